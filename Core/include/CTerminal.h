@@ -21,12 +21,17 @@
 #include <fstream>
 #include <vector>
 #include <deque>
+#include <mutex>
+#include <chrono>
 
 ///Default size of terminal scroll back buffer in lines.
 #define SCROLLBACK_SIZE 1000
 
-#define CTERMINAL_VERSION "1.2.10"
-#define CTERMINAL_DATE "Sept. 7th, 2016"
+///Default maximum number of distinct posted messages waiting to be written.
+#define POSTED_MESSAGES_SIZE 100
+
+#define CTERMINAL_VERSION "1.2.11"
+#define CTERMINAL_DATE "Oct. 15th, 2026"
 
 #include <curses.h>
 
@@ -147,6 +152,20 @@ class Terminal{
 	
 	/// Number of lines scrolled back
 	int _scrollPosition;
+
+	/// A message posted with Post() and the number of times it was posted since it was last written.
+	struct PostedMessage{
+		std::string key; ///< Messages with the same key are coalesced.
+		std::string text; ///< The text of the latest message with this key.
+		unsigned int count; ///< The number of messages coalesced.
+	};
+
+	std::mutex post_mutex; ///< Protects the posted messages and the status lines.
+	std::deque<PostedMessage> posted; ///< Messages waiting to be written by flush().
+	size_t numDropped; ///< Messages dropped since the last write because the queue was full.
+	size_t maxPosted_; ///< Maximum number of distinct messages waiting.
+	float postInterval_; ///< Minimum time in seconds between writes of posted messages.
+	std::chrono::system_clock::time_point lastPostWrite_; ///< Time posted messages were last written.
 	
 	/// Refresh the terminal
 	void refresh_();
@@ -162,6 +181,12 @@ class Terminal{
 	
 	/// Clear the command prompt output
 	void clear_();
+
+	/// Return a copy of a status line
+	std::string get_status_(unsigned short line);
+
+	/// Take the posted messages as text, if the interval since they were last written has passed
+	std::string take_posted_();
 	
 	/// Force a character to the input screen
 	void in_char_(const char input_);
@@ -234,7 +259,13 @@ class Terminal{
 	/// Disrupt ncurses while boolean is true
 	void pause(bool &flag);
 
-	/// Dump all text in the stream to the output screen
+	/// Queue a message from any thread, to be written by the next flush(). Never waits on the screen.
+	void Post(const std::string &msg, const std::string &key="");
+
+	/// Set the minimum time in seconds between writes of posted messages and the queue size.
+	void SetPostLimits(float interval, size_t maxMessages = POSTED_MESSAGES_SIZE);
+
+	/// Dump all text in the stream and the posted messages to the output screen
 	void flush();
 
 	/// Print a command to the terminal output.
@@ -0,0 +1,77 @@
+/** \file SpillBuffer.h
+  *
+  * \brief A growable, cache line aligned buffer for a single data spill
+  *
+  * Spills are read into a buffer which is kept from one spill to the next and
+  * only grows, doubling its size, when a spill does not fit. So no memory is
+  * allocated for a spill once the buffer has reached the size of the largest
+  * spill, and no spill is ever cut short because the buffer was sized for a
+  * smaller one. The readers of DATA_buffer and PLD_data grow the buffer as the
+  * spill is read.
+*/
+
+#ifndef SPILL_BUFFER_H
+#define SPILL_BUFFER_H
+
+#include <stdlib.h>
+#include <string.h>
+
+class SpillBuffer{
+  public:
+	static const size_t alignment = 64; /// Alignment of the data (in bytes), a cache line.
+	static const size_t maxWords = 1 << 28; /// Largest size of the buffer (in words), to reject corrupt spill lengths.
+
+	/// Default constructor.
+	SpillBuffer() : words(NULL), capacity(0) { }
+
+	/// Move constructor, the data of other_ is taken over.
+	SpillBuffer(SpillBuffer &&other_) noexcept : words(other_.words), capacity(other_.capacity) {
+		other_.words = NULL;
+		other_.capacity = 0;
+	}
+
+	/// Destructor.
+	~SpillBuffer(){ free(words); }
+
+	/// Return a pointer to the data.
+	unsigned int *Data(){ return words; }
+
+	/// Return the number of words the buffer holds.
+	size_t Capacity() const { return capacity; }
+
+	/** Make room for at least nWords_ words, keeping the first keepWords_ words
+	  * of the data. The buffer is never shrunk.
+	  * \param[in]  nWords_    The number of words needed.
+	  * \param[in]  keepWords_ The number of words of the data to keep if the buffer is moved.
+	  * \return False if nWords_ is larger than maxWords or the memory could not be allocated.
+	  */
+	bool Reserve(const size_t &nWords_, const size_t &keepWords_=0){
+		if(nWords_ <= capacity){ return true; }
+		if(nWords_ > maxWords){ return false; }
+
+		size_t newCapacity = (2*capacity > nWords_ ? 2*capacity : nWords_);
+		if(newCapacity > maxWords){ newCapacity = maxWords; }
+
+		void *newWords = NULL;
+		if(posix_memalign(&newWords, alignment, newCapacity*sizeof(unsigned int)) != 0){ return false; }
+		if(words && keepWords_ > 0){ memcpy(newWords, words, (keepWords_ < capacity ? keepWords_ : capacity)*sizeof(unsigned int)); }
+
+		free(words);
+		words = (unsigned int*)newWords;
+		capacity = newCapacity;
+
+		return true;
+	}
+
+  private:
+	unsigned int *words; /// The data.
+	size_t capacity; /// The number of words allocated.
+
+	/// The buffer is not copied.
+	SpillBuffer(const SpillBuffer &) = delete;
+
+	/// The buffer is not copied.
+	SpillBuffer &operator = (const SpillBuffer &) = delete;
+};
+
+#endif
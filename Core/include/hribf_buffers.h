@@ -24,10 +24,21 @@
 
 #include <fstream>
 #include <vector>
+#include <thread>
 
 #define HRIBF_BUFFERS_VERSION "1.3.00"
 #define HRIBF_BUFFERS_DATE "Sept. 19th, 2016"
 
+class SpillBuffer;
+
+/// A run of contiguous spill words, which are not copied out of the memory they were read into.
+struct SpillSpan{
+	const unsigned int *data; /// The first word of the span.
+	unsigned int nWords; /// The number of words in the span.
+
+	SpillSpan(const unsigned int *data_, const unsigned int &nWords_) : data(data_), nWords(nWords_) { }
+};
+
 #define ACTUAL_BUFF_SIZE 8194 /// HRIBF .ldf file format
 
 class Client;
@@ -64,6 +75,9 @@ class BufferType{
 
 	/// Return true if the first word of the current buffer is equal to this buffer type
 	bool ReadHeader(std::ifstream *file_);
+
+	/// Return true if the word at pos_ in a memory mapped file is equal to this buffer type. Advances pos_ by one word.
+	bool ReadHeader(const unsigned int *map_, const size_t &mapWords_, size_t &pos_);
 };
 
 /// The pld header contains information about the run including the date/time, the title, and the run number.
@@ -80,7 +94,10 @@ class PLD_header : public BufferType{
 
   public:
 	PLD_header();
+	PLD_header(const PLD_header &other_);
 	~PLD_header();
+
+	PLD_header &operator = (const PLD_header &other_);
 	
 	unsigned int GetBufferLength(); /// Get the total length of the buffer (in bytes)
 	
@@ -105,6 +122,8 @@ class PLD_header : public BufferType{
 	void SetEndDateTime();
 
 	void SetFacility(std::string input_);
+
+	void SetFormat(std::string input_);
 	
 	void SetTitle(std::string input_);
 	
@@ -134,16 +153,60 @@ class PLD_header : public BufferType{
 /// The DATA buffer contains all physics data within the .pld file
 class PLD_data : public BufferType{
   private:
-	
+	bool compress; /// Write spills as zlib compressed blocks.
+	int compression_level; /// zlib compression level used for writing.
+	std::vector<char> zbuffer; /// Scratch space for compressed spill blocks.
+
+	/// Read a compressed data block whose header word has already been read.
+	bool read_block(std::ifstream *file_, char *data_, SpillBuffer *buffer_, unsigned int &nBytes, unsigned int max_bytes_, bool dry_run_mode);
+
+	/// Read a data spill from a file into data_, or into buffer_ if it is not NULL.
+	bool read_spill_(std::ifstream *file_, char *data_, SpillBuffer *buffer_, unsigned int &nBytes, unsigned int max_bytes_, bool dry_run_mode);
+
   public:
+	/// Location of a single compressed spill block in a compressed pld file.
+	struct Block{
+		unsigned long long offset; /// Byte offset of the block header in the file.
+		unsigned int nWords; /// Uncompressed length of the spill (in words).
+	};
+
 	PLD_data(); /// 0x41544144 "DATA"
 
-	/// Write a data spill to file
+	/// Return true if zlib support was compiled in.
+	static bool CompressionAvailable();
+
+	/// Return true if spills are written as compressed blocks.
+	bool GetCompression(){ return compress; }
+
+	/// Toggle writing spills as compressed blocks. Returns false if zlib is unavailable.
+	bool SetCompression(bool state_=true, int level_=1);
+
+	/** Write a data spill to file. When compression is enabled, the spill is written
+	  * as an independent compressed block (1 word block type, 1 word uncompressed length
+	  * in words, 1 word compressed length in bytes, compressed data padded to a whole
+	  * word, 1 word end of buffer) */
 	virtual bool Write(std::ofstream *file_, char *data_, unsigned int nWords_);
+
+	/** Write the block index of a compressed file (1 word buffer type, 1 word number of
+	  * blocks N, 3N words of block offsets and lengths, 1 word N, 1 word end of buffer) */
+	bool WriteIndex(std::ofstream *file_, const std::vector<Block> &blocks_);
+
+	/** Read the block index from the end of a compressed file. The stream position is
+	  * restored afterwards. Returns false if the file contains no index */
+	bool ReadIndex(std::ifstream *file_, std::vector<Block> &blocks_);
 	
 	/// Read a data spill from a file
 	virtual bool Read(std::ifstream *file_, char *data_, unsigned int &nBytes, unsigned int max_bytes_, bool dry_run_mode=false);
 
+	/** Read a data spill from a file into a spill buffer, which is grown to hold the
+	  * spill and the two words which terminate it, so no spill is too large to read */
+	bool Read(std::ifstream *file_, SpillBuffer &buffer_, unsigned int &nBytes, bool dry_run_mode=false);
+
+	/** Parse a data spill in place from a memory mapped file. On success, data_ points
+	  * to the first word of the spill inside the mapping and pos_ is advanced to the word
+	  * following the end of the buffer. Nothing is copied. */
+	bool Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, const unsigned int *&data_, unsigned int &nBytes, unsigned int max_bytes_);
+
 	/// Set initial values.
 	virtual void Reset(){ }
 };
@@ -241,8 +304,16 @@ class DATA_buffer : public BufferType{
 	unsigned int buffer1[ACTUAL_BUFF_SIZE]; /// Container for a ldf buffer.
 	unsigned int buffer2[ACTUAL_BUFF_SIZE]; /// Container for a second ldf buffer.
 
-	unsigned int *curr_buffer; /// Pointer to the current ldf buffer.
-	unsigned int *next_buffer; /// Pointer to the next ldf buffer.
+	const unsigned int *curr_buffer; /// Pointer to the current ldf buffer.
+	const unsigned int *next_buffer; /// Pointer to the next ldf buffer.
+
+	std::vector<unsigned int> image; /// The ldf buffers of the spill being written, as they are laid out in the file.
+
+	std::ifstream *input; /// The input file to read buffers from (if not reading from a memory map).
+	const unsigned int *map_data; /// The memory mapped file to read buffers from (if any).
+	size_t map_words; /// The number of words in the memory mapped file.
+	size_t *map_pos; /// The position of the next unread word in the memory mapped file.
+	bool map_eof; /// Set to true when there are no more full buffers in the memory mapped file.
 	
 	unsigned int bcount; /// The total number of ldf buffers read from file.
 	unsigned int buff_head; /// The ldf buffer header ID.
@@ -251,11 +322,31 @@ class DATA_buffer : public BufferType{
 	unsigned int missing_chunks; /// Count of the number of missing spill chunks which were dropped.
 
 	unsigned int buff_pos; /// The actual position in the current ldf buffer.
+	unsigned int start_pos; /// Position to start reading from in the first buffer after a call to SetStartPosition.
+
+	size_t curr_offset; /// The word offset of the current ldf buffer in the input.
+	size_t next_offset; /// The word offset of the next ldf buffer in the input.
+	size_t spill_offset; /// The word offset of the buffer containing the start of the last spill read.
+	unsigned int spill_pos; /// The position of the start of the last spill read within its buffer.
 
 	/// DATA buffer (1 word buffer type, 1 word buffer size)
 	bool open_(std::ofstream *file_);
 
-	bool read_next_buffer(std::ifstream *f_, bool force_=false);
+	/// Add the header of a new ldf buffer to the spill image.
+	void open_image_();
+
+	/// Pad the current ldf buffer of the spill image with 0xFFFFFFFF words.
+	void close_image_();
+
+	/// Load the next ldf buffer into storage_ or, for a memory mapped file, point ptr_ at it in the mapping.
+	bool load_buffer_(unsigned int *storage_, const unsigned int *&ptr_, size_t &offset_);
+
+	bool read_next_buffer(bool force_=false);
+
+	/** Read a data spill from the current input (file or memory map) into data_, or into buffer_
+	  * if it is not NULL. If spans_ is not NULL, nothing is copied and the chunks of the spill
+	  * are added to spans_ instead (memory map only). */
+	bool read_spill_(char *data_, SpillBuffer *buffer_, std::vector<SpillSpan> *spans_, unsigned int &nBytes_, unsigned int max_bytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode);
 	
   public:
 	DATA_buffer(); /// 0x41544144 "DATA"
@@ -276,6 +367,7 @@ class DATA_buffer : public BufferType{
 	  *  4 - Encountered invalid spill chunk
 	  *  5 - Received bad spill footer size
 	  *  6 - Failed to read buffer from file
+	  *  7 - Spill larger than the data array
 	  */
 	int GetRetval(){ return retval; }
 	
@@ -285,12 +377,41 @@ class DATA_buffer : public BufferType{
 	/// Return the number of missing or dropped spill chunks.
 	unsigned int GetNumMissing(){ return missing_chunks; }
 	
+	/// Return the word offset in the input of the ldf buffer where the last spill read started.
+	size_t GetSpillOffset(){ return spill_offset; }
+	
+	/// Return the word position of the start of the last spill read within its ldf buffer.
+	unsigned int GetSpillPosition(){ return spill_pos; }
+	
+	/** Discard the ldf buffers held in memory so that the next read starts at word pos_ of the
+	  * buffer at the current input position. Used after seeking the input to a known spill.
+	  * The spill chunk counters are not reset. */
+	void SetStartPosition(const unsigned int &pos_);
+	
 	/// Write a data spill to file
 	virtual bool Write(std::ofstream *file_, char *data_, unsigned int nWords_, int &buffs_written);
 	
 	/// Read a data spill from a file
 	virtual bool Read(std::ifstream *file_, char *data_, unsigned int &nBytes_, unsigned int max_bytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode=false);
 
+	/** Read a data spill from a memory mapped file. The ldf buffers are parsed in place
+	  * and only the spill chunk payloads are copied into data_. pos_ is the word position
+	  * in the mapping and is advanced as buffers are read. */
+	bool Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, char *data_, unsigned int &nBytes_, unsigned int max_bytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode=false);
+
+	/** Read a data spill from a file into a spill buffer, which is grown to hold the
+	  * spill and the two words which terminate it, so no spill is too large to read */
+	bool Read(std::ifstream *file_, SpillBuffer &buffer_, unsigned int &nBytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode=false);
+
+	/// Read a data spill from a memory mapped file into a spill buffer, which is grown to hold the spill.
+	bool Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, SpillBuffer &buffer_, unsigned int &nBytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode=false);
+
+	/** Read a data spill from a memory mapped file without reassembling it. spans_ is filled
+	  * with the payloads of the spill chunks, in order, where they lie in the mapping, so the
+	  * spill words are never copied. The spans are valid as long as the mapping is. nBytes_
+	  * is the total length of the spans. */
+	bool Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, std::vector<SpillSpan> &spans_, unsigned int &nBytes_, bool &full_spill, bool &bad_spill);
+
 	/// Set initial values.
 	virtual void Reset();
 };
@@ -322,6 +443,7 @@ class PollOutputFile{
 	HEAD_buffer headBuff;
 	DATA_buffer dataBuff;
 	EOF_buffer eofBuff;
+	std::vector<PLD_data::Block> blockIndex; /// Compressed spill blocks written to the current file.
 	unsigned int max_spill_size;
 	unsigned int current_file_num;
 	unsigned int output_format;
@@ -333,6 +455,14 @@ class PollOutputFile{
 	std::string current_directory;
 	std::vector<std::string> directories;
 
+	std::ofstream next_file; /// Continuation file opened ahead of a rollover.
+	std::string next_filename; /// Name of the continuation file.
+
+	std::ofstream closing_file; /// File which was rolled over, finished by the finisher thread.
+	PLD_header closing_head; /// Final pld header of the file which was rolled over.
+	std::vector<PLD_data::Block> closing_index; /// Compressed spill blocks of the file which was rolled over.
+	std::thread finisher; /// Thread finishing the file which was rolled over.
+
 	/// Get the formatted filename of the current file
 	std::string get_filename();
 	
@@ -342,7 +472,14 @@ class PollOutputFile{
 	/** Overwrite the fourth word of the file with the total number of buffers and close the file
 	  * Returns false if no output file is open or if the number of 4 byte words in the file is not 
 	  * evenly divisible by the number of words in a buffer */
-	bool overwrite_dir(int total_buffers_=-1);
+	bool overwrite_dir(std::ofstream &file_, int total_buffers_=-1);
+
+	/** Write the EOF buffers, the block index and the final header of a file and close it. The
+	  * last ldf data buffer must already be closed and the header must hold its final values */
+	void finish_file(std::ofstream &file_, unsigned int format_, PLD_header &head_, const std::vector<PLD_data::Block> &index_);
+
+	/// Close and delete the continuation file, if one was opened
+	void discard_next_file();
 
 	/// Initialize the output file with initial parameters
 	void initialize();
@@ -384,7 +521,8 @@ class PollOutputFile{
 	/// Toggle debug mode
 	void SetDebugMode(bool debug_=true);
 	
-	/// Set the output file format
+	/** Set the output file format (0=ldf, 1=pld, 2=root, 3=compressed pld). Returns false
+	  * if the format is unknown or if compressed output is requested without zlib support */
 	bool SetFileFormat(unsigned int format_);
 
 	/// Set the output filename prefix
@@ -404,6 +542,15 @@ class PollOutputFile{
 	bool OpenNewFile(std::string title_, unsigned int &run_num_, std::string prefix, std::string output_dir="./", bool continueRun = false);
 
 	std::string GetNextFileName(unsigned int &run_num_, std::string prefix, std::string output_dir, bool continueRun = false);
+
+	/** Open the next continuation file of the run and write the start of its header, so that a
+	  * rollover does not wait on the file system. The current file is not touched, so this may run
+	  * in another thread while spills are written. Return false if the file could not be opened */
+	bool PrepareNextFile(unsigned int run_num_, std::string prefix, std::string output_dir="./");
+
+	/** Switch to the continuation file opened by PrepareNextFile. The current file is finished and
+	  * closed by a background thread. Return false if no continuation file is open */
+	bool Rollover(std::string title_, unsigned int run_num_);
 	
 	unsigned int GetRunNumber() {return dirBuff.GetRunNumber();}
 
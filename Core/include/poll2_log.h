@@ -0,0 +1,101 @@
+/** \file poll2_log.h
+  *
+  * \brief Rate limited logging of anomalies found in the readout and scan loops
+  *
+  * Each place in the code which reports an anomaly declares a static LogSite
+  * and asks it whether to print before doing any output. The first few
+  * occurrences of a site are printed, and after that at most one per
+  * interval, carrying the number of occurrences suppressed in between. Every
+  * occurrence, printed or not, is counted and kept as a small binary record
+  * in a ring shared by all sites, so a corrupted spill costs a few atomic
+  * operations per event instead of millions of lines of output.
+*/
+
+#ifndef POLL2_LOG_H
+#define POLL2_LOG_H
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#define POLL2_LOG_VERSION "1.0.00"
+#define POLL2_LOG_DATE "Oct. 15th, 2026"
+
+#define POLL2_LOG_RING_SIZE 4096 /// Number of records kept in the ring, a power of two
+#define POLL2_LOG_BURST 10 /// Default number of occurrences of a site printed before rate limiting
+#define POLL2_LOG_INTERVAL 1.0 /// Default minimum time in seconds between printed occurrences
+
+/// One occurrence of an anomaly, as kept in the ring.
+struct LogRecord{
+	uint64_t time; ///< Nanoseconds since the first occurrence logged by the process.
+	uint32_t site; ///< Index of the site, see LogSite::GetSite().
+	uint32_t seq; ///< Occurrence number at the site, starting at 0.
+	uint32_t a; ///< First value describing the occurrence, chosen by the site.
+	uint32_t b; ///< Second value describing the occurrence, chosen by the site.
+};
+
+class LogSite{
+  public:
+	/** Register a site. Sites are meant to be static and live until exit.
+	  * \param[in]  name_ Short description of the anomaly, used in the summary.
+	  * \param[in]  burst_ Number of occurrences printed before rate limiting.
+	  * \param[in]  interval_ Minimum time in seconds between printed occurrences after the burst.
+	  */
+	LogSite(const char *name_, unsigned int burst_=POLL2_LOG_BURST, double interval_=POLL2_LOG_INTERVAL);
+
+	/** Count an occurrence and add it to the ring. This does no output and
+	  * may be called from any thread.
+	  * \param[in]  a_ First value to keep in the record.
+	  * \param[in]  b_ Second value to keep in the record.
+	  * \return True if the caller should print its message and false otherwise.
+	  */
+	bool Hit(uint32_t a_=0, uint32_t b_=0);
+
+	/** Return a note on the occurrences suppressed since the last printed one
+	  * and reset their number, for appending to a printed message.
+	  * \return " [N similar suppressed]", or an empty string if there were none.
+	  */
+	std::string Suppressed();
+
+	const char *GetName() const { return name; }
+
+	uint64_t GetCount() const { return count.load(std::memory_order_relaxed); }
+
+	/// Return the site registered with index index_, or NULL.
+	static const LogSite *GetSite(uint32_t index_);
+
+	/** Print the number of occurrences of every site which was hit.
+	  * \param[in]  out_ Stream to print to.
+	  * \param[in]  prefix_ String printed at the start of each line.
+	  * \return The number of sites which were hit.
+	  */
+	static size_t PrintSummary(std::ostream &out_, const std::string &prefix_="");
+
+	/** Copy the records in the ring, oldest first.
+	  * \param[out] records_ The records. At most POLL2_LOG_RING_SIZE are kept.
+	  * \return The number of records copied.
+	  */
+	static size_t ReadRing(std::vector<LogRecord> &records_);
+
+	/** Write the records in the ring to a binary file, oldest first, preceded
+	  * by the names of the sites (one per line, then an empty line).
+	  * \param[in]  fname_ Name of the file to write.
+	  * \return True if the file was written and false otherwise.
+	  */
+	static bool WriteRing(const char *fname_);
+
+  private:
+	const char *name; ///< Short description of the anomaly.
+	uint32_t index; ///< Index of the site in the registry.
+	unsigned int burst; ///< Number of occurrences printed before rate limiting.
+	int64_t interval; ///< Minimum time between printed occurrences, in ns.
+
+	std::atomic<uint64_t> count; ///< Number of occurrences.
+	std::atomic<uint64_t> suppressed; ///< Occurrences not printed since the last printed one.
+	std::atomic<int64_t> nextPrint; ///< Earliest time of the next printed occurrence after the burst, in ns.
+};
+
+#endif
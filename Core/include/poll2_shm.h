@@ -0,0 +1,122 @@
+/** \file poll2_shm.h
+  *
+  * \brief Shares data spills between poll2 and scanners on the same host
+  *
+  * This file contains a ring of spill slots held in POSIX shared memory. The
+  * ring is created and written by poll2. Any number of scan programs on the
+  * same host may map it read-only and follow the spills at their own pace.
+  * Whole spills are passed without being split into network packets, so no
+  * spill is lost to a single dropped UDP datagram.
+*/
+
+#ifndef POLL2_SHM_H
+#define POLL2_SHM_H
+
+#include <atomic>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define POLL2_SHM_VERSION "1.0.00"
+#define POLL2_SHM_DATE "Oct. 14th, 2026"
+
+#define POLL2_SHM_NAME "/poll2_spills" /// Name of the shared memory object written by poll2
+#define POLL2_SHM_SLOTS 8 /// Default number of spill slots in the ring
+
+class SpillShm{
+  public:
+	typedef uint32_t word_t;
+
+	SpillShm();
+
+	~SpillShm(){ Close(); }
+
+	/** Create the shared memory ring and map it for writing. Any existing ring
+	  * with the same name is replaced.
+	  * \param[in]  name_ Name of the shared memory object.
+	  * \param[in]  nSlots_ Number of spill slots in the ring.
+	  * \param[in]  slotWords_ Maximum length of a spill, in words.
+	  * \return True if the ring was created and false otherwise.
+	  */
+	bool Create(const char *name_, unsigned int nSlots_, unsigned int slotWords_);
+
+	/** Map an existing shared memory ring read-only. The reader starts at the
+	  * next spill to be written.
+	  * \param[in]  name_ Name of the shared memory object.
+	  * \return True if the ring was mapped and false if it does not exist or is invalid.
+	  */
+	bool Open(const char *name_);
+
+	/** Copy a spill into the next slot of the ring, overwriting the oldest spill.
+	  * \param[in]  data_ Pointer to the spill.
+	  * \param[in]  nWords_ Length of the spill, in words.
+	  * \return False if the spill does not fit into a slot or the ring is not open for writing.
+	  */
+	bool Write(const word_t *data_, unsigned int nWords_);
+
+	/** Copy the next spill out of the ring. Spills which were overwritten before
+	  * they could be read are skipped and counted as dropped.
+	  * \param[out] data_ Array to copy the spill into.
+	  * \param[in]  maxWords_ Length of data_, in words.
+	  * \return The length of the spill in words, 0 if no new spill is available, or -1
+	  *  if the writer has closed the ring or is no longer running.
+	  */
+	int Read(word_t *data_, unsigned int maxWords_);
+
+	/// Unmap the ring. The writer also marks the ring as closed and removes it.
+	void Close();
+
+	/// Return true if the ring is mapped.
+	bool IsOpen(){ return (header != NULL); }
+
+	/// Return true if this object created the ring.
+	bool IsWriter(){ return writer; }
+
+	/// Return the maximum length of a spill, in words.
+	unsigned int GetSlotWords();
+
+	/// Return the number of spills this reader has dropped, or the writer could not fit.
+	unsigned long GetDropped(){ return dropped; }
+
+	/// Return the number of spills written to the ring.
+	unsigned long long GetWritten();
+
+	/// Return the number of spills written but not yet read by this reader, at most the number of slots.
+	unsigned int GetBacklog();
+
+	/// Return the number of spill slots in the ring.
+	unsigned int GetSlots(){ return (header ? header->nSlots : 0); }
+
+  private:
+	/// Layout of the start of the shared memory object.
+	struct Header{
+		uint32_t magic; /// Identifies a poll2 spill ring.
+		uint32_t nSlots; /// Number of spill slots.
+		uint32_t slotWords; /// Maximum length of a spill, in words.
+		pid_t pid; /// Process ID of the writer.
+		std::atomic<uint64_t> head; /// Sequence number of the next spill to write.
+		std::atomic<uint32_t> closed; /// Set to 1 when the writer closes the ring.
+	};
+
+	/// Layout of the start of each spill slot, followed by the spill itself.
+	struct SlotHeader{
+		std::atomic<uint64_t> seq; /// Sequence number (+1) of the spill in the slot, 0 while it is written.
+		uint32_t nWords; /// Length of the spill, in words.
+		uint32_t reserved; /// Keeps the spill data aligned.
+	};
+
+	std::string name; /// Name of the shared memory object.
+	Header *header; /// Start of the mapped ring.
+	size_t mapSize; /// Size of the mapping, in bytes.
+	size_t slotBytes; /// Size of each slot including its header, in bytes.
+	bool writer; /// True if this object created the ring.
+	uint64_t next; /// Sequence number of the next spill this reader will read.
+	unsigned long dropped; /// Number of spills dropped.
+
+	/// Return a pointer to the slot which holds the spill with sequence number seq_.
+	SlotHeader *get_slot(const uint64_t &seq_);
+};
+
+#endif
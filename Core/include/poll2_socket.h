@@ -15,10 +15,17 @@
 #ifndef POLL2_SOCKET_H
 #define POLL2_SOCKET_H
 
+#include <vector>
+
 #include <netinet/in.h>
+#include <sys/uio.h>
+
+#define POLL2_SOCKET_VERSION "1.2.01"
+#define POLL2_SOCKET_DATE "Oct. 14th, 2026"
 
-#define POLL2_SOCKET_VERSION "1.1.01"
-#define POLL2_SOCKET_DATE "May 11th, 2015"
+#define POLL2_SOCKET_BATCH 64 /// Maximum number of datagrams passed to a single sendmmsg/recvmmsg call
+#define POLL2_SOCKET_BUFFER 8388608 /// Kernel buffer size (in bytes) requested for the poll2 shm port
+#define POLL2_SOCKET_CHUNK 4050 /// Maximum number of spill words in a single shm datagram
 
 class Server{
   private:
@@ -46,10 +53,28 @@ class Server{
 	  * -1 if the receive fails or if the object was not initialized. */
 	int RecvMessage(char *message_, size_t length_);
 
+	/** Receive up to count_ messages with as few system calls as possible. Waits for
+	  * the first message, then takes any others which are already queued. Message i
+	  * is stored at &messages_[i*length_] and its length in bytes in lengths_[i].
+	  * Returns the number of messages received. Returns -1 if the receive fails or
+	  * if the object was not initialized. */
+	int RecvMessages(char *messages_, size_t length_, int *lengths_, unsigned int count_);
+
 	/** Send a message to the socket. Returns the number of bytes sent. Returns
 	  * -1 if the send fails or if the object was not initialized. */
 	int SendMessage(char *message_, size_t length_);
 
+	/** Set the size of the kernel receive buffer in bytes, so bursts of messages are
+	  * not dropped before they are read. The kernel may cap the size (net.core.rmem_max).
+	  * Returns false if the object was not initialized or the size could not be set. */
+	bool SetBufferSize(int bytes_);
+
+	/// Return the size of the kernel receive buffer in bytes, or 0 if it is unknown.
+	int GetBufferSize();
+
+	/// Return the number of bytes waiting in the kernel receive buffer, or 0 if it is unknown.
+	int GetQueued();
+
 	bool Select(int &retval);
 
 	/// Close the socket.
@@ -64,6 +89,9 @@ class Client{
 	struct hostent *hp;
 	bool init;
 
+	std::vector<unsigned int> spillHeaders; /// Chunk headers of the spill being sent.
+	std::vector<struct iovec> spillIov; /// Header and data blocks of the spill being sent.
+
   public:
 	Client(){ init = false; }
 	
@@ -82,6 +110,25 @@ class Client{
 	/** Send a message to the socket. Returns the number of bytes sent. Returns
 	  * -1 if the send fails or if the object was not initialized. */
 	int SendMessage(char *message_, size_t length_);
+
+	/** Send count_ messages with as few system calls as possible. Each message is
+	  * gathered from iovPerMsg_ consecutive entries of iov_, so headers and data need
+	  * not be copied into one buffer. Returns the number of messages sent. Returns
+	  * -1 if the first send fails or if the object was not initialized. */
+	int SendMessages(struct iovec *iov_, unsigned int iovPerMsg_, unsigned int count_);
+
+	/** Send a spill in the poll2 shm format. The spill is split into chunks of at most
+	  * POLL2_SOCKET_CHUNK words, each preceded by a two word header (chunk number
+	  * starting at 1, number of chunks), and sent in batches with a short pause between
+	  * batches so the receiver can keep up. Returns the number of chunks sent, which is
+	  * less than the number of chunks if a send failed, or -1 if the object was not
+	  * initialized. */
+	int SendSpill(const unsigned int *data_, unsigned int nWords_);
+
+	/** Set the size of the kernel send buffer in bytes, so a burst of messages does
+	  * not have to wait for the network. The kernel may cap the size (net.core.wmem_max).
+	  * Returns false if the object was not initialized or the size could not be set. */
+	bool SetBufferSize(int bytes_);
 	
 	/// Close the socket.
 	void Close();
@@ -0,0 +1,199 @@
+/** \file poll2_stream.h
+  *
+  * \brief Streams data spills from poll2 to remote scanners over TCP
+  *
+  * This file contains classes used to send whole spills from poll2 to any
+  * number of subscribers over TCP. The StreamServer is run by poll2 and never
+  * waits on a subscriber. Each subscriber has its own bounded queue, and a
+  * subscriber which falls behind drops whole spills rather than slowing down
+  * the others. The StreamClient is used by the scan programs to subscribe.
+  * Each spill is framed by a four word header of POLL2_STREAM_MAGIC, the
+  * spill sequence number, the spill length in words and the number of spills
+  * skipped by the subscription since the previous frame. A subscriber may ask
+  * for only every Nth spill, or for a maximum data rate, by sending a three
+  * word subscription of POLL2_STREAM_SUBSCRIBE, N and the rate in bytes/s.
+*/
+
+#ifndef POLL2_STREAM_H
+#define POLL2_STREAM_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POLL2_STREAM_VERSION "1.1.00"
+#define POLL2_STREAM_DATE "Oct. 14th, 2026"
+
+#define POLL2_STREAM_PORT 5556 /// Default TCP port of the poll2 spill stream
+#define POLL2_STREAM_MAGIC 0x53505354 /// Start of every spill frame ("SPST")
+#define POLL2_STREAM_SUBSCRIBE 0x53554253 /// Start of a subscription from a subscriber ("SUBS")
+#define POLL2_STREAM_QUEUE 67108864 /// Default maximum number of bytes queued for each subscriber
+
+class StreamServer{
+  public:
+	typedef uint32_t word_t;
+
+	StreamServer();
+
+	~StreamServer(){ Close(); }
+
+	/** Listen for subscribers on a port and start the thread which serves them.
+	  * \param[in]  port_ The TCP port to listen on.
+	  * \param[in]  maxQueued_ The maximum number of bytes queued for a single subscriber.
+	  * \return False if the port could not be opened and true otherwise.
+	  */
+	bool Init(int port_, size_t maxQueued_=POLL2_STREAM_QUEUE);
+
+	/** Queue a spill for every subscriber which wants it. Never waits on the network.
+	  * A subscriber whose queue has no room for the spill drops it.
+	  * \param[in]  data_ Pointer to the spill.
+	  * \param[in]  nWords_ Length of the spill, in words.
+	  */
+	void Send(const word_t *data_, unsigned int nWords_);
+
+	/// Disconnect all subscribers and stop listening.
+	void Close();
+
+	/// Return the number of connected subscribers.
+	size_t GetNumClients();
+
+	/// Return the number of spills dropped by all subscribers.
+	unsigned long GetDropped(){ return dropped; }
+
+	/// Return the number of spills skipped by all subscriptions.
+	unsigned long GetSkipped(){ return skipped; }
+
+	/// Return the number of spills queued.
+	unsigned long long GetSent(){ return sequence; }
+
+  private:
+	typedef std::shared_ptr<const std::vector<char> > FramePtr;
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	/// A spill waiting to be sent to one subscriber.
+	struct Frame{
+		word_t header[4]; /// Frame header for this subscriber.
+		FramePtr spill; /// The spill, shared by all subscribers.
+
+		size_t size() const { return sizeof(header) + spill->size(); }
+	};
+
+	/// A connected subscriber and the frames waiting to be sent to it.
+	struct Subscriber{
+		int sock; /// Connected socket.
+		std::deque<Frame> queue; /// Frames waiting to be sent.
+		size_t offset; /// Bytes of the first frame already sent.
+		size_t queuedBytes; /// Total bytes waiting to be sent.
+
+		unsigned int every; /// Send only every Nth spill.
+		double maxRate; /// Maximum data rate in bytes/s, 0 for no limit.
+		double credit; /// Bytes which may be sent under the rate limit.
+		time_point lastSend; /// Time at which the credit was last updated.
+		unsigned long long offered; /// Number of spills offered to this subscriber.
+		unsigned int skipped; /// Spills skipped by the subscription since the last queued frame.
+		std::vector<char> request; /// Partially received subscription.
+
+		Subscriber(int sock_) : sock(sock_), offset(0), queuedBytes(0), every(1), maxRate(0), credit(0), 
+		                        lastSend(std::chrono::steady_clock::now()), offered(0), skipped(0) { }
+	};
+
+	int listenSock; /// Socket accepting new subscribers.
+	int wakePipe[2]; /// Wakes the server thread when a spill is queued.
+	size_t maxQueued; /// Maximum number of bytes queued for a single subscriber.
+
+	std::vector<Subscriber> subscribers; /// Connected subscribers.
+	std::mutex subscriberMutex; /// Guards subscribers.
+	std::thread serverThread; /// Accepts subscribers and sends them their frames.
+	std::atomic<bool> running; /// Set to false to stop the server thread.
+
+	std::atomic<unsigned long long> sequence; /// Sequence number of the next spill.
+	std::atomic<unsigned long> dropped; /// Number of spills dropped by all subscribers.
+	std::atomic<unsigned long> skipped; /// Number of spills skipped by all subscriptions.
+
+	/// Accept subscribers and send queued frames until the server is closed.
+	void serve();
+
+	/// Send as much of a subscriber's queue as the socket takes. Returns false if the subscriber has gone.
+	bool send_queued(Subscriber &sub_);
+
+	/// Read a subscription sent by a subscriber. Returns false if the subscriber has gone.
+	bool read_request(Subscriber &sub_);
+
+	/// Return true if a subscription wants a spill of the given size, and update its rate limit.
+	bool wants(Subscriber &sub_, const size_t &nBytes_, const time_point &now_);
+};
+
+class StreamClient{
+  public:
+	typedef uint32_t word_t;
+
+	StreamClient() : sock(-1), next(0), dropped(0), skipped(0), received(0) { }
+
+	~StreamClient(){ Close(); }
+
+	int Get(){ return sock; }
+
+	/** Connect to a poll2 spill stream.
+	  * \param[in]  address_ Host name or address of the poll2 machine.
+	  * \param[in]  port_ The TCP port of the stream.
+	  * \return False if the host could not be resolved or reached and true otherwise.
+	  */
+	bool Init(const char *address_, int port_=POLL2_STREAM_PORT);
+
+	/** Ask poll2 to send only part of the spills. By default every spill is sent.
+	  * \param[in]  every_ Send only every Nth spill.
+	  * \param[in]  maxRate_ Maximum data rate in MB/s, 0 for no limit. Spills which would
+	  *  exceed the rate are skipped.
+	  * \return False if the request could not be sent.
+	  */
+	bool Subscribe(unsigned int every_, double maxRate_=0);
+
+	/** Read the next spill from the stream.
+	  * \param[out] data_ Vector to store the spill in. It is resized as needed.
+	  * \param[in]  timeout_ Time to wait for a spill to start to arrive, in ms.
+	  * \return The length of the spill in words, 0 if no spill arrived in time, or -1 if
+	  *  the stream was closed or is corrupt.
+	  */
+	int Read(std::vector<word_t> &data_, int timeout_);
+
+	/// Close the connection.
+	void Close();
+
+	/// Return true if connected to a stream.
+	bool IsOpen(){ return (sock >= 0); }
+
+	/// Return the number of spills poll2 dropped for this subscriber because it fell behind.
+	unsigned long GetDropped(){ return dropped; }
+
+	/// Return the number of spills poll2 skipped because of the subscription.
+	unsigned long GetSkipped(){ return skipped; }
+
+	/// Return the number of spills received.
+	unsigned long GetReceived(){ return received; }
+
+	/// Return the size of the kernel receive buffer in bytes, or 0 if it is unknown.
+	int GetBufferSize();
+
+	/// Return the number of bytes waiting in the kernel receive buffer, or 0 if it is unknown.
+	int GetQueued();
+
+  private:
+	int sock; /// Connected socket, -1 if not connected.
+	unsigned long long next; /// Sequence number of the next expected spill.
+	unsigned long dropped; /// Number of spills dropped by poll2 for this subscriber.
+	unsigned long skipped; /// Number of spills skipped by the subscription.
+	unsigned long received; /// Number of spills received.
+
+	/// Read exactly length_ bytes. Returns false if the stream was closed.
+	bool read_all(char *buffer_, size_t length_);
+};
+
+#endif
@@ -326,15 +326,23 @@ void Terminal::SetStatus(std::string status, unsigned short line) {
 }
 
 void Terminal::ClearStatus(unsigned short line) {
+	std::lock_guard<std::mutex> lock(post_mutex);
 	if (status_window)
 		statusStr.at(line) = "";
 }
 
 void Terminal::AppendStatus(std::string status, unsigned short line) {
+	std::lock_guard<std::mutex> lock(post_mutex);
 	if (status_window)
 		statusStr.at(line).append(status);
 }
 
+// The status lines may be set from any thread, so they are copied under the lock.
+std::string Terminal::get_status_(unsigned short line) {
+	std::lock_guard<std::mutex> lock(post_mutex);
+	return statusStr.at(line);
+}
+
 // Force a character to the input screen
 void Terminal::in_char_(const char input_){
 	cursX++;
@@ -527,7 +535,10 @@ Terminal::Terminal() :
 	insertMode_(false),
 	debug_(false),
 	_scrollbackBufferSize(SCROLLBACK_SIZE),
-	_scrollPosition(0)
+	_scrollPosition(0),
+	numDropped(0),
+	maxPosted_(POSTED_MESSAGES_SIZE),
+	postInterval_(0.25)
 {
 	from_script = false;
 	prompt_user = false;
@@ -686,13 +697,13 @@ void Terminal::print(WINDOW* window, std::string input_){
 	refresh_();
 }
 
-// Dump all text in the stream to the output screen
+// Dump all text in the stream and the posted messages to the output screen
 void Terminal::flush(){
-	std::string stream_contents = stream.str();
+	std::string stream_contents = stream.str() + take_posted_();
 	if(stream_contents.size() > 0){
 		print(output_window, stream_contents);
 		if (logFile.good()) {
-			logFile << stream.str();
+			logFile << stream_contents;
 			logFile.flush();
 		}
 		stream.str("");
@@ -700,6 +711,74 @@ void Terminal::flush(){
 	}
 }
 
+/**Queue a message to be written to the output screen by the next flush(). This
+ * may be called from any thread and never touches the screen, so it may be used
+ * in loops which must not wait on the terminal. A message with the same key as
+ * one still waiting replaces it, and the number of such messages is printed
+ * with the last one.
+ *
+ * \param[in] msg The message, including any trailing newline.
+ * \param[in] key Messages with the same key are coalesced. Defaults to the message itself.
+ */
+void Terminal::Post(const std::string &msg, const std::string &key/*=""*/){
+	const std::string &k = (key.empty() ? msg : key);
+
+	std::lock_guard<std::mutex> lock(post_mutex);
+	for(std::deque<PostedMessage>::iterator it = posted.begin(); it != posted.end(); ++it){
+		if(it->key == k){
+			it->text = msg;
+			it->count++;
+			return;
+		}
+	}
+	if(posted.size() >= maxPosted_){
+		numDropped++;
+		return;
+	}
+	PostedMessage newMsg = {k, msg, 1};
+	posted.push_back(newMsg);
+}
+
+/**\param[in] interval Minimum time in seconds between writes of posted messages.
+ * \param[in] maxMessages Maximum number of distinct messages waiting, further messages are dropped and counted.
+ */
+void Terminal::SetPostLimits(float interval, size_t maxMessages/*=POSTED_MESSAGES_SIZE*/){
+	std::lock_guard<std::mutex> lock(post_mutex);
+	postInterval_ = interval;
+	maxPosted_ = maxMessages;
+}
+
+// Take the posted messages if the interval since they were last written has passed.
+std::string Terminal::take_posted_(){
+	sclock::time_point now = sclock::now();
+	if(std::chrono::duration_cast<std::chrono::duration<float>>(now - lastPostWrite_).count() < postInterval_){ return ""; }
+
+	std::deque<PostedMessage> msgs;
+	size_t dropped;
+	{
+		std::lock_guard<std::mutex> lock(post_mutex);
+		msgs.swap(posted);
+		dropped = numDropped;
+		numDropped = 0;
+	}
+	lastPostWrite_ = now;
+
+	std::string output;
+	for(std::deque<PostedMessage>::iterator it = msgs.begin(); it != msgs.end(); ++it){
+		if(it->count == 1){
+			output += it->text;
+			continue;
+		}
+		std::string text = it->text;
+		bool newline = (!text.empty() && text[text.size()-1] == '\n');
+		if(newline){ text.erase(text.size()-1); }
+		output += text + " (x" + to_str(it->count) + ")" + (newline ? "\n" : "");
+	}
+	if(dropped > 0){ output += to_str(dropped) + " posted messages dropped\n"; }
+
+	return output;
+}
+
 bool Terminal::SetLogFile(std::string logFileName) {
 	logFile.open(logFileName,std::ofstream::app);
 	if (!logFile.good()) {
@@ -828,7 +907,7 @@ std::string Terminal::GetCommand(std::string &args, const int &prev_cmd_return_/
 	//Update status message
 	if (status_window) {
 		werase(status_window);
-		print(status_window,statusStr.at(0).c_str());
+		print(status_window,get_status_(0).c_str());
 	}
 
 	// Check for commands in the command queue.
@@ -863,7 +942,7 @@ std::string Terminal::GetCommand(std::string &args, const int &prev_cmd_return_/
 			//Update status message
 			if (status_window) {
 				werase(status_window);
-				print(status_window,statusStr.at(0).c_str());
+				print(status_window,get_status_(0).c_str());
 			}
 
 			flush(); // If there is anything in the stream, dump it to the screen
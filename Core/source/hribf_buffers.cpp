@@ -26,8 +26,13 @@
 #include <iomanip>
 #include <vector>
 
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "hribf_buffers.h"
 #include "poll2_socket.h"
+#include "SpillBuffer.h"
 
 #define SMALLEST_CHUNK_SIZE 20 /// Smallest possible size of a chunk in words
 #define NO_HEADER_SIZE 8192 /// Size of .ldf buffer with no header
@@ -41,6 +46,8 @@
 #define PAC 541278544   /// "PAC "
 #define ENDFILE 541478725 /// End of file buffer
 #define ENDBUFF 0xFFFFFFFF /// End of buffer marker
+#define ZDATA 1413563482 /// "ZDAT" compressed pld data block
+#define ZINDEX 1480870234 /// "ZIDX" compressed pld block index
 
 #define LDF_DATA_LENGTH 8193 // Maximum length of an ldf style DATA buffer.
 
@@ -59,6 +66,17 @@ void set_char_array(const std::string &input_, char *arr_, const unsigned int &s
 	arr_[size_] = '\0';
 }
 
+/** Make room for nBytes_ bytes of a spill being read. With a spill buffer, the buffer is
+  * grown to hold them and the two words which terminate a spill, keeping the keepBytes_
+  * bytes already read, and data_ is pointed at it. Without one, nBytes_ must fit in max_bytes_.
+  */
+bool fit_spill(char *&data_, SpillBuffer *buffer_, const unsigned int &nBytes_, const unsigned int &keepBytes_, const unsigned int &max_bytes_){
+	if(!buffer_){ return (nBytes_ <= max_bytes_); }
+	if(!buffer_->Reserve((nBytes_ + 3)/4 + 2, keepBytes_/4)){ return false; }
+	data_ = (char*)buffer_->Data();
+	return true;
+}
+
 /// Return true if the input word corresponds to the header of a ldf style buffer.
 bool is_hribf_buffer(const unsigned int &input_){
 	return (input_==HEAD || input_==DATA || input_==SCAL || input_==DEAD || input_==DIR || input_==PAC || input_==ENDFILE);
@@ -94,16 +112,54 @@ bool BufferType::ReadHeader(std::ifstream *file_){
 	return true;
 }
 
+/// Return true if the word at pos_ in a memory mapped file is equal to this buffer type
+bool BufferType::ReadHeader(const unsigned int *map_, const size_t &mapWords_, size_t &pos_){
+	if(!map_ || pos_ >= mapWords_){ return false; }
+	if(map_[pos_++] != bufftype){ // Not a valid buffer
+		return false;
+	}
+	return true;
+}
+
 /// Default constructor.
 PLD_header::PLD_header() : BufferType(HEAD, 0){ // 0x44414548 "HEAD"
 	PLD_header::Reset();
 }
 
+/// Copy constructor. The run title is copied.
+PLD_header::PLD_header(const PLD_header &other_) : BufferType(other_){
+	run_title = NULL;
+	*this = other_;
+}
+
 /// Destructor.
 PLD_header::~PLD_header(){
 	if(run_title){ delete[] run_title; }
 }
 
+/// Assignment operator. The run title is copied.
+PLD_header &PLD_header::operator = (const PLD_header &other_){
+	if(this == &other_){ return *this; }
+	
+	BufferType::operator = (other_);
+	run_num = other_.run_num;
+	max_spill_size = other_.max_spill_size;
+	run_time = other_.run_time;
+	memcpy(format, other_.format, sizeof(format));
+	memcpy(facility, other_.facility, sizeof(facility));
+	memcpy(start_date, other_.start_date, sizeof(start_date));
+	memcpy(end_date, other_.end_date, sizeof(end_date));
+
+	if(run_title){ delete[] run_title; }
+	run_title = NULL;
+	if(other_.run_title){
+		run_title = new char[strlen(other_.run_title)+1];
+		strcpy(run_title, other_.run_title);
+	}
+	
+	return *this;
+}
+
 /// Get the length of the header buffer.
 unsigned int PLD_header::GetBufferLength(){
 	unsigned int buffer_len = 100;
@@ -134,6 +190,11 @@ void PLD_header::SetEndDateTime(){
 void PLD_header::SetFacility(std::string input_){
 	set_char_array(input_, facility, 16);
 }
+
+/// Set the format string of the output pld file (16 characters).
+void PLD_header::SetFormat(std::string input_){
+	set_char_array(input_, format, 16);
+}
 	
 /// Set the title of the output pld file (unlimited length).
 void PLD_header::SetTitle(std::string input_){
@@ -216,6 +277,53 @@ bool PLD_header::Read(std::ifstream *file_){
 	return true;
 }
 
+/// Parse a pld style data buffer in place from a memory mapped file.
+bool PLD_data::Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, const unsigned int *&data_, unsigned int &nBytes, unsigned int max_bytes_){
+	if(!map_ || pos_ >= mapWords_){ return false; }
+
+	if(map_[pos_] != bufftype){ // Not a valid DATA buffer
+		if(debug_mode){ std::cout << "debug: not a valid DATA buffer\n"; }
+
+		unsigned int countw = 0;
+		while(map_[pos_] != bufftype){
+			if(++pos_ >= mapWords_){
+				if(debug_mode){ std::cout << "debug: encountered physical end-of-file before start of spill!\n"; }
+				return false;
+			}
+			countw++;
+		}
+		
+		if(debug_mode){ std::cout << "debug: read an extra " << countw << " words to get to first DATA buffer!\n"; }
+	}
+	pos_++;
+
+	if(pos_ >= mapWords_){ return false; }
+	nBytes = map_[pos_++] * 4;
+	
+	if(debug_mode){ std::cout << "debug: reading spill of " << nBytes << " bytes\n"; }
+	
+	if(nBytes > max_bytes_){
+		if(debug_mode){ std::cout << "debug: spill size is greater than size of data array!\n"; }
+		return false;
+	}
+
+	if(pos_ + nBytes/4 >= mapWords_){
+		if(debug_mode){ std::cout << "debug: encountered physical end-of-file before end of spill!\n"; }
+		pos_ = mapWords_;
+		return false;
+	}
+
+	data_ = &map_[pos_];
+	pos_ += nBytes/4;
+
+	if(map_[pos_++] != buffend){ // Buffer was not terminated properly
+		if(debug_mode){ std::cout << "debug: buffer not terminated properly\n"; }
+		return false;
+	}
+
+	return true;
+}
+
 /// Set initial values.
 void PLD_header::Reset(){
 	set_char_array("U OF TENNESSEE  ", facility, 16);
@@ -255,12 +363,106 @@ void PLD_header::PrintDelimited(const char &delimiter_/*='\t'*/){
 
 /// Default constructor.
 PLD_data::PLD_data() : BufferType(DATA, 0){ // 0x41544144 "DATA"
+	compress = false;
+	compression_level = 1;
+}
+
+/// Read a compressed data block whose header word has already been read.
+bool PLD_data::read_block(std::ifstream *file_, char *data_, SpillBuffer *buffer_, unsigned int &nBytes, unsigned int max_bytes_, bool dry_run_mode){
+	unsigned int zBytes;
+	file_->read((char*)&nBytes, 4);
+	file_->read((char*)&zBytes, 4);
+	nBytes = nBytes * 4;
+
+	if(debug_mode){ std::cout << "debug: reading compressed spill of " << nBytes << " bytes (" << zBytes << " compressed bytes)\n"; }
+
+	if(!dry_run_mode && !fit_spill(data_, buffer_, nBytes, 0, max_bytes_)){
+		if(debug_mode){ std::cout << "debug: spill size is greater than size of data array!\n"; }
+		return false;
+	}
+
+	unsigned int paddedBytes = 4*((zBytes + 3)/4);
+	if(dry_run_mode){ file_->seekg(paddedBytes, std::ios::cur); }
+	else{
+#ifdef USE_ZLIB
+		if(zbuffer.size() < paddedBytes){ zbuffer.resize(paddedBytes); }
+		file_->read(zbuffer.data(), paddedBytes);
+		if(!file_->good()){ return false; }
+
+		uLongf destLen = nBytes;
+		if(uncompress((Bytef*)data_, &destLen, (const Bytef*)zbuffer.data(), zBytes) != Z_OK || destLen != nBytes){
+			if(debug_mode){ std::cout << "debug: failed to decompress spill block\n"; }
+			return false;
+		}
+#else
+		std::cout << "PLD_data: Unable to read compressed spill, zlib support was not compiled in!\n";
+		return false;
+#endif
+	}
+
+	unsigned int end_buff_check;
+	file_->read((char*)&end_buff_check, 4);
+	if(end_buff_check != buffend){ // Buffer was not terminated properly
+		if(debug_mode){ std::cout << "debug: buffer not terminated properly\n"; }
+		return false;
+	}
+
+	return true;
+}
+
+/// Return true if zlib support was compiled in.
+bool PLD_data::CompressionAvailable(){
+#ifdef USE_ZLIB
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// Toggle writing spills as compressed blocks. Returns false if zlib is unavailable.
+bool PLD_data::SetCompression(bool state_/*=true*/, int level_/*=1*/){
+	if(state_ && !CompressionAvailable()){ return false; }
+	compress = state_;
+	compression_level = level_;
+	return true;
 }
 
 /// Write a pld style data buffer to file.
 bool PLD_data::Write(std::ofstream *file_, char *data_, unsigned int nWords_){
 	if(!file_ || !file_->is_open() || !file_->good() || nWords_ == 0){ return false; }
 	
+	if(compress){
+#ifdef USE_ZLIB
+		// The block is laid out in zbuffer, with its 3 header words in front of the
+		// compressed data and the end of buffer word after it, and written at once.
+		uLongf zBytes = compressBound(4*nWords_);
+		if(zbuffer.size() < zBytes + 20){ zbuffer.resize(zBytes + 20); }
+		if(compress2((Bytef*)&zbuffer[12], &zBytes, (const Bytef*)data_, 4*nWords_, compression_level) != Z_OK){
+			if(debug_mode){ std::cout << "debug: failed to compress spill of " << nWords_ << " words\n"; }
+			return false;
+		}
+
+		if(debug_mode){ std::cout << "debug: writing spill of " << nWords_ << " words (" << zBytes << " compressed bytes)\n"; }
+
+		// Pad the compressed data to a whole number of words.
+		unsigned int paddedBytes = 4*((zBytes + 3)/4);
+		memset(&zbuffer[12 + zBytes], 0, paddedBytes - zBytes);
+
+		unsigned int blocktype = ZDATA;
+		unsigned int compressedBytes = zBytes;
+		memcpy(&zbuffer[0], (char*)&blocktype, 4);
+		memcpy(&zbuffer[4], (char*)&nWords_, 4);
+		memcpy(&zbuffer[8], (char*)&compressedBytes, 4);
+		memcpy(&zbuffer[12 + paddedBytes], (char*)&buffend, 4); // Close the buffer
+
+		file_->write(zbuffer.data(), paddedBytes + 16);
+
+		return file_->good();
+#else
+		return false;
+#endif
+	}
+
 	if(debug_mode){ std::cout << "debug: writing spill of " << nWords_ << " words\n"; }
 	
 	file_->write((char*)&bufftype, 4);
@@ -274,11 +476,31 @@ bool PLD_data::Write(std::ofstream *file_, char *data_, unsigned int nWords_){
 
 /// Read a pld style data buffer from file.
 bool PLD_data::Read(std::ifstream *file_, char *data_, unsigned int &nBytes, unsigned int max_bytes_, bool dry_run_mode/*=false*/){
+	return read_spill_(file_, data_, NULL, nBytes, max_bytes_, dry_run_mode);
+}
+
+/// Read a pld style data buffer from file into a spill buffer.
+bool PLD_data::Read(std::ifstream *file_, SpillBuffer &buffer_, unsigned int &nBytes, bool dry_run_mode/*=false*/){
+	return read_spill_(file_, NULL, &buffer_, nBytes, 0, dry_run_mode);
+}
+
+/// Read a pld style data buffer from file into data_ or buffer_.
+bool PLD_data::read_spill_(std::ifstream *file_, char *data_, SpillBuffer *buffer_, unsigned int &nBytes, unsigned int max_bytes_, bool dry_run_mode){
 	if(!file_ || !file_->is_open() || !file_->good()){ return false; }
 
 	unsigned int check_bufftype;	
 	file_->read((char*)&check_bufftype, 4);
-	if(check_bufftype != bufftype){ // Not a valid DATA buffer
+	if(check_bufftype == ZDATA){ // Compressed spill block
+		return read_block(file_, data_, buffer_, nBytes, max_bytes_, dry_run_mode);
+	}
+	else if(check_bufftype == ZINDEX){ // Skip the block index at the end of a compressed file
+		unsigned int numBlocks;
+		file_->read((char*)&numBlocks, 4);
+		file_->seekg(4*(3*numBlocks + 2), std::ios::cur);
+		if(debug_mode){ std::cout << "debug: skipped index of " << numBlocks << " compressed blocks\n"; }
+		return false;
+	}
+	else if(check_bufftype != bufftype){ // Not a valid DATA buffer
 		if(debug_mode){ std::cout << "debug: not a valid DATA buffer\n"; }
 
 		unsigned int countw = 0;
@@ -299,7 +521,7 @@ bool PLD_data::Read(std::ifstream *file_, char *data_, unsigned int &nBytes, uns
 	
 	if(debug_mode){ std::cout << "debug: reading spill of " << nBytes << " bytes\n"; }
 	
-	if(nBytes > max_bytes_){
+	if(!dry_run_mode && !fit_spill(data_, buffer_, nBytes, 0, max_bytes_)){
 		if(debug_mode){ std::cout << "debug: spill size is greater than size of data array!\n"; }
 		return false;
 	}
@@ -317,6 +539,75 @@ bool PLD_data::Read(std::ifstream *file_, char *data_, unsigned int &nBytes, uns
 	return true;
 }
 
+/// Write the block index of a compressed pld file.
+bool PLD_data::WriteIndex(std::ofstream *file_, const std::vector<Block> &blocks_){
+	if(!file_ || !file_->is_open() || !file_->good()){ return false; }
+
+	if(debug_mode){ std::cout << "debug: writing index of " << blocks_.size() << " compressed blocks\n"; }
+
+	unsigned int temp = ZINDEX;
+	unsigned int numBlocks = blocks_.size();
+	file_->write((char*)&temp, 4);
+	file_->write((char*)&numBlocks, 4);
+	for(std::vector<Block>::const_iterator iter = blocks_.begin(); iter != blocks_.end(); iter++){
+		temp = iter->offset & 0xFFFFFFFF;
+		file_->write((char*)&temp, 4);
+		temp = iter->offset >> 32;
+		file_->write((char*)&temp, 4);
+		file_->write((char*)&iter->nWords, 4);
+	}
+	file_->write((char*)&numBlocks, 4); // Repeated so the index may be found from the end of the file
+	file_->write((char*)&buffend, 4); // Close the buffer
+	
+	return file_->good();
+}
+
+/// Read the block index from the end of a compressed pld file.
+bool PLD_data::ReadIndex(std::ifstream *file_, std::vector<Block> &blocks_){
+	blocks_.clear();
+	if(!file_ || !file_->is_open()){ return false; }
+
+	std::streampos initial = file_->tellg();
+	file_->clear();
+
+	// The file ends with the index buffer followed by the EOF buffer (2 words).
+	file_->seekg(0, std::ios::end);
+	long long length = file_->tellg();
+
+	bool retval = false;
+	unsigned int numBlocks, temp;
+	if(length >= 24){
+		file_->seekg(length - 16);
+		file_->read((char*)&numBlocks, 4);
+		long long start = length - 16 - 4*(3*(long long)numBlocks + 2);
+		if(file_->good() && start >= 0){
+			file_->seekg(start);
+			file_->read((char*)&temp, 4);
+			if(temp == ZINDEX){
+				file_->read((char*)&temp, 4);
+				Block block;
+				for(unsigned int i = 0; i < numBlocks && file_->good(); i++){
+					file_->read((char*)&temp, 4);
+					block.offset = temp;
+					file_->read((char*)&temp, 4);
+					block.offset |= ((unsigned long long)temp << 32);
+					file_->read((char*)&block.nWords, 4);
+					blocks_.push_back(block);
+				}
+				retval = (file_->good() && blocks_.size() == numBlocks);
+			}
+		}
+	}
+
+	if(!retval){ blocks_.clear(); }
+	if(debug_mode){ std::cout << "debug: read index of " << blocks_.size() << " compressed blocks\n"; }
+
+	file_->clear();
+	file_->seekg(initial);
+
+	return retval;
+}
+
 /// Default constructor.
 DIR_buffer::DIR_buffer() : BufferType(DIR, NO_HEADER_SIZE){ // 0x20524944 "DIR "
 }
@@ -534,12 +825,37 @@ bool DATA_buffer::open_(std::ofstream *file_){
 	return true;
 }
 
+/// Load the next ldf buffer into storage_ or, for a memory mapped file, point ptr_ at it in the mapping.
+bool DATA_buffer::load_buffer_(unsigned int *storage_, const unsigned int *&ptr_, size_t &offset_){
+	if(!map_data){
+		offset_ = input->tellg()/4;
+		input->read((char *)storage_, ACTUAL_BUFF_SIZE*4);
+		ptr_ = storage_;
+		return input->good();
+	}
+	
+	if(*map_pos + ACTUAL_BUFF_SIZE > map_words){ // Not enough words left for a full buffer.
+		*map_pos = map_words;
+		map_eof = true;
+		return false;
+	}
+	
+	offset_ = *map_pos;
+	ptr_ = &map_data[*map_pos];
+	*map_pos += ACTUAL_BUFF_SIZE;
+	
+	return true;
+}
+
 /// 
-bool DATA_buffer::read_next_buffer(std::ifstream *f_, bool force_/*=false*/){
-	if(!f_ || !f_->good() || f_->eof()){ return false; }
+bool DATA_buffer::read_next_buffer(bool force_/*=false*/){
+	if(map_data){
+		if(map_eof){ return false; }
+	}
+	else if(!input || !input->good() || input->eof()){ return false; }
 
 	if(bcount == 0){
-		f_->read((char *)buffer1, ACTUAL_BUFF_SIZE*4);
+		load_buffer_(buffer1, next_buffer, next_offset);
 	}
 	else if(buff_pos + 3 <= ACTUAL_BUFF_SIZE-1 && !force_){
 		// Don't need to scan a new buffer yet. There are still
@@ -556,17 +872,11 @@ bool DATA_buffer::read_next_buffer(std::ifstream *f_, bool force_/*=false*/){
 		}
 	}
 	
-	// Read the buffer into memory.
-	if(bcount % 2 == 0){
-		f_->read((char *)buffer2, ACTUAL_BUFF_SIZE*4);
-		curr_buffer = buffer1;
-		next_buffer = buffer2;
-	}
-	else{
-		f_->read((char *)buffer1, ACTUAL_BUFF_SIZE*4);
-		curr_buffer = buffer2;
-		next_buffer = buffer1;
-	}
+	// Read the buffer into memory. The previously read buffer becomes the
+	// current buffer and the new one is kept as the next buffer.
+	curr_buffer = next_buffer;
+	curr_offset = next_offset;
+	bool loaded = load_buffer_((curr_buffer == buffer1 ? buffer2 : buffer1), next_buffer, next_offset);
 	
 	// Reset the buffer index.
 	buff_pos = 0;
@@ -578,18 +888,36 @@ bool DATA_buffer::read_next_buffer(std::ifstream *f_, bool force_/*=false*/){
 	buff_head = curr_buffer[buff_pos++];
 	buff_size = curr_buffer[buff_pos++];
 
-	if(!f_->good()){ return false; }
-	else if(f_->eof()){ retval = 2; }
+	// Resume reading part way through the first buffer after a seek.
+	if(start_pos > 0){
+		buff_pos = start_pos;
+		start_pos = 0;
+	}
+
+	if(!loaded){ return false; }
+	else if(!map_data && input->eof()){ retval = 2; }
 	
 	return true; 
 }
 
 /// Default constructor.
 DATA_buffer::DATA_buffer() : BufferType(DATA, NO_HEADER_SIZE){ // 0x41544144 "DATA"
+	curr_buffer = buffer1;
+	next_buffer = buffer2;
+	input = NULL;
+	map_data = NULL;
+	map_words = 0;
+	map_pos = NULL;
+	map_eof = false;
 	bcount = 0;
 	good_chunks = 0;
 	missing_chunks = 0;
 	buff_pos = 0;
+	start_pos = 0;
+	curr_offset = 0;
+	next_offset = 0;
+	spill_offset = 0;
+	spill_pos = 0;
 }
 
 /// Close a ldf data buffer by padding with 0xFFFFFFFF.
@@ -608,7 +936,28 @@ bool DATA_buffer::Close(std::ofstream *file_){
 	return true;
 }
 
-/// Write a ldf data buffer to disk.
+/// Add the header of a new ldf buffer to the spill image.
+void DATA_buffer::open_image_(){
+	if(debug_mode){ std::cout << "debug: writing 2 word DATA header\n"; }
+	image.push_back(bufftype); // write buffer header type
+	image.push_back(buffsize); // write buffer size
+	buff_pos = 2;
+}
+
+/// Pad the current ldf buffer of the spill image with 0xFFFFFFFF words.
+void DATA_buffer::close_image_(){
+	if(buff_pos < ACTUAL_BUFF_SIZE){
+		if(debug_mode)
+			std::cout << "debug: closing buffer with " << ACTUAL_BUFF_SIZE - buff_pos << " 0xFFFFFFFF words\n";
+		image.insert(image.end(), ACTUAL_BUFF_SIZE - buff_pos, buffend);
+	}
+	buff_pos = 0;
+}
+
+/** Write a ldf data spill to disk. The ldf buffers, spill chunk headers and spill
+  * footer are laid out in memory first, as they are in the file, and the whole
+  * spill is written at once, instead of with a write for every header word and
+  * every padding word. */
 bool DATA_buffer::Write(std::ofstream *file_, char *data_, unsigned int nWords_, int &buffs_written){
 	if(!file_ || !file_->is_open() || !file_->good() || !data_ || nWords_ == 0){ 
 		if(debug_mode){ std::cout << "debug: !file_ || !file_->is_open() || !data_ || nWords_ == 0\n"; }	
@@ -616,11 +965,12 @@ bool DATA_buffer::Write(std::ofstream *file_, char *data_, unsigned int nWords_,
 	}
 
 	buffs_written = 0;
+	image.clear();
 
 	// If this is a new buffer, write a buffer header.
 	// We are currently at the start of a new buffer. No need to close.
 	if(buff_pos == 0)
-		open_(file_);
+		open_image_();
 
 	unsigned int spillpos = 0;
 	unsigned int chunkPayload;
@@ -657,12 +1007,12 @@ bool DATA_buffer::Write(std::ofstream *file_, char *data_, unsigned int nWords_,
 	// Reset the spill position.
 	spillpos = 0;
 	
-	// Write the spill.
+	// Lay out the spill.
 	while(spillpos < nWords_){
 		if(buff_pos + 4 > LDF_DATA_LENGTH){
 			buffs_written++;
-			Close(file_);
-			open_(file_);
+			close_image_();
+			open_image_();
 		}
 		
 		if(nWords_ - spillpos + 4 > LDF_DATA_LENGTH - buff_pos)
@@ -676,11 +1026,13 @@ bool DATA_buffer::Write(std::ofstream *file_, char *data_, unsigned int nWords_,
 		if(debug_mode) 
 			std::cout << "debug: writing " << 1+chunkSizeB/4 << " word spill chunk " << currentNumChunk << " of " << totalNumChunks << ".\n";
 		
-		file_->write((char*)&chunkSizeB, 4);
-		file_->write((char*)&totalNumChunks, 4);
-		file_->write((char*)&currentNumChunk, 4);
-		file_->write((char*)arrptr, 4*chunkPayload);
-		file_->write((char*)&buffend, 4);
+		image.push_back(chunkSizeB);
+		image.push_back(totalNumChunks);
+		image.push_back(currentNumChunk);
+		size_t payloadStart = image.size();
+		image.resize(payloadStart + chunkPayload);
+		memcpy(&image[payloadStart], arrptr, 4*chunkPayload);
+		image.push_back(buffend);
 		
 		currentNumChunk++;
 		
@@ -692,8 +1044,8 @@ bool DATA_buffer::Write(std::ofstream *file_, char *data_, unsigned int nWords_,
 		
 		if(buff_pos >= LDF_DATA_LENGTH){
 			buffs_written++;
-			Close(file_);
-			open_(file_);
+			close_image_();
+			open_image_();
 		}
 	}
 
@@ -703,23 +1055,26 @@ bool DATA_buffer::Write(std::ofstream *file_, char *data_, unsigned int nWords_,
 	// Write the spill footer.
 	if(buff_pos + 6 > LDF_DATA_LENGTH){
 		buffs_written++;
-		open_(file_);
+		open_image_();
 	}
 	
 	if(debug_mode)
 		std::cout << "debug: writing final spill chunk " << currentNumChunk << " of " << 1+end_spill_size/4 << " words.\n";
 		
-	file_->write((char*)&end_spill_size, 4);
-	file_->write((char*)&totalNumChunks, 4);
-	file_->write((char*)&currentNumChunk, 4);
-	file_->write((char*)&pacman_word1, 4);
-	file_->write((char*)&pacman_word2, 4);
-	file_->write((char*)&buffend, 4);
+	image.push_back(end_spill_size);
+	image.push_back(totalNumChunks);
+	image.push_back(currentNumChunk);
+	image.push_back(pacman_word1);
+	image.push_back(pacman_word2);
+	image.push_back(buffend);
 
 	// Update the buffer position.
 	buff_pos += 6;
 
-	return true;
+	// Write the whole spill at once.
+	file_->write((char*)image.data(), 4*image.size());
+
+	return file_->good();
 }
 
 /// Read a ldf data spill from a file.
@@ -729,6 +1084,73 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 		return false; 
 	}
 	
+	input = file_;
+	map_data = NULL;
+	
+	return read_spill_(data_, NULL, NULL, nBytes, max_bytes_, full_spill, bad_spill, dry_run_mode);
+}
+
+/// Read a ldf data spill from a memory mapped file.
+bool DATA_buffer::Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, char *data_, unsigned int &nBytes, unsigned int max_bytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode/*=false*/){
+	if(!map_){ 
+		retval = 6;
+		return false; 
+	}
+	
+	input = NULL;
+	map_data = map_;
+	map_words = mapWords_;
+	map_pos = &pos_;
+	
+	return read_spill_(data_, NULL, NULL, nBytes, max_bytes_, full_spill, bad_spill, dry_run_mode);
+}
+
+/// Read a ldf data spill from a file into a spill buffer.
+bool DATA_buffer::Read(std::ifstream *file_, SpillBuffer &buffer_, unsigned int &nBytes, bool &full_spill, bool &bad_spill, bool dry_run_mode/*=false*/){
+	if(!file_ || !file_->is_open() || !file_->good()){ 
+		retval = 6;
+		return false; 
+	}
+	
+	input = file_;
+	map_data = NULL;
+	
+	return read_spill_(NULL, &buffer_, NULL, nBytes, 0, full_spill, bad_spill, dry_run_mode);
+}
+
+/// Read a ldf data spill from a memory mapped file into a spill buffer.
+bool DATA_buffer::Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, SpillBuffer &buffer_, unsigned int &nBytes, bool &full_spill, bool &bad_spill, bool dry_run_mode/*=false*/){
+	if(!map_){ 
+		retval = 6;
+		return false; 
+	}
+	
+	input = NULL;
+	map_data = map_;
+	map_words = mapWords_;
+	map_pos = &pos_;
+	
+	return read_spill_(NULL, &buffer_, NULL, nBytes, 0, full_spill, bad_spill, dry_run_mode);
+}
+
+/// Read a ldf data spill from a memory mapped file as a list of spans into the mapping.
+bool DATA_buffer::Read(const unsigned int *map_, const size_t &mapWords_, size_t &pos_, std::vector<SpillSpan> &spans_, unsigned int &nBytes, bool &full_spill, bool &bad_spill){
+	spans_.clear();
+	if(!map_){ 
+		retval = 6;
+		return false; 
+	}
+	
+	input = NULL;
+	map_data = map_;
+	map_words = mapWords_;
+	map_pos = &pos_;
+	
+	return read_spill_(NULL, NULL, &spans_, nBytes, 0, full_spill, bad_spill, false);
+}
+
+/// Read a ldf data spill from the current input (file or memory map).
+bool DATA_buffer::read_spill_(char *data_, SpillBuffer *buffer_, std::vector<SpillSpan> *spans_, unsigned int &nBytes, unsigned int max_bytes_, bool &full_spill, bool &bad_spill, bool dry_run_mode){
 	bad_spill = false;
 
 	bool first_chunk = true;
@@ -740,7 +1162,7 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 	nBytes = 0; // Set the number of output bytes to zero
 
 	while(true){
-		if(!read_next_buffer(file_)){ 
+		if(!read_next_buffer()){ 
 			if(debug_mode){ std::cout << "debug: failed to read from input data file\n"; }
 			retval = 6;
 			return false;
@@ -758,6 +1180,9 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 			
 			// Check if this is a spill fragment.
 			if(first_chunk){ // Check for starting read in middle of spill.
+				spill_offset = curr_offset;
+				spill_pos = buff_pos - 3;
+
 				if(current_chunk_num != 0){
 					if(debug_mode){ std::cout << "debug: starting read in middle of spill (chunk " << current_chunk_num << " of " << total_num_chunks << ")\n"; }		
 					
@@ -773,7 +1198,7 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 				if(debug_mode){ std::cout << "debug: skipped to new spill with " << total_num_chunks << " spill chunks without reading footer of old spill\n"; }
 				
 				// We are likely out of position in the spill. Scrap this current buffer and skip to the next one.
-				read_next_buffer(file_, true);
+				read_next_buffer(true);
 				
 				// Update the number of dropped chunks.
 				missing_chunks += (prev_num_chunks-1) - prev_chunk_num;
@@ -789,7 +1214,7 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 				full_spill = false;
 				
 				// We are likely out of position in the spill. Scrap this current buffer and skip to the next one.
-				read_next_buffer(file_, true);
+				read_next_buffer(true);
 				
 				// Update the number of dropped chunks.
 				missing_chunks += (current_chunk_num-1) - prev_chunk_num;
@@ -804,7 +1229,7 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 					if(debug_mode){ std::cout << "debug: spill footer (chunk " << current_chunk_num << " of " << total_num_chunks << ") has size " << this_chunk_sizeB << " != 5\n"; }
 					
 					// We are likely out of position in the spill. Scrap this current buffer and skip to the next one.
-					read_next_buffer(file_, true);
+					read_next_buffer(true);
 					
 					// Update the number of dropped chunks.
 					//missing_chunks += 1;
@@ -818,7 +1243,15 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 				}
 			
 				// Copy data into the output array.
-				if(!dry_run_mode){ memcpy(&data_[nBytes], &curr_buffer[buff_pos], 8); }
+				if(spans_){ spans_->push_back(SpillSpan(&curr_buffer[buff_pos], 2)); }
+				else if(!dry_run_mode){
+					if(!fit_spill(data_, buffer_, nBytes + 8, nBytes, max_bytes_)){
+						if(debug_mode){ std::cout << "debug: spill size is greater than size of data array!\n"; }
+						retval = 7;
+						return false;
+					}
+					memcpy(&data_[nBytes], &curr_buffer[buff_pos], 8);
+				}
 				if(debug_mode){ std::cout << "debug: spill footer words are " << curr_buffer[buff_pos] << " and " << curr_buffer[buff_pos+1] << std::endl; }
 				nBytes += 8;
 				buff_pos += 2;
@@ -842,7 +1275,15 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 				good_chunks++;
 			
 				copied_bytes = this_chunk_sizeB - 12;
-				if(!dry_run_mode){ memcpy(&data_[nBytes], &curr_buffer[buff_pos], copied_bytes); }
+				if(spans_){ spans_->push_back(SpillSpan(&curr_buffer[buff_pos], copied_bytes/4)); }
+				else if(!dry_run_mode){
+					if(!fit_spill(data_, buffer_, nBytes + copied_bytes, nBytes, max_bytes_)){
+						if(debug_mode){ std::cout << "debug: spill size is greater than size of data array!\n"; }
+						retval = 7;
+						return false;
+					}
+					memcpy(&data_[nBytes], &curr_buffer[buff_pos], copied_bytes);
+				}
 				nBytes += copied_bytes;
 				buff_pos += copied_bytes/4;
 			}
@@ -856,7 +1297,7 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 				if(debug_mode){ std::cout << "debug: encountered EOF buffer marking end of run\n"; }
 				
 				// We need to skip this buffer.
-				read_next_buffer(file_, true);
+				read_next_buffer(true);
 				
 				retval = 1;
 			}
@@ -871,7 +1312,7 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 			// This is not a data buffer. We need to force a scan of the next buffer.
 			// read_next_buffer will not scan the next buffer by default because it
 			// thinks there are still words left in this buffer to read.
-			read_next_buffer(file_, true);
+			read_next_buffer(true);
 			
 			retval = 3;
 			continue;
@@ -881,13 +1322,26 @@ bool DATA_buffer::Read(std::ifstream *file_, char *data_, unsigned int &nBytes,
 	return false;
 }
 
+/// Discard buffered data so the next read starts at word pos_ of the buffer at the current input position.
+void DATA_buffer::SetStartPosition(const unsigned int &pos_){
+	curr_buffer = buffer1;
+	next_buffer = buffer2;
+	buff_pos = 0;
+	bcount = 0;
+	retval = 0;
+	map_eof = false;
+	start_pos = pos_;
+}
+
 /// Set initial values.
 void DATA_buffer::Reset(){
 	curr_buffer = buffer1;
 	next_buffer = buffer2;
 	buff_pos = 0;
+	start_pos = 0;
 	bcount = 0;
 	retval = 0;
+	map_eof = false;
 	good_chunks = 0;
 	missing_chunks = 0;
 }
@@ -942,6 +1396,7 @@ std::string PollOutputFile::get_filename(){
 	
 	if(output_format == 0){ output += ".ldf"; }
 	else if(output_format == 1){ output += ".pld"; }
+	else if(output_format == 3){ output += ".pldz"; }
 	else{ output += ".root"; } // PLACEHOLDER!!!
 	return output;
 }
@@ -993,18 +1448,18 @@ bool PollOutputFile::get_full_filename(std::string &output){
   * Returns false if no output file is open or if the number of 4 byte words in the file is not 
   * evenly divisible by the number of words in a buffer.
   */
-bool PollOutputFile::overwrite_dir(int total_buffers_/*=-1*/){
-	if(!output_file.is_open() || !output_file.good()){ return false; }
+bool PollOutputFile::overwrite_dir(std::ofstream &file_, int total_buffers_/*=-1*/){
+	if(!file_.is_open() || !file_.good()){ return false; }
 	
 	// Set the buffer count in the "DIR " buffer
 	if(total_buffers_ == -1){ // Set with the internal buffer count
-		unsigned int size = output_file.tellp(); // Get the length of the file (in bytes)
-		output_file.seekp(12); // Set position to just after the third word
+		unsigned int size = file_.tellp(); // Get the length of the file (in bytes)
+		file_.seekp(12); // Set position to just after the third word
 	
 		// Calculate the number of buffers in this file
 		unsigned int total_num_buffer = size / (4 * ACTUAL_BUFF_SIZE);
 		unsigned int overflow = size % (4 * ACTUAL_BUFF_SIZE);
-		output_file.write((char*)&total_num_buffer, 4); 
+		file_.write((char*)&total_num_buffer, 4); 
 		
 		if(debug_mode){ 
 			std::cout << "debug: file size is " << size << " bytes (" << size/4 << " 4 byte words)\n";
@@ -1014,22 +1469,61 @@ bool PollOutputFile::overwrite_dir(int total_buffers_/*=-1*/){
 		}
 		
 		if(overflow != 0){ 
-			output_file.close();
+			file_.close();
 			return false; 
 		}
 	} 
 	else{ // Set with an external buffer count
-		output_file.write((char*)&total_buffers_, 4); 
+		file_.write((char*)&total_buffers_, 4); 
 		if(debug_mode){ std::cout << "debug: set .ldf directory buffer number to " << total_buffers_ << std::endl; }	
 	}
 	
-	output_file.close();
+	file_.close();
 	return true;
 }
 
+/** Write the EOF buffers, the block index and the final header of a file and close it. This
+  * only touches the file and header it is given, so it may finish a rolled over file in the
+  * background while spills are written to the next file.
+  */
+void PollOutputFile::finish_file(std::ofstream &file_, unsigned int format_, PLD_header &head_, const std::vector<PLD_data::Block> &index_){
+	if(!file_.is_open() || !file_.good()){ return; }
+	
+	if(format_ == 0){
+		eofBuff.Write(&file_); // First EOF buffer signals end of run
+		eofBuff.Write(&file_); // Second EOF buffer signals physical end of file
+	
+		overwrite_dir(file_); // Overwrite the total buffer number word and close the file
+	}
+	else if(format_ == 1 || format_ == 3){
+		// Compressed files get an index of the spill blocks before the EOF buffer
+		if(format_ == 3){ pldData.WriteIndex(&file_, index_); }
+
+		unsigned int temp = ENDFILE; // Write an EOF buffer
+		file_.write((char*)&temp, 4);
+		
+		temp = ENDBUFF; // Signal the end of the file
+		file_.write((char*)&temp, 4);
+		
+		// Overwrite the blank pld header at the beginning of the file and close it
+		file_.seekp(0);
+		head_.Write(&file_);
+		file_.close();
+	}
+	else if(debug_mode){ std::cout << "debug: invalid output format for PollOutputFile::CloseFile!\n"; }
+}
+
+/// Close and delete the continuation file, if one was opened.
+void PollOutputFile::discard_next_file(){
+	if(!next_file.is_open()){ return; }
+	next_file.close();
+	unlink(next_filename.c_str());
+	next_filename = "";
+}
+
 /// Initialize the output file with initial parameters
 void PollOutputFile::initialize(){
-	max_spill_size = -9999;
+	max_spill_size = 0;
 	current_file_num = 0; 
 	output_format = 0;
 	number_spills = 0;
@@ -1084,8 +1578,13 @@ void PollOutputFile::SetDebugMode(bool debug_/*=true*/){
 
 /// Set the output file data format.
 bool PollOutputFile::SetFileFormat(unsigned int format_){
-	if(format_ <= 2){
+	if(format_ == 3 && !PLD_data::CompressionAvailable()){ 
+		if(debug_mode){ std::cout << "debug: compressed pld output requires zlib support!\n"; }
+		return false; 
+	}
+	if(format_ <= 3){
 		output_format = format_;
+		pldData.SetCompression(output_format == 3);
 		return true;
 	}
 	return false;
@@ -1110,7 +1609,13 @@ int PollOutputFile::Write(char *data_, unsigned int nWords_){
 	if(output_format == 0){
 		if(!dataBuff.Write(&output_file, data_, nWords_, buffs_written)){ return -1; }
 	}
-	else if(output_format == 1){
+	else if(output_format == 1 || output_format == 3){
+		if(output_format == 3){
+			PLD_data::Block block;
+			block.offset = output_file.tellp();
+			block.nWords = nWords_;
+			blockIndex.push_back(block);
+		}
 		if(!pldData.Write(&output_file, data_, nWords_)){ return -1; }
 		buffs_written = 1;
 	}
@@ -1197,6 +1702,7 @@ bool PollOutputFile::OpenNewFile(std::string title_, unsigned int &run_num_, std
 
 	// Restart the spill counter for the new file
 	number_spills = 0;
+	max_spill_size = 0;
 
 	std::string filename = GetNextFileName(run_num_,prefix,output_directory,continueRun);
 	output_file.open(filename.c_str(), std::ios::binary);
@@ -1217,7 +1723,10 @@ bool PollOutputFile::OpenNewFile(std::string title_, unsigned int &run_num_, std
 		headBuff.SetRunNumber(run_num_);
 		headBuff.Write(&output_file); // Every .ldf file gets a HEAD file header
 	}
-	else if(output_format == 1){
+	else if(output_format == 1 || output_format == 3){
+		blockIndex.clear();
+
+		pldHead.SetFormat(output_format == 3 ? "PIXIE LIST ZLIB " : "PIXIE LIST DATA ");
 		pldHead.SetTitle(title_);
 		pldHead.SetRunNumber(run_num_);
 		pldHead.SetStartDateTime();
@@ -1238,6 +1747,81 @@ bool PollOutputFile::OpenNewFile(std::string title_, unsigned int &run_num_, std
 	return true;
 }
 
+/// Open the next continuation file of the run ahead of a rollover.
+bool PollOutputFile::PrepareNextFile(unsigned int run_num_, std::string prefix, std::string output_directory/*="./"*/){
+	if(next_file.is_open()){ return true; }
+
+	std::string filename = GetNextFileName(run_num_, prefix, output_directory, true);
+	next_file.open(filename.c_str(), std::ios::binary);
+	if(!next_file.is_open() || !next_file.good()){
+		next_file.close();
+		return false;
+	}
+	next_filename = filename;
+
+	// The DIR buffer is written now. The ldf HEAD buffer carries the time the file
+	// is switched to, so it is written by Rollover.
+	if(output_format == 0){
+		dirBuff.SetRunNumber(run_num_);
+		dirBuff.Write(&next_file);
+	}
+	else if(output_format == 1 || output_format == 3){
+		// Write a blank header for now and overwrite it later
+		unsigned int temp = 0;
+		for(unsigned int i = 0; i < pldHead.GetBufferLength()/4; i++){
+			next_file.write((char*)&temp, 4);
+		}
+		temp = -1;
+		next_file.write((char*)&temp, 4); // Close the buffer
+	}
+	else{
+		discard_next_file();
+		return false;
+	}
+
+	return next_file.good();
+}
+
+/// Switch to the continuation file, finishing the current file in the background.
+bool PollOutputFile::Rollover(std::string title_, unsigned int run_num_){
+	if(!next_file.is_open()){ return false; }
+
+	// Only one file is finished at a time. It had the whole length of a file to do so.
+	if(finisher.joinable()){ finisher.join(); }
+
+	// The last data buffer belongs to this file, so it is closed before switching.
+	if(output_format == 0){ dataBuff.Close(&output_file); }
+	
+	pldHead.SetEndDateTime();
+	pldHead.SetRunTime(0.0);
+	pldHead.SetMaxSpillSize(max_spill_size);
+	closing_head = pldHead;
+	closing_index.swap(blockIndex);
+	blockIndex.clear();
+
+	closing_file = std::move(output_file);
+	output_file = std::move(next_file);
+	finisher = std::thread(&PollOutputFile::finish_file, this, std::ref(closing_file), output_format, std::ref(closing_head), std::cref(closing_index));
+
+	// Restart the spill counter for the new file
+	number_spills = 0;
+	max_spill_size = 0;
+
+	current_filename = next_filename;
+	get_full_filename(current_full_filename);
+	next_filename = "";
+
+	if(output_format == 0){
+		headBuff.SetTitle(title_);
+		headBuff.SetDateTime();
+		headBuff.SetRunNumber(run_num_);
+		headBuff.Write(&output_file); // Every .ldf file gets a HEAD file header
+	}
+	else{ pldHead.SetStartDateTime(); }
+
+	return output_file.good();
+}
+
 /// Return the filename of the next output file.
 std::string PollOutputFile::GetNextFileName(unsigned int &run_num_, std::string prefix, std::string output_directory, bool continueRun /*=false*/) {
 	std::stringstream filename;
@@ -1245,6 +1829,7 @@ std::string PollOutputFile::GetNextFileName(unsigned int &run_num_, std::string
 
 	if(output_format == 0){ filename << ".ldf"; }
 	else if(output_format == 1){ filename << ".pld"; }
+	else if(output_format == 3){ filename << ".pldz"; }
 	
 	std::ifstream dummy_file(filename.str().c_str());
 	unsigned int suffix = 0;
@@ -1257,6 +1842,7 @@ std::string PollOutputFile::GetNextFileName(unsigned int &run_num_, std::string
 		
 		if(output_format == 0){ filename << ".ldf"; }
 		else if(output_format == 1){ filename << ".pld"; }
+		else if(output_format == 3){ filename << ".pldz"; }
 		
 		dummy_file.open(filename.str().c_str());
 	}
@@ -1266,30 +1852,16 @@ std::string PollOutputFile::GetNextFileName(unsigned int &run_num_, std::string
 
 /// Write the footer and close the file.
 void PollOutputFile::CloseFile(float total_run_time_/*=0.0*/){
+	// Wait for a rolled over file to be finished and drop an unused continuation file.
+	if(finisher.joinable()){ finisher.join(); }
+	discard_next_file();
+
 	if(!output_file.is_open() || !output_file.good()){ return; }
 	
-	if(output_format == 0){
-		dataBuff.Close(&output_file); // Pad the final data buffer with 0xFFFFFFFF
-	
-		eofBuff.Write(&output_file); // First EOF buffer signals end of run
-		eofBuff.Write(&output_file); // Second EOF buffer signals physical end of file
+	if(output_format == 0){ dataBuff.Close(&output_file); } // Pad the final data buffer with 0xFFFFFFFF
 	
-		overwrite_dir(); // Overwrite the total buffer number word and close the file
-	}
-	else if(output_format == 1){
-		unsigned int temp = ENDFILE; // Write an EOF buffer
-		output_file.write((char*)&temp, 4);
-		
-		temp = ENDBUFF; // Signal the end of the file
-		output_file.write((char*)&temp, 4);
-		
-		// Overwrite the blank pld header at the beginning of the file and close it
-		output_file.seekp(0);
-		pldHead.SetEndDateTime();
-		pldHead.SetRunTime(total_run_time_);
-		pldHead.SetMaxSpillSize(max_spill_size);
-		pldHead.Write(&output_file);
-		output_file.close();
-	}
-	else if(debug_mode){ std::cout << "debug: invalid output format for PollOutputFile::CloseFile!\n"; }
+	pldHead.SetEndDateTime();
+	pldHead.SetRunTime(total_run_time_);
+	pldHead.SetMaxSpillSize(max_spill_size);
+	finish_file(output_file, output_format, pldHead, blockIndex);
 }
@@ -0,0 +1,126 @@
+/** \file poll2_log.cpp
+  *
+  * \brief Rate limited logging of anomalies found in the readout and scan loops
+  *
+  * The counters of a site and the ring index are atomics, so hitting a site
+  * never takes a lock. Records of different threads may interleave in the
+  * ring, and a record being overwritten while the ring is read may be torn;
+  * the ring is a diagnostic of what happened last, not a complete log.
+*/
+
+#include "poll2_log.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+#define POLL2_LOG_MAGIC 0x474F4C50 // "PLOG"
+
+namespace {
+	// The registry is only locked when a site is constructed or listed.
+	std::mutex &registry_mutex(){
+		static std::mutex mtx;
+		return mtx;
+	}
+
+	std::vector<LogSite*> &registry(){
+		static std::vector<LogSite*> sites;
+		return sites;
+	}
+
+	LogRecord ring[POLL2_LOG_RING_SIZE];
+	std::atomic<uint64_t> ringHead(0);
+
+	// Nanoseconds since the first call.
+	int64_t now_ns(){
+		static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+LogSite::LogSite(const char *name_, unsigned int burst_/*=POLL2_LOG_BURST*/, double interval_/*=POLL2_LOG_INTERVAL*/) :
+	name(name_), burst(burst_), interval((int64_t)(interval_ * 1E9)), count(0), suppressed(0), nextPrint(0)
+{
+	std::lock_guard<std::mutex> lock(registry_mutex());
+	index = registry().size();
+	registry().push_back(this);
+}
+
+bool LogSite::Hit(uint32_t a_/*=0*/, uint32_t b_/*=0*/){
+	uint64_t seq = count.fetch_add(1, std::memory_order_relaxed);
+	int64_t now = now_ns();
+
+	LogRecord &rec = ring[ringHead.fetch_add(1, std::memory_order_relaxed) & (POLL2_LOG_RING_SIZE - 1)];
+	rec.time = now;
+	rec.site = index;
+	rec.seq = (uint32_t)seq;
+	rec.a = a_;
+	rec.b = b_;
+
+	// The burst is printed in full and pushes the first rate limited print one interval out.
+	if(seq < burst){
+		nextPrint.store(now + interval, std::memory_order_relaxed);
+		return true;
+	}
+
+	int64_t next = nextPrint.load(std::memory_order_relaxed);
+	if(now >= next && nextPrint.compare_exchange_strong(next, now + interval, std::memory_order_relaxed)){ return true; }
+
+	suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+std::string LogSite::Suppressed(){
+	uint64_t n = suppressed.exchange(0, std::memory_order_relaxed);
+	if(n == 0){ return ""; }
+	return " [" + std::to_string(n) + " similar suppressed]";
+}
+
+const LogSite *LogSite::GetSite(uint32_t index_){
+	std::lock_guard<std::mutex> lock(registry_mutex());
+	return (index_ < registry().size() ? registry()[index_] : NULL);
+}
+
+size_t LogSite::PrintSummary(std::ostream &out_, const std::string &prefix_/*=""*/){
+	std::lock_guard<std::mutex> lock(registry_mutex());
+	size_t numHit = 0;
+	for(std::vector<LogSite*>::iterator iter = registry().begin(); iter != registry().end(); iter++){
+		uint64_t n = (*iter)->GetCount();
+		if(n == 0){ continue; }
+		out_ << prefix_ << (*iter)->GetName() << ": " << n << " occurrence" << (n == 1 ? "" : "s") << "\n";
+		numHit++;
+	}
+	return numHit;
+}
+
+size_t LogSite::ReadRing(std::vector<LogRecord> &records_){
+	uint64_t head = ringHead.load(std::memory_order_acquire);
+	uint64_t first = (head > POLL2_LOG_RING_SIZE ? head - POLL2_LOG_RING_SIZE : 0);
+
+	records_.clear();
+	records_.reserve(head - first);
+	for(uint64_t i = first; i < head; i++)
+		records_.push_back(ring[i & (POLL2_LOG_RING_SIZE - 1)]);
+
+	return records_.size();
+}
+
+bool LogSite::WriteRing(const char *fname_){
+	std::ofstream file(fname_, std::ios::binary);
+	if(!file.good()){ return false; }
+
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex());
+		for(std::vector<LogSite*>::iterator iter = registry().begin(); iter != registry().end(); iter++)
+			file << (*iter)->GetName() << "\n";
+		file << "\n";
+	}
+
+	std::vector<LogRecord> records;
+	uint32_t header[2] = {POLL2_LOG_MAGIC, (uint32_t)ReadRing(records)};
+	file.write((const char*)header, sizeof(header));
+	if(!records.empty())
+		file.write((const char*)records.data(), records.size() * sizeof(LogRecord));
+
+	return file.good();
+}
@@ -0,0 +1,209 @@
+/** \file poll2_shm.cpp
+  *
+  * \brief Shares data spills between poll2 and scanners on the same host
+  *
+  * This file contains a ring of spill slots held in POSIX shared memory. The
+  * ring is created and written by poll2. Any number of scan programs on the
+  * same host may map it read-only and follow the spills at their own pace.
+  * Each slot is guarded by its sequence number, which the writer clears before
+  * overwriting the slot and sets once the spill is complete. A reader checks
+  * the sequence number before and after copying a spill out, and drops the
+  * spill if it changed in between.
+*/
+
+#include "poll2_shm.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define POLL2_SHM_MAGIC 0x504F4C32 // "POL2"
+
+// Round a size up to a multiple of 64 bytes, keeping each slot on its own cache lines.
+#define SHM_ALIGN(size) (((size) + 63) & ~((size_t)63))
+
+SpillShm::SpillShm() : header(NULL), mapSize(0), slotBytes(0), writer(false), next(0), dropped(0) { }
+
+bool SpillShm::Create(const char *name_, unsigned int nSlots_, unsigned int slotWords_){
+	if(header || nSlots_ == 0 || slotWords_ == 0){ return false; }
+
+	name = name_;
+	slotBytes = SHM_ALIGN(sizeof(SlotHeader) + slotWords_ * sizeof(word_t));
+	mapSize = SHM_ALIGN(sizeof(Header)) + nSlots_ * slotBytes;
+
+	// Replace any ring left behind by a previous writer. Readers still mapping
+	// the old ring see that it was closed, or that its writer is gone.
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(fd < 0){ return false; }
+
+	if(ftruncate(fd, mapSize) != 0){
+		close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	void *ptr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ptr == MAP_FAILED){
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	// The new object is zero filled, so every slot starts out empty.
+	header = (Header *)ptr;
+	header->nSlots = nSlots_;
+	header->slotWords = slotWords_;
+	header->pid = getpid();
+	header->head.store(0, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = POLL2_SHM_MAGIC;
+
+	writer = true;
+	next = 0;
+	dropped = 0;
+
+	return true;
+}
+
+bool SpillShm::Open(const char *name_){
+	if(header){ return false; }
+
+	int fd = shm_open(name_, O_RDONLY, 0);
+	if(fd < 0){ return false; }
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header)){
+		close(fd);
+		return false;
+	}
+
+	void *ptr = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ptr == MAP_FAILED){ return false; }
+
+	// Check that the ring has been set up and is as large as it claims to be.
+	Header *ring = (Header *)ptr;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	size_t ringSlotBytes = SHM_ALIGN(sizeof(SlotHeader) + ring->slotWords * sizeof(word_t));
+	if(ring->magic != POLL2_SHM_MAGIC || ring->nSlots == 0 || SHM_ALIGN(sizeof(Header)) + ring->nSlots * ringSlotBytes > (size_t)info.st_size){
+		munmap(ptr, info.st_size);
+		return false;
+	}
+
+	name = name_;
+	header = ring;
+	mapSize = info.st_size;
+	slotBytes = ringSlotBytes;
+	writer = false;
+	next = header->head.load(std::memory_order_acquire);
+	dropped = 0;
+
+	return true;
+}
+
+bool SpillShm::Write(const word_t *data_, unsigned int nWords_){
+	if(!header || !writer){ return false; }
+	if(nWords_ > header->slotWords){
+		dropped++;
+		return false;
+	}
+
+	const uint64_t seq = header->head.load(std::memory_order_relaxed);
+	SlotHeader *slot = get_slot(seq);
+
+	// Mark the slot as being written before touching the spill data.
+	slot->seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	memcpy((char *)slot + sizeof(SlotHeader), data_, nWords_ * sizeof(word_t));
+	slot->nWords = nWords_;
+
+	slot->seq.store(seq+1, std::memory_order_release);
+	header->head.store(seq+1, std::memory_order_release);
+
+	return true;
+}
+
+int SpillShm::Read(word_t *data_, unsigned int maxWords_){
+	if(!header || writer){ return -1; }
+
+	while(true){
+		const uint64_t current = header->head.load(std::memory_order_acquire);
+		if(next >= current){
+			// No new spill. Check that the writer is still there.
+			if(header->closed.load(std::memory_order_acquire) || (kill(header->pid, 0) != 0 && errno == ESRCH)){ return -1; }
+			return 0;
+		}
+
+		// Skip ahead to the oldest spill still in the ring.
+		if(current - next > header->nSlots){
+			dropped += (current - header->nSlots) - next;
+			next = current - header->nSlots;
+		}
+
+		SlotHeader *slot = get_slot(next);
+		const uint64_t seq = next++;
+
+		if(slot->seq.load(std::memory_order_acquire) != seq+1){ // Already being overwritten
+			dropped++;
+			continue;
+		}
+
+		unsigned int nWords = slot->nWords;
+		if(nWords > maxWords_ || nWords > header->slotWords){ // Does not fit, or is being overwritten
+			dropped++;
+			continue;
+		}
+		memcpy(data_, (char *)slot + sizeof(SlotHeader), nWords * sizeof(word_t));
+
+		// The spill is only good if the writer did not start to overwrite it while it was copied.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(slot->seq.load(std::memory_order_relaxed) != seq+1){
+			dropped++;
+			continue;
+		}
+
+		return nWords;
+	}
+}
+
+void SpillShm::Close(){
+	if(!header){ return; }
+
+	if(writer){
+		header->closed.store(1, std::memory_order_release);
+		shm_unlink(name.c_str());
+	}
+
+	munmap((void *)header, mapSize);
+	header = NULL;
+	writer = false;
+}
+
+unsigned int SpillShm::GetSlotWords(){
+	return (header ? header->slotWords : 0);
+}
+
+unsigned long long SpillShm::GetWritten(){
+	return (header ? header->head.load(std::memory_order_acquire) : 0);
+}
+
+unsigned int SpillShm::GetBacklog(){
+	if(!header){ return 0; }
+
+	uint64_t head = header->head.load(std::memory_order_acquire);
+	if(head <= next){ return 0; }
+	return (unsigned int)std::min<uint64_t>(head - next, header->nSlots);
+}
+
+SpillShm::SlotHeader *SpillShm::get_slot(const uint64_t &seq_){
+	return (SlotHeader *)((char *)header + SHM_ALIGN(sizeof(Header)) + (seq_ % header->nSlots) * slotBytes);
+}
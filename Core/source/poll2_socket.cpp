@@ -20,6 +20,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <stdio.h>
@@ -27,6 +28,7 @@
 #include <unistd.h>
 #include <strings.h>
 #include <string.h>
+#include <vector>
 
 /////////////////////////////////////////////////////////////////////
 // class Server
@@ -70,12 +72,62 @@ int Server::RecvMessage(char *message_, size_t length_){
 	return nbytes;
 }
 
+/**
+ *	\param[out] messages_ Array of count_ * length_ bytes to store the messages in.
+ *	\param[in] length_ The maximum length of each message, in bytes.
+ *	\param[out] lengths_ Array of count_ ints to store the length of each message in.
+ *	\param[in] count_ The maximum number of messages to receive.
+ *	\return The number of messages received, or -1 on failure.
+ */
+int Server::RecvMessages(char *messages_, size_t length_, int *lengths_, unsigned int count_){
+	if(!init){ return -1; }
+	if(count_ > POLL2_SOCKET_BATCH){ count_ = POLL2_SOCKET_BATCH; }
+
+	struct mmsghdr msgs[POLL2_SOCKET_BATCH];
+	struct iovec iov[POLL2_SOCKET_BATCH];
+	bzero(msgs, count_ * sizeof(struct mmsghdr));
+	for(unsigned int i = 0; i < count_; i++){
+		iov[i].iov_base = &messages_[i * length_];
+		iov[i].iov_len = length_;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	if(count_ > 0){
+		msgs[0].msg_hdr.msg_name = &from;
+		msgs[0].msg_hdr.msg_namelen = fromlen;
+	}
+
+	int nmsgs = recvmmsg(sock, msgs, count_, MSG_WAITFORONE, NULL);
+	for(int i = 0; i < nmsgs; i++){ lengths_[i] = (int)msgs[i].msg_len; }
+
+	return nmsgs;
+}
+
 int Server::SendMessage(char *message_, size_t length_){
 	if(!init){ return -1; }
 
 	return (int)sendto(sock, message_, length_, 0, (struct sockaddr *)&from, fromlen);
 }
 
+bool Server::SetBufferSize(int bytes_){
+	if(!init){ return false; }
+
+	return (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bytes_, sizeof(bytes_)) == 0);
+}
+
+int Server::GetBufferSize(){
+	int bytes = 0;
+	socklen_t length = sizeof(bytes);
+	if(!init || getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bytes, &length) != 0){ return 0; }
+	return bytes;
+}
+
+int Server::GetQueued(){
+	int bytes = 0;
+	if(!init || ioctl(sock, FIONREAD, &bytes) != 0){ return 0; }
+	return bytes;
+}
+
 bool Server::Select(int &retval){
 	timeout.tv_sec = to_sec; // Set timeout to sec_
 	timeout.tv_usec = to_usec;
@@ -132,6 +184,78 @@ int Client::SendMessage(char *message_, size_t length_){
 	return (int)sendto(sock, message_, length_, 0, (const struct sockaddr *)&serv, length);
 }
 
+/**
+ *	\param[in] iov_ Array of count_ * iovPerMsg_ blocks making up the messages.
+ *	\param[in] iovPerMsg_ The number of blocks in each message.
+ *	\param[in] count_ The number of messages to send.
+ *	\return The number of messages sent, or -1 on failure.
+ */
+int Client::SendMessages(struct iovec *iov_, unsigned int iovPerMsg_, unsigned int count_){
+	if(!init){ return -1; }
+
+	std::vector<struct mmsghdr> msgs(count_);
+	for(unsigned int i = 0; i < count_; i++){
+		bzero(&msgs[i], sizeof(struct mmsghdr));
+		msgs[i].msg_hdr.msg_name = &serv;
+		msgs[i].msg_hdr.msg_namelen = length;
+		msgs[i].msg_hdr.msg_iov = &iov_[i * iovPerMsg_];
+		msgs[i].msg_hdr.msg_iovlen = iovPerMsg_;
+	}
+
+	// The kernel may send fewer messages than requested, so keep going until all are gone.
+	unsigned int nsent = 0;
+	while(nsent < count_){
+		unsigned int batch = count_ - nsent;
+		if(batch > POLL2_SOCKET_BATCH){ batch = POLL2_SOCKET_BATCH; }
+
+		int retval = sendmmsg(sock, &msgs[nsent], batch, 0);
+		if(retval <= 0){ return (nsent > 0 ? (int)nsent : -1); }
+		nsent += retval;
+	}
+
+	return (int)nsent;
+}
+
+int Client::SendSpill(const unsigned int *data_, unsigned int nWords_){
+	if(!init){ return -1; }
+
+	unsigned int numChunks = nWords_ / POLL2_SOCKET_CHUNK;
+	if(nWords_ % POLL2_SOCKET_CHUNK != 0){ numChunks++; }
+
+	// Each chunk is gathered from its header and its block of the spill.
+	spillHeaders.resize(2 * numChunks);
+	spillIov.resize(2 * numChunks);
+
+	unsigned int wordsSent = 0;
+	for(unsigned int chunk = 0; chunk < numChunks; chunk++){
+		unsigned int chunkWords = nWords_ - wordsSent;
+		if(chunkWords > POLL2_SOCKET_CHUNK){ chunkWords = POLL2_SOCKET_CHUNK; }
+		spillHeaders[2 * chunk] = chunk + 1;
+		spillHeaders[2 * chunk + 1] = numChunks;
+		spillIov[2 * chunk].iov_base = &spillHeaders[2 * chunk];
+		spillIov[2 * chunk].iov_len = 2 * sizeof(unsigned int);
+		spillIov[2 * chunk + 1].iov_base = (void*)&data_[wordsSent];
+		spillIov[2 * chunk + 1].iov_len = chunkWords * sizeof(unsigned int);
+		wordsSent += chunkWords;
+	}
+
+	for(unsigned int chunk = 0; chunk < numChunks; chunk += POLL2_SOCKET_BATCH){
+		unsigned int batch = numChunks - chunk;
+		if(batch > POLL2_SOCKET_BATCH){ batch = POLL2_SOCKET_BATCH; }
+		int retval = SendMessages(&spillIov[2 * chunk], 2, batch);
+		if(retval < (int)batch){ return chunk + (retval > 0 ? retval : 0); }
+		if(chunk + batch < numChunks){ usleep(1); }
+	}
+
+	return (int)numChunks;
+}
+
+bool Client::SetBufferSize(int bytes_){
+	if(!init){ return false; }
+
+	return (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &bytes_, sizeof(bytes_)) == 0);
+}
+
 void Client::Close(){
 	if(!init){ return; }
 
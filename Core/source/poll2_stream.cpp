@@ -0,0 +1,376 @@
+/** \file poll2_stream.cpp
+  *
+  * \brief Streams data spills from poll2 to remote scanners over TCP
+  *
+  * This file contains classes used to send whole spills from poll2 to any
+  * number of subscribers over TCP. The StreamServer is run by poll2 and never
+  * waits on a subscriber. Each subscriber has its own bounded queue, and a
+  * subscriber which falls behind drops whole spills rather than slowing down
+  * the others. The StreamClient is used by the scan programs to subscribe.
+*/
+
+#include "poll2_stream.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#define STREAM_HEADER_WORDS 4 // Words in each frame header
+#define STREAM_REQUEST_WORDS 3 // Words in each subscription
+
+/////////////////////////////////////////////////////////////////////
+// class StreamServer
+/////////////////////////////////////////////////////////////////////
+
+StreamServer::StreamServer() : listenSock(-1), maxQueued(POLL2_STREAM_QUEUE), running(false), sequence(0), dropped(0), skipped(0) {
+	wakePipe[0] = -1;
+	wakePipe[1] = -1;
+}
+
+bool StreamServer::Init(int port_, size_t maxQueued_/*=POLL2_STREAM_QUEUE*/){
+	if(running){ return false; }
+
+	listenSock = socket(AF_INET, SOCK_STREAM, 0);
+	if(listenSock < 0){ return false; } // failed to open socket
+
+	int reuse = 1;
+	setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in serv;
+	bzero(&serv, sizeof(serv));
+	serv.sin_family = AF_INET;
+	serv.sin_addr.s_addr = INADDR_ANY;
+	serv.sin_port = htons(port_);
+
+	if(bind(listenSock, (struct sockaddr *)&serv, sizeof(serv)) < 0 || listen(listenSock, 8) < 0 || pipe(wakePipe) < 0){ // failed to bind to port
+		close(listenSock);
+		listenSock = -1;
+		return false;
+	}
+
+	// Neither end may ever block the server thread.
+	fcntl(listenSock, F_SETFL, O_NONBLOCK);
+	fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+	maxQueued = maxQueued_;
+	sequence = 0;
+	dropped = 0;
+	skipped = 0;
+	running = true;
+	serverThread = std::thread(&StreamServer::serve, this);
+
+	return true;
+}
+
+void StreamServer::Send(const word_t *data_, unsigned int nWords_){
+	if(!running || nWords_ == 0){ return; }
+
+	const unsigned long long seq = sequence++;
+
+	std::lock_guard<std::mutex> lock(subscriberMutex);
+	if(subscribers.empty()){ return; }
+
+	const time_point now = std::chrono::steady_clock::now();
+	const size_t nBytes = (STREAM_HEADER_WORDS + nWords_) * sizeof(word_t);
+
+	// The spill is copied once, when the first subscriber wants it, and shared by every queue.
+	Frame frame;
+	frame.header[0] = POLL2_STREAM_MAGIC;
+	frame.header[1] = (word_t)seq;
+	frame.header[2] = nWords_;
+
+	bool queued = false;
+	for(std::vector<Subscriber>::iterator iter = subscribers.begin(); iter != subscribers.end(); iter++){
+		if(!wants(*iter, nBytes, now)){ // Not part of the subscription
+			iter->skipped++;
+			skipped++;
+			continue;
+		}
+		if(iter->queuedBytes + nBytes > maxQueued){ // This subscriber is too far behind
+			dropped++;
+			continue;
+		}
+		if(!frame.spill){ frame.spill = FramePtr(new std::vector<char>((const char *)data_, (const char *)(data_ + nWords_))); }
+		frame.header[3] = iter->skipped;
+		iter->skipped = 0;
+		iter->queue.push_back(frame);
+		iter->queuedBytes += nBytes;
+		queued = true;
+	}
+
+	if(queued){
+		char wake = 0;
+		if(write(wakePipe[1], &wake, 1) < 0){ } // The pipe is only full if the thread is already awake
+	}
+}
+
+void StreamServer::Close(){
+	if(!running){ return; }
+
+	running = false;
+	char wake = 0;
+	if(write(wakePipe[1], &wake, 1) < 0){ }
+	serverThread.join();
+
+	for(std::vector<Subscriber>::iterator iter = subscribers.begin(); iter != subscribers.end(); iter++){
+		close(iter->sock);
+	}
+	subscribers.clear();
+
+	close(listenSock);
+	close(wakePipe[0]);
+	close(wakePipe[1]);
+	listenSock = -1;
+	wakePipe[0] = -1;
+	wakePipe[1] = -1;
+}
+
+size_t StreamServer::GetNumClients(){
+	std::lock_guard<std::mutex> lock(subscriberMutex);
+	return subscribers.size();
+}
+
+void StreamServer::serve(){
+	std::vector<struct pollfd> fds;
+	while(running){
+		{
+			std::lock_guard<std::mutex> lock(subscriberMutex);
+			fds.resize(2 + subscribers.size());
+			for(size_t i = 0; i < subscribers.size(); i++){
+				fds[2+i].fd = subscribers[i].sock;
+				fds[2+i].events = POLLIN | (subscribers[i].queue.empty() ? 0 : POLLOUT);
+				fds[2+i].revents = 0;
+			}
+		}
+		fds[0].fd = listenSock;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = wakePipe[0];
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+
+		if(poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR){ break; }
+
+		// Empty the wake up pipe.
+		if(fds[1].revents & POLLIN){
+			char buffer[64];
+			while(read(wakePipe[0], buffer, sizeof(buffer)) > 0){ }
+		}
+
+		std::lock_guard<std::mutex> lock(subscriberMutex);
+
+		// Read any subscriptions, then send what each subscriber will take.
+		std::vector<Subscriber>::iterator iter = subscribers.begin();
+		for(size_t i = 2; i < fds.size() && iter != subscribers.end(); i++){
+			bool good = true;
+			if(fds[i].revents & (POLLIN | POLLHUP | POLLERR)){ good = read_request(*iter); }
+			if(good && !iter->queue.empty()){ good = send_queued(*iter); }
+
+			if(!good){
+				dropped += iter->queue.size();
+				close(iter->sock);
+				iter = subscribers.erase(iter);
+			}
+			else{ iter++; }
+		}
+
+		// Accept new subscribers. They receive spills from the next one queued.
+		if(fds[0].revents & POLLIN){
+			int sock;
+			while((sock = accept(listenSock, NULL, NULL)) >= 0){
+				fcntl(sock, F_SETFL, O_NONBLOCK);
+				subscribers.push_back(Subscriber(sock));
+			}
+		}
+	}
+}
+
+bool StreamServer::send_queued(Subscriber &sub_){
+	while(!sub_.queue.empty()){
+		const Frame &frame = sub_.queue.front();
+
+		// Send the rest of the header and the spill together.
+		struct iovec iov[2];
+		int niov = 0;
+		if(sub_.offset < sizeof(frame.header)){
+			iov[niov].iov_base = (char *)frame.header + sub_.offset;
+			iov[niov++].iov_len = sizeof(frame.header) - sub_.offset;
+			iov[niov].iov_base = (char *)frame.spill->data();
+			iov[niov++].iov_len = frame.spill->size();
+		}
+		else{
+			iov[niov].iov_base = (char *)frame.spill->data() + (sub_.offset - sizeof(frame.header));
+			iov[niov++].iov_len = frame.size() - sub_.offset;
+		}
+
+		struct msghdr msg;
+		bzero(&msg, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = niov;
+
+		ssize_t nbytes = sendmsg(sub_.sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(nbytes < 0){ return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR); }
+
+		sub_.offset += nbytes;
+		if(sub_.offset < frame.size()){ return true; } // The socket buffer is full
+
+		sub_.queuedBytes -= frame.size();
+		sub_.offset = 0;
+		sub_.queue.pop_front();
+	}
+	return true;
+}
+
+bool StreamServer::read_request(Subscriber &sub_){
+	char buffer[64];
+	ssize_t nbytes = recv(sub_.sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+	if(nbytes == 0){ return false; } // The subscriber closed the connection
+	else if(nbytes < 0){ return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR); }
+
+	sub_.request.insert(sub_.request.end(), buffer, buffer + nbytes);
+	while(sub_.request.size() >= STREAM_REQUEST_WORDS * sizeof(word_t)){
+		word_t request[STREAM_REQUEST_WORDS];
+		memcpy(request, sub_.request.data(), sizeof(request));
+		sub_.request.erase(sub_.request.begin(), sub_.request.begin() + sizeof(request));
+		if(request[0] != POLL2_STREAM_SUBSCRIBE){ return false; } // Not a poll2 subscriber
+
+		sub_.every = (request[1] > 0 ? request[1] : 1);
+		sub_.maxRate = request[2];
+		sub_.credit = 0;
+		sub_.lastSend = std::chrono::steady_clock::now();
+		sub_.offered = 0;
+	}
+
+	return true;
+}
+
+bool StreamServer::wants(Subscriber &sub_, const size_t &nBytes_, const time_point &now_){
+	if(sub_.every > 1 && (sub_.offered++ % sub_.every) != 0){ return false; }
+	if(sub_.maxRate <= 0){ return true; }
+
+	// The rate limit lets up to one second (or one spill) of data through in a burst.
+	sub_.credit += sub_.maxRate * std::chrono::duration<double>(now_ - sub_.lastSend).count();
+	sub_.lastSend = now_;
+	if(sub_.credit > sub_.maxRate && sub_.credit > nBytes_){ sub_.credit = std::max(sub_.maxRate, (double)nBytes_); }
+	if(sub_.credit < nBytes_){ return false; }
+
+	sub_.credit -= nBytes_;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+// class StreamClient
+/////////////////////////////////////////////////////////////////////
+
+bool StreamClient::Init(const char *address_, int port_/*=POLL2_STREAM_PORT*/){
+	if(sock >= 0){ return false; }
+
+	struct hostent *hp = gethostbyname(address_);
+	if(!hp){ return false; } // failed to resolve hostname
+
+	struct sockaddr_in serv;
+	bzero(&serv, sizeof(serv));
+	serv.sin_family = AF_INET;
+	bcopy((char *)hp->h_addr, (char *)&serv.sin_addr, hp->h_length);
+	serv.sin_port = htons(port_);
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if(sock < 0){ return false; } // failed to open socket
+
+	if(connect(sock, (struct sockaddr *)&serv, sizeof(serv)) < 0){
+		Close();
+		return false;
+	}
+
+	next = 0;
+	dropped = 0;
+	skipped = 0;
+	received = 0;
+
+	return true;
+}
+
+bool StreamClient::Subscribe(unsigned int every_, double maxRate_/*=0*/){
+	if(sock < 0){ return false; }
+
+	word_t request[STREAM_REQUEST_WORDS];
+	request[0] = POLL2_STREAM_SUBSCRIBE;
+	request[1] = every_;
+	request[2] = (maxRate_ > 0 ? (word_t)std::min(maxRate_ * 1E6, 4E9) : 0);
+
+	return (send(sock, request, sizeof(request), MSG_NOSIGNAL) == (ssize_t)sizeof(request));
+}
+
+int StreamClient::Read(std::vector<word_t> &data_, int timeout_){
+	if(sock < 0){ return -1; }
+
+	struct pollfd fd;
+	fd.fd = sock;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	int retval = poll(&fd, 1, timeout_);
+	if(retval == 0 || (retval < 0 && errno == EINTR)){ return 0; }
+	else if(retval < 0){ return -1; }
+
+	// Once a frame has started to arrive, read all of it.
+	word_t header[STREAM_HEADER_WORDS];
+	if(!read_all((char *)header, sizeof(header)) || header[0] != POLL2_STREAM_MAGIC){ return -1; }
+	if(data_.size() < header[2]){ data_.resize(header[2]); }
+	if(!read_all((char *)data_.data(), header[2] * sizeof(word_t))){ return -1; }
+
+	// Gaps in the sequence which were not skipped by the subscription are
+	// spills poll2 dropped because this subscriber fell behind.
+	if(received > 0){
+		word_t gap = header[1] - (word_t)next;
+		skipped += header[3];
+		if(gap > header[3]){ dropped += gap - header[3]; }
+	}
+	next = (word_t)(header[1] + 1);
+	received++;
+
+	return (int)header[2];
+}
+
+int StreamClient::GetBufferSize(){
+	int bytes = 0;
+	socklen_t length = sizeof(bytes);
+	if(sock < 0 || getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bytes, &length) != 0){ return 0; }
+	return bytes;
+}
+
+int StreamClient::GetQueued(){
+	int bytes = 0;
+	if(sock < 0 || ioctl(sock, FIONREAD, &bytes) != 0){ return 0; }
+	return bytes;
+}
+
+void StreamClient::Close(){
+	if(sock < 0){ return; }
+
+	close(sock);
+	sock = -1;
+}
+
+bool StreamClient::read_all(char *buffer_, size_t length_){
+	while(length_ > 0){
+		ssize_t nbytes = recv(sock, buffer_, length_, 0);
+		if(nbytes < 0 && errno == EINTR){ continue; }
+		else if(nbytes <= 0){ return false; }
+		buffer_ += nbytes;
+		length_ -= nbytes;
+	}
+	return true;
+}
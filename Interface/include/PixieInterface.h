@@ -35,10 +35,12 @@
 #endif
 
 #include <fstream>
+#include <functional>
+#include <iostream>
 #include <map>
-#include <queue>
 #include <string>
 #include <set>
+#include <vector>
 
 #include <stdint.h>
 
@@ -65,6 +67,18 @@ class PixieInterface
   typedef uint16_t halfword_t;
 
   typedef word_t stats_t[STAT_SIZE];
+
+  /// A channel parameter to be written as part of a batch (see WriteChanPars)
+  struct ChanPar {
+    std::string name; ///< Name of the channel parameter
+    int chan;         ///< Channel to write
+    double val;       ///< Value to write
+    double prev;      ///< Value before the write, filled by WriteChanPars
+    bool written;     ///< True if the value differed and was written
+    bool failed;      ///< True if the parameter could not be read or written
+
+    ChanPar(const std::string &n, int c, double v) : name(n), chan(c), val(v), prev(0), written(false), failed(false) {};
+  };
   class Histogram {
   public: 
       enum ErrorTypes {NO_ERROR, ERROR_SUBTRACT, ERROR_READ, ERROR_WRITE};
@@ -98,19 +112,29 @@ class PixieInterface
   bool WriteSglModPar(const char *name, word_t val, int mod);
   bool WriteSglModPar(const char *name, word_t val, int mod, word_t &pval);
   bool ReadSglModPar(const char *name, word_t &val, int mod);
-  void PrintSglModPar(const char *name, int mod);
-  void PrintSglModPar(const char *name, int mod, word_t prev);
+  void PrintSglModPar(const char *name, int mod, std::ostream &out = std::cout);
+  void PrintSglModPar(const char *name, int mod, word_t prev, std::ostream &out = std::cout);
   bool WriteSglChanPar(const char *name, double val, int mod, int chan);
   bool WriteSglChanPar(const char *name, double val, int mod, int chan, double &pval);
+  // write a batch of channel parameters to one module, skipping unchanged values
+  bool WriteChanPars(int mod, std::vector<ChanPar> &pars);
+  // write a batch of channel parameters to each module, concurrently if enabled
+  bool WriteChanPars(std::vector< std::vector<ChanPar> > &pars);
   bool ReadSglChanPar(const char *name, double &val, int mod, int chan);
-  void PrintSglChanPar(const char *name, int mod, int chan);
-  void PrintSglChanPar(const char *name, int mod, int chan, double prev);
+  void PrintSglChanPar(const char *name, int mod, int chan, std::ostream &out = std::cout);
+  void PrintSglChanPar(const char *name, int mod, int chan, double prev, std::ostream &out = std::cout);
   bool SaveDSPParameters(const char *fn = NULL);
   bool AcquireTraces(int mod);
   // # AcquireTraces must be called before calling this #
   bool ReadSglChanTrace(unsigned short *buf, unsigned long sz,
 			unsigned short mod, unsigned short chan);
   // # #
+  // acquire traces and read every channel of module mod into buf, channel after channel,
+  //   or if mod < 0 of every module (module after module, concurrently if enabled)
+  bool AcquireAllTraces(unsigned short *buf, unsigned long sz, int mod = -1);
+  // baseline (mean of the first tenth) and maximum above baseline of nTraces traces, split over threads
+  static void AnalyzeTraces(const unsigned short *traces, size_t nTraces, unsigned long sz,
+			    float *baseline, float *maximum);
   bool GetStatistics(unsigned short mod);
   // # GetStatistics must be called before calling these #
   stats_t& GetStatisticsData(void) {return statistics;}
@@ -119,6 +143,15 @@ class PixieInterface
   double GetLiveTime(int mod, int chan);
   double GetRealTime(int mod);
   double GetProcessedEvents(int mod);
+  // read the statistics of every module, module by module in stats (STAT_SIZE words each), concurrently if enabled
+  bool ReadStatistics(word_t *stats);
+  // read the statistics of module mod alone into stats (STAT_SIZE words)
+  bool ReadStatistics(word_t *stats, unsigned short mod);
+  // compute from the statistics of module mod read by ReadStatistics (stats points to that module's block)
+  double GetInputCountRate(word_t *stats, int mod, int chan);
+  double GetOutputCountRate(word_t *stats, int mod, int chan);
+  double GetLiveTime(word_t *stats, int mod, int chan);
+  double GetRealTime(word_t *stats, int mod);
 	bool GetModuleInfo(unsigned short mod, unsigned short *rev, unsigned int *serNum, unsigned short *adcBits, unsigned short *adcMsps); 
   // # #
   bool StartHistogramRun(unsigned short mode = NEW_RUN);
@@ -142,7 +175,21 @@ class PixieInterface
 
   bool ReadHistogram(word_t *hist, unsigned long sz,
 		     unsigned short mod, unsigned short ch);
+  // read the histograms of every channel of every module, module by module in hist, concurrently if enabled
+  bool ReadHistograms(word_t *hist, unsigned long sz);
   bool AdjustOffsets(unsigned short mod);
+  bool AdjustOffsets(void); // adjust offsets in all modules, concurrently if enabled
+  // find the decay constant (in us) of every channel of every module, concurrently if enabled
+  bool FindTau(std::vector< std::vector<double> > &taus);
+
+  /** Run per-module operations (boot, offset adjustment, batched parameter
+    *  writes and histogram readout) in one thread per module. Each module has its own device handle
+    *  in the XIA API, so operations on different modules may overlap. */
+  void SetParallelModules(bool parallel = true) {parallelModules = parallel;};
+  bool GetParallelModules(void) const {return parallelModules;};
+  typedef std::function<int(unsigned short)> ModuleTask;
+  // run task for every module, concurrently if enabled, and store its return code, false if any failed
+  bool ForEachModule(ModuleTask task, std::vector<int> &results);
   // accessors
   unsigned short GetNumberCards(void) const {return numberCards;};
   static size_t GetNumberChannels(void) {return NUMBER_OF_CHANNELS;};
@@ -171,6 +218,11 @@ class PixieInterface
  private:
   bool ToggleChannelBit(int mod, int chan, const char *parameter, int bit);
 
+  // print the status of each module after a ForEachModule, true if any failed
+  bool CheckModuleErrors(const std::string &leader, const std::vector<int> &results, bool exitOnError = false) const;
+  // write a batch of channel parameters without printing, returns the number of failures
+  int WriteChanParBatch(int mod, std::vector<ChanPar> &pars) const;
+
   static const size_t MAX_MODULES = 14;
   static const size_t CONFIG_LINE_LENGTH = 80;
   static const size_t TRACE_LENGTH = RANDOMINDICES_LENGTH;
@@ -193,13 +245,23 @@ class PixieInterface
   unsigned short slotMap[MAX_MODULES];
   unsigned short firmwareConfig[MAX_MODULES];
   bool hasAlternativeConfig;
+  bool parallelModules;
 
   stats_t statistics;
 
   int retval; // return value from pixie functions
   Lock lock;  // class to prevent simultaneous access to pixies
 
-  std::queue<word_t> extraWords[MAX_MODULES];
+  /// Words read from a module FIFO beyond those requested, returned first by the next read.
+  /// Like the partial event carry of Poll, the words are a pointer into the storage and a length.
+  struct CarryWords {
+    word_t words[2 * MIN_FIFO_READ]; ///< Storage, at most MIN_FIFO_READ-1 carried words plus one minimum read
+    word_t *data;                    ///< The first carried word
+    size_t nWords;                   ///< Number of carried words, 0 if there are none
+
+    CarryWords() : data(words), nWords(0) {};
+  };
+  CarryWords extraWords[MAX_MODULES];
 
   // temporary variables which hold the parameter which is being modified
   //   to deal with the const-incorrectness of the Pixie-16 API
@@ -1,10 +1,13 @@
 #ifndef PIXIE_SUPPORT_H
 #define PIXIE_SUPPORT_H
 
+#include <iostream>
 #include <vector>
 #include <string>
 #include <sstream>
 #include <bitset>
+#include <map>
+#include <tuple>
 
 #include "PixieInterface.h"
 
@@ -16,8 +19,9 @@ struct PixieFunctionParms{
 	unsigned int mod;
 	unsigned int ch;
 	T par;
+	std::ostream *out; /// Where the function prints, a buffer of its module when run by forChannelParallel or forModuleParallel.
   
-	PixieFunctionParms(PixieInterface *p, T x) : pif(p) {par=x;}
+	PixieFunctionParms(PixieInterface *p, T x) : pif(p), out(&std::cout) {par=x;}
 };
 
 template<typename T=int>
@@ -82,6 +86,62 @@ bool forModule(PixieInterface *pif, int mod, PixieFunction<T> &f, T par)
 	return !hadError;
 }
 
+/** Run f as forChannel does, but with each module in its own thread when the modules are
+  * run in parallel (see PixieInterface::SetParallelModules). The channels of a module are
+  * run in order by its thread. As f is called for several modules at once it must only
+  * use the module it is given, and print to par.out. The output of each module is kept
+  * and printed module after module once every module is done, as forChannel would print it.
+  */
+template<typename T>
+bool forChannelParallel(PixieInterface *pif, int mod, int ch, PixieFunction<T> &f, T par){
+	if(mod >= 0 || !pif->GetParallelModules()){ return forChannel(pif, mod, ch, f, par); }
+
+	std::vector<std::stringstream> output(pif->GetNumberCards());
+	std::vector<int> results;
+	bool okay = pif->ForEachModule([&](unsigned short module){
+		PixieFunctionParms<T> parms(pif, par);
+		parms.mod = module;
+		parms.out = &output[module];
+
+		bool hadError = false;
+		if(ch < 0){
+			for(parms.ch = 0; parms.ch < pif->GetNumberChannels(); parms.ch++){
+				if(!f(parms)){ hadError = true; }
+			}
+		}
+		else{
+			parms.ch = ch;
+			hadError = !f(parms);
+		}
+		return (hadError ? -1 : 0);
+	}, results);
+
+	for(size_t module = 0; module < output.size(); module++){ std::cout << output[module].str(); }
+
+	return okay;
+}
+
+/** Run f as forModule does, but with each module in its own thread when the modules are
+  * run in parallel. f must follow the rules of forChannelParallel.
+  */
+template<typename T>
+bool forModuleParallel(PixieInterface *pif, int mod, PixieFunction<T> &f, T par){
+	if(mod >= 0 || !pif->GetParallelModules()){ return forModule(pif, mod, f, par); }
+
+	std::vector<std::stringstream> output(pif->GetNumberCards());
+	std::vector<int> results;
+	bool okay = pif->ForEachModule([&](unsigned short module){
+		PixieFunctionParms<T> parms(pif, par);
+		parms.mod = module;
+		parms.out = &output[module];
+		return (f(parms) ? 0 : -1);
+	}, results);
+
+	for(size_t module = 0; module < output.size(); module++){ std::cout << output[module].str(); }
+
+	return okay;
+}
+
 std::string PadStr(const std::string &input_, int width_);
 
 template<typename T>
@@ -210,4 +270,65 @@ class TauFinder : public PixieFunction<int>{
 	bool operator()(PixieFunctionParms<int> &par);
 };
 
+/** A copy of the channel and module parameters of the crate, held in memory so that
+  * a target set of parameters can be compared against it and only the parameters
+  * which differ are written. Snapshots are stored using the format of the poll2
+  * dump command, i.e. "mod ch name value" for channel parameters and "mod name value"
+  * for module parameters.
+  */
+class ParameterSnapshot{
+  public:
+	const static std::vector<std::string> chan_names; /// Channel parameters read into a snapshot.
+	const static std::vector<std::string> mod_names; /// Module parameters read into a snapshot.
+
+	/// Read all parameters of a module, or of every module if mod_ < 0, from the crate.
+	bool Read(PixieInterface *pif_, int mod_=-1);
+
+	/// Load a snapshot from a parameter dump file.
+	bool Load(const std::string &fname_);
+
+	/// Write the snapshot to a parameter dump file.
+	bool Save(const std::string &fname_) const;
+
+	/** Find the parameters which have to change to turn this snapshot into target_.
+	  * Parameters missing from either snapshot are not compared. 
+	  * \param[in]  target_ The desired parameters.
+	  * \param[out] changes_ The parameters of target_ which differ from this snapshot.
+	  * 
+eturn The number of parameters which differ.
+	  */
+	size_t Diff(const ParameterSnapshot &target_, ParameterSnapshot &changes_) const;
+
+	/// Write every parameter of the snapshot to the crate, batching the channel parameters of each module.
+	bool Apply(PixieInterface *pif_) const;
+
+	/// Print every parameter of the snapshot, along with its value in before_ if present.
+	void Print(const ParameterSnapshot *before_=NULL) const;
+
+	/// Set the value of a channel parameter.
+	void SetChannel(int mod_, int ch_, const std::string &name_, double value_){ chan_values[std::make_tuple(mod_, ch_, name_)] = value_; }
+
+	/// Set the value of a module parameter.
+	void SetModule(int mod_, const std::string &name_, unsigned int value_){ mod_values[std::make_pair(mod_, name_)] = value_; }
+
+	/// Get the value of a channel parameter. Returns false if it is not in the snapshot.
+	bool GetChannel(int mod_, int ch_, const std::string &name_, double &value_) const;
+
+	/// Get the value of a module parameter. Returns false if it is not in the snapshot.
+	bool GetModule(int mod_, const std::string &name_, unsigned int &value_) const;
+
+	/// Return the number of parameters in the snapshot.
+	size_t Size() const { return chan_values.size() + mod_values.size(); }
+
+	/// Remove all parameters from the snapshot.
+	void Clear(){ chan_values.clear(); mod_values.clear(); }
+
+  private:
+	typedef std::tuple<int, int, std::string> ChanKey;
+	typedef std::pair<int, std::string> ModKey;
+
+	std::map<ChanKey, double> chan_values; /// Channel parameters by module, channel and name.
+	std::map<ModKey, unsigned int> mod_values; /// Module parameters by module and name.
+};
+
 #endif
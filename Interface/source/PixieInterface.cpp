@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -5,6 +6,7 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <thread>
 
 #include <sys/time.h>
 
@@ -96,7 +98,7 @@ bool PixieInterface::Histogram::Write(ofstream &out)
     return true;
 }
 
-PixieInterface::PixieInterface(const char *fn) : hasAlternativeConfig(false), lock("PixieInterface")
+PixieInterface::PixieInterface(const char *fn) : hasAlternativeConfig(false), parallelModules(false), lock("PixieInterface")
 {
 	SetColorTerm();
 	// Set-up valid configuration keys if they don't exist yet
@@ -268,32 +270,29 @@ bool PixieInterface::Boot(int mode, bool useWorkingSetFile)
 
 	bool goodBoot = true;
 
-	if (hasAlternativeConfig) {
+	if (hasAlternativeConfig || parallelModules) {
 		// must proceed through boot module by module
-		cout << InfoStr("[MULTICONFIG]") << "\n";
-		for (int i=0; i < numberCards; i++) {
-			if (firmwareConfig[i] == 1) {
-				// use the Alt... files
-				retval = Pixie16BootModule(&configStrings["AltComFpgaFile"][0],
-						&configStrings["AltSpFpgaFile"][0],
-						&configStrings["AltTrigFpgaFile"][0],
-						&configStrings["AltDspConfFile"][0],
-						&setFile[0],
-						&configStrings["AltDspVarFile"][0],
-						i, mode);
-			} else {
-				// use the standard files
-				retval = Pixie16BootModule(&configStrings["ComFpgaFile"][0], 
-						&configStrings["SpFpgaFile"][0], 
-						&configStrings["TrigFpgaFile"][0],
-						&configStrings["DspConfFile"][0], 
-						&setFile[0],
-						&configStrings["DspVarFile"][0],
-						i, mode);
-			}
-			LeaderPrint("Booting Pixie Module ");
-			goodBoot = (goodBoot && !CheckError(true));
-		}
+		if (hasAlternativeConfig) cout << InfoStr("[MULTICONFIG]") << "\n";
+		else cout << InfoStr("[PARALLEL]") << "\n";
+
+		// look up the file names here, the map may not be used by the boot threads
+		char *files[2][5] = {
+			{&configStrings["ComFpgaFile"][0], &configStrings["SpFpgaFile"][0],
+			 &configStrings["TrigFpgaFile"][0], &configStrings["DspConfFile"][0],
+			 &configStrings["DspVarFile"][0]},
+			{&configStrings["AltComFpgaFile"][0], &configStrings["AltSpFpgaFile"][0],
+			 &configStrings["AltTrigFpgaFile"][0], &configStrings["AltDspConfFile"][0],
+			 &configStrings["AltDspVarFile"][0]}
+		};
+		char *setName = &setFile[0];
+
+		std::vector<int> results;
+		ForEachModule([&](unsigned short i) {
+			// use the Alt... files for the alternative firmware configuration
+			char **f = files[(hasAlternativeConfig && firmwareConfig[i] == 1) ? 1 : 0];
+			return Pixie16BootModule(f[0], f[1], f[2], f[3], setName, f[4], i, mode);
+		}, results);
+		goodBoot = !CheckModuleErrors("Booting Pixie Module ", results, true);
 	} else {
 		// boot all at once
 		retval = Pixie16BootModule(&configStrings["ComFpgaFile"][0], 
@@ -343,11 +342,13 @@ bool PixieInterface::WriteSglModPar(const char *name, word_t val, int mod)
 
 bool PixieInterface::WriteSglModPar(const char *name, word_t val, int mod, word_t &pval)
 {
-  strncpy(tmpName, name, nameSize);
+  // private copy of the name, so that modules may be set up from several threads
+  char parName[nameSize];
+  strncpy(parName, name, nameSize);
+  parName[nameSize - 1] = '\0';
 
-  Pixie16ReadSglModPar(tmpName, &pval, mod);
-  retval = Pixie16WriteSglModPar(tmpName, val, mod);
-  if (retval < 0) {
+  Pixie16ReadSglModPar(parName, &pval, mod);
+  if (Pixie16WriteSglModPar(parName, val, mod) < 0) {
     cout << "Error writing module parameter " << WarningStr(name) << " for module " << mod << endl;
     return false;      
   }
@@ -356,37 +357,34 @@ bool PixieInterface::WriteSglModPar(const char *name, word_t val, int mod, word_
 
 bool PixieInterface::ReadSglModPar(const char *name, word_t &val, int mod)
 {
-  strncpy(tmpName, name, nameSize);
+  char parName[nameSize];
+  strncpy(parName, name, nameSize);
+  parName[nameSize - 1] = '\0';
 
-  retval = Pixie16ReadSglModPar(tmpName, &val, mod);
-  if (retval < 0) {
+  if (Pixie16ReadSglModPar(parName, &val, mod) < 0) {
     cout << "Error reading module parameter " << WarningStr(name) << " for module " << mod << endl;
     return false;      
   }
   return true;
 }
 
-void PixieInterface::PrintSglModPar(const char *name, int mod)
+void PixieInterface::PrintSglModPar(const char *name, int mod, std::ostream &out)
 {
   word_t val;
 
-  strncpy(tmpName, name, nameSize);
-
-  if (ReadSglModPar(tmpName, val, mod)) {    
-	cout.unsetf(ios_base::floatfield);
-    cout << "  MOD " << setw(2) << mod << "  " << setw(15) << name << "  " << setprecision(6) << val << endl;
+  if (ReadSglModPar(name, val, mod)) {    
+	out.unsetf(ios_base::floatfield);
+    out << "  MOD " << setw(2) << mod << "  " << setw(15) << name << "  " << setprecision(6) << val << endl;
   }
 }
 
-void PixieInterface::PrintSglModPar(const char *name, int mod, word_t prev)
+void PixieInterface::PrintSglModPar(const char *name, int mod, word_t prev, std::ostream &out)
 {
   word_t val;
 
-  strncpy(tmpName, name, nameSize);
-
-  if (ReadSglModPar(tmpName, val, mod)) {    
-	cout.unsetf(ios_base::floatfield);
-    cout << "  MOD " << setw(2) << mod << "  " << setw(15) << name << "  " << setprecision(6) << prev << " -> " << val << endl;
+  if (ReadSglModPar(name, val, mod)) {    
+	out.unsetf(ios_base::floatfield);
+    out << "  MOD " << setw(2) << mod << "  " << setw(15) << name << "  " << setprecision(6) << prev << " -> " << val << endl;
   }
 }
 
@@ -398,48 +396,83 @@ bool PixieInterface::WriteSglChanPar(const char *name, double val, int mod, int
 
 bool PixieInterface::WriteSglChanPar(const char *name, double val, int mod, int chan, double &pval)
 {
-  strncpy(tmpName, name, nameSize);
+  char parName[nameSize];
+  strncpy(parName, name, nameSize);
+  parName[nameSize - 1] = '\0';
 
-  Pixie16ReadSglChanPar(tmpName, &pval, mod, chan);
-  retval = Pixie16WriteSglChanPar(tmpName, val, mod, chan);
-  if (retval < 0) {
+  Pixie16ReadSglChanPar(parName, &pval, mod, chan);
+  if (Pixie16WriteSglChanPar(parName, val, mod, chan) < 0) {
     cout << "Error writing channel parameter " << WarningStr(name) << " for module " << mod << ", channel " << chan << endl;
     return false;      
   }
   return true;
 }
 
+bool PixieInterface::WriteChanPars(int mod, std::vector<ChanPar> &pars)
+{
+  if (WriteChanParBatch(mod, pars) == 0)
+    return true;
+
+  for (size_t i=0; i < pars.size(); i++) {
+    if (pars[i].failed)
+      cout << "Error writing channel parameter " << WarningStr(pars[i].name) << " for module " << mod << ", channel " << pars[i].chan << endl;
+  }
+  return false;
+}
+
+bool PixieInterface::WriteChanPars(std::vector< std::vector<ChanPar> > &pars)
+{
+  // modules without a batch are left alone
+  pars.resize(numberCards);
+
+  std::vector<int> results;
+  ForEachModule([this, &pars](unsigned short mod) {
+    return -WriteChanParBatch(mod, pars[mod]);
+  }, results);
+
+  bool hadError = false;
+  for (unsigned short mod=0; mod < numberCards; mod++) {
+    if (results[mod] == 0)
+      continue;
+    hadError = true;
+    for (size_t i=0; i < pars[mod].size(); i++) {
+      if (pars[mod][i].failed)
+        cout << "Error writing channel parameter " << WarningStr(pars[mod][i].name) << " for module " << mod << ", channel " << pars[mod][i].chan << endl;
+    }
+  }
+  return !hadError;
+}
+
 bool PixieInterface::ReadSglChanPar(const char *name, double &pval, int mod, int chan)
 {
-  strncpy(tmpName, name, nameSize);
+  char parName[nameSize];
+  strncpy(parName, name, nameSize);
+  parName[nameSize - 1] = '\0';
 
-  retval = Pixie16ReadSglChanPar(tmpName, &pval, mod, chan);
-  if (retval < 0) {
+  if (Pixie16ReadSglChanPar(parName, &pval, mod, chan) < 0) {
     cout << "Error reading channel parameter " << WarningStr(name) << " for module " << mod << ", channel " << chan << endl;
     return false;      
   }
   return true;
 }
 
-void PixieInterface::PrintSglChanPar(const char *name, int mod, int chan)
+void PixieInterface::PrintSglChanPar(const char *name, int mod, int chan, std::ostream &out)
 {
   double val;
-  strncpy(tmpName, name, nameSize);
 
-  if (ReadSglChanPar(tmpName, val, mod, chan)) {    
-	cout.unsetf(ios_base::floatfield);
-    cout << "  MOD " << setw(2) << mod << "  CHAN " << setw(2) << chan << "  " << setw(15) << name << "  " << setprecision(6) << val << endl;
+  if (ReadSglChanPar(name, val, mod, chan)) {    
+	out.unsetf(ios_base::floatfield);
+    out << "  MOD " << setw(2) << mod << "  CHAN " << setw(2) << chan << "  " << setw(15) << name << "  " << setprecision(6) << val << endl;
   }
 }
 
-void PixieInterface::PrintSglChanPar(const char *name, int mod, int chan, double prev)
+void PixieInterface::PrintSglChanPar(const char *name, int mod, int chan, double prev, std::ostream &out)
 {
   double val;
-  strncpy(tmpName, name, nameSize);
 
-  if (ReadSglChanPar(tmpName, val, mod, chan)) {    
-	cout.unsetf(ios_base::floatfield);
-    cout << "  MOD " << setw(2) << mod << "  CHAN " << setw(2) << chan << "  " << setw(15) << name << "  " << setprecision(6) << prev << " -> " << val << endl;
+  if (ReadSglChanPar(name, val, mod, chan)) {    
+	out.unsetf(ios_base::floatfield);
+    out << "  MOD " << setw(2) << mod << "  CHAN " << setw(2) << chan << "  " << setw(15) << name << "  " << setprecision(6) << prev << " -> " << val << endl;
   }
 }
 
@@ -485,6 +518,71 @@ bool PixieInterface::ReadSglChanTrace(unsigned short *buf, unsigned long sz,
   return true;
 }
 
+bool PixieInterface::AcquireAllTraces(unsigned short *buf, unsigned long sz, int mod)
+{
+  if (sz > TRACE_LENGTH) {
+    cout << ErrorStr("Trace length too large.") << endl;
+    return false;
+  }
+
+  // a single acquisition per module, then every channel is read back without pauses,
+  //   each module into its own part of buf, retval is not touched by the threads
+  ModuleTask task = [buf, sz, mod](unsigned short m) {
+    unsigned short *modBuf = &buf[(mod < 0 ? m : 0) * NUMBER_OF_CHANNELS * sz];
+    int ret = Pixie16AcquireADCTrace(m);
+    for (unsigned short ch=0; ret >= 0 && ch < NUMBER_OF_CHANNELS; ch++)
+      ret = Pixie16ReadSglChanADCTrace(&modBuf[ch * sz], sz, m, ch);
+    return ret;
+  };
+
+  std::vector<int> results;
+  bool b;
+  if (mod >= 0) {
+    results.assign(1, task(mod));
+    b = (results[0] >= 0);
+  } else {
+    b = ForEachModule(task, results);
+  }
+
+  for (size_t i=0; i < results.size(); i++) {
+    if (results[i] < 0)
+      cout << ErrorStr("Error acquiring ADC traces from module ") << (mod < 0 ? (int)i : mod) << endl;
+  }
+  return b;
+}
+
+void PixieInterface::AnalyzeTraces(const unsigned short *traces, size_t nTraces, unsigned long sz,
+				   float *baseline, float *maximum)
+{
+  auto analyze = [traces, sz, baseline, maximum](size_t first, size_t last) {
+    size_t baselineSamples = sz / 10;
+    for (size_t i=first; i < last; i++) {
+      const unsigned short *trace = &traces[i * sz];
+      unsigned long sum = 0;
+      unsigned short peak = 0;
+      for (size_t j=0; j < baselineSamples; j++)
+	sum += trace[j];
+      for (size_t j=0; j < sz; j++)
+	peak = std::max(peak, trace[j]);
+      baseline[i] = (baselineSamples > 0 ? float(sum) / float(baselineSamples) : 0);
+      maximum[i] = peak - baseline[i];
+    }
+  };
+
+  size_t nThreads = std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), nTraces);
+  if (nThreads < 2) {
+    analyze(0, nTraces);
+    return;
+  }
+
+  // each thread only writes the results of its own traces
+  std::vector<std::thread> threads;
+  for (size_t t=0; t < nThreads; t++)
+    threads.push_back(std::thread(analyze, t * nTraces / nThreads, (t + 1) * nTraces / nThreads));
+  for (size_t t=0; t < threads.size(); t++)
+    threads[t].join();
+}
+
 bool PixieInterface::GetStatistics(unsigned short mod)
 {
   retval = Pixie16ReadStatisticsFromModule(statistics, mod);
@@ -522,6 +620,51 @@ double PixieInterface::GetProcessedEvents(int mod)
   return Pixie16ComputeProcessedEvents(statistics,mod);
 }
 
+bool PixieInterface::ReadStatistics(word_t *stats)
+{
+  // each module fills its own block of stats, retval is not touched by the threads
+  std::vector<int> results;
+  bool b = ForEachModule([stats](unsigned short mod) {
+    return Pixie16ReadStatisticsFromModule(&stats[mod * STAT_SIZE], mod);
+  }, results);
+
+  for (size_t mod=0; mod < results.size(); mod++) {
+    if (results[mod] < 0)
+      cout << WarningStr("Error reading statistics from module ") << mod << endl;
+  }
+  return b;
+}
+
+bool PixieInterface::ReadStatistics(word_t *stats, unsigned short mod)
+{
+  // the shared statistics block and retval are not touched
+  if (Pixie16ReadStatisticsFromModule(stats, mod) < 0) {
+    cout << WarningStr("Error reading statistics from module ") << mod << endl;
+    return false;
+  }
+  return true;
+}
+
+double PixieInterface::GetInputCountRate(word_t *stats, int mod, int chan)
+{
+  return Pixie16ComputeInputCountRate(stats,mod,chan);
+}
+
+double PixieInterface::GetOutputCountRate(word_t *stats, int mod, int chan)
+{
+  return Pixie16ComputeOutputCountRate(stats,mod,chan);
+}
+
+double PixieInterface::GetLiveTime(word_t *stats, int mod, int chan)
+{
+  return Pixie16ComputeLiveTime(stats,mod,chan);
+}
+
+double PixieInterface::GetRealTime(word_t *stats, int mod)
+{
+  return Pixie16ComputeRealTime(stats,mod);
+}
+
 bool PixieInterface::StartHistogramRun(unsigned short mode)
 {
   LeaderPrint("Starting histogram run");
@@ -593,50 +736,57 @@ unsigned long PixieInterface::CheckFIFOWords(unsigned short mod)
   // word_t nWords;
   unsigned int nWords;
 
-  retval = Pixie16CheckExternalFIFOStatus(&nWords, mod);
+  // A local status, as the FIFOs of several crates may be checked at once.
+  int status = Pixie16CheckExternalFIFOStatus(&nWords, mod);
 
-  if (retval < 0) {
+  if (status < 0) {
     cout << WarningStr("Error checking FIFO status in module ") << mod << endl;
     return 0;
   }
  
-	return nWords + extraWords[mod].size();
+	return nWords + extraWords[mod].nWords;
 }
 
 bool PixieInterface::ReadFIFOWords(word_t *buf, unsigned long nWords,
 				   unsigned short mod, bool verbose)
 {
 	unsigned long availWords = CheckFIFOWords(mod);
+	CarryWords &extra = extraWords[mod];
 
 	if (verbose) {
 		std::cout << "mod " << mod << " nWords " << nWords;
-		std::cout << " extraWords[mod].size " << extraWords[mod].size();
+		std::cout << " extraWords[mod].nWords " << extra.nWords;
 	}
-	if (nWords < MIN_FIFO_READ + extraWords[mod].size()) {
-		if (nWords > extraWords[mod].size()) {
-			word_t minibuf[MIN_FIFO_READ];
-
+	if (nWords < MIN_FIFO_READ + extra.nWords) {
+		if (nWords > extra.nWords) {
 			if (availWords < MIN_FIFO_READ) {
 				std::cout << Display::ErrorStr() << " Not enough words available in module " << mod << "'s FIFO for read! (" << availWords << "/" << MIN_FIFO_READ << ")\n";
 				return false;
 			}
-			retval = Pixie16ReadDataFromExternalFIFO(minibuf, MIN_FIFO_READ, mod);
+			// Move the carried words to the front so the minimum read lands right behind them.
+			if (extra.data != extra.words && extra.nWords > 0) memmove(extra.words, extra.data, extra.nWords * sizeof(word_t));
+			extra.data = extra.words;
 
-			if (retval < 0) {
-				cout << WarningStr("Error reading words from FIFO in module ") << mod << " retVal " << retval << endl;
+			int status = Pixie16ReadDataFromExternalFIFO(&extra.words[extra.nWords], MIN_FIFO_READ, mod);
+
+			if (status < 0) {
+				cout << WarningStr("Error reading words from FIFO in module ") << mod << " retVal " << status << endl;
 				return false;
 			}
-			for (int i=0;i<MIN_FIFO_READ;i++) extraWords[mod].push(minibuf[i]);
+			extra.nWords += MIN_FIFO_READ;
 		}
 	}
-	if (verbose) std::cout << " " << extraWords[mod].size();
-
-	size_t wordsAdded;
-	for (wordsAdded = 0;wordsAdded<nWords && !extraWords[mod].empty();++wordsAdded) {
-		*buf++ = extraWords[mod].front();
-		extraWords[mod].pop();
+	if (verbose) std::cout << " " << extra.nWords;
+
+	size_t wordsAdded = std::min((size_t)nWords, extra.nWords);
+	if (wordsAdded > 0) {
+		memcpy(buf, extra.data, wordsAdded * sizeof(word_t));
+		buf += wordsAdded;
+		extra.data += wordsAdded;
+		extra.nWords -= wordsAdded;
 	}
-	if (verbose) std::cout << " " << extraWords[mod].size();
+	if (extra.nWords == 0) extra.data = extra.words;
+	if (verbose) std::cout << " " << extra.nWords;
 
 	if (nWords <= wordsAdded) {
 		std::cout <<std::endl;
@@ -650,10 +800,10 @@ bool PixieInterface::ReadFIFOWords(word_t *buf, unsigned long nWords,
 		std::cout << Display::ErrorStr() << " Not enough words available in module " << mod << "'s FIFO for read! (" << availWords << "/" << nWords << ")\n";
 		return false;
 	}
-	retval = Pixie16ReadDataFromExternalFIFO(buf, nWords, mod);
+	int status = Pixie16ReadDataFromExternalFIFO(buf, nWords, mod);
 
-	if (retval < 0) {
-		cout << WarningStr("Error reading words from FIFO in module ") << mod << " retVal " << retval << endl;
+	if (status < 0) {
+		cout << WarningStr("Error reading words from FIFO in module ") << mod << " retVal " << status << endl;
 		return false;
 	}
 
@@ -726,6 +876,31 @@ bool PixieInterface::ReadHistogram(word_t *hist, unsigned long sz,
   return true;
 }
 
+bool PixieInterface::ReadHistograms(word_t *hist, unsigned long sz)
+{
+  if (sz > MAX_HISTOGRAM_LENGTH) {
+    cout << ErrorStr("Histogram length is too large.") << endl;
+    return false;
+  }
+
+  // each module fills its own part of hist, retval is not touched by the threads
+  std::vector<int> results;
+  bool b = ForEachModule([hist, sz](unsigned short mod) {
+    for (unsigned short ch=0; ch < NUMBER_OF_CHANNELS; ch++) {
+      int ret = Pixie16ReadHistogramFromModule(&hist[(mod * NUMBER_OF_CHANNELS + ch) * sz], sz, mod, ch);
+      if (ret < 0)
+        return ret;
+    }
+    return 0;
+  }, results);
+
+  for (size_t mod=0; mod < results.size(); mod++) {
+    if (results[mod] < 0)
+      cout << ErrorStr("Failed to get histogram data from module ") << mod << endl;
+  }
+  return b;
+}
+
 bool PixieInterface::AdjustOffsets(unsigned short mod)
 {
   LeaderPrint("Adjusting Offsets");
@@ -734,6 +909,29 @@ bool PixieInterface::AdjustOffsets(unsigned short mod)
   return !CheckError();
 }
 
+bool PixieInterface::AdjustOffsets(void)
+{
+  std::vector<int> results;
+  ForEachModule([](unsigned short mod) {
+    return Pixie16AdjustOffsets(mod);
+  }, results);
+
+  return !CheckModuleErrors("Adjusting Offsets in Module ", results);
+}
+
+bool PixieInterface::FindTau(std::vector< std::vector<double> > &taus)
+{
+  // channels where no tau is found are left at -1
+  taus.assign(numberCards, std::vector<double>(NUMBER_OF_CHANNELS, -1));
+
+  std::vector<int> results;
+  ForEachModule([&taus](unsigned short mod) {
+    return Pixie16TauFinder(mod, taus[mod].data());
+  }, results);
+
+  return !CheckModuleErrors("Finding Tau in Module ", results);
+}
+
 bool PixieInterface::ToggleGain(int mod, int chan)
 {
   return ToggleChannelBit(mod, chan, "CHANNEL_CSRA", CCSRA_ENARELAY);
@@ -824,6 +1022,76 @@ bool PixieInterface::ToggleChannelBit(int mod, int chan, const char *parameter,
   return WriteSglChanPar(parameter, dval, mod, chan);
 }
 
+bool PixieInterface::ForEachModule(ModuleTask task, std::vector<int> &results)
+{
+  results.assign(numberCards, 0);
+
+  if (!parallelModules || numberCards < 2) {
+    for (unsigned short mod=0; mod < numberCards; mod++)
+      results[mod] = task(mod);
+  } else {
+    // each thread only writes the result of its own module
+    std::vector<std::thread> threads;
+    for (unsigned short mod=0; mod < numberCards; mod++)
+      threads.push_back(std::thread([&task, &results, mod]() { results[mod] = task(mod); }));
+    for (size_t i=0; i < threads.size(); i++)
+      threads[i].join();
+  }
+
+  for (size_t i=0; i < results.size(); i++) {
+    if (results[i] < 0)
+      return false;
+  }
+  return true;
+}
+
+bool PixieInterface::CheckModuleErrors(const std::string &leader, const std::vector<int> &results, bool exitOnError) const
+{
+  bool hadError = false;
+
+  for (size_t i=0; i < results.size(); i++) {
+    stringstream str;
+    str << leader << i;
+    LeaderPrint(str.str());
+    if (StatusPrint(results[i] < 0))
+      hadError = true;
+  }
+
+  if (hadError && exitOnError)
+    exit(EXIT_FAILURE); // or do something else
+
+  return hadError;
+}
+
+int PixieInterface::WriteChanParBatch(int mod, std::vector<ChanPar> &pars) const
+{
+  // private copy of the name, tmpName may be in use by another module
+  char name[nameSize];
+  int failures = 0;
+
+  for (size_t i=0; i < pars.size(); i++) {
+    ChanPar &par = pars[i];
+    strncpy(name, par.name.c_str(), nameSize);
+    name[nameSize - 1] = '\0';
+
+    par.written = false;
+    par.failed = (Pixie16ReadSglChanPar(name, &par.prev, mod, par.chan) < 0);
+    // skip the round trip if the module already has the value
+    if (!par.failed && par.prev == par.val)
+      continue;
+
+    if (Pixie16WriteSglChanPar(name, par.val, mod, par.chan) < 0) {
+      par.failed = true;
+      failures++;
+      continue;
+    }
+    par.failed = false;
+    par.written = true;
+  }
+
+  return failures;
+}
+
 string PixieInterface::ConfigFileName(const string &str) 
 {
   if (str[0] == '.' || str[0] == '/')
@@ -1,7 +1,9 @@
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <stdlib.h>
 #include <cmath>
+#include <cstring>
 #include <unistd.h>
 
 #include "Display.h"
@@ -45,7 +47,7 @@ bool BitFlipper::operator()(PixieFunctionParms<std::string> &par){
 	}
 	
 	if(par.pif->WriteSglChanPar(par.par.c_str(), new_csra, par.mod, par.ch)){
-		par.pif->PrintSglChanPar(par.par.c_str(), par.mod, par.ch, value);
+		par.pif->PrintSglChanPar(par.par.c_str(), par.mod, par.ch, value, *par.out);
 		return true;
 	}
 
@@ -232,7 +234,7 @@ void GetTraces::Help(){
 }
 
 bool GetTraces::operator()(PixieFunctionParms<int> &par){
-	float temp_val;
+	size_t nChan = par.pif->GetNumberChannels();
 
 	// Reset parameters.
 	for (unsigned int i = 0; i < NUMBER_OF_CHANNELS; i++) {
@@ -241,75 +243,31 @@ bool GetTraces::operator()(PixieFunctionParms<int> &par){
 	}
 	status = false;
 
-	size_t baselineSamples = trace_len / 10;
-	unsigned long sum;
+	if(total_len < nChan * trace_len){ return false; }
 
-	// Get a single channel's trace.
-	// Try to find a pulse above the threshold.
+	// Try to find a pulse above the threshold. Every channel of the module is
+	// acquired and read at once, so the other channels need no second pass.
 	for(attempts = 1; attempts <= 100; attempts++){
-		par.pif->AcquireTraces(par.mod); // Acquire new traces.
-		usleep(10);
-		
-		if (par.pif->ReadSglChanTrace(trace_data, trace_len, par.mod, par.ch)) {
-			// Reset the parameters for the trigger channel.
-			baseline[par.ch] = -1;
-			maximum[par.ch] = -9999;
-		
-			// Calculate the channel baseline.
-			sum = 0;
+		if(!par.pif->AcquireAllTraces(total_data, trace_len, par.mod)){ continue; }
 
-			for (unsigned i = 0; i < baselineSamples; i++)
-				sum += trace_data[i];
+		// Calculate the channel baselines and the maximum values above them.
+		PixieInterface::AnalyzeTraces(total_data, nChan, trace_len, baseline, maximum);
 
-			baseline[par.ch] = float(sum)/float(baselineSamples);
-
-			// Correct the baseline
-			//for (unsigned i = 0; i < trace_len; ++i)
-				//data[i] = data[i] - baseline[par.ch];
-		
-			// Find the maximum value above baseline.
-			for (unsigned i = 0; i < trace_len; i++){
-				temp_val = trace_data[i] - baseline[par.ch];
-				if(temp_val > maximum[par.ch]){ maximum[par.ch] = temp_val; }
-				
-				if(!correct_baselines){ total_data[(par.ch * trace_len) + i] = trace_data[i]; }
-				else{ total_data[(par.ch * trace_len) + i] = temp_val; }
-			}
-			
-			// Check that this "trace" is above threshold.
-			if(maximum[par.ch] < threshold){ continue; }
-		
-			status = true;
-			break;
-		} 
-	}
+		// Check that this "trace" is above threshold.
+		if(maximum[par.ch] < threshold){ continue; }
 	
-	// Threshold was not reached. Copy the most recent pulse into
-	// the module traces array.
-	for (unsigned int i = 0; i < NUMBER_OF_CHANNELS; i++) {
-		if(i == par.ch){ continue; } // Already did this channel.
-		
-		if(par.pif->ReadSglChanTrace(trace_data, trace_len, par.mod, i)){
-			// Calculate the channel baseline.
-			sum = 0;
-
-			for (unsigned j = 0; j < baselineSamples; j++)
-				sum += trace_data[j];
+		status = true;
+		break;
+	}
 
-			baseline[i] = float(sum)/float(baselineSamples);
+	// Keep the trigger channel's trace.
+	memcpy(trace_data, &total_data[par.ch * trace_len], trace_len * sizeof(unsigned short));
 
-			// Correct the baseline
-			//for (unsigned i = 0; i < trace_len; ++i)
-				//data[i] = data[i] - baseline[par.ch];
-		
-			// Find the maximum value above baseline.
-			for (unsigned j = 0; j < trace_len; j++){
-				temp_val = trace_data[j] - baseline[i];
-				if(temp_val > maximum[i]){ maximum[i] = temp_val; }
-				
-				if(!correct_baselines){ total_data[(i * trace_len) + j] = trace_data[j]; }
-				else{ total_data[(i * trace_len) + j] = temp_val; }
-			}
+	// Correct the baselines.
+	if(correct_baselines){
+		for (unsigned int i = 0; i < nChan; i++) {
+			for (unsigned j = 0; j < trace_len; j++)
+				total_data[(i * trace_len) + j] = total_data[(i * trace_len) + j] - baseline[i];
 		}
 	}
 	
@@ -319,7 +277,7 @@ bool GetTraces::operator()(PixieFunctionParms<int> &par){
 bool ParameterChannelWriter::operator()(PixieFunctionParms< std::pair<std::string, double> > &par){
 	double previousValue;
 	if(par.pif->WriteSglChanPar(par.par.first.c_str(), par.par.second, par.mod, par.ch, previousValue)){
-		par.pif->PrintSglChanPar(par.par.first.c_str(), par.mod, par.ch, previousValue);
+		par.pif->PrintSglChanPar(par.par.first.c_str(), par.mod, par.ch, previousValue, *par.out);
 		return true;
 	}
 	return false;
@@ -328,19 +286,19 @@ bool ParameterChannelWriter::operator()(PixieFunctionParms< std::pair<std::strin
 bool ParameterModuleWriter::operator()(PixieFunctionParms< std::pair<std::string, unsigned int> > &par){
 	unsigned int previousValue;
 	if(par.pif->WriteSglModPar(par.par.first.c_str(), par.par.second, par.mod, previousValue)){
-		par.pif->PrintSglModPar(par.par.first.c_str(), par.mod, previousValue);
+		par.pif->PrintSglModPar(par.par.first.c_str(), par.mod, previousValue, *par.out);
 		return true;
 	} 
 	return false;
 }
 
 bool ParameterChannelReader::operator()(PixieFunctionParms<std::string> &par){
-	par.pif->PrintSglChanPar(par.par.c_str(), par.mod, par.ch);
+	par.pif->PrintSglChanPar(par.par.c_str(), par.mod, par.ch, *par.out);
 	return true;
 }
 
 bool ParameterModuleReader::operator()(PixieFunctionParms<std::string> &par){
-	par.pif->PrintSglModPar(par.par.c_str(), par.mod);
+	par.pif->PrintSglModPar(par.par.c_str(), par.mod, *par.out);
 	return true;
 }
 
@@ -378,3 +336,144 @@ bool TauFinder::operator()(PixieFunctionParms<> &par){
 
 	return (errorNum >= 0);
 }
+
+// Comparisons allow for the precision of the values in a parameter dump file.
+#define PARAMETER_TOLERANCE 1E-5
+
+const std::vector<std::string> ParameterSnapshot::chan_names = {"TRIGGER_RISETIME", "TRIGGER_FLATTOP", "TRIGGER_THRESHOLD", 
+	"ENERGY_RISETIME", "ENERGY_FLATTOP", "TAU", "TRACE_LENGTH", "TRACE_DELAY", "VOFFSET", "XDT", "BASELINE_PERCENT", "EMIN", 
+	"BINFACTOR", "CHANNEL_CSRA", "CHANNEL_CSRB", "BLCUT", "ExternDelayLen", "ExtTrigStretch", "ChanTrigStretch", "FtrigoutDelay", 
+	"FASTTRIGBACKLEN"};
+
+const std::vector<std::string> ParameterSnapshot::mod_names = {"MODULE_CSRA", "MODULE_CSRB", "MODULE_FORMAT", "MAX_EVENTS", 
+	"SYNCH_WAIT", "IN_SYNCH", "SLOW_FILTER_RANGE", "FAST_FILTER_RANGE", "MODULE_NUMBER", "TrigConfig0", "TrigConfig1", 
+	"TrigConfig2", "TrigConfig3"};
+
+bool ParameterSnapshot::Read(PixieInterface *pif_, int mod_/*=-1*/){
+	int firstMod = (mod_ < 0 ? 0 : mod_);
+	int lastMod = (mod_ < 0 ? pif_->GetNumberCards() : mod_ + 1);
+	bool hadError = false;
+
+	for(int mod = firstMod; mod < lastMod; mod++){
+		for(size_t ch = 0; ch < pif_->GetNumberChannels(); ch++){
+			for(size_t i = 0; i < chan_names.size(); i++){
+				double value;
+				if(pif_->ReadSglChanPar(chan_names[i].c_str(), value, mod, ch)){ SetChannel(mod, ch, chan_names[i], value); }
+				else{ hadError = true; }
+			}
+		}
+		for(size_t i = 0; i < mod_names.size(); i++){
+			PixieInterface::word_t value;
+			if(pif_->ReadSglModPar(mod_names[i].c_str(), value, mod)){ SetModule(mod, mod_names[i], value); }
+			else{ hadError = true; }
+		}
+	}
+
+	return !hadError;
+}
+
+bool ParameterSnapshot::Load(const std::string &fname_){
+	std::ifstream file(fname_.c_str());
+	if(!file.good()){ return false; }
+
+	std::string line;
+	while(std::getline(file, line)){
+		if(line.empty() || line[0] == '#'){ continue; }
+
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while(stream >> field){ fields.push_back(field); }
+
+		// "mod ch name value" for channel parameters, "mod name value" for module parameters.
+		if(fields.size() == 4){ SetChannel(atoi(fields[0].c_str()), atoi(fields[1].c_str()), fields[2], strtod(fields[3].c_str(), NULL)); }
+		else if(fields.size() == 3){ SetModule(atoi(fields[0].c_str()), fields[1], strtoul(fields[2].c_str(), NULL, 0)); }
+		else{
+			std::cout << Display::WarningStr("Warning") << ": Ignoring malformed line '" << line << "' in " << fname_ << std::endl;
+		}
+	}
+
+	return true;
+}
+
+bool ParameterSnapshot::Save(const std::string &fname_) const {
+	std::ofstream file(fname_.c_str());
+	if(!file.good()){ return false; }
+
+	for(std::map<ChanKey, double>::const_iterator iter = chan_values.begin(); iter != chan_values.end(); iter++){
+		file << std::get<0>(iter->first) << "\t" << std::get<1>(iter->first) << "\t" << std::get<2>(iter->first) << "\t" << iter->second << std::endl;
+	}
+	for(std::map<ModKey, unsigned int>::const_iterator iter = mod_values.begin(); iter != mod_values.end(); iter++){
+		file << iter->first.first << "\t" << iter->first.second << "\t" << iter->second << std::endl;
+	}
+
+	return file.good();
+}
+
+size_t ParameterSnapshot::Diff(const ParameterSnapshot &target_, ParameterSnapshot &changes_) const {
+	changes_.Clear();
+
+	for(std::map<ChanKey, double>::const_iterator iter = target_.chan_values.begin(); iter != target_.chan_values.end(); iter++){
+		std::map<ChanKey, double>::const_iterator current = chan_values.find(iter->first);
+		if(current == chan_values.end()){ continue; }
+		if(std::fabs(current->second - iter->second) > PARAMETER_TOLERANCE * std::max(1.0, std::fabs(iter->second))){
+			changes_.chan_values.insert(*iter);
+		}
+	}
+	for(std::map<ModKey, unsigned int>::const_iterator iter = target_.mod_values.begin(); iter != target_.mod_values.end(); iter++){
+		std::map<ModKey, unsigned int>::const_iterator current = mod_values.find(iter->first);
+		if(current != mod_values.end() && current->second != iter->second){ changes_.mod_values.insert(*iter); }
+	}
+
+	return changes_.Size();
+}
+
+bool ParameterSnapshot::Apply(PixieInterface *pif_) const {
+	bool hadError = false;
+
+	// Module parameters go first, as they may change the meaning of the channel parameters.
+	for(std::map<ModKey, unsigned int>::const_iterator iter = mod_values.begin(); iter != mod_values.end(); iter++){
+		if(iter->first.first < 0 || iter->first.first >= pif_->GetNumberCards()){ continue; }
+		if(!pif_->WriteSglModPar(iter->first.second.c_str(), iter->second, iter->first.first)){ hadError = true; }
+	}
+
+	std::vector< std::vector<PixieInterface::ChanPar> > batches(pif_->GetNumberCards());
+	for(std::map<ChanKey, double>::const_iterator iter = chan_values.begin(); iter != chan_values.end(); iter++){
+		int mod = std::get<0>(iter->first);
+		if(mod < 0 || mod >= pif_->GetNumberCards()){ continue; }
+		batches[mod].push_back(PixieInterface::ChanPar(std::get<2>(iter->first), std::get<1>(iter->first), iter->second));
+	}
+	if(!pif_->WriteChanPars(batches)){ hadError = true; }
+
+	return !hadError;
+}
+
+void ParameterSnapshot::Print(const ParameterSnapshot *before_/*=NULL*/) const {
+	for(std::map<ModKey, unsigned int>::const_iterator iter = mod_values.begin(); iter != mod_values.end(); iter++){
+		unsigned int prev;
+		std::cout << "  MOD " << std::setw(2) << iter->first.first << "  " << std::setw(15) << iter->first.second << "  ";
+		if(before_ && before_->GetModule(iter->first.first, iter->first.second, prev)){ std::cout << prev << " -> "; }
+		std::cout << iter->second << std::endl;
+	}
+	for(std::map<ChanKey, double>::const_iterator iter = chan_values.begin(); iter != chan_values.end(); iter++){
+		double prev;
+		std::cout << "  MOD " << std::setw(2) << std::get<0>(iter->first) << "  CHAN " << std::setw(2) << std::get<1>(iter->first);
+		std::cout << "  " << std::setw(15) << std::get<2>(iter->first) << "  ";
+		if(before_ && before_->GetChannel(std::get<0>(iter->first), std::get<1>(iter->first), std::get<2>(iter->first), prev)){ std::cout << prev << " -> "; }
+		std::cout << iter->second << std::endl;
+	}
+}
+
+bool ParameterSnapshot::GetChannel(int mod_, int ch_, const std::string &name_, double &value_) const {
+	std::map<ChanKey, double>::const_iterator iter = chan_values.find(std::make_tuple(mod_, ch_, name_));
+	if(iter == chan_values.end()){ return false; }
+	value_ = iter->second;
+	return true;
+}
+
+bool ParameterSnapshot::GetModule(int mod_, const std::string &name_, unsigned int &value_) const {
+	std::map<ModKey, unsigned int>::const_iterator iter = mod_values.find(std::make_pair(mod_, name_));
+	if(iter == mod_values.end()){ return false; }
+	value_ = iter->second;
+	return true;
+}
@@ -54,6 +54,7 @@ public:
 
     /** Dtor, closing files and deleting memory. */
     virtual ~HisDrr() {
+                unmapHis();
                 drrFile->close();
                 hisFile->close();
                 delete drrFile;
@@ -84,7 +85,32 @@ public:
     /** Replaces histogram id values by ones given in a vector. The 2-bytes long word version.  */
     virtual void setValue(const int id, vector<unsigned short> &value);
 
+    /** Maps the his file into memory (only if the his file was opened by name).
+     * Histograms may then be changed in place through getMappedData and other
+     * programs reading the his file see the changes without reopening it.
+     * Returns false if the file could not be mapped. */
+    virtual bool mapHis();
+
+    /** Returns a pointer to the channels of histogram 'id' in the mapped his file,
+     * or NULL if the file is not mapped. The 4-bytes long word version. */
+    virtual unsigned int* getMappedData(int id);
+
+    /** Schedules the changes to the mapped his file to be written to disk. */
+    virtual void syncHis();
+
 private:
+    /** Name of the his file, empty if the his fstream was passed in. */
+    string hisName;
+
+    /** The mapped his file, NULL if not mapped. */
+    char *hisMap;
+
+    /** Size of the mapped his file in bytes. */
+    size_t hisMapSize;
+
+    /** Unmaps the his file. */
+    void unmapHis();
+
     /** Vector holding all the histogram info read from drr file. */
     vector<DrrHisRecordExtended> hisList;
 
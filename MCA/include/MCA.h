@@ -2,10 +2,10 @@
 #define MCA_H
 
 #include <ctime>
+#include <vector>
 
 #include "PixieSupport.h"
-
-class PixieInterface;
+#include "PixieInterface.h"
 
 ///Abstract MCA class
 class MCA {
@@ -23,6 +23,22 @@ class MCA {
 		bool _isOpen;
 		///Pointer to the PixieInterface
 		PixieInterface *_pif;
+
+		///Time between histogram updates (in seconds).
+		float _refresh;
+		///Histograms of every module and channel from the last update.
+		std::vector<PixieInterface::word_t> _histo;
+		///Histograms from the update before the last.
+		std::vector<PixieInterface::word_t> _prev;
+		///Bins of the current channel which changed since the last update.
+		std::vector<unsigned int> _changed;
+		///Store every channel at the next update, as there is no previous one.
+		bool _storeAll;
+
+		///Read all histograms and pass the bins which changed to StoreData().
+		bool Update();
+		///Forget the last update, so the next one compares against empty histograms.
+		void ClearUpdate() {_histo.clear();};
 	public:
 		///Default constructor.
 		MCA(PixieInterface *pif);
@@ -30,18 +46,32 @@ class MCA {
 		virtual ~MCA() {};
 		///Return the length of time the MCA has been running.
 		double GetRunTime();
-		///Abstract method describing how the MCA data is stored.
-		virtual bool StoreData(int mod, int ch) = 0;
+		///Abstract method describing how the MCA data is stored. Only the bins
+		///listed in changed differ from the previous call for this channel.
+		virtual bool StoreData(int mod, int ch, const PixieInterface::word_t *histo, const std::vector<unsigned int> &changed) = 0;
 		///Abstract method to open a storage file.
 		virtual bool OpenFile(const char *basename) = 0;
 		///Flush the current memory to disk.
 		virtual void Flush() = 0;
+		///Return the time between histogram updates (in seconds).
+		float GetRefreshInterval() {return _refresh;};
+		///Set the time between histogram updates (in seconds).
+		void SetRefreshInterval(float refresh) {_refresh = refresh;};
 		///Check if the histogram construction was successful.
 		virtual bool IsOpen() {return _isOpen;};
 		///Start the MCA running.
 		virtual void Run(float duration, bool *stop=NULL);
 		///Update the MCA histograms.
 		virtual bool Step();
+		///Start an update read one channel at a time with ReadChannel(), e.g.
+		///between the FIFO reads of a list-mode run.
+		void BeginUpdate();
+		///Read the histogram of one channel into the update begun by BeginUpdate().
+		bool ReadChannel(int mod, int ch);
+		///Drop the update begun by BeginUpdate(), keeping the last one as the reference.
+		void CancelUpdate() {_histo.swap(_prev);};
+		///Pass the bins which changed in the update begun by BeginUpdate() to StoreData().
+		bool FinishUpdate();
 };
 
 #endif 
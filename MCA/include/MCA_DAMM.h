@@ -1,6 +1,9 @@
 #ifndef MCA_DAMM_H
 #define MCA_DAMM_H
 
+#include <map>
+#include <vector>
+
 #include "MCA.h"
 
 class HisDrr;
@@ -8,12 +11,14 @@ class HisDrr;
 class MCA_DAMM : public MCA {
 	private:
 		HisDrr *_histogram;
+		///The DAMM spectrum of each histogram id, as last written, if the his file is not mapped.
+		std::map<int, std::vector<unsigned int> > _spectra;
 	public:
 		MCA_DAMM(PixieInterface *pif, const char* basename);
 		~MCA_DAMM();
 		bool OpenFile(const char* basename);
-		bool StoreData(int mod, int ch);
-		void Flush() {};
+		bool StoreData(int mod, int ch, const PixieInterface::word_t *histo, const std::vector<unsigned int> &changed);
+		void Flush();
 };
 
 #endif
@@ -4,6 +4,7 @@
 #include "MCA.h"
 #include <stdio.h>
 #include <unistd.h>
+#include <vector>
 
 class TFile;
 class TH1F;
@@ -11,7 +12,10 @@ class TH1F;
 class MCA_ROOT : public MCA {
 	private:
 		TFile* _file;
-		std::map<int,TH1F*> _histograms;
+		///Histograms indexed by mod * channels per module + ch.
+		std::vector<TH1F*> _histograms;
+		///Keep the ROOT file in memory (a TMemFile) instead of on disk.
+		bool _inMemory;
 
 		///A class to handle redirecting stderr
 		/**The class redirects stderr to a text file and also saves output in case the user
@@ -44,15 +48,21 @@ class MCA_ROOT : public MCA {
 		};
 
 	public:
-		///Default constructor
-		MCA_ROOT(PixieInterface *pif, const char* basename);
+		///Default constructor. With inMemory the histograms are kept in a TMemFile,
+		///which a viewer may be sent with CopyTo(), and nothing is written to disk.
+		MCA_ROOT(PixieInterface *pif, const char* basename, bool inMemory = false);
 		///Defaul destructor
 		~MCA_ROOT();
-		bool StoreData(int mod, int ch);
+		bool StoreData(int mod, int ch, const PixieInterface::word_t *histo, const std::vector<unsigned int> &changed);
 		void Flush();
 		bool OpenFile(const char* basename);
 		TH1F* GetHistogram(int mod, int ch);
 		void Reset();
+		///Return the ROOT file holding the histograms.
+		TFile* GetFile() {return _file;};
+		///Copy the in-memory ROOT file to a buffer of maxsize bytes.
+		///Returns the number of bytes copied, or 0 if the file is not in memory or does not fit.
+		long long CopyTo(void *to, long long maxsize);
 		
 };
 
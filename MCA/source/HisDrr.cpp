@@ -11,13 +11,17 @@
 #include <cstdlib>
 #include <sstream>
 #include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "HisDrr.h"
 #include "DrrBlock.h"
 #include "Exceptions.h"
 
 using namespace std;
 
-HisDrr::HisDrr(fstream* drr, fstream* his) {
+HisDrr::HisDrr(fstream* drr, fstream* his) : hisMap(NULL), hisMapSize(0) {
     /* test of size of int and short */
     if ( sizeof(unsigned short) != 2 || sizeof(unsigned int) != 4 ) {
         stringstream err;
@@ -47,7 +51,7 @@ HisDrr::HisDrr(fstream* drr, fstream* his) {
     loadDrr();
 }
 
-HisDrr::HisDrr(const string &drr, const string &his) {
+HisDrr::HisDrr(const string &drr, const string &his) : hisName(his), hisMap(NULL), hisMapSize(0) {
     /* test of size of int and short */
     if ( sizeof(unsigned short) != 2 || sizeof(unsigned int) != 4 ) {
         stringstream err;
@@ -77,7 +81,7 @@ HisDrr::HisDrr(const string &drr, const string &his) {
     loadDrr();
 }
 
-HisDrr::HisDrr(const string &drr, const string &his, const string &input) {
+HisDrr::HisDrr(const string &drr, const string &his, const string &input) : hisName(his), hisMap(NULL), hisMapSize(0) {
     /* test of size of int and short */
     if ( sizeof(unsigned short) != 2 || sizeof(unsigned int) != 4 ) {
         stringstream err;
@@ -654,3 +658,86 @@ void HisDrr::setValue(const int id, vector<unsigned short> &value){
 
 }
 
+bool HisDrr::mapHis() {
+    if (hisMap != NULL)
+        return true;
+    if (hisName.empty())
+        return false;
+
+    // Everything written through the stream has to be in the file first
+    hisFile->flush();
+
+    int fd = open(hisName.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    hisMap = (char*)map;
+    hisMapSize = st.st_size;
+    return true;
+}
+
+unsigned int* HisDrr::getMappedData(int id) {
+    if (hisMap == NULL)
+        return NULL;
+
+    // First we search if histogram id exists
+    int index = -1;
+    for (unsigned int i = 0; i < hisList.size(); ++i)
+        if (hisList[i].hisID == id) {
+            index = i;
+            break;
+        }
+
+    if (index < 0) {
+        stringstream err;
+        err << "HisDrr:26: Could not find spectrum id = " << id << " in drr file";
+        string msg = err.str();
+        throw GenError(msg);
+    }
+
+    if (hisList[index].halfWords*2 != sizeof(unsigned int)) {
+        stringstream err;
+        err << "HisDrr:27: Channel size " << hisList[index].halfWords*2 << " bytes, mismatches requested variables of size " << sizeof(unsigned int) << " bytes ";
+        string msg = err.str();
+        throw GenError(msg);
+    }
+
+    // Lenght of data is equal to product of all histogram dimensions lengths
+    unsigned int length = 1;
+    for (int i = 0; i < hisList[index].hisDim; ++i)
+        length = length * hisList[index].scaled[i];
+    if ((size_t)hisList[index].offset*2 + length*sizeof(unsigned int) > hisMapSize) {
+        stringstream err;
+        err << "HisDrr:28: Histogram id " << id << " exceedes size of his file";
+        string msg = err.str();
+        throw GenError(msg);
+    }
+
+    // Offset is given in units of 2 bytes
+    return (unsigned int*)(hisMap + hisList[index].offset*2);
+}
+
+void HisDrr::syncHis() {
+    if (hisMap != NULL)
+        msync(hisMap, hisMapSize, MS_ASYNC);
+}
+
+void HisDrr::unmapHis() {
+    if (hisMap != NULL) {
+        munmap(hisMap, hisMapSize);
+        hisMap = NULL;
+        hisMapSize = 0;
+    }
+}
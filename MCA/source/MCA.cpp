@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <cstring>
 #include <unistd.h>
 
 #include "PixieInterface.h"
@@ -9,7 +10,7 @@
 #include "Utility.h"
 
 ///Default constructor
-MCA::MCA(PixieInterface *pif) : _pif(pif){
+MCA::MCA(PixieInterface *pif) : _pif(pif), _refresh(0.5), _storeAll(true){
 	time(&start_time);
 }
 
@@ -38,7 +39,7 @@ void MCA::Run(float duration, bool *stop) {
 		if(stop != NULL && *stop){ break; }
 		else if(duration > 0.0 && (difftime(stop_time, start_time) >= duration)){ break; } // Adds support for infinite MCA runs
 	
-		sleep(2);
+		usleep(_refresh * 1e6);
 		
 		//Update run time
 		std::cout << "|" << std::fixed << std::setprecision(2) << GetRunTime()  << " s |\r" << std::flush; 
@@ -49,18 +50,11 @@ void MCA::Run(float duration, bool *stop) {
 			break;
 		}
 
-		//Store the MCA data via the inherited method StoreData()
-		for (int mod = 0;mod < _pif->GetNumberCards(); mod++) {
-			for (unsigned int ch = 0; ch < _pif->GetNumberChannels(); ch++) {
-				StoreData(mod, ch);
-			}
+		//Store the MCA data which changed via the inherited method StoreData()
+		if (!Update()) {
+			std::cout << Display::ErrorStr("Run TERMINATED") << std::endl;
+			break;
 		}
-		
-		//Flush the data to disk.
-		Flush();
-		
-		//Update the timer.
-		time(&stop_time);
 	}
 
 	//End the run
@@ -81,17 +75,65 @@ void MCA::Run(float duration, bool *stop) {
 bool MCA::Step(){
 	if(!_pif || !_pif->CheckRunStatus()){ return false; }
 
-	//Store the MCA data via the inherited method StoreData()
+	//Store the MCA data which changed via the inherited method StoreData()
+	return Update();
+}
+
+/**All histograms are read in one pass (each module in its own thread if
+ * parallel module access is enabled) and compared with the previous read.
+ * Only channels with new counts are passed to StoreData(), along with the
+ * list of bins which changed, and the output is only flushed if anything
+ * changed.
+ */
+bool MCA::Update(){
+	BeginUpdate();
+	if (!_pif->ReadHistograms(_histo.data(), ADC_SIZE)) {
+		CancelUpdate();
+		return false;
+	}
+	return FinishUpdate();
+}
+
+void MCA::BeginUpdate(){
+	size_t size = _pif->GetNumberCards() * _pif->GetNumberChannels() * ADC_SIZE;
+	_storeAll = (_histo.size() != size);
+	if (_storeAll) {
+		_histo.assign(size, 0);
+		_prev.assign(size, 0);
+	}
+
+	//Keep the last read as the reference and read over the one before.
+	_histo.swap(_prev);
+}
+
+bool MCA::ReadChannel(int mod, int ch){
+	size_t nChan = _pif->GetNumberChannels();
+	return _pif->ReadHistogram(&_histo[(mod * nChan + ch) * ADC_SIZE], ADC_SIZE, mod, ch);
+}
+
+bool MCA::FinishUpdate(){
+	size_t nChan = _pif->GetNumberChannels();
+	bool changed = _storeAll;
 	for (int mod = 0; mod < _pif->GetNumberCards(); mod++) {
-		for (unsigned int ch = 0; ch < _pif->GetNumberChannels(); ch++) {
-			StoreData(mod, ch);
+		for (unsigned int ch = 0; ch < nChan; ch++) {
+			const PixieInterface::word_t *curr = &_histo[(mod * nChan + ch) * ADC_SIZE];
+			const PixieInterface::word_t *last = &_prev[(mod * nChan + ch) * ADC_SIZE];
+			if (memcmp(curr, last, ADC_SIZE * sizeof(PixieInterface::word_t)) == 0) continue;
+
+			_changed.clear();
+			for (unsigned int i = 0; i < ADC_SIZE; i++) {
+				if (curr[i] != last[i]) _changed.push_back(i);
+			}
+			StoreData(mod, ch, curr, _changed);
+			changed = true;
 		}
 	}
-	
+	_storeAll = false;
+
 	//Flush the data to disk.
-	Flush();
-	
+	if (changed) Flush();
+
 	time(&stop_time);
-	
+
 	return true;
 }
@@ -27,24 +27,53 @@ bool MCA_DAMM::OpenFile(const char* basename) {
 	_histogram = new HisDrr(drr, his, input);
 	cout << Display::OkayStr() << endl;
 
+	//Updates are copied straight into the mapped his file, so damm sees live data.
+	if (!_histogram->mapHis())
+		cout << Display::WarningStr("Unable to map ") << his << ", histograms are written through the file stream" << endl;
+
 	return (_isOpen = true);
 }
 
-bool MCA_DAMM::StoreData(int mod, int ch) {
-	PixieInterface::word_t histo[ADC_SIZE];
-
-	_pif->ReadHistogram(histo, ADC_SIZE, mod, ch);
+bool MCA_DAMM::StoreData(int mod, int ch, const PixieInterface::word_t *histo, const std::vector<unsigned int> &changed) {
+	static const unsigned int binning = ADC_SIZE / HIS_SIZE;
 
 	int id = (mod + 1) * 100 + ch;
 
-	vector<unsigned int> data;
-	data.resize(HIS_SIZE, 0);
+	//Rebin in place in the mapped his file if possible.
+	unsigned int *data = _histogram->getMappedData(id);
+	vector<unsigned int> *spectrum = NULL;
+	if (!data) {
+		spectrum = &_spectra[id];
+		spectrum->resize(HIS_SIZE, 0);
+		data = spectrum->data();
+	}
+
+	//Rebin only the DAMM channels containing a changed ADC bin. The changed
+	//bins are in order, so a DAMM channel is never listed twice.
+	vector<unsigned int> bins;
+	for (size_t i = 0; i < changed.size(); i++) {
+		unsigned v = changed[i] / binning;
+		if (!bins.empty() && bins.back() == v) continue;
+		unsigned int sum = 0;
+		for (unsigned int j = v * binning; j < (v + 1) * binning; j++)
+			sum += histo[j];
+		data[v] = sum;
+		bins.push_back(v);
+	}
+	if (!spectrum) return true;
 
-	for (size_t i = 0; i < ADC_SIZE; i++) {
-		unsigned v = static_cast<unsigned>(i / (ADC_SIZE / HIS_SIZE ));
-		data[v] += histo[i];
+	//Each single channel write seeks in the file, so write the whole spectrum if many changed.
+	if (bins.size() > HIS_SIZE / 64) {
+		_histogram->setValue(id, *spectrum);
+	}
+	else {
+		for (size_t i = 0; i < bins.size(); i++)
+			_histogram->setValue(id, bins[i], data[bins[i]]);
 	}
-	_histogram->setValue(id, data);
 
 	return true;
 }
+
+void MCA_DAMM::Flush() {
+	_histogram->syncHis();
+}
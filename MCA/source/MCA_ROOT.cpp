@@ -1,12 +1,13 @@
 #include "MCA_ROOT.h"
 
 #include <TFile.h>
+#include <TMemFile.h>
 #include <TH1F.h>
 
 #include "Display.h"
 
-MCA_ROOT::MCA_ROOT(PixieInterface *pif, const char *basename) :
-	MCA(pif)
+MCA_ROOT::MCA_ROOT(PixieInterface *pif, const char *basename, bool inMemory) :
+	MCA(pif), _inMemory(inMemory)
 {
 	OpenFile(basename);
 }
@@ -20,12 +21,13 @@ MCA_ROOT::~MCA_ROOT() {
 
 bool MCA_ROOT::OpenFile(const char* basename) {
 
-	std::string message = std::string("Creating new empty ROOT histogram ") + basename + std::string(".root");
+	std::string message = std::string("Creating new empty ") + (_inMemory ? "in-memory " : "") + std::string("ROOT histogram ") + basename + std::string(".root");
 	Display::LeaderPrint(message);
 	//We redirect stderr, to catch ROOT error messages
 	cerr_redirect *redirect = new cerr_redirect("Pixie16msg.txt");
 	//Try and open the file
-	_file = new TFile(Form("%s.root",basename),"RECREATE");
+	if (_inMemory) _file = new TMemFile(Form("%s.root",basename),"RECREATE");
+	else _file = new TFile(Form("%s.root",basename),"RECREATE");
 	_isOpen = _file->IsOpen() && _file->IsWritable();
 	if (Display::StatusPrint(!_isOpen)) {
 		//Print out the ROOT error message
@@ -36,10 +38,10 @@ bool MCA_ROOT::OpenFile(const char* basename) {
 	delete redirect;
 
 	//Loop over the number of cards and channels to build the histograms.
+	_histograms.assign(_pif->GetNumberCards() * _pif->GetNumberChannels(), nullptr);
 	for (int card=0;card < _pif->GetNumberCards();card++) {
 		for (unsigned int ch=0;ch < _pif->GetNumberChannels();ch++) {
-			int id = (card + 1) * 100 + ch;
-			_histograms[id] = new TH1F(Form("h%d%02d",card,ch),Form("Mod %d Ch %d",card,ch),ADC_SIZE,0,ADC_SIZE);
+			_histograms[card * _pif->GetNumberChannels() + ch] = new TH1F(Form("h%d%02d",card,ch),Form("Mod %d Ch %d",card,ch),ADC_SIZE,0,ADC_SIZE);
 		}
 	}
 	_file->Write(0,TObject::kWriteDelete);
@@ -49,26 +51,28 @@ bool MCA_ROOT::OpenFile(const char* basename) {
 }
 
 TH1F* MCA_ROOT::GetHistogram(int mod, int ch) {
-	int id = (mod + 1) * 100 + ch;
-	auto loc = _histograms.find(id);
-	TH1F* histogram = nullptr;
-	if (loc != _histograms.end())
-		histogram = loc->second;
+	if (mod < 0 || ch < 0 || (size_t)ch >= _pif->GetNumberChannels()) return nullptr;
+	size_t index = mod * _pif->GetNumberChannels() + ch;
+	if (index >= _histograms.size()) return nullptr;
 
-	return histogram;
+	return _histograms[index];
 }
 
-bool MCA_ROOT::StoreData(int mod, int ch) {
-	PixieInterface::word_t histo[ADC_SIZE];
-
-	_pif->ReadHistogram(histo, ADC_SIZE, mod, ch);
-
+bool MCA_ROOT::StoreData(int mod, int ch, const PixieInterface::word_t *histo, const std::vector<unsigned int> &changed) {
 	TH1F *histogram = GetHistogram(mod,ch);
 	if (!histogram) return false;
 
+	//Write the bin contents straight into the histogram array (bin 0 is the underflow).
+	Float_t *contents = histogram->GetArray();
+	for (auto it = changed.begin(); it != changed.end(); ++it) {
+		contents[*it+1] = histo[*it];
+	}
+
+	double entries = 0;
 	for (size_t i = 0; i < ADC_SIZE; i++) {
-		histogram->SetBinContent(i+1,histo[i]);
+		entries += histo[i];
 	}
+	histogram->SetEntries(entries);
 
   return true;
 
@@ -76,8 +80,18 @@ bool MCA_ROOT::StoreData(int mod, int ch) {
 
 void MCA_ROOT::Reset() {
 	for (auto it = _histograms.begin(); it != _histograms.end(); ++it) 
-		it->second->Reset();
+		(*it)->Reset();
+	//The next update has to fill every bin again.
+	ClearUpdate();
 }
+
+long long MCA_ROOT::CopyTo(void *to, long long maxsize) {
+	if (!_inMemory || !_file) return 0;
+	TMemFile *memFile = static_cast<TMemFile*>(_file);
+	if (memFile->GetSize() > maxsize) return 0;
+	return memFile->CopyTo(to, maxsize);
+}
+
 void MCA_ROOT::Flush() {
 	_file->Write(0,TObject::kWriteDelete);
 	_file->Flush();
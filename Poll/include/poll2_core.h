@@ -19,6 +19,11 @@
 #define POLL2_CORE_H
 
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <condition_variable>
 
 #include "PixieInterface.h"
 #include "hribf_buffers.h"
@@ -40,6 +45,7 @@ class MCA_args{
 	bool running;
 	bool useRoot;
 	int totalTime;
+	float refresh;
 	std::string basename;
 	
 	MCA *mca;
@@ -50,6 +56,9 @@ class MCA_args{
 	MCA_args(bool useRoot_, int totalTime_, std::string basename_);
 	
 	~MCA_args();
+
+	/// Create an MCA object of the chosen type writing to basename. Returns NULL if poll2 was built without ROOT and DAMM.
+	MCA *NewMCA(PixieInterface *pif_);
 	
 	bool IsRunning(){ return running; }
 	
@@ -58,6 +67,9 @@ class MCA_args{
 	int GetTotalTime(){ return totalTime; }
 	
 	std::string GetBasename(){ return basename; }
+
+	/// Return the time between histogram updates (in seconds).
+	float GetRefresh(){ return refresh; }
 	
 	MCA *GetMCA(){ return mca; }
 	
@@ -67,6 +79,9 @@ class MCA_args{
 	
 	void SetBasename(std::string basename_){ basename = basename_; }
 
+	/// Set the time between histogram updates (in seconds).
+	void SetRefresh(float refresh_){ refresh = refresh_; }
+
 	bool Initialize(PixieInterface *pif_);
 	
 	bool Step();
@@ -96,6 +111,11 @@ struct data_pack{
 
 // Forward class declarations
 class StatsHandler;
+class SpillRing;
+class SpillMerger;
+class SpillShm;
+class StreamServer;
+class MetricsServer;
 class Client;
 class Server;
 class Terminal;
@@ -103,12 +123,32 @@ class Terminal;
 class Poll{
   private:
 	Terminal *poll_term_;
-	///A vector to store the partial events
-	std::vector<word_t> *partialEvents;
+
+	///A partial event left at the end of a module FIFO read, and how often this happens.
+	struct PartialEvent{
+		word_t *data; /// The partial event, in the FIFO read buffer.
+		size_t nWords; /// Length of the partial event, 0 if there is none.
+		unsigned long numReads; /// Number of FIFO reads of the module.
+		unsigned long numPartial; /// Number of reads which ended in a partial event.
+		unsigned long long partialWords; /// Total number of partial event words carried over.
+
+		PartialEvent() : data(NULL), nWords(0), numReads(0), numPartial(0), partialWords(0) { }
+	};
+
+	///The partial event of each module, carried to the front of the next FIFO read.
+	PartialEvent *partialEvents;
 	
 	double startTime; ///Time when the acquistion was started.
 	double lastSpillTime; ///Time when the last spill finished.
 
+	///The FIFO readout of one crate, a contiguous range of modules. Defined in poll2_core.cpp.
+	struct CrateReadout;
+
+	std::vector<unsigned short> crateSizes; ///Number of modules in each crate, empty for a single crate.
+	std::vector<CrateReadout*> crates; ///The readout of each crate. The first crate is read by RunControl.
+	std::mutex publish_mutex; ///The readout threads of the crates take turns to publish to the spill ring.
+	SpillMerger *spillMerger; ///Orders the spills of several crates in time for the broadcast.
+
   	struct tm *time_info;
 
 	Client *client; /// UDP client for network access
@@ -133,6 +173,8 @@ class Poll{
 	// System MCA flags
 	bool do_MCA_run; /// Set to true when the "mca" command is received
 	MCA_args mca_args; /// Structure to hold arguments for MCA program
+	MCA_args liveMca_args; /// Arguments of the histograms read during list-mode runs
+	bool live_mca; /// Read the onboard histograms into an MCA file during list-mode runs
 
 	// Run control variables
 	bool boot_fast; //
@@ -141,6 +183,17 @@ class Poll{
 	bool send_alarm; //
 	bool show_module_rates; //
 	bool zero_clocks; //
+	bool pipeline_readout; /// Parse the data of each module while the next module is read.
+	bool adaptive_polling; /// Size the FIFO threshold and poll interval from the measured data rate.
+	bool parallel_setup; /// Boot and set up the modules concurrently.
+	bool shm_ring; /// Share spills with scanners on this host through a shared memory ring.
+	int stream_port; /// TCP port to stream spills to remote scanners on, 0 if disabled.
+	int metrics_port; /// TCP port to serve Prometheus metrics on, 0 if disabled.
+	int readout_core; /// Core to pin the FIFO readout thread to, -1 to let it float.
+	int writer_core; /// Core to pin the disk writer thread to, -1 to let it float.
+	int broadcast_core; /// Core to pin the network broadcast thread to, -1 to let it float.
+	int readout_priority; /// SCHED_FIFO priority of the FIFO readout thread, 0 for the standard scheduler.
+	bool huge_buffers; /// Allocate the FIFO readout buffer in hugepages.
 	bool debug_mode; //
 	bool shm_mode; /// New style shared-memory mode.
 	bool pac_mode; /// Pacman shared-memory mode.
@@ -157,13 +210,35 @@ class Poll{
 	// The main output data file and related variables
 	int current_file_num;
 	PollOutputFile output_file;
+	std::mutex output_mutex; /// Guards output_file against the writer thread
+	std::future<bool> nextOutputFile; /// Continuation file being opened in the background, guarded by output_mutex
+
+	// Spill ring shared by the FIFO readout and its consumer threads
+	SpillRing *spillRing; /// Spills published by ReadFIFO
+	int writerID; /// Lossless ring consumer which writes spills to disk
+	int broadcastID; /// Lossy ring consumer which broadcasts spills onto the network
+	std::thread writerThread; /// Thread running the disk writer consumer
+	std::thread broadcastThread; /// Thread running the network broadcast consumer
+	SpillShm *spillShm; /// Shared memory ring read by scanners on this host
+	int shmID; /// Ring consumer which copies spills into spillShm
+	std::thread shmThread; /// Thread running the shared memory consumer
+	StreamServer *streamServer; /// TCP stream read by remote scanners
+	int streamID; /// Lossy ring consumer which queues spills on streamServer
+	std::thread streamThread; /// Thread running the TCP stream consumer
+	MetricsServer *metricsServer; /// HTTP endpoint serving the runtime metrics
+	std::atomic<unsigned long long> bytesWritten; /// Number of bytes written to output files
+	std::atomic<unsigned long> spillsWritten; /// Number of spills written to output files
 
 	///Pacman related variables
 	unsigned int udp_sequence; ///< The number of UDP packets transmitted.
 	unsigned int total_spill_chunks; ///< Total number of poll data spill chunks sent over the network
 
+	int pixieNode; ///<NUMA node local to the PCI bridge of the modules, -1 if unknown.
+
 	size_t n_cards;
 	size_t threshWords;
+	size_t adaptThreshWords; ///<FIFO threshold used when adaptive_polling is set.
+	unsigned int pollInterval; ///<Time between FIFO polls in us when adaptive_polling is set.
 
 	typedef std::pair<unsigned int, unsigned int> chanid_t;
 	std::map<chanid_t, PixieInterface::Histogram> histoMap;
@@ -171,6 +246,18 @@ class Poll{
 	StatsHandler *statsHandler;
 	static const int statsInterval_ = 3; ///<The amount time between scaler reads in seconds.
 
+	std::thread statsThread; ///<Thread reading the module statistics into statsCache between FIFO reads.
+	std::mutex stats_mutex; ///<Guards statsCache, statsTimes and statsRefreshes.
+	std::condition_variable statsCond; ///<Wakes statsThread when poll2 is exiting.
+	std::vector<word_t> statsCache; ///<The last statistics read from each module, STAT_SIZE words per module.
+	std::vector<time_t> statsTimes; ///<Time the statistics of each module were last read, 0 if never.
+	unsigned long statsRefreshes; ///<Number of passes of statsThread over the modules.
+
+	std::thread liveMcaThread; ///<Thread reading the onboard histograms between FIFO reads when live_mca is set.
+	std::mutex liveMca_mutex; ///<Guards liveMcaUpdates.
+	std::condition_variable liveMcaCond; ///<Wakes liveMcaThread when poll2 is exiting or live_mca is changed.
+	unsigned long liveMcaUpdates; ///<Number of histogram updates written by liveMcaThread.
+
 	const static std::vector<std::string> runControlCommands_;
 	const static std::vector<std::string> paramControlCommands_;
 	const static std::vector<std::string> pollStatusCommands_; 
@@ -199,18 +286,48 @@ class Poll{
 	/// Display polling threshold.
 	void show_thresh();
 
+	/// Display the cached statistics of a module.
+	void show_stats(int mod_);
+
 	/// Acquire raw traces from a pixie module.
 	void get_traces(int mod_, int chan_, int thresh_=0);
 
 	/// Method responsible for handling tab complete.
 	std::vector<std::string> TabComplete(const std::string &value_, const std::vector<std::string> &valid_);
 
-	///Routine to read Pixie FIFOs
-	bool ReadFIFO();
+	///Routine to read the Pixie FIFOs of a crate
+	bool ReadFIFO(unsigned int crate_=0);
+
+	///Routine to read the Pixie FIFOs of every crate
+	void ReadAllFIFOs();
+
+	///Readout loop of the crates after the first, each running in its own thread.
+	void CrateControl(unsigned int crate_);
+
+	///Pin the calling thread as the FIFO readout thread and set its scheduler.
+	void setup_readout_thread();
+
+	///Allocate the FIFO readout buffer, in hugepages if requested. Called from the readout thread.
+	word_t *alloc_fifo_buffer(const size_t &nWords);
+
+	///Size the adaptive FIFO threshold and poll interval from the module data rates.
+	void update_polling();
+
+	///Build a new metrics snapshot for the metrics endpoint.
+	void update_metrics();
+
+	///Check the FIFO data of a module and store any trailing partial event.
+	bool parse_module(unsigned short mod, word_t *modData, word_t &nWords);
 	
-	///Routine to read Pixie scalers.
+	///Fill the stats handler with the scalers cached by statsThread, without touching the modules.
 	void ReadScalers();
 
+	///Read the statistics of the modules into statsCache while a run is on. Runs in statsThread.
+	void StatsControl();
+
+	///Read the onboard histograms of the modules into an MCA file while a run is on. Runs in liveMcaThread.
+	void LiveMcaControl();
+
 	///Routine to update the status message.
 	void UpdateStatus();
 
@@ -225,11 +342,14 @@ class Poll{
 	
 	/// Opens a new file if no file is currently open.
 	bool OpenOutputFile(bool continueRun = false);
+
+	/// Switch to the continuation file opened in the background. Called from the writer thread.
+	bool RolloverOutputFile();
 	
-	/// Write a data spill to disk.
+	/// Write a data spill to disk. Called from the writer thread.
 	int write_data(word_t *data, unsigned int nWords);
 
-	/// Broadcast a data spill onto the network.
+	/// Broadcast a data spill onto the network. Called from the broadcast thread.
 	void broadcast_data(word_t *data, unsigned int nWords);
 
 	/// Broadcast a data spill onto the network in the classic pacman format.
@@ -258,6 +378,49 @@ class Poll{
 	
 	void SetZeroClocks(bool input_=true){ zero_clocks = input_; }
 	
+	void SetPipelineReadout(bool input_=true){ pipeline_readout = input_; }
+	
+	void SetAdaptivePolling(bool input_=true){ adaptive_polling = input_; }
+
+	/// Boot the modules and adjust their offsets concurrently, one thread per module.
+	void SetParallelSetup(bool input_=true){ parallel_setup = input_; }
+
+	/// Set the time between MCA histogram updates (in seconds).
+	void SetMcaRefresh(float input_){ mca_args.SetRefresh(input_); }
+
+	/// Read the onboard histograms of the modules into an MCA file during list-mode runs.
+	void SetLiveMca(bool input_=true){ live_mca = input_; }
+
+	/// Set the time between histogram reads during list-mode runs (in seconds).
+	void SetLiveMcaRefresh(float input_){ liveMca_args.SetRefresh(input_); }
+
+	/// Share spills with scanners on this host through the POLL2_SHM_NAME shared memory ring.
+	void SetShmRing(bool input_=true){ shm_ring = input_; }
+
+	/// Stream spills to remote scanners over TCP on the given port. Set to 0 to disable.
+	void SetStreamPort(int input_){ stream_port = input_; }
+
+	/// Serve Prometheus metrics over HTTP on the given port. Set to 0 to disable.
+	void SetMetricsPort(int input_){ metrics_port = input_; }
+
+	/// Pin the FIFO readout thread to a core. Set to -1 to let it float.
+	void SetReadoutCore(int input_){ readout_core = input_; }
+
+	/// Pin the disk writer thread to a core. Set to -1 to let it float.
+	void SetWriterCore(int input_){ writer_core = input_; }
+
+	/// Pin the network broadcast thread to a core. Set to -1 to let it float.
+	void SetBroadcastCore(int input_){ broadcast_core = input_; }
+
+	/// Run the FIFO readout thread with SCHED_FIFO at the given priority (1-99). Set to 0 to disable.
+	void SetReadoutPriority(int input_){ readout_priority = input_; }
+
+	/// Allocate the FIFO readout buffer in hugepages on the NUMA node of the modules.
+	void SetHugeBuffers(bool input_=true){ huge_buffers = input_; }
+
+	/// Split the modules into crates of the given sizes, each read by its own thread.
+	void SetCrates(const std::vector<unsigned short> &input_){ crateSizes = input_; }
+	
 	void SetDebugMode(bool input_=true){ debug_mode = input_; }
 	
 	void SetShmMode(bool input_=true){ shm_mode = input_; }
@@ -284,6 +447,36 @@ class Poll{
 	
 	bool GetZeroClocks(){ return zero_clocks; }
 	
+	bool GetPipelineReadout(){ return pipeline_readout; }
+	
+	bool GetAdaptivePolling(){ return adaptive_polling; }
+
+	bool GetParallelSetup(){ return parallel_setup; }
+
+	float GetMcaRefresh(){ return mca_args.GetRefresh(); }
+
+	bool GetLiveMca(){ return live_mca; }
+
+	float GetLiveMcaRefresh(){ return liveMca_args.GetRefresh(); }
+
+	bool GetShmRing(){ return shm_ring; }
+
+	int GetStreamPort(){ return stream_port; }
+
+	int GetMetricsPort(){ return metrics_port; }
+
+	int GetReadoutCore(){ return readout_core; }
+
+	int GetWriterCore(){ return writer_core; }
+
+	int GetBroadcastCore(){ return broadcast_core; }
+
+	int GetReadoutPriority(){ return readout_priority; }
+
+	bool GetHugeBuffers(){ return huge_buffers; }
+
+	size_t GetNumCrates(){ return (crateSizes.empty() ? 1 : crateSizes.size()); }
+	
 	bool GetDebugMode(){ return debug_mode; }
 	
 	bool GetShmMode(){ return shm_mode; }
@@ -0,0 +1,59 @@
+// Plain HTTP endpoint exposing the poll2 runtime metrics to Prometheus
+
+#ifndef POLL2_METRICS_H
+#define POLL2_METRICS_H
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8" /// Prometheus text exposition format
+#define METRICS_TIMEOUT 1000 /// Time allowed for a scraper to send its request, in ms
+
+/** Serves the latest metrics snapshot to any scraper which asks for /metrics.
+  * The snapshot is built by the readout thread once per stats interval and
+  * handed over with Update(), so a scrape never touches the readout data and
+  * the readout thread only takes a lock when a new snapshot is ready.
+  */
+class MetricsServer{
+  public:
+	MetricsServer() : listenSock(-1), running(false), scrapes(0) { }
+
+	~MetricsServer(){ Close(); }
+
+	/** Listen for scrapers on a port and start the thread which answers them.
+	  * \param[in]  port_ The TCP port to listen on.
+	  * \return False if the port could not be opened and true otherwise.
+	  */
+	bool Init(int port_);
+
+	/// Replace the metrics snapshot served to scrapers.
+	void Update(const std::string &text_);
+
+	/// Stop listening and wait for the server thread to exit.
+	void Close();
+
+	/// Return true if the server is listening.
+	bool IsOpen(){ return running; }
+
+	/// Return the number of scrapes answered.
+	unsigned long GetScrapes(){ return scrapes; }
+
+  private:
+	int listenSock; /// Socket accepting scrapers.
+	std::thread serverThread; /// Accepts scrapers and answers them.
+	std::atomic<bool> running; /// Set to false to stop the server thread.
+	std::atomic<unsigned long> scrapes; /// Number of scrapes answered.
+
+	std::string text; /// The latest metrics snapshot.
+	std::mutex textMutex; /// Guards text.
+
+	/// Accept scrapers until the server is closed.
+	void serve();
+
+	/// Read a single HTTP request from a scraper and send the answer.
+	void answer(int sock_);
+};
+
+#endif
@@ -0,0 +1,175 @@
+// Lock-free ring of data spills shared by the FIFO readout and its consumers
+
+#ifndef POLL2_RING_H
+#define POLL2_RING_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_MAX_CONSUMERS 4 /// Maximum number of consumers of a SpillRing
+
+/** A fixed number of spill slots shared by one producer (the FIFO readout)
+  * and up to RING_MAX_CONSUMERS consumer threads, each reading at its own
+  * pace. Every consumer sees the spills in the order they were published.
+  * Lossless consumers (the disk writer) hold up the producer once the ring is
+  * full. Lossy consumers (the network broadcaster) never hold it up; spills
+  * which were overwritten before they could be read are dropped and counted.
+  * No locks are taken, all synchronisation is done with sequence counters.
+  */
+class SpillRing{
+  public:
+	typedef uint32_t word_t;
+	typedef std::function<void(word_t*, unsigned int, bool)> ConsumeFunction;
+	typedef std::function<void(word_t*, unsigned int, bool, unsigned int)> TaggedConsumeFunction;
+	typedef std::function<void()> IdleFunction;
+
+	/// A single spill stored in the ring.
+	struct Slot{
+		std::vector<word_t> data; /// Spill storage.
+		unsigned int nWords; /// Number of words in the spill.
+		bool record; /// True if the spill is to be recorded to disk.
+		unsigned int tag; /// Tag of the producer of the spill, e.g. its crate.
+
+		Slot() : nWords(0), record(false), tag(0) { }
+	};
+
+	/// A block of words which forms part of a spill.
+	struct Segment{
+		const word_t *data; /// First word of the block.
+		unsigned int nWords; /// Number of words in the block.
+
+		Segment(const word_t *data_, unsigned int nWords_) : data(data_), nWords(nWords_) { }
+	};
+
+	SpillRing(size_t nSlots = 8);
+
+	/** Register a consumer. Must be called before spills are published.
+	  * \param[in]  lossy_ Set to true if this consumer may drop spills.
+	  * \return The ID of the new consumer, or -1 if no more consumers may be added.
+	  */
+	int AddConsumer(bool lossy_);
+
+	/// Copy a spill into the ring. Waits while a lossless consumer is a full ring behind.
+	bool Publish(const word_t *data, unsigned int nWords, bool record_=true, unsigned int tag_=0);
+
+	/** Copy a spill made up of several blocks into the ring, joining them in order.
+	  * There is only one producer, several readout threads must take turns.
+	  */
+	bool Publish(const std::vector<Segment> &segments_, bool record_=true, unsigned int tag_=0);
+
+	/** Consume spills until the ring is closed and drained. Each spill is passed to
+	  * func_ along with its record flag. Lossy consumers receive a private copy of
+	  * the spill so the producer never waits on them.
+	  */
+	void Run(int consumer_, ConsumeFunction func_);
+
+	/** Consume spills as above, also passing the tag of each spill to func_. If
+	  * given, idle_ is called whenever the consumer has caught up with the ring.
+	  */
+	void RunTagged(int consumer_, TaggedConsumeFunction func_, IdleFunction idle_=IdleFunction());
+
+	/// Block until all lossless consumers have consumed every published spill.
+	void Flush();
+
+	/// Stop accepting spills. Consumers exit once they have drained the ring.
+	void Close(){ closed = true; }
+
+	/// Return true if the ring is closed.
+	bool IsClosed(){ return closed; }
+
+	/// Return the number of slots in the ring.
+	size_t GetNumSlots(){ return slots.size(); }
+
+	/// Return the number of spills a consumer has yet to read.
+	size_t GetDepth(int consumer_);
+
+	/// Return the number of spills a lossy consumer has dropped.
+	unsigned long GetDropped(int consumer_);
+
+	/// Return the number of times the producer waited on a lossless consumer.
+	unsigned long GetStalls(){ return stalls; }
+
+	/// Return the total number of spills published.
+	unsigned long long GetPublished(){ return head; }
+
+  private:
+	/// Read position of a single consumer.
+	struct Consumer{
+		std::atomic<unsigned long long> tail; /// Sequence number of the next spill to read.
+		std::atomic<unsigned long long> busy; /// Sequence number (+1) of the slot being read by a lossy consumer, 0 if idle.
+		std::atomic<unsigned long> dropped; /// Number of spills dropped.
+		bool lossy; /// True if this consumer may drop spills.
+	};
+
+	std::vector<Slot> slots; /// Spill storage.
+	Consumer consumers[RING_MAX_CONSUMERS]; /// Registered consumers.
+	int numConsumers; /// Number of registered consumers.
+
+	std::atomic<unsigned long long> head; /// Sequence number of the next spill to publish.
+	std::atomic<unsigned long long> writing; /// Sequence number (+1) of the slot being written by the producer.
+	std::atomic<bool> closed; /// Set to true when no more spills are published.
+	std::atomic<unsigned long> stalls; /// Number of times the producer waited for a lossless consumer.
+
+	/** Get the next spill for a consumer, or NULL if none is available. A lossy
+	  * consumer which fell behind skips ahead to the oldest spill still in the ring.
+	  */
+	Slot *acquire(const int &consumer_, unsigned long long &seq_);
+};
+
+/** Passes on the spills of several crates in the order of their first hardware
+  * time stamp. A spill is held until every crate has a spill waiting, since a
+  * crate could still send an earlier one. A crate without data sends nothing, so
+  * spills are also passed on once a crate has maxHeld_ spills waiting, or once
+  * a spill has waited for maxWait_ seconds (checked by Expire).
+  */
+class SpillMerger{
+  public:
+	typedef SpillRing::word_t word_t;
+	typedef std::function<void(word_t*, unsigned int)> OutputFunction;
+
+	SpillMerger(unsigned int nCrates_, OutputFunction func_, size_t maxHeld_=4, double maxWait_=1.0);
+
+	/// Queue a spill of a crate and pass on every spill which is known to come next.
+	void Add(const word_t *data_, unsigned int nWords_, unsigned int crate_);
+
+	/// Pass on the spills which have waited for longer than maxWait.
+	void Expire();
+
+	/// Pass on every queued spill, in time order.
+	void Flush();
+
+	/// Return the number of spills waiting to be passed on.
+	size_t GetHeld();
+
+	/** Return the earliest time stamp of the first events of the module buffers of a
+	  * spill, or false if the spill holds no events.
+	  */
+	static bool GetStartTime(const word_t *data_, unsigned int nWords_, unsigned long long &time_);
+
+  private:
+	typedef std::chrono::steady_clock clock;
+
+	/// A spill waiting to be passed on.
+	struct Spill{
+		std::vector<word_t> data; /// The spill.
+		unsigned long long time; /// Time stamp of its first event.
+		clock::time_point arrival; /// When the spill was queued.
+	};
+
+	std::vector<std::deque<Spill> > queues; /// Spills waiting for each crate.
+	std::vector<unsigned long long> lastTime; /// Start time of the last spill of each crate.
+	OutputFunction func; /// Receives the spills in time order.
+	size_t maxHeld; /// Most spills held for a single crate.
+	double maxWait; /// Longest time a spill is held, in seconds.
+
+	/// Pass on the earliest spill at the front of the queues. Return false if all are empty.
+	bool pop();
+};
+
+#endif
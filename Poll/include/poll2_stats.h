@@ -3,8 +3,58 @@
 #ifndef POLL2_STATS_H
 #define POLL2_STATS_H
 
+#include <vector>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
 #define NUM_CHAN_PER_MOD 16
 
+#define STATS_FRAME_MAGIC 0x54415453 /// Start of every stats frame ("STAT")
+#define STATS_FRAME_VERSION 2 /// Version of the stats frame layout
+#define STATS_FRAME_MAX 65507 /// Maximum size of a stats frame, in bytes (one UDP datagram)
+
+// Below is the stats frame structure (for N modules of M channels)
+// ---------------------------------------------------------------
+// StatsFrameHeader
+// StatsFrameModule for module 0 ... N-1
+// StatsFrameChannel for module 0, channel 0 ... M-1, then module 1 ... N-1
+// All fields are in host byte order and naturally aligned, so the frame
+// may be decoded by casting or copying it onto these structures.
+
+/// Header of a stats frame.
+struct StatsFrameHeader{
+	uint32_t magic; /// STATS_FRAME_MAGIC
+	uint32_t version; /// STATS_FRAME_VERSION
+	uint32_t numCards; /// Number of module records which follow.
+	uint32_t numChannels; /// Number of channel records per module.
+	uint64_t sequence; /// Number of frames sent before this one.
+	double totalTime; /// Total time of the run, in seconds.
+	double interval; /// Time covered by the rates in this frame, in seconds.
+	double dataRate; /// Total data rate, in B/s.
+};
+
+/// Per module part of a stats frame.
+struct StatsFrameModule{
+	double dataRate; /// Data rate, in B/s.
+	double realTime; /// Real time reported by the module, in seconds.
+	uint32_t fifoWords; /// Number of words in the FIFO at the last read.
+	uint32_t fifoPeak; /// Largest number of words in the FIFO during the interval.
+	uint32_t fifoLength; /// Size of the FIFO, in words.
+	uint32_t reserved; /// Keeps the frame aligned.
+};
+
+/// Per channel part of a stats frame.
+struct StatsFrameChannel{
+	double inputCountRate; /// Input count rate reported by the module, in Hz.
+	double outputCountRate; /// Output count rate reported by the module, in Hz.
+	double eventRate; /// Rate of events read out during the interval, in Hz.
+	double liveTime; /// Live time reported by the module, in seconds.
+	double liveFraction; /// Fraction of the real time the channel was live during the interval.
+	uint64_t totalEvents; /// Number of events read out during the run.
+};
+
 class Client;
 
 class StatsHandler{
@@ -14,6 +64,9 @@ class StatsHandler{
     ~StatsHandler();
 
     void AddEvent(unsigned int mod, unsigned int ch, size_t size, int delta_=1);
+
+	///Add the events of a module read at once, counts_ holding the number of events of each of its NUM_CHAN_PER_MOD channels and size the bytes of the events.
+	void AddEvents(unsigned int mod, const unsigned int *counts_, size_t size);
     
     bool AddTime(double dtime);
 
@@ -31,6 +84,28 @@ class StatsHandler{
 
 	///Set the ICR and OCR from the XIA module.
 	void SetXiaRates(int mod, std::vector<std::pair<double,double>> *xiaRates); 
+
+	///Set the live time of each channel and the real time from the XIA module, in seconds.
+	void SetXiaTimes(int mod, std::vector<double> *liveTimes, double realTime);
+
+	///Set the number of words found in a module's FIFO when it was read.
+	void SetFifoWords(unsigned int mod, unsigned int words){
+		if(mod >= numCards){ return; }
+		fifoWords[mod] = words;
+		if(words > fifoPeak[mod]){ fifoPeak[mod] = words; }
+	}
+
+	///Set the size of the module FIFOs, in words.
+	void SetFifoLength(unsigned int length){ fifoLength = length; }
+
+	///Return the number of words in a module's FIFO at the last read.
+	unsigned int GetFifoWords(size_t mod){ return fifoWords[mod]; }
+
+	///Return the largest number of words in a module's FIFO since the rates were cleared.
+	unsigned int GetFifoPeak(size_t mod){ return fifoPeak[mod]; }
+
+	///Return the size of the module FIFOs, in words.
+	unsigned int GetFifoLength(){ return fifoLength; }
 	
 	bool CanSend(){ return is_able_to_send; }
 	
@@ -48,7 +123,7 @@ class StatsHandler{
     unsigned int **nEventsDelta;
     
     /** total number of events for each channel */
-    unsigned int **nEventsTotal; 
+    unsigned long long **nEventsTotal; 
     
     /** data in bytes this tick per module*/
     size_t *dataDelta;
@@ -61,6 +136,16 @@ class StatsHandler{
     
     double **inputCountRate; ///<The XIA Module input count rate.
     double **outputCountRate; ///<The XIA Module output count rate.
+    double **liveTime; ///<The XIA Module live time, in seconds.
+    double **liveFraction; ///<Fraction of the last interval each channel was live.
+    double *realTime; ///<The XIA Module real time, in seconds.
+    
+    /** words in each module FIFO at the last read, and the peak this tick */
+    unsigned int *fifoWords;
+    unsigned int *fifoPeak;
+    
+    /** size of the module FIFOs in words */
+    unsigned int fifoLength;
     
     /** calculated data rate in bytes per second for each module */
     size_t *calcDataRate;
@@ -79,6 +164,9 @@ class StatsHandler{
 
 	bool is_able_to_send; /// Is StatsHandler able to send on the network?
 
+	std::vector<char> frame; /// Preallocated stats frame.
+	uint64_t numFrames; /// Number of stats frames sent.
+
 };
 
 #endif
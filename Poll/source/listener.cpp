@@ -1,23 +1,61 @@
 /** \file listener.cpp
-  * 
-  * \brief Receives and decodes packets broadcast by poll2
-  * 
+  *
+  * \brief Receives the spills broadcast by poll2 and measures their transport
+  *
   * \author Cory R. Thornsberry
-  * 
+  *
   * \date April 20th, 2015
-  * 
-  * \version 1.0
+  *
+  * \version 2.0
+  *
+  * Subscribes to the poll2 spills over udp (the shm port), over the tcp spill
+  * stream or through the shared memory ring, and reports for every interval
+  * the data rate, the lost and out-of-order chunks, the gaps between packets,
+  * the time taken to assemble a spill and the fill of the receive buffer. It
+  * is used to size the socket buffers and to choose the transport of a
+  * deployment. The spill notifications which poll2 sends when it is not in
+  * shm mode are decoded as well.
 */
 
 #include <iostream>
-#include <string.h>
-#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
 #include <cmath>
 
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/sock_diag.h>
+
 #include "poll2_socket.h"
+#include "poll2_stream.h"
+#include "poll2_shm.h"
+
+#define GAP_DECADES 6 /// Number of bins of the inter-packet gap histogram, one per decade from 10 us
+#define SPILL_TIMEOUT 1.0 /// Time without a chunk after which a spill is finished, in s
+#define REORDER_WINDOW POLL2_SOCKET_BATCH /// Chunk 1 this far behind the highest chunk starts a new spill
+#define MAX_DATAGRAM 65536 /// Largest datagram received, in bytes
+
+/// Set by the signal handler to stop listening and print the totals.
+volatile sig_atomic_t stop_listening = 0;
 
-typedef std::chrono::high_resolution_clock hr_clock;
-typedef std::chrono::high_resolution_clock::time_point hr_time;
+void handle_signal(int){ stop_listening = 1; }
+
+/// Return the wall clock time in seconds, the clock of the kernel packet time stamps.
+double wall_time(){
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return now.tv_sec + 1E-9 * now.tv_nsec;
+}
 
 /// Find the order of magnitude of an input double
 int order(double input_){
@@ -39,146 +77,676 @@ int order(double input_){
 	return 999;
 }
 
-int main(){
-	char buffer[1024];
-	Server poll_server;
-	
-	size_t total_size;
-	int spillID, buffSize;
-	int end_packet_flag;
-	std::streampos file_size;
-	std::streampos new_size;
-	
-	hr_time clock1;
-	hr_time clock2;
-	double dT;
-	std::chrono::duration<double> time_span;
-	
-	size_t size_of_int; // The first byte is always the size of an integer on the sending machine
-	size_t size_of_spos; // The second byte is always the size of a std::streampos type on the sending machine
-	
-	std::cout << " Size of integer on this machine: " << sizeof(int) << " bytes\n";
-	std::cout << " Size of streampos on this machine: " << sizeof(std::streampos) << " bytes\n";
-	
+/// Return a number of bytes (or bytes/s for unit_ = "B/s") with a metric prefix.
+std::string format_bytes(double bytes_, const char *unit_="B"){
+	std::stringstream stream;
+	stream << std::setprecision(3);
+	int magnitude = order(bytes_);
+	if(magnitude < 3){ stream << bytes_ << " " << unit_; }
+	else if(magnitude < 6){ stream << bytes_/1E3 << " k" << unit_; }
+	else if(magnitude < 9){ stream << bytes_/1E6 << " M" << unit_; }
+	else{ stream << bytes_/1E9 << " G" << unit_; }
+	return stream.str();
+}
+
+/// Return a time in seconds with a metric prefix.
+std::string format_time(double seconds_){
+	std::stringstream stream;
+	stream << std::setprecision(3);
+	int magnitude = order(seconds_);
+	if(magnitude > -3){ stream << seconds_ << " s"; }
+	else if(magnitude > -6){ stream << seconds_/1E-3 << " ms"; }
+	else if(magnitude > -9){ stream << seconds_/1E-6 << " us"; }
+	else{ stream << seconds_/1E-9 << " ns"; }
+	return stream.str();
+}
+
+/// Number, mean and extremes of a set of values.
+struct Summary{
+	unsigned long long count;
+	double sum, min, max;
+
+	Summary(){ Reset(); }
+
+	void Reset(){ count = 0; sum = 0; min = 0; max = 0; }
+
+	void Add(const double &value_){
+		if(count == 0 || value_ < min){ min = value_; }
+		if(count == 0 || value_ > max){ max = value_; }
+		sum += value_;
+		count++;
+	}
+
+	void Merge(const Summary &other_){
+		if(other_.count == 0){ return; }
+		if(count == 0 || other_.min < min){ min = other_.min; }
+		if(count == 0 || other_.max > max){ max = other_.max; }
+		sum += other_.sum;
+		count += other_.count;
+	}
+
+	double Mean() const { return (count > 0 ? sum/count : 0.0); }
+
+	/// Return the mean and extremes as times (or as bytes if time_ is false).
+	std::string Print(bool time_=true) const {
+		std::stringstream stream;
+		if(time_){ stream << "mean " << format_time(Mean()) << ", min " << format_time(min) << ", max " << format_time(max); }
+		else{ stream << "mean " << format_bytes(Mean()) << ", min " << format_bytes(min) << ", max " << format_bytes(max); }
+		stream << " (" << count << ")";
+		return stream.str();
+	}
+};
+
+/// Counters of the transport over an interval or over the whole run.
+struct TransportStats{
+	double start; /// Time at which the counters were reset, in s.
+	unsigned long long packets; /// Datagrams, frames or spills received.
+	unsigned long long bytes; /// Bytes received, including the chunk and frame headers.
+	unsigned long long spills; /// Complete spills received.
+	unsigned long long fragmented; /// Spills which are missing at least one chunk.
+	unsigned long long dropped; /// Whole spills dropped by poll2 or overwritten in the ring, or missed spill notifications.
+	unsigned long long chunksExpected; /// Chunks of the finished spills.
+	unsigned long long chunksLost; /// Chunks of the finished spills which never arrived.
+	unsigned long long outOfOrder; /// Chunks which arrived after a later chunk of their spill.
+	unsigned long long kernelDrops; /// Datagrams dropped by the kernel because the receive buffer was full.
+	unsigned long long unknown; /// Packets which are neither chunks, notifications nor poll2 flags.
+	unsigned long long notifications; /// Spill notifications received.
+	long long fileBytes; /// Growth of the poll2 output file, from the spill notifications.
+	Summary gaps; /// Time between consecutive packets of the same spill, in s.
+	Summary periods; /// Time between the starts of consecutive spills, in s.
+	Summary latency; /// Time from the first to the last packet of a spill, in s.
+	Summary spillBytes; /// Size of the spills, in bytes.
+	unsigned long long gapDecades[GAP_DECADES]; /// Gaps below 10 us, 100 us, 1 ms, 10 ms, 100 ms and above.
+	int peakQueued; /// Largest fill of the receive buffer in bytes (or of the ring in spills).
+
+	TransportStats(){ Reset(0.0); }
+
+	void Reset(double now_){
+		start = now_;
+		packets = bytes = spills = fragmented = dropped = 0;
+		chunksExpected = chunksLost = outOfOrder = kernelDrops = unknown = notifications = 0;
+		fileBytes = 0;
+		gaps.Reset();
+		periods.Reset();
+		latency.Reset();
+		spillBytes.Reset();
+		for(int i = 0; i < GAP_DECADES; i++){ gapDecades[i] = 0; }
+		peakQueued = 0;
+	}
+
+	void AddGap(double gap_){
+		gaps.Add(gap_);
+		int decade = 0;
+		for(double limit = 1E-5; decade < GAP_DECADES - 1 && gap_ >= limit; limit *= 10.0){ decade++; }
+		gapDecades[decade]++;
+	}
+
+	void Queued(int queued_){
+		if(queued_ > peakQueued){ peakQueued = queued_; }
+	}
+
+	/// Add the counters of an interval to the totals.
+	void Merge(const TransportStats &other_){
+		packets += other_.packets;
+		bytes += other_.bytes;
+		spills += other_.spills;
+		fragmented += other_.fragmented;
+		dropped += other_.dropped;
+		chunksExpected += other_.chunksExpected;
+		chunksLost += other_.chunksLost;
+		outOfOrder += other_.outOfOrder;
+		kernelDrops += other_.kernelDrops;
+		unknown += other_.unknown;
+		notifications += other_.notifications;
+		fileBytes += other_.fileBytes;
+		gaps.Merge(other_.gaps);
+		periods.Merge(other_.periods);
+		latency.Merge(other_.latency);
+		spillBytes.Merge(other_.spillBytes);
+		for(int i = 0; i < GAP_DECADES; i++){ gapDecades[i] += other_.gapDecades[i]; }
+		Queued(other_.peakQueued);
+	}
+};
+
+/// Prints the counters of every interval and the totals of the run.
+class Reporter{
+  public:
+	/** \param[in]  transport_ Name of the transport being measured.
+	  * \param[in]  interval_ Length of an interval, in s.
+	  * \param[in]  log_ Print the intervals one after the other instead of clearing the screen.
+	  * \param[in]  slots_ The receive buffer is a ring of spill slots rather than bytes.
+	  */
+	Reporter(const std::string &transport_, double interval_, bool log_, bool slots_) : transport(transport_), interval(interval_), log(log_), slots(slots_) {
+		double now = wall_time();
+		current.Reset(now);
+		total.Reset(now);
+	}
+
+	/// Return the counters of the current interval.
+	TransportStats &Stats(){ return current; }
+
+	/// Set a line describing the state of the sender, printed with every interval.
+	void SetNote(const std::string &note_){ note = note_; }
+
+	/// Print the current interval and start the next one if it is over.
+	void Update(double now_, int capacity_){
+		if(now_ - current.start < interval){ return; }
+		if(!log){ system("clear"); }
+		std::cout << " " << transport << ", last " << format_time(now_ - current.start) << ":\n";
+		print(current, now_ - current.start, capacity_);
+		total.Merge(current);
+		current.Reset(now_);
+	}
+
+	/// Print the totals of the run and what they suggest for the deployment.
+	void Finish(double now_, int capacity_){
+		total.Merge(current);
+		current.Reset(now_);
+		double elapsed = now_ - total.start;
+
+		std::cout << "\n " << transport << ", total over " << format_time(elapsed) << ":\n";
+		print(total, elapsed, capacity_);
+
+		if(capacity_ > 0 && !slots && (total.kernelDrops > 0 || total.peakQueued > capacity_ / 2)){
+			double needed = std::max(2.0 * total.spillBytes.max, 2.0 * total.peakQueued);
+			std::cout << "  The receive buffer filled up to " << 100.0 * total.peakQueued / capacity_ << "%, raise it with --buffer (and net.core.rmem_max) to at least " << format_bytes(needed) << ".\n";
+		}
+		if(total.chunksLost > total.kernelDrops){
+			std::cout << "  " << total.chunksLost - std::min(total.chunksLost, total.kernelDrops) << " chunks were lost before reaching this host, consider the tcp stream.\n";
+		}
+		if(slots && capacity_ > 0 && total.dropped > 0){
+			std::cout << "  Spills were overwritten in the ring, give poll2 more slots or read the ring faster.\n";
+		}
+		else if(!slots && total.dropped > 0 && total.chunksExpected == 0 && total.notifications == 0){
+			std::cout << "  poll2 dropped spills for this subscriber, the link or this host cannot sustain the rate.\n";
+		}
+	}
+
+  private:
+	std::string transport;
+	double interval;
+	bool log;
+	bool slots;
+	std::string note;
+
+	TransportStats current; /// Counters of the current interval.
+	TransportStats total; /// Counters of the finished intervals.
+
+	void print(const TransportStats &stats_, double elapsed_, int capacity_){
+		if(elapsed_ <= 0.0){ elapsed_ = 1.0; }
+		std::cout << "  Data rate: " << format_bytes(stats_.bytes / elapsed_, "B/s") << " (" << stats_.packets << " packets, " << format_bytes(stats_.bytes) << ")\n";
+		std::cout << "  Spills: " << stats_.spills << " complete, " << stats_.fragmented << " fragmented, " << stats_.dropped << " dropped\n";
+		if(stats_.chunksExpected > 0 || stats_.kernelDrops > 0){
+			std::cout << "  Chunk loss: " << stats_.chunksLost << " of " << stats_.chunksExpected << " (" << 100.0 * stats_.chunksLost / std::max(stats_.chunksExpected, 1ULL) << "%), ";
+			std::cout << stats_.outOfOrder << " out of order, " << stats_.kernelDrops << " dropped by the kernel\n";
+		}
+		if(stats_.gaps.count > 0){
+			std::cout << "  Inter-packet gap: " << stats_.gaps.Print() << "\n";
+			std::cout << "   <10us: " << stats_.gapDecades[0] << ", <100us: " << stats_.gapDecades[1] << ", <1ms: " << stats_.gapDecades[2];
+			std::cout << ", <10ms: " << stats_.gapDecades[3] << ", <100ms: " << stats_.gapDecades[4] << ", >=100ms: " << stats_.gapDecades[5] << "\n";
+		}
+		if(stats_.periods.count > 0){ std::cout << "  Spill period: " << stats_.periods.Print() << "\n"; }
+		if(stats_.latency.count > 0){ std::cout << "  Spill assembly latency: " << stats_.latency.Print() << "\n"; }
+		if(stats_.spillBytes.count > 0){ std::cout << "  Spill size: " << stats_.spillBytes.Print(false) << "\n"; }
+		if(slots){ std::cout << "  Ring backlog: peak " << stats_.peakQueued << " of " << capacity_ << " spills\n"; }
+		else if(capacity_ > 0){ std::cout << "  Receive buffer: peak " << format_bytes(stats_.peakQueued) << " of " << format_bytes(capacity_) << " (" << 100.0 * stats_.peakQueued / capacity_ << "%)\n"; }
+		if(stats_.notifications > 0){ std::cout << "  File growth: " << format_bytes(stats_.fileBytes / elapsed_, "B/s") << " (" << stats_.notifications << " notifications)\n"; }
+		if(stats_.unknown > 0){ std::cout << "  Unknown packets: " << stats_.unknown << "\n"; }
+		if(!note.empty()){ std::cout << "  " << note << "\n"; }
+		std::cout << std::endl;
+	}
+};
+
+/// The spill whose chunks are being received over udp.
+class SpillAssembly{
+  public:
+	SpillAssembly() : active(false), synced(false), partial(false), numChunks(0), received(0), highest(0), bytes(0), first(0), last(0), previousStart(-1) { }
+
+	/** Add a chunk of a spill. Chunks are numbered from 1 to the number of chunks
+	  * of their spill. A chunk which was already received, a different number of
+	  * chunks, or chunk 1 far behind the highest chunk received starts a new spill.
+	  * Any other chunk below the highest chunk received is out of order.
+	  */
+	void Add(unsigned int chunk_, unsigned int numChunks_, size_t bytes_, double time_, TransportStats &stats_){
+		if(active && (numChunks_ != numChunks || got[chunk_-1] || (chunk_ == 1 && highest > REORDER_WINDOW))){ finish(stats_); }
+
+		if(!active){
+			// Only the first spill may have started before we were listening.
+			partial = (!synced && chunk_ != 1);
+			synced = true;
+			active = true;
+			numChunks = numChunks_;
+			got.assign(numChunks, false);
+			received = 0;
+			highest = 0;
+			bytes = 0;
+			first = time_;
+			if(previousStart >= 0){ stats_.periods.Add(time_ - previousStart); }
+			previousStart = time_;
+		}
+		else{
+			stats_.AddGap(time_ - last);
+			if(chunk_ < highest){ stats_.outOfOrder++; }
+		}
+
+		got[chunk_-1] = true;
+		received++;
+		bytes += bytes_;
+		last = time_;
+		if(chunk_ > highest){ highest = chunk_; }
+
+		if(received == numChunks){ finish(stats_); }
+	}
+
+	/// Finish the spill if no chunk has arrived for SPILL_TIMEOUT seconds.
+	void Expire(double now_, TransportStats &stats_){
+		if(active && now_ - last > SPILL_TIMEOUT){ finish(stats_); }
+	}
+
+  private:
+	bool active; /// Set while chunks of a spill are arriving.
+	bool synced; /// Set once the first chunk has been seen.
+	bool partial; /// The spill started before we were listening and is not counted.
+	unsigned int numChunks; /// Number of chunks of the spill.
+	unsigned int received; /// Number of chunks of the spill received.
+	unsigned int highest; /// Highest chunk of the spill received.
+	std::vector<bool> got; /// Chunks of the spill received.
+	size_t bytes; /// Bytes of the spill received.
+	double first; /// Arrival time of the first chunk, in s.
+	double last; /// Arrival time of the last chunk, in s.
+	double previousStart; /// Arrival time of the first chunk of the previous spill, in s.
+
+	void finish(TransportStats &stats_){
+		active = false;
+		if(partial){ return; }
+		stats_.chunksExpected += numChunks;
+		stats_.chunksLost += numChunks - received;
+		if(received == numChunks){
+			stats_.spills++;
+			stats_.latency.Add(last - first);
+		}
+		else{ stats_.fragmented++; }
+		stats_.spillBytes.Add(bytes);
+	}
+};
+
+/// Return the bytes held in the receive buffer of a udp socket.
+int queued_bytes(Server &server_){
+#ifdef SO_MEMINFO
+	// FIONREAD only gives the size of the next datagram of a udp socket.
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	socklen_t length = sizeof(meminfo);
+	if(getsockopt(server_.Get(), SOL_SOCKET, SO_MEMINFO, meminfo, &length) == 0){ return (int)meminfo[SK_MEMINFO_RMEM_ALLOC]; }
+#endif
+	return server_.GetQueued();
+}
+
+/// Decode a spill notification. Returns false if the packet is not a notification.
+bool decode_notification(char *buffer_, int recv_bytes_, TransportStats &stats_, Reporter &reporter_, long long &file_size_, int &spill_id_){
+	unsigned int total_size = 0;
+	size_t size_of_int = (size_t)buffer_[0]; // The first byte is always the size of an integer on the sending machine
+	size_t size_of_spos = (size_t)buffer_[1]; // The second byte is always the size of a std::streampos type on the sending machine
 	size_t min_pack_size = 2 + 2*sizeof(int);
-	std::cout << " Minimum packet size: " << min_pack_size << " bytes\n\n";
-	
-	bool first_packet = true;
-	if(poll_server.Init(5555)){
-		while(true){
-			int recv_bytes = poll_server.RecvMessage(buffer, 1024);
-
-			if(strcmp(buffer, "$CLOSE_FILE") == 0){
-				std::cout << "  Received CLOSE_FILE flag...\n\n";
-				first_packet = true;
-				continue;
+
+	if(recv_bytes_ < (int)min_pack_size || size_of_int != sizeof(int) || size_of_spos != sizeof(std::streampos)){ return false; }
+
+	// The third byte is the start of an integer specifying the total length of the packet
+	// (in bytes) including itself and the first two size bytes.
+	memcpy((char *)&total_size, &buffer_[2], size_of_int);
+	if(total_size != (unsigned int)recv_bytes_){ return false; }
+
+	stats_.notifications++;
+	if(total_size <= min_pack_size){
+		// Below is the buffer packet structure
+		// ------------------------------------
+		// 1 byte size of integer (may not be the same on a different machine)
+		// 1 byte size of streampos (may not be the same on a different machine)
+		// 4 byte packet length (inclusive, also includes the end packet flag)
+		// 4 byte begin packet flag (0xFFFFFFFF)
+		reporter_.SetNote("poll2 has no output file open");
+		return true;
+	}
+	if(total_size < 2 + 4*size_of_int + size_of_spos){ return false; }
+
+	// Below is the buffer packet structure
+	// ------------------------------------
+	// 1 byte size of integer (may not be the same on a different machine)
+	// 1 byte size of streampos (may not be the same on a different machine)
+	// 4 byte packet length (inclusive, also includes the end packet flag)
+	// x byte file path (no size limit)
+	// 8 byte file size streampos (long long)
+	// 4 byte spill number ID (unsigned int)
+	// 4 byte buffer size (unsigned int)
+	// 4 byte end packet flag (0xFFFFFFFF)
+	std::streampos new_size;
+	int spillID, buffSize;
+	size_t fname_size = total_size - (2 + 4*size_of_int) - size_of_spos; // Size of the filename (in bytes)
+	std::string fname(&buffer_[2 + size_of_int], fname_size);
+
+	unsigned int index = 2 + size_of_int + fname_size;
+	memcpy((char *)&new_size, (char *)&buffer_[index], size_of_spos); index += size_of_spos; // Copy the file size
+	memcpy((char *)&spillID, (char *)&buffer_[index], size_of_int); index += size_of_int; // Copy the spill ID
+	memcpy((char *)&buffSize, (char *)&buffer_[index], size_of_int); // Copy the buffer size
+
+	// Gaps in the spill IDs are notifications which never arrived.
+	long long size = (long long)new_size;
+	if(spill_id_ >= 0 && spillID > spill_id_ + 1){ stats_.dropped += spillID - spill_id_ - 1; }
+	if(file_size_ >= 0 && size > file_size_){ stats_.fileBytes += size - file_size_; }
+	spill_id_ = spillID;
+	file_size_ = size;
+
+	std::stringstream note;
+	note << "poll2 file: " << fname.c_str() << ", " << format_bytes(size) << ", spill " << spillID << ", buffers of " << buffSize << " words";
+	reporter_.SetNote(note.str());
+	return true;
+}
+
+/// Measure the spills sent to the shm port over udp.
+int listen_udp(int port_, int buffer_bytes_, Reporter &reporter_){
+	Server poll_server;
+	if(!poll_server.Init(port_, 0, 100000)){ // Wake up every 0.1 s to print the intervals.
+		std::cout << " Error! Failed to open udp port " << port_ << ".\n";
+		return 1;
+	}
+	if(buffer_bytes_ > 0 && !poll_server.SetBufferSize(buffer_bytes_)){ std::cout << " Warning! Failed to set the receive buffer to " << buffer_bytes_ << " bytes.\n"; }
+	int capacity = poll_server.GetBufferSize();
+
+	// Ask the kernel for the arrival time of every datagram and for the number it dropped.
+	int sock = poll_server.Get();
+	int enable = 1;
+	if(setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0){ std::cout << " Warning! Kernel time stamps are not available, the gaps include the time to read the packets.\n"; }
+	if(setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) != 0){ std::cout << " Warning! The kernel does not report dropped datagrams.\n"; }
+
+	std::cout << " Listening on udp port " << port_ << " with a receive buffer of " << format_bytes(capacity) << "\n\n";
+
+	const size_t controlLength = CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t));
+	std::vector<char> buffers(POLL2_SOCKET_BATCH * (MAX_DATAGRAM + 1));
+	std::vector<char> controls(POLL2_SOCKET_BATCH * controlLength);
+	struct mmsghdr msgs[POLL2_SOCKET_BATCH];
+	struct iovec iov[POLL2_SOCKET_BATCH];
+
+	SpillAssembly spill;
+	uint32_t overflow = 0;
+	long long file_size = -1;
+	int spill_id = -1;
+
+	while(!stop_listening){
+		int select_dummy;
+		if(!poll_server.Select(select_dummy)){
+			double now = wall_time();
+			spill.Expire(now, reporter_.Stats());
+			reporter_.Update(now, capacity);
+			continue;
+		}
+
+		TransportStats &stats = reporter_.Stats();
+		stats.Queued(queued_bytes(poll_server));
+
+		memset(msgs, 0, sizeof(msgs));
+		for(unsigned int i = 0; i < POLL2_SOCKET_BATCH; i++){
+			iov[i].iov_base = &buffers[i * (MAX_DATAGRAM + 1)];
+			iov[i].iov_len = MAX_DATAGRAM;
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_control = &controls[i * controlLength];
+			msgs[i].msg_hdr.msg_controllen = controlLength;
+		}
+
+		int nmsgs = recvmmsg(sock, msgs, POLL2_SOCKET_BATCH, MSG_DONTWAIT, NULL);
+		if(nmsgs <= 0){ continue; }
+		double received = wall_time();
+
+		for(int i = 0; i < nmsgs; i++){
+			char *buffer = (char *)iov[i].iov_base;
+			int recv_bytes = (int)msgs[i].msg_len;
+			buffer[recv_bytes] = '\0';
+
+			double arrival = received;
+			for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)){
+				if(cmsg->cmsg_level != SOL_SOCKET){ continue; }
+				if(cmsg->cmsg_type == SCM_TIMESTAMPNS){
+					struct timespec stamp;
+					memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+					arrival = stamp.tv_sec + 1E-9 * stamp.tv_nsec;
+				}
+				else if(cmsg->cmsg_type == SO_RXQ_OVFL){
+					// The kernel gives the number of datagrams dropped since the socket was opened.
+					uint32_t count;
+					memcpy(&count, CMSG_DATA(cmsg), sizeof(count));
+					stats.kernelDrops += (uint32_t)(count - overflow);
+					overflow = count;
+				}
 			}
-			else if(strcmp(buffer, "$OPEN_FILE") == 0){
-				std::cout << "  Received OPEN_FILE flag...\n\n";
-				first_packet = true;
+
+			stats.packets++;
+			stats.bytes += recv_bytes;
+
+			if(strcmp(buffer, "$CLOSE_FILE") == 0 || strcmp(buffer, "$OPEN_FILE") == 0){
+				reporter_.SetNote(std::string("Received ") + (buffer + 1) + " flag");
+				spill_id = -1;
+				file_size = -1;
 				continue;
 			}
 			else if(strcmp(buffer, "$KILL_SOCKET") == 0){
 				std::cout << "  Received KILL_SOCKET flag...\n\n";
+				stop_listening = 1;
 				break;
 			}
+			else if(decode_notification(buffer, recv_bytes, stats, reporter_, file_size, spill_id)){ continue; }
 
-			// decode the packet
-			if(first_packet){
-				size_of_int = (size_t)buffer[0];
-				size_of_spos = (size_t)buffer[1];
-	
-				if(size_of_int != sizeof(int) || size_of_spos != sizeof(std::streampos)){ 
-					std::cout << "  Warning! basic type size on remote machine does not match local size\n"; 
-					std::cout << "  Size of integer on remote machine: " << size_of_int << " bytes\n";
-					std::cout << "  Size of streampos on remote machine: " << size_of_spos << " bytes\n\n";
-					break;
-				}
+			// Every chunk of a spill is preceded by its number (starting at 1) and the number of chunks.
+			unsigned int chunk, numChunks;
+			if(recv_bytes < (int)(2 * sizeof(unsigned int)) || recv_bytes % sizeof(unsigned int) != 0 || recv_bytes > (int)((POLL2_SOCKET_CHUNK + 2) * sizeof(unsigned int))){
+				stats.unknown++;
+				continue;
 			}
-			else{
-				clock2 = hr_clock::now();
-				time_span = std::chrono::duration_cast<std::chrono::duration<double> >(clock2 - clock1); // Time between packets in seconds
-				if(time_span.count() < 2.0){ continue; }
+			memcpy(&chunk, &buffer[0], sizeof(unsigned int));
+			memcpy(&numChunks, &buffer[sizeof(unsigned int)], sizeof(unsigned int));
+			if(chunk < 1 || chunk > numChunks){
+				stats.unknown++;
+				continue;
 			}
-		
-			// The third byte is the start of an integer specifying the total length of the packet
-			// (in bytes) including itself and the first two size bytes.
-			memcpy((char *)&total_size, &buffer[2], size_of_int);
-		
-			if(total_size <= min_pack_size){
-				// Below is the buffer packet structure
-				// ------------------------------------
-				// 1 byte size of integer (may not be the same on a different machine)
-				// 1 byte size of streampos (may not be the same on a different machine)
-				// 4 byte packet length (inclusive, also includes the end packet flag)
-				// 4 byte begin packet flag (0xFFFFFFFF)
-				std::cout << "  Null packet...\n\n";
+			spill.Add(chunk, numChunks, recv_bytes, arrival, stats);
+		}
+
+		double now = wall_time();
+		spill.Expire(now, reporter_.Stats());
+		reporter_.Update(now, capacity);
+	}
+
+	spill.Expire(wall_time() + SPILL_TIMEOUT + 1.0, reporter_.Stats());
+	reporter_.Finish(wall_time(), capacity);
+	poll_server.Close();
+
+	return 0;
+}
+
+/// Measure the spills of the tcp spill stream.
+int listen_stream(const std::string &host_, int port_, int buffer_bytes_, Reporter &reporter_){
+	StreamClient client;
+	if(!client.Init(host_.c_str(), port_)){
+		std::cout << " Error! Failed to connect to the spill stream at " << host_ << ":" << port_ << ".\n";
+		return 1;
+	}
+	if(buffer_bytes_ > 0 && setsockopt(client.Get(), SOL_SOCKET, SO_RCVBUF, &buffer_bytes_, sizeof(buffer_bytes_)) != 0){ std::cout << " Warning! Failed to set the receive buffer to " << buffer_bytes_ << " bytes.\n"; }
+
+	std::cout << " Subscribed to the spill stream at " << host_ << ":" << port_ << " with a receive buffer of " << format_bytes(client.GetBufferSize()) << "\n\n";
+
+	std::vector<StreamClient::word_t> data;
+	unsigned long dropped = 0;
+	double previousStart = -1;
+
+	while(!stop_listening){
+		struct pollfd fd;
+		fd.fd = client.Get();
+		fd.events = POLLIN;
+		fd.revents = 0;
+		int retval = poll(&fd, 1, 100);
+
+		if(retval > 0){
+			// The frame has started to arrive, time how long it takes to read all of it.
+			double start = wall_time();
+			TransportStats &stats = reporter_.Stats();
+			stats.Queued(client.GetQueued());
+			int nWords = client.Read(data, 0);
+			if(nWords < 0){
+				std::cout << "  The spill stream was closed...\n\n";
+				break;
 			}
-			else{
-				// Below is the buffer packet structure
-				// ------------------------------------
-				// 1 byte size of integer (may not be the same on a different machine)
-				// 1 byte size of streampos (may not be the same on a different machine)
-				// 4 byte packet length (inclusive, also includes the end packet flag)
-				// x byte file path (no size limit)
-				// 8 byte file size streampos (long long)
-				// 4 byte spill number ID (unsigned int)
-				// 4 byte buffer size (unsigned int)
-				// 4 byte end packet flag (0xFFFFFFFF)
-				size_t fname_size = total_size - (2 + 4*size_of_int) - size_of_spos; // Size of the filename (in bytes)
-				char *fname = new char[fname_size+1];
-	
-				unsigned int index = 2  + size_of_int;
-				memcpy(fname, (char *)&buffer[index], fname_size); index += fname_size; // Copy the file name
-				memcpy((char *)&new_size, (char *)&buffer[index], size_of_spos); index += size_of_spos; // Copy the file size
-				memcpy((char *)&spillID, (char *)&buffer[index], size_of_int); index += size_of_int; // Copy the spill ID
-				memcpy((char *)&buffSize, (char *)&buffer[index], size_of_int); index += size_of_int; // Copy the buffer size
-				memcpy((char *)&end_packet_flag, (char *)&buffer[index], size_of_int); // Copy the end packet flag
-				fname[fname_size] = '\0'; // Terminate the filename string
-				
-				system("clear");
-
-				std::cout << " recv: " << recv_bytes << " bytes\n";
-				std::cout << "  Packet length: " << total_size << " bytes\n";
-				std::cout << "  Poll2 filename: " << fname << "\n";
-				
-				int magnitude = order(new_size);
-				if(magnitude < 3){ std::cout << "  Total file size: " << new_size << " B\n"; } // B
-				else if(magnitude >= 3 && magnitude < 6){ std::cout << "  Total file size: " << new_size/1E3 << " kB\n"; } // kB
-				else if(magnitude >= 6 && magnitude < 9){ std::cout << "  Total file size: " << new_size/1E6 << " MB\n"; } // MB
-				else{ std::cout << "  Total file size: " << new_size/1E9 << " GB\n"; } // GB
-				
-				std::cout << "  Spill number ID: " << spillID << "\n";
-				std::cout << "  Buffer size: " << buffSize << " words\n";
-				std::cout << "  End packet: " << end_packet_flag << "\n";
-				
-				if(!first_packet){ 
-					dT = time_span.count();
-					double rate = ((double)(new_size - file_size))/dT;
-					
-					magnitude = order(dT);
-					if(magnitude > -3){ std::cout << "  Time diff: " << dT << " s\n"; } // s
-					else if(magnitude <= -3 && magnitude > -6){ std::cout << "  Time diff: " << dT/1E-3 << " ms\n"; } // ms
-					else if(magnitude <= -6 && magnitude > -9){ std::cout << "  Time diff: " << dT/1E-6 << " us\n"; } // us
-					else{ std::cout << "  Time diff: " << dT/1E-9 << " ns\n"; } // ns
-					
-					magnitude = order(rate);
-					if(magnitude < 3){ std::cout << "  Data rate: " << rate << " B/s\n"; } // B/s
-					else if(magnitude >= 3 && magnitude < 6){ std::cout << "  Data rate: " << rate/1E3 << " kB/s\n"; } // kB/s
-					else if(magnitude >= 6 && magnitude < 9){ std::cout << "  Data rate: " << rate/1E6 << " MB/s\n"; } // MB/s
-					else{ std::cout << "  Data rate: " << rate/1E9 << " GB/s\n"; } // GB/s
-				}
-				else{ first_packet = false; }
-				std::cout << std::endl;
-				
-				file_size = new_size;
-				delete[] fname;
+			if(nWords > 0){
+				size_t bytes = 4 * sizeof(StreamClient::word_t) + nWords * sizeof(StreamClient::word_t);
+				stats.packets++;
+				stats.bytes += bytes;
+				stats.spills++;
+				stats.spillBytes.Add(bytes);
+				stats.latency.Add(wall_time() - start);
+				if(previousStart >= 0){ stats.periods.Add(start - previousStart); }
+				previousStart = start;
+				stats.dropped += client.GetDropped() - dropped;
+				dropped = client.GetDropped();
 			}
-			clock1 = std::chrono::high_resolution_clock::now();
 		}
+
+		reporter_.Update(wall_time(), client.GetBufferSize());
+	}
+
+	reporter_.Finish(wall_time(), client.GetBufferSize());
+	client.Close();
+
+	return 0;
+}
+
+/// Measure the spills read from the shared memory ring.
+int listen_shm(const std::string &name_, Reporter &reporter_){
+	SpillShm shm;
+	if(!shm.Open(name_.c_str())){
+		std::cout << " Error! Failed to open the shared memory ring " << name_ << ", is poll2 running?\n";
+		return 1;
+	}
+
+	std::cout << " Reading the shared memory ring " << name_ << " of " << shm.GetSlots() << " spills\n\n";
+
+	std::vector<SpillShm::word_t> data(shm.GetSlotWords());
+	unsigned long dropped = 0;
+	double previousStart = -1;
+
+	while(!stop_listening){
+		TransportStats &stats = reporter_.Stats();
+		stats.Queued(shm.GetBacklog());
+
+		// A spill is available once it has been written, so the latency is the time to copy it out.
+		double start = wall_time();
+		int nWords = shm.Read(data.data(), data.size());
+		if(nWords < 0){
+			std::cout << "  The shared memory ring was closed...\n\n";
+			break;
+		}
+		if(nWords > 0){
+			size_t bytes = nWords * sizeof(SpillShm::word_t);
+			stats.packets++;
+			stats.bytes += bytes;
+			stats.spills++;
+			stats.spillBytes.Add(bytes);
+			stats.latency.Add(wall_time() - start);
+			if(previousStart >= 0){ stats.periods.Add(start - previousStart); }
+			previousStart = start;
+			stats.dropped += shm.GetDropped() - dropped;
+			dropped = shm.GetDropped();
+		}
+		else{ usleep(1000); }
+
+		reporter_.Update(wall_time(), shm.GetSlots());
 	}
-	else{ return 1; }
-	poll_server.Close();
+
+	reporter_.Finish(wall_time(), shm.GetSlots());
+	shm.Close();
 
 	return 0;
 }
+
+void help(char *prog_name_){
+	std::cout << "  SYNTAX: " << prog_name_ << " [options]\n";
+	std::cout << "   Receives the spills broadcast by poll2 and measures their transport.\n";
+	std::cout << "   Available options:\n";
+	std::cout << "    --help (-h)                 | Display this dialogue.\n";
+	std::cout << "    --port (-p) <port>          | Listen for udp datagrams on this port (default=5555).\n";
+	std::cout << "    --stream (-s) <host[:port]> | Subscribe to the tcp spill stream instead (default port=" << POLL2_STREAM_PORT << ").\n";
+	std::cout << "    --shm [name]                | Read the shared memory ring instead (default=" << POLL2_SHM_NAME << ").\n";
+	std::cout << "    --interval (-i) <s>         | Print the measurements every interval (default=2).\n";
+	std::cout << "    --buffer (-b) <bytes>       | Request a kernel receive buffer of this size (default=" << POLL2_SOCKET_BUFFER << " for udp).\n";
+	std::cout << "    --log (-l)                  | Print the intervals one after the other instead of clearing the screen.\n";
+	std::cout << "   The totals are printed when interrupted (ctrl-c) or when poll2 closes the socket.\n";
+	std::cout << "   The spill assembly latency is the time from the first to the last packet of a spill\n";
+	std::cout << "   (udp), to read a frame once it starts to arrive (tcp) or to copy a spill out (shm).\n";
+}
+
+int main(int argc, char *argv[]){
+	struct option longOpts[] = {
+		{ "help",     no_argument,       NULL, 'h' },
+		{ "port",     required_argument, NULL, 'p' },
+		{ "stream",   required_argument, NULL, 's' },
+		{ "shm",      optional_argument, NULL, 'S' },
+		{ "interval", required_argument, NULL, 'i' },
+		{ "buffer",   required_argument, NULL, 'b' },
+		{ "log",      no_argument,       NULL, 'l' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	int port = 5555;
+	std::string host;
+	int streamPort = POLL2_STREAM_PORT;
+	std::string shmName;
+	bool useShm = false;
+	double interval = 2.0;
+	int bufferBytes = -1;
+	bool log = false;
+
+	int retval;
+	while((retval = getopt_long(argc, argv, "hp:s:i:b:l", longOpts, NULL)) != -1){
+		switch(retval){
+			case 'h' :
+				help(argv[0]);
+				return 0;
+			case 'p' : port = atoi(optarg); break;
+			case 's' :
+				host = optarg;
+				if(host.find(':') != std::string::npos){
+					streamPort = atoi(host.substr(host.find(':') + 1).c_str());
+					host = host.substr(0, host.find(':'));
+				}
+				break;
+			case 'S' :
+				useShm = true;
+				shmName = (optarg ? optarg : POLL2_SHM_NAME);
+				break;
+			case 'i' : interval = strtod(optarg, NULL); break;
+			case 'b' : bufferBytes = atoi(optarg); break;
+			case 'l' : log = true; break;
+			default :
+				help(argv[0]);
+				return 1;
+		}
+	}
+
+	if(interval <= 0.0){
+		std::cout << " Error! The interval must be positive.\n";
+		return 1;
+	}
+
+	std::cout << std::setprecision(3);
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+
+	if(useShm){
+		Reporter reporter("shm ring " + shmName, interval, log, true);
+		return listen_shm(shmName, reporter);
+	}
+	else if(!host.empty()){
+		Reporter reporter("tcp stream " + host + ":" + std::to_string(streamPort), interval, log, false);
+		return listen_stream(host, streamPort, (bufferBytes > 0 ? bufferBytes : 0), reporter);
+	}
+
+	// Size the buffer like the scanners do, unless asked for another size.
+	Reporter reporter("udp port " + std::to_string(port), interval, log, false);
+	return listen_udp(port, (bufferBytes >= 0 ? bufferBytes : POLL2_SOCKET_BUFFER), reporter);
+}
@@ -6,7 +6,7 @@
   * 
   * \date June 4th, 2015
   * 
-  * \version 1.0
+  * \version 1.1
 */
 
 #include <stdlib.h>
@@ -15,15 +15,18 @@
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 #include "poll2_socket.h"
+#include "poll2_stats.h"
 
 #define KILOBYTE 1024 // bytes
 #define MEGABYTE 1048576 // bytes
 #define GIGABYTE 1073741824 // bytes
 
 // Return the order of magnitude of a number
-double GetOrder(unsigned int input_, unsigned int &power){
+double GetOrder(unsigned long long input_, unsigned int &power){
 	double test = 1;
 	for(unsigned int i = 0; i < 100; i++){
 		if(input_/test <= 1){ 
@@ -57,7 +60,7 @@ std::string GetChanRateString(double input_){
 	return output;
 }
 
-std::string GetChanTotalString(unsigned int input_){
+std::string GetChanTotalString(unsigned long long input_){
 	std::stringstream stream;
 	unsigned int power = 0;
 	double order = GetOrder(input_, power);
@@ -124,89 +127,54 @@ std::string GetTimeString(double input_){
 }
 
 int main(){
-	const size_t msg_size = 5844;// 5.8 kB of stats data max
 	const int modColumnWidth = 25;
-	char buffer[msg_size]; 
+	static char buffer[STATS_FRAME_MAX + 1]; 
 	Server poll_server;
 	
-	int num_modules;
-	double time_in_sec;
-	double data_rate;
-	double **rates = NULL;
-	double **inputCountRate = NULL;
-	double **outputCountRate = NULL;
-	unsigned int **totals = NULL;
-	
-	bool first_packet = true;
 	if(poll_server.Init(5556)){
 		std::cout << " Waiting for first stats packet...\n";			
 
 		while(true){
 			std::cout << std::setprecision(2);
 
-			poll_server.RecvMessage(buffer, msg_size);
-			char *ptr = buffer;
+			int recv_bytes = poll_server.RecvMessage(buffer, STATS_FRAME_MAX);
+			if(recv_bytes < 0){ continue; }
+			buffer[recv_bytes] = '\0';
 
 			if(strcmp(buffer, "$KILL_SOCKET") == 0){
 				std::cout << "  Received KILL_SOCKET flag...\n\n";
 				break;
 			}
 
-			system("clear");
-			
-			//std::cout << " Received:\t" << recv_bytes << " bytes\n";
-		
-			// Below is the stats packet structure (for N modules)
-			// ---------------------------------------------------
-			// 4 byte total number of pixie modules (N)
-			// 8 byte total time of run (in seconds)
-			// 8 byte total data rate (in B/s)
-			// channel 0, 0 rate
-			// channel 0, 0 total
-			// channel 0, 1 rate
-			// channel 0, 1 total
-			// ...
-			// channel 0, 15 rate
-			// channel 0, 15 total
-			// channel 1, 0 rate
-			// channel 1, 0 total
-			// ...
-			// channel N-1, 15 rate
-			// channel N-1, 15 total
-			memcpy(&num_modules, ptr, 4); ptr += 4;
-
-			if(first_packet){
-				rates = new double*[num_modules];
-				inputCountRate = new double*[num_modules];
-				outputCountRate = new double*[num_modules];
-				totals = new unsigned int*[num_modules];
-				for(int i = 0; i < num_modules; i++){
-					rates[i] = new double[16];
-					inputCountRate[i] = new double[16];
-					outputCountRate[i] = new double[16];
-					totals[i] = new unsigned int[16];
-				}
-				first_packet = false;
+			// The frame layout is described in poll2_stats.h
+			StatsFrameHeader header;
+			if((size_t)recv_bytes < sizeof(header)){ continue; }
+			memcpy(&header, buffer, sizeof(header));
+			if(header.magic != STATS_FRAME_MAGIC || header.version != STATS_FRAME_VERSION){
+				std::cout << " Ignoring unknown stats packet of " << recv_bytes << " bytes\n";
+				continue;
 			}
-			
-			memcpy(&time_in_sec, ptr, 8); ptr += 8;
-			memcpy(&data_rate, ptr, 8); ptr += 8;
-			for(int i = 0; i < num_modules; i++){
-				for(int j = 0; j < 16; j++){
-					memcpy(&inputCountRate[i][j], ptr, 8); ptr += 8;
-					memcpy(&outputCountRate[i][j], ptr, 8); ptr += 8;
-					memcpy(&rates[i][j], ptr, 8); ptr += 8;
-					memcpy(&totals[i][j], ptr, 4); ptr += 4;
-				}
+			if((size_t)recv_bytes < sizeof(header) + header.numCards * (sizeof(StatsFrameModule) + header.numChannels * sizeof(StatsFrameChannel))){
+				std::cout << " Ignoring truncated stats packet of " << recv_bytes << " bytes\n";
+				continue;
 			}
 			
+			std::vector<StatsFrameModule> modules(header.numCards);
+			std::vector<StatsFrameChannel> channels(header.numCards * header.numChannels);
+			memcpy(modules.data(), buffer + sizeof(header), modules.size() * sizeof(StatsFrameModule));
+			memcpy(channels.data(), buffer + sizeof(header) + modules.size() * sizeof(StatsFrameModule), channels.size() * sizeof(StatsFrameChannel));
+
+			system("clear");
+			
+			unsigned int num_modules = header.numCards;
+
 			// Display the rate information
-			std::cout << "Run Time: " << GetTimeString(time_in_sec);
+			std::cout << "Run Time: " << GetTimeString(header.totalTime);
 			if (num_modules > 1) std::cout << "\t";
 			else std::cout << "\n";
-			std::cout << "Data Rate: " << GetRateString(data_rate) << std::endl;
+			std::cout << "Data Rate: " << GetRateString(header.dataRate) << std::endl;
 			std::cout << "   ";
-			for(unsigned int i = 0; i < (unsigned int)num_modules; i++){
+			for(unsigned int i = 0; i < num_modules; i++){
 			    std::cout << "|" << std::setw((int)((modColumnWidth-1.+0.5) / 2)) 
 				      << std::setfill('-') << "M" << std::setw(2) 
 				      << std::setfill('0') << i 
@@ -215,17 +183,39 @@ int main(){
 			}
 			std::cout << "|\n";
 				
-			for(unsigned int i = 0; i < 16; i++){
+			for(unsigned int i = 0; i < header.numChannels; i++){
 			    std::cout << "C" << std::setw(2) << std:: setfill('0') << i << "|";
-			    for(unsigned int j = 0; j < (unsigned int)num_modules; j++){
-				std::cout << std::setw(5) << std::setfill(' ') << GetChanRateString(inputCountRate[j][i]) << " ";
-				std::cout << std::setw(5) << std::setfill(' ') << GetChanRateString(outputCountRate[j][i]) << " ";
-				std::cout << std::setw(5) << std::setfill(' ') << GetChanRateString(rates[j][i]) << " ";
-				std::cout << std::setw(6) << GetChanTotalString(totals[j][i]) << " ";
+			    for(unsigned int j = 0; j < num_modules; j++){
+				const StatsFrameChannel &chan = channels[j * header.numChannels + i];
+				std::cout << std::setw(5) << std::setfill(' ') << GetChanRateString(chan.inputCountRate) << " ";
+				std::cout << std::setw(5) << std::setfill(' ') << GetChanRateString(chan.outputCountRate) << " ";
+				std::cout << std::setw(5) << std::setfill(' ') << GetChanRateString(chan.eventRate) << " ";
+				std::cout << std::setw(6) << GetChanTotalString(chan.totalEvents) << " ";
 				std::cout << "|";
 			    }
 			    std::cout << "\n";
 			}
+
+			// The lowest channel live fraction and the FIFO fill of each module
+			std::cout << "LT |" << std::setfill(' ') << std::fixed;
+			for(unsigned int j = 0; j < num_modules; j++){
+				double minLive = 1.0;
+				for(unsigned int i = 0; i < header.numChannels; i++){
+					minLive = std::min(minLive, channels[j * header.numChannels + i].liveFraction);
+				}
+				std::cout << " min live " << std::setw(6) << std::setprecision(1) << 100 * minLive << "%        |";
+			}
+			std::cout << "\nFF |";
+			for(unsigned int j = 0; j < num_modules; j++){
+				double fill = 0.0, peak = 0.0;
+				if(modules[j].fifoLength > 0){
+					fill = 100.0 * modules[j].fifoWords / modules[j].fifoLength;
+					peak = 100.0 * modules[j].fifoPeak / modules[j].fifoLength;
+				}
+				std::cout << " fifo " << std::setw(5) << std::setprecision(1) << fill << "% pk " << std::setw(5) << peak << "%   |";
+			}
+			std::cout << "\n";
+			std::cout.unsetf(std::ios::fixed);
 		}
 	}
 	else{ 
@@ -233,11 +223,6 @@ int main(){
 		return 1; 
 	}
 	poll_server.Close();
-	
-	if(rates){ delete[] rates; }
-	if(inputCountRate){ delete[] inputCountRate; }
-	if(outputCountRate){ delete[] outputCountRate; }
-	if(totals){ delete[] totals; }
 
 	return 0;
 }
@@ -14,6 +14,7 @@
 #include <thread>
 #include <utility>
 #include <map>
+#include <sstream>
 #include <getopt.h>
 #include <string.h>
 
@@ -33,6 +34,20 @@ void help(const char *progName_){
 	std::cout << "  --rates               | Display module rates in quiet mode (false by defualt)\n";
 	std::cout << "  --thresh (-t) <num>   | Sets FIFO read threshold to num% full (50% by default)\n";
 	std::cout << "  --zero                | Zero clocks on each START_ACQ (false by default)\n";
+	std::cout << "  --pipeline            | Parse module data while the next module is read (false by default)\n";
+	std::cout << "  --adaptive            | Size the FIFO threshold from the data rate, up to --thresh (false by default)\n";
+	std::cout << "  --parallel-setup      | Boot, adjust offsets and read MCA histograms of all modules concurrently (false by default)\n";
+	std::cout << "  --mca-refresh <sec>   | Time between MCA histogram updates (0.5 s by default)\n";
+	std::cout << "  --live-mca <sec>      | Read the histograms into live_mca every sec seconds during list-mode runs (10 s by default)\n";
+	std::cout << "  --shm-ring            | Share spills with local scanners through shared memory (false by default)\n";
+	std::cout << "  --tcp-stream <port>   | Stream spills to remote scanners over TCP on port (5556 is typical)\n";
+	std::cout << "  --metrics <port>      | Serve Prometheus metrics over HTTP on port (9556 is typical)\n";
+	std::cout << "  --readout-core <core> | Pin the FIFO readout thread to a core (floating by default)\n";
+	std::cout << "  --writer-core <core>  | Pin the disk writer thread to a core (floating by default)\n";
+	std::cout << "  --broadcast-core <core> | Pin the network broadcast thread to a core (floating by default)\n";
+	std::cout << "  --rt-priority <prio>  | Run the FIFO readout with SCHED_FIFO priority 1-99 (needs CAP_SYS_NICE)\n";
+	std::cout << "  --crates <n1,n2,...>  | Split the modules into crates of n1, n2, ... modules, each read by its own thread\n";
+	std::cout << "  --hugepages           | Allocate the FIFO buffer in hugepages on the node of the modules (false by default)\n";
 	std::cout << "  --debug (-d)          | Set debug mode to true (false by default)\n";
 	std::cout << "  --pacman (-p)         | Use classic poll operation for use with Pacman.\n";
 	std::cout << "  --help (-h)           | Display this help dialogue.\n\n";
@@ -59,6 +74,20 @@ int main(int argc, char *argv[]){
 		{ "rates", no_argument, NULL, 0 },
 		{ "thresh", required_argument, NULL, 't' },
 		{ "zero", no_argument, NULL, 0 },
+		{ "pipeline", no_argument, NULL, 0 },
+		{ "adaptive", no_argument, NULL, 0 },
+		{ "parallel-setup", no_argument, NULL, 0 },
+		{ "mca-refresh", required_argument, NULL, 0 },
+		{ "live-mca", required_argument, NULL, 0 },
+		{ "shm-ring", no_argument, NULL, 0 },
+		{ "tcp-stream", required_argument, NULL, 0 },
+		{ "metrics", required_argument, NULL, 0 },
+		{ "readout-core", required_argument, NULL, 0 },
+		{ "writer-core", required_argument, NULL, 0 },
+		{ "broadcast-core", required_argument, NULL, 0 },
+		{ "rt-priority", required_argument, NULL, 0 },
+		{ "hugepages", no_argument, NULL, 0 },
+		{ "crates", required_argument, NULL, 0 },
 		{ "debug", no_argument, NULL, 'd' },
 		{ "pacman", no_argument, NULL, 'p' },
 		{ "help", no_argument, NULL, 'h' },
@@ -119,6 +148,95 @@ int main(int argc, char *argv[]){
 				else if(strcmp("zero", longOpts[idx].name) == 0 ) { // --zero
 					poll.SetZeroClocks();
 				}
+				else if(strcmp("pipeline", longOpts[idx].name) == 0 ) { // --pipeline
+					poll.SetPipelineReadout();
+				}
+				else if(strcmp("adaptive", longOpts[idx].name) == 0 ) { // --adaptive
+					poll.SetAdaptivePolling();
+				}
+				else if(strcmp("parallel-setup", longOpts[idx].name) == 0 ) { // --parallel-setup
+					poll.SetParallelSetup();
+				}
+				else if(strcmp("mca-refresh", longOpts[idx].name) == 0 ) { // --mca-refresh
+					poll.SetMcaRefresh(atof(optarg));
+					if(poll.GetMcaRefresh() <= 0){
+						std::cout << Display::ErrorStr() << " Invalid MCA refresh time (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("live-mca", longOpts[idx].name) == 0 ) { // --live-mca
+					poll.SetLiveMcaRefresh(atof(optarg));
+					if(poll.GetLiveMcaRefresh() <= 0){
+						std::cout << Display::ErrorStr() << " Invalid live MCA refresh time (" << optarg << ")!\n";
+						return 1;
+					}
+					poll.SetLiveMca();
+				}
+				else if(strcmp("shm-ring", longOpts[idx].name) == 0 ) { // --shm-ring
+					poll.SetShmRing();
+				}
+				else if(strcmp("tcp-stream", longOpts[idx].name) == 0 ) { // --tcp-stream
+					poll.SetStreamPort(atoi(optarg));
+					if(poll.GetStreamPort() <= 0){
+						std::cout << Display::ErrorStr() << " Invalid TCP stream port (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("metrics", longOpts[idx].name) == 0 ) { // --metrics
+					poll.SetMetricsPort(atoi(optarg));
+					if(poll.GetMetricsPort() <= 0){
+						std::cout << Display::ErrorStr() << " Invalid metrics port (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("readout-core", longOpts[idx].name) == 0 ) { // --readout-core
+					poll.SetReadoutCore(atoi(optarg));
+					if(poll.GetReadoutCore() < 0 || !IsNumeric(optarg)){
+						std::cout << Display::ErrorStr() << " Invalid readout core (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("writer-core", longOpts[idx].name) == 0 ) { // --writer-core
+					poll.SetWriterCore(atoi(optarg));
+					if(poll.GetWriterCore() < 0 || !IsNumeric(optarg)){
+						std::cout << Display::ErrorStr() << " Invalid writer core (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("broadcast-core", longOpts[idx].name) == 0 ) { // --broadcast-core
+					poll.SetBroadcastCore(atoi(optarg));
+					if(poll.GetBroadcastCore() < 0 || !IsNumeric(optarg)){
+						std::cout << Display::ErrorStr() << " Invalid broadcast core (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("rt-priority", longOpts[idx].name) == 0 ) { // --rt-priority
+					poll.SetReadoutPriority(atoi(optarg));
+					if(poll.GetReadoutPriority() < 1 || poll.GetReadoutPriority() > 99){
+						std::cout << Display::ErrorStr() << " Invalid SCHED_FIFO priority (" << optarg << ")!\n";
+						return 1;
+					}
+				}
+				else if(strcmp("hugepages", longOpts[idx].name) == 0 ) { // --hugepages
+					poll.SetHugeBuffers();
+				}
+				else if(strcmp("crates", longOpts[idx].name) == 0 ) { // --crates
+					std::vector<unsigned short> crates;
+					std::stringstream list(optarg);
+					std::string size;
+					while(std::getline(list, size, ',')){
+						if(!IsNumeric(size) || atoi(size.c_str()) <= 0){
+							std::cout << Display::ErrorStr() << " Invalid crate size (" << size << ")!\n";
+							return 1;
+						}
+						crates.push_back(atoi(size.c_str()));
+					}
+					if(crates.size() > 16){
+						std::cout << Display::ErrorStr() << " No more than 16 crates may be read (" << optarg << ")!\n";
+						return 1;
+					}
+					poll.SetCrates(crates);
+				}
 				break;
 			case '?' :
 				help(argv[0]);
@@ -24,16 +24,29 @@
 #include <stdlib.h>
 #include <sstream>
 #include <ctime>
+#include <chrono>
+#include <future>
 
 #include <cmath>
 
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "poll2_core.h"
 #include "poll2_socket.h"
 #include "poll2_stats.h"
+#include "poll2_ring.h"
+#include "poll2_shm.h"
+#include "poll2_stream.h"
+#include "poll2_metrics.h"
 
 #include "CTerminal.h"
 
@@ -52,6 +65,25 @@
 // 4 GB. Maximum allowable .ldf file size in bytes
 #define MAX_FILE_SIZE 4294967296ll
 
+// The continuation file is opened in the background once the output file reaches this fraction of MAX_FILE_SIZE
+#define ROLLOVER_PREPARE_FRACTION 0.9
+
+// Number of spill slots shared by the FIFO readout and the writer/broadcast threads
+#define RING_SLOTS 8
+
+// Adaptive polling: the FIFO threshold is sized so that data waits at most
+// ADAPT_MAX_LATENCY seconds in the FIFO, between ADAPT_MIN_FILL of the FIFO and
+// the user threshold. The FIFOs are polled ADAPT_POLLS_PER_FILL times while
+// filling up to the threshold, within the interval limits (in us).
+#define ADAPT_MAX_LATENCY 0.5
+#define ADAPT_MIN_FILL 0.01
+#define ADAPT_POLLS_PER_FILL 4
+#define ADAPT_MIN_INTERVAL 100
+#define ADAPT_MAX_INTERVAL 10000
+
+// Hugepages are assumed to be the x86 default of 2 MB. Buffers are rounded up to a whole number of them.
+#define HUGEPAGE_SIZE (2*1024*1024)
+
 // Length of shm packet header (in bytes)
 #define PKT_HEAD_LEN 8
 
@@ -74,6 +106,104 @@ bool IsNumeric(const std::string &input_, const std::string &prefix_/*=""*/, con
 	return true;
 }
 
+/** Read the first line of a small file, such as a sysfs attribute.
+  *  \param[in]  fname_ Path to the file.
+  *  \return The first line, or an empty string if the file could not be read.
+  */
+static std::string read_line(const std::string &fname_){
+	std::ifstream file(fname_.c_str());
+	std::string line;
+	if(file.good()){ std::getline(file, line); }
+	return line;
+}
+
+/** Find the NUMA node of the PCI bus the modules are on, from the PLX 9054
+  * bridges of the modules in sysfs.
+  *  \return The NUMA node, or -1 if it is unknown or the host is not NUMA.
+  */
+static int find_pixie_node(){
+	DIR *dir = opendir("/sys/bus/pci/devices");
+	if(!dir){ return -1; }
+
+	int node = -1;
+	struct dirent *entry;
+	while(node < 0 && (entry = readdir(dir)) != NULL){
+		if(entry->d_name[0] == '.'){ continue; }
+		std::string path = std::string("/sys/bus/pci/devices/") + entry->d_name + "/";
+		if(read_line(path + "vendor") != "0x10b5" || read_line(path + "device") != "0x9054"){ continue; }
+		std::string numa = read_line(path + "numa_node");
+		if(!numa.empty()){ node = atoi(numa.c_str()); }
+	}
+	closedir(dir);
+
+	return node;
+}
+
+/** Fill a cpu set with the cores of a NUMA node, from its sysfs cpulist (e.g. "0-7,16-23").
+  *  \param[in]  node_ The NUMA node.
+  *  \param[out] cpus_ The cores of the node.
+  *  \return true if the node has at least one core.
+  */
+static bool get_node_cpus(int node_, cpu_set_t &cpus_){
+	CPU_ZERO(&cpus_);
+	std::stringstream list(read_line("/sys/devices/system/node/node" + std::to_string(node_) + "/cpulist"));
+	std::string range;
+	while(std::getline(list, range, ',')){
+		if(range.empty()){ continue; }
+		size_t dash = range.find('-');
+		int first = atoi(range.substr(0, dash).c_str());
+		int last = (dash == std::string::npos ? first : atoi(range.substr(dash+1).c_str()));
+		for(int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++){ CPU_SET(cpu, &cpus_); }
+	}
+	return CPU_COUNT(&cpus_) > 0;
+}
+
+/** Pin a thread to a single core and report the result.
+  *  \param[in]  thread_ The thread to pin.
+  *  \param[in]  core_ The core to pin it to, nothing is done if negative.
+  *  \param[in]  name_ The name of the thread for the report.
+  *  \param[in]  node_ The NUMA node of the modules, a warning is given if the core is not on it.
+  *  \return true if the thread was pinned.
+  */
+static bool pin_thread(pthread_t thread_, int core_, const std::string &name_, int node_=-1){
+	if(core_ < 0){ return false; }
+
+	Display::LeaderPrint("Pinning " + name_ + " thread to core " + std::to_string(core_));
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core_, &cpus);
+	int retval = pthread_setaffinity_np(thread_, sizeof(cpu_set_t), &cpus);
+	if(retval != 0){
+		std::cout << Display::ErrorStr() << " " << strerror(retval) << std::endl;
+		return false;
+	}
+	std::cout << Display::OkayStr() << std::endl;
+
+	cpu_set_t nodeCpus;
+	if(node_ >= 0 && get_node_cpus(node_, nodeCpus) && !CPU_ISSET(core_, &nodeCpus)){
+		std::cout << Display::WarningStr("Warning") << ": Core " << core_ << " is not on NUMA node " << node_ << " of the modules!\n";
+	}
+	return true;
+}
+
+/// The FIFO readout of one crate. Its modules are read into their own blocks of
+/// fifoData and published to the spill ring as one spill, numbered from 0 within
+/// the crate so that scanners see an ordinary spill.
+struct Poll::CrateReadout{
+	unsigned short firstMod; /// Index of the first module of the crate.
+	unsigned short nMods; /// Number of modules in the crate.
+	word_t *fifoData; /// FIFO blocks of the modules, allocated by the readout thread.
+	std::vector<word_t*> modBlocks; /// Start of the spill data of each module.
+	std::vector<SpillRing::Segment> segments; /// The module blocks making up a spill.
+	std::atomic<bool> forceSpill; /// Read the FIFOs on the next poll, whatever their fill.
+	double lastSpillTime; /// Time when the last spill of the crate finished.
+	std::mutex readMutex; /// Held while the FIFOs of the crate are read.
+	std::thread thread; /// Readout thread of the crate, unused for the first crate.
+
+	CrateReadout(unsigned short firstMod_, unsigned short nMods_) : firstMod(firstMod_), nMods(nMods_), fifoData(NULL), 
+		modBlocks(nMods_), forceSpill(false), lastSpillTime(0) { }
+};
+
 std::vector<std::string> chan_params = {"TRIGGER_RISETIME", "TRIGGER_FLATTOP", "TRIGGER_THRESHOLD", "ENERGY_RISETIME", "ENERGY_FLATTOP", "TAU", "TRACE_LENGTH",
 									 "TRACE_DELAY", "VOFFSET", "XDT", "BASELINE_PERCENT", "EMIN", "BINFACTOR", "CHANNEL_CSRA", "CHANNEL_CSRB", "BLCUT",
 									 "ExternDelayLen", "ExtTrigStretch", "ChanTrigStretch", "FtrigoutDelay", "FASTTRIGBACKLEN"};
@@ -90,11 +220,12 @@ const std::vector<std::string> Poll::paramControlCommands_ ({"dump", "pread",
 	"pmread", "pwrite", "pmwrite", "adjust_offsets", "find_tau", "toggle", 
 	"toggle_bit", "csr_test", "bit_test", "get_traces"});
 	
-const std::vector<std::string> Poll::pollStatusCommands_ ({"status", "thresh", 
-	"debug", "quiet", "quit", "help", "version"});
+const std::vector<std::string> Poll::pollStatusCommands_ ({"status", "thresh", "stats", 
+	"debug", "quiet", "pipeline", "adaptive", "quit", "help", "version"});
 
 MCA_args::MCA_args(){ 
 	mca = NULL;
+	refresh = 0.5;
 	Zero(); 
 }
 	
@@ -102,6 +233,7 @@ MCA_args::MCA_args(bool useRoot_, int totalTime_, std::string basename_){
 	running = false;
 	useRoot = useRoot_;
 	totalTime = totalTime_;
+	refresh = 0.5;
 	basename = basename_;
 	
 	mca = NULL;
@@ -111,22 +243,30 @@ MCA_args::~MCA_args(){
 	if(mca){ delete mca; }
 }
 
-bool MCA_args::Initialize(PixieInterface *pif_){
-	if(running){ return false; }
-
-	pif_->RemovePresetRunLength(0);
-	
-	// Initialize the MCA object.
+MCA *MCA_args::NewMCA(PixieInterface *pif_){
+	MCA *mca_ = NULL;
 #if defined(USE_ROOT) && defined(USE_DAMM)
 	if(useRoot)
-		mca = (MCA*)(new MCA_ROOT(pif_, basename.c_str()));
+		mca_ = (MCA*)(new MCA_ROOT(pif_, basename.c_str()));
 	else
-		mca = (MCA*)(new MCA_DAMM(pif_, basename.c_str()));
+		mca_ = (MCA*)(new MCA_DAMM(pif_, basename.c_str()));
 #elif defined(USE_ROOT)
-	mca = (MCA*)(new MCA_ROOT(pif_, basename.c_str()));
+	mca_ = (MCA*)(new MCA_ROOT(pif_, basename.c_str()));
 #elif defined(USE_DAMM)
-	mca = (MCA*)(new MCA_DAMM(pif_, basename.c_str()));
+	mca_ = (MCA*)(new MCA_DAMM(pif_, basename.c_str()));
 #endif
+	if(mca_){ mca_->SetRefreshInterval(refresh); }
+	return mca_;
+}
+
+bool MCA_args::Initialize(PixieInterface *pif_){
+	if(running){ return false; }
+
+	pif_->RemovePresetRunLength(0);
+	
+	// Initialize the MCA object.
+	mca = NewMCA(pif_);
+	if(!mca){ return false; }
 
 	pif_->StartHistogramRun();
 
@@ -166,6 +306,8 @@ void MCA_args::Close(PixieInterface *pif_){
 }
 
 Poll::Poll() : 
+	partialEvents(NULL),
+	spillMerger(NULL),
 	// System flags and variables
 	sys_message_head(" POLL: "),
 	kill_all(false), // Set to true when the program is exiting
@@ -180,6 +322,8 @@ Poll::Poll() :
 	file_open(false), //Set to true when a file is opened.
 	raw_time(0),
 	do_MCA_run(false), // Set to true when the "mca" command is received
+	liveMca_args(false, 0, "live_mca"), // Set with 'mca live' command
+	live_mca(false),
 	// Run control variables
 	boot_fast(false),
 	insert_wall_clock(true),
@@ -187,6 +331,17 @@ Poll::Poll() :
 	send_alarm(false),
 	show_module_rates(false),
 	zero_clocks(false),
+	pipeline_readout(false),
+	adaptive_polling(false),
+	parallel_setup(false),
+	shm_ring(false),
+	stream_port(0),
+	metrics_port(0),
+	readout_core(-1),
+	writer_core(-1),
+	broadcast_core(-1),
+	readout_priority(0),
+	huge_buffers(false),
 	debug_mode(false),
 	shm_mode(false),
 	pac_mode(false),
@@ -199,11 +354,29 @@ Poll::Poll() :
 	next_run_num(1), // Set with 'runnum' command
 	output_format(0), // Set with 'oform' command
 	current_file_num(0),
+	spillRing(NULL),
+	writerID(-1),
+	broadcastID(-1),
+	spillShm(NULL),
+	shmID(-1),
+	streamServer(NULL),
+	streamID(-1),
+	metricsServer(NULL),
+	bytesWritten(0),
+	spillsWritten(0),
 	// Some pacman stuff
 	udp_sequence(0),
-	total_spill_chunks(0)
+	total_spill_chunks(0),
+	pixieNode(-1),
+	adaptThreshWords(0),
+	pollInterval(ADAPT_MIN_INTERVAL),
+	statsRefreshes(0),
+	liveMcaUpdates(0)
 {
 	pif = new PixieInterface("pixie.cfg");
+
+	//Each update of the live histograms reads every channel of every module, so it is kept rare.
+	liveMca_args.SetRefresh(10.0);
 	
 	// Check the scheduler (kernel priority)
 	Display::LeaderPrint("Checking scheduler");
@@ -258,7 +431,8 @@ bool Poll::Initialize(){
 
 	PrintModuleInfo();
 
-	//Boot the modules.
+	//Boot the modules, and set them up concurrently if requested.
+	pif->SetParallelModules(parallel_setup);
 	if(boot_fast){
 		if(!pif->Boot(PixieInterface::DownloadParameters | PixieInterface::SetDAC | PixieInterface::ProgramFPGA)){ return false; } 
 	}
@@ -271,6 +445,40 @@ bool Poll::Initialize(){
 
 	// Allocate memory buffers for FIFO
 	n_cards = pif->GetNumberCards();
+
+	// Split the modules into crates. Every hit is tagged with its crate ID, which
+	// scanners add as 100 times the crate to the module number.
+	if(crateSizes.empty()){ crates.push_back(new CrateReadout(0, n_cards)); }
+	else{
+		size_t firstMod = 0;
+		for(size_t crate = 0; crate < crateSizes.size(); crate++){
+			crates.push_back(new CrateReadout(firstMod, crateSizes[crate]));
+			firstMod += crateSizes[crate];
+		}
+		if(firstMod != n_cards){
+			std::cout << Display::ErrorStr() << " The crates hold " << firstMod << " modules, but there are " << n_cards << "!\n";
+			for(size_t crate = 0; crate < crates.size(); crate++){ delete crates[crate]; }
+			crates.clear();
+			return false;
+		}
+
+		Display::LeaderPrint("Setting crate IDs");
+		bool hadError = false;
+		for(size_t crate = 0; crate < crates.size(); crate++){
+			for(unsigned short mod = crates[crate]->firstMod; mod < crates[crate]->firstMod + crates[crate]->nMods; mod++){
+				if(!pif->WriteSglModPar("CrateID", crate, mod)){ hadError = true; }
+			}
+		}
+		if(!hadError){ std::cout << Display::OkayStr() << std::endl; }
+		else{ std::cout << Display::ErrorStr() << std::endl; }
+	}
+
+	// The readout buffers are placed on the NUMA node of the modules' PCI bridge.
+	pixieNode = find_pixie_node();
+	if(pixieNode >= 0){
+		Display::LeaderPrint("Finding NUMA node of modules");
+		std::cout << Display::InfoStr("NODE " + std::to_string(pixieNode)) << std::endl;
+	}
 	
 	if(pac_mode){ 
 		//Initialize pacman data port
@@ -284,14 +492,104 @@ bool Poll::Initialize(){
 		//Initialize Cory's shm port
 		// This port number is used to avoid tying up udptoipc's port
 		client->Init("127.0.0.1", 5555);
+		client->SetBufferSize(POLL2_SOCKET_BUFFER);
 	}
 
-	//Allocate an array of vectors to store partial events from the FIFO.
-	partialEvents = new std::vector<word_t>[n_cards];
+	//Allocate the partial event records of each module.
+	partialEvents = new PartialEvent[n_cards];
 
 	//Create a stats handler and set the interval.
 	statsHandler = new StatsHandler(n_cards);
 	statsHandler->SetDumpInterval(statsInterval_);
+	statsHandler->SetFifoLength(EXTERNAL_FIFO_LENGTH);
+
+	//Start the consumers of the spill ring. The writer never drops spills, while the
+	//broadcaster drops spills it falls behind on so the network never stalls readout.
+	spillRing = new SpillRing(RING_SLOTS);
+	writerID = spillRing->AddConsumer(false);
+	broadcastID = spillRing->AddConsumer(true);
+	writerThread = std::thread(&SpillRing::Run, spillRing, writerID, [this](word_t *data, unsigned int nWords, bool record){
+		if(record) write_data(data, nWords);
+	});
+	if(crates.size() > 1){
+		//The spills of the crates are broadcast in the order of their hardware time.
+		spillMerger = new SpillMerger(crates.size(), [this](word_t *data, unsigned int nWords){
+			broadcast_data(data, nWords);
+		});
+		broadcastThread = std::thread([this](){
+			spillRing->RunTagged(broadcastID, [this](word_t *data, unsigned int nWords, bool record, unsigned int crate){
+				spillMerger->Add(data, nWords, crate);
+			}, [this](){ spillMerger->Expire(); });
+			spillMerger->Flush();
+		});
+	}
+	else{
+		broadcastThread = std::thread(&SpillRing::Run, spillRing, broadcastID, [this](word_t *data, unsigned int nWords, bool record){
+			broadcast_data(data, nWords);
+		});
+	}
+	pin_thread(writerThread.native_handle(), writer_core, "writer");
+	pin_thread(broadcastThread.native_handle(), broadcast_core, "broadcast");
+
+	//Scanners on this host may follow the spills through shared memory. Writing a
+	//spill into the shared ring never waits on them, so this consumer is lossless.
+	if(shm_ring){
+		spillShm = new SpillShm();
+		if(spillShm->Create(POLL2_SHM_NAME, POLL2_SHM_SLOTS, n_cards * (EXTERNAL_FIFO_LENGTH + maxEventSize + 2))){
+			shmID = spillRing->AddConsumer(false);
+			shmThread = std::thread(&SpillRing::Run, spillRing, shmID, [this](word_t *data, unsigned int nWords, bool record){
+				spillShm->Write(data, nWords);
+			});
+		}
+		else{
+			std::cout << Display::WarningStr("Warning") << ": Failed to create shared memory ring " << POLL2_SHM_NAME << "!\n";
+			delete spillShm;
+			spillShm = NULL;
+		}
+	}
+
+	//Remote scanners may subscribe to a TCP stream of the spills. Every subscriber
+	//has its own queue, and a slow subscriber drops spills instead of holding up readout.
+	if(stream_port > 0){
+		streamServer = new StreamServer();
+		if(streamServer->Init(stream_port)){
+			streamID = spillRing->AddConsumer(true);
+			streamThread = std::thread(&SpillRing::Run, spillRing, streamID, [this](word_t *data, unsigned int nWords, bool record){
+				streamServer->Send(data, nWords);
+			});
+		}
+		else{
+			std::cout << Display::WarningStr("Warning") << ": Failed to open TCP stream port " << stream_port << "!\n";
+			delete streamServer;
+			streamServer = NULL;
+		}
+	}
+
+	//The first crate is read by RunControl, every other crate by its own thread.
+	for(size_t crate = 1; crate < crates.size(); crate++){
+		crates[crate]->thread = std::thread(&Poll::CrateControl, this, crate);
+	}
+
+	//The module statistics are read into a cache by their own thread, each module between
+	//the FIFO reads of its crate, so neither the readout nor a status command waits on them.
+	statsCache.assign(n_cards * PixieInterface::STAT_SIZE, 0);
+	statsTimes.assign(n_cards, 0);
+	statsThread = std::thread(&Poll::StatsControl, this);
+
+	//The onboard histograms are read in the same way, when asked for with 'mca live'.
+	liveMcaThread = std::thread(&Poll::LiveMcaControl, this);
+
+	//The metrics endpoint only serves snapshots made at each stats dump, so a
+	//scrape never reaches into the readout.
+	if(metrics_port > 0){
+		metricsServer = new MetricsServer();
+		if(metricsServer->Init(metrics_port)){ update_metrics(); }
+		else{
+			std::cout << Display::WarningStr("Warning") << ": Failed to open metrics port " << metrics_port << "!\n";
+			delete metricsServer;
+			metricsServer = NULL;
+		}
+	}
 	
 	//Build the list of commands
 	commands_.insert(commands_.begin(), pollStatusCommands_.begin(), pollStatusCommands_.end());
@@ -319,9 +617,50 @@ bool Poll::Close(){
 	//Close the UDP data / SHM port.
 	client->Close();
 	
-	// Close any open files.
+	// Stop the readout threads of the crates.
+	kill_all = true;
+	for(size_t crate = 0; crate < crates.size(); crate++){
+		if(crates[crate]->thread.joinable()) crates[crate]->thread.join();
+	}
+	{
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		statsCond.notify_all();
+	}
+	if(statsThread.joinable()) statsThread.join();
+	{
+		std::lock_guard<std::mutex> lock(liveMca_mutex);
+		liveMcaCond.notify_all();
+	}
+	if(liveMcaThread.joinable()) liveMcaThread.join();
+
+	// Drain the spill ring and close any open files.
+	spillRing->Close();
+	writerThread.join();
+	broadcastThread.join();
+	if(shmThread.joinable()) shmThread.join();
+	if(streamThread.joinable()) streamThread.join();
 	if(output_file.IsOpen()) CloseOutputFile();
 
+	delete spillRing;
+	spillRing = NULL;
+
+	delete spillMerger;
+	spillMerger = NULL;
+
+	//The FIFO buffers are kept, they may be hugepages which are never unmapped.
+	for(size_t crate = 0; crate < crates.size(); crate++){ delete crates[crate]; }
+	crates.clear();
+
+	//Closing the shared memory ring tells the scanners that poll2 has gone.
+	delete spillShm;
+	spillShm = NULL;
+
+	delete streamServer;
+	streamServer = NULL;
+
+	delete metricsServer;
+	metricsServer = NULL;
+
 	//Delete the array of partial event vectors.
 	delete[] partialEvents;
 	partialEvents = NULL;
@@ -359,7 +698,12 @@ bool Poll::CloseOutputFile(const bool continueRun /*=false*/){
 		statsHandler->Dump();
 	}
 
+	output_mutex.lock();
+	//A continuation file being opened must be ready before it is discarded.
+	if(nextOutputFile.valid()){ nextOutputFile.wait(); }
+	nextOutputFile = std::future<bool>();
 	output_file.CloseFile();
+	output_mutex.unlock();
 
 	//Broadcast to Cory's SHM that the file is now closed.
 	if(!pac_mode){ client->SendMessage((char *)"$CLOSE_FILE", 12); }
@@ -403,7 +747,10 @@ bool Poll::OpenOutputFile(bool continueRun){
 	}
 
 	//Try to open a file and check if unsuccessful.
-	if(!output_file.OpenNewFile(output_title, next_run_num, filename_prefix, output_directory, continueRun)){
+	output_mutex.lock();
+	bool opened = output_file.OpenNewFile(output_title, next_run_num, filename_prefix, output_directory, continueRun);
+	output_mutex.unlock();
+	if(!opened){
 		std::cout << Display::ErrorStr() << std::endl;
 		//Unsuccessful when opening file print a message.
 		std::cout << "|- Failed to open output file! Check that the path is correct.\n";
@@ -430,6 +777,34 @@ bool Poll::OpenOutputFile(bool continueRun){
 	return true;
 }
 
+/**Switch to the continuation file which was opened in the background. The
+ * previous file is finished and closed by PollOutputFile in the background, so
+ * the writer goes straight on with the next spill.
+ *
+ * \return True if the continuation file is now the output file.
+ */
+bool Poll::RolloverOutputFile(){
+	output_mutex.lock();
+	bool switched = nextOutputFile.valid() && nextOutputFile.get();
+	if(switched){ switched = output_file.Rollover(output_title, next_run_num); }
+	output_mutex.unlock();
+	if(!switched){ return false; }
+
+	//Tell Cory's SHM that the file was closed and the next one opened.
+	if(!pac_mode){
+		client->SendMessage((char *)"$CLOSE_FILE", 12);
+		client->SendMessage((char *)"$OPEN_FILE", 12);
+	}
+
+	//Clear the stats, as for any newly opened file.
+	statsHandler->Clear();
+	statsHandler->Dump();
+
+	std::cout << sys_message_head << "Continuing run in '" << output_file.GetCurrentFilename() << "'.\n";
+
+	return true;
+}
+
 bool Poll::synch_mods(){
 	static bool firstTime = true;
 	static char synchString[] = "IN_SYNCH";
@@ -454,6 +829,10 @@ bool Poll::synch_mods(){
 	return !hadError;
 }
 
+/** Write a data spill to the output file, opening a continuation file if the
+ * maximum file size would be exceeded. The spill notification is broadcast once
+ * the spill is on disk. Called from the writer thread.
+ */
 int Poll::write_data(word_t *data, unsigned int nWords){
 	// Open an output file if needed
 	if(!output_file.IsOpen()){
@@ -464,19 +843,38 @@ int Poll::write_data(word_t *data, unsigned int nWords){
 	}
 
 	// Handle the writing of buffers to the file
+	output_mutex.lock();
 	std::streampos current_filesize = output_file.GetFilesize();
+	// Open the continuation file in the background well before it is needed, so
+	// the rollover itself is only a switch of streams at a spill boundary.
+	if(!nextOutputFile.valid() && current_filesize > (std::streampos)(MAX_FILE_SIZE * ROLLOVER_PREPARE_FRACTION)){
+		nextOutputFile = std::async(std::launch::async, &PollOutputFile::PrepareNextFile, &output_file, next_run_num, filename_prefix, output_directory);
+	}
+	output_mutex.unlock();
 	if(current_filesize + (std::streampos)(4*nWords + 65552) > MAX_FILE_SIZE){
 		// Adding nWords plus 2 EOF buffers to the file will push it over MAX_FILE_SIZE.
 		// Open a new output file instead
 		std::cout << sys_message_head << "Maximum ifile size reached. New output file will be created.\n";
 		std::cout << sys_message_head << "Current filesize is " << current_filesize + (std::streampos)65552 << " bytes.\n";
-		CloseOutputFile(true);
-		OpenOutputFile(true); 
+		if(!RolloverOutputFile()){
+			CloseOutputFile(true);
+			OpenOutputFile(true); 
+		}
 	}
 
-	if (!is_quiet) std::cout << "Writing " << nWords << " words.\n";
+	if (!is_quiet) poll_term_->Post("Writing " + std::to_string(nWords) + " words.\n", "write");
+
+	std::lock_guard<std::mutex> lock(output_mutex);
+	int retval = output_file.Write((char*)data, nWords);
+	if(retval >= 0){
+		bytesWritten += 4 * (unsigned long long)nWords;
+		spillsWritten++;
+	}
 
-	return output_file.Write((char*)data, nWords);
+	// Let listeners know that the spill is now available in the file.
+	if(!pac_mode && !shm_mode){ output_file.SendPacket(client); }
+
+	return retval;
 }
 
 void Poll::broadcast_data(word_t *data, unsigned int nWords) {
@@ -534,35 +932,15 @@ void Poll::broadcast_data(word_t *data, unsigned int nWords) {
 		broadcast_pac_data();  
 	}
 	else if(shm_mode){ // Broadcast the spill onto the network using the new shm style
-		int shm_data[maxShmSizeL+2]; // packets of data
-		unsigned int num_net_chunks = nWords / maxShmSizeL;
-		unsigned int num_net_remain = nWords % maxShmSizeL;
-		if(num_net_remain != 0){ num_net_chunks++; }
-		
-		unsigned int net_chunk = 1;
-		unsigned int words_bcast = 0;
-		if(debug_mode){ std::cout << " debug: Splitting " << nWords << " words into network spill of " << num_net_chunks << " chunks (fragment = " << num_net_remain << " words)\n"; }
-		
-		while(words_bcast < nWords){
-			if(nWords - words_bcast > maxShmSizeL){ // Broadcast the spill chunks
-				memcpy(&shm_data[0], &net_chunk, 4);
-				memcpy(&shm_data[1], &num_net_chunks, 4);
-				memcpy(&shm_data[2], &data[words_bcast], maxShmSize);
-				client->SendMessage((char *)shm_data, maxShmSize+8);
-				words_bcast += maxShmSizeL;
-			}
-			else{ // Broadcast the spill remainder
-				memcpy(&shm_data[0], &net_chunk, 4);
-				memcpy(&shm_data[1], &num_net_chunks, 4);
-				memcpy(&shm_data[2], &data[words_bcast], (nWords-words_bcast)*4);
-				client->SendMessage((char *)shm_data, (nWords - words_bcast + 2)*4);
-				words_bcast += nWords-words_bcast;
-			}
-			usleep(1);
-			net_chunk++;
-		}
+		int num_net_chunks = (nWords + POLL2_SOCKET_CHUNK - 1) / POLL2_SOCKET_CHUNK;
+		if(debug_mode){ std::cout << " debug: Splitting " << nWords << " words into network spill of " << num_net_chunks << " chunks (fragment = " << nWords % POLL2_SOCKET_CHUNK << " words)\n"; }
+
+		int chunks_sent = client->SendSpill(data, nWords);
+		if(debug_mode && chunks_sent < num_net_chunks){ std::cout << " debug: Failed to send network spill chunks after chunk " << chunks_sent << "\n"; }
 	}
-	else{ // Broadcast a spill notification to the network
+	else if(!record_data){ // Broadcast a spill notification to the network
+		// When recording, the writer thread sends the notification after the spill is written.
+		std::lock_guard<std::mutex> lock(output_mutex);
 		output_file.SendPacket(client);
 	}
 }
@@ -639,10 +1017,11 @@ void Poll::help(){
 		std::cout << "   fdir [path]         - Set the output file directory (default='./')\n";
 		std::cout << "   title [runTitle]    - Set the title of the current run (default='PIXIE Data File)\n";
 		std::cout << "   runnum [number]     - Set the number of the current run (default=0)\n";
-		std::cout << "   oform [0|1|2]       - Set the format of the output file (default=0)\n";
+		std::cout << "   oform [0|1|2|3]     - Set the format of the output file (default=0)\n";
 		std::cout << "   reboot              - Reboot PIXIE crate\n";
 		std::cout << "   stats [time]        - Set the time delay between statistics dumps (default=-1)\n";
 		std::cout << "   mca [root|damm] [time] [filename]     - Use MCA to record data for debugging purposes\n";
+		std::cout << "   mca live [off|root|damm] [refresh] [filename] - Read the histograms every refresh seconds during list-mode runs\n";
 	}
 	std::cout << "   dump [filename]                       - Dump pixie settings to file (default='Fallback.set')\n";
 	std::cout << "   pread <mod> <chan> <param>            - Read parameters from individual PIXIE channels\n";
@@ -658,8 +1037,11 @@ void Poll::help(){
 	std::cout << "   get_traces <mod> <chan> [threshold]   - Get traces for all channels in a specified module\n";
 	std::cout << "   status              - Display system status information\n";
 	std::cout << "   thresh [threshold]  - Modify or display the current polling threshold.\n";
+	std::cout << "   stats [module]      - Display the module statistics last read during the run\n";
 	std::cout << "   debug               - Toggle debug mode flag (default=false)\n";
 	std::cout << "   quiet               - Toggle quiet mode flag (default=false)\n";
+	std::cout << "   pipeline            - Toggle parsing module data while reading the next module (default=false)\n";
+	std::cout << "   adaptive            - Toggle sizing the FIFO threshold from the data rate (default=false)\n";
 	std::cout << "   quit                - Close the program\n";
 	std::cout << "   help (h)            - Display this dialogue\n";
 	std::cout << "   version (v)         - Display Poll2 version information\n";
@@ -749,9 +1131,35 @@ void Poll::show_status(){
 		std::cout << "   Shared memory   - " << yesno(shm_mode) << std::endl;
 		std::cout << "   Write to disk   - " << yesno(record_data) << std::endl;
 		std::cout << "   File open       - " << yesno(output_file.IsOpen()) << std::endl;
+		if(spillRing){
+			std::cout << "   Write queue     - " << spillRing->GetDepth(writerID) << "/" << spillRing->GetNumSlots() << " (" << spillRing->GetStalls() << " stalls)" << std::endl;
+			std::cout << "   Bcast dropped   - " << spillRing->GetDropped(broadcastID) << " of " << spillRing->GetPublished() << " spills" << std::endl;
+			if(spillShm){ std::cout << "   Shm ring        - " << spillShm->GetWritten() << " spills (" << spillShm->GetDropped() << " too large)" << std::endl; }
+			if(metricsServer){ std::cout << "   Metrics         - port " << metrics_port << ", " << metricsServer->GetScrapes() << " scrapes" << std::endl; }
+			if(streamServer){ std::cout << "   TCP stream      - " << streamServer->GetNumClients() << " clients, " << streamServer->GetDropped() + spillRing->GetDropped(streamID) << " spills dropped, " << streamServer->GetSkipped() << " skipped by subscriptions" << std::endl; }
+		}
+		if(partialEvents){
+			for(unsigned short mod = 0; mod < n_cards; mod++){
+				if(partialEvents[mod].numReads == 0){ continue; }
+				std::cout << "   Partial mod " << std::setw(2) << mod << "  - " << partialEvents[mod].numPartial << " of " << partialEvents[mod].numReads << " reads";
+				if(partialEvents[mod].numPartial > 0){ std::cout << " (avg " << partialEvents[mod].partialWords / partialEvents[mod].numPartial << " words)"; }
+				std::cout << std::endl;
+			}
+		}
+		if(!statsTimes.empty()){
+			std::lock_guard<std::mutex> lock(stats_mutex);
+			time_t lastRead = *std::max_element(statsTimes.begin(), statsTimes.end());
+			std::cout << "   Module stats    - " << statsRefreshes << " reads";
+			if(lastRead > 0){ std::cout << ", last " << (long)difftime(time(NULL), lastRead) << " s ago"; }
+			std::cout << std::endl;
+		}
 		std::cout << "   Rebooting       - " << yesno(do_reboot) << std::endl;
 		std::cout << "   Force Spill     - " << yesno(force_spill) << std::endl;
-		std::cout << "   Do MCA run      - " << yesno(do_MCA_run) << std::endl;	
+		std::cout << "   Do MCA run      - " << yesno(do_MCA_run) << std::endl;
+		if(live_mca){
+			std::lock_guard<std::mutex> lock(liveMca_mutex);
+			std::cout << "   Live MCA        - " << liveMcaUpdates << " updates of " << liveMca_args.GetBasename() << std::endl;
+		}	
 	}
 	else{ std::cout << "   Pacman mode     - " << yesno(pac_mode) << std::endl; }
 	std::cout << "   Run ctrl Exited - " << yesno(run_ctrl_exit) << std::endl;
@@ -763,6 +1171,13 @@ void Poll::show_status(){
 	std::cout << "   Send alarm  - " << yesno(send_alarm) << std::endl;
 	std::cout << "   Show rates  - " << yesno(show_module_rates) << std::endl;
 	std::cout << "   Zero clocks - " << yesno(zero_clocks) << std::endl;
+	std::cout << "   Pipeline    - " << yesno(pipeline_readout) << std::endl;
+	std::cout << "   Adaptive    - " << yesno(adaptive_polling) << std::endl;
+	std::cout << "   Par. setup  - " << yesno(parallel_setup) << std::endl;
+	std::cout << "   MCA refresh - " << mca_args.GetRefresh() << " s" << std::endl;
+	std::cout << "   Live MCA    - " << yesno(live_mca);
+	if(live_mca){ std::cout << " (every " << liveMca_args.GetRefresh() << " s)"; }
+	std::cout << std::endl;
 	std::cout << "   Debug mode  - " << yesno(debug_mode) << std::endl;
 	std::cout << "   Initialized - " << yesno(init) << std::endl;
 }
@@ -770,6 +1185,37 @@ void Poll::show_status(){
 void Poll::show_thresh() {
 	float threshPercent = (float) threshWords / EXTERNAL_FIFO_LENGTH * 100;
 	std::cout << sys_message_head << "Polling Threshold = " << threshPercent << "% (" << threshWords << "/" << EXTERNAL_FIFO_LENGTH << ")\n";
+	if (adaptive_polling) {
+		std::cout << sys_message_head << "Adaptive Threshold = " << (float) adaptThreshWords / EXTERNAL_FIFO_LENGTH * 100 << "% (" << adaptThreshWords << "/" << EXTERNAL_FIFO_LENGTH << "), poll interval = " << pollInterval << " us\n";
+	}
+}
+
+/// Display the cached statistics of a module.
+void Poll::show_stats(int mod_){
+	if(mod_ < 0 || (size_t)mod_ >= n_cards){
+		std::cout << sys_message_head << "Invalid module " << mod_ << "\n";
+		return;
+	}
+
+	//Copy the statistics out of the cache so that printing never holds up statsThread.
+	std::vector<word_t> stats(PixieInterface::STAT_SIZE);
+	time_t readTime;
+	{
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		readTime = statsTimes[mod_];
+		std::copy(statsCache.begin() + mod_ * PixieInterface::STAT_SIZE, statsCache.begin() + (mod_ + 1) * PixieInterface::STAT_SIZE, stats.begin());
+	}
+	if(readTime == 0){
+		std::cout << sys_message_head << "No statistics read from module " << mod_ << " yet, they are read while a run is on.\n";
+		return;
+	}
+
+	std::cout << "  Module " << mod_ << " statistics, read " << (long)difftime(time(NULL), readTime) << " s ago, real time " << pif->GetRealTime(stats.data(), mod_) << " s:\n";
+	std::cout << "   Chan      ICR (/s)      OCR (/s)   Live (s)\n";
+	for(unsigned int ch = 0; ch < pif->GetNumberChannels(); ch++){
+		std::cout << "   " << std::setw(4) << ch << std::setw(14) << pif->GetInputCountRate(stats.data(), mod_, ch);
+		std::cout << std::setw(14) << pif->GetOutputCountRate(stats.data(), mod_, ch) << std::setw(11) << pif->GetLiveTime(stats.data(), mod_, ch) << std::endl;
+	}
 }
 
 /// Acquire raw traces from a pixie module.
@@ -992,6 +1438,15 @@ void Poll::CommandControl(){
 			}
 			show_thresh();
 		}
+		else if(cmd == "stats"){ // Display the cached module statistics
+			if(p_args >= 1){
+				if(!IsNumeric(arguments.at(0), sys_message_head, "Invalid module specification")) continue;
+				show_stats(atoi(arguments.at(0).c_str()));
+			}
+			else{
+				for(size_t mod = 0; mod < n_cards; mod++) show_stats(mod);
+			}
+		}
 		else if(cmd == "dump"){ // Dump pixie parameters to file
 			std::ofstream ofile;
 			
@@ -1045,7 +1500,7 @@ void Poll::CommandControl(){
 					double value = std::strtod(arguments.at(3).c_str(), NULL);
 				
 					ParameterChannelWriter writer;
-					if(forChannel(pif, mod, ch, writer, make_pair(arguments.at(2), value))){ pif->SaveDSPParameters(); }
+					if(forChannelParallel(pif, mod, ch, writer, make_pair(arguments.at(2), value))){ pif->SaveDSPParameters(); }
 				}
 				else{
 					std::cout << sys_message_head << "Invalid number of parameters to pwrite\n";
@@ -1061,7 +1516,7 @@ void Poll::CommandControl(){
 					unsigned int value = (unsigned int)std::strtoul(arguments.at(2).c_str(), NULL, 0);
 				
 					ParameterModuleWriter writer;
-					if(forModule(pif, mod, writer, make_pair(arguments.at(1), value))){ pif->SaveDSPParameters(); }
+					if(forModuleParallel(pif, mod, writer, make_pair(arguments.at(1), value))){ pif->SaveDSPParameters(); }
 				}
 				else{
 					std::cout << sys_message_head << "Invalid number of parameters to pmwrite\n";
@@ -1084,7 +1539,7 @@ void Poll::CommandControl(){
 					int ch = atoi(arguments.at(1).c_str());
 				
 					ParameterChannelReader reader;
-					forChannel(pif, mod, ch, reader, arguments.at(2));
+					forChannelParallel(pif, mod, ch, reader, arguments.at(2));
 				}
 				else{
 					std::cout << sys_message_head << "Invalid number of parameters to pread\n";
@@ -1098,7 +1553,7 @@ void Poll::CommandControl(){
 					int mod = atoi(arguments.at(0).c_str());
 				
 					ParameterModuleReader reader;
-					forModule(pif, mod, reader, arguments.at(1));
+					forModuleParallel(pif, mod, reader, arguments.at(1));
 				}
 				else{
 					std::cout << sys_message_head << "Invalid number of parameters to pmread\n";
@@ -1116,6 +1571,12 @@ void Poll::CommandControl(){
 				if(!IsNumeric(arguments.at(0), sys_message_head, "Invalid module specification")) continue;
 				int mod = atoi(arguments.at(0).c_str());
 				
+				//All modules are adjusted at once, and concurrently with parallel setup.
+				if(mod < 0){
+					if(pif->AdjustOffsets()){ pif->SaveDSPParameters(); }
+					continue;
+				}
+
 				OffsetAdjuster adjuster;
 				if(forModule(pif, mod, adjuster, 0)){ pif->SaveDSPParameters(); }
 			}
@@ -1158,7 +1619,7 @@ void Poll::CommandControl(){
 				flipper.SetCSRAbit(arguments.at(2));
 				
 				std::string dum_str = "CHANNEL_CSRA";
-				if(forChannel(pif, atoi(arguments.at(0).c_str()), atoi(arguments.at(1).c_str()), flipper, dum_str)){
+				if(forChannelParallel(pif, atoi(arguments.at(0).c_str()), atoi(arguments.at(1).c_str()), flipper, dum_str)){
 					pif->SaveDSPParameters();
 				}
 			}
@@ -1182,7 +1643,7 @@ void Poll::CommandControl(){
 				else if(!IsNumeric(arguments.at(3), sys_message_head, "Invalid bit number specification")) continue;
 				flipper.SetBit(arguments.at(3));
 
-				if(forChannel(pif, atoi(arguments.at(0).c_str()), atoi(arguments.at(1).c_str()), flipper, arguments.at(2))){
+				if(forChannelParallel(pif, atoi(arguments.at(0).c_str()), atoi(arguments.at(1).c_str()), flipper, arguments.at(2))){
 					pif->SaveDSPParameters();
 				}
 			}
@@ -1269,6 +1730,28 @@ void Poll::CommandControl(){
 				is_quiet = true;
 			}
 		}
+		else if(cmd == "adaptive"){ // Toggle adaptive FIFO polling
+			if(adaptive_polling){
+				std::cout << sys_message_head << "Toggling adaptive polling OFF\n";
+				adaptive_polling = false;
+			}
+			else{
+				std::cout << sys_message_head << "Toggling adaptive polling ON\n";
+				adaptThreshWords = std::min(threshWords, (size_t)(ADAPT_MIN_FILL * EXTERNAL_FIFO_LENGTH));
+				pollInterval = ADAPT_MIN_INTERVAL;
+				adaptive_polling = true;
+			}
+		}
+		else if(cmd == "pipeline"){ // Toggle parsing of module data while the next module is read
+			if(pipeline_readout){
+				std::cout << sys_message_head << "Toggling pipelined FIFO readout OFF\n";
+				pipeline_readout = false;
+			}
+			else{
+				std::cout << sys_message_head << "Toggling pipelined FIFO readout ON\n";
+				pipeline_readout = true;
+			}
+		}
 		else if(cmd == "debug"){ // Toggle debug mode
 			if(debug_mode){
 				std::cout << sys_message_head << "Toggling debug mode OFF\n";
@@ -1412,11 +1895,15 @@ void Poll::CommandControl(){
 			else if(cmd == "oform"){ // Change the output file format
 				if(arg != ""){
 					int format = atoi(arg.c_str());
-					if(format == 0 || format == 1 || format == 2){
+					if(format == 3 && !PLD_data::CompressionAvailable()){
+						std::cout << sys_message_head << "Compressed .pld output is unavailable, zlib support was not compiled in.\n";
+					}
+					else if(format == 0 || format == 1 || format == 2 || format == 3){
 						output_format = atoi(arg.c_str());
 						std::cout << sys_message_head << "Set output file format to '" << output_format << "'\n";
 						if(output_format == 1){ std::cout << "  Warning! This output format is experimental and is not recommended for data taking\n"; }
 						else if(output_format == 2){ std::cout << "  Warning! This output format is experimental and is not recommended for data taking\n"; }
+						else if(output_format == 3){ std::cout << "  Warning! This output format is experimental and is not recommended for data taking\n"; }
 						output_file.SetFileFormat(output_format);
 					}
 					else{ 
@@ -1425,11 +1912,29 @@ void Poll::CommandControl(){
 						std::cout << "   0 - .ldf (HRIBF) file format (default)\n";
 						std::cout << "   1 - .pld (PIXIE) file format (experimental)\n";
 						std::cout << "   2 - .root file format (slow, not recommended)\n";
+						std::cout << "   3 - .pldz (compressed PIXIE) file format (experimental)\n";
 					}
 				}
 				else{ std::cout << sys_message_head << "Using output file format '" << output_format << "'\n"; }
 				if(output_file.IsOpen()){ std::cout << sys_message_head << "New output format used for new files only! Current file is unchanged.\n"; }
 			}
+			else if((cmd == "mca" || cmd == "MCA") && p_args >= 1 && arguments.at(0) == "live"){ // Read the histograms during list-mode runs
+				if(p_args >= 2 && arguments.at(1) == "off"){ live_mca = false; }
+				else{
+					size_t arg = 1;
+					if(p_args > arg && (arguments.at(arg) == "root" || arguments.at(arg) == "damm")){ liveMca_args.SetUseRoot(arguments.at(arg++) == "root"); }
+					if(p_args > arg){
+						float refresh = atof(arguments.at(arg++).c_str());
+						if(refresh > 0){ liveMca_args.SetRefresh(refresh); }
+						else{ std::cout << sys_message_head << "Invalid refresh time, using " << liveMca_args.GetRefresh() << " s\n"; }
+					}
+					if(p_args > arg){ liveMca_args.SetBasename(arguments.at(arg)); }
+					live_mca = true;
+					std::cout << sys_message_head << "Reading the histograms into '" << liveMca_args.GetBasename() << "' every " << liveMca_args.GetRefresh() << " s during runs\n";
+				}
+				std::lock_guard<std::mutex> lock(liveMca_mutex);
+				liveMcaCond.notify_all();
+			}
 			else if(cmd == "mca" || cmd == "MCA"){ // Run MCA program using either root or damm
 				if(do_MCA_run){
 					std::cout << sys_message_head << "MCA program is already running\n\n";
@@ -1474,6 +1979,10 @@ void Poll::CommandControl(){
 void Poll::RunControl(){
 	time_t acqStartTime;
 	time_t currentTime;
+
+	//This thread reads the FIFOs, so it is the one to pin and to prioritise.
+	setup_readout_thread();
+
 	while(true){
 		if(kill_all){ // Supersedes all other commands
 			if(acq_running || mca_args.IsRunning()){ do_stop_acq = true; } // Safety catch
@@ -1515,7 +2024,7 @@ void Poll::RunControl(){
 					do_MCA_run = false;
 				}
 				else{
-					sleep(1); // Sleep for a small amount of time.
+					usleep(mca_args.GetRefresh() * 1e6); // Sleep until the next histogram update.
 					if(!mca_args.Step()){ // Update the histograms.
 						std::cout << Display::ErrorStr("Run TERMINATED") << std::endl;
 						mca_args.Close(pif);
@@ -1533,6 +2042,7 @@ void Poll::RunControl(){
 					//Close a file if open
 					if(output_file.IsOpen()){ 
 						std::cout << Display::WarningStr() << " Unexpected output file open!\n";
+						spillRing->Flush();
 						CloseOutputFile(); 
 					}
 
@@ -1553,9 +2063,14 @@ void Poll::RunControl(){
 					else std::cout << "Acq";
 					std::cout << " started on " << ctime(&acqStartTime);
 
-					acq_running = true;
 					startTime = usGetTime(0);
 					lastSpillTime = 0;
+					for(size_t crate = 0; crate < crates.size(); crate++){ crates[crate]->lastSpillTime = 0; }
+					acq_running = true;
+
+					//Start with small reads, polled often, until the data rate has been measured.
+					adaptThreshWords = std::min(threshWords, (size_t)(ADAPT_MIN_FILL * EXTERNAL_FIFO_LENGTH));
+					pollInterval = ADAPT_MIN_INTERVAL;
 				}
 				else{ 
 					std::cout << sys_message_head << "Failed to start list mode run. Try rebooting PIXIE\n"; 
@@ -1580,7 +2095,7 @@ void Poll::RunControl(){
 			//Handle a stop signal
 			if(do_stop_acq){ 
 				// Read data from the modules.
-				ReadFIFO();
+				ReadAllFIFOs();
 
 				// Instruct all modules to end the current run.
 				pif->EndRun();
@@ -1596,16 +2111,18 @@ void Poll::RunControl(){
 						//We sleep to allow the module to finish.
 						sleep(1);
 						//We read the FIFO out.
-						ReadFIFO();
+						for(size_t crate = 0; crate < crates.size(); crate++){
+							if(mod >= crates[crate]->firstMod && mod < crates[crate]->firstMod + crates[crate]->nMods) ReadFIFO(crate);
+						}
 					}
 
 					//Print the module status.
 					std::stringstream leader;
 					leader << "Run end status in module " << mod;
-					if (!partialEvents[mod].empty()) {
+					if (partialEvents[mod].nWords > 0) {
 						///\bug Warning Str colors oversets the number of characters.
 						leader << Display::WarningStr(" (partial evt)");
-						partialEvents[mod].clear();
+						partialEvents[mod].nWords = 0;
 					}
 					
 					Display::LeaderPrint(leader.str());
@@ -1626,12 +2143,14 @@ void Poll::RunControl(){
 				statsHandler->Dump();
 				statsHandler->ClearTotals();
 
-				//Close the output file
+				//Wait for the writer thread and close the output file
+				spillRing->Flush();
 				if(output_file.IsOpen()) CloseOutputFile();
 
 				//Reset status flags
 				do_stop_acq = false;
 				acq_running = false;
+				if (metricsServer) update_metrics();
 			} //if (do_stop_acq) -- End of handling a stop acq flag
 			
 			// Read data from the modules.
@@ -1672,6 +2191,7 @@ void Poll::UpdateStatus() {
 	if (file_open) {
 		if (acq_running && !record_data) status << TermColors::DkYellow;
 		//Add file size to status
+		std::lock_guard<std::mutex> lock(output_mutex);
 		status << " " << humanReadable(output_file.GetFilesize());
 		status << " " << output_file.GetCurrentFilename();
 		if (acq_running && !record_data) status << TermColors::Reset;
@@ -1684,204 +2204,575 @@ void Poll::UpdateStatus() {
 
 void Poll::ReadScalers() {
 	static std::vector< std::pair<double, double> > xiaRates(16, std::make_pair<double, double>(0,0));
+	static std::vector<double> liveTimes(16, 0.0);
 	static int numChPerMod = pif->GetNumberChannels();
 
+	//The statistics were read by statsThread, the modules are not touched here.
+	std::lock_guard<std::mutex> lock(stats_mutex);
 	for (unsigned short mod=0;mod < n_cards; mod++) {
-		//Tell interface to get stats data from the modules.
-		pif->GetStatistics(mod);
+		//A module not yet read keeps its previous rates.
+		if (statsTimes[mod] == 0) continue;
+		word_t *stats = &statsCache[mod * PixieInterface::STAT_SIZE];
 
-		for (int ch=0;ch< numChPerMod; ch++) 
-			xiaRates[ch] = std::make_pair<double, double>(pif->GetInputCountRate(mod, ch),pif->GetOutputCountRate(mod,ch));
+		for (int ch=0;ch< numChPerMod; ch++) {
+			xiaRates[ch] = std::make_pair<double, double>(pif->GetInputCountRate(stats, mod, ch),pif->GetOutputCountRate(stats, mod, ch));
+			liveTimes[ch] = pif->GetLiveTime(stats, mod, ch);
+		}
 
-		//Populate Stats Handler with ICR and OCR.
+		//Populate Stats Handler with ICR, OCR and the live and real times.
 		statsHandler->SetXiaRates(mod, &xiaRates);
+		statsHandler->SetXiaTimes(mod, &liveTimes, pif->GetRealTime(stats, mod));
+	}
+}
+
+void Poll::StatsControl() {
+	//Lower the priority of the thread. SCHED_IDLE is not used as the thread briefly holds the
+	//lock of a crate, which a SCHED_FIFO readout would then wait on for as long as it is starved.
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+
+	std::vector<word_t> stats(PixieInterface::STAT_SIZE);
+	std::unique_lock<std::mutex> lock(stats_mutex);
+	while (!kill_all) {
+		statsCond.wait_for(lock, std::chrono::seconds(1));
+		//The modules are only read during a run, when nothing but the readout uses them.
+		if (kill_all || !acq_running || do_stop_acq) continue;
+		lock.unlock();
+
+		//Each module is read while its crate is between FIFO reads.
+		for (size_t crate = 0; crate < crates.size() && !kill_all; crate++) {
+			CrateReadout &readout = *crates[crate];
+			for (unsigned short mod = readout.firstMod; mod < readout.firstMod + readout.nMods; mod++) {
+				std::unique_lock<std::mutex> readLock(readout.readMutex);
+				if (!acq_running || do_stop_acq) break;
+				bool okay = pif->ReadStatistics(stats.data(), mod);
+				readLock.unlock();
+				if (!okay) continue;
+
+				std::lock_guard<std::mutex> cacheLock(stats_mutex);
+				std::copy(stats.begin(), stats.end(), statsCache.begin() + mod * PixieInterface::STAT_SIZE);
+				statsTimes[mod] = time(NULL);
+			}
+		}
+
+		lock.lock();
+		statsRefreshes++;
+	}
+}
+
+/** The modules accumulate their energy histograms during list-mode runs as in
+ * MCA runs, so the histograms are read every liveMca_args refresh interval while
+ * a run is on and written to an MCA file of their own, giving online spectra
+ * without any list-mode data being unpacked. Each channel is read while its
+ * crate is between FIFO reads, as the statistics are by StatsControl(). The file
+ * is opened at the first read of a run and closed when the run stops.
+ */
+void Poll::LiveMcaControl() {
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+
+	MCA *mca = NULL;
+	std::unique_lock<std::mutex> lock(liveMca_mutex);
+	while (!kill_all) {
+		liveMcaCond.wait_for(lock, std::chrono::milliseconds((long)(1000 * liveMca_args.GetRefresh())));
+		if (kill_all || !live_mca || !acq_running || do_stop_acq) {
+			delete mca;
+			mca = NULL;
+			continue;
+		}
+
+		if (!mca) {
+			mca = liveMca_args.NewMCA(pif);
+			if (!mca || !mca->IsOpen()) {
+				std::cout << Display::WarningStr("Warning") << ": Failed to open the live MCA output '" << liveMca_args.GetBasename() << "'!\n";
+				delete mca;
+				mca = NULL;
+				live_mca = false;
+				continue;
+			}
+		}
+		lock.unlock();
+
+		mca->BeginUpdate();
+		bool okay = true;
+		for (size_t crate = 0; crate < crates.size() && okay; crate++) {
+			CrateReadout &readout = *crates[crate];
+			for (unsigned short mod = readout.firstMod; mod < readout.firstMod + readout.nMods && okay; mod++) {
+				for (size_t ch = 0; ch < pif->GetNumberChannels() && okay; ch++) {
+					std::lock_guard<std::mutex> readLock(readout.readMutex);
+					okay = (acq_running && !do_stop_acq && !kill_all && mca->ReadChannel(mod, ch));
+				}
+			}
+		}
+		//An update cut short by the end of the run is dropped, the last one is kept in the file.
+		if (okay) mca->FinishUpdate();
+		else mca->CancelUpdate();
+
+		lock.lock();
+		if (okay) liveMcaUpdates++;
 	}
+	delete mca;
 }
-bool Poll::ReadFIFO() {
-	static word_t *fifoData = new word_t[(EXTERNAL_FIFO_LENGTH + 2) * n_cards];
 
-	if (!acq_running) return false;
+/** Parse the FIFO data of a single module to check for corrupted data and to
+ * remove a trailing partial event, which is stored for the next FIFO read. The
+ * module data starts with the two injected words (spill length and module) and
+ * the first of these is set to the final block length.
+ *
+ * \param[in] mod The module the data was read from.
+ * \param[in] modData Pointer to the module block (2 injected words followed by the data).
+ * \param[in,out] nWords The number of data words, reduced by the size of a partial event.
+ * \return True if the data was parsed successfully.
+ */
+bool Poll::parse_module(unsigned short mod, word_t *modData, word_t &nWords){
+	word_t *data = &modData[2];
+
+	//We now ned to parse the event to determine if there is a hanging event. Also, allows a check for corrupted data.
+	size_t parseWords = 0;
+	//We declare the eventSize outside the loop in case there is a partial event.
+	word_t eventSize = 0;
+	word_t slotExpected = pif->GetSlotNumber(mod);
+	//The events of each channel are counted here and given to the statsHandler once the module is parsed.
+	unsigned int channelEvents[NUM_CHAN_PER_MOD] = {0};
+	size_t eventBytes = 0;
+	while (parseWords < nWords) {
+		//Check first word to see if data makes sense.
+		// We check the slot, channel and event size.
+		word_t slotRead = ((data[parseWords] & 0xF0) >> 4);
+		word_t chanRead = (data[parseWords] & 0xF);
+		eventSize = ((data[parseWords] & 0x7FFE2000) >> 17);
+		bool virtualChannel = ((data[parseWords] & 0x20000000) != 0);
+
+		if( slotRead != slotExpected ){ 
+			std::cout << Display::ErrorStr() << " Slot read (" << slotRead 
+				<< ") not the same as" << " slot expected (" 
+				<< slotExpected << ")" << std::endl; 
+			break;
+		}
+		else if (chanRead < 0 || chanRead > 15) {
+			std::cout << Display::ErrorStr() << " Channel read (" << chanRead << ") not valid!\n";
+			break;
+		}
+		else if(eventSize == 0){ 
+			std::cout << Display::ErrorStr() << "ZERO EVENT SIZE in mod " << mod << "!\n"; 
+			break;
+		}
+
+		//Count the event for the statsHandler (for monitor.bash)
+		if(!virtualChannel){
+			channelEvents[chanRead]++;
+			eventBytes += sizeof(word_t) * eventSize;
+		}
+
+		//Iterate to the next event and continue parsing
+		parseWords += eventSize;
+	}
+
+	//Update the statsHandler with the events of the module in one call.
+	if (statsHandler) statsHandler->AddEvents(mod, channelEvents, eventBytes);
+
+	//We now check the outcome of the data parsing.
+	//If we have too many words as an event was not completely pulled form the FIFO
+	if (parseWords > nWords) {
+		word_t missingWords = parseWords - nWords;
+		word_t partialSize = eventSize - missingWords;
+		if (debug_mode) std::cout << "Partial event " << partialSize << "/" << eventSize << " words!\n";
+
+		//The carry region in front of each module's DMA target only holds a partial event up to maxEventSize.
+		if (partialSize > maxEventSize) {
+			std::cout << Display::ErrorStr() << " Partial event of " << partialSize << " words in mod " << mod << " is larger than the maximum event size!\n";
+			return false;
+		}
+
+		//We could get the words now from the FIFO, but me may have to wait. Instead the partial event is
+		//left where it is, and moved in front of the next FIFO read of this module.
+		partialEvents[mod].data = &data[parseWords - eventSize];
+		partialEvents[mod].nWords = partialSize;
+		partialEvents[mod].numPartial++;
+		partialEvents[mod].partialWords += partialSize;
+
+		//Update the number of words to indicate removal or partial event.
+		nWords -= partialSize;
+	}
+	//If parseWords is small then the parse failed for some reason
+	else if (parseWords < nWords) {
+		std::cout << Display::ErrorStr() << " Parsing indicated corrupted data at " << parseWords << " words into FIFO.\n";
+
+		std::cout << std::hex;
+		//Print the previous words
+		std::cout << "Words prior to parsing error:\n";
+		for(size_t i = (parseWords > 100 ? parseWords - 100 : 0); i < parseWords; i++) {
+			if (i%10 == 0) std::cout << std::endl << "\t";
+			std::cout << data[i] << " ";
+		}
+		//Print the following words 
+		std::cout << "Words following parsing error:\n";
+		for(size_t i = parseWords; i < parseWords + 100 && i < nWords; i++) {
+			if (i%10 == 0) std::cout << std::endl << "\t";
+			std::cout << data[i] << " ";
+		}
+		std::cout << std::dec << std::endl;
+
+		return false;
+	}
+
+	//Assign the first injected word of spill to final spill length
+	modData[0] = nWords + 2;
+
+	return true;
+}
+
+/** Size the FIFO threshold and poll interval used by adaptive polling from the
+ * data rate of the fastest module, as measured by the StatsHandler. The threshold
+ * is the amount of data which arrives within ADAPT_MAX_LATENCY, kept between
+ * ADAPT_MIN_FILL of the FIFO and the user threshold. High rates therefore give
+ * large reads and low rates give low latency.
+ */
+void Poll::update_polling(){
+	//Find the fastest filling module (in words per second).
+	double maxRate = 0;
+	for (unsigned short mod=0; mod < n_cards; mod++) {
+		maxRate = std::max(maxRate, statsHandler->GetDataRate(mod) / sizeof(word_t));
+	}
+
+	size_t minThresh = ADAPT_MIN_FILL * EXTERNAL_FIFO_LENGTH;
+	double target = maxRate * ADAPT_MAX_LATENCY;
+	if (target < minThresh) adaptThreshWords = minThresh;
+	else if (target > threshWords) adaptThreshWords = threshWords;
+	else adaptThreshWords = target;
+	if (adaptThreshWords > threshWords) adaptThreshWords = threshWords;
+
+	//Poll several times while the FIFO fills up to the threshold.
+	double interval = ADAPT_MAX_INTERVAL;
+	if (maxRate > 0) interval = 1e6 * adaptThreshWords / (maxRate * ADAPT_POLLS_PER_FILL);
+	if (interval < ADAPT_MIN_INTERVAL) pollInterval = ADAPT_MIN_INTERVAL;
+	else if (interval > ADAPT_MAX_INTERVAL) pollInterval = ADAPT_MAX_INTERVAL;
+	else pollInterval = interval;
+
+	if (debug_mode) {
+		std::cout << "Adaptive polling: " << maxRate << " words/s, threshold " << adaptThreshWords;
+		std::cout << "/" << EXTERNAL_FIFO_LENGTH << " words, interval " << pollInterval << " us\n";
+	}
+}
+
+/** Build the metrics snapshot served by the metrics endpoint, in the Prometheus
+ * text format. Rates are those of the last stats interval, so this is called
+ * after the StatsHandler has been dumped and before its rates are cleared.
+ * Counters only ever increase, so the scraper may take rates of its own.
+ */
+void Poll::update_metrics(){
+	std::stringstream output;
+
+	output << "# HELP poll2_acq_running Whether an acquisition is running.\n";
+	output << "# TYPE poll2_acq_running gauge\n";
+	output << "poll2_acq_running " << (acq_running ? 1 : 0) << "\n";
+	output << "# HELP poll2_run_time_seconds Time since the start of the run.\n";
+	output << "# TYPE poll2_run_time_seconds gauge\n";
+	output << "poll2_run_time_seconds " << statsHandler->GetTotalTime() << "\n";
+	output << "# HELP poll2_data_rate_bytes Rate of data read from all modules, in bytes per second.\n";
+	output << "# TYPE poll2_data_rate_bytes gauge\n";
+	output << "poll2_data_rate_bytes " << statsHandler->GetTotalDataRate() << "\n";
+
+	output << "# HELP poll2_module_data_rate_bytes Rate of data read from a module, in bytes per second.\n";
+	output << "# TYPE poll2_module_data_rate_bytes gauge\n";
+	for (unsigned short mod=0; mod < n_cards; mod++)
+		output << "poll2_module_data_rate_bytes{module=\"" << mod << "\"} " << statsHandler->GetDataRate(mod) << "\n";
+	output << "# HELP poll2_module_event_rate_hz Rate of events read from a module.\n";
+	output << "# TYPE poll2_module_event_rate_hz gauge\n";
+	for (unsigned short mod=0; mod < n_cards; mod++)
+		output << "poll2_module_event_rate_hz{module=\"" << mod << "\"} " << statsHandler->GetEventRate(mod) << "\n";
+	output << "# HELP poll2_module_fifo_fill_ratio Fraction of a module FIFO in use at the last read.\n";
+	output << "# TYPE poll2_module_fifo_fill_ratio gauge\n";
+	for (unsigned short mod=0; mod < n_cards; mod++)
+		output << "poll2_module_fifo_fill_ratio{module=\"" << mod << "\"} " << (double)statsHandler->GetFifoWords(mod) / EXTERNAL_FIFO_LENGTH << "\n";
+	output << "# HELP poll2_module_fifo_peak_ratio Largest fraction of a module FIFO in use during the last interval.\n";
+	output << "# TYPE poll2_module_fifo_peak_ratio gauge\n";
+	for (unsigned short mod=0; mod < n_cards; mod++)
+		output << "poll2_module_fifo_peak_ratio{module=\"" << mod << "\"} " << (double)statsHandler->GetFifoPeak(mod) / EXTERNAL_FIFO_LENGTH << "\n";
+	output << "# HELP poll2_module_partial_events_total FIFO reads of a module which ended in a partial event.\n";
+	output << "# TYPE poll2_module_partial_events_total counter\n";
+	for (unsigned short mod=0; mod < n_cards; mod++)
+		output << "poll2_module_partial_events_total{module=\"" << mod << "\"} " << partialEvents[mod].numPartial << "\n";
+
+	output << "# HELP poll2_written_bytes_total Bytes of data written to output files.\n";
+	output << "# TYPE poll2_written_bytes_total counter\n";
+	output << "poll2_written_bytes_total " << bytesWritten << "\n";
+	output << "# HELP poll2_written_spills_total Spills written to output files.\n";
+	output << "# TYPE poll2_written_spills_total counter\n";
+	output << "poll2_written_spills_total " << spillsWritten << "\n";
+
+	output << "# HELP poll2_spills_total Spills read from the modules.\n";
+	output << "# TYPE poll2_spills_total counter\n";
+	output << "poll2_spills_total " << spillRing->GetPublished() << "\n";
+	output << "# HELP poll2_write_queue_spills Spills waiting to be written to disk.\n";
+	output << "# TYPE poll2_write_queue_spills gauge\n";
+	output << "poll2_write_queue_spills " << spillRing->GetDepth(writerID) << "\n";
+	output << "# HELP poll2_write_stalls_total Times the readout waited on the disk writer.\n";
+	output << "# TYPE poll2_write_stalls_total counter\n";
+	output << "poll2_write_stalls_total " << spillRing->GetStalls() << "\n";
+	output << "# HELP poll2_broadcast_dropped_spills_total Spills the network broadcast fell behind on and dropped.\n";
+	output << "# TYPE poll2_broadcast_dropped_spills_total counter\n";
+	output << "poll2_broadcast_dropped_spills_total " << spillRing->GetDropped(broadcastID) << "\n";
+	if (streamServer) {
+		output << "# HELP poll2_stream_clients Subscribers to the TCP spill stream.\n";
+		output << "# TYPE poll2_stream_clients gauge\n";
+		output << "poll2_stream_clients " << streamServer->GetNumClients() << "\n";
+		output << "# HELP poll2_stream_dropped_spills_total Spills dropped by the TCP spill stream.\n";
+		output << "# TYPE poll2_stream_dropped_spills_total counter\n";
+		output << "poll2_stream_dropped_spills_total " << streamServer->GetDropped() + spillRing->GetDropped(streamID) << "\n";
+	}
+	if (spillShm) {
+		output << "# HELP poll2_shm_dropped_spills_total Spills too large for the shared memory ring.\n";
+		output << "# TYPE poll2_shm_dropped_spills_total counter\n";
+		output << "poll2_shm_dropped_spills_total " << spillShm->GetDropped() << "\n";
+	}
+
+	metricsServer->Update(output.str());
+}
+
+void Poll::setup_readout_thread(){
+	//Without a chosen core, the thread is kept on the node of the modules so the
+	//buffers it touches first are allocated there.
+	if(readout_core >= 0){ pin_thread(pthread_self(), readout_core, "readout", pixieNode); }
+	else if(pixieNode >= 0 && huge_buffers){
+		cpu_set_t cpus;
+		if(get_node_cpus(pixieNode, cpus)){
+			Display::LeaderPrint("Keeping readout thread on node " + std::to_string(pixieNode));
+			int retval = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+			if(retval == 0){ std::cout << Display::OkayStr() << std::endl; }
+			else{ std::cout << Display::ErrorStr() << " " << strerror(retval) << std::endl; }
+		}
+	}
+
+	if(readout_priority > 0){
+		Display::LeaderPrint("Setting readout to SCHED_FIFO priority " + std::to_string(readout_priority));
+		struct sched_param param;
+		param.sched_priority = readout_priority;
+		int retval = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if(retval == 0){ std::cout << Display::OkayStr() << std::endl; }
+		else{ std::cout << Display::ErrorStr() << " " << strerror(retval) << std::endl; }
+	}
+}
+
+word_t *Poll::alloc_fifo_buffer(const size_t &nWords){
+	if(!huge_buffers){ return new word_t[nWords]; }
+
+	//The buffer lives as long as poll2, so it is never unmapped. The pages are
+	//touched here, from the readout thread, so that they are placed on its node.
+	size_t length = ((nWords * sizeof(word_t) + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE) * HUGEPAGE_SIZE;
+	void *buffer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if(buffer == MAP_FAILED){
+		std::cout << Display::WarningStr("Warning") << ": No hugepages for the FIFO buffer (" << strerror(errno) << "), using transparent hugepages.\n";
+		buffer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(buffer == MAP_FAILED){ return new word_t[nWords]; }
+		madvise(buffer, length, MADV_HUGEPAGE);
+	}
+	memset(buffer, 0, length);
+
+	return (word_t*)buffer;
+}
+
+void Poll::ReadAllFIFOs() {
+	for (size_t crate = 0; crate < crates.size(); crate++) ReadFIFO(crate);
+}
+
+void Poll::CrateControl(unsigned int crate_) {
+	while (!kill_all) {
+		//The final reads of a stopping run are made by RunControl.
+		if (acq_running && !do_stop_acq) ReadFIFO(crate_);
+		else usleep(10000);
+	}
+}
+
+bool Poll::ReadFIFO(unsigned int crate_/*=0*/) {
+	//Each module is read into its own block so that a module may be parsed while the next one is read.
+	//The FIFO is always read to the same place in the block. In front of it is a carry region for the
+	//partial event left by the previous read, preceded by the 2 injected words (size and module).
+	static const size_t carryWords = maxEventSize + 2;
+	static const size_t moduleStride = carryWords + EXTERNAL_FIFO_LENGTH;
+
+	if (!acq_running || crate_ >= crates.size()) return false;
+
+	CrateReadout &crate = *crates[crate_];
+	std::lock_guard<std::mutex> readLock(crate.readMutex);
+	if (do_stop_acq && std::this_thread::get_id() == crate.thread.get_id()) return true;
+	if (!crate.fifoData) crate.fifoData = alloc_fifo_buffer(moduleStride * crate.nMods);
+	word_t *fifoData = crate.fifoData;
+	std::vector<word_t*> &modBlocks = crate.modBlocks;
+	std::vector<SpillRing::Segment> &segments = crate.segments;
+	const unsigned short firstMod = crate.firstMod;
+	const unsigned short nMods = crate.nMods;
+
+	//A forced spill reads every crate.
+	if (force_spill) {
+		for (size_t i = 0; i < crates.size(); i++) crates[i]->forceSpill = true;
+		force_spill = false;
+	}
+	bool force = crate.forceSpill.exchange(false);
 
 	//Number of words in the FIFO of each module.
-	std::vector<word_t> nWords(n_cards);
+	std::vector<word_t> nWords(nMods);
 	//Iterator to determine which card has the most words.
 	std::vector<word_t>::iterator maxWords;
 
+	//With adaptive polling the FIFOs are checked once per call and the threshold follows the data rate.
+	size_t thresh = (adaptive_polling ? adaptThreshWords : threshWords);
+	unsigned int tries = (adaptive_polling ? 1 : POLL_TRIES);
+
 	//We loop until the FIFO has reached the threshold for any module unless we are stopping and then we skip the loop.
-	for (unsigned int timeout = 0; timeout < POLL_TRIES; timeout++){ 
+	for (unsigned int timeout = 0; timeout < tries; timeout++){ 
 		//Check the FIFO size for every module
-		for (unsigned short mod=0; mod < n_cards; mod++) {
-			nWords[mod] = pif->CheckFIFOWords(mod);
+		for (unsigned short mod=0; mod < nMods; mod++) {
+			nWords[mod] = pif->CheckFIFOWords(firstMod + mod);
 		}
 		//Find the maximum module
 		maxWords = std::max_element(nWords.begin(), nWords.end());
-		if(*maxWords > threshWords){ break; }
+		if(*maxWords > thresh){ break; }
+	}
+
+	if (adaptive_polling && *maxWords <= thresh && !force) {
+		//Read anyway once data has waited longer than the latency target, otherwise back off.
+		if (usGetTime(startTime) - crate.lastSpillTime < ADAPT_MAX_LATENCY * 1e6) {
+			usleep(pollInterval);
+			return true;
+		}
+		force = true;
+	}
+	else if (adaptive_polling && *maxWords > 2 * thresh) {
+		//The rate rose faster than it was measured, poll as often as possible until the next update.
+		pollInterval = ADAPT_MIN_INTERVAL;
 	}
 
 	//We need to read the data out of the FIFO
-	if (*maxWords > threshWords || force_spill) {
-		force_spill = false;
+	if (*maxWords > thresh || force) {
 		//Number of data words read from the FIFO
 		size_t dataWords = 0;
 
-		//Loop over each module's FIFO
-		for (unsigned short mod=0;mod < n_cards; mod++) {
+		//Parse of the previous module, running while the next module is read out.
+		std::future<bool> parsing;
+		bool parseOkay = true;
+
+		//Loop over each module's FIFO. The injected module numbers start from 0 in every crate.
+		for (unsigned short mod=0;mod < nMods; mod++) {
+			const unsigned short pixieMod = firstMod + mod;
+			word_t *modData = &fifoData[mod * moduleStride];
+			modBlocks[mod] = modData;
+			statsHandler->SetFifoWords(pixieMod, nWords[mod]);
 
 			//if the module has no words in the FIFO we continue to the next module
 			if (nWords[mod] < MIN_FIFO_READ) {
 				// write an empty buffer if there is no data
-				fifoData[dataWords++] = 2;
-				fifoData[dataWords++] = mod;	    
+				modData[0] = 2;
+				modData[1] = mod;	    
 				continue;
 			}
 			else if (nWords[mod] < 0) {
-				std::cout << Display::WarningStr("Number of FIFO words less than 0") << " in module " << mod << std::endl;
+				std::cout << Display::WarningStr("Number of FIFO words less than 0") << " in module " << pixieMod << std::endl;
 				// write an empty buffer if there is no data
-				fifoData[dataWords++] = 2;
-				fifoData[dataWords++] = mod;	    
+				modData[0] = 2;
+				modData[1] = mod;	    
 				continue;
 			}
 
 			//Check if the FIFO is overfilled
 			bool fullFIFO = (nWords[mod] >= EXTERNAL_FIFO_LENGTH);
 			if (fullFIFO) {
-				std::cout << Display::ErrorStr() << " Full FIFO in module " << mod 
+				std::cout << Display::ErrorStr() << " Full FIFO in module " << pixieMod 
 					<< " size: " << nWords[mod] << "/" 
 					<< EXTERNAL_FIFO_LENGTH << Display::ErrorStr(" ABORTING!") << std::endl;
 				had_error = true;
 				do_stop_acq = true;
+				if (parsing.valid()) parsing.wait();
 				return false;
 			}
 
-			//We inject two words describing the size of the FIFO spill and the module.
-			//We inject the size after it has been computedos we skip it for now and only add the module number.
-			dataWords++;
-			fifoData[dataWords++] = mod;
+			//Move the partial event, if we had one, to just in front of the FIFO data. It is
+			//still in the block from the previous read, so this is the only copy made of it.
+			PartialEvent &partial = partialEvents[pixieMod];
+			word_t *fifoTarget = &modData[carryWords];
+			if (partial.nWords > 0) memmove(fifoTarget - partial.nWords, partial.data, partial.nWords * sizeof(word_t));
+			modData = fifoTarget - partial.nWords - 2;
+			modBlocks[mod] = modData;
 
-			//We store the partial event if we had one
-			for (size_t i=0;i<partialEvents[mod].size();i++)
-				fifoData[dataWords + i] = partialEvents[mod].at(i);
+			//We inject two words describing the size of the FIFO spill and the module.
+			//The size is set once the data has been parsed.
+			modData[1] = mod;
 
 			//Try to read FIFO and catch errors.
-			if(!pif->ReadFIFOWords(&fifoData[dataWords + partialEvents[mod].size()], nWords[mod], mod, debug_mode)){
-				std::cout << Display::ErrorStr() << " Unable to read " << nWords[mod] << " from module " << mod << "\n";
+			if(!pif->ReadFIFOWords(fifoTarget, nWords[mod], pixieMod, debug_mode)){
+				std::cout << Display::ErrorStr() << " Unable to read " << nWords[mod] << " from module " << pixieMod << "\n";
 				had_error = true;
 				do_stop_acq = true;
+				if (parsing.valid()) parsing.wait();
 				return false;
 			}
 
 			//Print a message about what we did	
+			//Posted to the terminal, so the readout never waits on the screen.
 			if(!is_quiet || debug_mode) {
-				std::cout << "Read " << nWords[mod] << " words from module " << mod;
-				if (!partialEvents[mod].empty())
-					std::cout << " and stored " << partialEvents[mod].size() << " partial event words";
-				std::cout << " to buffer position " << dataWords << std::endl;
+				std::stringstream msg;
+				msg << "Read " << nWords[mod] << " words from module " << pixieMod;
+				if (partial.nWords > 0)
+					msg << " and stored " << partial.nWords << " partial event words";
+				msg << " to buffer position " << dataWords << "\n";
+				poll_term_->Post(msg.str(), "read " + std::to_string(pixieMod));
 			}
 
 			//After reading the FIFO and printing a sttus message we can update the number of words to include the partial event.
-			nWords[mod] += partialEvents[mod].size();
+			nWords[mod] += partial.nWords;
 			//Clear the partial event
-			partialEvents[mod].clear();
-
-			//We now ned to parse the event to determine if there is a hanging event. Also, allows a check for corrupted data.
-			size_t parseWords = dataWords;
-			//We declare the eventSize outside the loop in case there is a partial event.
-			word_t eventSize = 0;
-			word_t slotExpected = pif->GetSlotNumber(mod);
-			while (parseWords < dataWords + nWords[mod]) {
-				//Check first word to see if data makes sense.
-				// We check the slot, channel and event size.
-				word_t slotRead = ((fifoData[parseWords] & 0xF0) >> 4);
-				word_t chanRead = (fifoData[parseWords] & 0xF);
-				eventSize = ((fifoData[parseWords] & 0x7FFE2000) >> 17);
-				bool virtualChannel = ((fifoData[parseWords] & 0x20000000) != 0);
-
-				if( slotRead != slotExpected ){ 
-					std::cout << Display::ErrorStr() << " Slot read (" << slotRead 
-						<< ") not the same as" << " slot expected (" 
-						<< slotExpected << ")" << std::endl; 
-					break;
-				}
-				else if (chanRead < 0 || chanRead > 15) {
-					std::cout << Display::ErrorStr() << " Channel read (" << chanRead << ") not valid!\n";
-					break;
-				}
-				else if(eventSize == 0){ 
-					std::cout << Display::ErrorStr() << "ZERO EVENT SIZE in mod " << mod << "!\n"; 
-					break;
-				}
-
-				// Update the statsHandler with the event (for monitor.bash)
-				if(!virtualChannel && statsHandler){ 
-					statsHandler->AddEvent(mod, chanRead, sizeof(word_t) * eventSize); 
-				}
-
-				//Iterate to the next event and continue parsing
-				parseWords += eventSize;
+			partial.nWords = 0;
+			partial.numReads++;
+			dataWords += nWords[mod] + 2;
+
+			//Parse the module, either now or while the next module is read.
+			if (pipeline_readout) {
+				if (parsing.valid() && !parsing.get()) parseOkay = false;
+				parsing = std::async(std::launch::async, &Poll::parse_module, this, pixieMod, modData, std::ref(nWords[mod]));
 			}
-
-			//We now check the outcome of the data parsing.
-			//If we have too many words as an event was not completely pulled form the FIFO
-			if (parseWords > dataWords + nWords[mod]) {
-				word_t missingWords = parseWords - dataWords - nWords[mod];
-				word_t partialSize = eventSize - missingWords;
-				if (debug_mode) std::cout << "Partial event " << partialSize << "/" << eventSize << " words!\n";
-
-				//We could get the words now from the FIFO, but me may have to wait. Instead we store the partial event for the next FIFO read.
-				for(unsigned short i=0;i< partialSize;i++) 
-					partialEvents[mod].push_back(fifoData[parseWords - eventSize + i]);
-
-				//Update the number of words to indicate removal or partial event.
-				nWords[mod] -= partialSize;
-
+			else if (!parse_module(pixieMod, modData, nWords[mod])) {
+				parseOkay = false;
 			}
-			//If parseWords is small then the parse failed for some reason
-			else if (parseWords < dataWords + nWords[mod]) {
-				std::cout << Display::ErrorStr() << " Parsing indicated corrupted data at " << parseWords - dataWords << " words into FIFO.\n";
 
-				std::cout << std::hex;
-				//Print the previous words
-				std::cout << "Words prior to parsing error:\n";
-				for(int i=0;i< 100;i++) {
-					if (i%10 == 0) std::cout << std::endl << "\t";
-					std::cout << fifoData[dataWords + parseWords - 100 + i] << " ";
-				}
-				//Print the following words 
-				std::cout << "Words following parsing error:\n";
-				for(int i=0;i< 100;i++) {
-					if (i%10 == 0) std::cout << std::endl << "\t";
-					std::cout << fifoData[dataWords + parseWords + i] << " ";
-				}
-				std::cout << std::dec << std::endl;
+			if (!parseOkay) break;
+		} //End loop over modules for reading FIFO
 
-				do_stop_acq = true;
-				had_error = true;
-				return false;
-			}
+		if (parsing.valid() && !parsing.get()) parseOkay = false;
+		if (!parseOkay) {
+			do_stop_acq = true;
+			had_error = true;
+			return false;
+		}
 
-			//Assign the first injected word of spill to final spill length
-			fifoData[dataWords - 2] = nWords[mod] + 2;
-			//The data should be good so we iterate the position in the storage array.
-			dataWords += nWords[mod];
-		} //End loop over modules for reading FIFO
+		//Join the module blocks into a single spill.
+		segments.clear();
+		dataWords = 0;
+		for (unsigned short mod=0; mod < nMods; mod++) {
+			segments.push_back(SpillRing::Segment(modBlocks[mod], modBlocks[mod][0]));
+			dataWords += modBlocks[mod][0];
+		}
 
 		//Get the length of the spill
 		double spillTime = usGetTime(startTime);
-		double durSpill = spillTime - lastSpillTime;
-		lastSpillTime = spillTime;
+		double durSpill = spillTime - crate.lastSpillTime;
+		crate.lastSpillTime = spillTime;
 
 		// Add time to the statsHandler and check if interval has been exceeded.
 		//If exceed interval we read the scalers from the modules and dump the stats.
-		if (statsHandler->AddTime(durSpill * 1e-6)) {
+		//The time is kept by the first crate alone, the others only add their events.
+		if (crate_ == 0) lastSpillTime = spillTime;
+		if (crate_ == 0 && statsHandler->AddTime(durSpill * 1e-6)) {
 			ReadScalers();
 			statsHandler->Dump();
+			if (adaptive_polling) update_polling();
+			if (metricsServer) update_metrics();
 			statsHandler->ClearRates();
 		}
 
-		if (!is_quiet || debug_mode) std::cout << "Writing/Broadcasting " << dataWords << " words.\n";
-		//We have read the FIFO now we write the data	
-		if (record_data && !pac_mode) write_data(fifoData, dataWords); 
-		broadcast_data(fifoData, dataWords);
+		if (!is_quiet || debug_mode) poll_term_->Post("Writing/Broadcasting " + std::to_string(dataWords) + " words.\n", "broadcast");
+		//We have read the FIFO now we hand the data to the writer and broadcast threads.
+		//The spill is copied into the ring, so fifoData may be reused immediately.
+		//The spill is tagged with its crate, so the broadcast may order the crates in time.
+		std::lock_guard<std::mutex> publishLock(publish_mutex);
+		spillRing->Publish(segments, record_data && !pac_mode, crate_);
 
 	} //If we had exceeded the threshold or forced a flush
 
@@ -0,0 +1,124 @@
+#include <sstream>
+
+#include <poll.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "poll2_metrics.h"
+
+bool MetricsServer::Init(int port_){
+	if(running){ return false; }
+
+	listenSock = socket(AF_INET, SOCK_STREAM, 0);
+	if(listenSock < 0){ return false; } // failed to open socket
+
+	int reuse = 1;
+	setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in serv;
+	bzero(&serv, sizeof(serv));
+	serv.sin_family = AF_INET;
+	serv.sin_addr.s_addr = INADDR_ANY;
+	serv.sin_port = htons(port_);
+
+	if(bind(listenSock, (struct sockaddr *)&serv, sizeof(serv)) < 0 || listen(listenSock, 8) < 0){ // failed to bind to port
+		close(listenSock);
+		listenSock = -1;
+		return false;
+	}
+
+	scrapes = 0;
+	running = true;
+	serverThread = std::thread(&MetricsServer::serve, this);
+
+	return true;
+}
+
+void MetricsServer::Update(const std::string &text_){
+	std::lock_guard<std::mutex> lock(textMutex);
+	text = text_;
+}
+
+void MetricsServer::Close(){
+	if(!running){ return; }
+	running = false;
+	if(serverThread.joinable()){ serverThread.join(); }
+	close(listenSock);
+	listenSock = -1;
+}
+
+void MetricsServer::serve(){
+	struct pollfd pfd;
+	pfd.fd = listenSock;
+	pfd.events = POLLIN;
+
+	while(running){
+		// Wake up regularly to check if the server has been closed.
+		if(poll(&pfd, 1, 100) <= 0 || !(pfd.revents & POLLIN)){ continue; }
+
+		int sock = accept(listenSock, NULL, NULL);
+		if(sock < 0){ continue; }
+
+		// A scraper which stalls may not hold up the next one for long.
+		struct timeval timeout;
+		timeout.tv_sec = METRICS_TIMEOUT / 1000;
+		timeout.tv_usec = (METRICS_TIMEOUT % 1000) * 1000;
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		answer(sock);
+		close(sock);
+	}
+}
+
+void MetricsServer::answer(int sock_){
+	// Read up to the end of the request headers. The body of a GET is empty.
+	std::string request;
+	char buffer[1024];
+	while(request.find("\r\n\r\n") == std::string::npos && request.find("\n\n") == std::string::npos){
+		ssize_t nBytes = recv(sock_, buffer, sizeof(buffer), 0);
+		if(nBytes <= 0){ return; } // closed or timed out
+		request.append(buffer, nBytes);
+		if(request.size() > 8192){ return; } // not a scraper
+	}
+
+	std::string method, path;
+	std::stringstream line(request.substr(0, request.find('\n')));
+	line >> method >> path;
+
+	std::string status = "200 OK";
+	std::string body;
+	if(method != "GET" && method != "HEAD"){
+		status = "405 Method Not Allowed";
+		body = "Only GET is supported\n";
+	}
+	else if(path == "/metrics" || path.compare(0, 9, "/metrics?") == 0 || path == "/"){
+		std::lock_guard<std::mutex> lock(textMutex);
+		body = text;
+	}
+	else{
+		status = "404 Not Found";
+		body = "Metrics are served at /metrics\n";
+	}
+
+	std::stringstream reply;
+	reply << "HTTP/1.0 " << status << "\r\n";
+	reply << "Content-Type: " << (status[0] == '2' ? METRICS_CONTENT_TYPE : "text/plain") << "\r\n";
+	reply << "Content-Length: " << body.size() << "\r\n";
+	reply << "Connection: close\r\n\r\n";
+	if(method != "HEAD"){ reply << body; }
+
+	const std::string output = reply.str();
+	size_t sent = 0;
+	while(sent < output.size()){
+		ssize_t nBytes = send(sock_, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+		if(nBytes <= 0){ return; }
+		sent += nBytes;
+	}
+	if(status[0] == '2'){ scrapes++; }
+}
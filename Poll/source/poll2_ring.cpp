@@ -0,0 +1,244 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "poll2_ring.h"
+
+SpillRing::SpillRing(size_t nSlots/*=8*/) : slots(nSlots > 1 ? nSlots : 2) {
+	numConsumers = 0;
+	head = 0;
+	writing = 0;
+	closed = false;
+	stalls = 0;
+}
+
+int SpillRing::AddConsumer(bool lossy_){
+	if(numConsumers >= RING_MAX_CONSUMERS || head != 0){ return -1; }
+
+	Consumer &consumer = consumers[numConsumers];
+	consumer.tail = 0;
+	consumer.busy = 0;
+	consumer.dropped = 0;
+	consumer.lossy = lossy_;
+
+	return numConsumers++;
+}
+
+bool SpillRing::Publish(const word_t *data, unsigned int nWords, bool record_/*=true*/, unsigned int tag_/*=0*/){
+	if(!data || nWords == 0){ return false; }
+	return Publish(std::vector<Segment>(1, Segment(data, nWords)), record_, tag_);
+}
+
+bool SpillRing::Publish(const std::vector<Segment> &segments_, bool record_/*=true*/, unsigned int tag_/*=0*/){
+	unsigned int nWords = 0;
+	for(std::vector<Segment>::const_iterator iter = segments_.begin(); iter != segments_.end(); iter++){
+		nWords += iter->nWords;
+	}
+	if(nWords == 0 || closed){ return false; }
+
+	const unsigned long long seq = head.load(std::memory_order_relaxed);
+	const size_t nSlots = slots.size();
+
+	// Wait for the lossless consumers to free the slot.
+	bool waited = false;
+	for(int i = 0; i < numConsumers; i++){
+		if(consumers[i].lossy){ continue; }
+		while(seq - consumers[i].tail.load(std::memory_order_acquire) >= nSlots){
+			waited = true;
+			usleep(50);
+		}
+	}
+	if(waited){ stalls++; }
+
+	// Announce the overwrite, then wait for any lossy consumer which is still
+	// copying the spill out of this slot. A lossy consumer which starts reading
+	// after the announcement sees it and drops the spill instead.
+	writing.store(seq+1);
+	if(seq >= nSlots){
+		for(int i = 0; i < numConsumers; i++){
+			if(!consumers[i].lossy){ continue; }
+			while(consumers[i].busy.load() == seq - nSlots + 1){ usleep(1); }
+		}
+	}
+
+	Slot &slot = slots[seq % nSlots];
+	if(slot.data.size() < nWords){ slot.data.resize(nWords); }
+	word_t *ptr = slot.data.data();
+	for(std::vector<Segment>::const_iterator iter = segments_.begin(); iter != segments_.end(); iter++){
+		memcpy(ptr, iter->data, 4*iter->nWords);
+		ptr += iter->nWords;
+	}
+	slot.nWords = nWords;
+	slot.record = record_;
+	slot.tag = tag_;
+
+	head.store(seq+1, std::memory_order_release);
+
+	return true;
+}
+
+SpillRing::Slot *SpillRing::acquire(const int &consumer_, unsigned long long &seq_){
+	Consumer &consumer = consumers[consumer_];
+	const unsigned long long current = head.load(std::memory_order_acquire);
+	const size_t nSlots = slots.size();
+
+	seq_ = consumer.tail.load(std::memory_order_relaxed);
+	if(seq_ >= current){ return NULL; }
+
+	if(consumer.lossy){
+		// Skip ahead to the oldest spill still in the ring.
+		if(current - seq_ > nSlots){
+			consumer.dropped += (current - nSlots) - seq_;
+			seq_ = current - nSlots;
+		}
+
+		// Claim the slot, then check that the producer has not started to overwrite it.
+		consumer.busy.store(seq_+1);
+		if(writing.load() >= seq_ + nSlots + 1){
+			consumer.busy.store(0);
+			consumer.dropped++;
+			consumer.tail.store(seq_+1, std::memory_order_relaxed);
+			return NULL;
+		}
+	}
+
+	return &slots[seq_ % nSlots];
+}
+
+void SpillRing::Run(int consumer_, ConsumeFunction func_){
+	RunTagged(consumer_, [&func_](word_t *data, unsigned int nWords, bool record, unsigned int tag){
+		func_(data, nWords, record);
+	});
+}
+
+void SpillRing::RunTagged(int consumer_, TaggedConsumeFunction func_, IdleFunction idle_/*=IdleFunction()*/){
+	if(consumer_ < 0 || consumer_ >= numConsumers){ return; }
+
+	Consumer &consumer = consumers[consumer_];
+	std::vector<word_t> copy;
+	while(true){
+		unsigned long long seq;
+		Slot *slot = acquire(consumer_, seq);
+		if(!slot){
+			if(closed && consumer.tail >= head){ break; }
+			if(idle_){ idle_(); }
+			usleep(100);
+			continue;
+		}
+
+		if(consumer.lossy){
+			// Release the slot as soon as the spill has been copied.
+			copy.assign(slot->data.begin(), slot->data.begin() + slot->nWords);
+			bool record = slot->record;
+			unsigned int tag = slot->tag;
+			consumer.busy.store(0);
+			consumer.tail.store(seq+1, std::memory_order_release);
+			func_(copy.data(), copy.size(), record, tag);
+		}
+		else{
+			func_(slot->data.data(), slot->nWords, slot->record, slot->tag);
+			consumer.tail.store(seq+1, std::memory_order_release);
+		}
+	}
+}
+
+void SpillRing::Flush(){
+	for(int i = 0; i < numConsumers; i++){
+		if(consumers[i].lossy){ continue; }
+		while(consumers[i].tail.load(std::memory_order_acquire) < head.load()){ usleep(100); }
+	}
+}
+
+size_t SpillRing::GetDepth(int consumer_){
+	if(consumer_ < 0 || consumer_ >= numConsumers){ return 0; }
+	unsigned long long tail = consumers[consumer_].tail;
+	unsigned long long current = head;
+	return (current > tail ? current - tail : 0);
+}
+
+unsigned long SpillRing::GetDropped(int consumer_){
+	if(consumer_ < 0 || consumer_ >= numConsumers){ return 0; }
+	return consumers[consumer_].dropped;
+}
+
+SpillMerger::SpillMerger(unsigned int nCrates_, OutputFunction func_, size_t maxHeld_/*=4*/, double maxWait_/*=1.0*/) :
+	queues(nCrates_ > 0 ? nCrates_ : 1), lastTime(queues.size(), 0), func(func_), maxHeld(maxHeld_), maxWait(maxWait_) {
+}
+
+void SpillMerger::Add(const word_t *data_, unsigned int nWords_, unsigned int crate_){
+	if(!data_ || nWords_ == 0){ return; }
+	if(crate_ >= queues.size()){ crate_ = queues.size() - 1; }
+
+	// A spill without events keeps its place behind the previous spill of its crate.
+	unsigned long long time;
+	if(!GetStartTime(data_, nWords_, time) || time < lastTime[crate_]){ time = lastTime[crate_]; }
+	lastTime[crate_] = time;
+
+	queues[crate_].push_back(Spill());
+	Spill &spill = queues[crate_].back();
+	spill.data.assign(data_, data_ + nWords_);
+	spill.time = time;
+	spill.arrival = clock::now();
+
+	while(true){
+		bool allWaiting = true;
+		bool overfull = false;
+		for(std::vector<std::deque<Spill> >::iterator iter = queues.begin(); iter != queues.end(); iter++){
+			if(iter->empty()){ allWaiting = false; }
+			if(iter->size() > maxHeld){ overfull = true; }
+		}
+		if(!(allWaiting || overfull) || !pop()){ break; }
+	}
+}
+
+void SpillMerger::Expire(){
+	const clock::time_point now = clock::now();
+	while(true){
+		bool expired = false;
+		for(std::vector<std::deque<Spill> >::iterator iter = queues.begin(); iter != queues.end(); iter++){
+			if(!iter->empty() && std::chrono::duration<double>(now - iter->front().arrival).count() > maxWait){ expired = true; }
+		}
+		if(!expired || !pop()){ break; }
+	}
+}
+
+void SpillMerger::Flush(){
+	while(pop()){ }
+}
+
+size_t SpillMerger::GetHeld(){
+	size_t held = 0;
+	for(std::vector<std::deque<Spill> >::iterator iter = queues.begin(); iter != queues.end(); iter++){ held += iter->size(); }
+	return held;
+}
+
+bool SpillMerger::GetStartTime(const word_t *data_, unsigned int nWords_, unsigned long long &time_){
+	// The spill is a series of module buffers (length, module, events), and the
+	// first event of a buffer is the earliest one read from that module.
+	bool found = false;
+	unsigned int pos = 0;
+	while(pos + 2 <= nWords_){
+		unsigned int lenRec = data_[pos];
+		if(lenRec < 2 || pos + lenRec > nWords_){ break; }
+		if(lenRec >= 5){
+			unsigned long long time = data_[pos+3] | ((unsigned long long)(data_[pos+4] & 0xFFFF) << 32);
+			if(!found || time < time_){ time_ = time; }
+			found = true;
+		}
+		pos += lenRec;
+	}
+	return found;
+}
+
+bool SpillMerger::pop(){
+	std::deque<Spill> *first = NULL;
+	for(std::vector<std::deque<Spill> >::iterator iter = queues.begin(); iter != queues.end(); iter++){
+		if(!iter->empty() && (!first || iter->front().time < first->front().time)){ first = &(*iter); }
+	}
+	if(!first){ return false; }
+
+	Spill &spill = first->front();
+	func(spill.data.data(), spill.data.size());
+	first->pop_front();
+
+	return true;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <string.h>
 #include <unistd.h>
 
@@ -12,16 +13,20 @@ StatsHandler::StatsHandler(const size_t nCards){
 
 	// Define all the 2d arrays
 	nEventsDelta = new unsigned int*[numCards];
-	nEventsTotal = new unsigned int*[numCards]; 
+	nEventsTotal = new unsigned long long*[numCards]; 
 	calcEventRate = new double*[numCards];
 	inputCountRate = new double*[numCards];
 	outputCountRate = new double*[numCards];
+	liveTime = new double*[numCards];
+	liveFraction = new double*[numCards];
 	for(unsigned int i = 0; i < numCards; i++){
 		nEventsDelta[i] = new unsigned int[NUM_CHAN_PER_MOD];
-		nEventsTotal[i] = new unsigned int[NUM_CHAN_PER_MOD];
+		nEventsTotal[i] = new unsigned long long[NUM_CHAN_PER_MOD];
 		calcEventRate[i] = new double[NUM_CHAN_PER_MOD];
 		inputCountRate[i] = new double[NUM_CHAN_PER_MOD];
 		outputCountRate[i] = new double[NUM_CHAN_PER_MOD];
+		liveTime[i] = new double[NUM_CHAN_PER_MOD];
+		liveFraction[i] = new double[NUM_CHAN_PER_MOD];
 	}
 
 	for(unsigned int i = 0; i < numCards; i++){
@@ -31,12 +36,22 @@ StatsHandler::StatsHandler(const size_t nCards){
 			calcEventRate[i][j] = 0.0;
 			inputCountRate[i][j] = 0.0;
 			outputCountRate[i][j] = 0.0;
+			liveTime[i][j] = 0.0;
+			liveFraction[i][j] = 0.0;
 		}
 	}
 
 	// Define all the 1d arrays
 	dataDelta = new size_t[numCards];
 	dataTotal = new size_t[numCards];
+	realTime = new double[numCards];
+	fifoWords = new unsigned int[numCards];
+	fifoPeak = new unsigned int[numCards];
+	for(unsigned int i = 0; i < numCards; i++){
+		realTime[i] = 0.0;
+		fifoWords[i] = 0;
+	}
+	fifoLength = 0;
 
 	timeElapsed = 0.0;
 	totalTime = 0.0;
@@ -44,8 +59,16 @@ StatsHandler::StatsHandler(const size_t nCards){
 	
 	is_able_to_send = true;
 
+	// The frame is built in place on every dump, so allocate it once here.
+	frame.resize(sizeof(StatsFrameHeader) + numCards * (sizeof(StatsFrameModule) + NUM_CHAN_PER_MOD * sizeof(StatsFrameChannel)));
+	numFrames = 0;
+	if(frame.size() > STATS_FRAME_MAX){
+		std::cout << "StatsHandler: Stats frame of " << frame.size() << " bytes is too large to send!\n";
+		is_able_to_send = false;
+	}
+
 	client = new Client();
-	if(!client->Init("127.0.0.1", 5556)){
+	if(!is_able_to_send || !client->Init("127.0.0.1", 5556)){
 		is_able_to_send = false;
 	}
 
@@ -63,16 +86,23 @@ StatsHandler::~StatsHandler(){
 		delete[] calcEventRate[i];
 		delete[] inputCountRate[i];
 		delete[] outputCountRate[i];
+		delete[] liveTime[i];
+		delete[] liveFraction[i];
 	}
 	delete[] nEventsDelta;
 	delete[] nEventsTotal;
 	delete[] calcEventRate;
 	delete[] inputCountRate;
 	delete[] outputCountRate;
+	delete[] liveTime;
+	delete[] liveFraction;
 	
 	// De-allocate the 1d arrays
 	delete[] dataDelta;
 	delete[] dataTotal;
+	delete[] realTime;
+	delete[] fifoWords;
+	delete[] fifoPeak;
 }
 
 void StatsHandler::AddEvent(unsigned int mod, unsigned int ch, size_t size, int delta_/*=1*/){
@@ -90,6 +120,19 @@ void StatsHandler::AddEvent(unsigned int mod, unsigned int ch, size_t size, int
 	dataTotal[mod] += size;
 }
 
+void StatsHandler::AddEvents(unsigned int mod, const unsigned int *counts_, size_t size){
+	if(mod >= numCards){
+		std::cout << "Bad module " << mod << ", numCards = " << numCards << std::endl;
+		return;
+	}
+	for(unsigned int ch = 0; ch < NUM_CHAN_PER_MOD; ch++){
+		nEventsDelta[mod][ch] += counts_[ch];
+		nEventsTotal[mod][ch] += counts_[ch];
+	}
+	dataDelta[mod] += size;
+	dataTotal[mod] += size;
+}
+
 /**
  *	\return Returns true if the dump interval is exceeded.
  */
@@ -101,52 +144,52 @@ bool StatsHandler::AddTime(double dtime) {
    
 }
 
+/** Build the stats frame for the current interval in place and send it. The
+  * frame is described by StatsFrameHeader, StatsFrameModule and StatsFrameChannel.
+  */
 void StatsHandler::Dump(void){
 	if(!is_able_to_send){ return; }
 
-	double dataRate = GetTotalDataRate();
-
-	// Below is the stats packet structure (for N modules)
-	// ---------------------------------------------------
-	// 4 byte total number of pixie modules (N)
-	// 8 byte total time of run (in seconds)
-	// 8 byte total data rate (in B/s)
-	// channel 0, 0 rate
-	// channel 0, 0 total
-	// channel 0, 1 rate
-	// channel 0, 1 total
-	// ...
-	// channel 0, 15 rate
-	// channel 0, 15 total
-	// channel 1, 0 rate
-	// channel 1, 0 total
-	// ...
-	// channel N-1, 15 rate
-	// channel N-1, 15 total
-	//msg_size = 20 fixed bytes + 4 words/card/ch * numCards * 16 ch * 8 bytes/ word
-	size_t msg_size = sizeof(numCards) + sizeof(totalTime) + sizeof(dataRate) + numCards*16*(sizeof(inputCountRate[0][0])+sizeof(outputCountRate[0][0])+sizeof(calcEventRate[0][0])+sizeof(nEventsTotal[0][0]));
-	char *message = new char[msg_size];
-	char *ptr = message;
-	
-	// Construct the rate message
-	memcpy(ptr, &numCards, 4); ptr += 4;
-	memcpy(ptr, &totalTime, 8); ptr += 8;
-	memcpy(ptr, &dataRate, 8); ptr += 8;
 	for (unsigned int i=0; i < numCards; i++) {
 		for (unsigned int j=0; j < NUM_CHAN_PER_MOD; j++) {	 
 			calcEventRate[i][j] = nEventsDelta[i][j] / timeElapsed;
 			if (timeElapsed<=0) 
 				calcEventRate[i][j] = 0;
-			memcpy(ptr, &inputCountRate[i][j], sizeof(inputCountRate[i][j])); ptr += sizeof(inputCountRate[i][j]);
-			memcpy(ptr, &outputCountRate[i][j], sizeof(outputCountRate[i][j])); ptr += sizeof(outputCountRate[i][j]);
-			memcpy(ptr, &calcEventRate[i][j], sizeof(calcEventRate[i][j])); ptr += sizeof(calcEventRate[i][j]);
-			memcpy(ptr, &nEventsTotal[i][j], sizeof(nEventsTotal[i][j])); ptr += sizeof(nEventsTotal[i][j]);
-		} //Update the status bar
+		}
+	}
+
+	StatsFrameHeader *header = (StatsFrameHeader*)&frame[0];
+	StatsFrameModule *modules = (StatsFrameModule*)(header + 1);
+	StatsFrameChannel *channels = (StatsFrameChannel*)(modules + numCards);
+
+	// Construct the stats frame
+	header->magic = STATS_FRAME_MAGIC;
+	header->version = STATS_FRAME_VERSION;
+	header->numCards = numCards;
+	header->numChannels = NUM_CHAN_PER_MOD;
+	header->sequence = numFrames++;
+	header->totalTime = totalTime;
+	header->interval = timeElapsed;
+	header->dataRate = GetTotalDataRate();
+	for (unsigned int i=0; i < numCards; i++) {
+		modules[i].dataRate = GetDataRate(i);
+		modules[i].realTime = realTime[i];
+		modules[i].fifoWords = fifoWords[i];
+		modules[i].fifoPeak = fifoPeak[i];
+		modules[i].fifoLength = fifoLength;
+		modules[i].reserved = 0;
+		for (unsigned int j=0; j < NUM_CHAN_PER_MOD; j++) {
+			StatsFrameChannel &chan = channels[i * NUM_CHAN_PER_MOD + j];
+			chan.inputCountRate = inputCountRate[i][j];
+			chan.outputCountRate = outputCountRate[i][j];
+			chan.eventRate = calcEventRate[i][j];
+			chan.liveTime = liveTime[i][j];
+			chan.liveFraction = liveFraction[i][j];
+			chan.totalEvents = nEventsTotal[i][j];
+		}
 	}
 	
-	client->SendMessage(message, msg_size);
-	
-	delete[] message;
+	client->SendMessage(&frame[0], frame.size());
 }
 
 double StatsHandler::GetDataRate(size_t mod){
@@ -162,7 +205,7 @@ double StatsHandler::GetTotalDataRate(){
 
 double StatsHandler::GetEventRate(size_t mod){
 	double output = 0.0;
-	for(unsigned int i = 0; i < numCards; i++){
+	for(unsigned int i = 0; i < NUM_CHAN_PER_MOD; i++){
 		output += calcEventRate[mod][i];
 	}
 	return output;
@@ -180,6 +223,7 @@ void StatsHandler::ClearRates(){
 			nEventsDelta[i][j] = 0;
 		}
 		dataDelta[i] = 0;
+		fifoPeak[i] = fifoWords[i];
 	}
 }
 
@@ -189,6 +233,22 @@ void StatsHandler::SetXiaRates(int mod, std::vector<std::pair<double, double> >
 		outputCountRate[mod][ch] = xiaRates->at(ch).second;
 	}
 }
+/** The live fraction of each channel is taken over the time since the last call,
+  * or over the whole run if the module real time was reset in between.
+  */
+void StatsHandler::SetXiaTimes(int mod, std::vector<double> *liveTimes, double realTime_) {
+	double dReal = realTime_ - realTime[mod];
+	for (int ch = 0; ch < NUM_CHAN_PER_MOD; ch++) {
+		double live = liveTimes->at(ch);
+		double fraction = 0.0;
+		if (dReal > 0 && live >= liveTime[mod][ch]) fraction = (live - liveTime[mod][ch]) / dReal;
+		else if (realTime_ > 0) fraction = live / realTime_;
+		liveFraction[mod][ch] = std::min(1.0, std::max(0.0, fraction));
+		liveTime[mod][ch] = live;
+	}
+	realTime[mod] = realTime_;
+}
+
 void StatsHandler::ClearTotals(){
 	totalTime = 0;
 	for(size_t i=0; i < numCards; i++){
@@ -0,0 +1,82 @@
+/** \file ChannelCounters.hpp
+ * \brief Per (crate, module, channel) event counters for the Unpacker.
+ *
+ * The counters for each module are stored as one row which is padded and
+ * aligned to a cache line, so incrementing the channels of one module never
+ * touches the cache line of another. Rows are added automatically as new
+ * crates are encountered, so no compile time limit on the number of crates
+ * is needed.
+ */
+#ifndef CHANNELCOUNTERS_HPP
+#define CHANNELCOUNTERS_HPP
+
+#include <ostream>
+#include <stddef.h>
+
+#ifndef COUNTER_ALIGNMENT
+#define COUNTER_ALIGNMENT 64
+#endif
+
+class ChannelCounters{
+  public:
+	/** Constructor.
+	  * \param[in]  modsPerCrate_ The maximum number of modules in one crate.
+	  * \param[in]  chansPerMod_  The number of channels in one module.
+	  */
+	ChannelCounters(const unsigned int &modsPerCrate_, const unsigned int &chansPerMod_);
+
+	/// Destructor.
+	~ChannelCounters();
+
+	/// Return the number of crates which currently have counters.
+	unsigned int GetNumCrates() const { return numCrates; }
+
+	/** Increment the counter of a channel, adding counters for a new crate if needed.
+	  * \param[in]  crate_ The crate number.
+	  * \param[in]  mod_   The module number within the crate.
+	  * \param[in]  chan_  The channel number.
+	  * \return False if the module or channel is out of range and true otherwise.
+	  */
+	bool Increment(const unsigned int &crate_, const unsigned int &mod_, const unsigned int &chan_){
+		if(mod_ >= modsPerCrate || chan_ >= chansPerMod){ return false; }
+		if(crate_ >= numCrates){ Resize(crate_+1); }
+		counts[(crate_*modsPerCrate + mod_)*rowStride + chan_]++;
+		return true;
+	}
+
+	/// Return the counter of a channel, or zero if it has never been incremented.
+	unsigned int Get(const unsigned int &crate_, const unsigned int &mod_, const unsigned int &chan_) const;
+
+	/** Write all counters to a stream, one "module\tchannel\tcount" line per
+	  * channel. Modules in crates other than zero are written as
+	  * module + 100 * crate, following the convention of XiaData::modNum.
+	  * \param[in]  out_ The stream to write to.
+	  * \return Nothing.
+	  */
+	void Write(std::ostream &out_) const;
+
+	/// Set all counters to zero.
+	void Zero();
+
+  private:
+	unsigned int modsPerCrate; /// Number of modules (rows) in each crate.
+	unsigned int chansPerMod; /// Number of channels used in each row.
+	size_t rowStride; /// Number of counters in each row, padded to the alignment.
+	unsigned int numCrates; /// Number of crates which have counters allocated.
+
+	unsigned int *counts; /// Aligned storage for all counters.
+
+	/// Counters own their storage and may not be copied.
+	ChannelCounters(const ChannelCounters &);
+
+	/// Counters own their storage and may not be assigned.
+	ChannelCounters &operator = (const ChannelCounters &);
+
+	/** Reallocate the counters for a new number of crates, keeping all existing counts.
+	  * \param[in]  numCrates_ The new number of crates.
+	  * \return Nothing.
+	  */
+	void Resize(const unsigned int &numCrates_);
+};
+
+#endif
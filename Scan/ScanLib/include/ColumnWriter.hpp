@@ -0,0 +1,164 @@
+/** \file ColumnWriter.hpp
+ * \brief A class to write event data into a chunked columnar file
+ *
+ * The file begins with the 8 byte magic "PXCOLS01". The values of each column
+ * are buffered for a number of events and written as a chunk: the tag
+ * "CHNK", the number of rows and then, for every column in the order they
+ * were added, its codec (0 stored, 1 zlib), compressed and raw sizes and
+ * data. Every column of a chunk is compressed independently, so a reader
+ * only inflates the columns it needs. The schema and chunk index follow the
+ * last chunk: the tag "SCHM", the number of columns and for each its name,
+ * type and width, the number of rows, and the number and file offsets of the
+ * chunks. The file ends with the offset of the schema and the magic
+ * "PXCOLEND". All numbers are little endian, as written by the machine.
+ *
+ * In the background mode the full chunks are compressed and written by a
+ * thread of the writer, so that Fill only copies the values. The buffers of
+ * the chunk being written and the chunk being filled are swapped, so Fill
+ * only waits if the previous chunk is not written yet when the next is full.
+ */
+#ifndef __COLUMNWRITER_HPP__
+#define __COLUMNWRITER_HPP__
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+//! Class to write the data of events into columns, in chunks of rows
+class ColumnWriter {
+public:
+    /** The types of the values held in a column */
+    enum ColumnType {DOUBLE = 0, INT = 1, UINT = 2, ULONG = 3};
+
+    /** Constructor opening the output file. Use IsOpen to check that the
+     * file could be opened.
+     * \param [in] fileName : the name of the file to write
+     * \param [in] chunkSize : the number of rows buffered before a chunk is
+     *  written
+     * \param [in] level : the zlib compression level of the columns, 0 to
+     *  store them uncompressed
+     * \param [in] background : true to write the chunks from a thread of
+     *  the writer */
+    ColumnWriter(const std::string &fileName, const unsigned int &chunkSize,
+                 const int &level, const bool &background = false);
+    /** Destructor writing the last chunk and the schema */
+    ~ColumnWriter();
+
+    /** Add a column of doubles. Columns must be added before the first Fill.
+     * \param [in] name : the name of the column
+     * \param [in] value : the value(s) copied into the column by Fill
+     * \param [in] width : the number of values in each row
+     * \return false if rows were already filled */
+    bool AddColumn(const std::string &name, const double *value,
+                   const unsigned int &width = 1) {
+        return(Add(name, DOUBLE, value, sizeof(double), width));
+    }
+    /** Add a column of integers. Columns must be added before the first Fill.
+     * \param [in] name : the name of the column
+     * \param [in] value : the value(s) copied into the column by Fill
+     * \param [in] width : the number of values in each row
+     * \return false if rows were already filled */
+    bool AddColumn(const std::string &name, const int *value,
+                   const unsigned int &width = 1) {
+        return(Add(name, INT, value, sizeof(int), width));
+    }
+    /** Add a column of unsigned integers. Columns must be added before the
+     * first Fill.
+     * \param [in] name : the name of the column
+     * \param [in] value : the value(s) copied into the column by Fill
+     * \param [in] width : the number of values in each row
+     * \return false if rows were already filled */
+    bool AddColumn(const std::string &name, const unsigned int *value,
+                   const unsigned int &width = 1) {
+        return(Add(name, UINT, value, sizeof(unsigned int), width));
+    }
+    /** Add a column of 64 bit unsigned integers. Columns must be added before
+     * the first Fill.
+     * \param [in] name : the name of the column
+     * \param [in] value : the value(s) copied into the column by Fill
+     * \param [in] width : the number of values in each row
+     * \return false if rows were already filled */
+    bool AddColumn(const std::string &name, const unsigned long long *value,
+                   const unsigned int &width = 1) {
+        return(Add(name, ULONG, value, sizeof(uint64_t), width));
+    }
+
+    /** Append the current values of all columns as a row, writing a chunk
+     * once chunkSize rows are buffered */
+    void Fill(void);
+
+    /** Write the buffered rows as a chunk, or hand them to the thread of
+     * the writer in the background mode */
+    void Flush(void);
+
+    /** Write the last chunk, the schema and the chunk index, and close the
+     * file. Nothing may be filled afterwards. */
+    void Close(void);
+
+    /** \return The number of columns */
+    size_t GetNumColumns(void) const {return(columns_.size());}
+    /** \return The number of rows filled */
+    uint64_t GetEntries(void) const {return(entries_);}
+    /** \return true if the file is open for writing */
+    bool IsOpen(void) const {return(file_.is_open());}
+private:
+    /** A column and the values buffered for the chunk being filled */
+    struct Column {
+        std::string name; //!< the name of the column
+        ColumnType type; //!< the type of its values
+        const char *value; //!< where Fill copies the values from
+        unsigned int rowBytes; //!< the number of bytes in a row
+        unsigned int width; //!< the number of values in a row
+        std::vector<char> buffer; //!< the rows of the chunk being filled
+    };
+
+    /** Add a column
+     * \param [in] name : the name of the column
+     * \param [in] type : the type of its values
+     * \param [in] value : where Fill copies the values from
+     * \param [in] size : the size of a value in bytes
+     * \param [in] width : the number of values in a row
+     * \return false if rows were already filled */
+    bool Add(const std::string &name, const ColumnType &type,
+             const void *value, const unsigned int &size,
+             const unsigned int &width);
+
+    /** Compress and write a chunk of rows
+     * \param [in] rows : the number of rows of the chunk
+     * \param [in,out] buffers : the rows of each column, cleared once they
+     *  are written */
+    void WriteChunk(const uint32_t &rows,
+                    std::vector<std::vector<char> > &buffers);
+
+    /** Write the chunks handed over by Flush, in the background mode */
+    void WriteLoop(void);
+
+    /** Write a number to the file
+     * \param [in] a : the number to write */
+    template<typename T> void Write(const T &a) {
+        file_.write(reinterpret_cast<const char*>(&a), sizeof(T));
+    }
+
+    std::ofstream file_; //!< the output file
+    unsigned int chunkSize_; //!< the number of rows in a full chunk
+    int level_; //!< the compression level of the columns
+    unsigned int rows_; //!< the number of rows buffered
+    uint64_t entries_; //!< the number of rows filled
+    std::vector<Column> columns_; //!< the columns
+    std::vector<uint64_t> chunks_; //!< the file offset of each chunk
+    std::vector<char> zbuffer_; //!< buffer for the compressed columns
+
+    std::vector<std::vector<char> > buffers_; //!< the rows of the chunk given to the thread, per column
+    uint32_t pendingRows_; //!< the number of rows given to the thread
+    bool pending_; //!< true while the thread writes a chunk
+    bool stop_; //!< true to stop the thread
+    std::mutex mutex_; //!< guards the chunk given to the thread
+    std::condition_variable changed_; //!< signals a chunk given or written
+    std::thread thread_; //!< writes the chunks in the background mode
+};
+#endif // __COLUMNWRITER_HPP__
@@ -0,0 +1,48 @@
+/** \file CompactHit.hpp
+ * \brief A fixed size, trivially copyable record of a pixie16 channel hit.
+ *
+ * A XiaData is more than 150 bytes with a std::vector for its trace, and most
+ * of its fields are copies of one another (time, trigTime and the event time
+ * words are all parts of the timeStamp). The CompactHit keeps only what the
+ * list-mode header holds, in 32 bytes, with its trace held elsewhere (e.g. in
+ * a file or a sample array) at traceOffset. It may therefore be copied with
+ * memcpy, written to a file as is, and kept in arrays which fill exactly two
+ * hits per cache line. XiaData::pack and XiaData::unpack convert between the
+ * two, every derived field of the XiaData being filled again by unpack.
+ */
+#ifndef COMPACTHIT_HPP
+#define COMPACTHIT_HPP
+
+#include <type_traits>
+
+#include <stdint.h>
+
+struct CompactHit{
+	/// The bits of the flags.
+	enum {VIRTUAL = 0x1, PILEUP = 0x2, SATURATED = 0x4, CFD_FORCE = 0x8, CFD_SOURCE = 0x10};
+
+	uint64_t timeStamp; /// The 48-bit event time in clock ticks followed by 16 bits of CFD time, as XiaData::timeStamp.
+	uint32_t spillIndex; /// Number of the spill the hit was read from.
+	uint32_t hitIndex; /// Position of the hit header in its spill (in words).
+	uint32_t traceOffset; /// Index of the first trace sample in the sample array the hit is kept beside.
+	uint16_t traceLength; /// Number of trace samples.
+	uint16_t energy; /// Raw pixie energy.
+	uint16_t modNum; /// Module number (plus 100 times the crate number).
+	uint8_t chanNum; /// Channel number.
+	uint8_t crateNum; /// Crate number.
+	uint8_t slotNum; /// Slot number.
+	uint8_t headerLength; /// Number of words in the list-mode header of the hit.
+	uint8_t flags; /// The pixie flags of the hit (see the enum above).
+	uint8_t reserved; /// Unused, zero.
+
+	/// Return the integer part of the timeStamp in clock ticks.
+	uint64_t getTimeTicks() const { return (timeStamp >> 16); }
+
+	/// Return the raw CFD time, the fractional part of the timeStamp.
+	uint16_t getCfdTime() const { return (uint16_t)(timeStamp & 0xFFFF); }
+};
+
+static_assert(sizeof(CompactHit) == 32, "Unexpected padding of the CompactHit");
+static_assert(std::is_trivially_copyable<CompactHit>::value, "The CompactHit must be copyable with memcpy");
+
+#endif
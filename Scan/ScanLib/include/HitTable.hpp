@@ -0,0 +1,117 @@
+/** \file HitTable.hpp
+ * \brief A columnar (structure of arrays) store of pixie16 channel hits.
+ *
+ * Walking a deque of XiaData pointers touches one heap object per hit. The
+ * HitTable instead keeps the fields used for sorting and windowing in
+ * contiguous arrays, so these operations only touch the columns they need and
+ * work on hit indices rather than on the objects themselves. Each row also
+ * keeps a pointer to the XiaData it was filled from, which allows consumers
+ * written for lists of XiaData to iterate over the table unchanged.
+ */
+#ifndef HITTABLE_HPP
+#define HITTABLE_HPP
+
+#include <deque>
+#include <vector>
+#include <stddef.h>
+
+class XiaData;
+
+class HitTable{
+  public:
+	/// Flag bits stored in the flags column.
+	enum FLAGS { VIRTUAL=0x1, SATURATED=0x2, PILEUP=0x4 };
+
+	std::vector<double> time; /// Event time in pixie clock ticks.
+	std::vector<unsigned long long> timeStamp; /// Fixed point event time (see XiaData::timeStamp).
+	std::vector<unsigned int> cfdTime; /// CFD trigger time in units of 1/256 pixie clock ticks.
+	std::vector<double> energy; /// Raw pixie energy.
+	std::vector<unsigned short> modNum; /// Module number.
+	std::vector<unsigned short> chanNum; /// Channel number.
+	std::vector<unsigned char> flags; /// Virtual channel, saturation and pile-up bits.
+	std::vector<size_t> traceOffset; /// Index of the first trace sample of each hit in the samples array.
+	std::vector<size_t> traceLength; /// Number of trace samples of each hit.
+	std::vector<int> samples; /// Trace samples of all hits, stored back to back.
+	std::vector<XiaData*> events; /// The XiaData each row was filled from.
+
+	/** Iterator over the XiaData of the table in the current row order. This
+	  * allows code written for a deque of XiaData pointers to walk the table.
+	  */
+	class const_iterator{
+	  public:
+		const_iterator(const HitTable *table_, size_t pos_) : table(table_), pos(pos_) { }
+
+		XiaData *operator * () const { return table->events[table->order[pos]]; }
+
+		const_iterator &operator ++ (){ pos++; return *this; }
+
+		bool operator == (const const_iterator &rhs_) const { return (pos == rhs_.pos); }
+
+		bool operator != (const const_iterator &rhs_) const { return (pos != rhs_.pos); }
+
+		/// Return the row of the table this iterator points to.
+		size_t row() const { return table->order[pos]; }
+
+	  private:
+		const HitTable *table; /// The table being iterated over.
+		size_t pos; /// Position in the row order.
+	};
+
+	/// Default constructor.
+	HitTable(){ }
+
+	/// Return the number of hits in the table.
+	size_t size() const { return events.size(); }
+
+	/// Return true if the table holds no hits.
+	bool empty() const { return events.empty(); }
+
+	/// Return an iterator to the first hit in the current row order.
+	const_iterator begin() const { return const_iterator(this, 0); }
+
+	/// Return an iterator past the last hit in the current row order.
+	const_iterator end() const { return const_iterator(this, order.size()); }
+
+	/// Return the index of the row at a position in the current row order.
+	size_t at(const size_t &pos_) const { return order[pos_]; }
+
+	/** Add a hit to the end of the table. The trace is copied into the samples
+	  * array, whether it is stored in the XiaData or viewed in the spill buffer.
+	  * \param[in]  event_ The XiaData to add. The table does not take ownership.
+	  * \return Nothing.
+	  */
+	void push_back(XiaData *event_);
+
+	/** Clear the table and fill it with a list of hits.
+	  * \param[in]  events_ The list of XiaData to add.
+	  * \return Nothing.
+	  */
+	void Fill(const std::deque<XiaData*> &events_);
+
+	/** Order the rows by timeStamp. Only the row order is sorted, the columns are
+	  * left untouched. Hits with equal times keep the order they were added in.
+	  * \return Nothing.
+	  */
+	void Sort();
+
+	/** Find the hits in the time window [start_, start_+width_]. The rows must
+	  * have been time ordered by Sort().
+	  * \param[in]  start_ The start of the window in pixie clock ticks.
+	  * \param[in]  width_ The width of the window in pixie clock ticks.
+	  * \param[out] first_ The position (in row order) of the first hit in the window.
+	  * \param[out] last_  The position (in row order) one past the last hit in the window.
+	  * \return The number of hits in the window.
+	  */
+	size_t Window(const double &start_, const double &width_, size_t &first_, size_t &last_) const;
+
+	/// Return a pointer to the trace samples of a row, or NULL if it has no trace.
+	const int *getTrace(const size_t &row_) const { return (traceLength[row_] > 0 ? &samples[traceOffset[row_]] : NULL); }
+
+	/// Remove all hits from the table. Allocated memory is kept for reuse.
+	void clear();
+
+  private:
+	std::vector<size_t> order; /// The row order used for iteration and windowing.
+};
+
+#endif
@@ -0,0 +1,90 @@
+/** \file InputStream.hpp
+ * \brief One of several input files whose spills are merged in time.
+ *
+ * Experiments with independent crates or DAQs write a separate .ldf or .pld
+ * file for each system. ScanInterface opens each of them as an InputStream,
+ * reads it on its own read-ahead thread, and always passes the next spill of
+ * the stream which is furthest behind in time to the Unpacker, so that raw
+ * events may be built from the hits of every system.
+ */
+#ifndef INPUTSTREAM_HPP
+#define INPUTSTREAM_HPP
+
+#include <string>
+#include <fstream>
+
+#include "hribf_buffers.h"
+#include "SpillPrefetcher.hpp"
+
+class InputStream{
+  public:
+	/// Default constructor.
+	InputStream();
+
+	/// Destructor. Stops the reader thread and closes the file.
+	~InputStream();
+
+	/** Open an .ldf, .pld or .pldz file, read its header buffers and start its reader thread.
+	  * \param[in]  fname_  The name of the file to open.
+	  * \param[in]  depth_  The number of spills to read ahead of the scan.
+	  * \param[in]  debug_  Set to true to print debug information about the buffers read.
+	  * \return True if the file was opened and false otherwise.
+	  */
+	bool Open(const std::string &fname_, const size_t &depth_, const bool &debug_=false);
+
+	/// Stop the reader thread and close the file.
+	void Close();
+
+	/// Return the name of the file.
+	const std::string &GetName() const { return fname; }
+
+	/// Return the fraction of the file which has been read, in percent.
+	double GetProgress() const { return (length > 0 ? 100.0 * position / length : 100.0); }
+
+	/// Return true once every spill of the file has been returned by Next().
+	bool IsFinished() const { return finished; }
+
+	/// Return the time of the latest hit passed on from this stream (in pixie clock ticks).
+	double GetTime() const { return time; }
+
+	/// Set the time of the latest hit passed on from this stream (in pixie clock ticks).
+	void SetTime(const double &time_){ time = time_; }
+
+	/** Wait for the next complete spill of the file. Fragments and spills which
+	  * are flagged as corrupt are skipped. The spill remains valid until Pop()
+	  * is called and ends with the two words which terminate a spill.
+	  * \param[out] nWords_ The number of words in the spill.
+	  * \return Pointer to the spill, or NULL once the end of the file is reached.
+	  */
+	unsigned int *Next(unsigned int &nWords_);
+
+	/// Return the spill obtained from Next() to the reader thread.
+	void Pop(){ prefetcher.Pop(); }
+
+  private:
+	std::string fname; /// The name of the file.
+	std::ifstream file; /// The input file.
+	std::streampos length; /// The length of the file (in bytes).
+	std::streampos position; /// The file position after the last spill returned by Next() (in bytes).
+
+	int format; /// Format of the file (0=.ldf, 1=.pld).
+
+	double time; /// The time of the latest hit passed on from this stream.
+	bool finished; /// Set to true once the end of the file is reached.
+
+	DIR_buffer dirbuff; /// HRIBF DIR buffer handler.
+	HEAD_buffer headbuff; /// HRIBF HEAD buffer handler.
+	DATA_buffer databuff; /// HRIBF DATA buffer handler.
+	PLD_header pldHead; /// PLD style HEAD buffer handler.
+	PLD_data pldData; /// PLD style DATA buffer handler.
+
+	SpillPrefetcher prefetcher; /// The reader thread of this stream.
+
+	/// Read the next spill of an .ldf file on the reader thread.
+	bool ReadLdf(SpillPrefetcher::Spill &spill_);
+
+	/// Read the next spill of a .pld file on the reader thread.
+	bool ReadPld(SpillPrefetcher::Spill &spill_);
+};
+
+#endif
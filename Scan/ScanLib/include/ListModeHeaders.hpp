@@ -0,0 +1,87 @@
+/** \file ListModeHeaders.hpp
+ * \brief Column-wise decoding of the fixed pixie16 list-mode header words.
+ *
+ * Locating the events in a module buffer is inherently serial, since the
+ * length of each event is stored in its first header word. Once the event
+ * boundaries are known, however, the fixed header fields of every event in the
+ * buffer can be decoded at once. This class gathers the first four header
+ * words of each event into contiguous columns and then decodes them with
+ * simple, branch-free loops which the compiler is able to vectorize.
+ */
+#ifndef LISTMODEHEADERS_HPP
+#define LISTMODEHEADERS_HPP
+
+#include <vector>
+#include <stddef.h>
+
+class ListModeHeaders{
+  public:
+	/// Flag bits stored in the flags column.
+	enum FLAGS { VIRTUAL=0x1, SATURATED=0x2, PILEUP=0x4 };
+
+	std::vector<const unsigned int*> start; /// Pointer to the first header word of each event.
+
+	std::vector<unsigned int> word0; /// First header word (channel id and lengths).
+	std::vector<unsigned int> word1; /// Second header word (low 32 bits of the event time).
+	std::vector<unsigned int> word2; /// Third header word (high event time and CFD time).
+	std::vector<unsigned int> word3; /// Fourth header word (energy and trace length).
+
+	std::vector<unsigned int> chanNum; /// Channel number.
+	std::vector<unsigned int> slotNum; /// Slot number.
+	std::vector<unsigned int> crateNum; /// Crate number.
+	std::vector<unsigned int> headerLength; /// Number of header words.
+	std::vector<unsigned int> eventLength; /// Number of words in the event (header and trace).
+	std::vector<unsigned char> flags; /// Virtual channel, saturation and pile-up bits.
+
+	std::vector<unsigned int> lowTime; /// Lower 32 bits of the event time.
+	std::vector<unsigned int> highTime; /// Upper 16 bits of the event time.
+	std::vector<unsigned int> cfdTime; /// CFD time.
+	std::vector<unsigned int> energy; /// Onboard energy.
+	std::vector<unsigned int> traceLength; /// Number of trace samples.
+	std::vector<double> time; /// The 48-bit event time.
+	std::vector<unsigned long long> timeStamp; /// Fixed point event time with the CFD time as the fraction (see XiaData::timeStamp).
+
+	/// Default constructor.
+	ListModeHeaders() : badHeader(false), badWord(0), commonHeaderLength(0) { }
+
+	/// Return the number of events located in the buffer.
+	size_t size() const { return start.size(); }
+
+	/// Return true if locating stopped on an event with an unexpected header length.
+	bool StoppedOnBadHeader() const { return badHeader; }
+
+	/// Return the first header word of the event which stopped the locating pass.
+	unsigned int GetBadWord() const { return badWord; }
+
+	/// Return the header length shared by all located events, or 0 if they differ.
+	unsigned int GetCommonHeaderLength() const { return commonHeaderLength; }
+
+	/** Walk a module buffer and record the location and fixed header words of
+	  * each event. Locating stops at the end of the buffer or at the first event
+	  * with an unexpected header length.
+	  * \param[in]  buf Pointer to the first header word of the first event.
+	  * \param[in]  end Pointer to one past the last word in the buffer.
+	  * \return The number of events located.
+	  */
+	size_t Locate(const unsigned int *buf, const unsigned int *end);
+
+	/** Decode the fixed header fields of all located events into the columns.
+	  * \return Nothing.
+	  */
+	void Decode();
+
+	/** Return true if the header length is one of the lengths written by the
+	  * pixie16 firmware (4, 8, 12, or 16 words) or a statistics block (1 word).
+	  */
+	static bool IsValidHeaderLength(const unsigned int &len_){ return (len_ == 1 || len_ == 4 || len_ == 8 || len_ == 12 || len_ == 16); }
+
+	/// Clear all columns.
+	void clear();
+
+  private:
+	bool badHeader; /// True if locating stopped on an event with an unexpected header length.
+	unsigned int badWord; /// First header word of the event with the unexpected header length.
+	unsigned int commonHeaderLength; /// Header length shared by all located events, 0 if they differ.
+};
+
+#endif
@@ -0,0 +1,165 @@
+/** \file PerfCounters.hpp
+ * \brief Timers and counters for the stages of a scan.
+ *
+ * Each stage of the scan (reading a spill, decoding it, sorting it, building
+ * raw events, processing them, and any stages added by a derived scan) has
+ * a call counter, an item counter and a timer. The processing time of every
+ * raw event is also histogrammed, so that the latency of single events can
+ * be compared to the mean. All recording goes through the PERF_ macros,
+ * which compile to nothing unless SCAN_PERF is defined (cmake option
+ * USE_SCAN_PERF).
+ *
+ * The memory held by each subsystem of the scan (histograms, correlator
+ * history, event pool, ...) is reported here as well. It is measured by the
+ * Unpacker, not by the PERF_ macros, so it is printed even without SCAN_PERF.
+ */
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifndef PERF_MAX_STAGES
+#define PERF_MAX_STAGES 32
+#endif
+#ifndef PERF_LATENCY_BINS
+#define PERF_LATENCY_BINS 32
+#endif
+
+#ifdef SCAN_PERF
+#define PERF_START(start_) PerfCounters::clock::time_point start_ = PerfCounters::clock::now()
+#define PERF_RESTART(start_) start_ = PerfCounters::clock::now()
+#define PERF_RECORD(perf_, id_, start_, items_) (perf_).Record(id_, start_, items_)
+#define PERF_EVENT(perf_, start_, items_) (perf_).RecordEvent(start_, items_)
+#else
+#define PERF_START(start_)
+#define PERF_RESTART(start_) ((void)0)
+#define PERF_RECORD(perf_, id_, start_, items_) ((void)0)
+#define PERF_EVENT(perf_, start_, items_) ((void)0)
+#endif
+
+class PerfCounters{
+  public:
+	typedef std::chrono::steady_clock clock; /// The clock used for all timers.
+
+	/// The stages recorded by the Unpacker. Derived scans add their own with Add().
+	enum Stage{
+		READ, /// Time between spills, spent getting the next spill.
+		DECODE, /// Checking and decoding the module buffers of a spill.
+		SORT, /// Time sorting the events of a spill.
+		BUILD, /// Building raw events from the sorted events.
+		EVENT, /// Processing raw events, also histogrammed per event.
+		NUM_STAGES
+	};
+
+	/// The memory held by one subsystem of the scan.
+	struct MemoryEntry{
+		std::string name; /// The name of the subsystem, e.g. the owner of a histogram range.
+		unsigned long long bytes; /// The number of bytes held.
+
+		MemoryEntry(const std::string &name_, const unsigned long long &bytes_) : name(name_), bytes(bytes_) { }
+	};
+
+	/// Default constructor.
+	PerfCounters();
+
+	/// Return true if the scan was compiled with SCAN_PERF.
+	static bool Enabled();
+
+	/** Add a stage to be timed. Stages must be added before any thread
+	  * records them. Adding a name twice returns the id of the first stage.
+	  * \param[in]  name_ The name of the stage.
+	  * \return The id of the stage, or PERF_MAX_STAGES if no more stages may be added.
+	  */
+	unsigned int Add(const std::string &name_);
+
+	/** Record one call of a stage. Several threads may record at once as long
+	  * as no two of them record the same stage.
+	  * \param[in]  id_    The id of the stage.
+	  * \param[in]  start_ The time at which the call started.
+	  * \param[in]  items_ The number of items (hits, events, ...) handled by the call.
+	  * \return Nothing.
+	  */
+	void Record(const unsigned int &id_, const clock::time_point &start_, const unsigned long long &items_=1){
+		if(id_ < numStages)
+			AddCall(entries[id_], clock::now() - start_, items_);
+	}
+
+	/** Record the processing of one raw event in the EVENT stage and the latency histogram.
+	  * \param[in]  start_ The time at which processing of the event started.
+	  * \param[in]  hits_  The number of hits in the event.
+	  * \return Nothing.
+	  */
+	void RecordEvent(const clock::time_point &start_, const unsigned long long &hits_);
+
+	/** Replace the memory held by each subsystem, as last measured.
+	  * \param[in]  entries_ The memory of each subsystem.
+	  * \param[in]  budget_  The budget of all subsystems in bytes, zero if there is none.
+	  * \return Nothing.
+	  */
+	void SetMemory(const std::vector<MemoryEntry> &entries_, const unsigned long long &budget_);
+
+	/// Return true if the memory of the subsystems was measured at least once.
+	bool HasMemory() const ;
+
+	/** Print a table of all stages which were called and the event latency percentiles,
+	  * followed by the memory of each subsystem if it was measured.
+	  * \param[in]  out_ The stream to print to.
+	  * \return Nothing.
+	  */
+	void Print(std::ostream &out_) const;
+
+	/// Set all counters to zero and restart the wall clock. Calls recorded at the same time may be lost.
+	void Zero();
+
+  private:
+	/// The counters of one stage. Each is only written by the thread recording the stage.
+	struct Entry{
+		std::string name; /// The name of the stage.
+		std::atomic<unsigned long long> calls; /// The number of calls recorded.
+		std::atomic<unsigned long long> items; /// The number of items handled by all calls.
+		std::atomic<unsigned long long> totalNs; /// The total time of all calls in ns.
+		std::atomic<unsigned long long> maxNs; /// The time of the longest call in ns.
+	};
+
+	Entry entries[PERF_MAX_STAGES]; /// The counters of every stage.
+	unsigned int numStages; /// The number of stages added.
+
+	std::atomic<unsigned long long> latency[PERF_LATENCY_BINS]; /// Events per power of two of their processing time in ns.
+
+	clock::time_point startTime; /// The time of construction or of the last Zero().
+
+	std::vector<MemoryEntry> memory; /// The memory of each subsystem, as last measured.
+	unsigned long long memoryBudget; /// The budget of all subsystems in bytes, zero if there is none.
+	mutable std::mutex memoryMutex; /// Guards the memory table, which is set by the scan thread and printed by the command thread.
+
+	/// Print the memory table.
+	void PrintMemory(std::ostream &out_) const ;
+
+	/// Increment a counter which only the calling thread writes.
+	static void Increment(std::atomic<unsigned long long> &counter_, const unsigned long long &value_){
+		counter_.store(counter_.load(std::memory_order_relaxed) + value_, std::memory_order_relaxed);
+	}
+
+	/// Add one call to the counters of a stage.
+	static void AddCall(Entry &entry_, const clock::duration &elapsed_, const unsigned long long &items_){
+		unsigned long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed_).count();
+		Increment(entry_.calls, 1);
+		Increment(entry_.items, items_);
+		Increment(entry_.totalNs, ns);
+		if(ns > entry_.maxNs.load(std::memory_order_relaxed))
+			entry_.maxNs.store(ns, std::memory_order_relaxed);
+	}
+
+	/// Counters may not be copied.
+	PerfCounters(const PerfCounters &);
+
+	/// Counters may not be assigned.
+	PerfCounters &operator = (const PerfCounters &);
+};
+
+#endif
@@ -0,0 +1,212 @@
+/** \file RawEventFile.hpp
+ * \brief Records built raw events to a file and reads them back.
+ *
+ * Every pass of a scan over a .ldf or .pld file reads, decodes, time sorts
+ * and builds the raw events again before any analysis is done. A .rev file
+ * holds the raw events once they are built, so the analysis may be run again
+ * and again on them without unpacking the data.
+ *
+ * The file begins with the 8 byte magic "PXREVT02" and is followed by the
+ * raw events. Each event starts with its number of hits, the length of its
+ * hits in bytes, and its start time and first and last hit times (doubles,
+ * in clock ticks). Each hit is its 32 byte CompactHit (see CompactHit.hpp),
+ * followed by its onboard energy sums and QDCs if its list-mode header had
+ * them, and by its trace samples (16 bits each) if traces were recorded. The index follows the last event: the tag "RIDX",
+ * the time of the first event, the number of events and hits, the entries of
+ * the header of the input file as name and value strings, and the number,
+ * start times and file offsets of every indexStep-th event. The file ends
+ * with the offset of the index and the magic "PXREVEND". All numbers are
+ * little endian, as written by the machine. A file which was not closed has
+ * no index, but its events may still be read one after the other.
+ */
+#ifndef RAWEVENTFILE_HPP
+#define RAWEVENTFILE_HPP
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+class XiaData;
+
+class RawEventWriter{
+  public:
+	static const unsigned int indexStep = 1024; /// Every indexStep-th raw event is entered in the index.
+
+	/// Default constructor.
+	RawEventWriter();
+
+	/// Destructor. Writes the index and closes the file.
+	~RawEventWriter();
+
+	/** Open the output file and write its magic.
+	  * \param[in]  fname_  The name of the .rev file to write.
+	  * \param[in]  traces_ Set to false to leave the traces out of the file.
+	  * \return True if the file was opened and false otherwise.
+	  */
+	bool Open(const std::string &fname_, bool traces_=true);
+
+	/// Write the index and close the file.
+	void Close();
+
+	/// Return true if the output file is open.
+	bool IsOpen() const { return file.is_open(); }
+
+	/// Return the name of the output file.
+	const std::string &GetName() const { return fname; }
+
+	/// Return the number of raw events written.
+	unsigned long long GetNumEvents() const { return numEvents; }
+
+	/// Return the number of hits written.
+	unsigned long long GetNumHits() const { return numHits; }
+
+	/** Add an entry of the header of the input file, which is written to the index.
+	  * \param[in]  name_  The name of the entry, as in ScanInterface::GetFileInfo().
+	  * \param[in]  value_ The value of the entry.
+	  * \return Nothing.
+	  */
+	void SetHeader(const std::string &name_, const std::string &value_);
+
+	/** Write a built raw event.
+	  * \param[in]  event_         The hits of the raw event.
+	  * \param[in]  firstTime_     The time of the first raw event of the scan (in clock ticks).
+	  * \param[in]  startTime_     The start time of the raw event window.
+	  * \param[in]  realStartTime_ The time of the first hit of the raw event.
+	  * \param[in]  realStopTime_  The time of the last hit of the raw event.
+	  * \return True if the event was written and false if the file is not open.
+	  */
+	bool Write(const std::deque<XiaData*> &event_, const double &firstTime_, const double &startTime_, const double &realStartTime_, const double &realStopTime_);
+
+  private:
+	std::string fname; /// The name of the output file.
+	std::ofstream file; /// The output file.
+	bool traces; /// True if the traces are written.
+
+	double firstTime; /// The time of the first raw event of the scan.
+	unsigned long long numEvents; /// The number of raw events written.
+	unsigned long long numHits; /// The number of hits written.
+	uint64_t position; /// The file offset of the next raw event.
+
+	std::vector<std::pair<std::string, std::string> > header; /// The entries of the header of the input file.
+	std::vector<double> indexTimes; /// The start time of every indexStep-th raw event.
+	std::vector<uint64_t> indexOffsets; /// The file offset of every indexStep-th raw event.
+
+	std::vector<char> buffer; /// Scratch space for the raw event being written.
+};
+
+class RawEventReader{
+  public:
+	/// Default constructor.
+	RawEventReader();
+
+	/** Open a .rev file and read its index, if it has one.
+	  * \param[in]  fname_ The name of the .rev file to read.
+	  * \return True if the file was opened and is a raw event file and false otherwise.
+	  */
+	bool Open(const std::string &fname_);
+
+	/// Close the file.
+	void Close();
+
+	/// Return true if the input file is open.
+	bool IsOpen() const { return file.is_open(); }
+
+	/// Return true if the file was closed by its writer and has an index.
+	bool HasIndex() const { return indexed; }
+
+	/// Return the time of the first raw event of the scan which wrote the file (in clock ticks).
+	double GetFirstTime() const { return firstTime; }
+
+	/// Return the number of raw events in the file, zero if it has no index.
+	unsigned long long GetNumEvents() const { return numEvents; }
+
+	/// Return the number of hits in the file, zero if it has no index.
+	unsigned long long GetNumHits() const { return numHits; }
+
+	/// Return the number of raw events read since the file was opened or the last seek.
+	unsigned long long GetEventNumber() const { return eventNumber; }
+
+	/// Return the entries of the header of the input file the events were built from.
+	const std::vector<std::pair<std::string, std::string> > &GetHeader() const { return header; }
+
+	/// Return the percentage of the file which was read.
+	float GetProgress() const { return (dataEnd > 0 ? 100.0*position/dataEnd : 0); }
+
+	/** Read the next raw event. Its hits are then filled with GetHit.
+	  * \return False at the end of the file or if the event is corrupt.
+	  */
+	bool Next();
+
+	/// Return the number of hits of the raw event just read.
+	size_t GetNumEventHits() const { return hitOffsets.size(); }
+
+	/// Return the start time of the window of the raw event just read.
+	double GetStartTime() const { return startTime; }
+
+	/// Return the time of the first hit of the raw event just read.
+	double GetRealStartTime() const { return realStartTime; }
+
+	/// Return the time of the last hit of the raw event just read.
+	double GetRealStopTime() const { return realStopTime; }
+
+	/** Fill a hit of the raw event just read.
+	  * \param[in]  index_ The hit to fill, below GetNumEventHits().
+	  * \param[out] event_ The cleared XiaData to fill.
+	  * \return Nothing.
+	  */
+	void GetHit(const size_t &index_, XiaData *event_) const;
+
+	/// Move back to the first raw event of the file.
+	void Rewind();
+
+	/** Read the first raw events of the file into memory, so that they are read
+	  * again and again from memory after each Rewind, e.g. to time the processing
+	  * of the raw events without the noise of reading the file.
+	  * \param[in]  maxEvents_ The number of raw events to load, 0 to load every raw event.
+	  * \return The number of raw events loaded.
+	  */
+	unsigned long long Load(const unsigned long long &maxEvents_=0);
+
+	/** Move to the first raw event which starts at or after a time, using the index.
+	  * \param[in]  time_ The time to seek to (in clock ticks).
+	  * \return False if the file has no index.
+	  */
+	bool SeekTime(const double &time_);
+
+  private:
+	std::ifstream file; /// The input file.
+	bool indexed; /// True if the file has an index.
+
+	double firstTime; /// The time of the first raw event of the scan.
+	unsigned long long numEvents; /// The number of raw events in the file.
+	unsigned long long numHits; /// The number of hits in the file.
+	unsigned long long eventNumber; /// The number of the next raw event to read.
+	uint64_t position; /// The file offset of the next raw event.
+	uint64_t dataEnd; /// The file offset of the end of the raw events.
+
+	std::vector<std::pair<std::string, std::string> > header; /// The entries of the header of the input file.
+	std::vector<double> indexTimes; /// The start time of every indexStep-th raw event.
+	std::vector<uint64_t> indexOffsets; /// The file offset of every indexStep-th raw event.
+
+	double startTime; /// The start time of the raw event just read.
+	double realStartTime; /// The time of the first hit of the raw event just read.
+	double realStopTime; /// The time of the last hit of the raw event just read.
+	std::vector<char> buffer; /// The hits of the raw event just read.
+	std::vector<size_t> hitOffsets; /// The offset of each hit of the raw event in the buffer.
+
+	std::vector<char> memory; /// The raw events loaded into memory, from the first one on.
+	size_t cursor; /// The offset in memory of the next byte to read.
+	bool loaded; /// True if the raw events are read from memory instead of the file.
+
+	/// Read the index at the end of the file. Returns false if the file has none.
+	bool read_index();
+
+	/// Read length_ bytes at the current position, from memory if the raw events were loaded.
+	bool read_bytes(char *data_, const size_t &length_);
+};
+
+#endif
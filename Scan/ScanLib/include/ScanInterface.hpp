@@ -17,15 +17,21 @@
 #include <sstream>
 #include <vector>
 #include <deque>
+#include <ctime>
 #include <getopt.h>
 
 #include "hribf_buffers.h"
 #include "XiaData.hpp"
+#include "SpillPrefetcher.hpp"
+#include "SpillIndex.hpp"
+#include "RawEventFile.hpp"
 
 #define SCAN_VERSION "1.2.29"
 #define SCAN_DATE "Aug. 11th, 2016"
 
 class Server;
+class SpillShm;
+class StreamClient;
 class Terminal;
 class Unpacker;
 
@@ -99,9 +105,45 @@ class ScanInterface{
 	/// Return true if shared memory mode is enabled.
 	bool ShmMode(){ return shm_mode; }
 	
+	/// Return true if spills are read from the poll2 shared memory ring instead of the network.
+	bool ShmRingMode(){ return shm_ring; }
+	
+	/// Return true if the intact module buffers of fragmented shm spills are recovered.
+	bool RecoverMode(){ return recover_mode; }
+	
+	/// Return true if the scan is running.
+	bool IsRunning(){ return is_running; }
+	
 	/// Return true if batch processing mode is enabled.
 	bool BatchMode(){ return batch_mode; }
 	
+	/// Return true if the Unpacker will recycle XiaData objects through its event pool.
+	bool PoolMode(){ return pool_mode; }
+	
+	/// Return true if raw events will be built across spill boundaries.
+	bool StreamMode(){ return stream_mode; }
+	
+	/// Return true if the Unpacker will leave traces in the spill buffer until requested.
+	bool TraceViewMode(){ return trace_view_mode; }
+	
+	/// Return true if the Unpacker will skip trace payloads without reading them.
+	bool SkipTraces(){ return skip_traces; }
+	
+	/// Return true if input files are read through a memory mapping.
+	bool MmapMode(){ return mmap_mode; }
+	
+	/// Return the number of spills which are read ahead of the Unpacker (0 if read-ahead is disabled).
+	unsigned int GetPrefetchDepth(){ return prefetch_depth; }
+
+	/// Return the number of raw events the Unpacker may queue for its processing thread (0 if disabled).
+	unsigned int GetPipelineDepth(){ return pipeline_depth; }
+	
+	/// Return the spill shard processed by this scan and the number of shards (see ::SetSpillShard).
+	void GetSpillShard(unsigned int &index_, unsigned int &count_){ index_ = shard_index; count_ = shard_count; }
+
+	/// Return true if a spill index is loaded or built when a .ldf file is opened.
+	bool IndexMode(){ return index_mode; }
+	
 	/// Return the header string used to prefix output messages.
 	std::string GetMessageHeader(){ return msgHeader; }
 	
@@ -135,9 +177,94 @@ class ScanInterface{
 	/// Enable or disable shared memory mode.
 	bool SetShmMode(bool state_=true){ return (shm_mode = state_); }
 	
+	/** Enable or disable reading spills from the shared memory ring written by
+	  * poll2 --shm-ring on this host, instead of from the network. Only used
+	  * in shared memory mode. Must be called before ::Setup.
+	  */
+	bool SetShmRingMode(bool state_=true){ return (shm_ring = state_); }
+	
+	/** Enable or disable recovery of fragmented shm spills. Disabled by default.
+	  * When enabled, a spill which is missing network chunks is not discarded.
+	  * Every module buffer which arrived intact is passed to the Unpacker, and
+	  * the lost modules are replaced by empty buffers and counted.
+	  */
+	bool SetRecoverMode(bool state_=true){ return (recover_mode = state_); }
+	
 	/// Enable or disable batch processing mode.
 	bool SetBatchMode(bool state_=true){ return (batch_mode = state_); }
 	
+	/** Enable or disable the Unpacker event pool. Disabled by default. Only enable
+	  * this if the derived Unpacker does not delete the XiaData objects it receives
+	  * (see Unpacker::SetPoolMode). Must be called before ::Setup.
+	  */
+	bool SetPoolMode(bool state_=true){ return (pool_mode = state_); }
+	
+	/// Enable or disable building raw events across spill boundaries (see Unpacker::SetStreamMode).
+	bool SetStreamMode(bool state_=true){ return (stream_mode = state_); }
+	
+	/** Enable or disable Unpacker trace view mode. Disabled by default. Only enable
+	  * this if the derived Unpacker is finished with all traces by the time
+	  * ProcessRawEvent returns (see Unpacker::SetTraceViewMode). Must be called
+	  * before ::Setup.
+	  */
+	bool SetTraceViewMode(bool state_=true){ return (trace_view_mode = state_); }
+	
+	/** Enable or disable skipping of all trace payloads (see Unpacker::SetSkipTraces).
+	  * Disabled by default. Useful for energy and timing only passes over data
+	  * which was taken with traces. Must be called before ::Setup.
+	  */
+	bool SetSkipTraces(bool state_=true){ return (skip_traces = state_); }
+	
+	/** Enable or disable reading input files through a memory mapping. Disabled
+	  * by default. When enabled, buffers are parsed in place and .pld spills are
+	  * passed to the Unpacker without being copied. Must be called before a file
+	  * is opened.
+	  */
+	bool SetMmapMode(bool state_=true){ return (mmap_mode = state_); }
+	
+	/** Set the number of spills which a separate reader thread reads ahead of
+	  * the Unpacker when scanning a file as a stream. Zero disables read-ahead.
+	  * Read-ahead is not used for memory mapped files.
+	  */
+	unsigned int SetPrefetchDepth(unsigned int depth_){ return (prefetch_depth = depth_); }
+
+	/// Set the number of raw events the Unpacker may queue for its processing thread (see Unpacker::SetPipelineDepth). Must be called before ::Setup.
+	unsigned int SetPipelineDepth(unsigned int depth_){ return (pipeline_depth = depth_); }
+	
+	/** Process only one shard of the spills of an input file. Spill number n is passed
+	  * to the Unpacker only if n % count_ == index_, all other spills are read and
+	  * dropped. Scans of every shard of a file may then be run side by side and their
+	  * histograms summed. Events are never built across two shards, so this may not
+	  * be combined with stream mode or with analysis which correlates spills.
+	  * \param[in]  index_ The shard to process, from 0 to count_-1.
+	  * \param[in]  count_ The number of shards the spills are divided into.
+	  * \return False if index_ is not smaller than count_.
+	  */
+	bool SetSpillShard(unsigned int index_, unsigned int count_);
+
+	/** Shed load in shared memory mode when the scan falls behind poll2, instead of
+	  * losing spills at random when the queue overflows. The fill of the queue (the
+	  * unread spills of the ring, or the unread bytes of the socket) is checked
+	  * before each spill is processed. Past low_ the traces are skipped, and past
+	  * high_ only every Nth spill is processed, N doubling each time the queue is
+	  * still past high_ (up to 64). N is halved again, and then the traces are
+	  * unpacked again, once the queue is below low_. Disabled by default.
+	  * \param[in]  low_ Fill of the queue (0 to 1) at which the traces are skipped.
+	  * \param[in]  high_ Fill of the queue (low_ to 1) at which spills are skipped.
+	  * 
+eturn False if the fills are not 0 < low_ <= high_ <= 1.
+	  */
+	bool SetLoadShedding(double low_, double high_);
+
+	/** Enable or disable the spill index. Disabled by default. When enabled, the
+	  * index of a .ldf file is read from <filename>.idx when the file is opened,
+	  * or built in a separate pass over the file and written there if it does not
+	  * exist. The index allows seeking to a spill or time and lets the Unpacker
+	  * skip whole spills (see Unpacker::SkipSpill). Must be called before a file
+	  * is opened.
+	  */
+	bool SetIndexMode(bool state_=true){ return (index_mode = state_); }
+	
 	/// Main scan control method.
 	void RunControl();
 	
@@ -264,6 +391,25 @@ class ScanInterface{
 	  */
 	virtual void Notify(const std::string &code_=""){ }
 
+	/** SaveState is called when a checkpoint of the scan is written (see
+	  * --checkpoint), once every event read so far has been processed. A
+	  * derived class should write everything it needs to resume the scan
+	  * (e.g. its histograms) to the checkpoint file.
+	  * Does nothing useful by default.
+	  * \param[out] out_ The checkpoint file.
+	  * \return True upon success and false otherwise.
+	  */
+	virtual bool SaveState(std::ostream &out_){ return true; }
+
+	/** LoadState is called when a scan is resumed from a checkpoint (see
+	  * --resume), before any data is read. A derived class should read back
+	  * exactly what it wrote with SaveState.
+	  * Does nothing useful by default.
+	  * \param[in]  in_ The checkpoint file.
+	  * \return True upon success and false otherwise.
+	  */
+	virtual bool LoadState(std::istream &in_){ return true; }
+
 	/** Return a pointer to the Unpacker object to use for data unpacking.
 	  * If no object has been initialized, create a new one.
 	  * \return Pointer to an Unpacker object.
@@ -280,12 +426,30 @@ class ScanInterface{
 	std::string homeDir; /// Linux user home directory.
 	std::string setup_filename; //!< Configuration file to be opened
 	std::string output_filename; //!< Name of file to be used for output
+	std::string input_fname; /// Name of the main input file.
+	std::vector<std::string> merge_filenames; /// Input files whose spills are merged in time with those of the main input file.
 
 	int max_spill_size; /// Maximum size of a spill to read.
+	unsigned int decode_threads; /// Number of threads the Unpacker uses to decode module buffers.
+	unsigned int prefetch_depth; /// Number of spills to read ahead of the Unpacker (0 to disable).
+	unsigned int pipeline_depth; /// Number of raw events the Unpacker may queue for its processing thread (0 to disable).
+	unsigned int shard_index; /// Shard of the input file's spills processed by this scan.
+	unsigned int shard_count; /// Number of shards the input file's spills are divided into (1 to process every spill).
 	int file_format; /// Input file format to use (0=.ldf, 1=.pld, 2=.root).
+	bool compressed_input; /// Set to true if the input .pld file contains compressed spill blocks.
 	
 	unsigned long num_spills_recvd; /// The total number of good spills received from either the input file or shared memory.
+	unsigned long num_spills_recovered; /// The number of fragmented shm spills which were recovered.
+	unsigned long num_spills_shed; /// The number of shm spills which were received but skipped to shed load.
+	unsigned long num_spills_untraced; /// The number of shm spills processed without their traces to shed load.
+	std::vector<unsigned long> lost_buffers; /// The number of module buffers lost from recovered spills, indexed by module.
 	unsigned long file_start_offset; /// The first word in the file at which to start scanning.
+	unsigned int start_position; /// Position of the first spill to read in its buffer (.ldf files only).
+
+	unsigned int checkpoint_interval; /// Seconds between checkpoints of the scan (0 to disable).
+	time_t next_checkpoint; /// Time of the next checkpoint of the scan.
+	bool resume_mode; /// Set to true if the scan is to be resumed from its last checkpoint.
+	bool resume_complete; /// Set to true if the checkpoint resumed from was written at the end of the file.
 	
 	bool write_counts; /// Set to true if raw channel counts are to be written to file.
 
@@ -295,7 +459,24 @@ class ScanInterface{
 	bool debug_mode; /// Set to true if the user wishes to display debug information.
 	bool dry_run_mode; /// Set to true if a dry run is to be performed i.e. data is to be read but not processed.
 	bool shm_mode; /// Set to true if shared memory mode is to be used.
+	bool shm_ring; /// Set to true if shared memory mode reads from the local poll2 ring instead of the network.
+	bool recover_mode; /// Set to true if the intact module buffers of fragmented shm spills are to be recovered.
+	std::string stream_host; /// Host of the poll2 TCP stream read in shared memory mode, empty if not used.
+	int stream_port; /// Port of the poll2 TCP stream.
+	unsigned int stream_every; /// Ask the poll2 TCP stream for only every Nth spill.
+	double stream_rate; /// Ask the poll2 TCP stream for at most this many MB/s (0 for no limit).
+	double shed_low; /// Fill of the shm queue past which traces are skipped (0 to never shed load).
+	double shed_high; /// Fill of the shm queue past which only every shed_every spill is processed.
+	unsigned int shed_every; /// Only every Nth shm spill is processed while shedding load.
+	unsigned int shed_count; /// Number of shm spills skipped since the last processed spill.
+	bool shed_traces; /// Set to true while traces are skipped to shed load.
 	bool batch_mode; /// Set to true if the program is to be run with no interactive command line.
+	bool pool_mode; /// Set to true if the Unpacker should recycle XiaData objects.
+	bool trace_view_mode; /// Set to true if the Unpacker should not copy traces out of the spill buffer.
+	bool skip_traces; /// Set to true if the Unpacker should skip trace payloads entirely.
+	bool stream_mode; /// Set to true if raw events are to be built across spill boundaries.
+	bool mmap_mode; /// Set to true if input files are to be read through a memory mapping.
+	bool index_mode; /// Set to true if a spill index is to be used for .ldf files.
 	bool scan_init; /// Set to true when ScanInterface is initialized properly and is ready to scan.
 	bool file_open; /// Set to true when an input binary file is successfully opened for reading.
 
@@ -303,10 +484,19 @@ class ScanInterface{
 	bool run_ctrl_exit; /// Set to true when run control thread has exited.
 
 	Server *poll_server; /// Poll2 shared memory server.
+	SpillShm *spill_shm; /// Poll2 shared memory spill ring.
+	StreamClient *stream_client; /// Poll2 TCP spill stream.
 
 	std::ifstream input_file; /// Main input binary data file.
 	std::streampos file_length; /// Main input file length (in bytes).
 
+	unsigned int *map_data; /// Private (copy-on-write) memory mapping of the input file.
+	size_t map_words; /// Number of words in the memory mapping.
+	size_t map_pos; /// Position of the next unread word in the memory mapping.
+
+	size_t data_start; /// Word offset of the first data buffer in the input file.
+	SpillIndex spillIndex; /// Index of the spills in the input file (empty if not in use).
+
 	fileInformation finfo; /// Data structure for storing binary file header information.
 
 	PLD_header pldHead; /// PLD style HEAD buffer handler.
@@ -316,6 +506,14 @@ class ScanInterface{
 	DATA_buffer databuff; /// HRIBF DATA buffer handler.
 	EOF_buffer eofbuff; /// HRIBF EOF buffer handler.
 
+	SpillPrefetcher prefetcher; /// Read-ahead thread used when prefetch_depth is non-zero.
+	SpillBuffer spillBuffer; /// Spill buffer of the input read without the prefetcher, kept from one spill (and file) to the next.
+
+	RawEventReader event_reader; /// Reads the raw events of a .rev input file.
+	RawEventWriter event_recorder; /// Records the built raw events to a .rev file.
+	std::string record_fname; /// Name of the .rev file the raw events are recorded to, empty if they are not recorded.
+	bool record_traces; /// Set to false if the traces are left out of the recorded raw events.
+
 	Terminal *term; /// ncurses terminal used for displaying output and handling user input.
 
 	/// Start the scan.
@@ -332,6 +530,57 @@ class ScanInterface{
 	
 	/// Open a new binary input file for reading.
 	bool open_input_file(const std::string &fname_);
+
+	/// Map the entire input file into memory.
+	bool map_input_file(const std::string &fname_);
+
+	/// Remove the memory mapping of the input file, if there is one.
+	void unmap_input_file();
+
+	/// Scan the main input file and all merged input files, taking spills from each in time order.
+	void read_merged();
+
+	/// Process the raw events of a .rev input file without unpacking or building them again.
+	void replay_events();
+
+	/// Return the current read position in the input file (in bytes).
+	std::streampos get_file_position();
+
+	/// Return true if the spill being read belongs to the shard processed by this scan.
+	bool in_shard(){ return (shard_count <= 1 || num_spills_recvd % shard_count == shard_index); }
+
+	/// Build the spill index of the input .ldf file in a separate pass over the file.
+	bool build_index();
+
+	/// Load the spill index of the input .ldf file, building it if needed.
+	bool load_index();
+
+	/// Seek to the start of a spill in the spill index.
+	bool seek_spill(const size_t &spill_);
+
+	/// Seek to the start of the spill containing a given time.
+	bool seek_time(const unsigned long long &time_);
+
+	/// Return true if a checkpoint of the scan is due.
+	bool checkpoint_due(){ return (checkpoint_interval > 0 && !dry_run_mode && time(NULL) >= next_checkpoint); }
+
+	/// Write a checkpoint of the scan, to be resumed at the spill starting at word position_ of the buffer at word offset_.
+	bool write_checkpoint(const size_t &offset_, const unsigned int &position_, bool complete_=false);
+
+	/// Restore the state of the scan from its last checkpoint and seek to the next spill.
+	bool resume_scan();
+
+	/** Update the load shedding state from the fill of the shm queue (see ::SetLoadShedding).
+	  * \param[in]  fill_ Fill of the queue, from 0 (empty) to 1 (full).
+	  * \return True if the spill just received is to be processed and false if it is to be skipped.
+	  */
+	bool shed_load(const double &fill_);
+
+	/// Return the load shedding state and the percentage of the shm spills which were processed, for the status line.
+	std::string shed_status();
+
+	/// Keep the intact module buffers of a spill which is missing network chunks.
+	unsigned int recover_spill(unsigned int *data_, const unsigned int &nWords_, const std::vector<bool> &goodChunks_, const unsigned int &chunkWords_);
 };
 
 /// Get the file extension from an input filename string.
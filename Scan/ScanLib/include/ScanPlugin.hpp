@@ -0,0 +1,267 @@
+/** \file ScanPlugin.hpp
+ * \brief Header only layer over Unpacker and ScanInterface for small scan tools.
+ *
+ * Instead of copying the skeleton and overriding the virtual methods of the
+ * Unpacker and ScanInterface, a tool may be written as a single plugin class
+ * derived from ScanPlugin, which hides the callbacks it needs:
+ *
+ * \code
+ * class EnergySkim : public ScanPlugin {
+ *   public:
+ *	static const bool buildEvents = false;
+ *	void Hit(const XiaData &hit_){ if(hit_.energy > 1000){ ... } }
+ * };
+ *
+ * int main(int argc, char *argv[]){ return RunScanPlugin<EnergySkim>(argc, argv, "EnergySkim"); }
+ * \endcode
+ *
+ * The callbacks are called on the plugin type itself, so they are resolved at
+ * compile time and inlined into the loop over the decoded hits, without a
+ * virtual call per hit.
+ */
+#ifndef SCANPLUGIN_HPP
+#define SCANPLUGIN_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+
+#include "XiaData.hpp"
+#include "Unpacker.hpp"
+#include "ScanInterface.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// class ScanPlugin
+///////////////////////////////////////////////////////////////////////////////
+
+/** The default callbacks of a scan plugin, which do nothing. Plugins derive
+  * from this class and hide the callbacks they use.
+  */
+class ScanPlugin {
+  public:
+	/** Set to false in a plugin which only needs the individual hits. Raw
+	  * events are then not built, and Hit() is called for every hit as soon as
+	  * its module buffer is decoded. Otherwise Event() is called for every raw
+	  * event and Hit() is never called.
+	  */
+	static const bool buildEvents = true;
+
+	/** Add the command line options of the plugin.
+	  * \param[out] opts_ The list of options to add to.
+	  * \return Nothing.
+	  */
+	void AddOptions(std::vector<optionExt> &opts_){  }
+
+	/** Read the command line options of the plugin.
+	  * \param[in]  opts_ The options added by AddOptions(), in the same order.
+	  * \return Nothing.
+	  */
+	void SetOptions(const std::vector<optionExt> &opts_){  }
+
+	/** Open any output before the scan starts.
+	  * \param[in]  fname_ The output filename given on the command line.
+	  * \return True upon success and false to abort the scan.
+	  */
+	bool Initialize(const std::string &fname_){ return true; }
+
+	/** Handle one hit, only called if buildEvents is false. The hit is reused
+	  * once this returns, and any trace view is only valid until then.
+	  * \param[in]  hit_ The decoded hit.
+	  * \return Nothing.
+	  */
+	void Hit(const XiaData &hit_){  }
+
+	/** Handle one raw event, only called if buildEvents is true. The events
+	  * are released once this returns.
+	  * \param[in]  event_ The time ordered hits of the raw event.
+	  * \return Nothing.
+	  */
+	void Event(const std::deque<XiaData*> &event_){  }
+
+	/** Finish up once the scan is complete.
+	  * \return Nothing.
+	  */
+	void Finish(){  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class PluginUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/** Unpacker which passes the hits or raw events of the input to a plugin.
+  */
+template <class Plugin>
+class PluginUnpacker : public Unpacker {
+  public:
+	/// Constructor taking the plugin to call.
+	PluginUnpacker(Plugin &plugin_) : Unpacker(), plugin(plugin_), numHits(0), numBadSpills(0) {  }
+
+	/// Destructor.
+	~PluginUnpacker(){
+		for(std::vector<XiaData*>::iterator iter = cache.begin(); iter != cache.end(); iter++)
+			ReleaseEvent(*iter);
+	}
+
+	/// Return the number of hits passed to the plugin (only counted if buildEvents is false).
+	unsigned long long GetNumHits() const { return numHits; }
+
+	/// Return the number of spills which failed to decode (only counted if buildEvents is false).
+	unsigned long long GetNumBadSpills() const { return numBadSpills; }
+
+	/** Read a spill. If the plugin builds raw events this is Unpacker::ReadSpill.
+	  * Otherwise each module buffer is decoded in turn and its hits are passed
+	  * straight to Plugin::Hit().
+	  * \param[in]  data       Pointer to an array of unsigned ints containing the spill data.
+	  * \param[in]  nWords     The number of words in the array.
+	  * \param[in]  is_verbose Toggle the verbosity flag on/off.
+	  * \return True if the spill was read successfully and false otherwise.
+	  */
+	virtual bool ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose=true){
+		if(Plugin::buildEvents){ return Unpacker::ReadSpill(data, nWords, is_verbose); }
+
+		const unsigned int maxVsn = 14; // No more than 14 pixie modules per crate
+		size_t nWords_read = 0;
+		unsigned int lenRec = 0;
+		unsigned int vsn = 0xFFFFFFFF;
+
+		while(nWords_read + 1 < nWords){
+			while(nWords_read < nWords && data[nWords_read] == 0xFFFFFFFF) // Search for the next non-delimiter.
+				nWords_read++;
+			if(nWords_read + 1 >= nWords){ break; }
+
+			lenRec = data[nWords_read]; // Number of words in this record
+			vsn = data[nWords_read+1]; // Module number
+
+			if(vsn == 9999){ break; } // End spill vsn
+
+			// Check sanity of record length and vsn
+			if(lenRec < 2 || nWords_read + lenRec > nWords || (vsn > maxVsn && vsn != 1000)){
+				if(is_verbose){
+					std::cout << "PluginUnpacker: SANITY CHECK FAILED: lenRec = " << lenRec << ", vsn = " << vsn << ", read " << nWords_read << " of " << nWords << std::endl;
+				}
+				numBadSpills++;
+				return false;
+			}
+
+			// Empty modules (record length 6) and the wall clock buffer (vsn 1000) hold no hits.
+			if(lenRec != 6 && vsn < maxVsn){
+				events.clear();
+				int retval = DecodeBuffer(&data[nWords_read], events, &cache);
+				for(std::vector<XiaData*>::iterator iter = events.begin(); iter != events.end(); iter++){
+					plugin.Hit(**iter);
+					ReleaseCachedEvent(*iter, &cache);
+				}
+				numHits += events.size();
+				if(retval <= -100){
+					if(is_verbose){ std::cout << "PluginUnpacker: READOUT PROBLEM in module " << vsn << std::endl; }
+					numBadSpills++;
+					return false;
+				}
+			}
+
+			nWords_read += lenRec;
+		}
+
+		return true;
+	}
+
+  protected:
+	Plugin &plugin; /// The plugin receiving the hits or raw events.
+
+	std::vector<XiaData*> events; /// The hits decoded from the current module buffer.
+	std::vector<XiaData*> cache; /// Cache of hits reused for every buffer.
+
+	unsigned long long numHits; /// The number of hits passed to the plugin.
+	unsigned long long numBadSpills; /// The number of spills which failed to decode.
+
+	/** Pass the current raw event to the plugin.
+	  * \param[in]  addr_ Pointer to a ScanInterface object. Unused.
+	  * \return Nothing.
+	  */
+	virtual void ProcessRawEvent(ScanInterface *addr_=NULL){ plugin.Event(rawEvent); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class PluginScanner
+///////////////////////////////////////////////////////////////////////////////
+
+/** ScanInterface which runs a plugin over the input.
+  */
+template <class Plugin>
+class PluginScanner : public ScanInterface {
+  public:
+	/// Default constructor.
+	PluginScanner() : ScanInterface() {  }
+
+	/// Return the plugin.
+	Plugin &GetPlugin(){ return plugin; }
+
+	/** Return a pointer to the Unpacker object to use for data unpacking.
+	  * If no object has been initialized, create a new one.
+	  * \return Pointer to an Unpacker object.
+	  */
+	virtual Unpacker *GetCore(){
+		if(!core){ core = (Unpacker*)(new PluginUnpacker<Plugin>(plugin)); }
+		return core;
+	}
+
+  protected:
+	Plugin plugin; /// The plugin.
+
+	/// Pass the command line options of the plugin to the plugin.
+	virtual void ExtraArguments(){ plugin.SetOptions(userOpts); }
+
+	/// Add the command line options of the plugin.
+	virtual void ArgHelp(){
+		std::vector<optionExt> opts;
+		plugin.AddOptions(opts);
+		for(std::vector<optionExt>::iterator iter = opts.begin(); iter != opts.end(); iter++)
+			AddOption(*iter);
+	}
+
+	/** Initialize the plugin.
+	  * \param[in]  prefix_ String to append to the beginning of system output.
+	  * \return True upon successfully initializing and false otherwise.
+	  */
+	virtual bool Initialize(std::string prefix_=""){ return plugin.Initialize(GetOutputFilename()); }
+
+	/** Receive various status notifications from the scan.
+	  * \param[in] code_ The notification code passed from ScanInterface methods.
+	  * \return Nothing.
+	  */
+	virtual void Notify(const std::string &code_=""){
+		if(code_ == "SCAN_COMPLETE"){
+			std::cout << msgHeader << "Scan complete.\n";
+			plugin.Finish();
+		}
+		else if(code_ == "LOAD_FILE"){ std::cout << msgHeader << "File loaded.\n"; }
+	}
+};
+
+/** Set up and run a plugin scan, as the main() of a tool.
+  * \param[in]  argc  The number of command line arguments.
+  * \param[in]  argv  The command line arguments.
+  * \param[in]  name_ The name of the program.
+  * \return The exit code of the scan.
+  */
+template <class Plugin>
+int RunScanPlugin(int argc, char *argv[], const std::string &name_){
+	PluginScanner<Plugin> scanner;
+
+	// Set the output message prefix.
+	scanner.SetProgramName(name_);
+
+	// Initialize the scanner.
+	if(!scanner.Setup(argc, argv))
+		return 1;
+
+	// Run the main loop.
+	int retval = scanner.Execute();
+
+	scanner.Close();
+
+	return retval;
+}
+
+#endif
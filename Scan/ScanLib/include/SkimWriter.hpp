@@ -0,0 +1,104 @@
+/** \file SkimWriter.hpp
+ * \brief Writes the hits of selected raw events to a new .pld file.
+ *
+ * Once a first pass over the data has found which raw events are of
+ * interest, a skim of only those events may be scanned again much faster
+ * than the complete data. Each hit is written back as a revision F
+ * list-mode event (header words, onboard energy sums and QDCs, and trace)
+ * into the block of its module, and the blocks are written as a spill
+ * whenever the next event would no longer fit into the records accepted by
+ * the Unpacker. The file header is copied from the input file.
+ */
+#ifndef SKIMWRITER_HPP
+#define SKIMWRITER_HPP
+
+#include <deque>
+#include <string>
+#include <fstream>
+#include <vector>
+
+#include "hribf_buffers.h"
+
+class XiaData;
+
+class SkimWriter{
+  public:
+	/// Default constructor.
+	SkimWriter();
+
+	/// Destructor. Writes the last spill and closes the file.
+	~SkimWriter();
+
+	/** Open the output file and write a blank header, which is overwritten once the file is closed.
+	  * \param[in]  fname_ The name of the .pld file to write.
+	  * \return True if the file was opened and false otherwise.
+	  */
+	bool Open(const std::string &fname_);
+
+	/// Write the last spill and the header and close the file.
+	void Close();
+
+	/// Return true if the output file is open.
+	bool IsOpen() const { return file.is_open(); }
+
+	/// Return the name of the output file.
+	const std::string &GetName() const { return fname; }
+
+	/// Return the number of raw events written.
+	unsigned long long GetNumEvents() const { return numEvents; }
+
+	/// Return the number of hits written.
+	unsigned long long GetNumHits() const { return numHits; }
+
+	/** Copy an entry of the header of the input file to the header of the skim. Only the
+	  * run number, title, facility, start and stop dates and run time are copied.
+	  * \param[in]  name_  The name of the entry, as in ScanInterface::GetFileInfo().
+	  * \param[in]  value_ The value of the entry.
+	  * \return Nothing.
+	  */
+	void SetHeader(const std::string &name_, const std::string &value_);
+
+	/** Write the hits of a raw event. The hits of an event are always written to the same spill.
+	  * \param[in]  event_ The hits of the raw event.
+	  * \return True if the hits were written and false if the file is not open.
+	  */
+	bool Write(const std::deque<XiaData*> &event_);
+
+	/** Encode a hit as a revision F list-mode event. The onboard energy of a
+	  * saturated hit is written as the value the Unpacker gives it.
+	  * \param[in]  event_ The hit to encode.
+	  * \param[out] words_ The list-mode words are appended to this vector.
+	  * \return The number of words appended.
+	  */
+	static unsigned int Encode(XiaData *event_, std::vector<unsigned int> &words_);
+
+	/** Write the spills of several skim files, one file after the other, to a single .pld
+	  * file. The header is copied from the first input, with the largest spill of all inputs.
+	  * \param[in]  fname_  The name of the .pld file to write.
+	  * \param[in]  inputs_ The names of the skim files to merge.
+	  * \return True if every spill of every input was written and false otherwise.
+	  */
+	static bool Merge(const std::string &fname_, const std::vector<std::string> &inputs_);
+
+  private:
+	std::string fname; /// The name of the output file.
+	std::ofstream file; /// The output file.
+
+	PLD_header pldHead; /// The header of the output file.
+	PLD_data pldData; /// PLD style DATA buffer handler.
+
+	std::vector<std::vector<unsigned int> > blocks; /// The hits of each module in the current spill.
+	std::vector<std::vector<unsigned int> > eventWords; /// Scratch space for the hits of one raw event, by module.
+	unsigned int spillWords; /// The number of words in the current spill.
+	unsigned int maxSpillSize; /// The largest spill written (in words).
+
+	unsigned long long numEvents; /// The number of raw events written.
+	unsigned long long numHits; /// The number of hits written.
+
+	std::vector<unsigned int> spill; /// Scratch space for the spill being written.
+
+	/// Write the current spill, if it is not empty.
+	bool Flush();
+};
+
+#endif
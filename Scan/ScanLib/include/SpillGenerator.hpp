@@ -0,0 +1,81 @@
+#ifndef SPILLGENERATOR_HPP
+#define SPILLGENERATOR_HPP
+
+#include <vector>
+#include <random>
+
+/** Generates synthetic Pixie-16 (revision F) list-mode spills in the format
+  * written by poll2, for benchmarking the scan pipeline without a crate or a
+  * data file. Events arrive at a fixed mean rate, and each event fires a
+  * number of channels picked at random among all channels of the crate.
+  * Every hit carries a random energy and optionally a trace with a simple
+  * exponential pulse. Like a readout triggered by a full FIFO, a spill ends
+  * early once a module or the whole spill would exceed the largest record
+  * accepted by the Unpacker.
+  */
+class SpillGenerator{
+  public:
+	/// Default constructor.
+	SpillGenerator();
+
+	/// Set the number of modules in the crate.
+	void SetModules(const unsigned int &modules_){ modules = (modules_ > 0 ? modules_ : 1); }
+
+	/// Set the mean event rate of the crate, in Hz.
+	void SetRate(const double &rate_){ rate = rate_; }
+
+	/// Set the mean number of channels firing in each event.
+	void SetMultiplicity(const double &mult_){ multiplicity = mult_; }
+
+	/// Set the number of samples of the trace of every hit, zero for no traces.
+	void SetTraceLength(const unsigned int &length_){ traceLength = length_ & ~1u; }
+
+	/// Set the length of a spill, in seconds.
+	void SetSpillTime(const double &time_){ spillTime = time_; }
+
+	/// Set the largest number of words of a module record and of a whole spill.
+	void SetMaxWords(const unsigned int &module_, const unsigned int &spill_){ maxModuleWords = module_; maxSpillWords = spill_; }
+
+	/// Restart the generator with a new seed.
+	void SetSeed(const unsigned int &seed_){ rng.seed(seed_); }
+
+	unsigned int GetModules() const { return modules; }
+
+	/// Return the time covered by the last spill, in seconds, which is shorter than the spill time if it ended early.
+	double GetLastSpillTime() const { return lastSpillTime; }
+
+	/** Generate the next spill, following the last one in time.
+	  * \param[out] spill_ The spill, one block per module followed by the end of spill block.
+	  * \return The number of hits in the spill.
+	  */
+	size_t Next(std::vector<unsigned int> &spill_);
+
+  private:
+	unsigned int modules; ///< The number of modules.
+	double rate; ///< The mean event rate, in Hz.
+	double multiplicity; ///< The mean number of channels per event.
+	unsigned int traceLength; ///< The number of samples per trace.
+	double spillTime; ///< The length of a spill, in seconds.
+	unsigned int maxModuleWords; ///< The largest number of words of a module record.
+	unsigned int maxSpillWords; ///< The largest number of words of a spill.
+
+	double lastSpillTime; ///< The time covered by the last spill, in seconds.
+
+	unsigned long long clock; ///< The time of the last event, in 8 ns ticks, starting one second after boot.
+
+	std::mt19937 rng; ///< The random number generator.
+
+	std::vector<std::vector<unsigned int> > blocks; ///< The hits of each module in the current spill.
+	std::vector<unsigned int> channels; ///< Work space for picking the channels of an event.
+
+	/** Add a hit to the block of its module.
+	  * \param[in]  mod_    The module.
+	  * \param[in]  chan_   The channel.
+	  * \param[in]  time_   The time of the hit, in 8 ns ticks.
+	  * \param[in]  energy_ The energy of the hit.
+	  * \return Nothing.
+	  */
+	void AddHit(const unsigned int &mod_, const unsigned int &chan_, const unsigned long long &time_, const unsigned int &energy_);
+};
+
+#endif
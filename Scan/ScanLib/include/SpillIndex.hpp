@@ -0,0 +1,118 @@
+/** \file SpillIndex.hpp
+ * \brief An index of the spills in a .ldf file, used for seeking.
+ *
+ * Each entry records where a spill starts in the file (the word offset of the
+ * ldf buffer holding its first chunk and the position within that buffer), the
+ * number of words in the spill and the time of its earliest event. The index is
+ * stored next to the data file as <filename>.idx so that it only has to be built
+ * once. Spills are assumed to be written in time order.
+ */
+#ifndef SPILLINDEX_HPP
+#define SPILLINDEX_HPP
+
+#include <vector>
+#include <string>
+#include <stddef.h>
+
+struct SpillSpan;
+
+class SpillIndex{
+  public:
+	/// A single indexed spill.
+	class Entry{
+	  public:
+		size_t offset; /// Word offset in the file of the ldf buffer containing the start of the spill.
+		unsigned int position; /// Word position of the start of the spill within that buffer.
+		unsigned int numWords; /// The number of words in the spill.
+		unsigned long long firstTime; /// The earliest event time in the spill (in clock ticks).
+
+		Entry() : offset(0), position(0), numWords(0), firstTime(0) { }
+	};
+
+	/// Default constructor.
+	SpillIndex() : fileLength(0) { }
+
+	/// Return the number of indexed spills.
+	size_t size() const { return entries.size(); }
+
+	/// Return true if no spills are indexed.
+	bool empty() const { return entries.empty(); }
+
+	/// Return the entry of the spill with index spill_.
+	const Entry &operator [] (const size_t &spill_) const { return entries[spill_]; }
+
+	/// Add a spill to the end of the index.
+	void push_back(const Entry &entry_){ entries.push_back(entry_); }
+
+	/// Remove all entries.
+	void clear(){ entries.clear(); }
+
+	/// Return the length of the indexed data file (in bytes).
+	unsigned long long GetFileLength() const { return fileLength; }
+
+	/// Set the length of the indexed data file (in bytes).
+	void SetFileLength(const unsigned long long &length_){ fileLength = length_; }
+
+	/** Find the spill which starts at a given position in the file.
+	  * \param[in]  offset_   Word offset of the ldf buffer containing the start of the spill.
+	  * \param[in]  position_ Word position of the start of the spill within that buffer.
+	  * \param[out] spill_    The index of the spill.
+	  * \return True if the spill is in the index and false otherwise.
+	  */
+	bool FindSpill(const size_t &offset_, const unsigned int &position_, size_t &spill_) const;
+
+	/** Find the last spill which starts at or before a given time.
+	  * \param[in]  time_  The time to search for (in clock ticks).
+	  * \param[out] spill_ The index of the spill.
+	  * \return True if such a spill exists and false otherwise.
+	  */
+	bool FindTime(const unsigned long long &time_, size_t &spill_) const;
+
+	/** Get the time range covered by a spill. The range ends at the first time of
+	  * the following spill, so it is unknown for the last spill in the index.
+	  * \param[in]  spill_ The index of the spill.
+	  * \param[out] start_ The earliest event time in the spill.
+	  * \param[out] stop_  The earliest event time in the following spill.
+	  * \return True if the range is known and false otherwise.
+	  */
+	bool GetTimeRange(const size_t &spill_, unsigned long long &start_, unsigned long long &stop_) const;
+
+	/** Read an index from file.
+	  * \param[in]  fname_ The index filename.
+	  * \return True upon success and false otherwise.
+	  */
+	bool Read(const std::string &fname_);
+
+	/** Write the index to file.
+	  * \param[in]  fname_ The index filename.
+	  * \return True upon success and false otherwise.
+	  */
+	bool Write(const std::string &fname_) const;
+
+	/// Return the name of the index file for a given data file.
+	static std::string GetIndexFilename(const std::string &fname_){ return fname_ + ".idx"; }
+
+	/** Find the earliest event time in a spill without decoding it. Only the
+	  * first event of each module buffer is inspected, since the events within
+	  * a module buffer are in time order.
+	  * \param[in]  data_   The spill data.
+	  * \param[in]  nWords_ The number of words in the spill.
+	  * \param[out] time_   The earliest event time (in clock ticks).
+	  * \return True if the spill contains at least one event and false otherwise (time_ is not modified).
+	  */
+	static bool GetFirstTime(const unsigned int *data_, const unsigned int &nWords_, unsigned long long &time_);
+
+	/** Find the earliest event time in a spill which was not reassembled, as read by
+	  * DATA_buffer from a memory mapped file. The words are read where they lie.
+	  * \param[in]  spans_ The spill chunks, in order.
+	  * \param[out] time_  The earliest event time (in clock ticks).
+	  * eturn True if the spill contains at least one event and false otherwise (time_ is not modified).
+	  */
+	static bool GetFirstTime(const std::vector<SpillSpan> &spans_, unsigned long long &time_);
+
+  private:
+	std::vector<Entry> entries; /// The indexed spills, in file order.
+	unsigned long long fileLength; /// Length of the indexed data file, used to detect a stale index.
+};
+
+#endif
@@ -0,0 +1,118 @@
+/** \file SpillPrefetcher.hpp
+ * \brief A read-ahead thread which fills a ring of spill buffers from an input file.
+ *
+ * The prefetcher runs a reader thread which calls a user supplied read function
+ * to fill a fixed number of spill buffers, while the scan thread consumes them
+ * in order. This lets reading from disk overlap with unpacking. Counters are
+ * kept of how often each side had to wait on the other.
+ */
+#ifndef SPILLPREFETCHER_HPP
+#define SPILLPREFETCHER_HPP
+
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "SpillBuffer.h"
+
+class SpillPrefetcher{
+  public:
+	/// A single spill read from the input file.
+	class Spill{
+	  public:
+		SpillBuffer data; /// The spill data, grown by the read function to fit the spill.
+		unsigned int nBytes; /// The number of bytes in the spill.
+		bool good; /// True if the read function returned a spill.
+		bool full_spill; /// True if the spill is complete (ldf only).
+		bool bad_spill; /// True if the spill is flagged as corrupt (ldf only).
+		int retval; /// Return code of the read (see DATA_buffer::GetRetval).
+		std::streampos position; /// The file position after reading this spill (in bytes).
+		unsigned int numChunks; /// The number of good spill chunks read so far (ldf only).
+		unsigned int numMissing; /// The number of missing spill chunks so far (ldf only).
+		size_t spillOffset; /// Word offset of the ldf buffer where the spill started, or of the start of the pld spill.
+		unsigned int spillPosition; /// Position of the start of the spill within that buffer (ldf only).
+
+		Spill() : nBytes(0), good(false), full_spill(false), bad_spill(false), retval(0), position(0), numChunks(0), numMissing(0), spillOffset(0), spillPosition(0) { }
+	};
+
+	/** The function used to read the next spill. Returns false if no more spills
+	  * should be read after this one; the spill is still passed on to the consumer.
+	  */
+	typedef std::function<bool(Spill&)> ReadFunction;
+
+	/// Default constructor.
+	SpillPrefetcher();
+
+	/// Destructor. Stops the reader thread.
+	~SpillPrefetcher();
+
+	/// Return true if the reader thread has been started and not stopped.
+	bool IsActive(){ return active; }
+
+	/// Return true if the reader thread has read its last spill.
+	bool IsFinished();
+
+	/// Return the number of spills waiting to be consumed.
+	size_t GetQueueDepth();
+
+	/// Return the number of spill buffers in the ring.
+	size_t GetCapacity(){ return ring.size(); }
+
+	/// Return the number of times the reader had to wait for a free buffer.
+	unsigned long GetReaderStalls();
+
+	/// Return the number of times the consumer had to wait for a spill to be read.
+	unsigned long GetConsumerStalls();
+
+	/** Start the reader thread. Does nothing if it is already active.
+	  * \param[in]  depth_ The number of spill buffers in the ring.
+	  * \param[in]  read_  The function used to read each spill.
+	  * \return Nothing.
+	  */
+	void Start(const size_t &depth_, ReadFunction read_);
+
+	/** Stop the reader thread and discard all spills which have not been consumed.
+	  * \return Nothing.
+	  */
+	void Stop();
+
+	/** Wait for the next spill. The spill remains valid until Pop() is called.
+	  * \return Pointer to the next spill, or NULL if the reader has finished
+	  *         (or was stopped) and no spills are left.
+	  */
+	Spill *Front();
+
+	/** Return the spill obtained from Front() to the ring of free buffers.
+	  * \return Nothing.
+	  */
+	void Pop();
+
+  private:
+	std::vector<Spill> ring; /// The spill buffers.
+	std::deque<size_t> freeSlots; /// Indices of buffers which may be filled by the reader.
+	std::deque<size_t> filledSlots; /// Indices of buffers waiting for the consumer, in read order.
+
+	std::thread reader; /// The reader thread.
+	std::mutex lock; /// Lock for the slot lists and flags.
+	std::condition_variable slotFreed; /// Signalled when a buffer is returned to the free list.
+	std::condition_variable slotFilled; /// Signalled when a spill is read or the reader exits.
+
+	ReadFunction readSpill; /// The function used to read each spill.
+
+	std::atomic<bool> active; /// True if the reader thread is running or has finished but was not stopped.
+	bool finished; /// True if the reader thread has read its last spill.
+	bool stopping; /// True if the reader thread has been asked to exit.
+
+	unsigned long readerStalls; /// Number of times the reader waited for a free buffer.
+	unsigned long consumerStalls; /// Number of times the consumer waited for a spill.
+
+	/// Main loop of the reader thread.
+	void ReadLoop();
+};
+
+#endif
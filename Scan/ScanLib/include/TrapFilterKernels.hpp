@@ -0,0 +1,87 @@
+#ifndef TRAPFILTERKERNELS_HPP
+#define TRAPFILTERKERNELS_HPP
+
+#include <vector>
+
+#include <cstddef>
+
+/** The inner loops of the Pixie style trapezoidal filters. They only work on
+  * plain sample arrays, so that they are shared by the TraceFilter of utkscan
+  * and the stand-alone utilities. All lengths are in samples.
+  */
+class TrapFilterKernels {
+  public:
+	/** Compute the running sum of a trace. The sum is kept in integers so that
+	  * differences of it are exact, and every window sum of the filters costs
+	  * a single subtraction.
+	  * \param[in]  samples_ The trace samples.
+	  * \param[in]  size_    The number of samples.
+	  * \param[out] sum_     The sum of the samples before each index, size_+1 long.
+	  * \return Nothing.
+	  */
+	template <typename T>
+	static void RunningSum(const T *samples_, const size_t &size_, std::vector<long long> &sum_){
+		sum_.resize(size_ + 1);
+		sum_[0] = 0;
+		for(size_t i = 0; i < size_; i++)
+			sum_[i+1] = sum_[i] + samples_[i];
+	}
+
+	/** Compute a trapezoidal filter from a running sum, as the difference of
+	  * the sums of the rise samples after the gap and before it, divided by
+	  * the rise. There is no dependence between samples, so the loop is
+	  * vectorized by the compiler. The first 2*rise+gap-1 values are zero.
+	  * \param[in]  sum_  The running sum of the trace.
+	  * \param[in]  rise_ The rise time.
+	  * \param[in]  gap_  The flat top.
+	  * \param[out] filt_ The filter, one value per sample.
+	  * \return Nothing.
+	  */
+	static void Trapezoid(const std::vector<long long> &sum_, const int &rise_, const int &gap_, std::vector<double> &filt_){
+		int size = (int)sum_.size() - 1;
+		int first = 2*rise_ + gap_ - 1;
+		filt_.assign(size > 0 ? size : 0, 0.0);
+
+		const long long *s = sum_.data();
+		double *f = filt_.data();
+		for(int i = first; i < size; i++)
+			f[i] = ((s[i+1] - s[i-rise_+1]) - (s[i-rise_-gap_+1] - s[i-first])) / (double)rise_;
+	}
+
+	/** Compute the recursive trapezoid with pole-zero correction of
+	  * V. T. Jordanov and G. F. Knoll, NIM A 345 (1994) 337, which is the one
+	  * used by the Pixie FPGA. It costs O(1) per sample for any filter length.
+	  * \param[in]  samples_  The trace samples.
+	  * \param[in]  size_     The number of samples.
+	  * \param[in]  baseline_ The baseline subtracted from every sample.
+	  * \param[in]  rise_     The rise time.
+	  * \param[in]  gap_      The flat top.
+	  * \param[in]  beta_     The decay per sample, exp(-1/tau).
+	  * \param[out] filt_     The filter, one value per sample.
+	  * \return Nothing.
+	  */
+	template <typename T>
+	static void Recursive(const T *samples_, const size_t &size_, const double &baseline_, const int &rise_, const int &gap_, const double &beta_, std::vector<double> &filt_){
+		int k = rise_, m = rise_ + gap_;
+		int size = (int)size_;
+		double pz = beta_ / (1 - beta_);
+		double norm = k * (pz + 1);
+
+		filt_.assign(size_, 0.0);
+		double acc = 0, out = 0;
+		for(int i = 0; i < size; i++){
+			double d = samples_[i] - baseline_;
+			if(i >= k)
+				d -= samples_[i-k] - baseline_;
+			if(i >= m)
+				d -= samples_[i-m] - baseline_;
+			if(i >= k + m)
+				d += samples_[i-k-m] - baseline_;
+			acc += d;
+			out += acc + pz * d;
+			filt_[i] = out / norm;
+		}
+	}
+};
+
+#endif
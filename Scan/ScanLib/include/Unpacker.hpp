@@ -16,6 +16,15 @@
 #include <deque>
 #include <vector>
 #include <string>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "HitTable.hpp"
+#include "ChannelCounters.hpp"
+#include "PerfCounters.hpp"
 
 #ifndef MAX_PIXIE_MOD
 #define MAX_PIXIE_MOD 12
@@ -23,8 +32,23 @@
 #ifndef MAX_PIXIE_CHAN
 #define MAX_PIXIE_CHAN 15
 #endif
+#ifndef MAX_CARRY_WIDTHS
+#define MAX_CARRY_WIDTHS 1000
+#endif
+#ifndef EVENT_CACHE_SIZE
+#define EVENT_CACHE_SIZE 256
+#endif
+#ifndef POOL_SLAB_SIZE
+#define POOL_SLAB_SIZE 4096
+#endif
+#ifndef HIT_DROP_ALL
+#define HIT_DROP_ALL 0xFFFFFFFF
+#endif
 
 class XiaData;
+class ListModeHeaders;
+class RawEventWriter;
+class RawEventReader;
 class ScanMain;
 class ScanInterface;
 
@@ -63,25 +87,265 @@ class Unpacker{
 	/// Return true if the scan is running and false otherwise.
 	bool IsRunning(){ return running; }
 
+	/// Return true if XiaData objects are recycled through the event pool.
+	bool PoolMode(){ return pool_mode; }
+
+	/// Return true if traces are left in the spill buffer instead of being copied.
+	bool TraceViewMode(){ return trace_view_mode; }
+
+	/// Return true if trace payloads are skipped without being read.
+	bool SkipTraces(){ return skip_traces; }
+
+	/// Return the number of threads used to decode module buffers.
+	unsigned int GetDecodeThreads(){ return decode_threads; }
+
+	/// Return true if raw events are built across spill boundaries.
+	bool StreamMode(){ return stream_mode; }
+
+	/// Return true if raw events are only built around trigger hits.
+	bool TriggerMode(){ return !triggerWindows.empty(); }
+
+	/// Return the number of hits which were not inside the window of any trigger.
+	unsigned long long GetNumUntriggeredHits(){ return numUntriggered; }
+
+	/// Return true if each raw event is also stored in the columnar hit table.
+	bool HitTableMode(){ return hit_table_mode; }
+
+	/// Return the maximum number of raw events queued for the processing thread (0 if disabled).
+	unsigned int GetPipelineDepth(){ return pipeline_depth; }
+
+	/// Return the number of XiaData objects currently waiting in the event pool.
+	size_t GetPoolSize(){ return eventPool.size(); }
+
+	/// Return the total number of XiaData objects allocated by the event pool.
+	size_t GetPoolCapacity(){ return eventSlabs.size()*POOL_SLAB_SIZE; }
+
+	/// Return the number of hits dropped by the hit filter.
+	unsigned long long GetNumDroppedHits(){ return numDroppedHits; }
+
+	/// Return the timers and counters of the stages of the scan.
+	PerfCounters &GetPerf(){ return perf; }
+
+	/** Set the memory budget of the scan. UpdateMemory warns once each time
+	  * the memory of all subsystems goes over the budget.
+	  * \param[in]  bytes_ The budget in bytes, zero for no budget.
+	  * \return The budget.
+	  */
+	unsigned long long SetMemoryBudget(const unsigned long long &bytes_){ return (memoryBudget = bytes_); }
+
+	/// Return the memory budget of the scan in bytes, zero if there is none.
+	unsigned long long GetMemoryBudget(){ return memoryBudget; }
+
+	/** Measure the memory held by each subsystem (see AccountMemory) and give
+	  * it to the perf counters, which print it with the stage timers. Must be
+	  * called from the thread which processes raw events, or once the
+	  * pipeline is stopped.
+	  * \return True if the memory of all subsystems is over the budget.
+	  */
+	bool UpdateMemory();
+
 	/// Toggle debug mode on / off.
 	bool SetDebugMode(bool state_=true){ return (debug_mode = state_); }
 	
+	/** Enable or disable recycling of XiaData objects. When enabled, events are
+	  * allocated in slabs which are owned by the Unpacker and are returned to
+	  * the pool (along with their trace capacity) instead of being deleted.
+	  * Derived classes which take ownership of events from the rawEvent must
+	  * hand them back through ReleaseEvent() rather than deleting them.
+	  * \param[in]  state_ Set to true to enable the event pool.
+	  * \return The new state of the pool mode flag.
+	  */
+	bool SetPoolMode(bool state_=true);
+
+	/** Enable or disable trace view mode. When enabled, ReadBuffer does not copy
+	  * trace samples into XiaData::adcTrace. Instead, each XiaData points at its
+	  * samples inside of the spill buffer and the trace is only converted when
+	  * XiaData::getTrace() is called. The spill buffer is guaranteed to be valid
+	  * until ProcessRawEvent returns, so events must not hold onto a trace view
+	  * past that point.
+	  * \param[in]  state_ Set to true to enable trace view mode.
+	  * \return The new state of the trace view mode flag.
+	  */
+	bool SetTraceViewMode(bool state_=true){ return (trace_view_mode = state_); }
+
+	/** Enable or disable skipping of trace payloads. When enabled, ReadBuffer
+	  * jumps over the trace samples of each event without reading them, so the
+	  * XiaData objects contain only header information (energy, times, QDCs).
+	  * This takes precedence over trace view mode.
+	  * \param[in]  state_ Set to true to skip all traces.
+	  * \return The new state of the skip traces flag.
+	  */
+	bool SetSkipTraces(bool state_=true){ return (skip_traces = state_); }
+
+	/** Enable or disable stream mode. When enabled, raw events are built across
+	  * spill boundaries. Events at the end of a spill whose event window may
+	  * still contain hits from the next spill are held over (with their traces
+	  * converted) and built once the window is closed. At most MAX_CARRY_WIDTHS
+	  * event widths of data are held over. FlushEvents must be called once the
+	  * end of the data is reached.
+	  * \param[in]  state_ Set to true to enable stream mode.
+	  * \return The new state of the stream mode flag.
+	  */
+	bool SetStreamMode(bool state_=true){ return (stream_mode = state_); }
+
+	/** Limit the stream horizon when the spills of several input streams are
+	  * merged. Raw events are then only built before the time up to which
+	  * every other stream has already delivered its hits. The amount of data
+	  * held over is bounded by always reading the stream which is furthest
+	  * behind next.
+	  * \param[in]  time_ The input horizon in pixie clock ticks, or the largest double for no limit.
+	  * \return Nothing.
+	  */
+	void SetInputHorizon(const double &time_){ inputHorizon = time_; }
+
+	/** Drop the hits of some channels right after their header is decoded,
+	  * before an XiaData is taken for them or their trace is read. A hit is
+	  * dropped if its energy is below the threshold of its channel. Dropped
+	  * hits are not counted in the channel counts. Must not be changed while
+	  * a spill is being read.
+	  * \param[in]  thresholds_ The minimum raw energy of each channel, indexed by 16*module+channel with 100 times the crate added to the module. A threshold of HIT_DROP_ALL drops every hit of a channel.
+	  * \return Nothing.
+	  */
+	void SetHitFilter(const std::vector<unsigned int> &thresholds_);
+
+	/** Set the width of the raw event window for each channel. A raw event
+	  * still opens at the earliest hit which has not been built, but each hit
+	  * is only added to it if it is within the width of its own channel. Later
+	  * hits of channels with a narrower window start the next raw event, so
+	  * slow detectors may be given a wide window without adding unrelated hits
+	  * of fast ones. Not used in trigger mode. Must not be changed while a
+	  * spill is being read.
+	  * \param[in]  widths_ The window width of each channel in pixie clock ticks, indexed by 16*module+channel with 100 times the crate added to the module. Channels with a width of 0 use the event width.
+	  * \return Nothing.
+	  */
+	void SetChannelWidths(const std::vector<unsigned int> &widths_);
+
+	/** Only build raw events around the hits of trigger channels. The window
+	  * of a trigger opens a number of clock ticks before it and closes a
+	  * number of ticks after it, and may differ from channel to channel. The
+	  * hits inside the window form the raw event, including any further
+	  * triggers, and hits which are not in the window of any trigger are
+	  * released without being built. The event width is not used in this
+	  * mode. An empty list of windows returns to the normal event building.
+	  * Must not be changed while a spill is being read.
+	  * \param[in]  windows_ The (before, after) window of each channel in pixie clock ticks, indexed by 16*module+channel with 100 times the crate added to the module. Channels whose window is (0, 0) are not triggers.
+	  * \return Nothing.
+	  */
+	void SetTriggerWindows(const std::vector<std::pair<unsigned int, unsigned int> > &windows_);
+
+	/// Return the time of the latest hit in the last spill, or zero if it had no hits (in pixie clock ticks, stream mode only).
+	double GetSpillEndTime(){ return spillEndTime; }
+
+	/** Set the number of the next spill passed to ReadSpill. Together with
+	  * the position of a hit in its spill it identifies the hit (XiaData::spillIndex
+	  * and XiaData::hitIndex), even when other spills are skipped.
+	  * \param[in]  num_ The number of the spill, counted from the start of the input.
+	  * \return Nothing.
+	  */
+	void SetSpillNumber(const unsigned int &num_){ spillNumber = num_; }
+
+	/** Set the number of raw events built so far and the time of the first
+	  * event, when a scan is resumed from a checkpoint, so that times are
+	  * still given with respect to the first event of the input.
+	  * \param[in]  numRawEvt_ The number of raw events built before the checkpoint.
+	  * \param[in]  firstTime_ The time of the first event (in clock ticks).
+	  * \return Nothing.
+	  */
+	void SetEventCount(const unsigned int &numRawEvt_, const double &firstTime_){ numRawEvt = numRawEvt_; firstTime = firstTime_; }
+
+	/** Enable or disable the columnar hit table. When enabled, BuildRawEvent
+	  * also fills rawHits with the time ordered hits of the raw event, so that
+	  * derived classes may sort and window the hits using contiguous columns
+	  * rather than walking the rawEvent deque.
+	  * \param[in]  state_ Set to true to enable the hit table.
+	  * \return The new state of the hit table mode flag.
+	  */
+	bool SetHitTableMode(bool state_=true){ return (hit_table_mode = state_); }
+
+	/** Set the number of threads used to decode the module buffers of a spill.
+	  * With more than one thread, ReadSpill first locates all of the module
+	  * buffers in the spill, decodes them in parallel, and then adds the
+	  * decoded events to the event list in the order of the buffers.
+	  * \param[in]  threads_ The number of decode threads. Zero is treated as one.
+	  * \return The number of decode threads.
+	  */
+	unsigned int SetDecodeThreads(unsigned int threads_){ return (decode_threads = (threads_ > 0 ? threads_ : 1)); }
+
+	/** Set the number of raw events which may be queued for the processing
+	  * thread. With a non-zero depth, ReadSpill decodes and builds raw events
+	  * and hands them off to a separate thread which calls RawStats and
+	  * ProcessRawEvent on them, in order. ReadSpill only waits when the queue
+	  * is full. In trace view mode ReadSpill also waits for the queue to drain
+	  * before returning, since the traces point into the spill buffer. Derived
+	  * classes must not use the event list from ProcessRawEvent. Must be set
+	  * before the first spill is read.
+	  * \param[in]  depth_ The maximum number of queued raw events, 0 to process them on the reading thread.
+	  * \return The pipeline depth.
+	  */
+	unsigned int SetPipelineDepth(unsigned int depth_){ return (pipeline_depth = depth_); }
+
 	/// Set the width of events in pixie16 clock ticks.
 	double SetEventWidth(double width_){ return (eventWidth = width_); }
 	
 	/// Set the address of the scan interface used for file operations.
 	ScanInterface *SetInterface(ScanInterface *interface_){ return (interface = interface_); }
+
+	/** Record every raw event to a .rev file as it is built, so that later scans may
+	  * replay the raw events without unpacking and building them again (see ::ReplayRawEvent).
+	  * \param[in]  recorder_ The open raw event file to write to, NULL to stop recording.
+	  * \return The recorder.
+	  */
+	RawEventWriter *SetEventRecorder(RawEventWriter *recorder_){ return (eventRecorder = recorder_); }
+
+	/** Process the next raw event of a .rev file written by an earlier scan. The
+	  * hits are handed to ProcessRawEvent as if the raw event had just been built
+	  * from a spill, so neither the unpacking nor the event building is repeated.
+	  * \param[in]  reader_ The open raw event file to read from.
+	  * \return False at the end of the file or if the raw event could not be read.
+	  */
+	bool ReplayRawEvent(RawEventReader &reader_);
 	
 	/** ReadSpill is responsible for constructing a list of pixie16 events from
 	  * a raw data spill. This method performs sanity checks on the spill and
-	  * calls ReadBuffer in order to construct the event list.
+	  * calls ReadBuffer in order to construct the event list. Derived classes
+	  * which do not build raw events may read the spill themselves.
 	  * \param[in]  data       Pointer to an array of unsigned ints containing the spill data.
 	  * \param[in]  nWords     The number of words in the array.
 	  * \param[in]  is_verbose Toggle the verbosity flag on/off.
 	  * \return True if the spill was read successfully and false otherwise.
 	  */	
-	bool ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose=true);
+	virtual bool ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose=true);
+
+	/** Return true if a whole spill may be skipped without reading it. Only
+	  * called when the time range of the spill is known from a spill index.
+	  * \param[in]  start_ The earliest event time in the spill (in clock ticks).
+	  * \param[in]  stop_  The earliest event time in the following spill (in clock ticks).
+	  * \return False by default.
+	  */
+	virtual bool SkipSpill(const unsigned long long &start_, const unsigned long long &stop_){ return false; }
 	
+	/** Build and process all events which are being held over for the next
+	  * spill. This should be called when there is no more data to read (e.g. at
+	  * the end of a file) when stream mode is enabled. Also waits for all raw
+	  * events queued for the processing thread and stops it.
+	  * \return Nothing.
+	  */
+	void FlushEvents();
+
+	/** Wait for the processing thread to finish all queued raw events and stop
+	  * it. Does nothing if the pipeline is not running. This must be called
+	  * before a derived class is destroyed (FlushEvents also calls it).
+	  * \return Nothing.
+	  */
+	void StopPipeline();
+
+	/** Return an event to the Unpacker. If pool mode is enabled the event is
+	  * cleared and placed back into the pool, otherwise it is deleted.
+	  * \param[in]  event_ Pointer to an event obtained from the rawEvent.
+	  * \return Nothing.
+	  */
+	void ReleaseEvent(XiaData *event_);
+
 	/** Write all recorded channel counts to a file.
 	  * \return Nothing.
 	  */
@@ -102,12 +366,24 @@ class Unpacker{
 	
 	bool debug_mode; /// True if debug mode is set.
 	bool running; /// True if the scan is running.
+	bool pool_mode; /// True if XiaData objects are recycled through the event pool.
+	bool trace_view_mode; /// True if traces are left in the spill buffer until requested.
+	bool skip_traces; /// True if trace payloads are skipped without being read.
+	bool stream_mode; /// True if raw events are built across spill boundaries.
+	bool hit_table_mode; /// True if raw events are also stored in the hit table.
+	unsigned int decode_threads; /// Number of threads used to decode module buffers.
+	unsigned int pipeline_depth; /// Maximum number of raw events queued for the processing thread.
 
 	std::vector<std::deque<XiaData*> > eventList; /// The list of all events in a spill.
 	std::deque<XiaData*> rawEvent; /// The list of all events in the event window.
+	HitTable rawHits; /// Columnar copy of the rawEvent (only filled in hit table mode).
 
 	ScanInterface *interface; /// Pointer to an object derived from ScanInterface.
 
+	RawEventWriter *eventRecorder; /// The file every built raw event is recorded to, or NULL.
+
+	PerfCounters perf; /// Timers of the stages of the scan. Derived classes may add their own stages.
+
 	/** Process all events in the event list.
 	  * \param[in]  addr_ Pointer to a ScanInterface object. Unused by default.
 	  * \return Nothing.
@@ -120,6 +396,28 @@ class Unpacker{
 	  * \return Nothing.
 	  */
 	virtual void RawStats(XiaData *event_, ScanInterface *addr_=NULL){  }
+
+	/** Add the memory held by each subsystem of the scan to a list. Derived
+	  * classes add their own subsystems (histograms, correlators, ...) to
+	  * those of the Unpacker. Called by UpdateMemory.
+	  * \param[out] entries_ The memory of each subsystem.
+	  * \return Nothing.
+	  */
+	virtual void AccountMemory(std::vector<PerfCounters::MemoryEntry> &entries_);
+
+	/** Return the index of the event list which holds the events of a module.
+	  * The modules of each crate follow those of the previous crate, so that the
+	  * event list stays compact for multi-crate systems.
+	  * \param[in]  event_ Pointer to the event.
+	  * \return The event list index of the event's module.
+	  */
+	static unsigned int GetModuleIndex(const XiaData *event_);
+
+	/** Get a new, cleared XiaData. If pool mode is enabled the event is taken
+	  * from the pool, otherwise it is allocated on the heap.
+	  * \return Pointer to a cleared XiaData.
+	  */
+	XiaData *GetNewEvent();
 	
 	/** Called form ReadSpill. Scan the current spill and construct a list of
 	  * events which fired by obtaining the module, channel, trace, etc. of the
@@ -130,13 +428,53 @@ class Unpacker{
 	  * \return The number of XiaDatas read from the buffer.
 	  */	
 	int ReadBuffer(unsigned int *buf, unsigned long &bufLen);
+
+	/** Decode a single module buffer into a list of XiaData without touching the
+	  * event list. This method may be called from several threads at once as long
+	  * as each thread passes its own event cache.
+	  * \param[in]  buf    Pointer to an array of unsigned ints containing raw buffer data.
+	  * \param[out] events The list of XiaDatas decoded from the buffer.
+	  * \param[in]  cache  Per-thread cache of events to use instead of GetNewEvent(). May be NULL.
+	  * \return The number of XiaDatas read from the buffer.
+	  */
+	int DecodeBuffer(unsigned int *buf, std::vector<XiaData*> &events, std::vector<XiaData*> *cache=NULL);
+
+	/** Fill XiaDatas from the located and decoded headers of a module buffer.
+	  * HEADER_LEN fixes the header layout at compile time (4 words, 8 with
+	  * energy sums, 12 with QDCs, or 16 with both) so that the loop has no
+	  * checks on the header length. A HEADER_LEN of 0 reads the length of
+	  * each event instead, for buffers which mix layouts.
+	  * \param[in]  headers The located and decoded headers of the buffer.
+	  * \param[in]  modNum  The module number of the buffer.
+	  * \param[out] events  The list of XiaDatas decoded from the buffer.
+	  * \param[in]  cache   Per-thread cache of events to use instead of GetNewEvent(). May be NULL.
+	  * 
+eturn The number of XiaDatas read from the buffer.
+	  */
+	template <unsigned int HEADER_LEN>
+	unsigned long DecodeEvents(const ListModeHeaders &headers, const unsigned int &modNum, std::vector<XiaData*> &events, std::vector<XiaData*> *cache);
+
+	/** Get an event from a per-thread cache, refilling it from the event pool
+	  * (while holding the pool lock) if it is empty.
+	  * \param[in]  cache The per-thread event cache.
+	  * \return Pointer to a cleared XiaData.
+	  */
+	XiaData *GetCachedEvent(std::vector<XiaData*> &cache);
+
+	/** Return an unused event to a per-thread cache or, if no cache is given,
+	  * release it through ReleaseEvent().
+	  * \param[in]  event_ The event to return.
+	  * \param[in]  cache  The per-thread event cache. May be NULL.
+	  * \return Nothing.
+	  */
+	void ReleaseCachedEvent(XiaData *event_, std::vector<XiaData*> *cache);
 	
   private:
 	unsigned int TOTALREAD; /// Maximum number of data words to read.
 	unsigned int maxWords; /// Maximum number of data words for revision D.
 	unsigned int numRawEvt; /// The total count of raw events read from file.
 	
-	unsigned int channel_counts[MAX_PIXIE_MOD+1][MAX_PIXIE_CHAN+1]; /// Counters for each channel in each module.
+	ChannelCounters channelCounts; /// Counters for each channel in each module of each crate.
 	
 	double firstTime; /// The first recorded event time.
 	double eventStartTime; /// The start time of the current raw event.
@@ -144,16 +482,217 @@ class Unpacker{
 	double realStartTime; /// The time of the first xia event in the raw event.
 	double realStopTime; /// The time of the last xia event in the raw event.
 
+	std::vector<XiaData*> decodedEvents; /// Scratch list of events decoded by ReadBuffer.
+	std::vector<unsigned int*> pendingBuffers; /// Module buffers waiting for the decode threads.
+	std::vector<std::vector<XiaData*> > decodedBuffers; /// Events decoded from each pending buffer.
+	std::vector<int> decodedRetvals; /// Return value of DecodeBuffer for each pending buffer.
+
+	std::mutex poolMutex; /// Lock for the event pool when decode threads are running.
+
+	std::vector<XiaData*> eventPool; /// Free list of recycled XiaData objects.
+	std::vector<XiaData*> eventSlabs; /// Blocks of XiaData objects allocated by the pool.
+
+	std::atomic<unsigned long long> poolBytes; /// Bytes held by the event pool and the traces of its events, measured at the start of each spill.
+	unsigned long long memoryBudget; /// The memory budget of the scan in bytes, zero if there is none.
+	bool overBudget; /// True if the last call of UpdateMemory found the scan over its budget.
+
+	/** Measure the bytes held by the event pool, including the trace capacity
+	  * kept by its events. Called by the reading thread, which owns the pool.
+	  * \return Nothing.
+	  */
+	void MeasurePool();
+
+	/** Push a list of decoded events into the event list. Events which can not be
+	  * added are released.
+	  * \param[in]  events_ The list of XiaDatas to add.
+	  * \return Nothing.
+	  */
+	void AddEvents(const std::vector<XiaData*> &events_);
+
+	/** Decode module buffers from the list of pending buffers until none are left.
+	  * \param[in]  next_ The index of the next buffer which has not been picked up by a thread.
+	  * \return Nothing.
+	  */
+	void DecodeWorker(std::atomic<size_t> *next_);
+
+	/** Decode all pending module buffers using the decode threads and add the
+	  * results to the event list in the order the buffers appeared in the spill.
+	  * \param[out] numEvents The total number of events decoded.
+	  * \return The return value of the first failed buffer or of the last buffer.
+	  */
+	int DecodePendingBuffers(unsigned long &numEvents);
+
+	/** Allocate a new slab of XiaData objects and add them to the pool.
+	  * \return Nothing.
+	  */
+	void GrowPool();
+
+	/** Delete all slabs allocated by the event pool. WARNING! Any events which
+	  * are still in use are deleted as well.
+	  * \return Nothing.
+	  */
+	void ClearPool();
+
+	/** Release all events in a deque through ReleaseEvent() and empty it.
+	  * \param[in]  list The deque of events to clear.
+	  * \return Nothing.
+	  */
+	void ClearDeque(std::deque<XiaData*> &list);
+
+	/// A raw event which has been built but not yet processed.
+	struct BuiltEvent{
+		std::deque<XiaData*> events; /// The events in the raw event window.
+		double startTime; /// The start time of the raw event window.
+		double realStartTime; /// The time of the first xia event in the raw event.
+		double realStopTime; /// The time of the last xia event in the raw event.
+
+		BuiltEvent() : startTime(0), realStartTime(0), realStopTime(0) { }
+	};
+
+	BuiltEvent buildEvent; /// The raw event being built by BuildRawEvent.
+
+	std::deque<BuiltEvent> pipelineQueue; /// Raw events waiting for the processing thread.
+	std::mutex pipelineMutex; /// Lock for the pipeline queue.
+	std::condition_variable pipelineReady; /// Signalled when a raw event is queued or the pipeline is stopped.
+	std::condition_variable pipelineSpace; /// Signalled when the processing thread takes or finishes a raw event.
+	std::thread pipelineThread; /// Thread which processes the queued raw events.
+	bool pipelineRunning; /// True while the processing thread is running.
+	bool pipelineStop; /// Set to true to stop the processing thread once the queue is empty.
+	bool pipelineBusy; /// True while the processing thread is processing a raw event.
+
+	/** Make a built raw event the current rawEvent, call RawStats for each of
+	  * its events and fill the hit table.
+	  * \param[in]  event_ The built raw event. Its list of events is left empty.
+	  * \return Nothing.
+	  */
+	void StartRawEvent(BuiltEvent &event_);
+
+	/** Process the raw event which was just built, either right away or, with a
+	  * non-zero pipeline depth, by queueing it for the processing thread.
+	  * \return Nothing.
+	  */
+	void DispatchRawEvent();
+
+	/** Process queued raw events until the pipeline is stopped. This is the body
+	  * of the processing thread.
+	  * \return Nothing.
+	  */
+	void PipelineWorker();
+
+	/** Wait until the processing thread has finished every queued raw event.
+	  * \return Nothing.
+	  */
+	void WaitForPipeline();
+
+	PerfCounters::clock::time_point lastSpillEnd; /// The time at which the last call of ReadSpill returned.
+
+	double streamHorizon; /// In stream mode, only raw events which close before this time are built.
+
+	double inputHorizon; /// Time up to which every other merged input stream has delivered its hits.
+
+	double spillEndTime; /// Time of the latest hit in the last spill, zero if it had none.
+
+	unsigned int spillNumber; /// The number of the spill being read.
+	const unsigned int *spillStart; /// The first word of the spill being read.
+
+	std::vector<unsigned int> hitFilterMask; /// Bit n is set if channel n of a module has a threshold, indexed by module.
+	std::vector<unsigned int> hitThresholds; /// The minimum raw energy of each channel, indexed by 16*module+channel.
+	std::atomic<unsigned long long> numDroppedHits; /// The number of hits dropped by the hit filter.
+
+	std::vector<std::deque<XiaData*> > carryList; /// Events held over from the previous spill in stream mode.
+
+	/** Get the time before which every raw event window is closed. This is the
+	  * earliest of the last hit times of all modules which have data in the
+	  * current spill, limited to MAX_CARRY_WIDTHS event widths before the latest.
+	  * \return The stream horizon in pixie clock ticks.
+	  */
+	double GetStreamHorizon();
+
+	/** Move all events held over from the previous spill to the front of the event list.
+	  * \return Nothing.
+	  */
+	void MergeCarryList();
+
+	/** Move all events which were not built into raw events from the event list
+	  * to the carry list, converting any trace views.
+	  * \return Nothing.
+	  */
+	void FillCarryList();
+
+	std::vector<std::pair<unsigned long long, size_t> > mergeHeap; /// Min-heap of the earliest (timeStamp, module) from each module in the event list.
+
+	std::vector<std::pair<unsigned int, unsigned int> > triggerWindows; /// The (before, after) window of each trigger channel, indexed by 16*module+channel.
+	unsigned int maxTriggerBefore; /// The longest time before any trigger which is inside its window.
+	unsigned int maxTriggerAfter; /// The longest time after any trigger which is inside its window.
+	std::deque<XiaData*> pendingHits; /// Time ordered hits taken from the merge heap which have not been built yet.
+	std::deque<XiaData*> deferredHits; /// Hits outside the width of their channel, scratch for BuildRawEvent.
+
+	std::vector<unsigned int> channelWidths; /// The window width of each channel, indexed by 16*module+channel.
+	unsigned int maxChannelWidth; /// The widest of the channel widths.
+	unsigned long long numUntriggered; /// The number of hits which were not inside the window of any trigger.
+
+	std::vector<std::pair<unsigned long long, XiaData*> > sortBuffer; /// Keyed events for the radix sort.
+	std::vector<std::pair<unsigned long long, XiaData*> > sortScratch; /// Scratch space for the radix sort.
+
 	/** Scan the event list and sort it by timestamp.
 	  * \return Nothing.
 	  */
 	void TimeSort();
 
+	/** Sort the events of a single module by timestamp. Module streams are
+	  * almost always time ordered already, so out of order events are first
+	  * moved into place with an insertion sort. If that turns out to require too
+	  * many moves, the module is sorted with RadixSort() instead.
+	  * \param[in]  module_ The list of events from one module.
+	  * \return Nothing.
+	  */
+	void SortModule(std::deque<XiaData*> &module_);
+
+	/** Sort the events of a single module by timestamp using a stable LSD
+	  * radix sort over the bytes of the timestamp.
+	  * \param[in]  module_ The list of events from one module.
+	  * \return Nothing.
+	  */
+	void RadixSort(std::deque<XiaData*> &module_);
+
+	/** Build the k-way merge heap from the front of each module in the event
+	  * list. The event list must be time sorted by module.
+	  * \return Nothing.
+	  */
+	void BuildMergeHeap();
+
+	/** Take the earliest event from the merge heap and put the next event of
+	  * its module into the heap. Events with a non-physical module or
+	  * channel are released.
+	  * \return The earliest event, or NULL if it was released.
+	  */
+	XiaData *PopFirstEvent();
+
+	/** Take the earliest event which has not been built, either from the hits
+	  * left over from the window of the previous raw event or from the merge heap.
+	  * \return The earliest event, or NULL if it was released.
+	  */
+	XiaData *TakeFirstEvent();
+
+	/** Add an event to the raw event being built and update its real start and stop times.
+	  * \param[in]  event_ The event to add.
+	  * \return Nothing.
+	  */
+	void AddToBuildEvent(XiaData *event_);
+
 	/** Scan the time sorted event list and package the events into a raw
-	  * event with a size governed by the event width.
+	  * event with a size governed by the event width, or around the next
+	  * trigger in trigger mode.
 	  * \return True if the event list is not empty and false otherwise.
 	  */
 	bool BuildRawEvent();
+
+	/** Scan the time sorted event list for the next trigger and package the
+	  * events inside of its window into a raw event. Hits which can not be
+	  * inside the window of any later trigger are released.
+	  * \return True if a raw event was built and false otherwise.
+	  */
+	bool BuildTriggeredEvent();
 	
 	/** Push an event into the event list.
 	  * \param[in]  event_ The XiaData to push onto the back of the event list.
@@ -173,7 +712,7 @@ class Unpacker{
 	  */	
 	void ClearRawEvent();
 	
-	/** Get the minimum channel time from the event list.
+	/** Get the minimum channel time from the merge heap and the hits left over from the previous window.
 	  * \param[out] time The minimum time from the event list in system clock ticks.
 	  * \return True if the event list is not empty and false otherwise.
 	  */
@@ -7,6 +7,8 @@
 #include <vector>
 #include <stdlib.h>
 
+#include "CompactHit.hpp"
+
 /*! \brief A pixie16 channel event
  *
  * All data is grouped together into channels.  For each pixie16 channel that
@@ -20,14 +22,29 @@ class XiaData{
 public:
     double energy; /// Raw pixie energy.
     double time; /// Raw pixie event time. Measured in filter clock ticks (8E-9 Hz for RevF).
+    unsigned long long timeStamp; /// Fixed point event time. The 48-bit event time in clock ticks followed by cfdFractionBits of CFD time.
     
     std::vector<int> adcTrace; /// ADC trace capture.
     
+    const unsigned short *traceView; /// Trace samples in the raw spill buffer (only valid until Unpacker::ProcessRawEvent returns).
+    size_t traceViewLength; /// Number of samples pointed to by traceView.
+    
+    const unsigned int *headerView; /// Header words in the raw spill buffer (only valid until Unpacker::ProcessRawEvent returns).
+    unsigned int headerViewLength; /// Number of header words pointed to by headerView.
+    unsigned int headerLength; /// Number of words in the list-mode header of the event.
+    
+    unsigned int spillIndex; /// Number of the spill the event was read from, counted from the start of the input.
+    unsigned int hitIndex; /// Position of the event header in its spill (in words).
+    
     static const int numQdcs = 8; /// Number of QDCs onboard.
-    unsigned int qdcValue[numQdcs]; /// QDCs from onboard.
+    static const int numEnergySums = 4; /// Number of onboard energy sums (trailing, leading, gap, baseline).
+    static const unsigned int cfdFractionBits = 16; /// Number of fractional (CFD) bits in the timeStamp.
+    unsigned int qdcValue[numQdcs]; /// QDCs from onboard. Only filled once the header view is copied, use getQdcValue().
+    unsigned int energySums[numEnergySums]; /// Energy sums from onboard. Only filled once the header view is copied, use getEnergySum().
     
     unsigned int slotNum; ///Slot number
-    unsigned int modNum; /// Module number.
+    unsigned int modNum; /// Module number (plus 100 times the crate number).
+    unsigned int crateNum; /// Crate number.
     unsigned int chanNum; /// Channel number.
     unsigned int trigTime; /// The channel trigger time, trigger time and the lower 32 bits of the event time are not necessarily the same but could be separated by a constant value.
     unsigned int cfdTime; /// CFD trigger time in units of 1/256 pixie clock ticks.
@@ -62,14 +79,66 @@ public:
     /// Push back the trace vector with a value.
     void push_back(const int &input_); 
 
+    /// Point the trace at samples in a spill buffer without copying them.
+    void setTraceView(const unsigned short *data_, const size_t &size_);
+
+    /// Return true if the trace is a view into the spill buffer which has not yet been converted.
+    bool hasTraceView() const { return (traceView != NULL); }
+
+    /// Return the number of trace samples, whether they are stored or viewed.
+    size_t getTraceLength() const { return (traceView ? traceViewLength : adcTrace.size()); }
+
+    /// Return the trace, converting it from the spill buffer on the first call if needed.
+    std::vector<int> &getTrace();
+
+    /// Point the onboard QDCs and energy sums at the header words in a spill buffer without decoding them.
+    void setHeaderView(const unsigned int *data_, const unsigned int &length_){ headerView = data_; headerViewLength = length_; }
+
+    /// Return true if the onboard QDCs and energy sums are a view into the spill buffer which has not yet been copied.
+    bool hasHeaderView() const { return (headerView != NULL); }
+
+    /// Copy the onboard QDCs and energy sums out of the spill buffer so that they outlive it.
+    void copyHeaderView();
+
+    /// Set the fixed point timeStamp from the 48-bit event time and the CFD time.
+    void setTimeStamp(const unsigned int &hi_, const unsigned int &lo_, const unsigned int &cfd_){ timeStamp = ((((unsigned long long)hi_ << 32) | lo_) << cfdFractionBits) | (cfd_ & 0xFFFF); }
+
+    /// Return the integer part of the timeStamp in clock ticks.
+    unsigned long long getTimeTicks() const { return (timeStamp >> cfdFractionBits); }
+
+    /// Return true if the fixed point timeStamp of rhs is later than that of lhs.
+    static bool compareTimeStamp(XiaData *lhs, XiaData *rhs){ return (lhs->timeStamp < rhs->timeStamp); }
+
     /// Return true if the time of arrival for rhs is later than that of lhs.
     static bool compareTime(XiaData *lhs, XiaData *rhs){ return (lhs->time < rhs->time); }
     
     /// Return true if lhs has a lower event id (mod * chan) than rhs.
     static bool compareChannel(XiaData *lhs, XiaData *rhs){ return ((lhs->modNum*lhs->chanNum) < (rhs->modNum*rhs->chanNum)); }
     
-    /// Return one of the onboard qdc values.
-    unsigned int getQdcValue(int id){ return (id < 0 || id >= numQdcs ? -1 : qdcValue[id]); }
+    /// Return one of the onboard qdc values, which are the last eight words of 12 and 16 word headers.
+    unsigned int getQdcValue(int id) const {
+        if(id < 0 || id >= numQdcs){ return -1; }
+        if(headerView){ return (headerViewLength >= 12 ? headerView[headerViewLength - numQdcs + id] : 0); }
+        return qdcValue[id];
+    }
+
+    /// Return one of the onboard energy sums, which follow the first four words of 8 and 16 word headers.
+    unsigned int getEnergySum(int id) const {
+        if(id < 0 || id >= numEnergySums){ return -1; }
+        if(headerView){ return (headerViewLength == 8 || headerViewLength == 16 ? headerView[4 + id] : 0); }
+        return energySums[id];
+    }
+    
+    /** Fill a CompactHit from the hit. Its trace is not copied, the caller keeps
+      * the samples and sets traceOffset. The eventTime is not kept.
+      */
+    void pack(CompactHit &hit_) const;
+
+    /** Fill every field of the hit from a CompactHit, deriving the time, trigger
+      * time and event time words from its timeStamp. The trace, onboard QDCs and
+      * energy sums are left for the caller to fill.
+      */
+    void unpack(const CompactHit &hit_);
     
     /// Clear all variables.
     void clear();
@@ -0,0 +1,79 @@
+/** \file ChannelCounters.cpp
+ * \brief Per (crate, module, channel) event counters for the Unpacker.
+ */
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ChannelCounters.hpp"
+
+/** Constructor.
+  * \param[in]  modsPerCrate_ The maximum number of modules in one crate.
+  * \param[in]  chansPerMod_  The number of channels in one module.
+  */
+ChannelCounters::ChannelCounters(const unsigned int &modsPerCrate_, const unsigned int &chansPerMod_) :
+	modsPerCrate(modsPerCrate_),
+	chansPerMod(chansPerMod_),
+	numCrates(0),
+	counts(NULL)
+{
+	const size_t perLine = COUNTER_ALIGNMENT / sizeof(unsigned int);
+	rowStride = ((chansPerMod + perLine - 1) / perLine) * perLine;
+	Resize(1);
+}
+
+/// Destructor.
+ChannelCounters::~ChannelCounters(){
+	free(counts);
+}
+
+/// Return the counter of a channel, or zero if it has never been incremented.
+unsigned int ChannelCounters::Get(const unsigned int &crate_, const unsigned int &mod_, const unsigned int &chan_) const {
+	if(crate_ >= numCrates || mod_ >= modsPerCrate || chan_ >= chansPerMod){ return 0; }
+	return counts[(crate_*modsPerCrate + mod_)*rowStride + chan_];
+}
+
+/** Write all counters to a stream, one "module\tchannel\tcount" line per
+  * channel. Modules in crates other than zero are written as
+  * module + 100 * crate, following the convention of XiaData::modNum.
+  * \param[in]  out_ The stream to write to.
+  * \return Nothing.
+  */
+void ChannelCounters::Write(std::ostream &out_) const {
+	for(unsigned int crate = 0; crate < numCrates; crate++){
+		for(unsigned int mod = 0; mod < modsPerCrate; mod++){
+			for(unsigned int chan = 0; chan < chansPerMod; chan++){
+				out_ << mod + 100 * crate << "\t" << chan << "\t" << Get(crate, mod, chan) << std::endl;
+			}
+		}
+	}
+}
+
+/// Set all counters to zero.
+void ChannelCounters::Zero(){
+	memset(counts, 0, numCrates*modsPerCrate*rowStride*sizeof(unsigned int));
+}
+
+/** Reallocate the counters for a new number of crates, keeping all existing counts.
+  * \param[in]  numCrates_ The new number of crates.
+  * \return Nothing.
+  */
+void ChannelCounters::Resize(const unsigned int &numCrates_){
+	size_t oldSize = numCrates*modsPerCrate*rowStride;
+	size_t newSize = numCrates_*modsPerCrate*rowStride;
+
+	void *storage = NULL;
+	if(posix_memalign(&storage, COUNTER_ALIGNMENT, newSize*sizeof(unsigned int)) != 0)
+		throw std::bad_alloc();
+
+	unsigned int *newCounts = (unsigned int *)storage;
+	memset(newCounts, 0, newSize*sizeof(unsigned int));
+	if(counts){
+		memcpy(newCounts, counts, oldSize*sizeof(unsigned int));
+		free(counts);
+	}
+
+	counts = newCounts;
+	numCrates = numCrates_;
+}
@@ -21,7 +21,7 @@ ChannelData::ChannelData(XiaData *event_){
 	yvals = NULL;
 	Clear();
 	event = event_;
-	size = event->adcTrace.size();
+	size = event->getTrace().size();
 	if(size != 0){
 		xvals = new float[size];
 		yvals = new float[size];
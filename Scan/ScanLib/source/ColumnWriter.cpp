@@ -0,0 +1,182 @@
+/** \file ColumnWriter.cpp
+ * \brief A class to write event data into a chunked columnar file
+ */
+#include <iostream>
+#include <cstring>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ColumnWriter.hpp"
+
+using namespace std;
+
+ColumnWriter::ColumnWriter(const std::string &fileName,
+                           const unsigned int &chunkSize, const int &level,
+                           const bool &background) :
+    pendingRows_(0), pending_(false), stop_(false) {
+    chunkSize_ = chunkSize > 0 ? chunkSize : 1;
+#ifdef USE_ZLIB
+    level_ = level;
+#else
+    level_ = 0;
+#endif
+    rows_ = 0;
+    entries_ = 0;
+
+    file_.open(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!file_.is_open()) {
+        cout << "ColumnWriter: ERROR! Failed to open the output file '"
+             << fileName << "'!\n";
+        return;
+    }
+    file_.write("PXCOLS01", 8);
+    if (background)
+        thread_ = thread(&ColumnWriter::WriteLoop, this);
+}
+
+ColumnWriter::~ColumnWriter() {
+    Close();
+}
+
+bool ColumnWriter::Add(const std::string &name, const ColumnType &type,
+                       const void *value, const unsigned int &size,
+                       const unsigned int &width) {
+    if (entries_ != 0) {
+        cout << "ColumnWriter: ERROR! The column '" << name
+             << "' was added after the first row was filled!\n";
+        return(false);
+    }
+
+    Column col;
+    col.name = name;
+    col.type = type;
+    col.value = static_cast<const char*>(value);
+    col.rowBytes = size * width;
+    col.width = width;
+    col.buffer.reserve((size_t)col.rowBytes * chunkSize_);
+    columns_.push_back(col);
+    return(true);
+}
+
+void ColumnWriter::Fill(void) {
+    for (vector<Column>::iterator it = columns_.begin();
+         it != columns_.end(); it++) {
+        size_t pos = it->buffer.size();
+        it->buffer.resize(pos + it->rowBytes);
+        memcpy(&it->buffer[pos], it->value, it->rowBytes);
+    }
+    rows_++;
+    entries_++;
+    if (rows_ >= chunkSize_)
+        Flush();
+}
+
+void ColumnWriter::Flush(void) {
+    if (rows_ == 0 || !file_.is_open())
+        return;
+
+    if (!thread_.joinable()) {
+        vector<vector<char> > buffers(columns_.size());
+        for (size_t i = 0; i < columns_.size(); i++)
+            buffers[i].swap(columns_[i].buffer);
+        WriteChunk(rows_, buffers);
+        for (size_t i = 0; i < columns_.size(); i++)
+            columns_[i].buffer.swap(buffers[i]);
+        rows_ = 0;
+        return;
+    }
+
+    unique_lock<mutex> lock(mutex_);
+    changed_.wait(lock, [this]{ return !pending_; });
+    buffers_.resize(columns_.size());
+    for (size_t i = 0; i < columns_.size(); i++)
+        buffers_[i].swap(columns_[i].buffer);
+    pendingRows_ = rows_;
+    pending_ = true;
+    rows_ = 0;
+    changed_.notify_all();
+}
+
+void ColumnWriter::WriteLoop(void) {
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [this]{ return pending_ || stop_; });
+        if (!pending_)
+            return;
+        //Flush waits for pending_ to be cleared, so the buffers may be
+        // written without the lock
+        lock.unlock();
+        WriteChunk(pendingRows_, buffers_);
+        lock.lock();
+        pending_ = false;
+        changed_.notify_all();
+    }
+}
+
+void ColumnWriter::WriteChunk(const uint32_t &rows,
+                              vector<vector<char> > &buffers) {
+    chunks_.push_back((uint64_t)file_.tellp());
+    file_.write("CHNK", 4);
+    Write<uint32_t>(rows);
+
+    for (vector<vector<char> >::iterator it = buffers.begin();
+         it != buffers.end(); it++) {
+        const char *data = it->data();
+        uint32_t rawSize = it->size();
+        uint32_t size = rawSize;
+        uint8_t codec = 0;
+#ifdef USE_ZLIB
+        if (level_ > 0 && rawSize > 0) {
+            uLongf zBytes = compressBound(rawSize);
+            zbuffer_.resize(zBytes);
+            if (compress2((Bytef*)zbuffer_.data(), &zBytes,
+                          (const Bytef*)data, rawSize, level_) == Z_OK &&
+                zBytes < rawSize) {
+                data = zbuffer_.data();
+                size = zBytes;
+                codec = 1;
+            }
+        }
+#endif
+        Write<uint8_t>(codec);
+        Write<uint32_t>(size);
+        Write<uint32_t>(rawSize);
+        file_.write(data, size);
+        it->clear();
+    }
+}
+
+void ColumnWriter::Close(void) {
+    if (!file_.is_open())
+        return;
+    Flush();
+    if (thread_.joinable()) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stop_ = true;
+            changed_.notify_all();
+        }
+        thread_.join();
+    }
+
+    uint64_t schema = file_.tellp();
+    file_.write("SCHM", 4);
+    Write<uint32_t>(columns_.size());
+    for (vector<Column>::const_iterator it = columns_.begin();
+         it != columns_.end(); it++) {
+        Write<uint32_t>(it->name.size());
+        file_.write(it->name.data(), it->name.size());
+        Write<uint8_t>(it->type);
+        Write<uint32_t>(it->width);
+    }
+    Write<uint64_t>(entries_);
+    Write<uint32_t>(chunks_.size());
+    for (vector<uint64_t>::const_iterator it = chunks_.begin();
+         it != chunks_.end(); it++)
+        Write<uint64_t>(*it);
+    Write<uint64_t>(schema);
+    file_.write("PXCOLEND", 8);
+    file_.close();
+}
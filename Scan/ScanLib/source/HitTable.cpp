@@ -0,0 +1,110 @@
+/** \file HitTable.cpp
+ * \brief A columnar (structure of arrays) store of pixie16 channel hits.
+ */
+#include <algorithm>
+
+#include "HitTable.hpp"
+#include "XiaData.hpp"
+
+/// Compare two rows of a table by timeStamp, used to sort the row order.
+class HitTimeCompare{
+  public:
+	HitTimeCompare(const std::vector<unsigned long long> &timeStamp_) : timeStamp(timeStamp_) { }
+
+	bool operator () (const size_t &lhs_, const size_t &rhs_) const { return (timeStamp[lhs_] < timeStamp[rhs_]); }
+
+  private:
+	const std::vector<unsigned long long> &timeStamp;
+};
+
+/** Add a hit to the end of the table. The trace is copied into the samples
+  * array, whether it is stored in the XiaData or viewed in the spill buffer.
+  * \param[in]  event_ The XiaData to add. The table does not take ownership.
+  * \return Nothing.
+  */
+void HitTable::push_back(XiaData *event_){
+	order.push_back(events.size());
+	events.push_back(event_);
+
+	time.push_back(event_->time);
+	timeStamp.push_back(event_->timeStamp);
+	cfdTime.push_back(event_->cfdTime);
+	energy.push_back(event_->energy);
+	modNum.push_back(event_->modNum);
+	chanNum.push_back(event_->chanNum);
+	flags.push_back((event_->virtualChannel ? VIRTUAL : 0) | (event_->saturatedBit ? SATURATED : 0) | (event_->pileupBit ? PILEUP : 0));
+
+	traceOffset.push_back(samples.size());
+	traceLength.push_back(event_->getTraceLength());
+	if(event_->hasTraceView())
+		samples.insert(samples.end(), event_->traceView, event_->traceView+event_->traceViewLength);
+	else
+		samples.insert(samples.end(), event_->adcTrace.begin(), event_->adcTrace.end());
+}
+
+/** Clear the table and fill it with a list of hits.
+  * \param[in]  events_ The list of XiaData to add.
+  * \return Nothing.
+  */
+void HitTable::Fill(const std::deque<XiaData*> &events_){
+	clear();
+	for(std::deque<XiaData*>::const_iterator iter = events_.begin(); iter != events_.end(); iter++){
+		push_back(*iter);
+	}
+}
+
+/** Order the rows by timeStamp. Only the row order is sorted, the columns are
+  * left untouched. Hits with equal times keep the order they were added in.
+  * \return Nothing.
+  */
+void HitTable::Sort(){
+	HitTimeCompare compare(timeStamp);
+	if(!std::is_sorted(order.begin(), order.end(), compare))
+		std::stable_sort(order.begin(), order.end(), compare);
+}
+
+/** Find the hits in the time window [start_, start_+width_]. The rows must
+  * have been time ordered by Sort().
+  * \param[in]  start_ The start of the window in pixie clock ticks.
+  * \param[in]  width_ The width of the window in pixie clock ticks.
+  * \param[out] first_ The position (in row order) of the first hit in the window.
+  * \param[out] last_  The position (in row order) one past the last hit in the window.
+  * \return The number of hits in the window.
+  */
+size_t HitTable::Window(const double &start_, const double &width_, size_t &first_, size_t &last_) const {
+	const double stop = start_ + width_;
+
+	size_t low = 0, high = order.size();
+	while(low < high){ // First row with time >= start_.
+		size_t mid = low + (high - low) / 2;
+		if(time[order[mid]] < start_) low = mid + 1;
+		else high = mid;
+	}
+	first_ = low;
+
+	high = order.size();
+	while(low < high){ // First row with time > stop.
+		size_t mid = low + (high - low) / 2;
+		if(time[order[mid]] <= stop) low = mid + 1;
+		else high = mid;
+	}
+	last_ = low;
+
+	return (last_ - first_);
+}
+
+/// Remove all hits from the table. Allocated memory is kept for reuse.
+void HitTable::clear(){
+	time.clear();
+	timeStamp.clear();
+	cfdTime.clear();
+	energy.clear();
+	modNum.clear();
+	chanNum.clear();
+	flags.clear();
+	traceOffset.clear();
+	traceLength.clear();
+	samples.clear();
+	events.clear();
+	order.clear();
+}
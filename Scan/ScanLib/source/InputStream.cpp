@@ -0,0 +1,146 @@
+/** \file InputStream.cpp
+ * \brief One of several input files whose spills are merged in time.
+ */
+#include <iostream>
+
+#include <string.h>
+
+#include "InputStream.hpp"
+
+/// Default constructor.
+InputStream::InputStream() : length(0), position(0), format(0), time(0), finished(true) { }
+
+/// Destructor. Stops the reader thread and closes the file.
+InputStream::~InputStream(){
+	Close();
+}
+
+/** Open an .ldf, .pld or .pldz file, read its header buffers and start its reader thread.
+  * \param[in]  fname_  The name of the file to open.
+  * \param[in]  depth_  The number of spills to read ahead of the scan.
+  * \param[in]  debug_  Set to true to print debug information about the buffers read.
+  * \return True if the file was opened and false otherwise.
+  */
+bool InputStream::Open(const std::string &fname_, const size_t &depth_, const bool &debug_/*=false*/){
+	Close();
+
+	size_t dot = fname_.find_last_of('.');
+	std::string extension = (dot != std::string::npos ? fname_.substr(dot+1) : "");
+	if(extension == "ldf"){ format = 0; }
+	else if(extension == "pld" || extension == "pldz"){
+		if(extension == "pldz" && !PLD_data::CompressionAvailable()){
+			std::cout << " ERROR! Unable to read compressed pld file '" << fname_ << "', zlib support was not compiled in!\n";
+			return false;
+		}
+		format = 1;
+	}
+	else{
+		std::cout << " ERROR! Invalid file format '" << extension << "' of merged input file '" << fname_ << "'\n";
+		return false;
+	}
+
+	file.open(fname_.c_str(), std::ios::binary);
+	if(!file.is_open() || !file.good()){
+		std::cout << " ERROR! Failed to open merged input file '" << fname_ << "'! Check that the path is correct.\n";
+		file.close();
+		return false;
+	}
+	file.seekg(0, file.end);
+	length = file.tellg();
+	file.seekg(0, file.beg);
+
+	dirbuff.SetDebugMode(debug_);
+	headbuff.SetDebugMode(debug_);
+	databuff.SetDebugMode(debug_);
+	pldHead.SetDebugMode(debug_);
+	pldData.SetDebugMode(debug_);
+
+	// Every poll2 ldf file starts with a DIR buffer followed by a HEAD buffer.
+	bool readOk;
+	if(format == 0){ readOk = dirbuff.Read(&file) && headbuff.Read(&file); }
+	else{ readOk = pldHead.Read(&file); }
+	if(!readOk){
+		std::cout << " ERROR! Failed to read the header of merged input file '" << fname_ << "'!\n";
+		file.close();
+		return false;
+	}
+
+	fname = fname_;
+	position = file.tellg();
+	time = 0;
+	finished = false;
+
+	databuff.Reset();
+	pldData.Reset();
+	if(format == 0){ prefetcher.Start(depth_, [this](SpillPrefetcher::Spill &spill_) -> bool { return ReadLdf(spill_); }); }
+	else{ prefetcher.Start(depth_, [this](SpillPrefetcher::Spill &spill_) -> bool { return ReadPld(spill_); }); }
+
+	return true;
+}
+
+/// Stop the reader thread and close the file.
+void InputStream::Close(){
+	prefetcher.Stop();
+	if(file.is_open()){ file.close(); }
+	finished = true;
+}
+
+/** Wait for the next complete spill of the file. Fragments and spills which
+  * are flagged as corrupt are skipped. The spill remains valid until Pop()
+  * is called and ends with the two words which terminate a spill.
+  * \param[out] nWords_ The number of words in the spill.
+  * \return Pointer to the spill, or NULL once the end of the file is reached.
+  */
+unsigned int *InputStream::Next(unsigned int &nWords_){
+	while(!finished){
+		SpillPrefetcher::Spill *spill = prefetcher.Front();
+		if(!spill){
+			finished = true;
+			break;
+		}
+		position = spill->position;
+
+		if(format == 0){
+			// Only the end of the file stops the stream, other bad buffers are skipped.
+			if(!spill->good){
+				if(spill->retval == 2 || spill->retval == 6){ finished = true; }
+			}
+			else if(spill->bad_spill){
+				std::cout << " WARNING: Spill of " << fname << " has been flagged as corrupt, skipping (at word " << position/4 << " in file)!\n";
+			}
+			else if(spill->full_spill){
+				nWords_ = spill->nBytes/4;
+				return spill->data.Data();
+			}
+		}
+		else if(spill->good){
+			// Terminate the spill in the same way as a spill of the main input file.
+			unsigned int *data = spill->data.Data();
+			nWords_ = spill->nBytes/4;
+			int word1 = 2, word2 = 9999;
+			memcpy(&data[nWords_], (char *)&word1, 4);
+			memcpy(&data[nWords_+1], (char *)&word2, 4);
+			nWords_ += 2;
+			return data;
+		}
+		else{ finished = true; }
+
+		prefetcher.Pop();
+	}
+	return NULL;
+}
+
+/// Read the next spill of an .ldf file on the reader thread.
+bool InputStream::ReadLdf(SpillPrefetcher::Spill &spill_){
+	spill_.good = databuff.Read(&file, spill_.data, spill_.nBytes, spill_.full_spill, spill_.bad_spill);
+	spill_.retval = databuff.GetRetval();
+	spill_.position = file.tellg();
+	return (spill_.good || (spill_.retval != 2 && spill_.retval != 6));
+}
+
+/// Read the next spill of a .pld file on the reader thread.
+bool InputStream::ReadPld(SpillPrefetcher::Spill &spill_){
+	spill_.good = pldData.Read(&file, spill_.data, spill_.nBytes);
+	spill_.position = file.tellg();
+	return spill_.good;
+}
@@ -0,0 +1,97 @@
+/** \file ListModeHeaders.cpp
+ * \brief Column-wise decoding of the fixed pixie16 list-mode header words.
+ */
+#include "ListModeHeaders.hpp"
+#include "XiaData.hpp"
+
+/** Walk a module buffer and record the location and fixed header words of
+  * each event. Locating stops at the end of the buffer or at the first event
+  * with an unexpected header length.
+  * \param[in]  buf Pointer to the first header word of the first event.
+  * \param[in]  end Pointer to one past the last word in the buffer.
+  * \return The number of events located.
+  */
+size_t ListModeHeaders::Locate(const unsigned int *buf, const unsigned int *end){
+	clear();
+	while(buf < end){
+		unsigned int headerLen = (buf[0] & 0x0001F000) >> 12;
+		unsigned int eventLen  = (buf[0] & 0x1FFE0000) >> 17;
+		if(!IsValidHeaderLength(headerLen) || eventLen == 0){
+			badHeader = true;
+			badWord = buf[0];
+			break;
+		}
+
+		if(start.empty())
+			commonHeaderLength = headerLen;
+		else if(headerLen != commonHeaderLength)
+			commonHeaderLength = 0;
+
+		start.push_back(buf);
+		word0.push_back(buf[0]);
+		word1.push_back(headerLen > 1 ? buf[1] : 0);
+		word2.push_back(headerLen > 1 ? buf[2] : 0);
+		word3.push_back(headerLen > 1 ? buf[3] : 0);
+
+		buf += eventLen;
+	}
+	return start.size();
+}
+
+/** Decode the fixed header fields of all located events into the columns.
+  * \return Nothing.
+  */
+void ListModeHeaders::Decode(){
+	// multiplier for high bits of 48-bit time
+	static const double HIGH_MULT = 4294967296.0;
+
+	const size_t num = start.size();
+
+	chanNum.resize(num);
+	slotNum.resize(num);
+	crateNum.resize(num);
+	headerLength.resize(num);
+	eventLength.resize(num);
+	flags.resize(num);
+	lowTime.resize(num);
+	highTime.resize(num);
+	cfdTime.resize(num);
+	energy.resize(num);
+	traceLength.resize(num);
+	time.resize(num);
+	timeStamp.resize(num);
+
+	// Each loop only reads from one or two columns and writes one, which
+	// keeps them free of branches and aliasing so they can be vectorized.
+	const unsigned int *w0 = word0.data();
+	const unsigned int *w1 = word1.data();
+	const unsigned int *w2 = word2.data();
+	const unsigned int *w3 = word3.data();
+
+	for(size_t i = 0; i < num; i++) chanNum[i] = (w0[i] & 0x0000000F);
+	for(size_t i = 0; i < num; i++) slotNum[i] = (w0[i] & 0x000000F0) >> 4;
+	for(size_t i = 0; i < num; i++) crateNum[i] = (w0[i] & 0x00000F00) >> 8;
+	for(size_t i = 0; i < num; i++) headerLength[i] = (w0[i] & 0x0001F000) >> 12;
+	for(size_t i = 0; i < num; i++) eventLength[i] = (w0[i] & 0x1FFE0000) >> 17;
+	for(size_t i = 0; i < num; i++) flags[i] = (unsigned char)(w0[i] >> 29);
+
+	for(size_t i = 0; i < num; i++) lowTime[i] = w1[i];
+	for(size_t i = 0; i < num; i++) highTime[i] = (w2[i] & 0x0000FFFF);
+	for(size_t i = 0; i < num; i++) cfdTime[i] = (w2[i] & 0xFFFF0000) >> 16;
+	for(size_t i = 0; i < num; i++) energy[i] = (w3[i] & 0x0000FFFF);
+	for(size_t i = 0; i < num; i++) traceLength[i] = (w3[i] & 0xFFFF0000) >> 16;
+	for(size_t i = 0; i < num; i++) time[i] = highTime[i] * HIGH_MULT + lowTime[i];
+	for(size_t i = 0; i < num; i++) timeStamp[i] = ((((unsigned long long)highTime[i] << 32) | lowTime[i]) << XiaData::cfdFractionBits) | cfdTime[i];
+}
+
+/// Clear all columns.
+void ListModeHeaders::clear(){
+	badHeader = false;
+	badWord = 0;
+	commonHeaderLength = 0;
+	start.clear();
+	word0.clear();
+	word1.clear();
+	word2.clear();
+	word3.clear();
+}
@@ -0,0 +1,171 @@
+/** \file PerfCounters.cpp
+ * \brief Timers and counters for the stages of a scan.
+ */
+#include <iomanip>
+
+#include "PerfCounters.hpp"
+
+/// Default constructor.
+PerfCounters::PerfCounters() : numStages(0), memoryBudget(0) {
+	const char *names[NUM_STAGES] = { "read", "decode", "sort", "build", "event" };
+	for(unsigned int i = 0; i < NUM_STAGES; i++)
+		Add(names[i]);
+	Zero();
+}
+
+/// Return true if the scan was compiled with SCAN_PERF.
+bool PerfCounters::Enabled(){
+#ifdef SCAN_PERF
+	return true;
+#else
+	return false;
+#endif
+}
+
+/** Add a stage to be timed. Stages must be added before any thread
+  * records them. Adding a name twice returns the id of the first stage.
+  * \param[in]  name_ The name of the stage.
+  * \return The id of the stage, or PERF_MAX_STAGES if no more stages may be added.
+  */
+unsigned int PerfCounters::Add(const std::string &name_){
+	for(unsigned int i = 0; i < numStages; i++){
+		if(entries[i].name == name_){ return i; }
+	}
+	if(numStages >= PERF_MAX_STAGES){ return PERF_MAX_STAGES; }
+	entries[numStages].name = name_;
+	return numStages++;
+}
+
+/** Record the processing of one raw event in the EVENT stage and the latency histogram.
+  * \param[in]  start_ The time at which processing of the event started.
+  * \param[in]  hits_  The number of hits in the event.
+  * \return Nothing.
+  */
+void PerfCounters::RecordEvent(const clock::time_point &start_, const unsigned long long &hits_){
+	clock::duration elapsed = clock::now() - start_;
+	AddCall(entries[EVENT], elapsed, hits_);
+
+	unsigned long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	unsigned int bin = 0;
+	while(ns > 1 && bin < PERF_LATENCY_BINS - 1){
+		ns >>= 1;
+		bin++;
+	}
+	Increment(latency[bin], 1);
+}
+
+/** Replace the memory held by each subsystem, as last measured.
+  * \param[in]  entries_ The memory of each subsystem.
+  * \param[in]  budget_  The budget of all subsystems in bytes, zero if there is none.
+  * \return Nothing.
+  */
+void PerfCounters::SetMemory(const std::vector<MemoryEntry> &entries_, const unsigned long long &budget_){
+	std::lock_guard<std::mutex> lock(memoryMutex);
+	memory = entries_;
+	memoryBudget = budget_;
+}
+
+/// Return true if the memory of the subsystems was measured at least once.
+bool PerfCounters::HasMemory() const {
+	std::lock_guard<std::mutex> lock(memoryMutex);
+	return !memory.empty();
+}
+
+/// Print the memory table.
+void PerfCounters::PrintMemory(std::ostream &out_) const {
+	std::lock_guard<std::mutex> lock(memoryMutex);
+	if(memory.empty()){ return; }
+
+	unsigned long long total = 0;
+	for(std::vector<MemoryEntry>::const_iterator iter = memory.begin(); iter != memory.end(); iter++)
+		total += iter->bytes;
+
+	out_ << " Memory held by each subsystem of the scan:\n";
+	out_ << "  " << std::left << std::setw(32) << "Subsystem" << std::right << std::setw(12) << "MB" << std::setw(9) << "%\n";
+	for(std::vector<MemoryEntry>::const_iterator iter = memory.begin(); iter != memory.end(); iter++){
+		out_ << "  " << std::left << std::setw(32) << iter->name << std::right << std::fixed;
+		out_ << std::setprecision(2) << std::setw(12) << iter->bytes / 1048576.0;
+		out_ << std::setprecision(1) << std::setw(8) << (total > 0 ? 100.0 * iter->bytes / total : 0) << "\n";
+	}
+	out_ << "  " << std::left << std::setw(32) << "total" << std::right << std::setprecision(2) << std::setw(12) << total / 1048576.0;
+	if(memoryBudget > 0){
+		out_ << " of a " << memoryBudget / 1048576.0 << " MB budget";
+		if(total > memoryBudget){ out_ << " (over budget)"; }
+	}
+	out_ << "\n";
+}
+
+/** Print a table of all stages which were called and the event latency percentiles,
+  * followed by the memory of each subsystem if it was measured.
+  * \param[in]  out_ The stream to print to.
+  * \return Nothing.
+  */
+void PerfCounters::Print(std::ostream &out_) const {
+	std::ios::fmtflags flags = out_.flags();
+	std::streamsize precision = out_.precision();
+
+	if(!Enabled()){
+		out_ << " Stage timing is disabled, rebuild with USE_SCAN_PERF to enable it.\n";
+		PrintMemory(out_);
+		out_.flags(flags);
+		out_.precision(precision);
+		return;
+	}
+
+	double wall = std::chrono::duration<double>(clock::now() - startTime).count();
+
+	out_ << " Time spent in each stage of the scan over " << std::fixed << std::setprecision(3) << wall << " s:\n";
+	out_ << "  " << std::left << std::setw(12) << "Stage" << std::right << std::setw(12) << "Calls";
+	out_ << std::setw(12) << "Total [s]" << std::setw(12) << "Mean [us]" << std::setw(12) << "Max [us]";
+	out_ << std::setw(14) << "Items" << std::setw(12) << "Items/s" << std::setw(9) << "Wall %\n";
+	for(unsigned int i = 0; i < numStages; i++){
+		unsigned long long calls = entries[i].calls.load(std::memory_order_relaxed);
+		if(calls == 0){ continue; }
+		unsigned long long items = entries[i].items.load(std::memory_order_relaxed);
+		double total = entries[i].totalNs.load(std::memory_order_relaxed) * 1E-9;
+		out_ << "  " << std::left << std::setw(12) << entries[i].name << std::right << std::setw(12) << calls;
+		out_ << std::setprecision(3) << std::setw(12) << total;
+		out_ << std::setprecision(2) << std::setw(12) << total * 1E6 / calls;
+		out_ << std::setw(12) << entries[i].maxNs.load(std::memory_order_relaxed) * 1E-3;
+		out_ << std::setw(14) << items << std::setprecision(0) << std::setw(12) << (total > 0 ? items / total : 0);
+		out_ << std::setprecision(1) << std::setw(8) << (wall > 0 ? 100 * total / wall : 0) << "\n";
+	}
+
+	// Percentiles of the event latency, given as the upper edge of their bin.
+	unsigned long long numEvents = 0;
+	for(unsigned int bin = 0; bin < PERF_LATENCY_BINS; bin++)
+		numEvents += latency[bin].load(std::memory_order_relaxed);
+	if(numEvents > 0){
+		const double fractions[3] = { 0.5, 0.9, 0.99 };
+		const char *labels[3] = { "p50", "p90", "p99" };
+		unsigned long long count = 0;
+		unsigned int next = 0;
+		out_ << "  Event latency:";
+		for(unsigned int bin = 0; bin < PERF_LATENCY_BINS && next < 3; bin++){
+			count += latency[bin].load(std::memory_order_relaxed);
+			while(next < 3 && count >= fractions[next] * numEvents){
+				out_ << " " << labels[next] << " < " << std::setprecision(2) << (2ULL << bin) * 1E-3 << " us,";
+				next++;
+			}
+		}
+		out_ << " max = " << entries[EVENT].maxNs.load(std::memory_order_relaxed) * 1E-3 << " us\n";
+	}
+
+	PrintMemory(out_);
+
+	out_.flags(flags);
+	out_.precision(precision);
+}
+
+/// Set all counters to zero and restart the wall clock. Calls recorded at the same time may be lost.
+void PerfCounters::Zero(){
+	for(unsigned int i = 0; i < PERF_MAX_STAGES; i++){
+		entries[i].calls.store(0, std::memory_order_relaxed);
+		entries[i].items.store(0, std::memory_order_relaxed);
+		entries[i].totalNs.store(0, std::memory_order_relaxed);
+		entries[i].maxNs.store(0, std::memory_order_relaxed);
+	}
+	for(unsigned int bin = 0; bin < PERF_LATENCY_BINS; bin++)
+		latency[bin].store(0, std::memory_order_relaxed);
+	startTime = clock::now();
+}
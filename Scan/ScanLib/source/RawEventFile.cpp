@@ -0,0 +1,442 @@
+/** \file RawEventFile.cpp
+ * \brief Records built raw events to a file and reads them back.
+ */
+#include <algorithm>
+
+#include <string.h>
+
+#include "RawEventFile.hpp"
+#include "XiaData.hpp"
+
+// The magic at the start and the end of a raw event file, and the tag of its index.
+static const char revMagic[8] = {'P', 'X', 'R', 'E', 'V', 'T', '0', '2'};
+static const char revEndMagic[8] = {'P', 'X', 'R', 'E', 'V', 'E', 'N', 'D'};
+static const char revIndexTag[4] = {'R', 'I', 'D', 'X'};
+
+/// The start of a raw event in the file.
+struct EventRecord{
+	uint32_t numHits; /// The number of hits of the event.
+	uint32_t numBytes; /// The length of the hits, in bytes.
+	double startTime; /// The start time of the event window.
+	double realStartTime; /// The time of the first hit.
+	double realStopTime; /// The time of the last hit.
+};
+
+static_assert(sizeof(EventRecord) == 32, "Unexpected padding of the raw event record");
+
+/// Return the number of onboard words (energy sums and QDCs) kept for a hit with a list-mode header of this length.
+static unsigned int onboard_words(const unsigned int &headerLength_){
+	unsigned int words = 0;
+	if(headerLength_ == 8 || headerLength_ == 16){ words += XiaData::numEnergySums; }
+	if(headerLength_ == 12 || headerLength_ == 16){ words += XiaData::numQdcs; }
+	return words;
+}
+
+template<typename T>
+static void append(std::vector<char> &buffer_, const T &value_){
+	buffer_.insert(buffer_.end(), (const char*)&value_, (const char*)&value_ + sizeof(T));
+}
+
+template<typename T>
+static bool read_value(std::istream &in_, T &value_){
+	return (bool)in_.read((char*)&value_, sizeof(T));
+}
+
+static void write_string(std::ostream &out_, const std::string &str_){
+	uint32_t length = str_.size();
+	out_.write((const char*)&length, sizeof(length));
+	out_.write(str_.data(), length);
+}
+
+static bool read_string(std::istream &in_, std::string &str_){
+	uint32_t length;
+	if(!read_value(in_, length) || length > 65536){ return false; }
+	str_.resize(length);
+	return (length == 0 || (bool)in_.read(&str_[0], length));
+}
+
+/////////////////////////////////////////////////////////////////////
+// RawEventWriter
+/////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+RawEventWriter::RawEventWriter() : traces(true), firstTime(0), numEvents(0), numHits(0), position(0) { }
+
+/// Destructor. Writes the index and closes the file.
+RawEventWriter::~RawEventWriter(){
+	Close();
+}
+
+/** Open the output file and write its magic.
+  * \param[in]  fname_  The name of the .rev file to write.
+  * \param[in]  traces_ Set to false to leave the traces out of the file.
+  * \return True if the file was opened and false otherwise.
+  */
+bool RawEventWriter::Open(const std::string &fname_, bool traces_/*=true*/){
+	Close();
+
+	file.open(fname_.c_str(), std::ios::binary | std::ios::trunc);
+	if(!file.is_open() || !file.good()){
+		file.close();
+		return false;
+	}
+	fname = fname_;
+	traces = traces_;
+
+	file.write(revMagic, 8);
+	position = 8;
+
+	firstTime = 0;
+	numEvents = 0;
+	numHits = 0;
+	header.clear();
+	indexTimes.clear();
+	indexOffsets.clear();
+
+	return file.good();
+}
+
+/// Write the index and close the file.
+void RawEventWriter::Close(){
+	if(!file.is_open()){ return; }
+
+	file.write(revIndexTag, 4);
+	file.write((const char*)&firstTime, sizeof(firstTime));
+	file.write((const char*)&numEvents, sizeof(numEvents));
+	file.write((const char*)&numHits, sizeof(numHits));
+
+	uint32_t numEntries = header.size();
+	file.write((const char*)&numEntries, sizeof(numEntries));
+	for(size_t i = 0; i < header.size(); i++){
+		write_string(file, header[i].first);
+		write_string(file, header[i].second);
+	}
+
+	uint64_t numIndexed = indexOffsets.size();
+	file.write((const char*)&numIndexed, sizeof(numIndexed));
+	file.write((const char*)indexTimes.data(), numIndexed*sizeof(double));
+	file.write((const char*)indexOffsets.data(), numIndexed*sizeof(uint64_t));
+
+	file.write((const char*)&position, sizeof(position));
+	file.write(revEndMagic, 8);
+	file.close();
+}
+
+/** Add an entry of the header of the input file, which is written to the index.
+  * \param[in]  name_  The name of the entry, as in ScanInterface::GetFileInfo().
+  * \param[in]  value_ The value of the entry.
+  * \return Nothing.
+  */
+void RawEventWriter::SetHeader(const std::string &name_, const std::string &value_){
+	header.push_back(std::make_pair(name_, value_));
+}
+
+/** Write a built raw event.
+  * \param[in]  event_         The hits of the raw event.
+  * \param[in]  firstTime_     The time of the first raw event of the scan (in clock ticks).
+  * \param[in]  startTime_     The start time of the raw event window.
+  * \param[in]  realStartTime_ The time of the first hit of the raw event.
+  * \param[in]  realStopTime_  The time of the last hit of the raw event.
+  * \return True if the event was written and false if the file is not open.
+  */
+bool RawEventWriter::Write(const std::deque<XiaData*> &event_, const double &firstTime_, const double &startTime_, const double &realStartTime_, const double &realStopTime_){
+	if(!file.is_open()){ return false; }
+
+	if(numEvents == 0){ firstTime = firstTime_; }
+	if(numEvents % indexStep == 0){
+		indexTimes.push_back(startTime_);
+		indexOffsets.push_back(position);
+	}
+
+	// The event record is filled in once the length of the hits is known.
+	buffer.assign(sizeof(EventRecord), 0);
+
+	EventRecord record;
+	record.numHits = 0;
+	for(std::deque<XiaData*>::const_iterator iter = event_.begin(); iter != event_.end(); iter++){
+		const XiaData *hit = *iter;
+		if(!hit){ continue; }
+
+		// Each hit is a CompactHit followed by its onboard words and trace.
+		CompactHit out;
+		hit->pack(out);
+		if(!traces){ out.traceLength = 0; }
+		append(buffer, out);
+
+		// Energy sums follow the first four words of 8 and 16 word headers, and
+		// the QDCs end 12 and 16 word headers.
+		if(hit->headerLength == 8 || hit->headerLength == 16){
+			for(int i = 0; i < XiaData::numEnergySums; i++){ append(buffer, (uint32_t)hit->getEnergySum(i)); }
+		}
+		if(hit->headerLength == 12 || hit->headerLength == 16){
+			for(int i = 0; i < XiaData::numQdcs; i++){ append(buffer, (uint32_t)hit->getQdcValue(i)); }
+		}
+
+		// Read the samples from the spill buffer if the trace was not copied.
+		if(out.traceLength > 0){
+			size_t offset = buffer.size();
+			buffer.resize(offset + out.traceLength*sizeof(uint16_t));
+			uint16_t *samples = (uint16_t*)&buffer[offset];
+			if(hit->hasTraceView()){ memcpy(samples, hit->traceView, out.traceLength*sizeof(uint16_t)); }
+			else{ std::copy(hit->adcTrace.begin(), hit->adcTrace.end(), samples); }
+		}
+
+		record.numHits++;
+	}
+
+	record.numBytes = buffer.size() - sizeof(EventRecord);
+	record.startTime = startTime_;
+	record.realStartTime = realStartTime_;
+	record.realStopTime = realStopTime_;
+	memcpy(buffer.data(), &record, sizeof(record));
+
+	file.write(buffer.data(), buffer.size());
+	position += buffer.size();
+	numEvents++;
+	numHits += record.numHits;
+
+	return file.good();
+}
+
+/////////////////////////////////////////////////////////////////////
+// RawEventReader
+/////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+RawEventReader::RawEventReader() : indexed(false), firstTime(0), numEvents(0), numHits(0), eventNumber(0), position(0), dataEnd(0),
+                                   startTime(0), realStartTime(0), realStopTime(0), cursor(0), loaded(false) { }
+
+/** Open a .rev file and read its index, if it has one.
+  * \param[in]  fname_ The name of the .rev file to read.
+  * \return True if the file was opened and is a raw event file and false otherwise.
+  */
+bool RawEventReader::Open(const std::string &fname_){
+	Close();
+
+	file.open(fname_.c_str(), std::ios::binary);
+	char magic[8];
+	if(!file.is_open() || !file.read(magic, 8) || memcmp(magic, revMagic, 8) != 0){
+		Close();
+		return false;
+	}
+
+	file.seekg(0, file.end);
+	dataEnd = file.tellg();
+
+	if(!read_index()){
+		header.clear();
+		indexTimes.clear();
+		indexOffsets.clear();
+		numEvents = 0;
+		numHits = 0;
+
+		// The time of the first event is the start of the first event window.
+		file.clear();
+		file.seekg(8 + 2*sizeof(uint32_t));
+		read_value(file, firstTime);
+		file.clear();
+	}
+
+	position = 8;
+	eventNumber = 0;
+	file.seekg(position);
+
+	return true;
+}
+
+/// Close the file.
+void RawEventReader::Close(){
+	file.close();
+	file.clear();
+	indexed = false;
+	firstTime = 0;
+	numEvents = 0;
+	numHits = 0;
+	eventNumber = 0;
+	position = 0;
+	dataEnd = 0;
+	header.clear();
+	indexTimes.clear();
+	indexOffsets.clear();
+	hitOffsets.clear();
+	memory.clear();
+	cursor = 0;
+	loaded = false;
+}
+
+/** Read the next raw event. Its hits are then filled with GetHit.
+  * \return False at the end of the file or if the event is corrupt.
+  */
+bool RawEventReader::Next(){
+	hitOffsets.clear();
+
+	// Loaded raw events end where the memory ends.
+	const uint64_t end = (loaded ? 8 + memory.size() : dataEnd);
+
+	EventRecord record;
+	if(position + sizeof(EventRecord) > end || !read_bytes((char*)&record, sizeof(record)) || position + sizeof(EventRecord) + record.numBytes > end){ return false; }
+
+	buffer.resize(record.numBytes);
+	if(record.numBytes > 0 && !read_bytes(buffer.data(), record.numBytes)){ return false; }
+
+	// Find the start of each hit, checking that they fit the length of the event.
+	size_t offset = 0;
+	for(uint32_t i = 0; i < record.numHits; i++){
+		if(offset + sizeof(CompactHit) > buffer.size()){
+			hitOffsets.clear();
+			return false;
+		}
+		CompactHit hit;
+		memcpy(&hit, &buffer[offset], sizeof(hit));
+		hitOffsets.push_back(offset);
+		offset += sizeof(CompactHit) + onboard_words(hit.headerLength)*sizeof(uint32_t) + hit.traceLength*sizeof(uint16_t);
+	}
+	if(offset != buffer.size()){
+		hitOffsets.clear();
+		return false;
+	}
+
+	startTime = record.startTime;
+	realStartTime = record.realStartTime;
+	realStopTime = record.realStopTime;
+	position += sizeof(EventRecord) + record.numBytes;
+	eventNumber++;
+
+	return true;
+}
+
+/** Fill a hit of the raw event just read.
+  * \param[in]  index_ The hit to fill, below GetNumEventHits().
+  * \param[out] event_ The cleared XiaData to fill.
+  * \return Nothing.
+  */
+void RawEventReader::GetHit(const size_t &index_, XiaData *event_) const {
+	const char *data = &buffer[hitOffsets[index_]];
+	CompactHit hit;
+	memcpy(&hit, data, sizeof(hit));
+	data += sizeof(hit);
+
+	event_->unpack(hit);
+
+	if(hit.headerLength == 8 || hit.headerLength == 16){
+		memcpy(event_->energySums, data, XiaData::numEnergySums*sizeof(uint32_t));
+		data += XiaData::numEnergySums*sizeof(uint32_t);
+	}
+	if(hit.headerLength == 12 || hit.headerLength == 16){
+		memcpy(event_->qdcValue, data, XiaData::numQdcs*sizeof(uint32_t));
+		data += XiaData::numQdcs*sizeof(uint32_t);
+	}
+
+	const uint16_t *samples = (const uint16_t*)data;
+	event_->adcTrace.assign(samples, samples + hit.traceLength);
+}
+
+/// Move back to the first raw event of the file.
+void RawEventReader::Rewind(){
+	position = 8;
+	cursor = 0;
+	eventNumber = 0;
+	file.clear();
+	file.seekg(position);
+}
+
+/** Read the first raw events of the file into memory.
+  * \param[in]  maxEvents_ The number of raw events to load, 0 to load every raw event.
+  * \return The number of raw events loaded.
+  */
+unsigned long long RawEventReader::Load(const unsigned long long &maxEvents_/*=0*/){
+	memory.clear();
+	loaded = false;
+	Rewind();
+
+	// Find the end of the raw events to load from their records alone.
+	unsigned long long count = 0;
+	EventRecord record;
+	while((maxEvents_ == 0 || count < maxEvents_) && position + sizeof(EventRecord) <= dataEnd && read_value(file, record) &&
+	      position + sizeof(EventRecord) + record.numBytes <= dataEnd){
+		position += sizeof(EventRecord) + record.numBytes;
+		file.seekg(position);
+		count++;
+	}
+
+	memory.resize(position - 8);
+	file.clear();
+	file.seekg(8);
+	if(!memory.empty() && !file.read(memory.data(), memory.size())){
+		memory.clear();
+		count = 0;
+	}
+	loaded = true;
+	Rewind();
+
+	return count;
+}
+
+/** Move to the first raw event which starts at or after a time, using the index.
+  * \param[in]  time_ The time to seek to (in clock ticks).
+  * \return False if the file has no index.
+  */
+bool RawEventReader::SeekTime(const double &time_){
+	if(!indexed){ return false; }
+
+	// Start from the last indexed event before the time and skip the events in between.
+	size_t entry = std::lower_bound(indexTimes.begin(), indexTimes.end(), time_) - indexTimes.begin();
+	if(entry > 0){ entry--; }
+
+	file.clear();
+	position = (entry < indexOffsets.size() ? indexOffsets[entry] : dataEnd);
+	eventNumber = entry*RawEventWriter::indexStep;
+	EventRecord record;
+	while(position < dataEnd){
+		file.seekg(position);
+		if(!read_value(file, record) || record.startTime >= time_){ break; }
+		position += sizeof(EventRecord) + record.numBytes;
+		eventNumber++;
+	}
+
+	file.clear();
+	file.seekg(position);
+	cursor = position - 8;
+	return true;
+}
+
+/// Read length_ bytes at the current position, from memory if the raw events were loaded.
+bool RawEventReader::read_bytes(char *data_, const size_t &length_){
+	if(!loaded){ return (bool)file.read(data_, length_); }
+
+	if(cursor + length_ > memory.size()){ return false; }
+	memcpy(data_, &memory[cursor], length_);
+	cursor += length_;
+	return true;
+}
+
+/// Read the index at the end of the file. Returns false if the file has none.
+bool RawEventReader::read_index(){
+	uint64_t indexOffset;
+	char magic[8];
+	if(dataEnd < 8 + sizeof(indexOffset) + 8){ return false; }
+	file.seekg(dataEnd - sizeof(indexOffset) - 8);
+	if(!read_value(file, indexOffset) || !file.read(magic, 8) || memcmp(magic, revEndMagic, 8) != 0 || indexOffset < 8 || indexOffset > dataEnd){ return false; }
+
+	char tag[4];
+	uint32_t numEntries;
+	uint64_t numIndexed;
+	file.seekg(indexOffset);
+	if(!file.read(tag, 4) || memcmp(tag, revIndexTag, 4) != 0 || !read_value(file, firstTime) || !read_value(file, numEvents) ||
+	   !read_value(file, numHits) || !read_value(file, numEntries)){ return false; }
+
+	std::string name, value;
+	for(uint32_t i = 0; i < numEntries; i++){
+		if(!read_string(file, name) || !read_string(file, value)){ return false; }
+		header.push_back(std::make_pair(name, value));
+	}
+
+	if(!read_value(file, numIndexed) || numIndexed > numEvents/RawEventWriter::indexStep + 1){ return false; }
+	indexTimes.resize(numIndexed);
+	indexOffsets.resize(numIndexed);
+	if(!file.read((char*)indexTimes.data(), numIndexed*sizeof(double)) || !file.read((char*)indexOffsets.data(), numIndexed*sizeof(uint64_t))){ return false; }
+
+	dataEnd = indexOffset;
+	indexed = true;
+	return true;
+}
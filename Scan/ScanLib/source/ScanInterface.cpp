@@ -13,23 +13,50 @@
 #include <iostream>
 #include <sstream>
 #include <thread>
+#include <algorithm>
+#include <limits>
 
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
 #include <unistd.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "Unpacker.hpp"
 #include "poll2_socket.h"
+#include "poll2_shm.h"
+#include "poll2_stream.h"
+#include "poll2_log.h"
 #include "CTerminal.h"
 
 #include "ScanInterface.hpp"
+#include "InputStream.hpp"
 
 #ifndef PROG_NAME
 #define PROG_NAME "ScanInterface"
 #endif
 
+// The first word of a scan checkpoint file ("SCKP") and its version.
+static const unsigned int checkpointMagic = 0x504B4353;
+static const unsigned int checkpointVersion = 1;
+
+// The most spills one shm spill may stand for while shedding load.
+static const unsigned int maxShedEvery = 64;
+
+template<typename T>
+static void write_value(std::ostream &out_, const T &value_){
+	out_.write((const char*)&value_, sizeof(T));
+}
+
+template<typename T>
+static bool read_value(std::istream &in_, T &value_){
+	return (bool)in_.read((char*)&value_, sizeof(T));
+}
+
 void start_run_control(ScanInterface *main_){
 	main_->RunControl();
 }
@@ -189,10 +216,20 @@ bool ScanInterface::rewind(const unsigned long &offset_/*=0*/){
 		return false;
 	}
 
-	// Move to the first word in the file.
+	// Spills which were already read ahead are from the old position.
+	prefetcher.Stop();
+
+	// Move to the first word in the file. Raw event files always start over at their first event.
+	if(file_format == 3){
+		std::cout << " Seeking to the first raw event in file\n";
+		event_reader.Rewind();
+		Notify("REWIND_FILE");
+		return true;
+	}
 	std::cout << " Seeking to word no. " << offset_ << " in file\n";
-	input_file.seekg(offset_*4, input_file.beg);
-	std::cout << " Input file is now at " << input_file.tellg() << " bytes\n";
+	if(map_data){ map_pos = (offset_ < map_words ? offset_ : map_words); }
+	else{ input_file.seekg(offset_*4, input_file.beg); }
+	std::cout << " Input file is now at " << get_file_position() << " bytes\n";
 
 	// Notify that the user has rewound to the start of the file.
 	Notify("REWIND_FILE");
@@ -226,21 +263,36 @@ bool ScanInterface::open_input_file(const std::string &fname_){
 	else if(extension == "pld"){ // Pixie list data file format
 		file_format = 1;
 	}
+	else if(extension == "pldz"){ // Compressed pixie list data file format
+		if(!PLD_data::CompressionAvailable()){
+			std::cout << " ERROR! Unable to read compressed pld files, zlib support was not compiled in!\n";
+			return false;
+		}
+		file_format = 1;
+	}
+	else if(extension == "rev"){ // Raw events recorded by a scan
+		file_format = 3;
+	}
 	else{
 		std::cout << " ERROR! Invalid file format '" << extension << "'\n";
 		std::cout << "  The current valid data formats are:\n";
 		std::cout << "   ldf - list data format (HRIBF)\n";
 		std::cout << "   pld - pixie list data format\n";
+		if(PLD_data::CompressionAvailable()){ std::cout << "   pldz - compressed pixie list data format\n"; }
+		std::cout << "   rev - raw events recorded by a scan (--record)\n";
 		return false;
 	}
+	compressed_input = (extension == "pldz");
 
 	// Close the previous file, if one is open.
 	if(file_open){
 		std::cout << " Note: Closing previously opened file.\n";
 		input_file.close();
+		unmap_input_file();
 	}
 
 	file_open = true;
+	input_fname = fname_;
 
 	// Load the input file.
 	input_file.open(fname_.c_str(), std::ios::binary);
@@ -296,6 +348,43 @@ bool ScanInterface::open_input_file(const std::string &fname_){
 			pldHead.Print();	
 			std::cout << std::endl;
 		}
+		else if(file_format == 3){
+			if(!event_reader.Open(fname_)){
+				std::cout << " ERROR! Input file '" << fname_ << "' is not a raw event file!\n";
+				input_file.close();
+				file_open = false;
+				return false;
+			}
+
+			// The header of the file the raw events were built from.
+			const std::vector<std::pair<std::string, std::string> > &header = event_reader.GetHeader();
+			for(std::vector<std::pair<std::string, std::string> >::const_iterator iter = header.begin(); iter != header.end(); iter++){
+				finfo.push_back(iter->first, iter->second);
+			}
+
+			if(event_reader.HasIndex()){ std::cout << " Raw event file with " << event_reader.GetNumEvents() << " raw events (" << event_reader.GetNumHits() << " hits)\n\n"; }
+			else{ std::cout << " WARNING! The raw event file was not closed, its events are read until the first incomplete one.\n\n"; }
+		}
+	}
+
+	data_start = input_file.tellg()/4;
+
+	// Load the spill index, or build it if there is no up to date index file.
+	spillIndex.clear();
+	if(index_mode && file_format == 0){ load_index(); }
+
+	// Map the file. The headers above are still read through the stream, so
+	// data reading starts at the current stream position.
+	// Compressed spills must be inflated into a separate buffer, so there is
+	// nothing to be gained by mapping the file.
+	if(mmap_mode && file_format == 3){ std::cout << " Note: Raw event files are read as a stream.\n"; }
+	else if(mmap_mode && compressed_input){ std::cout << " Note: Compressed input files are read as a stream.\n"; }
+	else if(mmap_mode){
+		if(map_input_file(fname_)){
+			map_pos = input_file.tellg()/4;
+			if(debug_mode){ std::cout << "debug: Mapped " << map_words << " words of input file\n"; }
+		}
+		else{ std::cout << " WARNING! Failed to map input file, reading it as a stream instead.\n"; }
 	}
 
 	// Notify that the user has loaded a new file.
@@ -304,6 +393,548 @@ bool ScanInterface::open_input_file(const std::string &fname_){
 	return true;	
 }
 
+/** Scan the main input file together with every merged input file. Each file
+  * is read from the start on its own read-ahead thread, and the next spill is
+  * always taken from the file which is furthest behind in time. The Unpacker
+  * only builds raw events up to the time which every other file has reached,
+  * so at most about one spill of each file is held over at a time.
+  * \return Nothing.
+  */
+void ScanInterface::read_merged(){
+	unsigned int depth = (prefetch_depth > 0 ? prefetch_depth : 2);
+
+	std::vector<std::string> fnames(1, input_fname);
+	fnames.insert(fnames.end(), merge_filenames.begin(), merge_filenames.end());
+
+	std::vector<InputStream*> streams;
+	for(std::vector<std::string>::iterator iter = fnames.begin(); iter != fnames.end(); iter++){
+		InputStream *stream = new InputStream();
+		if(!stream->Open(*iter, depth, debug_mode)){
+			delete stream;
+			continue;
+		}
+		std::cout << msgHeader << "Merging spills of " << *iter << ".\n";
+		streams.push_back(stream);
+	}
+
+	while(true){
+		if(kill_all == true){ 
+			break;
+		}
+		else if(!is_running){
+			IdleTask();
+			usleep(100000); //0.1 seconds
+			continue;
+		}
+
+		// Read the stream whose latest hit is the earliest.
+		InputStream *next = NULL;
+		for(std::vector<InputStream*>::iterator iter = streams.begin(); iter != streams.end(); iter++){
+			if(!(*iter)->IsFinished() && (!next || (*iter)->GetTime() < next->GetTime())){ next = *iter; }
+		}
+		if(!next){ break; }
+
+		unsigned int nWords;
+		unsigned int *spill = next->Next(nWords);
+		if(!spill){ continue; }
+
+		// The next spill of any other stream may still hold hits from after its latest hit.
+		double horizon = std::numeric_limits<double>::max();
+		for(std::vector<InputStream*>::iterator iter = streams.begin(); iter != streams.end(); iter++){
+			if(*iter != next && !(*iter)->IsFinished() && (*iter)->GetTime() < horizon){ horizon = (*iter)->GetTime(); }
+		}
+
+		std::stringstream status;
+		status << "\033[0;32m" << "[MERGE] " << "\033[0m" << nWords << " words from " << next->GetName() << " (" << (int)next->GetProgress() << "%)";
+		if(!batch_mode){ term->SetStatus(status.str()); }
+		else{ std::cout << "\r" << status.str(); }
+
+		if(debug_mode){ std::cout << "debug: Retrieved spill of " << nWords << " words from " << next->GetName() << ", input horizon is " << horizon << "\n"; }
+
+		if(!dry_run_mode){
+			core->SetInputHorizon(horizon);
+			core->SetSpillNumber(num_spills_recvd);
+			core->ReadSpill(spill, nWords, is_verbose);
+			if(core->GetSpillEndTime() > next->GetTime()){ next->SetTime(core->GetSpillEndTime()); }
+			IdleTask();
+		}
+		next->Pop();
+		num_spills_recvd++;
+	}
+
+	// Every file has been read, so the remaining events may all be built.
+	core->SetInputHorizon(std::numeric_limits<double>::max());
+
+	for(std::vector<InputStream*>::iterator iter = streams.begin(); iter != streams.end(); iter++){
+		delete (*iter);
+	}
+
+	if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Finished scanning files."); }
+	else{ std::cout << std::endl << std::endl; }
+}
+
+/** Process the raw events of a .rev input file, which were built and recorded
+  * by an earlier scan. The hits of each raw event go straight to the Unpacker's
+  * ProcessRawEvent, so nothing is unpacked, sorted or built again.
+  * \return Nothing.
+  */
+void ScanInterface::replay_events(){
+	while(true){
+		if(kill_all == true){ 
+			break;
+		}
+		else if(!is_running){
+			IdleTask();
+			usleep(100000); //0.1 seconds
+			continue;
+		}
+
+		if(dry_run_mode ? !event_reader.Next() : !core->ReplayRawEvent(event_reader)){ break; }
+
+		// Raw events come much faster than spills, so the status is only updated every so often.
+		if(event_reader.GetEventNumber() % 10000 == 0){
+			std::stringstream status;
+			status << "\033[0;32m" << "[REPLAY] " << "\033[0m" << event_reader.GetEventNumber() << " raw events (" << (int)event_reader.GetProgress() << "%)";
+			if(!batch_mode){ term->SetStatus(status.str()); }
+			else{ std::cout << "\r" << status.str(); }
+			IdleTask();
+		}
+	}
+
+	if(debug_mode){ std::cout << "debug: Replayed " << event_reader.GetEventNumber() << " raw events\n"; }
+
+	if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Finished scanning file."); }
+	else{ std::cout << std::endl << std::endl; }
+}
+
+/** Map the entire input file into memory. The mapping is private, so writing
+  * to it (e.g. to terminate a .pld spill in place) never touches the file.
+  * \param[in]  fname_ Input filename to map.
+  * \return True upon successfully mapping the file and false otherwise.
+  */
+bool ScanInterface::map_input_file(const std::string &fname_){
+	unmap_input_file();
+
+	int fd = open(fname_.c_str(), O_RDONLY);
+	if(fd < 0){ return false; }
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size < 4){
+		close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(NULL, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED){ return false; }
+
+	// The file is scanned from front to back.
+	madvise(mapping, fileStat.st_size, MADV_SEQUENTIAL);
+
+	map_data = (unsigned int *)mapping;
+	map_words = fileStat.st_size / 4;
+	map_pos = 0;
+
+	return true;
+}
+
+/** Remove the memory mapping of the input file, if there is one.
+  * \return Nothing.
+  */
+void ScanInterface::unmap_input_file(){
+	if(!map_data){ return; }
+	munmap(map_data, map_words*4);
+	map_data = NULL;
+	map_words = 0;
+	map_pos = 0;
+}
+
+/** Return the current read position in the input file.
+  * \return The position in the input file in bytes.
+  */
+std::streampos ScanInterface::get_file_position(){
+	if(map_data){ return std::streampos(map_pos*4); }
+	return input_file.tellg();
+}
+
+/** Build the spill index of the input .ldf file. The file is read through a
+  * separate stream (or its own position in the memory mapping), so the current
+  * scan position is not changed. A mapped file is indexed in place, without
+  * reassembling its spills.
+  * \return True upon success and false otherwise.
+  */
+bool ScanInterface::build_index(){
+	spillIndex.clear();
+	if(!file_open || file_format != 0){ return false; }
+
+	std::ifstream file;
+	if(!map_data){
+		file.open((prefix + "." + extension).c_str(), std::ios::binary);
+		if(!file.good()){ return false; }
+		file.seekg(data_start*4, file.beg);
+	}
+
+	std::cout << " Building spill index of input file...\n";
+
+	DATA_buffer reader;
+	size_t pos = data_start;
+	std::vector<SpillSpan> spans;
+	unsigned int nBytes;
+	bool full_spill;
+	bool bad_spill;
+	SpillIndex::Entry entry;
+	while(true){
+		bool readOk;
+		if(map_data){ readOk = reader.Read(map_data, map_words, pos, spans, nBytes, full_spill, bad_spill); }
+		else{ readOk = reader.Read(&file, spillBuffer, nBytes, full_spill, bad_spill); }
+		if(!readOk){
+			if(reader.GetRetval() == 2 || reader.GetRetval() == 6){ break; }
+			continue;
+		}
+		if(!full_spill || bad_spill){ continue; }
+
+		entry.offset = reader.GetSpillOffset();
+		entry.position = reader.GetSpillPosition();
+		entry.numWords = nBytes/4;
+
+		// A spill with no events keeps the time of the previous spill, so that
+		// the index stays in time order.
+		if(map_data){ SpillIndex::GetFirstTime(spans, entry.firstTime); }
+		else{ SpillIndex::GetFirstTime(spillBuffer.Data(), nBytes/4, entry.firstTime); }
+		spillIndex.push_back(entry);
+	}
+	spillIndex.SetFileLength(file_length);
+
+	std::cout << " Indexed " << spillIndex.size() << " spills\n";
+
+	return true;
+}
+
+/** Load the spill index of the input .ldf file from its index file. If the
+  * index file does not exist or does not match the input file, the index is
+  * built and written to the index file.
+  * \return True if an index was loaded or built and false otherwise.
+  */
+bool ScanInterface::load_index(){
+	std::string fname = SpillIndex::GetIndexFilename(prefix + "." + extension);
+	if(spillIndex.Read(fname) && spillIndex.GetFileLength() == (unsigned long long)file_length){
+		std::cout << " Loaded index of " << spillIndex.size() << " spills from '" << fname << "'\n";
+		return true;
+	}
+
+	if(!build_index()){ return false; }
+
+	if(!spillIndex.Write(fname)){ std::cout << " WARNING! Failed to write spill index file '" << fname << "'.\n"; }
+
+	return true;
+}
+
+/** Seek to the start of a spill in the spill index.
+  * \param[in]  spill_ The index of the spill.
+  * \return True upon success and false otherwise.
+  */
+bool ScanInterface::seek_spill(const size_t &spill_){
+	if(!scan_init){ return false; }
+
+	if(!file_open){
+		std::cout << " No input file loaded.\n";
+		return false;
+	}
+	else if(is_running){ 
+		std::cout << " Cannot change file position while scan is running!\n";
+		return false;
+	}
+	else if(spillIndex.empty()){
+		std::cout << " No spill index loaded. Use 'index' to build one.\n";
+		return false;
+	}
+	else if(spill_ >= spillIndex.size()){
+		std::cout << " Spill no. " << spill_ << " is not in the index of " << spillIndex.size() << " spills.\n";
+		return false;
+	}
+
+	// Spills which were already read ahead are from the old position.
+	prefetcher.Stop();
+
+	const SpillIndex::Entry &entry = spillIndex[spill_];
+	std::cout << " Seeking to spill no. " << spill_ << " at word no. " << entry.offset + entry.position << " in file\n";
+	if(map_data){ map_pos = entry.offset; }
+	else{
+		input_file.clear();
+		input_file.seekg(entry.offset*4, input_file.beg);
+	}
+	databuff.SetStartPosition(entry.position);
+
+	// Notify that the user has changed the file position.
+	Notify("REWIND_FILE");
+
+	return true;
+}
+
+/** Seek to the start of the last spill which begins at or before a given time.
+  * \param[in]  time_ The time to seek to (in clock ticks).
+  * \return True upon success and false otherwise.
+  */
+bool ScanInterface::seek_time(const unsigned long long &time_){
+	size_t spill = 0;
+	if(!spillIndex.FindTime(time_, spill)){ spill = 0; }
+	return seek_spill(spill);
+}
+
+/** Write a checkpoint of the scan to the output file name with a .ckpt extension. Every event
+  * read so far is built and processed first, so the checkpoint holds the complete state of the
+  * scan before the next spill. In stream mode, the events held over for the next spill are built
+  * without it, as at the end of a file. The checkpoint is written to a temporary file which is
+  * then renamed, so a crash always leaves the last complete checkpoint.
+  * \param[in]  offset_   The word offset of the buffer holding the start of the next spill.
+  * \param[in]  position_ The word position of the next spill in its buffer (.ldf files only).
+  * \param[in]  complete_ Set to true if the whole input file has been scanned.
+  * \return True upon success and false otherwise.
+  */
+bool ScanInterface::write_checkpoint(const size_t &offset_, const unsigned int &position_, bool complete_/*=false*/){
+	next_checkpoint = time(NULL) + checkpoint_interval;
+	core->FlushEvents();
+
+	std::string fname = output_filename + ".ckpt";
+	std::ofstream file((fname + ".tmp").c_str(), std::ios::binary | std::ios::trunc);
+
+	write_value(file, checkpointMagic);
+	write_value(file, checkpointVersion);
+	write_value(file, (unsigned int)input_fname.size());
+	file.write(input_fname.data(), input_fname.size());
+	write_value(file, (unsigned long long)file_length);
+	write_value(file, (unsigned long long)offset_);
+	write_value(file, position_);
+	write_value(file, (unsigned long long)num_spills_recvd);
+	write_value(file, (unsigned char)complete_);
+	write_value(file, core->GetNumRawEvents());
+	write_value(file, core->GetFirstTime());
+
+	bool good = file.good() && SaveState(file);
+	file.close();
+	good = good && !file.fail() && std::rename((fname + ".tmp").c_str(), fname.c_str()) == 0;
+
+	if(!good){ std::cout << msgHeader << "Failed to write the checkpoint '" << fname << "'!\n"; }
+	else if(debug_mode){ std::cout << "debug: Wrote checkpoint at spill no. " << num_spills_recvd << " (word no. " << offset_ + position_ << " in file)\n"; }
+
+	return good;
+}
+
+/** Restore the state of the scan from the checkpoint written by an earlier scan of the same input
+  * file to the same output file, and seek to the spill following the checkpoint. If there is no
+  * checkpoint, the scan starts from the beginning of the file.
+  * \return True upon success and false if the checkpoint can not be used.
+  */
+bool ScanInterface::resume_scan(){
+	std::string fname = output_filename + ".ckpt";
+	std::ifstream file(fname.c_str(), std::ios::binary);
+	if(!file.good()){
+		std::cout << msgHeader << "No checkpoint '" << fname << "' found, starting from the beginning of the file.\n";
+		return true;
+	}
+
+	unsigned int magic, version, nameLength;
+	std::string fileName;
+	unsigned long long fileLength, offset, numSpills;
+	unsigned int position, numRawEvt;
+	unsigned char complete;
+	double firstTime;
+
+	bool good = (read_value(file, magic) && magic == checkpointMagic && read_value(file, version) && version == checkpointVersion &&
+	             read_value(file, nameLength) && nameLength < 4096);
+	if(good){
+		fileName.resize(nameLength);
+		good = (nameLength == 0 || file.read(&fileName[0], nameLength));
+	}
+	good = good && read_value(file, fileLength) && read_value(file, offset) && read_value(file, position) && read_value(file, numSpills) &&
+	       read_value(file, complete) && read_value(file, numRawEvt) && read_value(file, firstTime);
+
+	if(!good){
+		std::cout << msgHeader << "The checkpoint '" << fname << "' is not a valid checkpoint!\n";
+		return false;
+	}
+	else if(fileName != input_fname || fileLength != (unsigned long long)file_length){
+		std::cout << msgHeader << "The checkpoint '" << fname << "' was written for the input file '" << fileName << "'!\n";
+		return false;
+	}
+	else if(!LoadState(file)){
+		std::cout << msgHeader << "Failed to restore the scan from the checkpoint '" << fname << "'!\n";
+		return false;
+	}
+
+	core->SetEventCount(numRawEvt, firstTime);
+	num_spills_recvd = numSpills;
+
+	if(complete){
+		std::cout << msgHeader << "The checkpoint '" << fname << "' was written at the end of the file, there is nothing left to scan.\n";
+		resume_complete = true;
+		return true;
+	}
+
+	// Seek to the next spill. The position in its buffer is set when the scan starts.
+	prefetcher.Stop();
+	if(map_data){ map_pos = offset; }
+	else{
+		input_file.clear();
+		input_file.seekg(offset*4, input_file.beg);
+	}
+	start_position = position;
+
+	std::cout << msgHeader << "Resuming the scan at spill no. " << numSpills << " (word no. " << offset + position << " in file).\n";
+
+	// Notify that the file position has changed.
+	Notify("REWIND_FILE");
+
+	return true;
+}
+
+/** Rebuild a spill which is missing some of its network chunks. The module
+  * buffers of a spill are self-delimiting (length, module number) and every
+  * chunk but the last holds chunkWords_ words, so the position of each chunk
+  * in the spill is known. Every module buffer which arrived intact is kept.
+  * Lost modules are replaced by empty (two word) buffers so the Unpacker does
+  * not discard the other modules of the spill. Where a buffer header itself
+  * was lost, the next intact module buffer is found by checking for a
+  * plausible header followed by a plausible Pixie event header.
+  * \param[in,out] data_ The spill. Missing chunks may hold any data.
+  * \param[in]  nWords_ The length of the spill (or an upper limit if the last chunk is missing).
+  * \param[in]  goodChunks_ Set to true for every chunk which was received.
+  * \param[in]  chunkWords_ The number of spill words in every chunk but the last.
+  * \return The length of the rebuilt spill in words.
+  */
+unsigned int ScanInterface::recover_spill(unsigned int *data_, const unsigned int &nWords_, const std::vector<bool> &goodChunks_, const unsigned int &chunkWords_){
+	const unsigned int maxVsn = 14; // No more than 14 pixie modules per crate
+	const unsigned int clockVsn = 1000; // Wall clock buffer inserted by poll2
+
+	// Return true if words [start_, stop_) of the spill were all received.
+	auto received = [&](unsigned int start_, unsigned int stop_) -> bool {
+		if(stop_ > nWords_ || start_ >= stop_){ return false; }
+		for(unsigned int chunk = start_ / chunkWords_; chunk <= (stop_ - 1) / chunkWords_; chunk++){
+			if(chunk >= goodChunks_.size() || !goodChunks_[chunk]){ return false; }
+		}
+		return true;
+	};
+
+	// Return true if a module buffer header could start at pos_, after module lastVsn_.
+	auto plausible = [&](unsigned int pos_, int lastVsn_) -> bool {
+		if(!received(pos_, pos_ + 2)){ return false; }
+		unsigned int lenRec = data_[pos_];
+		unsigned int vsn = data_[pos_+1];
+		if(lenRec < 2 || pos_ + lenRec > nWords_){ return false; }
+		if(vsn == clockVsn){ return (lenRec == 4); }
+		if(vsn >= maxVsn || (int)vsn <= lastVsn_){ return false; }
+		if(lenRec == 2){ return true; }
+
+		// The buffer must start with a whole Pixie event.
+		if(!received(pos_ + 2, pos_ + 3)){ return false; }
+		unsigned int headerLength = (data_[pos_+2] & 0x1F000) >> 12;
+		unsigned int eventLength = (data_[pos_+2] & 0x7FFE0000) >> 17;
+		return (headerLength >= 4 && eventLength >= headerLength && eventLength <= lenRec - 2);
+	};
+
+	unsigned int readPos = 0;
+	unsigned int writePos = 0;
+	int lastVsn = -1;
+	bool lost = false;
+
+	while(readPos < nWords_){
+		if(!plausible(readPos, lastVsn)){
+			// Find the next intact module buffer header.
+			unsigned int nextPos = readPos + 1;
+			while(nextPos < nWords_ && !plausible(nextPos, lastVsn)){ nextPos++; }
+			if(nextPos >= nWords_){ 
+				lost = true;
+				break; 
+			}
+			readPos = nextPos;
+			if(data_[readPos+1] != clockVsn){
+				for(unsigned int vsn = lastVsn + 1; vsn < data_[readPos+1]; vsn++){ // Replace the modules whose headers were lost
+					data_[writePos++] = 2;
+					data_[writePos++] = vsn;
+					lost_buffers[vsn]++;
+				}
+			}
+		}
+
+		unsigned int lenRec = data_[readPos];
+		unsigned int vsn = data_[readPos+1];
+		if(received(readPos, readPos + lenRec)){ // Keep the intact buffer
+			memmove(&data_[writePos], &data_[readPos], lenRec * sizeof(unsigned int));
+			writePos += lenRec;
+		}
+		else if(vsn != clockVsn){ // Replace the damaged buffer
+			data_[writePos++] = 2;
+			data_[writePos++] = vsn;
+			lost_buffers[vsn]++;
+		}
+		if(vsn != clockVsn){ lastVsn = vsn; }
+		readPos += lenRec;
+	}
+
+	// Modules after the last intact header cannot be identified.
+	if(lost && debug_mode){ std::cout << "debug: Unable to identify the modules after module " << lastVsn << std::endl; }
+
+	num_spills_recovered++;
+
+	return writePos;
+}
+
+bool ScanInterface::shed_load(const double &fill_){
+	if(shed_low <= 0){ return true; }
+
+	if(++shed_count < shed_every){
+		num_spills_shed++;
+		return false;
+	}
+	shed_count = 0;
+
+	// Only change the state once per processed spill, so the queue has time to drain.
+	if(fill_ >= shed_high){ shed_every = std::min(shed_every * 2, maxShedEvery); }
+	else if(fill_ < shed_low && shed_every > 1){ shed_every /= 2; }
+
+	bool traces = (fill_ >= shed_low || shed_every > 1);
+	if(traces != shed_traces){
+		shed_traces = traces;
+		if(core){ core->SetSkipTraces(skip_traces || shed_traces); }
+		if(debug_mode){ std::cout << "debug: " << (shed_traces ? "Skipping" : "Unpacking") << " traces at a queue fill of " << fill_ << std::endl; }
+	}
+	if(shed_traces){ num_spills_untraced++; }
+
+	return true;
+}
+
+std::string ScanInterface::shed_status(){
+	std::stringstream status;
+	if(shed_every > 1){ status << " [SHED 1/" << shed_every << "]"; }
+	else if(shed_traces){ status << " [SHED traces]"; }
+	if(num_spills_recvd > 0){ status << " " << (int)(100.0 * (num_spills_recvd - num_spills_shed) / num_spills_recvd) << "% processed"; }
+	return status.str();
+}
+
+/** Process only one shard of the spills of an input file.
+  * \param[in]  index_ The shard to process, from 0 to count_-1.
+  * \param[in]  count_ The number of shards the spills are divided into.
+  * \return False if index_ is not smaller than count_ and true otherwise.
+  */
+bool ScanInterface::SetSpillShard(unsigned int index_, unsigned int count_){
+	if(index_ >= count_){ return false; }
+	shard_index = index_;
+	shard_count = count_;
+	return true;
+}
+
+/** Shed load in shared memory mode when the scan falls behind poll2.
+  * \param[in]  low_ Fill of the queue (0 to 1) at which the traces are skipped.
+  * \param[in]  high_ Fill of the queue (low_ to 1) at which spills are skipped.
+  * \return False if the fills are not 0 < low_ <= high_ <= 1 and true otherwise.
+  */
+bool ScanInterface::SetLoadShedding(double low_, double high_){
+	if(low_ <= 0 || high_ < low_ || high_ > 1){ return false; }
+	shed_low = low_;
+	shed_high = high_;
+	return true;
+}
+
 /** Add a command line option to the option list.
   * \param[in]  opt_ The option to add to the list.
   * \return Nothing.
@@ -371,9 +1002,19 @@ ScanInterface::ScanInterface(Unpacker *core_/*=NULL*/){
 
 	max_spill_size = 0;
 	file_format = -1;
+	compressed_input = false;
 
 	file_start_offset = 0;
+	start_position = 0;
+	checkpoint_interval = 0;
+	next_checkpoint = 0;
+	resume_mode = false;
+	resume_complete = false;
 	num_spills_recvd = 0;
+	num_spills_recovered = 0;
+	num_spills_shed = 0;
+	num_spills_untraced = 0;
+	lost_buffers.assign(14, 0);
 	
 	total_stopped = true;
 	write_counts = false;
@@ -382,7 +1023,29 @@ ScanInterface::ScanInterface(Unpacker *core_/*=NULL*/){
 	debug_mode = false;
 	dry_run_mode = false;
 	shm_mode = false;
+	shm_ring = false;
+	recover_mode = false;
+	stream_port = POLL2_STREAM_PORT;
+	stream_every = 1;
+	stream_rate = 0;
+	shed_low = 0;
+	shed_high = 0;
+	shed_every = 1;
+	shed_count = 0;
+	shed_traces = false;
+	record_traces = true;
 	batch_mode = false;
+	pool_mode = false;
+	trace_view_mode = false;
+	skip_traces = false;
+	stream_mode = false;
+	mmap_mode = false;
+	index_mode = false;
+	decode_threads = 1;
+	prefetch_depth = 0;
+	pipeline_depth = 0;
+	shard_index = 0;
+	shard_count = 1;
 	scan_init = false;
 	file_open = false;
 
@@ -390,7 +1053,14 @@ ScanInterface::ScanInterface(Unpacker *core_/*=NULL*/){
 	run_ctrl_exit = false;
 
 	poll_server = NULL;
+	spill_shm = NULL;
+	stream_client = NULL;
 	term = NULL;
+
+	map_data = NULL;
+	map_words = 0;
+	map_pos = 0;
+	data_start = 0;
 	
 	// Set the Unpacker pointer, if one is specified.
 	if(core_){ core = core_; }
@@ -398,17 +1068,36 @@ ScanInterface::ScanInterface(Unpacker *core_/*=NULL*/){
 
 	// Push back all of the arguments. Annoying, but we only need to do this once.
 	baseOpts.push_back(optionExt("batch", no_argument, NULL, 'b', "", "Run in batch mode (i.e. with no command line)"));
+	baseOpts.push_back(optionExt("checkpoint", required_argument, NULL, 0, "<sec>", "Write a checkpoint of the scan every <sec> seconds, at the start of a spill"));
 	baseOpts.push_back(optionExt("config", required_argument, NULL, 'c',
 								 "<path>", "Specify path to setup to use for scan"));
 	baseOpts.push_back(optionExt("counts", no_argument, NULL, 0, "", "Write all recorded channel counts to a file"));
 	baseOpts.push_back(optionExt("debug", no_argument, NULL, 0, "", "Enable readout debug mode"));
+	baseOpts.push_back(optionExt("decode-threads", required_argument, NULL, 0, "<N>", "Decode module buffers using N threads (default=1)"));
 	baseOpts.push_back(optionExt("dry-run", no_argument, NULL, 0, "", "Extract spills from file, but do no processing"));
 	baseOpts.push_back(optionExt("fast-fwd", required_argument, NULL, 0, "<word>", "Skip ahead to a specified word in the file (start of file at zero)"));
 	baseOpts.push_back(optionExt("help", no_argument, NULL, 'h', "", "Display this dialogue"));
+	baseOpts.push_back(optionExt("index", no_argument, NULL, 0, "", "Load or build a spill index of .ldf input files for seeking"));
 	baseOpts.push_back(optionExt("input", required_argument, NULL, 'i', "<filename>", "Specifies the input file to analyze"));
+	baseOpts.push_back(optionExt("merge", required_argument, NULL, 0, "<filename>", "Build events across the input file and another .ldf/.pld file (repeatable)"));
+	baseOpts.push_back(optionExt("mmap", no_argument, NULL, 0, "", "Read the input file through a memory mapping"));
+	baseOpts.push_back(optionExt("no-traces", no_argument, NULL, 0, "", "Skip all trace samples (energies and times only)"));
 	baseOpts.push_back(optionExt("output", required_argument, NULL, 'o', "<filename>", "Specifies the name of the output file. Default is \"out\""));
+	baseOpts.push_back(optionExt("resume", no_argument, NULL, 0, "", "Resume the scan from the last checkpoint of the output file"));
+	baseOpts.push_back(optionExt("record", required_argument, NULL, 0, "<filename>", "Record the built raw events to a .rev file, which may be scanned again without unpacking"));
+	baseOpts.push_back(optionExt("record-compact", no_argument, NULL, 0, "", "Leave the traces out of the recorded raw events"));
+	baseOpts.push_back(optionExt("recover", no_argument, NULL, 0, "", "Keep the intact modules of shm spills which are missing network chunks"));
+	baseOpts.push_back(optionExt("pipeline", required_argument, NULL, 0, "<N>", "Process raw events on a separate thread, queueing up to N events"));
+	baseOpts.push_back(optionExt("prefetch", required_argument, NULL, 0, "<N>", "Read up to N spills ahead of the unpacker on a separate thread"));
 	baseOpts.push_back(optionExt("quiet", no_argument, NULL, 'q', "", "Toggle off verbosity flag"));
+	baseOpts.push_back(optionExt("shed", required_argument, NULL, 0, "<low:high>", "Skip traces, then skip shm spills, when the poll2 queue is filled past these fractions"));
+	baseOpts.push_back(optionExt("shard", required_argument, NULL, 0, "<k/N>", "Only process every Nth spill of the input file, starting with spill k"));
 	baseOpts.push_back(optionExt("shm", no_argument, NULL, 's', "", "Enable shared memory readout"));
+	baseOpts.push_back(optionExt("shm-ring", no_argument, NULL, 0, "", "Enable shared memory readout from the local poll2 ring (poll2 --shm-ring)"));
+	baseOpts.push_back(optionExt("stream", no_argument, NULL, 0, "", "Build raw events across spill boundaries"));
+	baseOpts.push_back(optionExt("tcp-every", required_argument, NULL, 0, "<N>", "Ask the poll2 TCP stream for only every Nth spill"));
+	baseOpts.push_back(optionExt("tcp-rate", required_argument, NULL, 0, "<MB/s>", "Ask the poll2 TCP stream for at most this data rate"));
+	baseOpts.push_back(optionExt("tcp-stream", required_argument, NULL, 0, "<host[:port]>", "Enable shared memory readout from a poll2 TCP stream (poll2 --tcp-stream)"));
 	baseOpts.push_back(optionExt("version", no_argument, NULL, 'v', "", "Display version information"));
 
 	optstr = "bc:hi:o:qsv";
@@ -447,16 +1136,110 @@ void ScanInterface::RunControl(){
 			usleep(0.1);
 			continue;
 		}
+		else if(shm_mode && (shm_ring || !stream_host.empty())){
+			std::cout << std::endl;
+			std::vector<unsigned int> data; // Spills arrive whole from the ring or the TCP stream.
+			unsigned long dropped;
+			unsigned long skipped = 0;
+			double fill; // Fill of the ring or of the socket buffer, from 0 to 1.
+			int nWords;
+
+			while(true){
+				if(kill_all == true){ 
+					break;
+				}
+				else if(!is_running){
+					IdleTask();
+					usleep(100000); //0.1 seconds
+					continue;
+				}
+
+				// Map the ring, or connect to the stream, once poll2 is up.
+				if(shm_ring ? !spill_shm->IsOpen() : !stream_client->IsOpen()){
+					if(shm_ring ? !spill_shm->Open(POLL2_SHM_NAME) : !stream_client->Init(stream_host.c_str(), stream_port)){
+						if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Waiting for poll2..."); }
+						else{ std::cout << "\r\033[0;33m[IDLE]\033[0m Waiting for poll2..."; }
+						IdleTask();
+						usleep(100000); //0.1 seconds
+						continue;
+					}
+					if(shm_ring){
+						if(debug_mode){ std::cout << "debug: Mapped shared memory ring with " << spill_shm->GetSlotWords() << " word slots\n"; }
+						data.resize(spill_shm->GetSlotWords() + 2); // Leave room for the end of spill words.
+					}
+					else{
+						if(debug_mode){ std::cout << "debug: Connected to poll2 stream at " << stream_host << ":" << stream_port << std::endl; }
+						if((stream_every > 1 || stream_rate > 0) && !stream_client->Subscribe(stream_every, stream_rate)){
+							std::cout << msgHeader << "Failed to send the TCP stream subscription!\n";
+						}
+					}
+				}
+
+				if(shm_ring){
+					nWords = spill_shm->Read(data.data(), spill_shm->GetSlotWords());
+					dropped = spill_shm->GetDropped();
+					fill = (double)spill_shm->GetBacklog() / std::max(spill_shm->GetSlots(), 1u);
+				}
+				else{
+					nWords = stream_client->Read(data, 100);
+					dropped = stream_client->GetDropped();
+					skipped = stream_client->GetSkipped();
+					fill = (double)stream_client->GetQueued() / std::max(stream_client->GetBufferSize(), 1);
+				}
+
+				if(nWords < 0){ // poll2 closed the ring or the stream. Wait for the next one.
+					std::cout << msgHeader << "Spill source closed by poll2 (" << dropped << " spills dropped).\n";
+					if(shm_ring){ spill_shm->Close(); }
+					else{ stream_client->Close(); }
+					continue;
+				}
+				else if(nWords == 0){
+					if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Waiting for a spill..."); }
+					else{ std::cout << "\r\033[0;33m[IDLE]\033[0m Waiting for a spill..."; }
+					IdleTask();
+					if(shm_ring){ usleep(1000); }
+					continue;
+				}
+
+				bool process = shed_load(fill);
+
+				std::stringstream status;
+				status << "\033[0;32m" << "[RECV] " << "\033[0m" << nWords << " words (" << dropped << " spills dropped";
+				if(skipped > 0){ status << ", " << skipped << " skipped"; }
+				status << ")";
+				if(shed_low > 0){ status << shed_status(); }
+				if(!batch_mode){ term->SetStatus(status.str()); }
+				else{ std::cout << "\r" << status.str(); }
+
+				if(debug_mode){ std::cout << "debug: Retrieved spill of " << nWords << " words (" << nWords*4 << " bytes)\n"; }
+				if(!dry_run_mode && process){ 
+					if(data.size() < (size_t)nWords + 2){ data.resize(nWords + 2); }
+					data[nWords] = 2;
+					data[nWords+1] = 9999;
+					core->SetSpillNumber(num_spills_recvd);
+					core->ReadSpill(data.data(), nWords + 2, is_verbose); 
+					IdleTask();
+				}
+				num_spills_recvd++;
+			}
+		}
 		else if(shm_mode){
 			std::cout << std::endl;
-			unsigned int data[250000]; // Array for storing spill data. Larger than any RevF spill should be.
-			unsigned int *shm_data = new unsigned int[maxShmSizeL]; // Array to store the temporary shm data (~16 kB)
+			unsigned int *data; // The spill data, in the spill buffer which grows to fit the spill.
+			unsigned int *shm_batch = new unsigned int[maxShmSizeL * POLL2_SOCKET_BATCH]; // Array to store a batch of shm packets (~1 MB)
+			unsigned int *shm_data; // The current shm packet
+			int batchLengths[POLL2_SOCKET_BATCH]; // Length of each packet in the batch (in bytes)
+			int batchCount = 0; // Number of packets in the batch
+			int batchPos = 0; // Next unread packet in the batch
 			int dummy;
 			int previous_chunk;
 			int current_chunk;
 			int total_chunks;
 			int nWords;
 			unsigned int nTotalWords;
+			const unsigned int chunkWords = maxShmSizeL - 2; // Spill words in every chunk but the last
+			std::vector<bool> goodChunks; // Chunks of the spill which were received, used in recovery mode
+			bool fragmented; // Set to true if a chunk of the spill was missed
 	
 			bool full_spill = false;
 		
@@ -476,25 +1259,39 @@ void ScanInterface::RunControl(){
 				total_chunks = -1;
 				nTotalWords = 0;
 				full_spill = true;
+				fragmented = false;
+				goodChunks.clear();
 
-				if(!poll_server->Select(dummy)){
+				// Packets left over from the last batch belong to the next spill.
+				if(batchPos >= batchCount && !poll_server->Select(dummy)){
 					if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Waiting for a spill..."); }
 					else{ std::cout << "\r\033[0;33m[IDLE]\033[0m Waiting for a spill..."; }
 					IdleTask();
 					continue; 
 				}
 		
-				if(!poll_server->Select(select_dummy)){ continue; } // Server timeout
+				if(batchPos >= batchCount && !poll_server->Select(select_dummy)){ continue; } // Server timeout
 		
 				// Get the spill
 				while(current_chunk != total_chunks){
-					if(!poll_server->Select(select_dummy)){ // Server timeout
-						std::cout << msgHeader << "Network timeout before recv full spill!\n";
-						full_spill = false;
-						break;
-					} 
+					if(batchPos >= batchCount){ // Read the next batch of packets from the socket
+						if(!poll_server->Select(select_dummy)){ // Server timeout
+							std::cout << msgHeader << "Network timeout before recv full spill!\n";
+							full_spill = false;
+							break;
+						} 
 
-					nWords = poll_server->RecvMessage((char*)shm_data, maxShmSize) / 4; // Read from the socket
+						batchCount = poll_server->RecvMessages((char*)shm_batch, maxShmSize, batchLengths, POLL2_SOCKET_BATCH);
+						batchPos = 0;
+						if(batchCount <= 0){
+							batchCount = 0;
+							continue;
+						}
+					}
+
+					shm_data = &shm_batch[batchPos * maxShmSizeL];
+					nWords = batchLengths[batchPos++] / 4;
+					if(batchLengths[batchPos-1] < (int)maxShmSize){ ((char*)shm_data)[batchLengths[batchPos-1]] = '\0'; } // Terminate the poll2 network flags
 					if(strcmp((char*)shm_data, "$CLOSE_FILE") == 0 || strcmp((char*)shm_data, "$OPEN_FILE") == 0 || strcmp((char*)shm_data, "$KILL_SOCKET") == 0){ continue; } // Poll2 network flags
 					// Did not read enough bytes
 					else if(nWords < 2){
@@ -505,6 +1302,28 @@ void ScanInterface::RunControl(){
 					memcpy((char *)&current_chunk, &shm_data[0], 4);
 					memcpy((char *)&total_chunks, &shm_data[1], 4);
 
+					if(recover_mode){
+						if(current_chunk <= previous_chunk || total_chunks <= 0 || !spillBuffer.Reserve((size_t)total_chunks * chunkWords + 2, nTotalWords)){ // The next spill has started, keep this chunk for it
+							if(current_chunk <= previous_chunk){ batchPos--; }
+							fragmented = true;
+							break;
+						}
+						if(current_chunk != previous_chunk + 1){
+							if(debug_mode){ std::cout << "debug: Found chunk " << current_chunk << " but expected chunk " << previous_chunk+1 << std::endl; }
+							fragmented = true;
+						}
+						previous_chunk = current_chunk;
+
+						// Every chunk but the last is full, so put this chunk at its place in the spill.
+						if(goodChunks.size() < (size_t)total_chunks){ goodChunks.resize(total_chunks, false); }
+						unsigned int offset = (current_chunk - 1) * chunkWords;
+						unsigned int length = std::min((unsigned int)(nWords - 2), chunkWords);
+						memcpy(&spillBuffer.Data()[offset], &shm_data[2], length*4);
+						goodChunks[current_chunk-1] = true;
+						nTotalWords = std::max(nTotalWords, offset + length);
+						continue;
+					}
+
 					if(previous_chunk == -1 && current_chunk != 1){ // Started reading in the middle of a spill, ignore the rest of it
 						if(debug_mode){ std::cout << "debug: Skipping chunk " << current_chunk << " of " << total_chunks << std::endl; }
 						continue;
@@ -517,8 +1336,8 @@ void ScanInterface::RunControl(){
 					previous_chunk = current_chunk;
 		
 					// Copy the shm spill chunk into the data array
-					if(nTotalWords + 2 + nWords <= 250000){ // This spill chunk will fit into the data buffer
-						memcpy(&data[nTotalWords], &shm_data[2], (nWords - 2)*4);
+					if(spillBuffer.Reserve(nTotalWords + nWords, nTotalWords)){ // Grow the spill buffer to fit the chunk and the end of spill words
+						memcpy(&spillBuffer.Data()[nTotalWords], &shm_data[2], (nWords - 2)*4);
 						nTotalWords += (nWords - 2);				
 					}
 					else{ 
@@ -527,16 +1346,38 @@ void ScanInterface::RunControl(){
 					}
 				}
 
+				// Leave room for the end of spill words, even if nothing was received.
+				spillBuffer.Reserve(nTotalWords + 2, nTotalWords);
+				data = spillBuffer.Data();
+
+				// Keep what was received of a fragmented spill.
+				if(recover_mode && !goodChunks.empty()){
+					if(!full_spill || current_chunk != total_chunks){ fragmented = true; }
+					if(fragmented){
+						if(!goodChunks.back()){ nTotalWords = goodChunks.size() * chunkWords; } // The length of the last chunk is unknown
+						for(size_t chunk = 0; chunk < goodChunks.size(); chunk++){
+							if(!goodChunks[chunk]){ std::fill(&data[chunk * chunkWords], &data[std::min((unsigned int)(chunk + 1) * chunkWords, nTotalWords)], 0); }
+						}
+						if(debug_mode){ std::cout << "debug: Recovering spill with " << std::count(goodChunks.begin(), goodChunks.end(), false) << " of " << goodChunks.size() << " chunks missing\n"; }
+						nTotalWords = recover_spill(data, nTotalWords, goodChunks, chunkWords);
+					}
+					full_spill = true;
+				}
+
+				bool process = (!full_spill || shed_load((double)poll_server->GetQueued() / std::max(poll_server->GetBufferSize(), 1)));
+
 				std::stringstream status;
 				status << "\033[0;32m" << "[RECV] " << "\033[0m" << nTotalWords << " words";
+				if(shed_low > 0){ status << shed_status(); }
 				if(!batch_mode){ term->SetStatus(status.str()); }
 				else{ std::cout << "\r" << status.str(); }
 		
 				if(debug_mode){ std::cout << "debug: Retrieved spill of " << nTotalWords << " words (" << nTotalWords*4 << " bytes)\n"; }
-				if(!dry_run_mode && full_spill){ 
+				if(!dry_run_mode && full_spill && process){ 
 					int word1 = 2, word2 = 9999;
 					memcpy(&data[nTotalWords], (char *)&word1, 4);
 					memcpy(&data[nTotalWords+1], (char *)&word2, 4);
+					core->SetSpillNumber(num_spills_recvd);
 					core->ReadSpill(data, nTotalWords + 2, is_verbose); 
 					IdleTask();
 				}
@@ -545,18 +1386,35 @@ void ScanInterface::RunControl(){
 				else{ num_spills_recvd++; }
 			}
 		
-			delete[] shm_data;
+			delete[] shm_batch;
+		}
+		else if(!merge_filenames.empty()){
+			read_merged();
 		}
 		else if(file_format == 0){
-			unsigned int *data = NULL;
 			bool full_spill;
 			bool bad_spill;
 			unsigned int nBytes;
+			bool prefetch = (prefetch_depth > 0 && !map_data);
 		
-			if(!dry_run_mode){ data = new unsigned int[250000]; }
-		
-			// Reset the buffer reader to default values.
+			// Reset the buffer reader to default values, starting at the resumed spill, if any.
 			databuff.Reset();
+			if(start_position != 0){
+				databuff.SetStartPosition(start_position);
+				start_position = 0;
+			}
+
+			// Used by the read-ahead thread to read each spill.
+			SpillPrefetcher::ReadFunction ldfReader = [this](SpillPrefetcher::Spill &spill_) -> bool {
+				spill_.good = databuff.Read(&input_file, spill_.data, spill_.nBytes, spill_.full_spill, spill_.bad_spill, dry_run_mode);
+				spill_.retval = databuff.GetRetval();
+				spill_.numChunks = databuff.GetNumChunks();
+				spill_.numMissing = databuff.GetNumMissing();
+				spill_.spillOffset = databuff.GetSpillOffset();
+				spill_.spillPosition = databuff.GetSpillPosition();
+				spill_.position = input_file.tellg();
+				return (spill_.good || (spill_.retval != 2 && spill_.retval != 6));
+			};
 		
 			while(true){ 
 				if(kill_all == true){ 
@@ -568,72 +1426,173 @@ void ScanInterface::RunControl(){
 					continue;
 				}
 
-				if(!databuff.Read(&input_file, (char*)data, nBytes, 1000000, full_spill, bad_spill, dry_run_mode)){
-					if(databuff.GetRetval() == 1){
+				bool readOk;
+				int readRetval;
+				unsigned int numChunks, numMissing;
+				size_t spillOffset;
+				unsigned int spillPosition;
+				std::streampos filePos;
+				unsigned int *spillData;
+				SpillPrefetcher::Spill *prefetched = NULL;
+				if(prefetch){
+					if(!prefetcher.IsActive()){ prefetcher.Start(prefetch_depth, ldfReader); }
+					if(!(prefetched = prefetcher.Front())){
+						if(prefetcher.IsFinished()){ break; }
+						continue; // The reader was stopped (e.g. by a rewind).
+					}
+					readOk = prefetched->good;
+					spillData = prefetched->data.Data();
+					nBytes = prefetched->nBytes;
+					full_spill = prefetched->full_spill;
+					bad_spill = prefetched->bad_spill;
+					readRetval = prefetched->retval;
+					numChunks = prefetched->numChunks;
+					numMissing = prefetched->numMissing;
+					spillOffset = prefetched->spillOffset;
+					spillPosition = prefetched->spillPosition;
+					filePos = prefetched->position;
+				}
+				else{
+					if(map_data){ readOk = databuff.Read(map_data, map_words, map_pos, spillBuffer, nBytes, full_spill, bad_spill, dry_run_mode); }
+					else{ readOk = databuff.Read(&input_file, spillBuffer, nBytes, full_spill, bad_spill, dry_run_mode); }
+					spillData = spillBuffer.Data();
+					readRetval = databuff.GetRetval();
+					numChunks = databuff.GetNumChunks();
+					numMissing = databuff.GetNumMissing();
+					spillOffset = databuff.GetSpillOffset();
+					spillPosition = databuff.GetSpillPosition();
+					filePos = get_file_position();
+				}
+				if(!readOk){
+					bool end_of_file = false;
+					if(readRetval == 1){
 						if(debug_mode){ std::cout << "debug: Encountered single EOF buffer (end of run).\n"; }
 					}
-					else if(databuff.GetRetval() == 2){
+					else if(readRetval == 2){
 						if(debug_mode){ std::cout << "debug: Encountered double EOF buffer (end of file).\n"; }
-						break;
+						end_of_file = true;
 					}
-					else if(databuff.GetRetval() == 3){
+					else if(readRetval == 3){
 						if(debug_mode){ std::cout << "debug: Encountered unknown ldf buffer type.\n"; }
 					}
-					else if(databuff.GetRetval() == 4){
+					else if(readRetval == 4){
 						if(debug_mode){ std::cout << "debug: Encountered invalid spill chunk.\n"; }
 					}
-					else if(databuff.GetRetval() == 5){
+					else if(readRetval == 5){
 						if(debug_mode){ std::cout << "debug: Received bad spill footer size.\n"; }
 					}
-					else if(databuff.GetRetval() == 6){
+					else if(readRetval == 6){
 						if(debug_mode){ std::cout << "debug: Failed to read buffer from input file.\n"; }
-						break;
+						end_of_file = true;
+					}
+					else if(readRetval == 7){
+						std::cout << " WARNING: Spill is too large to be read, skipping (at word " << filePos/4 << " in file)!\n";
 					}
+					if(prefetched){ prefetcher.Pop(); }
+					if(end_of_file){ break; }
 					continue;
 				}
 
 				std::stringstream status;			
-				status << "\033[0;32m" << "[READ] " << "\033[0m" << nBytes/4 << " words (" << 100*input_file.tellg()/file_length << "%), ";
-				status << "GOOD = " << databuff.GetNumChunks() << ", LOST = " << databuff.GetNumMissing();
+				status << "\033[0;32m" << "[READ] " << "\033[0m" << nBytes/4 << " words (" << 100*filePos/file_length << "%), ";
+				status << "GOOD = " << numChunks << ", LOST = " << numMissing;
+				if(prefetch){
+					status << ", QUEUE = " << prefetcher.GetQueueDepth() << "/" << prefetcher.GetCapacity();
+					status << ", DISK WAIT = " << prefetcher.GetConsumerStalls() << ", CPU WAIT = " << prefetcher.GetReaderStalls();
+				}
 				if(!batch_mode){ term->SetStatus(status.str()); }
 				else{ std::cout << "\r" << status.str(); }
 		
 				if(full_spill){ 
 					if(debug_mode){ 
 						std::cout << "debug: Retrieved spill of " << nBytes << " bytes (" << nBytes/4 << " words)\n"; 
-						std::cout << "debug: Read up to word number " << input_file.tellg()/4 << " in input file\n";
+						std::cout << "debug: Read up to word number " << filePos/4 << " in input file\n";
 					}
 					if(!dry_run_mode){ 
 						if(!bad_spill){ 
-							core->ReadSpill(data, nBytes/4, is_verbose); 
+							if(checkpoint_due()){ write_checkpoint(spillOffset, spillPosition); }
+
+							// Let the Unpacker skip the whole spill if it does not want any of its events.
+							size_t spillNum;
+							unsigned long long startTime, stopTime;
+							if(!spillIndex.empty() && spillIndex.FindSpill(spillOffset, spillPosition, spillNum) && 
+							   spillIndex.GetTimeRange(spillNum, startTime, stopTime) && core->SkipSpill(startTime, stopTime)){
+								if(debug_mode){ std::cout << "debug: Skipping spill no. " << spillNum << " of spill index\n"; }
+							}
+							else if(in_shard()){
+								core->SetSpillNumber(num_spills_recvd);
+								core->ReadSpill(spillData, nBytes/4, is_verbose);
+							}
 							IdleTask();
 						}
-						else{ std::cout << " WARNING: Spill has been flagged as corrupt, skipping (at word " << input_file.tellg()/4 << " in file)!\n"; }
+						else{ std::cout << " WARNING: Spill has been flagged as corrupt, skipping (at word " << filePos/4 << " in file)!\n"; }
 					}
 				}
 				else if(debug_mode){ 
 					std::cout << "debug: Retrieved spill fragment of " << nBytes << " bytes (" << nBytes/4 << " words)\n"; 
-					std::cout << "debug: Read up to word number " << input_file.tellg()/4 << " in input file\n";
+					std::cout << "debug: Read up to word number " << filePos/4 << " in input file\n";
 				}
+				if(prefetched){ prefetcher.Pop(); }
 				num_spills_recvd++;
 			}
 
-			if(!dry_run_mode){ delete[] data; }
+			prefetcher.Stop();
 		
 			if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Finished scanning file."); }
 			else{ std::cout << std::endl << std::endl; }
 		}
 		else if(file_format == 1){
-			unsigned int *data = NULL;
 			unsigned int nBytes;
-		
-			if(!dry_run_mode){ data = new unsigned int[max_spill_size+2]; }
+			bool prefetch = ((prefetch_depth > 0 || compressed_input) && !map_data);
+			bool found_eof = false;
+
+			// Compressed spills are always inflated on the read-ahead thread.
+			unsigned int depth = (prefetch_depth > 0 ? prefetch_depth : 2);
 		
 			// Reset the buffer reader to default values.
 			pldData.Reset();
+
+			// Used by the read-ahead thread to read each spill. The end of file
+			// buffer is checked by the reader once no more spills can be read.
+			SpillPrefetcher::ReadFunction pldReader = [this](SpillPrefetcher::Spill &spill_) -> bool {
+				spill_.spillOffset = input_file.tellg()/4;
+				spill_.good = pldData.Read(&input_file, spill_.data, spill_.nBytes, dry_run_mode);
+				spill_.position = input_file.tellg();
+				if(!spill_.good){ spill_.retval = (eofbuff.ReadHeader(&input_file) ? 1 : 0); }
+				return spill_.good;
+			};
 		
-			while(pldData.Read(&input_file, (char*)data, nBytes,
-							   4*max_spill_size, dry_run_mode)){
+			const unsigned int *spill = NULL;
+			SpillPrefetcher::Spill *prefetched = NULL;
+			while(true){
+				bool readOk;
+				size_t spillOffset; // Word offset of the start of the spill in the file.
+				if(prefetch){
+					if(!prefetcher.IsActive()){ prefetcher.Start(depth, pldReader); }
+					if(!(prefetched = prefetcher.Front())){
+						if(kill_all == true || prefetcher.IsFinished()){ break; }
+						continue; // The reader was stopped (e.g. by a rewind).
+					}
+					readOk = prefetched->good;
+					spill = prefetched->data.Data();
+					nBytes = prefetched->nBytes;
+					spillOffset = prefetched->spillOffset;
+					if(!readOk){
+						found_eof = (prefetched->retval == 1);
+						prefetcher.Pop();
+					}
+				}
+				else if(map_data){
+					spillOffset = map_pos;
+					readOk = pldData.Read(map_data, map_words, map_pos, spill, nBytes, 4*SpillBuffer::maxWords);
+				}
+				else{
+					spillOffset = get_file_position()/4;
+					readOk = pldData.Read(&input_file, spillBuffer, nBytes, dry_run_mode);
+					spill = spillBuffer.Data();
+				}
+				if(!readOk){ break; }
+
 				if(kill_all == true){ 
 					break;
 				}
@@ -643,40 +1602,85 @@ void ScanInterface::RunControl(){
 					continue;
 				}
 
+				std::streampos filePos = (prefetched ? prefetched->position : get_file_position());
+
 				std::stringstream status;
-				status << "\033[0;32m" << "[READ] " << "\033[0m" << nBytes/4 << " words (" << 100*input_file.tellg()/file_length << "%)";
+				status << "\033[0;32m" << "[READ] " << "\033[0m" << nBytes/4 << " words (" << 100*filePos/file_length << "%)";
+				if(prefetch){
+					status << ", QUEUE = " << prefetcher.GetQueueDepth() << "/" << prefetcher.GetCapacity();
+					status << ", DISK WAIT = " << prefetcher.GetConsumerStalls() << ", CPU WAIT = " << prefetcher.GetReaderStalls();
+				}
 				if(!batch_mode){ term->SetStatus(status.str()); }
 				else{ std::cout << "\r" << status.str(); }
 		
 				if(debug_mode){ 
 					std::cout << "debug: Retrieved spill of " << nBytes << " bytes (" << nBytes/4 << " words)\n"; 
-					std::cout << "debug: Read up to word number " << input_file.tellg()/4 << " in input file\n";
+					std::cout << "debug: Read up to word number " << filePos/4 << " in input file\n";
 				}
 			
-				if(!dry_run_mode){ 
+				if(checkpoint_due()){ write_checkpoint(spillOffset, 0); }
+
+				if(!dry_run_mode && in_shard()){ 
 					int word1 = 2, word2 = 9999;
-					memcpy(&data[(nBytes/4)], (char *)&word1, 4);
-					memcpy(&data[(nBytes/4)+1], (char *)&word2, 4);
-					core->ReadSpill(data, nBytes/4 + 2, is_verbose); 
+					size_t spillEnd = (map_data ? (spill - map_data) + nBytes/4 : 0);
+					if(map_data && spillEnd + 2 <= map_words){
+						// Terminate the spill in place. The two words following the spill
+						// (end of buffer and the next buffer header) are restored afterwards.
+						unsigned int *spillData = map_data + (spill - map_data);
+						unsigned int savedWords[2] = { map_data[spillEnd], map_data[spillEnd+1] };
+						memcpy(&map_data[spillEnd], (char *)&word1, 4);
+						memcpy(&map_data[spillEnd+1], (char *)&word2, 4);
+						core->SetSpillNumber(num_spills_recvd);
+						core->ReadSpill(spillData, nBytes/4 + 2, is_verbose); 
+						map_data[spillEnd] = savedWords[0];
+						map_data[spillEnd+1] = savedWords[1];
+					}
+					else{
+						unsigned int *spillData = spillBuffer.Data();
+						if(prefetched){ spillData = prefetched->data.Data(); }
+						else if(map_data){
+							spillBuffer.Reserve(nBytes/4 + 2);
+							spillData = spillBuffer.Data();
+							memcpy(spillData, spill, nBytes);
+						}
+						memcpy(&spillData[(nBytes/4)], (char *)&word1, 4);
+						memcpy(&spillData[(nBytes/4)+1], (char *)&word2, 4);
+						core->SetSpillNumber(num_spills_recvd);
+						core->ReadSpill(spillData, nBytes/4 + 2, is_verbose); 
+					}
 					IdleTask();
 				}
+				if(prefetched){ prefetcher.Pop(); }
 				num_spills_recvd++;
 			}
 
-			if(eofbuff.ReadHeader(&input_file)){
+			if(prefetch){
+				prefetcher.Stop();
+			}
+			else if(map_data){ found_eof = eofbuff.ReadHeader(map_data, map_words, map_pos); }
+			else{ found_eof = eofbuff.ReadHeader(&input_file); }
+
+			if(found_eof){
 				std::cout << msgHeader << "Encountered EOF buffer.\n";
 			}
 			else{
 				std::cout << msgHeader << "Failed to find end of file buffer!\n";
 			}
 		
-			if(!dry_run_mode){ delete[] data; }
-		
 			if(!batch_mode){ term->SetStatus("\033[0;33m[IDLE]\033[0m Finished scanning file."); }
 			else{ std::cout << std::endl << std::endl; }
 		}
 		else if(file_format == 2){
 		}
+		else if(file_format == 3){
+			replay_events();
+		}
+
+		// Build any events which are still being held over for the next spill.
+		if(!dry_run_mode){ core->FlushEvents(); }
+
+		// A scan which reached the end of the file is not scanned again when resumed.
+		if(checkpoint_interval > 0 && !dry_run_mode && !kill_all && !shm_mode){ write_checkpoint(file_length/4, 0, true); }
 
 		// Notify that the scan has completed.
 		Notify("SCAN_COMPLETE");
@@ -738,7 +1742,7 @@ void ScanInterface::CmdControl(){
 		std::vector<std::string> arguments;
 		unsigned int p_args = split_str(arg, arguments);
 		
-		if(cmd == "quit" || cmd == "exit"){
+		if(cmd == "quit" || cmd == "exit" || cmd == "end"){
 			stop_scan();
 			kill_all = true;
 			while(!run_ctrl_exit){ sleep(1); }
@@ -754,17 +1758,21 @@ void ScanInterface::CmdControl(){
 			std::cout << "  Help:\n";
 			std::cout << "   debug           - Toggle debug mode flag (default=false)\n";
 			std::cout << "   quiet           - Toggle quiet mode flag (default=false)\n";
-			std::cout << "   quit            - Close the program\n";
+			std::cout << "   quit (end)      - Close the program\n";
 			std::cout << "   help (h)        - Display this dialogue\n";
 			std::cout << "   version (v)     - Display Poll2 version information\n";
-			std::cout << "   run             - Start acquisition\n";
+			std::cout << "   run (go)        - Start acquisition\n";
 			std::cout << "   stop            - Stop acquisition\n";
 			std::cout << "   file <filename> - Load an input file\n";
 			std::cout << "   rewind [offset] - Rewind to the beginning of the file\n";
+			std::cout << "   index           - Build the spill index of the input file\n";
+			std::cout << "   spill <number>  - Seek to a spill in the spill index\n";
+			std::cout << "   seek <time>     - Seek to the spill containing a time (in clock ticks)\n";
 			std::cout << "   sync            - Wait for the current run to finish\n";
+			std::cout << "   perf [reset]    - Print (or zero) the time spent in each stage of the scan, and its memory\n";
 			CmdHelp("   ");
 		}
-		else if(cmd == "run"){ // Start acquisition.
+		else if(cmd == "run" || cmd == "go"){ // Start acquisition.
 			start_scan();
 		}
 		else if(cmd == "stop"){ // Stop acquisition.
@@ -806,6 +1814,27 @@ void ScanInterface::CmdControl(){
 			if(p_args > 0){ rewind(strtoul(arguments.at(0).c_str(), NULL, 0)); }
 			else{ rewind(); }
 		}
+		else if(cmd == "index"){ // Build the spill index of the input file
+			if(is_running){ std::cout << msgHeader << "Cannot build spill index while scan is running!\n"; }
+			else if(!file_open || file_format != 0){ std::cout << msgHeader << "A spill index requires an input .ldf file.\n"; }
+			else if(build_index() && !spillIndex.Write(SpillIndex::GetIndexFilename(prefix + "." + extension))){
+				std::cout << msgHeader << "WARNING! Failed to write spill index file.\n";
+			}
+		}
+		else if(cmd == "spill"){ // Seek to a spill in the spill index
+			if(p_args > 0){ seek_spill(strtoul(arguments.at(0).c_str(), NULL, 0)); }
+			else{
+				std::cout << msgHeader << "Invalid number of parameters to 'spill'\n";
+				std::cout << msgHeader << " -SYNTAX- spill <number>\n";
+			}
+		}
+		else if(cmd == "seek"){ // Seek to the spill containing a given time
+			if(p_args > 0){ seek_time(strtoull(arguments.at(0).c_str(), NULL, 0)); }
+			else{
+				std::cout << msgHeader << "Invalid number of parameters to 'seek'\n";
+				std::cout << msgHeader << " -SYNTAX- seek <time>\n";
+			}
+		}
 		else if(cmd == "sync"){ // Wait until the current run is completed.
 			if(is_running){
 				std::cout << msgHeader << "Waiting for current scan to complete.\n";
@@ -813,6 +1842,13 @@ void ScanInterface::CmdControl(){
 			}
 			else{ std::cout << msgHeader << "Scan is not running.\n"; }
 		}
+		else if(cmd == "perf"){ // Print the time spent in each stage of the scan and the memory of its subsystems
+			if(p_args > 0 && arguments.at(0) == "reset"){
+				core->GetPerf().Zero();
+				std::cout << msgHeader << "Reset the stage timers.\n";
+			}
+			else{ core->GetPerf().Print(std::cout); }
+		}
 		else if(!ExtraCommands(cmd, arguments)){ // Unrecognized command. Send it to a derived object.
 			std::cout << msgHeader << "Unknown command '" << cmd << "'\n";
 		}
@@ -866,12 +1902,90 @@ bool ScanInterface::Setup(int argc, char *argv[]){
 			else if(strcmp("debug", longOpts[idx].name) == 0 ) {
 				debug_mode = true;
 			}
+			else if(strcmp("decode-threads", longOpts[idx].name) == 0) {
+				decode_threads = strtoul(optarg, NULL, 0);
+			}
 			else if(strcmp("dry-run", longOpts[idx].name) == 0) {
 				dry_run_mode = true;
 			}
 			else if(strcmp("fast-fwd", longOpts[idx].name) == 0) {
 				file_start_offset = atoll(optarg);
 			}
+			else if(strcmp("merge", longOpts[idx].name) == 0) {
+				merge_filenames.push_back(optarg);
+			}
+			else if(strcmp("mmap", longOpts[idx].name) == 0) {
+				mmap_mode = true;
+			}
+			else if(strcmp("index", longOpts[idx].name) == 0) {
+				index_mode = true;
+			}
+			else if(strcmp("no-traces", longOpts[idx].name) == 0) {
+				skip_traces = true;
+			}
+			else if(strcmp("shm-ring", longOpts[idx].name) == 0) {
+				file_format = 0;
+				shm_mode = true;
+				shm_ring = true;
+			}
+			else if(strcmp("tcp-every", longOpts[idx].name) == 0) {
+				stream_every = strtoul(optarg, NULL, 0);
+			}
+			else if(strcmp("tcp-rate", longOpts[idx].name) == 0) {
+				stream_rate = strtod(optarg, NULL);
+			}
+			else if(strcmp("tcp-stream", longOpts[idx].name) == 0) {
+				file_format = 0;
+				shm_mode = true;
+				stream_host = optarg;
+				size_t colon = stream_host.find(':');
+				if(colon != std::string::npos){
+					stream_port = atoi(stream_host.substr(colon+1).c_str());
+					stream_host = stream_host.substr(0, colon);
+				}
+			}
+			else if(strcmp("recover", longOpts[idx].name) == 0) {
+				recover_mode = true;
+			}
+			else if(strcmp("pipeline", longOpts[idx].name) == 0) {
+				pipeline_depth = strtoul(optarg, NULL, 0);
+			}
+			else if(strcmp("shard", longOpts[idx].name) == 0) {
+				char *slash = NULL;
+				unsigned int index = strtoul(optarg, &slash, 0);
+				unsigned int count = (slash && *slash == '/' ? strtoul(slash+1, NULL, 0) : 0);
+				if(!SetSpillShard(index, count)){
+					std::cout << msgHeader << "Invalid spill shard (" << optarg << "), expected k/N with k < N.\n";
+					return false;
+				}
+			}
+			else if(strcmp("shed", longOpts[idx].name) == 0) {
+				char *colon = NULL;
+				double low = strtod(optarg, &colon);
+				double high = (colon && *colon == ':' ? strtod(colon+1, NULL) : 0);
+				if(!SetLoadShedding(low, high)){
+					std::cout << msgHeader << "Invalid load shedding fills (" << optarg << "), expected low:high with 0 < low <= high <= 1.\n";
+					return false;
+				}
+			}
+			else if(strcmp("record", longOpts[idx].name) == 0) {
+				record_fname = optarg;
+			}
+			else if(strcmp("record-compact", longOpts[idx].name) == 0) {
+				record_traces = false;
+			}
+			else if(strcmp("prefetch", longOpts[idx].name) == 0) {
+				prefetch_depth = strtoul(optarg, NULL, 0);
+			}
+			else if(strcmp("stream", longOpts[idx].name) == 0) {
+				stream_mode = true;
+			}
+			else if(strcmp("checkpoint", longOpts[idx].name) == 0) {
+				checkpoint_interval = strtoul(optarg, NULL, 0);
+			}
+			else if(strcmp("resume", longOpts[idx].name) == 0) {
+				resume_mode = true;
+			}
 			else{
 				for(std::vector<optionExt>::iterator iter = userOpts.begin(); iter != userOpts.end(); iter++){
 					if(strcmp(iter->name, longOpts[idx].name) == 0){
@@ -913,6 +2027,8 @@ bool ScanInterface::Setup(int argc, char *argv[]){
 				case 'v' :
 					std::cout << "  " << PROG_NAME << "	  v" << SCAN_VERSION << " (" << SCAN_DATE << ")\n" ;
 					std::cout << "  Poll2 Socket  v" << POLL2_SOCKET_VERSION << " (" << POLL2_SOCKET_DATE << ")\n";
+					std::cout << "  Poll2 Shm     v" << POLL2_SHM_VERSION << " (" << POLL2_SHM_DATE << ")\n";
+					std::cout << "  Poll2 Stream  v" << POLL2_STREAM_VERSION << " (" << POLL2_STREAM_DATE << ")\n";
 					std::cout << "  HRIBF Buffers v" << HRIBF_BUFFERS_VERSION << " (" << HRIBF_BUFFERS_DATE << ")\n";
 					std::cout << "  CTerminal	 v" << CTERMINAL_VERSION << " (" << CTERMINAL_DATE << ")\n";
 					return false;
@@ -941,6 +2057,47 @@ bool ScanInterface::Setup(int argc, char *argv[]){
 	if(debug_mode)
 		core->SetDebugMode();
 
+	if(pool_mode)
+		core->SetPoolMode();
+
+	if(trace_view_mode)
+		core->SetTraceViewMode();
+
+	if(skip_traces)
+		core->SetSkipTraces();
+
+	// Events can only be built across merged files in stream mode.
+	if(!merge_filenames.empty()){
+		stream_mode = true;
+		if(shard_count > 1 || index_mode || mmap_mode){ std::cout << msgHeader << "WARNING! Sharding, indexing and mapping are not used for merged input files.\n"; }
+	}
+
+	// Checkpoints are only written at the spills of a single input file.
+	if((checkpoint_interval > 0 || resume_mode) && (shm_mode || !merge_filenames.empty())){
+		std::cout << msgHeader << "WARNING! Checkpoints are not used in shared memory mode or for merged input files.\n";
+		checkpoint_interval = 0;
+		resume_mode = false;
+	}
+
+	if(stream_mode){
+		core->SetStreamMode();
+		if(shard_count > 1){ std::cout << msgHeader << "WARNING! Events are not built across the spills of different shards.\n"; }
+	}
+
+	core->SetDecodeThreads(decode_threads);
+
+	core->SetPipelineDepth(pipeline_depth);
+
+	// Record the raw events as they are built.
+	if(!record_fname.empty()){
+		if(!event_recorder.Open(record_fname, record_traces)){
+			std::cout << " FATAL ERROR! Failed to open the raw event file '" << record_fname << "'!\n";
+			return false;
+		}
+		core->SetEventRecorder(&event_recorder);
+		std::cout << msgHeader << "Recording the raw events to " << record_fname << (record_traces ? "" : " without traces") << ".\n";
+	}
+
 	// Parse for any extra arguments that are known to the derived class.
 	ExtraArguments();
 
@@ -954,12 +2111,20 @@ bool ScanInterface::Setup(int argc, char *argv[]){
 
 #ifndef USE_HRIBF		
 	if(shm_mode){
-		poll_server = new Server();
-		if(!poll_server->Init(5555, 1)){
-			std::cout << " FATAL ERROR! Failed to open shm socket 5555!\n";
-			std::cout << "\nCleaning up...\n";
-			return false;
-		}	
+		// The local ring is mapped when poll2 creates it, so poll2 may be started after the scan.
+		if(shm_ring){ spill_shm = new SpillShm(); }
+		else if(!stream_host.empty()){ stream_client = new StreamClient(); }
+		else{
+			poll_server = new Server();
+			if(!poll_server->Init(5555, 1)){
+				std::cout << " FATAL ERROR! Failed to open shm socket 5555!\n";
+				std::cout << "\nCleaning up...\n";
+				return false;
+			}
+			if(!poll_server->SetBufferSize(POLL2_SOCKET_BUFFER)){
+				std::cout << msgHeader << "Warning! Failed to set the shm socket receive buffer size.\n";
+			}
+		}
 		if(batch_mode){
 			std::cout << msgHeader << "Unable to enable batch mode for shared-memory mode!\n";
 			batch_mode = false;
@@ -983,7 +2148,9 @@ bool ScanInterface::Setup(int argc, char *argv[]){
 	if(dry_run_mode){ std::cout << msgHeader << "Doing a dry run.\n\n"; }
 	if(shm_mode){ 
 		std::cout << msgHeader << "Using shared-memory mode.\n\n"; 
-		std::cout << msgHeader << "Listening on poll2 SHM port 5555\n\n";
+		if(shm_ring){ std::cout << msgHeader << "Reading from poll2 shared memory ring " << POLL2_SHM_NAME << "\n\n"; }
+		else if(!stream_host.empty()){ std::cout << msgHeader << "Reading from poll2 TCP stream at " << stream_host << ":" << stream_port << "\n\n"; }
+		else{ std::cout << msgHeader << "Listening on poll2 SHM port 5555\n\n"; }
 	}
 		
 	// Load the input file, if the user has supplied a filename.
@@ -1022,6 +2189,14 @@ int ScanInterface::Execute(){
 	// Seek to the beginning of the file.
 	if(file_start_offset != 0){ rewind(); }
 
+	// Pick up where the last checkpoint left off.
+	if(resume_mode && !resume_scan()){ return 1; }
+	next_checkpoint = time(NULL) + checkpoint_interval;
+	if(resume_complete){
+		Notify("SCAN_COMPLETE");
+		return 0;
+	}
+
 	// Process the file.
 	if(!batch_mode){
 		// Start the run control thread
@@ -1055,16 +2230,44 @@ bool ScanInterface::Close(){
 	
 	// Only close the server if this is shared memory mode. Otherwise
 	// the server would never have been initialized.
-	if(shm_mode){ poll_server->Close(); }
+	if(poll_server){ poll_server->Close(); }
+	if(spill_shm){ spill_shm->Close(); }
+	if(stream_client){ stream_client->Close(); }
+	event_reader.Close();
 	
 	//Reprint the leader as the carriage was returned
 	std::cout << "Running " << PROG_NAME << " v" << SCAN_VERSION << " (" << SCAN_DATE << ")\n";
 	
 	std::cout << msgHeader << "Retrieved " << num_spills_recvd << " spills!\n";
+	if(shed_low > 0 && num_spills_recvd > 0){
+		std::cout << msgHeader << "Processed " << num_spills_recvd - num_spills_shed << " spills (" << 100.0 * (num_spills_recvd - num_spills_shed) / num_spills_recvd << "%) to keep up with poll2";
+		std::cout << ", " << num_spills_untraced << " of them without traces.\n";
+	}
+	if(recover_mode){
+		std::cout << msgHeader << "Recovered " << num_spills_recovered << " fragmented spills.\n";
+		for(size_t mod = 0; mod < lost_buffers.size(); mod++){
+			if(lost_buffers[mod] > 0){ std::cout << msgHeader << " Lost " << lost_buffers[mod] << " buffers from module " << mod << ".\n"; }
+		}
+	}
+
+	// The header of the input file is kept with the recorded raw events.
+	if(event_recorder.IsOpen()){
+		std::string name, value;
+		for(size_t i = 0; i < finfo.size(); i++){
+			if(finfo.at(i, name, value)){ event_recorder.SetHeader(name, value); }
+		}
+		event_recorder.Close();
+		if(core){ core->SetEventRecorder(NULL); }
+		std::cout << msgHeader << "Recorded " << event_recorder.GetNumEvents() << " raw events (" << event_recorder.GetNumHits() << " hits) to " << event_recorder.GetName() << ".\n";
+	}
+
+	// Anomalies which were only counted after their first few messages.
+	LogSite::PrintSummary(std::cout, msgHeader);
 
 	if(input_file.good()){
 		input_file.close();	
 	}
+	unmap_input_file();
 
 	// Clean up detector driver
 	std::cout << "\n" << msgHeader << "Cleaning up...\n";
@@ -1073,10 +2276,21 @@ bool ScanInterface::Close(){
 	std::cout << msgHeader << "Read " << databuff.GetNumChunks() << " spill chunks.\n";
 	std::cout << msgHeader << "Lost at least " << databuff.GetNumMissing() << " spill chunks.\n";
 	
+	// Finish any raw events still queued for the processing thread.
+	core->StopPipeline();
+
+	core->UpdateMemory();
+	if(PerfCounters::Enabled() || core->GetPerf().HasMemory()){
+		std::cout << "\n";
+		core->GetPerf().Print(std::cout);
+	}
+
 	if(write_counts)
 		core->Write();
 	
 	if(poll_server){ delete poll_server; }
+	if(spill_shm){ delete spill_shm; }
+	if(stream_client){ delete stream_client; }
 	if(term){ delete term; }
 #endif
 	if(core){ delete core; }
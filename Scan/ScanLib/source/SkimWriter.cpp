@@ -0,0 +1,242 @@
+/** \file SkimWriter.cpp
+ * \brief Writes the hits of selected raw events to a new .pld file.
+ */
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SkimWriter.hpp"
+#include "XiaData.hpp"
+
+// The largest module record and spill read by the Unpacker (in words).
+static const unsigned int maxModuleWords = 131072;
+static const unsigned int maxSpillWords = 1000000;
+
+// The end of file and end of buffer words of a .pld file.
+static const unsigned int endFileWord = 541478725;
+static const unsigned int endBufferWord = 0xFFFFFFFF;
+
+/// Default constructor.
+SkimWriter::SkimWriter() : spillWords(0), maxSpillSize(0), numEvents(0), numHits(0) { }
+
+/// Destructor. Writes the last spill and closes the file.
+SkimWriter::~SkimWriter(){
+	Close();
+}
+
+/** Open the output file and write a blank header, which is overwritten once the file is closed.
+  * \param[in]  fname_ The name of the .pld file to write.
+  * \return True if the file was opened and false otherwise.
+  */
+bool SkimWriter::Open(const std::string &fname_){
+	Close();
+
+	file.open(fname_.c_str(), std::ios::binary | std::ios::trunc);
+	if(!file.is_open() || !file.good()){
+		file.close();
+		return false;
+	}
+	fname = fname_;
+
+	pldHead.SetFormat("PIXIE LIST DATA ");
+	pldHead.SetStartDateTime();
+
+	// Write a blank header for now and overwrite it later. The title may
+	// still change, so leave room for the longest one we will write.
+	pldHead.SetTitle(std::string(80, ' '));
+	std::vector<unsigned int> blank(pldHead.GetBufferLength()/4, 0);
+	file.write((char*)blank.data(), 4*blank.size());
+	file.write((char*)&endBufferWord, 4); // Close the buffer
+	pldHead.SetTitle("");
+
+	blocks.clear();
+	spillWords = 0;
+	maxSpillSize = 0;
+	numEvents = 0;
+	numHits = 0;
+
+	return file.good();
+}
+
+/// Write the last spill and the header and close the file.
+void SkimWriter::Close(){
+	if(!file.is_open()){ return; }
+
+	Flush();
+
+	file.write((char*)&endFileWord, 4); // Write an EOF buffer
+	file.write((char*)&endBufferWord, 4); // Signal the end of the file
+
+	// Pad the title to the length of the blank header.
+	std::string title(pldHead.GetRunTitle());
+	title.resize(80, ' ');
+	pldHead.SetTitle(title);
+	pldHead.SetMaxSpillSize(maxSpillSize);
+
+	file.seekp(0);
+	pldHead.Write(&file);
+	file.close();
+}
+
+/** Copy an entry of the header of the input file to the header of the skim. Only the
+  * run number, title, facility, start and stop dates and run time are copied.
+  * \param[in]  name_  The name of the entry, as in ScanInterface::GetFileInfo().
+  * \param[in]  value_ The value of the entry.
+  * \return Nothing.
+  */
+void SkimWriter::SetHeader(const std::string &name_, const std::string &value_){
+	if(name_ == "Run number"){ pldHead.SetRunNumber(strtoul(value_.c_str(), NULL, 0)); }
+	else if(name_ == "Title"){ pldHead.SetTitle(value_.substr(0, 80)); }
+	else if(name_ == "Facility"){ pldHead.SetFacility(value_); }
+	else if(name_ == "ACQ time"){ pldHead.SetRunTime(atof(value_.c_str())); }
+	else if(name_ == "Start" || name_ == "Date"){ strncpy(pldHead.GetStartDate(), value_.c_str(), 24); }
+	else if(name_ == "Stop"){ strncpy(pldHead.GetEndDate(), value_.c_str(), 24); }
+}
+
+/** Write the hits of a raw event. The hits of an event are always written to the same spill.
+  * \param[in]  event_ The hits of the raw event.
+  * \return True if the hits were written and false if the file is not open.
+  */
+bool SkimWriter::Write(const std::deque<XiaData*> &event_){
+	if(!file.is_open()){ return false; }
+
+	for(std::vector<std::vector<unsigned int> >::iterator iter = eventWords.begin(); iter != eventWords.end(); iter++){
+		iter->clear();
+	}
+
+	unsigned int words = 0;
+	for(std::deque<XiaData*>::const_iterator iter = event_.begin(); iter != event_.end(); iter++){
+		unsigned int mod = (*iter)->modNum - 100 * (*iter)->crateNum;
+		if(eventWords.size() <= mod){ eventWords.resize(mod+1); }
+		words += Encode(*iter, eventWords[mod]);
+	}
+	if(words == 0){ return true; }
+
+	// Start a new spill if any module record or the spill would become too long.
+	if(blocks.size() < eventWords.size()){ blocks.resize(eventWords.size()); }
+	bool fits = (spillWords + words + 2*(blocks.size()+1) <= maxSpillWords);
+	for(size_t mod = 0; fits && mod < eventWords.size(); mod++){
+		fits = (blocks[mod].size() + eventWords[mod].size() + 2 <= maxModuleWords);
+	}
+	if(!fits){ Flush(); }
+
+	for(size_t mod = 0; mod < eventWords.size(); mod++){
+		blocks[mod].insert(blocks[mod].end(), eventWords[mod].begin(), eventWords[mod].end());
+	}
+	spillWords += words;
+	numHits += event_.size();
+	numEvents++;
+
+	return true;
+}
+
+/** Encode a hit as a revision F list-mode event. The onboard energy of a
+  * saturated hit is written as the value the Unpacker gives it.
+  * \param[in]  event_ The hit to encode.
+  * \param[out] words_ The list-mode words are appended to this vector.
+  * \return The number of words appended.
+  */
+unsigned int SkimWriter::Encode(XiaData *event_, std::vector<unsigned int> &words_){
+	const unsigned int headerLength = std::max(event_->headerLength, 4u);
+
+	// The event length is a 12 bit field, so very long traces are cut short.
+	size_t traceLength = std::min(event_->getTraceLength(), (size_t)2*(0xFFF - headerLength));
+	const unsigned int paddedLength = (traceLength + 1) & ~1u;
+	const unsigned int eventLength = headerLength + paddedLength/2;
+
+	words_.push_back((event_->chanNum & 0xF) | ((event_->slotNum & 0xF) << 4) | ((event_->crateNum & 0xF) << 8) |
+	                 (headerLength << 12) | (eventLength << 17) | ((unsigned int)event_->virtualChannel << 29) |
+	                 ((unsigned int)event_->saturatedBit << 30) | ((unsigned int)event_->pileupBit << 31));
+	words_.push_back(event_->eventTimeLo);
+	words_.push_back((event_->eventTimeHi & 0xFFFF) | ((event_->cfdTime & 0xFFFF) << 16));
+	words_.push_back(((unsigned int)event_->energy & 0xFFFF) | (paddedLength << 16));
+
+	// Energy sums follow the first four words of 8 and 16 word headers, and
+	// the QDCs end 12 and 16 word headers.
+	const bool hasSums = (headerLength == 8 || headerLength == 16);
+	const bool hasQdcs = (headerLength == 12 || headerLength == 16);
+	for(unsigned int i = 4; i < headerLength; i++){
+		if(hasSums && i < 4 + XiaData::numEnergySums){ words_.push_back(event_->getEnergySum(i - 4)); }
+		else if(hasQdcs && i >= headerLength - XiaData::numQdcs){ words_.push_back(event_->getQdcValue(i - (headerLength - XiaData::numQdcs))); }
+		else{ words_.push_back(0); }
+	}
+
+	// Two samples per word, read from the spill buffer if the trace was not copied.
+	for(size_t i = 0; i < paddedLength; i += 2){
+		unsigned int s0, s1 = 0;
+		if(event_->hasTraceView()){
+			s0 = event_->traceView[i];
+			if(i + 1 < traceLength){ s1 = event_->traceView[i+1]; }
+		}
+		else{
+			s0 = event_->adcTrace[i];
+			if(i + 1 < traceLength){ s1 = event_->adcTrace[i+1]; }
+		}
+		words_.push_back((s0 & 0xFFFF) | ((s1 & 0xFFFF) << 16));
+	}
+
+	return eventLength;
+}
+
+/** Write the spills of several skim files, one file after the other, to a single .pld
+  * file. The header is copied from the first input, with the largest spill of all inputs.
+  * \param[in]  fname_  The name of the .pld file to write.
+  * \param[in]  inputs_ The names of the skim files to merge.
+  * \return True if every spill of every input was written and false otherwise.
+  */
+bool SkimWriter::Merge(const std::string &fname_, const std::vector<std::string> &inputs_){
+	if(inputs_.empty()){ return false; }
+
+	// Read every header first, to find the largest spill.
+	PLD_header head, firstHead;
+	unsigned int maxSize = 0;
+	for(size_t i = 0; i < inputs_.size(); i++){
+		std::ifstream input(inputs_[i].c_str(), std::ios::binary);
+		PLD_header &thisHead = (i == 0 ? firstHead : head);
+		if(!thisHead.Read(&input)){ return false; }
+		maxSize = std::max(maxSize, thisHead.GetMaxSpillSize());
+	}
+
+	std::ofstream file(fname_.c_str(), std::ios::binary | std::ios::trunc);
+	if(!file.good()){ return false; }
+	firstHead.SetMaxSpillSize(maxSize);
+	firstHead.Write(&file);
+	file.write((char*)&endBufferWord, 4);
+
+	PLD_data pldData;
+	std::vector<unsigned int> spill(maxSize + 2);
+	bool retval = true;
+	for(size_t i = 0; i < inputs_.size() && retval; i++){
+		std::ifstream input(inputs_[i].c_str(), std::ios::binary);
+		unsigned int nBytes;
+		retval = head.Read(&input);
+		while(retval && pldData.Read(&input, (char*)spill.data(), nBytes, 4*maxSize)){
+			retval = pldData.Write(&file, (char*)spill.data(), nBytes/4);
+		}
+	}
+
+	file.write((char*)&endFileWord, 4); // Write an EOF buffer
+	file.write((char*)&endBufferWord, 4); // Signal the end of the file
+	file.close();
+
+	return (retval && !file.fail());
+}
+
+/// Write the current spill, if it is not empty.
+bool SkimWriter::Flush(){
+	if(spillWords == 0){ return true; }
+
+	spill.clear();
+	for(size_t mod = 0; mod < blocks.size(); mod++){
+		if(blocks[mod].empty()){ continue; }
+		spill.push_back(blocks[mod].size() + 2);
+		spill.push_back(mod);
+		spill.insert(spill.end(), blocks[mod].begin(), blocks[mod].end());
+		blocks[mod].clear();
+	}
+	spillWords = 0;
+
+	if(spill.size() > maxSpillSize){ maxSpillSize = spill.size(); }
+	return pldData.Write(&file, (char*)spill.data(), spill.size());
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SpillGenerator.hpp"
+
+#define CLOCK_TICK 8E-9 // The revision F timestamp clock, in seconds.
+#define FIRST_SLOT 2 // The slot of module 0.
+#define HEADER_LENGTH 4 // The list-mode header length without QDCs or sums.
+#define EVENT_SPREAD 16 // The maximum spread of the hits of an event, in clock ticks.
+
+SpillGenerator::SpillGenerator() : modules(4), rate(1E5), multiplicity(2), traceLength(0), spillTime(0.1), maxModuleWords(131072), maxSpillWords(1000000), lastSpillTime(0), clock(125000000) {  }
+
+void SpillGenerator::AddHit(const unsigned int &mod_, const unsigned int &chan_, const unsigned long long &time_, const unsigned int &energy_){
+	std::vector<unsigned int> &block = blocks[mod_];
+	unsigned int eventLength = HEADER_LENGTH + traceLength / 2;
+
+	block.push_back(chan_ | ((mod_ + FIRST_SLOT) << 4) | (HEADER_LENGTH << 12) | (eventLength << 17));
+	block.push_back(time_ & 0xFFFFFFFF);
+	block.push_back((time_ >> 32) & 0xFFFF);
+	block.push_back((energy_ & 0xFFFF) | (traceLength << 16));
+
+	// A pulse rising at a quarter of the trace and decaying over a tenth of it.
+	unsigned int rise = traceLength / 4;
+	double decay = traceLength / 10.0 + 1;
+	for(unsigned int i = 0; i < traceLength; i += 2){
+		unsigned int s[2];
+		for(unsigned int j = 0; j < 2; j++){
+			unsigned int k = i + j;
+			double pulse = (k >= rise ? energy_ * std::exp(-(k - rise) / decay) : 0);
+			s[j] = std::min(100 + (unsigned int)pulse + (unsigned int)(rng() & 0x7), 0xFFFFu);
+		}
+		block.push_back(s[0] | (s[1] << 16));
+	}
+}
+
+size_t SpillGenerator::Next(std::vector<unsigned int> &spill_){
+	const unsigned int numChannels = modules * 16;
+
+	blocks.assign(modules, std::vector<unsigned int>());
+	if(channels.size() != numChannels){
+		channels.resize(numChannels);
+		for(unsigned int i = 0; i < numChannels; i++)
+			channels[i] = i;
+	}
+
+	std::exponential_distribution<double> interval(rate * CLOCK_TICK);
+	std::uniform_int_distribution<unsigned int> energy(100, 4000);
+	std::uniform_real_distribution<double> uniform(0, 1);
+
+	// Leave room for the record headers and the end of spill block.
+	const unsigned int hitWords = HEADER_LENGTH + traceLength / 2;
+	const unsigned int moduleLimit = maxModuleWords - 2;
+	const unsigned int spillLimit = maxSpillWords - 2 * (modules + 1);
+
+	const unsigned long long start = clock;
+	unsigned long long stop = clock + (unsigned long long)(spillTime / CLOCK_TICK);
+	size_t numHits = 0;
+	size_t numWords = 0;
+	while(true){
+		unsigned long long next = clock + EVENT_SPREAD + (unsigned long long)interval(rng);
+		if(next >= stop){ break; }
+
+		// The multiplicity alternates between the integers around its mean.
+		unsigned int mult = (unsigned int)multiplicity;
+		if(uniform(rng) < multiplicity - mult){ mult++; }
+		mult = std::max(1u, std::min(mult, numChannels));
+
+		// End the spill early if a module could overflow, as if its FIFO were read out.
+		bool full = (numWords + mult * hitWords > spillLimit);
+		for(unsigned int mod = 0; mod < modules && !full; mod++)
+			full = (blocks[mod].size() + mult * hitWords > moduleLimit);
+		if(full){
+			stop = next;
+			break;
+		}
+		clock = next;
+
+		// Pick distinct channels, then add them in channel order so each module stays time ordered.
+		for(unsigned int i = 0; i < mult; i++)
+			std::swap(channels[i], channels[i + rng() % (numChannels - i)]);
+		std::sort(channels.begin(), channels.begin() + mult);
+		for(unsigned int i = 0; i < mult; i++)
+			AddHit(channels[i] / 16, channels[i] % 16, clock + rng() % EVENT_SPREAD, energy(rng));
+		numHits += mult;
+		numWords += mult * hitWords;
+	}
+	clock = stop;
+	lastSpillTime = (stop - start) * CLOCK_TICK;
+
+	spill_.clear();
+	for(unsigned int mod = 0; mod < modules; mod++){
+		spill_.push_back(blocks[mod].size() + 2);
+		spill_.push_back(mod);
+		spill_.insert(spill_.end(), blocks[mod].begin(), blocks[mod].end());
+	}
+	spill_.push_back(2);
+	spill_.push_back(9999);
+
+	return numHits;
+}
@@ -0,0 +1,197 @@
+/** \file SpillIndex.cpp
+ * \brief An index of the spills in a .ldf file, used for seeking.
+ */
+#include <fstream>
+
+#include "SpillIndex.hpp"
+#include "hribf_buffers.h"
+
+#define SPILL_INDEX_MAGIC 0x58444953 /// "SIDX"
+#define SPILL_INDEX_VERSION 1
+
+namespace {
+	/// The words of a spill split into spans, indexed as if they were contiguous.
+	class SpanWords{
+	  public:
+		SpanWords(const std::vector<SpillSpan> &spans_) : spans(spans_), span(0), first(0) { }
+
+		/// Return the word at pos_ of the spill. Reading forward is the fastest.
+		unsigned int operator [] (const unsigned int &pos_){
+			while(pos_ < first){ first -= spans[--span].nWords; }
+			while(pos_ >= first + spans[span].nWords){ first += spans[span++].nWords; }
+			return spans[span].data[pos_ - first];
+		}
+
+	  private:
+		const std::vector<SpillSpan> &spans; /// The spans of the spill.
+		size_t span; /// The span of the last word read.
+		unsigned int first; /// The position of the first word of that span in the spill.
+	};
+
+	/// Find the earliest event time in a spill. Words_ is indexed as an array of words.
+	template <typename Words>
+	bool first_time(Words &data_, const unsigned int &nWords_, unsigned long long &time_){
+		const unsigned int maxVsn = 14; // No more than 14 pixie modules per crate
+		bool found = false;
+		unsigned int pos = 0;
+		while(pos + 1 < nWords_){
+			if(data_[pos] == 0xFFFFFFFF){ // Skip delimiters.
+				pos++;
+				continue;
+			}
+
+			unsigned int lenRec = data_[pos];
+			unsigned int vsn = data_[pos+1];
+			if(lenRec < 2 || vsn == 9999){ break; }
+
+			// A module buffer with at least one event header (record length 6 is an empty module).
+			if(vsn < maxVsn && lenRec > 6 && pos + 5 < nWords_){
+				unsigned long long time = ((unsigned long long)(data_[pos+4] & 0x0000FFFF) << 32) | data_[pos+3];
+				if(!found || time < time_){ time_ = time; }
+				found = true;
+			}
+
+			pos += lenRec;
+		}
+		return found;
+	}
+}
+
+/** Find the spill which starts at a given position in the file.
+  * \param[in]  offset_   Word offset of the ldf buffer containing the start of the spill.
+  * \param[in]  position_ Word position of the start of the spill within that buffer.
+  * \param[out] spill_    The index of the spill.
+  * \return True if the spill is in the index and false otherwise.
+  */
+bool SpillIndex::FindSpill(const size_t &offset_, const unsigned int &position_, size_t &spill_) const {
+	size_t low = 0, high = entries.size();
+	while(low < high){
+		size_t mid = low + (high - low) / 2;
+		const Entry &entry = entries[mid];
+		if(entry.offset < offset_ || (entry.offset == offset_ && entry.position < position_)){ low = mid + 1; }
+		else{ high = mid; }
+	}
+	if(low >= entries.size() || entries[low].offset != offset_ || entries[low].position != position_){ return false; }
+	spill_ = low;
+	return true;
+}
+
+/** Find the last spill which starts at or before a given time.
+  * \param[in]  time_  The time to search for (in clock ticks).
+  * \param[out] spill_ The index of the spill.
+  * \return True if such a spill exists and false otherwise.
+  */
+bool SpillIndex::FindTime(const unsigned long long &time_, size_t &spill_) const {
+	size_t low = 0, high = entries.size();
+	while(low < high){
+		size_t mid = low + (high - low) / 2;
+		if(entries[mid].firstTime <= time_){ low = mid + 1; }
+		else{ high = mid; }
+	}
+	if(low == 0){ return false; }
+	spill_ = low - 1;
+	return true;
+}
+
+/** Get the time range covered by a spill. The range ends at the first time of
+  * the following spill, so it is unknown for the last spill in the index.
+  * \param[in]  spill_ The index of the spill.
+  * \param[out] start_ The earliest event time in the spill.
+  * \param[out] stop_  The earliest event time in the following spill.
+  * \return True if the range is known and false otherwise.
+  */
+bool SpillIndex::GetTimeRange(const size_t &spill_, unsigned long long &start_, unsigned long long &stop_) const {
+	if(spill_ + 1 >= entries.size()){ return false; }
+	start_ = entries[spill_].firstTime;
+	stop_ = entries[spill_+1].firstTime;
+	return true;
+}
+
+/** Read an index from file.
+  * \param[in]  fname_ The index filename.
+  * \return True upon success and false otherwise.
+  */
+bool SpillIndex::Read(const std::string &fname_){
+	entries.clear();
+
+	std::ifstream file(fname_.c_str(), std::ios::binary);
+	if(!file.good()){ return false; }
+
+	unsigned int magic = 0, version = 0;
+	unsigned long long numEntries = 0;
+	file.read((char*)&magic, 4);
+	file.read((char*)&version, 4);
+	file.read((char*)&fileLength, 8);
+	file.read((char*)&numEntries, 8);
+	if(!file.good() || magic != SPILL_INDEX_MAGIC || version != SPILL_INDEX_VERSION){ return false; }
+
+	Entry entry;
+	unsigned long long offset;
+	for(unsigned long long i = 0; i < numEntries; i++){
+		file.read((char*)&offset, 8);
+		file.read((char*)&entry.position, 4);
+		file.read((char*)&entry.numWords, 4);
+		file.read((char*)&entry.firstTime, 8);
+		if(!file.good()){
+			entries.clear();
+			return false;
+		}
+		entry.offset = offset;
+		entries.push_back(entry);
+	}
+
+	return true;
+}
+
+/** Write the index to file.
+  * \param[in]  fname_ The index filename.
+  * \return True upon success and false otherwise.
+  */
+bool SpillIndex::Write(const std::string &fname_) const {
+	std::ofstream file(fname_.c_str(), std::ios::binary);
+	if(!file.good()){ return false; }
+
+	unsigned int magic = SPILL_INDEX_MAGIC, version = SPILL_INDEX_VERSION;
+	unsigned long long numEntries = entries.size();
+	file.write((char*)&magic, 4);
+	file.write((char*)&version, 4);
+	file.write((char*)&fileLength, 8);
+	file.write((char*)&numEntries, 8);
+
+	unsigned long long offset;
+	for(std::vector<Entry>::const_iterator iter = entries.begin(); iter != entries.end(); iter++){
+		offset = iter->offset;
+		file.write((char*)&offset, 8);
+		file.write((char*)&iter->position, 4);
+		file.write((char*)&iter->numWords, 4);
+		file.write((char*)&iter->firstTime, 8);
+	}
+
+	return file.good();
+}
+
+/** Find the earliest event time in a spill without decoding it. Only the
+  * first event of each module buffer is inspected, since the events within
+  * a module buffer are in time order.
+  * \param[in]  data_   The spill data.
+  * \param[in]  nWords_ The number of words in the spill.
+  * \param[out] time_   The earliest event time (in clock ticks).
+  * \return True if the spill contains at least one event and false otherwise (time_ is not modified).
+  */
+bool SpillIndex::GetFirstTime(const unsigned int *data_, const unsigned int &nWords_, unsigned long long &time_){
+	return first_time(data_, nWords_, time_);
+}
+
+/** Find the earliest event time in a spill which was not reassembled.
+  * \param[in]  spans_ The spill chunks, in order.
+  * \param[out] time_  The earliest event time (in clock ticks).
+  * eturn True if the spill contains at least one event and false otherwise (time_ is not modified).
+  */
+bool SpillIndex::GetFirstTime(const std::vector<SpillSpan> &spans_, unsigned long long &time_){
+	unsigned int nWords = 0;
+	for(std::vector<SpillSpan>::const_iterator iter = spans_.begin(); iter != spans_.end(); iter++){ nWords += iter->nWords; }
+	if(nWords == 0){ return false; }
+
+	SpanWords words(spans_);
+	return first_time(words, nWords, time_);
+}
@@ -0,0 +1,132 @@
+/** \file SpillPrefetcher.cpp
+ * \brief A read-ahead thread which fills a ring of spill buffers from an input file.
+ */
+#include "SpillPrefetcher.hpp"
+
+/// Default constructor.
+SpillPrefetcher::SpillPrefetcher() : active(false), finished(false), stopping(false), readerStalls(0), consumerStalls(0) { }
+
+/// Destructor. Stops the reader thread.
+SpillPrefetcher::~SpillPrefetcher(){
+	Stop();
+}
+
+/// Return true if the reader thread has read its last spill.
+bool SpillPrefetcher::IsFinished(){
+	std::lock_guard<std::mutex> guard(lock);
+	return finished;
+}
+
+/// Return the number of spills waiting to be consumed.
+size_t SpillPrefetcher::GetQueueDepth(){
+	std::lock_guard<std::mutex> guard(lock);
+	return filledSlots.size();
+}
+
+/// Return the number of times the reader had to wait for a free buffer.
+unsigned long SpillPrefetcher::GetReaderStalls(){
+	std::lock_guard<std::mutex> guard(lock);
+	return readerStalls;
+}
+
+/// Return the number of times the consumer had to wait for a spill to be read.
+unsigned long SpillPrefetcher::GetConsumerStalls(){
+	std::lock_guard<std::mutex> guard(lock);
+	return consumerStalls;
+}
+
+/** Start the reader thread. Does nothing if it is already active.
+  * \param[in]  depth_ The number of spill buffers in the ring.
+  * \param[in]  read_  The function used to read each spill.
+  * \return Nothing.
+  */
+void SpillPrefetcher::Start(const size_t &depth_, ReadFunction read_){
+	if(active){ return; }
+
+	// Buffers are kept between runs so their memory is only allocated once.
+	if(ring.size() != depth_){ ring.resize(depth_ > 0 ? depth_ : 1); }
+	freeSlots.clear();
+	filledSlots.clear();
+	for(size_t i = 0; i < ring.size(); i++){
+		freeSlots.push_back(i);
+	}
+
+	readSpill = read_;
+	finished = false;
+	stopping = false;
+	active = true;
+
+	reader = std::thread(&SpillPrefetcher::ReadLoop, this);
+}
+
+/** Stop the reader thread and discard all spills which have not been consumed.
+  * \return Nothing.
+  */
+void SpillPrefetcher::Stop(){
+	if(!active){ return; }
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	slotFreed.notify_all();
+	slotFilled.notify_all();
+
+	reader.join();
+
+	filledSlots.clear();
+	freeSlots.clear();
+	active = false;
+}
+
+/** Wait for the next spill. The spill remains valid until Pop() is called.
+  * \return Pointer to the next spill, or NULL if the reader has finished
+  *         (or was stopped) and no spills are left.
+  */
+SpillPrefetcher::Spill *SpillPrefetcher::Front(){
+	std::unique_lock<std::mutex> guard(lock);
+	if(filledSlots.empty() && !finished && !stopping){ consumerStalls++; }
+	slotFilled.wait(guard, [this]{ return (!filledSlots.empty() || finished || stopping); });
+	if(filledSlots.empty()){ return NULL; }
+	return &ring[filledSlots.front()];
+}
+
+/** Return the spill obtained from Front() to the ring of free buffers.
+  * \return Nothing.
+  */
+void SpillPrefetcher::Pop(){
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if(filledSlots.empty()){ return; }
+		freeSlots.push_back(filledSlots.front());
+		filledSlots.pop_front();
+	}
+	slotFreed.notify_one();
+}
+
+/// Main loop of the reader thread.
+void SpillPrefetcher::ReadLoop(){
+	while(true){
+		size_t slot;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			if(freeSlots.empty() && !stopping){ readerStalls++; }
+			slotFreed.wait(guard, [this]{ return (!freeSlots.empty() || stopping); });
+			if(stopping){ break; }
+			slot = freeSlots.front();
+			freeSlots.pop_front();
+		}
+
+		// Read outside of the lock so the consumer can keep working.
+		bool more = readSpill(ring[slot]);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			filledSlots.push_back(slot);
+			if(!more){ finished = true; }
+		}
+		slotFilled.notify_one();
+
+		if(!more){ break; }
+	}
+}
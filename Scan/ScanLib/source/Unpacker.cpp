@@ -18,105 +18,369 @@
 #include <cmath>
 #include <algorithm>
 #include <limits>
+#include <functional>
+#include <thread>
 
 #include "Unpacker.hpp"
 #include "XiaData.hpp"
+#include "ListModeHeaders.hpp"
+#include "RawEventFile.hpp"
+#include "poll2_log.h"
 
-void clearDeque(std::deque<XiaData*> &list){
+/** Allocate a new slab of XiaData objects and add them to the pool.
+  * \return Nothing.
+  */
+void Unpacker::GrowPool(){
+	XiaData *slab = new XiaData[POOL_SLAB_SIZE];
+	eventSlabs.push_back(slab);
+	eventPool.reserve(eventSlabs.size()*POOL_SLAB_SIZE);
+	for(unsigned int i = 0; i < POOL_SLAB_SIZE; i++){
+		eventPool.push_back(&slab[i]);
+	}
+}
+
+/** Measure the bytes held by the event pool, including the trace capacity
+  * kept by its events. Called by the reading thread, which owns the pool.
+  * \return Nothing.
+  */
+void Unpacker::MeasurePool(){
+	unsigned long long bytes = 0;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		for(std::vector<XiaData*>::iterator iter = eventSlabs.begin(); iter != eventSlabs.end(); iter++){
+			bytes += POOL_SLAB_SIZE*sizeof(XiaData);
+			for(unsigned int i = 0; i < POOL_SLAB_SIZE; i++)
+				bytes += (*iter)[i].adcTrace.capacity()*sizeof(int);
+		}
+	}
+	poolBytes.store(bytes, std::memory_order_relaxed);
+}
+
+/** Add the memory held by each subsystem of the scan to a list. Derived
+  * classes add their own subsystems (histograms, correlators, ...) to
+  * those of the Unpacker. Called by UpdateMemory.
+  * \param[out] entries_ The memory of each subsystem.
+  * \return Nothing.
+  */
+void Unpacker::AccountMemory(std::vector<PerfCounters::MemoryEntry> &entries_){
+	if(pool_mode)
+		entries_.push_back(PerfCounters::MemoryEntry("event pool", poolBytes.load(std::memory_order_relaxed)));
+}
+
+/** Measure the memory held by each subsystem (see AccountMemory) and give
+  * it to the perf counters, which print it with the stage timers. Must be
+  * called from the thread which processes raw events, or once the
+  * pipeline is stopped.
+  * \return True if the memory of all subsystems is over the budget.
+  */
+bool Unpacker::UpdateMemory(){
+	std::vector<PerfCounters::MemoryEntry> entries;
+	AccountMemory(entries);
+	perf.SetMemory(entries, memoryBudget);
+
+	unsigned long long total = 0;
+	for(std::vector<PerfCounters::MemoryEntry>::iterator iter = entries.begin(); iter != entries.end(); iter++)
+		total += iter->bytes;
+	bool over = (memoryBudget > 0 && total > memoryBudget);
+	if(over && !overBudget){
+		std::cout << "UpdateMemory: Scan holds " << total/1048576 << " MB, over its budget of " << memoryBudget/1048576 << " MB.\n";
+		std::cout << "UpdateMemory:  Use the perf command to see the memory of each subsystem.\n";
+	}
+	return (overBudget = over);
+}
+
+/** Delete all slabs allocated by the event pool. WARNING! Any events which
+  * are still in use are deleted as well.
+  * \return Nothing.
+  */
+void Unpacker::ClearPool(){
+	for(std::vector<XiaData*>::iterator iter = eventSlabs.begin(); iter != eventSlabs.end(); iter++){
+		delete[] (*iter);
+	}
+	eventSlabs.clear();
+	eventPool.clear();
+}
+
+/** Release all events in a deque through ReleaseEvent() and empty it.
+  * \param[in]  list The deque of events to clear.
+  * \return Nothing.
+  */
+void Unpacker::ClearDeque(std::deque<XiaData*> &list){
 	while(!list.empty()){
-		delete list.front();
+		ReleaseEvent(list.front());
 		list.pop_front();
 	}
 }
 
-/** Scan the event list and sort it by timestamp.
+/** Get a new, cleared XiaData. If pool mode is enabled the event is taken
+  * from the pool, otherwise it is allocated on the heap.
+  * \return Pointer to a cleared XiaData.
+  */
+XiaData *Unpacker::GetNewEvent(){
+	if(!pool_mode){ return new XiaData(); }
+	std::unique_lock<std::mutex> lock(poolMutex, std::defer_lock);
+	if(pipelineRunning){ lock.lock(); }
+	if(eventPool.empty()){ GrowPool(); }
+	XiaData *output = eventPool.back();
+	eventPool.pop_back();
+	return output;
+}
+
+/** Scan the event list and sort it by timestamp. Module streams are
+  * normally already time ordered, so each deque is only sorted if needed.
+  * Once all modules are sorted the merge heap is built for BuildRawEvent.
   * \return Nothing.
   */
 void Unpacker::TimeSort(){
 	for(std::vector<std::deque<XiaData*> >::iterator iter = eventList.begin(); iter != eventList.end(); iter++){
-		sort(iter->begin(), iter->end(), &XiaData::compareTime);
+		SortModule(*iter);
+	}
+	BuildMergeHeap();
+}
+
+/** Sort the events of a single module by timestamp. Module streams are
+  * almost always time ordered already, so out of order events are first
+  * moved into place with an insertion sort. If that turns out to require too
+  * many moves, the module is sorted with RadixSort() instead.
+  * \param[in]  module_ The list of events from one module.
+  * \return Nothing.
+  */
+void Unpacker::SortModule(std::deque<XiaData*> &module_){
+	// Allow a few moves per event before giving up on the insertion sort.
+	const size_t maxShifts = 4 * module_.size();
+	size_t numShifts = 0;
+
+	for(size_t i = 1; i < module_.size(); i++){
+		XiaData *current = module_[i];
+		if(current->timeStamp >= module_[i-1]->timeStamp)
+			continue;
+
+		size_t j = i;
+		while(j > 0 && module_[j-1]->timeStamp > current->timeStamp){
+			module_[j] = module_[j-1];
+			j--;
+		}
+		module_[j] = current;
+
+		numShifts += i - j;
+		if(numShifts > maxShifts){ // The stream is badly out of order.
+			RadixSort(module_);
+			return;
+		}
+	}
+}
+
+/** Sort the events of a single module by timestamp using a stable LSD
+  * radix sort over the bytes of the timestamp. Passes over bytes which are
+  * identical for every event (e.g. the upper bytes of the clock) are skipped.
+  * \param[in]  module_ The list of events from one module.
+  * \return Nothing.
+  */
+void Unpacker::RadixSort(std::deque<XiaData*> &module_){
+	const size_t num = module_.size();
+	if(num < 2)
+		return;
+
+	sortBuffer.clear();
+	for(std::deque<XiaData*>::iterator iter = module_.begin(); iter != module_.end(); iter++){
+		sortBuffer.push_back(std::make_pair((*iter)->timeStamp, *iter));
+	}
+	sortScratch.resize(num);
+
+	// Histogram all eight bytes of the key in a single pass.
+	size_t counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for(size_t i = 0; i < num; i++){
+		unsigned long long key = sortBuffer[i].first;
+		for(int byte = 0; byte < 8; byte++){
+			counts[byte][(key >> (8 * byte)) & 0xFF]++;
+		}
+	}
+
+	for(int byte = 0; byte < 8; byte++){
+		size_t *count = counts[byte];
+		if(count[(sortBuffer[0].first >> (8 * byte)) & 0xFF] == num) // All events share this byte.
+			continue;
+
+		size_t offset = 0;
+		for(int bin = 0; bin < 256; bin++){
+			size_t binCount = count[bin];
+			count[bin] = offset;
+			offset += binCount;
+		}
+		for(size_t i = 0; i < num; i++){
+			sortScratch[count[(sortBuffer[i].first >> (8 * byte)) & 0xFF]++] = sortBuffer[i];
+		}
+		sortBuffer.swap(sortScratch);
 	}
+
+	for(size_t i = 0; i < num; i++){
+		module_[i] = sortBuffer[i].second;
+	}
+}
+
+/** Build the k-way merge heap from the front of each module in the event
+  * list. The event list must be time sorted by module.
+  * \return Nothing.
+  */
+void Unpacker::BuildMergeHeap(){
+	mergeHeap.clear();
+	for(size_t mod = 0; mod < eventList.size(); mod++){
+		if(!eventList[mod].empty())
+			mergeHeap.push_back(std::make_pair(eventList[mod].front()->timeStamp, mod));
+	}
+	std::make_heap(mergeHeap.begin(), mergeHeap.end(), std::greater<std::pair<unsigned long long, size_t> >());
+}
+
+/** Take the earliest event from the merge heap and put the next event of
+  * its module into the heap. Events with a non-physical module or
+  * channel are released.
+  * \return The earliest event, or NULL if it was released.
+  */
+XiaData *Unpacker::PopFirstEvent(){
+	std::greater<std::pair<unsigned long long, size_t> > heapCompare;
+
+	std::pop_heap(mergeHeap.begin(), mergeHeap.end(), heapCompare);
+	size_t modIndex = mergeHeap.back().second;
+	std::deque<XiaData*> &module = eventList[modIndex];
+	mergeHeap.pop_back();
+
+	// Remove this event from the event list but do not delete it yet.
+	// Deleting of the channel events will be handled by clearing the rawEvent.
+	XiaData *current_event = module.front();
+	module.pop_front();
+
+	// Put the next event from this module back into the heap.
+	if(!module.empty()){
+		mergeHeap.push_back(std::make_pair(module.front()->timeStamp, modIndex));
+		std::push_heap(mergeHeap.begin(), mergeHeap.end(), heapCompare);
+	}
+
+	unsigned int mod = current_event->modNum - 100 * current_event->crateNum;
+	unsigned int chan = current_event->chanNum;
+
+	if(mod > MAX_PIXIE_MOD || chan > MAX_PIXIE_CHAN){ // Skip this channel
+		static LogSite badIdSite("BuildRawEvent: Non-physical Pixie ID");
+		if(badIdSite.Hit(mod, chan))
+			std::cout << "BuildRawEvent: Encountered non-physical Pixie ID (mod = " << mod << ", chan = " << chan << ")" << badIdSite.Suppressed() << "\n";
+		ReleaseEvent(current_event);
+		return NULL;
+	}
+
+	return current_event;
+}
+
+/** Add an event to the raw event being built and update its real start and stop times.
+  * \param[in]  event_ The event to add.
+  * \return Nothing.
+  */
+void Unpacker::AddToBuildEvent(XiaData *event_){
+	double currtime = event_->time;
+
+	// Check for the minimum time in this raw event.
+	if(currtime < buildEvent.realStartTime)
+		buildEvent.realStartTime = currtime;
+	
+	// Check for the maximum time in this raw event.
+	if(currtime > buildEvent.realStopTime)
+		buildEvent.realStopTime = currtime;
+
+	// Push this channel event into the raw event being built.
+	buildEvent.events.push_back(event_);
+}
+
+/** Take the earliest event which has not been built, either from the hits
+  * left over from the window of the previous raw event or from the merge heap.
+  * \return The earliest event, or NULL if it was released.
+  */
+XiaData *Unpacker::TakeFirstEvent(){
+	if(!pendingHits.empty() && (mergeHeap.empty() || pendingHits.front()->timeStamp <= mergeHeap.front().first)){
+		XiaData *current_event = pendingHits.front();
+		pendingHits.pop_front();
+		return current_event;
+	}
+	return PopFirstEvent();
 }
 
 /** Scan the time sorted event list and package the events into a raw
-  * event with a size governed by the event width.
+  * event with a size governed by the event width, or around the next
+  * trigger in trigger mode. Events are pulled from the modules in time
+  * order using the merge heap, so each channel costs O(log modules)
+  * regardless of how many modules are in the system.
   * \return True if the event list is not empty and false otherwise.
   */
 bool Unpacker::BuildRawEvent(){
-	if(!rawEvent.empty())
-		ClearRawEvent();
+	if(!triggerWindows.empty())
+		return BuildTriggeredEvent();
+
+	// Move the event window forward to the next valid channel fire. The top
+	// of the merge heap is the earliest time from all modules.
+	double startTime;
+	if(!GetFirstTime(startTime))
+		return false;
+
+	// In stream mode, hits from the next spill may still fall inside of this
+	// window, so leave it for later.
+	const double maxWidth = std::max(eventWidth, (double)maxChannelWidth);
+	if(stream_mode && startTime + maxWidth >= streamHorizon)
+		return false;
 
 	if(numRawEvt == 0){// This is the first rawEvent. Do some special processing.
-		// Find the first XiaData event. The eventList is time sorted by module.
-		// The first component of each deque will be the earliest time from that module.
-		// The first event time will be the minimum of these first components.
-		if(!GetFirstTime(firstTime))
-			return false;
+		firstTime = startTime;
 		std::cout << "BuildRawEvent: First event time is " << firstTime << " clock ticks.\n";
-		eventStartTime = firstTime;
-	}
-	else{ 
-		// Move the event window forward to the next valid channel fire.
-		if(!GetFirstTime(eventStartTime))
-			return false;
 	}
+	buildEvent.startTime = startTime;
 
-	realStartTime = eventStartTime+eventWidth;
-	realStopTime = eventStartTime;
-	
-	unsigned int mod, chan;
-	std::string type, subtype, tag;
-	XiaData *current_event = NULL;
+	buildEvent.realStartTime = startTime+maxWidth;
+	buildEvent.realStopTime = startTime;
 
-	// Loop over all time-sorted modules.
-	for(std::vector<std::deque<XiaData*> >::iterator iter = eventList.begin(); iter != eventList.end(); iter++){
-		if(iter->empty())
-			continue;
-			
-		// Loop over the list of channels that fired in this buffer
-		while(!iter->empty()){
-			current_event = iter->front();
-			mod = current_event->modNum;
-			chan = current_event->chanNum;
-	
-			if(mod > MAX_PIXIE_MOD || chan > MAX_PIXIE_CHAN){ // Skip this channel
-				std::cout << "BuildRawEvent: Encountered non-physical Pixie ID (mod = " << mod << ", chan = " << chan << ")\n";
-				delete current_event;
-				iter->pop_front();
+	// Windowing is done on the integer clock ticks of the timeStamp, so the
+	// CFD fraction only affects the order of hits inside of the window.
+	unsigned long long startTicks = (unsigned long long)startTime;
+	unsigned long long widthTicks = (unsigned long long)eventWidth;
+
+	// With channel widths, the window stays open for the widest channel and
+	// hits beyond the width of their own channel are left for the next window.
+	if(!channelWidths.empty()){
+		unsigned long long maxTicks = (unsigned long long)maxWidth;
+		while(!pendingHits.empty() || !mergeHeap.empty()){
+			unsigned long long ticks = (!pendingHits.empty() && (mergeHeap.empty() || pendingHits.front()->timeStamp <= mergeHeap.front().first) ?
+			                            pendingHits.front()->timeStamp : mergeHeap.front().first) >> XiaData::cfdFractionBits;
+			if(ticks - startTicks > maxTicks)
+				break;
+
+			XiaData *current_event = TakeFirstEvent();
+			if(!current_event)
 				continue;
-			}
 
-			double currtime = current_event->time;
+			unsigned int id = current_event->modNum*16 + current_event->chanNum;
+			if(ticks - startTicks <= (id < channelWidths.size() && channelWidths[id] > 0 ? channelWidths[id] : widthTicks))
+				AddToBuildEvent(current_event);
+			else
+				deferredHits.push_back(current_event);
+		}
 
-			// Check for backwards time-skip. This is un-handled currently and needs fixed CRT!!!
-			if(currtime < eventStartTime)
-				std::cout << "BuildRawEvent: Detected backwards time-skip from start=" << eventStartTime << " to " << current_event->time << "???\n";
+		// The deferred hits are earlier than any pending hit left over.
+		pendingHits.insert(pendingHits.begin(), deferredHits.begin(), deferredHits.end());
+		deferredHits.clear();
 
-			// If the time difference between the current and previous event is 
-			// larger than the event width, finalize the current event, otherwise
-			// treat this as part of the current event
-			if((currtime - eventStartTime) > eventWidth){ // 62 pixie ticks represents ~0.5 us
-				break;
-			}
+		numRawEvt++;
 
-			// Check for the minimum time in this raw event.
-			if(currtime < realStartTime)
-				realStartTime = currtime;
-			
-			// Check for the maximum time in this raw event.
-			if(currtime > realStopTime)
-				realStopTime = currtime;
+		return true;
+	}
 
-			// Update raw stats output with the new event before adding it to the raw event.
-			RawStats(current_event);
-	
-			// Push this channel event into the rawEvent.
-			rawEvent.push_back(current_event);
-	
-			// Remove this event from the event list but do not delete it yet.
-			// Deleting of the channel events will be handled by clearing the rawEvent.
-			iter->pop_front();
+	// Pull events from the modules in time order until we leave the event window.
+	while(!mergeHeap.empty()){
+		// If the time difference between the current and previous event is 
+		// larger than the event width, finalize the current event, otherwise
+		// treat this as part of the current event
+		if((mergeHeap.front().first >> XiaData::cfdFractionBits) - startTicks > widthTicks){ // 62 pixie ticks represents ~0.5 us
+			break;
 		}
+
+		XiaData *current_event = PopFirstEvent();
+		if(current_event)
+			AddToBuildEvent(current_event);
 	}
 
 	numRawEvt++;
@@ -124,33 +388,342 @@ bool Unpacker::BuildRawEvent(){
 	return true;
 }	
 
+/** Scan the time sorted event list for the next trigger and package the
+  * events inside of its window into a raw event. Hits are moved from the
+  * merge heap to the pending list until a trigger is found, and pending hits
+  * which are earlier than the longest window of any trigger are released,
+  * so that every hit is looked at once.
+  * \return True if a raw event was built and false otherwise.
+  */
+bool Unpacker::BuildTriggeredEvent(){
+	while(!mergeHeap.empty()){
+		unsigned long long ticks = (mergeHeap.front().first >> XiaData::cfdFractionBits);
+
+		// In stream mode, the window of a trigger here may still reach into
+		// the next spill, so leave it for later.
+		if(stream_mode && (double)ticks + maxTriggerAfter >= streamHorizon)
+			return false;
+
+		XiaData *current_event = PopFirstEvent();
+		if(!current_event)
+			continue;
+
+		// No later trigger can reach back to these hits.
+		while(!pendingHits.empty() && (pendingHits.front()->timeStamp >> XiaData::cfdFractionBits) + maxTriggerBefore < ticks){
+			ReleaseEvent(pendingHits.front());
+			pendingHits.pop_front();
+			numUntriggered++;
+		}
+
+		unsigned int id = current_event->modNum*16 + current_event->chanNum;
+		if(id >= triggerWindows.size() || (triggerWindows[id].first == 0 && triggerWindows[id].second == 0)){
+			pendingHits.push_back(current_event);
+			continue;
+		}
+
+		unsigned long long startTicks = ticks - std::min(ticks, (unsigned long long)triggerWindows[id].first);
+		unsigned long long stopTicks = ticks + triggerWindows[id].second;
+
+		if(numRawEvt == 0){// This is the first rawEvent. Do some special processing.
+			firstTime = (double)startTicks;
+			std::cout << "BuildRawEvent: First triggered event time is " << firstTime << " clock ticks.\n";
+		}
+		buildEvent.startTime = (double)startTicks;
+		buildEvent.realStartTime = current_event->time;
+		buildEvent.realStopTime = current_event->time;
+
+		// Hits before the window opened are not part of any event.
+		while(!pendingHits.empty()){
+			if((pendingHits.front()->timeStamp >> XiaData::cfdFractionBits) < startTicks){
+				ReleaseEvent(pendingHits.front());
+				numUntriggered++;
+			}
+			else
+				AddToBuildEvent(pendingHits.front());
+			pendingHits.pop_front();
+		}
+		AddToBuildEvent(current_event);
+
+		// Pull events from the modules in time order until the window closes.
+		while(!mergeHeap.empty() && (mergeHeap.front().first >> XiaData::cfdFractionBits) <= stopTicks){
+			current_event = PopFirstEvent();
+			if(current_event)
+				AddToBuildEvent(current_event);
+		}
+
+		numRawEvt++;
+
+		return true;
+	}
+
+	// Without stream mode no trigger can follow the pending hits. In stream
+	// mode they wait for the next spill in the carry list.
+	if(!stream_mode){
+		numUntriggered += pendingHits.size();
+		ClearDeque(pendingHits);
+	}
+
+	return false;
+}
+
+/** Make a built raw event the current rawEvent, call RawStats for each of
+  * its events and fill the hit table.
+  * \param[in]  event_ The built raw event. Its list of events is left empty.
+  * \return Nothing.
+  */
+void Unpacker::StartRawEvent(BuiltEvent &event_){
+	if(!rawEvent.empty())
+		ClearRawEvent();
+
+	rawEvent.swap(event_.events);
+	eventStartTime = event_.startTime;
+	realStartTime = event_.realStartTime;
+	realStopTime = event_.realStopTime;
+
+	// Update raw stats output with the new events.
+	for(std::deque<XiaData*>::iterator iter = rawEvent.begin(); iter != rawEvent.end(); iter++){
+		RawStats(*iter);
+	}
+
+	if(eventRecorder)
+		eventRecorder->Write(rawEvent, firstTime, eventStartTime, realStartTime, realStopTime);
+
+	if(hit_table_mode)
+		rawHits.Fill(rawEvent);
+}
+
+/** Process the raw event which was just built, either right away or, with a
+  * non-zero pipeline depth, by queueing it for the processing thread.
+  * \return Nothing.
+  */
+void Unpacker::DispatchRawEvent(){
+	if(pipeline_depth == 0){
+		PERF_START(eventStart);
+		StartRawEvent(buildEvent);
+		ProcessRawEvent(interface);
+		PERF_EVENT(perf, eventStart, rawEvent.size());
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(pipelineMutex);
+	if(!pipelineRunning){
+		pipelineStop = false;
+		pipelineRunning = true;
+		pipelineThread = std::thread(&Unpacker::PipelineWorker, this);
+	}
+	while(pipelineQueue.size() >= pipeline_depth)
+		pipelineSpace.wait(lock);
+
+	// Hand the events over without copying them.
+	pipelineQueue.push_back(BuiltEvent());
+	BuiltEvent &queued = pipelineQueue.back();
+	queued.events.swap(buildEvent.events);
+	queued.startTime = buildEvent.startTime;
+	queued.realStartTime = buildEvent.realStartTime;
+	queued.realStopTime = buildEvent.realStopTime;
+	pipelineReady.notify_one();
+}
+
+/** Process the next raw event of a .rev file written by an earlier scan.
+  * \param[in]  reader_ The open raw event file to read from.
+  * \return False at the end of the file or if the raw event could not be read.
+  */
+bool Unpacker::ReplayRawEvent(RawEventReader &reader_){
+	if(!reader_.Next())
+		return false;
+
+	if(numRawEvt == 0)
+		firstTime = reader_.GetFirstTime();
+
+	for(size_t i = 0; i < reader_.GetNumEventHits(); i++){
+		XiaData *event = GetNewEvent();
+		reader_.GetHit(i, event);
+		buildEvent.events.push_back(event);
+	}
+	buildEvent.startTime = reader_.GetStartTime();
+	buildEvent.realStartTime = reader_.GetRealStartTime();
+	buildEvent.realStopTime = reader_.GetRealStopTime();
+	numRawEvt++;
+
+	DispatchRawEvent();
+	return true;
+}
+
+/** Process queued raw events until the pipeline is stopped. This is the body
+  * of the processing thread.
+  * \return Nothing.
+  */
+void Unpacker::PipelineWorker(){
+	BuiltEvent current;
+	std::unique_lock<std::mutex> lock(pipelineMutex);
+	while(true){
+		while(pipelineQueue.empty() && !pipelineStop)
+			pipelineReady.wait(lock);
+		if(pipelineQueue.empty())
+			break;
+
+		current.events.swap(pipelineQueue.front().events);
+		current.startTime = pipelineQueue.front().startTime;
+		current.realStartTime = pipelineQueue.front().realStartTime;
+		current.realStopTime = pipelineQueue.front().realStopTime;
+		pipelineQueue.pop_front();
+		pipelineBusy = true;
+		pipelineSpace.notify_one();
+		lock.unlock();
+
+		PERF_START(eventStart);
+		StartRawEvent(current);
+		ProcessRawEvent(interface);
+		PERF_EVENT(perf, eventStart, rawEvent.size());
+
+		lock.lock();
+		pipelineBusy = false;
+		pipelineSpace.notify_one();
+	}
+}
+
+/** Wait until the processing thread has finished every queued raw event.
+  * \return Nothing.
+  */
+void Unpacker::WaitForPipeline(){
+	std::unique_lock<std::mutex> lock(pipelineMutex);
+	while(!pipelineQueue.empty() || pipelineBusy)
+		pipelineSpace.wait(lock);
+}
+
+/** Wait for the processing thread to finish all queued raw events and stop
+  * it. Does nothing if the pipeline is not running.
+  * \return Nothing.
+  */
+void Unpacker::StopPipeline(){
+	{
+		std::lock_guard<std::mutex> lock(pipelineMutex);
+		if(!pipelineRunning){ return; }
+		pipelineStop = true;
+		pipelineReady.notify_one();
+	}
+	pipelineThread.join();
+	pipelineRunning = false;
+}
+
 /** Push an event into the event list.
   * \param[in]  event_ The XiaData to push onto the back of the event list.
   * \return True if the XiaData's module number is valid and false otherwise.
   */
 bool Unpacker::AddEvent(XiaData *event_){
-	if(event_->modNum > MAX_PIXIE_MOD){ return false; }
+	unsigned int crateMod = event_->modNum - 100 * event_->crateNum;
+	if(event_->modNum < 100 * event_->crateNum || crateMod > MAX_PIXIE_MOD){ return false; }
 	
+	unsigned int index = GetModuleIndex(event_);
+
 	// Check for the need to add a new deque to the event list.
-	if(event_->modNum+1 > (unsigned int)eventList.size()){
-		while (eventList.size() < event_->modNum + 1) {
+	if(index+1 > (unsigned int)eventList.size()){
+		while (eventList.size() < index + 1) {
 			eventList.push_back(std::deque<XiaData*>());
 		}
 	}
 	
-	eventList.at(event_->modNum).push_back(event_);
+	eventList[index].push_back(event_);
 	
+	channelCounts.Increment(event_->crateNum, crateMod, event_->chanNum);
+
 	return true;
 }
 
+/** Return the index of the event list which holds the events of a module.
+  * The modules of each crate follow those of the previous crate, so that the
+  * event list stays compact for multi-crate systems.
+  * \param[in]  event_ Pointer to the event.
+  * \return The event list index of the event's module.
+  */
+unsigned int Unpacker::GetModuleIndex(const XiaData *event_){
+	return event_->crateNum * (MAX_PIXIE_MOD + 1) + (event_->modNum - 100 * event_->crateNum);
+}
+
 /** Clear all events in the spill event list. WARNING! This method will delete all events in the
   * event list. This could cause seg faults if the events are used elsewhere.
   * \return Nothing.
   */	
 void Unpacker::ClearEventList(){
 	for(std::vector<std::deque<XiaData*> >::iterator iter = eventList.begin(); iter != eventList.end(); iter++){
-		clearDeque((*iter));
+		ClearDeque((*iter));
 	}
+	ClearDeque(pendingHits);
+	mergeHeap.clear();
+}
+
+/** Get the time before which every raw event window is closed. This is the
+  * earliest of the last hit times of all modules which have data in the
+  * current spill, since the next spill can only contain later hits from
+  * those modules. To keep the carry-over bounded, the horizon never trails the
+  * latest hit in the spill by more than the carry window. When several input
+  * streams are merged, the horizon is further limited by the input horizon.
+  * \return The stream horizon in pixie clock ticks.
+  */
+double Unpacker::GetStreamHorizon(){
+	double minLast = std::numeric_limits<double>::max();
+	double maxLast = -std::numeric_limits<double>::max();
+	for(std::vector<std::deque<XiaData*> >::iterator iter = eventList.begin(); iter != eventList.end(); iter++){
+		if(iter->empty())
+			continue;
+		double last = iter->front()->time;
+		for(std::deque<XiaData*>::iterator evt = iter->begin(); evt != iter->end(); evt++){
+			if((*evt)->time > last)
+				last = (*evt)->time;
+		}
+		if(last < minLast)
+			minLast = last;
+		if(last > maxLast)
+			maxLast = last;
+	}
+	if(maxLast < minLast) // No events in this spill.
+		return streamHorizon;
+	spillEndTime = maxLast;
+	return std::min(std::max(minLast, maxLast - MAX_CARRY_WIDTHS*eventWidth), inputHorizon);
+}
+
+/** Move all events held over from the previous spill to the front of the
+  * event list. Carried events are always earlier than the new spill data
+  * from the same module, so the list remains sorted by module.
+  * \return Nothing.
+  */
+void Unpacker::MergeCarryList(){
+	for(size_t mod = 0; mod < carryList.size(); mod++){
+		if(carryList[mod].empty())
+			continue;
+		while(eventList.size() < mod + 1)
+			eventList.push_back(std::deque<XiaData*>());
+		eventList[mod].insert(eventList[mod].begin(), carryList[mod].begin(), carryList[mod].end());
+		carryList[mod].clear();
+	}
+}
+
+/** Move all events which were not built into raw events from the event
+  * list to the carry list. The traces of carried events are converted, since
+  * the spill buffer they point to will be overwritten by the next spill.
+  * \return Nothing.
+  */
+void Unpacker::FillCarryList(){
+	if(carryList.size() < eventList.size())
+		carryList.resize(eventList.size());
+
+	// Hits waiting for a trigger are earlier than any left in the event list.
+	for(std::deque<XiaData*>::iterator evt = pendingHits.begin(); evt != pendingHits.end(); evt++){
+		(*evt)->getTrace();
+		(*evt)->copyHeaderView();
+		carryList[GetModuleIndex(*evt)].push_back(*evt);
+	}
+	pendingHits.clear();
+
+	for(size_t mod = 0; mod < eventList.size(); mod++){
+		for(std::deque<XiaData*>::iterator evt = eventList[mod].begin(); evt != eventList[mod].end(); evt++){
+			(*evt)->getTrace();
+			(*evt)->copyHeaderView();
+			carryList[mod].push_back(*evt);
+		}
+		eventList[mod].clear();
+	}
+	mergeHeap.clear();
 }
 
 /** Clear all events in the raw event list. WARNING! This method will delete all events in the
@@ -158,24 +731,23 @@ void Unpacker::ClearEventList(){
   * \return Nothing.
   */
 void Unpacker::ClearRawEvent(){
-	clearDeque(rawEvent);
+	rawHits.clear();
+	ClearDeque(rawEvent);
 }
 
-/** Get the minimum channel time from the event list.
+/** Get the minimum channel time from the merge heap and the hits left over from the previous window.
   * \param[out] time The minimum time from the event list in system clock ticks.
   * \return True if the event list is not empty and false otherwise.
   */
 bool Unpacker::GetFirstTime(double &time){
-	if(IsEmpty())
+	if(mergeHeap.empty() && pendingHits.empty())
 		return false;
 
-	time = std::numeric_limits<double>::max();
-	for(std::vector<std::deque<XiaData*> >::iterator iter = eventList.begin(); iter != eventList.end(); iter++){
-		if(iter->empty())
-			continue;
-		if(iter->front()->time < time)
-			time = iter->front()->time;
-	}
+	unsigned long long first = (mergeHeap.empty() ? pendingHits.front()->timeStamp : mergeHeap.front().first);
+	if(!pendingHits.empty() && pendingHits.front()->timeStamp < first)
+		first = pendingHits.front()->timeStamp;
+
+	time = (double)(first >> XiaData::cfdFractionBits);
 	
 	return true;
 }
@@ -199,185 +771,532 @@ void Unpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/){
 	ClearRawEvent();
 }
 
-/** Called form ReadSpill. Scan the current spill and construct a list of
-  * events which fired by obtaining the module, channel, trace, etc. of the
-  * timestamped event. This method will construct the event list for
-  * later processing.
+/** Fill XiaDatas from the located and decoded headers of a module buffer.
+  * HEADER_LEN fixes the header layout at compile time (4 words, 8 with
+  * energy sums, 12 with QDCs, or 16 with both) so that the loop has no
+  * checks on the header length. A HEADER_LEN of 0 reads the length of
+  * each event instead, for buffers which mix layouts.
+  * \param[in]  headers The located and decoded headers of the buffer.
+  * \param[in]  modNum  The module number of the buffer.
+  * \param[out] events  The list of XiaDatas decoded from the buffer.
+  * \param[in]  cache   Per-thread cache of events to use instead of GetNewEvent(). May be NULL.
+  * \return The number of XiaDatas read from the buffer.
+  */
+template <unsigned int HEADER_LEN>
+unsigned long Unpacker::DecodeEvents(const ListModeHeaders &headers, const unsigned int &modNum, std::vector<XiaData*> &events, std::vector<XiaData*> *cache){
+	unsigned long numEvents = 0;
+	unsigned long numDropped = 0;
+	XiaData *lastVirtualChannel = NULL;
+
+	const size_t numLocated = headers.size();
+	for(size_t evt = 0; evt < numLocated; evt++){
+		const unsigned int headerLength = (HEADER_LEN ? HEADER_LEN : headers.headerLength[evt]);
+		unsigned int eventLength  = headers.eventLength[evt];
+		unsigned int traceLength  = headers.traceLength[evt];
+
+		// Rev. D header lengths not clearly defined in pixie16app_defs
+		//! magic numbers here for now
+		if(headerLength == 1){
+			// this is a manual statistics block inserted by the poll program
+			/*stats.DoStatisticsBlock(&buf[1], modNum);
+			numEvents = -10;*/
+			continue;
+		}
+
+		// One last check
+		if( traceLength / 2 + headerLength != eventLength ){
+			static LogSite badLengthSite("ReadBuffer: Bad event length");
+			if(badLengthSite.Hit(eventLength, headerLength)){
+				std::cout << "ReadBuffer: Bad event length (" << eventLength << ") does not correspond with length of header (";
+				std::cout << headerLength << ") and length of trace (" << traceLength << ")" << badLengthSite.Suppressed() << std::endl;
+			}
+			continue;
+		}
+
+		// Drop the hits of filtered channels before any work is done for them.
+		const unsigned int fullModNum = modNum + 100 * headers.crateNum[evt];
+		if(fullModNum < hitFilterMask.size() && (hitFilterMask[fullModNum] & (1u << headers.chanNum[evt]))){
+			const unsigned int energy = ((headers.flags[evt] & ListModeHeaders::SATURATED) ? 16383 : headers.energy[evt]);
+			if(energy < hitThresholds[16*fullModNum + headers.chanNum[evt]]){
+				numDropped++;
+				continue;
+			}
+		}
+
+		XiaData *currentEvt = (cache ? GetCachedEvent(*cache) : GetNewEvent());
+		const unsigned int *evtBuf = headers.start[evt];
+
+		currentEvt->virtualChannel = ((headers.flags[evt] & ListModeHeaders::VIRTUAL) != 0);
+		currentEvt->saturatedBit   = ((headers.flags[evt] & ListModeHeaders::SATURATED) != 0);
+		currentEvt->pileupBit      = ((headers.flags[evt] & ListModeHeaders::PILEUP) != 0);
+
+		// Headers of 8 and 16 words carry the onboard energy sums after the
+		// first four words, and those of 12 and 16 words end with the QDCs.
+		// They are only decoded from the spill buffer if they are asked for.
+		if(headerLength > 4)
+			currentEvt->setHeaderView(evtBuf, headerLength);
+		currentEvt->headerLength = headerLength;
+		currentEvt->spillIndex = spillNumber;
+		currentEvt->hitIndex = (spillStart ? evtBuf - spillStart : 0);
+
+		currentEvt->chanNum = headers.chanNum[evt];
+		currentEvt->slotNum = headers.slotNum[evt];
+		currentEvt->crateNum = headers.crateNum[evt];
+		currentEvt->modNum = modNum + 100 * headers.crateNum[evt]; // Handle multiple crates
+		/*if(currentEvt->virtualChannel){
+			DetectorLibrary* modChan = DetectorLibrary::get();
+
+			currentEvt->modNum += modChan->GetPhysicalModules();
+			if(modChan->at(modNum, chanNum).HasTag("construct_trace")){
+				lastVirtualChannel = currentEvt;
+			}
+		}*/
+
+		currentEvt->energy = headers.energy[evt];
+		if(currentEvt->saturatedBit){ currentEvt->energy = 16383; }
+				
+		currentEvt->trigTime = headers.lowTime[evt];
+		currentEvt->cfdTime	= headers.cfdTime[evt];
+		currentEvt->eventTimeHi = headers.highTime[evt];
+		currentEvt->eventTimeLo = headers.lowTime[evt];
+		currentEvt->time = headers.time[evt];
+		currentEvt->timeStamp = headers.timeStamp[evt];
+
+		// Check if trace data follows the channel header. The event boundaries
+		// are already known, so skipped traces are never touched.
+		if( traceLength > 0 && !skip_traces ){
+			// sbuf points to the beginning of trace data
+			const unsigned short *sbuf = (const unsigned short *)(evtBuf + headerLength);
+
+			/*if(currentEvt->saturatedBit)
+				currentEvt->trace.SetValue("saturation", 1);*/
+
+			// Read the trace data (2-bytes per sample, i.e. 2 samples per word).
+			// In trace view mode we only record where the samples are.
+			if(trace_view_mode)
+				currentEvt->setTraceView(sbuf, traceLength);
+			else
+				currentEvt->adcTrace.assign(sbuf, sbuf+traceLength);
+
+			if(lastVirtualChannel != NULL){
+				std::vector<int> &virtualTrace = lastVirtualChannel->getTrace();
+				if(virtualTrace.empty())
+					virtualTrace.assign(traceLength, 0);
+				for(unsigned int k = 0; k < traceLength; k ++){
+					virtualTrace[k] += sbuf[k];
+				}
+			}
+		}
+
+		events.push_back(currentEvt);
+		
+		numEvents++;
+	}
+
+	if(numDropped > 0){ numDroppedHits += numDropped; }
+
+	return numEvents;
+}
+
+/** Decode a single module buffer into a list of XiaData without touching the
+  * event list. This method may be called from several threads at once as long
+  * as each thread passes its own event cache.
   * \param[in]  buf    Pointer to an array of unsigned ints containing raw buffer data.
-  * \param[out] bufLen The number of words in the buffer.
+  * \param[out] events The list of XiaDatas decoded from the buffer.
+  * \param[in]  cache  Per-thread cache of events to use instead of GetNewEvent(). May be NULL.
   * \return The number of XiaDatas read from the buffer.
   */
-int Unpacker::ReadBuffer(unsigned int *buf, unsigned long &bufLen){						
-	// multiplier for high bits of 48-bit time
-	static const double HIGH_MULT = pow(2., 32.); 
+int Unpacker::DecodeBuffer(unsigned int *buf, std::vector<XiaData*> &events, std::vector<XiaData*> *cache/*=NULL*/){
+	// Header columns are reused between buffers to avoid reallocating them.
+	static thread_local ListModeHeaders headers;
 
 	unsigned int modNum;
 	unsigned long numEvents = 0;
 	unsigned int *bufStart = buf;
 
 	// Determine the number of words in the buffer
-	bufLen = *buf++;
+	unsigned long bufLen = *buf++;
 
 	// Read the module number
 	modNum = *buf++;
 
-	XiaData *lastVirtualChannel = NULL;
-
 	if(bufLen > 0){ // Check if the buffer has data
 		if(bufLen == 2){ // this is an empty channel
 			return 0;
 		}
-		while( buf < bufStart + bufLen ){
-			XiaData *currentEvt = new XiaData();
-
-			// decoding event data... see pixie16app.c
-			// buf points to the start of channel data
-			unsigned int chanNum      = (buf[0] & 0x0000000F);
-			unsigned int slotNum      = (buf[0] & 0x000000F0) >> 4;
-			unsigned int crateNum     = (buf[0] & 0x00000F00) >> 8;
-			unsigned int headerLength = (buf[0] & 0x0001F000) >> 12;
-			unsigned int eventLength  = (buf[0] & 0x1FFE0000) >> 17;
-
-			currentEvt->virtualChannel = ((buf[0] & 0x20000000) != 0);
-			currentEvt->saturatedBit   = ((buf[0] & 0x40000000) != 0);
-			currentEvt->pileupBit      = ((buf[0] & 0x80000000) != 0);
-
-			// Rev. D header lengths not clearly defined in pixie16app_defs
-			//! magic numbers here for now
-			if(headerLength == 1){
-				// this is a manual statistics block inserted by the poll program
-				/*stats.DoStatisticsBlock(&buf[1], modNum);
-				buf += eventLength;
-				numEvents = -10;*/
-				continue;
-			}
-			if(headerLength != 4 && headerLength != 8 && headerLength != 12 && headerLength != 16){
-				std::cout << "ReadBuffer: Unexpected header length: " << headerLength << std::endl;
-				std::cout << "ReadBuffer:   Buffer " << modNum << " of length " << bufLen << std::endl;
-				std::cout << "ReadBuffer:   CHAN:SLOT:CRATE " << chanNum << ":" << slotNum << ":" << crateNum << std::endl;
-				// advance to next event and continue
-				// buf += EventLength;
-				// continue;
-
-				// skip the rest of this buffer
-				return numEvents;
-			}
 
-			unsigned int lowTime     = buf[1];
-			unsigned int highTime    = buf[2] & 0x0000FFFF;
-			unsigned int cfdTime     = (buf[2] & 0xFFFF0000) >> 16;
-			unsigned int energy      = buf[3] & 0x0000FFFF;
-			unsigned int traceLength = (buf[3] & 0xFFFF0000) >> 16;
+		// Find the event boundaries, then decode all fixed header fields at once.
+		// decoding event data... see pixie16app.c
+		headers.Locate(buf, bufStart + bufLen);
+		headers.Decode();
 
-			if(headerLength == 8 || headerLength == 16){
-				// Skip the onboard partial sums for now 
-				// trailing, leading, gap, baseline
-			}
-
-			if(headerLength >= 12){
-				int offset = headerLength - 8;
-				for (int i=0; i < currentEvt->numQdcs; i++){
-					currentEvt->qdcValue[i] = buf[offset + i];
-				}
-			}	 
+		// A module writes the same header layout for every channel unless
+		// they were set up differently, so pick the decoder once per buffer.
+		switch(headers.GetCommonHeaderLength()){
+			case 4:
+				numEvents = DecodeEvents<4>(headers, modNum, events, cache);
+				break;
+			case 8:
+				numEvents = DecodeEvents<8>(headers, modNum, events, cache);
+				break;
+			case 12:
+				numEvents = DecodeEvents<12>(headers, modNum, events, cache);
+				break;
+			case 16:
+				numEvents = DecodeEvents<16>(headers, modNum, events, cache);
+				break;
+			default:
+				numEvents = DecodeEvents<0>(headers, modNum, events, cache);
+		}
 
-			// One last check
-			if( traceLength / 2 + headerLength != eventLength ){
-				std::cout << "ReadBuffer: Bad event length (" << eventLength << ") does not correspond with length of header (";
-				std::cout << headerLength << ") and length of trace (" << traceLength << ")" << std::endl;
-				buf += eventLength;
-				continue;
+		if(headers.StoppedOnBadHeader()){
+			unsigned int badWord = headers.GetBadWord();
+			static LogSite badHeaderSite("ReadBuffer: Unexpected header length");
+			if(badHeaderSite.Hit(badWord, modNum)){
+				std::cout << "ReadBuffer: Unexpected header length: " << ((badWord & 0x0001F000) >> 12) << " (event length " << ((badWord & 0x1FFE0000) >> 17) << ")" << badHeaderSite.Suppressed() << std::endl;
+				std::cout << "ReadBuffer:   Buffer " << modNum << " of length " << bufLen << std::endl;
+				std::cout << "ReadBuffer:   CHAN:SLOT:CRATE " << (badWord & 0x0000000F) << ":" << ((badWord & 0x000000F0) >> 4) << ":" << ((badWord & 0x00000F00) >> 8) << std::endl;
 			}
+			// skip the rest of this buffer
+		}
+	} 
+	else{ // if buffer has data
+		std::cout << "ReadBuffer: ERROR IN ReadBuffer, LIST UNKNOWN" << std::endl;
+		return -100;
+	}
+	
+	return numEvents;
+}
 
-			// Handle multiple crates
-			modNum += 100 * crateNum;
+/** Called form ReadSpill. Scan the current spill and construct a list of
+  * events which fired by obtaining the module, channel, trace, etc. of the
+  * timestamped event. This method will construct the event list for
+  * later processing.
+  * \param[in]  buf    Pointer to an array of unsigned ints containing raw buffer data.
+  * \param[out] bufLen The number of words in the buffer.
+  * \return The number of XiaDatas read from the buffer.
+  */
+int Unpacker::ReadBuffer(unsigned int *buf, unsigned long &bufLen){
+	bufLen = *buf;
+	decodedEvents.clear();
+	int retval = DecodeBuffer(buf, decodedEvents);
+	AddEvents(decodedEvents);
+	return retval;
+}
 
-			currentEvt->chanNum = chanNum;
-			currentEvt->modNum = modNum;
-			/*if(currentEvt->virtualChannel){
-				DetectorLibrary* modChan = DetectorLibrary::get();
+/** Push a list of decoded events into the event list. Events which can not be
+  * added are released.
+  * \param[in]  events_ The list of XiaDatas to add.
+  * \return Nothing.
+  */
+void Unpacker::AddEvents(const std::vector<XiaData*> &events_){
+	for(std::vector<XiaData*>::const_iterator iter = events_.begin(); iter != events_.end(); iter++){
+		if(!AddEvent(*iter))
+			ReleaseEvent(*iter);
+	}
+}
 
-				currentEvt->modNum += modChan->GetPhysicalModules();
-				if(modChan->at(modNum, chanNum).HasTag("construct_trace")){
-					lastVirtualChannel = currentEvt;
-				}
-			}*/
+/** Get an event from a per-thread cache. If the cache is empty it is refilled
+  * from the event pool while holding the pool lock. Without pool mode, events
+  * are simply allocated on the heap.
+  * \param[in]  cache The per-thread event cache.
+  * \return Pointer to a cleared XiaData.
+  */
+XiaData *Unpacker::GetCachedEvent(std::vector<XiaData*> &cache){
+	if(!pool_mode){ return new XiaData(); }
+	if(cache.empty()){
+		std::lock_guard<std::mutex> lock(poolMutex);
+		for(unsigned int i = 0; i < EVENT_CACHE_SIZE; i++){
+			if(eventPool.empty()){ GrowPool(); }
+			cache.push_back(eventPool.back());
+			eventPool.pop_back();
+		}
+	}
+	XiaData *output = cache.back();
+	cache.pop_back();
+	return output;
+}
 
-			channel_counts[modNum][chanNum]++;
+/** Return an unused event to a per-thread cache or, if no cache is given,
+  * release it through ReleaseEvent().
+  * \param[in]  event_ The event to return.
+  * \param[in]  cache  The per-thread event cache. May be NULL.
+  * \return Nothing.
+  */
+void Unpacker::ReleaseCachedEvent(XiaData *event_, std::vector<XiaData*> *cache){
+	if(!cache || !pool_mode){
+		if(cache){ delete event_; }
+		else{ ReleaseEvent(event_); }
+		return;
+	}
+	event_->clear();
+	cache->push_back(event_);
+}
 
-			currentEvt->energy = energy;
-			if(currentEvt->saturatedBit){ currentEvt->energy = 16383; }
-					
-			currentEvt->trigTime = lowTime;
-			currentEvt->cfdTime	= cfdTime;
-			currentEvt->eventTimeHi = highTime;
-			currentEvt->eventTimeLo = lowTime;
-			currentEvt->time = highTime * HIGH_MULT + lowTime;
+/** Decode module buffers from the list of pending buffers until none are
+  * left. This is the body of each decode thread.
+  * \param[in]  next_ The index of the next buffer which has not been picked up by a thread.
+  * \return Nothing.
+  */
+void Unpacker::DecodeWorker(std::atomic<size_t> *next_){
+	std::vector<XiaData*> cache;
+	size_t index;
+	while((index = (*next_)++) < pendingBuffers.size()){
+		decodedBuffers[index].clear();
+		decodedRetvals[index] = DecodeBuffer(pendingBuffers[index], decodedBuffers[index], &cache);
+	}
 
-			buf += headerLength;
-			// Check if trace data follows the channel header
-			if( traceLength > 0 ){
-				// sbuf points to the beginning of trace data
-				unsigned short *sbuf = (unsigned short *)buf;
+	// Give any unused events back to the pool.
+	if(!cache.empty()){
+		std::lock_guard<std::mutex> lock(poolMutex);
+		eventPool.insert(eventPool.end(), cache.begin(), cache.end());
+	}
+}
 
-				currentEvt->reserve(traceLength);
+/** Decode all pending module buffers using the decode threads and add the
+  * results to the event list in the order the buffers appeared in the spill.
+  * \param[out] numEvents The total number of events decoded.
+  * \return The return value of the first failed buffer or of the last buffer.
+  */
+int Unpacker::DecodePendingBuffers(unsigned long &numEvents){
+	int retval = 0;
+	if(pendingBuffers.empty())
+		return retval;
 
-				/*if(currentEvt->saturatedBit)
-					currentEvt->trace.SetValue("saturation", 1);*/
+	if(decodedBuffers.size() < pendingBuffers.size())
+		decodedBuffers.resize(pendingBuffers.size());
+	decodedRetvals.assign(pendingBuffers.size(), 0);
 
-				if( lastVirtualChannel != NULL && lastVirtualChannel->adcTrace.empty() ){		
-					lastVirtualChannel->assign(traceLength, 0);
-				}
-				// Read the trace data (2-bytes per sample, i.e. 2 samples per word)
-				for(unsigned int k = 0; k < traceLength; k ++){		
-					currentEvt->push_back(sbuf[k]);
+	std::atomic<size_t> next(0);
+	size_t numThreads = std::min((size_t)decode_threads, pendingBuffers.size());
+	std::vector<std::thread> workers;
+	for(size_t i = 1; i < numThreads; i++){
+		workers.push_back(std::thread(&Unpacker::DecodeWorker, this, &next));
+	}
+	DecodeWorker(&next);
+	for(std::vector<std::thread>::iterator iter = workers.begin(); iter != workers.end(); iter++){
+		iter->join();
+	}
 
-					if(lastVirtualChannel != NULL){
-						lastVirtualChannel->adcTrace[k] += sbuf[k];
-					}
+	// Merge the results. Stop at the first buffer which failed to read.
+	for(size_t i = 0; i < pendingBuffers.size(); i++){
+		retval = decodedRetvals[i];
+		if(retval <= -100){
+			for(size_t j = i; j < pendingBuffers.size(); j++){
+				for(std::vector<XiaData*>::iterator iter = decodedBuffers[j].begin(); iter != decodedBuffers[j].end(); iter++){
+					ReleaseEvent(*iter);
 				}
-				buf += traceLength / 2;
+				decodedBuffers[j].clear();
 			}
- 
-			AddEvent(currentEvt);
-			
-			numEvents++;
+			break;
 		}
-	} 
-	else{ // if buffer has data
-		std::cout << "ReadBuffer: ERROR IN ReadBuffData, LIST UNKNOWN" << std::endl;
-		return -100;
+		else if(retval > 0){
+			numEvents += retval;
+		}
+		AddEvents(decodedBuffers[i]);
+		decodedBuffers[i].clear();
 	}
-	
-	return numEvents;
+	pendingBuffers.clear();
+
+	return retval;
 }
 
 Unpacker::Unpacker() :
 	eventWidth(62), // ~ 500 ns in 8 ns pixie clock ticks.
    debug_mode(false),
 	running(true),
+	pool_mode(false),
+	trace_view_mode(false),
+	skip_traces(false),
+	stream_mode(false),
+	hit_table_mode(false),
+	decode_threads(1),
+	pipeline_depth(0),
 	interface(NULL),
+	eventRecorder(NULL),
 	TOTALREAD(1000000), // Maximum number of data words to read.
 	maxWords(131072), // Maximum number of data words for revision D.	
 	numRawEvt(0), // Count of raw events read from file.
+	channelCounts(MAX_PIXIE_MOD+1, MAX_PIXIE_CHAN+1),
 	firstTime(0),
 	eventStartTime(0),
 	realStartTime(0),
-	realStopTime(0)
+	realStopTime(0),
+	poolBytes(0),
+	memoryBudget(0),
+	overBudget(false),
+	pipelineRunning(false),
+	pipelineStop(false),
+	pipelineBusy(false),
+	streamHorizon(0),
+	inputHorizon(std::numeric_limits<double>::max()),
+	spillEndTime(0),
+	spillNumber(0),
+	spillStart(NULL),
+	numDroppedHits(0),
+	maxTriggerBefore(0),
+	maxTriggerAfter(0),
+	numUntriggered(0),
+	maxChannelWidth(0)
 {
-	for(unsigned int i = 0; i <= MAX_PIXIE_MOD; i++){
-		for(unsigned int j = 0; j <= MAX_PIXIE_CHAN; j++){
-			channel_counts[i][j] = 0;
-		}
-	}
 }
 
 /// Destructor.
 Unpacker::~Unpacker(){
+	StopPipeline();
+	ClearDeque(buildEvent.events);
 	ClearRawEvent();
 	ClearEventList();
+	for(std::vector<std::deque<XiaData*> >::iterator iter = carryList.begin(); iter != carryList.end(); iter++){
+		ClearDeque((*iter));
+	}
+	ClearPool();
+}
+
+/** Build and process all events which are being held over for the next
+  * spill. This should be called when there is no more data to read (e.g. at
+  * the end of a file) when stream mode is enabled. Does nothing otherwise.
+  * \return Nothing.
+  */
+void Unpacker::FlushEvents(){
+	ClearEventList();
+	MergeCarryList();
+	if(!IsEmpty()){
+		// Every window is closed since there is no more data.
+		streamHorizon = std::numeric_limits<double>::max();
+
+		PERF_START(sortStart);
+		TimeSort();
+		PERF_RECORD(perf, PerfCounters::SORT, sortStart, 1);
+
+		PERF_START(buildStart);
+		while(BuildRawEvent()){
+			PERF_RECORD(perf, PerfCounters::BUILD, buildStart, 1);
+			DispatchRawEvent();
+			PERF_RESTART(buildStart);
+		}
+		if(!triggerWindows.empty())
+			numUntriggered += pendingHits.size();
+		ClearEventList();
+	}
+	StopPipeline();
 }
 
+/** Enable or disable recycling of XiaData objects. When enabled, events are
+  * allocated in slabs which are owned by the Unpacker and are returned to
+  * the pool (along with their trace capacity) instead of being deleted.
+  * The mode may not be disabled while pooled events are still in use.
+  * \param[in]  state_ Set to true to enable the event pool.
+  * \return The new state of the pool mode flag.
+  */
+bool Unpacker::SetPoolMode(bool state_/*=true*/){
+	if(!state_ && pool_mode){
+		if(eventPool.size() != GetPoolCapacity()){
+			std::cout << "SetPoolMode: Unable to disable event pool while " << GetPoolCapacity()-eventPool.size() << " events are in use.\n";
+			return pool_mode;
+		}
+		ClearPool();
+	}
+	return (pool_mode = state_);
+}
+
+/** Drop the hits of some channels right after their header is decoded,
+  * before an XiaData is taken for them or their trace is read. A hit is
+  * dropped if its energy is below the threshold of its channel. Dropped
+  * hits are not counted in the channel counts. Must not be changed while
+  * a spill is being read.
+  * \param[in]  thresholds_ The minimum raw energy of each channel, indexed by 16*module+channel with 100 times the crate added to the module. A threshold of HIT_DROP_ALL drops every hit of a channel.
+  * \return Nothing.
+  */
+void Unpacker::SetHitFilter(const std::vector<unsigned int> &thresholds_){
+	hitFilterMask.clear();
+	hitThresholds.clear();
+	for(size_t i = 0; i < thresholds_.size(); i++){
+		if(thresholds_[i] == 0){ continue; }
+		if(hitFilterMask.size() <= i/16){
+			hitFilterMask.resize(i/16+1, 0);
+			hitThresholds.resize(16*hitFilterMask.size(), 0);
+		}
+		hitFilterMask[i/16] |= (1u << (i%16));
+		hitThresholds[i] = thresholds_[i];
+	}
+}
+
+/** Set the width of the raw event window for each channel. A raw event
+  * still opens at the earliest hit which has not been built, but each hit
+  * is only added to it if it is within the width of its own channel. Later
+  * hits of channels with a narrower window start the next raw event, so
+  * slow detectors may be given a wide window without adding unrelated hits
+  * of fast ones. Not used in trigger mode. Must not be changed while a
+  * spill is being read.
+  * \param[in]  widths_ The window width of each channel in pixie clock ticks, indexed by 16*module+channel with 100 times the crate added to the module. Channels with a width of 0 use the event width.
+  * \return Nothing.
+  */
+void Unpacker::SetChannelWidths(const std::vector<unsigned int> &widths_){
+	channelWidths.clear();
+	maxChannelWidth = 0;
+	for(size_t i = 0; i < widths_.size(); i++){
+		if(widths_[i] == 0){ continue; }
+		channelWidths.resize(i+1, 0);
+		channelWidths[i] = widths_[i];
+		maxChannelWidth = std::max(maxChannelWidth, widths_[i]);
+	}
+}
+
+/** Only build raw events around the hits of trigger channels. The window
+  * of a trigger opens a number of clock ticks before it and closes a
+  * number of ticks after it, and may differ from channel to channel. The
+  * hits inside the window form the raw event, including any further
+  * triggers, and hits which are not in the window of any trigger are
+  * released without being built. The event width is not used in this
+  * mode. An empty list of windows returns to the normal event building.
+  * Must not be changed while a spill is being read.
+  * \param[in]  windows_ The (before, after) window of each channel in pixie clock ticks, indexed by 16*module+channel with 100 times the crate added to the module. Channels whose window is (0, 0) are not triggers.
+  * \return Nothing.
+  */
+void Unpacker::SetTriggerWindows(const std::vector<std::pair<unsigned int, unsigned int> > &windows_){
+	triggerWindows.clear();
+	maxTriggerBefore = 0;
+	maxTriggerAfter = 0;
+	for(size_t i = 0; i < windows_.size(); i++){
+		if(windows_[i].first == 0 && windows_[i].second == 0){ continue; }
+		triggerWindows.resize(i+1, std::make_pair(0u, 0u));
+		triggerWindows[i] = windows_[i];
+		maxTriggerBefore = std::max(maxTriggerBefore, windows_[i].first);
+		maxTriggerAfter = std::max(maxTriggerAfter, windows_[i].second);
+	}
+}
+
+/** Return an event to the Unpacker. If pool mode is enabled the event is
+  * cleared and placed back into the pool, otherwise it is deleted.
+  * \param[in]  event_ Pointer to an event obtained from the rawEvent.
+  * \return Nothing.
+  */
+void Unpacker::ReleaseEvent(XiaData *event_){
+	if(!event_){ return; }
+	if(!pool_mode){ 
+		delete event_;
+		return;
+	}
+	event_->clear();
+	std::unique_lock<std::mutex> lock(poolMutex, std::defer_lock);
+	if(pipelineRunning){ lock.lock(); }
+	eventPool.push_back(event_);
+}
+
+#ifdef SCAN_PERF
+namespace {
+	/// Marks the time at which ReadSpill returns, through any of its returns.
+	struct SpillEndMark{
+		PerfCounters::clock::time_point &mark; /// The time point to set.
+
+		SpillEndMark(PerfCounters::clock::time_point &mark_) : mark(mark_) { }
+
+		~SpillEndMark(){ mark = PerfCounters::clock::now(); }
+	};
+}
+#endif
+
 /** ReadSpill is responsible for constructing a list of pixie16 events from
   * a raw data spill. This method performs sanity checks on the spill and
   * calls ReadBuffer in order to construct the event list.
@@ -405,6 +1324,19 @@ bool Unpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbos
 	time_t theTime = 0;
 
 	counter++;
+	pendingBuffers.clear();
+	spillEndTime = 0;
+	spillStart = data;
+
+	if(pool_mode){ MeasurePool(); }
+
+#ifdef SCAN_PERF
+	// Everything between two spills is counted as reading the next spill.
+	PERF_START(decodeStart);
+	if(lastSpillEnd != PerfCounters::clock::time_point())
+		perf.Record(PerfCounters::READ, lastSpillEnd);
+	SpillEndMark spillEnd(lastSpillEnd);
+#endif
  
 	unsigned int lenRec = 0xFFFFFFFF;
 	unsigned int vsn = 0xFFFFFFFF;
@@ -422,15 +1354,15 @@ bool Unpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbos
 	
 		// Check sanity of record length and vsn
 		if(lenRec > maxWords || (vsn > maxVsn && vsn != 9999 && vsn != 1000)){ 
-			if(is_verbose){
-				std::cout << "ReadSpill: SANITY CHECK FAILED: lenRec = " << lenRec << ", vsn = " << vsn << ", read " << nWords_read << " of " << nWords << std::endl;
+			static LogSite sanitySite("ReadSpill: Sanity check failed");
+			if(sanitySite.Hit(lenRec, vsn) && is_verbose){
+				std::cout << "ReadSpill: SANITY CHECK FAILED: lenRec = " << lenRec << ", vsn = " << vsn << ", read " << nWords_read << " of " << nWords << sanitySite.Suppressed() << std::endl;
 			}
 			return false;	
 		}
 
 		// If the record length is 6, this is an empty channel.
 		// Skip this vsn and continue with the next
-		//! Revision specific, so move to ReadBuffData
 		if(lenRec==6){
 			nWords_read += lenRec;
 			lastVsn=vsn;
@@ -441,13 +1373,24 @@ bool Unpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbos
 		// range, begin reading the buffer.
 		if(vsn < maxVsn){
 			if(lastVsn != 0xFFFFFFFF && vsn != lastVsn+1){
-				if(is_verbose){ 
-					std::cout << "ReadSpill: MISSING BUFFER " << lastVsn+1 << ", lastVsn = " << lastVsn << ", vsn = " << vsn << ", lenrec = " << lenRec << std::endl;
+				static LogSite missingSite("ReadSpill: Missing buffer");
+				if(missingSite.Hit(lastVsn+1, vsn) && is_verbose){ 
+					std::cout << "ReadSpill: MISSING BUFFER " << lastVsn+1 << ", lastVsn = " << lastVsn << ", vsn = " << vsn << ", lenrec = " << lenRec << missingSite.Suppressed() << std::endl;
 				}
 				ClearEventList();
+				pendingBuffers.clear();
 				fullSpill=false; // WHY WAS THIS TRUE!?!? CRT
 			}
 			
+			// With several decode threads, only record where the buffer is
+			// and decode all of the buffers at once when the spill is done.
+			if(decode_threads > 1){
+				pendingBuffers.push_back(&data[nWords_read]);
+				lastVsn = vsn;
+				nWords_read += lenRec;
+				continue;
+			}
+
 			// Read the buffer.	After read, the vector eventList will 
 			//contain pointers to all channels that fired in this buffer
 			retval = ReadBuffer(&data[nWords_read], bufLen);
@@ -495,6 +1438,21 @@ bool Unpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbos
 		}
 	} // while still have words
 
+	// Decode any buffers which were deferred to the decode threads.
+	if(!pendingBuffers.empty()){
+		retval = DecodePendingBuffers(numEvents);
+		if(retval <= -100){
+			if(is_verbose){ std::cout << "ReadSpill: READOUT PROBLEM " << retval << " in event " << counter << std::endl; }
+			if(retval == -100){
+				if(is_verbose){ std::cout << "ReadSpill:  Remove list" << std::endl; }
+				ClearEventList();
+			}
+			return false;
+		}
+	}
+
+	PERF_RECORD(perf, PerfCounters::DECODE, decodeStart, numEvents);
+
 	if(nWords > TOTALREAD || nWords_read > TOTALREAD){
 		std::cout << "ReadSpill: Values of nn - " << nWords << " nk - "<< nWords_read << " TOTALREAD - " << TOTALREAD << std::endl;
 		return false;
@@ -519,18 +1477,39 @@ bool Unpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbos
 			// Sort the vector of pointers eventlist according to time
 			//double lastTimestamp = (*(eventList.rbegin()))->time;
 
+			// When building events across spills, find the time up to which
+			// every raw event window is guaranteed to be closed and put the
+			// events held over from the previous spill back into the list.
+			PERF_START(sortStart);
+			if(stream_mode){
+				streamHorizon = GetStreamHorizon();
+				MergeCarryList();
+			}
+
 			// Sort the event list in time
 			TimeSort();
+			PERF_RECORD(perf, PerfCounters::SORT, sortStart, numEvents);
 
 			// Once the vector of pointers eventlist is sorted based on time,
 			// begin the event processing in ScanList().
 			// ScanList will also clear the event list for us.
+			PERF_START(buildStart);
 			while(BuildRawEvent()){
-				// Process the event.
-				ProcessRawEvent(interface);
+				PERF_RECORD(perf, PerfCounters::BUILD, buildStart, 1);
+				// Process the event, or queue it for the processing thread.
+				DispatchRawEvent();
+				PERF_RESTART(buildStart);
 			}
+
+			// Trace views point into this spill, which is only valid until we return.
+			if(pipeline_depth > 0 && trace_view_mode && !skip_traces)
+				WaitForPipeline();
 			
-			ClearEventList();
+			// Hold over any events whose window is still open.
+			if(stream_mode)
+				FillCarryList();
+			else
+				ClearEventList();
 			
 			// Once the eventlist has been scanned, reset the number 
 			// of events to zero and update the event counter
@@ -564,11 +1543,7 @@ bool Unpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbos
 void Unpacker::Write(){
 	std::ofstream count_output("counts.dat");
 	if(count_output.good()){
-		for(unsigned int i = 0; i <= MAX_PIXIE_MOD; i++){
-			for(unsigned int j = 0; j <= MAX_PIXIE_CHAN; j++){
-				count_output << i << "\t" << j << "\t" << channel_counts[i][j] << std::endl;
-			}
-		}
+		channelCounts.Write(count_output);
 		count_output.close();
 	}
 }
@@ -14,15 +14,28 @@ XiaData::XiaData(){
 /// Constructor from a pointer to another XiaData.
 XiaData::XiaData(XiaData *other_){
 	adcTrace = other_->adcTrace;
+	traceView = other_->traceView;
+	traceViewLength = other_->traceViewLength;
+	headerView = other_->headerView;
+	headerViewLength = other_->headerViewLength;
+	headerLength = other_->headerLength;
+	spillIndex = other_->spillIndex;
+	hitIndex = other_->hitIndex;
 
 	energy = other_->energy; 
 	time = other_->time;
+	timeStamp = other_->timeStamp;
 	
 	for(int i = 0; i < numQdcs; i++){
 		qdcValue[i] = other_->qdcValue[i];
 	}
+	for(int i = 0; i < numEnergySums; i++){
+		energySums[i] = other_->energySums[i];
+	}
 
+	slotNum = other_->slotNum;
 	modNum = other_->modNum;
+	crateNum = other_->crateNum;
 	chanNum = other_->chanNum;
 	trigTime = other_->trigTime;
 	cfdTime = other_->cfdTime;
@@ -53,17 +66,100 @@ void XiaData::push_back(const int &input_){
 	adcTrace.push_back(input_);
 }
 
+void XiaData::setTraceView(const unsigned short *data_, const size_t &size_){
+	adcTrace.clear();
+	traceView = (size_ > 0 ? data_ : NULL);
+	traceViewLength = (size_ > 0 ? size_ : 0);
+}
+
+std::vector<int> &XiaData::getTrace(){
+	if(traceView){
+		adcTrace.assign(traceView, traceView+traceViewLength);
+		traceView = NULL;
+		traceViewLength = 0;
+	}
+	return adcTrace;
+}
+
+void XiaData::copyHeaderView(){
+	if(!headerView){ return; }
+	for(int i = 0; i < numQdcs; i++){
+		qdcValue[i] = getQdcValue(i);
+	}
+	for(int i = 0; i < numEnergySums; i++){
+		energySums[i] = getEnergySum(i);
+	}
+	headerView = NULL;
+	headerViewLength = 0;
+}
+
+void XiaData::pack(CompactHit &hit_) const {
+	hit_.timeStamp = timeStamp;
+	hit_.spillIndex = spillIndex;
+	hit_.hitIndex = hitIndex;
+	hit_.traceOffset = 0;
+	hit_.traceLength = getTraceLength();
+	hit_.energy = (uint16_t)energy;
+	hit_.modNum = modNum;
+	hit_.chanNum = chanNum;
+	hit_.crateNum = crateNum;
+	hit_.slotNum = slotNum;
+	hit_.headerLength = headerLength;
+	hit_.flags = (virtualChannel ? CompactHit::VIRTUAL : 0) | (pileupBit ? CompactHit::PILEUP : 0) | (saturatedBit ? CompactHit::SATURATED : 0) |
+	             (cfdForceTrig ? CompactHit::CFD_FORCE : 0) | (cfdTrigSource ? CompactHit::CFD_SOURCE : 0);
+	hit_.reserved = 0;
+}
+
+void XiaData::unpack(const CompactHit &hit_){
+	const uint64_t ticks = hit_.getTimeTicks();
+	timeStamp = hit_.timeStamp;
+	eventTimeHi = (unsigned int)(ticks >> 32);
+	eventTimeLo = (unsigned int)(ticks & 0xFFFFFFFF);
+	trigTime = eventTimeLo;
+	time = (double)ticks;
+	cfdTime = hit_.getCfdTime();
+	eventTime = 0.0;
+
+	spillIndex = hit_.spillIndex;
+	hitIndex = hit_.hitIndex;
+	energy = hit_.energy;
+	modNum = hit_.modNum;
+	chanNum = hit_.chanNum;
+	crateNum = hit_.crateNum;
+	slotNum = hit_.slotNum;
+	headerLength = hit_.headerLength;
+
+	virtualChannel = (hit_.flags & CompactHit::VIRTUAL);
+	pileupBit = (hit_.flags & CompactHit::PILEUP);
+	saturatedBit = (hit_.flags & CompactHit::SATURATED);
+	cfdForceTrig = (hit_.flags & CompactHit::CFD_FORCE);
+	cfdTrigSource = (hit_.flags & CompactHit::CFD_SOURCE);
+}
+
 void XiaData::clear(){
 	adcTrace.clear();
+	traceView = NULL;
+	traceViewLength = 0;
+	headerView = NULL;
+	headerViewLength = 0;
+	headerLength = 0;
+	spillIndex = 0;
+	hitIndex = 0;
 
 	energy = 0.0; 
 	time = 0.0;
+	timeStamp = 0;
 	
 	for(int i = 0; i < numQdcs; i++){
 		qdcValue[i] = 0;
 	}
+	for(int i = 0; i < numEnergySums; i++){
+		energySums[i] = 0;
+	}
 
+	slotNum = 0;
 	modNum = 0;
+	crateNum = 0;
 	chanNum = 0;
 	trigTime = 0;
 	cfdTime = 0;
@@ -99,7 +195,7 @@ ChannelEvent::ChannelEvent(XiaData *event_){
 	cfdvals = NULL;
 	Clear();
 	event = event_;
-	size = event->adcTrace.size();
+	size = event->getTrace().size();
 	if(size != 0){
 		xvals = new float[size];
 		yvals = new float[size];
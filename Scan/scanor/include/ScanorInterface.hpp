@@ -23,7 +23,7 @@ private:
     ScanorInterface(const ScanorInterface &){}; //!< Overloaded constructor
     ScanorInterface &operator=(ScanorInterface const &);//!< Equality constructor
 
-    bool MakeModuleData(const uint32_t *data, unsigned long nWords, unsigned
+    bool MakeModuleData(uint32_t *data, unsigned long nWords, unsigned
                             int maxWords);
     static ScanorInterface *instance_;//!< The only instance of ScanorInterface
     Unpacker *unpacker_;//!< The unpacker object that we are going to use to
@@ -25,19 +25,18 @@ ScanorInterface* ScanorInterface::get() {
     return instance_;
 }
 
-/** \brief inserts a delimiter in between individual module data and at end of
- * buffer. Data is then passed to hissub_sec() for processing.
+/** \brief checks the module buffers of a reassembled spill and passes the
+ * spill to the unpacker. The buffers already follow each other in the spill,
+ * so they are checked in place instead of being copied again.
  * \param [in] data : the data to parse
  * \param [in] nWords : the length of the data
  * \param [in] maxWords : the maximum words to get
  * \return true if successful */
-bool ScanorInterface::MakeModuleData(const uint32_t *data, unsigned long nWords,
+bool ScanorInterface::MakeModuleData(uint32_t *data, unsigned long nWords,
                                         unsigned int maxWords) {
     const unsigned int maxVsn = 14; // no more than 14 pixie modules per crate
 
-    unsigned int inWords = 0, outWords = 0;
-
-    static uint32_t modData[TOTALREAD];
+    unsigned int inWords = 0;
 
     do {
 	uint32_t lenRec = data[inWords];
@@ -47,23 +46,18 @@ bool ScanorInterface::MakeModuleData(const uint32_t *data, unsigned long nWords,
 #ifdef VERBOSE
 	    std::cout << "SANITY CHECK FAILED: lenRec = " << lenRec
 		 << ", vsn = " << vsn << ", inWords = " << inWords
-		 << " of " << nWords << ", outWords = " << outWords << std::endl;
+		 << " of " << nWords << std::endl;
 #endif
 	    return false;
 	}
-
-	/*Extract the data from TotData and place into ModData*/
-	memcpy(&modData[outWords], &data[inWords], lenRec * sizeof(uint32_t));
 	inWords  += lenRec;
-	outWords += lenRec;
-        
     } while (inWords < nWords);
 
-    if(nWords > TOTALREAD || inWords > TOTALREAD || outWords > TOTALREAD ) {
+    if(nWords > TOTALREAD || inWords > TOTALREAD) {
         std::stringstream ess;
         ess << "Values of nn - " << nWords << " nk - "<< inWords
-            << " mm - " << outWords << " TOTALREAD - " << TOTALREAD << std::endl;
-        ess << "One of the variables named nn, nk, or mm"
+            << " TOTALREAD - " << TOTALREAD << std::endl;
+        ess << "One of the variables named nn or nk "
             << "have exceeded the value of TOTALREAD. The value of "
             << "TOTALREAD MUST NEVER exceed 1000000 for correct "
             << "opertation of code between 32-bit and 64-bit architecture "
@@ -75,7 +69,7 @@ bool ScanorInterface::MakeModuleData(const uint32_t *data, unsigned long nWords,
     }
 
 	// Process the data.
-	unpacker_->ReadSpill(modData, outWords);
+	unpacker_->ReadSpill(data, inWords);
 
     return true;
 }
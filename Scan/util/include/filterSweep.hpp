@@ -0,0 +1,206 @@
+#ifndef FILTERSWEEP_HPP
+#define FILTERSWEEP_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "Unpacker.hpp"
+#include "ScanInterface.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// class filterSweepUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/** Unpacker which keeps a copy of the traces of one channel, for the
+  * filter parameter sweep of the filterSweepScanner.
+  */
+class filterSweepUnpacker : public Unpacker {
+  public:
+	/// Default constructor.
+	filterSweepUnpacker();
+
+	/// Destructor.
+	~filterSweepUnpacker(){  }
+
+	/// Set the module of the signal of interest.
+	void SetMod(const unsigned int &mod){ mod_ = mod; }
+
+	/// Set the channel of the signal of interest.
+	void SetChan(const unsigned int &chan){ chan_ = chan; }
+
+	/// Set the maximum number of traces to keep.
+	void SetMaxTraces(const size_t &max){ maxTraces_ = max; }
+
+	unsigned int GetMod(){ return mod_; }
+
+	unsigned int GetChan(){ return chan_; }
+
+	/// Return the number of traces kept.
+	size_t GetNumTraces(){ return offsets_.size(); }
+
+	/// Return the samples of a kept trace.
+	const unsigned short *GetTrace(const size_t &index_){ return &samples_[offsets_[index_]]; }
+
+	/// Return the number of samples of a kept trace.
+	size_t GetTraceLength(const size_t &index_){ return lengths_[index_]; }
+
+  private:
+	unsigned int mod_; ///< The module of the signal of interest.
+	unsigned int chan_; ///< The channel of the signal of interest.
+	size_t maxTraces_; ///< The maximum number of traces to keep.
+
+	std::vector<unsigned short> samples_; ///< The samples of all kept traces, back to back.
+	std::vector<size_t> offsets_; ///< The index of the first sample of each trace.
+	std::vector<size_t> lengths_; ///< The number of samples of each trace.
+
+	/** Copy the traces of the signal of interest and delete all events.
+	  * \param[in]  addr_ Pointer to a ScanInterface object.
+	  * \return Nothing.
+	  */
+	virtual void ProcessRawEvent(ScanInterface *addr_=NULL);
+
+	/** Add an event to generic statistics output.
+	  * \param[in]  event_ Pointer to the current XIA event.
+	  * \param[in]  addr_  Pointer to a ScanInterface object.
+	  * \return Nothing.
+	  */
+	virtual void RawStats(XiaData *event_, ScanInterface *addr_=NULL){  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class filterSweepScanner
+///////////////////////////////////////////////////////////////////////////////
+
+/** Headless counterpart of the filterer. Once the input has been read, the
+  * energy filter of the kept traces is computed for every combination of a
+  * grid of rise times, flat tops and decay constants, in parallel, and the
+  * resolution of the energy peak is reported for each of them.
+  */
+class filterSweepScanner : public ScanInterface {
+  public:
+	/// Default constructor.
+	filterSweepScanner();
+
+	/// Destructor.
+	~filterSweepScanner();
+
+	/** ExtraArguments is used to send command line arguments to classes derived
+	  * from ScanInterface. This method should loop over the optionExt elements
+	  * in the vector userOpts and check for those options which have been flagged
+	  * as active by ::Setup(). This should be overloaded in the derived class.
+	  * \return Nothing.
+	  */
+	virtual void ExtraArguments();
+
+	/** ArgHelp is used to allow a derived class to add a command line option
+	  * to the main list of options. This method is called at the end of
+	  * from the ::Setup method.
+	  * \return Nothing.
+	  */
+	virtual void ArgHelp();
+
+	/** SyntaxStr is used to print a linux style usage message to the screen.
+	  * \param[in]  name_ The name of the program.
+	  * \return Nothing.
+	  */
+	virtual void SyntaxStr(char *name_);
+
+	/** Initialize the scanner.
+	  * \param[in]  prefix_ String to append to the beginning of system output.
+	  * \return True upon successfully initializing and false otherwise.
+	  */
+	virtual bool Initialize(std::string prefix_="");
+
+	/** Receive various status notifications from the scan. The sweep is run
+	  * when the scan is complete.
+	  * \param[in] code_ The notification code passed from ScanInterface methods.
+	  * \return Nothing.
+	  */
+	virtual void Notify(const std::string &code_="");
+
+	/** Return a pointer to the Unpacker object to use for data unpacking.
+	  * If no object has been initialized, create a new one.
+	  * \return Pointer to an Unpacker object.
+	  */
+	virtual Unpacker *GetCore();
+
+  private:
+	/// A trace prepared for the sweep.
+	struct SweepTrace{
+		const unsigned short *samples; ///< The samples of the trace.
+		size_t length; ///< The number of samples.
+		size_t trigger; ///< The sample at which the trigger filter fired.
+		double baseline; ///< The mean of the samples before the trigger.
+	};
+
+	/// The result of one set of filter parameters.
+	struct SweepResult{
+		int rise; ///< The energy filter rise time, in samples.
+		int gap; ///< The energy filter flat top, in samples.
+		double tau; ///< The decay constant, in samples.
+		size_t count; ///< The number of energies in the peak.
+		double centroid; ///< The median energy of the peak.
+		double fwhm; ///< The FWHM of the peak, estimated from its interquartile range.
+		double resolution; ///< The FWHM over the centroid, in percent.
+	};
+
+	bool init; /// Set to true when the initialization process successfully completes.
+
+	double trigRise; /// The trigger filter rise time, in μs.
+	double trigFlat; /// The trigger filter flat top, in μs.
+	double trigThresh; /// The trigger filter threshold, in ADC units.
+
+	std::vector<double> riseTimes; /// The energy filter rise times to sweep, in μs.
+	std::vector<double> flatTops; /// The energy filter flat tops to sweep, in μs.
+	std::vector<double> decayTimes; /// The decay constants to sweep, in μs.
+
+	double window; /// Half width of the peak window around the median energy, in percent.
+	unsigned int numThreads; /// The number of threads computing the sweep.
+
+	std::vector<SweepTrace> traces; /// The traces with a valid trigger.
+	std::vector<SweepResult> results; /// The results in the order of the grid.
+
+	/** Split a string of colon separated numbers.
+	  * \param[in]  arg_    The string to split.
+	  * \param[out] fields_ The numbers.
+	  * \return Nothing.
+	  */
+	static void SplitFields(const std::string &arg_, std::vector<double> &fields_);
+
+	/** Parse a range of values given as <first>[:<last>[:<step>]].
+	  * \param[in]  arg_    The string to parse.
+	  * \param[out] values_ The values of the range.
+	  * \return True if the range is valid and false otherwise.
+	  */
+	static bool ParseRange(const std::string &arg_, std::vector<double> &values_);
+
+	/** Find the trigger and baseline of every kept trace.
+	  * \return The number of traces with a valid trigger.
+	  */
+	size_t PrepareTraces();
+
+	/** Compute the energies and resolution of every parameter set, from the
+	  * next one not yet taken until all are done. This is the body of each
+	  * sweep thread.
+	  * \param[in]  next_ The index of the next parameter set to compute.
+	  * \return Nothing.
+	  */
+	void SweepWorker(std::atomic<size_t> *next_);
+
+	/** Compute the energy of every trace and the resolution of the peak for
+	  * one set of filter parameters.
+	  * \param[in,out] result_   The parameter set, filled with its result.
+	  * \param[out]    filter_   Work space for the energy filter.
+	  * \param[out]    energies_ Work space for the energies.
+	  * \return Nothing.
+	  */
+	void Sweep(SweepResult &result_, std::vector<double> &filter_, std::vector<double> &energies_);
+
+	/** Run the sweep and print the results.
+	  * \return Nothing.
+	  */
+	void RunSweep();
+};
+
+#endif
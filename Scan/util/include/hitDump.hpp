@@ -0,0 +1,196 @@
+#ifndef HITDUMP_HPP
+#define HITDUMP_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Unpacker.hpp"
+#include "ScanInterface.hpp"
+#include "HitTable.hpp"
+
+class ColumnWriter;
+
+///////////////////////////////////////////////////////////////////////////////
+// class hitDumpUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/** Unpacker which writes every channel hit of the input to a columnar file
+  * (see ColumnWriter.hpp) instead of building raw events. Spills are copied
+  * into a queue and decoded into hit tables by a pool of worker threads, one
+  * spill per thread. The main thread writes the time ordered hits of each
+  * finished spill in the order the spills were read.
+  */
+class hitDumpUnpacker : public Unpacker {
+  public:
+	/// Default constructor.
+	hitDumpUnpacker();
+
+	/// Destructor. Writes any queued spills and closes the output.
+	~hitDumpUnpacker();
+
+	/** Open the output file and start one worker thread for each decode thread.
+	  * \param[in]  fname_  The name of the column file to write.
+	  * \param[in]  chunk_  The number of hits in each chunk of the file.
+	  * \param[in]  level_  The zlib compression level of the columns.
+	  * \param[in]  traces_ Set to true to write the trace samples to fname_.trc.
+	  * \return True if the output files were opened and false otherwise.
+	  */
+	bool Open(const std::string &fname_, const unsigned int &chunk_, const int &level_, const bool &traces_);
+
+	/** Copy a spill into the queue of the worker threads. Finished spills are
+	  * written before returning. Only waits if the queue is full.
+	  * \param[in]  data       Pointer to an array of unsigned ints containing the spill data.
+	  * \param[in]  nWords     The number of words in the array.
+	  * \param[in]  is_verbose Toggle the verbosity flag on/off.
+	  * \return True if the output is open and false otherwise.
+	  */
+	virtual bool ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose=true);
+
+	/** Wait for all queued spills to be decoded and write them.
+	  * \return Nothing.
+	  */
+	void Flush();
+
+	/** Write the remaining spills, stop the worker threads and close the output.
+	  * \return Nothing.
+	  */
+	void Close();
+
+	/// Return the number of hits written.
+	unsigned long long GetNumHits() const { return numHits; }
+
+	/// Return the number of spills written.
+	unsigned long long GetNumSpills() const { return numSpills; }
+
+  private:
+	/// A spill waiting to be decoded or written.
+	struct SpillJob{
+		std::vector<unsigned int> words; /// A copy of the spill data.
+		HitTable hits; /// The hits decoded from the spill.
+		bool verbose; /// Print warnings for this spill.
+		bool done; /// Set by the worker once the hits are ready.
+		bool good; /// False if the spill failed a sanity check.
+	};
+
+	static const unsigned int maxVsn = 14; /// No more than 14 pixie modules per crate.
+
+	ColumnWriter *writer; /// The output column file.
+	std::ofstream traceFile; /// The output trace samples (only used with traces).
+	bool writeTraces; /// True if trace samples are written.
+
+	unsigned long long numHits; /// The number of hits written.
+	unsigned long long numSpills; /// The number of spills written.
+	unsigned long long numBadSpills; /// The number of spills which failed to decode.
+	unsigned long long numSamples; /// The number of trace samples written.
+
+	unsigned long long hitTime; /// Fixed point time of the current hit.
+	unsigned int hitMod; /// Module of the current hit.
+	unsigned int hitChan; /// Channel of the current hit.
+	double hitEnergy; /// Energy of the current hit.
+	unsigned int hitCfd; /// CFD time of the current hit.
+	unsigned int hitFlags; /// HitTable flags of the current hit.
+	unsigned long long hitTraceOffset; /// Index of the first trace sample of the current hit.
+	unsigned int hitTraceLength; /// Number of trace samples of the current hit.
+
+	std::vector<std::thread> workers; /// The threads decoding spills.
+	std::deque<SpillJob*> jobs; /// Spills in the order they were read.
+	std::deque<SpillJob*> todo; /// Spills not yet picked up by a worker.
+	std::vector<SpillJob*> spare; /// Written spills kept for reuse.
+	std::mutex jobMutex; /// Lock for the spill queues.
+	std::condition_variable jobReady; /// Signalled when a spill is queued or the workers stop.
+	std::condition_variable jobDone; /// Signalled when a worker finishes a spill.
+	size_t maxJobs; /// The maximum number of spills in the queue.
+	bool stopping; /// Set to true to stop the worker threads.
+
+	/** Decode spills from the queue until told to stop. This is the body of
+	  * each worker thread.
+	  * \return Nothing.
+	  */
+	void DecodeSpills();
+
+	/** Decode all of the module buffers of a spill into its hit table and
+	  * order the hits in time.
+	  * \param[in]  job_   The spill to decode.
+	  * \param[in]  cache_ The per-thread event cache.
+	  * \return Nothing.
+	  */
+	void DecodeSpill(SpillJob *job_, std::vector<XiaData*> &cache_);
+
+	/** Write finished spills from the front of the queue, waiting until at
+	  * most maxJobs_ spills are left.
+	  * \param[in]  maxJobs_ The number of spills which may be left in the queue.
+	  * \return Nothing.
+	  */
+	void WriteSpills(const size_t &maxJobs_);
+
+	/** Write the hits of a decoded spill.
+	  * \param[in]  job_ The spill to write.
+	  * \return Nothing.
+	  */
+	void WriteSpill(SpillJob *job_);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class hitDumpScanner
+///////////////////////////////////////////////////////////////////////////////
+
+class hitDumpScanner : public ScanInterface {
+  public:
+  	/// Default constructor.
+	hitDumpScanner();
+
+	/// Destructor.
+	~hitDumpScanner();
+
+	/** ExtraArguments is used to send command line arguments to classes derived
+	  * from ScanInterface. This method should loop over the optionExt elements
+	  * in the vector userOpts and check for those options which have been flagged
+	  * as active by ::Setup(). This should be overloaded in the derived class.
+	  * \return Nothing.
+	  */
+	virtual void ExtraArguments();
+
+	/** ArgHelp is used to allow a derived class to add a command line option
+	  * to the main list of options. This method is called at the end of
+	  * from the ::Setup method.
+	  * \return Nothing.
+	  */
+	virtual void ArgHelp();
+
+	/** SyntaxStr is used to print a linux style usage message to the screen.
+	  * \param[in]  name_ The name of the program.
+	  * \return Nothing.
+	  */
+	virtual void SyntaxStr(char *name_);
+
+	/** Open the output file and start the decoding threads.
+	  * \param[in]  prefix_ String to append to the beginning of system output.
+	  * \return True upon successfully initializing and false otherwise.
+	  */
+	virtual bool Initialize(std::string prefix_="");
+
+	/** Receive various status notifications from the scan.
+	  * \param[in] code_ The notification code passed from ScanInterface methods.
+	  * \return Nothing.
+	  */
+	virtual void Notify(const std::string &code_="");
+
+	/** Return a pointer to the Unpacker object to use for data unpacking.
+	  * If no object has been initialized, create a new one.
+	  * \return Pointer to an Unpacker object.
+	  */
+	virtual Unpacker *GetCore();
+
+  private:
+	bool init; /// Set to true when the initialization process successfully completes.
+	unsigned int chunkSize; /// The number of hits in each chunk of the output.
+	int compression; /// The zlib compression level of the output.
+	bool writeTraces; /// Set to true to write the trace samples.
+};
+
+#endif
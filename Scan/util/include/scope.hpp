@@ -2,8 +2,11 @@
 #define OSCILLOSCOPE_HPP
 
 #include <ctime>
+#include <chrono>
 #include <vector>
 #include <deque>
+#include <map>
+#include <set>
 #include <cmath>
 #include <string>
 
@@ -48,9 +51,18 @@ class scopeUnpacker : public Unpacker {
 	
 	int GetThreshHigh(){ return threshHigh_; }
 
+	/** Set the channels passed on in monitor mode, by XiaData::getID(). In
+	  * monitor mode every event of these channels is passed to the scanner
+	  * and the module, channel and thresholds are ignored.
+	  * \param[in]  ids_ The channel IDs to monitor, empty to end monitor mode.
+	  * \return Nothing.
+	  */
+	void SetMonitor(const std::set<unsigned int> &ids_){ monitor_ = ids_; }
+
   private:
 	unsigned int mod_; ///< The module of the signal of interest.
 	unsigned int chan_; ///< The channel of the signal of interest.
+	std::set<unsigned int> monitor_; ///< The IDs of the channels monitored, if any.
 	int threshLow_;
 	int threshHigh_;
 
@@ -92,6 +104,36 @@ class scopeScanner : public ScanInterface {
 	/// Set the maximum number of events to store.
 	void SetNumEvents(size_t num_){ numEvents = num_; }
 
+	/** Enable or disable the accumulation mode. In accumulation mode every
+	  * waveform of the selected channel is added to a running sum of each
+	  * sample and the average is drawn at a fixed frame rate, instead of
+	  * drawing stored waveforms.
+	  * \param[in]  rate_ The number of frames drawn per second, zero to disable.
+	  * \return True if the accumulation mode is enabled.
+	  */
+	bool SetAccumulate(const double &rate_);
+
+	/** Enable or disable the persistence mode. In persistence mode every
+	  * waveform of the selected channel is binned into a map of ADC value
+	  * versus sample time, which is drawn at a fixed frame rate.
+	  * \param[in]  rate_ The number of frames drawn per second, zero to disable.
+	  * \param[in]  binWidth_ The number of ADC channels per vertical bin.
+	  * \return True if the persistence mode is enabled.
+	  */
+	bool SetPersist(const double &rate_, const int &binWidth_);
+
+	/** Enable or disable the monitor mode. In monitor mode every waveform of
+	  * a set of channels is analyzed for its baseline, amplitude and rise
+	  * time, and the averaged waveform and statistics of every channel are
+	  * drawn in a grid at the frame rate of the accumulation mode.
+	  * \param[in]  ids_ The channel IDs (module*16+channel) to monitor, empty to disable.
+	  * \return True if the monitor mode is enabled.
+	  */
+	bool SetMonitor(const std::set<unsigned int> &ids_);
+
+	/// Print the statistics of the monitored channels.
+	void PrintMonitor();
+
 	/// Stop the run.
 	void StopACQ(){ running = false; }
 	
@@ -189,7 +231,7 @@ class scopeScanner : public ScanInterface {
 	  */
 	virtual bool ProcessEvents();
 
-	/** Clear the event deque.
+	/** Clear the event deque, the accumulated waveform and the counters.
 	  * \return Nothing.
 	  */
 	void ClearEvents();
@@ -219,6 +261,38 @@ class scopeScanner : public ScanInterface {
 	std::vector<int> x_vals;
 	std::deque<ChannelEvent*> chanEvents_; ///<The buffer of waveforms to be plotted.
 
+	bool accumulate_; ///< True if waveforms are summed instead of stored.
+	bool persist_; ///< True if waveforms are binned into a persistence map instead of stored.
+	double frameRate_; ///< The number of frames drawn per second in accumulation or persistence mode.
+	std::vector<double> accumSum_; ///< The running sum of each sample of the accumulated waveforms.
+	unsigned long long accumCount_; ///< The number of waveforms in the running sum or persistence map.
+
+	static const int persistBins_ = 256; ///< The number of vertical bins of the persistence map.
+	std::vector<unsigned int> persistCounts_; ///< The persistence map, one column of persistBins_ per sample.
+	size_t persistLength_; ///< The trace length of the persistence map.
+	int persistLow_; ///< The ADC value of the lower edge of the persistence map.
+	int persistBinWidth_; ///< The number of ADC channels per vertical bin.
+
+	/// The statistics of a channel in monitor mode.
+	struct MonitorChannel {
+		unsigned int id; ///< The channel ID, module*16+channel.
+		unsigned long long count; ///< The number of waveforms analyzed.
+		double baselineSum; ///< The sum of the baselines.
+		double amplitudeSum; ///< The sum of the amplitudes above the baseline.
+		double riseTimeSum; ///< The sum of the 10% to 90% rise times, in ns.
+		double firstTime; ///< The time of the first event, in filter clock ticks.
+		double lastTime; ///< The time of the last event, in filter clock ticks.
+		std::vector<double> sum; ///< The running sum of each sample of the waveforms.
+		unsigned long long sumCount; ///< The number of waveforms in the running sum.
+		TGraph *graph; ///< The graph of the averaged waveform.
+	};
+	std::vector<MonitorChannel> monitorChans_; ///< The monitored channels, in the order of the grid.
+	std::map<unsigned int, size_t> monitorIndex_; ///< The index in monitorChans_ of each channel ID.
+	std::chrono::steady_clock::time_point lastFrame_; ///< The time the last frame was drawn.
+
+	unsigned long long numSeen_; ///< The number of waveforms of the selected channel received.
+	unsigned long long numUsed_; ///< The number of those waveforms which were drawn or accumulated.
+
 	time_t last_trace; ///< The time of the last trace.
 	
 	std::string saveFile_; ///< The name of the file to save a trace.
@@ -236,9 +310,45 @@ class scopeScanner : public ScanInterface {
 	TF1 *SetupFunc();
 
 	void ResetGraph(unsigned int size_);
-	
+
+	/// Return the title of the plots, with the fraction of dropped waveforms.
+	std::string GetTitle();
+
+	/** Add a waveform to the running sum. A change of the trace length
+	  * restarts the sum.
+	  * \param[in]  event_ The event holding the waveform.
+	  * \return True if the next frame is due and false otherwise.
+	  */
+	bool Accumulate(XiaData *event_);
+
+	/** Add a waveform to the persistence map. The vertical range of the map
+	  * is centred on the first waveform and samples outside of it are put in
+	  * the edge bins. A change of the trace length restarts the map.
+	  * \param[in]  event_ The event holding the waveform.
+	  * \return True if the next frame is due and false otherwise.
+	  */
+	bool Persist(XiaData *event_);
+
+	/** Add a waveform to the statistics of its monitored channel.
+	  * \param[in]  event_ The event holding the waveform.
+	  * \return True if the next frame is due and false otherwise.
+	  */
+	bool Monitor(XiaData *event_);
+
+	/// Return true if the next frame of the accumulation or persistence mode is due.
+	bool FrameDue();
+
 	/// Plot the current event.
 	void Plot();
+
+	/// Plot the average of the accumulated waveforms.
+	void PlotAccumulated();
+
+	/// Plot the persistence map.
+	void PlotPersistence();
+
+	/// Plot the grid of monitored channels.
+	void PlotMonitor();
 };
 
 #endif
@@ -0,0 +1,178 @@
+#ifndef TIMEDIFF_HPP
+#define TIMEDIFF_HPP
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Unpacker.hpp"
+#include "ScanInterface.hpp"
+#include "HitTable.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// class timeDiffUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/** Unpacker which fills the time difference spectra of channel pairs for
+  * the alignment of the channel timing. Every spill is decoded into a hit
+  * table and ordered in time, and a single sweep over it pairs each hit with
+  * the hits of the preceding window, carried over from one spill to the
+  * next, so the cost grows with the number of hits times the hits per window
+  * rather than with the number of pairs. Either all pairs of channels are
+  * filled, or only the pairs of each channel with a reference channel.
+  */
+class timeDiffUnpacker : public Unpacker {
+  public:
+	/// The peak of the time difference spectrum of a pair of channels.
+	struct Peak{
+		unsigned int first; /// The ID of the first channel (mod*16+chan).
+		unsigned int second; /// The ID of the second channel (mod*16+chan).
+		double mean; /// The time of the second channel minus the first at the peak (in ns).
+		double sigma; /// The width of the peak (in ns).
+		unsigned long long counts; /// The number of counts in the spectrum.
+	};
+
+	/// Default constructor.
+	timeDiffUnpacker();
+
+	/// Destructor.
+	~timeDiffUnpacker();
+
+	/** Set up the spectra.
+	  * \param[in]  window_    The largest time difference paired (in ns).
+	  * \param[in]  binWidth_  The width of the bins of the spectra (in ns).
+	  * \param[in]  tick_      The length of a clock tick of the timestamps (in ns).
+	  * \param[in]  reference_ The ID of the reference channel, or -1 to fill all pairs.
+	  * \return Nothing.
+	  */
+	void SetSpectra(const double &window_, const double &binWidth_, const double &tick_, const int &reference_);
+
+	/** Decode all module buffers of a spill into the hit table, order them in
+	  * time and fill the spectra of the pairs of hits within the window.
+	  * \param[in]  data       Pointer to an array of unsigned ints containing the spill data.
+	  * \param[in]  nWords     The number of words in the array.
+	  * \param[in]  is_verbose Toggle the verbosity flag on/off.
+	  * \return True if the spill was read successfully and false otherwise.
+	  */
+	virtual bool ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose=true);
+
+	/** Find the peak of the spectrum of every pair with at least minCounts_
+	  * counts.
+	  * \param[in]  minCounts_ The smallest number of counts of a spectrum with a peak.
+	  * \param[out] peaks_     The peaks found.
+	  * \return Nothing.
+	  */
+	void FindPeaks(const unsigned long long &minCounts_, std::vector<Peak> &peaks_) const;
+
+	/// Return the number of hits swept.
+	unsigned long long GetNumHits() const { return numHits; }
+
+	/// Return the number of pairs of hits filled.
+	unsigned long long GetNumPairs() const { return numPairs; }
+
+	/// Return the number of spills which failed to decode.
+	unsigned long long GetNumBadSpills() const { return numBadSpills; }
+
+  private:
+	static const unsigned int maxVsn = 14; /// No more than 14 pixie modules per crate.
+
+	HitTable hits; /// The hits of the current spill.
+	std::vector<XiaData*> cache; /// Cache of hits reused for every buffer.
+	std::deque<std::pair<unsigned long long, unsigned int> > recent; /// The timeStamp and ID of the hits within the window of the last hit.
+	std::map<unsigned int, std::vector<unsigned int> > spectra; /// The time difference spectra, by first ID * 65536 + second ID.
+
+	unsigned long long window; /// The largest time difference paired, in fixed point clock ticks.
+	unsigned long long binWidth; /// The width of the bins, in fixed point clock ticks.
+	unsigned int numBins; /// The number of bins of each spectrum.
+	double tick; /// The length of a clock tick (in ns).
+	int reference; /// The ID of the reference channel, or -1 to fill all pairs.
+
+	unsigned long long numHits; /// The number of hits swept.
+	unsigned long long numPairs; /// The number of pairs filled.
+	unsigned long long numBadSpills; /// The number of spills which failed to decode.
+
+	/** Pair a hit with the hits of the window before it.
+	  * \param[in]  timeStamp_ The fixed point time of the hit.
+	  * \param[in]  id_        The ID of the channel of the hit.
+	  * \return Nothing.
+	  */
+	void Sweep(const unsigned long long &timeStamp_, const unsigned int &id_);
+
+	/** Fill the spectrum of a pair of channels.
+	  * \param[in]  first_  The ID of the first channel.
+	  * \param[in]  second_ The ID of the second channel.
+	  * \param[in]  diff_   The time of the second channel minus the first, in fixed point clock ticks.
+	  * \return Nothing.
+	  */
+	void Fill(const unsigned int &first_, const unsigned int &second_, const long long &diff_);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class timeDiffScanner
+///////////////////////////////////////////////////////////////////////////////
+
+class timeDiffScanner : public ScanInterface {
+  public:
+	/// Default constructor.
+	timeDiffScanner();
+
+	/// Destructor.
+	~timeDiffScanner();
+
+	/** ExtraArguments is used to send command line arguments to classes derived
+	  * from ScanInterface. This method should loop over the optionExt elements
+	  * in the vector userOpts and check for those options which have been flagged
+	  * as active by ::Setup(). This should be overloaded in the derived class.
+	  * \return Nothing.
+	  */
+	virtual void ExtraArguments();
+
+	/** ArgHelp is used to allow a derived class to add a command line option
+	  * to the main list of options. This method is called at the end of
+	  * from the ::Setup method.
+	  * \return Nothing.
+	  */
+	virtual void ArgHelp();
+
+	/** SyntaxStr is used to print a linux style usage message to the screen.
+	  * \param[in]  name_ The name of the program.
+	  * \return Nothing.
+	  */
+	virtual void SyntaxStr(char *name_);
+
+	/** Set up the spectra.
+	  * \param[in]  prefix_ String to append to the beginning of system output.
+	  * \return True upon successfully initializing and false otherwise.
+	  */
+	virtual bool Initialize(std::string prefix_="");
+
+	/** Receive various status notifications from the scan.
+	  * \param[in] code_ The notification code passed from ScanInterface methods.
+	  * \return Nothing.
+	  */
+	virtual void Notify(const std::string &code_="");
+
+	/** Return a pointer to the Unpacker object to use for data unpacking.
+	  * If no object has been initialized, create a new one.
+	  * \return Pointer to an Unpacker object.
+	  */
+	virtual Unpacker *GetCore();
+
+  private:
+	bool init; /// Set to true when the initialization process successfully completes.
+	double window; /// The largest time difference paired (in ns).
+	double binWidth; /// The width of the bins of the spectra (in ns).
+	double tick; /// The length of a clock tick of the timestamps (in ns).
+	int reference; /// The ID of the reference channel, or -1 to fill all pairs.
+	unsigned long long minCounts; /// The smallest number of counts of a spectrum with a peak.
+
+	/** Find the peaks, solve for the offset of every channel and write them
+	  * to <output>.time.xml.
+	  * \return Nothing.
+	  */
+	void WriteOffsets();
+};
+
+#endif
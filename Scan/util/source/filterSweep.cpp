@@ -0,0 +1,398 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+
+#include <getopt.h>
+#include <cmath>
+#include <cstdlib>
+
+#include "XiaData.hpp"
+#include "TrapFilterKernels.hpp"
+
+// Local files
+#include "filterSweep.hpp"
+
+// Define the name of the program.
+#ifndef PROG_NAME
+#define PROG_NAME "FilterSweep"
+#endif
+
+#define ADC_CLOCK_uSEC 4E-3 // us
+
+///////////////////////////////////////////////////////////////////////////////
+// class filterSweepUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+filterSweepUnpacker::filterSweepUnpacker() : Unpacker(),
+	mod_(0),
+	chan_(0),
+	maxTraces_(10000)
+{
+}
+
+/** Copy the traces of the signal of interest and delete all events.
+  * \param[in]  addr_ Pointer to a ScanInterface object.
+  * \return Nothing.
+  */
+void filterSweepUnpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/){
+	XiaData *current_event = NULL;
+
+	while(!rawEvent.empty()){
+		current_event = rawEvent.front();
+		rawEvent.pop_front();
+
+		if(!current_event){ continue; }
+
+		size_t length = current_event->getTraceLength();
+		if(length > 0 && offsets_.size() < maxTraces_ && current_event->modNum == mod_ && current_event->chanNum == chan_){
+			offsets_.push_back(samples_.size());
+			lengths_.push_back(length);
+			if(current_event->hasTraceView())
+				samples_.insert(samples_.end(), current_event->traceView, current_event->traceView + length);
+			else
+				samples_.insert(samples_.end(), current_event->adcTrace.begin(), current_event->adcTrace.end());
+		}
+
+		delete current_event;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class filterSweepScanner
+///////////////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+filterSweepScanner::filterSweepScanner() : ScanInterface() {
+	init = false;
+	trigRise = 0.1;
+	trigFlat = 0.05;
+	trigThresh = 20;
+	window = 20;
+	numThreads = std::thread::hardware_concurrency();
+	if(numThreads == 0){ numThreads = 1; }
+}
+
+/// Destructor.
+filterSweepScanner::~filterSweepScanner(){
+}
+
+/** ExtraArguments is used to send command line arguments to classes derived
+  * from ScanInterface. This method should loop over the optionExt elements
+  * in the vector userOpts and check for those options which have been flagged
+  * as active by ::Setup(). This should be overloaded in the derived class.
+  * \return Nothing.
+  */
+void filterSweepScanner::ExtraArguments(){
+	filterSweepUnpacker *unpacker = (filterSweepUnpacker*)GetCore();
+	if(userOpts.at(0).active)
+		unpacker->SetMod(atoi(userOpts.at(0).argument.c_str()));
+	if(userOpts.at(1).active)
+		unpacker->SetChan(atoi(userOpts.at(1).argument.c_str()));
+	if(userOpts.at(2).active)
+		unpacker->SetMaxTraces(strtoul(userOpts.at(2).argument.c_str(), NULL, 0));
+	if(userOpts.at(3).active){
+		std::vector<double> values;
+		SplitFields(userOpts.at(3).argument, values);
+		if(values.size() != 3)
+			std::cout << msgHeader << "Invalid trigger filter '" << userOpts.at(3).argument << "', expected <rise>:<flattop>:<thresh>.\n";
+		else{
+			trigRise = values[0];
+			trigFlat = values[1];
+			trigThresh = values[2];
+		}
+	}
+	if(userOpts.at(4).active && !ParseRange(userOpts.at(4).argument, riseTimes))
+		std::cout << msgHeader << "Invalid range of rise times '" << userOpts.at(4).argument << "'.\n";
+	if(userOpts.at(5).active && !ParseRange(userOpts.at(5).argument, flatTops))
+		std::cout << msgHeader << "Invalid range of flat tops '" << userOpts.at(5).argument << "'.\n";
+	if(userOpts.at(6).active && !ParseRange(userOpts.at(6).argument, decayTimes))
+		std::cout << msgHeader << "Invalid range of decay constants '" << userOpts.at(6).argument << "'.\n";
+	if(userOpts.at(7).active)
+		window = atof(userOpts.at(7).argument.c_str());
+	if(userOpts.at(8).active){
+		int threads = atoi(userOpts.at(8).argument.c_str());
+		numThreads = (threads > 0 ? threads : 1);
+	}
+}
+
+/** ArgHelp is used to allow a derived class to add a command line option
+  * to the main list of options. This method is called at the end of
+  * from the ::Setup method.
+  * \return Nothing.
+  */
+void filterSweepScanner::ArgHelp(){
+	AddOption(optionExt("mod", required_argument, NULL, 0, "<module>", "Module of signal of interest (default=0)"));
+	AddOption(optionExt("chan", required_argument, NULL, 0, "<channel>", "Channel of signal of interest (default=0)"));
+	AddOption(optionExt("max-traces", required_argument, NULL, 0, "<N>", "Keep at most N traces (default=10000)"));
+	AddOption(optionExt("trigger", required_argument, NULL, 0, "<rise:flat:thresh>", "Trigger filter in μs and ADC units (default=0.1:0.05:20)"));
+	AddOption(optionExt("rise", required_argument, NULL, 0, "<first[:last[:step]]>", "Energy filter rise times to sweep, in μs"));
+	AddOption(optionExt("flat", required_argument, NULL, 0, "<first[:last[:step]]>", "Energy filter flat tops to sweep, in μs"));
+	AddOption(optionExt("tau", required_argument, NULL, 0, "<first[:last[:step]]>", "Decay constants to sweep, in μs"));
+	AddOption(optionExt("window", required_argument, NULL, 0, "<percent>", "Half width of the peak window around the median energy (default=20)"));
+	AddOption(optionExt("threads", required_argument, NULL, 0, "<N>", "Number of threads computing the sweep (default=all cores)"));
+}
+
+/** SyntaxStr is used to print a linux style usage message to the screen.
+  * \param[in]  name_ The name of the program.
+  * \return Nothing.
+  */
+void filterSweepScanner::SyntaxStr(char *name_){
+	std::cout << " usage: " << std::string(name_) << " [options]\n";
+	std::cout << "  Sweeps the energy filter over the traces of one channel and writes the\n";
+	std::cout << "  resolution of each parameter set to <output>.sweep.\n";
+}
+
+/** Initialize the scanner.
+  * \param[in]  prefix_ String to append to the beginning of system output.
+  * \return True upon successfully initializing and false otherwise.
+  */
+bool filterSweepScanner::Initialize(std::string prefix_){
+	if(init){ return false; }
+
+	if(riseTimes.empty() || flatTops.empty() || decayTimes.empty()){
+		std::cout << prefix_ << "The --rise, --flat and --tau ranges are required.\n";
+		return false;
+	}
+
+	filterSweepUnpacker *unpacker = (filterSweepUnpacker*)GetCore();
+	std::cout << prefix_ << "Sweeping " << riseTimes.size() * flatTops.size() * decayTimes.size() << " filters over mod = " << unpacker->GetMod() << ", chan = " << unpacker->GetChan() << ".\n";
+
+	return (init = true);
+}
+
+/** Receive various status notifications from the scan. The sweep is run
+  * when the scan is complete.
+  * \param[in] code_ The notification code passed from ScanInterface methods.
+  * \return Nothing.
+  */
+void filterSweepScanner::Notify(const std::string &code_/*=""*/){
+	if(code_ == "START_SCAN"){  }
+	else if(code_ == "STOP_SCAN"){  }
+	else if(code_ == "SCAN_COMPLETE"){
+		std::cout << msgHeader << "Scan complete.\n";
+		RunSweep();
+	}
+	else if(code_ == "LOAD_FILE"){ std::cout << msgHeader << "File loaded.\n"; }
+	else if(code_ == "REWIND_FILE"){  }
+	else{ std::cout << msgHeader << "Unknown notification code '" << code_ << "'!\n"; }
+}
+
+/** Return a pointer to the Unpacker object to use for data unpacking.
+  * If no object has been initialized, create a new one.
+  * \return Pointer to an Unpacker object.
+  */
+Unpacker *filterSweepScanner::GetCore(){
+	if(!core){ core = (Unpacker*)(new filterSweepUnpacker()); }
+	return core;
+}
+
+/** Split a string of colon separated numbers.
+  * \param[in]  arg_    The string to split.
+  * \param[out] fields_ The numbers.
+  * \return Nothing.
+  */
+void filterSweepScanner::SplitFields(const std::string &arg_, std::vector<double> &fields_){
+	fields_.clear();
+	size_t start = 0;
+	while(true){
+		size_t stop = arg_.find(':', start);
+		fields_.push_back(atof(arg_.substr(start, stop - start).c_str()));
+		if(stop == std::string::npos){ break; }
+		start = stop + 1;
+	}
+}
+
+/** Parse a range of values given as <first>[:<last>[:<step>]]. The step
+  * defaults to the difference of the first and last values.
+  * \param[in]  arg_    The string to parse.
+  * \param[out] values_ The values of the range.
+  * \return True if the range is valid and false otherwise.
+  */
+bool filterSweepScanner::ParseRange(const std::string &arg_, std::vector<double> &values_){
+	std::vector<double> fields;
+	SplitFields(arg_, fields);
+
+	values_.clear();
+	if(fields.size() > 3){ return false; }
+	if(fields.size() < 3){
+		values_.push_back(fields.front());
+		if(fields.back() != fields.front())
+			values_.push_back(fields.back());
+		return true;
+	}
+	if(fields[2] <= 0 || fields[1] < fields[0]){ return false; }
+
+	// Allow for rounding of the step so that the last value is included.
+	for(double value = fields[0]; value <= fields[1] + 1E-9 * fields[2]; value += fields[2])
+		values_.push_back(value);
+
+	return true;
+}
+
+/** Find the trigger and baseline of every kept trace. The trigger is the
+  * first sample at which the trigger filter reaches the threshold, and the
+  * baseline is the mean of the samples before the trigger filter, as in
+  * TraceFilter::CalcBaseline().
+  * \return The number of traces with a valid trigger.
+  */
+size_t filterSweepScanner::PrepareTraces(){
+	filterSweepUnpacker *unpacker = (filterSweepUnpacker*)GetCore();
+
+	int rise = std::max(1, (int)round(trigRise / ADC_CLOCK_uSEC));
+	int gap = (int)round(trigFlat / ADC_CLOCK_uSEC);
+
+	std::vector<long long> sum;
+	std::vector<double> filter;
+	traces.clear();
+	for(size_t i = 0; i < unpacker->GetNumTraces(); i++){
+		SweepTrace trace;
+		trace.samples = unpacker->GetTrace(i);
+		trace.length = unpacker->GetTraceLength(i);
+
+		TrapFilterKernels::RunningSum(trace.samples, trace.length, sum);
+		TrapFilterKernels::Trapezoid(sum, rise, gap, filter);
+
+		std::vector<double>::iterator trig = std::find_if(filter.begin(), filter.end(), [this](const double &value){ return value >= trigThresh; });
+		if(trig == filter.end()){ continue; }
+		trace.trigger = trig - filter.begin();
+
+		int offset = (int)trace.trigger - rise - 5;
+		if(offset <= 0){ continue; }
+		trace.baseline = (double)sum[offset] / offset;
+
+		traces.push_back(trace);
+	}
+
+	return traces.size();
+}
+
+/** Compute the energies and resolution of every parameter set, from the
+  * next one not yet taken until all are done. This is the body of each
+  * sweep thread.
+  * \param[in]  next_ The index of the next parameter set to compute.
+  * \return Nothing.
+  */
+void filterSweepScanner::SweepWorker(std::atomic<size_t> *next_){
+	std::vector<double> filter;
+	std::vector<double> energies;
+	for(size_t index = (*next_)++; index < results.size(); index = (*next_)++)
+		Sweep(results[index], filter, energies);
+}
+
+/** Compute the energy of every trace and the resolution of the peak for
+  * one set of filter parameters. The energy is the recursive filter in the
+  * middle of its flat top after the trigger. The centroid is the median of
+  * the energies within the window around the median of all of them, and the
+  * FWHM is estimated from their interquartile range, which is not affected
+  * by the tails of the peak.
+  * \param[in,out] result_   The parameter set, filled with its result.
+  * \param[out]    filter_   Work space for the energy filter.
+  * \param[out]    energies_ Work space for the energies.
+  * \return Nothing.
+  */
+void filterSweepScanner::Sweep(SweepResult &result_, std::vector<double> &filter_, std::vector<double> &energies_){
+	double beta = exp(-1.0 / result_.tau);
+
+	energies_.clear();
+	for(std::vector<SweepTrace>::iterator iter = traces.begin(); iter != traces.end(); iter++){
+		size_t sample = iter->trigger + result_.rise + result_.gap / 2;
+		if(sample >= iter->length){ continue; }
+
+		// The filter is causal, so only the samples up to the energy are needed.
+		TrapFilterKernels::Recursive(iter->samples, sample + 1, iter->baseline, result_.rise, result_.gap, beta, filter_);
+		energies_.push_back(filter_[sample]);
+	}
+
+	result_.count = 0;
+	result_.centroid = result_.fwhm = result_.resolution = 0;
+	if(energies_.empty()){ return; }
+
+	std::sort(energies_.begin(), energies_.end());
+	double median = energies_[energies_.size() / 2];
+	double halfWidth = std::fabs(median) * window / 100.0;
+	std::vector<double>::iterator low = std::lower_bound(energies_.begin(), energies_.end(), median - halfWidth);
+	std::vector<double>::iterator high = std::upper_bound(energies_.begin(), energies_.end(), median + halfWidth);
+
+	size_t count = high - low;
+	if(count < 4){ return; }
+
+	result_.count = count;
+	result_.centroid = low[count / 2];
+	result_.fwhm = 2.3548 * (low[(3 * count) / 4] - low[count / 4]) / 1.349;
+	if(result_.centroid != 0)
+		result_.resolution = 100.0 * result_.fwhm / result_.centroid;
+}
+
+/** Run the sweep and print the results.
+  * \return Nothing.
+  */
+void filterSweepScanner::RunSweep(){
+	filterSweepUnpacker *unpacker = (filterSweepUnpacker*)GetCore();
+	size_t numGood = PrepareTraces();
+	std::cout << msgHeader << "Found a trigger in " << numGood << " of " << unpacker->GetNumTraces() << " traces.\n";
+	if(numGood == 0){ return; }
+
+	results.clear();
+	for(std::vector<double>::iterator rise = riseTimes.begin(); rise != riseTimes.end(); rise++){
+		for(std::vector<double>::iterator flat = flatTops.begin(); flat != flatTops.end(); flat++){
+			for(std::vector<double>::iterator tau = decayTimes.begin(); tau != decayTimes.end(); tau++){
+				SweepResult result;
+				result.rise = std::max(1, (int)round(*rise / ADC_CLOCK_uSEC));
+				result.gap = std::max(0, (int)round(*flat / ADC_CLOCK_uSEC));
+				result.tau = *tau / ADC_CLOCK_uSEC;
+				results.push_back(result);
+			}
+		}
+	}
+
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for(unsigned int i = 0; i < std::min((size_t)numThreads, results.size()); i++)
+		workers.push_back(std::thread(&filterSweepScanner::SweepWorker, this, &next));
+	for(std::vector<std::thread>::iterator iter = workers.begin(); iter != workers.end(); iter++)
+		iter->join();
+
+	std::string fname = GetOutputFilename() + ".sweep";
+	std::ofstream output(fname.c_str());
+	if(!output.good())
+		std::cout << msgHeader << "Failed to open output file '" << fname << "'.\n";
+	output << "#rise(us)\tflat(us)\ttau(us)\tcount\tcentroid\tfwhm\tresolution(%)\n";
+
+	const SweepResult *best = NULL;
+	for(std::vector<SweepResult>::iterator iter = results.begin(); iter != results.end(); iter++){
+		output << iter->rise * ADC_CLOCK_uSEC << "\t" << iter->gap * ADC_CLOCK_uSEC << "\t" << iter->tau * ADC_CLOCK_uSEC << "\t";
+		output << iter->count << "\t" << iter->centroid << "\t" << iter->fwhm << "\t" << iter->resolution << "\n";
+		if(iter->count > 0 && (!best || iter->resolution < best->resolution))
+			best = &(*iter);
+	}
+	std::cout << msgHeader << "Wrote " << results.size() << " filters to '" << fname << "'.\n";
+
+	if(best){
+		std::cout << msgHeader << "Best resolution " << std::fixed << std::setprecision(3) << best->resolution << "% FWHM for";
+		std::cout << " ENERGY_RISETIME = " << best->rise * ADC_CLOCK_uSEC << " μs, ENERGY_FLATTOP = " << best->gap * ADC_CLOCK_uSEC;
+		std::cout << " μs, TAU = " << best->tau * ADC_CLOCK_uSEC << " μs.\n";
+		std::cout.unsetf(std::ios::floatfield);
+	}
+}
+
+int main(int argc, char *argv[]){
+	// Define a new unpacker object.
+	filterSweepScanner scanner;
+
+	// Set the output message prefix.
+	scanner.SetProgramName(std::string(PROG_NAME));
+
+	// Initialize the scanner.
+	if(!scanner.Setup(argc, argv))
+		return 1;
+
+	// Run the main loop.
+	int retval = scanner.Execute();
+
+	scanner.Close();
+
+	return retval;
+}
@@ -183,7 +183,7 @@ void Filterer::ProcessRawEvent(){
 		rawEvent.pop_front();
 		
 		// Safety catches for null event or empty adcTrace.
-		if(!current_event || current_event->adcTrace.empty()){
+		if(!current_event || current_event->getTraceLength() == 0){
 			continue;
 		}
 
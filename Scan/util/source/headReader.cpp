@@ -1,19 +1,218 @@
 #include <iostream>
+#include <iomanip>
 #include <fstream>
+#include <vector>
+#include <map>
 #include <string.h>
+#include <stdlib.h>
 
 #include "Unpacker.hpp"
 #include "ScanInterface.hpp"
+#include "ScanPlugin.hpp"
+#include "SpillIndex.hpp"
 #include "hribf_buffers.h"
 
+#define FILTER_CLOCK 8E-9 // Filter clock tick (in seconds)
+
 DIR_buffer ldfDir;
 HEAD_buffer ldfHead;
 PLD_header pldHead;
 
+/// Counts the hits of each channel in the sampled spills of a summary.
+class summaryCounter : public ScanPlugin {
+  public:
+	static const bool buildEvents = false;
+
+	std::map<unsigned int, unsigned long long> counts; /// Number of hits for each channel ID.
+	double firstTime; /// Earliest hit time (in filter clock ticks).
+	double lastTime; /// Latest hit time (in filter clock ticks).
+	bool haveTime; /// Set to true once a hit has been seen.
+
+	summaryCounter() : firstTime(0), lastTime(0), haveTime(false) { }
+
+	void Hit(const XiaData &hit_){
+		counts[hit_.modNum*16 + hit_.chanNum]++;
+		if(!haveTime || hit_.time < firstTime){ firstTime = hit_.time; }
+		if(!haveTime || hit_.time > lastTime){ lastTime = hit_.time; }
+		haveTime = true;
+	}
+};
+
 void help(char *name_){
 	std::cout << "  SYNTAX: " << name_ << " [options] <files ...>\n";
 	std::cout << "   Available options:\n";
-	std::cout << "    --columns | Output file information in tab-delimited columns.\n";
+	std::cout << "    --columns       | Output file information in tab-delimited columns.\n";
+	std::cout << "    --summary [num] | Estimate run length, rates and per-channel counts by decoding num spills (default=100) spread over the file.\n";
+}
+
+/** Find the spills of an .ldf file. The index file is used if it matches the
+  * file, otherwise the index is built (without decoding) and written so the
+  * next summary is fast.
+  * \param[in]  file_   The input file, positioned at the first data buffer.
+  * \param[in]  fname_  The input filename.
+  * \param[in]  length_ The length of the input file (in bytes).
+  * \param[out] index_  The spill index.
+  * \return True upon success and false otherwise.
+  */
+bool indexLdf(std::ifstream &file_, const std::string &fname_, const unsigned long long &length_, SpillIndex &index_){
+	std::string idxname = SpillIndex::GetIndexFilename(fname_);
+	if(index_.Read(idxname) && index_.GetFileLength() == length_){ return true; }
+
+	std::cout << " Building spill index '" << idxname << "'...\n";
+
+	index_.clear();
+	DATA_buffer reader;
+	std::vector<unsigned int> data(250000);
+	unsigned int nBytes;
+	bool full_spill;
+	bool bad_spill;
+	SpillIndex::Entry entry;
+	while(true){
+		if(!reader.Read(&file_, (char*)data.data(), nBytes, 1000000, full_spill, bad_spill)){
+			if(reader.GetRetval() == 2 || reader.GetRetval() == 6){ break; }
+			continue;
+		}
+		if(!full_spill || bad_spill){ continue; }
+
+		entry.offset = reader.GetSpillOffset();
+		entry.position = reader.GetSpillPosition();
+		entry.numWords = nBytes/4;
+		SpillIndex::GetFirstTime(data.data(), nBytes/4, entry.firstTime);
+		index_.push_back(entry);
+	}
+	index_.SetFileLength(length_);
+
+	if(!index_.Write(idxname)){ std::cout << " WARNING! Failed to write spill index file '" << idxname << "'.\n"; }
+
+	return true;
+}
+
+/** Find the spills of a .pld file. Every spill record starts with its length,
+  * so the spill data is skipped over and only the record headers are read.
+  * \param[in]  file_  The input file, positioned at the first data record.
+  * \param[out] index_ The spill index. Offsets are the word offsets of the records.
+  * \return True upon success and false otherwise.
+  */
+bool indexPld(std::ifstream &file_, SpillIndex &index_){
+	index_.clear();
+	PLD_data reader;
+	unsigned int nBytes;
+	SpillIndex::Entry entry;
+	while(true){
+		std::streampos pos = file_.tellg();
+		if(pos < 0 || !reader.Read(&file_, NULL, nBytes, 0xFFFFFFFF, true)){
+			if(!file_.good()){ break; }
+			continue;
+		}
+		entry.offset = pos/4;
+		entry.numWords = nBytes/4;
+		index_.push_back(entry);
+	}
+	file_.clear();
+	return !index_.empty();
+}
+
+/** Print a summary of the run in a data file from a sample of its spills. The
+  * hit counts of the sampled spills are scaled by the fraction of the spill
+  * data which was decoded.
+  * \param[in]  file_    The input file, positioned at the first data buffer.
+  * \param[in]  fname_   The input filename.
+  * \param[in]  format_  The file format (0=ldf, 1=pld).
+  * \param[in]  samples_ The maximum number of spills to decode.
+  * \return True upon success and false otherwise.
+  */
+bool summarize(std::ifstream &file_, const std::string &fname_, const int &format_, const size_t &samples_){
+	std::streampos start = file_.tellg();
+	file_.seekg(0, file_.end);
+	unsigned long long length = file_.tellg();
+	file_.seekg(start);
+
+	SpillIndex index;
+	if(format_ == 0){
+		if(!indexLdf(file_, fname_, length, index)){ return false; }
+	}
+	else if(!indexPld(file_, index)){ return false; }
+
+	if(index.empty()){
+		std::cout << " ERROR! Found no spills in file.\n";
+		return false;
+	}
+
+	unsigned long long totalWords = 0;
+	for(size_t i = 0; i < index.size(); i++)
+		totalWords += index[i].numWords;
+
+	// Pick evenly spaced spills, always including the first and last so the run length is known.
+	std::vector<size_t> picks;
+	size_t numPicks = (samples_ < 2 ? 2 : samples_);
+	if(numPicks >= index.size()){
+		for(size_t i = 0; i < index.size(); i++)
+			picks.push_back(i);
+	}
+	else{
+		for(size_t i = 0; i < numPicks; i++)
+			picks.push_back((i*(index.size()-1))/(numPicks-1));
+	}
+
+	summaryCounter counter;
+	PluginUnpacker<summaryCounter> unpacker(counter);
+
+	DATA_buffer ldfReader;
+	PLD_data pldReader;
+	std::vector<unsigned int> data(250000);
+	unsigned long long sampledWords = 0;
+	size_t numSampled = 0;
+	unsigned int nBytes;
+	bool full_spill;
+	bool bad_spill;
+	for(std::vector<size_t>::iterator iter = picks.begin(); iter != picks.end(); iter++){
+		const SpillIndex::Entry &entry = index[*iter];
+		if(data.size() < entry.numWords + 1){ data.resize(entry.numWords + 1); }
+
+		file_.clear();
+		file_.seekg(entry.offset*4, file_.beg);
+		if(format_ == 0){
+			ldfReader.SetStartPosition(entry.position);
+			if(!ldfReader.Read(&file_, (char*)data.data(), nBytes, 4*data.size(), full_spill, bad_spill) || !full_spill || bad_spill){ continue; }
+		}
+		else if(!pldReader.Read(&file_, (char*)data.data(), nBytes, 4*data.size())){ continue; }
+
+		if(!unpacker.ReadSpill(data.data(), nBytes/4, false)){ continue; }
+
+		sampledWords += entry.numWords;
+		numSampled++;
+	}
+
+	if(numSampled == 0 || sampledWords == 0){
+		std::cout << " ERROR! Failed to decode any spills.\n";
+		return false;
+	}
+
+	double scale = (double)totalWords / sampledWords;
+	double runTime = (counter.lastTime - counter.firstTime) * FILTER_CLOCK;
+
+	unsigned long long totalHits = 0;
+	for(std::map<unsigned int, unsigned long long>::iterator iter = counter.counts.begin(); iter != counter.counts.end(); iter++)
+		totalHits += iter->second;
+
+	std::cout << " Summary-\n";
+	std::cout << "  Spills: " << index.size() << " (" << totalWords << " words)\n";
+	std::cout << "  Sampled: " << numSampled << " spills (" << 100.0*sampledWords/totalWords << "% of data)\n";
+	std::cout << "  First hit: " << (unsigned long long)counter.firstTime << " ticks\n";
+	std::cout << "  Last hit: " << (unsigned long long)counter.lastTime << " ticks\n";
+	std::cout << "  Run length: " << runTime << " seconds\n";
+	std::cout << "  Hits: " << (unsigned long long)(totalHits*scale + 0.5);
+	if(runTime > 0){ std::cout << " (" << totalHits*scale/runTime << " Hz)"; }
+	std::cout << "\n";
+
+	std::cout << "  " << std::setw(4) << "mod" << std::setw(6) << "chan" << std::setw(14) << "hits" << std::setw(14) << "rate (Hz)" << "\n";
+	for(std::map<unsigned int, unsigned long long>::iterator iter = counter.counts.begin(); iter != counter.counts.end(); iter++){
+		std::cout << "  " << std::setw(4) << iter->first/16 << std::setw(6) << iter->first%16;
+		std::cout << std::setw(14) << (unsigned long long)(iter->second*scale + 0.5);
+		std::cout << std::setw(14) << (runTime > 0 ? iter->second*scale/runTime : 0.0) << "\n";
+	}
+
+	return true;
 }
 
 int main(int argc, char *argv[]){
@@ -24,6 +223,8 @@ int main(int argc, char *argv[]){
 	}
 
 	bool col_output = false;
+	bool summary = false;
+	size_t summary_spills = 100;
 	int file_format = -1;
 	int file_count = 1;
 	std::string dummy, extension;
@@ -33,6 +234,11 @@ int main(int argc, char *argv[]){
 			col_output = true;
 			continue;
 		}
+		else if(strcmp(argv[i], "--summary") == 0){
+			summary = true;
+			if(i+1 < argc && atoi(argv[i+1]) > 0){ summary_spills = atoi(argv[++i]); }
+			continue;
+		}
 
 		if(!col_output)
 			std::cout << "File no. " << file_count++ << ": " << argv[i] << std::endl;
@@ -85,6 +291,11 @@ int main(int argc, char *argv[]){
 				pldHead.PrintDelimited();
 			std::cout << std::endl;
 		}
+
+		if(summary && !col_output){
+			summarize(file, argv[i], file_format, summary_spills);
+			std::cout << std::endl;
+		}
 		
 		file.close();
 	}
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <iomanip>
+#include <map>
+
+#include <cstdlib>
+
+#include "ScanPlugin.hpp"
+
+// Define the name of the program.
+#ifndef PROG_NAME
+#define PROG_NAME "HitCount"
+#endif
+
+/** Count the hits, the pileups and the mean energy of every channel. This
+  * is also the smallest example of a ScanPlugin.
+  */
+class hitCountPlugin : public ScanPlugin {
+  public:
+	static const bool buildEvents = false;
+
+	hitCountPlugin() : minEnergy(0) {  }
+
+	void AddOptions(std::vector<optionExt> &opts_){
+		opts_.push_back(optionExt("min-energy", required_argument, NULL, 0, "<energy>", "Only count hits with at least this energy (default=0)"));
+	}
+
+	void SetOptions(const std::vector<optionExt> &opts_){
+		if(opts_.at(0).active)
+			minEnergy = atof(opts_.at(0).argument.c_str());
+	}
+
+	void Hit(const XiaData &hit_){
+		if(hit_.energy < minEnergy){ return; }
+		ChannelCount &count = counts[hit_.modNum*16+hit_.chanNum];
+		count.hits++;
+		if(hit_.pileupBit){ count.pileups++; }
+		count.energySum += hit_.energy;
+	}
+
+	void Finish(){
+		std::cout << " mod chan        hits    pileups  mean energy\n";
+		for(std::map<unsigned int, ChannelCount>::iterator iter = counts.begin(); iter != counts.end(); iter++){
+			std::cout << std::setw(4) << iter->first / 16 << std::setw(5) << iter->first % 16;
+			std::cout << std::setw(12) << iter->second.hits << std::setw(11) << iter->second.pileups;
+			std::cout << std::setw(13) << std::fixed << std::setprecision(1) << iter->second.energySum / iter->second.hits << "\n";
+		}
+	}
+
+  private:
+	/// The counters of one channel.
+	struct ChannelCount{
+		unsigned long long hits;
+		unsigned long long pileups;
+		double energySum;
+
+		ChannelCount() : hits(0), pileups(0), energySum(0) {  }
+	};
+
+	double minEnergy; /// The smallest energy counted.
+	std::map<unsigned int, ChannelCount> counts; /// The counters of each channel ID.
+};
+
+int main(int argc, char *argv[]){
+	return RunScanPlugin<hitCountPlugin>(argc, argv, PROG_NAME);
+}
@@ -0,0 +1,443 @@
+#include <iostream>
+#include <algorithm>
+
+#include <getopt.h>
+#include <cstdlib>
+
+#include "XiaData.hpp"
+#include "ColumnWriter.hpp"
+
+// Local files
+#include "hitDump.hpp"
+
+// Define the name of the program.
+#ifndef PROG_NAME
+#define PROG_NAME "HitDump"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// class hitDumpUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+hitDumpUnpacker::hitDumpUnpacker() : Unpacker(),
+	writer(NULL),
+	writeTraces(false),
+	numHits(0),
+	numSpills(0),
+	numBadSpills(0),
+	numSamples(0),
+	maxJobs(0),
+	stopping(false)
+{
+}
+
+/// Destructor. Writes any queued spills and closes the output.
+hitDumpUnpacker::~hitDumpUnpacker(){
+	Close();
+	for(std::vector<SpillJob*>::iterator iter = spare.begin(); iter != spare.end(); iter++){
+		delete (*iter);
+	}
+}
+
+/** Open the output file and start one worker thread for each decode thread.
+  * \param[in]  fname_  The name of the column file to write.
+  * \param[in]  chunk_  The number of hits in each chunk of the file.
+  * \param[in]  level_  The zlib compression level of the columns.
+  * \param[in]  traces_ Set to true to write the trace samples to fname_.trc.
+  * \return True if the output files were opened and false otherwise.
+  */
+bool hitDumpUnpacker::Open(const std::string &fname_, const unsigned int &chunk_, const int &level_, const bool &traces_){
+	if(writer){ return false; }
+
+	writer = new ColumnWriter(fname_, chunk_, level_);
+	if(!writer->IsOpen()){
+		delete writer;
+		writer = NULL;
+		return false;
+	}
+
+	writeTraces = traces_;
+	if(writeTraces){
+		traceFile.open((fname_+".trc").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!traceFile.is_open()){
+			std::cout << "hitDumpUnpacker: ERROR! Failed to open the trace file '" << fname_ << ".trc'!\n";
+			delete writer;
+			writer = NULL;
+			return false;
+		}
+	}
+
+	writer->AddColumn("time", &hitTime);
+	writer->AddColumn("mod", &hitMod);
+	writer->AddColumn("chan", &hitChan);
+	writer->AddColumn("energy", &hitEnergy);
+	writer->AddColumn("cfd", &hitCfd);
+	writer->AddColumn("flags", &hitFlags);
+	if(writeTraces){
+		writer->AddColumn("trace.offset", &hitTraceOffset);
+		writer->AddColumn("trace.length", &hitTraceLength);
+	}
+
+	// Keep enough spills queued that every worker has one to decode while
+	// the main thread waits on the oldest.
+	maxJobs = 2 * decode_threads;
+	stopping = false;
+	for(unsigned int i = 0; i < decode_threads; i++){
+		workers.push_back(std::thread(&hitDumpUnpacker::DecodeSpills, this));
+	}
+
+	return true;
+}
+
+/** Copy a spill into the queue of the worker threads. Finished spills are
+  * written before returning. Only waits if the queue is full.
+  * \param[in]  data       Pointer to an array of unsigned ints containing the spill data.
+  * \param[in]  nWords     The number of words in the array.
+  * \param[in]  is_verbose Toggle the verbosity flag on/off.
+  * \return True if the output is open and false otherwise.
+  */
+bool hitDumpUnpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose/*=true*/){
+	if(!writer){ return false; }
+
+	// Make room in the queue first, so that a spare spill may be reused.
+	WriteSpills(maxJobs - 1);
+
+	SpillJob *job;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		if(!spare.empty()){
+			job = spare.back();
+			spare.pop_back();
+		}
+		else{ job = new SpillJob(); }
+	}
+
+	job->words.assign(data, data+nWords);
+	job->verbose = is_verbose;
+	job->done = false;
+	job->good = true;
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(job);
+		todo.push_back(job);
+	}
+	jobReady.notify_one();
+
+	// Write whatever the workers have finished in the meantime.
+	WriteSpills(maxJobs);
+
+	return true;
+}
+
+/** Wait for all queued spills to be decoded and write them.
+  * \return Nothing.
+  */
+void hitDumpUnpacker::Flush(){
+	WriteSpills(0);
+}
+
+/** Write the remaining spills, stop the worker threads and close the output.
+  * \return Nothing.
+  */
+void hitDumpUnpacker::Close(){
+	if(!writer){ return; }
+
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for(std::vector<std::thread>::iterator iter = workers.begin(); iter != workers.end(); iter++){
+		iter->join();
+	}
+	workers.clear();
+
+	writer->Close();
+	delete writer;
+	writer = NULL;
+
+	if(traceFile.is_open()){ traceFile.close(); }
+}
+
+/** Decode spills from the queue until told to stop. This is the body of
+  * each worker thread.
+  * \return Nothing.
+  */
+void hitDumpUnpacker::DecodeSpills(){
+	std::vector<XiaData*> cache;
+	std::unique_lock<std::mutex> lock(jobMutex);
+	while(true){
+		while(todo.empty() && !stopping){ jobReady.wait(lock); }
+		if(todo.empty()){ break; }
+
+		SpillJob *job = todo.front();
+		todo.pop_front();
+
+		lock.unlock();
+		DecodeSpill(job, cache);
+		lock.lock();
+
+		job->done = true;
+		jobDone.notify_all();
+	}
+	lock.unlock();
+
+	// Pool mode is never enabled for the dump, so cached events are our own.
+	for(std::vector<XiaData*>::iterator iter = cache.begin(); iter != cache.end(); iter++){
+		delete (*iter);
+	}
+}
+
+/** Decode all of the module buffers of a spill into its hit table and
+  * order the hits in time. The module records are walked in the same way as
+  * Unpacker::ReadSpill, but decoded events go straight into the hit table.
+  * \param[in]  job_   The spill to decode.
+  * \param[in]  cache_ The per-thread event cache.
+  * \return Nothing.
+  */
+void hitDumpUnpacker::DecodeSpill(SpillJob *job_, std::vector<XiaData*> &cache_){
+	std::vector<XiaData*> events;
+
+	unsigned int *data = job_->words.data();
+	size_t nWords = job_->words.size();
+	size_t nWords_read = 0;
+	unsigned int lenRec = 0;
+	unsigned int vsn = 0xFFFFFFFF;
+
+	job_->hits.clear();
+
+	while(nWords_read + 1 < nWords){
+		while(nWords_read < nWords && data[nWords_read] == 0xFFFFFFFF) // Search for the next non-delimiter.
+			nWords_read++;
+		if(nWords_read + 1 >= nWords){ break; }
+
+		lenRec = data[nWords_read]; // Number of words in this record
+		vsn = data[nWords_read+1]; // Module number
+
+		if(vsn == 9999){ break; } // End spill vsn
+
+		// Check sanity of record length and vsn
+		if(lenRec < 2 || nWords_read + lenRec > nWords || (vsn > maxVsn && vsn != 1000)){
+			if(job_->verbose){
+				std::cout << "hitDumpUnpacker: SANITY CHECK FAILED: lenRec = " << lenRec << ", vsn = " << vsn << ", read " << nWords_read << " of " << nWords << std::endl;
+			}
+			job_->good = false;
+			break;
+		}
+
+		// Empty modules (record length 6) and the wall clock buffer (vsn 1000) hold no hits.
+		if(lenRec != 6 && vsn < maxVsn){
+			events.clear();
+			if(DecodeBuffer(&data[nWords_read], events, &cache_) <= -100){
+				if(job_->verbose){ std::cout << "hitDumpUnpacker: READOUT PROBLEM in module " << vsn << std::endl; }
+				job_->good = false;
+			}
+			for(std::vector<XiaData*>::iterator iter = events.begin(); iter != events.end(); iter++){
+				job_->hits.push_back(*iter);
+				ReleaseCachedEvent(*iter, &cache_);
+			}
+			if(!job_->good){ break; }
+		}
+
+		nWords_read += lenRec;
+	}
+
+	// Spills which end without the end of spill vsn were split between
+	// buffers, and are dropped like they are by Unpacker::ReadSpill.
+	if(vsn != 9999 && vsn != 1000){ job_->good = false; }
+
+	if(!job_->good){
+		job_->hits.clear();
+		return;
+	}
+
+	// The events were released once copied, so the table is only used
+	// through its columns.
+	std::fill(job_->hits.events.begin(), job_->hits.events.end(), (XiaData*)NULL);
+	job_->hits.Sort();
+}
+
+/** Write finished spills from the front of the queue, waiting until at
+  * most maxJobs_ spills are left.
+  * \param[in]  maxJobs_ The number of spills which may be left in the queue.
+  * \return Nothing.
+  */
+void hitDumpUnpacker::WriteSpills(const size_t &maxJobs_){
+	std::unique_lock<std::mutex> lock(jobMutex);
+	while(!jobs.empty()){
+		SpillJob *job = jobs.front();
+		if(!job->done){
+			if(jobs.size() <= maxJobs_){ break; }
+			jobDone.wait(lock);
+			continue;
+		}
+		jobs.pop_front();
+
+		lock.unlock();
+		WriteSpill(job);
+		lock.lock();
+
+		spare.push_back(job);
+	}
+}
+
+/** Write the hits of a decoded spill.
+  * \param[in]  job_ The spill to write.
+  * \return Nothing.
+  */
+void hitDumpUnpacker::WriteSpill(SpillJob *job_){
+	if(!job_->good){
+		numBadSpills++;
+		return;
+	}
+
+	const HitTable &hits = job_->hits;
+	for(HitTable::const_iterator iter = hits.begin(); iter != hits.end(); ++iter){
+		size_t row = iter.row();
+		hitTime = hits.timeStamp[row];
+		hitMod = hits.modNum[row];
+		hitChan = hits.chanNum[row];
+		hitEnergy = hits.energy[row];
+		hitCfd = hits.cfdTime[row];
+		hitFlags = hits.flags[row];
+		if(writeTraces){
+			hitTraceOffset = numSamples;
+			hitTraceLength = hits.traceLength[row];
+			const int *trace = hits.getTrace(row);
+			for(unsigned int i = 0; i < hitTraceLength; i++){
+				unsigned short sample = trace[i];
+				traceFile.write((const char*)&sample, sizeof(unsigned short));
+			}
+			numSamples += hitTraceLength;
+		}
+		writer->Fill();
+	}
+
+	numHits += hits.size();
+	numSpills++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class hitDumpScanner
+///////////////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+hitDumpScanner::hitDumpScanner() : ScanInterface() {
+	init = false;
+	chunkSize = 65536;
+	compression = 1;
+	writeTraces = false;
+}
+
+/// Destructor.
+hitDumpScanner::~hitDumpScanner(){
+}
+
+/** ExtraArguments is used to send command line arguments to classes derived
+  * from ScanInterface. This method should loop over the optionExt elements
+  * in the vector userOpts and check for those options which have been flagged
+  * as active by ::Setup(). This should be overloaded in the derived class.
+  * \return Nothing.
+  */
+void hitDumpScanner::ExtraArguments(){
+	if(userOpts.at(0).active){
+		chunkSize = strtoul(userOpts.at(0).argument.c_str(), NULL, 0);
+		std::cout << msgHeader << "Writing chunks of " << chunkSize << " hits.\n";
+	}
+	if(userOpts.at(1).active){
+		compression = atoi(userOpts.at(1).argument.c_str());
+		std::cout << msgHeader << "Using compression level " << compression << ".\n";
+	}
+	if(userOpts.at(2).active){
+		writeTraces = true;
+		std::cout << msgHeader << "Writing trace samples.\n";
+	}
+	else{ GetCore()->SetSkipTraces(); }
+}
+
+/** ArgHelp is used to allow a derived class to add a command line option
+  * to the main list of options. This method is called at the end of
+  * from the ::Setup method.
+  * \return Nothing.
+  */
+void hitDumpScanner::ArgHelp(){
+	AddOption(optionExt("chunk", required_argument, NULL, 0, "<N>", "Write the hits in chunks of N rows (default=65536)"));
+	AddOption(optionExt("compression", required_argument, NULL, 0, "<level>", "Compress the columns with zlib level 0-9 (default=1)"));
+	AddOption(optionExt("traces", no_argument, NULL, 0, "", "Write the trace samples of all hits to <output>.col.trc"));
+}
+
+/** SyntaxStr is used to print a linux style usage message to the screen.
+  * \param[in]  name_ The name of the program.
+  * \return Nothing.
+  */
+void hitDumpScanner::SyntaxStr(char *name_){
+	std::cout << " usage: " << std::string(name_) << " [options]\n";
+	std::cout << "  Writes every hit of the input to <output>.col. Use --decode-threads to\n";
+	std::cout << "  set the number of spills decoded in parallel.\n";
+}
+
+/** Open the output file and start the decoding threads.
+  * \param[in]  prefix_ String to append to the beginning of system output.
+  * \return True upon successfully initializing and false otherwise.
+  */
+bool hitDumpScanner::Initialize(std::string prefix_){
+	if(init){ return false; }
+
+	std::string fname = GetOutputFilename() + ".col";
+	if(!((hitDumpUnpacker*)GetCore())->Open(fname, chunkSize, compression, writeTraces)){
+		std::cout << prefix_ << "Failed to open output file '" << fname << "'.\n";
+		return false;
+	}
+	std::cout << prefix_ << "Writing hits to '" << fname << "'.\n";
+
+	return (init = true);
+}
+
+/** Receive various status notifications from the scan.
+  * \param[in] code_ The notification code passed from ScanInterface methods.
+  * \return Nothing.
+  */
+void hitDumpScanner::Notify(const std::string &code_/*=""*/){
+	if(code_ == "START_SCAN"){  }
+	else if(code_ == "STOP_SCAN"){  }
+	else if(code_ == "SCAN_COMPLETE"){
+		hitDumpUnpacker *unpacker = (hitDumpUnpacker*)GetCore();
+		unpacker->Flush();
+		std::cout << msgHeader << "Scan complete. Wrote " << unpacker->GetNumHits() << " hits from " << unpacker->GetNumSpills() << " spills.\n";
+	}
+	else if(code_ == "LOAD_FILE"){ std::cout << msgHeader << "File loaded.\n"; }
+	else if(code_ == "REWIND_FILE"){  }
+	else{ std::cout << msgHeader << "Unknown notification code '" << code_ << "'!\n"; }
+}
+
+/** Return a pointer to the Unpacker object to use for data unpacking.
+  * If no object has been initialized, create a new one.
+  * \return Pointer to an Unpacker object.
+  */
+Unpacker *hitDumpScanner::GetCore(){
+	if(!core){ core = (Unpacker*)(new hitDumpUnpacker()); }
+	return core;
+}
+
+int main(int argc, char *argv[]){
+	// Define a new unpacker object.
+	hitDumpScanner scanner;
+
+	// Set the output message prefix.
+	scanner.SetProgramName(std::string(PROG_NAME));
+
+	// Initialize the scanner.
+	if(!scanner.Setup(argc, argv))
+		return 1;
+
+	// Run the main loop.
+	int retval = scanner.Execute();
+
+	scanner.Close();
+
+	return retval;
+}
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+
+#include <getopt.h>
+#include <cstdlib>
+
+#include "hribf_buffers.h"
+
+#include "ScanPlugin.hpp"
+#include "SpillGenerator.hpp"
+
+// Define the name of the program.
+#ifndef PROG_NAME
+#define PROG_NAME "ScanBench"
+#endif
+
+/** Plugin decoding the hits of every module buffer without building events.
+  * The energies are summed so that the decoding can not be optimized away.
+  */
+class benchHitPlugin : public ScanPlugin {
+  public:
+	static const bool buildEvents = false;
+
+	benchHitPlugin() : energySum(0) {  }
+
+	void Hit(const XiaData &hit_){ energySum += hit_.energy; }
+
+	double energySum; /// The sum of the energies of all hits.
+};
+
+/** Plugin building raw events from every spill.
+  */
+class benchEventPlugin : public ScanPlugin {
+  public:
+	static const bool buildEvents = true;
+
+	benchEventPlugin() : numEvents(0), numHits(0) {  }
+
+	void Event(const std::deque<XiaData*> &event_){
+		numEvents++;
+		numHits += event_.size();
+	}
+
+	unsigned long long numEvents; /// The number of raw events built.
+	unsigned long long numHits; /// The number of hits in all raw events.
+};
+
+/// Print the throughput of one stage of the benchmark.
+void report(const std::string &stage_, const double &seconds_, const unsigned long long &hits_, const unsigned long long &words_){
+	std::cout << " " << std::left << std::setw(10) << stage_ << std::right;
+	std::cout << std::fixed << std::setprecision(3) << std::setw(10) << seconds_ << " s";
+	std::cout << std::setprecision(2) << std::setw(12) << hits_ / seconds_ / 1E6 << " Mhits/s";
+	std::cout << std::setprecision(1) << std::setw(10) << words_ * 4 / seconds_ / 1E6 << " MB/s\n";
+}
+
+/// Return the seconds elapsed since a time point.
+double elapsed(const std::chrono::steady_clock::time_point &start_){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void help(char *prog_name_){
+	std::cout << "  SYNTAX: " << prog_name_ << " [options]\n";
+	std::cout << "   Available options:\n";
+	std::cout << "    --help (-h)                   | Display this dialogue.\n";
+	std::cout << "    --modules (-m) <num>          | The number of modules in the crate (default=4).\n";
+	std::cout << "    --rate (-r) <Hz>              | The event rate of the crate (default=1E5).\n";
+	std::cout << "    --mult (-M) <num>             | The mean number of channels per event (default=2).\n";
+	std::cout << "    --trace (-t) <samples>        | The trace length of every hit (default=0).\n";
+	std::cout << "    --spill-time (-T) <s>         | The length of a spill (default=0.1).\n";
+	std::cout << "    --spills (-n) <num>           | The number of spills to generate (default=50).\n";
+	std::cout << "    --threads (-j) <num>          | The number of decode threads for event building (default=1).\n";
+	std::cout << "    --seed (-s) <seed>            | The seed of the generator (default=1).\n";
+	std::cout << "    --output (-o) <prefix>        | Also write the spills to ./<prefix>_001.pld.\n";
+}
+
+int main(int argc, char *argv[]){
+	struct option longOpts[] = {
+		{ "help",       no_argument,       NULL, 'h' },
+		{ "modules",    required_argument, NULL, 'm' },
+		{ "rate",       required_argument, NULL, 'r' },
+		{ "mult",       required_argument, NULL, 'M' },
+		{ "trace",      required_argument, NULL, 't' },
+		{ "spill-time", required_argument, NULL, 'T' },
+		{ "spills",     required_argument, NULL, 'n' },
+		{ "threads",    required_argument, NULL, 'j' },
+		{ "seed",       required_argument, NULL, 's' },
+		{ "output",     required_argument, NULL, 'o' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	SpillGenerator generator;
+	unsigned int numSpills = 50;
+	unsigned int numThreads = 1;
+	std::string outputPrefix;
+
+	int retval;
+	while((retval = getopt_long(argc, argv, "hm:r:M:t:T:n:j:s:o:", longOpts, NULL)) != -1){
+		switch(retval){
+			case 'h' :
+				help(argv[0]);
+				return 0;
+			case 'm' : generator.SetModules(strtoul(optarg, NULL, 0)); break;
+			case 'r' : generator.SetRate(strtod(optarg, NULL)); break;
+			case 'M' : generator.SetMultiplicity(strtod(optarg, NULL)); break;
+			case 't' : generator.SetTraceLength(strtoul(optarg, NULL, 0)); break;
+			case 'T' : generator.SetSpillTime(strtod(optarg, NULL)); break;
+			case 'n' : numSpills = strtoul(optarg, NULL, 0); break;
+			case 'j' : numThreads = strtoul(optarg, NULL, 0); break;
+			case 's' : generator.SetSeed(strtoul(optarg, NULL, 0)); break;
+			case 'o' : outputPrefix = optarg; break;
+			default :
+				help(argv[0]);
+				return 1;
+		}
+	}
+
+	if(generator.GetModules() > 14){
+		std::cout << " Error! No more than 14 modules per crate.\n";
+		return 1;
+	}
+
+	// Generate all spills up front, so that the generator is not part of the other stages.
+	std::vector<std::vector<unsigned int> > spills(numSpills);
+	unsigned long long numHits = 0;
+	unsigned long long numWords = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(std::vector<std::vector<unsigned int> >::iterator iter = spills.begin(); iter != spills.end(); iter++){
+		numHits += generator.Next(*iter);
+		numWords += iter->size();
+	}
+	double genTime = elapsed(start);
+
+	std::cout << " Generated " << numSpills << " spills, " << numHits << " hits, " << numWords * 4 / 1E6 << " MB.\n\n";
+	std::cout << " stage          time        hit rate      data rate\n";
+	report("generate", genTime, numHits, numWords);
+
+	// Decode every module buffer and pass the hits straight through.
+	{
+		benchHitPlugin plugin;
+		PluginUnpacker<benchHitPlugin> unpacker(plugin);
+		start = std::chrono::steady_clock::now();
+		for(std::vector<std::vector<unsigned int> >::iterator iter = spills.begin(); iter != spills.end(); iter++)
+			unpacker.ReadSpill(iter->data(), iter->size(), false);
+		report("decode", elapsed(start), unpacker.GetNumHits(), numWords);
+		if(unpacker.GetNumBadSpills() > 0)
+			std::cout << " Warning! Failed to decode " << unpacker.GetNumBadSpills() << " spills.\n";
+	}
+
+	// Decode, time sort and build raw events, as the scan codes do.
+	{
+		benchEventPlugin plugin;
+		PluginUnpacker<benchEventPlugin> unpacker(plugin);
+		unpacker.SetPoolMode(true);
+		unpacker.SetDecodeThreads(numThreads);
+		start = std::chrono::steady_clock::now();
+		for(std::vector<std::vector<unsigned int> >::iterator iter = spills.begin(); iter != spills.end(); iter++)
+			unpacker.ReadSpill(iter->data(), iter->size(), false);
+		unpacker.FlushEvents();
+		report("build", elapsed(start), plugin.numHits, numWords);
+		if(plugin.numEvents > 0)
+			std::cout << "\n Built " << plugin.numEvents << " raw events, " << (double)plugin.numHits / plugin.numEvents << " hits per event.\n";
+	}
+
+	if(!outputPrefix.empty()){
+		PollOutputFile output;
+		output.SetFileFormat(1);
+		unsigned int runNumber = 1;
+		if(!output.OpenNewFile(PROG_NAME, runNumber, outputPrefix)){
+			std::cout << " Error! Failed to open output file with prefix \"" << outputPrefix << "\".\n";
+			return 1;
+		}
+		for(std::vector<std::vector<unsigned int> >::iterator iter = spills.begin(); iter != spills.end(); iter++)
+			output.Write((char*)iter->data(), iter->size());
+		std::cout << " Wrote " << numSpills << " spills to " << output.GetCurrentFilename() << ".\n";
+		output.CloseFile();
+	}
+
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <iomanip>
 #include <iostream>
 
 // PixieCore libraries
@@ -34,6 +35,7 @@
 #endif
 
 #define ADC_TIME_STEP 4 // ns
+#define FILTER_CLOCK 8E-9 // s
 #define SLEEP_WAIT 1E4 // When not in shared memory mode, length of time to wait after gSystem->ProcessEvents is called (in us).
 
 /**The Paulauskas function is described in NIM A 737 (22), with a slight 
@@ -62,6 +64,38 @@ double PaulauskasFitFunc(double *x, double *p) {
 	return p[0] + p[1] * exp(-diff * p[3]) * (1 - exp(-pow(diff * p[4],4)));
 }
 
+/** Find the baseline, amplitude and rise time of a waveform and add its
+  * samples to a running sum. The baseline is the mean of the first quarter of
+  * the trace, up to 16 samples, and the rise time is measured between the
+  * last samples below 10% and 90% of the amplitude before the maximum.
+  *
+  * \param[in]  samples The samples of the waveform.
+  * \param[in]  size The number of samples.
+  * \param[out] baseline The baseline of the waveform.
+  * \param[out] amplitude The maximum of the waveform above the baseline.
+  * \param[out] riseTime The 10% to 90% rise time, in ns.
+  * \param[out] sum The running sum, which must hold size samples.
+  */
+template <typename T>
+void AnalyzeWaveform(const T *samples, const size_t &size, double &baseline, double &amplitude, double &riseTime, std::vector<double> &sum){
+	size_t numBase = std::max((size_t)1, std::min((size_t)16, size / 4));
+	size_t maxIndex = 0;
+	baseline = 0;
+	for(size_t i = 0; i < size; i++){
+		if(i < numBase) baseline += samples[i];
+		if(samples[i] > samples[maxIndex]) maxIndex = i;
+		sum[i] += samples[i];
+	}
+	baseline /= numBase;
+	amplitude = samples[maxIndex] - baseline;
+
+	size_t high = maxIndex;
+	while(high > 0 && samples[high - 1] - baseline >= 0.9 * amplitude) high--;
+	size_t low = high;
+	while(low > 0 && samples[low - 1] - baseline >= 0.1 * amplitude) low--;
+	riseTime = (high - low) * ADC_TIME_STEP;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // class scopeUnpacker
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,14 +127,24 @@ void scopeUnpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/){
 		rawEvent.pop_front();
 
 		// Safety catches for null event or empty adcTrace.
-		if(!current_event || current_event->adcTrace.empty()){
+		if(!current_event || current_event->getTraceLength() == 0){
+			continue;
+		}
+
+		// In monitor mode every event of a monitored channel is passed on.
+		if(!monitor_.empty()){
+			if(monitor_.count(current_event->getID()) == 0)
+				delete current_event;
+			else if(addr_->AddEvent(current_event))
+				addr_->ProcessEvents();
 			continue;
 		}
 
 		// Pass this event to the correct processor
-		int maximum = *std::max_element(current_event->adcTrace.begin(),current_event->adcTrace.end());
 		if(current_event->modNum == mod_ && current_event->chanNum == chan_){  
 			//Check threhsold.
+			std::vector<int> &trace = current_event->getTrace();
+			int maximum = *std::max_element(trace.begin(),trace.end());
 			if (maximum < threshLow_) {
 				delete current_event;
 				continue;
@@ -115,6 +159,7 @@ void scopeUnpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/){
 				addr_->ProcessEvents();
 			}
 		}
+		else{ delete current_event; }
 	}
 }
 
@@ -142,6 +187,17 @@ scopeScanner::scopeScanner(int mod /*= 0*/, int chan/*=0*/) : ScanInterface() {
 	delay_ = 2;
 	num_displayed = 0;
 	time(&last_trace);
+
+	accumulate_ = false;
+	persist_ = false;
+	frameRate_ = 10;
+	accumCount_ = 0;
+	persistLength_ = 0;
+	persistLow_ = 0;
+	persistBinWidth_ = 16;
+	lastFrame_ = std::chrono::steady_clock::now();
+	numSeen_ = 0;
+	numUsed_ = 0;
 	
 	// Variables for root graphics
 	rootapp = new TApplication("scope", 0, NULL);
@@ -176,6 +232,8 @@ scopeScanner::~scopeScanner(){
 	delete cfdLine;
 	delete hist;
 	delete paulauskasFunc;
+	for(std::vector<MonitorChannel>::iterator iter = monitorChans_.begin(); iter != monitorChans_.end(); iter++)
+		delete iter->graph;
 }
 
 TF1 *scopeScanner::SetupFunc() {
@@ -203,12 +261,191 @@ void scopeScanner::ResetGraph(unsigned int size) {
 	}
 	hist->SetBins(x_vals.size(), x_vals.front(), x_vals.back() + ADC_TIME_STEP, 1, 0, 1);
 
+	graph->SetTitle(GetTitle().c_str());
+	hist->SetTitle(GetTitle().c_str());
+
+	resetGraph_ = false;
+}
+
+std::string scopeScanner::GetTitle(){
 	std::stringstream stream;
 	stream << "M" << ((scopeUnpacker*)core)->GetMod() << "C" << ((scopeUnpacker*)core)->GetChan();
-	graph->SetTitle(stream.str().c_str());
-	hist->SetTitle(stream.str().c_str());
+	if(accumulate_)
+		stream << " average of " << accumCount_;
+	else if(persist_)
+		stream << " persistence of " << accumCount_;
+	if(numSeen_ > 0){
+		unsigned long long pending = chanEvents_.size();
+		stream << " (" << std::fixed << std::setprecision(1) << 100.0 * (numSeen_ - numUsed_ - pending) / numSeen_ << "% dropped)";
+	}
+	return stream.str();
+}
 
-	resetGraph_ = false;
+bool scopeScanner::SetAccumulate(const double &rate_){
+	ClearEvents();
+	resetGraph_ = true;
+	if(rate_ <= 0)
+		return (accumulate_ = false);
+	persist_ = false;
+	frameRate_ = rate_;
+	lastFrame_ = std::chrono::steady_clock::now();
+	return (accumulate_ = true);
+}
+
+bool scopeScanner::SetPersist(const double &rate_, const int &binWidth_){
+	ClearEvents();
+	resetGraph_ = true;
+	if(rate_ <= 0)
+		return (persist_ = false);
+	accumulate_ = false;
+	frameRate_ = rate_;
+	persistBinWidth_ = (binWidth_ > 0 ? binWidth_ : 1);
+	lastFrame_ = std::chrono::steady_clock::now();
+	return (persist_ = true);
+}
+
+bool scopeScanner::SetMonitor(const std::set<unsigned int> &ids_){
+	for(std::vector<MonitorChannel>::iterator iter = monitorChans_.begin(); iter != monitorChans_.end(); iter++)
+		delete iter->graph;
+	monitorChans_.clear();
+	monitorIndex_.clear();
+
+	((scopeUnpacker*)core)->SetMonitor(ids_);
+	ClearEvents();
+	resetGraph_ = true;
+
+	canvas->Clear();
+	if(ids_.empty()){
+		canvas->cd();
+		return false;
+	}
+
+	for(std::set<unsigned int>::const_iterator iter = ids_.begin(); iter != ids_.end(); iter++){
+		MonitorChannel chan;
+		chan.id = *iter;
+		chan.count = 0;
+		chan.baselineSum = chan.amplitudeSum = chan.riseTimeSum = 0;
+		chan.firstTime = chan.lastTime = 0;
+		chan.sumCount = 0;
+		chan.graph = new TGraph();
+		monitorIndex_[chan.id] = monitorChans_.size();
+		monitorChans_.push_back(chan);
+	}
+
+	// Arrange the channels in a grid as close to square as possible.
+	int columns = (int)std::ceil(std::sqrt(monitorChans_.size()));
+	int rows = (monitorChans_.size() + columns - 1) / columns;
+	canvas->Divide(columns, rows);
+
+	lastFrame_ = std::chrono::steady_clock::now();
+	return true;
+}
+
+bool scopeScanner::Monitor(XiaData *event_){
+	std::map<unsigned int, size_t>::iterator index = monitorIndex_.find(event_->getID());
+	if(index == monitorIndex_.end())
+		return false;
+	MonitorChannel &chan = monitorChans_[index->second];
+
+	size_t size = event_->getTraceLength();
+	if(size != chan.sum.size()){
+		chan.sum.assign(size, 0);
+		chan.sumCount = 0;
+	}
+
+	// Read trace views in place rather than copying them into the event.
+	double baseline, amplitude, riseTime;
+	if(event_->hasTraceView())
+		AnalyzeWaveform(event_->traceView, size, baseline, amplitude, riseTime, chan.sum);
+	else
+		AnalyzeWaveform(event_->adcTrace.data(), size, baseline, amplitude, riseTime, chan.sum);
+
+	if(chan.count == 0)
+		chan.firstTime = event_->time;
+	chan.lastTime = event_->time;
+	chan.baselineSum += baseline;
+	chan.amplitudeSum += amplitude;
+	chan.riseTimeSum += riseTime;
+	chan.count++;
+	chan.sumCount++;
+	numUsed_++;
+
+	return FrameDue();
+}
+
+void scopeScanner::PrintMonitor(){
+	if(monitorChans_.empty()){
+		std::cout << msgHeader << "No channels are being monitored.\n";
+		return;
+	}
+	std::cout << msgHeader << " mod chan     count  baseline  amplitude  rise (ns)  rate (Hz)\n";
+	for(std::vector<MonitorChannel>::iterator iter = monitorChans_.begin(); iter != monitorChans_.end(); iter++){
+		std::cout << msgHeader << std::setw(4) << iter->id / 16 << std::setw(5) << iter->id % 16 << std::setw(10) << iter->count;
+		if(iter->count > 0){
+			double span = (iter->lastTime - iter->firstTime) * FILTER_CLOCK;
+			std::cout << std::fixed << std::setprecision(1);
+			std::cout << std::setw(10) << iter->baselineSum / iter->count << std::setw(11) << iter->amplitudeSum / iter->count;
+			std::cout << std::setw(11) << iter->riseTimeSum / iter->count << std::setw(11) << (span > 0 ? (iter->count - 1) / span : 0);
+		}
+		std::cout << std::endl;
+	}
+}
+
+bool scopeScanner::FrameDue(){
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - lastFrame_;
+	return (elapsed.count() >= 1.0 / frameRate_);
+}
+
+bool scopeScanner::Accumulate(XiaData *event_){
+	size_t size = event_->getTraceLength();
+	if(size != accumSum_.size() || accumCount_ == 0){
+		accumSum_.assign(size, 0);
+		accumCount_ = 0;
+	}
+
+	// Read trace views in place rather than copying them into the event.
+	if(event_->hasTraceView()){
+		const unsigned short *samples = event_->traceView;
+		for(size_t i = 0; i < size; i++)
+			accumSum_[i] += samples[i];
+	}
+	else{
+		const std::vector<int> &samples = event_->adcTrace;
+		for(size_t i = 0; i < size; i++)
+			accumSum_[i] += samples[i];
+	}
+	accumCount_++;
+	numUsed_++;
+
+	return FrameDue();
+}
+
+bool scopeScanner::Persist(XiaData *event_){
+	size_t size = event_->getTraceLength();
+	const unsigned short *view = (event_->hasTraceView() ? event_->traceView : NULL);
+	const std::vector<int> &trace = event_->adcTrace;
+
+	if(size != persistLength_ || accumCount_ == 0){
+		// Centre the map on the first waveform, rounded to whole bins.
+		int first = (view ? view[0] : trace[0]);
+		persistLow_ = first - (persistBins_ / 4) * persistBinWidth_;
+		persistLow_ -= ((persistLow_ % persistBinWidth_) + persistBinWidth_) % persistBinWidth_;
+		persistCounts_.assign(size * persistBins_, 0);
+		persistLength_ = size;
+		accumCount_ = 0;
+	}
+
+	unsigned int *column = persistCounts_.data();
+	for(size_t i = 0; i < size; i++, column += persistBins_){
+		int bin = ((view ? view[i] : trace[i]) - persistLow_) / persistBinWidth_;
+		if(bin < 0) bin = 0;
+		else if(bin >= persistBins_) bin = persistBins_ - 1;
+		column[bin]++;
+	}
+	accumCount_++;
+	numUsed_++;
+
+	return FrameDue();
 }
 
 void scopeScanner::Plot(){
@@ -271,6 +508,7 @@ void scopeScanner::Plot(){
 		graph->GetXaxis()->SetRangeUser(userZoomVals[0][0], userZoomVals[0][1]);
 		graph->GetYaxis()->SetRangeUser(userZoomVals[1][0], userZoomVals[1][1]);
 
+		graph->SetTitle(GetTitle().c_str());
 		graph->Draw("AP0");
 
 		float lowVal = (chanEvents_.front()->max_index - fitLow_) * ADC_TIME_STEP;
@@ -362,6 +600,7 @@ void scopeScanner::Plot(){
 		delete chanEvents_.front();
 		chanEvents_.pop_front();
 	}
+	numUsed_ += numAvgWaveforms_;
 
 	// Update the canvas.
 	canvas->Update();
@@ -377,6 +616,124 @@ void scopeScanner::Plot(){
 	num_displayed++;
 }
 
+void scopeScanner::PlotAccumulated(){
+	if(accumCount_ == 0)
+		return;
+
+	size_t size = accumSum_.size();
+	if(size != x_vals.size() || resetGraph_)
+		ResetGraph(size);
+
+	// Write the average straight into the points of the graph.
+	if(graph->GetN() != (int)size)
+		graph->Set(size);
+	double *xPoints = graph->GetX();
+	double *yPoints = graph->GetY();
+	double norm = 1.0 / accumCount_;
+	double yMin = accumSum_[0] * norm, yMax = yMin;
+	for(size_t i = 0; i < size; i++){
+		xPoints[i] = x_vals[i];
+		yPoints[i] = accumSum_[i] * norm;
+		if(yPoints[i] < yMin) yMin = yPoints[i];
+		if(yPoints[i] > yMax) yMax = yPoints[i];
+	}
+
+	double margin = 0.1 * (yMax - yMin) + 1;
+	graph->SetMinimum(yMin - margin);
+	graph->SetMaximum(yMax + margin);
+	graph->GetXaxis()->SetLimits(x_vals.front(), x_vals.back());
+	graph->SetTitle(GetTitle().c_str());
+	graph->Draw("AL");
+
+	canvas->Modified();
+	canvas->Update();
+
+	// Save the TGraph to a file.
+	if (saveFile_ != "") {
+		TFile f(saveFile_.c_str(), "RECREATE");
+		graph->Clone("trace")->Write();
+		f.Close();
+		saveFile_ = "";
+	}
+
+	num_displayed++;
+}
+
+void scopeScanner::PlotMonitor(){
+	for(size_t i = 0; i < monitorChans_.size(); i++){
+		MonitorChannel &chan = monitorChans_[i];
+		canvas->cd(i + 1);
+
+		std::stringstream title;
+		title << "M" << chan.id / 16 << "C" << chan.id % 16;
+		if(chan.count == 0 || chan.sumCount == 0){
+			chan.graph->Set(0);
+			continue;
+		}
+
+		double span = (chan.lastTime - chan.firstTime) * FILTER_CLOCK;
+		title << std::fixed << std::setprecision(1) << " B=" << chan.baselineSum / chan.count;
+		title << " A=" << chan.amplitudeSum / chan.count << " R=" << chan.riseTimeSum / chan.count << "ns";
+		title << " " << (span > 0 ? (chan.count - 1) / span : 0) << "Hz";
+
+		// Write the average straight into the points of the graph.
+		size_t size = chan.sum.size();
+		if(chan.graph->GetN() != (int)size)
+			chan.graph->Set(size);
+		double *xPoints = chan.graph->GetX();
+		double *yPoints = chan.graph->GetY();
+		double norm = 1.0 / chan.sumCount;
+		for(size_t j = 0; j < size; j++){
+			xPoints[j] = j * ADC_TIME_STEP;
+			yPoints[j] = chan.sum[j] * norm;
+		}
+
+		chan.graph->SetTitle(title.str().c_str());
+		chan.graph->Draw("AL");
+	}
+
+	canvas->cd();
+	canvas->Modified();
+	canvas->Update();
+
+	num_displayed++;
+}
+
+void scopeScanner::PlotPersistence(){
+	if(accumCount_ == 0)
+		return;
+
+	if(persistLength_ != x_vals.size() || resetGraph_){
+		ResetGraph(persistLength_);
+		hist->SetBins(x_vals.size(), x_vals.front(), x_vals.back() + ADC_TIME_STEP, persistBins_, persistLow_, persistLow_ + persistBins_ * persistBinWidth_);
+	}
+
+	// Copy the map into the histogram, the bins of which are offset by one.
+	const unsigned int *column = persistCounts_.data();
+	for(size_t i = 0; i < persistLength_; i++, column += persistBins_){
+		for(int j = 0; j < persistBins_; j++)
+			hist->SetBinContent(i + 1, j + 1, column[j]);
+	}
+	hist->SetEntries(accumCount_ * persistLength_);
+
+	hist->SetTitle(GetTitle().c_str());
+	hist->SetStats(false);
+	hist->Draw("COLZ");
+
+	canvas->Modified();
+	canvas->Update();
+
+	// Save the histogram to a file.
+	if (saveFile_ != "") {
+		TFile f(saveFile_.c_str(), "RECREATE");
+		hist->Clone("persistence")->Write();
+		f.Close();
+		saveFile_ = "";
+	}
+
+	num_displayed++;
+}
+
 /** Initialize the map file, the config file, the processor handler, 
   * and add all of the required processors.
   * \param[in]  prefix_ String to append to the beginning of system output.
@@ -424,6 +781,22 @@ Unpacker *scopeScanner::GetCore(){
 bool scopeScanner::AddEvent(XiaData *event_){
 	if(!event_){ return false; }
 
+	numSeen_++;
+
+	// Only the statistics are kept in monitor mode.
+	if(!monitorChans_.empty()){
+		bool frameDue = Monitor(event_);
+		delete event_;
+		return frameDue;
+	}
+
+	// Only the running sum or the map is kept in accumulation or persistence mode.
+	if(accumulate_ || persist_){
+		bool frameDue = (accumulate_ ? Accumulate(event_) : Persist(event_));
+		delete event_;
+		return frameDue;
+	}
+
 	//Get the first event int the FIFO.
 	ChannelEvent *channel_event = new ChannelEvent(event_);
 
@@ -447,6 +820,16 @@ bool scopeScanner::AddEvent(XiaData *event_){
   * \return True if events were processed and false otherwise.
   */
 bool scopeScanner::ProcessEvents(){
+	//In monitor, accumulation or persistence mode the frame rate was checked by AddEvent.
+	if(!monitorChans_.empty() || accumulate_ || persist_){
+		if(!monitorChans_.empty()) PlotMonitor();
+		else if(accumulate_) PlotAccumulated();
+		else PlotPersistence();
+		lastFrame_ = std::chrono::steady_clock::now();
+		if (singleCapture_) running = false;
+		return true;
+	}
+
 	//Check if we have delayed the plotting enough
 	time_t cur_time;
 	time(&cur_time);
@@ -479,6 +862,17 @@ void scopeScanner::ClearEvents(){
 		delete chanEvents_.front();
 		chanEvents_.pop_front();
 	}
+	accumSum_.clear();
+	persistCounts_.clear();
+	accumCount_ = 0;
+	for(std::vector<MonitorChannel>::iterator iter = monitorChans_.begin(); iter != monitorChans_.end(); iter++){
+		iter->count = 0;
+		iter->baselineSum = iter->amplitudeSum = iter->riseTimeSum = 0;
+		iter->sum.clear();
+		iter->sumCount = 0;
+	}
+	numSeen_ = 0;
+	numUsed_ = 0;
 }
 
 /** CmdHelp is used to allow a derived class to print a help statement about
@@ -496,6 +890,9 @@ void scopeScanner::CmdHelp(const std::string &prefix_/*=""*/){
 	std::cout << "   fit <low> <high>        - Turn on fitting of waveform. Set <low> to \"off\" to disable.\n";
 	std::cout << "   cfd [F=0.5] [D=1] [L=1] - Turn on cfd analysis of waveform. Set [F] to \"off\" to disable.\n";
 	std::cout << "   avg <numWaveforms>      - Set the number of waveforms to average.\n";
+	std::cout << "   accum [rate=10]         - Average all waveforms, drawing <rate> frames per second. Set [rate] to \"off\" to disable.\n";
+	std::cout << "   monitor [mod:chan ...]  - Monitor the statistics of several channels at once, <chan> may be \"*\" for a whole module. Without arguments, print the statistics. Use \"off\" to disable.\n";
+	std::cout << "   persist [rate=10] [bin=16] - Fill a persistence map of all waveforms with <bin> ADC channels per bin, drawing <rate> frames per second. Set [rate] to \"off\" to disable.\n";
 	std::cout << "   save <fileName>         - Save the next trace to the specified file name..\n";
 	std::cout << "   delay [time]            - Set the delay between drawing traces (in seconds, default = 1 s).\n";
 	std::cout << "   log                     - Toggle log/linear mode on the y-axis.\n";
@@ -638,6 +1035,56 @@ bool scopeScanner::ExtraCommands(const std::string &cmd_, std::vector<std::strin
 			std::cout << msgHeader << " -SYNTAX- avg <numWavefroms>\n";
 		}
 	}
+	else if (cmd_ == "accum") {
+		double rate = 10;
+		if (!args_.empty())
+			rate = (args_.at(0) == "off" ? 0 : atof(args_.at(0).c_str()));
+		if (SetAccumulate(rate))
+			std::cout << msgHeader << "Accumulating waveforms, drawing " << frameRate_ << " frames per second.\n";
+		else
+			std::cout << msgHeader << "Disabling waveform accumulation.\n";
+	}
+	else if (cmd_ == "persist") {
+		double rate = 10;
+		int binWidth = persistBinWidth_;
+		if (!args_.empty())
+			rate = (args_.at(0) == "off" ? 0 : atof(args_.at(0).c_str()));
+		if (args_.size() > 1)
+			binWidth = atoi(args_.at(1).c_str());
+		if (SetPersist(rate, binWidth))
+			std::cout << msgHeader << "Filling persistence map with " << persistBinWidth_ << " ADC channels per bin, drawing " << frameRate_ << " frames per second.\n";
+		else
+			std::cout << msgHeader << "Disabling persistence map.\n";
+	}
+	else if (cmd_ == "monitor") {
+		if (args_.empty()) {
+			PrintMonitor();
+			return true;
+		}
+		std::set<unsigned int> ids;
+		if (args_.at(0) != "off") {
+			for (std::vector<std::string>::iterator arg = args_.begin(); arg != args_.end(); arg++) {
+				size_t colon = arg->find(':');
+				if (colon == std::string::npos) {
+					std::cout << msgHeader << "Invalid channel '" << *arg << "' to 'monitor'\n";
+					std::cout << msgHeader << " -SYNTAX- monitor <mod:chan> [mod:chan ...]\n";
+					return true;
+				}
+				unsigned int mod = atoi(arg->substr(0, colon).c_str());
+				std::string chan = arg->substr(colon + 1);
+				if (chan == "*") {
+					for (unsigned int i = 0; i < 16; i++)
+						ids.insert(mod * 16 + i);
+				}
+				else
+					ids.insert(mod * 16 + atoi(chan.c_str()));
+			}
+		}
+		if (SetMonitor(ids))
+			std::cout << msgHeader << "Monitoring " << ids.size() << " channels.\n";
+		else
+			std::cout << msgHeader << "Disabling channel monitoring.\n";
+	}
 	else if(cmd_ == "save") {
 		if (args_.size() == 1) {
 			saveFile_ = args_.at(0);
@@ -666,6 +1113,7 @@ bool scopeScanner::ExtraCommands(const std::string &cmd_, std::vector<std::strin
 	}
 	else if(cmd_ == "clear"){
 		ClearEvents();
+		resetGraph_ = true;
 		std::cout << msgHeader << "Event deque cleared.\n";
 	}
 	else{ return false; }
@@ -0,0 +1,372 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include <getopt.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+#include "hribf_buffers.h"
+#include "poll2_socket.h"
+#include "poll2_shm.h"
+#include "poll2_stream.h"
+
+#include "SpillGenerator.hpp"
+#include "SpillIndex.hpp"
+
+// Define the name of the program.
+#ifndef PROG_NAME
+#define PROG_NAME "SpillGen"
+#endif
+
+#define CLOCK_TICK 8E-9 // The revision F timestamp clock, in seconds.
+#define MAX_SPILL_GAP 10.0 // The longest pause between replayed spills, in seconds.
+#define MAX_SPILL_WORDS 1000000 // The largest spill, in words.
+
+typedef std::chrono::steady_clock::time_point time_point;
+
+volatile sig_atomic_t stopRequested = 0;
+
+void stop_handler(int sig_){ stopRequested = 1; }
+
+/// Source of the spills, either generated or read from a data file.
+class SpillSource{
+  public:
+	SpillSource() : fileFormat(-1), maxBytes(4*MAX_SPILL_WORDS), loop(false), numReplays(0) {  }
+
+	SpillGenerator generator; /// The generator used when there is no input file.
+
+	/** Open a .ldf or .pld file for replay.
+	  * \param[in]  fname_ The name of the file.
+	  * \param[in]  loop_  Rewind the file whenever its end is reached.
+	  * \return True upon success and false otherwise.
+	  */
+	bool Open(const std::string &fname_, const bool &loop_){
+		std::string ext = fname_.substr(fname_.find_last_of('.') + 1);
+		if(ext == "ldf"){ fileFormat = 0; }
+		else if(ext == "pld"){ fileFormat = 1; }
+		else{
+			std::cout << " Error! Unknown file extension \"" << ext << "\", expected .ldf or .pld.\n";
+			return false;
+		}
+
+		file.open(fname_.c_str(), std::ios::binary);
+		if(!file.good()){
+			std::cout << " Error! Failed to open input file \"" << fname_ << "\".\n";
+			return false;
+		}
+
+		loop = loop_;
+		return ReadHeaders();
+	}
+
+	/// Return true if spills are read from a file.
+	bool IsReplay() const { return (fileFormat >= 0); }
+
+	/// Return the number of times the end of the input file was reached.
+	unsigned int GetNumReplays() const { return numReplays; }
+
+	/** Get the next spill.
+	  * \param[out] spill_ The spill.
+	  * \return True if a spill was read and false at the end of the data.
+	  */
+	bool Next(std::vector<unsigned int> &spill_){
+		if(!IsReplay()){
+			generator.Next(spill_);
+			return true;
+		}
+
+		spill_.resize(maxBytes/4 + 2);
+		unsigned int nBytes = 0;
+		while(true){
+			bool readOk;
+			bool endOfFile = false;
+			bool fullSpill = true;
+			bool badSpill = false;
+			if(fileFormat == 0){
+				readOk = dataBuff.Read(&file, (char*)spill_.data(), nBytes, maxBytes, fullSpill, badSpill);
+				endOfFile = (!readOk && (dataBuff.GetRetval() == 2 || dataBuff.GetRetval() == 6));
+			}
+			else{
+				readOk = pldData.Read(&file, (char*)spill_.data(), nBytes, maxBytes);
+				endOfFile = !readOk;
+			}
+
+			if(readOk && fullSpill && !badSpill){
+				spill_.resize(nBytes/4);
+				return true;
+			}
+			if(!endOfFile){ continue; }
+
+			numReplays++;
+			if(!loop){ return false; }
+			file.clear();
+			file.seekg(0, std::ios::beg);
+			if(!ReadHeaders()){ return false; }
+		}
+	}
+
+  private:
+	std::ifstream file; /// The input file.
+	int fileFormat; /// The format of the input file, 0 for .ldf and 1 for .pld, -1 if generating.
+	unsigned int maxBytes; /// The largest spill which may be read, in bytes.
+	bool loop; /// True if the input file is replayed in a loop.
+	unsigned int numReplays; /// The number of times the end of the input file was reached.
+
+	DIR_buffer dirBuff;
+	HEAD_buffer headBuff;
+	DATA_buffer dataBuff;
+	PLD_header pldHead;
+	PLD_data pldData;
+
+	/// Read the headers at the start of the file.
+	bool ReadHeaders(){
+		if(fileFormat == 0){
+			dataBuff.Reset();
+			return (dirBuff.Read(&file) && headBuff.Read(&file));
+		}
+		pldData.Reset();
+		if(!pldHead.Read(&file)){ return false; }
+		maxBytes = 4 * pldHead.GetMaxSpillSize();
+		return true;
+	}
+};
+
+/// Send the spills on to one of the outputs used by poll2.
+class SpillSink{
+  public:
+	SpillSink() : numFailed(0), client(NULL), shm(NULL), stream(NULL) {  }
+
+	~SpillSink(){
+		if(client){ client->SendMessage((char *)"$KILL_SOCKET", 13); }
+		delete client;
+		delete shm;
+		delete stream;
+	}
+
+	/// Send the spills in datagrams to a shm port, as poll2 does in shm mode.
+	bool InitSocket(const std::string &host_){
+		client = new Client();
+		if(!client->Init(host_.c_str(), 5555)){
+			std::cout << " Error! Failed to open socket to " << host_ << ":5555.\n";
+			return false;
+		}
+		client->SetBufferSize(POLL2_SOCKET_BUFFER);
+		std::cout << " Sending spills to " << host_ << ":5555.\n";
+		return true;
+	}
+
+	/// Write the spills into the shared memory ring read by scanners on this host.
+	bool InitShm(){
+		shm = new SpillShm();
+		if(!shm->Create(POLL2_SHM_NAME, POLL2_SHM_SLOTS, MAX_SPILL_WORDS)){
+			std::cout << " Error! Failed to create shared memory ring " << POLL2_SHM_NAME << ".\n";
+			return false;
+		}
+		std::cout << " Writing spills to shared memory ring " << POLL2_SHM_NAME << ".\n";
+		return true;
+	}
+
+	/// Serve the spills to TCP stream subscribers.
+	bool InitStream(const int &port_){
+		stream = new StreamServer();
+		if(!stream->Init(port_)){
+			std::cout << " Error! Failed to open TCP stream port " << port_ << ".\n";
+			return false;
+		}
+		std::cout << " Serving spills on TCP stream port " << port_ << ".\n";
+		return true;
+	}
+
+	/// Send a spill.
+	void Send(std::vector<unsigned int> &spill_){
+		if(client){
+			int numChunks = (spill_.size() + POLL2_SOCKET_CHUNK - 1) / POLL2_SOCKET_CHUNK;
+			if(client->SendSpill(spill_.data(), spill_.size()) < numChunks){ numFailed++; }
+		}
+		else if(shm){
+			if(!shm->Write(spill_.data(), spill_.size())){ numFailed++; }
+		}
+		else if(stream){ stream->Send(spill_.data(), spill_.size()); }
+	}
+
+	/// Return a short status of the output.
+	std::string Status(){
+		std::stringstream status;
+		if(stream){ status << stream->GetNumClients() << " clients, " << stream->GetDropped() << " dropped"; }
+		else{ status << numFailed << " failed"; }
+		return status.str();
+	}
+
+  private:
+	unsigned long numFailed; /// The number of spills which could not be sent.
+
+	Client *client;
+	SpillShm *shm;
+	StreamServer *stream;
+};
+
+void help(char *prog_name_){
+	std::cout << "  SYNTAX: " << prog_name_ << " [options]\n";
+	std::cout << "   Sends synthetic spills, or the spills of a data file, the way poll2 broadcasts them.\n";
+	std::cout << "   Available options:\n";
+	std::cout << "    --help (-h)                   | Display this dialogue.\n";
+	std::cout << "    --host <address>              | Send datagrams to the shm port of this host (default).\n";
+	std::cout << "    --shm                         | Write to the shared memory ring instead.\n";
+	std::cout << "    --stream <port>               | Serve a TCP stream on this port instead.\n";
+	std::cout << "    --input (-i) <file>           | Replay the spills of a .ldf or .pld file.\n";
+	std::cout << "    --loop                        | Replay the input file until stopped.\n";
+	std::cout << "    --speed (-x) <factor>         | Send at this multiple of real time, 0 for no pacing (default=1).\n";
+	std::cout << "    --duration (-d) <s>           | Stop after this many seconds (default=run until stopped).\n";
+	std::cout << "    --modules (-m) <num>          | The number of generated modules (default=4).\n";
+	std::cout << "    --rate (-r) <Hz>              | The generated event rate (default=1E5).\n";
+	std::cout << "    --mult (-M) <num>             | The mean number of channels per event (default=2).\n";
+	std::cout << "    --trace (-t) <samples>        | The trace length of every hit (default=0).\n";
+	std::cout << "    --spill-time (-T) <s>         | The length of a generated spill (default=0.1).\n";
+	std::cout << "    --burst (-B) <f>,<period>,<s> | Multiply the rate by f for s seconds of every period.\n";
+	std::cout << "    --seed (-s) <seed>            | The seed of the generator (default=1).\n";
+}
+
+int main(int argc, char *argv[]){
+	struct option longOpts[] = {
+		{ "help",       no_argument,       NULL, 'h' },
+		{ "host",       required_argument, NULL, 'H' },
+		{ "shm",        no_argument,       NULL, 'S' },
+		{ "stream",     required_argument, NULL, 'P' },
+		{ "input",      required_argument, NULL, 'i' },
+		{ "loop",       no_argument,       NULL, 'l' },
+		{ "speed",      required_argument, NULL, 'x' },
+		{ "duration",   required_argument, NULL, 'd' },
+		{ "modules",    required_argument, NULL, 'm' },
+		{ "rate",       required_argument, NULL, 'r' },
+		{ "mult",       required_argument, NULL, 'M' },
+		{ "trace",      required_argument, NULL, 't' },
+		{ "spill-time", required_argument, NULL, 'T' },
+		{ "burst",      required_argument, NULL, 'B' },
+		{ "seed",       required_argument, NULL, 's' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	SpillSource source;
+	std::string host = "127.0.0.1";
+	std::string input;
+	bool useShm = false;
+	bool loop = false;
+	int streamPort = 0;
+	double speed = 1;
+	double duration = 0;
+	double rate = 1E5;
+	double spillTime = 0.1;
+	double burstFactor = 1, burstPeriod = 0, burstLength = 0;
+
+	int retval;
+	while((retval = getopt_long(argc, argv, "hi:x:d:m:r:M:t:T:B:s:", longOpts, NULL)) != -1){
+		switch(retval){
+			case 'h' :
+				help(argv[0]);
+				return 0;
+			case 'H' : host = optarg; break;
+			case 'S' : useShm = true; break;
+			case 'P' : streamPort = atoi(optarg); break;
+			case 'i' : input = optarg; break;
+			case 'l' : loop = true; break;
+			case 'x' : speed = strtod(optarg, NULL); break;
+			case 'd' : duration = strtod(optarg, NULL); break;
+			case 'm' : source.generator.SetModules(strtoul(optarg, NULL, 0)); break;
+			case 'r' : rate = strtod(optarg, NULL); break;
+			case 'M' : source.generator.SetMultiplicity(strtod(optarg, NULL)); break;
+			case 't' : source.generator.SetTraceLength(strtoul(optarg, NULL, 0)); break;
+			case 'T' : spillTime = strtod(optarg, NULL); break;
+			case 'B' :
+				if(sscanf(optarg, "%lf,%lf,%lf", &burstFactor, &burstPeriod, &burstLength) != 3 || burstPeriod <= 0){
+					std::cout << " Error! Expected a burst of the form <factor>,<period>,<length>.\n";
+					return 1;
+				}
+				break;
+			case 's' : source.generator.SetSeed(strtoul(optarg, NULL, 0)); break;
+			default :
+				help(argv[0]);
+				return 1;
+		}
+	}
+
+	source.generator.SetSpillTime(spillTime);
+	if(!input.empty() && !source.Open(input, loop)){ return 1; }
+
+	SpillSink sink;
+	bool sinkOk;
+	if(streamPort > 0){ sinkOk = sink.InitStream(streamPort); }
+	else if(useShm){ sinkOk = sink.InitShm(); }
+	else{ sinkOk = sink.InitSocket(host); }
+	if(!sinkOk){ return 1; }
+
+	signal(SIGINT, stop_handler);
+	signal(SIGTERM, stop_handler);
+
+	std::vector<unsigned int> spill;
+	unsigned long long numSpills = 0;
+	unsigned long long numWords = 0;
+	unsigned long long lastTime = 0;
+	double dataTime = 0; // The time covered by the data sent so far, in seconds.
+
+	time_point start = std::chrono::steady_clock::now();
+	time_point lastReport = start;
+	unsigned long long lastSpills = 0, lastWords = 0;
+	while(!stopRequested){
+		// The rate of the generator follows the burst pattern in data time.
+		if(!source.IsReplay()){
+			bool inBurst = (burstPeriod > 0 && dataTime - burstPeriod * (unsigned long long)(dataTime / burstPeriod) < burstLength);
+			source.generator.SetRate(inBurst ? rate * burstFactor : rate);
+		}
+
+		if(!source.Next(spill)){ break; }
+
+		// Advance the data time by the length of the spill, or by the time between replayed spills.
+		if(!source.IsReplay()){ dataTime += source.generator.GetLastSpillTime(); }
+		else{
+			unsigned long long time;
+			if(SpillIndex::GetFirstTime(spill.data(), spill.size(), time)){
+				if(lastTime != 0 && time > lastTime){ dataTime += std::min((time - lastTime) * CLOCK_TICK, MAX_SPILL_GAP); }
+				lastTime = time;
+			}
+		}
+
+		// Wait until the spill is due.
+		if(speed > 0){
+			time_point due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(dataTime / speed));
+			std::this_thread::sleep_until(due);
+		}
+
+		sink.Send(spill);
+		numSpills++;
+		numWords += spill.size();
+
+		time_point now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>(now - start).count();
+		double sinceReport = std::chrono::duration<double>(now - lastReport).count();
+		if(sinceReport >= 1){
+			std::cout << " " << std::fixed << std::setprecision(1) << std::setw(8) << elapsed << " s: ";
+			std::cout << std::setw(7) << (numSpills - lastSpills) / sinceReport << " spills/s, ";
+			std::cout << std::setw(8) << (numWords - lastWords) * 4 / sinceReport / 1E6 << " MB/s, ";
+			std::cout << numSpills << " spills sent, " << sink.Status() << std::endl;
+			lastReport = now;
+			lastSpills = numSpills;
+			lastWords = numWords;
+		}
+
+		if(duration > 0 && elapsed >= duration){ break; }
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << " Sent " << numSpills << " spills (" << numWords * 4 / 1E6 << " MB) in " << elapsed << " s, ";
+	std::cout << numWords * 4 / elapsed / 1E6 << " MB/s, " << sink.Status() << ".\n";
+	if(source.IsReplay()){ std::cout << " Replayed " << dataTime << " s of data, reaching the end of the input file " << source.GetNumReplays() << " times.\n"; }
+
+	return 0;
+}
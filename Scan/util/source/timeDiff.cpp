@@ -0,0 +1,462 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "XiaData.hpp"
+
+// Local files
+#include "timeDiff.hpp"
+
+// Define the name of the program.
+#ifndef PROG_NAME
+#define PROG_NAME "TimeDiff"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// class timeDiffUnpacker
+///////////////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+timeDiffUnpacker::timeDiffUnpacker() : Unpacker(),
+	window(0),
+	binWidth(1),
+	numBins(1),
+	tick(8),
+	reference(-1),
+	numHits(0),
+	numPairs(0),
+	numBadSpills(0)
+{
+}
+
+/// Destructor.
+timeDiffUnpacker::~timeDiffUnpacker(){
+	for(std::vector<XiaData*>::iterator iter = cache.begin(); iter != cache.end(); iter++)
+		ReleaseEvent(*iter);
+}
+
+/** Set up the spectra.
+  * \param[in]  window_    The largest time difference paired (in ns).
+  * \param[in]  binWidth_  The width of the bins of the spectra (in ns).
+  * \param[in]  tick_      The length of a clock tick of the timestamps (in ns).
+  * \param[in]  reference_ The ID of the reference channel, or -1 to fill all pairs.
+  * \return Nothing.
+  */
+void timeDiffUnpacker::SetSpectra(const double &window_, const double &binWidth_, const double &tick_, const int &reference_){
+	const double fixedTick = (double)(1ULL << XiaData::cfdFractionBits);
+	tick = tick_;
+	window = (unsigned long long)(window_ / tick * fixedTick);
+	binWidth = std::max(1ULL, (unsigned long long)(binWidth_ / tick * fixedTick));
+	window -= window % binWidth; // Zero is then the lower edge of the center bin.
+	numBins = 2 * (window / binWidth) + 1;
+	reference = reference_;
+	spectra.clear();
+	recent.clear();
+}
+
+/** Decode all module buffers of a spill into the hit table, order them in
+  * time and fill the spectra of the pairs of hits within the window. The
+  * module records are walked in the same way as Unpacker::ReadSpill.
+  * \param[in]  data       Pointer to an array of unsigned ints containing the spill data.
+  * \param[in]  nWords     The number of words in the array.
+  * \param[in]  is_verbose Toggle the verbosity flag on/off.
+  * \return True if the spill was read successfully and false otherwise.
+  */
+bool timeDiffUnpacker::ReadSpill(unsigned int *data, unsigned int nWords, bool is_verbose/*=true*/){
+	std::vector<XiaData*> events;
+
+	size_t nWords_read = 0;
+	unsigned int lenRec = 0;
+	unsigned int vsn = 0xFFFFFFFF;
+	bool good = true;
+
+	hits.clear();
+
+	while(nWords_read + 1 < nWords){
+		while(nWords_read < nWords && data[nWords_read] == 0xFFFFFFFF) // Search for the next non-delimiter.
+			nWords_read++;
+		if(nWords_read + 1 >= nWords){ break; }
+
+		lenRec = data[nWords_read]; // Number of words in this record
+		vsn = data[nWords_read+1]; // Module number
+
+		if(vsn == 9999){ break; } // End spill vsn
+
+		// Check sanity of record length and vsn
+		if(lenRec < 2 || nWords_read + lenRec > nWords || (vsn > maxVsn && vsn != 1000)){
+			if(is_verbose){
+				std::cout << "timeDiffUnpacker: SANITY CHECK FAILED: lenRec = " << lenRec << ", vsn = " << vsn << ", read " << nWords_read << " of " << nWords << std::endl;
+			}
+			good = false;
+			break;
+		}
+
+		// Empty modules (record length 6) and the wall clock buffer (vsn 1000) hold no hits.
+		if(lenRec != 6 && vsn < maxVsn){
+			events.clear();
+			if(DecodeBuffer(&data[nWords_read], events, &cache) <= -100){
+				if(is_verbose){ std::cout << "timeDiffUnpacker: READOUT PROBLEM in module " << vsn << std::endl; }
+				good = false;
+			}
+			for(std::vector<XiaData*>::iterator iter = events.begin(); iter != events.end(); iter++){
+				hits.push_back(*iter);
+				ReleaseCachedEvent(*iter, &cache);
+			}
+			if(!good){ break; }
+		}
+
+		nWords_read += lenRec;
+	}
+
+	// Spills which end without the end of spill vsn were split between
+	// buffers, and are dropped like they are by Unpacker::ReadSpill.
+	if(!good || (vsn != 9999 && vsn != 1000)){
+		numBadSpills++;
+		hits.clear();
+		return false;
+	}
+
+	// The hits of the window are carried over from the last spill, so the
+	// pairs which straddle the end of a spill are kept.
+	hits.Sort();
+	for(size_t pos = 0; pos < hits.size(); pos++){
+		size_t row = hits.at(pos);
+		Sweep(hits.timeStamp[row], hits.modNum[row]*16+hits.chanNum[row]);
+	}
+	numHits += hits.size();
+
+	return true;
+}
+
+/** Find the peak of the spectrum of every pair with at least minCounts_
+  * counts. The flat background of random coincidences, taken from the
+  * outer quarters of the spectrum, is subtracted, and a gaussian is fitted
+  * to the bins above half of the maximum around the highest bin, by fitting
+  * a parabola to the logarithm of the counts weighted by the counts.
+  * \param[in]  minCounts_ The smallest number of counts of a spectrum with a peak.
+  * \param[out] peaks_     The peaks found.
+  * \return Nothing.
+  */
+void timeDiffUnpacker::FindPeaks(const unsigned long long &minCounts_, std::vector<Peak> &peaks_) const {
+	const double binNs = binWidth * tick / (1ULL << XiaData::cfdFractionBits);
+	const int center = numBins / 2;
+
+	for(std::map<unsigned int, std::vector<unsigned int> >::const_iterator iter = spectra.begin(); iter != spectra.end(); iter++){
+		const std::vector<unsigned int> &spec = iter->second;
+
+		unsigned long long counts = 0;
+		for(size_t i = 0; i < spec.size(); i++)
+			counts += spec[i];
+		if(counts < minCounts_){ continue; }
+
+		size_t quarter = std::max((size_t)1, spec.size() / 4);
+		double background = 0;
+		for(size_t i = 0; i < quarter; i++)
+			background += spec[i] + spec[spec.size()-1-i];
+		background /= 2 * quarter;
+
+		size_t peak = std::max_element(spec.begin(), spec.end()) - spec.begin();
+		double height = spec[peak] - background;
+		if(height <= 0){ continue; }
+
+		size_t low = peak, high = peak;
+		while(low > 0 && spec[low-1] - background > height / 2){ low--; }
+		while(high + 1 < spec.size() && spec[high+1] - background > height / 2){ high++; }
+
+		// Weighted least squares of ln(y) = a + b*x + c*x^2, with x relative
+		// to the highest bin to keep the sums well conditioned.
+		double s[5] = {0, 0, 0, 0, 0}, t[3] = {0, 0, 0};
+		for(size_t i = low; i <= high; i++){
+			double y = spec[i] - background;
+			double x = (double)i - peak;
+			double w = y * y, ly = std::log(y);
+			double xn = 1;
+			for(int k = 0; k < 5; k++){
+				s[k] += w * xn;
+				if(k < 3){ t[k] += w * xn * ly; }
+				xn *= x;
+			}
+		}
+
+		Peak result;
+		result.first = iter->first / 65536;
+		result.second = iter->first % 65536;
+		result.counts = counts;
+
+		double det = s[0]*(s[2]*s[4]-s[3]*s[3]) - s[1]*(s[1]*s[4]-s[3]*s[2]) + s[2]*(s[1]*s[3]-s[2]*s[2]);
+		double b = 0, c = 0;
+		if(high - low >= 2 && det != 0){
+			b = (s[0]*(t[1]*s[4]-s[3]*t[2]) - t[0]*(s[1]*s[4]-s[3]*s[2]) + s[2]*(s[1]*t[2]-t[1]*s[2])) / det;
+			c = (s[0]*(s[2]*t[2]-t[1]*s[3]) - s[1]*(s[1]*t[2]-t[1]*s[2]) + t[0]*(s[1]*s[3]-s[2]*s[2])) / det;
+		}
+		if(c < 0){
+			result.mean = (peak - b / (2 * c) - center + 0.5) * binNs;
+			result.sigma = std::sqrt(-1 / (2 * c)) * binNs;
+		}
+		else{ // Too narrow to fit, use the centroid of the bins above half maximum.
+			double sum = 0, sumx = 0, sumxx = 0;
+			for(size_t i = low; i <= high; i++){
+				double y = spec[i] - background;
+				sum += y;
+				sumx += y * i;
+				sumxx += y * i * i;
+			}
+			double mean = sumx / sum;
+			result.mean = (mean - center + 0.5) * binNs;
+			result.sigma = std::sqrt(std::max(sumxx / sum - mean * mean, 1.0 / 12)) * binNs;
+		}
+		peaks_.push_back(result);
+	}
+}
+
+/** Pair a hit with the hits of the window before it.
+  * \param[in]  timeStamp_ The fixed point time of the hit.
+  * \param[in]  id_        The ID of the channel of the hit.
+  * \return Nothing.
+  */
+void timeDiffUnpacker::Sweep(const unsigned long long &timeStamp_, const unsigned int &id_){
+	while(!recent.empty() && recent.front().first + window < timeStamp_)
+		recent.pop_front();
+
+	for(std::deque<std::pair<unsigned long long, unsigned int> >::iterator iter = recent.begin(); iter != recent.end(); iter++){
+		if(iter->second == id_){ continue; }
+		long long diff = (long long)(timeStamp_ - iter->first);
+		if(reference >= 0){
+			if((int)iter->second == reference){ Fill(iter->second, id_, diff); }
+			else if((int)id_ == reference){ Fill(id_, iter->second, -diff); }
+		}
+		else if(iter->second < id_){ Fill(iter->second, id_, diff); }
+		else{ Fill(id_, iter->second, -diff); }
+	}
+
+	recent.push_back(std::make_pair(timeStamp_, id_));
+}
+
+/** Fill the spectrum of a pair of channels.
+  * \param[in]  first_  The ID of the first channel.
+  * \param[in]  second_ The ID of the second channel.
+  * \param[in]  diff_   The time of the second channel minus the first, in fixed point clock ticks.
+  * \return Nothing.
+  */
+void timeDiffUnpacker::Fill(const unsigned int &first_, const unsigned int &second_, const long long &diff_){
+	if(diff_ > (long long)window || -diff_ > (long long)window){ return; }
+	std::vector<unsigned int> &spec = spectra[first_*65536+second_];
+	if(spec.empty()){ spec.resize(numBins, 0); }
+	long long bin = (diff_ + (long long)window) / (long long)binWidth;
+	spec[std::min((long long)numBins-1, bin)]++;
+	numPairs++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class timeDiffScanner
+///////////////////////////////////////////////////////////////////////////////
+
+/// Default constructor.
+timeDiffScanner::timeDiffScanner() : ScanInterface() {
+	init = false;
+	window = 100;
+	binWidth = 0.5;
+	tick = 8;
+	reference = -1;
+	minCounts = 100;
+}
+
+/// Destructor.
+timeDiffScanner::~timeDiffScanner(){
+}
+
+/** ExtraArguments is used to send command line arguments to classes derived
+  * from ScanInterface. This method should loop over the optionExt elements
+  * in the vector userOpts and check for those options which have been flagged
+  * as active by ::Setup(). This should be overloaded in the derived class.
+  * \return Nothing.
+  */
+void timeDiffScanner::ExtraArguments(){
+	if(userOpts.at(0).active){
+		window = atof(userOpts.at(0).argument.c_str());
+		std::cout << msgHeader << "Pairing hits up to " << window << " ns apart.\n";
+	}
+	if(userOpts.at(1).active){
+		binWidth = atof(userOpts.at(1).argument.c_str());
+		std::cout << msgHeader << "Using bins of " << binWidth << " ns.\n";
+	}
+	if(userOpts.at(2).active){
+		tick = atof(userOpts.at(2).argument.c_str());
+		std::cout << msgHeader << "Using clock ticks of " << tick << " ns.\n";
+	}
+	if(userOpts.at(3).active){
+		std::string arg = userOpts.at(3).argument;
+		size_t colon = arg.find(':');
+		if(colon == std::string::npos){ reference = strtol(arg.c_str(), NULL, 0); }
+		else{ reference = strtol(arg.substr(0, colon).c_str(), NULL, 0)*16 + strtol(arg.substr(colon+1).c_str(), NULL, 0); }
+		std::cout << msgHeader << "Pairing every channel with module " << reference / 16 << " channel " << reference % 16 << ".\n";
+	}
+	if(userOpts.at(4).active){
+		minCounts = strtoull(userOpts.at(4).argument.c_str(), NULL, 0);
+		std::cout << msgHeader << "Fitting spectra with at least " << minCounts << " counts.\n";
+	}
+	GetCore()->SetSkipTraces();
+}
+
+/** ArgHelp is used to allow a derived class to add a command line option
+  * to the main list of options. This method is called at the end of
+  * from the ::Setup method.
+  * \return Nothing.
+  */
+void timeDiffScanner::ArgHelp(){
+	AddOption(optionExt("window", required_argument, NULL, 0, "<ns>", "Pair hits up to this far apart (default=100)"));
+	AddOption(optionExt("bin", required_argument, NULL, 0, "<ns>", "Width of the bins of the time difference spectra (default=0.5)"));
+	AddOption(optionExt("tick", required_argument, NULL, 0, "<ns>", "Length of a clock tick of the timestamps (default=8)"));
+	AddOption(optionExt("reference", required_argument, NULL, 0, "<mod:chan>", "Only pair the channels with this one, instead of all pairs"));
+	AddOption(optionExt("min-counts", required_argument, NULL, 0, "<N>", "Only fit spectra with at least N counts (default=100)"));
+}
+
+/** SyntaxStr is used to print a linux style usage message to the screen.
+  * \param[in]  name_ The name of the program.
+  * \return Nothing.
+  */
+void timeDiffScanner::SyntaxStr(char *name_){
+	std::cout << " usage: " << std::string(name_) << " [options]\n";
+	std::cout << "  Fills the time difference spectra of channel pairs, fits their peaks and\n";
+	std::cout << "  writes the timing offset of every channel to <output>.time.xml.\n";
+}
+
+/** Set up the spectra.
+  * \param[in]  prefix_ String to append to the beginning of system output.
+  * \return True upon successfully initializing and false otherwise.
+  */
+bool timeDiffScanner::Initialize(std::string prefix_){
+	if(init){ return false; }
+
+	if(window <= 0 || binWidth <= 0 || tick <= 0){
+		std::cout << prefix_ << "The window, bin and tick must be positive.\n";
+		return false;
+	}
+	((timeDiffUnpacker*)GetCore())->SetSpectra(window, binWidth, tick, reference);
+
+	return (init = true);
+}
+
+/** Receive various status notifications from the scan.
+  * \param[in] code_ The notification code passed from ScanInterface methods.
+  * \return Nothing.
+  */
+void timeDiffScanner::Notify(const std::string &code_/*=""*/){
+	if(code_ == "START_SCAN"){  }
+	else if(code_ == "STOP_SCAN"){  }
+	else if(code_ == "SCAN_COMPLETE"){
+		timeDiffUnpacker *unpacker = (timeDiffUnpacker*)GetCore();
+		std::cout << msgHeader << "Scan complete. Paired " << unpacker->GetNumHits() << " hits " << unpacker->GetNumPairs() << " times.\n";
+		if(unpacker->GetNumBadSpills() > 0)
+			std::cout << msgHeader << "Dropped " << unpacker->GetNumBadSpills() << " spills which failed to decode.\n";
+		WriteOffsets();
+	}
+	else if(code_ == "LOAD_FILE"){ std::cout << msgHeader << "File loaded.\n"; }
+	else if(code_ == "REWIND_FILE"){  }
+	else{ std::cout << msgHeader << "Unknown notification code '" << code_ << "'!\n"; }
+}
+
+/** Return a pointer to the Unpacker object to use for data unpacking.
+  * If no object has been initialized, create a new one.
+  * \return Pointer to an Unpacker object.
+  */
+Unpacker *timeDiffScanner::GetCore(){
+	if(!core){ core = (Unpacker*)(new timeDiffUnpacker()); }
+	return core;
+}
+
+/** Find the peaks, solve for the offset of every channel and write them to
+  * <output>.time.xml. The offset of a channel is the time by which its hits
+  * are late with respect to the reference channel. With a reference every
+  * offset is the peak of its pair with the reference. Otherwise the offsets
+  * are the weighted least squares solution of the peaks of all pairs, with
+  * the channel of lowest ID as the reference, found by relaxation.
+  * \return Nothing.
+  */
+void timeDiffScanner::WriteOffsets(){
+	std::vector<timeDiffUnpacker::Peak> peaks;
+	((timeDiffUnpacker*)GetCore())->FindPeaks(minCounts, peaks);
+	if(peaks.empty()){
+		std::cout << msgHeader << "No spectrum has " << minCounts << " counts, no offsets were found.\n";
+		return;
+	}
+
+	std::cout << " mod chan  mod chan       counts   peak (ns)  sigma (ns)\n";
+	for(std::vector<timeDiffUnpacker::Peak>::iterator iter = peaks.begin(); iter != peaks.end(); iter++){
+		std::cout << std::setw(4) << iter->first / 16 << std::setw(5) << iter->first % 16;
+		std::cout << std::setw(5) << iter->second / 16 << std::setw(5) << iter->second % 16;
+		std::cout << std::setw(13) << iter->counts << std::fixed << std::setprecision(3);
+		std::cout << std::setw(12) << iter->mean << std::setw(12) << iter->sigma << "\n";
+	}
+
+	// Each channel is moved to the weighted mean of where its pairs put it.
+	unsigned int ref = (reference >= 0 ? reference : peaks.front().first);
+	std::map<unsigned int, double> offsets;
+	offsets[ref] = 0;
+	for(int iteration = 0; iteration < 10000; iteration++){
+		std::map<unsigned int, std::pair<double, double> > sums;
+		for(std::vector<timeDiffUnpacker::Peak>::iterator iter = peaks.begin(); iter != peaks.end(); iter++){
+			double weight = iter->counts / (iter->sigma * iter->sigma);
+			std::map<unsigned int, double>::iterator first = offsets.find(iter->first);
+			std::map<unsigned int, double>::iterator second = offsets.find(iter->second);
+			if(first != offsets.end()){
+				sums[iter->second].first += weight * (first->second + iter->mean);
+				sums[iter->second].second += weight;
+			}
+			if(second != offsets.end()){
+				sums[iter->first].first += weight * (second->second - iter->mean);
+				sums[iter->first].second += weight;
+			}
+		}
+
+		double change = 0;
+		for(std::map<unsigned int, std::pair<double, double> >::iterator iter = sums.begin(); iter != sums.end(); iter++){
+			if(iter->first == ref){ continue; }
+			double offset = iter->second.first / iter->second.second;
+			std::map<unsigned int, double>::iterator old = offsets.find(iter->first);
+			change = std::max(change, (old == offsets.end() ? 1.0 : std::fabs(offset - old->second)));
+			offsets[iter->first] = offset;
+		}
+		if(reference >= 0 || change < 1E-6){ break; }
+	}
+
+	std::string fname = GetOutputFilename() + ".time.xml";
+	std::ofstream xml(fname.c_str());
+	if(!xml.good()){
+		std::cout << msgHeader << "Failed to open output file '" << fname << "'.\n";
+		return;
+	}
+	xml << "<TimeCalibration verbose_timing=\"False\">\n";
+	xml << "    <Channels reference=\"" << ref / 16 << ":" << ref % 16 << "\" unit=\"ns\">\n";
+	xml << std::fixed << std::setprecision(3);
+	for(std::map<unsigned int, double>::iterator iter = offsets.begin(); iter != offsets.end(); iter++){
+		xml << "        <Channel module=\"" << iter->first / 16 << "\" channel=\"" << iter->first % 16;
+		xml << "\" offset=\"" << iter->second << "\"/>\n";
+	}
+	xml << "    </Channels>\n";
+	xml << "</TimeCalibration>\n";
+	std::cout << msgHeader << "Wrote the offsets of " << offsets.size() << " channels to '" << fname << "'.\n";
+}
+
+int main(int argc, char *argv[]){
+	// Define a new unpacker object.
+	timeDiffScanner scanner;
+
+	// Set the output message prefix.
+	scanner.SetProgramName(std::string(PROG_NAME));
+
+	// Initialize the scanner.
+	if(!scanner.Setup(argc, argv))
+		return 1;
+
+	// Run the main loop.
+	int retval = scanner.Execute();
+
+	scanner.Close();
+
+	return retval;
+}
@@ -15,6 +15,16 @@ class CfdAnalyzer : public TraceAnalyzer {
 public:
     /** Default constructor */
     CfdAnalyzer();
+    /** Constructor
+    * \param [in] type : "poly" for the streaming integer CFD with a
+    *    polynomial interpolation of the crossing, anything else for the
+    *    fit of the CFD waveform around the maximum
+    * \param [in] fraction : the fraction of the CFD
+    * \param [in] delay : the delay of the CFD in samples
+    * \param [in] threshold : the height above the baseline in ADC units
+    *    that arms the streaming CFD */
+    CfdAnalyzer(const std::string &type, const double &fraction,
+                const unsigned int &delay, const unsigned int &threshold);
     /** Default Destructor */
     ~CfdAnalyzer(){};
     /** Declare the plots */
@@ -27,5 +37,23 @@ public:
     virtual void Analyze(Trace &trace, const std::string &detType,
                          const std::string &detSubtype,
                          const std::map<std::string, int> &tagMap);
+private:
+    bool isPoly_; //!< True if we use the streaming integer CFD
+    double fraction_; //!< The fraction of the CFD
+    unsigned int delay_; //!< The delay of the CFD in samples
+    unsigned int threshold_; //!< Height above the baseline that arms the CFD
+    long long fracNum_; //!< The fraction in units of 1/kFracDen
+
+    /** Find the phase with the CFD waveform around the maximum found by the
+    * WaveformAnalyzer
+    * \param [in] trace : the trace to analyze */
+    void AnalyzeWaveform(Trace &trace);
+
+    /** Find the phase with the streaming integer CFD. The CFD is calculated
+    * sample by sample from the start of the trace, and stops at the first
+    * crossing after the trace passes the threshold. The crossing is then
+    * interpolated with a cubic polynomial through the CFD around it.
+    * \param [in] trace : the trace to analyze */
+    void AnalyzeStreaming(Trace &trace);
 };
 #endif
@@ -2,7 +2,8 @@
  * \brief Class to fit functions to waveforms
  *
  * Obtains the phase of a waveform using a Chi^2 fitting algorithm
- * implemented through the GSL libraries.
+ * implemented through the GSL libraries, or using the faster fit of a
+ * tabulated pulse shape.
  *
  * \author S. V. Paulauskas
  * \date 22 July 2011
@@ -23,7 +24,7 @@ public:
     FittingAnalyzer(const std::string &s);
 
     /** Default Destructor */
-    ~FittingAnalyzer() {};
+    ~FittingAnalyzer();
     /** Declare plots for the analyzer */
     virtual void DeclarePlots(void);
     /** Analyzes the traces
@@ -34,8 +35,21 @@ public:
     virtual void Analyze(Trace &trace, const std::string &detType,
                          const std::string &detSubtype,
                          const std::map<std::string, int> & tagMap);
+    /** Analyzes all of the traces of an event, looking up the fitting
+     * parameters once for each detector type
+     * \param [in] hits : the traces of the event */
+    virtual void Analyze(std::vector<Hit> &hits);
 private:
+    /** Fits the waveform of a single trace
+     * \param [in] trace : the trace to fit
+     * \param [in] isDblBetaT : true if this is the timing output of a SiPMT
+     * \param [in] pars : the fitting parameters for the detector */
+    void FitTrace(Trace &trace, const bool &isDblBetaT,
+                  const std::pair<double,double> &pars);
+
     FitDriver::FITTER_TYPE fitterType_;
+    FitDriver *pmtDriver_; ///< fitter for the standard PMT signals
+    FitDriver *siPmtDriver_; ///< fitter for the fast SiPMT timing signals
 };
 #endif // __FITTINGANALYZER_HPP_
 // David is awesome.
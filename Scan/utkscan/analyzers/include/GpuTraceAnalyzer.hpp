@@ -0,0 +1,54 @@
+/** \file GpuTraceAnalyzer.hpp
+ * \brief Analyzes whole batches of traces on a GPU
+ *
+ * The baseline, maximum, QDCs, a digital CFD and a fit of the PMT pulse
+ * shape are calculated for every trace of an event at once, by one thread
+ * of the GPU for each trace. The analysis is the same as that of the
+ * WaveformAnalyzer followed by the FittingAnalyzer with the template
+ * fitter. The GPU is only used if utkscan was built with UTKSCAN_USE_CUDA
+ * and the batch is large enough to be worth the transfer, otherwise the
+ * same code is run on the host.
+ */
+#ifndef __GPUTRACEANALYZER_HPP_
+#define __GPUTRACEANALYZER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "GpuTraceKernels.hpp"
+#include "Trace.hpp"
+#include "TraceAnalyzer.hpp"
+
+//! Analyzer that offloads the waveform analysis and fitting to a GPU
+class GpuTraceAnalyzer : public TraceAnalyzer {
+public:
+    /** Constructor
+     * \param [in] minBatch : the smallest batch of traces that is sent to
+     *    the GPU, smaller batches are analyzed on the host */
+    GpuTraceAnalyzer(const unsigned int &minBatch);
+
+    /** Default Destructor */
+    ~GpuTraceAnalyzer() {};
+
+    /** Analyzes a single trace, on the host
+     * \param [in] trace : the trace to analyze
+     * \param [in] detType : the detector type we have
+     * \param [in] detSubtype : the subtype of the detector
+     * \param [in] tagMap : the map of tags for the channel */
+    virtual void Analyze(Trace &trace, const std::string &detType,
+                         const std::string &detSubtype,
+                         const std::map<std::string, int> & tagMap);
+
+    /** Analyzes all of the traces of an event in one batch
+     * \param [in] hits : the traces of the event */
+    virtual void Analyze(std::vector<Hit> &hits);
+private:
+    unsigned int minBatch_; ///< smallest batch that is sent to the GPU
+    bool warned_; ///< true once we warned that the GPU is not available
+
+    std::vector<Trace::Sample> samples_; ///< the samples of the batch
+    std::vector<GpuTraceInput> inputs_; ///< the description of each trace
+    std::vector<GpuTraceResult> results_; ///< the results of each trace
+    std::vector<Hit> batch_; ///< the hits whose traces are in the batch
+};
+#endif // __GPUTRACEANALYZER_HPP_
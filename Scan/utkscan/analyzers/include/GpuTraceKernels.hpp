@@ -0,0 +1,188 @@
+/// \file GpuTraceKernels.hpp
+/// \brief The analysis of a single trace shared by the GPU and the host
+///
+/// The function in this file is compiled both by the CUDA compiler, for the
+/// kernel in GpuTraceKernels.cu, and by the host compiler, for the
+/// GpuTraceAnalyzer when no device is available. It therefore only uses
+/// plain data and the math functions that both of them provide.
+#ifndef PIXIESUITE_GPUTRACEKERNELS_HPP
+#define PIXIESUITE_GPUTRACEKERNELS_HPP
+
+#include <cstddef>
+
+#include <math.h>
+
+#ifdef __CUDACC__
+#define GPU_HOST_DEVICE __host__ __device__
+#else
+#define GPU_HOST_DEVICE
+#endif
+
+/// The description of one trace in a batch
+struct GpuTraceInput {
+    unsigned int offset;///< index of the first sample in the batch
+    unsigned int size;///< number of samples in the trace
+    unsigned int low;///< samples of the waveform before the maximum
+    unsigned int high;///< samples of the waveform after the maximum
+    double beta;///< the decay constant of the pulse shape
+    double gamma;///< the rise constant of the pulse shape
+};
+
+/// The results of the analysis of one trace
+struct GpuTraceResult {
+    int status;///< 0 if the analysis succeeded
+    int maxpos;///< the position of the maximum in the trace
+    double baseline;///< the baseline before the waveform
+    double sigmaBaseline;///< the standard deviation of the baseline
+    double maxval;///< the maximum above the baseline
+    double qdc;///< the baseline subtracted sum of the waveform
+    double tqdc;///< the baseline subtracted sum of the whole trace
+    double cfdPhase;///< the CFD crossing in samples from the trace start
+    double phase;///< the start of the fitted pulse relative to the maximum
+    double amplitude;///< the fitted amplitude relative to the qdc
+};
+
+/// Evaluates the PMT pulse shape of the VANDLE fitting function
+/// \param[in] u the time after the start of the pulse in samples
+/// \param[in] beta the decay constant of the pulse shape
+/// \param[in] gamma the rise constant of the pulse shape
+/// \param[out] deriv the derivative of the shape at u
+/// \return the value of the shape at u
+GPU_HOST_DEVICE inline double GpuPulseShape(double u, double beta,
+                                            double gamma, double &deriv) {
+    if(u <= 0) {
+        deriv = 0.;
+        return(0.);
+    }
+    double decay = exp(-beta*u);
+    double gu = gamma*u;
+    double gaussSq = exp(-gu*gu*gu*gu);
+    deriv = -beta*decay*(1-gaussSq) + 4*decay*u*u*u*gamma*gamma*gamma*gamma*
+                                      gaussSq;
+    return(decay*(1-gaussSq));
+}
+
+/// Analyzes a single trace : the baseline, maximum and QDCs, a digital CFD
+/// at 25% with a delay of 2 samples and a linear interpolation, and a fit of
+/// the PMT pulse shape over the waveform with the amplitude profiled out, a
+/// coarse scan of the phase and a few Gauss-Newton steps.
+/// \param[in] samples the samples of the whole batch
+/// \param[in] in the description of the trace to analyze
+/// \param[out] out the results of the analysis
+GPU_HOST_DEVICE inline void GpuAnalyzeTrace(const unsigned short *samples,
+                                            const GpuTraceInput &in,
+                                            GpuTraceResult &out) {
+    const unsigned short *x = samples + in.offset;
+    const int n = in.size;
+    out.status = 1;
+
+    //Maximum of the trace, searched after the samples for the baseline
+    int maxpos = in.low + 1;
+    if(maxpos >= n)
+        return;
+    for(int i = maxpos; i < n; i++)
+        if(x[i] > x[maxpos])
+            maxpos = i;
+    int wlo = maxpos - (int)in.low;
+    int whi = maxpos + (int)in.high + 1;
+    if(wlo < 1 || whi > n)
+        return;
+
+    //Baseline before the waveform and the QDCs
+    long long sum = 0, baseSum = 0, baseSumSq = 0, qdcSum = 0;
+    for(int i = 0; i < n; i++) {
+        long long v = x[i];
+        sum += v;
+        if(i < wlo) {
+            baseSum += v;
+            baseSumSq += v*v;
+        } else if(i > wlo && i < whi)
+            qdcSum += v;
+    }
+    double mean = (double)baseSum / wlo;
+    out.maxpos = maxpos;
+    out.baseline = mean;
+    out.sigmaBaseline = sqrt((double)(wlo*baseSumSq - baseSum*baseSum)) / wlo;
+    out.maxval = x[maxpos] - mean;
+    out.qdc = qdcSum - mean*(whi - wlo - 1);
+    out.tqdc = sum - mean*n;
+
+    //CFD : the delayed signal minus a fraction of the prompt one
+    out.cfdPhase = NAN;
+    double prev = 0;
+    for(int i = wlo + 2; i <= maxpos + 2 && i < n; i++) {
+        double cfd = (x[i-2] - mean) - 0.25*(x[i] - mean);
+        if(i > wlo + 2 && prev < 0 && cfd >= 0) {
+            out.cfdPhase = i - 1 + prev / (prev - cfd);
+            break;
+        }
+        prev = cfd;
+    }
+
+    //Fit of the pulse shape to the waveform, which starts at wlo + 1
+    const int first = wlo + 1, m = whi - first;
+    double best = -1, phi = 0, amp = 0;
+    for(double trial = -2.; trial <= in.low; trial += 0.25) {
+        double syg = 0, sgg = 0, syy = 0, deriv;
+        for(int i = 0; i < m; i++) {
+            double y = x[first+i] - mean;
+            double g = GpuPulseShape(i - trial, in.beta, in.gamma, deriv);
+            syg += y*g;
+            sgg += g*g;
+            syy += y*y;
+        }
+        if(sgg <= 0)
+            continue;
+        double res = syy - syg*syg/sgg;
+        if(best < 0 || res < best) {
+            best = res;
+            phi = trial;
+            amp = syg/sgg;
+        }
+    }
+    if(best < 0)
+        return;
+
+    for(int iter = 0; iter < 5; iter++) {
+        double saa = 0, sab = 0, sbb = 0, sar = 0, sbr = 0;
+        for(int i = 0; i < m; i++) {
+            double deriv;
+            double g = GpuPulseShape(i - phi, in.beta, in.gamma, deriv);
+            double r = amp*g - (x[first+i] - mean);
+            double a = -amp*deriv;
+            saa += a*a;
+            sab += a*g;
+            sbb += g*g;
+            sar += a*r;
+            sbr += g*r;
+        }
+        double det = saa*sbb - sab*sab;
+        if(det <= 0)
+            break;
+        double dphi = -(sbb*sar - sab*sbr) / det;
+        phi += dphi;
+        amp += -(saa*sbr - sab*sar) / det;
+        if(fabs(dphi) < 1e-4)
+            break;
+    }
+
+    out.phase = phi;
+    out.amplitude = out.qdc != 0 ? amp / out.qdc : 0.;
+    out.status = 0;
+}
+
+/// Analyzes a batch of traces on the GPU. The device buffers are kept
+/// between calls and only grown when a batch does not fit.
+/// \param[in] samples the samples of all of the traces, one after another
+/// \param[in] numSamples the total number of samples
+/// \param[in] inputs the description of each trace
+/// \param[out] results the results for each trace
+/// \param[in] numTraces the number of traces in the batch
+/// \return false if there is no device or a CUDA call failed, in which case
+/// the results are not filled
+bool GpuAnalyzeTraces(const unsigned short *samples,
+                      const size_t &numSamples,
+                      const GpuTraceInput *inputs, GpuTraceResult *results,
+                      const size_t &numTraces);
+
+#endif //PIXIESUITE_GPUTRACEKERNELS_HPP
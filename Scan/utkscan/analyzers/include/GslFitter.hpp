@@ -6,14 +6,18 @@
 #ifndef PIXIESUITE_GSLFITTER_HPP
 #define PIXIESUITE_GSLFITTER_HPP
 
+#include <map>
+
+#include <gsl/gsl_multifit_nlin.h>
+
 #include "FitDriver.hpp"
 
 class GslFitter : public FitDriver{
 public:
     ///Default Constructor
     GslFitter(const bool &isFastSipm) : FitDriver() {isFastSipm_ = isFastSipm;}
-    ///Default Destructor
-    virtual ~GslFitter(){};
+    ///Default Destructor, frees the cached workspaces
+    virtual ~GslFitter();
 
     ///\return the phase from the GSL fit
     virtual double GetPhase(void){return phase_;}
@@ -32,6 +36,24 @@ public:
                             const double &weight = 1.,
                             const double &area = 1.);
 private:
+    /// The GSL objects needed to fit a trace of a given length. They are
+    /// allocated the first time a trace of that length is fit, and are
+    /// reused by every later fit of the same length.
+    struct Workspace {
+        gsl_multifit_fdfsolver *solver;///< the Levenberg-Marquardt solver
+        gsl_matrix *jac;///< the Jacobian at the solution
+        gsl_matrix *covar;///< the covariance matrix of the parameters
+        std::vector<double> y;///< copy of the data for the fit function
+        std::vector<double> weights;///< weights for each of the points
+    };
+
+    /// Gets the workspace for a fit, allocating it if needed
+    /// \param[in] n The number of points in the fit
+    /// \param[in] p The number of parameters in the fit
+    /// \return The workspace for a fit of n points
+    Workspace &GetWorkspace(const size_t &n, const size_t &p);
+
+    std::map<size_t, Workspace> workspaces_;///< Workspaces by trace length
     bool isFastSipm_;
 
     double amp_;
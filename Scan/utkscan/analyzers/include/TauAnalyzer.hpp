@@ -5,6 +5,7 @@
 #define __TAUANALYZER_HPP_
 
 #include <string>
+#include <vector>
 
 #include "TraceAnalyzer.hpp"
 
@@ -19,8 +20,20 @@ public:
     * \param [in] aSubtype : a subtype to analyze tau from */
     TauAnalyzer(const std::string &aType, const std::string &aSubtype);
 
-    /** Default Destructor */
-    ~TauAnalyzer(){};
+    /** Constructor for a survey of the decay constants of every channel. The
+    * traces of each channel are gathered by a log-linear fit of their tails,
+    * and the decay constants are written at the end of the run, in the
+    * format read by papply, to the file given.
+    * \param [in] survey : the file to write the survey to, in the output
+    *  path, no survey is done if it is empty */
+    TauAnalyzer(const std::string &survey);
+
+    /** Destructor, writes the survey if one was done */
+    ~TauAnalyzer();
+
+    /** Analyze the traces of an event, adding them to the survey
+    * \param [in] hits : the traces of the event */
+    virtual void Analyze(std::vector<Hit> &hits);
 
     /** The main analysis driver
     * \param [in] trace : the trace to analyze
@@ -31,8 +44,32 @@ public:
                          const std::string &aSubtype,
                          const std::map<std::string, int> & tagMap);
 private:
+    /** The sums of the log-linear fits of the traces of a channel */
+    struct Survey {
+        unsigned long long traces; //!< the number of traces fit
+        double sxy; //!< sum of the weighted covariances of time and log
+        double sxx; //!< sum of the weighted variances of time
+    };
+
+    /** Fit the logarithm of the tail of a trace with a line, each sample
+    * weighted by its square, which is the inverse of the variance of its
+    * logarithm. The slope of the fit is sxy / sxx, and is negative for a
+    * decaying trace. Since the amplitude of a trace only moves the line up
+    * or down, the sums of several traces give the slope common to all of
+    * them.
+    * \param [in] trace : the trace to fit
+    * \param [out] sxy : the weighted covariance of the time and the log
+    * \param [out] sxx : the weighted variance of the time
+    * \return false if the tail was too short to fit */
+    static bool FitTail(const Trace &trace, double &sxy, double &sxx);
+
+    /** Write the decay constants of the survey to its file and the screen */
+    void WriteSurvey() const;
+
     std::string type; //!< the detector type
     std::string subtype;//!< the detector subtype
+    std::string surveyFile_; //!< the file to write the survey to
+    std::vector<Survey> survey_; //!< the survey of each channel index
 };
 
 #endif // __TAUANALYZER_HPP_
@@ -0,0 +1,80 @@
+/// \file TemplateFitter.hpp
+/// \brief A fast fitter that uses a tabulated pulse shape and a linearized
+/// solve instead of a full Levenberg-Marquardt minimization
+
+#ifndef PIXIESUITE_TEMPLATEFITTER_HPP
+#define PIXIESUITE_TEMPLATEFITTER_HPP
+
+#include <vector>
+
+#include "FitDriver.hpp"
+
+/// A fitter that uses the same pulse shapes as the GslFitter, tabulated
+/// finely along with their derivatives. The amplitude is a linear parameter
+/// of the fit, so for any phase it is known in closed form. The phase is
+/// first estimated with a matched filter, by scanning the template over the
+/// rise of the trace, and is then refined with a few Gauss-Newton steps of
+/// the linearized problem. The table is only rebuilt when the parameters of
+/// the pulse shape or the length of the trace change.
+class TemplateFitter : public FitDriver {
+public:
+    ///Default Constructor
+    /// \param[in] isFastSipm True if we are fitting the Gaussian fast output
+    /// of SiPMTs, which has no free amplitude
+    TemplateFitter(const bool &isFastSipm);
+    ///Default Destructor
+    virtual ~TemplateFitter(){};
+
+    ///\return the phase from the fit
+    virtual double GetPhase(void){return phase_;}
+    ///\return the amplitude from the fit
+    virtual double GetAmplitude(void) {return amp_;}
+    ///\return the chi^2 from the fit
+    virtual double GetChiSq(void) {return chi_*chi_;}
+    ///\return the chi^2dof from the fit
+    virtual double GetChiSqPerDof(void) {return GetChiSq()/dof_;}
+    ///The main driver for the fitting
+    /// \param[in] data The data that we would like to try and fit
+    /// \param[in] pars The parameters for the fit
+    /// \param[in] weight The weight for the fit
+    /// \param[in] area The qdc of the waveform
+    virtual void PerformFit(const std::vector<double> &data,
+                            const std::pair<double,double> &pars,
+                            const double &weight = 1.,
+                            const double &area = 1.);
+private:
+    /// Tabulates the pulse shape and its derivative for the given parameters
+    /// \param[in] pars The <beta, gamma> parameters of the pulse shape
+    /// \param[in] size The number of points in the traces that are fit
+    void BuildTemplate(const std::pair<double,double> &pars,
+                       const size_t &size);
+
+    /// Looks up the template at a time after the start of the pulse
+    /// \param[in] u The time after the start of the pulse in samples
+    /// \param[out] deriv The derivative of the template at u
+    /// \return The value of the template at u
+    double Lookup(const double &u, double &deriv) const;
+
+    /// Calculates the sum of the squared residuals at a given phase, using
+    /// the amplitude that best matches the data at that phase
+    /// \param[in] data The data that we are fitting
+    /// \param[in] phase The start of the pulse in samples
+    /// \param[out] amp The amplitude of the template for the phase
+    /// \return The sum of the squared residuals
+    double Residual(const std::vector<double> &data, const double &phase,
+                    double &amp) const;
+
+    bool isFastSipm_;///< True if we are fitting the SiPMT fast output
+
+    std::pair<double,double> tablePars_;///< Parameters of the current table
+    size_t tableSize_;///< Trace length the current table was built for
+    double tableMin_;///< The first time in the table in samples
+    std::vector<double> shape_;///< The tabulated template
+    std::vector<double> slope_;///< The tabulated derivative of the template
+
+    double amp_;///< the amplitude found by the fit
+    double chi_;///< the weighted norm of the residuals
+    double dof_;///< the number of degrees of freedom of the fit
+    double phase_;///< the phase found by the fit
+};
+#endif //PIXIESUITE_TEMPLATEFITTER_HPP
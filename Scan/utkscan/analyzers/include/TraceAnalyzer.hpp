@@ -6,8 +6,11 @@
 #ifndef __TRACEANALYZER_HPP_
 #define __TRACEANALYZER_HPP_
 
+#include <map>
+#include <set>
 #include <string>
-#include <sys/times.h>
+#include <typeinfo>
+#include <vector>
 
 #include "Plots.hpp"
 #include "Trace.hpp"
@@ -15,6 +18,15 @@
 ///Abstract class that all trace analyzers are derived from
 class TraceAnalyzer {
 public:
+    /** A trace of an event together with the channel it was read from */
+    struct Hit {
+        Trace *trace; ///< the trace to analyze
+        const std::string *type; ///< the type of detector
+        const std::string *subtype; ///< the subtype of the detector
+        const std::map<std::string, int> *tags; ///< the tags of the channel
+        int index; ///< the channel index, module * 16 + channel
+    };
+
      /** Default Constructor */
     TraceAnalyzer();
     /** Default Destructor */
@@ -40,24 +52,65 @@ public:
     virtual void Analyze(Trace &trace, const std::string &type,
                          const std::string &subtype,
                          const std::map<std::string, int> & tagMap);
+
+    /** Function to analyze all of the traces of an event at once. The hits
+     * are sorted so that those of the same type and subtype are next to each
+     * other, which lets an analyzer do its setup once per detector type, or
+     * hand the traces out to several threads. By default every hit is
+     * analyzed in turn.
+     * \param [in] hits : the traces of the event */
+    virtual void Analyze(std::vector<Hit> &hits);
+
     /** End the analysis and record the analyzer level in the trace
      * \param [in] trace : the trace */
     void EndAnalyze(Trace &trace);
-    /** Finish analysis updating the analyzer timing information */
-    void EndAnalyze(void);
+    /** Finish analysis. The time spent in Analyze is recorded by the
+     * DetectorDriver, so this does nothing and is kept for the derived
+     * classes which call it. */
+    void EndAnalyze(void) {};
     /** Set the level of the trace analysis
      * \param [in] i : the level of the analysis to be done */
     void SetLevel(int i) {level=i;}
     /** \return the level of the trace analysis */
     int  GetLevel() {return level;}
+    /** \return the name of the analyzer */
+    const std::string& GetName() const {return name;}
+
+    /** \return true if the analyzer declared the trace fields that it reads
+     * and writes (see DeclareFields). A declaration made by a base class
+     * does not hold for the classes derived from it. */
+    bool HasDeclaredFields(void) const {
+        return(fieldsDeclared != NULL && *fieldsDeclared == typeid(*this));
+    }
+    /** \return the trace fields read by the analyzer */
+    const std::set<std::string>& GetConsumedFields() const {
+        return consumedFields;
+    }
+    /** \return the trace fields written by the analyzer */
+    const std::set<std::string>& GetProducedFields() const {
+        return producedFields;
+    }
 protected:
+    /** Declare the trace fields that the analyzer reads and writes, with the
+     * names used by EventProcessor::DeclareTraceFields. The DetectorDriver
+     * only runs the analyzer on the types for which a processor, or a later
+     * analyzer, reads one of the fields that it writes. An analyzer which
+     * makes no declaration, for instance because it fills histograms, is
+     * always run. Call from the constructor of the analyzer.
+     * \param [in] consumes : the trace fields that are read
+     * \param [in] produces : the trace fields that are written */
+    void DeclareFields(const std::set<std::string> &consumes,
+                       const std::set<std::string> &produces) {
+        consumedFields = consumes;
+        producedFields = produces;
+        fieldsDeclared = &typeid(*this);
+    }
+
     int level;                ///< the level of analysis to proceed with
     static int numTracesAnalyzed;    ///< rownumber for DAMM spectrum 850
     std::string name;         ///< name of the analyzer
-private:
-    tms tmsBegin;             ///< time at which the analyzer began
-    double userTime;          ///< user time used by this class
-    double systemTime;        ///< system time used by this class
-    double clocksPerSecond;   ///< frequency of system clock
+    std::set<std::string> consumedFields; ///< trace fields read
+    std::set<std::string> producedFields; ///< trace fields written
+    const std::type_info *fieldsDeclared; ///< class which declared the fields
 };
 #endif // __TRACEANALYZER_HPP_
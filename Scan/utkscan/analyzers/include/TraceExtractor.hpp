@@ -6,6 +6,7 @@
  */
 #ifndef __TRACEEXTRACTOR_HPP_
 #define __TRACEEXTRACTOR_HPP_
+#include <chrono>
 #include <string>
 
 #include "TraceAnalyzer.hpp"
@@ -16,14 +17,23 @@
 class TraceExtractor : public TraceAnalyzer {
 public:
     /** Default Constructor */
-    TraceExtractor(){};
+    TraceExtractor() : every_(1), rate_(0), onlyPileup_(false),
+                       onlySaturated_(false), numMatched_(0),
+                       numInSecond_(0) {};
 
     /** Constructor taking the type and subtype to plot
     * \param [in] aType : a type to plot the traces for
     * \param [in] aSubtype : a subtype to plot the traces for 
-    * \param [in] aTag : the tag for what we want to plot */
+    * \param [in] aTag : the tag for what we want to plot
+    * \param [in] every : only every Nth matching trace is plotted
+    * \param [in] rate : the most traces plotted per second (of wall clock
+    *  time), no limit if zero
+    * \param [in] only : a comma separated list of the flags of which a trace
+    *  needs one to be plotted, "pileup" (more than one trigger found by the
+    *  TraceFilterAnalyzer) or "saturated", any trace is plotted if empty */
     TraceExtractor(const std::string &aType, const std::string &aSubtype,
-		   const std::string &aTag = "");
+		   const std::string &aTag = "", unsigned int every = 1,
+                   double rate = 0, const std::string &only = "");
 
     /** Default Destructor */
     ~TraceExtractor() {};
@@ -46,5 +56,19 @@ protected:
     std::string type; //!< the detector type
     std::string subtype; //!< The detector subtype
     std::string tag; //!< The tags for the detector
+
+private:
+    /** \return true if a matching trace is to be plotted, according to the
+    * flags, every and rate
+    * \param [in] trace : the matching trace */
+    bool Sample(const Trace &trace);
+
+    unsigned int every_; //!< Only every Nth matching trace is plotted
+    double rate_; //!< The most traces plotted per second, no limit if zero
+    bool onlyPileup_; //!< Plot the traces which piled up
+    bool onlySaturated_; //!< Plot the traces which saturated
+    unsigned long long numMatched_; //!< The traces which passed the flags
+    std::chrono::steady_clock::time_point second_; //!< Start of the current second of the rate
+    unsigned int numInSecond_; //!< The traces plotted in the current second
 };
 #endif // __TRACEEXTRACTOR_HPP_
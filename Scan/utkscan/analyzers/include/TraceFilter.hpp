@@ -75,6 +75,9 @@ public:
 
     /** \return The trigger filter */
     std::vector<double> GetTriggerFilter(void) {return(trigFilter_);}
+    /** \return The energy filter over the whole trace, only calculated if
+     * the energy filter is recursive */
+    std::vector<double> GetEnergyFilter(void) {return(energyFilter_);}
     /** \return The list of energies that were found if we chose to analyze 
      * pileup events. */
     std::vector<double> GetEnergies(void){return(en_);}
@@ -135,17 +138,28 @@ private:
     std::vector<double> en_; //!< the calculated energies
     std::vector<double> coeffs_; //!< the calculated energy coefficients
     std::vector<double> trigFilter_; //!< the calculated trigger filter
+    std::vector<double> energyFilter_; //!< the recursive energy filter
     std::vector<double> esums_; //!< the caluclated energy sums
+    std::vector<long long> runningSum_; //!< sum of the signal before each sample
     
     std::vector<unsigned int> limits_; //!< the limits for the energy filter
     std::vector<unsigned int> trigs_; //!< the identified triggers
 
     void CalcBaseline(void); //!< calculates the baseline
+    void CalcRunningSum(void); //!< calculates the running sum of the signal
     void CalcEnergyFilterCoeffs(void); //!< calculates energy filter coeffs
     void CalcEnergyFilterLimits(const unsigned int &tpos); //!< calc energy filter limits
     void CalcEnergyFilter(void); //!< calculate the energy filter
+    void CalcRecursiveEnergyFilter(void); //!< calc the recursive energy filter
     void CalcTriggerFilter(void); //!< calculate trigger filter
     void ConvertToClockticks(void); //!< convert from ns to clockticks
     void Reset(void); //!< Reset values for repeated calls. 
+
+    /** \return the sum of the signal over the samples [low, high)
+     * \param [in] low : the first sample of the sum
+     * \param [in] high : one past the last sample of the sum */
+    double Sum(const unsigned int &low, const unsigned int &high) const {
+        return(runningSum_[high] - runningSum_[low]);
+    }
 };
 #endif //__TRACEFILTER_HPP__
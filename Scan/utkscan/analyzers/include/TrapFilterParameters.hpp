@@ -26,13 +26,16 @@
 class TrapFilterParameters {
 public:
     //!Default Constructor
-    TrapFilterParameters(){};
+    TrapFilterParameters(){isRecursive_ = false;};
     //!Constructor accepting risetime, flattop, and tau/threshold parameters
-    //!in units of nanoseconds.
-    TrapFilterParameters(const double &l, const double &g, const double &t){
+    //!in units of nanoseconds, and whether the filter is calculated with the
+    //!recursive (IIR) trapezoid over the whole trace.
+    TrapFilterParameters(const double &l, const double &g, const double &t,
+                         const bool &isRecursive = false){
         l_ = l;
         g_ = g;
         t_ = t;
+        isRecursive_ = isRecursive;
     };
     //!Default Destructor
     ~TrapFilterParameters(){};
@@ -45,6 +48,8 @@ public:
     double GetT(void){return(t_);}
     //! Returns the size of the filter
     double GetSize(void) {return(2*l_+g_);}
+    //! Returns true if the filter is calculated recursively
+    bool IsRecursive(void) {return(isRecursive_);}
 
     //! Sets the value of the flattop
     void SetFlattop(const double &a){g_ = a;}
@@ -52,7 +57,10 @@ public:
     void SetRisetime(const double &a){l_ = a;}
     //! Sets the value of tau/threhsold
     void SetT(const double &a){t_ = a;}
+    //! Sets if the filter is calculated recursively
+    void SetRecursive(const bool &a){isRecursive_ = a;}
 private:
+    bool isRecursive_; //!< true if the filter is calculated recursively
     double g_;  //!< the flattop of the filer
     double l_;   //!< the risetime for the filter
     double t_;  //!< the tau/threhsold for the filter
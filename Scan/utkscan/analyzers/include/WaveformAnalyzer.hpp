@@ -31,6 +31,11 @@ public:
                          const std::string &subtype,
                          const std::map<std::string, int> &tags);
 
+    /** Do the analysis on all of the traces of an event, looking up the
+    * waveform range once for each detector type
+    * \param [in] hits : the traces of the event */
+    virtual void Analyze(std::vector<Hit> &hits);
+
 private:
 
     double mean_; //!< The mean of the baseline
@@ -41,19 +46,39 @@ private:
 //!< range
     Trace::iterator bhi_; //!< high value for baseline calculation
     Trace *trc_; //!< A pointer to the trace for the class
+    std::vector<double> waveform_; //!< Buffer for the waveform of the trace
+
+    /** Find the waveform in a single trace and calculate its sums
+    * \param [in] trace : the trace to analyze
+    * \param [in] tags : the map of the tags for the channel
+    * \param [in] range : the waveform range for the detector */
+    void AnalyzeWaveform(Trace &trace, const std::map<std::string, int> &tags,
+                         const std::pair<unsigned int, unsigned int> &range);
 
+    /** \return the waveform range for a detector
+    * \param [in] type : the detector type
+    * \param [in] subtype : detector subtype
+    * \param [in] isTiming : true if the channel has the timing tag */
+    std::pair<unsigned int, unsigned int> GetRange(
+            const std::string &type, const std::string &subtype,
+            const bool &isTiming) const;
 
-    /** Performs the baseline calculation
-    * \param [in] lo : the low range for the baseline calculation
-    * \param [in] numBins : The number of bins for the baseline calculation
-    * \return The average value of the baseline in the region */
-    void CalculateSums();
+    /** Calculates the baseline and its standard deviation, the QDCs, the
+    * waveform and, if requested, the neutron-gamma discrimination. Each sum
+    * is a branch free loop over its own range of the raw integer samples,
+    * which the compiler vectorizes, and the baseline is subtracted from the
+    * sums at the end.
+    * \param [in] psd : true if the discrimination should be calculated */
+    void CalculateSums(const bool &psd);
 
-    /** Performs the neutron-gamma discrimination on the traces
-    * \param [in] lo : The low range for the discrimination (referenced from max)
-    * \param [in] numBins : the number of bins to calculate the baseline over
-    * \return The discrimination value */
-    void CalculateDiscrimination(const unsigned int &lo);
+    /** Insert the discrimination, the baseline subtracted sum of the tail
+    * of the waveform, into the trace
+    * \param [in] discrimSum : the raw sum of the tail
+    * \param [in] dlo : the first sample of the tail
+    * \param [in] whi : the end of the waveform range
+    * \param [in] size : the size of the trace */
+    void InsertDiscrimination(const long long &discrimSum, const long long &dlo,
+                              const long long &whi, const long long &size);
 
     /** Calculate information for the maximum value of the trace
     * \param [in] lo : the low side of the waveform
@@ -2,10 +2,15 @@
  * \brief Uses a Digital CFD to obtain waveform phases
  *
  * This code will obtain the phase of a waveform using a digital CFD.
- * Currently the only method is a polynomial fit to the crossing point.
+ * The default method is a linear fit to the CFD waveform before its maximum.
  * For 100-250 MHz systems, this is not going to produce good timing.
  * This code was originally written by S. Padgett.
  *
+ * The "poly" method runs the CFD in integer arithmetic over the raw trace
+ * and stops at the first zero crossing after the threshold, which is then
+ * interpolated with a cubic polynomial. It calculates its own baseline, so
+ * it does not need the WaveformAnalyzer.
+ *
  * \author S. V. Paulauskas
  * \date 22 July 2011
  */
@@ -15,31 +20,133 @@
 #include <string>
 #include <vector>
 
+#include <cmath>
+
 #include "CfdAnalyzer.hpp"
 
 using namespace std;
 
+namespace {
+    /// The denominator of the fraction of the streaming CFD
+    const long long kFracDen = 256;
+    /// Number of samples at the start of the trace used for the baseline
+    const unsigned int kBaselineSamples = 10;
+
+    /** \return the root in [0, 1] of the cubic polynomial through four
+     * values at x = -1, 0, 1, 2, where the values at 0 and 1 have opposite
+     * signs. The root of the line between them is refined with a few
+     * Newton steps.
+     * \param [in] y : the four values */
+    double CubicCrossing(const double y[4]) {
+        //Coefficients of c0 + c1 x + c2 x^2 + c3 x^3 from the Lagrange form
+        double c0 = y[1];
+        double c1 = -y[0]/3. - y[1]/2. + y[2] - y[3]/6.;
+        double c2 = y[0]/2. - y[1] + y[2]/2.;
+        double c3 = -y[0]/6. + y[1]/2. - y[2]/2. + y[3]/6.;
+
+        double x = y[1] / (y[1] - y[2]);
+        for(unsigned int i = 0; i < 3; i++) {
+            double f = c0 + x*(c1 + x*(c2 + x*c3));
+            double df = c1 + x*(2*c2 + x*3*c3);
+            if(df == 0)
+                break;
+            x -= f / df;
+        }
+        //Fall back to the line if the cubic went astray
+        if(!(x >= 0 && x <= 1))
+            x = y[1] / (y[1] - y[2]);
+        return(x);
+    }
+}
+
 CfdAnalyzer::CfdAnalyzer() : TraceAnalyzer() {
     name = "CfdAnalyzer";
+    isPoly_ = false;
+    fraction_ = 0.25;
+    delay_ = 2;
+    threshold_ = 0;
+    fracNum_ = llround(fraction_ * kFracDen);
+    DeclareFields({"baseline", "maxpos", "saturation"}, {"phase"});
+}
+
+CfdAnalyzer::CfdAnalyzer(const std::string &type, const double &fraction,
+                         const unsigned int &delay,
+                         const unsigned int &threshold) : TraceAnalyzer() {
+    name = "CfdAnalyzer";
+    isPoly_ = type == "poly";
+    fraction_ = fraction;
+    delay_ = delay;
+    threshold_ = threshold;
+    fracNum_ = llround(fraction_ * kFracDen);
+    DeclareFields({"baseline", "maxpos", "saturation"}, {"phase"});
 }
 
 void CfdAnalyzer::Analyze(Trace &trace, const std::string &detType,
                           const std::string &detSubtype,
                           const std::map<std::string, int> & tagMap) {
     TraceAnalyzer::Analyze(trace, detType, detSubtype, tagMap);
-    Globals *globals = Globals::get();
-    unsigned int saturation = (unsigned int)trace.GetValue("saturation");
+    unsigned int saturation = (unsigned int)trace.GetValue(Trace::SATURATION);
     if(saturation > 0) {
             EndAnalyze();
             return;
     }
-    double aveBaseline = trace.GetValue("baseline");
-    unsigned int maxPos = (unsigned int)trace.GetValue("maxpos");
+
+    if(isPoly_)
+        AnalyzeStreaming(trace);
+    else
+        AnalyzeWaveform(trace);
+    EndAnalyze();
+}
+
+void CfdAnalyzer::AnalyzeStreaming(Trace &trace) {
+    const unsigned int size = trace.size();
+    const unsigned int first = max(kBaselineSamples, delay_ + 2);
+    if(size < first + 2)
+        return;
+
+    //Everything is kept scaled by the number of baseline samples and the
+    // denominator of the fraction, so that it stays in integers
+    const long long num = kBaselineSamples;
+    long long baseSum = 0;
+    for(unsigned int i = 0; i < kBaselineSamples; i++)
+        baseSum += trace[i];
+    const long long armLevel = (long long)threshold_ * num;
+
+    //The CFD is the delayed signal minus the fraction of the prompt one :
+    // cfd(i) = kFracDen * (x[i-D] - b) - fracNum_ * (x[i] - b)
+    const Trace::Sample *x = &trace[0];
+    bool isArmed = false;
+    long long prev = 0;
+    for(unsigned int i = first; i < size; i++) {
+        long long prompt = num * x[i] - baseSum;
+        long long delayed = num * x[i-delay_] - baseSum;
+        long long cfd = kFracDen * delayed - fracNum_ * prompt;
+
+        if(!isArmed) {
+            isArmed = prompt > armLevel && cfd < 0;
+        } else if(prev < 0 && cfd >= 0) {
+            double y[4];
+            for(int k = 0; k < 4; k++) {
+                unsigned int j = min(i - 2 + k, size - 1);
+                y[k] = (double)(kFracDen * (num * x[j-delay_] - baseSum) -
+                                fracNum_ * (num * x[j] - baseSum));
+            }
+            trace.InsertValue(Trace::PHASE, i - 1 + CubicCrossing(y));
+            return;
+        }
+        prev = cfd;
+    }
+}
+
+void CfdAnalyzer::AnalyzeWaveform(Trace &trace) {
+    Globals *globals = Globals::get();
+    double aveBaseline = trace.GetValue(Trace::BASELINE);
+    unsigned int maxPos = (unsigned int)trace.GetValue(Trace::MAXPOS);
     pair<unsigned int, unsigned int> range = globals->waveformRange("default");
     unsigned int waveformLow  = range.first;
     unsigned int waveformHigh = range.second;
-    unsigned int delay = 2;
-    double fraction = 0.25;
+    unsigned int delay = delay_;
+    double fraction = fraction_;
     vector<double> cfd;
     Trace::iterator cfdStart = trace.begin();
     advance(cfdStart, (int)(maxPos - waveformLow - 2));
@@ -74,6 +181,5 @@ void CfdAnalyzer::Analyze(Trace &trace, const std::string &detType,
         (1/deltaPrime)*(sumXSq*sumY - sumX*sumXY);
     double slope =
         (1/deltaPrime)*(num*sumXY - sumX*sumY);
-    trace.InsertValue("phase", (-intercept/slope)+maxPos);
-    EndAnalyze();
+    trace.InsertValue(Trace::PHASE, (-intercept/slope)+maxPos);
 }
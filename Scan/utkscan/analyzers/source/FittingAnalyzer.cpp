@@ -5,6 +5,8 @@
  * implemented through the GSL libraries. We have now set up two different
  * functions for this processor. One of them handles the fast SiPMT signals,
  * which tend to be more Gaussian in shape than the standard PMT signals.
+ * The type "template" selects the TemplateFitter, which fits the same
+ * functions from a table with a few linearized steps, and does not need GSL.
  *
  * \author S. V. Paulauskas
  * \date 22 July 2011
@@ -19,7 +21,11 @@
 #include "DammPlotIds.hpp"
 #include "FitDriver.hpp"
 #include "FittingAnalyzer.hpp"
+#include "TemplateFitter.hpp"
+
+#ifdef usegsl
 #include "GslFitter.hpp"
+#endif
 
 using namespace std;
 using namespace dammIds::trace::waveformanalyzer;
@@ -35,11 +41,43 @@ void FittingAnalyzer::DeclarePlots(void) {
 
 FittingAnalyzer::FittingAnalyzer(const std::string &s) {
     name = "FittingAnalyzer";
+    DeclareFields({"maxpos", "maxval", "qdc", "saturation", "sigmaBaseline",
+                   "waveform"}, {"phase"});
     if(s == "GSL" || s == "gsl") {
         fitterType_ = FitDriver::GSL;
+    } else if(s == "TEMPLATE" || s == "template") {
+        fitterType_ = FitDriver::TEMPLATE;
     } else {
         fitterType_ = FitDriver::UNKNOWN;
     }
+
+    //The fitters are kept for the whole run so that they can reuse their
+    // workspaces from one trace to the next
+    switch(fitterType_) {
+#ifdef usegsl
+        case FitDriver::GSL:
+            pmtDriver_ = new GslFitter(false);
+            siPmtDriver_ = new GslFitter(true);
+            break;
+#endif
+        case FitDriver::TEMPLATE:
+            pmtDriver_ = new TemplateFitter(false);
+            siPmtDriver_ = new TemplateFitter(true);
+            break;
+        case FitDriver::UNKNOWN:
+        default:
+            pmtDriver_ = siPmtDriver_ = NULL;
+            break;
+    }
+
+    if(!pmtDriver_)
+        cerr << "FittingAnalyzer : The fitter type \"" << s << "\" is not "
+             << "available, no waveforms will be fit." << endl;
+}
+
+FittingAnalyzer::~FittingAnalyzer() {
+    delete(pmtDriver_);
+    delete(siPmtDriver_);
 }
 
 void FittingAnalyzer::Analyze(Trace &trace, const std::string &detType,
@@ -47,7 +85,41 @@ void FittingAnalyzer::Analyze(Trace &trace, const std::string &detType,
                               const std::map<std::string, int> & tagMap) {
     TraceAnalyzer::Analyze(trace, detType, detSubtype, tagMap);
 
-    if(trace.HasValue("saturation") || trace.empty() ||
+    Globals *globals = Globals::get();
+    bool isDblBeta = detType == "beta" && detSubtype == "double";
+    bool isDblBetaT = isDblBeta && tagMap.find("timing") != tagMap.end();
+
+    pair<double,double> pars =  globals->fitPars(detType+":"+detSubtype);
+    if(isDblBetaT)
+	    pars = globals->fitPars(detType+":"+detSubtype+":timing");
+
+    FitTrace(trace, isDblBetaT, pars);
+}
+
+void FittingAnalyzer::Analyze(std::vector<Hit> &hits) {
+    Globals *globals = Globals::get();
+    pair<double,double> pars, timingPars;
+    for(vector<Hit>::iterator it = hits.begin(); it != hits.end(); it++) {
+        TraceAnalyzer::Analyze(*it->trace, *it->type, *it->subtype, *it->tags);
+
+        //The hits are sorted by type, so look up the parameters only when
+        // the type or subtype changes
+        if(it == hits.begin() || *it->type != *(it-1)->type ||
+           *it->subtype != *(it-1)->subtype) {
+            string key = *it->type + ":" + *it->subtype;
+            pars = globals->fitPars(key);
+            timingPars = globals->fitPars(key + ":timing");
+        }
+
+        bool isDblBetaT = *it->type == "beta" && *it->subtype == "double" &&
+            it->tags->find("timing") != it->tags->end();
+        FitTrace(*it->trace, isDblBetaT, isDblBetaT ? timingPars : pars);
+    }
+}
+
+void FittingAnalyzer::FitTrace(Trace &trace, const bool &isDblBetaT,
+                               const std::pair<double,double> &pars) {
+    if(trace.HasValue(Trace::SATURATION) || trace.empty() ||
        trace.GetWaveform().size() == 0) {
      	EndAnalyze();
      	return;
@@ -55,13 +127,11 @@ void FittingAnalyzer::Analyze(Trace &trace, const std::string &detType,
 
     Globals *globals = Globals::get();
 
-    const double sigmaBaseline = trace.GetValue("sigmaBaseline");
-    const double maxVal = trace.GetValue("maxval");
-    const double qdc = trace.GetValue("qdc");
-    const double maxPos = trace.GetValue("maxpos");
-    const vector<double> waveform = trace.GetWaveform();
-    bool isDblBeta = detType == "beta" && detSubtype == "double";
-    bool isDblBetaT = isDblBeta && tagMap.find("timing") != tagMap.end();
+    const double sigmaBaseline = trace.GetValue(Trace::SIGMA_BASELINE);
+    const double maxVal = trace.GetValue(Trace::MAXVAL);
+    const double qdc = trace.GetValue(Trace::QDC);
+    const double maxPos = trace.GetValue(Trace::MAXPOS);
+    const vector<double> &waveform = trace.GetWaveform();
 
     trace.plot(D_SIGMA, sigmaBaseline*100);
 
@@ -77,28 +147,19 @@ void FittingAnalyzer::Analyze(Trace &trace, const std::string &detType,
         }
     }
 
-    pair<double,double> pars =  globals->fitPars(detType+":"+detSubtype);
-    if(isDblBetaT)
-	    pars = globals->fitPars(detType+":"+detSubtype+":timing");
-
-    FitDriver *driver;
-    switch(fitterType_) {
-        case FitDriver::GSL:
-            driver = new GslFitter(isDblBetaT);
-            break;
-        case FitDriver::UNKNOWN:
-        default:
-            EndAnalyze();
-            return;
+    FitDriver *driver = isDblBetaT ? siPmtDriver_ : pmtDriver_;
+    if(!driver) {
+        EndAnalyze();
+        return;
     }
 
     driver->PerformFit(waveform, pars, sigmaBaseline, qdc);
-    trace.InsertValue("phase", driver->GetPhase()+maxPos);
+    trace.InsertValue(Trace::PHASE, driver->GetPhase()+maxPos);
+    trace.InsertValue(Trace::CHISQ_PER_DOF, driver->GetChiSqPerDof());
     
     trace.plot(DD_AMP, driver->GetAmplitude(), maxVal);
     trace.plot(D_PHASE, driver->GetPhase()*1000+100);
     trace.plot(D_CHISQPERDOF, driver->GetChiSqPerDof());
 
-    delete(driver);
     EndAnalyze();
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+/** \file GpuTraceAnalyzer.cpp
+ * \brief Analyzes whole batches of traces on a GPU
+ */
+#include <iostream>
+
+#include "Globals.hpp"
+#include "GpuTraceAnalyzer.hpp"
+
+using namespace std;
+
+GpuTraceAnalyzer::GpuTraceAnalyzer(const unsigned int &minBatch) :
+    TraceAnalyzer() {
+    name = "GpuTraceAnalyzer";
+    minBatch_ = minBatch;
+    warned_ = false;
+    DeclareFields({"saturation"},
+                  {"baseline", "cfdPhase", "maxpos", "maxval", "phase", "qdc",
+                   "sigmaBaseline", "tqdc"});
+}
+
+void GpuTraceAnalyzer::Analyze(Trace &trace, const std::string &detType,
+                               const std::string &detSubtype,
+                               const std::map<std::string, int> & tagMap) {
+    vector<Hit> hits(1);
+    hits[0].trace = &trace;
+    hits[0].type = &detType;
+    hits[0].subtype = &detSubtype;
+    hits[0].tags = &tagMap;
+    Analyze(hits);
+}
+
+void GpuTraceAnalyzer::Analyze(std::vector<Hit> &hits) {
+    Globals *globals = Globals::get();
+    samples_.clear();
+    inputs_.clear();
+    batch_.clear();
+
+    GpuTraceInput input;
+    for(vector<Hit>::iterator it = hits.begin(); it != hits.end(); it++) {
+        TraceAnalyzer::Analyze(*it->trace, *it->type, *it->subtype, *it->tags);
+        Trace &trace = *it->trace;
+        if(trace.HasValue(Trace::SATURATION) || trace.empty())
+            continue;
+
+        //The hits are sorted by type, so look up the parameters only when
+        // the type or subtype changes
+        if(batch_.empty() || *it->type != *batch_.back().type ||
+           *it->subtype != *batch_.back().subtype) {
+            string key = *it->type + ":" + *it->subtype;
+            pair<unsigned int, unsigned int> range =
+                globals->waveformRange(key);
+            pair<double, double> pars = globals->fitPars(key);
+            input.low = range.first;
+            input.high = range.second;
+            input.beta = pars.first;
+            input.gamma = pars.second;
+        }
+        input.offset = samples_.size();
+        input.size = trace.size();
+        samples_.insert(samples_.end(), trace.begin(), trace.end());
+        inputs_.push_back(input);
+        batch_.push_back(*it);
+    }
+
+    const size_t num = inputs_.size();
+    if(num == 0) {
+        EndAnalyze();
+        return;
+    }
+    results_.resize(num);
+
+    bool onDevice = false;
+#ifdef usecuda
+    if(num >= minBatch_)
+        onDevice = GpuAnalyzeTraces(&samples_[0], samples_.size(),
+                                    &inputs_[0], &results_[0], num);
+    if(!onDevice && num >= minBatch_ && !warned_) {
+        cerr << "GpuTraceAnalyzer : No CUDA device could be used, the traces "
+             << "will be analyzed on the host." << endl;
+        warned_ = true;
+    }
+#endif
+    if(!onDevice)
+        for(size_t i = 0; i < num; i++)
+            GpuAnalyzeTrace(&samples_[0], inputs_[i], results_[i]);
+
+    for(size_t i = 0; i < num; i++) {
+        const GpuTraceResult &res = results_[i];
+        Trace &trace = *batch_[i].trace;
+        if(res.status != 0)
+            continue;
+        trace.InsertValue(Trace::MAXPOS, res.maxpos);
+        trace.InsertValue(Trace::TQDC, res.tqdc);
+        trace.InsertValue(Trace::QDC, res.qdc);
+        trace.SetValue(Trace::BASELINE, res.baseline);
+        trace.SetValue(Trace::SIGMA_BASELINE, res.sigmaBaseline);
+        trace.SetValue(Trace::MAXVAL, res.maxval);
+        trace.SetValue("cfdPhase", res.cfdPhase);
+        trace.InsertValue(Trace::PHASE, res.phase + res.maxpos);
+    }
+    EndAnalyze();
+}
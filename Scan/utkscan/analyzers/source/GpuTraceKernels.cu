@@ -0,0 +1,77 @@
+/// \file GpuTraceKernels.cu
+/// \brief The CUDA kernel and device memory handling for the trace analysis
+#include <cuda_runtime.h>
+
+#include "GpuTraceKernels.hpp"
+
+namespace {
+    /// Number of threads in each block of the kernel
+    const unsigned int kThreadsPerBlock = 128;
+
+    unsigned short *devSamples = NULL;///< samples of the batch on the device
+    size_t devSamplesSize = 0;///< capacity of devSamples
+    GpuTraceInput *devInputs = NULL;///< trace descriptions on the device
+    size_t devInputsSize = 0;///< capacity of devInputs
+    GpuTraceResult *devResults = NULL;///< results on the device
+    size_t devResultsSize = 0;///< capacity of devResults
+
+    /// Analyzes one trace per thread
+    __global__ void AnalyzeKernel(const unsigned short *samples,
+                                  const GpuTraceInput *inputs,
+                                  GpuTraceResult *results,
+                                  size_t numTraces) {
+        size_t i = blockIdx.x * blockDim.x + threadIdx.x;
+        if(i < numTraces)
+            GpuAnalyzeTrace(samples, inputs[i], results[i]);
+    }
+
+    /// Grows a device buffer to hold at least the requested number of
+    /// elements
+    template<typename T>
+    bool Reserve(T *&buffer, size_t &capacity, const size_t &size) {
+        if(size <= capacity)
+            return(true);
+        cudaFree(buffer);
+        buffer = NULL;
+        capacity = 0;
+        size_t grown = size + size / 2;
+        if(cudaMalloc((void**)&buffer, grown * sizeof(T)) != cudaSuccess)
+            return(false);
+        capacity = grown;
+        return(true);
+    }
+}
+
+bool GpuAnalyzeTraces(const unsigned short *samples,
+                      const size_t &numSamples,
+                      const GpuTraceInput *inputs, GpuTraceResult *results,
+                      const size_t &numTraces) {
+    static bool hasDevice = true;
+    if(!hasDevice)
+        return(false);
+    if(numTraces == 0)
+        return(true);
+
+    if(!Reserve(devSamples, devSamplesSize, numSamples) ||
+       !Reserve(devInputs, devInputsSize, numTraces) ||
+       !Reserve(devResults, devResultsSize, numTraces)) {
+        hasDevice = false;
+        return(false);
+    }
+
+    cudaMemcpy(devSamples, samples, numSamples * sizeof(unsigned short),
+               cudaMemcpyHostToDevice);
+    cudaMemcpy(devInputs, inputs, numTraces * sizeof(GpuTraceInput),
+               cudaMemcpyHostToDevice);
+
+    unsigned int blocks = (numTraces + kThreadsPerBlock - 1) / kThreadsPerBlock;
+    AnalyzeKernel<<<blocks, kThreadsPerBlock>>>(devSamples, devInputs,
+                                                devResults, numTraces);
+
+    if(cudaMemcpy(results, devResults, numTraces * sizeof(GpuTraceResult),
+                  cudaMemcpyDeviceToHost) != cudaSuccess) {
+        hasDevice = false;
+        return(false);
+    }
+    return(true);
+}
@@ -55,6 +55,31 @@ int SiPmtFunctionDerivative(const gsl_vector *x, void *FitData, gsl_vector *f,
 
 using namespace std;
 
+GslFitter::~GslFitter() {
+    for(map<size_t, Workspace>::iterator it = workspaces_.begin();
+        it != workspaces_.end(); it++) {
+        gsl_multifit_fdfsolver_free(it->second.solver);
+        gsl_matrix_free(it->second.covar);
+    }
+}
+
+GslFitter::Workspace &GslFitter::GetWorkspace(const size_t &n,
+                                              const size_t &p) {
+    map<size_t, Workspace>::iterator it = workspaces_.find(n);
+    if(it != workspaces_.end())
+        return(it->second);
+
+    //The GSL v1 solver keeps its own Jacobian in s->J
+    Workspace &ws = workspaces_[n];
+    ws.solver = gsl_multifit_fdfsolver_alloc(gsl_multifit_fdfsolver_lmsder,
+                                             n, p);
+    ws.jac = NULL;
+    ws.covar = gsl_matrix_alloc(p, p);
+    ws.y.resize(n);
+    ws.weights.resize(n);
+    return(ws);
+}
+
 void GslFitter::PerformFit(const std::vector<double> &data,
                             const std::pair<double, double> &pars,
                             const double &weight/* = 1.*/,
@@ -62,10 +87,12 @@ void GslFitter::PerformFit(const std::vector<double> &data,
     gsl_multifit_function_fdf f;
     int status;
     const size_t sizeFit = data.size();
-    size_t numParams;
     double xInit[3];
 
-    double y[sizeFit], sigma[sizeFit];
+    size_t numParams = isFastSipm_ ? 1 : 2;
+    Workspace &ws = GetWorkspace(sizeFit, numParams);
+    double *y = &ws.y[0];
+    double *sigma = &ws.weights[0];
     for(unsigned int i = 0; i < sizeFit; i++) {
         y[i] = data.at(i);
         sigma[i] = weight;
@@ -78,14 +105,12 @@ void GslFitter::PerformFit(const std::vector<double> &data,
     f.params = &fitData;
 
     if(!isFastSipm_) {
-        numParams = 2;
         xInit[0] = 0.0;
         xInit[1] = 2.5;
         f.f = &PmtFunction;
         f.df = &CalcPmtJacobian;
         f.fdf = &PmtFunctionDerivative;
     } else {
-        numParams = 1;
         xInit[0] = (double)data.size()*0.5;
         f.f = &SiPmtFunction;
         f.df = &CalcSiPmtJacobian;
@@ -93,10 +118,8 @@ void GslFitter::PerformFit(const std::vector<double> &data,
     }
     dof_ = sizeFit - numParams;
 
-    const gsl_multifit_fdfsolver_type *T = gsl_multifit_fdfsolver_lmsder;
     gsl_vector_view x = gsl_vector_view_array (xInit, numParams);
-    gsl_multifit_fdfsolver *s = gsl_multifit_fdfsolver_alloc (T, sizeFit, numParams);
-    gsl_matrix *covar = gsl_matrix_alloc (numParams, numParams);
+    gsl_multifit_fdfsolver *s = ws.solver;
     f.p = numParams;
     gsl_multifit_fdfsolver_set (s, &f, &x.vector);
 
@@ -109,7 +132,7 @@ void GslFitter::PerformFit(const std::vector<double> &data,
             break;
     }
 
-    gsl_multifit_covar (s->J, 0.0, covar);
+    gsl_multifit_covar (s->J, 0.0, ws.covar);
     chi_ = gsl_blas_dnrm2(s->f);
 
     if(!isFastSipm_) {
@@ -119,9 +142,6 @@ void GslFitter::PerformFit(const std::vector<double> &data,
         phase_ = gsl_vector_get(s->x,0);
         amp_ = 0.0;
     }
-
-    gsl_multifit_fdfsolver_free (s);
-    gsl_matrix_free (covar);
 }
 
 int PmtFunction (const gsl_vector * x, void *FitData, gsl_vector * f) {
@@ -38,6 +38,31 @@ int CalcSiPmtJacobian(const gsl_vector *x, void *FitData, gsl_matrix *J);
 
 using namespace std;
 
+GslFitter::~GslFitter() {
+    for(map<size_t, Workspace>::iterator it = workspaces_.begin();
+        it != workspaces_.end(); it++) {
+        gsl_multifit_fdfsolver_free(it->second.solver);
+        gsl_matrix_free(it->second.jac);
+        gsl_matrix_free(it->second.covar);
+    }
+}
+
+GslFitter::Workspace &GslFitter::GetWorkspace(const size_t &n,
+                                              const size_t &p) {
+    map<size_t, Workspace>::iterator it = workspaces_.find(n);
+    if(it != workspaces_.end())
+        return(it->second);
+
+    Workspace &ws = workspaces_[n];
+    ws.solver = gsl_multifit_fdfsolver_alloc(gsl_multifit_fdfsolver_lmsder,
+                                             n, p);
+    ws.jac = gsl_matrix_alloc(n, p);
+    ws.covar = gsl_matrix_alloc(p, p);
+    ws.y.resize(n);
+    ws.weights.resize(n);
+    return(ws);
+}
+
 void GslFitter::PerformFit(const std::vector<double> &data,
                             const std::pair<double, double> &pars,
                             const double &weight/* = 1.*/,
@@ -65,11 +90,10 @@ void GslFitter::PerformFit(const std::vector<double> &data,
 
     dof_ = n - p;
 
-    const gsl_multifit_fdfsolver_type *T = gsl_multifit_fdfsolver_lmsder;
-    gsl_multifit_fdfsolver *s = gsl_multifit_fdfsolver_alloc(T, n, p);
-    gsl_matrix *jac=gsl_matrix_alloc(n,p);
-    gsl_matrix *covar = gsl_matrix_alloc (p,p);
-    double y[n], weights[n];
+    Workspace &ws = GetWorkspace(n, p);
+    gsl_multifit_fdfsolver *s = ws.solver;
+    double *y = &ws.y[0];
+    double *weights = &ws.weights[0];
     struct FitDriver::FitData fitData = {n, y, weights, pars.first,
                                          pars.second, area};
     gsl_vector_view x = gsl_vector_view_array (xInit,p);
@@ -90,8 +114,8 @@ void GslFitter::PerformFit(const std::vector<double> &data,
 
     gsl_multifit_fdfsolver_wset (s, &f, &x.vector, &w.vector);
     gsl_multifit_fdfsolver_driver(s, 1000, xtol, gtol, ftol, &info);
-    gsl_multifit_fdfsolver_jac(s,jac);
-    gsl_multifit_covar (jac, 0.0, covar);
+    gsl_multifit_fdfsolver_jac(s, ws.jac);
+    gsl_multifit_covar (ws.jac, 0.0, ws.covar);
 
     gsl_vector *res_f = gsl_multifit_fdfsolver_residual(s);
     chi_ = gsl_blas_dnrm2(res_f);
@@ -103,10 +127,6 @@ void GslFitter::PerformFit(const std::vector<double> &data,
         phase_ = gsl_vector_get(s->x,0);
         amp_ = 0.0;
     }
-
-    gsl_multifit_fdfsolver_free (s);
-    gsl_matrix_free (covar);
-    gsl_matrix_free(jac);
 }
 
 int PmtFunction (const gsl_vector * x, void *FitData, gsl_vector * f) {
@@ -2,6 +2,8 @@
  * \brief Implements the determination of the decay constants for a trace
  */
 #include <algorithm>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <string>
@@ -19,11 +21,115 @@ using namespace dammIds::trace;
 TauAnalyzer::TauAnalyzer() {
     name="tau";
     type=subtype="";
+    DeclareFields({"filterEnergy2"}, {"tau"});
 }
 
 TauAnalyzer::TauAnalyzer(const std::string &aType, const std::string &aSubtype) :
   TraceAnalyzer(), type(aType), subtype(aSubtype) {
     name="tau";
+    DeclareFields({"filterEnergy2"}, {"tau"});
+}
+
+TauAnalyzer::TauAnalyzer(const std::string &survey) :
+    TraceAnalyzer(), surveyFile_(survey) {
+    name="tau";
+    type=subtype="";
+    //! Nothing reads the survey from the traces, so the fields are only
+    //! declared without it, otherwise the analyzer would be skipped
+    if (surveyFile_.empty())
+        DeclareFields({"filterEnergy2"}, {"tau"});
+}
+
+TauAnalyzer::~TauAnalyzer() {
+    if (!surveyFile_.empty())
+        WriteSurvey();
+}
+
+void TauAnalyzer::Analyze(std::vector<Hit> &hits) {
+    for (vector<Hit>::iterator it = hits.begin(); it != hits.end(); it++) {
+        Analyze(*it->trace, *it->type, *it->subtype, *it->tags);
+        if (surveyFile_.empty() || it->index < 0 ||
+            it->trace->HasValue("filterEnergy2"))
+            continue;
+
+        double sxy, sxx;
+        if (!FitTail(*it->trace, sxy, sxx))
+            continue;
+        if (it->index >= (int)survey_.size()) {
+            Survey empty = {0, 0, 0};
+            survey_.resize(it->index + 1, empty);
+        }
+        Survey &survey = survey_[it->index];
+        survey.traces++;
+        survey.sxy += sxy;
+        survey.sxx += sxx;
+    }
+}
+
+bool TauAnalyzer::FitTail(const Trace &trace, double &sxy, double &sxx) {
+    const size_t size = trace.size();
+    const size_t maxpos = max_element(trace.begin(), trace.end()) -
+        trace.begin();
+    if (maxpos < 4 || size - maxpos < 20)
+        return false;
+
+    double baseline = 0;
+    if (trace.HasValue(Trace::BASELINE))
+        baseline = trace.GetValue(Trace::BASELINE);
+    else {
+        for (size_t i = 0; i < maxpos / 2; i++)
+            baseline += trace[i];
+        baseline /= maxpos / 2;
+    }
+
+    //! As for the successive integration, the samples near the maximum are
+    //! skipped since the pulse may not be exponential there. The tail ends
+    //! at the first sample which is not above the baseline.
+    const size_t first = maxpos + (size - maxpos) / 10;
+    double sw = 0, sx = 0, sy = 0, sxxw = 0, sxyw = 0;
+    size_t num = 0;
+    for (size_t i = first; i < size; i++, num++) {
+        double y = trace[i] - baseline;
+        if (y <= 0)
+            break;
+        double w = y * y;
+        double t = i - first;
+        double l = log(y);
+        sw += w;
+        sx += w * t;
+        sy += w * l;
+        sxxw += w * t * t;
+        sxyw += w * t * l;
+    }
+    if (num < 3)
+        return false;
+
+    sxy = sxyw - sx * sy / sw;
+    sxx = sxxw - sx * sx / sw;
+    return sxx > 0;
+}
+
+void TauAnalyzer::WriteSurvey() const {
+    string fileName = Globals::get()->outputPath(surveyFile_);
+    ofstream file(fileName.c_str());
+    file << "# Decay constants (TAU, in us) found by the TauAnalyzer" << endl;
+
+    cout << "Tau survey written to " << fileName << endl;
+    cout << "  mod chan   traces  tau (us)" << endl;
+    for (size_t i = 0; i < survey_.size(); i++) {
+        const Survey &survey = survey_[i];
+        if (survey.traces == 0 || survey.sxy >= 0)
+            continue;
+        //! The traces are sampled with the ADC clock
+        double tau = -survey.sxx / survey.sxy *
+            Globals::get()->adcClockInSeconds() * 1e6;
+        int mod = i / pixie::numberOfChannels;
+        int chan = i % pixie::numberOfChannels;
+        file << mod << "\t" << chan << "\tTAU\t" << tau << endl;
+        cout << "  " << setw(3) << mod << " " << setw(4) << chan
+             << " " << setw(8) << survey.traces << " " << fixed
+             << setprecision(3) << setw(9) << tau << endl;
+    }
 }
 
 void TauAnalyzer::Analyze(Trace &trace, const std::string &aType,
@@ -61,7 +167,7 @@ void TauAnalyzer::Analyze(Trace &trace, const std::string &aType,
             i+=1.;
     }
     double tau =  1 / log(sum1 / sum2) * Globals::get()->clockInSeconds();
-    trace.SetValue("tau", tau);
+    trace.SetValue(Trace::TAU, tau);
 
     EndAnalyze();
 }
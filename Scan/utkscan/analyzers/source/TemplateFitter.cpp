@@ -0,0 +1,172 @@
+/// \file TemplateFitter.cpp
+/// \brief A fast fitter that uses a tabulated pulse shape and a linearized
+/// solve instead of a full Levenberg-Marquardt minimization
+#include <algorithm>
+
+#include <cmath>
+
+#include "TemplateFitter.hpp"
+
+using namespace std;
+
+namespace {
+    /// Number of points per sample in the tabulated template
+    const double kResolution = 16.;
+    /// Step of the matched filter scan in samples
+    const double kScanStep = 0.25;
+    /// Earliest start of a PMT pulse before the first sample of the trace
+    const double kMaxLead = 2.;
+    /// Half-width of the scan around the maximum for the SiPMT output
+    const double kSipmWindow = 2.;
+    /// Maximum number of Gauss-Newton steps after the scan
+    const unsigned int kMaxIterations = 5;
+    /// The fit stops once the phase changes by less than this in samples
+    const double kTolerance = 1e-4;
+}
+
+TemplateFitter::TemplateFitter(const bool &isFastSipm) : FitDriver() {
+    isFastSipm_ = isFastSipm;
+    tablePars_ = make_pair(0., 0.);
+    tableSize_ = 0;
+    tableMin_ = 0.;
+    amp_ = chi_ = dof_ = phase_ = 0.;
+}
+
+void TemplateFitter::BuildTemplate(const std::pair<double, double> &pars,
+                                   const size_t &size) {
+    double beta = pars.first;
+    double gamma = pars.second;
+    double tableMax = size + kMaxLead;
+    tableMin_ = isFastSipm_ ? -tableMax : 0.;
+
+    size_t points = (size_t)((tableMax - tableMin_) * kResolution) + 2;
+    shape_.resize(points);
+    slope_.resize(points);
+
+    for(size_t i = 0; i < points; i++) {
+        double u = tableMin_ + i / kResolution;
+        if(!isFastSipm_) {
+            double decay = exp(-beta*u);
+            double gaussSq = exp(-pow(gamma*u,4.));
+            shape_[i] = decay * (1-gaussSq);
+            slope_[i] = -beta*decay*(1-gaussSq) +
+                        4*decay*pow(u,3.)*pow(gamma,4.)*gaussSq;
+        } else {
+            shape_[i] = exp(-u*u/(2*gamma*gamma)) / (gamma*sqrt(2*M_PI));
+            slope_[i] = -u/(gamma*gamma) * shape_[i];
+        }
+    }
+
+    tablePars_ = pars;
+    tableSize_ = size;
+}
+
+double TemplateFitter::Lookup(const double &u, double &deriv) const {
+    double x = (u - tableMin_) * kResolution;
+    if(x < 0 || x >= shape_.size() - 1) {
+        deriv = 0.;
+        return(0.);
+    }
+    size_t i = (size_t)x;
+    double frac = x - i;
+    deriv = slope_[i] + frac * (slope_[i+1] - slope_[i]);
+    return(shape_[i] + frac * (shape_[i+1] - shape_[i]));
+}
+
+double TemplateFitter::Residual(const std::vector<double> &data,
+                                const double &phase, double &amp) const {
+    double deriv;
+    double sumYY = 0., sumYG = 0., sumGG = 0.;
+    for(size_t i = 0; i < data.size(); i++) {
+        double g = Lookup(i - phase, deriv);
+        sumYY += data[i] * data[i];
+        sumYG += data[i] * g;
+        sumGG += g * g;
+    }
+
+    //The amplitude of the SiPMT output is fixed by the QDC
+    if(isFastSipm_)
+        amp = qdc_;
+    else
+        amp = sumGG > 0 ? sumYG / sumGG : 0.;
+    return(sumYY - 2 * amp * sumYG + amp * amp * sumGG);
+}
+
+void TemplateFitter::PerformFit(const std::vector<double> &data,
+                                const std::pair<double, double> &pars,
+                                const double &weight/* = 1.*/,
+                                const double &area/* = 1.*/) {
+    const size_t n = data.size();
+    const size_t p = isFastSipm_ ? 1 : 2;
+    dof_ = n - p;
+    qdc_ = area;
+
+    if(pars != tablePars_ || n != tableSize_)
+        BuildTemplate(pars, n);
+
+    //Matched filter : scan the template over the rise of the trace
+    size_t maxPos = max_element(data.begin(), data.end()) - data.begin();
+    double low = -kMaxLead, high = maxPos;
+    if(isFastSipm_) {
+        low = maxPos - kSipmWindow;
+        high = maxPos + kSipmWindow;
+    }
+
+    double phi = low, amp = 0.;
+    double best = Residual(data, phi, amp);
+    for(double trial = low + kScanStep; trial <= high; trial += kScanStep) {
+        double trialAmp;
+        double res = Residual(data, trial, trialAmp);
+        if(res < best) {
+            best = res;
+            phi = trial;
+            amp = trialAmp;
+        }
+    }
+
+    //Refine with Gauss-Newton steps of the linearized problem
+    for(unsigned int iter = 0; iter < kMaxIterations; iter++) {
+        double saa = 0., sab = 0., sbb = 0., sar = 0., sbr = 0.;
+        for(size_t i = 0; i < n; i++) {
+            double deriv;
+            double g = Lookup(i - phi, deriv);
+            double r = amp * g - data[i];
+            double a = -amp * deriv;
+            saa += a * a;
+            sab += a * g;
+            sbb += g * g;
+            sar += a * r;
+            sbr += g * r;
+        }
+
+        double dphi, damp = 0.;
+        if(isFastSipm_) {
+            if(saa <= 0)
+                break;
+            dphi = -sar / saa;
+        } else {
+            double det = saa * sbb - sab * sab;
+            if(det <= 0)
+                break;
+            dphi = -(sbb * sar - sab * sbr) / det;
+            damp = -(saa * sbr - sab * sar) / det;
+        }
+
+        double trialAmp;
+        double res = Residual(data, phi + dphi, trialAmp);
+        if(res > best)
+            break;
+        best = res;
+        phi += dphi;
+        amp = isFastSipm_ ? trialAmp : amp + damp;
+        if(fabs(dphi) < kTolerance)
+            break;
+    }
+
+    phase_ = phi;
+    chi_ = sqrt(max(best, 0.)) / weight;
+    if(!isFastSipm_)
+        amp_ = qdc_ != 0 ? amp / qdc_ : 0.;
+    else
+        amp_ = 0.0;
+}
@@ -11,8 +11,6 @@
 #include <iostream>
 #include <string>
 
-#include <unistd.h>
-
 #include "DammPlotIds.hpp"
 #include "Trace.hpp"
 #include "TraceAnalyzer.hpp"
@@ -25,24 +23,20 @@ int TraceAnalyzer::numTracesAnalyzed = 0; //!< number of analyzed traces
 
 using namespace dammIds::trace;
 
-TraceAnalyzer::TraceAnalyzer() : userTime(0.), systemTime(0.) {
+TraceAnalyzer::TraceAnalyzer() {
     name = "Trace";
+    fieldsDeclared = NULL;
     // start at -1 so that when incremented on first trace analysis,
     //   row 0 is respectively filled in the trace spectrum of inheritees
     numTracesAnalyzed = -1;
-    clocksPerSecond = sysconf(_SC_CLK_TCK);
 }
 
 TraceAnalyzer::~TraceAnalyzer()
 {
-    cout << name << " analyzer : "
-	 << userTime << " user time, "
-	 << systemTime << " system time" << endl;
 }
 
 void TraceAnalyzer::Analyze(Trace &trace,
 			    const std::string &detType, const std::string &detSubtype) {
-    times(&tmsBegin);
     numTracesAnalyzed++;
     EndAnalyze(trace);
     return;
@@ -52,25 +46,17 @@ void TraceAnalyzer::Analyze(Trace &trace,
 void TraceAnalyzer::Analyze(Trace &trace,
 			    const std::string &detType, const std::string &detSubtype,
                             const std::map<std::string, int> & tagMap) {
-    times(&tmsBegin);
     numTracesAnalyzed++;
     EndAnalyze(trace);
     return;
 }
 
-void TraceAnalyzer::EndAnalyze(Trace &trace) {
-    trace.SetValue("analyzedLevel", level);
-    EndAnalyze();
+void TraceAnalyzer::Analyze(std::vector<Hit> &hits) {
+    for (std::vector<Hit>::iterator it = hits.begin(); it != hits.end(); it++)
+        Analyze(*it->trace, *it->type, *it->subtype, *it->tags);
 }
 
-void TraceAnalyzer::EndAnalyze(void) {
-    tms tmsEnd;
-    times(&tmsEnd);
-
-    userTime += (tmsEnd.tms_utime - tmsBegin.tms_utime) / clocksPerSecond;
-    systemTime += (tmsEnd.tms_stime - tmsBegin.tms_stime) / clocksPerSecond;
-
-    // reset the beginning time so multiple calls of EndAnalyze from
-    //   derived classes work properly
-    times(&tmsBegin);
+void TraceAnalyzer::EndAnalyze(Trace &trace) {
+    trace.SetValue(Trace::ANALYZED_LEVEL, level);
+    EndAnalyze();
 }
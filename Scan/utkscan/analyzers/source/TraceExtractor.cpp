@@ -1,6 +1,7 @@
 /** \file TraceExtractor.cpp
  *  \brief Extract traces for a specific type and subtype
  */
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -16,9 +17,50 @@ const unsigned int TraceExtractor::numTraces = dammIds::trace::extractor::maxSin
 
 TraceExtractor::TraceExtractor(const std::string& aType,
                                const std::string &aSubtype,
-			       const std::string &aTag) :
-    type(aType), subtype(aSubtype), tag(aTag){
+			       const std::string &aTag, unsigned int every,
+                               double rate, const std::string &only) :
+    type(aType), subtype(aSubtype), tag(aTag), every_(max(every, 1u)),
+    rate_(rate), onlyPileup_(false), onlySaturated_(false), numMatched_(0),
+    numInSecond_(0) {
     name = "TraceExtractor";
+
+    stringstream flags(only);
+    string flag;
+    while (getline(flags, flag, ',')) {
+        if (flag == "pileup")
+            onlyPileup_ = true;
+        else if (flag == "saturated")
+            onlySaturated_ = true;
+        else if (!flag.empty())
+            cerr << "TraceExtractor : Unknown flag \"" << flag
+                 << "\" ignored." << endl;
+    }
+}
+
+bool TraceExtractor::Sample(const Trace &trace) {
+    if (onlyPileup_ || onlySaturated_) {
+        bool pileup = trace.GetValue(Trace::NUM_TRIGGERS) > 1 ||
+            trace.HasValue("filterEnergy2");
+        bool saturated = trace.HasValue(Trace::SATURATION);
+        if (!(onlyPileup_ && pileup) && !(onlySaturated_ && saturated))
+            return(false);
+    }
+
+    if (numMatched_++ % every_ != 0)
+        return(false);
+
+    if (rate_ > 0) {
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        if (now - second_ >= std::chrono::seconds(1)) {
+            second_ = now;
+            numInSecond_ = 0;
+        }
+        if (numInSecond_ >= rate_)
+            return(false);
+        numInSecond_++;
+    }
+    return(true);
 }
 
 void TraceExtractor::DeclarePlots(void)
@@ -37,7 +79,7 @@ void TraceExtractor::Analyze(Trace &trace, const std::string &aType,
 
     if (type ==  aType && subtype == aSubtype && 
 	(tag == "" || tags.find(tag) != tags.end()) &&
-	numPlottedTraces < numTraces){
+	numPlottedTraces < numTraces && Sample(trace)){
         TraceAnalyzer::Analyze(trace, type, subtype, tags);
         trace.OffsetPlot(D_TRACE, numPlottedTraces, 0.0);
         numPlottedTraces++;
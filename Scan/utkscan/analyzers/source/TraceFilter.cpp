@@ -35,6 +35,7 @@
 #include <cmath>
 
 #include "TraceFilter.hpp"
+#include "TrapFilterKernels.hpp"
 
 using namespace std;
 
@@ -57,9 +58,7 @@ void TraceFilter::CalcBaseline(void) {
     if(offset < 0)
         throw(EARLY_TRIG);
     
-    for(unsigned int i = 0; i < (unsigned int) offset; i++)
-        baseline_ += sig_->at(i);
-    baseline_ /= offset;
+    baseline_ = Sum(0, offset) / offset;
     
     if(isVerbose_) 
         cout << "********** CalcBaseline **********" << endl
@@ -74,9 +73,12 @@ unsigned int TraceFilter::CalcFilters(const Trace *sig) {
         
         if(!isConverted_)
             ConvertToClockticks();
+        CalcRunningSum();
         CalcTriggerFilter();
         CalcBaseline();
         CalcEnergyFilterCoeffs();
+        if(e_.IsRecursive())
+            CalcRecursiveEnergyFilter();
 
         for(vector<unsigned int>::iterator it = trigs_.begin(); it!= trigs_.end(); it++) {
             CalcEnergyFilterLimits((*it));
@@ -112,24 +114,37 @@ unsigned int TraceFilter::CalcFilters(const Trace *sig) {
 }
 
 void TraceFilter::CalcEnergyFilter(void) {
-    double partA = 0, partB = 0, partC = 0;
-
-    for(unsigned int i = limits_[0]; i < limits_[1]; i++)
-        partA += sig_->at(i);
-    for(unsigned int i = limits_[2]; i < limits_[3]; i++)
-        partB += sig_->at(i);
-    for(unsigned int i = limits_[4]; i < limits_[5]; i++)
-        partC += sig_->at(i);
+    double partA = Sum(limits_[0], limits_[1]);
+    double partB = Sum(limits_[2], limits_[3]);
+    double partC = Sum(limits_[4], limits_[5]);
     esums_.push_back(partA);
     esums_.push_back(partB);
     esums_.push_back(partC);
 
-    en_.push_back(coeffs_[0]*partA + coeffs_[1]*partB + coeffs_[2]*partC - baseline_);
+    //The recursive filter at the end of the fall sum covers the same
+    // samples as the three sums.
+    if(e_.IsRecursive())
+        en_.push_back(energyFilter_[limits_[5]]);
+    else
+        en_.push_back(coeffs_[0]*partA + coeffs_[1]*partB + coeffs_[2]*partC - baseline_);
     if(isVerbose_)
         cout << "********** CalcEnergyFilter **********" << endl
              << "Calculated Energy : " << en_.back() << endl << endl;
 }
 
+void TraceFilter::CalcRecursiveEnergyFilter(void) {
+    //This is the recursive trapezoid with pole-zero correction used by the
+    // Pixie FPGA. It costs O(1) per sample for any filter length.
+    double beta = 1 - coeffs_[1];
+    TrapFilterKernels::Recursive(sig_->data(), sig_->size(), baseline_,
+                                 e_.GetRisetime(), e_.GetFlattop(), beta,
+                                 energyFilter_);
+
+    if(isVerbose_)
+        cout << "********** CalcRecursiveEnergyFilter **********" << endl
+             << "  Pole-zero constant : " << beta / (1 - beta) << endl << endl;
+}
+
 void TraceFilter::CalcEnergyFilterCoeffs(void) {
     double l = e_.GetRisetime();
     double beta = exp(-1.0/ e_.GetT());
@@ -184,33 +199,34 @@ void TraceFilter::CalcEnergyFilterLimits(const unsigned int &tpos) {
     limits_.push_back(p5);      // end of sum E1
 }
 
+void TraceFilter::CalcRunningSum(void) {
+    //The sum is kept in integers so that differences of it are exact, and
+    // every window sum of the filters costs a single subtraction.
+    TrapFilterKernels::RunningSum(sig_->data(), sig_->size(), runningSum_);
+}
+
 void TraceFilter::CalcTriggerFilter(void) {
     bool hasRecrossed = false;
 
     int l = t_.GetRisetime(), g = t_.GetFlattop();
-    for(int i = 0; i < (int)sig_->size(); i++) {
-        double sum1 = 0, sum2 = 0;
-        if( (i-2*l-g+1) >= 0 ) {
-            for(int a = i-2*l-g+1; a < i-l-g+1; a++)
-                sum1 += sig_->at(a);
-            for(int a = i-l+1; a < i+1; a++)
-                sum2 += sig_->at(a);
-            
-            if((sum2 - sum1)/l >= t_.GetT()) {
-                if(trigs_.size() == 0) 
-                    trigs_.push_back(i);
-                if(hasRecrossed) {
-                    trigs_.push_back(i);
-                    hasRecrossed = false;
-                }
-            }else {
-                if(trigs_.size() != 0)
-                    hasRecrossed = true;
+    int size = sig_->size();
+    int first = 2*l + g - 1;
+
+    //The filter is the difference of two window sums of the running sum.
+    TrapFilterKernels::Trapezoid(runningSum_, l, g, trigFilter_);
+
+    for(int i = first; i < size; i++) {
+        if(trigFilter_[i] >= t_.GetT()) {
+            if(trigs_.size() == 0) 
+                trigs_.push_back(i);
+            if(hasRecrossed) {
+                trigs_.push_back(i);
+                hasRecrossed = false;
             }
-            
-            trigFilter_.push_back((sum2 - sum1)/l);
-        } else
-            trigFilter_.push_back(0.0);
+        }else {
+            if(trigs_.size() != 0)
+                hasRecrossed = true;
+        }
     }
 
     if(trigs_.size() == 0)
@@ -278,6 +294,7 @@ void TraceFilter::Reset(void) {
     en_.clear();
     baseline_ = 0;
     trigFilter_.clear();
+    energyFilter_.clear();
     trigs_.clear();
     limits_.clear();
 }
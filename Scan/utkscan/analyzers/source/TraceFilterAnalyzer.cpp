@@ -63,7 +63,7 @@ void TraceFilterAnalyzer::Analyze(Trace &trace, const std::string &type,
     
     vector<double> tfilt = filter.GetTriggerFilter();
     trace.SetTriggerFilter(tfilt);
-    trace.SetValue("numTriggers", (int)filter.GetNumTriggers());
+    trace.SetValue(Trace::NUM_TRIGGERS, (int)filter.GetNumTriggers());
 
     //plot traces that were flagged as pileups
     if(filter.GetHasPileup() && numPileup < numTraces)
@@ -86,7 +86,7 @@ void TraceFilterAnalyzer::Analyze(Trace &trace, const std::string &type,
 	ss.str("");
     }
     
-    trace.SetValue("baseline", filter.GetBaseline());
+    trace.SetValue(Trace::BASELINE, filter.GetBaseline());
     trace.SetEnergySums(filter.GetEnergySums());
     
     //500 is an arbitrary offset since DAMM cannot display negative numbers.
@@ -28,13 +28,13 @@ void WaaAnalyzer::Analyze(Trace &trace, const string &detType,
                           const std::map<std::string, int> & tagMap) {
     TraceAnalyzer::Analyze(trace, detType, detSubtype,tagMap);
 
-    if(trace.HasValue("saturation") || trace.empty()) {
+    if(trace.HasValue(Trace::SATURATION) || trace.empty()) {
      	EndAnalyze();
      	return;
     }
 
-    const unsigned int maxPos = (unsigned int)trace.GetValue("maxpos");
-    const double baseline = trace.GetValue("baseline");
+    const unsigned int maxPos = (unsigned int)trace.GetValue(Trace::MAXPOS);
+    const double baseline = trace.GetValue(Trace::BASELINE);
 
     double sum = 0, phi = 0;
     static int row=0;
@@ -50,7 +50,7 @@ void WaaAnalyzer::Analyze(Trace &trace, const string &detType,
 	sum += trace[i]-baseline;
     for(unsigned int i = maxPos - low; i <= maxPos + high; i++)
      	phi += ((trace[i]-baseline)/sum)*i;
-    trace.InsertValue("phase", phi);
+    trace.InsertValue(Trace::PHASE, phi);
     //cout << phi << " " << maxPos << " " << endl;
     EndAnalyze();
 } //void WaaAnalyzer::Analyze
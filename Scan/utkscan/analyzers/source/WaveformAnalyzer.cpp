@@ -7,6 +7,7 @@
  *\author S. V. Paulauskas
  *\date July 16, 2009
 */
+#include <algorithm>
 #include <numeric>
 #include <string>
 
@@ -16,6 +17,24 @@
 
 using namespace std;
 
+namespace {
+    /** \return the sum of the samples in [lo, hi) */
+    inline long long SumSamples(const Trace::Sample *data, long long lo, long long hi) {
+        long long sum = 0;
+        for (long long i = lo; i < hi; i++)
+            sum += data[i];
+        return sum;
+    }
+
+    /** \return the sum of the squares of the samples in [lo, hi) */
+    inline long long SumSquares(const Trace::Sample *data, long long lo, long long hi) {
+        long long sum = 0;
+        for (long long i = lo; i < hi; i++)
+            sum += (long long) data[i] * data[i];
+        return sum;
+    }
+}
+
 enum WAVEFORMANALYZER_ERROR_CODES{
     TOO_LOW,
     MAX_END,
@@ -25,38 +44,68 @@ enum WAVEFORMANALYZER_ERROR_CODES{
 WaveformAnalyzer::WaveformAnalyzer() : TraceAnalyzer() {
     name = "WaveformAnalyzer";
     messenger_ = new Messenger();
+    DeclareFields({"baseline", "saturation"},
+                  {"baseline", "discrim", "maxpos", "maxval", "qdc",
+                   "saturation", "sigmaBaseline", "tqdc", "waveform"});
 }
 
 void WaveformAnalyzer::Analyze(Trace &trace, const std::string &type,
                                const std::string &subtype,
                                const std::map<std::string, int> &tags) {
     TraceAnalyzer::Analyze(trace, type, subtype, tags);
+    g_ = Globals::get();
+    AnalyzeWaveform(trace, tags, GetRange(type, subtype,
+                                          tags.find("timing") != tags.end()));
+}
+
+void WaveformAnalyzer::Analyze(std::vector<Hit> &hits) {
+    g_ = Globals::get();
+    pair<unsigned int, unsigned int> range, timingRange;
+    for (vector<Hit>::iterator it = hits.begin(); it != hits.end(); it++) {
+        TraceAnalyzer::Analyze(*it->trace, *it->type, *it->subtype, *it->tags);
+
+        //The hits are sorted by type, so look up the ranges only when the
+        // type or subtype changes
+        if (it == hits.begin() || *it->type != *(it-1)->type ||
+            *it->subtype != *(it-1)->subtype) {
+            range = GetRange(*it->type, *it->subtype, false);
+            timingRange = GetRange(*it->type, *it->subtype, true);
+        }
+
+        if (it->tags->find("timing") != it->tags->end())
+            AnalyzeWaveform(*it->trace, *it->tags, timingRange);
+        else
+            AnalyzeWaveform(*it->trace, *it->tags, range);
+    }
+}
+
+pair<unsigned int, unsigned int> WaveformAnalyzer::GetRange(
+        const std::string &type, const std::string &subtype,
+        const bool &isTiming) const {
+    if (type == "beta" && subtype == "double" && isTiming)
+        return(g_->waveformRange(type + ":" + subtype + ":timing"));
+    return(g_->waveformRange(type + ":" + subtype));
+}
+
+void WaveformAnalyzer::AnalyzeWaveform(
+        Trace &trace, const std::map<std::string, int> &tags,
+        const std::pair<unsigned int, unsigned int> &range) {
     trc_ = &trace;
 
-    if (trace.HasValue("saturation") || trace.size() == 0) {
+    if (trace.HasValue(Trace::SATURATION) || trace.size() == 0) {
         EndAnalyze();
         return;
     }
 
     mean_ = mval_ = 0;
 
-    g_ = Globals::get();
-
-    pair<unsigned int, unsigned int> range =
-            g_->waveformRange(type + ":" + subtype);
-
-    if (type == "beta" && subtype == "double" &&
-        tags.find("timing") != tags.end())
-        range = g_->waveformRange(type + ":" + subtype + ":timing");
-
     try {
         //First we find the waveform in the trace
         FindWaveform(range.first, range.second);
-        //Calculate the baseline, need to know where waveform is before this point
-        CalculateSums();
-        //If we had something tagged for additional trace analysis.
-        if (tags.find("psd") != tags.end())
-            CalculateDiscrimination(g_->discriminationStart());
+        //Calculate the baseline, need to know where waveform is before this
+        // point. If we had something tagged for additional trace analysis
+        // the discrimination is calculated in the same pass.
+        CalculateSums(tags.find("psd") != tags.end());
     } catch(WAVEFORMANALYZER_ERROR_CODES errorCode) {
         switch(errorCode) {
             case TOO_LOW:
@@ -96,48 +145,65 @@ void WaveformAnalyzer::Analyze(Trace &trace, const std::string &type,
     EndAnalyze();
 }
 
-void WaveformAnalyzer::CalculateSums() {
-    if (trc_->HasValue("baseline"))
+void WaveformAnalyzer::CalculateSums(const bool &psd) {
+    bool hasBaseline = trc_->HasValue(Trace::BASELINE);
+    if (hasBaseline && !psd)
         return;
 
-    double sum = 0, qdc = 0;
-    vector<double> w;
-    double numBins = (double) (bhi_ - trc_->begin());
-    mean_ = 0;
-    for (Trace::iterator it = trc_->begin(); it != trc_->end(); it++) {
-        sum += (*it);
-        if (it < bhi_)
-            mean_ += (*it) / numBins;
-
-        if (it > waverng_.first && it < waverng_.second) {
-            qdc += (*it) - mean_;
-            w.push_back((*it) - mean_);
-        }
+    const Trace::Sample *data = &(*trc_)[0];
+    const long long size = trc_->size();
+    const long long bhi = min((long long) (bhi_ - trc_->begin()), size);
+    const long long wlo = waverng_.first - trc_->begin();
+    const long long whi = min((long long) (waverng_.second - trc_->begin()),
+                              size);
+    const long long dlo = wlo + g_->discriminationStart();
+
+    //Every sum is taken over a whole range of the trace by itself, instead
+    // of testing the range of each sample, so that the loops have no
+    // branches and are vectorized by the compiler. The waveform range
+    // starts at the end of the baseline, so the baseline is known by the
+    // time the waveform is copied out.
+    long long baseSum = SumSamples(data, 0, bhi);
+    long long sum = baseSum + SumSamples(data, bhi, size);
+    long long discrimSum = psd ? SumSamples(data, max(dlo, 0LL),
+                                                  min(whi + 1, size)) : 0;
+    if (bhi < size)
+        mean_ = hasBaseline ? trc_->GetValue(Trace::BASELINE) :
+                (double) baseSum / bhi;
+
+    if (hasBaseline) {
+        InsertDiscrimination(discrimSum, dlo, whi, size);
+        return;
     }
 
-    //We need to perform one separate loop in order to calculate the standard
-    // deviation of the baseline
-    double accum = 0.0;
-    for (Trace::iterator it = trc_->begin(); it != bhi_; it++)
-        accum += (*it - mean_) * (*it - mean_);
-    double stdev = sqrt(accum / (numBins));
-
-    //Subtract the baseline from the full trace qdc
-    sum -= mean_ * trc_->size();
-
-    trc_->SetWaveform(w);
-    trc_->InsertValue("tqdc", sum);
-    trc_->InsertValue("qdc", qdc);
-    trc_->SetValue("baseline", mean_);
-    trc_->SetValue("sigmaBaseline", stdev);
-    trc_->SetValue("maxval", mval_ - mean_);
+    long long baseSumSq = SumSquares(data, 0, bhi);
+    long long qdcSum = SumSamples(data, wlo + 1, whi);
+    waveform_.resize(max(whi - wlo - 1, 0LL));
+    for (long long i = wlo + 1; i < whi; i++)
+        waveform_[i - wlo - 1] = data[i] - mean_;
+
+    if (psd)
+        InsertDiscrimination(discrimSum, dlo, whi, size);
+
+    double numBins = (double) bhi;
+    double qdc = qdcSum - mean_ * waveform_.size();
+    double stdev = sqrt((double) (bhi * baseSumSq - baseSum * baseSum) /
+                        (numBins * numBins));
+
+    trc_->SetWaveform(waveform_);
+    trc_->InsertValue(Trace::TQDC, sum - mean_ * size);
+    trc_->InsertValue(Trace::QDC, qdc);
+    trc_->SetValue(Trace::BASELINE, mean_);
+    trc_->SetValue(Trace::SIGMA_BASELINE, stdev);
+    trc_->SetValue(Trace::MAXVAL, mval_ - mean_);
 }
 
-void WaveformAnalyzer::CalculateDiscrimination(const unsigned int &lo) {
-    int discrim = 0;
-    for (Trace::iterator i = waverng_.first + lo; i <= waverng_.second; i++)
-        discrim += (*i) - mean_;
-    trc_->InsertValue("discrim", discrim);
+void WaveformAnalyzer::InsertDiscrimination(const long long &discrimSum,
+                                            const long long &dlo,
+                                            const long long &whi,
+                                            const long long &size) {
+    long long numDiscrim = max(min(whi, size - 1) - dlo + 1, 0LL);
+    trc_->InsertValue(Trace::DISCRIM, (int) (discrimSum - mean_ * numDiscrim));
 }
 
 bool WaveformAnalyzer::FindWaveform(const unsigned int &lo,
@@ -172,7 +238,7 @@ bool WaveformAnalyzer::FindWaveform(const unsigned int &lo,
     //Set the value of the maximum of the waveform and insert the value into
     // the trace.
     mval_ = *tmp;
-    trc_->InsertValue("maxpos", mpos);
+    trc_->InsertValue(Trace::MAXPOS, mpos);
 
     //Comparisons will be < to handle .end(), +1 here makes comparison <=
     //when we do not have the end().
@@ -189,7 +255,7 @@ bool WaveformAnalyzer::FindWaveform(const unsigned int &lo,
     //If the maximum value was greater than the bit resolution of the ADC then
     // we had a saturation and we need to set the saturation flag.
     if (mval_ >= g_->bitResolution())
-        trc_->InsertValue("saturation", 1);
+        trc_->InsertValue(Trace::SATURATION, 1);
 
     return (true);
 }
@@ -0,0 +1,193 @@
+///\file bench_analyzers.cpp
+///\brief Measures the time and the allocations per trace of the trace
+/// analyzers over libraries of synthetic traces
+///
+/// Every analyzer is run over fresh copies of the traces of each library.
+/// The analyzers it depends on (the WaveformAnalyzer for the fitters and the
+/// waveform CFD) are run on the copies before the timing starts. The
+/// allocations are counted by replacing the global operator new.
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "CfdAnalyzer.hpp"
+#include "FittingAnalyzer.hpp"
+#include "Globals.hpp"
+#include "TauAnalyzer.hpp"
+#include "Trace.hpp"
+#include "TraceFilterAnalyzer.hpp"
+#include "WaveformAnalyzer.hpp"
+
+using namespace std;
+
+namespace {
+    unsigned long long numAllocations = 0; //!< calls to operator new
+}
+
+void* operator new(size_t size) {
+    numAllocations++;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+//! A set of similar traces, and the channel they are analyzed as
+struct TraceLibrary {
+    string name; //!< the name of the library
+    string type; //!< the detector type of the channel
+    string subtype; //!< the detector subtype of the channel
+    map<string, int> tags; //!< the tags of the channel
+    vector<vector<int> > traces; //!< the traces
+};
+
+//! An analyzer under test and whether it needs the WaveformAnalyzer first
+struct Bench {
+    string name; //!< the name printed in the results
+    TraceAnalyzer *analyzer; //!< the analyzer
+    bool needsWaveform; //!< true if the WaveformAnalyzer must run first
+};
+
+///Make a library of traces of a given pulse shape with random amplitudes,
+/// random phases and gaussian noise on a fixed baseline
+static TraceLibrary MakeLibrary(const string &name, const string &type,
+                                const string &subtype, unsigned int length,
+                                unsigned int position, double baseline,
+                                double noise, double minAmp, double maxAmp,
+                                double (*shape)(double), unsigned int num,
+                                mt19937 &rng) {
+    TraceLibrary lib;
+    lib.name = name;
+    lib.type = type;
+    lib.subtype = subtype;
+
+    uniform_real_distribution<double> amplitude(minAmp, maxAmp);
+    uniform_real_distribution<double> phase(-0.5, 0.5);
+    normal_distribution<double> gauss(0, noise);
+    for (unsigned int i = 0; i < num; i++) {
+        double amp = amplitude(rng);
+        double t0 = position + phase(rng);
+        vector<int> trace(length);
+        for (unsigned int j = 0; j < length; j++)
+            trace[j] = (int)lround(baseline + amp * shape(j - t0) + gauss(rng));
+        lib.traces.push_back(trace);
+    }
+    return lib;
+}
+
+///The PMT shape used by the fitters, with the default beta and gamma
+static double PmtShape(double t) {
+    if (t < 0)
+        return 0;
+    return exp(-0.254373 * t) * (1 - exp(-pow(0.208072 * t, 4))) / 0.6;
+}
+
+///A fast SiPM signal, close to a gaussian
+static double SiPmFastShape(double t) {
+    return exp(-t * t / (2 * 1.5 * 1.5));
+}
+
+///A slow SiPM signal with a fast rise and a slow decay
+static double SiPmSlowShape(double t) {
+    if (t < 0)
+        return 0;
+    return (1 - exp(-t / 2.0)) * exp(-t / 40.0);
+}
+
+///An HPGe preamplifier signal with a slow rise and a long decay
+static double HpgeShape(double t) {
+    if (t < 0)
+        return 0;
+    return (1 - exp(-t / 15.0)) * exp(-t / 5000.0);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cout << "Usage : " << argv[0] << " <config.xml> [traces per library]"
+             << " [repetitions]" << endl;
+        return 1;
+    }
+    unsigned int numTraces = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+    unsigned int numReps = argc > 3 ? strtoul(argv[3], NULL, 0) : 5;
+
+    Globals::get(argv[1]);
+
+    mt19937 rng(1);
+    vector<TraceLibrary> libs;
+    libs.push_back(MakeLibrary("PMT", "bench", "pmt", 124, 40, 430, 2,
+                               500, 4000, PmtShape, numTraces, rng));
+    libs.push_back(MakeLibrary("SiPM fast", "beta", "double", 64, 30, 380,
+                               3, 200, 3000, SiPmFastShape, numTraces, rng));
+    libs.back().tags["timing"] = 1;
+    libs.push_back(MakeLibrary("SiPM slow", "beta", "double", 250, 60, 380,
+                               3, 200, 3000, SiPmSlowShape, numTraces, rng));
+    libs.push_back(MakeLibrary("HPGe", "ge", "clover_high", 1000, 250, 3000,
+                               4, 500, 8000, HpgeShape, numTraces, rng));
+
+    WaveformAnalyzer waveform;
+    vector<Bench> benches = {
+        {"TraceFilter", new TraceFilterAnalyzer(false), false},
+        {"Waveform", new WaveformAnalyzer(), false},
+        {"Cfd (poly)", new CfdAnalyzer("poly", 0.5, 2, 20), false},
+        {"Cfd (fit)", new CfdAnalyzer(), true},
+#ifdef usegsl
+        {"Fitting (gsl)", new FittingAnalyzer("gsl"), true},
+#endif
+        {"Fitting (template)", new FittingAnalyzer("template"), true},
+        {"Tau", new TauAnalyzer(), false}
+    };
+
+    cout << "Timing " << numReps << " passes over " << numTraces
+         << " traces of each library" << endl << endl
+         << left << setw(20) << "Analyzer" << setw(12) << "Library" << right
+         << setw(8) << "Samples" << setw(12) << "ns/trace" << setw(14)
+         << "allocs/trace" << endl;
+
+    for (vector<Bench>::iterator bench = benches.begin();
+         bench != benches.end(); ++bench) {
+        for (vector<TraceLibrary>::iterator lib = libs.begin();
+             lib != libs.end(); ++lib) {
+            double seconds = 0;
+            unsigned long long allocs = 0;
+            for (unsigned int rep = 0; rep < numReps; rep++) {
+                vector<Trace> traces(lib->traces.begin(), lib->traces.end());
+                if (bench->needsWaveform)
+                    for (vector<Trace>::iterator it = traces.begin();
+                         it != traces.end(); ++it)
+                        waveform.Analyze(*it, lib->type, lib->subtype,
+                                         lib->tags);
+
+                unsigned long long startAllocs = numAllocations;
+                chrono::steady_clock::time_point start =
+                        chrono::steady_clock::now();
+                for (vector<Trace>::iterator it = traces.begin();
+                     it != traces.end(); ++it)
+                    bench->analyzer->Analyze(*it, lib->type, lib->subtype,
+                                             lib->tags);
+                seconds += chrono::duration<double>(
+                        chrono::steady_clock::now() - start).count();
+                allocs += numAllocations - startAllocs;
+            }
+
+            double numAnalyzed = (double)numReps * lib->traces.size();
+            cout << left << setw(20) << bench->name << setw(12) << lib->name
+                 << right << setw(8) << lib->traces.front().size() << fixed
+                 << setprecision(0) << setw(12)
+                 << seconds * 1e9 / numAnalyzed << setprecision(2)
+                 << setw(14) << allocs / numAnalyzed << endl;
+        }
+        delete bench->analyzer;
+    }
+}
@@ -0,0 +1,119 @@
+/** \file AnalysisCache.hpp
+ * \brief The results of the trace analyzers, kept in a binary file so that
+ * they do not have to be analyzed again
+ *
+ * When only gates or histograms are changed between two scans of the same
+ * data, the traces are analyzed again to the same values. The first scan
+ * writes the values of every analyzed trace to the cache file, keyed by the
+ * number of the spill of the hit and the position of the hit in the spill,
+ * together with a hash of the configuration the analyzers depend on and of
+ * the header of the input file. Later scans with the same hash read the
+ * values back instead of running the analyzers.
+ *
+ * The records are written in the order the hits are processed, which is the
+ * same in the next scan, so they are read back as a stream. Records are read
+ * ahead by a few spills to find hits which are processed out of order, and
+ * a hit without a record is simply analyzed.
+ */
+#ifndef __ANALYSISCACHE_HPP_
+#define __ANALYSISCACHE_HPP_
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include "Trace.hpp"
+
+class ChanEvent;
+
+//! Reads or writes the cached results of the trace analyzers
+class AnalysisCache {
+public:
+    /** Default constructor */
+    AnalysisCache();
+
+    /** Default destructor, closes the file */
+    ~AnalysisCache() { Close(); }
+
+    /** Open the cache file. It is read if it was written with the same
+    * hash, otherwise it is written anew.
+    * \param [in] name : the name of the cache file
+    * \param [in] hash : the hash of the analyzer configuration and input
+    * \return true if the file was opened for reading or writing */
+    bool Open(const std::string &name, uint64_t hash);
+
+    /** Close the cache file */
+    void Close();
+
+    /** \return true if the results are read from the cache */
+    bool IsReading() const { return in_.is_open(); }
+
+    /** \return true if the results are written to the cache */
+    bool IsWriting() const { return out_.is_open(); }
+
+    /** Set the values of a trace from the cache
+    * \param [in] chan : the channel event of the trace
+    * \param [out] trace : the trace to set the values of
+    * \return true if the hit was found in the cache */
+    bool Load(const ChanEvent &chan, Trace &trace);
+
+    /** Write the values of an analyzed trace to the cache
+    * \param [in] chan : the channel event with the analyzed trace */
+    void Store(const ChanEvent &chan);
+
+    /** \return the number of traces whose values were read */
+    unsigned long long GetNumLoaded() const { return numLoaded_; }
+
+    /** \return the number of traces which were not found while reading */
+    unsigned long long GetNumMissed() const { return numMissed_; }
+
+    /** \return the number of traces whose values were written */
+    unsigned long long GetNumStored() const { return numStored_; }
+
+private:
+    //! The cached values of one trace
+    struct Record {
+        unsigned long long timeStamp; //!< the time stamp of the hit
+        int id; //!< the channel of the hit
+        unsigned int mask; //!< the fields which have a value
+        double fields[Trace::NUM_FIELDS]; //!< the values of the fields
+        std::vector<std::pair<std::string, double> > named; //!< the other values
+    };
+
+    /** Read records until the key is found, or until the records are more
+    * than spillWindow spills past it
+    * \param [in] key : the key of the hit to look for
+    * \return true if the key was read */
+    bool ReadAhead(uint64_t key);
+
+    /** Read the next record of the file
+    * \param [out] key : the key of the record
+    * \param [out] rec : the record
+    * \return true if a record was read */
+    bool ReadRecord(uint64_t &key, Record &rec);
+
+    /** \return the key of a hit
+    * \param [in] spill : the number of the spill of the hit
+    * \param [in] hit : the position of the hit in the spill */
+    static uint64_t Key(unsigned int spill, unsigned int hit) {
+        return ((uint64_t)spill << 32) | hit;
+    }
+
+    static const unsigned int spillWindow = 4; //!< spills to read ahead of a hit
+
+    std::ifstream in_; //!< the cache file when reading
+    std::ofstream out_; //!< the cache file when writing
+    std::unordered_map<uint64_t, Record> pending_; //!< records read ahead
+    std::deque<uint64_t> order_; //!< keys of the records in the order they were read
+
+    unsigned long long numLoaded_; //!< the number of traces read
+    unsigned long long numMissed_; //!< the number of traces not found
+    unsigned long long numStored_; //!< the number of traces written
+};
+
+#endif // __ANALYSISCACHE_HPP_
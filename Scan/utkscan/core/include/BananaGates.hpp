@@ -0,0 +1,74 @@
+/** \file BananaGates.hpp
+ * \brief Banana gates read from DAMM .ban files
+ *
+ * Each banana is a polygon drawn in DAMM on a 2D histogram. When a file is
+ * loaded every polygon is converted once into a table of the channel
+ * intervals it covers in each row, so that testing a point only looks up
+ * its row and the (usually one or two) intervals of that row. The table is
+ * only read while testing, so any number of threads may test at once.
+ */
+#ifndef __BANANAGATES_HPP_
+#define __BANANAGATES_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+//! A set of banana gates, indexed by their DAMM banana id - Singleton Class
+class BananaGates {
+public:
+    /** \return The only instance of the banana gates */
+    static BananaGates *get();
+
+    /** Load the bananas of a DAMM .ban file. Bananas with the same id as
+     * one loaded before replace it. This may not be called while other
+     * threads test gates.
+     * \param [in] file : the name of the .ban file
+     * \return true if the file was read */
+    bool Load(const std::string &file);
+
+    /** Test if a point is inside a banana, including its edges
+     * \param [in] id : the DAMM id of the banana
+     * \param [in] x : the x channel of the point
+     * \param [in] y : the y channel of the point
+     * \return true if the banana is loaded and contains the point */
+    bool Test(const int &id, const int &x, const int &y) const {
+        if (id < 0 || (size_t)id >= gates_.size())
+            return false;
+        const Gate &gate = gates_[id];
+        if (y < gate.yMin || y >= gate.yMin + (int)gate.rows.size() - 1)
+            return false;
+        for (unsigned int i = gate.rows[y - gate.yMin];
+             i < gate.rows[y - gate.yMin + 1]; i++)
+            if (x >= gate.intervals[i].first && x <= gate.intervals[i].second)
+                return true;
+        return false;
+    }
+
+    /** \return the number of bananas which are loaded */
+    unsigned int GetNumGates() const;
+
+    /** Set the vertices of a banana directly, replacing any banana with
+     * the same id
+     * \param [in] id : the DAMM id of the banana
+     * \param [in] vertices : the (x, y) channels of the vertices */
+    void SetGate(const int &id,
+                 const std::vector<std::pair<int, int> > &vertices);
+
+private:
+    BananaGates() {} //!< Default constructor
+    BananaGates(const BananaGates &); //!< Not implemented
+    BananaGates &operator=(const BananaGates &); //!< Not implemented
+
+    //! The rows of a banana as intervals of channels
+    struct Gate {
+        int yMin; //!< The lowest row of the banana
+        std::vector<unsigned int> rows; //!< Intervals of row y are rows[y-yMin] up to rows[y-yMin+1]
+        std::vector<std::pair<int, int> > intervals; //!< Inclusive x intervals of all rows
+        Gate() : yMin(0) {}
+    };
+
+    std::vector<Gate> gates_; //!< The gates, indexed by banana id
+};
+
+#endif //__BANANAGATES_HPP_
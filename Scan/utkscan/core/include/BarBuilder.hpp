@@ -8,15 +8,23 @@
 
 #include "BarDetector.hpp"
 #include "HighResTimingData.hpp"
+#include "HitArray.hpp"
 
 //! Class that builds bars out of a list of ends
 class BarBuilder {
 public:
     /** Default constructor */
-    BarBuilder(){};
+    BarBuilder(){isFlat_ = false;};
     /** Constructor taking the map of channels to build bars with
      * \param [in] vec : Reference to the vector to build channels with */
-    BarBuilder(const std::vector<ChanEvent*> vec){list_ = vec;};
+    BarBuilder(const std::vector<ChanEvent*> vec){list_ = vec; isFlat_ = false;};
+    /** Constructor laying out the bars of a detector type in flat arrays.
+     * Every bar of the type in the DetectorLibrary gets a slot, ordered by
+     * subtype and bar number, and the slot and side of each channel are
+     * looked up once here. BuildBars then fills the BarArray by channel id
+     * without any map or tag lookups and without allocating.
+     * \param [in] type : The detector type to build the bars of */
+    BarBuilder(const std::string &type);
     /** Default destructor */
     virtual ~BarBuilder(){};
 
@@ -29,7 +37,27 @@ public:
      * you must call the BuildBars method <strong> first </strong>.
      * \return A BarMap of the bars having no traces */
     std::map<unsigned int, std::pair<double,double> > GetLrtBarMap(void) {return(lrtBars_);};
+
+    /** Gets the built bars of a builder constructed with a detector type,
+     * indexed by the bar slot. Call the BuildBars method <strong> first
+     * </strong>.
+     * \return A BarArray of the bars having traces. */
+    const BarArray& GetBarArray(void) const {return(hrtArray_);};
+
+    /** Gets the built bars of a builder constructed with a detector type,
+     * indexed by the bar slot. Call the BuildBars method <strong> first
+     * </strong>.
+     * \return The time and energy of the bars having no traces */
+    const HitArray<std::pair<double,double> >& GetLrtBarArray(void) const {
+        return(lrtArray_);
+    };
     
+    /** \return The key of each bar slot of a builder constructed with a
+     * detector type */
+    const std::vector<TimingDefs::TimingIdentifier>& GetKeys(void) const {
+        return(keys_);
+    };
+
     /** Builds BarDetectors from the individual channel maps. We make assumptions
 	that the bars are not going to be vastly out of order, such that the 
 	location / 2 = bar number. This is a safe assumption for current 
@@ -39,7 +67,7 @@ public:
     /** Sets the channel list to build bars out of. This list <strong>
      * must </strong> contain both ends of the detector.
      * \param [in] a : The channel list to build bars out of. */
-    void SetChannelList(const std::vector<ChanEvent*> a){list_ = a;};
+    void SetChannelList(const std::vector<ChanEvent*> &a){list_ = a;};
 private:
     /** The bar number calculated from the location. We assume here
      * that the bars are located in adjacent slots so that they are always
@@ -59,10 +87,40 @@ private:
      * others should arise. */
     void FillMaps(void);
 
+    /** Fills the ends of the detector into the leftEnds_ and rightEnds_
+     * arrays, using the slots and sides laid out by the constructor. */
+    void FillArrays(void);
+
+    /** Builds the bars out of the leftEnds_ and rightEnds_ arrays */
+    void BuildArrays(void);
+
+    /** \return A bar made from the left and right ends of the list
+     * \param [in] left : the index of the left end in list_
+     * \param [in] right : the index of the right end in list_
+     * \param [in] key : the TimingIdentifier of the bar */
+    BarDetector MakeBar(const unsigned int &left, const unsigned int &right,
+                        TimingDefs::TimingIdentifier key);
+
+    /** \return The average time and the geometric mean of the energies
+     * of the left and right ends of the list
+     * \param [in] left : the index of the left end in list_
+     * \param [in] right : the index of the right end in list_ */
+    std::pair<double,double> MakeLrtBar(const unsigned int &left,
+                                        const unsigned int &right);
+
     BarMap hrtBars_; //!< Map containing bars with high resolution timing..
     std::map<unsigned int, std::pair<double,double> > lrtBars_; //!<Map with low res bars
     std::map<unsigned int, unsigned int> lefts_; //!< Map containing the left sides of bars
     std::map<unsigned int, unsigned int> rights_; //!< Map containing the left sides of bars
     std::vector<ChanEvent*> list_; //!< Vector of events to build bars out of.
+
+    bool isFlat_; //!< True if the bars are built into the flat arrays
+    BarArray hrtArray_; //!< Slots of the bars with high resolution timing
+    HitArray<std::pair<double,double> > lrtArray_; //!< Slots of the low res bars
+    HitArray<unsigned int> leftEnds_; //!< The list index of the left end of each slot
+    HitArray<unsigned int> rightEnds_; //!< The list index of the right end of each slot
+    std::vector<TimingDefs::TimingIdentifier> keys_; //!< The key of each slot
+    std::vector<int> slotOfChannel_; //!< The slot of each channel id, -1 if none
+    std::vector<unsigned char> sideOfChannel_; //!< 1 for the left ends, 2 for the right ends
 };
 #endif // __BARBUILDER_HPP_
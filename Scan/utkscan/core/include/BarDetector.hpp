@@ -11,6 +11,7 @@
 #include <map>
 
 #include "HighResTimingData.hpp"
+#include "HitArray.hpp"
 #include "TimingCalibrator.hpp"
 
 //! A class to handle detectors that have two readouts viewing the same volume
@@ -34,34 +35,33 @@ public:
 
     /** \return the true if there was an event in the bar */
     bool GetHasEvent(void) const {
+        const RunConstants &run = Globals::get()->constants();
         if(GetType() == "small") {
-            double lengthSmallTime = Globals::get()->smallLengthTime();
-            return(fabs(GetTimeDifference()) < lengthSmallTime+20 &&
+            return(fabs(GetTimeDifference()) < run.smallLengthTime+20 &&
                    GetRightSide().GetIsValid() && GetLeftSide().GetIsValid());
         } else if(GetType() == "big") {
-            double lengthBigTime = Globals::get()->bigLengthTime();
-            return(fabs(GetTimeDifference()) < lengthBigTime+20 &&
+            return(fabs(GetTimeDifference()) < run.bigLengthTime+20 &&
                    GetRightSide().GetIsValid() && GetLeftSide().GetIsValid());
         } else if (GetType() == "medium") {
-            double lengthMediumTime = Globals::get()->mediumLengthTime();
-            return(fabs(GetTimeDifference()) < lengthMediumTime+20 &&
+            return(fabs(GetTimeDifference()) < run.mediumLengthTime+20 &&
                    GetRightSide().GetIsValid() && GetLeftSide().GetIsValid());
         }
         return(GetRightSide().GetIsValid() && GetLeftSide().GetIsValid());
     }
     /** \return the flight path of the particle to the detector */
     double GetFlightPath(void) const {
+        const RunConstants &run = Globals::get()->constants();
         if(GetType() == "small")
             return(sqrt(GetCalibration().GetZ0()*GetCalibration().GetZ0()+
-                pow(Globals::get()->speedOfLightSmall()*0.5*GetTimeDifference()+
+                pow(run.speedOfLightSmall*0.5*GetTimeDifference()+
                     GetCalibration().GetXOffset(),2)));
         else if(GetType() == "big")
             return(sqrt(GetCalibration().GetZ0()*GetCalibration().GetZ0() +
-                pow(Globals::get()->speedOfLightBig()*0.5*GetTimeDifference()+
+                pow(run.speedOfLightBig*0.5*GetTimeDifference()+
                     GetCalibration().GetXOffset(),2)));
         else if(GetType() == "medium")
             return(sqrt(GetCalibration().GetZ0()*GetCalibration().GetZ0() +
-                pow(Globals::get()->speedOfLightMedium()*0.5*GetTimeDifference()+
+                pow(run.speedOfLightMedium*0.5*GetTimeDifference()+
                     GetCalibration().GetXOffset(),2)));
         return(std::numeric_limits<double>::quiet_NaN());
     }
@@ -100,6 +100,8 @@ public:
     const HighResTimingData& GetLeftSide() const {return(left_);}
     /** \return the right_ var */
     const HighResTimingData& GetRightSide() const {return(right_);}
+    /** \return the key of the bar detector */
+    const TimingDefs::TimingIdentifier& GetKey() const {return(key_);}
     /** \return the type of bar detector */
     std::string GetType() const {return(key_.second);}
     /** \return the time calibration var */
@@ -114,4 +116,6 @@ private:
 
 /** Defines a map to hold Bar Detectors */
 typedef std::map<TimingDefs::TimingIdentifier, BarDetector> BarMap;
+/** Defines a flat array of Bar Detectors indexed by the bar slot */
+typedef HitArray<BarDetector> BarArray;
 #endif // __BARDETECTOR_HPP__
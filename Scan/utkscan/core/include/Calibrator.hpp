@@ -6,12 +6,15 @@
 #ifndef __CALIBRATOR_HPP__
 #define __CALIBRATOR_HPP__
 
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <string>
 
 #include "Identifier.hpp"
 
+class HitTable;
+
 /** A list of known walk correction models (functions). Add here a new name
  * if you need a different model. Then add a new function to the Calibrator
  * class, and and else-if loop to the AddChannel and GetCalEnergy functions. */
@@ -65,7 +68,158 @@ public:
      * \param [in] raw : the raw value to use for the calibration */
     double GetCalEnergy(const Identifier& chanID, double raw) const;
 
+    /** Build the flat table used by GetCalEnergy(int, double). Call once all
+     * channels have been added. A channel added later is not in the table
+     * until it is built again.
+     * \param [in] chans : the identifier of each channel, indexed by
+     *  module * 16 + channel as in the DetectorLibrary */
+    void BuildTable(const std::vector<Identifier>& chans);
+
+    /** \return calibrated energy for a channel, looked up in the flat table
+     * without any Identifier comparisons.
+     * \param [in] index : the channel index, module * 16 + channel
+     * \param [in] raw : the raw value to use for the calibration */
+    double GetCalEnergy(int index, double raw) const {
+        double def;
+        const TableEntry *entry = FindEntry(index, raw, def);
+        if (entry == NULL)
+            return def;
+        return Evaluate(entry->model, entry->par, entry->numPar,
+                        raw * gains_[index]);
+    }
+
+    /** Calibrate many hits at once using the flat table. The raw, off,
+     * linear, quadratic, cubic and short polynomial models are all evaluated
+     * as a cubic in a single loop over packed coefficients, the other models
+     * hit by hit. The results are the same as calling GetCalEnergy(int,
+     * double) for each hit. The scratch buffers are shared, so do not call
+     * this on the same Calibrator from several threads.
+     * \param [in] index : the channel index of each hit, module * 16 + channel
+     * \param [in] raw : the raw value of each hit
+     * \param [out] cal : the calibrated energy of each hit
+     * \param [in] n : the number of hits */
+    void GetCalEnergies(const int *index, const double *raw, double *cal,
+                        size_t n) const;
+
+    /** Calibrate the raw energies of all hits in a hit table
+     * \param [in] hits : the hits to calibrate
+     * \param [out] cal : the calibrated energy of each row of the table */
+    void GetCalEnergies(const HitTable &hits, std::vector<double> &cal) const;
+
+    /** Correct the gain drift of a channel in the flat table. The raw values
+     * of the channel are multiplied by the gain before they are calibrated,
+     * while the ranges of the calibration stay in uncorrected raw values.
+     * For the models evaluated as a cubic the gain is folded into the packed
+     * coefficients, so the correction costs nothing per hit.
+     * \param [in] index : the channel index, module * 16 + channel
+     * \param [in] gain : the factor to multiply the raw values with */
+    void SetGain(int index, double gain);
+
+    /** \return the gain correction of a channel, 1 if it is not corrected
+     * \param [in] index : the channel index, module * 16 + channel */
+    double GetGain(int index) const {
+        if (index < 0 || index >= (int)gains_.size())
+            return 1;
+        return gains_[index];
+    }
+
+    /** Exchange the calibrations with those of another calibrator. The
+     * entries of the flat table point into its own vectors, which are
+     * swapped rather than copied so that the pointers stay valid.
+     * \param [in,out] other : the calibrator to exchange with */
+    void Swap(Calibrator &other) {
+        index_.swap(other.index_);
+        entries_.swap(other.entries_);
+        pars_.swap(other.pars_);
+        gains_.swap(other.gains_);
+        channels_.swap(other.channels_);
+    }
+
 private:
+    /** A calibration range of one channel in the flat table */
+    struct TableEntry {
+        CalibrationModel model; //!< Calibration model to use
+        double min; //!< Minimum of range for calibration
+        double max; //!< Maximum of range for calibration
+        const double *par; //!< coefficients for calibration eqn., in pars_
+        unsigned int numPar; //!< Number of coefficients
+        bool cubic; //!< True if the model is evaluated as the cubic in poly
+        double poly[4]; //!< Cubic coefficients, lowest order first, if cubic
+    };
+
+    /** The calibration ranges of one channel in the flat table */
+    struct TableRanges {
+        unsigned int first; //!< First entry of the channel in entries_
+        unsigned int num; //!< Number of entries of the channel
+        bool disjoint; //!< True if the entries do not overlap and are sorted by min
+    };
+
+    std::vector<TableRanges> index_; //!< The ranges of each channel index
+    std::vector<TableEntry> entries_; //!< Calibration ranges of all channels, grouped by channel
+    std::vector<double> pars_; //!< Coefficients of all entries
+    std::vector<double> gains_; //!< Gain correction of each channel index
+
+    mutable std::vector<int> batchIndex_; //!< Channel indices of the rows of a hit table
+    mutable std::vector<size_t> batchRow_; //!< Hit numbers of the cubic hits in a batch
+    mutable std::vector<double> batchX_; //!< Raw values of the cubic hits in a batch
+    mutable std::vector<double> batchPoly_[4]; //!< Coefficients of the cubic hits in a batch
+
+    /** Find the calibration range of a channel in the flat table
+     * \param [in] index : the channel index, module * 16 + channel
+     * \param [in] raw : the raw value to calibrate
+     * \param [out] def : the calibrated energy to use if there is no range
+     * \return the range which holds raw, or NULL if there is none */
+    const TableEntry *FindEntry(int index, double raw, double &def) const {
+        def = raw;
+        if (index < 0 || index >= (int)index_.size())
+            return NULL;
+        const TableRanges &range = index_[index];
+        if (range.num == 0) {
+            def = raw * gains_[index];
+            return NULL;
+        }
+        // Parts of spectrum that are not within some min-max range are
+        // zeroed
+        def = 0;
+        const TableEntry *begin = &entries_[range.first];
+        const TableEntry *end = begin + range.num;
+        if (range.disjoint) {
+            //The only range which may hold raw is the last one starting at
+            //or below it
+            const TableEntry *it = std::upper_bound(begin, end, raw,
+                                                    MinBelow);
+            if (it == begin)
+                return NULL;
+            --it;
+            if (it->min <= raw && raw <= it->max)
+                return it;
+            return NULL;
+        }
+        for (const TableEntry *it = begin; it != end; ++it) {
+            if (it->min <= raw && raw <= it->max)
+                return it;
+        }
+        return NULL;
+    }
+
+    /** 
+eturn true if a raw value is below the start of a range, to
+     * search the ranges of a channel sorted by min
+     * \param [in] raw : the raw value to calibrate
+     * \param [in] entry : the range */
+    static bool MinBelow(double raw, const TableEntry &entry) {
+        return raw < entry.min;
+    }
+
+    /** Evaluate a calibration model
+     * \param [in] model : the model to use
+     * \param [in] par : the coefficients of the model
+     * \param [in] numPar : the number of coefficients
+     * \param [in] raw : the raw value to calibrate
+     * \return Calibrated energy */
+    double Evaluate(CalibrationModel model, const double *par,
+                    unsigned int numPar, double raw) const;
+
     /** Map where key is a channel Identifier
      * and value is a vector holding struct with calibration range
      * and calibration model and parameters.*/
@@ -83,26 +237,26 @@ private:
     /** Linear calibration, parameters are assumed to be sorted
      * in order par0, par1
      * f(x) = par0 + par1 * x
-     * \param [in] par : the vector of calibration coeffs
+     * \param [in] par : the array of calibration coeffs
      * \param [in] raw : the raw value to calibrate
      * \return Calibrated energy */
-    double ModelLinear(const std::vector<double>& par, double raw) const;
+    double ModelLinear(const double *par, double raw) const;
 
     /** Quadratic calibration, parameters are assumed to be sorted
      * in order par0, par1, par2
      * f(x) = par0 + par1 * x  + par2 * x^2
-     * \param [in] par : the vector of calibration coeffs
+     * \param [in] par : the array of calibration coeffs
      * \param [in] raw : the raw value to calibrate
      * \return Calibrated energy */
-    double ModelQuadratic(const std::vector<double>& par, double raw) const;
+    double ModelQuadratic(const double *par, double raw) const;
 
     /** Cubic calibration, parameters are assumed to be sorted
      * in order par0, par1, par2, par3
      * f(x) = par0 + par1 * x  + par2 * x^2 + par3 * x^3
-     * \param [in] par : the vector of calibration coeffs
+     * \param [in] par : the array of calibration coeffs
      * \param [in] raw : the raw value to calibrate
      * \return Calibrated energy */
-    double ModelCubic(const std::vector<double>& par, double raw) const;
+    double ModelCubic(const double *par, double raw) const;
 
     /** Polynomial calibration, where parameters are assumed to be sorted
      * from the lowest order to the highest
@@ -111,25 +265,27 @@ private:
      * Note that this model covers also Linear and Quadratic, however
      * it is slower due to looping over unknown apriori number
      * of parameters.
-     * \param [in] par : the vector of calibration coeffs
+     * \param [in] par : the array of calibration coeffs
+     * \param [in] numPar : the number of calibration coeffs
      * \param [in] raw : the raw value to calibrate
      * \return Calibrated energy */
-    double ModelPolynomial(const std::vector<double>& par, double raw) const;
+    double ModelPolynomial(const double *par, unsigned int numPar,
+                           double raw) const;
 
     /** Linear plus hyperbolic calibration,
      * parameters are assumed to be sorted
      * from the lowest order to the highest
      * f(x) = par0 / x + par1 + par2 * x
-     * \param [in] par : the vector of calibration coeffs
+     * \param [in] par : the array of calibration coeffs
      * \param [in] raw : the raw value to calibrate
      * \return Calibrated energy */
-         double ModelHypLin(const std::vector<double>& par, double raw) const;
+    double ModelHypLin(const double *par, double raw) const;
 
     /** Exponential (for logarithmic preamp)
      * f(x) = par0 * exp(x / par[1]) + par2
-     * \param [in] par : the vector of calibration coeffs
+     * \param [in] par : the array of calibration coeffs
      * \param [in] raw : the raw value to calibrate
      * \return Calibrated energy */
-    double ModelExp(const std::vector<double>& par, double raw) const;
+    double ModelExp(const double *par, double raw) const;
 };
 #endif
@@ -30,9 +30,19 @@ public:
     ///Constructor setting XIA Data
     ChanEvent(const XiaData &xiadata) {
         data_ = xiadata;
-        trace = xiadata.adcTrace;
+        if (xiadata.hasTraceView())
+            trace.assign(xiadata.traceView,
+                         xiadata.traceView + xiadata.traceViewLength);
+        else
+            trace = xiadata.adcTrace;
     }
 
+    /** Fill the channel event from XIA data, reusing the storage of a
+     * previous event. The trace is copied once into the existing trace
+     * storage, the XIA trace itself is not copied into data_.
+     * \param [in] xiadata : the decoded XIA data for the channel */
+    void Set(XiaData *xiadata);
+
     ///Default Destructor
     ~ChanEvent(){};
 
@@ -101,6 +111,15 @@ public:
     unsigned long GetEventTimeHi() const {
         return data_.eventTimeHi;   /**< \return the upper 32 bits of event time */
     }
+    unsigned long long GetTimeStamp() const {
+        return data_.timeStamp;   /**< \return the fixed point event time */
+    }
+    unsigned int GetSpillIndex() const {
+        return data_.spillIndex;   /**< \return the number of the spill of the hit */
+    }
+    unsigned int GetHitIndex() const {
+        return data_.hitIndex;   /**< \return the position of the hit in its spill */
+    }
     unsigned long GetRunTime0() const {
         return runTime0;   /**< \return the lower bits of run time */
     }
@@ -0,0 +1,102 @@
+/** \file CoincidenceJoin.hpp
+ * \brief Pairs the hits of two detectors which are within a time window
+ */
+#ifndef __COINCIDENCEJOIN_HPP__
+#define __COINCIDENCEJOIN_HPP__
+
+#include <vector>
+
+#include <cstddef>
+
+class ChanEvent;
+class DetectorSummary;
+
+/** \brief Pairs the hits of two detector summaries (e.g. betas and gammas)
+ * whose times differ by a value within a window.
+ *
+ * Both lists of hits are sorted by time once. The hits of the second list
+ * in the window of a hit of the first start at or after those in the window
+ * of the hit before it, so the start of the window is swept forward along
+ * the second list, and each hit is passed over once besides the pairs which
+ * are found. A join therefore takes O(n + m + pairs) after the sort,
+ * instead of the O(n * m) of testing every pair.
+ *
+ * When the second list holds at most kSmallMult hits, which is the common
+ * case for a raw event, the window of each hit of the first list is tested
+ * against every time of the second list in a loop without branches, which
+ * the compiler vectorizes.
+ *
+ * The pairs are given in the order of the time of their first hit, and then
+ * of their second hit. The buffers are kept between the joins, so that the
+ * joins of an event do not allocate once they have grown.
+ */
+class CoincidenceJoin {
+public:
+    /** \brief The time of the hits which is compared */
+    enum TimeSource {
+        TIME, //!< ChanEvent::GetTime, in clock ticks
+        CORRECTED_TIME, //!< ChanEvent::GetCorrectedTime, walk corrected
+        HIGH_RES_TIME //!< ChanEvent::GetHighResTime, in ns
+    };
+
+    /** \brief A pair of hits within the window */
+    struct Pair {
+        ChanEvent *first; //!< the hit of the first list
+        ChanEvent *second; //!< the hit of the second list
+        double dt; //!< the time of the second hit minus that of the first
+    };
+
+    /** Number of hits of the second list up to which every time is tested */
+    static const size_t kSmallMult = 16;
+
+    /** Constructor
+    * \param [in] source : the time of the hits to compare */
+    CoincidenceJoin(TimeSource source = CORRECTED_TIME) : source_(source) {}
+
+    /** Find the pairs of hits with low <= second - first <= high
+    * \param [in] first : the hits of the first detector
+    * \param [in] second : the hits of the second detector
+    * \param [in] low : the lower edge of the window, e.g. negative for
+    *   second hits coming before the first
+    * \param [in] high : the upper edge of the window
+    * \return the pairs, which are valid until the next join */
+    const std::vector<Pair> &Join(const std::vector<ChanEvent*> &first,
+                                  const std::vector<ChanEvent*> &second,
+                                  double low, double high);
+
+    /** Find the pairs of hits of two summaries with
+    * low <= second - first <= high
+    * \param [in] first : the summary of the first detector
+    * \param [in] second : the summary of the second detector
+    * \param [in] low : the lower edge of the window
+    * \param [in] high : the upper edge of the window
+    * \return the pairs, which are valid until the next join */
+    const std::vector<Pair> &Join(const DetectorSummary &first,
+                                  const DetectorSummary &second,
+                                  double low, double high);
+
+    /** \return the pairs of the last join */
+    const std::vector<Pair> &GetPairs() const { return pairs_; }
+
+private:
+    /** A hit and the time which is compared */
+    struct Hit {
+        double time; //!< the time of the hit
+        ChanEvent *chan; //!< the hit
+        /** \return true if the hit comes before another */
+        bool operator<(const Hit &rhs) const { return time < rhs.time; }
+    };
+
+    /** Copy the hits with their times and sort them by time
+    * \param [in] chans : the hits
+    * \param [out] hits : the sorted hits */
+    void Sort(const std::vector<ChanEvent*> &chans,
+              std::vector<Hit> &hits) const;
+
+    TimeSource source_; //!< the time of the hits which is compared
+    std::vector<Hit> first_; //!< the sorted hits of the first list
+    std::vector<Hit> second_; //!< the sorted hits of the second list
+    std::vector<Pair> pairs_; //!< the pairs of the last join
+};
+
+#endif // __COINCIDENCEJOIN_HPP__
@@ -15,6 +15,7 @@
 #include "Plots.hpp"
 #include "DammPlotIds.hpp"
 #include "Globals.hpp"
+#include "PixelMap.hpp"
 
 class LogicProcessor;
 class RawEvent;
@@ -82,9 +83,9 @@ public:
 /*!
   \brief correlate decays with previous implants
 
-  The class controls the correlations of decays with previous implants.  There
-  are arrays of size MAX_STRIP %x MAX_STRIP that store implants and decays.
-  When an event has been identified as either an implant or decay, its
+  The class controls the correlations of decays with previous implants.  The
+  implants and decays are stored in a sparse map of the pixels, where a list is
+  only created for a pixel once it has fired.  When an event has been identified as either an implant or decay, its
   information is placed in the appropriate array based on its pixel location.
   If a decay was identified, it is correlated with a previous implant.  The
   correlator checks to make sure that the time between implants is
@@ -101,8 +102,10 @@ public:
 		      DECAY_TOO_LATE       = 48,
 		      IMPLANT_TOO_SOON     = 52,
 		      UNKNOWN_CONDITION    = 100};
-    /** Default Constructor */
-    Correlator();
+    /** Constructor taking the size of the detector
+     * \param [in] sizeX : the number of front strips
+     * \param [in] sizeY : the number of back strips */
+    Correlator(unsigned int sizeX = arraySize, unsigned int sizeY = arraySize);
     /** Default Destructor */
     virtual ~Correlator();
 
@@ -160,6 +163,9 @@ public:
      * \return true if it is flagged */
     bool IsFlagged(int fch, int bch);
 
+    /** \return the number of bytes held by the lists of the pixels */
+    size_t GetMemory(void) const;
+
     /** \return The conditions for correlation */
     EConditions GetCondition(void) const {
         return condition;
@@ -197,7 +203,7 @@ private:
         histo.DeclareHistogram2D(dammId, xSize, ySize, title);
     }
 
-    static const size_t arraySize = 40; /**< Size of the 2D array to hold the decay lists */
+    static const size_t arraySize = 40; /**< Default number of strips on each side */
 
     static const double minImpTime; /**< The minimum amount of time that must
 				       pass before an implant will be considered
@@ -212,6 +218,6 @@ private:
     EventInfo   *lastDecay;    ///< last decay procssed by correlator
 
     EConditions condition;     ///< condition for last processed event
-    CorrelationList decaylist[arraySize][arraySize]; ///< list of event data for a particular pixel since implant
+    PixelMap<CorrelationList> decaylist; ///< list of event data for a particular pixel since implant
 };
 #endif // __CORRELATOR_PROCESSOR_HPP_
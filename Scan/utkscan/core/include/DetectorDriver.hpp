@@ -33,6 +33,8 @@
 #ifndef __DETECTORDRIVER_HPP_
 #define __DETECTORDRIVER_HPP_
 
+#include <atomic>
+#include <mutex>
 #include <set>
 #include <string>
 #include <utility>
@@ -40,15 +42,23 @@
 
 #include "Calibrator.hpp"
 #include "ChanEvent.hpp"
+#include "GainTracker.hpp"
 #include "Globals.hpp"
+#include "MapCache.hpp"
 #include "Messenger.hpp"
+#include "OutputService.hpp"
+#include "PerfCounters.hpp"
 #include "Plots.hpp"
+#include "ProcessorGraph.hpp"
+#include "Profiler.hpp"
+#include "SpillFills.hpp"
+#include "TraceAnalyzer.hpp"
 #include "WalkCorrector.hpp"
 
+class AnalysisCache;
 class Calibration;
 class RawEvent;
 class EventProcessor;
-class TraceAnalyzer;
 
 /*! \brief DetectorDriver controls event processing
 
@@ -63,6 +73,7 @@ public:
 
     WalkCorrector walk; //!< Instance of the walk correction
     Calibrator cali;//!< Instance of the calibrator
+    OutputService output;//!< Record streams of the processors
     Plots histo;//!< Instance of the histogram class
 
     /*! \brief Plots into histogram defined by dammId
@@ -76,6 +87,29 @@ public:
         histo.Plot(dammId, val1, val2, val3, name);
     }
 
+    /*! \brief Plots into the histogram of a channel with its handle
+    * \param [in] handles : the handles of a spectrum for every channel
+    * \param [in] id : the index of the channel
+    * \param [in] val1 : the x value */
+    void plot(const std::vector<Plots::Handle> &handles, int id,
+              double val1) {
+        if (id >= 0 && (size_t)id < handles.size())
+            histo.Plot(handles[id], val1);
+    }
+
+    /*! \brief Count a hit into the spectra of the raw statistics: the hit
+    * spectrum, the run time in seconds and milliseconds and the scalar of
+    * the channel. The fills are added up until CommitSpillFills.
+    * \param [in] id : the index of the channel
+    * \param [in] runTimeSecs : the time of the hit since the start of the
+    * run in seconds */
+    void PlotRawStats(int id, double runTimeSecs);
+
+    /*! Plot the fills of the diagnostic spectra counted for every hit since
+    * the last commit, see SpillFills. Called at the end of each spill and
+    * of the scan, from the thread which processes the raw events. */
+    void CommitSpillFills(void) { spillFills_.Commit(); }
+
     /*! \brief Control of the event processing
     *
     * The ProcessEvent() function is called from ScanList() in PixieStd.cpp
@@ -90,9 +124,23 @@ public:
     * \param [in] rawev : the raw event to process */
     void ProcessEvent(RawEvent& rawev);
 
+    /*! Run every trace analyzer on all of the traces of the event at once,
+     * so that the analyzers can share their setup between the traces
+     * \param [in] rawev : the raw event with the traces to analyze */
+    void AnalyzeTraces(RawEvent& rawev);
+
+    /*! Decide for each detector type which trace analyzers have to run.
+     * The fields read by the DetectorDriver itself and by the processors
+     * which use the type are needed, and an analyzer is run if it writes a
+     * needed field, in which case the fields it reads are needed as well.
+     * Analyzers and processors which did not declare their fields are
+     * assumed to need everything. */
+    void BuildAnalysisPlan(void);
+
     /*! \brief Check threshold and calibrate each channel.
-     * Check the thresholds and calibrate the energy for each channel using the
-     * calibrations contained in the calibration vector filled during ReadCal()
+     * Check the thresholds and queue the energy of each channel to be
+     * calibrated, using the calibrations filled during ReadCal(), together
+     * with the rest of the event in ProcessEvent()
      * \param [in] chan : the channel to do the calibration on
      * \param [in] rawev : the raw event to write the information into
      * \return an unused integer (maybe change to void) */
@@ -125,6 +173,16 @@ public:
      * not succesful */
     void SanityCheck(void) const {};
 
+    /** Add the calibrate, analyze, process and fill stages of ProcessEvent
+    * to the stage timers of the scan
+    * \param [in] perf : the stage timers of the Unpacker */
+    void SetPerf(PerfCounters *perf);
+
+    /** Read the results of the trace analyzers from a cache, or write them
+    * to it, see AnalysisCache
+    * \param [in] cache : the open cache, NULL to always run the analyzers */
+    void SetAnalysisCache(AnalysisCache *cache) { analysisCache_ = cache; }
+
     /** Correlates the pixie clock to the wall clock
      * \param [in] d : the pixie time to correlate
      * \param [in] t : the wall time to correlate */
@@ -135,8 +193,7 @@ public:
     /** \return The wall time
      * \param [in] d : the pixie time to convert to wall time */
     time_t GetWallTime(double d) const {
-        return (time_t)((d - pixieToWallClock.first) *
-                        Globals::get()->clockInSeconds() +
+        return (time_t)((d - pixieToWallClock.first) * run_.clockInSeconds +
                         pixieToWallClock.second);
     }
 
@@ -152,6 +209,15 @@ public:
     /** \return the set of detectors used in the analysis */
     const std::set<std::string> &GetUsedDetectors(void) const;
 
+    /** Read the energy calibrations, walk corrections and timing
+     * calibrations of a configuration file and queue them to replace the
+     * current ones before the next raw event, without initializing anything
+     * again, so the spectra are kept. The channel map of the file must be
+     * the one being scanned. Called from the command thread of a scan.
+     * \param [in] fileName : the configuration file to read
+     * \return true if the file was read and its constants queued */
+    bool ReloadCalibrations(const std::string &fileName);
+
     /** Default Destructor - Not called due to singleton nature */
     virtual ~DetectorDriver();
 private:
@@ -161,6 +227,12 @@ private:
     DetectorDriver& operator= (DetectorDriver const&);//!< Equality constructor
     static DetectorDriver* instance;//!< The only instance of DetectorDriver
 
+    /** \return the index of the place of the channel in the TreeCorrelator,
+     * or -1 if the channel has no place. The index is looked up by name the
+     * first time the channel is seen.
+     * \param [in] chan : the channel */
+    int ChannelPlace(const ChanEvent *chan);
+
     std::vector<EventProcessor*> vecProcess; /**< vector of processors to handle each event */
 
     std::vector<TraceAnalyzer*> vecAnalyzer; /**< object which analyzes traces of channels to extract
@@ -168,8 +240,43 @@ private:
     std::set<std::string> knownDetectors; /**< list of valid detectors that can
                    be used as detector types */
     std::string cfg_; //!< The configuration file to read
+    RunConstants run_; //!< Constants of the run, copied at construction
     std::pair<double, time_t> pixieToWallClock; /**< rough estimate of pixie to wall clock */
 
+    std::vector<ChanEvent*> calEvents_; //!< Channels of the event queued for calibration
+    std::vector<int> calIndex_; //!< Channel index of each queued channel
+    std::vector<double> calRaw_; //!< Energy of each queued channel
+    std::vector<double> calEnergy_; //!< Calibrated energy of each queued channel
+    std::vector<TraceAnalyzer::Hit> traceHits_; //!< Traces of the event, sorted by type
+    std::vector<TraceAnalyzer::Hit> planHits_; //!< Traces of the event an analyzer runs on
+    std::map<std::string, std::vector<bool> > analysisPlan_; //!< Analyzers run on each type
+    std::vector<bool> runsOnAll_; //!< True if the analyzer runs on every type
+
+    unsigned int numThreads_; //!< Number of threads to run the processors on
+    bool deterministic_; //!< True to make the results independent of the threads
+    Profiler profiler_; //!< Time spent in the processors and analyzers
+    std::vector<unsigned int> analyzerTimers_; //!< Profiler id of each analyzer
+    PerfCounters *perf_; //!< Stage timers of the scan, may be NULL
+    unsigned int calibrateStage_; //!< Stage id of the calibration
+    unsigned int analyzeStage_; //!< Stage id of the trace analysis
+    unsigned int processStage_; //!< Stage id of the processors
+    unsigned int fillStage_; //!< Stage id of merging the buffered fills
+    ProcessorGraph procGraph_; //!< Runs the processors of each event
+    std::vector<Plots::Handle> rawEnergyPlots_; //!< Raw energy spectrum of each channel
+    SpillFills spillFills_; //!< Fills of the spectra plotted for every hit, committed once per spill
+    size_t hitSpectrumSlot_; //!< Slot of D_HIT_SPECTRUM in spillFills_
+    size_t hasTraceSlot_; //!< Slot of D_HAS_TRACE in spillFills_
+    size_t runTimeSecSlot_; //!< Slot of DD_RUNTIME_SEC in spillFills_
+    size_t runTimeMsecSlot_; //!< Slot of DD_RUNTIME_MSEC in spillFills_
+    std::vector<size_t> filterEnergySlots_; //!< Slot of the filter energy spectrum of each channel
+    std::vector<size_t> scalarSlots_; //!< Slot of the scalar spectrum of each channel
+    std::vector<Plots::Handle> calEnergyPlots_; //!< Calibrated energy spectrum of each channel
+    std::vector<int> channelPlaces_; //!< Place index of each channel, -2 until looked up
+    int skimPlace_; //!< Index of the place which selects the skimmed events, -1 if none
+    AnalysisCache *analysisCache_; //!< Cached results of the analyzers, may be NULL
+    GainTracker gainTracker_; //!< Corrects the gain drift of the channels
+    std::vector<ChanEvent*> traceEvents_; //!< Channels of the traces analyzed in the event
+
 
     /*! Declares a 1D histogram calls the C++ wrapper for DAMM
     * \param [in] dammId : The histogram number to define
@@ -193,10 +300,26 @@ private:
      * \param [in] m : the messenger to pass the loading messages through */
     void LoadProcessors(Messenger& m);
 
-    /** Read in the Calibration parameters from the Config.xml */
-    void ReadCalXml();
-    /** Read in the Walk correction parameters from the Config.xml */
-    void ReadWalkXml();
+    /** Read in the Calibration parameters from the Config.xml
+     * \param [in] channels : the channels of the Map section
+     * \param [out] cal : the calibrator to add the channels to
+     * \param [in] verbose : print the calibration of each channel */
+    void ReadCalXml(const std::vector<MapCache::Channel> &channels,
+                    Calibrator &cal, bool verbose);
+    /** Read in the Walk correction parameters from the Config.xml
+     * \param [in] channels : the channels of the Map section
+     * \param [out] corr : the corrector to add the channels to
+     * \param [in] verbose : print the correction of each channel */
+    void ReadWalkXml(const std::vector<MapCache::Channel> &channels,
+                     WalkCorrector &corr, bool verbose);
+
+    /** Swap in the constants queued by ReloadCalibrations */
+    void ApplyReload(void);
+
+    struct PendingCalibrations;
+    std::mutex reloadMutex_; //!< Guards pendingCals_
+    PendingCalibrations *pendingCals_; //!< Constants queued by ReloadCalibrations, NULL if none
+    std::atomic<bool> reloadPending_; //!< True if pendingCals_ is set, tested on every raw event
 };
 
 #endif // __DETECTORDRIVER_HPP_
@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "Identifier.hpp"
+#include "LocationSet.hpp"
 #include "RawEvent.hpp"
 
 ///Predefine the RawEvnent class
@@ -60,6 +61,20 @@ public:
      * \return the set of locations for a given type, subtype */
     const std::set<int> &GetLocations(const std::string &type,
                                       const std::string &subtype) const;
+    /** Get the locations of a type and subtype as a bitset, whose membership
+     * tests and iteration need no tree walk. The ids are resolved once with
+     * Identifier::NameId and the set kept by the caller.
+     * \param [in] typeId : the interned id of the type
+     * \param [in] subtypeId : the interned id of the subtype
+     * \return the locations, empty if the type and subtype are not used */
+    const LocationSet &GetLocationSet(unsigned int typeId,
+                                      unsigned int subtypeId) const;
+    /** Get the locations of a type and subtype as a bitset
+     * \param [in] type : the type to look for
+     * \param [in] subtype : the subtype to look for
+     * \return the locations, empty if the type and subtype are not used */
+    const LocationSet &GetLocationSet(const std::string &type,
+                                      const std::string &subtype) const;
     /** Get the next undefined location of a given Identifier
      * \param [in] id : The Identifier you want the the next location for
      * \return the id for the locaton */
@@ -120,6 +135,11 @@ public:
     const std::set<std::string>& GetKnownDetectors(void);
     /** \return the used detectors */
     const std::set<std::string>& GetUsedDetectors(void) const;
+    /** \return true if a channel of the type is in the map
+     * \param [in] typeId : the interned id of the type */
+    bool IsUsed(unsigned int typeId) const {
+        return typeId < usedTypeIds.size() && usedTypeIds[typeId];
+    }
 
     typedef std::string mapkey_t; //!< typedef for a mapkey
 
@@ -138,14 +158,22 @@ private:
      * \return the constructed map key */
     mapkey_t MakeKey(const std::string &type, const std::string &subtype) const;
 
+    /** Add the location of an Identifier to the locations of its type and
+     * subtype
+     * \param [in] id : the Identifier to add */
+    void AddLocation(const Identifier &id);
+
     std::map< mapkey_t, std::set<int> > locations; ///< collection of all used locations for a given type and subtype
     static std::set<int> emptyLocations; ///< dummy locations to return when map key does not exist
+    std::vector< std::vector<LocationSet> > locationSets; ///< locations indexed by type id and subtype id
+    static LocationSet emptyLocationSet; ///< dummy locations to return when the type and subtype are not used
 
     unsigned int numModules;//!< number of modules
     unsigned int numPhysicalModules; //!< number of physical modules
 
     std::set<std::string> usedTypes;//!< used types
     std::set<std::string> usedSubtypes; //!< used subtypes
+    std::vector<bool> usedTypeIds; //!< true for the interned ids of the used types
     std::set<std::string> knownDetectors; //!< known detectors in the analysis
 };
 #endif // __DETECTORLIBRARY_HPP_
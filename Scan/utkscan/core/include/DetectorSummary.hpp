@@ -27,6 +27,10 @@ class ChanEvent;
  * pointers to all channels of this type are stored in a vector, as well as the
  * channel event where the maximum energy was deposited.  Lastly, the detector
  * summary records the detector name to which it applies.
+ *
+ * A summary attached to the channel list of a raw event is filled from the
+ * list the first time it is read after the list has changed, so summaries
+ * that are not read in an event cost nothing.
  */
 class DetectorSummary {
 public:
@@ -41,35 +45,69 @@ public:
     /** Zero the summary */
     void Zero();
 
+    /** Attach the summary to the channel list of a raw event. The summary
+     * is filled from the list whenever it is read after the generation
+     * counter of the list has changed.
+     * \param [in] fullList : the full list of channels in the event
+     * \param [in] generation : counter which is changed whenever the list changes
+     * \param [in] channels : true for each DetectorLibrary index which belongs
+     *    in the summary */
+    void Attach(const std::vector<ChanEvent*> *fullList,
+                const unsigned long *generation,
+                const std::vector<bool> &channels);
+
+    /** Fill the summary from the attached channel list, if the list has
+     * changed since the summary was last filled */
+    void Update(void) const {
+        if (source && filled != *sourceGeneration)
+            Fill();
+    }
+
     /** Add an event to the summary
      * \param [in] ev : the event to add */
     void AddEvent(ChanEvent *ev);
 
-    /** Set the detector name
+    /** Set the detector name, of the form type[:subtype[:tag]]
      * \param [in] a : the name of the detector */
-    void SetName(const std::string& a) {name = a;}
+    void SetName(const std::string& a) {name = a; ParseName();}
+
+    /** Check if a channel belongs in the summary
+     * \param [in] id : the identifier of the channel
+     * \return true if the type, and the subtype and tag if given, match */
+    bool Matches(const Identifier &id) const;
 
     /** \return the max event in the summary (constant) */
-    const ChanEvent* GetMaxEvent(void) const {return maxEvent;};
+    const ChanEvent* GetMaxEvent(void) const {Update(); return maxEvent;};
 
     /** \return the max event with the ability to change it
      * \param [in] fake : a bool to allow overloading the function name */
-    ChanEvent* GetMaxEvent(bool fake) {return maxEvent;};
+    ChanEvent* GetMaxEvent(bool fake) {Update(); return maxEvent;};
 
     /** \return the multiplicity of the summary */
-    int GetMult() const {return eventList.size();}
+    int GetMult() const {Update(); return eventList.size();}
 
     /** \return get the detector name */
     const std::string& GetName() const {return name;};
 
     /** \return the list of al channels in the raw event with this detector type */
-    const std::vector<ChanEvent*>& GetList() const {return eventList;};
+    const std::vector<ChanEvent*>& GetList() const {Update(); return eventList;};
 private:
     std::string name;                  /**< name associated with this summary */
     std::string type;                  /**< detector type associated with this summary */
     std::string subtype;               /**< detector subtype associated with this summary */
     std::string tag;               /**< detector tag associated with this summary */
-    std::vector<ChanEvent*> eventList; /**< list of events associated with this detector group */
-    ChanEvent* maxEvent;               /**< event with maximum energy deposition */
+    unsigned int typeId;           /**< interned id of the type */
+    unsigned int subtypeId;        /**< interned id of the subtype */
+    unsigned int tagId;            /**< interned id of the tag */
+    mutable std::vector<ChanEvent*> eventList; /**< list of events associated with this detector group */
+    mutable ChanEvent* maxEvent;               /**< event with maximum energy deposition */
+
+    const std::vector<ChanEvent*> *source;  /**< attached channel list, NULL if not attached */
+    const unsigned long *sourceGeneration;  /**< generation counter of the attached list */
+    mutable unsigned long filled;           /**< generation of the list the summary was filled from */
+    std::vector<bool> channels;             /**< DetectorLibrary indices which belong in the summary */
+
+    void ParseName(void); /**< Split the name into the type, subtype and tag */
+    void Fill(void) const; /**< Fill the summary from the attached channel list */
 };
 #endif
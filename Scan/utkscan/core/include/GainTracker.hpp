@@ -0,0 +1,107 @@
+/** \file GainTracker.hpp
+ * \brief Tracks the gain drift of the channels on a reference line and
+ * corrects it in the calibration while scanning
+ */
+#ifndef __GAINTRACKER_HPP__
+#define __GAINTRACKER_HPP__
+
+#include <ostream>
+#include <vector>
+
+#include "Plots.hpp"
+
+class Calibrator;
+class DetectorLibrary;
+
+/** \brief Corrects the gain drift of long runs while scanning
+ *
+ * Every channel of a detector type given in the GainTracking node of the
+ * configuration follows one reference line. The calibrated energies which
+ * fall in the window around the line are summed, which is all the work
+ * done per hit. Once per interval the mean of the window of each channel
+ * with enough counts gives the position of the line, and the gain of the
+ * channel in the Calibrator is scaled by the ratio of the line to that
+ * position. Since the window is centered on the line the mean underestimates
+ * a shift, so a sudden jump is followed over a few intervals, while a slow
+ * drift is followed as it happens.
+ *
+ * The energies around the line of each tracked channel are plotted against
+ * the interval number in DD_GAIN_DRIFT + channel index, and the gain of
+ * every tracked channel in ten thousandths in DD_GAIN_HISTORY, with the
+ * order of the tracked channel on the y axis.
+ */
+class GainTracker {
+public:
+    /** Default constructor, tracking nothing */
+    GainTracker();
+
+    /** Find the channels with a reference line and declare their plots
+     * \param [in] lib : the channels of the map
+     * \param [in] histo : the histograms of the DetectorDriver */
+    void Init(const DetectorLibrary &lib, Plots &histo);
+
+    /** \return true if no channel is tracked */
+    bool empty() const { return channels_.empty(); }
+
+    /** Start an event, correcting the gains if an interval has passed since
+     * the last correction
+     * \param [in] time : the time of the event in pixie clock ticks
+     * \param [in] cali : the calibration to correct */
+    void Advance(double time, Calibrator &cali) {
+        if (time >= next_)
+            Update(time, cali);
+    }
+
+    /** Add the calibrated energy of a hit
+     * \param [in] index : the channel index, module * 16 + channel
+     * \param [in] energy : the calibrated energy */
+    void Add(int index, double energy) {
+        if (index < 0 || index >= (int)tracked_.size() || tracked_[index] < 0)
+            return;
+        Channel &chan = channels_[tracked_[index]];
+        double diff = energy - chan.line;
+        if (diff < -chan.window || diff >= chan.window)
+            return;
+        chan.sum += diff;
+        chan.count++;
+        histo_->Plot(chan.drift, interval_,
+                     (diff / chan.window + 1) * driftBins / 2);
+    }
+
+    /** Print the final gain of every tracked channel
+     * \param [in] out : the stream to print to */
+    void Print(std::ostream &out) const;
+
+private:
+    static const int driftBins = 128; //!< y bins of the drift plots
+
+    //! A tracked channel
+    struct Channel {
+        int index; //!< the channel index, module * 16 + channel
+        double line; //!< the energy of the reference line
+        double window; //!< the half width of the window around the line
+        double sum; //!< the sum of the energies in the window minus the line
+        unsigned int count; //!< the number of energies in the window
+        double gain; //!< the gain correction of the channel
+        unsigned int updates; //!< the number of corrections of the gain
+        Plots::Handle drift; //!< the energies around the line vs time
+    };
+
+    /** Correct the gains of the channels with enough counts and start the
+     * next interval
+     * \param [in] time : the time of the event in pixie clock ticks
+     * \param [in] cali : the calibration to correct */
+    void Update(double time, Calibrator &cali);
+
+    std::vector<Channel> channels_; //!< the tracked channels
+    std::vector<int> tracked_; //!< position in channels_ of each channel index, -1 if not tracked
+    Plots *histo_; //!< the histograms of the DetectorDriver
+    Plots::Handle history_; //!< the gains vs time
+    double interval_; //!< the number of the current interval
+    double length_; //!< the length of an interval in clock ticks
+    double start_; //!< the time of the first event, -1 before it
+    double next_; //!< the time of the next correction
+    unsigned int minCounts_; //!< the counts needed to correct a gain
+};
+
+#endif // __GAINTRACKER_HPP__
@@ -0,0 +1,129 @@
+/** \file GammaCube.hpp
+ * \brief A sparse, symmetric gamma-gamma-gamma coincidence cube
+ *
+ * A full cube of 4096 bins per axis takes 256 GB with 4 byte bins (45 GB
+ * even when only the sorted sixth is kept), while the triples of a run fill
+ * only a tiny part of it. The cube is therefore kept as a hash of the bins
+ * which were filled: every triple is sorted, so the six permutations of the
+ * same energies share one entry, and the sorted bins are packed into a 64
+ * bit key. The hash uses open addressing with linear probing, so an entry
+ * takes 12 bytes and a fill is a single probe most of the time.
+ *
+ * The cube is written as the sorted keys, each stored as a variable length
+ * difference to the previous one, followed by its count, so the file is
+ * usually a few bytes per entry. The gated projections are done by the
+ * ProjectCube functions of HisProjections.hpp.
+ */
+#ifndef __GAMMACUBE_HPP__
+#define __GAMMACUBE_HPP__
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+//! Sparse, symmetric cube of the triple gamma coincidences
+class GammaCube {
+public:
+    static const unsigned int maxSize = 1 << 21; //!< the largest number of bins per axis
+
+    /** Constructor
+     * \param [in] size : the number of bins per axis, at most maxSize
+     * \param [in] binWidth : the energy (in keV) of a bin */
+    GammaCube(unsigned int size = 4096, double binWidth = 1.0);
+
+    /** Add a triple coincidence, the bins may be given in any order. Bins
+     * outside of the cube are ignored.
+     * \param [in] x : the bin of the first gamma
+     * \param [in] y : the bin of the second gamma
+     * \param [in] z : the bin of the third gamma
+     * \param [in] weight : the number of counts to add */
+    void Add(unsigned int x, unsigned int y, unsigned int z,
+             uint32_t weight = 1);
+
+    /** \return the counts of a triple, the bins may be given in any order
+     * \param [in] x : the bin of the first gamma
+     * \param [in] y : the bin of the second gamma
+     * \param [in] z : the bin of the third gamma */
+    uint32_t Get(unsigned int x, unsigned int y, unsigned int z) const;
+
+    /** Remove every entry */
+    void Clear();
+
+    /** \return the number of bins per axis */
+    unsigned int GetSize() const { return size_; }
+
+    /** \return the energy (in keV) of a bin */
+    double GetBinWidth() const { return binWidth_; }
+
+    /** \return the number of filled entries (sorted triples) */
+    size_t GetNumEntries() const { return used_; }
+
+    /** \return the number of triples added */
+    unsigned long long GetTotal() const { return total_; }
+
+    /** \return the number of slots of the hash, filled or empty */
+    size_t GetNumSlots() const { return keys_.size(); }
+
+    /** Read a slot of the hash
+     * \param [in] slot : the slot to read, below GetNumSlots()
+     * \param [out] x : the lowest bin of the triple
+     * \param [out] y : the middle bin of the triple
+     * \param [out] z : the highest bin of the triple
+     * \return the counts of the slot, zero if it is empty */
+    uint32_t GetSlot(size_t slot, unsigned int &x, unsigned int &y,
+                     unsigned int &z) const {
+        if (keys_[slot] == 0)
+            return 0;
+        Unpack(keys_[slot], x, y, z);
+        return counts_[slot];
+    }
+
+    /** Write the cube to a file
+     * \param [in] name : the name of the file
+     * \return false if the file could not be written */
+    bool Write(const std::string &name) const;
+
+    /** Read a cube written by Write, replacing this one
+     * \param [in] name : the name of the file
+     * \return false if the file could not be read */
+    bool Read(const std::string &name);
+
+private:
+    /** \return the key of a sorted triple, never zero
+     * \param [in] x : the lowest bin
+     * \param [in] y : the middle bin
+     * \param [in] z : the highest bin */
+    static uint64_t Pack(unsigned int x, unsigned int y, unsigned int z) {
+        return (((uint64_t)x << 42) | ((uint64_t)y << 21) | z) + 1;
+    }
+
+    /** Unpack a key into its sorted triple
+     * \param [in] key : the key
+     * \param [out] x : the lowest bin
+     * \param [out] y : the middle bin
+     * \param [out] z : the highest bin */
+    static void Unpack(uint64_t key, unsigned int &x, unsigned int &y,
+                       unsigned int &z) {
+        key -= 1;
+        x = (key >> 42) & (maxSize - 1);
+        y = (key >> 21) & (maxSize - 1);
+        z = key & (maxSize - 1);
+    }
+
+    /** \return the slot of a key, which is empty if the key is not stored
+     * \param [in] key : the key to look up */
+    size_t Find(uint64_t key) const;
+
+    /** Double the number of slots and insert the entries again */
+    void Grow();
+
+    unsigned int size_; //!< the number of bins per axis
+    double binWidth_; //!< the energy of a bin in keV
+    size_t used_; //!< the number of filled slots
+    unsigned long long total_; //!< the number of triples added
+    std::vector<uint64_t> keys_; //!< the key of each slot, zero if empty
+    std::vector<uint32_t> counts_; //!< the counts of each slot
+};
+
+#endif // __GAMMACUBE_HPP__
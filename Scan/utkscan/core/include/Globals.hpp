@@ -151,11 +151,120 @@ namespace strings {
     }
 }
 
+/** \brief Constants of the run which are needed for every hit or event
+ *
+ * The values are copied out of Globals once the configuration has been read,
+ * so that classes on the hot path may keep their own copy instead of going
+ * through the singleton for every hit. */
+struct RunConstants {
+    double clockInSeconds; //!< the pixie clock in seconds
+    double adcClockInSeconds; //!< the adc clock in seconds
+    double filterClockInSeconds; //!< the filter clock in seconds
+    double eventInSeconds; //!< the event width in seconds
+    double neutronMass; //!< the mass of the neutron in MeV/c/c
+    double speedOfLight; //!< the speed of light in cm/ns
+    double speedOfLightSmall; //!< speed of light in small VANDLE bars in cm/ns
+    double speedOfLightMedium; //!< speed of light in medium VANDLE bars in cm/ns
+    double speedOfLightBig; //!< speed of light in big VANDLE bars in cm/ns
+    double smallLengthTime; //!< length of the small VANDLE bars in ns
+    double mediumLengthTime; //!< length of the medium VANDLE bars in ns
+    double bigLengthTime; //!< length of the big VANDLE bars in ns
+};
+
+/** \brief The rejection regions of a run, sorted and merged
+ *
+ * Times are in seconds from the beginning of the file. A time is rejected if
+ * it lies strictly inside a region, and overlapping regions are merged when
+ * they are added, so a time is looked up with one binary search. */
+class RejectRegions {
+public:
+    /** Add a region to reject
+    * \param [in] start : the start of the region
+    * \param [in] end : the end of the region */
+    void Add(double start, double end) {
+        regions_.push_back(std::make_pair(start, end));
+        std::sort(regions_.begin(), regions_.end());
+        std::vector<std::pair<double, double> > merged;
+        for (std::vector<std::pair<double, double> >::const_iterator it =
+                regions_.begin(); it != regions_.end(); ++it) {
+            if (!merged.empty() && it->first < merged.back().second)
+                merged.back().second = std::max(merged.back().second,
+                                                 it->second);
+            else
+                merged.push_back(*it);
+        }
+        regions_.swap(merged);
+    }
+
+    /** \return true if no regions were added */
+    bool empty() const { return regions_.empty(); }
+
+    /** \return true if a time lies inside one of the regions
+    * \param [in] time : the time to look up */
+    bool Contains(double time) const {
+        const std::pair<double, double> *region = Find(time);
+        return region && time < region->second;
+    }
+
+    /** \return true if the whole interval lies inside one of the regions
+    * \param [in] start : the start of the interval
+    * \param [in] stop : the end of the interval */
+    bool Contains(double start, double stop) const {
+        const std::pair<double, double> *region = Find(start);
+        return region && stop < region->second;
+    }
+private:
+    /** \return the last region which starts before a time, NULL if none
+    * \param [in] time : the time to look up */
+    const std::pair<double, double> *Find(double time) const {
+        std::vector<std::pair<double, double> >::const_iterator it =
+            std::lower_bound(regions_.begin(), regions_.end(),
+                             std::make_pair(time, -HUGE_VAL));
+        if (it == regions_.begin())
+            return NULL;
+        return &*(it - 1);
+    }
+
+    std::vector<std::pair<double, double> > regions_; //!< sorted, disjoint regions
+};
+
+/** \brief A detector type whose hits trigger the building of raw events
+ *
+ * Times are in pixie clock ticks around the time of the trigger. */
+struct TriggerWindow {
+    std::string type; //!< the detector type of the trigger
+    std::string subtype; //!< the detector subtype, empty for all subtypes
+    unsigned int before; //!< the width of the window before the trigger
+    unsigned int after; //!< the width of the window after the trigger
+};
+
+/** \brief A reference line whose position is tracked to correct the gain
+ * drift of the channels of a detector type
+ *
+ * The energy and the window are calibrated energies. */
+struct GainLine {
+    std::string type; //!< the detector type
+    std::string subtype; //!< the detector subtype, empty for all subtypes
+    double energy; //!< the energy of the reference line
+    double window; //!< the half width of the window around the line
+};
+
+/** \brief The width of the raw event window for a detector type
+ *
+ * The width is in pixie clock ticks from the start of the window. */
+struct TypeWidth {
+    std::string type; //!< the detector type
+    std::string subtype; //!< the detector subtype, empty for all subtypes
+    unsigned int width; //!< the width of the window for the type
+};
+
 /** \brief Singleton class holding global parameters.*/
 class Globals {
 public:
     /** \return only instance of Globals class.*/
-    static Globals *get();
+    static Globals *get() {
+        return instance ? instance : get("Config.xml");
+    }
 
     /** \return only instance of Globals class.*/
     static Globals *get(const std::string &file);
@@ -168,6 +277,36 @@ public:
     /** \return true if we will define the raw histograms */
     bool hasRaw() const { return (hasRaw_); }
 
+    /** \return true if the .his file is mapped into memory and filled in
+     * place, so that it may be watched while scanning */
+    bool mappedHis() const { return (mappedHis_); }
+
+    /** \return true if the bins of the mapped .his file are incremented
+     * atomically */
+    bool atomicHis() const { return (atomicHis_); }
+
+    /** \return the number of seconds between the background checkpoints of
+     * the .his file, zero if it is written in place */
+    unsigned int checkpointInterval() const { return (checkpointInterval_); }
+
+    /** \return the port on which the histograms are served to viewers on
+     * other hosts, zero if they are not served */
+    unsigned int hisServerPort() const { return (hisServerPort_); }
+
+    /** \return the ids of the histograms which are also kept as rolling
+     * histograms over the last rollingSlices() * rollingSeconds() seconds */
+    const std::vector<unsigned int> &rollingIds() const {
+        return (rollingIds_);
+    }
+
+    /** \return the number of time slices in the window of the rolling
+     * histograms */
+    unsigned int rollingSlices() const { return (rollingSlices_); }
+
+    /** \return the length of a time slice of the rolling histograms (in
+     * seconds) */
+    unsigned int rollingSeconds() const { return (rollingSeconds_); }
+
     /** \return the adc clock in seconds */
     double adcClockInSeconds() const { return adcClockInSeconds_; }
 
@@ -275,12 +414,56 @@ public:
         return ss.str();
     }
 
+    /** \return the DAMM .ban file to load the banana gates from, empty if
+     * there is none */
+    std::string bananaFile() const { return (bananaFile_); }
+
+    /** \return true if the hits of the ignore channels are dropped by the
+     * unpacker, so that they are not in the raw spectra either */
+    bool dropIgnoredHits() const { return (dropIgnoredHits_); }
+
+    /** \return true if the selected raw events are written to a skim file */
+    bool hasSkim() const { return (hasSkim_); }
+
+    /** \return the place which selects the raw events of the skim, empty if
+     * only the events kept by the processors are written */
+    std::string skimPlace() const { return (skimPlace_); }
+
+    /** \return the name of the skim file, empty to name it after the output
+     * file */
+    std::string skimFile() const { return (skimFile_); }
+
+    /** \return the memory budget of the scan in bytes, zero if there is
+     * none */
+    unsigned long long memoryBudget() const { return (memoryBudget_); }
+
+    /** \return true if the 2-D histograms are made sparse once the scan is
+     * over its memory budget */
+    bool sparseHis() const { return (sparseHis_); }
+
+    /** \return true if the results of the trace analyzers are cached */
+    bool hasAnalysisCache() const { return (hasAnalysisCache_); }
+
+    /** \return the name of the analysis cache file, empty to name it after
+     * the output file */
+    std::string analysisCacheFile() const { return (analysisCacheFile_); }
+
     /** \return the revision for the data */
     std::string revision() const { return (revision_); }
 
     /** \return the configuration file */
     std::string configfile() const { return (configFile_); }
 
+    /** \return the parsed configuration file, which is read only once */
+    const pugi::xml_document &configdoc() const { return (configDoc_); }
+
+    /** \return the hash of the contents of the configuration file */
+    uint64_t confighash() const { return (configHash_); }
+
+    /** \return the hash of the parts of the configuration which the trace
+     * analyzers depend on */
+    uint64_t analyzerhash() const { return (analyzerHash_); }
+
     /** \return the maximum words */
     unsigned int maxWords() const { return maxWords_; }
 
@@ -291,7 +474,40 @@ public:
     /*! \return rejection regions to exclude from scan.
      * Values should be given in seconds in respect to the beginning
      of the file */
-    std::vector<std::pair<int, int> > rejectRegions() const { return reject_; };
+    const std::vector<std::pair<int, int> > &rejectRegions() const {
+        return reject_;
+    }
+
+    /** \return the rejection regions, sorted and merged for fast lookups */
+    const RejectRegions &rejects() const { return rejects_; }
+
+    /** \return the event widths of the detector types which do not use the
+     * event width of the Unpacker */
+    const std::vector<TypeWidth> &typeWidths() const { return typeWidths_; }
+
+    /** \return the triggers of the triggered event building, empty if raw
+     * events are built from every hit */
+    const std::vector<TriggerWindow> &triggers() const { return triggers_; }
+
+    /** \return the reference lines of the gain drift tracking, empty if the
+     * gains are not tracked */
+    const std::vector<GainLine> &gainLines() const { return gainLines_; }
+
+    /** \return the time between the corrections of the gains in pixie clock
+     * ticks */
+    double gainInterval() const { return gainInterval_; }
+
+    /** \return the number of counts in the window of a line needed to
+     * correct the gain of a channel */
+    unsigned int gainMinCounts() const { return gainMinCounts_; }
+
+    /** \return the constants of the run needed for every hit or event */
+    const RunConstants &constants() const { return constants_; }
+
+    /** Hash the contents of the configuration file, or any other string
+    * \param [in] contents : the contents of the file
+    * \return the 64 bit FNV-1a hash of the contents */
+    static uint64_t HashConfig(const std::string &contents);
 private:
     /** Default Constructor */
     Globals(const std::string &file);
@@ -309,7 +525,26 @@ private:
     void WarnOfUnknownParameter(Messenger &m, pugi::xml_node_iterator &it);
 
     bool hasReject_;//!< Has a rejection region
+    RejectRegions rejects_; //!< The rejection regions, sorted and merged
+    std::vector<TriggerWindow> triggers_; //!< The triggers of the event building
+    std::vector<TypeWidth> typeWidths_; //!< The event widths of single detector types
+    std::vector<GainLine> gainLines_; //!< The reference lines of the gain tracking
+    double gainInterval_; //!< Clock ticks between the gain corrections
+    unsigned int gainMinCounts_; //!< Counts needed to correct a gain
+    RunConstants constants_; //!< Copy of the constants needed on the hot path
     bool hasRaw_; //!< True for plotting Raw Histograms in DAMM
+    bool mappedHis_; //!< True to fill the histograms in the mapped .his file
+    bool atomicHis_; //!< True to increment the mapped bins atomically
+    bool dropIgnoredHits_; //!< True to drop the ignore channels when unpacking
+    bool hasSkim_; //!< True to write the selected raw events to a skim file
+    bool hasAnalysisCache_; //!< True to cache the results of the trace analyzers
+    unsigned int checkpointInterval_; //!< Seconds between .his checkpoints
+    unsigned long long memoryBudget_; //!< Memory budget of the scan in bytes, zero for none
+    bool sparseHis_; //!< True to make the 2-D histograms sparse beyond the budget
+    unsigned int hisServerPort_; //!< Port serving the histograms, zero for none
+    std::vector<unsigned int> rollingIds_; //!< Histograms kept as rolling histograms
+    unsigned int rollingSlices_; //!< Number of slices of the rolling histograms
+    unsigned int rollingSeconds_; //!< Seconds in a slice of the rolling histograms
 
     double adcClockInSeconds_; //!< adc clock in second
     double bitResolution_;//!<The Bit resolution of the digitizer that we used.
@@ -338,7 +573,14 @@ private:
     std::map<std::string, std::pair<TrapFilterParameters, TrapFilterParameters> > trapFiltPars_; //!<Map containing all of the trapezoidal filter parameters for a given type:subtype
 
     std::string configFile_;//!< The configuration file
+    pugi::xml_document configDoc_;//!< The parsed configuration file
+    uint64_t configHash_;//!< The hash of the configuration file
+    uint64_t analyzerHash_;//!< The hash of the configuration of the analyzers
     std::string outputPath_;//!< The path to additional configuration files
+    std::string bananaFile_;//!< The .ban file with the banana gates
+    std::string skimPlace_;//!< The place which selects the skimmed events
+    std::string skimFile_;//!< The name of the skim file
+    std::string analysisCacheFile_;//!< The name of the analysis cache file
     std::string revision_;//!< the pixie revision
 
     unsigned int maxWords_;//!< maximum words in the
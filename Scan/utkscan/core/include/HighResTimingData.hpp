@@ -8,89 +8,97 @@
 
 #include "ChanEvent.hpp"
 #include "Globals.hpp"
+#include "HitArray.hpp"
 
 //! Class for holding information for high resolution timing. All times more
 //! precise than the filter time will be in nanoseconds (phase, highResTime).
+//! The values are copied from the channel and its trace once, when the class
+//! is constructed, so that the ToF loops, which ask for them again for every
+//! bar and start, read plain members instead of the trace. The channel must
+//! therefore be fully analyzed and calibrated before it is given here.
 class HighResTimingData {
 public:
     /** Default constructor */
-    HighResTimingData() {};
+    HighResTimingData() : chan_(NULL), isValid_(false), cfdSourceBit_(false),
+                          numAboveThresh_(0), aveBaseline_(0),
+                          discrimination_(0), highResTime_(0), maxPos_(0),
+                          maxVal_(0), phase_(0), filterEnergy_(0),
+                          filterTime_(0), snr_(0), stdDevBaseline_(0),
+                          traceQdc_(0), correctedTime_(0) {};
     /** Default destructor */
     virtual ~HighResTimingData() {};
 
     /** Constructor using the channel event
     * \param [in] chan : the channel event for grabbing values from */
-    HighResTimingData(ChanEvent *chan) {chan_ = chan;}
+    HighResTimingData(ChanEvent *chan) : chan_(chan) {
+        const Trace &trace = chan->GetTrace();
+        maxVal_ = trace.GetValue(Trace::MAXVAL);
+        traceQdc_ = trace.GetValue(Trace::QDC);
+        stdDevBaseline_ = trace.GetValue(Trace::SIGMA_BASELINE);
+        isValid_ = !std::isnan(maxVal_) && !std::isnan(traceQdc_) &&
+            !std::isnan(stdDevBaseline_);
+        aveBaseline_ = trace.GetValue(Trace::BASELINE);
+        discrimination_ = trace.GetValue(Trace::DISCRIM);
+        maxPos_ = trace.GetValue(Trace::MAXPOS);
+        double numAboveThresh = trace.GetValue("numAboveThresh");
+        numAboveThresh_ = std::isnan(numAboveThresh) ? 0 : numAboveThresh;
+        phase_ = trace.GetValue(Trace::PHASE) *
+            Globals::get()->clockInSeconds() * 1e9;
+        snr_ = 20 * log10(maxVal_ / stdDevBaseline_);
+        cfdSourceBit_ = chan->GetCfdSourceBit();
+        highResTime_ = chan->GetHighResTime();
+        filterEnergy_ = chan->GetEnergy();
+        filterTime_ = chan->GetTime();
+        correctedTime_ = chan->GetCorrectedTime();
+    }
 
     /** Calculate the energy from the time of flight, using a correction
     * \param [in] tof : The time of flight to use for the calculation in ns
     * \param [in] z0 : The perpendicular distance between the bar and the source in cm
     * \return The particle energy in MeV*/
     double CalcEnergy(const double &tof, const double &z0) {
-        return((0.5*Globals::get()->neutronMass()*
-                pow((z0/tof)/Globals::get()->speedOfLight(), 2)));
+        const RunConstants &run = Globals::get()->constants();
+        return((0.5*run.neutronMass*pow((z0/tof)/run.speedOfLight, 2)));
     }
 
     /** \return The channel event that holds most of our information */
     const ChanEvent* GetChan(void) const {return(chan_);}
 
     /** \return True if maxval,tqdc and sigmaBaseline were not NAN */
-    bool GetIsValid() const {
-        if(!std::isnan(chan_->GetTrace().GetValue("maxval")) &&
-           !std::isnan(chan_->GetTrace().GetValue("qdc")) &&
-           !std::isnan(chan_->GetTrace().GetValue("sigmaBaseline")) ) {
-            return(true);
-        }else
-            return(false);
-        return(false);
-    }
+    bool GetIsValid() const { return(isValid_); }
 
     ///\return the CFD source trigger bit
-    bool GetCfdSourceBit() const { return(chan_->GetCfdSourceBit());}
+    bool GetCfdSourceBit() const { return(cfdSourceBit_);}
     /** \return The current value of aveBaseline_ */
-    double GetAveBaseline() const { return(chan_->GetTrace().GetValue("baseline")); }
+    double GetAveBaseline() const { return(aveBaseline_); }
     /** \return The current value of discrimination_ */
-    double GetDiscrimination() const { return(chan_->GetTrace().GetValue("discrim")); }
+    double GetDiscrimination() const { return(discrimination_); }
     /** \return The current value of highResTime_ */
-    double GetHighResTime() const { return(chan_->GetHighResTime()); }
+    double GetHighResTime() const { return(highResTime_); }
     /** \return The current value of maxpos_ */
-    double GetMaximumPosition() const { return(chan_->GetTrace().GetValue("maxpos")); }
+    double GetMaximumPosition() const { return(maxPos_); }
     /** \return The current value of maxval_ */
-    double GetMaximumValue() const { return(chan_->GetTrace().GetValue("maxval")); }
+    double GetMaximumValue() const { return(maxVal_); }
     /** \return The current value of numAboveThresh_  */
-    int GetNumAboveThresh() const {
-        return(chan_->GetTrace().GetValue("numAboveThresh"));
-    }
+    int GetNumAboveThresh() const { return(numAboveThresh_); }
     /** \return The current value of phase_ in nanoseconds*/
-    double GetPhase() const {
-        return(chan_->GetTrace().GetValue("phase") *
-               Globals::get()->clockInSeconds() * 1e9);
-    }
+    double GetPhase() const { return(phase_); }
     /** \return The pixie Energy */
-    double GetFilterEnergy() const { return(chan_->GetEnergy()); }
+    double GetFilterEnergy() const { return(filterEnergy_); }
     /** \return The pixie Energy */
-    double GetFilterTime() const { return(chan_->GetTime()); }
+    double GetFilterTime() const { return(filterTime_); }
     /** \return The current value of snr_ */
-    double GetSignalToNoiseRatio() const {
-	return(20*log10(chan_->GetTrace().GetValue("maxval") /
-			chan_->GetTrace().GetValue("sigmaBaseline")));
-    }
+    double GetSignalToNoiseRatio() const { return(snr_); }
     /** \return The current value of stdDevBaseline_  */
-    double GetStdDevBaseline() const {
-        return(chan_->GetTrace().GetValue("sigmaBaseline"));
-    }
+    double GetStdDevBaseline() const { return(stdDevBaseline_); }
 
     /** \return Get the trace associated with the channel */
     const Trace* GetTrace() const { return(&chan_->GetTrace()); }
 
     /** \return The current value of tqdc_ */
-    double GetTraceQdc() const {
-        return(chan_->GetTrace().GetValue("qdc"));
-    }
+    double GetTraceQdc() const { return(traceQdc_); }
     /** \return Walk corrected time  */
-    double GetCorrectedTime() const {
-        return(chan_->GetCorrectedTime());
-    }
+    double GetCorrectedTime() const { return(correctedTime_); }
 
 #ifdef useroot
     struct HrtRoot {
@@ -128,8 +136,25 @@ public:
 #endif
 private:
     ChanEvent *chan_; //!< a pointer to the channel event for the high res time
+    bool isValid_; //!< true if maxval, qdc and sigmaBaseline are not NAN
+    bool cfdSourceBit_; //!< the CFD source trigger bit
+    int numAboveThresh_; //!< the number of samples above the threshold
+    double aveBaseline_; //!< the average baseline of the trace
+    double discrimination_; //!< the discrimination of the trace
+    double highResTime_; //!< the high resolution time in ns
+    double maxPos_; //!< the position of the maximum of the trace
+    double maxVal_; //!< the maximum of the trace above the baseline
+    double phase_; //!< the phase of the trace in ns
+    double filterEnergy_; //!< the pixie energy
+    double filterTime_; //!< the pixie time
+    double snr_; //!< the signal to noise ratio in dB
+    double stdDevBaseline_; //!< the standard deviation of the baseline
+    double traceQdc_; //!< the QDC of the trace
+    double correctedTime_; //!< the walk corrected time
 };
 
 /** Defines a map to hold timing data for a channel. */
 typedef std::map<TimingDefs::TimingIdentifier, HighResTimingData> TimingMap;
+/** Defines a flat array of timing data indexed by the channel id. */
+typedef HitArray<HighResTimingData> TimingArray;
 #endif // __HIGHRESTIMINGDATA_HPP__
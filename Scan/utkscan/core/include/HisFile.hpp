@@ -13,12 +13,21 @@
 #ifndef HISFILE_H
 #define HISFILE_H
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <vector>
 
+#include <string.h>
+#include <time.h>
+
+class HisServer;
+
 #ifndef USE_HRIBF
 /// Create a DAMM 1D histogram
 void hd1d_(int dammId, int nHalfWords, int rawlen, int histlen, int min, int max,
@@ -172,23 +181,6 @@ struct drr_entry{
     void print_list(std::ofstream *file_);
 };
 
-struct fill_queue{
-    drr_entry *entry; /// .drr entry of the histogram to be filled
-    unsigned int byte; /// Offset of bin (in bytes)
-    unsigned int weight; /// Weight of fill
-    bool good; /// True if the histo array index is within range
-    
-    fill_queue(drr_entry *entry_, unsigned int bin_, unsigned int w_){
-        entry = entry_;
-        byte = bin_ * entry->halfWords * 2;
-        weight = w_;
-        good = entry->check_bin(bin_);
-        if(byte < 0)
-            std::cout << " his id = " << entry_->hisID
-                      << " byte offset is less than zero (" << byte << ")!\n";
-    }
-};
-
 class HisFile{
 protected:
     bool is_good; /// True if a valid drr file is open
@@ -248,6 +240,9 @@ public:
     /// Return a pointer to the current .drr file entry
     drr_entry *GetDrrEntry(){ return current_entry; }
     
+    /// Return the map of all .drr entries, keyed by histogram ID
+    const std::map<unsigned int, drr_entry*> &GetDrrMap(){ return drrMap_; }
+    
     /// Return the date formatted as mmm dd, yyyy HH:MM
     std::string GetDate();
     
@@ -326,6 +321,12 @@ public:
 
 class OutputHisFile : public HisFile{
 private:
+    /// A range of the .his file converted from the counts, which is written in one go
+    struct his_chunk{
+        size_t offset; /// Location in the .his file (in bytes)
+        std::vector<char> bytes; /// The bins written at offset
+    };
+    
     std::fstream ofile; /// The output .his file stream
     std::string fname; /// The output filename prefix
     bool writable; /// True if the output .his file is open and writable
@@ -333,13 +334,145 @@ private:
     bool existing_file; /// True if the .his file was a previously existing file
     unsigned int Flush_wait; /// Number of fills to wait between Flushes
     unsigned int Flush_count; /// Number of fills since last Flush
-    std::vector<fill_queue*> fills_waiting; /// Vector containing list of histograms to be filled
+    /// A block of block_size counts, which may be shared with a snapshot being written
+    typedef std::shared_ptr<unsigned int> count_block;
+    
+    /// The nonzero counts of a block with few of them, as (index in the block, count) sorted by index
+    typedef std::vector<std::pair<unsigned short, unsigned int> > sparse_counts;
+    
+    /// A sparse block of counts, which may be shared with a snapshot being written
+    typedef std::shared_ptr<sparse_counts> sparse_block;
+    
+    /// A zero or a snapshot asked for by another thread than the fills
+    struct his_request{
+        bool zero; /// True to zero all histograms, false for a snapshot
+        std::string prefix; /// The filename prefix of the snapshot
+    };
+    
+    std::vector<count_block> count_blocks; /// The 32 bit counts of every histogram in blocks of block_size, NULL until a bin of the block is filled
+    size_t num_counts; /// Total number of counts of all histograms
+    std::vector<size_t> count_table; /// Index of the first count of each histogram, by histogram id
+    std::vector<drr_entry*> his_order; /// The histograms in the order of the .his file
+    std::vector<bool> dirty_blocks; /// True for the blocks of counts changed since the last Flush
+    std::vector<bool> served_blocks; /// True for the blocks of counts changed since they were last given to the server
+    std::vector<bool> snapshot_blocks; /// True for the blocks which may be shared with a snapshot, and are copied before they are changed
+    bool use_sparse; /// True if the blocks of 2-D histograms are kept sparse while they have few nonzero counts
+    std::vector<sparse_block> sparse_blocks; /// The sparse blocks of counts, by block, NULL for the dense and unfilled blocks. Empty unless use_sparse
+    std::vector<bool> sparse_allowed; /// True for the blocks holding counts of a 2-D histogram, which start sparse when filled
+    bool zero_file; /// True if the counts were zeroed and the .his file is to be truncated instead of written with zeros
+    std::thread snapshot_thread; /// Writes the snapshots in the background
+    std::mutex request_mutex; /// Guards requests
+    std::vector<his_request> requests; /// The zeros and snapshots asked for by another thread, in order
+    std::atomic<bool> has_requests; /// True if requests is not empty
+    HisServer *server; /// Serves the histograms to viewers over the network, or NULL
+    static const size_t block_size = 1024; /// Number of counts in the blocks which are allocated when filled and written by Flush
+    static const size_t sparse_limit = block_size/8; /// Number of nonzero counts beyond which a sparse block is made dense
+    std::set<unsigned int> saturated; /// Ids of the histograms with counts beyond the range of their bins
+    std::set<unsigned int> promoted; /// Ids of the histograms written with 32 bit bins because of saturation
+    bool use_map; /// True if the .his file is mapped into memory once finalized
+    bool atomic_fills; /// True if the bins of the mapped .his file are incremented atomically
+    int map_fd; /// File descriptor of the mapped .his file
+    char *map_base; /// Start of the mapped .his file, or NULL if it is not mapped
+    size_t map_size; /// Size of the mapped .his file (in bytes)
+    unsigned int checkpoint_interval; /// Seconds between background checkpoints of the .his file, zero to write it in place
+    bool use_checkpoints; /// True if the finalized .his file is written by checkpoints
+    time_t next_checkpoint; /// Time of the next checkpoint
+    std::vector<bool> shadow_blocks; /// True for the blocks of counts missing from the shadow .his file
+    std::thread checkpoint_thread; /// Writes the checkpoints in the background
+    std::atomic<bool> checkpoint_busy; /// True while a checkpoint is being written
+    std::atomic<bool> checkpoint_failed; /// True if the last checkpoint could not be written
     std::set<unsigned int> failed_fills; /// Vector containing list of histogram fills into an invalid his id
+    std::vector<drr_entry*> drr_table; /// The .drr entries indexed by histogram id, NULL for unused ids
+    
+    /// A histogram whose counts are also kept in a ring of time slices
+    struct rolling_his{
+        drr_entry *entry; /// The histogram
+        unsigned int seconds; /// Length of a slice (in seconds)
+        std::vector<std::vector<unsigned int> > slices; /// The counts of each slice, the oldest one following current
+        size_t current; /// The slice being filled
+        time_t slice_end; /// Time at which the current slice ends
+        std::vector<unsigned int> sum; /// The sum of the slices, if sum_valid
+        bool sum_valid; /// True if sum holds the sum of the slices
+        bool served; /// True if the server has the window since it last changed
+    };
+    std::vector<rolling_his> rolling; /// The histograms kept in time slices
+    std::vector<int> rolling_table; /// Index in rolling by histogram id, -1 for the others
     std::streampos total_his_size; /// Total size of .his file
     
     /// Find the specified .drr entry in the drr list using its histogram id
     drr_entry *find_drr_in_list(unsigned int hisID_);
     
+    /// Increment a bin of a histogram in memory by weight_
+    bool increment_bin(drr_entry *entry_, unsigned int bin_, unsigned int weight_);
+    
+    /// Increment a bin of a histogram in the mapped .his file by weight_
+    void increment_mapped(drr_entry *entry_, unsigned int bin_, unsigned int weight_);
+    
+    /// Return the count at index_ of blocks_ and sparse_, which is zero if its block was never filled
+    static unsigned int get_count(const std::vector<count_block> &blocks_, const std::vector<sparse_block> &sparse_, size_t index_){
+        size_t block = index_/block_size;
+        if(blocks_[block])
+            return blocks_[block].get()[index_ % block_size];
+        if(block < sparse_.size() && sparse_[block])
+            return get_sparse(*sparse_[block], index_ % block_size);
+        return 0;
+    }
+    
+    /// Return the count at index_ of a sparse block
+    static unsigned int get_sparse(const sparse_counts &counts_, unsigned short index_);
+    
+    /// Return the counts of a block which are to be changed, allocating the block, making it dense or copying it from a snapshot first if needed
+    unsigned int *own_block(size_t block_);
+    
+    /// Return the sparse counts of a block which are to be changed, copying them from a snapshot first if needed, or NULL if the block is not sparse
+    sparse_counts *own_sparse(size_t block_);
+    
+    /// Return the count at index_ which is to be changed, kept in a sparse block while it has few nonzero counts
+    unsigned int &own_count(size_t index_);
+    
+    /// Allow the blocks of a 2-D histogram to be kept sparse
+    void allow_sparse(drr_entry *entry_);
+    
+    /// Mark the counts in [start_, stop_) as changed since the last Flush
+    void mark_dirty(size_t start_, size_t stop_);
+    
+    /// Convert the counts in [start_, stop_) to the bins of the .his file, appending them to chunks_
+    void pack_counts(size_t start_, size_t stop_, std::vector<his_chunk> &chunks_){ pack_counts(count_blocks, sparse_blocks, start_, stop_, chunks_, &saturated); }
+    
+    /// Convert the counts of blocks_ and sparse_ in [start_, stop_) to the bins of the .his file, appending them to chunks_ and the ids of saturated 16 bit histograms to saturated_, if not NULL
+    void pack_counts(const std::vector<count_block> &blocks_, const std::vector<sparse_block> &sparse_, size_t start_, size_t stop_,
+                     std::vector<his_chunk> &chunks_, std::set<unsigned int> *saturated_);
+    
+    /// Write chunks_ to the shadow .his file, then rename it to the .his file. The shadow file is first emptied if zero_ is set
+    void write_checkpoint(std::vector<his_chunk> chunks_, bool zero_);
+    
+    /// Write a snapshot of the histograms to prefix_.his from blocks_ and sparse_, or from image_ if the file is mapped, and copy the .drr and .list files
+    void write_snapshot(std::string prefix_, std::vector<count_block> blocks_, std::vector<sparse_block> sparse_, std::vector<char> image_);
+    
+    /// Do the zeros and snapshots asked for by another thread
+    void do_requests();
+    
+    /// Give the histograms changed since the last publish to the server
+    void publish();
+    
+    /// Start a new time slice of the rolling histograms whose current slice ended before now_
+    void advance_rolling(time_t now_);
+    
+    /// Add up the slices of a rolling histogram, if they changed since the last sum
+    void sum_rolling(rolling_his &his_);
+    
+    /// Write the .drr and .list files describing the current layout of the .his file
+    bool write_drr();
+    
+    /// Rewrite the saturated 16 bit histograms with 32 bit bins, returning the number promoted
+    size_t promote_saturated();
+    
+    /// Map the finalized .his file into memory, returning false on failure
+    bool map_his();
+    
+    /// Unmap the .his file, leaving its contents to the page cache
+    void unmap_his();
+    
 public:
     OutputHisFile();
     
@@ -356,6 +489,101 @@ public:
     /// Set the number of fills to wait between file Flushes
     void SetFlushWait(unsigned int wait_){ Flush_wait = wait_; }
     
+    /* Map the .his file into memory when it is finalized. The fills then
+     * increment the bins of the file directly, so other programs (e.g. damm)
+     * see the spectra grow without waiting for a Flush, and the page cache
+     * writes them back. With atomic_ set the bins are incremented with
+     * atomic operations. If the file can not be mapped, the histograms are
+     * filled in memory as usual. Call before Finalize. The bins of a mapped
+     * file saturate at the largest value of their size, as they can not be
+     * promoted to 32 bits when the file is closed.
+     */
+    void SetMapped(bool mapped_, bool atomic_=false){ use_map = mapped_; atomic_fills = atomic_; }
+    
+    /* Write the .his file with background checkpoints every interval_
+     * seconds, and at every Flush, instead of writing it in place. The
+     * changed blocks are copied and written by another thread to a shadow
+     * file (.his.tmp), which is then renamed to the .his file, so a crash
+     * leaves the last complete checkpoint and the fills never wait for the
+     * disk. Not used if the file is mapped.
+     * Call before Finalize.
+     */
+    void SetCheckpoint(unsigned int interval_){ checkpoint_interval = interval_; }
+    
+    /* Start a checkpoint of the .his file. If a checkpoint is still being
+     * written, nothing is done, unless wait_ is set, in which case the
+     * checkpoint is written before returning.
+     */
+    void Checkpoint(bool wait_=false);
+
+    /* Write the counts of every histogram to out_, so that a scan can be
+     * resumed from them with LoadCounts. The full 32 bit counts are written,
+     * only for the blocks which were filled, or the bins of the file if it is
+     * mapped. Call after Finalize.
+     */
+    bool SaveCounts(std::ostream &out_);
+
+    /* Read the counts written by SaveCounts into the histograms, which must
+     * have the same layout and must both be mapped or not. The histograms are
+     * written to the .his file at the next Flush.
+     */
+    bool LoadCounts(std::istream &in_);
+
+    /* Serve the histograms to viewers on other hosts with server_, which
+     * is given the histograms changed since the last Flush at every Flush,
+     * and the layout of the .his file whenever it changes. The server is
+     * not deleted by OutputHisFile. Call before Finalize.
+     */
+    void SetServer(HisServer *server_){ server = server_; }
+    
+    /// Return true if the .his file is mapped into memory
+    bool IsMapped(){ return (map_base != NULL); }
+    
+    /* Keep the blocks of counts of 2-D histograms sparse while they have few
+     * nonzero counts, as a sorted list of (bin, count) which takes 8 bytes
+     * per nonzero bin instead of 4 bytes per bin. A sparse block is made
+     * dense once it holds more than sparse_limit counts. Mostly empty 2-D
+     * histograms then take a fraction of their memory, at the cost of
+     * slower fills. Only applies to the blocks filled after the call, see
+     * Sparsify for those filled before. Not used if the file is mapped.
+     */
+    void SetSparse(bool sparse_);
+    
+    /// Return true if the blocks of 2-D histograms are kept sparse
+    bool IsSparse(){ return use_sparse; }
+    
+    /* Make the dense blocks of 2-D histograms with few nonzero counts
+     * sparse, if SetSparse was called. Returns the number of bytes freed.
+     */
+    size_t Sparsify();
+    
+    /* Return the number of bytes of memory held by the counts of a
+     * histogram, including its rolling slices. The blocks shared with other
+     * histograms are counted in proportion to the bins of the histogram.
+     * Returns zero if the histogram does not exist.
+     */
+    size_t GetMemory(unsigned int hisID_);
+    
+    /// Return the number of bytes of memory held by the counts of all histograms
+    size_t GetMemory();
+    
+    /* Keep the counts of a histogram in a ring of slices_ time slices of
+     * seconds_ seconds each, besides its counts in the .his file, so that
+     * the counts of the last slices_*seconds_ seconds (e.g. the last five
+     * minutes) may be watched for drifts. A fill only adds to the current
+     * slice, the slices are added up when the window is asked for, and the
+     * oldest slice is zeroed and reused when a slice ends. The ring takes
+     * slices_ times 4 bytes per bin. The window is given to the server at
+     * every Flush in which it changed. Call once the histogram is declared.
+     * Returns false if the histogram does not exist.
+     */
+    bool SetRolling(unsigned int hisID_, unsigned int slices_, unsigned int seconds_);
+    
+    /* Copy the counts of a rolling histogram over its window, one per bin,
+     * to counts_. Returns false if the histogram is not rolling.
+     */
+    bool GetRolling(unsigned int hisID_, std::vector<unsigned int> &counts_);
+    
     /* Push back with another histogram entry. This command will also
      * extend the length of the .his file (if possible). DO NOT delete
      * the passed drr_entry after calling. OutputHisFile will handle cleanup.
@@ -375,20 +603,154 @@ public:
     /// Increment a histogram at bin (x, y) by weight_
     bool FillBin(unsigned int hisID_, unsigned int x_, unsigned int y_, unsigned int weight_=1);
     
+    /* Increment a histogram at (x, y_) by weights_[x] for every x below n_,
+     * the same as n_ calls to Fill, but the histogram is only looked up once.
+     * Returns false if the histogram does not exist.
+     */
+    bool FillRow(unsigned int hisID_, unsigned int y_, const unsigned int *weights_, size_t n_);
+    
     /// Zero the specified histogram 
     bool Zero(unsigned int hisID_);
     
-    /// Zero all histograms
+    /* Zero all histograms. The counts in memory are swapped for blocks which
+     * were never filled, and the .his file is truncated and extended again
+     * at the next Flush or checkpoint instead of being written with zeros,
+     * so the fills hardly wait. The bins of a mapped file are dropped by
+     * punching a hole over the file, or cleared if that is not supported.
+     */
     bool Zero();
     
+    /* Write a snapshot of all histograms to fname_prefix.his, with a copy of
+     * the .drr and .list files, e.g. at the end of a run before zeroing. The
+     * file is written by another thread while the fills go on. Its blocks of
+     * counts are shared with the histograms, and a block is only copied when
+     * it is filled before the snapshot is written, so the snapshot takes
+     * little memory and holds the counts at the time it was taken. The bins
+     * of a mapped file are copied in full. If a snapshot is still being
+     * written, it is first waited for. Call after Finalize.
+     */
+    bool Snapshot(const std::string &fname_prefix);
+    
+    /* Zero all histograms, or write a snapshot of them, from another thread
+     * than the one filling them, e.g. the command thread of a running scan.
+     * The requests are done in order before the next fill or Flush.
+     */
+    void RequestZero();
+    void RequestSnapshot(const std::string &fname_prefix);
+    
     /// Open a new .his file
     bool Open(std::string fname_prefix);
     
-    /// Flush histogram fills to file
+    /* Write the histograms changed since the last Flush to the .his file.
+     * The histograms are filled in memory with 32 bit counts, and only the
+     * blocks of the file which changed are written, in order. Blocks which
+     * were never filled take no memory and are written as zeros. The counts of
+     * 16 bit histograms saturate at 65535 in the file instead of wrapping
+     * around. This is done every Flush_wait fills, so that the .his file can
+     * be watched while scanning.
+     */
     void Flush();
     
-    /// Close the histogram file and write the drr file
+    /* Close the histogram file and write the drr file. The 16 bit histograms
+     * whose counts saturated are first promoted to 32 bit bins, and the
+     * .his, .drr and .list files are then written again with the new layout.
+     */
     void Close();
+    
+    /* Sum the .his files of several scans which used the same .drr layout
+     * into a single .his file. The .drr and .list files of the first input
+     * are copied to the output. Half-word bins saturate at 65535, the same as
+     * when they are filled.
+     */
+    static bool Sum(const std::string &fname_prefix, const std::vector<std::string> &inputs_);
+};
+
+/// A view of the bins of one histogram in a mapped .his file, which copies nothing
+class HisView{
+private:
+    const char *bins; /// Start of the bins in the mapped .his file, or NULL for an invalid view
+    const drr_entry *entry; /// The .drr entry of the histogram
+    
+public:
+    HisView() : bins(NULL), entry(NULL) {}
+    
+    HisView(const char *bins_, const drr_entry *entry_) : bins(bins_), entry(entry_) {}
+    
+    /// Return true if the view points to the bins of a histogram
+    bool IsValid() const { return (bins != NULL); }
+    
+    /// Return the .drr entry of the histogram
+    const drr_entry *GetEntry() const { return entry; }
+    
+    /// Return the raw bins of the histogram, which are 2 or 4 bytes long
+    const char *GetBins() const { return bins; }
+    
+    /// Return the number of bins of the histogram
+    size_t GetSize() const { return (bins ? entry->total_bins : 0); }
+    
+    /// Return the bin at index_, with no range check
+    unsigned int Get(size_t index_) const {
+        if(entry->use_int){
+            unsigned int ival;
+            memcpy(&ival, bins + index_*4, 4);
+            return ival;
+        }
+        unsigned short sval;
+        memcpy(&sval, bins + index_*2, 2);
+        return sval;
+    }
+    
+    /// Return the bin at index_, with no range check
+    unsigned int operator [](const size_t &index_) const { return Get(index_); }
+};
+
+/* A reader for large .his files. The .drr and .his files are mapped into
+ * memory and the histograms are indexed by the list of ids at the end of
+ * the .drr file, so opening a file reads neither the .drr entries nor any
+ * histograms. The .drr entry of a histogram is only read the first time it
+ * is requested, and the bins are returned as views into the mapped .his
+ * file, which the page cache loads on demand.
+ */
+class MappedHisFile{
+private:
+    std::string prefix; /// The filename prefix of the open .drr and .his files
+    const char *drr_base; /// Start of the mapped .drr file, or NULL if it is not open
+    size_t drr_size; /// Size of the mapped .drr file (in bytes)
+    const char *his_base; /// Start of the mapped .his file, or NULL if it is not open
+    size_t his_size; /// Size of the mapped .his file (in bytes)
+    std::map<unsigned int, size_t> index; /// Location of the .drr entry of each histogram (in bytes), by histogram id
+    std::map<unsigned int, drr_entry*> entries; /// The .drr entries which were read, by histogram id
+    
+    /// Map a whole file read-only, returning NULL on failure
+    static const char *map_file(const std::string &fname_, size_t &size_);
+    
+public:
+    MappedHisFile();
+    
+    MappedHisFile(const char *prefix_);
+    
+    ~MappedHisFile();
+    
+    /// Map the .drr and .his files with the given prefix and index their histograms
+    bool Open(const char *prefix_);
+    
+    /// Unmap the files and delete the .drr entries which were read
+    void Close();
+    
+    /// Return true if the .drr and .his files are open
+    bool IsOpen() const { return (his_base != NULL); }
+    
+    /// Return the number of histograms in the file
+    size_t GetNumHistograms() const { return index.size(); }
+    
+    /// Return the ids of all histograms in the file, in increasing order
+    std::vector<unsigned int> GetIdList() const;
+    
+    /// Return the .drr entry of a histogram, reading it if needed, or NULL if there is no such histogram
+    const drr_entry *GetDrrEntry(unsigned int hisID_);
+    
+    /// Return a view of the bins of a histogram, which is invalid if there is no such histogram
+    HisView GetHistogram(unsigned int hisID_);
 };
 
 extern OutputHisFile *output_his; /// The global .his file handler
@@ -0,0 +1,70 @@
+/** \file HisProjections.hpp
+ * \brief Projections, gate sums and rebinning of the histograms in a mapped .his file.
+ *
+ * The routines work directly on the views returned by MappedHisFile, so the
+ * matrices are never copied, and the rows of a 2D histogram may be split
+ * between several threads.
+ */
+#ifndef HISPROJECTIONS_H
+#define HISPROJECTIONS_H
+
+#include <functional>
+#include <vector>
+
+#include "GammaCube.hpp"
+#include "HisFile.hpp"
+
+/// A gate on the (x, y) bins of a 2D histogram, called from several threads at once
+typedef std::function<bool(unsigned int, unsigned int)> his_gate;
+
+/// Return a gate accepting the bins inside the x and y ranges (inclusive)
+his_gate RangeGate(unsigned int xlow_, unsigned int xhigh_, unsigned int ylow_, unsigned int yhigh_);
+
+/* Return a gate accepting the bins whose channels are inside banana ban_id_,
+ * as tested by bantesti_. The channels are the bins times the compression
+ * of the histogram, the same values which were plotted.
+ */
+his_gate BananaGate(const drr_entry *entry_, int ban_id_);
+
+/* Project the bins of a 2D histogram accepted by gate_ onto the x axis
+ * (onto_x_) or the y axis. The rows are split between threads_ threads.
+ * Returns false if the view is not a valid 2D histogram.
+ */
+bool Project(const HisView &view_, bool onto_x_, const his_gate &gate_,
+             std::vector<unsigned long long> &output_, unsigned int threads_=1);
+
+/* Project the bins of a 2D histogram onto the x axis (onto_x_) or the y
+ * axis, summing the bins from low_ to high_ (inclusive) of the other axis.
+ * This is the same as Project with a RangeGate, without a call per bin.
+ */
+bool ProjectRange(const HisView &view_, bool onto_x_, unsigned int low_, unsigned int high_,
+                  std::vector<unsigned long long> &output_, unsigned int threads_=1);
+
+/// Return the sum of the bins of a 2D histogram accepted by gate_, using threads_ threads
+unsigned long long GateSum(const HisView &view_, const his_gate &gate_, unsigned int threads_=1);
+
+/// Rebin a spectrum by summing groups of factor_ bins, the last group may be shorter
+void Rebin(const std::vector<unsigned long long> &input_, unsigned int factor_,
+           std::vector<unsigned long long> &output_);
+
+/* Project a gamma-gamma-gamma cube onto a symmetric 2D matrix, summing
+ * the bins from low_ to high_ (inclusive) of the third axis. The matrix has
+ * the size of the cube on both axes and is stored row by row, as the bins of
+ * a 2D histogram. The entries of the cube are split between threads_ threads.
+ */
+bool ProjectCube(const GammaCube &cube_, unsigned int low_, unsigned int high_,
+                 std::vector<unsigned long long> &output_, unsigned int threads_=1);
+
+/* Project a gamma-gamma-gamma cube onto one axis, summing the bins in
+ * coincidence with both the bins from low1_ to high1_ and the bins from
+ * low2_ to high2_ (inclusive), i.e. the spectrum of a double gate.
+ */
+bool ProjectCube(const GammaCube &cube_, unsigned int low1_, unsigned int high1_,
+                 unsigned int low2_, unsigned int high2_,
+                 std::vector<unsigned long long> &output_, unsigned int threads_=1);
+
+/// Project a gamma-gamma-gamma cube onto one axis, summing all of the other bins
+bool ProjectCube(const GammaCube &cube_, std::vector<unsigned long long> &output_,
+                 unsigned int threads_=1);
+
+#endif
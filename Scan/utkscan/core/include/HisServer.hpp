@@ -0,0 +1,177 @@
+/** \file HisServer.hpp
+ * \brief Serves the histograms of the scan over HTTP while it is running
+ *
+ * The server keeps a copy of the bytes of the .his file, which the scan
+ * updates at every Flush of the histograms, so that viewers on other hosts
+ * watch the spectra without waiting for the .his file to reach the disk and
+ * the fills never wait for a viewer. The copy is divided into pages, and
+ * every page remembers the version of the histograms in which it last
+ * changed, so that a viewer which already has some version only fetches the
+ * pages which changed since.
+ *
+ * GET /list returns one line with the layout number, the current version
+ * and the size of the .his file, followed by one line per histogram with
+ * its id, dimension, half-words per bin, x and y sizes, offset in the .his
+ * file (in bytes) and title. The layout number changes whenever the
+ * histograms are moved in the file (e.g. when saturated histograms are
+ * promoted to 32 bit bins at the end of the scan).
+ *
+ * GET /counts?since=V[&id=N] returns the pages changed after version V (all
+ * of them for V=0), optionally only those of histogram N, as a binary
+ * HisServer::Header followed by runs of an 8 byte offset, a 4 byte length
+ * and the bytes of the .his file at that offset. Applying the runs to a
+ * local copy of the .his file brings it up to the version of the header.
+ * The reply is compressed with deflate if the viewer accepts it.
+ *
+ * GET /rolling lists the rolling histograms (see OutputHisFile::SetRolling),
+ * one per line with its id, x and y sizes, number of slices and length of
+ * a slice in seconds. GET /rolling?id=N returns the counts of histogram N
+ * over its window, as a binary HisServer::RollingHeader followed by one 4
+ * byte count per bin, deflated as well if the viewer accepts it.
+ */
+#ifndef __HISSERVER_HPP_
+#define __HISSERVER_HPP_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+struct drr_entry;
+
+//! Answers the viewers of the histograms from a copy of the .his file
+class HisServer {
+public:
+    //! The start of the reply to /counts
+    struct Header {
+        char magic[4]; //!< "UKHS"
+        uint32_t layout; //!< the layout number of the histograms
+        uint64_t version; //!< the version the runs bring the file up to
+        uint64_t size; //!< the size of the .his file (in bytes)
+        uint32_t numRuns; //!< the number of runs which follow
+        uint32_t pageSize; //!< the size of the pages (in bytes)
+    };
+
+    //! The start of the reply to /rolling?id=N
+    struct RollingHeader {
+        char magic[4]; //!< "UKHR"
+        uint32_t id; //!< the histogram id
+        uint32_t xSize; //!< the number of bins along x
+        uint32_t ySize; //!< the number of bins along y, 1 for a 1D histogram
+        uint32_t slices; //!< the number of time slices in the window
+        uint32_t seconds; //!< the length of a slice (in seconds)
+        uint64_t version; //!< the version in which the counts were last given
+    };
+
+    /** Default constructor */
+    HisServer();
+
+    /** Default destructor, stops the server */
+    ~HisServer() { Close(); }
+
+    /** Listen for viewers on a port and start the thread which answers them
+    * \param [in] port : the TCP port to listen on
+    * \return false if the port could not be opened */
+    bool Init(int port);
+
+    /** Stop listening and wait for the server thread to exit */
+    void Close();
+
+    /** \return true if the server is listening */
+    bool IsOpen() const { return running_; }
+
+    /** Set the histograms and the size of the .his file. The copy of the
+    * file is zeroed and every page is marked as changed.
+    * \param [in] order : the histograms in the order of the .his file
+    * \param [in] size : the size of the .his file (in bytes) */
+    void SetLayout(const std::vector<drr_entry*> &order, size_t size);
+
+    /** Copy bytes of the .his file which changed into the copy
+    * \param [in] offset : the position of the bytes in the .his file
+    * \param [in] bytes : the bytes
+    * \param [in] len : the number of bytes */
+    void Update(size_t offset, const char *bytes, size_t len);
+
+    /** Compare the whole .his file with the copy and take the pages which
+    * changed. Used when the .his file is mapped into memory, where the
+    * changed bins are not tracked.
+    * \param [in] image : the bytes of the .his file
+    * \param [in] len : the size of the .his file */
+    void Compare(const char *image, size_t len);
+
+    /** Set the counts of a rolling histogram over its window, which are
+    * served from the next Commit on
+    * \param [in] id : the histogram id
+    * \param [in] xSize : the number of bins along x
+    * \param [in] ySize : the number of bins along y
+    * \param [in] slices : the number of time slices in the window
+    * \param [in] seconds : the length of a slice (in seconds)
+    * \param [in] counts : the count of each bin */
+    void SetRolling(unsigned int id, unsigned int xSize, unsigned int ySize,
+                    unsigned int slices, unsigned int seconds,
+                    const std::vector<unsigned int> &counts);
+
+    /** Make the updates since the last Commit visible as a new version */
+    void Commit();
+
+    /** \return the number of requests answered */
+    unsigned long GetRequests() const { return requests_; }
+
+private:
+    /** Accept viewers until the server is closed */
+    void Serve();
+
+    /** Read a single HTTP request from a viewer and send the answer
+    * \param [in] sock : the socket of the viewer */
+    void Answer(int sock);
+
+    /** \return the text of /list */
+    std::string List();
+
+    /** \return the binary reply of /counts
+    * \param [in] since : the version the viewer already has
+    * \param [in] id : the histogram to send, or -1 for all of them */
+    std::string Counts(uint64_t since, long long id);
+
+    /** \return the text list of the rolling histograms for /rolling, or the
+    * binary reply with the window of one of them
+    * \param [in] id : the histogram to send, or -1 for the list */
+    std::string Rolling(long long id);
+
+    static const size_t pageSize = 4096; //!< bytes in a page of the copy
+    static const int timeout = 1000; //!< ms allowed to a viewer to send or receive
+
+    //! The place of a histogram in the .his file
+    struct Entry {
+        unsigned int id; //!< the histogram id
+        std::string line; //!< the line of the histogram in /list
+        size_t offset; //!< the position of its bins (in bytes)
+        size_t size; //!< the size of its bins (in bytes)
+    };
+
+    int listenSock_; //!< the socket accepting the viewers
+    std::thread thread_; //!< accepts the viewers and answers them
+    std::atomic<bool> running_; //!< set to false to stop the thread
+    std::atomic<unsigned long> requests_; //!< the number of requests answered
+
+    std::mutex mutex_; //!< guards everything below
+    std::vector<char> image_; //!< the copy of the .his file
+    std::vector<uint64_t> pageVersions_; //!< the version each page last changed in
+    std::vector<Entry> entries_; //!< the histograms, in the order of the file
+
+    //! The window of a rolling histogram
+    struct RollingEntry {
+        RollingHeader head; //!< the start of the reply
+        std::vector<uint32_t> counts; //!< the count of each bin
+    };
+    std::map<unsigned int, RollingEntry> pendingRolling_; //!< windows given since the last Commit
+    std::map<unsigned int, RollingEntry> rolling_; //!< windows of the last committed version
+    uint64_t version_; //!< the last committed version
+    uint32_t layout_; //!< the layout number
+};
+
+#endif // __HISSERVER_HPP_
@@ -0,0 +1,87 @@
+/** \file HitArray.hpp
+ * \brief A fixed size array of detectors with a mask of the ones that fired
+ */
+#ifndef __HITARRAY_HPP__
+#define __HITARRAY_HPP__
+
+#include <vector>
+
+#include <cstddef>
+#include <stdint.h>
+
+/** \brief Holds one element, e.g. a bar or a start, for each slot of a
+ * detector array, together with a bit mask of the slots that fired in the
+ * current event.
+ *
+ * The storage is sized once, at the initialization of the processor, so
+ * filling the array for an event does not allocate. Clearing the array only
+ * clears the mask, and the slots that fired are visited in increasing order
+ * by walking the set bits of the mask:
+ *
+ *     for(size_t i = bars.Next(0); i < bars.size(); i = bars.Next(i+1))
+ */
+template<typename T>
+class HitArray {
+public:
+    /** Default constructor, an array without slots */
+    HitArray() {}
+
+    /** Constructor
+    * \param [in] size : the number of slots */
+    HitArray(size_t size) { Resize(size); }
+
+    /** Sets the number of slots, all of them are cleared
+    * \param [in] size : the number of slots */
+    void Resize(size_t size) {
+        data_.assign(size, T());
+        hits_.assign((size + 63) / 64, 0);
+    }
+
+    /** \return the number of slots */
+    size_t size() const { return data_.size(); }
+
+    /** \return true if no slot fired */
+    bool empty() const { return Next(0) == data_.size(); }
+
+    /** Clears the mask of the slots that fired */
+    void clear() { hits_.assign(hits_.size(), 0); }
+
+    /** \return true if the slot fired
+    * \param [in] i : the slot */
+    bool Has(size_t i) const {
+        return i < data_.size() && (hits_[i / 64] >> (i % 64)) & 1;
+    }
+
+    /** Stores the element of a slot and marks the slot as fired
+    * \param [in] i : the slot, which must exist
+    * \param [in] value : the element */
+    void Set(size_t i, const T& value) {
+        data_[i] = value;
+        hits_[i / 64] |= (uint64_t)1 << (i % 64);
+    }
+
+    /** \return the element of slot i, whether it fired or not
+    * \param [in] i : the slot */
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    /** \return the first slot from i on that fired, or size() if none
+    * \param [in] i : the slot to start from */
+    size_t Next(size_t i) const {
+        if (i >= data_.size())
+            return data_.size();
+        size_t word = i / 64;
+        uint64_t bits = hits_[word] & (~(uint64_t)0 << (i % 64));
+        while (bits == 0) {
+            if (++word == hits_.size())
+                return data_.size();
+            bits = hits_[word];
+        }
+        return word * 64 + __builtin_ctzll(bits);
+    }
+
+private:
+    std::vector<T> data_; //!< the element of each slot
+    std::vector<uint64_t> hits_; //!< one bit for each slot that fired
+};
+
+#endif // __HITARRAY_HPP__
@@ -4,10 +4,46 @@
 #ifndef __CHANIDENTIFIER_HPP
 #define __CHANIDENTIFIER_HPP
 
+#include <deque>
 #include <map>
 #include <sstream>
 #include <string>
 
+/** \brief A table of interned names
+ *
+ * Every distinct name is stored once and given a small integer id, starting
+ * from 0 for the empty name. Identifiers keep the ids of their type, subtype
+ * and tags so that they can be compared without comparing strings. The ids
+ * stay valid, and the names stay at the same address, for the lifetime of
+ * the program. */
+class SymbolTable {
+public:
+    static const unsigned int NOT_FOUND = (unsigned int)-1; //!< Returned by Find for unknown names
+
+    /** Default constructor, interns the empty name as id 0 */
+    SymbolTable() {Intern("");}
+
+    /** Get the id of a name, adding it to the table if it is new
+     * \param [in] s : the name to intern
+     * \return the id of the name */
+    unsigned int Intern(const std::string &s);
+
+    /** Get the id of a name without adding it to the table
+     * \param [in] s : the name to look for
+     * \return the id of the name, NOT_FOUND if it was never interned */
+    unsigned int Find(const std::string &s) const;
+
+    /** \return the name with the given id
+     * \param [in] id : the id returned by Intern */
+    const std::string& Get(unsigned int id) const {return names[id];}
+
+    /** \return the number of names in the table */
+    size_t Size() const {return names.size();}
+private:
+    std::map<std::string, unsigned int> ids; /**< The id of each name */
+    std::deque<std::string> names;           /**< The names indexed by id */
+};
+
 /** \brief Channel identification
  *
  * All parameters needed to uniquely specify the detector connected to a
@@ -42,36 +78,56 @@ public:
     void SetDammID(int a) {dammID = a;};
     /** Sets the type
      * \param [in] a : the type to set */
-    void SetType(const std::string &a) {type = a;};
+    void SetType(const std::string &a) {type = Names().Intern(a);};
     /** Sets the subtype of the channel
      * \param [in] a : the subtype to set */
-    void SetSubtype(const std::string &a) {subtype = a;};
+    void SetSubtype(const std::string &a) {subtype = Names().Intern(a);};
     /** Sets the location
      * \param [in] a : sets the location for the channel */
     void SetLocation(int a) {location = a;};
+    /** Sets the software threshold
+     * \param [in] a : the minimum raw energy of a hit, 0 for none */
+    void SetThreshold(unsigned int a) {threshold = a;};
 
     int GetDammID() const                 {return dammID;}   /**< \return Get the dammid */
-    const std::string& GetType() const    {return type;}     /**< \return Get the detector type */
-    const std::string& GetSubtype() const {return subtype;}  /**< \return Get the detector subtype */
+    const std::string& GetType() const    {return Names().Get(type);}    /**< \return Get the detector type */
+    const std::string& GetSubtype() const {return Names().Get(subtype);} /**< \return Get the detector subtype */
     int GetLocation() const               {return location;} /**< \return Get the detector location */
+    unsigned int GetThreshold() const     {return threshold;} /**< \return Get the minimum raw energy of a hit */
+    unsigned int GetTypeId() const        {return type;}     /**< \return Get the interned id of the detector type */
+    unsigned int GetSubtypeId() const     {return subtype;}  /**< \return Get the interned id of the detector subtype */
 
     /** Insert a tag to the Identifier
      * \param [in] s : the name of the tag to insert
      * \param [in] n : the value of the tag to insert */
-    void AddTag(const std::string &s, int n) {tag[s] = n;}
+    void AddTag(const std::string &s, int n);
     /** Check if an identifier has a tag
      * \param [in] s : the tag to search for
      * \return true if the tag is in the identifier */
     bool HasTag(const std::string &s) const {
-        if(tag.count(s) > 0)
-            return(true);
-        return(false);};
+        return(HasTag(Tags().Find(s)));};
+    /** Check if an identifier has a tag, without any string handling
+     * \param [in] id : the interned id of the tag, from TagId
+     * \return true if the tag is in the identifier */
+    bool HasTag(unsigned int id) const {
+        if (id < TAG_BITS)
+            return((tagBits >> id) & 1);
+        if (id == SymbolTable::NOT_FOUND)
+            return(false);
+        return(tag.count(Tags().Get(id)) > 0);};
     /** \return Get the requested tag
      * \param [in] s : the name of the tag to get */
     int GetTag(const std::string &s) const;
 
     /** \return The map with the list of tags */
-    std::map<std::string, int> GetTagMap(void) const {return (tag);};
+    const std::map<std::string, int>& GetTagMap(void) const {return (tag);};
+
+    /** \return the interned id of a detector type or subtype name
+     * \param [in] s : the name to look up */
+    static unsigned int NameId(const std::string &s) {return Names().Intern(s);}
+    /** \return the interned id of a tag name, for use with HasTag
+     * \param [in] s : the name of the tag to look up */
+    static unsigned int TagId(const std::string &s) {return Tags().Intern(s);}
 
     /** Zeroes an identifier
     *
@@ -104,19 +160,12 @@ public:
      * \param [in] x : the Identifier to compare
      * \return true if this is less than x */
     bool operator<(const Identifier &x) const {
-       if (type.compare(x.type) > 0)
-           return false;
-       else if (type.compare(x.type) < 0)
-           return true;
-       else {
-           if (subtype.compare(x.subtype) > 0)
-               return false;
-           else if (subtype.compare(x.subtype))
-               return true;
-           else {
-               return (location < x.location);
-           }
-       }
+       if (type != x.type)
+           return (GetType().compare(x.GetType()) < 0);
+       else if (subtype != x.subtype)
+           return (GetSubtype().compare(x.GetSubtype()) < 0);
+       else
+           return (location < x.location);
     }
 
     /** \return The name of the place associated with the channel */
@@ -126,11 +175,18 @@ public:
         return ss.str();
     }
 private:
-    std::string type;      /**< Specifies the detector type */
-    std::string subtype;   /**< Specifies the detector sub type */
+    static const unsigned int TAG_BITS = 64; //!< Number of tag ids held in tagBits
+
+    unsigned int type;     /**< Interned id of the detector type */
+    unsigned int subtype;  /**< Interned id of the detector sub type */
     int dammID;            /**< Damm spectrum number for plotting calibrated energies */
     int location;          /**< Specifies the real world location of the channel.
                                 For the DSSD this variable is the strip number */
+    unsigned int threshold; /**< Hits with a lower raw energy are dropped by the unpacker */
     std::map<std::string, int> tag;  /**< A list of tags associated with the Identifier */
+    unsigned long long tagBits;      /**< Bit n is set if the Identifier has the tag with id n */
+
+    static SymbolTable& Names(); /**< \return the table of type and subtype names */
+    static SymbolTable& Tags();  /**< \return the table of tag names */
 };
 #endif
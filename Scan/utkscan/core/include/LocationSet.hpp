@@ -0,0 +1,76 @@
+/** \file LocationSet.hpp
+ * \brief A dense set of detector locations, kept as a bitset
+ */
+#ifndef __LOCATIONSET_HPP__
+#define __LOCATIONSET_HPP__
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/** \brief The locations used by a detector type and subtype, one bit per
+ * location.
+ *
+ * The locations of a type are small numbers counted from 0, so a bit per
+ * location is far smaller than the nodes of a std::set<int>. Testing a
+ * location is a shift and a mask, and the locations are walked in increasing
+ * order, as those of the set, by skipping the words without a bit set.
+ * Negative locations are not kept.
+ */
+class LocationSet {
+public:
+    /** Default constructor, an empty set */
+    LocationSet() : count_(0) {}
+
+    /** Add a location to the set
+    * \param [in] location : the location to add */
+    void Insert(int location) {
+        if (location < 0 || Has(location))
+            return;
+        size_t word = location / 64;
+        if (word >= bits_.size())
+            bits_.resize(word + 1, 0);
+        bits_[word] |= (uint64_t)1 << (location % 64);
+        count_++;
+    }
+
+    /** \return true if the location is in the set
+    * \param [in] location : the location to test */
+    bool Has(int location) const {
+        if (location < 0 || (size_t)location / 64 >= bits_.size())
+            return false;
+        return (bits_[location / 64] >> (location % 64)) & 1;
+    }
+
+    /** \return the first location in the set at or after a location, -1 if
+    * there is none. The set is walked with
+    * for (int loc = set.Next(0); loc >= 0; loc = set.Next(loc + 1))
+    * \param [in] location : the location to start at */
+    int Next(int location) const {
+        if (location < 0)
+            location = 0;
+        size_t word = location / 64;
+        if (word >= bits_.size())
+            return -1;
+        uint64_t bits = bits_[word] & (~(uint64_t)0 << (location % 64));
+        while (bits == 0) {
+            if (++word >= bits_.size())
+                return -1;
+            bits = bits_[word];
+        }
+        return (int)(word * 64 + __builtin_ctzll(bits));
+    }
+
+    /** \return the number of locations in the set */
+    size_t Size() const { return count_; }
+
+    /** \return true if the set has no location */
+    bool Empty() const { return count_ == 0; }
+
+private:
+    std::vector<uint64_t> bits_; //!< bit n of word n / 64 is set if location n is in the set
+    size_t count_; //!< the number of locations in the set
+};
+
+#endif // __LOCATIONSET_HPP__
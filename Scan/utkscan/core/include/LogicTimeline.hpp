@@ -0,0 +1,99 @@
+/** \file LogicTimeline.hpp
+ * \brief The history of a logic signal, queried at any time
+ */
+#ifndef __LOGICTIMELINE_HPP__
+#define __LOGICTIMELINE_HPP__
+
+#include <algorithm>
+#include <vector>
+
+#include <cmath>
+#include <cstddef>
+
+/** \brief Keeps every transition of a logic signal (e.g. the beam or the
+ * tape move) in time order, so that its level may be asked at any time of
+ * the run, not only at the current event.
+ *
+ * Only the changes of the level are kept, so the levels of the transitions
+ * alternate and a query is a binary search of the times, O(log n). The time
+ * the signal was on up to each transition is kept as well, so the time it
+ * was on between any two times (e.g. the beam on time of a part of the run)
+ * is found the same way. The times are in any units, usually clock ticks.
+ */
+class LogicTimeline {
+public:
+    /** Constructor
+    * \param [in] initial : the level before the first transition */
+    LogicTimeline(bool initial = false) : initial_(initial) {}
+
+    /** Set the level of the signal from a time on. Nothing is kept if the
+    * level does not change. The times are expected in order, a time before
+    * the last transition is taken as the time of the last transition.
+    * \param [in] time : the time of the transition
+    * \param [in] state : the level from the time on */
+    void Set(double time, bool state) {
+        if (state == State())
+            return;
+        if (!times_.empty()) {
+            time = std::max(time, times_.back());
+            onTime_.push_back(onTime_.back() +
+                              (state ? 0 : time - times_.back()));
+        } else
+            onTime_.push_back(0);
+        times_.push_back(time);
+    }
+
+    /** \return the current level, that of the last transition */
+    bool State() const { return StateAfter(times_.size()); }
+
+    /** \return the level at a time, that of the last transition at or
+    * before it
+    * \param [in] time : the time to look at */
+    bool State(double time) const { return StateAfter(Count(time)); }
+
+    /** \return the time of the last transition at or before a time, NAN if
+    * there was none
+    * \param [in] time : the time to look at */
+    double LastChange(double time) const {
+        size_t n = Count(time);
+        return n == 0 ? NAN : times_[n - 1];
+    }
+
+    /** \return the time the signal was on up to a time, counted from the
+    * first transition
+    * \param [in] time : the time to look at */
+    double OnTime(double time) const {
+        size_t n = Count(time);
+        if (n == 0)
+            return 0;
+        return onTime_[n - 1] + (StateAfter(n) ? time - times_[n - 1] : 0);
+    }
+
+    /** \return the time the signal was on between two times
+    * \param [in] from : the start of the interval
+    * \param [in] to : the end of the interval */
+    double OnTime(double from, double to) const {
+        return OnTime(to) - OnTime(from);
+    }
+
+    /** \return the number of transitions */
+    size_t GetNumTransitions() const { return times_.size(); }
+
+private:
+    /** \return the number of transitions at or before a time
+    * \param [in] time : the time to look at */
+    size_t Count(double time) const {
+        return std::upper_bound(times_.begin(), times_.end(), time) -
+            times_.begin();
+    }
+
+    /** \return the level after a number of transitions
+    * \param [in] n : the number of transitions */
+    bool StateAfter(size_t n) const { return (n % 2 == 1) != initial_; }
+
+    bool initial_; //!< the level before the first transition
+    std::vector<double> times_; //!< the times of the transitions
+    std::vector<double> onTime_; //!< the time on before each transition
+};
+
+#endif // __LOGICTIMELINE_HPP__
@@ -0,0 +1,107 @@
+/** \file MapCache.hpp
+ * \brief The channel map, calibrations and walk corrections of the
+ * configuration, kept in a binary cache file next to it
+ *
+ * The Map section is by far the largest part of the configuration. It is
+ * walked once into plain records, which are written to <config>.cache
+ * together with the hash of the configuration file. As long as the file
+ * is unchanged the records are read back from the cache instead.
+ */
+#ifndef __MAPCACHE_HPP_
+#define __MAPCACHE_HPP_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "pugixml.hpp"
+
+//! The resolved Map section of the configuration - Singleton Class
+class MapCache {
+public:
+    //! A Calibration or WalkCorrection node of a channel
+    struct Correction {
+        std::string model; //!< the model of the correction
+        double min; //!< the lower bound of the correction
+        double max; //!< the upper bound of the correction
+        unsigned int points; //!< the number of tabulated points (walk only)
+        std::vector<double> parameters; //!< the parameters of the model
+    };
+
+    //! A Channel node of the map
+    struct Channel {
+        int module; //!< the module number, -1 if missing
+        int channel; //!< the channel number, -1 if missing
+        std::string type; //!< the detector type
+        std::string subtype; //!< the detector subtype
+        int location; //!< the location, -1 if it is to be assigned
+        std::string tags; //!< the comma separated tags
+        unsigned int threshold; //!< the minimum raw energy of a hit, 0 for none
+        std::vector<Correction> calibrations; //!< the energy calibrations
+        std::vector<Correction> walks; //!< the walk corrections
+    };
+
+    /** \return the only instance of the class */
+    static MapCache* get();
+
+    /** \return the channels in the order of the configuration file */
+    const std::vector<Channel>& channels() const { return channels_; }
+
+    /** \return true if the map was read from the cache file */
+    bool fromCache() const { return fromCache_; }
+
+    bool verboseMap() const { return verboseMap_; } //!< \return verbose_map
+    bool verboseCalibration() const { return verboseCal_; } //!< \return verbose_calibration
+    bool verboseWalk() const { return verboseWalk_; } //!< \return verbose_walk
+
+    /** Walk the channels of a Map section, e.g. of a configuration read
+    * again to reload its calibrations
+    * \param [in] map : the Map node
+    * \param [out] channels : the channels are appended here */
+    static void ReadChannels(const pugi::xml_node &map,
+                             std::vector<Channel> &channels);
+
+private:
+    MapCache(); //!< Reads the cache, or builds and writes it
+    MapCache(const MapCache&); //!< Overload of the constructor
+    MapCache& operator=(MapCache const&); //!< the copy constructor
+    static MapCache* instance; //!< static instance of the class
+
+    /** Walk the Map section of the configuration
+    * \param [in] doc : the parsed configuration */
+    void Build(const pugi::xml_document &doc);
+
+    /** Read the cache file
+    * \param [in] name : the name of the cache file
+    * \param [in] hash : the hash of the configuration the cache must match
+    * \return true if the file is valid and matches the hash */
+    bool Read(const std::string &name, uint64_t hash);
+
+    /** Write the cache file, failing silently if it can not be written
+    * \param [in] name : the name of the cache file
+    * \param [in] hash : the hash of the configuration */
+    void Write(const std::string &name, uint64_t hash) const;
+
+    /** Read the corrections of a channel from the cache file
+    * \param [in] in : the cache file
+    * \param [out] corrs : the corrections
+    * \return true if the corrections were read */
+    static bool ReadCorrections(std::ifstream &in,
+                                std::vector<Correction> &corrs);
+
+    /** Write the corrections of a channel to the cache file
+    * \param [in] out : the cache file
+    * \param [in] corrs : the corrections */
+    static void WriteCorrections(std::ofstream &out,
+                                 const std::vector<Correction> &corrs);
+
+    std::vector<Channel> channels_; //!< the channels of the map
+    bool fromCache_; //!< true if read from the cache
+    bool verboseMap_; //!< verbose_map attribute of the Map
+    bool verboseCal_; //!< verbose_calibration attribute of the Map
+    bool verboseWalk_; //!< verbose_walk attribute of the Map
+};
+
+#endif // __MAPCACHE_HPP_
@@ -0,0 +1,315 @@
+/** \file MappedPixelHistory.hpp
+ * \brief A disk backed store of the event history of each pixel
+ */
+#ifndef __MAPPEDPIXELHISTORY_HPP__
+#define __MAPPEDPIXELHISTORY_HPP__
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** \brief The header of the ring of one pixel in a MappedPixelHistory */
+struct MappedRingHeader {
+    uint32_t used; //!< 1 once the pixel has fired
+    uint32_t first; //!< the position of the oldest event in the ring
+    uint32_t size; //!< the number of events in the ring
+    uint32_t reserved; //!< keeps the events 8 byte aligned
+};
+
+/** \brief A view of the ring of one pixel in a MappedPixelHistory. It has
+ * the same interface as the RingBuffer, so that the correlators can use
+ * either of them, but the events live in the mapped file. */
+template<typename T>
+class MappedRing {
+public:
+    /** \brief Iterator over the events, from the oldest to the newest */
+    class iterator {
+    public:
+        /** Constructor
+        * \param [in] ring : the ring to iterate over
+        * \param [in] index : the index of the event */
+        iterator(MappedRing *ring, size_t index) : ring_(ring), index_(index) {}
+        /** \return the event */
+        T& operator*() const { return (*ring_)[index_]; }
+        /** \return pointer to the event */
+        T* operator->() const { return &(*ring_)[index_]; }
+        /** \return the iterator to the next event */
+        iterator& operator++() { ++index_; return *this; }
+        /** \return true if both iterators point to the same event
+        * \param [in] rhs : the iterator to compare to */
+        bool operator==(const iterator &rhs) const {
+            return ring_ == rhs.ring_ && index_ == rhs.index_;
+        }
+        /** \return true if the iterators point to different events
+        * \param [in] rhs : the iterator to compare to */
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+    private:
+        MappedRing *ring_; //!< the ring iterated over
+        size_t index_; //!< the index of the event
+    };
+
+    /** Constructor
+    * \param [in] head : the header of the ring in the mapped file
+    * \param [in] capacity : the largest number of events in the ring */
+    MappedRing(MappedRingHeader *head, size_t capacity) :
+        head_(head), data_((T*)(head + 1)), capacity_(capacity) {}
+
+    /** \return the number of events */
+    size_t size() const { return head_->size; }
+
+    /** \return true if there are no events */
+    bool empty() const { return head_->size == 0; }
+
+    /** \return the largest number of events */
+    size_t capacity() const { return capacity_; }
+
+    /** \return the header of the ring in the mapped file */
+    MappedRingHeader* Header() const { return head_; }
+
+    /** \return event i, counting from the oldest one, without checks
+    * \param [in] i : the index of the event */
+    T& operator[](size_t i) const { return data_[Slot(i)]; }
+
+    /** \return the oldest event, the ring must not be empty */
+    T& front() const { return (*this)[0]; }
+
+    /** \return the newest event, the ring must not be empty */
+    T& back() const { return (*this)[head_->size - 1]; }
+
+    /** Adds an event, overwriting the oldest one if the ring is full
+    * \param [in] value : the event to add */
+    void push_back(const T& value) {
+        if (capacity_ == 0)
+            return;
+        if (head_->size < capacity_) {
+            data_[Slot(head_->size)] = value;
+            ++head_->size;
+        } else {
+            data_[head_->first] = value;
+            head_->first = Slot(1);
+        }
+    }
+
+    /** Removes the oldest event, the ring must not be empty */
+    void pop_front() {
+        head_->first = Slot(1);
+        --head_->size;
+    }
+
+    /** Removes all of the events */
+    void clear() { head_->first = head_->size = 0; }
+
+    /** \return iterator to the oldest event */
+    iterator begin() { return iterator(this, 0); }
+
+    /** \return iterator past the newest event */
+    iterator end() { return iterator(this, head_->size); }
+
+private:
+    /** \return the position of event i in data_
+    * \param [in] i : the index of the event */
+    size_t Slot(size_t i) const {
+        size_t slot = head_->first + i;
+        return slot < capacity_ ? slot : slot - capacity_;
+    }
+
+    MappedRingHeader *head_; //!< the header of the ring
+    T *data_; //!< the events of the ring
+    size_t capacity_; //!< the largest number of events
+};
+
+/** \brief Keeps the history of the events of each pixel of a detector in a
+ * memory mapped file instead of in memory.
+ *
+ * Every pixel has a ring of a fixed depth at a fixed place in the file. The
+ * file is created sparse, so only the pages of the pixels that fired take
+ * space on the disk, and the kernel pages the histories in and out as they
+ * are used, so histories spanning hours do not have to fit in memory. When
+ * the file is opened again with the same geometry, e.g. for the next file
+ * of a run set, the histories are picked up where they were left. The
+ * interface is that of a PixelMap of RingBuffers. The events are kept in
+ * the file as they are in memory, so T must be a plain type without
+ * pointers. */
+template<typename T>
+class MappedPixelHistory {
+public:
+    /** \brief A pixel that has fired and its ring */
+    struct Pixel {
+        /** Constructor
+        * \param [in] px : the x position of the pixel
+        * \param [in] py : the y position of the pixel
+        * \param [in] pvalue : the ring of the pixel */
+        Pixel(unsigned px, unsigned py, const MappedRing<T>& pvalue) :
+            x(px), y(py), value(pvalue) {}
+        unsigned x; //!< the x position of the pixel
+        unsigned y; //!< the y position of the pixel
+        MappedRing<T> value; //!< the ring of the pixel
+    };
+
+    typedef MappedRing<T> value_type; //!< the type of the ring of a pixel
+
+    /** Default constructor */
+    MappedPixelHistory() : base_(NULL), size_(0), sizeX_(0), sizeY_(0) {}
+
+    /** Destructor, the histories are written to the file */
+    ~MappedPixelHistory() { Close(); }
+
+    /** Opens the file, keeping the histories it holds if they were written
+    * for the same geometry, or otherwise starting it from scratch
+    * \param [in] fname : the name of the file
+    * \param [in] sizeX : the number of pixels in x
+    * \param [in] sizeY : the number of pixels in y
+    * \param [in] depth : the largest number of events for each pixel
+    * \return false if the file could not be created or mapped */
+    bool Open(const std::string &fname, unsigned sizeX, unsigned sizeY,
+              unsigned depth) {
+        Close();
+
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "PXHIST01", 8);
+        header.sizeX = sizeX;
+        header.sizeY = sizeY;
+        header.depth = depth;
+        header.recordSize = sizeof(T);
+
+        size_t stride = sizeof(MappedRingHeader) +
+            ((depth * sizeof(T) + 7) / 8) * 8;
+        size_t size = sizeof(FileHeader) + (size_t)sizeX * sizeY * stride;
+
+        int fd = ::open(fname.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            return false;
+
+        // A file written for another geometry or type is started again
+        FileHeader found;
+        struct stat st;
+        bool resume = fstat(fd, &st) == 0 && (size_t)st.st_size == size &&
+            pread(fd, &found, sizeof(found), 0) == (ssize_t)sizeof(found) &&
+            memcmp(&found, &header, sizeof(header)) == 0;
+        if (!resume && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)) {
+            ::close(fd);
+            return false;
+        }
+
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return false;
+
+        base_ = (char*)addr;
+        size_ = size;
+        if (!resume)
+            memcpy(base_, &header, sizeof(header));
+
+        sizeX_ = sizeX;
+        sizeY_ = sizeY;
+        rings_.reserve((size_t)sizeX * sizeY);
+        for (size_t i = 0; i < (size_t)sizeX * sizeY; ++i) {
+            MappedRingHeader *head = (MappedRingHeader*)
+                (base_ + sizeof(FileHeader) + i * stride);
+            rings_.push_back(Pixel(i / sizeY, i % sizeY,
+                                   MappedRing<T>(head, depth)));
+        }
+        return true;
+    }
+
+    /** Writes the histories to the file and unmaps it */
+    void Close() {
+        if (base_ != NULL) {
+            msync(base_, size_, MS_SYNC);
+            munmap(base_, size_);
+        }
+        base_ = NULL;
+        size_ = 0;
+        sizeX_ = sizeY_ = 0;
+        rings_.clear();
+    }
+
+    /** \return true if the file is open */
+    bool IsOpen() const { return base_ != NULL; }
+
+    /** \return the number of pixels in x */
+    unsigned GetSizeX() const { return sizeX_; }
+
+    /** \return the number of pixels in y */
+    unsigned GetSizeY() const { return sizeY_; }
+
+    /** \return true if there is a pixel at the position
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    bool IsValid(int x, int y) const {
+        return x >= 0 && y >= 0 && (unsigned)x < sizeX_ &&
+            (unsigned)y < sizeY_;
+    }
+
+    /** \return the ring of the pixel, or NULL if it never fired or the
+    * position is not valid
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    MappedRing<T>* Find(int x, int y) {
+        if (!IsValid(x, y) || !Head(x, y)->used)
+            return NULL;
+        return &rings_[x * sizeY_ + y].value;
+    }
+
+    /** \return the ring of the pixel, which is marked as fired. The position
+    * must be valid.
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    MappedRing<T>& Get(int x, int y) {
+        Head(x, y)->used = 1;
+        return rings_[x * sizeY_ + y].value;
+    }
+
+    /** Finds the pixels that fired around a position, within radius pixels
+    * in x and y. The pixel at the position itself is not included.
+    * \param [in] x : the x position
+    * \param [in] y : the y position
+    * \param [in] radius : the largest distance in x and y
+    * \param [out] found : the pixels that fired, added to the vector */
+    void Neighbours(int x, int y, unsigned radius,
+                    std::vector<Pixel*> &found) {
+        for (int i = x - (int)radius; i <= x + (int)radius; ++i) {
+            for (int j = y - (int)radius; j <= y + (int)radius; ++j) {
+                if ((i == x && j == y) || !IsValid(i, j) || !Head(i, j)->used)
+                    continue;
+                found.push_back(&rings_[i * sizeY_ + j]);
+            }
+        }
+    }
+
+private:
+    /** \brief The header at the start of the file */
+    struct FileHeader {
+        char magic[8]; //!< identifies the file
+        uint32_t sizeX; //!< the number of pixels in x
+        uint32_t sizeY; //!< the number of pixels in y
+        uint32_t depth; //!< the largest number of events for each pixel
+        uint32_t recordSize; //!< the size of each event in bytes
+    };
+
+    /** \return the header of the ring of the pixel
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    MappedRingHeader* Head(int x, int y) const {
+        return rings_[x * sizeY_ + y].value.Header();
+    }
+
+    char *base_; //!< the mapped file
+    size_t size_; //!< the size of the mapped file
+    unsigned sizeX_; //!< the number of pixels in x
+    unsigned sizeY_; //!< the number of pixels in y
+    std::vector<Pixel> rings_; //!< the views of the rings of all the pixels
+};
+
+#endif // __MAPPEDPIXELHISTORY_HPP__
@@ -14,27 +14,37 @@
 #include <vector>
 
 #include "Exceptions.hpp"
+#include "poll2_log.h"
 
 //!This class outputs nicely formatted messages during configuration loading.
 class Messenger {
     public:
-        /** Default constructors sets output to std::cout*/
-        Messenger () {
-            file_ = false;
-            out_ = &std::cout;
-        }
+        /** Default constructors sets output to std::cout. Nothing is
+         * allocated, so a Messenger costs nothing until it prints. */
+        Messenger () : out_(&std::cout), fout_(NULL) {}
 
         /** Sets output to file.
          * \param [in] name : the name of the output file */
         Messenger (const std::string& name) {
-            file_ = true;
-            fout_.open(name.c_str());
-            if (!fout_.good()) {
+            fout_ = new std::ofstream(name.c_str());
+            if (!fout_->good()) {
+                delete fout_;
                 std::string msg =
                     "Messenger::Messenger: Could not open file " + name;
                 throw IOException(msg);
             }
-            out_ = &fout_;
+            out_ = fout_;
+        }
+
+        /** Build a message from its parts, each streamed in turn.
+         * \param [in] parts : the parts of the message
+         * \return the message */
+        template <typename... Parts>
+        static std::string format(const Parts &... parts) {
+            std::ostringstream ss;
+            int expand[] = {0, ((void)(ss << parts), 0)...};
+            (void)expand;
+            return ss.str();
         }
 
         /** Start of some main category.
@@ -60,10 +70,52 @@ class Messenger {
         * \param [in] level : the output level */
         void warning(std::string msg, short level = 0);
 
+        /** Warning message for an anomaly which may repeat for every event,
+         * only printed when the site allows it (see LogSite).
+        * \param [in] site : the log site of the anomaly
+        * \param [in] msg : the message to output
+        * \param [in] level : the output level */
+        void warning(LogSite &site, const std::string &msg, short level = 0) {
+            if (site.Hit())
+                warning(msg + site.Suppressed(), level);
+        }
+
+        /** Warning message for an anomaly which may repeat for every event,
+         * built from its parts only if the site allows it to be printed, so
+         * the occurrences which are just counted format nothing.
+        * \param [in] site : the log site of the anomaly
+        * \param [in] parts : the parts of the message (see format) */
+        template <typename... Parts>
+        void warningf(LogSite &site, const Parts &... parts) {
+            if (site.Hit())
+                warning(format(parts...) + site.Suppressed());
+        }
+
         /** Message shown during scanning
         * \param [in] msg : the message to output */
         void run_message(std::string msg);
 
+        /** Message shown during scanning for an anomaly which may repeat
+         * for every event. Only printed when the site allows it (see LogSite),
+         * otherwise just counted.
+        * \param [in] site : the log site of the anomaly
+        * \param [in] msg : the message to output */
+        void run_message(LogSite &site, const std::string &msg) {
+            if (site.Hit())
+                run_message(msg + site.Suppressed());
+        }
+
+        /** Message shown during scanning for an anomaly which may repeat
+         * for every event, built from its parts only if the site allows it
+         * to be printed.
+        * \param [in] site : the log site of the anomaly
+        * \param [in] parts : the parts of the message (see format) */
+        template <typename... Parts>
+        void run_messagef(LogSite &site, const Parts &... parts) {
+            if (site.Hit())
+                run_message(format(parts...) + site.Suppressed());
+        }
+
         /** At the end of main category, [Done] message.*/
         void done() {
             *out_ << std::setfill(' ');
@@ -86,14 +138,14 @@ class Messenger {
 
         /** Default destructor (closes the file) */
         ~Messenger() {
-            if (file_)
-                fout_.close();
+            delete fout_;
         }
 
     private:
         std::ostream* out_; //!< the output stream
-        std::ofstream fout_;//!< the output file stream
-        bool file_;//!< true if the file is opened
+        std::ofstream* fout_;//!< the output file stream, NULL if output is to std::cout
+        Messenger(const Messenger &) = delete; //!< not copied, it may own its file
+        Messenger &operator=(const Messenger &) = delete; //!< not copied
         static bool endline_;//!< true if we have an endline
 };
 #endif
@@ -6,18 +6,38 @@
 #ifndef __NOTEBOOK_HPP__
 #define __NOTEBOOK_HPP__
 
-#include <string>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
 
-//! A class to output things to a notebook
+//! A class to output things to a notebook. The notes are queued and written
+//! to the file by a thread of the notebook, so reporting never waits on disk.
 class Notebook {
 public:
     /** \return only instance of Notebook class. */
     static Notebook* get();
 
-    /** Save string to file
+    /** Queue a string to be saved to the file
     * \param [in] note : the note to report in the file */
-    void report(std::string note);
+    void report(const std::string &note);
+
+    /** Queue a note built from its parts, which are copied and only
+    * formatted by the writer thread, off the event path.
+    * \param [in] parts : the parts of the note, each streamed in turn */
+    template <typename... Parts>
+    void reportf(const Parts &... parts) {
+        push([=](std::ostream &out) {
+            int expand[] = {0, ((void)(out << parts), 0)...};
+            (void)expand;
+        });
+    }
+
+    /** Wait until every queued note is written to the file */
+    void flush();
 
     /** \return the current date and time */
     const std::string currentDateTime() const;
@@ -31,7 +51,26 @@ private:
     void operator=(Notebook const&);//!< the copy constructor
     static Notebook* instance;//!< static instance of the class
 
+    /** Write the queued notes and delete the instance, at exit */
+    static void close();
+
+    /** Queue a note for the writer thread
+    * \param [in] note : streams the note to the file */
+    void push(std::function<void(std::ostream &)> &&note);
+
+    /** Write the queued notes until the notebook is closed. Runs in writer_. */
+    void write_notes();
+
     std::string mode_; //!< the mode for the notebook class
     std::string file_name_;//!< the file name to output into
+
+    std::ofstream file_; //!< the notebook file, kept open
+    std::thread writer_; //!< thread writing the queued notes
+    std::mutex mutex_; //!< guards queue_, writing_ and stop_
+    std::condition_variable ready_; //!< wakes writer_ when notes are queued
+    std::condition_variable written_; //!< wakes flush when the queue is written
+    std::deque<std::function<void(std::ostream &)> > queue_; //!< the notes not yet written
+    bool writing_; //!< true while writer_ writes notes taken from queue_
+    bool stop_; //!< true when the notebook is closing
 };
 #endif
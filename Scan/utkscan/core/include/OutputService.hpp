@@ -0,0 +1,50 @@
+/** \file OutputService.hpp
+ * \brief Record streams shared by the processors, written in the background
+ */
+#ifndef __OUTPUTSERVICE_HPP__
+#define __OUTPUTSERVICE_HPP__
+
+#include <map>
+#include <string>
+
+#include "ColumnWriter.hpp"
+
+/** \brief The record streams of the processors, owned by the DetectorDriver
+ *
+ * A processor which writes some values for its events (e.g. the ToF and QDC
+ * of the bars) opens a stream by name in its Init, adds a column for each
+ * value with the AddColumn of the ColumnWriter, and calls Fill for every
+ * record. Each stream is a columnar file (see ColumnWriter.hpp) named after
+ * the stream in the output path of the configuration. The records are
+ * buffered in large chunks, which a thread of the stream compresses and
+ * writes, so a record costs a copy of its values instead of formatted,
+ * flushed text. The streams are closed when the DetectorDriver is deleted,
+ * after the processors.
+ */
+class OutputService {
+public:
+    /** Constructor
+    * \param [in] chunkSize : the number of records of a chunk
+    * \param [in] level : the zlib compression level, 0 to store the chunks */
+    OutputService(const unsigned int &chunkSize = 65536,
+                  const int &level = 1) :
+        chunkSize_(chunkSize), level_(level) {}
+
+    /** Destructor closing the streams */
+    ~OutputService() { Close(); }
+
+    /** Open a stream, or get the stream of the name if it is open already
+    * \param [in] name : the name of the stream, the file is name.col
+    * \return the stream, or NULL if its file could not be opened */
+    ColumnWriter *Open(const std::string &name);
+
+    /** Write the last chunk of every stream and close them */
+    void Close(void);
+
+private:
+    unsigned int chunkSize_; //!< the number of records of a chunk
+    int level_; //!< the compression level of the chunks
+    std::map<std::string, ColumnWriter *> streams_; //!< the open streams
+};
+
+#endif // __OUTPUTSERVICE_HPP__
@@ -0,0 +1,154 @@
+/** \file PixelMap.hpp
+ * \brief A sparse map of the pixels of a segmented detector
+ */
+#ifndef __PIXELMAP_HPP__
+#define __PIXELMAP_HPP__
+
+#include <deque>
+#include <vector>
+
+#include <cstddef>
+
+/** \brief Keeps a value, e.g. the history of the events, for each pixel of a
+ * detector with sizeX by sizeY pixels.
+ *
+ * Only an index of sizeX * sizeY integers is allocated up front. The value of
+ * a pixel is created, as a copy of the prototype, the first time the pixel
+ * fires, so a large detector costs memory only for the pixels that were hit.
+ * The values are kept in a deque and are not moved when pixels are added. */
+template<typename V>
+class PixelMap {
+public:
+    /** \brief A pixel that has fired and its value */
+    struct Pixel {
+        /** Constructor
+        * \param [in] px : the x position of the pixel
+        * \param [in] py : the y position of the pixel
+        * \param [in] pvalue : the value of the pixel */
+        Pixel(unsigned px, unsigned py, const V& pvalue) :
+            x(px), y(py), value(pvalue) {}
+        unsigned x; //!< the x position of the pixel
+        unsigned y; //!< the y position of the pixel
+        V value; //!< the value of the pixel
+    };
+
+    typedef V value_type; //!< the type of the value of a pixel
+    typedef typename std::deque<Pixel>::iterator iterator; //!< iterator
+    typedef typename std::deque<Pixel>::const_iterator const_iterator; //!< const iterator
+
+    /** Constructor
+    * \param [in] sizeX : the number of pixels in x
+    * \param [in] sizeY : the number of pixels in y
+    * \param [in] prototype : the value of a pixel when it first fires */
+    PixelMap(unsigned sizeX, unsigned sizeY, const V& prototype = V()) :
+        sizeX_(sizeX), sizeY_(sizeY), prototype_(prototype),
+        index_(sizeX * sizeY, 0) {}
+
+    /** \return the number of pixels in x */
+    unsigned GetSizeX() const { return sizeX_; }
+
+    /** \return the number of pixels in y */
+    unsigned GetSizeY() const { return sizeY_; }
+
+    /** \return true if there is a pixel at the position
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    bool IsValid(int x, int y) const {
+        return x >= 0 && y >= 0 && (unsigned)x < sizeX_ &&
+            (unsigned)y < sizeY_;
+    }
+
+    /** \return the value of the pixel, or NULL if it never fired or the
+    * position is not valid
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    V* Find(int x, int y) {
+        if (!IsValid(x, y) || index_[x * sizeY_ + y] == 0)
+            return NULL;
+        return &pixels_[index_[x * sizeY_ + y] - 1].value;
+    }
+
+    /** \return the value of the pixel, or NULL if it never fired or the
+    * position is not valid
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    const V* Find(int x, int y) const {
+        if (!IsValid(x, y) || index_[x * sizeY_ + y] == 0)
+            return NULL;
+        return &pixels_[index_[x * sizeY_ + y] - 1].value;
+    }
+
+    /** \return the value of the pixel, which is created if the pixel never
+    * fired. The position must be valid.
+    * \param [in] x : the x position
+    * \param [in] y : the y position */
+    V& Get(int x, int y) {
+        unsigned &slot = index_[x * sizeY_ + y];
+        if (slot == 0) {
+            pixels_.push_back(Pixel(x, y, prototype_));
+            slot = pixels_.size();
+        }
+        return pixels_[slot - 1].value;
+    }
+
+    /** Finds the pixels that fired around a position, within radius pixels
+    * in x and y. The pixel at the position itself is not included.
+    * \param [in] x : the x position
+    * \param [in] y : the y position
+    * \param [in] radius : the largest distance in x and y
+    * \param [out] found : the pixels that fired, added to the vector */
+    void Neighbours(int x, int y, unsigned radius,
+                    std::vector<Pixel*> &found) {
+        for (int i = x - (int)radius; i <= x + (int)radius; ++i) {
+            for (int j = y - (int)radius; j <= y + (int)radius; ++j) {
+                if ((i == x && j == y) || !IsValid(i, j) ||
+                    index_[i * sizeY_ + j] == 0)
+                    continue;
+                found.push_back(&pixels_[index_[i * sizeY_ + j] - 1]);
+            }
+        }
+    }
+
+    /** \return the number of pixels that fired */
+    size_t size() const { return pixels_.size(); }
+
+    /** \return iterator to the first pixel that fired */
+    iterator begin() { return pixels_.begin(); }
+
+    /** \return iterator past the last pixel that fired */
+    iterator end() { return pixels_.end(); }
+
+    /** \return iterator to the first pixel that fired */
+    const_iterator begin() const { return pixels_.begin(); }
+
+    /** \return iterator past the last pixel that fired */
+    const_iterator end() const { return pixels_.end(); }
+
+    /** \return the number of bytes held by the index and the pixels that
+    * fired, including what their values hold beyond their own object
+    * \param [in] valueBytes : gives the bytes held by a value beyond its
+    *     own object, e.g. the capacity of a vector */
+    template<typename F>
+    size_t GetMemory(F valueBytes) const {
+        size_t bytes = index_.capacity() * sizeof(unsigned) +
+            pixels_.size() * sizeof(Pixel);
+        for (const_iterator it = pixels_.begin(); it != pixels_.end(); ++it)
+            bytes += valueBytes(it->value);
+        return bytes;
+    }
+
+    /** Forgets all of the pixels and frees their values */
+    void clear() {
+        pixels_.clear();
+        index_.assign(index_.size(), 0);
+    }
+
+private:
+    unsigned sizeX_; //!< the number of pixels in x
+    unsigned sizeY_; //!< the number of pixels in y
+    V prototype_; //!< the value of a pixel when it first fires
+    std::vector<unsigned> index_; //!< position of each pixel in pixels_ + 1
+    std::deque<Pixel> pixels_; //!< the pixels that fired
+};
+
+#endif // __PIXELMAP_HPP__
@@ -6,7 +6,6 @@
 #ifndef __PLACES_HPP__
 #define __PLACES_HPP__
 
-#include <deque>
 #include <iostream>
 #include <vector>
 #include <utility>
@@ -15,6 +14,7 @@
 
 #include "Globals.hpp"
 #include "EventData.hpp"
+#include "RingBuffer.hpp"
 
 /** \brief A pure abstract class to define a "place" for correlator.
  *
@@ -27,10 +27,13 @@ public:
      * fifo remembers only current and previous event.
      * \param [in] resetable : if the place resets automatically
      * \param [in] max_size : sets the maximum size of the fifo */
-    Place(bool resetable = true, unsigned max_size = 2) {
+    Place(bool resetable = true, unsigned max_size = 2) :
+        info_(max_size, EventData(-1)), pendingInfo_(-1) {
         resetable_ = resetable;
         max_size_ = max_size;
         status_ = false;
+        rank_ = 0;
+        dirty_ = false;
     }
     /** Default Destructor */
     virtual ~Place() {};
@@ -130,34 +133,28 @@ public:
      * (raises exception).
      * \param [in] index : the index to get from the fifo
      * \return data in fifo */
-    virtual EventData operator [](unsigned index) const {
+    virtual const EventData& operator [](unsigned index) const {
         return info_.at(index);
     }
 
     /** Easy access to last (current) element of fifo. If fifo
      * is empty time=-1 event is returned
      * \return The last EventData entry in the fifo */
-    virtual EventData last() {
+    virtual const EventData& last() const {
+        static const EventData empty(-1);
         if(info_.size() > 0)
             return info_.back();
-        else {
-                EventData empty(-1);
-                return empty;
-            }
+        return empty;
     }
 
     /** Easy access to the second to last element of fifo. If fifo
      * has only one event, time=-1 event is returned.
      * \return Second to last event data */
-    virtual EventData secondlast() {
-        if(info_.size() > 1) {
-                unsigned sz = info_.size();
-                return info_.at(sz - 2);
-            }
-        else {
-                EventData empty(-1);
-                return empty;
-            }
+    virtual const EventData& secondlast() const {
+        static const EventData empty(-1);
+        if(info_.size() > 1)
+            return info_[info_.size() - 2];
+        return empty;
     }
 
     /** Returns true if place should automatically deactivate
@@ -168,10 +165,40 @@ public:
     virtual bool resetable() const {
         return resetable_;
     }
+
+    /** Writes the status of the place and the events in its fifo, so that
+    * a scan can be resumed from a checkpoint.
+    * \param [out] out : the stream to write to */
+    virtual void save(std::ostream& out) const;
+
+    /** Reads back the status and fifo written by save().
+    * \param [in] in : the stream to read from
+    * \return true if the place was read */
+    virtual bool load(std::istream& in);
+
+    /** \return the places to whom this place reports changes of status */
+    const std::vector<Place*>& getParents() const {
+        return parents_;
+    }
+
+    /** \return the rank of the place in the evaluation order, which is
+    * larger than the rank of any of its children */
+    unsigned rank() const {
+        return rank_;
+    }
+
+    /** Sets the rank of the place in the evaluation order, when the tree is
+    * compiled by the TreeCorrelator.
+    * \param [in] rank : the rank of the place */
+    void setRank(unsigned rank) {
+        rank_ = rank;
+    }
+
     /** Pythonic style private field. Use it if you must,
      * but perhaps you should not. Stores information on past
-     * events in a given Place.*/
-    std::deque<EventData> info_;
+     * events in a given Place. The fifo holds max_size_ events and
+     * its storage is allocated once, when the place is created.*/
+    RingBuffer<EventData> info_;
 
 protected:
     /** Pure virutal function. The check function should decide how
@@ -190,22 +217,19 @@ protected:
         parents_.push_back(parent);
     }
 
-    /** Reports change of status to parents.
-     * Calls check() function for all the parents.
+    /** Reports change of status to parents. The parents are marked as
+     * dirty and the check() function is then called for all of the dirty
+     * places in the order of their rank, so that a place is checked only
+     * once for each activation even if it is reached by several paths.
+     * Reports made while checking only mark the places.
      * \param [in] info : the information to report
      */
-    virtual void report_(EventData& info) {
-        std::vector<Place*>::iterator it;
-        for(it = parents_.begin(); it != parents_.end(); ++it)
-            (*it)->check_(info);
-    }
+    virtual void report_(EventData& info);
 
     /** Add information to the place
     * \param [in] info : the information to add */
     virtual void add_info_(const EventData& info) {
         info_.push_back(info);
-        while(info_.size() > max_size_)
-            info_.pop_front();
     }
 
     /** Status is true if given place is in active state (e.g. detector
@@ -226,6 +250,20 @@ protected:
      * should be reported.
      */
     std::vector<Place*> parents_;
+
+    unsigned rank_; //!< the rank of the place in the evaluation order
+    bool dirty_; //!< true if the place is waiting to be checked
+    EventData pendingInfo_; //!< the last information reported to the place
+
+    /** \return true if place a should be checked after place b
+    * \param [in] a : the first place
+    * \param [in] b : the second place */
+    static bool checkedAfter_(const Place* a, const Place* b) {
+        return a->rank_ > b->rank_;
+    }
+
+    static std::vector<Place*> dirtyPlaces_; //!< heap of the dirty places
+    static bool propagating_; //!< true while the dirty places are checked
 };
 
 /** \brief "Lazy" Place does not store multiple activation or deactivation events.
@@ -374,6 +412,15 @@ public:
         return counter_;
     }
 
+    /** Writes the place and its counter
+    * \param [out] out : the stream to write to */
+    virtual void save(std::ostream& out) const;
+
+    /** Reads back the place and its counter
+    * \param [in] in : the stream to read from
+    * \return true if the place was read */
+    virtual bool load(std::istream& in);
+
 protected:
     int counter_;//!< The counter for the place activation
 
@@ -8,16 +8,79 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "Globals.hpp"
 #include "HisFile.hpp"
 #include "PlotsRegister.hpp"
 
+/** A histogram declaration, so that a processor may keep all of its
+* histograms in a constexpr table, whose ids are checked at compile time
+* with HistogramTableIsValid, and declare them in one go. */
+struct HistogramDef {
+    int id; //!< the id of the histogram, relative to the processor offset
+    int xSize; //!< the range of the x-axis
+    int ySize; //!< the range of the y-axis, zero for a 1D histogram
+    const char *title; //!< the title of the histogram
+    int halfWordsPerChan; //!< the half words per channel, zero for default
+};
+
+/** 
+eturn true if one of the n histograms of defs has the given id
+* \param [in] id : the id to look for
+* \param [in] defs : the histogram declarations
+* \param [in] n : the number of declarations */
+constexpr bool HistogramIdInTable(int id, const HistogramDef *defs,
+                                  size_t n) {
+    return n > 0 && (defs[0].id == id || HistogramIdInTable(id, defs + 1,
+                                                            n - 1));
+}
+
+/** 
+eturn true if the ids of the n histograms of defs are all different
+* and within [0, range)
+* \param [in] defs : the histogram declarations
+* \param [in] n : the number of declarations
+* \param [in] range : the range of the ids of the processor */
+constexpr bool HistogramTableIsValid(const HistogramDef *defs, size_t n,
+                                     int range) {
+    return n == 0 || (defs[0].id >= 0 && defs[0].id < range &&
+                      !HistogramIdInTable(defs[0].id, defs + 1, n - 1) &&
+                      HistogramTableIsValid(defs + 1, n - 1, range));
+}
+
+/** 
+eturn true if the ids of the table are all different and within
+* [0, range)
+* \param [in] defs : the table of histogram declarations
+* \param [in] range : the range of the ids of the processor */
+template<size_t N>
+constexpr bool HistogramTableIsValid(const HistogramDef (&defs)[N],
+                                     int range) {
+    return HistogramTableIsValid(defs, N, range);
+}
+
 //! Holds pointers to all Histograms
 class Plots {
 public:
+    /** A declared histogram, which is plotted into without looking up its
+    * id or mnemonic. A default constructed handle is not valid and plotting
+    * into it does nothing. */
+    class Handle {
+    public:
+        /** Default constructor of an invalid handle */
+        Handle() : id_(-1) {}
+        /** \return true if the handle refers to a declared histogram */
+        bool IsValid() const { return id_ >= 0; }
+    private:
+        friend class Plots;
+        int id_; //!< the dammId of the histogram, with the offset
+    };
+
     /** Default constructor that takes the offset, range, and name of processor
     * \param [in] offset : the offset for the processor
     * \param [in] range : the range for the processor
@@ -43,6 +106,18 @@ public:
      * \param [in] mne : the name to check in the list */
     bool Exists (const std::string &mne) const;
 
+    /** Look up a declared histogram once, to plot into it with its handle
+    * \param [in] id : the id of the histogram
+    * \return the handle of the histogram, which is invalid if the histogram
+    * was not declared */
+    Handle GetHandle(int id) const;
+
+    /** Look up a declared histogram once, to plot into it with its handle
+    * \param [in] mne : the mnemonic of the histogram
+    * \return the handle of the histogram, which is invalid if the histogram
+    * was not declared */
+    Handle GetHandle(const std::string &mne) const;
+
 
     /*! \brief Declares a 1D histogram calls the C++ wrapper for DAMM
     * \param [in] dammId : The histogram number to define
@@ -62,11 +137,12 @@ public:
     * \param [in] dammId : The histogram number to define
     * \param [in] xSize : The range of the x-axis
     * \param [in] title : The title for the histogram
-    * \param [in] halfWordsPerChan : the half words per channel in the his
+    * \param [in] halfWordsPerChan : the half words per channel in the his,
+    * histograms which saturate 16 bit bins are written with 32 bit bins
     * \param [in] mne : the mnemonic for the histogram
     * \return true if things go all right */
     bool DeclareHistogram1D(int dammId, int xSize, const char* title,
-                int halfWordsPerChan = 2, const std::string &mne = "");
+                int halfWordsPerChan = 1, const std::string &mne = "");
 
     /*! \brief Declares a 1D histogram calls the C++ wrapper for DAMM
     * \param [in] dammId : The histogram number to define
@@ -125,6 +201,12 @@ public:
                              int halfWordsPerChan, int xContraction,
                              int yContraction, const std::string &mne = "");
 
+    /*! \brief Declares a table of 1D and 2D histograms
+    * \param [in] defs : the histogram declarations
+    * \param [in] n : the number of declarations
+    * \return true if things go all right */
+    bool DeclareHistograms(const HistogramDef *defs, size_t n);
+
     /*! \brief Plots into histogram defined by dammId
     * \param [in] dammId : The histogram number to define
     * \param [in] val1 : the x value
@@ -145,6 +227,26 @@ public:
     bool Plot(const std::string &mne, double val1, double val2 = -1,
               double val3 = -1, const char* name="h");
 
+    /*! \brief Plots into the histogram of a handle from GetHandle, which
+    * is the fastest way to plot since nothing is looked up
+    * \param [in] handle : the histogram to plot into
+    * \param [in] val1 : the x value
+    * \param [in] val2 : the y value or weight for a 1D histogram
+    * \param [in] val3 : the z value or weight in a 2D histogram
+    * \return true if successful */
+    bool Plot(const Handle &handle, double val1, double val2 = -1,
+              double val3 = -1);
+
+    /*! \brief Plots a whole row of a 2D histogram, e.g. a trace, the same as
+    * Plot(dammId, x, row, values[x]) for every x but with the histogram
+    * looked up once
+    * \param [in] dammId : The histogram number to plot into
+    * \param [in] row : the y value
+    * \param [in] values : the weight of each x value
+    * \param [in] n : the number of x values
+    * \return true if successful */
+    bool PlotRow(int dammId, int row, const double *values, size_t n);
+
     /** Method to test if a parameter is inside of a loaded banana
     *
     * Will not help you defend against a man wielding a pointed stick.
@@ -154,18 +256,104 @@ public:
     * \return true if the x,y coordinate was inside the banana */
     bool BananaTest(const int &id, const double &x, const double &y);
 
+    /** Let Plot be called from several threads at once when processors run
+    * concurrently. Each thread then adds its fills up in a buffer of its
+    * own, without taking any lock, and the buffers are added to the
+    * histograms by MergeFills, or by the thread once its buffer is full.
+    * \param [in] state : true if the fills are to be buffered per thread */
+    static void SetConcurrent(bool state);
+
+    /** Make the concurrent fills reproducible. The fills are then buffered
+    * per slot, selected by the thread with SelectSlot before it fills for,
+    * e.g., a processor, instead of per thread. The buffers are only added
+    * to the histograms by MergeFills, in the order of their slots, so the
+    * histograms are filled in the same order whichever thread ran what.
+    * Call when no thread is filling.
+    * \param [in] state : true to buffer the fills per slot
+    * \param [in] numSlots : the number of slots */
+    static void SetDeterministic(bool state, size_t numSlots = 0);
+
+    /** \return true if the fills are buffered per slot */
+    static bool IsDeterministic(void) { return deterministic_; }
+
+    /** Buffer the next fills of the calling thread in the buffer of a slot,
+    * in the deterministic mode. Only one thread may fill a slot at a time.
+    * \param [in] slot : the slot, e.g. 0 for the DetectorDriver and one
+    *   more than the index of a processor */
+    static void SelectSlot(size_t slot) {
+        if (slot < slots_.size())
+            buffer_ = slots_[slot];
+    }
+
+    /** Add the fills buffered by every thread, and then by every slot in
+    * order, to the histograms. Call when no thread is filling, e.g. once
+    * the processors are done with an event */
+    static void MergeFills(void);
+
 private:
+    /** A bin of a histogram, the fills of which are added up in a buffer */
+    struct FillKey {
+        int id; //!< the dammId of the histogram, with the offset
+        int x; //!< the x value of the fill
+        int y; //!< the y value of the fill
+        /** \return true if both are the same bin */
+        bool operator==(const FillKey &rhs) const {
+            return (id == rhs.id && x == rhs.x && y == rhs.y);
+        }
+    };
+
+    /** Hash of a FillKey */
+    struct FillKeyHash {
+        /** \return the hash of the key */
+        size_t operator()(const FillKey &key) const {
+            return ((size_t)key.id * 2654435761u) ^ ((size_t)key.x << 16) ^
+                (size_t)key.y * 40503u;
+        }
+    };
+
+    /** The total weight of the fills into each bin by one thread */
+    typedef std::unordered_map<FillKey, int, FillKeyHash> FillBuffer;
+
+    /** Plots into the histogram with the given id, including the offset
+    * \param [in] id : the dammId of the histogram, with the offset
+    * \param [in] val1 : the x value
+    * \param [in] val2 : the y value or weight for a 1D histogram
+    * \param [in] val3 : the z value or weight in a 2D histogram */
+    static void PlotId(int id, double val1, double val2, double val3);
+
+    /** Fill a bin with a weight, the weight being the count of the fills
+    * for the histograms filled with count1cc_
+    * \param [in] key : the bin to fill
+    * \param [in] weight : the weight of the fill */
+    static void Fill(const FillKey &key, int weight);
+
+    /** Add a fill to the buffer of the calling thread
+    * \param [in] key : the bin to fill
+    * \param [in] weight : the weight of the fill */
+    static void Buffer(const FillKey &key, int weight);
+
+    /** Add the buffered fills to the histograms and empty the buffer. The
+    * caller holds fillMutex_.
+    * \param [in] buffer : the buffer to empty */
+    static void Merge(FillBuffer &buffer);
+
     static PlotsRegister* plots_register_;//!< Instance of the plots register
+    static bool concurrent_; //!< True if the fills are buffered per thread
+    static bool deterministic_; //!< True if the fills are buffered per slot
+    static std::vector<FillBuffer*> slots_; //!< Fill buffer of each slot
+    static std::mutex fillMutex_; //!< Lock taken to merge the fill buffers
+    static std::vector<FillBuffer*> buffers_; //!< Fill buffer of each thread
+    static thread_local FillBuffer *buffer_; //!< Fill buffer of this thread
     /** Holds offset for a given set of plots */
     int offset_;
     /** Holds allowed range for a given set of plots*/
     int range_;
     /** Name of the owner of plots, mainly for debugging */
     std::string name_;
-    /** set of int (relative dammId without offsets */
-    std::set <int> idList_;
+    /** True for each declared relative dammId (without offset) */
+    std::vector<bool> idList_;
     /** Map of mnemonic -> int */
-    std::map <std::string, int> mneList;
+    std::unordered_map <std::string, int> mneList;
     /** Map of dammid -> title, helps debugging duplicated dammids*/
     std::map <int, std::string> titleList;
     /** A function to round the value before passing it to DAMM
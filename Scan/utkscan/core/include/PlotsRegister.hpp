@@ -6,9 +6,9 @@
 #ifndef __PLOTSREGISTER_HPP_
 #define __PLOTSREGISTER_HPP_
 
-#include <utility>
-#include <vector>
+#include <map>
 #include <string>
+#include <utility>
 
 //! Holds ranges and offsets of all plots. Singleton class.
 class PlotsRegister {
@@ -29,6 +29,12 @@ public:
     * \return true if everything is good */
     bool Add(int offset, int range, std::string name_);
 
+    /** \return the registered ranges, as the max of the histogram numbers
+    * and the name of their owner keyed by the min */
+    const std::map<int, std::pair<int, std::string> > &GetRanges() const {
+        return reg;
+    }
+
     /** Default destructor */
     ~PlotsRegister();
 
@@ -39,6 +45,6 @@ private:
     PlotsRegister& operator= (PlotsRegister const&);//!< the copy constructor
     static PlotsRegister* instance;//!< static instance of the class
 
-    std::vector< std::pair<int, int> > reg; //!< Vector of min, max of histogram numbers
+    std::map<int, std::pair<int, std::string> > reg; //!< Max of the histogram numbers and owner keyed by the min
 };
 #endif // __PLOTSREGISTER_HPP_
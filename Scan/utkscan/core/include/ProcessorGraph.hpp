@@ -0,0 +1,124 @@
+/** \file ProcessorGraph.hpp
+ * \brief Runs the event processors of an event, concurrently where allowed
+ */
+#ifndef __PROCESSORGRAPH_HPP_
+#define __PROCESSORGRAPH_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.hpp"
+
+class EventProcessor;
+class RawEvent;
+
+/** \brief Dependency graph of the event processors
+ *
+ * A processor depends on every processor before it in the configuration
+ * that writes a place or summary that it reads or writes, or that reads
+ * a place or summary that it writes (see EventProcessor::DeclareAccess).
+ * The PreProcess of all of the processors is run first and then their
+ * Process, as in the serial analysis. Within each stage a processor is
+ * started as soon as all of the processors that it depends on have
+ * finished, on the first free thread of a pool. With a single thread the
+ * processors are simply run in the order of the configuration.
+ *
+ * In the deterministic mode each processor draws its random numbers from a
+ * stream keyed by the sequence number of the event and the processor, and
+ * buffers its fills in a slot of its own, which are added to the histograms
+ * in the order of the configuration (see Plots::SetDeterministic). The
+ * places and summaries are already written in the order of the
+ * configuration, as the processors writing the same ones depend on each
+ * other. The results of a scan are then the same for any number of threads.
+ */
+class ProcessorGraph {
+public:
+    /** Default Constructor */
+    ProcessorGraph();
+
+    /** Default Destructor, stops the threads */
+    ~ProcessorGraph();
+
+    /** Build the graph of the processors and start the threads. Must be
+    * called once the processors and the TreeCorrelator are initialized.
+    * \param [in] procs : the processors in the order of the configuration
+    * \param [in] threads : the number of threads to run processors on,
+    *    including the thread calling Run
+    * \param [in] profiler : records the time of every PreProcess and
+    *    Process, if not NULL
+    * \param [in] deterministic : true to make the random numbers and the
+    *    fills of the processors independent of the threads */
+    void Build(const std::vector<EventProcessor*> &procs, unsigned int threads,
+               Profiler *profiler = NULL, bool deterministic = false);
+
+    /** Run PreProcess and then Process for every processor with an event.
+    * An exception thrown by a processor is passed on once the stage has
+    * finished.
+    * \param [in] event : the event to process */
+    void Run(RawEvent &event);
+
+    /** \return the number of threads processors are run on */
+    unsigned int GetNumThreads(void) const { return workers_.size() + 1; }
+
+    /** \return the length of the longest chain of dependent processors */
+    unsigned int GetDepth(void) const { return depth_; }
+
+private:
+    /** The two stages in which the processors are run */
+    enum Stage {PREPROCESS, PROCESS};
+
+    std::vector<EventProcessor*> procs_; //!< The processors in the graph
+    std::vector<std::vector<size_t> > dependents_; //!< Processors waiting on each processor
+    std::vector<unsigned int> numDeps_; //!< Number of processors each one depends on
+    std::vector<unsigned int> waiting_; //!< Unfinished dependencies in the current stage
+    unsigned int depth_; //!< Length of the longest chain of dependencies
+    Profiler *profiler_; //!< Records the time of the processors, may be NULL
+    bool deterministic_; //!< True to key the randoms and fills of each processor
+    std::vector<unsigned int> timerIds_; //!< Profiler ids of the PreProcess and Process of each processor
+
+    std::deque<size_t> ready_; //!< Processors ready to run in the current stage
+    size_t done_; //!< Number of processors finished in the current stage
+    Stage stage_; //!< The current stage
+    RawEvent *event_; //!< The event being processed
+    std::exception_ptr error_; //!< First exception thrown in the current stage
+
+    std::vector<std::thread> workers_; //!< The threads of the pool
+    std::mutex mutex_; //!< Lock for the state of the current stage
+    std::condition_variable changed_; //!< Signalled when a processor is ready or finished
+    bool stop_; //!< Set to true to stop the threads
+
+    /** Run one stage of every processor, using the pool
+    * \param [in] event : the event to process
+    * \param [in] stage : the stage to run */
+    void RunStage(RawEvent &event, Stage stage);
+
+    /** Run the next ready processor and release the processors waiting on it
+    * \param [in] lock : the lock on mutex_, held on entry and on return */
+    void RunNext(std::unique_lock<std::mutex> &lock);
+
+    /** Run one stage of a processor if it has an event, and time it
+    * \param [in] node : the index of the processor
+    * \param [in] stage : the stage to run
+    * \param [in] event : the event to process */
+    void RunProcessor(size_t node, Stage stage, RawEvent &event);
+
+    /** The loop of each thread of the pool */
+    void Worker(void);
+
+    /** Stop and join the threads of the pool */
+    void Stop(void);
+
+    /** \return the names of the places matching the declared names, with
+    * the names of all of their parents if parents is true
+    * \param [in] names : the declared names of places and summaries
+    * \param [in] parents : true to add the parents of the places */
+    static std::set<std::string> Expand(const std::set<std::string> &names,
+                                        bool parents);
+};
+#endif // __PROCESSORGRAPH_HPP_
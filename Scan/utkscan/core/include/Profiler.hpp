@@ -0,0 +1,71 @@
+/** \file Profiler.hpp
+ * \brief Collects the wall-clock time spent in the parts of the analysis
+ */
+#ifndef __PROFILER_HPP_
+#define __PROFILER_HPP_
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** \brief Accumulates the wall-clock time of processors and analyzers
+ *
+ * Each part of the analysis that is to be timed, such as the Process of a
+ * processor or the Analyze of a trace analyzer, is added once and given an
+ * id. The time of every call is then recorded with the steady clock, and a
+ * table of the parts sorted by their total time is printed at the end of
+ * the run. Several threads may record at once as long as no two of them
+ * record for the same part.
+ */
+class Profiler {
+public:
+    typedef std::chrono::steady_clock clock; //!< The clock used for timing
+
+    /** Default Constructor */
+    Profiler() : eventTime_(clock::duration::zero()), numEvents_(0) {};
+
+    /** Add a part of the analysis to be timed
+    * \param [in] name : the name of the processor or analyzer
+    * \param [in] stage : the stage that is timed, e.g. Process
+    * \return the id to record the time of the part with */
+    unsigned int Add(const std::string &name, const std::string &stage);
+
+    /** Record the time of a single call of a part
+    * \param [in] id : the id returned by Add
+    * \param [in] start : the time at which the call started */
+    void Record(unsigned int id, const clock::time_point &start) {
+        clock::duration elapsed = clock::now() - start;
+        Entry &entry = entries_[id];
+        entry.calls++;
+        entry.total += elapsed;
+        if (elapsed > entry.max)
+            entry.max = elapsed;
+    }
+
+    /** Record the time of a whole event, to which the parts are compared
+    * \param [in] start : the time at which the event started */
+    void RecordEvent(const clock::time_point &start) {
+        eventTime_ += clock::now() - start;
+        numEvents_++;
+    }
+
+    /** Print the table of the parts, the most expensive first
+    * \param [in] out : the stream to print to */
+    void Print(std::ostream &out) const;
+
+private:
+    /** The accumulated time of one part of the analysis */
+    struct Entry {
+        std::string name; //!< Name of the processor or analyzer
+        std::string stage; //!< Stage which is timed
+        unsigned long long calls; //!< Number of calls recorded
+        clock::duration total; //!< Total time of all calls
+        clock::duration max; //!< Time of the longest call
+    };
+
+    std::vector<Entry> entries_; //!< The timed parts of the analysis
+    clock::duration eventTime_; //!< Total time of all events
+    unsigned long long numEvents_; //!< Number of events recorded
+};
+#endif // __PROFILER_HPP_
@@ -0,0 +1,134 @@
+/** \file QdcPositions.hpp
+ * \brief Positions along the strips of a detector from the QDCs of their edges
+ */
+#ifndef __QDCPOSITIONS_HPP__
+#define __QDCPOSITIONS_HPP__
+
+#include <vector>
+
+#include <cstddef>
+
+class ChanEvent;
+class Trace;
+
+/** \brief Computes the QDCs of the two edges (top and bottom) of the strips
+ * hit in an event, and the position of the hit along each strip from their
+ * ratio.
+ *
+ * The QDCs are taken in windows of the trace which follow each other. The
+ * first window is the baseline, which is subtracted from the others in
+ * proportion to their lengths before they are normalized by their lengths.
+ * The position is the fraction of one of the QDCs seen by the top edge,
+ * scaled between the smallest and the largest fraction of the location.
+ *
+ * The edges of all the strips of an event are added first, and the QDCs
+ * which the modules did not write are summed from the trace. The QDCs are
+ * kept as one array of all the strips for each window, so that Compute
+ * runs over the strips of the event in loops without branches, which the
+ * compiler vectorizes, instead of doing the arithmetic of each strip on
+ * its own. The arrays are kept between the events, so that the events do
+ * not allocate once they have grown.
+ */
+class QdcPositions {
+public:
+    /** Number of QDC windows, the first one being the baseline */
+    static const size_t kNumQdcs = 8;
+
+    /** Default constructor, every window is empty */
+    QdcPositions();
+
+    /** Set the windows of the QDCs
+    * \param [in] lengths : the length of each window in samples, the
+    *     windows following each other from the start of the trace */
+    void SetWindows(const float *lengths);
+
+    /** Set the QDC used for the position and the scale of the position
+    * \param [in] whichQdc : the window giving the position, from 1 to
+    *     kNumQdcs - 1, the position is NAN for any other
+    * \param [in] scale : the position of a hit with the largest fraction */
+    void SetPosition(int whichQdc, float scale) {
+        whichQdc_ = whichQdc;
+        posScale_ = scale;
+    }
+
+    /** Forget the strips of the last event */
+    void Clear();
+
+    /** Add the edges of a strip. The QDCs are read from the edges, or summed
+    * from their traces if the module did not write them.
+    * \param [in] top : the top edge
+    * \param [in] bottom : the bottom edge
+    * \param [in] minNorm : the smallest fraction of the location
+    * \param [in] maxNorm : the largest fraction of the location
+    * \return false if a baseline had to be summed from a trace and either
+    *     baseline is zero, in which case the strip is not added */
+    bool Add(const ChanEvent &top, const ChanEvent &bottom,
+             float minNorm, float maxNorm);
+
+    /** Compute the QDCs, their fractions and the positions of every strip
+    * added since the last Clear */
+    void Compute();
+
+    /** \return the number of strips added */
+    size_t size() const { return minNorm_.size(); }
+
+    /** \return the baseline subtracted QDC of the top edge, per sample
+    * \param [in] qdc : the window
+    * \param [in] i : the strip */
+    float Top(size_t qdc, size_t i) const { return top_[qdc][i]; }
+
+    /** \return the baseline subtracted QDC of the bottom edge, per sample
+    * \param [in] qdc : the window
+    * \param [in] i : the strip */
+    float Bottom(size_t qdc, size_t i) const { return bottom_[qdc][i]; }
+
+    /** \return the fraction of the QDC seen by the top edge, per mil
+    * \param [in] qdc : the window
+    * \param [in] i : the strip */
+    float Fraction(size_t qdc, size_t i) const { return frac_[qdc][i]; }
+
+    /** \return the QDC of the top edge over all windows but the baseline,
+    * per sample
+    * \param [in] i : the strip */
+    float TopTotal(size_t i) const { return topTot_[i]; }
+
+    /** \return the QDC of the bottom edge over all windows but the baseline,
+    * per sample
+    * \param [in] i : the strip */
+    float BottomTotal(size_t i) const { return bottomTot_[i]; }
+
+    /** \return the position along the strip, NAN if there is no QDC for it
+    * \param [in] i : the strip */
+    float Position(size_t i) const { return position_[i]; }
+
+private:
+    /** Read the QDCs of an edge, summing those which the module did not
+    * write from the trace
+    * \param [in] chan : the edge
+    * \param [out] qdcs : the kNumQdcs QDCs of the edge */
+    void ReadQdcs(const ChanEvent &chan, float *qdcs) const;
+
+    /** \return the sum of the samples of the trace in [begin, end), clipped
+    * to the trace
+    * \param [in] trace : the trace
+    * \param [in] begin : the first sample
+    * \param [in] end : the sample past the last one */
+    static float SumWindow(const Trace &trace, size_t begin, size_t end);
+
+    float len_[kNumQdcs]; //!< the length of each window in samples
+    size_t end_[kNumQdcs]; //!< the sample past the end of each window
+    float totLen_; //!< the length of all windows but the baseline
+    int whichQdc_; //!< the window giving the position
+    float posScale_; //!< the position of a hit with the largest fraction
+
+    std::vector<float> top_[kNumQdcs]; //!< the QDCs of the top edges, by window
+    std::vector<float> bottom_[kNumQdcs]; //!< the QDCs of the bottom edges, by window
+    std::vector<float> frac_[kNumQdcs]; //!< the fractions of the top edges, by window
+    std::vector<float> topTot_; //!< the total QDCs of the top edges
+    std::vector<float> bottomTot_; //!< the total QDCs of the bottom edges
+    std::vector<float> minNorm_; //!< the smallest fraction of the location of each strip
+    std::vector<float> maxNorm_; //!< the largest fraction of the location of each strip
+    std::vector<float> position_; //!< the position of each strip
+};
+
+#endif // __QDCPOSITIONS_HPP__
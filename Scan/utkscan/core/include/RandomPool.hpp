@@ -1,37 +1,88 @@
 /** \file RandomPool.hpp
- * \brief Holds a pre-generated pool of random numbers
+ * \brief Provides uniform random numbers to every thread of the analysis
  *
- * This generates a pool of random numbers using the Mersenne twister.
+ * Each thread draws from its own stream of the Philox4x32-10 counter based
+ * generator, so no state is shared between threads and nothing has to be
+ * generated up front. Streams are numbered in the order in which threads
+ * first draw from them, and every stream is fully determined by the seed
+ * and its number, so a scan gives the same numbers on every run.
+ *
+ * In the deterministic mode (see the deterministic attribute of the
+ * DetectorDriver) a thread instead keys its stream by the sequence number
+ * of the raw event and the processor it runs with SetEvent, so the numbers
+ * drawn for an event do not depend on which thread runs what.
  * \author David Miller
  * \date 18 August 2010
  */
 #ifndef __RANDOMPOOL_HPP_
 #define __RANDOMPOOL_HPP_
 
-#include "MersenneTwister.hpp"
+#include <atomic>
+
+#include <stdint.h>
 
-//! A random pool of numbers using Mersenne twister - Singleton Class
+//! Random numbers from per thread counter based streams - Singleton Class
 class RandomPool {
 private:
     RandomPool(); //!<Default constructor
     RandomPool (const RandomPool&);  //!< Overload of the constructor
     RandomPool& operator= (RandomPool const&);//!< the copy constructor
-    static RandomPool* instance;//!< static instance of the class
 
-    static const size_t size = 1000000; ///< default size of the pool
+    //! The state of the stream of one thread
+    struct Stream {
+        unsigned int generation; //!< Generation the stream was started in, 0 if never
+        uint32_t counter[4]; //!< Counter of the next block, word 2 holds the stream number, words 1 and 3 the event of a keyed stream
+        double numbers[2]; //!< Numbers of the current block
+        unsigned int next; //!< Index of the next unused number in the block
+    };
+
+    static thread_local Stream stream_; //!< The stream of the calling thread
 
-    MTRand generator;     ///< random number generator
-    size_t counter;       ///< current random number index
-    double numbers[size]; ///< the pool of random numbers
+    std::atomic<unsigned int> generation_; //!< Incremented to restart all streams
+    std::atomic<uint32_t> numStreams_; //!< Streams started in this generation
+    uint32_t key_[2]; //!< The key of the generator, set from the seed
+
+    /** Start the stream of a thread if needed and fill its next block
+    * \param [in] stream : the stream of the calling thread */
+    void Refill(Stream &stream);
 public:
     /** \return The only instance to the random pool */
     static RandomPool* get();
 
-    void Generate(void); //!< Generates a random number
+    /** Restarts the streams of all threads, which are numbered again in the
+    * order in which the threads next draw from them */
+    void Generate(void);
+
+    /** Sets the seed of every stream and restarts them
+    * \param [in] seed : the new seed */
+    void SetSeed(uint64_t seed);
+
+    /** Start the stream of the calling thread keyed by an event and a
+    * stream of that event, e.g. the processor being run. The numbers drawn
+    * until the next SetEvent (or Generate) only depend on the seed, the
+    * event and the stream.
+    * \param [in] sequence : the sequence number of the raw event
+    * \param [in] stream : the stream within the event */
+    void SetEvent(uint64_t sequence, uint32_t stream = 0) {
+        Stream &s = stream_;
+        s.generation = generation_.load(std::memory_order_relaxed);
+        s.counter[0] = 0;
+        s.counter[1] = (uint32_t)sequence;
+        s.counter[2] = stream;
+        //! The top bit keeps the keyed streams apart from the numbered ones
+        s.counter[3] = (uint32_t)(sequence >> 32) | 0x80000000u;
+        s.next = 2;
+    }
 
-    /** \return a random number in the specified range [0, range]
+    /** \return a random number in the specified range [0, range)
     * \param [in] range : the upper bound for the range to get */
-    double Get(double range = 1);
+    double Get(double range = 1) {
+        Stream &stream = stream_;
+        if (stream.next > 1 ||
+            stream.generation != generation_.load(std::memory_order_relaxed))
+            Refill(stream);
+        return stream.numbers[stream.next++] * range;
+    }
 };
 
 #endif // __RANDOMPOOL_HPP_
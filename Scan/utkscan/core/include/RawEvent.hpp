@@ -11,12 +11,16 @@
 #ifndef __RAWEVENT_HPP_
 #define __RAWEVENT_HPP_
 
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
 
+#include <stdint.h>
+
 #include "pixie16app_defs.h"
 
 #include "Globals.hpp"
@@ -44,13 +48,13 @@ class ChanEvent;
 class RawEvent {
 public:
     /** Default Constructor */
-    RawEvent(){};
+    RawEvent() : generation(0), sequence(0), kept(false) {};
 
-    /** Default Destructor */
-    ~RawEvent(){};
+    /** Destructor, deletes the channel events held by the raw event */
+    ~RawEvent();
 
     /** Clear the list of individual channel events (Memory is managed elsewhere) */
-    void Clear(void) {eventList.clear();};
+    void Clear(void) {eventList.clear(); generation++;};
 
     /** \return the number of channels in the current event */
     size_t Size(void) const {return(eventList.size());};
@@ -63,12 +67,21 @@ public:
 
     /** Add a channel event to the raw event
     * \param [in] event : the event to add to the raw event */
-    void AddChan(ChanEvent* event) {eventList.push_back(event);};
+    void AddChan(ChanEvent* event) {eventList.push_back(event); generation++;};
+
+    /** Add a channel event filled from XIA data to the raw event. A channel
+    * event that was released by Zero is reused when one is available, so
+    * that no allocation is made once the pool has grown to the largest
+    * event multiplicity.
+    * \param [in] xiadata : the XIA data to fill the channel event with
+    * \return a pointer to the added channel event */
+    ChanEvent *AddChan(XiaData *xiadata);
 
     /** \brief Raw event zeroing
     *
-    * For any detector type that was used in the event, zero the appropriate
-    * detector summary in the map, and clear the event list
+    * Clear the event list. The channel events are kept to be reused by
+    * AddChan. The detector summaries are not touched, they are filled
+    * again from the new event list the first time they are read.
     * \param [in] usedev : the detector summary to zero */
     void Zero(const std::set<std::string> &usedev);
 
@@ -85,13 +98,71 @@ public:
     * \param [in] a : the name of the summary that you would like */
     const DetectorSummary *GetSummary(const std::string &a) const;
 
+    /** \brief Get the handle of a detector summary
+    *
+    * The handle is resolved once, for instance in a processor's Init, and
+    * used with GetSummary(int) for every event so that no string lookup is
+    * made on the per-event path.
+    * \param [in] a : the name of the summary that you would like
+    * \param [in] construct : flag indicating if we need to construct the summary
+    * \return the handle of the summary, or -1 if it does not exist */
+    int GetSummaryId(const std::string &a, bool construct = true);
+
+    /** \return a pointer to the summary with the handle, NULL if it is invalid
+    * \param [in] id : the handle returned by GetSummaryId */
+    DetectorSummary *GetSummary(int id) {
+        if (id < 0 || id >= (int)summaries.size())
+            return NULL;
+        return summaries[id];
+    }
+
+    /** \brief Fill the requested detector summaries from the event list
+    *
+    * Only the summaries which were ever requested through GetSummary or
+    * GetSummaryId are filled, summaries of types that no processor asked
+    * for are never filled. Processors may keep a reference to the list of a
+    * summary across events, so this is to be called once the channels have
+    * been calibrated and before the processors run. Summaries are also
+    * filled when they are first read after the event list has changed. */
+    void FillSummaries(void);
+
     /** \return the list of events */
     const std::vector<ChanEvent *> &GetEventList(void) const {return eventList;}
+
+    /** Mark the event to be written to the skim file, see the Skim node of
+    * the configuration. Processors may call this concurrently, the mark is
+    * cleared by Zero. */
+    void Keep(void) {kept = true;}
+
+    /** \return true if a processor marked the event to be skimmed */
+    bool IsKept(void) const {return kept;}
+
+    /** Set the sequence number of the event, the number of raw events built
+    * from the data before it, which keys the random numbers of the event in
+    * the deterministic mode
+    * \param [in] seq : the sequence number */
+    void SetSequence(uint64_t seq) {sequence = seq;}
+
+    /** \return the sequence number of the event */
+    uint64_t GetSequence(void) const {return sequence;}
 private:
     std::map<std::string, DetectorSummary> sumMap; /**< An STL map containing DetectorSummary classes
 					    associated with detector types */
     mutable std::set<std::string> nullSummaries;   /**< Summaries which were requested but don't exist */
     std::vector<ChanEvent*> eventList; /**< Pointers to all the channels that are close
                                             enough in time to be considered a single event */
+    std::vector<ChanEvent*> freeEvents; /**< Channel events released by Zero, to be reused */
+    std::vector<DetectorSummary*> summaries; /**< Summaries in sumMap indexed by their handle */
+    unsigned long generation; /**< Changed whenever the event list changes */
+    uint64_t sequence; /**< Number of raw events built before this one */
+    std::atomic<bool> kept; /**< True if a processor marked the event to be skimmed */
+    mutable std::set<const DetectorSummary*> requested; /**< Summaries handed out by GetSummary */
+    mutable std::mutex summaryMutex; /**< Lock for sumMap when processors run concurrently */
+
+    /** Give a summary a handle and attach it to the event list, with the
+    * channels in the DetectorLibrary that belong in it
+    * \param [in] summary : the summary in sumMap to add
+    * \return the handle of the summary */
+    int AddHandle(DetectorSummary *summary);
 };
 #endif // __RAWEVENT_HPP_
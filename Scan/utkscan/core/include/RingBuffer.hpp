@@ -0,0 +1,136 @@
+/** \file RingBuffer.hpp
+ * \brief A first in, first out buffer with a fixed capacity
+ */
+#ifndef __RINGBUFFER_HPP__
+#define __RINGBUFFER_HPP__
+
+#include <stdexcept>
+#include <vector>
+
+#include <cstddef>
+
+/** \brief A fifo holding at most a fixed number of elements. The storage is
+ * allocated once by the constructor, and adding an element to a full buffer
+ * overwrites the oldest one in place. Element 0 is the oldest one. */
+template<typename T>
+class RingBuffer {
+public:
+    /** \brief Iterator over the elements, from the oldest to the newest */
+    class iterator {
+    public:
+        /** Constructor
+        * \param [in] buffer : the buffer to iterate over
+        * \param [in] index : the index of the element */
+        iterator(RingBuffer *buffer, size_t index) :
+            buffer_(buffer), index_(index) {}
+        /** \return the element */
+        T& operator*() const { return (*buffer_)[index_]; }
+        /** \return pointer to the element */
+        T* operator->() const { return &(*buffer_)[index_]; }
+        /** \return the iterator to the next element */
+        iterator& operator++() { ++index_; return *this; }
+        /** \return true if both iterators point to the same element
+        * \param [in] rhs : the iterator to compare to */
+        bool operator==(const iterator &rhs) const {
+            return buffer_ == rhs.buffer_ && index_ == rhs.index_;
+        }
+        /** \return true if the iterators point to different elements
+        * \param [in] rhs : the iterator to compare to */
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+    private:
+        RingBuffer *buffer_; //!< the buffer iterated over
+        size_t index_; //!< the index of the element
+    };
+
+    /** Constructor
+    * \param [in] capacity : the largest number of elements held
+    * \param [in] fill : the value the storage is initialized with */
+    RingBuffer(size_t capacity, const T& fill = T()) :
+        data_(capacity, fill), first_(0), size_(0) {}
+
+    /** \return the number of elements */
+    size_t size() const { return size_; }
+
+    /** \return true if there are no elements */
+    bool empty() const { return size_ == 0; }
+
+    /** \return the largest number of elements held */
+    size_t capacity() const { return data_.size(); }
+
+    /** \return element i, counting from the oldest one, without checks
+    * \param [in] i : the index of the element */
+    T& operator[](size_t i) { return data_[Slot(i)]; }
+
+    /** \return element i, counting from the oldest one, without checks
+    * \param [in] i : the index of the element */
+    const T& operator[](size_t i) const { return data_[Slot(i)]; }
+
+    /** \return element i, counting from the oldest one, or throw
+    * std::out_of_range if there is no such element
+    * \param [in] i : the index of the element */
+    T& at(size_t i) { Check(i); return (*this)[i]; }
+
+    /** \return element i, counting from the oldest one, or throw
+    * std::out_of_range if there is no such element
+    * \param [in] i : the index of the element */
+    const T& at(size_t i) const { Check(i); return (*this)[i]; }
+
+    /** \return the oldest element, the buffer must not be empty */
+    T& front() { return (*this)[0]; }
+
+    /** \return the newest element, the buffer must not be empty */
+    T& back() { return (*this)[size_ - 1]; }
+
+    /** \return the newest element, the buffer must not be empty */
+    const T& back() const { return (*this)[size_ - 1]; }
+
+    /** Adds an element, overwriting the oldest one if the buffer is full
+    * \param [in] value : the element to add */
+    void push_back(const T& value) {
+        if (data_.empty())
+            return;
+        if (size_ < data_.size()) {
+            data_[Slot(size_)] = value;
+            ++size_;
+        } else {
+            data_[first_] = value;
+            first_ = (first_ + 1) % data_.size();
+        }
+    }
+
+    /** Removes the oldest element, the buffer must not be empty */
+    void pop_front() {
+        first_ = Slot(1);
+        --size_;
+    }
+
+    /** Removes all of the elements, keeping the storage */
+    void clear() { first_ = size_ = 0; }
+
+    /** \return iterator to the oldest element */
+    iterator begin() { return iterator(this, 0); }
+
+    /** \return iterator past the newest element */
+    iterator end() { return iterator(this, size_); }
+
+private:
+    /** \return the position of element i in data_
+    * \param [in] i : the index of the element */
+    size_t Slot(size_t i) const {
+        size_t slot = first_ + i;
+        return slot < data_.size() ? slot : slot - data_.size();
+    }
+
+    /** Throw std::out_of_range if there is no element i
+    * \param [in] i : the index of the element */
+    void Check(size_t i) const {
+        if (i >= size_)
+            throw std::out_of_range("RingBuffer: index out of range");
+    }
+
+    std::vector<T> data_; //!< the storage of the elements
+    size_t first_; //!< position of the oldest element in data_
+    size_t size_; //!< the number of elements
+};
+
+#endif // __RINGBUFFER_HPP__
@@ -5,10 +5,14 @@
 #ifndef __SHECORRELATOR_HPP_
 #define __SHECORRELATOR_HPP_
 
+#include <string>
 #include <vector>
-#include <deque> 
 #include <sstream>
 
+#include "MappedPixelHistory.hpp"
+#include "PixelMap.hpp"
+#include "RingBuffer.hpp"
+
 ///An enumeration of the different super heavy event types
 enum SheEventType {
     alpha,
@@ -83,20 +87,53 @@ private:
 ///Class to handle correlations for super heavy event experiments
 class SheCorrelator {
 public:
-    /** Constructor taking x and y size */ 
-    SheCorrelator(int size_x, int size_y);
+    /** Constructor taking x and y size
+     * \param [in] size_x : the largest x strip
+     * \param [in] size_y : the largest y strip
+     * \param [in] window : the correlation window in seconds, events
+     *     which are older than this compared to a new event in the same
+     *     pixel are dropped from its chain, 0 keeps them all
+     * \param [in] depth : the largest number of events in a chain
+     * \param [in] radius : a decay in a pixel without a chain joins the
+     *     chain of the latest implant within radius pixels, 0 disables it */
+    SheCorrelator(int size_x, int size_y, double window = 0,
+                  unsigned depth = 64, unsigned radius = 0);
     /** Default Destructor */
-    ~SheCorrelator();
-    /** adds an event to the deque */
+    ~SheCorrelator() {}
+    /** Keeps the chains in a memory mapped file instead of in memory from
+     * now on. If the file holds the chains of the previous file of a run
+     * set, they are continued. Throws an IOException if the file cannot
+     * be mapped.
+     * \param [in] fname : the name of the history file */
+    void open_history(const std::string& fname);
+    /** adds an event to the chain of the pixel */
     bool add_event(SheEvent& event, int x, int y);
+    /** \return the number of bytes held by the chains kept in memory, the
+     * chains kept on disk are left to the page cache */
+    size_t memory() const;
     /** provides human readable event info */
     void human_event_info(SheEvent& event, std::stringstream& ss, 
 			  double clockStart);
 private:
     int size_x_; //!< size in the x direction
     int size_y_; //!< size in the y direction 
-    std::deque<SheEvent>** pixels_; //!< deque of the pixels hit
+    double window_; //!< the correlation window in clock ticks
+    unsigned radius_; //!< the radius of the neighbour lookups
+    unsigned depth_; //!< the largest number of events in a chain
+    PixelMap< RingBuffer<SheEvent> > pixels_; //!< the chains of the pixels hit
+    MappedPixelHistory<SheEvent> history_; //!< the chains kept on disk
+    /** adds an event to the chain of the pixel in the store */
+    template<class Store>
+    bool add_event(Store& store, SheEvent& event, int x, int y);
+    /** drops the events older than the window from the chain */
+    template<class Chain>
+    void expire_chain(Chain& chain, double time);
+    /** \return the chain of the latest implant around the pixel, or NULL */
+    template<class Store>
+    typename Store::Pixel* find_neighbour(Store& store, int x, int y,
+                                          double time);
     /** flushes the chain */
-    bool flush_chain(int x, int y); 
+    template<class Store>
+    bool flush_chain(Store& store, int x, int y); 
 };
 #endif
@@ -0,0 +1,105 @@
+/** \file SpillFills.hpp
+ * \brief Adds up the fills of the diagnostic spectra filled for every hit
+ * and commits them to the histograms once per spill
+ */
+#ifndef __SPILLFILLS_HPP__
+#define __SPILLFILLS_HPP__
+
+#include <vector>
+
+#include "Plots.hpp"
+
+/** \brief Fills of fixed histograms, added up in memory and committed in bulk
+ *
+ * Some spectra, such as the hit spectrum, the run time and the scalars, are
+ * filled for every hit. Plotting each fill looks the histogram and its bin
+ * up and increments the bin. Here the fills are only counted, into a slot
+ * which was set up for the histogram once, and Commit plots the counts with
+ * their total weight, e.g. at the end of each spill.
+ *
+ * A small 1D histogram, such as the hit spectrum, is counted in a dense
+ * array of its bins. Any other histogram is counted by runs of fills into
+ * the same bin, which suits the run time and scalar spectra whose
+ * consecutive fills mostly land in the same second. The runs are committed
+ * by themselves once kMaxRuns of them are waiting.
+ */
+class SpillFills {
+public:
+    /** Constructor
+     * \param [in] histo : the histograms to commit the fills to */
+    SpillFills(Plots &histo) : histo_(&histo) {}
+
+    /** Add a 1D histogram counted in a dense array of its bins
+     * \param [in] handle : the histogram, an invalid one is never filled
+     * \param [in] xSize : the number of bins, larger x values are dropped
+     * \return the slot to count the fills into */
+    size_t AddDense(const Plots::Handle &handle, int xSize);
+
+    /** Add a 1D or 2D histogram counted by runs of fills into the same bin
+     * \param [in] handle : the histogram, an invalid one is never filled
+     * \return the slot to count the fills into */
+    size_t AddRuns(const Plots::Handle &handle);
+
+    /** Forget all of the slots and the fills counted into them */
+    void Clear(void);
+
+    /** Count a fill, the same as Plots::Plot(handle, x, y)
+     * \param [in] slot : the slot of the histogram
+     * \param [in] x : the x value
+     * \param [in] y : the y value, 1 for a 1D histogram */
+    void Count(size_t slot, int x, int y = 1) {
+        Slot &s = slots_[slot];
+        if (!s.handle.IsValid())
+            return;
+        if (!s.dense.empty()) {
+            if (x >= 0 && (size_t)x < s.dense.size())
+                s.dense[x]++;
+            return;
+        }
+        if (s.weight != 0) {
+            if (x == s.x && y == s.y) {
+                s.weight++;
+                return;
+            }
+            EndRun(slot);
+        }
+        s.x = x;
+        s.y = y;
+        s.weight = 1;
+    }
+
+    /** Plot the fills counted since the last commit into the histograms */
+    void Commit(void);
+
+private:
+    /** The fills of one histogram */
+    struct Slot {
+        Plots::Handle handle; //!< the histogram
+        std::vector<unsigned int> dense; //!< count of each bin, empty if counted by runs
+        int x; //!< the x value of the current run
+        int y; //!< the y value of the current run
+        unsigned int weight; //!< the number of fills of the current run, 0 if none
+    };
+
+    /** A finished run of fills into one bin */
+    struct Run {
+        size_t slot; //!< the slot of the histogram
+        int x; //!< the x value
+        int y; //!< the y value
+        unsigned int weight; //!< the number of fills
+    };
+
+    /** Number of finished runs which are waiting before they are committed
+     * by themselves */
+    static const size_t kMaxRuns = 65536;
+
+    /** Move the current run of a slot to the finished runs
+     * \param [in] slot : the slot of the histogram */
+    void EndRun(size_t slot);
+
+    Plots *histo_; //!< the histograms to commit to
+    std::vector<Slot> slots_; //!< the histograms and their counts
+    std::vector<Run> runs_; //!< finished runs waiting to be committed
+};
+
+#endif // __SPILLFILLS_HPP__
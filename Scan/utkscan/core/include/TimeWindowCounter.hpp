@@ -0,0 +1,105 @@
+/** \file TimeWindowCounter.hpp
+ * \brief Counts the hits in a time window after and before each trigger
+ */
+#ifndef __TIMEWINDOWCOUNTER_HPP__
+#define __TIMEWINDOWCOUNTER_HPP__
+
+#include <deque>
+#include <vector>
+
+#include <cstddef>
+
+/** \brief Counts the hits of a detector (e.g. the neutrons of the 3Hen
+ * tubes) in a time window after every trigger (e.g. a beta), for windows
+ * much longer than a raw event.
+ *
+ * The hits and triggers are given in time order, across the raw events.
+ * Every hit is numbered, so the count of a window is the difference of the
+ * numbers of the hits at its ends: a trigger remembers the number of hits
+ * seen when it arrives and is finished by the first hit or trigger past the
+ * end of its window, when the number of hits is read again. The hits of the
+ * window before the trigger, which give the random background, are the hits
+ * kept in a queue from which those older than the window are dropped. Each
+ * hit and trigger is therefore added and removed once, whatever the length
+ * of the window and the rate of the hits.
+ *
+ * The times are in any units, the same for the hits, triggers and window.
+ */
+class TimeWindowCounter {
+public:
+    /** \brief The counts of a finished trigger */
+    struct Result {
+        double time; //!< the time of the trigger
+        unsigned int after; //!< the hits in (time, time + window]
+        unsigned int before; //!< the hits in [time - window, time)
+    };
+
+    /** Constructor
+    * \param [in] window : the length of the windows */
+    TimeWindowCounter(double window = 0) : window_(window), numHits_(0) {}
+
+    /** \return the length of the windows */
+    double GetWindow() const { return window_; }
+
+    /** Add a hit, finishing the triggers whose window ended before it
+    * \param [in] time : the time of the hit */
+    void AddHit(double time) {
+        Advance(time);
+        recent_.push_back(time);
+        numHits_++;
+    }
+
+    /** Add a trigger, finishing the triggers whose window ended before it.
+    * Its counts are added to the results once a later hit or trigger, or
+    * Advance, passes the end of its window.
+    * \param [in] time : the time of the trigger */
+    void AddTrigger(double time) {
+        Advance(time);
+        while (!recent_.empty() && recent_.front() < time - window_)
+            recent_.pop_front();
+        Pending trigger;
+        trigger.time = time;
+        trigger.start = numHits_;
+        trigger.before = recent_.size();
+        pending_.push_back(trigger);
+    }
+
+    /** Finish the triggers whose window ended before a time, e.g. the time
+    * of the current event when it has no hits or triggers
+    * \param [in] time : the current time */
+    void Advance(double time) {
+        while (!pending_.empty() && pending_.front().time + window_ < time) {
+            Result result;
+            result.time = pending_.front().time;
+            result.after = numHits_ - pending_.front().start;
+            result.before = pending_.front().before;
+            results_.push_back(result);
+            pending_.pop_front();
+        }
+    }
+
+    /** \return the triggers finished since the last ClearResults */
+    const std::vector<Result> &GetResults() const { return results_; }
+
+    /** Forget the finished triggers, once they were used */
+    void ClearResults() { results_.clear(); }
+
+    /** \return the number of triggers whose window is still open */
+    size_t GetNumPending() const { return pending_.size(); }
+
+private:
+    /** \brief A trigger whose window is still open */
+    struct Pending {
+        double time; //!< the time of the trigger
+        unsigned long long start; //!< the number of hits before the trigger
+        unsigned int before; //!< the hits in the window before the trigger
+    };
+
+    double window_; //!< the length of the windows
+    unsigned long long numHits_; //!< the number of hits added
+    std::deque<double> recent_; //!< the times of the hits, oldest first, those older than a window before the last trigger dropped
+    std::deque<Pending> pending_; //!< the triggers whose window is open, oldest first
+    std::vector<Result> results_; //!< the finished triggers
+};
+
+#endif // __TIMEWINDOWCOUNTER_HPP__
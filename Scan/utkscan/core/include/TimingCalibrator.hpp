@@ -12,6 +12,7 @@
 
 #include "Globals.hpp"
 #include "Messenger.hpp"
+#include "pugixml.hpp"
 
 //! A class to hold the timing calibration for a detector
 class TimingCalibration {
@@ -39,6 +40,10 @@ public:
 
     /** \return the number of ToF Offsets that were read in from the calibration */
     unsigned int GetNumTofOffsets(void) const {return(tofOffsets_.size());};
+    /** \return the ToF offsets keyed by the location of the start */
+    const std::map<unsigned int, double>& GetTofOffsets(void) const {
+        return(tofOffsets_);
+    };
 
     /** Sets the left-right time offset
     * \param [in] a : the offset in ns */
@@ -71,6 +76,64 @@ private:
     };
 };
 
+/*! \brief The timing calibrations of a list of bars laid out in flat arrays
+ *
+ * The calibration of every bar is looked up in the TimingCalibrator once, when
+ * the table is made, and the ToF offsets are laid out by bar and start
+ * location. The constants of a bar are then read by its index in the list
+ * without map lookups or copies of the calibration. The effective speed of
+ * light and the largest time difference of a bar are taken from the Globals
+ * for its type. */
+class TimingCalibrationTable {
+public:
+    /** Default Constructor */
+    TimingCalibrationTable() {numStarts_ = 0;};
+    /** Constructor laying out the calibrations of a list of bars
+     * \param [in] keys : the identifiers of the bars, in the order in which
+     *  they are indexed */
+    TimingCalibrationTable(const std::vector<TimingDefs::TimingIdentifier> &keys);
+    /** Default Destructor */
+    ~TimingCalibrationTable(){};
+
+    /** \return The left-right time offset of a bar in ns
+     * \param [in] bar : the index of the bar */
+    double GetLeftRightTimeOffset(const size_t &bar) const {
+        return(lrtOffset_[bar]);
+    };
+    /** \return time offset of a bar w.r.t. the start at a location, 0 if
+     * there is none
+     * \param [in] bar : the index of the bar
+     * \param [in] start : the location of the start */
+    double GetTofOffset(const size_t &bar, const unsigned int &start) const {
+        if(start >= numStarts_)
+            return(0.0);
+        return(tofOffsets_[bar*numStarts_ + start]);
+    };
+    /** \return offset between the center of a bar and the source in cm
+     * \param [in] bar : the index of the bar */
+    double GetXOffset(const size_t &bar) const {return(xOffset_[bar]);};
+    /** \return the perpendicular distance between a bar and source in cm
+     * \param [in] bar : the index of the bar */
+    double GetZ0(const size_t &bar) const {return(z0_[bar]);};
+    /** \return the effective speed of light in a bar in cm/ns, NaN if the
+     * type of the bar has none
+     * \param [in] bar : the index of the bar */
+    double GetSpeedOfLight(const size_t &bar) const {return(speed_[bar]);};
+    /** \return the largest time difference in ns of an event in a bar
+     * \param [in] bar : the index of the bar */
+    double GetMaxTimeDifference(const size_t &bar) const {
+        return(maxTimeDiff_[bar]);
+    };
+private:
+    unsigned int numStarts_; //!< The number of start locations of each bar
+    std::vector<double> lrtOffset_; //!< left-right time offset of each bar
+    std::vector<double> xOffset_; //!< offset of each bar from the source
+    std::vector<double> z0_; //!< perpendicular distance of each bar
+    std::vector<double> speed_; //!< effective speed of light in each bar
+    std::vector<double> maxTimeDiff_; //!< largest time difference of each bar
+    std::vector<double> tofOffsets_; //!< ToF offsets by bar and start location
+};
+
 /*! \brief Class to handle time calibrations for bar type detectors - Singleton
 *
 * It is important to note that "left" generally refers to the upstream side of
@@ -83,6 +146,23 @@ public:
     /** \return The calibration for the requested bar
      * \param [in] id : the id of the bar that you want the calibration for */
     TimingCalibration GetCalibration(const TimingDefs::TimingIdentifier &id);
+
+    /** Read the timing calibrations of a configuration
+     * \param [in] doc : the parsed configuration
+     * \param [out] calibrations : the calibrations are added here, by bar
+     * \return the verbose_timing setting of the configuration */
+    static bool ReadCalibrations(const pugi::xml_document &doc,
+        std::map<TimingDefs::TimingIdentifier, TimingCalibration> &calibrations);
+
+    /** Swap in new calibrations, e.g. those of a configuration read again.
+     * The calibrations are read by the processors without a lock, so this
+     * is only called between events.
+     * \param [in,out] calibrations : the new calibrations, which are
+     *  swapped with the current ones */
+    void SetCalibrations(std::map<TimingDefs::TimingIdentifier,
+                         TimingCalibration> &calibrations) {
+        calibrations_.swap(calibrations);
+    }
 private:
     TimingCalibrator() {ReadTimingCalXml();}; //!<Default constructor
     TimingCalibrator (const TimingCalibrator&);//!< Overload of the constructor
@@ -23,6 +23,16 @@ public:
 
     /** \return The map of events that had high resolution timing data. */
     TimingMap GetMap(void){return(map_);};
+
+    /** Fills the events that had high resolution timing data into a flat
+     * array indexed by the channel id. The array must be sized to the
+     * DetectorLibrary, and it is not cleared, so that several lists of
+     * events can be added to it. As for the map, the first event of a
+     * channel is kept.
+     * \param [in] evts : The vector of Channel events to sort through
+     * \param [out] arr : The array to fill */
+    static void FillArray(const std::vector<ChanEvent*> &evts,
+                          TimingArray &arr);
 private:
     /** Fills finds all of the events that had high resolution timing data in
      * the vector of channel events
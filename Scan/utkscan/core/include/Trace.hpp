@@ -3,6 +3,10 @@
  *
  * A simple class to store the traces.
  * Used instead of a typedef so additional functionality can be added later.
+ *
+ * The samples are kept as 16 bit unsigned integers, the size of the Pixie
+ * ADC words, so that a trace takes half the memory of one stored as ints and
+ * the analyzers read twice as many samples per cache line.
  */
 #ifndef __TRACE_HPP__
 #define __TRACE_HPP__
@@ -20,70 +24,181 @@
 #include "PlotsRegister.hpp"
 
 //! \brief Store the information for a trace
-class Trace : public std::vector<int> {
+class Trace : public std::vector<unsigned short> {
 public:
+    typedef unsigned short Sample; //!< The type of a sample of the trace
+
+    /** The values that are calculated for most traces. They are kept in a
+    * fixed array instead of the maps, so that setting or reading them does
+    * not need a string comparison or an allocation. Any other value is still
+    * stored by its name. */
+    enum Field {
+        ANALYZED_LEVEL, //!< "analyzedLevel"
+        BAD_QDC, //!< "badqdc"
+        BASELINE, //!< "baseline"
+        CALC_ENERGY, //!< "calcEnergy"
+        CHISQ_PER_DOF, //!< "chisqPerDof"
+        DISCRIM, //!< "discrim"
+        FILTER_ENERGY, //!< "filterEnergy"
+        FILTER_ENERGY_CAL, //!< "filterEnergyCal"
+        FILTER_TIME, //!< "filterTime"
+        MAXPOS, //!< "maxpos"
+        MAXVAL, //!< "maxval"
+        NUM_PULSES, //!< "numPulses"
+        NUM_TRIGGERS, //!< "numTriggers"
+        PHASE, //!< "phase"
+        POSITION, //!< "position"
+        QDC, //!< "qdc"
+        SATURATION, //!< "saturation"
+        SIGMA_BASELINE, //!< "sigmaBaseline"
+        TAU, //!< "tau"
+        TQDC, //!< "tqdc"
+        NUM_FIELDS //!< The number of fields
+    };
+
     /** Default constructor */
-    Trace() : std::vector<int>() {}
+    Trace() : std::vector<Sample>(), fieldMask_(0) {}
 
-    /** An automatic conversion for the trace
+    /** An automatic conversion for the trace, the samples must fit in a
+    * Sample
     * \param [in] x : the trace to store in the class */
-    Trace(const std::vector<int> &x) : std::vector<int>(x) {}
+    Trace(const std::vector<int> &x) :
+        std::vector<Sample>(x.begin(), x.end()), fieldMask_(0) {}
+
+    /** \return the samples converted to ints, for the code which still needs
+    * them as a std::vector<int>. This copies the trace, so the analyzers
+    * should read the samples directly instead. */
+    std::vector<int> GetIntTrace() const {
+        return(std::vector<int>(begin(), end()));
+    }
+
+    /** \return the field with the given name, or NUM_FIELDS if the name is
+    * not one of the fields
+    * \param [in] name : the name of the value */
+    static Field FindField(const std::string &name);
+
+    /** Clear the samples and every value calculated from them. The storage
+    * of the samples is kept so that the trace can be refilled without
+    * allocating. */
+    void Reset() {
+        clear();
+        waveform_.clear();
+        trigFilter_.clear();
+        esums_.clear();
+        fieldMask_ = 0;
+        doubleTraceData.clear();
+        intTraceData.clear();
+    }
+
+    /** Insert a value into a field, if the field has no value yet
+    * \param [in] field : the field to insert
+    * \param [in] value : the value to insert */
+    void InsertValue(const Field &field, const double &value) {
+        if(!HasValue(field))
+            SetValue(field, value);
+    }
 
     /** Insert a value into the trace map
     * \param [in] name : the name of the parameter to insert
     * \param [in] value : the value to insert into the map */
     void InsertValue(const std::string &name, const double &value) {
-        doubleTraceData.insert(make_pair(name,value));
+        Field field = FindField(name);
+        if(field != NUM_FIELDS)
+            InsertValue(field, value);
+        else
+            doubleTraceData.insert(make_pair(name,value));
     }
 
     /** Insert an int value into the trace
     * \param [in] name : the name of the variable to insert
     * \param [in] value : The integer value to insert into the map */
     void InsertValue(const std::string &name, const int &value) {
-        intTraceData.insert(make_pair(name,value));
+        Field field = FindField(name);
+        if(field != NUM_FIELDS)
+            InsertValue(field, (double)value);
+        else
+            intTraceData.insert(make_pair(name,value));
+    }
+
+    /** Set the value of a field in the trace
+    * \param [in] field : the field to set
+    * \param [in] value : the value to set the field to */
+    void SetValue(const Field &field, const double &value) {
+        fields_[field] = value;
+        fieldMask_ |= 1u << field;
     }
 
     /** Set the double value of a parameter in the trace
     * \param [in] name : the name of the parameter to set
     * \param [in] value : the double value to set the parameter to */
     void SetValue(const std::string &name, const double &value) {
-        if(doubleTraceData.count(name) > 0)
-            doubleTraceData[name] = value;
+        Field field = FindField(name);
+        if(field != NUM_FIELDS)
+            SetValue(field, value);
         else
-            InsertValue(name,value);
+            doubleTraceData[name] = value;
     }
 
     /** Set the integer value of a parameter in the trace
     * \param [in] name : the name of the parameter to set
     * \param [in] value : the int value to set the parameter to */
     void SetValue(const std::string &name, const int &value) {
-        if(intTraceData.count(name) > 0)
-            intTraceData[name] = value;
+        Field field = FindField(name);
+        if(field != NUM_FIELDS)
+            SetValue(field, (double)value);
         else
-            InsertValue(name,value);
+            intTraceData[name] = value;
+    }
+
+    /** \return true if the field has a value in the trace
+    * \param [in] field : the field to check for */
+    bool HasValue(const Field &field) const {
+        return((fieldMask_ & (1u << field)) != 0);
     }
 
     /** Checks to see if a parameter has a value
     * \param [in] name : the name of the parameter to check for
     * \return true if the value exists in the trace */
     bool HasValue(const std::string &name) const {
+        Field field = FindField(name);
+        if(field != NUM_FIELDS)
+            return(HasValue(field));
         return (doubleTraceData.count(name) > 0 ||
                 intTraceData.count(name) > 0);
     }
 
+    /** \return the value of the field, or NAN if it has no value
+    * \param [in] field : the field to get */
+    double GetValue(const Field &field) const {
+        return(HasValue(field) ? fields_[field] : NAN);
+    }
+
     /** Returns the value of the requested parameter
     * \param [in] name : the name of the parameter to get for
     * \return the requested value */
     double GetValue(const std::string &name) const {
-        if(doubleTraceData.count(name) > 0)
-            return (*doubleTraceData.find(name)).second;
-        if(intTraceData.count(name) > 0)
-            return (*intTraceData.find(name)).second;
+        Field field = FindField(name);
+        if(field != NUM_FIELDS)
+            return(GetValue(field));
+        std::map<std::string, double>::const_iterator dit =
+            doubleTraceData.find(name);
+        if(dit != doubleTraceData.end())
+            return(dit->second);
+        std::map<std::string, int>::const_iterator iit =
+            intTraceData.find(name);
+        if(iit != intTraceData.end())
+            return(iit->second);
         return(NAN);
     }
 
+    /** \return the values stored by name as doubles, which are not one of
+    * the fields */
+    const std::map<std::string, double>& GetDoubleValues() const {
+        return(doubleTraceData);
+    }
+
     /** \return Returns the waveform found inside the trace */
-    std::vector<double> GetWaveform() {return(waveform_);}
+    const std::vector<double>& GetWaveform() const {return(waveform_);}
 
     /*! \brief Declares a 1D histogram calls the C++ wrapper for DAMM
     * \param [in] dammId : The histogram number to define
@@ -158,6 +273,9 @@ private:
     std::vector<double> trigFilter_; //!< The trigger filter for the trace
     std::vector<double> esums_; //!< The Energy sums calculated from the trace
 
+    double fields_[NUM_FIELDS]; //!< The values of the fields
+    unsigned int fieldMask_; //!< Bit i is set if field i has a value
+
     std::map<std::string, double> doubleTraceData; //!< Trace data stored as doubles
     std::map<std::string, int>    intTraceData;//!< Trace data stored as ints
 
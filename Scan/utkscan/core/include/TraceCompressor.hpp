@@ -0,0 +1,41 @@
+/** \file TraceCompressor.hpp
+ * \brief Lossless delta and entropy coding of trace samples
+ *
+ * The first sample is stored in 32 bits, every other sample as the
+ * difference to the one before it. The differences are zigzag mapped to
+ * unsigned numbers and Rice coded in blocks of 16 samples: each block starts
+ * with its 5 bit Rice parameter k, chosen to give the fewest bits, followed
+ * by the unary quotient and k remainder bits of every difference. Quotients
+ * of 16 or more are escaped by 16 ones followed by the 32 bit value. The bits
+ * are packed most significant first. Slowly varying 14-bit ADC traces typically need
+ * 3 to 5 bits per sample instead of 16.
+ */
+#ifndef __TRACECOMPRESSOR_HPP__
+#define __TRACECOMPRESSOR_HPP__
+
+#include <vector>
+
+#include <cstddef>
+
+//! Class to compress and decompress traces
+class TraceCompressor {
+public:
+    /** Compress a trace
+     * \param [in] trace : the samples to compress
+     * \param [out] out : the coded trace is appended to this buffer */
+    static void Encode(const std::vector<unsigned short> &trace,
+                       std::vector<unsigned char> &out);
+
+    /** Decompress a trace
+     * \param [in] data : the start of the coded trace
+     * \param [in] size : the number of bytes of the coded trace
+     * \param [in] length : the number of samples in the trace
+     * \param [out] trace : the decoded samples
+     * \return false if the data ended before all of the samples were read */
+    static bool Decode(const unsigned char *data, const size_t &size,
+                       const size_t &length, std::vector<int> &trace);
+private:
+    static const unsigned int blockSize_ = 16; //!< samples in a Rice block
+    static const unsigned int maxQuotient_ = 16; //!< quotient that escapes
+};
+#endif // __TRACECOMPRESSOR_HPP__
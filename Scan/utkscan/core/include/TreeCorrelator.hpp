@@ -12,6 +12,7 @@
 #include <string>
 #include <sstream>
 #include <map>
+#include <vector>
 
 #include "pugixml.hpp"
 #include "Places.hpp"
@@ -48,6 +49,38 @@ public:
     * \param [in] name : the name of the place */
     Place* place(std::string name);
 
+    /** \return the index of the place, which stays the same for the whole
+    * analysis, or throw exception if it doesn't exist. Look it up once, e.g.
+    * in Init, to get the place on every event without comparing names.
+    * \param [in] name : the name of the place */
+    size_t index(const std::string &name) const;
+
+    /** \return pointer to the place with the given index
+    * \param [in] index : the index returned by index(name) */
+    Place* place(size_t index) const { return placeTable_[index]; }
+
+    /** Reset all of the places which are resetable, at the end of an event */
+    void resetPlaces() const {
+        for (std::vector<Place*>::const_iterator it = resetable_.begin();
+             it != resetable_.end(); ++it)
+            (*it)->reset();
+    }
+
+    /** Writes the state of all places, so that a scan can be resumed from
+    * a checkpoint.
+    * \param [out] out : the stream to write to */
+    void savePlaces(std::ostream &out) const;
+
+    /** Reads back the state of the places written by savePlaces(). The
+    * places have to be the same as when they were written.
+    * \param [in] in : the stream to read from
+    * \return true if every place was read */
+    bool loadPlaces(std::istream &in);
+
+    /** \return the number of bytes held by the places and the events
+    * remembered by their fifos */
+    size_t memory() const;
+
     /** Create place, alter or add existing place to the tree.
     * \param [in] params : the map of the parameters
     * \param [in] verbose : verbosity */
@@ -84,6 +117,16 @@ private:
 
     static PlaceBuilder builder; //!< Instance of the PlaceBuilder
 
+    std::map<std::string, size_t> placeIndex_; //!< Index of each place
+    std::vector<Place*> placeTable_; //!< The places by index
+    std::vector<Place*> resetable_; //!< The places which are resetable
+
+    /** Sorts the places so that every place comes after all of its
+     * children and sets their rank, which orders the checks when a change
+     * of status is reported.
+     * \param [in] verbose : verbosity */
+    void compileOrder(bool verbose);
+
     /** Splits name string into the vector of string. Assumes that if
      * the last token (delimiter being "_") is in format "X-Y,Z" where
      * X, Y are integers, the X and Y are range of base names to be retured
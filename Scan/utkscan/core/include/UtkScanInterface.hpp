@@ -7,6 +7,8 @@
 #include <ScanInterface.hpp>
 #include <XiaData.hpp>
 
+class HisServer;
+
 ///Class derived from ScanInterface to handle UI for the scan.
 class UtkScanInterface : public ScanInterface {
 public:
@@ -62,7 +64,7 @@ public:
      * its own command line arguments. This method is called at the end of
      * the ScanInterface::help method.
      * \return Nothing. */
-    virtual void ArgHelp(void) {}
+    virtual void ArgHelp(void);
 
     /** SyntaxStr is used to print a linux style usage message to the screen.
      * \param[in]  name_ The name of the program.
@@ -85,9 +87,22 @@ public:
      * \return Nothing. */
     virtual void Notify(const std::string &code_ = "");
 
+    /** Write the histograms and the state of the correlator places to a
+     * checkpoint of the scan, together with the hash of the configuration.
+     * \param[out] out_ The checkpoint file.
+     * \return True upon success and false otherwise. */
+    virtual bool SaveState(std::ostream &out_);
+
+    /** Restore the histograms and the correlator places from a checkpoint
+     * written with the same configuration.
+     * \param[in] in_ The checkpoint file.
+     * \return True upon success and false otherwise. */
+    virtual bool LoadState(std::istream &in_);
+
 private:
     bool init_; /// Set to true when the initialization process successfully completes.
     std::string outputFname_; /// The output histogram filename prefix.
+    HisServer *hisServer_; /// Serves the histograms to viewers, or NULL.
 };
 
 #endif //__UTK_SCAN_INTERFACE_HPP__
@@ -8,8 +8,10 @@
 
 #include <ctime>
 
+#include "AnalysisCache.hpp"
 #include "DetectorDriver.hpp"
 #include "DetectorLibrary.hpp"
+#include "SkimWriter.hpp"
 #include "Unpacker.hpp"
 
 ///A class that is derived from Unpacker that defines what we are going to do
@@ -20,15 +22,43 @@
 class UtkUnpacker : public Unpacker {
 public:
     /// Default constructor that does nothing in particular
-    UtkUnpacker() : Unpacker() {}
+    UtkUnpacker() : Unpacker(), skimFailed_(false), lastSpill_(0),
+                    sequence_(0), lastMemory_(0) {}
     /// Default destructor that deconstructs the DetectorDriver singleton
     ~UtkUnpacker();
+
+    ///@brief Skip a whole spill if it falls inside one of the rejection
+    /// regions defined in the XML file.
+    ///@param[in] start_ The earliest event time in the spill.
+    ///@param[in] stop_ The earliest event time in the following spill.
+    ///@return True if the spill lies entirely inside a rejection region.
+    bool SkipSpill(const unsigned long long &start_,
+                   const unsigned long long &stop_);
+
+    ///@brief Close the skim file, if one was written, and print the number
+    /// of raw events that were written to it.
+    void CloseSkim();
+
+    ///@brief Close the analysis cache, if one was used, and print how many
+    /// traces were read from or written to it.
+    void CloseAnalysisCache();
     
 private:
     ///@brief Process all events in the event list.
     ///@param[in]  addr_ Pointer to a ScanInterface object.
     void ProcessRawEvent(ScanInterface *addr_=NULL);
 
+    ///@brief Add the memory of the histograms of each owner of a range of
+    /// ids, the places of the TreeCorrelator and the processors to that of
+    /// the Unpacker.
+    ///@param[out] entries_ The memory of each subsystem.
+    void AccountMemory(std::vector<PerfCounters::MemoryEntry> &entries_);
+
+    ///@brief Measure the memory of the subsystems, and make the 2-D
+    /// histograms sparse the first time the scan is over its budget, if the
+    /// configuration asks for it.
+    void CheckMemory();
+
     ///@brief Initializes the DetectorLibrary and DetectorDriver
     ///@param[in] driver A pointer to the DetectorDriver that we're using.
     ///@param[in] detlib A pointer to the DetectorLibrary that we're using.
@@ -52,5 +82,26 @@ private:
     ///@param[in] addr_  Pointer to a ScanInterface object.
     virtual void RawStats(XiaData *event_, DetectorDriver *driver,
                           ScanInterface *addr_=NULL);
+
+    ///@brief Write the current raw event to the skim file, opening the file
+    /// on the first event that is written.
+    ///@param[in] addr_ Pointer to a ScanInterface object.
+    void WriteSkim(ScanInterface *addr_);
+
+    ///@brief Open the cache of the trace analyzers and hand it to the
+    /// DetectorDriver. The cache is only read if it was written for the same
+    /// analyzer configuration and input file.
+    ///@param[in] driver Pointer to the DetectorDriver that we're using.
+    ///@param[in] addr_ Pointer to a ScanInterface object.
+    void OpenAnalysisCache(DetectorDriver *driver, ScanInterface *addr_);
+
+    RunConstants run_; ///< Constants of the run, copied on the first event
+    RejectRegions rejects_; ///< Rejection regions, copied on the first event
+    SkimWriter skim_; ///< Writes the selected raw events to a new .pld file
+    bool skimFailed_; ///< True if the skim file could not be opened
+    AnalysisCache analysisCache_; ///< Cached results of the trace analyzers
+    unsigned int lastSpill_; ///< Spill of the last raw event, to commit the diagnostic fills when it changes
+    uint64_t sequence_; ///< Number of raw events built, including the rejected ones
+    time_t lastMemory_; ///< Time at which the memory was last measured
 };
 #endif //__UTKUNPACKER_HPP__
@@ -23,6 +23,7 @@ struct CorrectionParams {
     WalkModel model; //!< The walk model that is used for the params
     double min; //!< minimum of range for the correction
     double max;//!< maximum of range for the correction
+    unsigned int points;//!< number of points tabulated over the range, 0 if none
     std::vector<double> parameters;//!< coefficients for function
 };
 
@@ -45,9 +46,12 @@ public:
      * \param[in] model : the model to use to correct the channel
      * \param[in] min : The lower bound of the correction range
      * \param[in] max : The upper bound of the correction range
-     * \param[in] par : The vector of parameters to use for the calibration */
+     * \param[in] par : The vector of parameters to use for the calibration
+     * \param[in] points : The number of points to tabulate the model at
+     *  across the range in the flat table, 0 to evaluate the model */
     void AddChannel(const Identifier& chanID, const std::string model,
-                    double min, double max, const std::vector<double>& par);
+                    double min, double max, const std::vector<double>& par,
+                    unsigned int points = 0);
 
     /** Returns time correction that should be subtracted from
      * the raw time. The channel is identified by Identifier class,
@@ -58,9 +62,77 @@ public:
      * \param [in] chanID : The channel identifier to get
      * \param [in] raw : The raw value to perform the correction on
      * \return The walk corrected value of raw */
-    double GetCorrection(Identifier& chanID, double raw) const;
+    double GetCorrection(const Identifier& chanID, double raw) const;
+
+    /** Build the flat table used by GetCorrection(int, double). Call once all
+     * channels have been added. A channel added later is not in the table
+     * until it is built again. Ranges added with a number of points are
+     * sampled here and linearly interpolated by GetCorrection(int, double).
+     * \param [in] chans : the identifier of each channel, indexed by
+     *  module * 16 + channel as in the DetectorLibrary */
+    void BuildTable(const std::vector<Identifier>& chans);
+
+    /** Returns the time correction for a channel, looked up in the flat
+     * table without any Identifier comparisons.
+     * \param [in] index : the channel index, module * 16 + channel
+     * \param [in] raw : The raw value to perform the correction on
+     * \return The walk corrected value of raw */
+    double GetCorrection(int index, double raw) const {
+        if (index < 0 || index >= (int)index_.size())
+            return 0;
+        const std::pair<unsigned int, unsigned int> &range = index_[index];
+        for (unsigned int i = range.first; i < range.first + range.second; i++) {
+            const TableEntry &entry = entries_[i];
+            if (entry.min <= raw && raw <= entry.max) {
+                if (entry.points == 0)
+                    return Evaluate(entry.model, entry.par, raw);
+                double x = (raw - entry.min) * entry.invStep;
+                unsigned int bin = (unsigned int)x;
+                if (bin > entry.points - 2)
+                    bin = entry.points - 2;
+                return entry.table[bin] + (x - bin) *
+                    (entry.table[bin + 1] - entry.table[bin]);
+            }
+        }
+        return 0;
+    }
+
+    /** Exchange the corrections with those of another corrector. The
+     * entries of the flat table point into its own vectors, which are
+     * swapped rather than copied so that the pointers stay valid.
+     * \param [in,out] other : the corrector to exchange with */
+    void Swap(WalkCorrector &other) {
+        index_.swap(other.index_);
+        entries_.swap(other.entries_);
+        pars_.swap(other.pars_);
+        tables_.swap(other.tables_);
+        channels_.swap(other.channels_);
+    }
 
 private:
+    /** A correction range of one channel in the flat table */
+    struct TableEntry {
+        WalkModel model; //!< The walk model that is used for the params
+        double min; //!< minimum of range for the correction
+        double max; //!< maximum of range for the correction
+        const double *par; //!< coefficients for function, in pars_
+        unsigned int points; //!< number of tabulated points, 0 if none
+        double invStep; //!< inverse of the spacing of the tabulated points
+        const double *table; //!< tabulated correction, in tables_
+    };
+
+    std::vector<std::pair<unsigned int, unsigned int> > index_; //!< First entry and number of entries for each channel index
+    std::vector<TableEntry> entries_; //!< Correction ranges of all channels, grouped by channel
+    std::vector<double> pars_; //!< Coefficients of all entries
+    std::vector<double> tables_; //!< Tabulated corrections of all entries
+
+    /** Evaluate a walk model
+     * \param [in] model : the model to use
+     * \param [in] par : the coefficients of the model
+     * \param [in] raw : the raw value to correct
+     * \return The correction */
+    double Evaluate(WalkModel model, const double *par, double raw) const;
+
     /** Map where key is a channel Identifier
      * and value is a vector holding struct with calibration range
      * and walk correction model and parameters. */
@@ -77,10 +149,10 @@ private:
      * f(x) = a0 + a1 / (a2 + x) + a3 * exp(-x / a4)
      * the returned value is in 'natural' pixie units
      * Developed for 85,86Ga experiment
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return The corrected time in pixie units */
-    double Model_A(const std::vector<double>& par, double raw) const;
+    double Model_A(const double *par, double raw) const;
 
     /** This model was developed for the 93Br experiment
      * f(x) = a0 + a1 * x + a2 * x^2 + a3 * x^3 +
@@ -89,10 +161,10 @@ private:
      *
      * This function is intended for low energy part, for high energy
      * part use B2 model.
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return the corrected time in pixie units */
-    double Model_B1(const std::vector<double>& par, double raw) const;
+    double Model_B1(const double *par, double raw) const;
 
     /** This function is the second part of 'B' model developed
      * for the 93Br experiment
@@ -101,40 +173,40 @@ private:
      *
      * This function is intended for high energy part, for low energy
      * part use B1 model.
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return corrected time in pixie units */
-    double Model_B2(const std::vector<double>& par, double raw) const;
+    double Model_B2(const double *par, double raw) const;
 
     /** The correction for Small VANDLE bars 
      * the returned value is in ns
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return corrected time in ns */
-    double Model_VS(const std::vector<double>& par, double raw) const;
+    double Model_VS(const double *par, double raw) const;
     /** The correction for Medium VANDLE bars 
      * the returned value is in ns
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return corrected time in ns */
-    double Model_VM(const std::vector<double>& par, double raw) const;
+    double Model_VM(const double *par, double raw) const;
     /** The correction for Large VANDLE bars 
      * the returned value is in ns
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return corrected time in ns */
-    double Model_VL(const std::vector<double>& par, double raw) const;
+    double Model_VL(const double *par, double raw) const;
     /** The correction for betas used with VANDLE
      * the returned value is in ns
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return corrected time in ns */
-    double Model_VB(const std::vector<double>& par, double raw) const;
+    double Model_VB(const double *par, double raw) const;
     /** The correction for Small VANDLE bars in RevD
      * the returned value is in ns
-     * \param [in] par : the vector of parameters for calibration
+     * \param [in] par : the array of parameters for calibration
      * \param [in] raw : the raw value to calibrate
      * \return corrected time in ns */
-    double Model_VD(const std::vector<double>& par, double raw) const;
+    double Model_VD(const double *par, double raw) const;
 };
 #endif
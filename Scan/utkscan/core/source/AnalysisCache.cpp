@@ -0,0 +1,173 @@
+/** \file AnalysisCache.cpp
+ * \brief The results of the trace analyzers, kept in a binary file so that
+ * they do not have to be analyzed again
+ */
+#include "AnalysisCache.hpp"
+#include "ChanEvent.hpp"
+
+using namespace std;
+
+namespace {
+    const uint32_t cacheMagic = 0x43414B55; //!< "UKAC"
+    const uint32_t cacheVersion = 1; //!< bumped whenever the records change
+    const uint32_t maxLength = 1 << 20; //!< sanity limit on read lengths
+
+    template<typename T>
+    void WritePod(ofstream &out, const T &val) {
+        out.write((const char*)&val, sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadPod(ifstream &in, T &val) {
+        return (bool)in.read((char*)&val, sizeof(T));
+    }
+}
+
+AnalysisCache::AnalysisCache() : numLoaded_(0), numMissed_(0),
+    numStored_(0) {
+}
+
+bool AnalysisCache::Open(const string &name, uint64_t hash) {
+    Close();
+    numLoaded_ = numMissed_ = numStored_ = 0;
+
+    in_.open(name.c_str(), ios::binary);
+    uint32_t magic, version;
+    uint64_t fileHash;
+    if (in_.good() && ReadPod(in_, magic) && magic == cacheMagic &&
+        ReadPod(in_, version) && version == cacheVersion &&
+        ReadPod(in_, fileHash) && fileHash == hash)
+        return true;
+    in_.close();
+
+    out_.open(name.c_str(), ios::binary | ios::trunc);
+    if (!out_.good()) {
+        out_.close();
+        return false;
+    }
+    WritePod(out_, cacheMagic);
+    WritePod(out_, cacheVersion);
+    WritePod(out_, hash);
+    return true;
+}
+
+void AnalysisCache::Close() {
+    if (in_.is_open())
+        in_.close();
+    if (out_.is_open())
+        out_.close();
+    pending_.clear();
+    order_.clear();
+}
+
+bool AnalysisCache::Load(const ChanEvent &chan, Trace &trace) {
+    uint64_t key = Key(chan.GetSpillIndex(), chan.GetHitIndex());
+    unordered_map<uint64_t, Record>::iterator it = pending_.find(key);
+    if (it == pending_.end()) {
+        if (!ReadAhead(key)) {
+            numMissed_++;
+            return false;
+        }
+        it = pending_.find(key);
+    }
+
+    //! The key is only trusted if the hit is the same as the one written
+    const Record &rec = it->second;
+    bool same = rec.timeStamp == chan.GetTimeStamp() && rec.id == chan.GetID();
+    if (same) {
+        for (unsigned int i = 0; i < Trace::NUM_FIELDS; i++)
+            if (rec.mask & (1u << i))
+                trace.SetValue((Trace::Field)i, rec.fields[i]);
+        for (vector<pair<string, double> >::const_iterator nit =
+                 rec.named.begin(); nit != rec.named.end(); ++nit)
+            trace.SetValue(nit->first, nit->second);
+    }
+    pending_.erase(it);
+
+    if (!same) {
+        numMissed_++;
+        return false;
+    }
+    numLoaded_++;
+    return true;
+}
+
+void AnalysisCache::Store(const ChanEvent &chan) {
+    if (!out_.is_open())
+        return;
+    const Trace &trace = chan.GetTrace();
+
+    uint32_t mask = 0;
+    for (unsigned int i = 0; i < Trace::NUM_FIELDS; i++)
+        if (trace.HasValue((Trace::Field)i))
+            mask |= (1u << i);
+
+    WritePod(out_, Key(chan.GetSpillIndex(), chan.GetHitIndex()));
+    WritePod(out_, (uint64_t)chan.GetTimeStamp());
+    WritePod(out_, (int32_t)chan.GetID());
+    WritePod(out_, mask);
+    for (unsigned int i = 0; i < Trace::NUM_FIELDS; i++)
+        if (mask & (1u << i))
+            WritePod(out_, trace.GetValue((Trace::Field)i));
+
+    const map<string, double> &named = trace.GetDoubleValues();
+    WritePod(out_, (uint32_t)named.size());
+    for (map<string, double>::const_iterator it = named.begin();
+         it != named.end(); ++it) {
+        WritePod(out_, (uint32_t)it->first.size());
+        out_.write(it->first.data(), it->first.size());
+        WritePod(out_, it->second);
+    }
+    numStored_++;
+}
+
+bool AnalysisCache::ReadAhead(uint64_t key) {
+    //! Forget the records which were used, or whose hits are long gone
+    uint64_t spill = key >> 32;
+    while (!order_.empty() && (pending_.count(order_.front()) == 0 ||
+                               (order_.front() >> 32) + spillWindow < spill)) {
+        pending_.erase(order_.front());
+        order_.pop_front();
+    }
+
+    uint64_t readKey;
+    Record rec;
+    while (ReadRecord(readKey, rec)) {
+        pending_[readKey] = rec;
+        order_.push_back(readKey);
+
+        if (readKey == key)
+            return true;
+        if ((readKey >> 32) > spill + spillWindow)
+            return false;
+    }
+    return false;
+}
+
+bool AnalysisCache::ReadRecord(uint64_t &key, Record &rec) {
+    uint64_t timeStamp;
+    int32_t id;
+    uint32_t numNamed;
+    if (!ReadPod(in_, key) || !ReadPod(in_, timeStamp) || !ReadPod(in_, id) ||
+        !ReadPod(in_, rec.mask))
+        return false;
+    rec.timeStamp = timeStamp;
+    rec.id = id;
+    for (unsigned int i = 0; i < Trace::NUM_FIELDS; i++)
+        if ((rec.mask & (1u << i)) && !ReadPod(in_, rec.fields[i]))
+            return false;
+
+    if (!ReadPod(in_, numNamed) || numNamed > maxLength)
+        return false;
+    rec.named.resize(numNamed);
+    for (uint32_t i = 0; i < numNamed; i++) {
+        uint32_t len;
+        if (!ReadPod(in_, len) || len > maxLength)
+            return false;
+        rec.named[i].first.resize(len);
+        if ((len > 0 && !in_.read(&rec.named[i].first[0], len)) ||
+            !ReadPod(in_, rec.named[i].second))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,202 @@
+/** \file BananaGates.cpp
+ * \brief Banana gates read from DAMM .ban files
+ */
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "BananaGates.hpp"
+#include "Messenger.hpp"
+
+namespace {
+    //! Length of the fixed records of a .ban file
+    const size_t kRecordLength = 80;
+
+    /** Read a fixed width integer field of a record
+     * \param [in] record : the record to read from
+     * \param [in] pos : the position of the field
+     * \param [out] value : the value of the field
+     * \return false if the field is blank */
+    bool ReadField(const std::string &record, const size_t &pos, int &value) {
+        if (pos + 5 > record.size())
+            return false;
+        std::string field = record.substr(pos, 5);
+        if (field.find_first_not_of(' ') == std::string::npos)
+            return false;
+        value = atoi(field.c_str());
+        return true;
+    }
+}
+
+BananaGates *BananaGates::get() {
+    static BananaGates instance;
+    return &instance;
+}
+
+/** A .ban file starts with a directory of the banana ids, followed by a set
+ * of 80 character records for each banana: an INP record with the name of
+ * the .his file, the histogram id, the banana id and the number of vertices,
+ * a TIT and a GATE record, and CXY records holding up to seven vertices
+ * each. Lines written by an editor are accepted as well. */
+bool BananaGates::Load(const std::string &file) {
+    Messenger m;
+    std::stringstream ss;
+
+    std::ifstream in(file.c_str());
+    if (!in.good()) {
+        ss << "BananaGates: Unable to open the banana file " << file;
+        m.warning(ss.str());
+        return false;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    contents.erase(std::remove(contents.begin(), contents.end(), '\r'),
+                   contents.end());
+
+    //Split into records, padding any short lines to the full length
+    std::vector<std::string> records;
+    std::istringstream lines(contents);
+    std::string line;
+    while (std::getline(lines, line)) {
+        for (size_t pos = 0; pos < line.size(); pos += kRecordLength) {
+            std::string record = line.substr(pos, kRecordLength);
+            record.resize(kRecordLength, ' ');
+            records.push_back(record);
+        }
+    }
+
+    unsigned int numLoaded = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].compare(0, 4, "INP ") != 0)
+            continue;
+
+        //The last four fields are the histogram id, banana id, an unused
+        //field and the number of vertices.
+        std::istringstream inp(records[i].substr(4));
+        std::vector<std::string> fields;
+        std::string field;
+        while (inp >> field)
+            fields.push_back(field);
+        if (fields.size() < 4) {
+            m.warning("BananaGates: Skipping a malformed INP record in " + file);
+            continue;
+        }
+        int id = atoi(fields[fields.size() - 3].c_str());
+        int numVertices = atoi(fields[fields.size() - 1].c_str());
+
+        std::vector<std::pair<int, int> > vertices;
+        for (size_t j = i + 1; j < records.size() &&
+             records[j].compare(0, 4, "INP ") != 0; j++) {
+            if (records[j].compare(0, 3, "CXY") != 0)
+                continue;
+            int x, y;
+            for (size_t pos = 5; (int)vertices.size() < numVertices &&
+                 ReadField(records[j], pos, x) &&
+                 ReadField(records[j], pos + 5, y); pos += 10)
+                vertices.push_back(std::make_pair(x, y));
+        }
+
+        if (id < 0 || vertices.size() < 3) {
+            ss << "BananaGates: Skipping banana " << id << " of " << file
+               << ", it has fewer than three vertices";
+            m.warning(ss.str());
+            ss.str("");
+            continue;
+        }
+
+        SetGate(id, vertices);
+        numLoaded++;
+    }
+
+    ss << "Loaded " << numLoaded << " bananas from " << file;
+    m.detail(ss.str());
+    return true;
+}
+
+unsigned int BananaGates::GetNumGates() const {
+    unsigned int num = 0;
+    for (std::vector<Gate>::const_iterator it = gates_.begin();
+         it != gates_.end(); it++)
+        if (!it->rows.empty())
+            num++;
+    return num;
+}
+
+/** Each row is cut with the edges of the polygon using the even-odd rule,
+ * counting an edge from its lower vertex up to, but not including, its
+ * upper one. The channels lying on an edge are added to the row as well,
+ * so that the edges always belong to the banana. */
+void BananaGates::SetGate(const int &id,
+                          const std::vector<std::pair<int, int> > &vertices) {
+    if (id < 0)
+        return;
+    if ((size_t)id >= gates_.size())
+        gates_.resize(id + 1);
+
+    Gate &gate = gates_[id];
+    gate = Gate();
+    if (vertices.empty())
+        return;
+
+    int yMin = vertices[0].second, yMax = vertices[0].second;
+    for (size_t i = 1; i < vertices.size(); i++) {
+        yMin = std::min(yMin, vertices[i].second);
+        yMax = std::max(yMax, vertices[i].second);
+    }
+    gate.yMin = yMin;
+
+    std::vector<double> crossings;
+    std::vector<std::pair<int, int> > row;
+    for (int y = yMin; y <= yMax; y++) {
+        gate.rows.push_back(gate.intervals.size());
+        crossings.clear();
+        row.clear();
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const std::pair<int, int> &a = vertices[i];
+            const std::pair<int, int> &b = vertices[(i + 1) % vertices.size()];
+            if (a.second == b.second) {
+                if (a.second == y)
+                    row.push_back(std::make_pair(std::min(a.first, b.first),
+                                                 std::max(a.first, b.first)));
+                continue;
+            }
+            if (y < std::min(a.second, b.second) ||
+                y > std::max(a.second, b.second))
+                continue;
+
+            double x = a.first + (double)(y - a.second) *
+                (b.first - a.first) / (b.second - a.second);
+            if (x == std::floor(x))
+                row.push_back(std::make_pair((int)x, (int)x));
+            if ((a.second <= y) != (b.second <= y))
+                crossings.push_back(x);
+        }
+
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            int low = (int)std::ceil(crossings[i]);
+            int high = (int)std::floor(crossings[i + 1]);
+            if (low <= high)
+                row.push_back(std::make_pair(low, high));
+        }
+
+        //Merge the overlapping and adjacent intervals of the row
+        std::sort(row.begin(), row.end());
+        for (size_t i = 0; i < row.size(); i++) {
+            if (gate.intervals.size() > gate.rows.back() &&
+                row[i].first <= gate.intervals.back().second + 1)
+                gate.intervals.back().second =
+                    std::max(gate.intervals.back().second, row[i].second);
+            else
+                gate.intervals.push_back(row[i]);
+        }
+    }
+    gate.rows.push_back(gate.intervals.size());
+}
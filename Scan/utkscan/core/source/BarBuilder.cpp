@@ -3,16 +3,65 @@
  *  \author S. V. Paulauskas
  *  \date December 15, 2014
 */
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
 #include "BarBuilder.hpp"
+#include "DetectorLibrary.hpp"
 #include "TimingMapBuilder.hpp"
 
 using namespace std;
 
+BarBuilder::BarBuilder(const std::string &type) {
+    isFlat_ = true;
+    DetectorLibrary *lib = DetectorLibrary::get();
+
+    //The number of bars of each subtype, from the largest location
+    map<string, unsigned int> numBars;
+    for(DetectorLibrary::const_iterator it = lib->begin();
+        it != lib->end(); it++) {
+        if(it->GetType() != type || it->GetLocation() < 0)
+            continue;
+        unsigned int &num = numBars[it->GetSubtype()];
+        num = max(num, CalcBarNumber(it->GetLocation()) + 1);
+    }
+
+    map<string, unsigned int> firstSlot;
+    for(map<string, unsigned int>::const_iterator it = numBars.begin();
+        it != numBars.end(); it++) {
+        firstSlot[it->first] = keys_.size();
+        for(unsigned int bar = 0; bar < it->second; bar++)
+            keys_.push_back(make_pair(bar, it->first));
+    }
+
+    slotOfChannel_.assign(lib->size(), -1);
+    sideOfChannel_.assign(lib->size(), 0);
+    for(DetectorLibrary::size_type i = 0; i < lib->size(); i++) {
+        const Identifier &id = lib->at(i);
+        if(id.GetType() != type || id.GetLocation() < 0)
+            continue;
+        slotOfChannel_[i] = firstSlot[id.GetSubtype()] +
+            CalcBarNumber(id.GetLocation());
+        if(id.HasTag("left") || id.HasTag("up") || id.HasTag("top"))
+            sideOfChannel_[i] |= 1;
+        if(id.HasTag("right") || id.HasTag("down") || id.HasTag("bottom"))
+            sideOfChannel_[i] |= 2;
+    }
+
+    hrtArray_.Resize(keys_.size());
+    lrtArray_.Resize(keys_.size());
+    leftEnds_.Resize(keys_.size());
+    rightEnds_.Resize(keys_.size());
+}
+
 void BarBuilder::BuildBars(void) {
     ClearMaps();
+    if(isFlat_) {
+        FillArrays();
+        BuildArrays();
+        return;
+    }
     FillMaps();
 
     for(map<unsigned int, unsigned int>::const_iterator it = lefts_.begin();
@@ -25,19 +74,45 @@ void BarBuilder::BuildBars(void) {
 	   list_.at(mate->second)->GetTrace().size() != 0) {
 	    TimingDefs::TimingIdentifier key =
 	     	make_pair(it->first, list_.at(it->second)->GetChanID().GetSubtype());
-	    hrtBars_.insert(make_pair(key,
-            BarDetector(HighResTimingData(list_.at(it->second)),
-                        HighResTimingData(list_.at(mate->second)), key)));
+	    hrtBars_.insert(make_pair(key, MakeBar(it->second, mate->second, key)));
 	} else {
 	    lrtBars_.insert(make_pair(it->first,
-				      make_pair(0.5*(list_.at(it->second)->GetCorrectedTime()+
-						     list_.at(mate->second)->GetCorrectedTime()),
-						sqrt(list_.at(it->second)->GetCalEnergy()*
-						     list_.at(mate->second)->GetCalEnergy()))));
+				      MakeLrtBar(it->second, mate->second)));
 	}
     }
 }
 
+void BarBuilder::BuildArrays(void) {
+    for(size_t slot = leftEnds_.Next(0); slot < leftEnds_.size();
+        slot = leftEnds_.Next(slot + 1)) {
+	if(!rightEnds_.Has(slot))
+	    continue;
+
+	unsigned int left = leftEnds_[slot];
+	unsigned int right = rightEnds_[slot];
+	if(list_[left]->GetTrace().size() != 0 &&
+	   list_[right]->GetTrace().size() != 0)
+	    hrtArray_.Set(slot, MakeBar(left, right, keys_[slot]));
+	else
+	    lrtArray_.Set(slot, MakeLrtBar(left, right));
+    }
+}
+
+BarDetector BarBuilder::MakeBar(const unsigned int &left,
+                                const unsigned int &right,
+                                TimingDefs::TimingIdentifier key) {
+    return(BarDetector(HighResTimingData(list_.at(left)),
+                       HighResTimingData(list_.at(right)), key));
+}
+
+pair<double,double> BarBuilder::MakeLrtBar(const unsigned int &left,
+                                           const unsigned int &right) {
+    return(make_pair(0.5*(list_.at(left)->GetCorrectedTime()+
+                          list_.at(right)->GetCorrectedTime()),
+                     sqrt(list_.at(left)->GetCalEnergy()*
+                          list_.at(right)->GetCalEnergy())));
+}
+
 unsigned int BarBuilder::CalcBarNumber(const unsigned int &loc) {
     return(loc/2);
 }
@@ -47,6 +122,10 @@ void BarBuilder::ClearMaps(void){
     hrtBars_.clear();
     lefts_.clear();
     rights_.clear();
+    hrtArray_.clear();
+    lrtArray_.clear();
+    leftEnds_.clear();
+    rightEnds_.clear();
 }
 
 void BarBuilder::FillMaps(void) {
@@ -61,3 +140,19 @@ void BarBuilder::FillMaps(void) {
 	    rights_.insert(make_pair(barNum,idx));
     }
 }
+
+void BarBuilder::FillArrays(void) {
+    for(vector<ChanEvent*>::const_iterator it = list_.begin();
+    it != list_.end(); it++) {
+	size_t channel = (*it)->GetID();
+	if(channel >= slotOfChannel_.size() || slotOfChannel_[channel] < 0)
+	    continue;
+	unsigned int slot = slotOfChannel_[channel];
+	unsigned int idx = (unsigned int)(it - list_.begin());
+	//As for the maps, the first end found in the list is kept
+	if((sideOfChannel_[channel] & 1) && !leftEnds_.Has(slot))
+	    leftEnds_.Set(slot, idx);
+	if((sideOfChannel_[channel] & 2) && !rightEnds_.Has(slot))
+	    rightEnds_.Set(slot, idx);
+    }
+}
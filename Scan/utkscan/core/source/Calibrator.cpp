@@ -3,11 +3,14 @@
  * \author K. A. Miernik
  * \date 2012
  */
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
 #include "Calibrator.hpp"
 #include "Exceptions.hpp"
+#include "Globals.hpp"
+#include "HitTable.hpp"
 
 using namespace std;
 
@@ -90,35 +93,187 @@ double Calibrator::GetCalEnergy(const Identifier& chanID, double raw) const {
         if (itf == itch->second.end()) {
             return 0;
         }
-        switch(itf->model) {
-            case cal_raw:
-                return ModelRaw(raw);
-                break;
-            case cal_off:
-                return ModelOff();
-                break;
-            case cal_linear:
-                return ModelLinear(itf->parameters, raw);
-                break;
-            case cal_quadratic:
-                return ModelQuadratic(itf->parameters, raw);
-                break;
-            case cal_cubic:
-                return ModelCubic(itf->parameters, raw);
-                break;
-            case cal_polynomial:
-                return ModelPolynomial(itf->parameters, raw);
-                break;
-            case cal_hyplin:
-                return ModelHypLin(itf->parameters, raw);
-                break;
-            case cal_exp:
-                return ModelExp(itf->parameters, raw);
-                break;
-            default:
-                break;
+        return Evaluate(itf->model, itf->parameters.data(),
+                        itf->parameters.size(), raw);
+    }
+    return raw;
+}
+
+void Calibrator::BuildTable(const std::vector<Identifier>& chans) {
+    TableRanges none = {0, 0, false};
+    index_.assign(chans.size(), none);
+    gains_.assign(chans.size(), 1.0);
+    entries_.clear();
+    pars_.clear();
+
+    vector<size_t> offsets;
+    for (size_t i = 0; i < chans.size(); i++) {
+        map<Identifier, vector<CalibrationParams> >::const_iterator itch =
+            channels_.find(chans[i]);
+        if (itch == channels_.end())
+            continue;
+        //The first range holding a raw value is used, so the ranges are
+        //sorted for the binary search of FindEntry only if they do not
+        //overlap, otherwise they are walked in the order they were added
+        vector<const CalibrationParams*> ranges;
+        for (vector<CalibrationParams>::const_iterator itf =
+                 itch->second.begin(); itf != itch->second.end(); ++itf)
+            ranges.push_back(&(*itf));
+        vector<const CalibrationParams*> sorted(ranges);
+        stable_sort(sorted.begin(), sorted.end(),
+                    [](const CalibrationParams *a, const CalibrationParams *b) {
+                        return a->min < b->min;
+                    });
+        bool disjoint = true;
+        for (size_t r = 1; r < sorted.size(); r++)
+            if (!(sorted[r - 1]->max < sorted[r]->min))
+                disjoint = false;
+        if (disjoint)
+            ranges.swap(sorted);
+
+        index_[i].first = entries_.size();
+        index_[i].num = ranges.size();
+        index_[i].disjoint = disjoint;
+        for (vector<const CalibrationParams*>::const_iterator itr =
+                 ranges.begin(); itr != ranges.end(); ++itr) {
+            const CalibrationParams *itf = *itr;
+            TableEntry entry;
+            entry.model = itf->model;
+            entry.min = itf->min;
+            entry.max = itf->max;
+            entry.par = NULL;
+            entry.numPar = itf->parameters.size();
+
+            //Models which are (at most) cubic polynomials get packed
+            //coefficients so they can be calibrated together in batches
+            const vector<double> &par = itf->parameters;
+            unsigned int order = 0;
+            entry.cubic = true;
+            switch (itf->model) {
+                case cal_raw: order = 0; break;
+                case cal_off: order = 0; break;
+                case cal_linear: order = 2; break;
+                case cal_quadratic: order = 3; break;
+                case cal_cubic: order = 4; break;
+                case cal_polynomial:
+                    order = par.size();
+                    entry.cubic = (order <= 4);
+                    break;
+                default: entry.cubic = false; break;
+            }
+            for (unsigned int p = 0; p < 4; p++)
+                entry.poly[p] = (entry.cubic && p < order) ? par[p] : 0;
+            if (itf->model == cal_raw)
+                entry.poly[1] = 1;
+            entries_.push_back(entry);
+            offsets.push_back(pars_.size());
+            pars_.insert(pars_.end(), itf->parameters.begin(),
+                         itf->parameters.end());
+        }
+    }
+
+    //The coefficients are pointed to only once pars_ has stopped growing
+    for (size_t i = 0; i < entries_.size(); i++)
+        entries_[i].par = pars_.data() + offsets[i];
+}
+
+void Calibrator::GetCalEnergies(const int *index, const double *raw,
+                                double *cal, size_t n) const {
+    if (batchX_.size() < n) {
+        batchRow_.resize(n);
+        batchX_.resize(n);
+        for (unsigned int p = 0; p < 4; p++)
+            batchPoly_[p].resize(n);
+    }
+
+    //Sort the hits: cubic ones are gathered, the rest are done right away
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        double def;
+        const TableEntry *entry = FindEntry(index[i], raw[i], def);
+        if (entry == NULL) {
+            cal[i] = def;
+        } else if (entry->cubic) {
+            batchRow_[m] = i;
+            batchX_[m] = raw[i];
+            for (unsigned int p = 0; p < 4; p++)
+                batchPoly_[p][m] = entry->poly[p];
+            m++;
+        } else {
+            cal[i] = Evaluate(entry->model, entry->par, entry->numPar,
+                              raw[i] * gains_[index[i]]);
         }
     }
+
+    double *x = batchX_.data();
+    const double *c0 = batchPoly_[0].data();
+    const double *c1 = batchPoly_[1].data();
+    const double *c2 = batchPoly_[2].data();
+    const double *c3 = batchPoly_[3].data();
+    for (size_t k = 0; k < m; k++)
+        x[k] = c0[k] + x[k] * (c1[k] + x[k] * (c2[k] + x[k] * c3[k]));
+
+    for (size_t k = 0; k < m; k++)
+        cal[batchRow_[k]] = x[k];
+}
+
+void Calibrator::GetCalEnergies(const HitTable &hits,
+                                std::vector<double> &cal) const {
+    batchIndex_.resize(hits.size());
+    for (size_t i = 0; i < hits.size(); i++)
+        batchIndex_[i] = hits.modNum[i] * pixie::numberOfChannels +
+            hits.chanNum[i];
+    cal.resize(hits.size());
+    GetCalEnergies(batchIndex_.data(), hits.energy.data(), cal.data(),
+                   hits.size());
+}
+
+void Calibrator::SetGain(int index, double gain) {
+    if (index < 0 || index >= (int)gains_.size() || gain <= 0)
+        return;
+    double scale = gain / gains_[index];
+    gains_[index] = gain;
+    const TableRanges &range = index_[index];
+    for (unsigned int i = range.first; i < range.first + range.num; i++) {
+        if (!entries_[i].cubic)
+            continue;
+        //poly(gain * x) has the coefficient of x^p scaled by gain^p
+        double factor = scale;
+        for (unsigned int p = 1; p < 4; p++, factor *= scale)
+            entries_[i].poly[p] *= factor;
+    }
+}
+
+double Calibrator::Evaluate(CalibrationModel model, const double *par,
+                            unsigned int numPar, double raw) const {
+    switch(model) {
+        case cal_raw:
+            return ModelRaw(raw);
+            break;
+        case cal_off:
+            return ModelOff();
+            break;
+        case cal_linear:
+            return ModelLinear(par, raw);
+            break;
+        case cal_quadratic:
+            return ModelQuadratic(par, raw);
+            break;
+        case cal_cubic:
+            return ModelCubic(par, raw);
+            break;
+        case cal_polynomial:
+            return ModelPolynomial(par, numPar, raw);
+            break;
+        case cal_hyplin:
+            return ModelHypLin(par, raw);
+            break;
+        case cal_exp:
+            return ModelExp(par, raw);
+            break;
+        default:
+            break;
+    }
     return raw;
 }
 
@@ -130,34 +285,30 @@ double Calibrator::ModelOff() const {
     return 0;
 }
 
-double Calibrator::ModelLinear(const std::vector<double>& par,
+double Calibrator::ModelLinear(const double *par,
                                     double raw) const {
     return par[0] + par[1] * raw;
 }
 
-double Calibrator::ModelQuadratic(const std::vector<double>& par,
+double Calibrator::ModelQuadratic(const double *par,
                                     double raw) const {
     return par[0] + par[1] * raw + par[2] * raw * raw;
 }
 
-double Calibrator::ModelCubic(const std::vector<double>& par,
+double Calibrator::ModelCubic(const double *par,
                               double raw) const {
     return(par[0] + par[1]*raw + par[2]*raw*raw + par[3]*raw*raw*raw);
 }
 
-double Calibrator::ModelPolynomial(const std::vector<double>& par,
+double Calibrator::ModelPolynomial(const double *par, unsigned int numPar,
                                     double raw) const {
-    int p = 0;
     double r = 0;
-    for (vector<double>::const_iterator it = par.begin(); it != par.end();
-        ++it) {
-        r += (*it) * pow(raw, p);
-        ++p;
-    }
+    for (unsigned int p = numPar; p > 0; --p)
+        r = r * raw + par[p - 1];
     return r;
 }
 
-double Calibrator::ModelHypLin(const std::vector<double>& par,
+double Calibrator::ModelHypLin(const double *par,
                                double raw) const {
     if (raw > 0)
         return par[0] / raw + par[1] + par[2] * raw;
@@ -165,7 +316,7 @@ double Calibrator::ModelHypLin(const std::vector<double>& par,
         return 0;
 }
 
-double Calibrator::ModelExp(const std::vector<double>& par,
+double Calibrator::ModelExp(const double *par,
                                double raw) const {
     if (raw > 0)
         return par[0] * exp(raw / par[1]) + par[2];
@@ -29,7 +29,7 @@ void ChanEvent::ZeroNums() {
 unsigned long ChanEvent::GetQdcValue(int i) const {
     if (i < 0 || i >= data_.numQdcs)
         return pixie::U_DELIMITER;
-    return data_.qdcValue[i];
+    return data_.getQdcValue(i);
 }
 
 const Identifier& ChanEvent::GetChanID() const {
@@ -40,6 +40,27 @@ int ChanEvent::GetID() const {
     return DetectorLibrary::get()->GetIndex(data_.modNum, data_.chanNum);
 }
 
+void ChanEvent::Set(XiaData *xiadata) {
+    ZeroNums();
+    trace.Reset();
+    if (xiadata->hasTraceView())
+        trace.assign(xiadata->traceView,
+                     xiadata->traceView + xiadata->traceViewLength);
+    else
+        trace.assign(xiadata->adcTrace.begin(), xiadata->adcTrace.end());
+
+    //Move the XIA trace aside so that it is not copied into data_
+    std::vector<int> samples;
+    samples.swap(xiadata->adcTrace);
+    data_ = *xiadata;
+    xiadata->adcTrace.swap(samples);
+
+    data_.traceView = NULL;
+    data_.traceViewLength = 0;
+    //The onboard QDCs are left in the spill buffer, which is kept until the
+    //event has been processed, and only read by GetQdcValue.
+}
+
 //! [Zero Channel]
 void ChanEvent::ZeroVar() {
     ZeroNums();
@@ -0,0 +1,94 @@
+/** \file CoincidenceJoin.cpp
+ * \brief Pairs the hits of two detectors which are within a time window
+ */
+#include <algorithm>
+
+#include "ChanEvent.hpp"
+#include "CoincidenceJoin.hpp"
+#include "DetectorSummary.hpp"
+
+using namespace std;
+
+void CoincidenceJoin::Sort(const vector<ChanEvent*> &chans,
+                           vector<Hit> &hits) const {
+    hits.resize(chans.size());
+    for (size_t i = 0; i < chans.size(); i++) {
+        ChanEvent *chan = chans[i];
+        hits[i].chan = chan;
+        switch (source_) {
+            case TIME:
+                hits[i].time = chan->GetTime();
+                break;
+            case HIGH_RES_TIME:
+                hits[i].time = chan->GetHighResTime();
+                break;
+            default:
+                hits[i].time = chan->GetCorrectedTime();
+        }
+    }
+    //! The hits of a summary are usually in time order already
+    if (!is_sorted(hits.begin(), hits.end()))
+        stable_sort(hits.begin(), hits.end());
+}
+
+const vector<CoincidenceJoin::Pair> &CoincidenceJoin::Join(
+        const vector<ChanEvent*> &first, const vector<ChanEvent*> &second,
+        double low, double high) {
+    pairs_.clear();
+    if (first.empty() || second.empty() || low > high)
+        return(pairs_);
+    Sort(first, first_);
+    Sort(second, second_);
+
+    size_t numSecond = second_.size();
+    if (numSecond <= kSmallMult) {
+        //! Every time of the second list is tested, without branches, and
+        //! only the hits which are in the window are looked at again
+        double times[kSmallMult];
+        bool in[kSmallMult];
+        for (size_t j = 0; j < numSecond; j++)
+            times[j] = second_[j].time;
+        for (size_t i = 0; i < first_.size(); i++) {
+            double t = first_[i].time;
+            unsigned int numIn = 0;
+            for (size_t j = 0; j < numSecond; j++) {
+                double dt = times[j] - t;
+                in[j] = (dt >= low) & (dt <= high);
+                numIn += in[j];
+            }
+            if (numIn == 0)
+                continue;
+            for (size_t j = 0; j < numSecond; j++) {
+                if (!in[j])
+                    continue;
+                Pair pair = {first_[i].chan, second_[j].chan, times[j] - t};
+                pairs_.push_back(pair);
+            }
+        }
+        return(pairs_);
+    }
+
+    //! The window of each hit starts at or after that of the hit before it
+    size_t start = 0;
+    for (size_t i = 0; i < first_.size(); i++) {
+        double t = first_[i].time;
+        while (start < numSecond && second_[start].time - t < low)
+            start++;
+        if (start == numSecond)
+            break;
+        for (size_t j = start; j < numSecond; j++) {
+            double dt = second_[j].time - t;
+            if (dt > high)
+                break;
+            Pair pair = {first_[i].chan, second_[j].chan, dt};
+            pairs_.push_back(pair);
+        }
+    }
+    return(pairs_);
+}
+
+const vector<CoincidenceJoin::Pair> &CoincidenceJoin::Join(
+        const DetectorSummary &first, const DetectorSummary &second,
+        double low, double high) {
+    return(Join(first.GetList(), second.GetList(), low, high));
+}
@@ -45,8 +45,9 @@ const double Correlator::minImpTime = 5e-3;
 const double Correlator::corrTime   = 60; // used to be 3300
 const double Correlator::fastTime   = 40e-6;
 
-Correlator::Correlator() : histo(OFFSET, RANGE, "correlator"),
-    lastImplant(NULL), lastDecay(NULL), condition(UNKNOWN_CONDITION) {
+Correlator::Correlator(unsigned int sizeX, unsigned int sizeY) :
+    histo(OFFSET, RANGE, "correlator"), lastImplant(NULL), lastDecay(NULL),
+    condition(UNKNOWN_CONDITION), decaylist(sizeX, sizeY) {
 }
 
 EventInfo::EventInfo() {
@@ -172,11 +173,10 @@ void CorrelationList::PrintDecayList() const {
 
 Correlator::~Correlator() {
     // dump any flagged decay lists which have not been output
-    for(unsigned int i=0; i < arraySize; i++) {
-            for(unsigned int j=0; j < arraySize; j++) {
-                    if(IsFlagged(i,j))
-                        PrintDecayList(i,j);
-                }
+    for(PixelMap<CorrelationList>::iterator it = decaylist.begin();
+        it != decaylist.end(); it++) {
+            if(it->value.IsFlagged())
+                PrintDecayList(it->x, it->y);
         }
 }
 
@@ -195,11 +195,19 @@ void Correlator::DeclarePlots() {
 void Correlator::Correlate(EventInfo &event, unsigned int fch,
                            unsigned int bch) {
     using namespace dammIds::correlator;
-    if(fch < 0 || fch >= arraySize || bch < 0  || bch >= arraySize) {
+    if(!decaylist.IsValid(fch, bch)) {
             plot(D_CONDITION, INVALID_LOCATION);
             return;
         }
-    CorrelationList &theList = decaylist[fch][bch];
+    // Only an implant creates the list of a pixel, a decay in a pixel
+    // that never had one has nothing to correlate with
+    CorrelationList *found = event.type == EventInfo::IMPLANT_EVENT ?
+        &decaylist.Get(fch, bch) : decaylist.Find(fch, bch);
+    if(found == NULL) {
+            plot(D_CONDITION, condition);
+            return;
+        }
+    CorrelationList &theList = *found;
     double lastTime = NAN;
     double clockInSeconds = Globals::get()->clockInSeconds();
     switch(event.type) {
@@ -251,13 +259,12 @@ void Correlator::Correlate(EventInfo &event, unsigned int fch,
                                      << "\n  DT: " << dt << endl;
                                 // PIXIE's clock has most likely been zeroed due to a file marker
                                 //   no chance of doing correlations
-                                for(unsigned int i=0; i < arraySize; i++) {
-                                        for(unsigned int j=0; j < arraySize; j++) {
-                                                if(IsFlagged(i,j)) {
-                                                        PrintDecayList(i, j);
-                                                    }
-                                                decaylist[i][j].clear();
+                                for(PixelMap<CorrelationList>::iterator it = decaylist.begin();
+                                    it != decaylist.end(); it++) {
+                                        if(it->value.IsFlagged()) {
+                                                PrintDecayList(it->x, it->y);
                                             }
+                                        it->value.clear();
                                     }
                             }
                         else if(event.type != EventInfo::GAMMA_EVENT) {
@@ -306,27 +313,26 @@ void Correlator::Correlate(EventInfo &event, unsigned int fch,
 }
 
 void Correlator::CorrelateAll(EventInfo &event) {
-    for(unsigned int fch=0; fch < arraySize; fch++) {
-            for(unsigned int bch=0; bch < arraySize; bch++) {
-                    if(decaylist[fch][bch].size() == 0)
-                        continue;
-                    if(event.time - decaylist[fch][bch].back().time <
-                            10e-6 / Globals::get()->clockInSeconds()) {
-                            // only correlate fast events for now
-                            Correlate(event, fch, bch);
-                        }
+    const double fastWindow = 10e-6 / Globals::get()->clockInSeconds();
+    for(PixelMap<CorrelationList>::iterator it = decaylist.begin();
+        it != decaylist.end(); it++) {
+            if(it->value.size() == 0)
+                continue;
+            if(event.time - it->value.back().time < fastWindow) {
+                    // only correlate fast events for now
+                    Correlate(event, it->x, it->y);
                 }
         }
 }
 
 void Correlator::CorrelateAllX(EventInfo &event, unsigned int bch) {
-    for(unsigned int fch = 0; fch < arraySize; fch++) {
+    for(unsigned int fch = 0; fch < decaylist.GetSizeX(); fch++) {
             Correlate(event, fch, bch);
         }
 }
 
 void Correlator::CorrelateAllY(EventInfo &event, unsigned int fch) {
-    for(unsigned int bch = 0; bch < arraySize; bch++) {
+    for(unsigned int bch = 0; bch < decaylist.GetSizeY(); bch++) {
             Correlate(event, fch, bch);
         }
 }
@@ -341,7 +347,8 @@ double Correlator::GetDecayTime(void) const {
 }
 
 double Correlator::GetDecayTime(int fch, int bch) const {
-    return decaylist[fch][bch].GetDecayTime();
+    const CorrelationList *list = decaylist.Find(fch, bch);
+    return list == NULL ? NAN : list->GetDecayTime();
 }
 
 double Correlator::GetImplantTime(void) const {
@@ -354,19 +361,33 @@ double Correlator::GetImplantTime(void) const {
 }
 
 double Correlator::GetImplantTime(int fch, int bch) const {
-    return decaylist[fch][bch].GetImplantTime();
+    const CorrelationList *list = decaylist.Find(fch, bch);
+    return list == NULL ? NAN : list->GetImplantTime();
+}
+
+size_t Correlator::GetMemory(void) const {
+    return decaylist.GetMemory([](const CorrelationList& list) {
+        return list.capacity() * sizeof(EventInfo);
+    });
 }
 
 void Correlator::Flag(int fch, int bch) {
-    if(!decaylist[fch][bch].empty())
-        decaylist[fch][bch].Flag();
+    CorrelationList *list = decaylist.Find(fch, bch);
+    if(list != NULL && !list->empty())
+        list->Flag();
 }
 
 bool Correlator::IsFlagged(int fch, int bch) {
-    return decaylist[fch][bch].IsFlagged();
+    const CorrelationList *list = decaylist.Find(fch, bch);
+    return list != NULL && list->IsFlagged();
 }
 
 void Correlator::PrintDecayList(unsigned int fch, unsigned int bch) const {
     cout << "Current decay list for " << fch << " , " << bch << " : " << endl;
-    decaylist[fch][bch].PrintDecayList();
+    const CorrelationList *list = decaylist.Find(fch, bch);
+    if(list == NULL) {
+            cout << "    EMPTY" << endl;
+            return;
+        }
+    list->PrintDecayList();
 }
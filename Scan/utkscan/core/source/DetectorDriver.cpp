@@ -13,16 +13,20 @@
 
 #include "pugixml.hpp"
 
+#include "AnalysisCache.hpp"
 #include "DammPlotIds.hpp"
 #include "DetectorDriver.hpp"
 #include "DetectorLibrary.hpp"
 #include "Exceptions.hpp"
 #include "HighResTimingData.hpp"
+#include "MapCache.hpp"
 #include "RandomPool.hpp"
 #include "RawEvent.hpp"
+#include "TimingCalibrator.hpp"
 #include "TreeCorrelator.hpp"
 
 #include "BetaScintProcessor.hpp"
+#include "ColumnProcessor.hpp"
 #include "DoubleBetaProcessor.hpp"
 #include "Hen3Processor.hpp"
 #include "GeProcessor.hpp"
@@ -42,6 +46,7 @@
 
 #include "CfdAnalyzer.hpp"
 #include "FittingAnalyzer.hpp"
+#include "GpuTraceAnalyzer.hpp"
 #include "TauAnalyzer.hpp"
 #include "TraceAnalyzer.hpp"
 #include "TraceExtractor.hpp"
@@ -53,6 +58,7 @@
 
 #ifdef useroot
 #include "RootProcessor.hpp"
+#include "TraceOutputProcessor.hpp"
 #endif
 
 using namespace std;
@@ -66,8 +72,21 @@ DetectorDriver* DetectorDriver::get() {
     return instance;
 }
 
-DetectorDriver::DetectorDriver() : histo(OFFSET, RANGE, "DetectorDriver") {
+/// The constants of a configuration read again, swapped in by ApplyReload
+struct DetectorDriver::PendingCalibrations {
+    Calibrator cali; //!< the energy calibrations, with their flat table
+    WalkCorrector walk; //!< the walk corrections, with their flat table
+    map<TimingDefs::TimingIdentifier, TimingCalibration> timing; //!< the timing calibrations
+};
+
+DetectorDriver::DetectorDriver() : histo(OFFSET, RANGE, "DetectorDriver"),
+                                   numThreads_(1), deterministic_(false),
+                                   perf_(NULL),
+                                   spillFills_(histo),
+                                   skimPlace_(-1), analysisCache_(NULL),
+                                   pendingCals_(NULL), reloadPending_(false) {
     cfg_ = Globals::get()->configfile();
+    run_ = Globals::get()->constants();
     Messenger m;
     try {
         m.start("Loading Processors");
@@ -88,6 +107,9 @@ DetectorDriver::DetectorDriver() : histo(OFFSET, RANGE, "DetectorDriver") {
 }
 
 DetectorDriver::~DetectorDriver() {
+    profiler_.Print(cout);
+    gainTracker_.Print(cout);
+
     for (vector<EventProcessor *>::iterator it = vecProcess.begin();
 	 it != vecProcess.end(); it++)
         delete(*it);
@@ -97,22 +119,18 @@ DetectorDriver::~DetectorDriver() {
 	 it != vecAnalyzer.end(); it++)
         delete(*it);
     vecAnalyzer.clear();
+    delete pendingCals_;
     instance = NULL;
 }
 
 void DetectorDriver::LoadProcessors(Messenger& m) {
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(cfg_.c_str());
-    if (!result) {
-        stringstream ss;
-        ss << "DetectorDriver: error parsing file " << cfg_;
-        ss << " : " << result.description();
-        throw IOException(ss.str());
-    }
+    const pugi::xml_document &doc = Globals::get()->configdoc();
 
     DetectorLibrary::get();
 
     pugi::xml_node driver = doc.child("Configuration").child("DetectorDriver");
+    numThreads_ = driver.attribute("threads").as_uint(1);
+    deterministic_ = driver.attribute("deterministic").as_bool(false);
     for (pugi::xml_node processor = driver.child("Processor"); processor;
         processor = processor.next_sibling("Processor")) {
         string name = processor.attribute("name").value();
@@ -170,10 +188,14 @@ void DetectorDriver::LoadProcessors(Messenger& m) {
                 processor.attribute("cycle_gate2_max").as_double(0.0);
             if (cycle_gate2_max == 0.0)
                 m.warning("Using default cycle_gate2_max = 0.0", 1);
+            string cube_file = processor.attribute("cube_file").as_string();
+            unsigned int cube_size =
+                processor.attribute("cube_size").as_uint(4096);
+            double cube_bin = processor.attribute("cube_bin").as_double(1.0);
             vecProcess.push_back(new GeProcessor(gamma_threshold, low_ratio,
                 high_ratio, sub_event, gamma_beta_limit, gamma_gamma_limit,
                 cycle_gate1_min, cycle_gate1_max, cycle_gate2_min,
-                cycle_gate2_max));
+                cycle_gate2_max, cube_file, cube_size, cube_bin));
         } else if (name == "GeCalibProcessor") {
             double gamma_threshold =
                 processor.attribute("gamma_threshold").as_double(1);
@@ -183,12 +205,24 @@ void DetectorDriver::LoadProcessors(Messenger& m) {
                 processor.attribute("high_ratio").as_double(3);
             vecProcess.push_back(new GeCalibProcessor(gamma_threshold,
                 low_ratio, high_ratio));
+        } else if (name == "ColumnProcessor") {
+            string fileName =
+                processor.attribute("file").as_string("events.col");
+            unsigned int chunkSize =
+                processor.attribute("chunk").as_uint(10000);
+            int level = processor.attribute("compression").as_int(1);
+            vecProcess.push_back(new ColumnProcessor(fileName, chunkSize,
+                                                     level));
         } else if (name == "Hen3Processor") {
-            vecProcess.push_back(new Hen3Processor());
+            double neutron_window =
+                processor.attribute("neutron_window").as_double(0);
+            vecProcess.push_back(new Hen3Processor(neutron_window * 1e-6));
         } else if (name == "IonChamberProcessor") {
             vecProcess.push_back(new IonChamberProcessor());
         } else if (name == "LiquidScintProcessor") {
-            vecProcess.push_back(new LiquidScintProcessor());
+            int neutron_banana =
+                processor.attribute("neutron_banana").as_int(0);
+            vecProcess.push_back(new LiquidScintProcessor(neutron_banana));
         } else if (name == "LogicProcessor") {
             vecProcess.push_back(new LogicProcessor());
         } else if (name == "NeutronScintProcessor") {
@@ -210,7 +244,9 @@ void DetectorDriver::LoadProcessors(Messenger& m) {
         } else if (name == "DoubleBetaProcessor") {
             vecProcess.push_back(new DoubleBetaProcessor());
         } else if (name == "PspmtProcessor") {
-                vecProcess.push_back(new PspmtProcessor());
+            bool positionMap =
+                processor.attribute("PositionMap").as_bool(false);
+            vecProcess.push_back(new PspmtProcessor(positionMap));
         } else if (name == "TemplateProcessor") {
             vecProcess.push_back(new TemplateProcessor());
         } else if (name == "TemplateExpProcessor") {
@@ -218,7 +254,38 @@ void DetectorDriver::LoadProcessors(Messenger& m) {
 	}
 #ifdef useroot
         else if (name == "RootProcessor") {
-            vecProcess.push_back(new RootProcessor("tree.root", "tree"));
+            unsigned int batchSize =
+                processor.attribute("batch").as_uint(0);
+            unsigned int imtThreads =
+                processor.attribute("imt_threads").as_uint(0);
+            vecProcess.push_back(new RootProcessor("tree.root", "tree",
+                                                   batchSize, imtThreads));
+        } else if (name == "TraceOutputProcessor") {
+            vector<TraceOutputProcessor::Rule> rules;
+            for (pugi::xml_node keep = processor.child("Keep"); keep;
+                 keep = keep.next_sibling("Keep")) {
+                TraceOutputProcessor::Rule rule;
+                rule.type = keep.attribute("type").as_string();
+                rule.subtype = keep.attribute("subtype").as_string();
+                rule.pileup = keep.attribute("pileup").as_bool(false);
+                rule.useEnergy = keep.attribute("emin") ||
+                    keep.attribute("emax");
+                rule.minEnergy = keep.attribute("emin").as_double(
+                    -numeric_limits<double>::max());
+                rule.maxEnergy = keep.attribute("emax").as_double(
+                    numeric_limits<double>::max());
+                rule.every = keep.attribute("every").as_uint(0);
+                rule.maxChiSq = keep.attribute("chisq").as_double(0.0);
+                if (rule.type.empty())
+                    throw GeneralException("DetectorDriver: a Keep rule of"
+                                           " the TraceOutputProcessor has no"
+                                           " type");
+                rules.push_back(rule);
+            }
+            if (rules.empty())
+                m.warning("TraceOutputProcessor has no Keep rules, no traces"
+                          " will be kept", 1);
+            vecProcess.push_back(new TraceOutputProcessor(rules));
         }
 #endif
         else {
@@ -247,16 +314,27 @@ void DetectorDriver::LoadProcessors(Messenger& m) {
 	    bool findPileups = analyzer.attribute("FindPileup").as_bool(false);
 	    vecAnalyzer.push_back(new TraceFilterAnalyzer(findPileups));
 	} else if(name == "TauAnalyzer") {
-            vecAnalyzer.push_back(new TauAnalyzer());
+            vecAnalyzer.push_back(new TauAnalyzer(
+                analyzer.attribute("survey").as_string("")));
         } else if (name == "TraceExtractor") {
             string type = analyzer.attribute("type").as_string();
             string subtype = analyzer.attribute("subtype").as_string();
             string tag = analyzer.attribute("tag").as_string();
-            vecAnalyzer.push_back(new TraceExtractor(type, subtype,tag));
+            vecAnalyzer.push_back(new TraceExtractor(type, subtype, tag,
+                analyzer.attribute("every").as_uint(1),
+                analyzer.attribute("rate").as_double(0),
+                analyzer.attribute("only").as_string("")));
         } else if (name == "WaveformAnalyzer") {
             vecAnalyzer.push_back(new WaveformAnalyzer());
         } else if (name == "CfdAnalyzer") {
-            vecAnalyzer.push_back(new CfdAnalyzer());
+            string type = analyzer.attribute("type").as_string();
+            vecAnalyzer.push_back(new CfdAnalyzer(type,
+                analyzer.attribute("fraction").as_double(0.25),
+                analyzer.attribute("delay").as_uint(2),
+                analyzer.attribute("threshold").as_uint(20)));
+        } else if (name == "GpuTraceAnalyzer") {
+            vecAnalyzer.push_back(new GpuTraceAnalyzer(
+                analyzer.attribute("minBatch").as_uint(16)));
         } else if (name == "WaaAnalyzer") {
             vecAnalyzer.push_back(new WaaAnalyzer());
         } else if (name == "FittingAnalyzer") {
@@ -281,10 +359,12 @@ void DetectorDriver::LoadProcessors(Messenger& m) {
 }
 
 void DetectorDriver::Init(RawEvent& rawev) {
+    analyzerTimers_.clear();
     for (vector<TraceAnalyzer *>::iterator it = vecAnalyzer.begin();
 	 it != vecAnalyzer.end(); it++) {
         (*it)->Init();
         (*it)->SetLevel(20);
+        analyzerTimers_.push_back(profiler_.Add((*it)->GetName(), "Analyze"));
     }
 
     for (vector<EventProcessor *>::iterator it = vecProcess.begin();
@@ -292,9 +372,31 @@ void DetectorDriver::Init(RawEvent& rawev) {
         (*it)->Init(rawev);
     }
 
+    //! Create the singletons used by processors before they run concurrently
+    if (numThreads_ > 1)
+        TimingCalibrator::get();
+    procGraph_.Build(vecProcess, numThreads_, &profiler_, deterministic_);
+    BuildAnalysisPlan();
+
+    //! The places are reset at the end of each event, so the place of the
+    //! skim is read here and the event marked to be kept
+    if (Globals::get()->hasSkim() && !Globals::get()->skimPlace().empty()) {
+        try {
+            skimPlace_ = TreeCorrelator::get()->index(Globals::get()->skimPlace());
+        } catch (TreeCorrelatorException &e) {
+            Messenger m;
+            m.warning("DetectorDriver: The place " + Globals::get()->skimPlace()
+                      + " of the skim does not exist, only the events kept "
+                      "by the processors are written.");
+        }
+    }
+
     try {
-        ReadCalXml();
-        ReadWalkXml();
+        const MapCache *cache = MapCache::get();
+        ReadCalXml(cache->channels(), cali, cache->verboseCalibration());
+        ReadWalkXml(cache->channels(), walk, cache->verboseWalk());
+        cali.BuildTable(*DetectorLibrary::get());
+        walk.BuildTable(*DetectorLibrary::get());
     } catch (GeneralException &e) {
         //! Any exception in reading calibration and walk correction
         //! will be intercepted here
@@ -310,17 +412,65 @@ void DetectorDriver::Init(RawEvent& rawev) {
     }
 }
 
+void DetectorDriver::SetPerf(PerfCounters *perf) {
+    perf_ = perf;
+    calibrateStage_ = perf_->Add("calibrate");
+    analyzeStage_ = perf_->Add("analyze");
+    processStage_ = perf_->Add("process");
+    fillStage_ = perf_->Add("fill");
+}
+
 void DetectorDriver::ProcessEvent(RawEvent& rawev) {
+    if (reloadPending_.load(std::memory_order_acquire))
+        ApplyReload();
+
+    //! The random numbers and fills of the event outside of the processors
+    if (deterministic_) {
+        RandomPool::get()->SetEvent(rawev.GetSequence());
+        Plots::SelectSlot(0);
+    }
+
+    Profiler::clock::time_point eventStart = Profiler::clock::now();
     plot(dammIds::raw::D_NUMBER_OF_EVENTS, dammIds::GENERIC_CHANNEL);
     try {
+        calEvents_.clear();
+        calIndex_.clear();
+        calRaw_.clear();
         for (vector<ChanEvent*>::const_iterator it = rawev.GetEventList().begin();
-             it != rawev.GetEventList().end(); ++it) {
+             it != rawev.GetEventList().end(); ++it)
             PlotRaw((*it));
+
+        PERF_START(stageStart);
+        AnalyzeTraces(rawev);
+        if (perf_)
+            PERF_RECORD(*perf_, analyzeStage_, stageStart, traceHits_.size());
+
+        PERF_RESTART(stageStart);
+        for (vector<ChanEvent*>::const_iterator it = rawev.GetEventList().begin();
+             it != rawev.GetEventList().end(); ++it)
             ThreshAndCal((*it), rawev);
+
+        //Calibrate the energies queued by ThreshAndCal in one batch
+        calEnergy_.resize(calRaw_.size());
+        cali.GetCalEnergies(calIndex_.data(), calRaw_.data(),
+                            calEnergy_.data(), calRaw_.size());
+        for (size_t i = 0; i < calEvents_.size(); i++)
+            calEvents_[i]->SetCalEnergy(calEnergy_[i]);
+        if (!gainTracker_.empty() && !calEvents_.empty()) {
+            for (size_t i = 0; i < calEvents_.size(); i++)
+                gainTracker_.Add(calIndex_[i], calEnergy_[i]);
+            //! The corrected gains apply from the next event on
+            gainTracker_.Advance(calEvents_[0]->GetTime(), cali);
+        }
+        if (perf_)
+            PERF_RECORD(*perf_, calibrateStage_, stageStart, calRaw_.size());
+
+        for (vector<ChanEvent*>::const_iterator it = rawev.GetEventList().begin();
+             it != rawev.GetEventList().end(); ++it) {
             PlotCal((*it));
 
-            string place = (*it)->GetChanID().GetPlaceName();
-            if (place == "__-1")
+            int place = ChannelPlace(*it);
+            if (place < 0)
                 continue;
 
             if ( (*it)->IsSaturated() || (*it)->IsPileup() )
@@ -331,27 +481,32 @@ void DetectorDriver::ProcessEvent(RawEvent& rawev) {
             int location = (*it)->GetChanID().GetLocation();
 
             EventData data(time, energy, location);
-            TreeCorrelator::get()->place(place)->activate(data);
+            TreeCorrelator::get()->place((size_t)place)->activate(data);
         }
+        rawev.FillSummaries();
 
         //!First round is preprocessing, where process result must be guaranteed
         //!to not to be dependent on results of other Processors.
-        for (vector<EventProcessor*>::iterator iProc = vecProcess.begin();
-        iProc != vecProcess.end(); iProc++)
-            if ( (*iProc)->HasEvent() )
-                (*iProc)->PreProcess(rawev);
         ///In the second round the Process is called, which may depend on other
-        ///Processors.
-        for (vector<EventProcessor *>::iterator iProc = vecProcess.begin();
-        iProc != vecProcess.end(); iProc++)
-            if ( (*iProc)->HasEvent() )
-                (*iProc)->Process(rawev);
+        ///Processors. Processors which do not depend on each other may run
+        ///concurrently in both rounds.
+        PERF_RESTART(stageStart);
+        procGraph_.Run(rawev);
+        if (perf_)
+            PERF_RECORD(*perf_, processStage_, stageStart, 1);
+
+        //! Add the fills which the threads buffered during the event
+        PERF_RESTART(stageStart);
+        Plots::MergeFills();
+        if (perf_)
+            PERF_RECORD(*perf_, fillStage_, stageStart, 1);
+        if (skimPlace_ >= 0 &&
+            TreeCorrelator::get()->place((size_t)skimPlace_)->status())
+            rawev.Keep();
+
         // Clear all places in correlator (if of resetable type)
-	for (map<string, Place*>::iterator it = 
-		 TreeCorrelator::get()->places_.begin(); 
-	     it != TreeCorrelator::get()->places_.end(); ++it)
-	    if ((*it).second->resetable())
-                (*it).second->reset();
+        TreeCorrelator::get()->resetPlaces();
+        profiler_.RecordEvent(eventStart);
     } catch (GeneralException &e) {
         /// Any exception in activation of basic places, PreProcess and Process
         /// will be intercepted here
@@ -416,6 +571,37 @@ void DetectorDriver::DeclarePlots() {
             }
         }
 
+        gainTracker_.Init(*DetectorLibrary::get(), histo);
+
+        //! The per channel spectra are filled through handles, to skip
+        //! looking up their ids for every channel
+        DetectorLibrary::size_type numChan = DetectorLibrary::get()->size();
+        rawEnergyPlots_.resize(numChan);
+        calEnergyPlots_.resize(numChan);
+        for (DetectorLibrary::size_type i = 0; i < numChan; i++) {
+            rawEnergyPlots_[i] = histo.GetHandle(D_RAW_ENERGY + i);
+            calEnergyPlots_[i] = histo.GetHandle(D_CAL_ENERGY + i);
+        }
+
+        //! The spectra filled for every hit are counted in memory and
+        //! committed once per spill
+        spillFills_.Clear();
+        hitSpectrumSlot_ = spillFills_.AddDense(
+            histo.GetHandle(D_HIT_SPECTRUM), S7);
+        hasTraceSlot_ = spillFills_.AddDense(histo.GetHandle(D_HAS_TRACE),
+                                             S8);
+        runTimeSecSlot_ = spillFills_.AddRuns(histo.GetHandle(DD_RUNTIME_SEC));
+        runTimeMsecSlot_ = spillFills_.AddRuns(
+            histo.GetHandle(DD_RUNTIME_MSEC));
+        filterEnergySlots_.resize(numChan);
+        scalarSlots_.resize(numChan);
+        for (DetectorLibrary::size_type i = 0; i < numChan; i++) {
+            filterEnergySlots_[i] = spillFills_.AddRuns(
+                histo.GetHandle(D_FILTER_ENERGY + i));
+            scalarSlots_[i] = spillFills_.AddRuns(
+                histo.GetHandle(D_SCALAR + i));
+        }
+
         for (vector<TraceAnalyzer *>::const_iterator it = vecAnalyzer.begin();
              it != vecAnalyzer.end(); it++) {
             (*it)->DeclarePlots();
@@ -432,67 +618,204 @@ void DetectorDriver::DeclarePlots() {
     }
 }
 
+namespace {
+    /** \return true if the first hit is of a type and subtype before the
+     * second, to sort the hits of an event by detector */
+    bool HitTypeLess(const TraceAnalyzer::Hit &a, const TraceAnalyzer::Hit &b) {
+        if (*a.type != *b.type)
+            return(*a.type < *b.type);
+        return(*a.subtype < *b.subtype);
+    }
+
+    /** \return true if the trace field names match, a name ending in '*'
+     * matching all of the names which start with it */
+    bool FieldMatches(const string &a, const string &b) {
+        if (!a.empty() && a[a.size() - 1] == '*')
+            return(b.compare(0, a.size() - 1, a, 0, a.size() - 1) == 0);
+        if (!b.empty() && b[b.size() - 1] == '*')
+            return(a.compare(0, b.size() - 1, b, 0, b.size() - 1) == 0);
+        return(a == b);
+    }
+
+    /** \return true if one of the fields is in the needed ones */
+    bool FieldsNeeded(const set<string> &fields, const set<string> &needed) {
+        for (set<string>::const_iterator it = fields.begin();
+             it != fields.end(); it++)
+            for (set<string>::const_iterator jt = needed.begin();
+                 jt != needed.end(); jt++)
+                if (FieldMatches(*it, *jt))
+                    return(true);
+        return(false);
+    }
+}
+
+void DetectorDriver::BuildAnalysisPlan(void) {
+    //! The fields that ThreshAndCal uses for the energy of every channel
+    static const char *driverFields[] = {"calcEnergy", "filterEnergy*",
+                                         "numPulses"};
+
+    analysisPlan_.clear();
+    runsOnAll_.assign(vecAnalyzer.size(), true);
+    const set<string> &types = DetectorLibrary::get()->GetUsedDetectors();
+    for (set<string>::const_iterator type = types.begin();
+         type != types.end(); type++) {
+        set<string> needed(driverFields, driverFields + 3);
+        bool all = false;
+        for (vector<EventProcessor *>::const_iterator it = vecProcess.begin();
+             it != vecProcess.end(); it++) {
+            bool reads = (*it)->GetTypes().count(*type) != 0;
+            if (!(*it)->HasDeclaredTraceFields()) {
+                all = all || reads;
+                continue;
+            }
+            if (reads || (*it)->GetTraceTypes().count(*type) != 0)
+                needed.insert((*it)->GetTraceFields().begin(),
+                              (*it)->GetTraceFields().end());
+        }
+
+        //! Walk back from the last analyzer, since each may read the fields
+        //! written by those before it
+        vector<bool> &plan = analysisPlan_[*type];
+        plan.assign(vecAnalyzer.size(), true);
+        for (size_t i = vecAnalyzer.size(); !all && i-- > 0;) {
+            const TraceAnalyzer *analyzer = vecAnalyzer[i];
+            if (!analyzer->HasDeclaredFields()) {
+                all = true;
+                break;
+            }
+            plan[i] = FieldsNeeded(analyzer->GetProducedFields(), needed);
+            if (plan[i])
+                needed.insert(analyzer->GetConsumedFields().begin(),
+                              analyzer->GetConsumedFields().end());
+        }
+
+        stringstream ss;
+        for (size_t i = 0; i < plan.size(); i++) {
+            runsOnAll_[i] = runsOnAll_[i] && plan[i];
+            if (!plan[i])
+                ss << " " << vecAnalyzer[i]->GetName();
+        }
+        if (!ss.str().empty()) {
+            Messenger m;
+            m.detail("Skipping the trace analysis of " + *type + " by" +
+                     ss.str() + ", nothing reads its results");
+        }
+    }
+}
+
+void DetectorDriver::AnalyzeTraces(RawEvent& rawev) {
+    static const unsigned int ignoreId = Identifier::NameId("ignore");
+
+    traceHits_.clear();
+    traceEvents_.clear();
+    for (vector<ChanEvent*>::const_iterator it = rawev.GetEventList().begin();
+         it != rawev.GetEventList().end(); ++it) {
+        const Identifier &chanId = (*it)->GetChanID();
+        if (chanId.GetTypeId() == ignoreId || chanId.GetTypeId() == 0)
+            continue;
+        Trace &trace = (*it)->GetTrace();
+        if (trace.empty())
+            continue;
+        //! Traces found in the cache are not analyzed again
+        if (analysisCache_ && analysisCache_->IsReading() &&
+            analysisCache_->Load(**it, trace))
+            continue;
+        TraceAnalyzer::Hit hit = {&trace, &chanId.GetType(),
+                                  &chanId.GetSubtype(), &chanId.GetTagMap(),
+                                  (*it)->GetID()};
+        traceHits_.push_back(hit);
+        traceEvents_.push_back(*it);
+    }
+    if (traceHits_.empty())
+        return;
+    stable_sort(traceHits_.begin(), traceHits_.end(), HitTypeLess);
+
+    for (size_t i = 0; i < vecAnalyzer.size(); i++) {
+        Profiler::clock::time_point start = Profiler::clock::now();
+        if (runsOnAll_[i]) {
+            vecAnalyzer[i]->Analyze(traceHits_);
+        } else {
+            //! The hits are sorted by type, so look up the plan once per type
+            planHits_.clear();
+            const string *type = NULL;
+            bool runs = true;
+            for (vector<TraceAnalyzer::Hit>::const_iterator it =
+                     traceHits_.begin(); it != traceHits_.end(); it++) {
+                if (type == NULL || *it->type != *type) {
+                    type = it->type;
+                    map<string, vector<bool> >::const_iterator plan =
+                        analysisPlan_.find(*type);
+                    runs = plan == analysisPlan_.end() || plan->second[i];
+                }
+                if (runs)
+                    planHits_.push_back(*it);
+            }
+            if (!planHits_.empty())
+                vecAnalyzer[i]->Analyze(planHits_);
+        }
+        profiler_.Record(analyzerTimers_[i], start);
+    }
+
+    if (analysisCache_ && analysisCache_->IsWriting())
+        for (vector<ChanEvent*>::const_iterator it = traceEvents_.begin();
+             it != traceEvents_.end(); ++it)
+            analysisCache_->Store(**it);
+}
+
 int DetectorDriver::ThreshAndCal(ChanEvent *chan, RawEvent& rawev) {
-    Identifier chanId = chan->GetChanID();
-    int id            = chan->GetID();
-    string type       = chanId.GetType();
-    string subtype    = chanId.GetSubtype();
-    map<string, int> tags = chanId.GetTagMap();
-    bool hasStartTag  = chanId.HasTag("start");
-    Trace &trace      = chan->GetTrace();
+    const Identifier &chanId = chan->GetChanID();
+    int id                   = chan->GetID();
+    Trace &trace             = chan->GetTrace();
 
     RandomPool* randoms = RandomPool::get();
 
     double energy = 0.0;
     
-    if (type == "ignore" || type == "")
+    static const unsigned int ignoreId = Identifier::NameId("ignore");
+    if (chanId.GetTypeId() == ignoreId || chanId.GetTypeId() == 0)
         return(0);
 
     if ( !trace.empty() ) {
-        plot(D_HAS_TRACE, id);
-
-        for (vector<TraceAnalyzer *>::iterator it = vecAnalyzer.begin();
-            it != vecAnalyzer.end(); it++) {
-            (*it)->Analyze(trace, type, subtype, tags);
-        }
+        spillFills_.Count(hasTraceSlot_, id);
 
-        if (trace.HasValue("filterEnergy") ) {
-            if (trace.GetValue("filterEnergy") > 0) {
-                energy = trace.GetValue("filterEnergy");
-                plot(D_FILTER_ENERGY + id, energy);
-                trace.SetValue("filterEnergyCal",
-                    cali.GetCalEnergy(chanId, trace.GetValue("filterEnergy")));
+        if (trace.HasValue(Trace::FILTER_ENERGY) ) {
+            if (trace.GetValue(Trace::FILTER_ENERGY) > 0) {
+                energy = trace.GetValue(Trace::FILTER_ENERGY);
+                if (id >= 0 && (size_t)id < filterEnergySlots_.size())
+                    spillFills_.Count(filterEnergySlots_[id], int(energy));
+                trace.SetValue(Trace::FILTER_ENERGY_CAL,
+                    cali.GetCalEnergy(id, trace.GetValue(Trace::FILTER_ENERGY)));
             } else {
                 energy = 0.0;
             }
 
             /** Calibrate pulses numbered 2 and forth,
              * add filterEnergyXCal to the trace */
-            int pulses = trace.GetValue("numPulses");
+            int pulses = trace.GetValue(Trace::NUM_PULSES);
             for (int i = 1; i < pulses; ++i) {
                 stringstream energyName;
                 energyName << "filterEnergy" << i + 1;
                 stringstream energyCalName;
                 energyCalName << "filterEnergy" << i + 1 << "Cal";
                 trace.SetValue(energyCalName.str(),
-                    cali.GetCalEnergy(chanId,
+                    cali.GetCalEnergy(id,
                                       trace.GetValue(energyName.str())));
             }
         }
 
-        if (trace.HasValue("calcEnergy") ) {
-            energy = trace.GetValue("calcEnergy");
+        if (trace.HasValue(Trace::CALC_ENERGY) ) {
+            energy = trace.GetValue(Trace::CALC_ENERGY);
             chan->SetEnergy(energy);
-        } else if (!trace.HasValue("filterEnergy")) {
+        } else if (!trace.HasValue(Trace::FILTER_ENERGY)) {
             energy = chan->GetEnergy() + randoms->Get();
         }
 
-        if (trace.HasValue("phase") ) {
+        if (trace.HasValue(Trace::PHASE) ) {
 	    //Saves the time in nanoseconds
-            chan->SetHighResTime((trace.GetValue("phase") *
-                                 Globals::get()->adcClockInSeconds() +
+            chan->SetHighResTime((trace.GetValue(Trace::PHASE) *
+                                  run_.adcClockInSeconds +
                                   (double)chan->GetTrigTime() *
-                                  Globals::get()->filterClockInSeconds()) * 1e9);
+                                  run_.filterClockInSeconds) * 1e9);
         }
     } else {
         /// otherwise, use the Pixie on-board calculated energy
@@ -506,41 +829,65 @@ int DetectorDriver::ThreshAndCal(ChanEvent *chan, RawEvent& rawev) {
     double time, walk_correction;
     if(chan->GetHighResTime() == 0.0) {
 	time = chan->GetTime(); //time is in clock ticks
-	walk_correction = walk.GetCorrection(chanId, energy);
+	walk_correction = walk.GetCorrection(id, energy);
     } else {
 	time = chan->GetHighResTime(); //time here is in ns
-	walk_correction = walk.GetCorrection(chanId, trace.GetValue("tqdc"));
+	walk_correction = walk.GetCorrection(id, trace.GetValue(Trace::TQDC));
     }
 
-    chan->SetCalEnergy(cali.GetCalEnergy(chanId, energy));
+    calEvents_.push_back(chan);
+    calIndex_.push_back(id);
+    calRaw_.push_back(energy);
     chan->SetCorrectedTime(time - walk_correction);
 
-    rawev.GetSummary(type)->AddEvent(chan);
-    DetectorSummary *summary;
+    return(1);
+}
 
-    summary = rawev.GetSummary(type + ':' + subtype, false);
-    if (summary != NULL)
-        summary->AddEvent(chan);
+/// The run time spectra hold the counts in each (milli)second, with the
+/// seconds wrapped onto rows of SE bins.
+void DetectorDriver::PlotRawStats(int id, double runTimeSecs) {
+    static const int specNoBins = SE;
 
-    if(hasStartTag && type != "logic") {
-        summary =
-            rawev.GetSummary(type + ':' + subtype + ':' + "start", false);
-        if (summary != NULL)
-            summary->AddEvent(chan);
-    }
-    return(1);
+    int rowNumSecs = int(runTimeSecs / specNoBins);
+    double remainNumSecs = runTimeSecs - rowNumSecs * specNoBins;
+
+    double runTimeMsecs = runTimeSecs * 1000;
+    int rowNumMsecs = int(runTimeMsecs / specNoBins);
+    double remainNumMsecs = runTimeMsecs - rowNumMsecs * specNoBins;
+
+    spillFills_.Count(hitSpectrumSlot_, id);
+    spillFills_.Count(runTimeSecSlot_, int(remainNumSecs), rowNumSecs);
+    spillFills_.Count(runTimeMsecSlot_, int(remainNumMsecs), rowNumMsecs);
+    if (id >= 0 && (size_t)id < scalarSlots_.size())
+        spillFills_.Count(scalarSlots_[id], int(runTimeSecs));
 }
 
 int DetectorDriver::PlotRaw(const ChanEvent *chan) {
-    plot(D_RAW_ENERGY + chan->GetID(), chan->GetEnergy());
+    plot(rawEnergyPlots_, chan->GetID(), chan->GetEnergy());
     return(0);
 }
 
 int DetectorDriver::PlotCal(const ChanEvent *chan) {
-    plot(D_CAL_ENERGY + chan->GetID(), chan->GetCalEnergy());
+    plot(calEnergyPlots_, chan->GetID(), chan->GetCalEnergy());
     return(0);
 }
 
+int DetectorDriver::ChannelPlace(const ChanEvent *chan) {
+    int id = chan->GetID();
+    if (id < 0)
+        return(-1);
+    if ((size_t)id >= channelPlaces_.size())
+        channelPlaces_.resize(id + 1, -2);
+    if (channelPlaces_[id] == -2) {
+        string place = chan->GetChanID().GetPlaceName();
+        if (place == "__-1")
+            channelPlaces_[id] = -1;
+        else
+            channelPlaces_[id] = TreeCorrelator::get()->index(place);
+    }
+    return(channelPlaces_[id]);
+}
+
 EventProcessor* DetectorDriver::GetProcessor(const std::string& name) const {
     for (vector<EventProcessor *>::const_iterator it = vecProcess.begin();
 	 it != vecProcess.end(); it++) {
@@ -550,142 +897,167 @@ EventProcessor* DetectorDriver::GetProcessor(const std::string& name) const {
     return(NULL);
 }
 
-void DetectorDriver::ReadCalXml() {
+/// Everything is read and the flat tables built here, in the command thread,
+/// so the scan only swaps a few vectors between two raw events. The map of
+/// the file is compared with the one the DetectorLibrary was built from: a
+/// channel moved to another detector needs a restart.
+bool DetectorDriver::ReloadCalibrations(const string &fileName) {
+    Messenger m;
     pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(cfg_.c_str());
+    pugi::xml_parse_result result = doc.load_file(fileName.c_str());
     if (!result) {
-        stringstream ss;
-        ss << "DetectorDriver: error parsing file" << cfg_;
-        ss << " : " << result.description();
-        throw GeneralException(ss.str());
+        m.warning("DetectorDriver: Could not read " + fileName + ": " +
+                  result.description());
+        return(false);
+    }
+
+    vector<MapCache::Channel> channels;
+    MapCache::ReadChannels(doc.child("Configuration").child("Map"), channels);
+    const vector<MapCache::Channel> &current = MapCache::get()->channels();
+    bool sameMap = (channels.size() == current.size());
+    for (size_t i = 0; sameMap && i < channels.size(); i++)
+        sameMap = (channels[i].module == current[i].module &&
+                   channels[i].channel == current[i].channel &&
+                   channels[i].type == current[i].type &&
+                   channels[i].subtype == current[i].subtype &&
+                   channels[i].location == current[i].location);
+    if (!sameMap) {
+        m.warning("DetectorDriver: The channel map of " + fileName +
+                  " differs from the one being scanned, restart to use it.");
+        return(false);
+    }
+
+    PendingCalibrations *cals = new PendingCalibrations();
+    try {
+        ReadCalXml(channels, cals->cali, false);
+        ReadWalkXml(channels, cals->walk, false);
+        cals->cali.BuildTable(*DetectorLibrary::get());
+        cals->walk.BuildTable(*DetectorLibrary::get());
+        TimingCalibrator::ReadCalibrations(doc, cals->timing);
+    } catch (GeneralException &e) {
+        m.warning("DetectorDriver: " + string(e.what()));
+        delete cals;
+        return(false);
     }
 
+    lock_guard<mutex> lock(reloadMutex_);
+    delete pendingCals_;
+    pendingCals_ = cals;
+    reloadPending_.store(true, memory_order_release);
+    return(true);
+}
+
+/// The gains of the GainTracker are kept, only the calibrations under them
+/// are replaced. The processors which laid out the timing calibrations in
+/// tables of their own are told to lay them out again.
+void DetectorDriver::ApplyReload(void) {
+    PendingCalibrations *cals;
+    {
+        lock_guard<mutex> lock(reloadMutex_);
+        cals = pendingCals_;
+        pendingCals_ = NULL;
+        reloadPending_.store(false, memory_order_relaxed);
+    }
+    if (!cals)
+        return;
+
+    for (size_t i = 0; i < DetectorLibrary::get()->size(); i++)
+        cals->cali.SetGain(i, cali.GetGain(i));
+    cali.Swap(cals->cali);
+    walk.Swap(cals->walk);
+    TimingCalibrator::get()->SetCalibrations(cals->timing);
+    delete cals;
+
+    for (vector<EventProcessor *>::iterator it = vecProcess.begin();
+         it != vecProcess.end(); it++)
+        (*it)->CalibrationsChanged();
+
     Messenger m;
-    m.start("Loading Calibration");
+    m.run_message("DetectorDriver: Swapped in the reloaded calibrations");
+}
 
-    pugi::xml_node map = doc.child("Configuration").child("Map");
+void DetectorDriver::ReadCalXml(const vector<MapCache::Channel> &channels,
+                                Calibrator &calibrator, bool verbose) {
+    Messenger m;
+    m.start("Loading Calibration");
 
-    /** Note that before this reading in of the xml file, it was already
+    /** Note that before this reading in of the map, it was already
      * processed for the purpose of creating the channels map.
      * Some sanity checks (module and channel number) were done there
      * so they are not repeated here/
      */
-    bool verbose = map.attribute("verbose_calibration").as_bool();
-    for (pugi::xml_node module = map.child("Module"); module;
-         module = module.next_sibling("Module")) {
-        int module_number = module.attribute("number").as_int(-1);
-        for (pugi::xml_node channel = module.child("Channel"); channel;
-             channel = channel.next_sibling("Channel")) {
-            int ch_number = channel.attribute("number").as_int(-1);
-            Identifier chanID = DetectorLibrary::get()->at(module_number,
-                                                           ch_number);
-            bool calibrated = false;
-            for (pugi::xml_node cal = channel.child("Calibration");
-                cal; cal = cal.next_sibling("Calibration")) {
-                string model = cal.attribute("model").as_string("None");
-                double min = cal.attribute("min").as_double(0);
-                double max =
-                  cal.attribute("max").as_double(numeric_limits<double>::max());
-
-                stringstream pars(cal.text().as_string());
-                vector<double> parameters;
-                while (true) {
-                    double p;
-                    pars >> p;
-                    if (pars)
-                        parameters.push_back(p);
-                    else
-                        break;
-                }
-                if (verbose) {
-                    stringstream ss;
-                    ss << "Module " << module_number << ", channel "
-                       << ch_number << ": ";
-                    ss << " model-" << model;
-                    for (vector<double>::iterator it = parameters.begin();
-                         it != parameters.end(); ++it)
-                        ss << " " << (*it);
-                    m.detail(ss.str(), 1);
-                }
-                cali.AddChannel(chanID, model, min, max, parameters);
-                calibrated = true;
-            }
-            if (!calibrated && verbose) {
+    for (vector<MapCache::Channel>::const_iterator channel =
+             channels.begin(); channel != channels.end(); ++channel) {
+        int module_number = channel->module;
+        int ch_number = channel->channel;
+        Identifier chanID = DetectorLibrary::get()->at(module_number,
+                                                       ch_number);
+        for (vector<MapCache::Correction>::const_iterator cal =
+                 channel->calibrations.begin();
+             cal != channel->calibrations.end(); ++cal) {
+            if (verbose) {
                 stringstream ss;
                 ss << "Module " << module_number << ", channel "
                    << ch_number << ": ";
-                ss << " non-calibrated";
+                ss << " model-" << cal->model;
+                for (vector<double>::const_iterator it =
+                         cal->parameters.begin();
+                     it != cal->parameters.end(); ++it)
+                    ss << " " << (*it);
                 m.detail(ss.str(), 1);
             }
+            calibrator.AddChannel(chanID, cal->model, cal->min, cal->max,
+                                  cal->parameters);
+        }
+        if (channel->calibrations.empty() && verbose) {
+            stringstream ss;
+            ss << "Module " << module_number << ", channel "
+               << ch_number << ": ";
+            ss << " non-calibrated";
+            m.detail(ss.str(), 1);
         }
     }
     m.done();
 }
 
-void DetectorDriver::ReadWalkXml() {
-    pugi::xml_document doc;
-
-    pugi::xml_parse_result result = doc.load_file(cfg_.c_str());
-    if (!result) {
-        stringstream ss;
-        ss << "DetectorDriver: error parsing file " << cfg_;
-        ss << " : " << result.description();
-        throw GeneralException(ss.str());
-    }
-
+void DetectorDriver::ReadWalkXml(const vector<MapCache::Channel> &channels,
+                                 WalkCorrector &corr, bool verbose) {
     Messenger m;
     m.start("Loading Walk Corrections");
 
-    pugi::xml_node map = doc.child("Configuration").child("Map");
     /** See comment in the similiar place at ReadCalXml() */
-    bool verbose = map.attribute("verbose_walk").as_bool();
-    for (pugi::xml_node module = map.child("Module"); module;
-         module = module.next_sibling("Module")) {
-        int module_number = module.attribute("number").as_int(-1);
-        for (pugi::xml_node channel = module.child("Channel"); channel;
-             channel = channel.next_sibling("Channel")) {
-            int ch_number = channel.attribute("number").as_int(-1);
-            Identifier chanID = DetectorLibrary::get()->at(module_number,
-                                                           ch_number);
-            bool corrected = false;
-            for (pugi::xml_node walkcorr = channel.child("WalkCorrection");
-                walkcorr; walkcorr = walkcorr.next_sibling("WalkCorrection")) {
-                string model = walkcorr.attribute("model").as_string("None");
-                double min = walkcorr.attribute("min").as_double(0);
-                double max =
-                  walkcorr.attribute("max").as_double(
-                                              numeric_limits<double>::max());
-
-                stringstream pars(walkcorr.text().as_string());
-                vector<double> parameters;
-                while (true) {
-                    double p;
-                    pars >> p;
-                    if (pars)
-                        parameters.push_back(p);
-                    else
-                        break;
-                }
-                if (verbose) {
-                    stringstream ss;
-                    ss << "Module " << module_number
-                       << ", channel " << ch_number << ": ";
-                    ss << " model: " << model;
-                    for (vector<double>::iterator it = parameters.begin();
-                         it != parameters.end(); ++it)
-                        ss << " " << (*it);
-                    m.detail(ss.str(), 1);
-                }
-                walk.AddChannel(chanID, model, min, max, parameters);
-                corrected = true;
-            }
-            if (!corrected && verbose) {
+    for (vector<MapCache::Channel>::const_iterator channel =
+             channels.begin(); channel != channels.end(); ++channel) {
+        int module_number = channel->module;
+        int ch_number = channel->channel;
+        Identifier chanID = DetectorLibrary::get()->at(module_number,
+                                                       ch_number);
+        for (vector<MapCache::Correction>::const_iterator walkcorr =
+                 channel->walks.begin();
+             walkcorr != channel->walks.end(); ++walkcorr) {
+            if (verbose) {
                 stringstream ss;
-                ss << "Module " << module_number << ", channel "
-                << ch_number << ": ";
-                ss << " not corrected for walk";
+                ss << "Module " << module_number
+                   << ", channel " << ch_number << ": ";
+                ss << " model: " << walkcorr->model;
+                for (vector<double>::const_iterator it =
+                         walkcorr->parameters.begin();
+                     it != walkcorr->parameters.end(); ++it)
+                    ss << " " << (*it);
+                if (walkcorr->points != 0)
+                    ss << " tabulated at " << walkcorr->points << " points";
                 m.detail(ss.str(), 1);
             }
+            corr.AddChannel(chanID, walkcorr->model, walkcorr->min,
+                            walkcorr->max, walkcorr->parameters,
+                            walkcorr->points);
+        }
+        if (channel->walks.empty() && verbose) {
+            stringstream ss;
+            ss << "Module " << module_number << ", channel "
+            << ch_number << ": ";
+            ss << " not corrected for walk";
+            m.detail(ss.str(), 1);
         }
     }
     m.done();
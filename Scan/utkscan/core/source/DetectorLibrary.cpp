@@ -14,12 +14,14 @@
 
 #include "DetectorLibrary.hpp"
 #include "Globals.hpp"
+#include "MapCache.hpp"
 #include "Messenger.hpp"
 #include "TreeCorrelator.hpp"
 
 using namespace std;
 
 set<int> DetectorLibrary::emptyLocations;
+LocationSet DetectorLibrary::emptyLocationSet;
 
 DetectorLibrary* DetectorLibrary::instance = NULL;
 
@@ -45,100 +47,81 @@ DetectorLibrary::DetectorLibrary() : vector<Identifier>(), locations(),
 }
 
 void DetectorLibrary::LoadXml() {
-    string cfg = Globals::get()->configfile();
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(cfg.c_str());
-    if (!result) {
-        stringstream ss;
-        ss << "DetectorLibrary: error parsing file " << cfg;
-        ss << " : " << result.description();
-        cout << ss.str() << endl;
-    }
+    const pugi::xml_document &doc = Globals::get()->configdoc();
+    const MapCache *cache = MapCache::get();
 
     Messenger m;
     m.start("Loading channels map");
 
-    /** These attributes have reserved meaning, all other
-     * attributes of [Channel] are treated as tags */
-    set<string> reserved;
-    reserved.insert("number");
-    reserved.insert("type");
-    reserved.insert("subtype");
-    reserved.insert("location");
-    reserved.insert("tags");
-
-    pugi::xml_node map = doc.child("Configuration").child("Map");
-    bool verbose = map.attribute("verbose_map").as_bool();
+    bool verbose = cache->verboseMap();
     pugi::xml_node tree = doc.child("Configuration").child("TreeCorrelator");
     bool verbose_tree = tree.attribute("verbose").as_bool(false);
-    for (pugi::xml_node module = map.child("Module"); module;
-         module = module.next_sibling("Module")) {
-        int module_number = module.attribute("number").as_int(-1);
+    for (vector<MapCache::Channel>::const_iterator channel =
+             cache->channels().begin();
+         channel != cache->channels().end(); ++channel) {
+        int module_number = channel->module;
         if (module_number < 0) {
             stringstream ss;
             ss << "DetectorLibrary: Illegal module number "
                 << "found " << module_number << " in configuration file.";
             throw GeneralException(ss.str());
         }
-        for (pugi::xml_node channel = module.child("Channel"); channel;
-             channel = channel.next_sibling("Channel")) {
-            int ch_number = channel.attribute("number").as_int(-1);
-            if (ch_number < 0 || ch_number >= (int)pixie::numberOfChannels ) {
-                stringstream ss;
-                ss << "DetectorLibrary : Identifier : Illegal channel number "
-                   << "found " << ch_number << " in configuration file.";
-                throw GeneralException(ss.str());
-            }
-            if ( HasValue(module_number, ch_number) ) {
-                stringstream ss;
-                ss << "DetectorLibrary: Identifier for module " << module_number
-                   << ", channel " << ch_number
-                   << " is initialized more than once";
-                throw GeneralException(ss.str());
-            }
-            Identifier id;
-
-            string ch_type = channel.attribute("type").as_string("None");
-            id.SetType(ch_type);
-
-            string ch_subtype = channel.attribute("subtype").as_string("None");
-            id.SetSubtype(ch_subtype);
-
-            int ch_location = channel.attribute("location").as_int(-1);
-            if (ch_location == -1) {
-                ch_location = GetNextLocation(ch_type, ch_subtype);
-            }
-            id.SetLocation(ch_location);
-
-            string ch_tags = channel.attribute("tags").as_string("None");
-            if(ch_tags != "None"){
-                vector<string> tagList = strings::tokenize(ch_tags, ",");
-                for(unsigned int i = 0; i < tagList.size(); i++)
-                    id.AddTag(tagList[i], 1);
-            }
-
-            Set(module_number, ch_number, id);
-
-            /** Create basic place for TreeCorrelator */
-            std::map <string, string> params;
-            params["name"] = id.GetPlaceName();
-            params["parent"] = "root";
-            params["type"] = "PlaceDetector";
-            params["reset"] = "true";
-            params["fifo"] = "2";
-            params["init"] = "false";
-            TreeCorrelator::get()->createPlace(params, verbose_tree);
-
-            if (verbose) {
-                stringstream ss;
-                ss << "Module " << module_number
-                   << ", channel " << ch_number  << ", type "
-                   << ch_type << " "
-                   << ch_subtype << ", location "
-                   << ch_location;
-                Messenger m;
-                m.detail(ss.str(), 1);
-            }
+        int ch_number = channel->channel;
+        if (ch_number < 0 || ch_number >= (int)pixie::numberOfChannels ) {
+            stringstream ss;
+            ss << "DetectorLibrary : Identifier : Illegal channel number "
+               << "found " << ch_number << " in configuration file.";
+            throw GeneralException(ss.str());
+        }
+        if ( HasValue(module_number, ch_number) ) {
+            stringstream ss;
+            ss << "DetectorLibrary: Identifier for module " << module_number
+               << ", channel " << ch_number
+               << " is initialized more than once";
+            throw GeneralException(ss.str());
+        }
+        Identifier id;
+
+        const string &ch_type = channel->type;
+        id.SetType(ch_type);
+
+        const string &ch_subtype = channel->subtype;
+        id.SetSubtype(ch_subtype);
+
+        int ch_location = channel->location;
+        if (ch_location == -1) {
+            ch_location = GetNextLocation(ch_type, ch_subtype);
+        }
+        id.SetLocation(ch_location);
+        id.SetThreshold(channel->threshold);
+
+        if(channel->tags != "None"){
+            vector<string> tagList = strings::tokenize(channel->tags, ",");
+            for(unsigned int i = 0; i < tagList.size(); i++)
+                id.AddTag(tagList[i], 1);
+        }
+
+        Set(module_number, ch_number, id);
+
+        /** Create basic place for TreeCorrelator */
+        std::map <string, string> params;
+        params["name"] = id.GetPlaceName();
+        params["parent"] = "root";
+        params["type"] = "PlaceDetector";
+        params["reset"] = "true";
+        params["fifo"] = "2";
+        params["init"] = "false";
+        TreeCorrelator::get()->createPlace(params, verbose_tree);
+
+        if (verbose) {
+            stringstream ss;
+            ss << "Module " << module_number
+               << ", channel " << ch_number  << ", type "
+               << ch_type << " "
+               << ch_subtype << ", location "
+               << ch_location;
+            Messenger m;
+            m.detail(ss.str(), 1);
         }
     }
     m.done();
@@ -164,12 +147,35 @@ DetectorLibrary::reference DetectorLibrary::at(DetectorLibrary::size_type mod,
 
 
 void DetectorLibrary::push_back(const Identifier &x) {
-    mapkey_t key = MakeKey(x.GetType(), x.GetSubtype());
-
-    locations[key].insert(x.GetLocation());
+    AddLocation(x);
     vector<Identifier>::push_back(x);
 }
 
+void DetectorLibrary::AddLocation(const Identifier &id) {
+    locations[MakeKey(id.GetType(), id.GetSubtype())].insert(id.GetLocation());
+
+    unsigned int type = id.GetTypeId();
+    unsigned int subtype = id.GetSubtypeId();
+    if (type >= locationSets.size())
+        locationSets.resize(type + 1);
+    if (subtype >= locationSets[type].size())
+        locationSets[type].resize(subtype + 1);
+    locationSets[type][subtype].Insert(id.GetLocation());
+}
+
+const LocationSet& DetectorLibrary::GetLocationSet(unsigned int typeId,
+                                                   unsigned int subtypeId) const {
+    if (typeId < locationSets.size() &&
+        subtypeId < locationSets[typeId].size())
+        return locationSets[typeId][subtypeId];
+    return emptyLocationSet;
+}
+
+const LocationSet& DetectorLibrary::GetLocationSet(const std::string &type,
+                                                   const std::string &subtype) const {
+    return GetLocationSet(Identifier::NameId(type), Identifier::NameId(subtype));
+}
+
 const set<int>& DetectorLibrary::GetLocations(const Identifier &id) const {
     return GetLocations(id.GetType(), id.GetSubtype());
 }
@@ -240,12 +246,13 @@ void DetectorLibrary::Set(int index, const Identifier& value) {
         }
     }
 
-    string key;
-    key = value.GetType() + ':' + value.GetSubtype();
-    locations[key].insert(value.GetLocation());
+    AddLocation(value);
 
     usedTypes.insert(value.GetType());
     usedSubtypes.insert(value.GetSubtype());
+    if (value.GetTypeId() >= usedTypeIds.size())
+        usedTypeIds.resize(value.GetTypeId() + 1, false);
+    usedTypeIds[value.GetTypeId()] = true;
 
     at(index) = value;
 }
@@ -10,46 +10,87 @@ using namespace std;
 void DetectorSummary::Zero() {
     eventList.clear();
     maxEvent = NULL;
+    if (source)
+        filled = *sourceGeneration;
 }
 
-DetectorSummary::DetectorSummary() {
+DetectorSummary::DetectorSummary() : source(NULL), sourceGeneration(NULL),
+                                     filled(0) {
     maxEvent = NULL;
+    ParseName();
 }
 
 DetectorSummary::DetectorSummary(const std::string &str,
-				 const std::vector<ChanEvent *> &fullList) : name(str) {
+				 const std::vector<ChanEvent *> &fullList) :
+    name(str), source(NULL), sourceGeneration(NULL), filled(0) {
     maxEvent = NULL;
+    ParseName();
 
     // go find all channel events with appropriate type and subtype
-    size_t colonPos = str.find_first_of(":");
-    size_t colonPos1 = str.find_last_of(":");
+    for (vector<ChanEvent *>::const_iterator it = fullList.begin();
+	 it != fullList.end(); it++) {
+        if (Matches((*it)->GetChanID()))
+            AddEvent(*it);
+    }
+}
 
-    type = str.substr(0, colonPos);
+void DetectorSummary::ParseName(void) {
+    size_t colonPos = name.find_first_of(":");
+    size_t colonPos1 = name.find_last_of(":");
+
+    type = name.substr(0, colonPos);
 
     if (colonPos == string::npos) {
 	subtype = ""; // no associated subtype
+	tag = "";
     } else {
 	if(colonPos != colonPos1) {
-	    subtype = str.substr(colonPos+1, colonPos1-colonPos-1);
-	    tag = str.substr(colonPos1+1);
+	    subtype = name.substr(colonPos+1, colonPos1-colonPos-1);
+	    tag = name.substr(colonPos1+1);
 	} else {
-	    subtype = str.substr(colonPos+1);
+	    subtype = name.substr(colonPos+1);
 	    tag = "";
 	}
     }
 
-    for (vector<ChanEvent *>::const_iterator it = fullList.begin();
-	 it != fullList.end(); it++) {
-        const Identifier& id = (*it)->GetChanID();
+    typeId = Identifier::NameId(type);
+    subtypeId = Identifier::NameId(subtype);
+    tagId = Identifier::TagId(tag);
+}
 
-        if ( id.GetType() != type )
-            continue;
-        if ( subtype != "" && id.GetSubtype() != subtype )
-            continue;
-        if (tag != "" && !id.HasTag(tag))
+bool DetectorSummary::Matches(const Identifier &id) const {
+    if ( id.GetTypeId() != typeId )
+        return false;
+    if ( subtypeId != 0 && id.GetSubtypeId() != subtypeId )
+        return false;
+    if ( tagId != 0 && !id.HasTag(tagId) )
+        return false;
+    return true;
+}
+
+void DetectorSummary::Attach(const std::vector<ChanEvent*> *fullList,
+                             const unsigned long *generation,
+                             const std::vector<bool> &chans) {
+    source = fullList;
+    sourceGeneration = generation;
+    channels = chans;
+    Fill();
+}
+
+void DetectorSummary::Fill(void) const {
+    eventList.clear();
+    maxEvent = NULL;
+    for (vector<ChanEvent *>::const_iterator it = source->begin();
+         it != source->end(); it++) {
+        size_t idx = (*it)->GetID();
+        if (idx >= channels.size() || !channels[idx])
             continue;
-        AddEvent(*it);
+        eventList.push_back(*it);
+        if (maxEvent == NULL ||
+            (*it)->GetCalEnergy() > maxEvent->GetCalEnergy())
+            maxEvent = *it;
     }
+    filled = *sourceGeneration;
 }
 
 void DetectorSummary::AddEvent(ChanEvent *ev) {
@@ -0,0 +1,115 @@
+/** \file GainTracker.cpp
+ * \brief Tracks the gain drift of the channels on a reference line and
+ * corrects it in the calibration while scanning
+ */
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "Calibrator.hpp"
+#include "DammPlotIds.hpp"
+#include "DetectorLibrary.hpp"
+#include "GainTracker.hpp"
+#include "Globals.hpp"
+#include "Messenger.hpp"
+
+using namespace std;
+using namespace dammIds::raw;
+
+GainTracker::GainTracker() : histo_(NULL), interval_(0), length_(0),
+    start_(-1), next_(0), minCounts_(0) {
+}
+
+void GainTracker::Init(const DetectorLibrary &lib, Plots &histo) {
+    const vector<GainLine> &lines = Globals::get()->gainLines();
+    channels_.clear();
+    tracked_.assign(lib.size(), -1);
+    if (lines.empty())
+        return;
+
+    histo_ = &histo;
+    length_ = Globals::get()->gainInterval();
+    minCounts_ = Globals::get()->gainMinCounts();
+    for (size_t i = 0; i < lib.size(); i++) {
+        if (!lib.HasValue(i))
+            continue;
+        const Identifier &id = lib.at(i);
+        vector<GainLine>::const_iterator line = lines.begin();
+        for (; line != lines.end(); ++line)
+            if (id.GetType() == line->type &&
+                (line->subtype.empty() || id.GetSubtype() == line->subtype))
+                break;
+        if (line == lines.end())
+            continue;
+
+        stringstream title;
+        title << "Gain drift M" << lib.ModuleFromIndex(i)
+              << " C" << lib.ChannelFromIndex(i) << " - " << id.GetType()
+              << ":" << id.GetSubtype() << " L" << id.GetLocation();
+        histo.DeclareHistogram2D(DD_GAIN_DRIFT + i, SA, driftBins,
+                                 title.str().c_str());
+
+        Channel chan;
+        chan.index = i;
+        chan.line = line->energy;
+        chan.window = line->window;
+        chan.sum = 0;
+        chan.count = 0;
+        chan.gain = 1;
+        chan.updates = 0;
+        chan.drift = histo.GetHandle(DD_GAIN_DRIFT + i);
+        tracked_[i] = channels_.size();
+        channels_.push_back(chan);
+    }
+
+    histo.DeclareHistogram2D(DD_GAIN_HISTORY, SA, S8,
+                             "Gain x 10000 of the tracked channels vs time");
+    history_ = histo.GetHandle(DD_GAIN_HISTORY);
+
+    stringstream ss;
+    ss << "Tracking the gain of " << channels_.size() << " channels";
+    Messenger m;
+    m.detail(ss.str());
+}
+
+void GainTracker::Update(double time, Calibrator &cali) {
+    if (channels_.empty()) {
+        next_ = HUGE_VAL;
+        return;
+    }
+    if (start_ < 0) {
+        start_ = time;
+        next_ = start_ + length_;
+        return;
+    }
+
+    for (vector<Channel>::iterator it = channels_.begin();
+         it != channels_.end(); ++it) {
+        if (it->count >= minCounts_) {
+            it->gain *= it->line / (it->line + it->sum / it->count);
+            cali.SetGain(it->index, it->gain);
+            it->updates++;
+            it->sum = 0;
+            it->count = 0;
+        }
+        histo_->Plot(history_, interval_, it - channels_.begin(),
+                     it->gain * 1e4);
+    }
+
+    //! Intervals without any event are skipped
+    interval_ = floor((time - start_) / length_);
+    next_ = start_ + (interval_ + 1) * length_;
+}
+
+void GainTracker::Print(ostream &out) const {
+    if (channels_.empty())
+        return;
+    out << "Gain tracking" << endl;
+    out << "  mod chan     gain  corrections" << endl;
+    for (vector<Channel>::const_iterator it = channels_.begin();
+         it != channels_.end(); ++it)
+        out << "  " << setw(3) << it->index / pixie::numberOfChannels
+            << " " << setw(4) << it->index % pixie::numberOfChannels
+            << " " << fixed << setprecision(5) << setw(8) << it->gain
+            << " " << setw(12) << it->updates << endl;
+}
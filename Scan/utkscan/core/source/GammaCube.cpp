@@ -0,0 +1,197 @@
+/** \file GammaCube.cpp
+ * \brief A sparse, symmetric gamma-gamma-gamma coincidence cube
+ */
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+#include <string.h>
+
+#include "GammaCube.hpp"
+
+using namespace std;
+
+namespace {
+    const char cubeMagic[4] = {'G', 'C', 'U', 'B'}; //!< start of a cube file
+    const uint32_t cubeVersion = 1; //!< version of the cube file
+    const size_t minSlots = 1 << 16; //!< the number of slots of an empty cube
+
+    /** \return the hash of a key, the last step of splitmix64 */
+    inline uint64_t Mix(uint64_t key) {
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+
+    /** Sort three bins in place */
+    inline void Sort3(unsigned int &x, unsigned int &y, unsigned int &z) {
+        if (x > y) swap(x, y);
+        if (y > z) swap(y, z);
+        if (x > y) swap(x, y);
+    }
+
+    /** Write a value as a variable length integer, 7 bits per byte */
+    void WriteVar(ofstream &out, uint64_t value) {
+        unsigned char bytes[10];
+        int n = 0;
+        do {
+            bytes[n] = value & 0x7f;
+            value >>= 7;
+            if (value)
+                bytes[n] |= 0x80;
+            n++;
+        } while (value);
+        out.write((const char*)bytes, n);
+    }
+
+    /** Read a variable length integer written by WriteVar
+     * \return false at the end of the file */
+    bool ReadVar(ifstream &in, uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if (byte == EOF)
+                return false;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+GammaCube::GammaCube(unsigned int size, double binWidth) :
+    size_(min(size, maxSize)), binWidth_(binWidth), used_(0), total_(0) {
+    Clear();
+}
+
+void GammaCube::Add(unsigned int x, unsigned int y, unsigned int z,
+                    uint32_t weight) {
+    if (x >= size_ || y >= size_ || z >= size_)
+        return;
+    Sort3(x, y, z);
+    uint64_t key = Pack(x, y, z);
+    size_t slot = Find(key);
+    if (keys_[slot] == 0) {
+        //! Keep the hash at most 70% full, so probes stay short
+        if ((used_ + 1) * 10 > keys_.size() * 7) {
+            Grow();
+            slot = Find(key);
+        }
+        keys_[slot] = key;
+        used_++;
+    }
+    uint32_t room = numeric_limits<uint32_t>::max() - counts_[slot];
+    counts_[slot] += min(weight, room);
+    total_ += weight;
+}
+
+uint32_t GammaCube::Get(unsigned int x, unsigned int y, unsigned int z) const {
+    if (x >= size_ || y >= size_ || z >= size_)
+        return 0;
+    Sort3(x, y, z);
+    return counts_[Find(Pack(x, y, z))];
+}
+
+void GammaCube::Clear() {
+    keys_.assign(minSlots, 0);
+    counts_.assign(minSlots, 0);
+    used_ = 0;
+    total_ = 0;
+}
+
+size_t GammaCube::Find(uint64_t key) const {
+    size_t mask = keys_.size() - 1;
+    size_t slot = Mix(key) & mask;
+    while (keys_[slot] != 0 && keys_[slot] != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+void GammaCube::Grow() {
+    vector<uint64_t> keys(keys_.size() * 2, 0);
+    vector<uint32_t> counts(counts_.size() * 2, 0);
+    keys.swap(keys_);
+    counts.swap(counts_);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == 0)
+            continue;
+        size_t slot = Find(keys[i]);
+        keys_[slot] = keys[i];
+        counts_[slot] = counts[i];
+    }
+}
+
+bool GammaCube::Write(const string &name) const {
+    ofstream out(name.c_str(), ios::binary);
+    if (!out.good())
+        return false;
+
+    uint64_t numEntries = used_;
+    out.write(cubeMagic, 4);
+    out.write((const char*)&cubeVersion, sizeof(cubeVersion));
+    out.write((const char*)&size_, sizeof(size_));
+    out.write((const char*)&binWidth_, sizeof(binWidth_));
+    out.write((const char*)&total_, sizeof(total_));
+    out.write((const char*)&numEntries, sizeof(numEntries));
+
+    //! The sorted keys are close to each other, so their differences are
+    //! mostly one or two bytes long
+    vector<size_t> order;
+    order.reserve(used_);
+    for (size_t i = 0; i < keys_.size(); i++)
+        if (keys_[i] != 0)
+            order.push_back(i);
+    sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return keys_[a] < keys_[b];
+    });
+    uint64_t last = 0;
+    for (vector<size_t>::const_iterator it = order.begin();
+         it != order.end(); ++it) {
+        WriteVar(out, keys_[*it] - last);
+        WriteVar(out, counts_[*it]);
+        last = keys_[*it];
+    }
+    return out.good();
+}
+
+bool GammaCube::Read(const string &name) {
+    ifstream in(name.c_str(), ios::binary);
+    char magic[4];
+    uint32_t version = 0, size = 0;
+    double binWidth = 0;
+    uint64_t total = 0, numEntries = 0;
+    in.read(magic, 4);
+    in.read((char*)&version, sizeof(version));
+    in.read((char*)&size, sizeof(size));
+    in.read((char*)&binWidth, sizeof(binWidth));
+    in.read((char*)&total, sizeof(total));
+    in.read((char*)&numEntries, sizeof(numEntries));
+    if (!in.good() || memcmp(magic, cubeMagic, 4) != 0 ||
+        version != cubeVersion || size == 0 || size > maxSize)
+        return false;
+
+    size_ = size;
+    binWidth_ = binWidth;
+    size_t slots = minSlots;
+    while (numEntries * 10 > slots * 7)
+        slots *= 2;
+    keys_.assign(slots, 0);
+    counts_.assign(slots, 0);
+    used_ = 0;
+
+    uint64_t key = 0, delta, count;
+    for (uint64_t i = 0; i < numEntries; i++) {
+        if (!ReadVar(in, delta) || !ReadVar(in, count) || delta == 0) {
+            Clear();
+            return false;
+        }
+        key += delta;
+        size_t slot = Find(key);
+        keys_[slot] = key;
+        counts_[slot] = count;
+        used_++;
+    }
+    total_ = total;
+    return true;
+}
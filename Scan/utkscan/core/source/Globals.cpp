@@ -2,13 +2,67 @@
  * \brief constant parameters used in pixie16 analysis
  * \author K. A. Miernik
  */
+#include <fstream>
 #include <iostream>
+#include <iterator>
 
 #include <unistd.h>
 
 #include "Exceptions.hpp"
 #include "Globals.hpp"
 
+namespace {
+    /** Convert a time to seconds
+     * \param [in] value : the time in the given units
+     * \param [in] units : one of ns, us, ms or s
+     * \return the time in seconds */
+    double InSeconds(double value, const std::string &units) {
+        if (units == "ns")
+            return value * 1e-9;
+        else if (units == "us")
+            return value * 1e-6;
+        else if (units == "ms")
+            return value * 1e-3;
+        else if (units == "s")
+            return value;
+        throw GeneralException("Globals: unknown units " + units);
+    }
+
+    /** Options of the Global node which do not change the results of the
+     * trace analyzers, so that they may be changed without invalidating
+     * the analysis cache */
+    const char *const kOutputOptions[] = {
+        "AnalysisCache", "BananaFile", "Checkpoint", "DropIgnoredHits",
+        "HasRaw", "MappedHis", "MemoryBudget", "OutputPath", "Skim", NULL
+    };
+
+    /** Serialize the parts of the configuration which the trace analyzers
+     * depend on: the analyzers themselves, the Global options except the
+     * output ones, and the Map, Trace and Fitting nodes
+     * \param [in] doc : the parsed configuration
+     * \return the serialized nodes */
+    std::string AnalyzerConfig(const pugi::xml_document &doc) {
+        std::stringstream ss;
+        pugi::xml_node config = doc.child("Configuration");
+        for (pugi::xml_node analyzer =
+                 config.child("DetectorDriver").child("Analyzer");
+             analyzer; analyzer = analyzer.next_sibling("Analyzer"))
+            analyzer.print(ss);
+        for (pugi::xml_node_iterator it = config.child("Global").begin();
+             it != config.child("Global").end(); ++it) {
+            bool output = false;
+            for (const char *const *opt = kOutputOptions; *opt && !output; opt++)
+                output = std::string(it->name()) == *opt;
+            if (!output)
+                it->print(ss);
+        }
+        config.child("Map").print(ss);
+        config.child("Trace").print(ss);
+        config.child("Fitting").print(ss);
+        return ss.str();
+    }
+}
+
 Globals *Globals::instance = NULL;
 
 Globals::Globals(const std::string &file) {
@@ -20,14 +74,41 @@ Globals::Globals(const std::string &file) {
     eventInSeconds_ = -1;
     hasReject_ = false;
     hasRaw_ = true;
+    mappedHis_ = false;
+    atomicHis_ = false;
+    dropIgnoredHits_ = false;
+    hasSkim_ = false;
+    hasAnalysisCache_ = false;
+    checkpointInterval_ = 0;
+    memoryBudget_ = 0;
+    sparseHis_ = false;
+    hisServerPort_ = 0;
+    rollingSlices_ = 10;
+    rollingSeconds_ = 30;
+    gainInterval_ = 0;
+    gainMinCounts_ = 0;
     revision_ = "None";
     numTraces_ = 16;
+    configHash_ = 0;
+    analyzerHash_ = 0;
 
     try {
-        pugi::xml_document doc;
-        pugi::xml_parse_result result = doc.load_file(configFile_.c_str());
+        /** The file is read and parsed only once, every other part of the
+         * configuration is read from this document */
+        std::ifstream input(configFile_.c_str(), std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(input)),
+                             std::istreambuf_iterator<char>());
+        configHash_ = HashConfig(contents);
+
+        pugi::xml_document &doc = configDoc_;
+        pugi::xml_parse_result result =
+            doc.load_buffer(contents.data(), contents.size());
 
         std::stringstream ss;
+        if (!input.good() && !input.eof()) {
+            ss << "Globals : error reading file " << configFile_;
+            throw GeneralException(ss.str());
+        }
         if (!result) {
             ss << "Globals : error parsing file " << configFile_;
             ss << " : " << result.description();
@@ -74,32 +155,93 @@ Globals::Globals(const std::string &file) {
                 std::string units = it->attribute("unit").as_string("None");
                 double value = it->attribute("value").as_double(-1);
 
-                if (units == "ns")
-                    value *= 1e-9;
-                else if (units == "us")
-                    value *= 1e-6;
-                else if (units == "ms")
-                    value *= 1e-3;
-                else if (units == "s")
-                    value *= 1.0;
-                else
-                    throw GeneralException("Globals: unknown units " + units);
-
-                eventInSeconds_ = value;
+                eventInSeconds_ = InSeconds(value, units);
                 eventWidth_ = (int) (eventInSeconds_ / clockInSeconds_);
                 ss << "Event width: " << eventInSeconds_ * 1e6
                    << " us" << ", i.e. " << eventWidth_
                    << " pixie16 clock tics.";
                 m.detail(ss.str());
                 ss.str("");
+            } else if (std::string(it->name()).compare("TypeWidth") == 0) {
+                TypeWidth width;
+                width.type = it->attribute("type").as_string();
+                width.subtype = it->attribute("subtype").as_string();
+                double value = InSeconds(it->attribute("value").as_double(-1),
+                                         it->attribute("unit").as_string("None"));
+                if (width.type.empty() || value <= 0)
+                    throw GeneralException("Globals: incomplete or wrong "
+                                           "TypeWidth declaration");
+                width.width = (unsigned int) (value / clockInSeconds_ + 0.5);
+                ss << "Event width of " << width.type
+                   << (width.subtype.empty() ? "" : ":" + width.subtype)
+                   << ": " << value * 1e6 << " us, i.e. " << width.width
+                   << " pixie16 clock tics.";
+                m.detail(ss.str());
+                ss.str("");
+                typeWidths_.push_back(width);
             } else if (std::string(it->name()).compare("NumOfTraces") == 0) {
                 numTraces_ = it->attribute("value").as_uint();
             } else if (std::string(it->name()).compare("HasRaw") == 0) {
                 hasRaw_ = it->attribute("value").as_bool(true);
+            } else if (std::string(it->name()).compare("MappedHis") == 0) {
+                mappedHis_ = it->attribute("value").as_bool(false);
+                atomicHis_ = it->attribute("atomic").as_bool(false);
+            } else if (std::string(it->name()).compare("Checkpoint") == 0) {
+                checkpointInterval_ = it->attribute("interval").as_uint(0);
+            } else if (std::string(it->name()).compare("MemoryBudget") == 0) {
+                std::string unit = it->attribute("unit").as_string("MB");
+                double value = it->attribute("value").as_double(0);
+                double scale;
+                if (unit == "B")
+                    scale = 1;
+                else if (unit == "kB")
+                    scale = 1024;
+                else if (unit == "MB")
+                    scale = 1024 * 1024;
+                else if (unit == "GB")
+                    scale = 1024 * 1024 * 1024;
+                else
+                    throw GeneralException("Globals: unknown MemoryBudget "
+                                           "unit " + unit);
+                memoryBudget_ = (unsigned long long) (value * scale);
+                sparseHis_ = it->attribute("sparse").as_bool(false);
+                ss << "Memory budget: " << value << " " << unit
+                   << (sparseHis_ ? ", 2-D histograms made sparse beyond it"
+                                  : "");
+                m.detail(ss.str());
+                ss.str("");
+            } else if (std::string(it->name()).compare("HisServer") == 0) {
+                hisServerPort_ = it->attribute("port").as_uint(0);
+            } else if (std::string(it->name()).compare("Rolling") == 0) {
+                rollingSlices_ = it->attribute("slices").as_uint(10);
+                rollingSeconds_ = it->attribute("seconds").as_uint(30);
+                if (rollingSlices_ == 0 || rollingSeconds_ == 0)
+                    throw GeneralException("Globals: The Rolling node needs "
+                                           "a non-zero number of slices and "
+                                           "seconds.");
+                for (pugi::xml_node his = it->child("Histogram"); his;
+                     his = his.next_sibling("Histogram"))
+                    rollingIds_.push_back(his.attribute("id").as_uint());
+                ss << "Rolling histograms over the last "
+                   << rollingSlices_ * rollingSeconds_ << " s in "
+                   << rollingSlices_ << " slices: " << rollingIds_.size();
+                m.detail(ss.str());
+                ss.str("");
             } else if (std::string(it->name()).compare("BitResolution") == 0) {
                 bitResolution_ = it->attribute("value").as_double(12);
             } else if (std::string(it->name()).compare("OutputPath") == 0) {
                 outputPath_ = it->attribute("value").as_string();
+            } else if (std::string(it->name()).compare("BananaFile") == 0) {
+                bananaFile_ = it->attribute("value").as_string();
+            } else if (std::string(it->name()).compare("DropIgnoredHits") == 0) {
+                dropIgnoredHits_ = it->attribute("value").as_bool(false);
+            } else if (std::string(it->name()).compare("Skim") == 0) {
+                hasSkim_ = true;
+                skimPlace_ = it->attribute("place").as_string();
+                skimFile_ = it->attribute("file").as_string();
+            } else if (std::string(it->name()).compare("AnalysisCache") == 0) {
+                hasAnalysisCache_ = it->attribute("value").as_bool(true);
+                analysisCacheFile_ = it->attribute("file").as_string();
             } else
                 WarnOfUnknownParameter(m, it);
         }
@@ -132,12 +274,73 @@ Globals::Globals(const std::string &file) {
             ss << "Rejection region: " << start << " to " << end << " s";
             m.detail(ss.str(), 1);
             reject_.push_back(std::make_pair(start, end));
+            rejects_.Add(start, end);
         }
 
         if (reject_.size() > 0) {
             hasReject_ = true;
         }
 
+        pugi::xml_node trigger = doc.child("Configuration").child("Trigger");
+        for (pugi::xml_node window = trigger.child("Window"); window;
+             window = window.next_sibling("Window")) {
+            TriggerWindow trig;
+            trig.type = window.attribute("type").as_string();
+            trig.subtype = window.attribute("subtype").as_string();
+            double before = window.attribute("before").as_double(0);
+            double after = window.attribute("after").as_double(0);
+
+            std::stringstream ss;
+            double scale =
+                InSeconds(1, window.attribute("unit").as_string("ns"));
+
+            if (trig.type.empty() || before < 0 || after < 0 ||
+                before + after <= 0) {
+                ss << "Globals: incomplete or wrong trigger window "
+                   << "declaration for type '" << trig.type << "'";
+                throw GeneralException(ss.str());
+            }
+            trig.before = (unsigned int) (before * scale / clockInSeconds_ + 0.5);
+            trig.after = (unsigned int) (after * scale / clockInSeconds_ + 0.5);
+
+            ss << "Trigger: " << trig.type
+               << (trig.subtype.empty() ? "" : ":" + trig.subtype)
+               << " from " << trig.before << " before to " << trig.after
+               << " after, in pixie16 clock tics";
+            m.detail(ss.str(), 1);
+            triggers_.push_back(trig);
+        }
+
+        pugi::xml_node gain = doc.child("Configuration").child("GainTracking");
+        gainInterval_ = InSeconds(gain.attribute("interval").as_double(60),
+                                  gain.attribute("unit").as_string("s")) /
+            clockInSeconds_;
+        gainMinCounts_ = gain.attribute("min_counts").as_uint(100);
+        for (pugi::xml_node line = gain.child("Line"); line;
+             line = line.next_sibling("Line")) {
+            GainLine ref;
+            ref.type = line.attribute("type").as_string();
+            ref.subtype = line.attribute("subtype").as_string();
+            ref.energy = line.attribute("energy").as_double(0);
+            ref.window = line.attribute("window").as_double(0);
+
+            std::stringstream ss;
+            if (ref.type.empty() || ref.energy <= 0 || ref.window <= 0 ||
+                ref.window >= ref.energy || gainInterval_ <= 0) {
+                ss << "Globals: incomplete or wrong gain tracking line "
+                   << "declaration for type '" << ref.type << "'";
+                throw GeneralException(ss.str());
+            }
+
+            ss << "Gain tracking: " << ref.type
+               << (ref.subtype.empty() ? "" : ":" + ref.subtype)
+               << " on the line at " << ref.energy << " +/- " << ref.window
+               << ", corrected every " << gainInterval_ * clockInSeconds_
+               << " s";
+            m.detail(ss.str(), 1);
+            gainLines_.push_back(ref);
+        }
+
         pugi::xml_node phys = doc.child("Configuration").child("Physical");
         for (pugi::xml_node_iterator it = phys.begin();
              it != phys.end(); ++it) {
@@ -190,7 +393,8 @@ Globals::Globals(const std::string &file) {
                     pugi::xml_node en = trapit->child("Energy");
                     TrapFilterParameters efilt(en.attribute("l").as_double(300),
                                                en.attribute("g").as_double(300),
-                                               en.attribute("t").as_double(50));
+                                               en.attribute("t").as_double(50),
+                                               en.attribute("recursive").as_bool(false));
                     trapFiltPars_.insert(std::make_pair(
                             trapit->attribute("name").as_string(),
                             std::make_pair(tfilt, efilt)));
@@ -226,6 +430,21 @@ Globals::Globals(const std::string &file) {
         }
 
         SanityCheck();
+
+        analyzerHash_ = HashConfig(AnalyzerConfig(doc));
+
+        constants_.clockInSeconds = clockInSeconds_;
+        constants_.adcClockInSeconds = adcClockInSeconds_;
+        constants_.filterClockInSeconds = filterClockInSeconds_;
+        constants_.eventInSeconds = eventInSeconds_;
+        constants_.neutronMass = neutronMass_;
+        constants_.speedOfLight = speedOfLight_;
+        constants_.speedOfLightSmall = speedOfLightSmall_;
+        constants_.speedOfLightMedium = speedOfLightMedium_;
+        constants_.speedOfLightBig = speedOfLightBig_;
+        constants_.smallLengthTime = smallLengthTime();
+        constants_.mediumLengthTime = mediumLengthTime();
+        constants_.bigLengthTime = bigLengthTime();
     } catch (std::exception &e) {
         std::cout << "Exception caught at Globals" << std::endl;
         std::cout << "\t" << e.what() << std::endl;
@@ -233,6 +452,17 @@ Globals::Globals(const std::string &file) {
     }
 }
 
+uint64_t Globals::HashConfig(const std::string &contents) {
+    //! 64 bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (std::string::const_iterator it = contents.begin();
+         it != contents.end(); ++it) {
+        hash ^= (unsigned char)(*it);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 void Globals::SanityCheck() {
     Messenger m;
     std::stringstream ss;
@@ -285,13 +515,6 @@ void Globals::WarnOfUnknownParameter(Messenger &m,
     m.warning(ss.str());
 }
 
-/** Instance is created upon first call */
-Globals *Globals::get() {
-    if (!instance)
-        instance = new Globals("Config.xml");
-    return (instance);
-}
-
 /** Instance is created upon first call */
 Globals *Globals::get(const std::string &file) {
     if (!instance)
@@ -10,17 +10,25 @@
  * \author C. R. Thornsberry
  * \date Feb. 12th, 2016
  */
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <vector>
 
+#include <limits.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "BananaGates.hpp"
 #include "HisFile.hpp"
+#include "HisServer.hpp"
 
 #ifndef USE_HRIBF
 /// Create a DAMM 1D histogram (implemented for backwards compatibility)
@@ -48,7 +56,7 @@ void hd2d_(int dammId, int nHalfWords, int rawXlen, int histXlen, int xMin,
 
 /// Do banana gating using ban files (implemented for backwards compatibility)
 bool bantesti_(const int &id, const double &x, const double &y){
-    return(false);
+    return(BananaGates::get()->Test(id, (int)floor(x + 0.5), (int)floor(y + 0.5)));
 }
 
 /// Increment histogram dammID at x and y (implemented for backwards compatibility)
@@ -98,6 +106,25 @@ void set_char_array(char *output, const std::string &input_, size_t arr_size_) {
     output[arr_size_] = '\0';
 }
 
+/// Add weight_ to the bin at ptr_, saturating at the largest value of T. Returns true if the bin saturated.
+template<typename T>
+static bool add_saturated(char *ptr_, unsigned int weight_, bool atomic_){
+    const unsigned long long max = (T)~0;
+    T old, sum;
+    if(atomic_){
+        old = __atomic_load_n((T*)ptr_, __ATOMIC_RELAXED);
+        do{
+            sum = (T)std::min((unsigned long long)old + weight_, max);
+        } while(!__atomic_compare_exchange_n((T*)ptr_, &old, sum, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+    else{
+        memcpy(&old, ptr_, sizeof(T));
+        sum = (T)std::min((unsigned long long)old + weight_, max);
+        memcpy(ptr_, &sum, sizeof(T));
+    }
+    return ((unsigned long long)old + weight_ > max);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // struct HisData
 ///////////////////////////////////////////////////////////////////////////////
@@ -329,22 +356,22 @@ void drr_entry::print_list(std::ofstream *file_){
 ///////////////////////////////////////////////////////////////////////////////
 
 /// Read an entry from the drr file
-drr_entry* HisFile::read_entry(){
+/// Unpack a 128 byte .drr entry
+static drr_entry *unpack_entry(const char *ptr_){
     drr_entry *output = new drr_entry();
     
-    // Read 128 bytes from the drr file
-    drr.read((char*)&output->hisDim, 2);
-    drr.read((char*)&output->halfWords, 2);
-    drr.read((char*)&output->params, 8);
-    drr.read((char*)&output->raw, 8);
-    drr.read((char*)&output->scaled, 8);
-    drr.read((char*)&output->minc, 8);
-    drr.read((char*)&output->maxc, 8);
-    drr.read((char*)&output->offset, 4);
-    drr.read(output->xlabel, 12); output->xlabel[12] = '\0';
-    drr.read(output->ylabel, 12); output->ylabel[12] = '\0';
-    drr.read((char*)&output->calcon, 16);
-    drr.read(output->title, 40); output->title[40] = '\0';
+    memcpy(&output->hisDim, ptr_, 2);
+    memcpy(&output->halfWords, ptr_ + 2, 2);
+    memcpy(output->params, ptr_ + 4, 8);
+    memcpy(output->raw, ptr_ + 12, 8);
+    memcpy(output->scaled, ptr_ + 20, 8);
+    memcpy(output->minc, ptr_ + 28, 8);
+    memcpy(output->maxc, ptr_ + 36, 8);
+    memcpy(&output->offset, ptr_ + 44, 4);
+    memcpy(output->xlabel, ptr_ + 48, 12); output->xlabel[12] = '\0';
+    memcpy(output->ylabel, ptr_ + 60, 12); output->ylabel[12] = '\0';
+    memcpy(output->calcon, ptr_ + 72, 16);
+    memcpy(output->title, ptr_ + 88, 40); output->title[40] = '\0';
     
     // Update variables not stored in the .drr file
     output->initialize();
@@ -352,6 +379,14 @@ drr_entry* HisFile::read_entry(){
     return output;
 }
 
+drr_entry* HisFile::read_entry(){
+    // Read 128 bytes from the drr file
+    char block[128];
+    drr.read(block, 128);
+    
+    return unpack_entry(block);
+}
+
 /// Delete all drr drr_entries and clear the drr_entries vector
 void HisFile::clear_drr_entries(){
     for(std::map<unsigned int, drr_entry*>::iterator iter = drrMap_.begin();
@@ -656,11 +691,16 @@ bool HisFile::LoadDrr(const char* prefix_, bool open_his_/*=true*/){
     drr.read(description, 40); description[40] = '\0';
     
     // Read in all drr drr_entries
-    for(int i = 0; i < nHis; i++){
-        drr_entry *entry = read_entry();
-        unsigned int id = entry->hisID;
-        drrMap_.insert(std::make_pair(id, entry));
-                       //drr_entries.push_back(read_entry());
+    std::vector<drr_entry*> entries;
+    for(int i = 0; i < nHis; i++)
+        entries.push_back(read_entry());
+    
+    // The histogram IDs are stored after the entries, in the same order
+    for(std::vector<drr_entry*>::iterator iter = entries.begin(); iter != entries.end(); iter++){
+        int his_id;
+        drr.read((char*)&his_id, 4);
+        (*iter)->hisID = his_id;
+        drrMap_.insert(std::make_pair((*iter)->hisID, *iter));
     }
     
     return true;
@@ -708,63 +748,542 @@ void HisFile::PrintEntry(){
 ///////////////////////////////////////////////////////////////////////////////
 
 drr_entry *OutputHisFile::find_drr_in_list(unsigned int hisId){
-    std::map<unsigned int, drr_entry*>::iterator it = drrMap_.find(hisId);
-    if(it != drrMap_.end())
-        return((*it).second);
+    if(hisId < drr_table.size() && drr_table[hisId])
+        return(drr_table[hisId]);
     failed_fills.insert(hisId);
     return(NULL);
 }
 
+bool OutputHisFile::increment_bin(drr_entry *entry_, unsigned int bin_,
+                                  unsigned int weight_){
+    if(!entry_->check_bin(bin_))
+        return(false);
+    entry_->good_counts++;
+    
+    if(has_requests.load(std::memory_order_relaxed))
+        do_requests();
+    
+    if(map_base)
+        increment_mapped(entry_, bin_, weight_);
+    else{
+        // The width of the bins on disk is only used when they are written
+        // and the blocks of counts are only allocated once they are filled
+        size_t index = count_table[entry_->hisID] + bin_;
+        unsigned int &count = own_count(index);
+        if(count > UINT_MAX - weight_){
+            count = UINT_MAX;
+            saturated.insert(entry_->hisID);
+        }
+        else
+            count += weight_;
+        mark_dirty(index, index + 1);
+    }
+    
+    if(!rolling.empty() && entry_->hisID < rolling_table.size() && rolling_table[entry_->hisID] >= 0){
+        rolling_his &his = rolling[rolling_table[entry_->hisID]];
+        his.slices[his.current][bin_] += weight_;
+        his.sum_valid = his.served = false;
+    }
+    
+    if(++Flush_count >= Flush_wait)
+        Flush();
+    else if(Flush_count % 4096 == 0){ // Only look at the clock every few thousand fills
+        if(!rolling.empty())
+            advance_rolling(time(NULL));
+        if(use_checkpoints && time(NULL) >= next_checkpoint)
+            Checkpoint();
+    }
+    return(true);
+}
+
+unsigned int *OutputHisFile::own_block(size_t block_){
+    count_block &block = count_blocks[block_];
+    if(!block){
+        block = count_block(new unsigned int[block_size], std::default_delete<unsigned int[]>());
+        std::fill(block.get(), block.get() + block_size, 0);
+        // A sparse block which grew too full, a snapshot keeps the sparse one
+        if(block_ < sparse_blocks.size() && sparse_blocks[block_]){
+            const sparse_counts &sparse = *sparse_blocks[block_];
+            for(sparse_counts::const_iterator iter = sparse.begin(); iter != sparse.end(); iter++)
+                block.get()[iter->first] = iter->second;
+            sparse_blocks[block_].reset();
+            snapshot_blocks[block_] = false;
+        }
+    }
+    else if(snapshot_blocks[block_]){
+        // The snapshot keeps the counts it was taken with
+        snapshot_blocks[block_] = false;
+        if(block.use_count() > 1){
+            count_block copy(new unsigned int[block_size], std::default_delete<unsigned int[]>());
+            std::copy(block.get(), block.get() + block_size, copy.get());
+            block.swap(copy);
+        }
+    }
+    return block.get();
+}
+
+unsigned int OutputHisFile::get_sparse(const sparse_counts &counts_, unsigned short index_){
+    sparse_counts::const_iterator iter = std::lower_bound(counts_.begin(), counts_.end(), index_,
+        [](const std::pair<unsigned short, unsigned int> &count_, unsigned short index_){ return count_.first < index_; });
+    return ((iter != counts_.end() && iter->first == index_) ? iter->second : 0);
+}
+
+OutputHisFile::sparse_counts *OutputHisFile::own_sparse(size_t block_){
+    if(block_ >= sparse_blocks.size() || !sparse_blocks[block_])
+        return NULL;
+    sparse_block &sparse = sparse_blocks[block_];
+    if(snapshot_blocks[block_]){
+        snapshot_blocks[block_] = false;
+        if(sparse.use_count() > 1)
+            sparse = std::make_shared<sparse_counts>(*sparse);
+    }
+    return sparse.get();
+}
+
+unsigned int &OutputHisFile::own_count(size_t index_){
+    size_t block = index_/block_size;
+    if(count_blocks[block] || block >= sparse_blocks.size() || (!sparse_blocks[block] && !sparse_allowed[block]))
+        return own_block(block)[index_ % block_size];
+    
+    if(!sparse_blocks[block])
+        sparse_blocks[block] = std::make_shared<sparse_counts>();
+    sparse_counts &sparse = *own_sparse(block);
+    unsigned short bin = index_ % block_size;
+    sparse_counts::iterator iter = std::lower_bound(sparse.begin(), sparse.end(), bin,
+        [](const std::pair<unsigned short, unsigned int> &count_, unsigned short index_){ return count_.first < index_; });
+    if(iter == sparse.end() || iter->first != bin){
+        if(sparse.size() >= sparse_limit)
+            return own_block(block)[bin];
+        iter = sparse.insert(iter, std::make_pair(bin, 0u));
+    }
+    return iter->second;
+}
+
+void OutputHisFile::allow_sparse(drr_entry *entry_){
+    if(entry_->hisDim < 2 || entry_->total_bins == 0)
+        return;
+    size_t start = count_table[entry_->hisID];
+    size_t stop = start + entry_->total_bins;
+    for(size_t i = start/block_size; i <= (stop - 1)/block_size; i++)
+        sparse_allowed[i] = true;
+}
+
+void OutputHisFile::SetSparse(bool sparse_){
+    use_sparse = sparse_;
+    if(!use_sparse || map_base)
+        return;
+    sparse_blocks.resize(count_blocks.size());
+    sparse_allowed.assign(count_blocks.size(), false);
+    for(std::vector<drr_entry*>::iterator iter = his_order.begin(); iter != his_order.end(); iter++)
+        allow_sparse(*iter);
+}
+
+size_t OutputHisFile::Sparsify(){
+    if(!use_sparse || map_base)
+        return 0;
+    size_t freed = 0;
+    for(size_t i = 0; i < count_blocks.size(); i++){
+        if(!count_blocks[i] || !sparse_allowed[i])
+            continue;
+        const unsigned int *counts = count_blocks[i].get();
+        size_t nonzero = block_size - std::count(counts, counts + block_size, 0u);
+        if(nonzero > sparse_limit)
+            continue;
+        sparse_block sparse = std::make_shared<sparse_counts>();
+        sparse->reserve(nonzero);
+        for(size_t j = 0; j < block_size; j++){
+            if(counts[j])
+                sparse->push_back(std::make_pair((unsigned short)j, counts[j]));
+        }
+        // A snapshot still holding the dense block keeps it
+        sparse_blocks[i] = sparse;
+        count_blocks[i].reset();
+        snapshot_blocks[i] = false;
+        freed += block_size*sizeof(unsigned int) - nonzero*sizeof(sparse_counts::value_type);
+    }
+    return freed;
+}
+
+size_t OutputHisFile::GetMemory(unsigned int hisID_){
+    if(hisID_ >= drr_table.size() || !drr_table[hisID_])
+        return 0;
+    drr_entry *entry = drr_table[hisID_];
+    size_t bytes = 0;
+    if(map_base)
+        bytes += entry->total_size;
+    else if(entry->total_bins > 0){
+        size_t start = count_table[hisID_];
+        size_t stop = start + entry->total_bins;
+        for(size_t i = start/block_size; i <= (stop - 1)/block_size; i++){
+            size_t lo = std::max(start, i*block_size) - i*block_size;
+            size_t hi = std::min(stop, (i + 1)*block_size) - i*block_size;
+            if(count_blocks[i])
+                bytes += (hi - lo)*sizeof(unsigned int);
+            else if(i < sparse_blocks.size() && sparse_blocks[i]){
+                for(sparse_counts::const_iterator iter = sparse_blocks[i]->begin(); iter != sparse_blocks[i]->end(); iter++){
+                    if(iter->first >= lo && iter->first < hi)
+                        bytes += sizeof(sparse_counts::value_type);
+                }
+            }
+        }
+    }
+    if(hisID_ < rolling_table.size() && rolling_table[hisID_] >= 0){
+        const rolling_his &his = rolling[rolling_table[hisID_]];
+        bytes += (his.slices.size()*entry->total_bins + his.sum.capacity())*sizeof(unsigned int);
+    }
+    return bytes;
+}
+
+size_t OutputHisFile::GetMemory(){
+    size_t bytes = map_size;
+    for(size_t i = 0; i < count_blocks.size(); i++){
+        if(count_blocks[i])
+            bytes += block_size*sizeof(unsigned int);
+        else if(i < sparse_blocks.size() && sparse_blocks[i])
+            bytes += sparse_blocks[i]->capacity()*sizeof(sparse_counts::value_type);
+    }
+    for(std::vector<rolling_his>::iterator iter = rolling.begin(); iter != rolling.end(); iter++)
+        bytes += (iter->slices.size()*iter->entry->total_bins + iter->sum.capacity())*sizeof(unsigned int);
+    return bytes;
+}
+
+void OutputHisFile::increment_mapped(drr_entry *entry_, unsigned int bin_, unsigned int weight_){
+    // push_back aligns the bins to their size, so they can be incremented in place
+    char *ptr = map_base + entry_->offset*2 + (size_t)bin_*entry_->halfWords*2;
+    bool full;
+    if(entry_->use_int)
+        full = add_saturated<unsigned int>(ptr, weight_, atomic_fills);
+    else
+        full = add_saturated<unsigned short>(ptr, weight_, atomic_fills);
+    if(full)
+        saturated.insert(entry_->hisID);
+}
+
+void OutputHisFile::mark_dirty(size_t start_, size_t stop_){
+    // The page cache writes back the mapped file
+    if(map_base)
+        return;
+    for(size_t i = start_/block_size; i <= (stop_ - 1)/block_size; i++)
+        dirty_blocks[i] = served_blocks[i] = true;
+}
+
+void OutputHisFile::publish(){
+    if(!server || !finalized)
+        return;
+    if(map_base) // The changed bins of the mapped file are not tracked
+        server->Compare(map_base, map_size);
+    else{
+        size_t i = 0;
+        while(i < served_blocks.size()){
+            if(!served_blocks[i]){
+                i++;
+                continue;
+            }
+            size_t first = i;
+            while(i < served_blocks.size() && served_blocks[i])
+                served_blocks[i++] = false;
+            std::vector<his_chunk> chunks;
+            pack_counts(first*block_size, std::min(i*block_size, num_counts), chunks);
+            for(std::vector<his_chunk>::iterator iter = chunks.begin(); iter != chunks.end(); iter++)
+                server->Update(iter->offset, &iter->bytes[0], iter->bytes.size());
+        }
+    }
+    for(std::vector<rolling_his>::iterator iter = rolling.begin(); iter != rolling.end(); iter++){
+        if(iter->served)
+            continue;
+        sum_rolling(*iter);
+        server->SetRolling(iter->entry->hisID, iter->entry->scaled[0],
+                           (iter->entry->hisDim > 1 ? iter->entry->scaled[1] : 1),
+                           iter->slices.size(), iter->seconds, iter->sum);
+        iter->served = true;
+    }
+    server->Commit();
+}
+
+void OutputHisFile::advance_rolling(time_t now_){
+    for(std::vector<rolling_his>::iterator iter = rolling.begin(); iter != rolling.end(); iter++){
+        if(now_ < iter->slice_end)
+            continue;
+        // Slices which ended without a fill are skipped, up to the whole ring
+        size_t num_ended = (now_ - iter->slice_end)/iter->seconds + 1;
+        iter->slice_end += num_ended*iter->seconds;
+        num_ended = std::min(num_ended, iter->slices.size());
+        for(size_t i = 0; i < num_ended; i++){
+            iter->current = (iter->current + 1) % iter->slices.size();
+            std::fill(iter->slices[iter->current].begin(), iter->slices[iter->current].end(), 0);
+        }
+        iter->sum_valid = iter->served = false;
+    }
+}
+
+void OutputHisFile::sum_rolling(rolling_his &his_){
+    if(his_.sum_valid)
+        return;
+    his_.sum.assign(his_.entry->total_bins, 0);
+    unsigned int *sum = &his_.sum[0];
+    for(std::vector<std::vector<unsigned int> >::const_iterator slice = his_.slices.begin(); slice != his_.slices.end(); slice++){
+        const unsigned int *counts = &(*slice)[0];
+        for(size_t i = 0; i < his_.sum.size(); i++)
+            sum[i] += counts[i];
+    }
+    his_.sum_valid = true;
+}
+
+bool OutputHisFile::SetRolling(unsigned int hisID_, unsigned int slices_, unsigned int seconds_){
+    drr_entry *entry = (hisID_ < drr_table.size() ? drr_table[hisID_] : NULL);
+    if(!entry || entry->total_bins == 0 || slices_ == 0 || seconds_ == 0)
+        return(false);
+    
+    if(hisID_ >= rolling_table.size())
+        rolling_table.resize(hisID_ + 1, -1);
+    if(rolling_table[hisID_] < 0){
+        rolling_table[hisID_] = rolling.size();
+        rolling.push_back(rolling_his());
+    }
+    rolling_his &his = rolling[rolling_table[hisID_]];
+    his.entry = entry;
+    his.seconds = seconds_;
+    his.slices.assign(slices_, std::vector<unsigned int>(entry->total_bins, 0));
+    his.current = 0;
+    his.slice_end = time(NULL) + seconds_;
+    his.sum_valid = his.served = false;
+    return(true);
+}
+
+bool OutputHisFile::GetRolling(unsigned int hisID_, std::vector<unsigned int> &counts_){
+    if(hisID_ >= rolling_table.size() || rolling_table[hisID_] < 0)
+        return(false);
+    rolling_his &his = rolling[rolling_table[hisID_]];
+    advance_rolling(time(NULL));
+    sum_rolling(his);
+    counts_ = his.sum;
+    return(true);
+}
+
 void OutputHisFile::Flush(){
     if(debug_mode)
         std::cout << "debug: Flushing histogram entries to file.\n";
     
-    if(writable){ // Do the filling
-        for(std::vector<fill_queue*>::iterator iter = fills_waiting.begin();
-            iter != fills_waiting.end(); iter++){
-
-            if(!(*iter)->good)
+    if(has_requests)
+        do_requests();
+    if(!rolling.empty())
+        advance_rolling(time(NULL));
+    publish();
+    
+    if(writable && use_checkpoints){ // Leave the writing to a checkpoint
+        Checkpoint();
+        return;
+    }
+    else if(writable && map_base){ // Start writing back the mapped file
+        msync(map_base, map_size, MS_ASYNC);
+    }
+    else if(writable){ // Write each run of changed blocks in one go
+        if(zero_file){
+            // Drop the bins of the zeroed file rather than writing zeros
+            ofile.flush();
+            std::string his = fname + ".his";
+            if(::truncate(his.c_str(), 0) != 0 || ::truncate(his.c_str(), total_his_size) != 0)
+                dirty_blocks.assign(dirty_blocks.size(), true);
+            zero_file = false;
+        }
+        size_t i = 0;
+        while(i < dirty_blocks.size()){
+            if(!dirty_blocks[i]){
+                i++;
                 continue;
-            
-            current_entry = (*iter)->entry;
-            current_entry->good_counts++;
-            
-            // Seek to the specified bin
-            ofile.seekg(current_entry->offset*2 + (*iter)->byte, std::ios::beg); // input offset
-            
-            unsigned short sval = 0;
-            unsigned int ival = 0;
-            
-            // Overwrite the bin value
-            if(current_entry->use_int){
-                // Get the original value of the bin
-                ofile.read((char*)&ival, 4);
-                ival += (*iter)->weight;
-		
-                // Set the new value of the bin
-                ofile.seekp(current_entry->offset*2 + (*iter)->byte, std::ios::beg); // output offset
-                ofile.write((char*)&ival, 4);
             }
-            else{
-                // Get the original value of the bin
-                ofile.read((char*)&sval, 2);
-                sval += (short)(*iter)->weight;
-		
-                // Set the new value of the bin
-                ofile.seekp(current_entry->offset*2 + (*iter)->byte, std::ios::beg); // output offset
-                ofile.write((char*)&sval, 2);
+            size_t first = i;
+            while(i < dirty_blocks.size() && dirty_blocks[i])
+                dirty_blocks[i++] = false;
+            std::vector<his_chunk> chunks;
+            pack_counts(first*block_size, std::min(i*block_size, num_counts), chunks);
+            for(std::vector<his_chunk>::iterator iter = chunks.begin(); iter != chunks.end(); iter++){
+                ofile.seekp(iter->offset, std::ios::beg);
+                ofile.write(&iter->bytes[0], iter->bytes.size());
             }
         }
+        ofile.flush();
     }
     else if(debug_mode){ std::cout << "debug: Output file is not writable!\n"; }
     
-    // Delete the drr_entries in the fill_queue vector
-    for(std::vector<fill_queue*>::iterator iter = fills_waiting.begin(); iter != fills_waiting.end(); iter++){
-        delete (*iter);
+    Flush_count = 0;
+}
+
+void OutputHisFile::Checkpoint(bool wait_/*=false*/){
+    if(!use_checkpoints)
+        return;
+    if(checkpoint_thread.joinable()){
+        if(!wait_ && checkpoint_busy) // Never keep the fills waiting
+            return;
+        checkpoint_thread.join();
     }
-    fills_waiting.clear();
+    if(checkpoint_failed)
+        shadow_blocks.assign(shadow_blocks.size(), true);
+    
+    // The emptied shadow file of a zero only lacks the blocks filled since
+    bool zero = zero_file;
+    if(zero)
+        shadow_blocks.assign(shadow_blocks.size(), false);
+    zero_file = false;
+    
+    // The shadow file also lacks the blocks which went to the .his file last time
+    std::vector<his_chunk> chunks;
+    size_t i = 0;
+    while(i < dirty_blocks.size()){
+        if(!dirty_blocks[i] && !shadow_blocks[i]){
+            i++;
+            continue;
+        }
+        size_t first = i;
+        while(i < dirty_blocks.size() && (dirty_blocks[i] || shadow_blocks[i]))
+            i++;
+        pack_counts(first*block_size, std::min(i*block_size, num_counts), chunks);
+    }
+    shadow_blocks.swap(dirty_blocks);
+    dirty_blocks.assign(dirty_blocks.size(), false);
     
     Flush_count = 0;
+    next_checkpoint = time(NULL) + checkpoint_interval;
+    checkpoint_busy = true;
+    if(wait_)
+        write_checkpoint(chunks, zero);
+    else
+        checkpoint_thread = std::thread(&OutputHisFile::write_checkpoint, this, std::move(chunks), zero);
+}
+
+void OutputHisFile::write_checkpoint(std::vector<his_chunk> chunks_, bool zero_){
+    std::string shadow = fname + ".his.tmp";
+    int fd = ::open(shadow.c_str(), O_WRONLY | O_CREAT, 0644);
+    bool good = (fd >= 0 && (!zero_ || ftruncate(fd, 0) == 0) && ftruncate(fd, total_his_size) == 0);
+    for(std::vector<his_chunk>::iterator iter = chunks_.begin(); good && iter != chunks_.end(); iter++)
+        good = (pwrite(fd, &iter->bytes[0], iter->bytes.size(), iter->offset) == (ssize_t)iter->bytes.size());
+    good = good && fsync(fd) == 0;
+    if(fd >= 0)
+        ::close(fd);
+    good = good && ::rename(shadow.c_str(), (fname + ".his").c_str()) == 0;
+    
+    if(!good)
+        std::cout << "OutputHisFile::Checkpoint : Failed to write the checkpoint '" << shadow << "'!\n";
+    checkpoint_failed = !good;
+    checkpoint_busy = false;
+}
+
+bool OutputHisFile::SaveCounts(std::ostream &out_){
+    if(!writable || !finalized)
+        return false;
+    
+    unsigned long long layout[3] = {num_counts, (unsigned long long)total_his_size, (map_base != NULL)};
+    out_.write((char*)layout, sizeof(layout));
+    if(map_base)
+        out_.write(map_base, map_size);
+    else{
+        // Only the blocks which were filled, each preceded by its index
+        std::vector<unsigned int> dense;
+        for(size_t i = 0; i < count_blocks.size(); i++){
+            const unsigned int *counts = count_blocks[i].get();
+            if(!counts && i < sparse_blocks.size() && sparse_blocks[i]){
+                dense.assign(block_size, 0);
+                for(sparse_counts::const_iterator iter = sparse_blocks[i]->begin(); iter != sparse_blocks[i]->end(); iter++)
+                    dense[iter->first] = iter->second;
+                counts = &dense[0];
+            }
+            if(!counts)
+                continue;
+            unsigned long long index = i;
+            out_.write((char*)&index, sizeof(index));
+            out_.write((char*)counts, block_size*4);
+        }
+        unsigned long long end = ULLONG_MAX;
+        out_.write((char*)&end, sizeof(end));
+    }
+    
+    for(std::vector<drr_entry*>::iterator iter = his_order.begin(); iter != his_order.end(); iter++){
+        out_.write((char*)&(*iter)->total_counts, 4);
+        out_.write((char*)&(*iter)->good_counts, 4);
+    }
+    
+    return out_.good();
+}
+
+bool OutputHisFile::LoadCounts(std::istream &in_){
+    if(!writable || !finalized)
+        return false;
+    
+    unsigned long long layout[3];
+    if(!in_.read((char*)layout, sizeof(layout)))
+        return false;
+    if(layout[0] != num_counts || layout[1] != (unsigned long long)total_his_size || (layout[2] != 0) != (map_base != NULL)){
+        std::cout << "OutputHisFile::LoadCounts : The saved histograms do not have the layout of '" << fname << ".his'!\n";
+        return false;
+    }
+    
+    if(map_base){
+        if(!in_.read(map_base, map_size))
+            return false;
+    }
+    else{
+        unsigned long long index;
+        while(in_.read((char*)&index, sizeof(index)) && index != ULLONG_MAX){
+            if(index >= count_blocks.size())
+                return false;
+            if(!in_.read((char*)own_block(index), block_size*4))
+                return false;
+            mark_dirty(index*block_size, std::min((size_t)(index + 1)*block_size, num_counts));
+        }
+        if(!in_.good())
+            return false;
+    }
+    
+    for(std::vector<drr_entry*>::iterator iter = his_order.begin(); iter != his_order.end(); iter++){
+        in_.read((char*)&(*iter)->total_counts, 4);
+        in_.read((char*)&(*iter)->good_counts, 4);
+    }
+    
+    return in_.good();
+}
+
+void OutputHisFile::pack_counts(const std::vector<count_block> &blocks_, const std::vector<sparse_block> &sparse_,
+                                size_t start_, size_t stop_, std::vector<his_chunk> &chunks_,
+                                std::set<unsigned int> *saturated_){
+    // Find the last histogram starting at or before start_
+    std::vector<drr_entry*>::iterator iter = std::upper_bound(his_order.begin(), his_order.end(), start_,
+        [this](size_t index_, drr_entry *entry_){ return index_ < count_table[entry_->hisID]; });
+    if(iter != his_order.begin())
+        iter--;
+    
+    for(; iter != his_order.end(); iter++){
+        drr_entry *entry = *iter;
+        size_t first = count_table[entry->hisID];
+        if(first >= stop_)
+            break;
+        size_t lo = std::max(start_, first);
+        size_t hi = std::min(stop_, first + entry->total_bins);
+        if(lo >= hi)
+            continue;
+        
+        size_t width = entry->use_int ? 4 : 2;
+        chunks_.push_back(his_chunk());
+        chunks_.back().offset = entry->offset*2 + (lo - first)*width;
+        std::vector<char> &bytes = chunks_.back().bytes;
+        bytes.resize((hi - lo)*width);
+        if(entry->use_int){
+            for(size_t i = lo; i < hi; i++){
+                unsigned int ival = get_count(blocks_, sparse_, i);
+                memcpy(&bytes[(i - lo)*4], &ival, 4);
+            }
+        }
+        else{
+            for(size_t i = lo; i < hi; i++){
+                unsigned int count = get_count(blocks_, sparse_, i);
+                unsigned short sval = USHRT_MAX;
+                if(count <= USHRT_MAX)
+                    sval = (unsigned short)count;
+                else if(saturated_)
+                    saturated_->insert(entry->hisID);
+                memcpy(&bytes[(i - lo)*2], &sval, 2);
+            }
+        }
+    }
 }
 
 OutputHisFile::OutputHisFile(){
@@ -772,9 +1291,24 @@ OutputHisFile::OutputHisFile(){
     writable = false;
     finalized = false;
     existing_file = false;
-    Flush_wait = 100000;
+    Flush_wait = 1000000;
     Flush_count = 0;
     total_his_size = 0;
+    num_counts = 0;
+    use_map = false;
+    atomic_fills = false;
+    map_fd = -1;
+    map_base = NULL;
+    map_size = 0;
+    checkpoint_interval = 0;
+    use_checkpoints = false;
+    next_checkpoint = 0;
+    checkpoint_busy = false;
+    checkpoint_failed = false;
+    server = NULL;
+    zero_file = false;
+    has_requests = false;
+    use_sparse = false;
     
     initialize();
 }
@@ -784,9 +1318,24 @@ OutputHisFile::OutputHisFile(std::string fname_prefix){
     writable = false;
     finalized = false;
     existing_file = false;
-    Flush_wait = 100000;
+    Flush_wait = 1000000;
     Flush_count = 0;
     total_his_size = 0;
+    num_counts = 0;
+    use_map = false;
+    atomic_fills = false;
+    map_fd = -1;
+    map_base = NULL;
+    map_size = 0;
+    checkpoint_interval = 0;
+    use_checkpoints = false;
+    next_checkpoint = 0;
+    checkpoint_busy = false;
+    checkpoint_failed = false;
+    server = NULL;
+    zero_file = false;
+    has_requests = false;
+    use_sparse = false;
     
     initialize();
     Open(fname_prefix);
@@ -814,57 +1363,47 @@ size_t OutputHisFile::push_back(drr_entry *entry){
         return(0);
     }
     
-    // Seek to the end of this histogram file
-    ofile.seekp(0, std::ios::end);
-    entry->offset = (size_t)ofile.tellp()/2; // Set the file offset (in 2 byte words)
+    // The histogram goes at the end of the file, which is written by Flush.
+    // Align the 4 byte bins so that they may be incremented atomically.
+    size_t size = total_his_size;
+    if(entry->use_int && size % 4 != 0)
+        size += 2;
+    entry->offset = size/2; // Set the file offset (in 2 byte words)
     drrMap_.insert(std::make_pair(entry->hisID,entry));
+    if(entry->hisID >= drr_table.size()){
+        drr_table.resize(entry->hisID + 1, NULL);
+        count_table.resize(entry->hisID + 1, 0);
+    }
+    drr_table[entry->hisID] = entry;
+    count_table[entry->hisID] = num_counts;
+    his_order.push_back(entry);
     
     if(debug_mode)
         std::cout << "debug: Extending .his file by " << entry->total_size
                   << " bytes for his ID = " << entry->hisID << " i.e. '"
                   << rstrip(entry->title) << "'\n";
     
-    char *block = new char[entry->total_size];	
-    memset(block, 0x0, entry->total_size);
-    ofile.write(block, entry->total_size);
-    delete[] block;
-    
-    ofile.seekp(0, std::ios::end);
-    total_his_size = ofile.tellp();
+    size_t first = num_counts;
+    num_counts += entry->total_bins;
+    count_blocks.resize((num_counts + block_size - 1)/block_size);
+    dirty_blocks.resize(count_blocks.size(), false);
+    served_blocks.resize(count_blocks.size(), false);
+    snapshot_blocks.resize(count_blocks.size(), false);
+    if(use_sparse){
+        sparse_blocks.resize(count_blocks.size());
+        sparse_allowed.resize(count_blocks.size(), false);
+        allow_sparse(entry);
+    }
+    if(entry->total_bins > 0)
+        mark_dirty(first, num_counts);
+    total_his_size = size + entry->total_size;
     
     return entry->total_size;
 }
 
-bool OutputHisFile::Finalize(bool make_list_file_/*=false*/, const std::string &descrip_/*="RootPixieScan .drr file"*/){
-    if(!writable || finalized){ 
-        if(debug_mode)
-            std::cout << "debug: The .drr and .his files have already been finalized and are locked!\n"; 
-        return(false); 
-    }
-    
+bool OutputHisFile::write_drr(){
     bool retval = true;
     
-    set_char_array(initial, "HHIRFDIR0001", 12);
-    set_char_array(description, descrip_, 40);
-    
-    if(debug_mode)
-        std::cout << "debug: NHIS = " << drrMap_.size() << std::endl;
-    nHis = drrMap_.size(); 
-    nHWords = (128 * (1 + drrMap_.size()) + drrMap_.size() * 4)/2;
-    
-    time_t rawtime;
-    struct tm * timeinfo;
-    
-    time(&rawtime);
-    timeinfo = localtime (&rawtime);
-    
-    date[0] = 0;
-    date[1] = timeinfo->tm_year + 1900; // tm_year measures the year from 1900
-    date[2] = timeinfo->tm_mon; // tm_mon ranges from 0 to 11
-    date[3] = timeinfo->tm_mday;
-    date[4] = timeinfo->tm_hour;
-    date[5] = timeinfo->tm_min;
-    
     // Write the .drr file
     std::ofstream drr_file((fname+".drr").c_str(), std::ios::binary);
     if(drr_file.good()){
@@ -922,9 +1461,59 @@ bool OutputHisFile::Finalize(bool make_list_file_/*=false*/, const std::string &
             std::cout << "debug: Failed to open the .list file for writing!\n";
         retval = false;
     }
-    list_file.close();	
+    list_file.close();
+    
+    return retval;
+}
+
+bool OutputHisFile::Finalize(bool make_list_file_/*=false*/, const std::string &descrip_/*="RootPixieScan .drr file"*/){
+    if(!writable || finalized){ 
+        if(debug_mode)
+            std::cout << "debug: The .drr and .his files have already been finalized and are locked!\n"; 
+        return(false); 
+    }
+    
+    set_char_array(initial, "HHIRFDIR0001", 12);
+    set_char_array(description, descrip_, 40);
+    
+    if(debug_mode)
+        std::cout << "debug: NHIS = " << drrMap_.size() << std::endl;
+    nHis = drrMap_.size(); 
+    nHWords = (128 * (1 + drrMap_.size()) + drrMap_.size() * 4)/2;
+    
+    time_t rawtime;
+    struct tm * timeinfo;
+    
+    time(&rawtime);
+    timeinfo = localtime (&rawtime);
+    
+    date[0] = 0;
+    date[1] = timeinfo->tm_year + 1900; // tm_year measures the year from 1900
+    date[2] = timeinfo->tm_mon; // tm_mon ranges from 0 to 11
+    date[3] = timeinfo->tm_mday;
+    date[4] = timeinfo->tm_hour;
+    date[5] = timeinfo->tm_min;
+    
+    bool retval = write_drr();
     
     finalized = true;
+    if(server){
+        server->SetLayout(his_order, total_his_size);
+        served_blocks.assign(served_blocks.size(), true);
+    }
+    
+    // Write the whole .his file now that its layout is fixed
+    Flush();
+    if(use_map && !map_his())
+        std::cout << "OutputHisFile::Finalize : Failed to map '" << fname
+                  << ".his', the histograms will be filled in memory.\n";
+    
+    // The shadow file for the checkpoints does not exist yet
+    if(checkpoint_interval > 0 && !map_base){
+        use_checkpoints = true;
+        shadow_blocks.assign(dirty_blocks.size(), true);
+        next_checkpoint = time(NULL) + checkpoint_interval;
+    }
     
     return retval;
 }
@@ -941,17 +1530,31 @@ bool OutputHisFile::Fill(unsigned int hisID_, unsigned int x_, unsigned int y_,
         if(!temp_drr->find_bin((unsigned int)(x_/temp_drr->comp[0]), (unsigned int)(y_/temp_drr->comp[1]), bin))
             return(false);
         
-        // Push this fill into the queue
-        fill_queue *fill = new fill_queue(temp_drr, bin, weight_);
-        fills_waiting.push_back(fill);
-        
-        if(++Flush_count >= Flush_wait)
-            Flush();
+        return(increment_bin(temp_drr, bin, weight_));
     }
     
     return(false);
 }
 
+bool OutputHisFile::FillRow(unsigned int hisID_, unsigned int y_,
+                            const unsigned int *weights_, size_t n_){
+    if(!writable)
+        return(false);
+    
+    drr_entry *temp_drr = find_drr_in_list(hisID_);
+    if(!temp_drr)
+        return(false);
+    
+    temp_drr->total_counts += n_;
+    unsigned int bin;
+    for(size_t x = 0; x < n_; x++){
+        if(temp_drr->find_bin((unsigned int)(x/temp_drr->comp[0]), (unsigned int)(y_/temp_drr->comp[1]), bin))
+            increment_bin(temp_drr, bin, weights_[x]);
+    }
+    
+    return(true);
+}
+
 bool OutputHisFile::FillBin(unsigned int hisID_, unsigned int x_, unsigned int y_, unsigned int weight_){
     if(!writable){ return false; }
     
@@ -961,29 +1564,85 @@ bool OutputHisFile::FillBin(unsigned int hisID_, unsigned int x_, unsigned int y
         temp_drr->total_counts++;
         if(!temp_drr->get_bin(x_, y_, bin)){ return false; }
 	
-        // Push this fill into the queue
-        fill_queue *fill = new fill_queue(temp_drr, bin, weight_);
-        fills_waiting.push_back(fill);
-        
-        if(++Flush_count >= Flush_wait){ Flush(); }
-        return true;
+        return increment_bin(temp_drr, bin, weight_);
     }
     
     return false;
 }
 
+bool OutputHisFile::map_his(){
+    size_t size = total_his_size;
+    if(size == 0)
+        return false;
+    
+    map_fd = ::open((fname+".his").c_str(), O_RDWR);
+    if(map_fd < 0)
+        return false;
+    void *addr = MAP_FAILED;
+    if(ftruncate(map_fd, size) == 0)
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, map_fd, 0);
+    if(addr == MAP_FAILED){
+        ::close(map_fd);
+        map_fd = -1;
+        return false;
+    }
+    
+    // The bins now live in the file, so the counts in memory are no longer needed
+    map_base = (char*)addr;
+    map_size = size;
+    std::vector<count_block>().swap(count_blocks);
+    std::vector<sparse_block>().swap(sparse_blocks);
+    std::vector<bool>().swap(dirty_blocks);
+    return true;
+}
+
+void OutputHisFile::unmap_his(){
+    if(!map_base)
+        return;
+    munmap(map_base, map_size);
+    ::close(map_fd);
+    map_base = NULL;
+    map_size = 0;
+    map_fd = -1;
+}
+
 bool OutputHisFile::Zero(unsigned int hisID_){
     if(!writable){ return false; }
     
     drr_entry *temp_drr = find_drr_in_list(hisID_);
     if(temp_drr){
-        ofile.seekp(temp_drr->offset*2, std::ios::beg);
-	
-        char *block = new char[temp_drr->total_size];	
-        memset(block, 0x0, temp_drr->total_size);
-        ofile.write(block, temp_drr->total_size);
-        delete[] block;
-	
+        if(map_base)
+            memset(map_base + temp_drr->offset*2, 0x0, temp_drr->total_size);
+        else if(temp_drr->total_bins > 0){
+            size_t start = count_table[hisID_];
+            size_t stop = start + temp_drr->total_bins;
+            for(size_t i = start/block_size; i <= (stop - 1)/block_size; i++){
+                size_t lo = std::max(start, i*block_size) - i*block_size;
+                size_t hi = std::min(stop, (i + 1)*block_size) - i*block_size;
+                if(!count_blocks[i]){
+                    sparse_counts *sparse = own_sparse(i);
+                    if(!sparse)
+                        continue;
+                    sparse->erase(std::remove_if(sparse->begin(), sparse->end(),
+                        [lo, hi](const std::pair<unsigned short, unsigned int> &count_){ return count_.first >= lo && count_.first < hi; }), sparse->end());
+                    if(sparse->empty())
+                        sparse_blocks[i].reset();
+                }
+                else if(lo == 0 && hi == block_size)
+                    count_blocks[i].reset();
+                else{
+                    unsigned int *block = own_block(i);
+                    std::fill(block + lo, block + hi, 0);
+                }
+            }
+            mark_dirty(start, stop);
+        }
+        if(hisID_ < rolling_table.size() && rolling_table[hisID_] >= 0){
+            rolling_his &his = rolling[rolling_table[hisID_]];
+            for(size_t i = 0; i < his.slices.size(); i++)
+                std::fill(his.slices[i].begin(), his.slices[i].end(), 0);
+            his.sum_valid = his.served = false;
+        }
         return true;
     }
     
@@ -994,17 +1653,128 @@ bool OutputHisFile::Zero(){
     if(!writable)
         return false;
     
-    for(std::map<unsigned int, drr_entry*>::iterator iter = drrMap_.begin();
-        iter != drrMap_.end(); iter++){
-        ofile.seekp((*iter).second->offset*2, std::ios::beg);
-        char *block = new char[(*iter).second->total_size];	
-        memset(block, 0x0, (*iter).second->total_size);
-        ofile.write(block, (*iter).second->total_size);
-        delete[] block;
+    if(map_base){
+#ifdef FALLOC_FL_PUNCH_HOLE
+        if(fallocate(map_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, map_size) != 0)
+#endif
+            memset(map_base, 0x0, map_size);
+    }
+    else if(num_counts > 0){
+        // Swap in blocks which were never filled, the old ones are only
+        // written by a snapshot still holding them
+        std::vector<count_block>(count_blocks.size()).swap(count_blocks);
+        std::vector<sparse_block>(sparse_blocks.size()).swap(sparse_blocks);
+        snapshot_blocks.assign(snapshot_blocks.size(), false);
+        dirty_blocks.assign(dirty_blocks.size(), false);
+        served_blocks.assign(served_blocks.size(), false);
+        zero_file = true;
+        if(server && finalized)
+            server->SetLayout(his_order, total_his_size);
+    }
+    for(std::vector<rolling_his>::iterator iter = rolling.begin(); iter != rolling.end(); iter++){
+        for(size_t i = 0; i < iter->slices.size(); i++)
+            std::fill(iter->slices[i].begin(), iter->slices[i].end(), 0);
+        iter->sum_valid = iter->served = false;
     }
     return true;
 }
 
+bool OutputHisFile::Snapshot(const std::string &fname_prefix){
+    if(!writable || !finalized || fname_prefix.empty() || fname_prefix == fname)
+        return false;
+    if(snapshot_thread.joinable())
+        snapshot_thread.join();
+    
+    // The blocks are shared with the snapshot, and copied when filled
+    std::vector<count_block> blocks;
+    std::vector<sparse_block> sparse;
+    std::vector<char> image;
+    if(map_base)
+        image.assign(map_base, map_base + map_size);
+    else{
+        blocks = count_blocks;
+        sparse = sparse_blocks;
+        snapshot_blocks.assign(snapshot_blocks.size(), true);
+    }
+    snapshot_thread = std::thread(&OutputHisFile::write_snapshot, this, fname_prefix, std::move(blocks), std::move(sparse), std::move(image));
+    return true;
+}
+
+void OutputHisFile::write_snapshot(std::string prefix_, std::vector<count_block> blocks_, std::vector<sparse_block> sparse_,
+                                   std::vector<char> image_){
+    std::string his = prefix_ + ".his";
+    int fd = ::open(his.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool good = (fd >= 0 && ftruncate(fd, total_his_size) == 0);
+    if(good && !image_.empty())
+        good = (pwrite(fd, &image_[0], image_.size(), 0) == (ssize_t)image_.size());
+    
+    // Blocks which were never filled are left as the zeros of the file
+    size_t i = 0;
+    while(good && i < blocks_.size()){
+        if(!blocks_[i] && (i >= sparse_.size() || !sparse_[i])){
+            i++;
+            continue;
+        }
+        size_t first = i;
+        while(i < blocks_.size() && (blocks_[i] || (i < sparse_.size() && sparse_[i])))
+            i++;
+        std::vector<his_chunk> chunks;
+        pack_counts(blocks_, sparse_, first*block_size, std::min(i*block_size, num_counts), chunks, NULL);
+        for(std::vector<his_chunk>::iterator iter = chunks.begin(); good && iter != chunks.end(); iter++)
+            good = (pwrite(fd, &iter->bytes[0], iter->bytes.size(), iter->offset) == (ssize_t)iter->bytes.size());
+        // Let the fills have the blocks back without copying them
+        for(size_t j = first; j < i; j++){
+            blocks_[j].reset();
+            if(j < sparse_.size())
+                sparse_[j].reset();
+        }
+    }
+    if(fd >= 0)
+        ::close(fd);
+    
+    const char *extensions[2] = {".drr", ".list"};
+    for(int j = 0; good && j < 2; j++){
+        std::ifstream src((fname + extensions[j]).c_str(), std::ios::binary);
+        std::ofstream dest((prefix_ + extensions[j]).c_str(), std::ios::binary | std::ios::trunc);
+        if(src.good() && dest.good())
+            dest << src.rdbuf();
+        else if(j == 0)
+            good = false;
+    }
+    
+    if(!good)
+        std::cout << "OutputHisFile::Snapshot : Failed to write the snapshot '" << prefix_ << "'!\n";
+}
+
+void OutputHisFile::RequestZero(){
+    std::lock_guard<std::mutex> lock(request_mutex);
+    his_request request = {true, ""};
+    requests.push_back(request);
+    has_requests = true;
+}
+
+void OutputHisFile::RequestSnapshot(const std::string &fname_prefix){
+    std::lock_guard<std::mutex> lock(request_mutex);
+    his_request request = {false, fname_prefix};
+    requests.push_back(request);
+    has_requests = true;
+}
+
+void OutputHisFile::do_requests(){
+    std::vector<his_request> todo;
+    {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        todo.swap(requests);
+        has_requests = false;
+    }
+    for(std::vector<his_request>::iterator iter = todo.begin(); iter != todo.end(); iter++){
+        if(iter->zero)
+            Zero();
+        else if(!Snapshot(iter->prefix))
+            std::cout << "OutputHisFile::Snapshot : Failed to take the snapshot '" << iter->prefix << "'!\n";
+    }
+}
+
 bool OutputHisFile::Open(std::string fname_prefix){
     if(writable){ 
         if(debug_mode){ std::cout << "debug: The .his file is already open!\n"; }
@@ -1019,11 +1789,150 @@ bool OutputHisFile::Open(std::string fname_prefix){
     return (writable = ofile.good());
 }
 
+bool OutputHisFile::Sum(const std::string &fname_prefix, const std::vector<std::string> &inputs_){
+    if(inputs_.empty())
+        return false;
+    
+    // All of the inputs share the layout of the first one.
+    HisFile layout;
+    if(!layout.LoadDrr(inputs_.front().c_str(), false)){
+        std::cout << "OutputHisFile::Sum : Failed to load '" << inputs_.front() << ".drr'!\n";
+        return false;
+    }
+    
+    std::vector<std::ifstream*> his_files;
+    bool retval = true;
+    for(std::vector<std::string>::const_iterator iter = inputs_.begin(); iter != inputs_.end(); iter++){
+        his_files.push_back(new std::ifstream((*iter + ".his").c_str(), std::ios::binary));
+        if(!his_files.back()->good()){
+            std::cout << "OutputHisFile::Sum : Failed to open '" << *iter << ".his'!\n";
+            retval = false;
+        }
+    }
+    
+    std::ofstream output((fname_prefix + ".his").c_str(), std::ios::binary | std::ios::trunc);
+    if(!output.good())
+        retval = false;
+    
+    std::vector<unsigned int> sum;
+    std::vector<unsigned int> ibins;
+    std::vector<unsigned short> sbins;
+    const std::map<unsigned int, drr_entry*> &entries = layout.GetDrrMap();
+    for(std::map<unsigned int, drr_entry*>::const_iterator iter = entries.begin();
+        retval && iter != entries.end(); iter++){
+        drr_entry *entry = (*iter).second;
+        sum.assign(entry->total_bins, 0);
+        
+        for(std::vector<std::ifstream*>::iterator file = his_files.begin(); file != his_files.end(); file++){
+            (*file)->seekg(entry->offset*2, std::ios::beg);
+            if(entry->use_int){
+                ibins.resize(entry->total_bins);
+                (*file)->read((char*)ibins.data(), entry->total_bins*4);
+                for(size_t i = 0; i < entry->total_bins; i++)
+                    sum[i] += ibins[i];
+            }
+            else{
+                sbins.resize(entry->total_bins);
+                (*file)->read((char*)sbins.data(), entry->total_bins*2);
+                for(size_t i = 0; i < entry->total_bins; i++)
+                    sum[i] += sbins[i];
+            }
+            if(!(*file)->good()){
+                std::cout << "OutputHisFile::Sum : Failed to read his id = " << entry->hisID << "!\n";
+                retval = false;
+                break;
+            }
+        }
+        
+        output.seekp(entry->offset*2, std::ios::beg);
+        if(entry->use_int)
+            output.write((char*)sum.data(), entry->total_bins*4);
+        else{
+            sbins.resize(entry->total_bins);
+            for(size_t i = 0; i < entry->total_bins; i++)
+                sbins[i] = (unsigned short)std::min(sum[i], (unsigned int)USHRT_MAX);
+            output.write((char*)sbins.data(), entry->total_bins*2);
+        }
+    }
+    output.close();
+    
+    for(std::vector<std::ifstream*>::iterator file = his_files.begin(); file != his_files.end(); file++)
+        delete (*file);
+    
+    // The summed histograms use the .drr and .list files of the inputs.
+    const char *extensions[2] = {".drr", ".list"};
+    for(int i = 0; retval && i < 2; i++){
+        std::ifstream src((inputs_.front() + extensions[i]).c_str(), std::ios::binary);
+        std::ofstream dest((fname_prefix + extensions[i]).c_str(), std::ios::binary | std::ios::trunc);
+        if(src.good() && dest.good())
+            dest << src.rdbuf();
+        else if(i == 0)
+            retval = false;
+    }
+    
+    return retval;
+}
+
+size_t OutputHisFile::promote_saturated(){
+    for(std::set<unsigned int>::iterator iter = saturated.begin(); iter != saturated.end(); iter++){
+        drr_entry *entry = drr_table[*iter];
+        if(entry->use_int)
+            continue;
+        entry->use_int = true;
+        entry->halfWords = 2;
+        entry->total_size = entry->total_bins*4;
+        promoted.insert(*iter);
+    }
+    if(promoted.empty())
+        return 0;
+    
+    // Lay out the file again, in the same order as push_back
+    size_t size = 0;
+    for(std::vector<drr_entry*>::iterator iter = his_order.begin(); iter != his_order.end(); iter++){
+        if((*iter)->use_int && size % 4 != 0)
+            size += 2;
+        (*iter)->offset = size/2;
+        size += (*iter)->total_size;
+    }
+    total_his_size = size;
+    
+    ofile.close();
+    ofile.open((fname+".his").c_str(), std::ios::out | std::ios::in | std::ios::trunc | std::ios::binary);
+    if(!write_drr() || !ofile.good())
+        std::cout << "OutputHisFile::Close : Failed to rewrite '" << fname << "' with the promoted histograms!\n";
+    dirty_blocks.assign(dirty_blocks.size(), true);
+    if(server){
+        server->SetLayout(his_order, total_his_size);
+        served_blocks.assign(served_blocks.size(), true);
+    }
+    Flush();
+    
+    return promoted.size();
+}
+
 void OutputHisFile::Close(){
     Flush();
+    if(snapshot_thread.joinable())
+        snapshot_thread.join();
     
     if(!finalized){ Finalize(); }
     
+    // Write the last checkpoint, then go back to writing the .his file in place
+    if(use_checkpoints){
+        Checkpoint(true);
+        use_checkpoints = false;
+        ::unlink((fname + ".his.tmp").c_str());
+        ofile.close();
+        ofile.open((fname+".his").c_str(), std::ios::out | std::ios::in | std::ios::binary);
+    }
+    
+    // Histograms whose 16 bit bins saturated are written again with 32 bit bins
+    if(writable && !map_base){
+        size_t num_promoted = promote_saturated();
+        if(num_promoted > 0)
+            std::cout << "OutputHisFile::Close : " << num_promoted << " histograms saturated their 16 bit bins and were written with 32 bit bins.\n";
+    }
+    
     // Write the .log file
     std::ofstream log_file((fname+".log").c_str());
     if(log_file.good()){
@@ -1038,13 +1947,158 @@ void OutputHisFile::Close(){
         for(std::set<unsigned int>::iterator iter = failed_fills.begin(); iter != failed_fills.end(); iter++){
             log_file << std::setw(5) << *iter << std::endl;
         }
+        log_file << "\nSaturated histograms:\n\n";
+        for(std::set<unsigned int>::iterator iter = saturated.begin(); iter != saturated.end(); iter++){
+            log_file << std::setw(5) << *iter;
+            if(promoted.find(*iter) != promoted.end())
+                log_file << "  promoted to 32 bit bins";
+            log_file << std::endl;
+        }
     }
     else if(debug_mode){ std::cout << "debug: Failed to open the .log file for writing!\n"; }
     log_file.close();
     
     // Clear the .drr entries in the entries vector
     clear_drr_entries();
+    drr_table.clear();
+    unmap_his();
+    count_blocks.clear();
+    sparse_blocks.clear();
+    sparse_allowed.clear();
+    num_counts = 0;
+    count_table.clear();
+    his_order.clear();
+    dirty_blocks.clear();
+    snapshot_blocks.clear();
+    saturated.clear();
+    promoted.clear();
+    shadow_blocks.clear();
     
     writable = false;
     ofile.close();
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// class MappedHisFile
+///////////////////////////////////////////////////////////////////////////////
+
+const char *MappedHisFile::map_file(const std::string &fname_, size_t &size_){
+    size_ = 0;
+    int fd = ::open(fname_.c_str(), O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    
+    // The mapping stays valid once the file is closed
+    void *addr = MAP_FAILED;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if(size > 0)
+        addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED)
+        return NULL;
+    
+    size_ = size;
+    return (const char*)addr;
+}
+
+MappedHisFile::MappedHisFile(){
+    drr_base = NULL;
+    drr_size = 0;
+    his_base = NULL;
+    his_size = 0;
+}
+
+MappedHisFile::MappedHisFile(const char *prefix_){
+    drr_base = NULL;
+    drr_size = 0;
+    his_base = NULL;
+    his_size = 0;
+    
+    Open(prefix_);
+}
+
+MappedHisFile::~MappedHisFile(){
+    Close();
+}
+
+bool MappedHisFile::Open(const char *prefix_){
+    Close();
+    
+    prefix = prefix_;
+    drr_base = map_file(prefix + ".drr", drr_size);
+    if(!drr_base || drr_size < 128 || strncmp(drr_base, "HHIRFDIR0001", 12) != 0){
+        Close();
+        return false;
+    }
+    
+    // The histogram ids follow the 128 byte header and the 128 byte entries
+    int num_his;
+    memcpy(&num_his, drr_base + 12, 4);
+    if(num_his < 0 || drr_size < 128 + (size_t)num_his*132){
+        Close();
+        return false;
+    }
+    const char *ids = drr_base + 128 + (size_t)num_his*128;
+    for(int i = 0; i < num_his; i++){
+        int his_id;
+        memcpy(&his_id, ids + (size_t)i*4, 4);
+        index.insert(std::make_pair((unsigned int)his_id, 128 + (size_t)i*128));
+    }
+    
+    his_base = map_file(prefix + ".his", his_size);
+    if(!his_base){
+        Close();
+        return false;
+    }
+    
+    // The histograms are read in whatever order they are requested
+    madvise((void*)his_base, his_size, MADV_RANDOM);
+    return true;
+}
+
+void MappedHisFile::Close(){
+    for(std::map<unsigned int, drr_entry*>::iterator iter = entries.begin(); iter != entries.end(); iter++)
+        delete (*iter).second;
+    entries.clear();
+    index.clear();
+    
+    if(drr_base)
+        munmap((void*)drr_base, drr_size);
+    if(his_base)
+        munmap((void*)his_base, his_size);
+    drr_base = NULL;
+    drr_size = 0;
+    his_base = NULL;
+    his_size = 0;
+}
+
+std::vector<unsigned int> MappedHisFile::GetIdList() const {
+    std::vector<unsigned int> ids;
+    ids.reserve(index.size());
+    for(std::map<unsigned int, size_t>::const_iterator iter = index.begin(); iter != index.end(); iter++)
+        ids.push_back((*iter).first);
+    return ids;
+}
+
+const drr_entry *MappedHisFile::GetDrrEntry(unsigned int hisID_){
+    std::map<unsigned int, drr_entry*>::iterator found = entries.find(hisID_);
+    if(found != entries.end())
+        return (*found).second;
+    
+    std::map<unsigned int, size_t>::iterator location = index.find(hisID_);
+    if(location == index.end())
+        return NULL;
+    
+    drr_entry *entry = unpack_entry(drr_base + (*location).second);
+    entry->hisID = hisID_;
+    entries.insert(std::make_pair(hisID_, entry));
+    return entry;
+}
+
+HisView MappedHisFile::GetHistogram(unsigned int hisID_){
+    const drr_entry *entry = GetDrrEntry(hisID_);
+    if(!entry || (entry->hisDim != 1 && entry->hisDim != 2) || !entry->good ||
+       (size_t)entry->offset*2 + entry->total_size > his_size)
+        return HisView();
+    return HisView(his_base + (size_t)entry->offset*2, entry);
+}
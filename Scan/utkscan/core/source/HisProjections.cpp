@@ -0,0 +1,229 @@
+/** \file HisProjections.cpp
+ * \brief Projections, gate sums and rebinning of the histograms in a mapped .his file.
+ */
+#include <algorithm>
+#include <thread>
+
+#include "HisProjections.hpp"
+
+/* Call func_(first, last, sums) for the rows [first, last) of a histogram
+ * with rows_ rows, split between threads_ threads which each fill their own
+ * sums of size_ bins. The sums are then added into output_.
+ */
+template<typename Func>
+static void split_rows(size_t rows_, unsigned int threads_, size_t size_,
+                       std::vector<unsigned long long> &output_, Func func_){
+    size_t num_threads = std::max((size_t)1, std::min((size_t)threads_, rows_));
+    std::vector<std::vector<unsigned long long> > sums(num_threads, std::vector<unsigned long long>(size_, 0));
+    
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < num_threads; i++)
+        workers.push_back(std::thread(func_, rows_*i/num_threads, rows_*(i + 1)/num_threads, std::ref(sums[i])));
+    func_(0, rows_/num_threads, sums[0]);
+    for(std::vector<std::thread>::iterator iter = workers.begin(); iter != workers.end(); iter++)
+        iter->join();
+    
+    output_.assign(size_, 0);
+    for(size_t i = 0; i < num_threads; i++)
+        for(size_t j = 0; j < size_; j++)
+            output_[j] += sums[i][j];
+}
+
+/// Return true if view_ is a valid 2D histogram
+static bool is_matrix(const HisView &view_){
+    return (view_.IsValid() && view_.GetEntry()->hisDim == 2);
+}
+
+his_gate RangeGate(unsigned int xlow_, unsigned int xhigh_, unsigned int ylow_, unsigned int yhigh_){
+    return [=](unsigned int x_, unsigned int y_){
+        return (x_ >= xlow_ && x_ <= xhigh_ && y_ >= ylow_ && y_ <= yhigh_);
+    };
+}
+
+his_gate BananaGate(const drr_entry *entry_, int ban_id_){
+    double xcomp = entry_->comp[0];
+    double ycomp = entry_->comp[1];
+    return [=](unsigned int x_, unsigned int y_){
+        return bantesti_(ban_id_, x_*xcomp, y_*ycomp);
+    };
+}
+
+bool Project(const HisView &view_, bool onto_x_, const his_gate &gate_,
+             std::vector<unsigned long long> &output_, unsigned int threads_/*=1*/){
+    if(!is_matrix(view_))
+        return false;
+    
+    const size_t xsize = view_.GetEntry()->scaled[0];
+    const size_t ysize = view_.GetEntry()->scaled[1];
+    split_rows(ysize, threads_, onto_x_ ? xsize : ysize, output_,
+        [&](size_t first_, size_t last_, std::vector<unsigned long long> &sums_){
+            for(size_t y = first_; y < last_; y++){
+                for(size_t x = 0; x < xsize; x++){
+                    if(gate_(x, y))
+                        sums_[onto_x_ ? x : y] += view_.Get(y*xsize + x);
+                }
+            }
+        });
+    return true;
+}
+
+bool ProjectRange(const HisView &view_, bool onto_x_, unsigned int low_, unsigned int high_,
+                  std::vector<unsigned long long> &output_, unsigned int threads_/*=1*/){
+    if(!is_matrix(view_))
+        return false;
+    
+    const size_t xsize = view_.GetEntry()->scaled[0];
+    const size_t ysize = view_.GetEntry()->scaled[1];
+    if(onto_x_){ // Only the rows inside the range are read
+        size_t first = std::min((size_t)low_, ysize);
+        size_t last = std::max(first, std::min((size_t)high_ + 1, ysize));
+        split_rows(last - first, threads_, xsize, output_,
+            [&](size_t first_, size_t last_, std::vector<unsigned long long> &sums_){
+                for(size_t y = first + first_; y < first + last_; y++)
+                    for(size_t x = 0; x < xsize; x++)
+                        sums_[x] += view_.Get(y*xsize + x);
+            });
+    }
+    else{
+        size_t first = std::min((size_t)low_, xsize);
+        size_t last = std::max(first, std::min((size_t)high_ + 1, xsize));
+        split_rows(ysize, threads_, ysize, output_,
+            [&](size_t first_, size_t last_, std::vector<unsigned long long> &sums_){
+                for(size_t y = first_; y < last_; y++)
+                    for(size_t x = first; x < last; x++)
+                        sums_[y] += view_.Get(y*xsize + x);
+            });
+    }
+    return true;
+}
+
+unsigned long long GateSum(const HisView &view_, const his_gate &gate_, unsigned int threads_/*=1*/){
+    if(!is_matrix(view_))
+        return 0;
+    
+    const size_t xsize = view_.GetEntry()->scaled[0];
+    std::vector<unsigned long long> sum;
+    split_rows(view_.GetEntry()->scaled[1], threads_, 1, sum,
+        [&](size_t first_, size_t last_, std::vector<unsigned long long> &sums_){
+            for(size_t y = first_; y < last_; y++)
+                for(size_t x = 0; x < xsize; x++)
+                    if(gate_(x, y))
+                        sums_[0] += view_.Get(y*xsize + x);
+        });
+    return sum[0];
+}
+
+void Rebin(const std::vector<unsigned long long> &input_, unsigned int factor_,
+           std::vector<unsigned long long> &output_){
+    if(factor_ == 0)
+        factor_ = 1;
+    output_.assign((input_.size() + factor_ - 1)/factor_, 0);
+    for(size_t i = 0; i < input_.size(); i++)
+        output_[i/factor_] += input_[i];
+}
+
+/* Fill perms_ with the distinct orderings of the sorted bins x_ <= y_ <= z_,
+ * which are the bins of the full symmetric cube one entry of a GammaCube
+ * stands for. Returns the number of orderings.
+ */
+static unsigned int orderings(unsigned int x_, unsigned int y_, unsigned int z_,
+                              unsigned int perms_[6][3]){
+    unsigned int num = 0;
+    if(x_ == z_){ // All three are the same
+        perms_[num][0] = x_; perms_[num][1] = x_; perms_[num++][2] = x_;
+    }
+    else if(x_ == y_ || y_ == z_){ // Two are the same, the odd one goes in each place
+        unsigned int odd = (x_ == y_ ? z_ : x_);
+        unsigned int pair = y_;
+        perms_[num][0] = odd; perms_[num][1] = pair; perms_[num++][2] = pair;
+        perms_[num][0] = pair; perms_[num][1] = odd; perms_[num++][2] = pair;
+        perms_[num][0] = pair; perms_[num][1] = pair; perms_[num++][2] = odd;
+    }
+    else{
+        const unsigned int bins[3] = {x_, y_, z_};
+        static const unsigned int order[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2},
+                                                 {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+        for(; num < 6; num++)
+            for(unsigned int i = 0; i < 3; i++)
+                perms_[num][i] = bins[order[num][i]];
+    }
+    return num;
+}
+
+bool ProjectCube(const GammaCube &cube_, unsigned int low_, unsigned int high_,
+                 std::vector<unsigned long long> &output_, unsigned int threads_/*=1*/){
+    const size_t size = cube_.GetSize();
+    const size_t slots = cube_.GetNumSlots();
+    if(low_ > high_ || low_ >= size)
+        return false;
+    
+    /* A matrix per thread would be as large as the output, so the threads
+     * collect the bins they fill, which are few for a narrow gate. */
+    size_t num_threads = std::max((size_t)1, std::min((size_t)threads_, slots));
+    std::vector<std::vector<std::pair<size_t, uint32_t> > > fills(num_threads);
+    auto func = [&](size_t first_, size_t last_, std::vector<std::pair<size_t, uint32_t> > &fills_){
+        unsigned int x, y, z, perms[6][3];
+        for(size_t slot = first_; slot < last_; slot++){
+            uint32_t counts = cube_.GetSlot(slot, x, y, z);
+            if(counts == 0 || ((x < low_ || x > high_) && (y < low_ || y > high_) &&
+                               (z < low_ || z > high_)))
+                continue;
+            unsigned int num = orderings(x, y, z, perms);
+            for(unsigned int i = 0; i < num; i++)
+                if(perms[i][2] >= low_ && perms[i][2] <= high_)
+                    fills_.push_back(std::make_pair(perms[i][1]*size + perms[i][0], counts));
+        }
+    };
+    
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < num_threads; i++)
+        workers.push_back(std::thread(func, slots*i/num_threads, slots*(i + 1)/num_threads, std::ref(fills[i])));
+    func(0, slots/num_threads, fills[0]);
+    for(std::vector<std::thread>::iterator iter = workers.begin(); iter != workers.end(); iter++)
+        iter->join();
+    
+    output_.assign(size*size, 0);
+    for(size_t i = 0; i < num_threads; i++)
+        for(std::vector<std::pair<size_t, uint32_t> >::const_iterator iter = fills[i].begin(); iter != fills[i].end(); iter++)
+            output_[iter->first] += iter->second;
+    return true;
+}
+
+bool ProjectCube(const GammaCube &cube_, unsigned int low1_, unsigned int high1_,
+                 unsigned int low2_, unsigned int high2_,
+                 std::vector<unsigned long long> &output_, unsigned int threads_/*=1*/){
+    if(low1_ > high1_ || low2_ > high2_)
+        return false;
+    split_rows(cube_.GetNumSlots(), threads_, cube_.GetSize(), output_,
+        [&](size_t first_, size_t last_, std::vector<unsigned long long> &sums_){
+            unsigned int x, y, z, perms[6][3];
+            for(size_t slot = first_; slot < last_; slot++){
+                uint32_t counts = cube_.GetSlot(slot, x, y, z);
+                if(counts == 0)
+                    continue;
+                unsigned int num = orderings(x, y, z, perms);
+                for(unsigned int i = 0; i < num; i++)
+                    if(perms[i][1] >= low1_ && perms[i][1] <= high1_ &&
+                       perms[i][2] >= low2_ && perms[i][2] <= high2_)
+                        sums_[perms[i][0]] += counts;
+            }
+        });
+    return true;
+}
+
+bool ProjectCube(const GammaCube &cube_, std::vector<unsigned long long> &output_,
+                 unsigned int threads_/*=1*/){
+    split_rows(cube_.GetNumSlots(), threads_, cube_.GetSize(), output_,
+        [&](size_t first_, size_t last_, std::vector<unsigned long long> &sums_){
+            unsigned int x, y, z, perms[6][3];
+            for(size_t slot = first_; slot < last_; slot++){
+                uint32_t counts = cube_.GetSlot(slot, x, y, z);
+                if(counts == 0)
+                    continue;
+                unsigned int num = orderings(x, y, z, perms);
+                for(unsigned int i = 0; i < num; i++)
+                    sums_[perms[i][0]] += counts;
+            }
+        });
+    return true;
+}
@@ -0,0 +1,362 @@
+/** \file HisServer.cpp
+ * \brief Serves the histograms of the scan over HTTP while it is running
+ */
+#include <algorithm>
+#include <sstream>
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "HisFile.hpp"
+#include "HisServer.hpp"
+
+using namespace std;
+
+namespace {
+    template<typename T>
+    void WritePod(string &out, const T &val) {
+        out.append((const char*)&val, sizeof(T));
+    }
+
+    /** \return the value of a parameter of the query of a path, or an empty
+    * string if it is not given */
+    string QueryValue(const string &path, const string &name) {
+        size_t query = path.find('?');
+        if (query == string::npos)
+            return "";
+        stringstream params(path.substr(query + 1));
+        string param;
+        while (getline(params, param, '&'))
+            if (param.compare(0, name.size() + 1, name + "=") == 0)
+                return param.substr(name.size() + 1);
+        return "";
+    }
+}
+
+HisServer::HisServer() : listenSock_(-1), running_(false), requests_(0),
+    version_(0), layout_(0) {
+}
+
+bool HisServer::Init(int port) {
+    if (running_)
+        return false;
+
+    listenSock_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSock_ < 0)
+        return false;
+
+    int reuse = 1;
+    setsockopt(listenSock_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in serv;
+    memset(&serv, 0, sizeof(serv));
+    serv.sin_family = AF_INET;
+    serv.sin_addr.s_addr = INADDR_ANY;
+    serv.sin_port = htons(port);
+
+    if (bind(listenSock_, (struct sockaddr *)&serv, sizeof(serv)) < 0 ||
+        listen(listenSock_, 8) < 0) {
+        close(listenSock_);
+        listenSock_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    thread_ = thread(&HisServer::Serve, this);
+    return true;
+}
+
+void HisServer::Close() {
+    if (!running_)
+        return;
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+    close(listenSock_);
+    listenSock_ = -1;
+}
+
+void HisServer::SetLayout(const vector<drr_entry*> &order, size_t size) {
+    lock_guard<mutex> lock(mutex_);
+    entries_.clear();
+    for (vector<drr_entry*>::const_iterator it = order.begin();
+         it != order.end(); ++it) {
+        const drr_entry *entry = *it;
+        string title(entry->title, strnlen(entry->title, 40));
+        title.erase(title.find_last_not_of(' ') + 1);
+        stringstream line;
+        line << entry->hisID << " " << entry->hisDim << " "
+             << entry->halfWords << " " << entry->scaled[0] << " "
+             << (entry->hisDim > 1 ? entry->scaled[1] : 1) << " "
+             << entry->offset * 2 << " " << title;
+        Entry e;
+        e.id = entry->hisID;
+        e.line = line.str();
+        e.offset = (size_t)entry->offset * 2;
+        e.size = entry->total_size;
+        entries_.push_back(e);
+    }
+
+    //! Viewers with an older layout get every page of the new one
+    image_.assign(size, 0);
+    pageVersions_.assign((size + pageSize - 1) / pageSize, version_ + 1);
+    layout_++;
+}
+
+void HisServer::Update(size_t offset, const char *bytes, size_t len) {
+    lock_guard<mutex> lock(mutex_);
+    if (len == 0 || offset + len > image_.size())
+        return;
+    memcpy(&image_[offset], bytes, len);
+    for (size_t i = offset / pageSize; i <= (offset + len - 1) / pageSize; i++)
+        pageVersions_[i] = version_ + 1;
+}
+
+void HisServer::Compare(const char *image, size_t len) {
+    lock_guard<mutex> lock(mutex_);
+    len = min(len, image_.size());
+    for (size_t offset = 0; offset < len; offset += pageSize) {
+        size_t n = min(pageSize, len - offset);
+        if (memcmp(&image_[offset], image + offset, n) == 0)
+            continue;
+        memcpy(&image_[offset], image + offset, n);
+        pageVersions_[offset / pageSize] = version_ + 1;
+    }
+}
+
+void HisServer::SetRolling(unsigned int id, unsigned int xSize,
+                           unsigned int ySize, unsigned int slices,
+                           unsigned int seconds,
+                           const vector<unsigned int> &counts) {
+    lock_guard<mutex> lock(mutex_);
+    RollingEntry &entry = pendingRolling_[id];
+    memcpy(entry.head.magic, "UKHR", 4);
+    entry.head.id = id;
+    entry.head.xSize = xSize;
+    entry.head.ySize = ySize;
+    entry.head.slices = slices;
+    entry.head.seconds = seconds;
+    entry.head.version = version_ + 1;
+    entry.counts.assign(counts.begin(), counts.end());
+}
+
+void HisServer::Commit() {
+    lock_guard<mutex> lock(mutex_);
+    version_++;
+    //! The windows are only served once committed, like the pages
+    for (map<unsigned int, RollingEntry>::iterator it =
+             pendingRolling_.begin(); it != pendingRolling_.end(); ++it) {
+        RollingEntry &entry = rolling_[it->first];
+        entry.head = it->second.head;
+        entry.counts.swap(it->second.counts);
+    }
+    pendingRolling_.clear();
+}
+
+void HisServer::Serve() {
+    struct pollfd pfd;
+    pfd.fd = listenSock_;
+    pfd.events = POLLIN;
+
+    while (running_) {
+        //! Wake up regularly to check if the server has been closed
+        if (poll(&pfd, 1, 100) <= 0 || !(pfd.revents & POLLIN))
+            continue;
+
+        int sock = accept(listenSock_, NULL, NULL);
+        if (sock < 0)
+            continue;
+
+        //! A viewer which stalls may not hold up the next one for long
+        struct timeval tv;
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        Answer(sock);
+        close(sock);
+    }
+}
+
+void HisServer::Answer(int sock) {
+    //! Read up to the end of the request headers, the body of a GET is empty
+    string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == string::npos &&
+           request.find("\n\n") == string::npos) {
+        ssize_t nBytes = recv(sock, buffer, sizeof(buffer), 0);
+        if (nBytes <= 0)
+            return;
+        request.append(buffer, nBytes);
+        if (request.size() > 8192)
+            return;
+    }
+
+    string method, path;
+    stringstream line(request.substr(0, request.find('\n')));
+    line >> method >> path;
+
+    string headers = request;
+    transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+    size_t accept = headers.find("\naccept-encoding:");
+    bool deflate = accept != string::npos &&
+        headers.substr(accept, headers.find('\n', accept + 1) - accept)
+            .find("deflate") != string::npos;
+
+    string status = "200 OK";
+    string type = "text/plain";
+    string body;
+    if (method != "GET" && method != "HEAD") {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported\n";
+    } else if (path == "/list" || path == "/") {
+        body = List();
+    } else if (path == "/counts" || path.compare(0, 8, "/counts?") == 0) {
+        string id = QueryValue(path, "id");
+        body = Counts(strtoull(QueryValue(path, "since").c_str(), NULL, 10),
+                      id.empty() ? -1 : strtoll(id.c_str(), NULL, 10));
+        type = "application/octet-stream";
+    } else if (path == "/rolling" || path.compare(0, 9, "/rolling?") == 0) {
+        string id = QueryValue(path, "id");
+        body = Rolling(id.empty() ? -1 : strtoll(id.c_str(), NULL, 10));
+        if (!id.empty()) {
+            type = "application/octet-stream";
+            if (body.empty()) {
+                status = "404 Not Found";
+                body = "The histogram is not rolling\n";
+            }
+        }
+    } else {
+        status = "404 Not Found";
+        body = "The histograms are listed at /list and served at /counts\n";
+    }
+
+    string encoding;
+#ifdef USE_ZLIB
+    if (deflate && status[0] == '2' && !body.empty()) {
+        uLongf len = compressBound(body.size());
+        string packed(len, '\0');
+        if (compress2((Bytef*)&packed[0], &len, (const Bytef*)body.data(),
+                      body.size(), Z_BEST_SPEED) == Z_OK) {
+            packed.resize(len);
+            body.swap(packed);
+            encoding = "Content-Encoding: deflate\r\n";
+        }
+    }
+#endif
+
+    stringstream reply;
+    reply << "HTTP/1.0 " << status << "\r\n";
+    reply << "Content-Type: " << type << "\r\n";
+    reply << encoding;
+    reply << "Content-Length: " << body.size() << "\r\n";
+    reply << "Connection: close\r\n\r\n";
+    string output = reply.str();
+    if (method != "HEAD")
+        output += body;
+
+    size_t sent = 0;
+    while (sent < output.size()) {
+        ssize_t nBytes = send(sock, output.data() + sent, output.size() - sent,
+                              MSG_NOSIGNAL);
+        if (nBytes <= 0)
+            return;
+        sent += nBytes;
+    }
+    if (status[0] == '2')
+        requests_++;
+}
+
+string HisServer::List() {
+    lock_guard<mutex> lock(mutex_);
+    stringstream list;
+    list << "layout " << layout_ << " version " << version_ << " size "
+         << image_.size() << "\n";
+    for (vector<Entry>::const_iterator it = entries_.begin();
+         it != entries_.end(); ++it)
+        list << it->line << "\n";
+    return list.str();
+}
+
+string HisServer::Counts(uint64_t since, long long id) {
+    lock_guard<mutex> lock(mutex_);
+    size_t lo = 0, hi = image_.size();
+    if (id >= 0) {
+        lo = hi = 0;
+        for (vector<Entry>::const_iterator it = entries_.begin();
+             it != entries_.end(); ++it) {
+            if (it->id == (unsigned long long)id) {
+                lo = it->offset;
+                hi = it->offset + it->size;
+                break;
+            }
+        }
+    }
+
+    //! Consecutive changed pages are sent as one run, pending updates which
+    //! were not committed yet are left to the next fetch
+    string runs;
+    uint32_t numRuns = 0;
+    size_t page = lo / pageSize;
+    while (lo < hi) {
+        size_t start = lo;
+        while (lo < hi && (pageVersions_[page] <= since ||
+                           pageVersions_[page] > version_)) {
+            lo = min(hi, (++page) * pageSize);
+            start = lo;
+        }
+        while (lo < hi && pageVersions_[page] > since &&
+               pageVersions_[page] <= version_)
+            lo = min(hi, (++page) * pageSize);
+        if (lo == start)
+            break;
+        WritePod(runs, (uint64_t)start);
+        WritePod(runs, (uint32_t)(lo - start));
+        runs.append(&image_[start], lo - start);
+        numRuns++;
+    }
+
+    Header head;
+    memcpy(head.magic, "UKHS", 4);
+    head.layout = layout_;
+    head.version = version_;
+    head.size = image_.size();
+    head.numRuns = numRuns;
+    head.pageSize = pageSize;
+    string body;
+    WritePod(body, head);
+    return body + runs;
+}
+
+string HisServer::Rolling(long long id) {
+    lock_guard<mutex> lock(mutex_);
+    if (id < 0) {
+        stringstream list;
+        for (map<unsigned int, RollingEntry>::const_iterator it =
+                 rolling_.begin(); it != rolling_.end(); ++it)
+            list << it->first << " " << it->second.head.xSize << " "
+                 << it->second.head.ySize << " " << it->second.head.slices
+                 << " " << it->second.head.seconds << "\n";
+        return list.str();
+    }
+
+    map<unsigned int, RollingEntry>::const_iterator it = rolling_.find(id);
+    if (it == rolling_.end())
+        return "";
+    string body;
+    WritePod(body, it->second.head);
+    if (!it->second.counts.empty())
+        body.append((const char*)&it->second.counts[0],
+                    it->second.counts.size() * sizeof(uint32_t));
+    return body;
+}
@@ -9,6 +9,52 @@
 
 using namespace std;
 
+const unsigned int SymbolTable::NOT_FOUND;
+const unsigned int Identifier::TAG_BITS;
+
+unsigned int SymbolTable::Intern(const std::string &s) {
+    map<string, unsigned int>::const_iterator it = ids.find(s);
+    if (it != ids.end())
+        return it->second;
+
+    unsigned int id = names.size();
+    names.push_back(s);
+    ids.insert(make_pair(s, id));
+    return id;
+}
+
+unsigned int SymbolTable::Find(const std::string &s) const {
+    map<string, unsigned int>::const_iterator it = ids.find(s);
+    if (it == ids.end())
+        return NOT_FOUND;
+    return it->second;
+}
+
+SymbolTable& Identifier::Names() {
+    static SymbolTable names;
+    return names;
+}
+
+SymbolTable& Identifier::Tags() {
+    static SymbolTable tags;
+    return tags;
+}
+
+void Identifier::AddTag(const std::string &s, int n) {
+    tag[s] = n;
+    unsigned int id = Tags().Intern(s);
+    if (id < TAG_BITS)
+        tagBits |= (1ULL << id);
+}
+
+Identifier::Identifier(const std::string &type, const std::string &subType,
+                       const int &loc) {
+    Zero();
+    SetType(type);
+    SetSubtype(subType);
+    location = loc;
+}
+
 int Identifier::GetTag(const std::string &s) const {
     map<string, int>::const_iterator it = tag.find(s);
 
@@ -21,10 +67,12 @@ int Identifier::GetTag(const std::string &s) const {
 void Identifier::Zero() {
     dammID   = -1;
     location = -1;
-    type     = "";
-    subtype  = "";
+    threshold = 0;
+    type     = 0;
+    subtype  = 0;
 
     tag.clear();
+    tagBits  = 0;
 }
 
 void Identifier::PrintHeaders(void) {
@@ -36,8 +84,8 @@ void Identifier::PrintHeaders(void) {
 }
 
 void Identifier::Print(void) const {
-    cout << setw(10) << type
-	 << setw(10) << subtype
+    cout << setw(10) << GetType()
+	 << setw(10) << GetSubtype()
 	 << setw(4)  << location
 	 << setw(6)  << dammID
 	 << "    ";
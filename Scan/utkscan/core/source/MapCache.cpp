@@ -0,0 +1,245 @@
+/** \file MapCache.cpp
+ * \brief The channel map, calibrations and walk corrections of the
+ * configuration, kept in a binary cache file next to it
+ */
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+#include "Globals.hpp"
+#include "MapCache.hpp"
+#include "Messenger.hpp"
+
+using namespace std;
+
+namespace {
+    const uint32_t cacheMagic = 0x504D4B55; //!< "UKMP"
+    const uint32_t cacheVersion = 2; //!< bumped whenever the records change
+    const uint32_t maxLength = 1 << 20; //!< sanity limit on read lengths
+
+    template<typename T>
+    void WritePod(ofstream &out, const T &val) {
+        out.write((const char*)&val, sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadPod(ifstream &in, T &val) {
+        return (bool)in.read((char*)&val, sizeof(T));
+    }
+
+    void WriteString(ofstream &out, const string &str) {
+        WritePod(out, (uint32_t)str.size());
+        out.write(str.data(), str.size());
+    }
+
+    bool ReadString(ifstream &in, string &str) {
+        uint32_t len;
+        if (!ReadPod(in, len) || len > maxLength)
+            return false;
+        str.resize(len);
+        return len == 0 || (bool)in.read(&str[0], len);
+    }
+
+    /** Read the whitespace separated parameters of a node */
+    vector<double> ReadParameters(const pugi::xml_node &node) {
+        stringstream pars(node.text().as_string());
+        vector<double> parameters;
+        while (true) {
+            double p;
+            pars >> p;
+            if (pars)
+                parameters.push_back(p);
+            else
+                break;
+        }
+        return parameters;
+    }
+}
+
+MapCache* MapCache::instance = NULL;
+
+MapCache* MapCache::get() {
+    if (!instance)
+        instance = new MapCache();
+    return instance;
+}
+
+MapCache::MapCache() : fromCache_(false), verboseMap_(false),
+    verboseCal_(false), verboseWalk_(false) {
+    string name = Globals::get()->configfile() + ".cache";
+    uint64_t hash = Globals::get()->confighash();
+
+    fromCache_ = Read(name, hash);
+    if (fromCache_) {
+        Messenger m;
+        m.detail("Read the channel map from " + name);
+        return;
+    }
+
+    channels_.clear();
+    Build(Globals::get()->configdoc());
+    Write(name, hash);
+}
+
+void MapCache::Build(const pugi::xml_document &doc) {
+    pugi::xml_node map = doc.child("Configuration").child("Map");
+    verboseMap_ = map.attribute("verbose_map").as_bool();
+    verboseCal_ = map.attribute("verbose_calibration").as_bool();
+    verboseWalk_ = map.attribute("verbose_walk").as_bool();
+    ReadChannels(map, channels_);
+}
+
+void MapCache::ReadChannels(const pugi::xml_node &map,
+                            vector<Channel> &channels) {
+    for (pugi::xml_node module = map.child("Module"); module;
+         module = module.next_sibling("Module")) {
+        int module_number = module.attribute("number").as_int(-1);
+        for (pugi::xml_node channel = module.child("Channel"); channel;
+             channel = channel.next_sibling("Channel")) {
+            Channel ch;
+            ch.module = module_number;
+            ch.channel = channel.attribute("number").as_int(-1);
+            ch.type = channel.attribute("type").as_string("None");
+            ch.subtype = channel.attribute("subtype").as_string("None");
+            ch.location = channel.attribute("location").as_int(-1);
+            ch.tags = channel.attribute("tags").as_string("None");
+            ch.threshold = channel.attribute("threshold").as_uint(0);
+
+            for (pugi::xml_node cal = channel.child("Calibration");
+                cal; cal = cal.next_sibling("Calibration")) {
+                Correction corr;
+                corr.model = cal.attribute("model").as_string("None");
+                corr.min = cal.attribute("min").as_double(0);
+                corr.max =
+                  cal.attribute("max").as_double(numeric_limits<double>::max());
+                corr.points = 0;
+                corr.parameters = ReadParameters(cal);
+                ch.calibrations.push_back(corr);
+            }
+
+            for (pugi::xml_node walkcorr = channel.child("WalkCorrection");
+                walkcorr; walkcorr = walkcorr.next_sibling("WalkCorrection")) {
+                Correction corr;
+                corr.model = walkcorr.attribute("model").as_string("None");
+                corr.min = walkcorr.attribute("min").as_double(0);
+                corr.max = walkcorr.attribute("max").as_double(
+                                              numeric_limits<double>::max());
+                corr.points = walkcorr.attribute("points").as_uint(0);
+                corr.parameters = ReadParameters(walkcorr);
+                ch.walks.push_back(corr);
+            }
+
+            channels.push_back(ch);
+        }
+    }
+}
+
+bool MapCache::Read(const string &name, uint64_t hash) {
+    ifstream in(name.c_str(), ios::binary);
+    if (!in.good())
+        return false;
+
+    uint32_t magic, version, numChannels;
+    uint64_t fileHash;
+    uint8_t verbose[3];
+    if (!ReadPod(in, magic) || magic != cacheMagic ||
+        !ReadPod(in, version) || version != cacheVersion ||
+        !ReadPod(in, fileHash) || fileHash != hash ||
+        !in.read((char*)verbose, sizeof(verbose)) ||
+        !ReadPod(in, numChannels) || numChannels > maxLength)
+        return false;
+
+    vector<Channel> channels(numChannels);
+    for (vector<Channel>::iterator it = channels.begin();
+         it != channels.end(); ++it) {
+        int32_t module, channel, location;
+        uint32_t threshold;
+        if (!ReadPod(in, module) || !ReadPod(in, channel) ||
+            !ReadPod(in, location) || !ReadPod(in, threshold) ||
+            !ReadString(in, it->type) ||
+            !ReadString(in, it->subtype) || !ReadString(in, it->tags) ||
+            !ReadCorrections(in, it->calibrations) ||
+            !ReadCorrections(in, it->walks))
+            return false;
+        it->module = module;
+        it->channel = channel;
+        it->location = location;
+        it->threshold = threshold;
+    }
+
+    //! Anything after the records means the file is not what we wrote
+    if (in.peek() != char_traits<char>::eof())
+        return false;
+
+    channels_.swap(channels);
+    verboseMap_ = verbose[0];
+    verboseCal_ = verbose[1];
+    verboseWalk_ = verbose[2];
+    return true;
+}
+
+void MapCache::Write(const string &name, uint64_t hash) const {
+    ofstream out(name.c_str(), ios::binary | ios::trunc);
+    if (!out.good())
+        return;
+
+    uint8_t verbose[3] = {verboseMap_, verboseCal_, verboseWalk_};
+    WritePod(out, cacheMagic);
+    WritePod(out, cacheVersion);
+    WritePod(out, hash);
+    out.write((const char*)verbose, sizeof(verbose));
+    WritePod(out, (uint32_t)channels_.size());
+    for (vector<Channel>::const_iterator it = channels_.begin();
+         it != channels_.end(); ++it) {
+        WritePod(out, (int32_t)it->module);
+        WritePod(out, (int32_t)it->channel);
+        WritePod(out, (int32_t)it->location);
+        WritePod(out, (uint32_t)it->threshold);
+        WriteString(out, it->type);
+        WriteString(out, it->subtype);
+        WriteString(out, it->tags);
+        WriteCorrections(out, it->calibrations);
+        WriteCorrections(out, it->walks);
+    }
+
+    //! A partial file would only be rejected later, so remove it now
+    if (!out.good()) {
+        out.close();
+        remove(name.c_str());
+    }
+}
+
+bool MapCache::ReadCorrections(ifstream &in, vector<Correction> &corrs) {
+    uint32_t num;
+    if (!ReadPod(in, num) || num > maxLength)
+        return false;
+    corrs.resize(num);
+    for (vector<Correction>::iterator it = corrs.begin();
+         it != corrs.end(); ++it) {
+        uint32_t numPars;
+        if (!ReadString(in, it->model) || !ReadPod(in, it->min) ||
+            !ReadPod(in, it->max) || !ReadPod(in, it->points) ||
+            !ReadPod(in, numPars) || numPars > maxLength)
+            return false;
+        it->parameters.resize(numPars);
+        if (numPars > 0 && !in.read((char*)it->parameters.data(),
+                                    numPars * sizeof(double)))
+            return false;
+    }
+    return true;
+}
+
+void MapCache::WriteCorrections(ofstream &out,
+                                const vector<Correction> &corrs) {
+    WritePod(out, (uint32_t)corrs.size());
+    for (vector<Correction>::const_iterator it = corrs.begin();
+         it != corrs.end(); ++it) {
+        WriteString(out, it->model);
+        WritePod(out, it->min);
+        WritePod(out, it->max);
+        WritePod(out, it->points);
+        WritePod(out, (uint32_t)it->parameters.size());
+        out.write((const char*)it->parameters.data(),
+                  it->parameters.size() * sizeof(double));
+    }
+}
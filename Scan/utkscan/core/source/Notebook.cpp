@@ -1,6 +1,8 @@
+#include <iostream>
 #include <sstream>
 #include <string>
 
+#include <cstdlib>
 #include <ctime>
 
 #include "Exceptions.hpp"
@@ -14,21 +16,13 @@ Notebook* Notebook::instance = NULL;
 Notebook* Notebook::get() {
     if (!instance) {
         instance = new Notebook();
+        std::atexit(Notebook::close);
     }
     return instance;
 }
 
-Notebook::Notebook() {
-    std::string cfg = Globals::get()->configfile();
-    pugi::xml_document doc;
-
-    pugi::xml_parse_result result = doc.load_file(cfg.c_str());
-    if (!result) {
-        std::stringstream ss;
-        ss << "Notebook: error parsing file " << cfg;
-        ss << " : " << result.description();
-        throw IOException(ss.str());
-    }
+Notebook::Notebook() : writing_(false), stop_(false) {
+    const pugi::xml_document &doc = Globals::get()->configdoc();
 
     pugi::xml_node note = doc.child("Configuration").child("Notebook");
 
@@ -38,12 +32,10 @@ Notebook::Notebook() {
     Messenger m;
     m.detail("Notebook: " + file_name_ + " mode: " + mode_);
 
-    std::ofstream note_file;
-
     if (mode_ == "r") {
-        note_file.open(file_name_.c_str(), std::ios::out);
+        file_.open(file_name_.c_str(), std::ios::out);
     } else if (mode_ == "a") {
-        note_file.open(file_name_.c_str(), std::ios::out | std::ios::app);
+        file_.open(file_name_.c_str(), std::ios::out | std::ios::app);
     } else {
         std::stringstream ss;
         ss << "Notebook: unknown mode";
@@ -51,14 +43,15 @@ Notebook::Notebook() {
         throw IOException(ss.str());
     }
 
-    if (!note_file.good()) {
+    if (!file_.good()) {
         std::stringstream ss;
         ss << "Notebook: error opening output file";
         ss << " : " << file_name_;
         throw IOException(ss.str());
     }
-    note_file << "# Starting notebook on : " << currentDateTime() << std::endl;
-    note_file.close();
+    file_ << "# Starting notebook on : " << currentDateTime() << std::endl;
+
+    writer_ = std::thread(&Notebook::write_notes, this);
 }
 
 const std::string Notebook::currentDateTime() const {
@@ -70,20 +63,64 @@ const std::string Notebook::currentDateTime() const {
     return buf;
 }
 
-void Notebook::report(std::string note) {
-    std::ofstream note_file;
-    note_file.open(file_name_.c_str(), std::ios::out | std::ios::app);
-    if (!note_file.good()) {
-        std::stringstream ss;
-        ss << "Notebook: error opening output file";
-        ss << " : " << file_name_;
-        throw IOException(ss.str());
+void Notebook::report(const std::string &note) {
+    push([note](std::ostream &out) { out << note; });
+}
+
+void Notebook::push(std::function<void(std::ostream &)> &&note) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(note));
     }
-    note_file << note << std::endl;
-    note_file.close();
+    ready_.notify_one();
 }
 
-Notebook::~Notebook() {
+void Notebook::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    written_.wait(lock, [this] { return queue_.empty() && !writing_; });
+}
+
+/// The notes are taken from the queue in batches and the file is flushed
+/// after each batch, so a note is on disk soon after it is reported without
+/// the file being flushed for every note.
+void Notebook::write_notes() {
+    std::deque<std::function<void(std::ostream &)> > notes;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty())
+            break;
+        notes.swap(queue_);
+        writing_ = true;
+        lock.unlock();
+
+        for (size_t i = 0; i < notes.size(); i++) {
+            notes[i](file_);
+            file_ << '\n';
+        }
+        file_.flush();
+        if (!file_.good())
+            std::cerr << "Notebook: error writing to " << file_name_ << std::endl;
+        notes.clear();
+
+        lock.lock();
+        writing_ = false;
+        written_.notify_all();
+    }
+}
+
+void Notebook::close() {
     delete instance;
     instance = NULL;
 }
+
+Notebook::~Notebook() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    ready_.notify_all();
+    if (writer_.joinable())
+        writer_.join();
+    file_.close();
+}
@@ -0,0 +1,36 @@
+/** \file OutputService.cpp
+ * \brief Record streams shared by the processors, written in the background
+ */
+#include <iostream>
+
+#include "Globals.hpp"
+#include "OutputService.hpp"
+
+using namespace std;
+
+ColumnWriter *OutputService::Open(const std::string &name) {
+    map<string, ColumnWriter *>::iterator it = streams_.find(name);
+    if (it != streams_.end())
+        return it->second;
+
+    string fileName = Globals::get()->outputPath(name + ".col");
+    ColumnWriter *stream = new ColumnWriter(fileName, chunkSize_, level_,
+                                            true);
+    if (!stream->IsOpen()) {
+        delete stream;
+        return NULL;
+    }
+    streams_[name] = stream;
+    return stream;
+}
+
+void OutputService::Close(void) {
+    for (map<string, ColumnWriter *>::iterator it = streams_.begin();
+         it != streams_.end(); it++) {
+        it->second->Close();
+        cout << "Wrote " << it->second->GetEntries() << " records to the "
+             << it->first << " stream" << endl;
+        delete it->second;
+    }
+    streams_.clear();
+}
@@ -3,6 +3,7 @@
 * \author K. A. Miernik
 * \date October 22, 2012
 */
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <map>
@@ -12,6 +13,56 @@
 
 using namespace std;
 
+namespace {
+    template<typename T>
+    void WritePod(ostream &out, const T &val) {
+        out.write((const char*)&val, sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadPod(istream &in, T &val) {
+        return (bool)in.read((char*)&val, sizeof(T));
+    }
+}
+
+vector<Place*> Place::dirtyPlaces_;
+bool Place::propagating_ = false;
+
+void Place::report_(EventData& info) {
+    for (vector<Place*>::iterator it = parents_.begin();
+         it != parents_.end(); ++it) {
+        (*it)->pendingInfo_ = info;
+        if (!(*it)->dirty_) {
+            (*it)->dirty_ = true;
+            dirtyPlaces_.push_back(*it);
+            push_heap(dirtyPlaces_.begin(), dirtyPlaces_.end(),
+                      checkedAfter_);
+        }
+    }
+
+    if (propagating_)
+        return;
+
+    propagating_ = true;
+    try {
+        while (!dirtyPlaces_.empty()) {
+            pop_heap(dirtyPlaces_.begin(), dirtyPlaces_.end(), checkedAfter_);
+            Place* next = dirtyPlaces_.back();
+            dirtyPlaces_.pop_back();
+            next->dirty_ = false;
+            next->check_(next->pendingInfo_);
+        }
+    } catch (...) {
+        for (vector<Place*>::iterator it = dirtyPlaces_.begin();
+             it != dirtyPlaces_.end(); ++it)
+            (*it)->dirty_ = false;
+        dirtyPlaces_.clear();
+        propagating_ = false;
+        throw;
+    }
+    propagating_ = false;
+}
+
 bool Place::checkParents(Place* child) {
     bool isAllDifferent = true;
     vector<Place*>::iterator it;
@@ -46,6 +97,44 @@ void Place::addChild (Place* child, bool relation) {
     }
 }
 
+void Place::save(ostream& out) const {
+    WritePod(out, status_);
+    WritePod(out, (uint32_t)info_.size());
+    for (size_t i = 0; i < info_.size(); ++i) {
+        const EventData &info = info_[i];
+        WritePod(out, info.status);
+        WritePod(out, info.time);
+        WritePod(out, info.energy);
+        WritePod(out, (int32_t)info.location);
+        WritePod(out, (uint32_t)info.type.size());
+        out.write(info.type.data(), info.type.size());
+    }
+}
+
+bool Place::load(istream& in) {
+    uint32_t size;
+    if (!ReadPod(in, status_) || !ReadPod(in, size) ||
+        size > info_.capacity())
+        return false;
+
+    info_.clear();
+    for (uint32_t i = 0; i < size; ++i) {
+        EventData info(-1);
+        int32_t location;
+        uint32_t length;
+        if (!ReadPod(in, info.status) || !ReadPod(in, info.time) ||
+            !ReadPod(in, info.energy) || !ReadPod(in, location) ||
+            !ReadPod(in, length) || length > 4096)
+            return false;
+        info.location = location;
+        info.type.resize(length);
+        if (length > 0 && !in.read(&info.type[0], length))
+            return false;
+        info_.push_back(info);
+    }
+    return true;
+}
+
 void PlaceOR::check_(EventData& info) {
     if (children_.size() > 0) {
         bool result = (children_[0].first->status() == children_[0].second);
@@ -94,6 +183,19 @@ void PlaceCounter::check_(EventData& info) {
     }
 }
 
+void PlaceCounter::save(ostream& out) const {
+    Place::save(out);
+    WritePod(out, (int32_t)counter_);
+}
+
+bool PlaceCounter::load(istream& in) {
+    int32_t counter;
+    if (!Place::load(in) || !ReadPod(in, counter))
+        return false;
+    counter_ = counter;
+    return true;
+}
+
 void PlaceAND::check_(EventData& info) {
     if (children_.size() > 0) {
         bool result = (children_[0].first->status() == children_[0].second);
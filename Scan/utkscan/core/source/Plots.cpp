@@ -8,19 +8,37 @@
 #include <cmath>
 #include <cstring>
 
+#include "BananaGates.hpp"
 #include "Plots.hpp"
 
 using namespace std;
 
+namespace {
+    /** Number of bins a thread buffers before merging them by itself */
+    const size_t kMaxBufferedBins = 4096;
+}
+
+bool Plots::concurrent_ = false;
+bool Plots::deterministic_ = false;
+std::vector<Plots::FillBuffer*> Plots::slots_;
+std::mutex Plots::fillMutex_;
+std::vector<Plots::FillBuffer*> Plots::buffers_;
+thread_local Plots::FillBuffer *Plots::buffer_ = NULL;
+
 Plots::Plots(int offset, int range, std::string name) {
     offset_ = offset;
     range_  = range;
     name_ = name;
+    idList_.assign(range_ > 0 ? range_ : 0, false);
     PlotsRegister::get()->Add(offset_, range_, name_);
 }
 
 bool Plots::BananaTest(const int &id, const double &x, const double &y) {
+#ifndef USE_HRIBF
+    return (BananaGates::get()->Test(id, Round(x), Round(y)));
+#else
     return (bantesti_(id, Round(x), Round(y)));
+#endif
 }
 
 /** Check if the id falls within the expected range */
@@ -30,7 +48,7 @@ bool Plots::CheckRange(int id) const {
 
 /** Checks if id is taken */
 bool Plots::Exists(int id) const {
-    return (idList_.count(id) != 0);
+    return (CheckRange(id) && idList_[id]);
 }
 
 bool Plots::Exists(const std::string &mne) const {
@@ -40,6 +58,20 @@ bool Plots::Exists(const std::string &mne) const {
     return (mneList.count(mne) != 0);
 }
 
+Plots::Handle Plots::GetHandle(int id) const {
+    Handle handle;
+    if (Exists(id))
+        handle.id_ = id + offset_;
+    return(handle);
+}
+
+Plots::Handle Plots::GetHandle(const std::string &mne) const {
+    unordered_map<string, int>::const_iterator it = mneList.find(mne);
+    if (it == mneList.end())
+        return(Handle());
+    return(GetHandle(it->second));
+}
+
 /** Constructors based on DeclareHistogram functions. */
 bool Plots::DeclareHistogram1D(int dammId, int xSize, const char* title,
 			       int halfWordsPerChan, int xHistLength,
@@ -59,9 +91,7 @@ bool Plots::DeclareHistogram1D(int dammId, int xSize, const char* title,
         throw HistogramException(ss.str());
     }
 
-    pair<set<int>::iterator, bool> result = idList_.insert(dammId);
-    if (result.second == false)
-        return false;
+    idList_[dammId] = true;
     // Mnemonic is optional and added only if longer then 0
     if (mne.size() > 0)
         mneList.insert( pair<string, int>(mne, dammId) );
@@ -72,7 +102,7 @@ bool Plots::DeclareHistogram1D(int dammId, int xSize, const char* title,
 }
 
 bool Plots::DeclareHistogram1D(int dammId, int xSize, const char* title,
-			       int halfWordsPerChan /* = 2*/,
+			       int halfWordsPerChan /* = 1*/,
 			       const std::string &mne /*=empty*/ ) {
     return DeclareHistogram1D(dammId, xSize, title, halfWordsPerChan,
                               xSize, 0, xSize - 1, mne);
@@ -105,9 +135,7 @@ bool Plots::DeclareHistogram2D(int dammId, int xSize, int ySize,
         throw HistogramException(ss.str());
     }
 
-    pair<set<int>::iterator, bool> result = idList_.insert(dammId);
-    if (result.second == false)
-        return(false);
+    idList_[dammId] = true;
     // Mnemonic is optional and added only if longer then 0
     if (mne.size() > 0)
         mneList.insert( pair<string, int>(mne, dammId) );
@@ -136,6 +164,19 @@ bool Plots::DeclareHistogram2D(int dammId, int xSize, int ySize,
 			      mne );
 }
 
+bool Plots::DeclareHistograms(const HistogramDef *defs, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const HistogramDef &def = defs[i];
+        int halfWords = def.halfWordsPerChan > 0 ? def.halfWordsPerChan : 1;
+        if (def.ySize > 0)
+            DeclareHistogram2D(def.id, def.xSize, def.ySize, def.title,
+                               halfWords);
+        else
+            DeclareHistogram1D(def.id, def.xSize, def.title, halfWords);
+    }
+    return true;
+}
+
 bool Plots::Plot(int dammId, double val1, double val2, double val3,
                  const char* name) {
     // We will not try to plot into histograms that have not been defined
@@ -150,20 +191,118 @@ bool Plots::Plot(int dammId, double val1, double val2, double val3,
         return(false);
     }
 
-    if (val2 == -1 && val3 == -1)
-        count1cc_(dammId + offset_, int(val1), 1);
-    else if  (val3 == -1 || val3 == 0)
-        count1cc_(dammId + offset_, int(val1), int(val2));
-    else
-        set2cc_(dammId + offset_, int(val1), int(val2), int(val3));
+    PlotId(dammId + offset_, val1, val2, val3);
+    return(true);
+}
+
+bool Plots::Plot(const Handle &handle, double val1, double val2,
+                 double val3) {
+    if (!handle.IsValid())
+        return(false);
+    PlotId(handle.id_, val1, val2, val3);
     return(true);
 }
 
+bool Plots::PlotRow(int dammId, int row, const double *values, size_t n) {
+    if (!Exists(dammId))
+        return(false);
+
+#ifndef USE_HRIBF
+    if (!concurrent_ && output_his) {
+        //! The weights are those PlotId gives, a weight of 0 filling with 1
+        static thread_local vector<unsigned int> weights;
+        weights.resize(n);
+        for (size_t i = 0; i < n; i++)
+            weights[i] = (values[i] == -1 || values[i] == 0) ? 1 :
+                int(values[i]);
+        output_his->FillRow(dammId + offset_, row, weights.data(), n);
+        return(true);
+    }
+#endif
+    for (size_t i = 0; i < n; i++)
+        PlotId(dammId + offset_, i, row, values[i]);
+    return(true);
+}
+
+void Plots::PlotId(int id, double val1, double val2, double val3) {
+    if (!concurrent_) {
+        if (val2 == -1 && val3 == -1)
+            count1cc_(id, int(val1), 1);
+        else if  (val3 == -1 || val3 == 0)
+            count1cc_(id, int(val1), int(val2));
+        else
+            set2cc_(id, int(val1), int(val2), int(val3));
+        return;
+    }
+
+    FillKey key = {id, int(val1), val2 == -1 && val3 == -1 ? 1 : int(val2)};
+    Buffer(key, (val3 == -1 || val3 == 0) ? 1 : int(val3));
+}
+
+void Plots::SetConcurrent(bool state) {
+    if (concurrent_ && !state)
+        MergeFills();
+    concurrent_ = state;
+}
+
+void Plots::Fill(const FillKey &key, int weight) {
+    //! set2cc_ adds the weight, as for the fills of Plot with a val3
+    if (weight == 1)
+        count1cc_(key.id, key.x, key.y);
+    else
+        set2cc_(key.id, key.x, key.y, weight);
+}
+
+void Plots::Buffer(const FillKey &key, int weight) {
+    if (!buffer_) {
+        lock_guard<mutex> lock(fillMutex_);
+        buffer_ = new FillBuffer();
+        buffer_->reserve(kMaxBufferedBins);
+        buffers_.push_back(buffer_);
+    }
+
+    (*buffer_)[key] += weight;
+    //! A slot is only merged in its turn, by MergeFills
+    if (!deterministic_ && buffer_->size() >= kMaxBufferedBins) {
+        lock_guard<mutex> lock(fillMutex_);
+        Merge(*buffer_);
+    }
+}
+
+void Plots::Merge(FillBuffer &buffer) {
+    for (FillBuffer::const_iterator it = buffer.begin(); it != buffer.end();
+         it++)
+        Fill(it->first, it->second);
+    buffer.clear();
+}
+
+void Plots::SetDeterministic(bool state, size_t numSlots) {
+    MergeFills();
+    deterministic_ = state;
+    //! The buffers of the slots are kept, as threads may still point at them
+    lock_guard<mutex> lock(fillMutex_);
+    while (slots_.size() < (state ? numSlots : 0)) {
+        slots_.push_back(new FillBuffer());
+        slots_.back()->reserve(kMaxBufferedBins);
+    }
+}
+
+void Plots::MergeFills(void) {
+    lock_guard<mutex> lock(fillMutex_);
+    for (vector<FillBuffer*>::iterator it = buffers_.begin();
+         it != buffers_.end(); it++)
+        Merge(**it);
+    for (vector<FillBuffer*>::iterator it = slots_.begin();
+         it != slots_.end(); it++)
+        Merge(**it);
+}
+
 bool Plots::Plot(const std::string &mne, double val1, double val2, double val3,
                  const char* name) {
-    if (!Exists(mne))
+    unordered_map<string, int>::const_iterator it = mneList.find(mne);
+    if (it == mneList.end())
         return false;
-    return Plot(mneList.find(mne)->second, val1, val2, val3, name);
+    return Plot(it->second, val1, val2, val3, name);
 }
 
 int Plots::Round(double val) const {
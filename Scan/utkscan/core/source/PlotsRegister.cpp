@@ -26,19 +26,13 @@ PlotsRegister::~PlotsRegister() {
 }
 
 bool PlotsRegister::CheckRange (int min, int max) const {
-    bool exists = false;
-
-    unsigned sz = reg.size();
-    for (unsigned id = 0; id < sz; ++id) {
-        if ( (min < reg[id].first && max < reg[id].first) ||
-             (min > reg[id].second && max > reg[id].second) )
-            continue;
-        else {
-            exists = true;
-            break;
-        }
-    }
-    return exists;
+    //! The registered ranges never overlap, so only the last one starting
+    //! at or before max may overlap [min, max]
+    map<int, pair<int, string> >::const_iterator it = reg.upper_bound(max);
+    if (it == reg.begin())
+        return false;
+    --it;
+    return it->second.first >= min;
 }
 
 bool PlotsRegister::Add (int offset, int range, std::string name) {
@@ -73,7 +67,7 @@ bool PlotsRegister::Add (int offset, int range, std::string name) {
         throw HistogramException(ss.str());
     }
 
-    reg.push_back( std::pair<int, int>(min, max) );
+    reg.insert(make_pair(min, make_pair(max, name)));
 
     Messenger m;
     stringstream ss;
@@ -0,0 +1,262 @@
+/** \file ProcessorGraph.cpp
+ * \brief Runs the event processors of an event, concurrently where allowed
+ */
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include "EventProcessor.hpp"
+#include "Messenger.hpp"
+#include "Places.hpp"
+#include "Plots.hpp"
+#include "ProcessorGraph.hpp"
+#include "RandomPool.hpp"
+#include "RawEvent.hpp"
+#include "TreeCorrelator.hpp"
+
+using namespace std;
+
+namespace {
+    /** \return true if the two sets have a name in common */
+    bool Intersects(const set<string> &a, const set<string> &b) {
+        for (set<string>::const_iterator it = a.begin(); it != a.end(); it++)
+            if (b.count(*it) != 0)
+                return(true);
+        return(false);
+    }
+}
+
+ProcessorGraph::ProcessorGraph() : depth_(0), profiler_(NULL),
+                                   deterministic_(false), done_(0),
+                                   stage_(PREPROCESS), event_(NULL),
+                                   stop_(false) {
+}
+
+ProcessorGraph::~ProcessorGraph() {
+    Stop();
+}
+
+set<string> ProcessorGraph::Expand(const set<string> &names, bool parents) {
+    const map<string, Place*> &places = TreeCorrelator::get()->places_;
+    set<string> expanded;
+    vector<Place*> found;
+    for (set<string>::const_iterator it = names.begin(); it != names.end();
+         it++) {
+        if (it->empty() || (*it)[it->size() - 1] != '*') {
+            expanded.insert(*it);
+            map<string, Place*>::const_iterator place = places.find(*it);
+            if (place != places.end())
+                found.push_back(place->second);
+            continue;
+        }
+        string prefix = it->substr(0, it->size() - 1);
+        for (map<string, Place*>::const_iterator place = places.begin();
+             place != places.end(); place++) {
+            if (place->first.compare(0, prefix.size(), prefix) == 0) {
+                expanded.insert(place->first);
+                found.push_back(place->second);
+            }
+        }
+    }
+
+    if (!parents)
+        return(expanded);
+
+    //! Activating a place changes the status of all of its parents
+    map<Place*, string> placeNames;
+    for (map<string, Place*>::const_iterator place = places.begin();
+         place != places.end(); place++)
+        placeNames[place->second] = place->first;
+    set<Place*> visited(found.begin(), found.end());
+    while (!found.empty()) {
+        Place *place = found.back();
+        found.pop_back();
+        for (vector<Place*>::const_iterator it = place->getParents().begin();
+             it != place->getParents().end(); it++) {
+            if (!visited.insert(*it).second)
+                continue;
+            expanded.insert(placeNames[*it]);
+            found.push_back(*it);
+        }
+    }
+    return(expanded);
+}
+
+void ProcessorGraph::Build(const vector<EventProcessor*> &procs,
+                           unsigned int threads, Profiler *profiler,
+                           bool deterministic) {
+    Stop();
+    procs_ = procs;
+    size_t n = procs_.size();
+    deterministic_ = deterministic;
+
+    profiler_ = profiler;
+    timerIds_.clear();
+    for (size_t i = 0; profiler_ && i < n; i++) {
+        timerIds_.push_back(profiler_->Add(procs_[i]->GetName(), "PreProcess"));
+        timerIds_.push_back(profiler_->Add(procs_[i]->GetName(), "Process"));
+    }
+    dependents_.assign(n, vector<size_t>());
+    numDeps_.assign(n, 0);
+    waiting_.assign(n, 0);
+
+    vector<set<string> > reads(n), writes(n);
+    for (size_t i = 0; i < n; i++) {
+        if (!procs_[i]->HasDeclaredAccess())
+            continue;
+        reads[i] = Expand(procs_[i]->GetReadAccess(), false);
+        reads[i].insert(procs_[i]->GetTypes().begin(),
+                        procs_[i]->GetTypes().end());
+        writes[i] = Expand(procs_[i]->GetWriteAccess(), true);
+    }
+
+    vector<unsigned int> level(n, 1);
+    depth_ = (n > 0 ? 1 : 0);
+    for (size_t j = 0; j < n; j++) {
+        for (size_t i = 0; i < j; i++) {
+            bool conflict = !procs_[i]->HasDeclaredAccess() ||
+                            !procs_[j]->HasDeclaredAccess() ||
+                            Intersects(writes[i], reads[j]) ||
+                            Intersects(writes[i], writes[j]) ||
+                            Intersects(writes[j], reads[i]);
+            if (!conflict)
+                continue;
+            dependents_[i].push_back(j);
+            numDeps_[j]++;
+            level[j] = max(level[j], level[i] + 1);
+        }
+        depth_ = max(depth_, level[j]);
+    }
+
+    if (threads < 1)
+        threads = 1;
+    threads = min(threads, (unsigned int)max(n, (size_t)1));
+    Plots::SetConcurrent(threads > 1);
+    //! Slot 0 is left to the fills made outside of the processors
+    Plots::SetDeterministic(deterministic_ && threads > 1, n + 1);
+    stop_ = false;
+    for (unsigned int i = 1; i < threads; i++)
+        workers_.push_back(thread(&ProcessorGraph::Worker, this));
+
+    if (threads > 1) {
+        Messenger m;
+        stringstream ss;
+        ss << "Running " << n << " processors on " << threads
+           << " threads, with at most " << depth_
+           << " processors depending on each other";
+        if (deterministic_)
+            ss << ", with reproducible random numbers and fills";
+        m.detail(ss.str());
+    }
+}
+
+void ProcessorGraph::Run(RawEvent &event) {
+    if (workers_.empty()) {
+        for (size_t i = 0; i < procs_.size(); i++)
+            RunProcessor(i, PREPROCESS, event);
+        for (size_t i = 0; i < procs_.size(); i++)
+            RunProcessor(i, PROCESS, event);
+        return;
+    }
+
+    RunStage(event, PREPROCESS);
+    RunStage(event, PROCESS);
+}
+
+void ProcessorGraph::RunStage(RawEvent &event, Stage stage) {
+    unique_lock<mutex> lock(mutex_);
+    event_ = &event;
+    stage_ = stage;
+    error_ = exception_ptr();
+    done_ = 0;
+    ready_.clear();
+    for (size_t i = 0; i < procs_.size(); i++) {
+        waiting_[i] = numDeps_[i];
+        if (waiting_[i] == 0)
+            ready_.push_back(i);
+    }
+    changed_.notify_all();
+
+    //! The calling thread runs processors as well until the stage is done
+    while (done_ < procs_.size()) {
+        if (!ready_.empty())
+            RunNext(lock);
+        else
+            changed_.wait(lock);
+    }
+
+    exception_ptr error = error_;
+    lock.unlock();
+    if (error)
+        rethrow_exception(error);
+}
+
+void ProcessorGraph::RunNext(unique_lock<mutex> &lock) {
+    size_t node = ready_.front();
+    ready_.pop_front();
+    RawEvent &event = *event_;
+    Stage stage = stage_;
+    lock.unlock();
+
+    exception_ptr error;
+    try {
+        RunProcessor(node, stage, event);
+    } catch (...) {
+        error = current_exception();
+    }
+
+    lock.lock();
+    if (error && !error_)
+        error_ = error;
+    for (vector<size_t>::const_iterator it = dependents_[node].begin();
+         it != dependents_[node].end(); it++)
+        if (--waiting_[*it] == 0)
+            ready_.push_back(*it);
+    done_++;
+    changed_.notify_all();
+}
+
+void ProcessorGraph::RunProcessor(size_t node, Stage stage, RawEvent &event) {
+    EventProcessor *proc = procs_[node];
+    if (!proc->HasEvent())
+        return;
+    Profiler::clock::time_point start;
+    if (profiler_)
+        start = Profiler::clock::now();
+    //! The two stages may run on different threads, so each has a stream
+    if (deterministic_) {
+        RandomPool::get()->SetEvent(event.GetSequence(),
+                                    2 * node + 1 + (stage == PROCESS));
+        Plots::SelectSlot(node + 1);
+    }
+    if (stage == PREPROCESS)
+        proc->PreProcess(event);
+    else
+        proc->Process(event);
+    if (deterministic_)
+        Plots::SelectSlot(0);
+    if (profiler_)
+        profiler_->Record(timerIds_[2 * node + (stage == PROCESS)], start);
+}
+
+void ProcessorGraph::Worker(void) {
+    unique_lock<mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [this]{ return stop_ || !ready_.empty(); });
+        if (stop_)
+            return;
+        RunNext(lock);
+    }
+}
+
+void ProcessorGraph::Stop(void) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    for (vector<thread>::iterator it = workers_.begin(); it != workers_.end();
+         it++)
+        it->join();
+    workers_.clear();
+}
@@ -0,0 +1,61 @@
+/** \file Profiler.cpp
+ * \brief Collects the wall-clock time spent in the parts of the analysis
+ */
+#include <algorithm>
+#include <iomanip>
+
+#include "Profiler.hpp"
+
+using namespace std;
+
+namespace {
+    /** \return the duration in seconds
+     * \param [in] d : the duration to convert */
+    double Seconds(const Profiler::clock::duration &d) {
+        return chrono::duration_cast<chrono::duration<double> >(d).count();
+    }
+}
+
+unsigned int Profiler::Add(const std::string &name, const std::string &stage) {
+    Entry entry;
+    entry.name = name;
+    entry.stage = stage;
+    entry.calls = 0;
+    entry.total = clock::duration::zero();
+    entry.max = clock::duration::zero();
+    entries_.push_back(entry);
+    return entries_.size() - 1;
+}
+
+void Profiler::Print(std::ostream &out) const {
+    vector<const Entry*> sorted;
+    for (vector<Entry>::const_iterator it = entries_.begin();
+         it != entries_.end(); it++)
+        if (it->calls > 0)
+            sorted.push_back(&(*it));
+    if (sorted.empty())
+        return;
+    sort(sorted.begin(), sorted.end(),
+         [](const Entry *a, const Entry *b) { return a->total > b->total; });
+
+    double event = Seconds(eventTime_);
+    out << "Time spent in the processors and analyzers of " << numEvents_
+        << " events (" << event << " s):" << endl;
+    out << setw(28) << left << "Name" << setw(12) << "Stage" << right
+        << setw(12) << "Calls" << setw(12) << "Total [s]"
+        << setw(12) << "Mean [us]" << setw(12) << "Max [us]"
+        << setw(10) << "Event %" << endl;
+    for (vector<const Entry*>::const_iterator it = sorted.begin();
+         it != sorted.end(); it++) {
+        double total = Seconds((*it)->total);
+        out << setw(28) << left << (*it)->name << setw(12) << (*it)->stage
+            << right << setw(12) << (*it)->calls
+            << setw(12) << fixed << setprecision(3) << total
+            << setw(12) << setprecision(2) << 1e6 * total / (*it)->calls
+            << setw(12) << 1e6 * Seconds((*it)->max)
+            << setw(10) << setprecision(1)
+            << (event > 0 ? 100. * total / event : 0.) << endl;
+        out.unsetf(ios::floatfield);
+        out << setprecision(6);
+    }
+}
@@ -0,0 +1,122 @@
+/** \file QdcPositions.cpp
+ * \brief Positions along the strips of a detector from the QDCs of their edges
+ */
+#include <algorithm>
+#include <numeric>
+
+#include <cmath>
+
+#include "ChanEvent.hpp"
+#include "QdcPositions.hpp"
+
+using namespace std;
+
+QdcPositions::QdcPositions() : totLen_(0), whichQdc_(0), posScale_(1) {
+    fill(len_, len_ + kNumQdcs, 0.f);
+    fill(end_, end_ + kNumQdcs, 0);
+}
+
+void QdcPositions::SetWindows(const float *lengths) {
+    float end = 0;
+    for (size_t i = 0; i < kNumQdcs; i++) {
+        len_[i] = lengths[i];
+        end += lengths[i];
+        end_[i] = (size_t)end;
+    }
+    totLen_ = end - len_[0];
+}
+
+void QdcPositions::Clear() {
+    for (size_t i = 0; i < kNumQdcs; i++) {
+        top_[i].clear();
+        bottom_[i].clear();
+    }
+    minNorm_.clear();
+    maxNorm_.clear();
+}
+
+float QdcPositions::SumWindow(const Trace &trace, size_t begin, size_t end) {
+    end = min(end, trace.size());
+    if (begin >= end)
+        return 0;
+    const Trace::Sample *samples = trace.data();
+    int sum = 0;
+    for (size_t i = begin; i < end; i++)
+        sum += samples[i];
+    return sum;
+}
+
+void QdcPositions::ReadQdcs(const ChanEvent &chan, float *qdcs) const {
+    for (size_t i = 0; i < kNumQdcs; i++) {
+        qdcs[i] = chan.GetQdcValue(i);
+        //! The modules do not write the QDCs of traces with double triggers
+        if (qdcs[i] == pixie::U_DELIMITER)
+            qdcs[i] = SumWindow(chan.GetTrace(), i == 0 ? 0 : end_[i - 1],
+                                end_[i]);
+    }
+}
+
+bool QdcPositions::Add(const ChanEvent &top, const ChanEvent &bottom,
+                       float minNorm, float maxNorm) {
+    float topQdc[kNumQdcs];
+    float bottomQdc[kNumQdcs];
+    ReadQdcs(top, topQdc);
+    ReadQdcs(bottom, bottomQdc);
+    if ((top.GetQdcValue(0) == pixie::U_DELIMITER ||
+         bottom.GetQdcValue(0) == pixie::U_DELIMITER) &&
+        (topQdc[0] == 0 || bottomQdc[0] == 0))
+        return false;
+
+    for (size_t i = 0; i < kNumQdcs; i++) {
+        top_[i].push_back(topQdc[i]);
+        bottom_[i].push_back(bottomQdc[i]);
+    }
+    minNorm_.push_back(minNorm);
+    maxNorm_.push_back(maxNorm);
+    return true;
+}
+
+void QdcPositions::Compute() {
+    const size_t n = size();
+    topTot_.assign(n, 0.f);
+    bottomTot_.assign(n, 0.f);
+    position_.assign(n, NAN);
+    frac_[0].assign(n, 0.f);
+
+    const float *top0 = top_[0].data();
+    const float *bottom0 = bottom_[0].data();
+    float *topTot = topTot_.data();
+    float *bottomTot = bottomTot_.data();
+    for (size_t q = 1; q < kNumQdcs; q++) {
+        frac_[q].resize(n);
+        float *top = top_[q].data();
+        float *bottom = bottom_[q].data();
+        float *frac = frac_[q].data();
+        const float len = len_[q];
+        const float base = len_[0];
+        for (size_t i = 0; i < n; i++) {
+            top[i] -= top0[i] * len / base;
+            bottom[i] -= bottom0[i] * len / base;
+            topTot[i] += top[i];
+            bottomTot[i] += bottom[i];
+            top[i] /= len;
+            bottom[i] /= len;
+            frac[i] = top[i] / (top[i] + bottom[i]) * 1000.f; // per mil
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        topTot[i] /= totLen_;
+        bottomTot[i] /= totLen_;
+    }
+
+    if (whichQdc_ < 1 || whichQdc_ >= (int)kNumQdcs)
+        return;
+    const float *frac = frac_[whichQdc_].data();
+    const float *minNorm = minNorm_.data();
+    const float *maxNorm = maxNorm_.data();
+    float *position = position_.data();
+    for (size_t i = 0; i < n; i++)
+        position[i] = posScale_ * (frac[i] - minNorm[i]) /
+            (maxNorm[i] - minNorm[i]);
+}
@@ -7,30 +7,92 @@
 
 #include "RandomPool.hpp"
 
-RandomPool* RandomPool::instance = NULL;
+namespace {
+    //! Multipliers and key increments of Philox4x32
+    const uint32_t kPhiloxM0 = 0xD2511F53;
+    const uint32_t kPhiloxM1 = 0xCD9E8D57;
+    const uint32_t kPhiloxW0 = 0x9E3779B9;
+    const uint32_t kPhiloxW1 = 0xBB67AE85;
 
-RandomPool* RandomPool::get() {
-    if (!instance) {
-        instance = new RandomPool();
+    //! The seed used until SetSeed is called
+    const uint64_t kDefaultSeed = 0x5DEECE66DULL;
+
+    /** Encrypt a counter with ten rounds of Philox4x32
+     * \param [in] counter : the counter to encrypt
+     * \param [in] key : the key of the generator
+     * \param [out] out : the four random words */
+    void Philox(const uint32_t counter[4], const uint32_t key[2],
+                uint32_t out[4]) {
+        uint32_t c0 = counter[0], c1 = counter[1];
+        uint32_t c2 = counter[2], c3 = counter[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            uint64_t p0 = (uint64_t)kPhiloxM0 * c0;
+            uint64_t p1 = (uint64_t)kPhiloxM1 * c2;
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+            c0 = n0;
+            c1 = (uint32_t)p1;
+            c2 = n2;
+            c3 = (uint32_t)p0;
+            k0 += kPhiloxW0;
+            k1 += kPhiloxW1;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    /** \return a double in [0, 1) made from 53 bits of two words
+     * \param [in] hi : the word giving the upper 27 bits
+     * \param [in] lo : the word giving the lower 26 bits */
+    double ToUnit(uint32_t hi, uint32_t lo) {
+        return ((uint64_t)(hi >> 5) * 67108864 + (lo >> 6)) *
+            (1.0 / 9007199254740992.0);
     }
-    return instance;
 }
 
-RandomPool::RandomPool() : generator() {
-  Generate();
+thread_local RandomPool::Stream RandomPool::stream_;
+
+RandomPool* RandomPool::get() {
+    static RandomPool instance;
+    return &instance;
+}
+
+RandomPool::RandomPool() : generation_(1), numStreams_(0) {
+    key_[0] = (uint32_t)kDefaultSeed;
+    key_[1] = (uint32_t)(kDefaultSeed >> 32);
 }
 
 void RandomPool::Generate(void) {
-    for (size_t i = 0; i < size; i++)
-        numbers[i] = generator.rand(1);
-    counter = 0;
+    numStreams_ = 0;
+    generation_++;
 }
 
-double RandomPool::Get(double range) {
-    double d = numbers[counter++];
+void RandomPool::SetSeed(uint64_t seed) {
+    key_[0] = (uint32_t)seed;
+    key_[1] = (uint32_t)(seed >> 32);
+    Generate();
+}
+
+void RandomPool::Refill(Stream &stream) {
+    unsigned int generation = generation_.load(std::memory_order_relaxed);
+    if (stream.generation != generation) {
+        stream.generation = generation;
+        stream.counter[0] = 0;
+        stream.counter[1] = 0;
+        stream.counter[2] = numStreams_++;
+        stream.counter[3] = 0;
+    }
 
-    if (counter == size)
-      counter = 0;
+    uint32_t words[4];
+    Philox(stream.counter, key_, words);
+    //! A keyed stream holds its event in word 1, and has 2^32 blocks
+    if (++stream.counter[0] == 0 && !(stream.counter[3] & 0x80000000u))
+        stream.counter[1]++;
 
-    return d * range;
+    stream.numbers[0] = ToUnit(words[0], words[1]);
+    stream.numbers[1] = ToUnit(words[2], words[3]);
+    stream.next = 0;
 }
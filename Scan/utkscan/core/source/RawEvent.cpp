@@ -4,6 +4,7 @@
 #include <sstream>
 
 #include "RawEvent.hpp"
+#include "DetectorLibrary.hpp"
 #include "Messenger.hpp"
 
 using namespace std;
@@ -21,24 +22,63 @@ void RawEvent::Init(const std::set<std::string> &usedTypes)
     for (set<string>::const_iterator it = usedTypes.begin();
 	 it != usedTypes.end(); it++) {
         ds.SetName(*it);
-        sumMap.insert(make_pair(*it,ds));
+        pair<map<string, DetectorSummary>::iterator, bool> ins =
+            sumMap.insert(make_pair(*it,ds));
+        if (ins.second)
+            AddHandle(&(ins.first->second));
     }
 }
 
+int RawEvent::AddHandle(DetectorSummary *summary) {
+    int id = summaries.size();
+    summaries.push_back(summary);
+
+    const DetectorLibrary *modChan = DetectorLibrary::get();
+    vector<bool> channels(modChan->size(), false);
+    for (size_t i = 0; i < modChan->size(); i++)
+        channels[i] = summary->Matches((*modChan)[i]);
+    summary->Attach(&eventList, &generation, channels);
+    return id;
+}
+
+void RawEvent::FillSummaries(void) {
+    for (set<const DetectorSummary*>::const_iterator it = requested.begin();
+         it != requested.end(); it++)
+        (*it)->Update();
+}
+
 void RawEvent::Zero(const std::set<std::string> &usedev) {
-    for (map<string, DetectorSummary>::iterator it = sumMap.begin();
-	 it != sumMap.end(); it++) {
-        (*it).second.Zero();
-    }
+    generation++;
+    kept = false;
+    freeEvents.insert(freeEvents.end(), eventList.begin(), eventList.end());
+    eventList.clear();
+}
 
+RawEvent::~RawEvent() {
     for(vector<ChanEvent*>::iterator it = eventList.begin();
                 it != eventList.end(); it++)
         delete *it;
+    for(vector<ChanEvent*>::iterator it = freeEvents.begin();
+                it != freeEvents.end(); it++)
+        delete *it;
+}
 
-    eventList.clear();
+ChanEvent *RawEvent::AddChan(XiaData *xiadata) {
+    ChanEvent *event;
+    if (freeEvents.empty())
+        event = new ChanEvent();
+    else {
+        event = freeEvents.back();
+        freeEvents.pop_back();
+    }
+    event->Set(xiadata);
+    eventList.push_back(event);
+    generation++;
+    return event;
 }
 
 DetectorSummary *RawEvent::GetSummary(const std::string& s, bool construct) {
+    lock_guard<mutex> lock(summaryMutex);
     map<string, DetectorSummary>::iterator it = sumMap.find(s);
     static set<string> nullSummaries;
 
@@ -49,8 +89,8 @@ DetectorSummary *RawEvent::GetSummary(const std::string& s, bool construct) {
             // construct the summary
             ss << "Constructing detector summary for type " << s;
             m.detail(ss.str());
-            sumMap.insert( make_pair(s, DetectorSummary(s, eventList) ) );
-            it = sumMap.find(s);
+            it = sumMap.insert( make_pair(s, DetectorSummary(s, eventList) ) ).first;
+            AddHandle(&(it->second));
         } else {
             if (nullSummaries.count(s) == 0) {
                 ss << "Returning NULL detector summary for type " << s;
@@ -60,10 +100,13 @@ DetectorSummary *RawEvent::GetSummary(const std::string& s, bool construct) {
             return NULL;
         }
     }
+    requested.insert(&(it->second));
+    it->second.Update();
     return &(it->second);
 }
 
 const DetectorSummary *RawEvent::GetSummary(const std::string &s) const {
+    lock_guard<mutex> lock(summaryMutex);
     map<string, DetectorSummary>::const_iterator it = sumMap.find(s);
 
     if ( it == sumMap.end() ) {
@@ -73,5 +116,17 @@ const DetectorSummary *RawEvent::GetSummary(const std::string &s) const {
         }
         return NULL;
     }
+    requested.insert(&(it->second));
     return &(it->second);
 }
+
+int RawEvent::GetSummaryId(const std::string &s, bool construct) {
+    DetectorSummary *summary = GetSummary(s, construct);
+    if (summary == NULL)
+        return -1;
+    for (size_t i = 0; i < summaries.size(); i++) {
+        if (summaries[i] == summary)
+            return i;
+    }
+    return -1;
+}
@@ -0,0 +1,59 @@
+/** \file SpillFills.cpp
+ * \brief Adds up the fills of the diagnostic spectra filled for every hit
+ * and commits them to the histograms once per spill
+ */
+#include "SpillFills.hpp"
+
+using namespace std;
+
+size_t SpillFills::AddDense(const Plots::Handle &handle, int xSize) {
+    Slot slot = {handle, vector<unsigned int>(xSize > 0 ? xSize : 1, 0),
+                 0, 0, 0};
+    slots_.push_back(slot);
+    return(slots_.size() - 1);
+}
+
+size_t SpillFills::AddRuns(const Plots::Handle &handle) {
+    Slot slot = {handle, vector<unsigned int>(), 0, 0, 0};
+    slots_.push_back(slot);
+    return(slots_.size() - 1);
+}
+
+void SpillFills::Clear(void) {
+    slots_.clear();
+    runs_.clear();
+}
+
+void SpillFills::EndRun(size_t slot) {
+    Slot &s = slots_[slot];
+    Run run = {slot, s.x, s.y, s.weight};
+    runs_.push_back(run);
+    s.weight = 0;
+    if (runs_.size() >= kMaxRuns)
+        Commit();
+}
+
+/// The weight is given as the z value, so that 1D histograms are filled at
+/// y = 1 like the fills of Plots::Plot(handle, x), and 2D histograms at (x,
+/// y), both with the number of fills.
+void SpillFills::Commit(void) {
+    for (size_t i = 0; i < slots_.size(); i++) {
+        Slot &s = slots_[i];
+        if (s.weight != 0) {
+            Run run = {i, s.x, s.y, s.weight};
+            runs_.push_back(run);
+            s.weight = 0;
+        }
+        for (size_t x = 0; x < s.dense.size(); x++) {
+            if (s.dense[x] == 0)
+                continue;
+            histo_->Plot(s.handle, x, 1, s.dense[x]);
+            s.dense[x] = 0;
+        }
+    }
+
+    for (vector<Run>::const_iterator it = runs_.begin(); it != runs_.end();
+         it++)
+        histo_->Plot(slots_[it->slot].handle, it->x, it->y, it->weight);
+    runs_.clear();
+}
@@ -3,7 +3,9 @@
  *  \author S. V. Paulauskas
  *  \date October 23, 2014
 */
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <cmath>
 
@@ -25,6 +27,51 @@ TimingCalibration TimingCalibrator::GetCalibration(const TimingDefs::TimingIdent
     return((*it).second);
 }
 
+TimingCalibrationTable::TimingCalibrationTable(
+    const std::vector<TimingDefs::TimingIdentifier> &keys) {
+    vector<TimingCalibration> cals;
+    numStarts_ = 0;
+    for(vector<TimingDefs::TimingIdentifier>::const_iterator it = keys.begin();
+        it != keys.end(); it++) {
+        cals.push_back(TimingCalibrator::get()->GetCalibration(*it));
+        const map<unsigned int, double> &offsets = cals.back().GetTofOffsets();
+        //Locations missing in the xml are read as -1 and never have a start
+        for(map<unsigned int, double>::const_iterator off = offsets.begin();
+            off != offsets.end(); off++)
+            if((int)off->first >= 0)
+                numStarts_ = max(numStarts_, off->first + 1);
+    }
+
+    tofOffsets_.assign(keys.size()*numStarts_, 0.0);
+    for(size_t bar = 0; bar < keys.size(); bar++) {
+        const TimingCalibration &cal = cals[bar];
+        lrtOffset_.push_back(cal.GetLeftRightTimeOffset());
+        xOffset_.push_back(cal.GetXOffset());
+        z0_.push_back(cal.GetZ0());
+
+        const string &type = keys[bar].second;
+        if(type == "small") {
+            speed_.push_back(Globals::get()->speedOfLightSmall());
+            maxTimeDiff_.push_back(Globals::get()->smallLengthTime() + 20);
+        } else if(type == "big") {
+            speed_.push_back(Globals::get()->speedOfLightBig());
+            maxTimeDiff_.push_back(Globals::get()->bigLengthTime() + 20);
+        } else if(type == "medium") {
+            speed_.push_back(Globals::get()->speedOfLightMedium());
+            maxTimeDiff_.push_back(Globals::get()->mediumLengthTime() + 20);
+        } else {
+            speed_.push_back(numeric_limits<double>::quiet_NaN());
+            maxTimeDiff_.push_back(numeric_limits<double>::infinity());
+        }
+
+        const map<unsigned int, double> &offsets = cal.GetTofOffsets();
+        for(map<unsigned int, double>::const_iterator off = offsets.begin();
+            off != offsets.end(); off++)
+            if((int)off->first >= 0)
+                tofOffsets_[bar*numStarts_ + off->first] = off->second;
+    }
+}
+
 TimingCalibrator* TimingCalibrator::get() {
     if (!instance)
         instance = new TimingCalibrator();
@@ -32,23 +79,19 @@ TimingCalibrator* TimingCalibrator::get() {
 }
 
 void TimingCalibrator::ReadTimingCalXml() {
-    string cfg = Globals::get()->configfile();
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(cfg.c_str());
-    if (!result) {
-        stringstream ss;
-        ss << "TimingCalibrator: error parsing file " << cfg;
-        ss << " : " << result.description();
-        throw GeneralException(ss.str());
-    }
-
     Messenger m;
     m.start("Loading Time Calibrations");
+    isVerbose_ = ReadCalibrations(Globals::get()->configdoc(), calibrations_);
+    m.done();
+}
 
+bool TimingCalibrator::ReadCalibrations(const pugi::xml_document &doc,
+    map<TimingDefs::TimingIdentifier, TimingCalibration> &calibrations) {
+    Messenger m;
     pugi::xml_node timeCals =
         doc.child("Configuration").child("TimeCalibration");
 
-    isVerbose_ = timeCals.attribute("verbose_timing").as_bool();
+    bool isVerbose = timeCals.attribute("verbose_timing").as_bool();
 
     for(pugi::xml_node_iterator detType = timeCals.begin();
         detType != timeCals.end(); ++detType) {
@@ -78,16 +121,16 @@ void TimingCalibrator::ReadTimingCalXml() {
                     temp.SetTofOffset(tofoffset->attribute("location").as_int(-1),
                                       tofoffset->attribute("offset").as_double(0.0));
 
-                if(!calibrations_.insert(make_pair(id, temp)).second) {
+                if(!calibrations.insert(make_pair(id, temp)).second) {
                     stringstream ss;
                     ss << "TimingCalibrator: We have found a duplicate "
                        << "entry into the TimingCalibrations at "
                        << bar->path() << barNumber << endl
                        << "Ignoring duplicate. ";
-                    m_.warning(ss.str());
+                    m.warning(ss.str());
                 }
 
-                if (isVerbose_) {
+                if (isVerbose) {
                     stringstream ss;
                     ss << detName << ":" << barType << ":" << barNumber
                         << " lroffset = " << temp.GetLeftRightTimeOffset()
@@ -101,5 +144,5 @@ void TimingCalibrator::ReadTimingCalXml() {
             }
         }
     }
-    m.done();
+    return(isVerbose);
 }
@@ -27,3 +27,18 @@ void TimingMapBuilder::FillMaps(const std::vector<ChanEvent*> &evts) {
         map_.insert(make_pair(key,data));
     }
 }
+
+void TimingMapBuilder::FillArray(const std::vector<ChanEvent*> &evts,
+                                 TimingArray &arr) {
+    for(vector<ChanEvent*>::const_iterator it = evts.begin();
+    it != evts.end(); it++) {
+        size_t channel = (*it)->GetID();
+        if(channel >= arr.size() || arr.Has(channel))
+            continue;
+
+        HighResTimingData data((*it));
+        if(!data.GetIsValid())
+            continue;
+        arr.Set(channel, data);
+    }
+}
@@ -15,42 +15,56 @@ namespace dammIds {
     }
 }
 
+Trace::Field Trace::FindField(const std::string &name) {
+    static const char *names[NUM_FIELDS] = {
+        "analyzedLevel", "badqdc", "baseline", "calcEnergy", "chisqPerDof",
+        "discrim", "filterEnergy", "filterEnergyCal", "filterTime", "maxpos",
+        "maxval", "numPulses", "numTriggers", "phase", "position", "qdc",
+        "saturation", "sigmaBaseline", "tau", "tqdc"
+    };
+    for (int i = 0; i < NUM_FIELDS; i++)
+        if (name == names[i])
+            return((Field)i);
+    return(NUM_FIELDS);
+}
+
 ///This creates the static instance of the Plots class before main. This may
 ///cause a static initialization order fiasco. Be AWARE!!
 Plots Trace::histo(dammIds::trace::OFFSET, dammIds::trace::RANGE, "traces");
 
+namespace {
+    ///The values of a row plotted by the Trace, kept between the plots so
+    ///that they are not allocated for every trace
+    thread_local vector<double> rowValues;
+}
+
 void Trace::Plot(int id) {
-    for (size_type i=0; i < size(); i++) {
-        histo.Plot(id, i, 1, at(i));
-    }
+    Plot(id, 1);
 }
 
 void Trace::Plot(int id, int row) {
-    for (size_type i=0; i < size(); i++) {
-        histo.Plot(id, i, row, at(i));
-    }
+    rowValues.assign(begin(), end());
+    histo.PlotRow(id, row, rowValues.data(), rowValues.size());
 }
 
 void Trace::ScalePlot(int id, double scale) {
-    for (size_type i=0; i < size(); i++) {
-        histo.Plot(id, i, 1, abs(at(i)) / scale);
-    }
+    ScalePlot(id, 1, scale);
 }
 
 void Trace::ScalePlot(int id, int row, double scale) {
-    for (size_type i=0; i < size(); i++) {
-        histo.Plot(id, i, row, abs(at(i)) / scale);
-    }
+    rowValues.resize(size());
+    for (size_type i=0; i < size(); i++)
+        rowValues[i] = abs(at(i)) / scale;
+    histo.PlotRow(id, row, rowValues.data(), rowValues.size());
 }
 
 void Trace::OffsetPlot(int id, double offset) {
-    for (size_type i=0; i < size(); i++) {
-        histo.Plot(id, i, 1, max(0., at(i) - offset));
-    }
+    OffsetPlot(id, 1, offset);
 }
 
 void Trace::OffsetPlot(int id, int row, double offset) {
-    for (size_type i=0; i < size(); i++) {
-        histo.Plot(id, i, row, max(0., at(i) - offset));
-    }
+    rowValues.resize(size());
+    for (size_type i=0; i < size(); i++)
+        rowValues[i] = max(0., at(i) - offset);
+    histo.PlotRow(id, row, rowValues.data(), rowValues.size());
 }
@@ -0,0 +1,154 @@
+/** \file TraceCompressor.cpp
+ * \brief Lossless delta and entropy coding of trace samples
+ */
+#include <algorithm>
+
+#include <stdint.h>
+
+#include "TraceCompressor.hpp"
+
+using namespace std;
+
+namespace {
+    //! Packs bits, most significant first, at the end of a byte buffer
+    class BitWriter {
+    public:
+        BitWriter(vector<unsigned char> &out) : out_(out), bits_(8) {}
+
+        void Put(const uint32_t &value, unsigned int nbits) {
+            while (nbits > 0) {
+                if (bits_ == 8) {
+                    out_.push_back(0);
+                    bits_ = 0;
+                }
+                unsigned int n = min(nbits, 8 - bits_);
+                unsigned int chunk = (value >> (nbits - n)) & ((1u << n) - 1);
+                out_.back() |= chunk << (8 - bits_ - n);
+                bits_ += n;
+                nbits -= n;
+            }
+        }
+
+        void PutOnes(unsigned int n) {
+            for (; n > 0; n--)
+                Put(1, 1);
+        }
+    private:
+        vector<unsigned char> &out_;
+        unsigned int bits_; //!< bits used in the last byte
+    };
+
+    //! Reads the bits packed by a BitWriter
+    class BitReader {
+    public:
+        BitReader(const unsigned char *data, const size_t &size) :
+            data_(data), size_(size), pos_(0) {}
+
+        bool Get(unsigned int nbits, uint32_t &value) {
+            if (pos_ + nbits > size_ * 8)
+                return(false);
+            value = 0;
+            for (; nbits > 0; nbits--, pos_++)
+                value = (value << 1) | ((data_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1);
+            return(true);
+        }
+    private:
+        const unsigned char *data_;
+        size_t size_;
+        size_t pos_; //!< the next bit to read
+    };
+
+    inline uint32_t ZigZag(const int32_t &d) {
+        return(((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+    }
+
+    inline int32_t UnZigZag(const uint32_t &u) {
+        return((int32_t)(u >> 1) ^ -(int32_t)(u & 1));
+    }
+}
+
+void TraceCompressor::Encode(const std::vector<unsigned short> &trace,
+                             std::vector<unsigned char> &out) {
+    if (trace.empty())
+        return;
+
+    BitWriter writer(out);
+    writer.Put((uint32_t)trace[0], 32);
+
+    uint32_t res[blockSize_];
+    for (size_t start = 1; start < trace.size(); start += blockSize_) {
+        size_t n = min((size_t)blockSize_, trace.size() - start);
+        for (size_t i = 0; i < n; i++)
+            res[i] = ZigZag((int32_t)trace[start + i] - trace[start + i - 1]);
+
+        //Pick the Rice parameter giving the fewest bits for the block
+        unsigned int bestK = 0;
+        uint64_t bestBits = ~(uint64_t)0;
+        for (unsigned int k = 0; k < 31; k++) {
+            uint64_t bits = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint32_t q = res[i] >> k;
+                bits += q < maxQuotient_ ? q + 1 + k : maxQuotient_ + 32;
+            }
+            if (bits < bestBits) {
+                bestBits = bits;
+                bestK = k;
+            }
+        }
+
+        writer.Put(bestK, 5);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t q = res[i] >> bestK;
+            if (q < maxQuotient_) {
+                writer.PutOnes(q);
+                writer.Put(0, 1);
+                if (bestK > 0)
+                    writer.Put(res[i], bestK);
+            } else {
+                writer.PutOnes(maxQuotient_);
+                writer.Put(res[i], 32);
+            }
+        }
+    }
+}
+
+bool TraceCompressor::Decode(const unsigned char *data, const size_t &size,
+                             const size_t &length, std::vector<int> &trace) {
+    trace.clear();
+    if (length == 0)
+        return(true);
+
+    BitReader reader(data, size);
+    uint32_t value;
+    if (!reader.Get(32, value))
+        return(false);
+    trace.reserve(length);
+    trace.push_back((int32_t)value);
+
+    while (trace.size() < length) {
+        uint32_t k;
+        if (!reader.Get(5, k))
+            return(false);
+        size_t n = min((size_t)blockSize_, length - trace.size());
+        for (size_t i = 0; i < n; i++) {
+            uint32_t q = 0, bit;
+            do {
+                if (!reader.Get(1, bit))
+                    return(false);
+            } while (bit == 1 && ++q < maxQuotient_);
+
+            uint32_t u;
+            if (q == maxQuotient_) {
+                if (!reader.Get(32, u))
+                    return(false);
+            } else {
+                uint32_t rem = 0;
+                if (k > 0 && !reader.Get(k, rem))
+                    return(false);
+                u = (q << k) | rem;
+            }
+            trace.push_back(trace.back() + UnZigZag(u));
+        }
+    }
+    return(true);
+}
@@ -5,6 +5,8 @@
  * \author K. A. Miernik
  * \date August 19, 2012
  */
+#include <algorithm>
+
 #include "TreeCorrelator.hpp"
 #include "Globals.hpp"
 #include "Exceptions.hpp"
@@ -58,6 +60,59 @@ Place* TreeCorrelator::place(std::string name) {
     return element->second;
 }
 
+size_t TreeCorrelator::index(const std::string &name) const {
+    map<string, size_t>::const_iterator element = placeIndex_.find(name);
+    if (element == placeIndex_.end()) {
+        stringstream ss;
+        ss << "TreeCorrelator: place " << name
+           << " doesn't exist " << endl;
+        throw TreeCorrelatorException(ss.str());
+    }
+    return element->second;
+}
+
+size_t TreeCorrelator::memory() const {
+    size_t bytes = 0;
+    for (map<string, Place*>::const_iterator it = places_.begin();
+         it != places_.end(); ++it)
+        bytes += sizeof(Place) +
+                 it->second->info_.capacity() * sizeof(EventData);
+    return bytes;
+}
+
+void TreeCorrelator::savePlaces(std::ostream &out) const {
+    uint32_t size = places_.size();
+    out.write((const char*)&size, sizeof(size));
+    for (map<string, Place*>::const_iterator it = places_.begin();
+         it != places_.end(); ++it) {
+        uint32_t length = it->first.size();
+        out.write((const char*)&length, sizeof(length));
+        out.write(it->first.data(), length);
+        it->second->save(out);
+    }
+}
+
+bool TreeCorrelator::loadPlaces(std::istream &in) {
+    uint32_t size;
+    if (!in.read((char*)&size, sizeof(size)) || size != places_.size())
+        return false;
+    //The places are written in the order of their names, so each name is
+    // the one of the place with the same position in the map
+    for (map<string, Place*>::iterator it = places_.begin();
+         it != places_.end(); ++it) {
+        uint32_t length;
+        string name;
+        if (!in.read((char*)&length, sizeof(length)) ||
+            length != it->first.size())
+            return false;
+        name.resize(length);
+        if ((length > 0 && !in.read(&name[0], length)) || name != it->first ||
+            !it->second->load(in))
+            return false;
+    }
+    return true;
+}
+
 void TreeCorrelator::addChild(std::string parent, std::string child,
                              bool coin, bool verbose) {
     if (places_.count(parent) == 1 && places_.count(child) == 1) {
@@ -157,6 +212,19 @@ void TreeCorrelator::createPlace(std::map<std::string, std::string>& params,
             }
             Place* current = builder.create(params, verbose);
             places_[(*it)] = current;
+
+            //! A replaced place keeps its index
+            map<string, size_t>::iterator found = placeIndex_.find(*it);
+            if (found == placeIndex_.end()) {
+                placeIndex_[*it] = placeTable_.size();
+                placeTable_.push_back(current);
+            } else
+                placeTable_[found->second] = current;
+            resetable_.clear();
+            for (vector<Place*>::iterator place = placeTable_.begin();
+                 place != placeTable_.end(); ++place)
+                if ((*place)->resetable())
+                    resetable_.push_back(*place);
             if (strings::to_bool(params["init"]))
                 current->activate(0.0);
         }
@@ -170,35 +238,77 @@ void TreeCorrelator::createPlace(std::map<std::string, std::string>& params,
 }
 
 void TreeCorrelator::buildTree() {
-    string cfg = Globals::get()->configfile();
-    pugi::xml_document doc;
+    const pugi::xml_document &doc = Globals::get()->configdoc();
 
     Messenger m;
     m.start("Creating TreeCorrelator");
-    pugi::xml_parse_result result = doc.load_file(cfg.c_str());
-    if (!result) {
-        stringstream ss;
-        ss << "DetectorDriver: error parsing file " << cfg;
-        ss << " : " << result.description();
-        m.fail();
-        throw IOException(ss.str());
-    }
 
     pugi::xml_node tree = doc.child("Configuration").child("TreeCorrelator");
     bool verbose = tree.attribute("verbose").as_bool(false);
 
     Walker walker;
     walker.traverseTree(tree, string(tree.attribute("name").value()), verbose);
+    compileOrder(verbose);
 
     m.done();
 }
 
+void TreeCorrelator::compileOrder(bool verbose) {
+    map<Place*, unsigned> children;
+    for (vector<Place*>::iterator it = placeTable_.begin();
+         it != placeTable_.end(); ++it) {
+        children[*it];
+        const vector<Place*>& parents = (*it)->getParents();
+        for (vector<Place*>::const_iterator itp = parents.begin();
+             itp != parents.end(); ++itp)
+            ++children[*itp];
+    }
+
+    vector<Place*> order;
+    for (map<Place*, unsigned>::iterator it = children.begin();
+         it != children.end(); ++it) {
+        if (it->second == 0) {
+            it->first->setRank(0);
+            order.push_back(it->first);
+        }
+    }
+
+    unsigned depth = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        Place* current = order[i];
+        depth = max(depth, current->rank());
+        const vector<Place*>& parents = current->getParents();
+        for (vector<Place*>::const_iterator it = parents.begin();
+             it != parents.end(); ++it) {
+            if ((*it)->rank() < current->rank() + 1)
+                (*it)->setRank(current->rank() + 1);
+            if (--children[*it] == 0)
+                order.push_back(*it);
+        }
+    }
+
+    if (order.size() != children.size())
+        throw TreeCorrelatorException("TreeCorrelator: the places do not "
+                                      "form a tree, could not order them");
+
+    if (verbose) {
+        Messenger m;
+        stringstream ss;
+        ss << "Evaluation order of " << order.size() << " places with "
+           << depth + 1 << " levels";
+        m.detail(ss.str(), 1);
+    }
+}
+
 TreeCorrelator::~TreeCorrelator() {
     for (map<string, Place*>::iterator it = places_.begin();
          it != places_.end(); ++it) {
         delete it->second;
     }
     places_.clear();
+    placeIndex_.clear();
+    placeTable_.clear();
+    resetable_.clear();
     delete instance;
     instance = NULL;
 }
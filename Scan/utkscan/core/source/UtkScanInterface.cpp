@@ -1,7 +1,28 @@
+#include "BananaGates.hpp"
 #include "DetectorDriver.hpp"
+#include "DetectorLibrary.hpp"
+#include "HisServer.hpp"
+#include "TreeCorrelator.hpp"
 #include "UtkScanInterface.hpp"
 #include "UtkUnpacker.hpp"
 
+namespace {
+    /** Find the first entry of a list of detector types that matches a
+     * channel, an empty subtype matching every subtype
+     * \param [in] list : the list of entries with a type and subtype
+     * \param [in] id : the identifier of the channel
+     * \return the matching entry, or NULL if there is none */
+    template<typename T>
+    const T *FindType(const std::vector<T> &list, const Identifier &id) {
+        for (typename std::vector<T>::const_iterator it = list.begin();
+             it != list.end(); ++it)
+            if (id.GetType() == it->type &&
+                (it->subtype.empty() || id.GetSubtype() == it->subtype))
+                return &*it;
+        return NULL;
+    }
+}
+
 // Define a pointer to an OutputHisFile for later use.
 #ifndef USE_HRIBF
 OutputHisFile *output_his = NULL;
@@ -10,6 +31,13 @@ OutputHisFile *output_his = NULL;
 /// Default constructor.
 UtkScanInterface::UtkScanInterface() : ScanInterface() {
     init_ = false;
+    hisServer_ = NULL;
+    //UtkUnpacker copies the XiaData into ChanEvents and never deletes the
+    // raw events itself, so we can safely let the Unpacker recycle them.
+    SetPoolMode(true);
+    //The ChanEvents only live until the end of UtkUnpacker::ProcessRawEvent,
+    // so the trace can be converted once directly from the spill buffer.
+    SetTraceViewMode(true);
 }
 
 /// Destructor.
@@ -17,6 +45,7 @@ UtkScanInterface::~UtkScanInterface() {
 #ifndef USE_HRIBF
     if (init_)
         delete (output_his);
+    delete hisServer_;
 #endif
 }
 
@@ -28,18 +57,67 @@ UtkScanInterface::~UtkScanInterface() {
  * \return True if the command was recognized and false otherwise. */
 bool UtkScanInterface::ExtraCommands(const std::string &cmd_,
                                      std::vector<std::string> &args_) {
-    if (cmd_ == "mycmd") {
-        if (args_.size() >= 1) {
-            // Handle the command.
-        } else {
-            std::cout << msgHeader
-                      << "Invalid number of parameters to 'mycmd'\n";
-            std::cout << msgHeader << " -SYNTAX- mycmd <param>\n";
+#ifndef USE_HRIBF
+    //zero, hup and ban follow the commands of the same name in scanor
+    if (cmd_ == "ban") {
+        if (args_.size() != 1) {
+            std::cout << msgHeader << "Invalid number of parameters to 'ban'\n";
+            std::cout << msgHeader << " -SYNTAX- ban <file>\n";
+        } else if (IsRunning())
+            std::cout << msgHeader << "Stop the scan before loading bananas.\n";
+        else if (BananaGates::get()->Load(args_[0]))
+            std::cout << msgHeader << BananaGates::get()->GetNumGates()
+                      << " bananas are loaded.\n";
+    } else if (cmd_ == "zero") {
+        //A running scan zeroes the histograms itself before its next fill
+        if (!init_)
+            std::cout << msgHeader << "Failed to zero the histograms.\n";
+        else if (IsRunning()) {
+            output_his->RequestZero();
+            std::cout << msgHeader << "Zeroing all histograms.\n";
+        } else if (!output_his->Zero())
+            std::cout << msgHeader << "Failed to zero the histograms.\n";
+        else
+            std::cout << msgHeader << "Zeroed all histograms.\n";
+    } else if (cmd_ == "snapshot") {
+        if (args_.size() != 1) {
+            std::cout << msgHeader << "Invalid number of parameters to 'snapshot'\n";
+            std::cout << msgHeader << " -SYNTAX- snapshot <prefix>\n";
+        } else if (!init_)
+            std::cout << msgHeader << "No histogram file is open.\n";
+        else if (IsRunning()) {
+            output_his->RequestSnapshot(args_[0]);
+            std::cout << msgHeader << "Writing a snapshot of the histograms to "
+                      << args_[0] << ".his.\n";
+        } else if (!output_his->Snapshot(args_[0]))
+            std::cout << msgHeader << "Failed to take the snapshot.\n";
+        else
+            std::cout << msgHeader << "Writing a snapshot of the histograms to "
+                      << args_[0] << ".his.\n";
+    } else if (cmd_ == "reload") {
+        //The constants are swapped in by the scan between two raw events
+        std::string fname = (args_.empty() ? Globals::get()->configfile()
+                                           : args_[0]);
+        if (!init_ || !DetectorDriver::get()->ReloadCalibrations(fname))
+            std::cout << msgHeader << "Failed to reload the calibrations.\n";
+        else
+            std::cout << msgHeader << "Reloaded the calibrations of "
+                      << fname << ".\n";
+    } else if (cmd_ == "hup") {
+        if (!init_)
+            std::cout << msgHeader << "No histogram file is open.\n";
+        else {
+            output_his->Flush();
+            std::cout << msgHeader << "Wrote the histograms to "
+                      << GetOutputFilename() << ".\n";
         }
     } else
         return (false); // Unrecognized command.
 
     return (true);
+#else
+    return (false);
+#endif
 }
 
 /** CmdHelp is used to allow a derived class to print a help statement about
@@ -47,7 +125,30 @@ bool UtkScanInterface::ExtraCommands(const std::string &cmd_,
  * or 'h' into the interactive terminal (if available).
  * \param[in]  prefix_ String to append at the start of any output. */
 void UtkScanInterface::CmdHelp() {
-    std::cout << "   mycmd <param> - Do something useful.\n";
+#ifndef USE_HRIBF
+    std::cout << "   zero            - Zero all histograms\n";
+    std::cout << "   hup             - Write the histograms to the .his file\n";
+    std::cout << "   snapshot <pre>  - Write a copy of the histograms to <pre>.his in the background\n";
+    std::cout << "   ban <file>      - Load the banana gates of a DAMM .ban file\n";
+    std::cout << "   reload [file]   - Swap in the calibrations, walk and timing corrections of the configuration\n";
+#endif
+}
+
+/** ArgHelp is used to allow a derived class to print a help statment about
+ * its own command line arguments. The --jobs, --hosts and --launcher options
+ * are handled in main() before the scan is set up, they are only added here
+ * for the help dialogue.
+ * \return Nothing. */
+void UtkScanInterface::ArgHelp() {
+    AddOption(optionExt("jobs", required_argument, NULL, 'j', "<N>",
+                        "Number of input files to scan at once when several "
+                        "are given with -i (default=number of cores)"));
+    AddOption(optionExt("hosts", required_argument, NULL, 0, "<h1,h2,..>",
+                        "Run the scans on these hosts, --jobs at a time on "
+                        "each, which share the file system"));
+    AddOption(optionExt("launcher", required_argument, NULL, 0, "<command>",
+                        "Command which runs a shell command on a host given "
+                        "with --hosts (default=ssh)"));
 }
 
 /** SyntaxStr is used to print a linux style usage message to the screen.
@@ -74,6 +175,25 @@ bool UtkScanInterface::Initialize(std::string prefix_) {
         // Read in the name of the his file.
         output_his = new OutputHisFile(GetOutputFilename().c_str());
         output_his->SetDebugMode(false);
+        output_his->SetMapped(Globals::get()->mappedHis(),
+                              Globals::get()->atomicHis());
+        output_his->SetCheckpoint(Globals::get()->checkpointInterval());
+
+        //The viewers on other hosts are given the histograms at every flush
+        unsigned int port = Globals::get()->hisServerPort();
+        if (port != 0) {
+            hisServer_ = new HisServer();
+            if (hisServer_->Init(port)) {
+                output_his->SetServer(hisServer_);
+                std::cout << prefix_ << "Serving the histograms on port "
+                          << port << ".\n";
+            } else {
+                std::cout << prefix_ << "Failed to serve the histograms on "
+                          << "port " << port << ".\n";
+                delete hisServer_;
+                hisServer_ = NULL;
+            }
+        }
 
         /** The DetectorDriver constructor will load processors
          *  from the xml configuration file upon first call.
@@ -88,6 +208,18 @@ bool UtkScanInterface::Initialize(std::string prefix_) {
          */
         DetectorDriver::get()->DeclarePlots();
         output_his->Finalize();
+
+        //The rolling histograms need the sizes of the declared histograms
+        const std::vector<unsigned int> &rolling = Globals::get()->rollingIds();
+        for (std::vector<unsigned int>::const_iterator it = rolling.begin();
+             it != rolling.end(); it++)
+            if (!output_his->SetRolling(*it, Globals::get()->rollingSlices(),
+                                        Globals::get()->rollingSeconds()))
+                std::cout << prefix_ << "Histogram " << *it << " cannot be "
+                          << "a rolling histogram, it is not declared.\n";
+
+        if (!Globals::get()->bananaFile().empty())
+            BananaGates::get()->Load(Globals::get()->bananaFile());
     } catch (std::exception &e) {
         // Any exceptions will be intercepted here
         std::cout << prefix_ << "Exception caught at Initialize:" << std::endl;
@@ -98,10 +230,51 @@ bool UtkScanInterface::Initialize(std::string prefix_) {
     return (init_ = true);
 }
 
-/** Peform any last minute initialization before processing data. 
+/** Peform any last minute initialization before processing data. The
+ * channel thresholds of the map, and the ignore channels if they are to be
+ * dropped, are handed to the Unpacker so that their hits are dropped before
+ * anything is done with them. The event widths of the detector types and
+ * the trigger windows, if any, are resolved to the channels of the map as
+ * well, and the Unpacker is given the memory budget.
  * /return Nothing. */
 void UtkScanInterface::FinalInitialization() {
-    // Do some last minute initialization before the run starts.
+    DetectorLibrary *modChan = DetectorLibrary::get();
+    const bool dropIgnored = Globals::get()->dropIgnoredHits();
+    static const unsigned int ignoreId = Identifier::NameId("ignore");
+
+    std::vector<unsigned int> thresholds(modChan->size(), 0);
+    for (size_t i = 0; i < modChan->size(); i++) {
+        const Identifier &id = modChan->at(i);
+        if (dropIgnored && id.GetTypeId() == ignoreId)
+            thresholds[i] = HIT_DROP_ALL;
+        else
+            thresholds[i] = id.GetThreshold();
+    }
+    GetCore()->SetHitFilter(thresholds);
+    GetCore()->SetMemoryBudget(Globals::get()->memoryBudget());
+
+    const std::vector<TypeWidth> &typeWidths = Globals::get()->typeWidths();
+    if (!typeWidths.empty()) {
+        std::vector<unsigned int> widths(modChan->size(), 0);
+        for (size_t i = 0; i < modChan->size(); i++) {
+            const TypeWidth *width = FindType(typeWidths, modChan->at(i));
+            if (width)
+                widths[i] = width->width;
+        }
+        GetCore()->SetChannelWidths(widths);
+    }
+
+    const std::vector<TriggerWindow> &triggers = Globals::get()->triggers();
+    if (!triggers.empty()) {
+        std::vector<std::pair<unsigned int, unsigned int> > windows(
+                modChan->size(), std::make_pair(0u, 0u));
+        for (size_t i = 0; i < modChan->size(); i++) {
+            const TriggerWindow *trigger = FindType(triggers, modChan->at(i));
+            if (trigger)
+                windows[i] = std::make_pair(trigger->before, trigger->after);
+        }
+        GetCore()->SetTriggerWindows(windows);
+    }
 }
 
 /** Receive various status notifications from the scan.
@@ -112,6 +285,16 @@ void UtkScanInterface::Notify(const std::string &code_/*=""*/) {
     } else if (code_ == "STOP_SCAN") {
     } else if (code_ == "SCAN_COMPLETE") {
         std::cout << msgHeader << "Scan complete.\n";
+        if (init_)
+            DetectorDriver::get()->CommitSpillFills();
+        if (GetCore()->GetNumDroppedHits() > 0)
+            std::cout << msgHeader << GetCore()->GetNumDroppedHits()
+                      << " hits were dropped when unpacking.\n";
+        if (GetCore()->TriggerMode())
+            std::cout << msgHeader << GetCore()->GetNumUntriggeredHits()
+                      << " hits were outside of every trigger window.\n";
+        ((UtkUnpacker *) GetCore())->CloseSkim();
+        ((UtkUnpacker *) GetCore())->CloseAnalysisCache();
     } else if (code_ == "LOAD_FILE") {
         std::cout << msgHeader << "File loaded.\n";
     } else if (code_ == "REWIND_FILE") {
@@ -121,6 +304,53 @@ void UtkScanInterface::Notify(const std::string &code_/*=""*/) {
     }
 }
 
+/** The histograms are restored exactly, and the correlator places keep the
+ * status and history they had at the checkpoint. The processors themselves
+ * start again from their initial state.
+ * \param[out] out_ The checkpoint file.
+ * \return True upon success and false otherwise. */
+bool UtkScanInterface::SaveState(std::ostream &out_) {
+#ifndef USE_HRIBF
+    if (!init_)
+        return (false);
+    DetectorDriver::get()->CommitSpillFills();
+    uint64_t hash = Globals::get()->confighash();
+    out_.write((const char *) &hash, sizeof(hash));
+    if (!output_his->SaveCounts(out_))
+        return (false);
+    TreeCorrelator::get()->savePlaces(out_);
+    return (out_.good());
+#else
+    return (false);
+#endif
+}
+
+/** \param[in] in_ The checkpoint file.
+ * \return True upon success and false otherwise. */
+bool UtkScanInterface::LoadState(std::istream &in_) {
+#ifndef USE_HRIBF
+    uint64_t hash;
+    if (!init_ || !in_.read((char *) &hash, sizeof(hash)))
+        return (false);
+    if (hash != Globals::get()->confighash()) {
+        std::cout << msgHeader << "The configuration has changed since the "
+                  "checkpoint was written.\n";
+        return (false);
+    }
+    if (!output_his->LoadCounts(in_) ||
+        !TreeCorrelator::get()->loadPlaces(in_))
+        return (false);
+
+    if (Globals::get()->hasSkim() || Globals::get()->hasAnalysisCache())
+        std::cout << msgHeader << "WARNING! The skim file, and an analysis "
+                  "cache being written, only hold the events scanned after "
+                  "resuming.\n";
+    return (true);
+#else
+    return (false);
+#endif
+}
+
 /** Return a pointer to the Unpacker object to use for data unpacking.
  * If no object has been initialized, create a new one.
  * \return Pointer to an Unpacker object. */
@@ -10,7 +10,10 @@
 #include <sys/times.h>
 
 #include "DammPlotIds.hpp"
+#include "EventProcessor.hpp"
+#include "HisFile.hpp"
 #include "Places.hpp"
+#include "PlotsRegister.hpp"
 #include "TreeCorrelator.hpp"
 #include "UtkScanInterface.hpp"
 #include "UtkUnpacker.hpp"
@@ -28,9 +31,26 @@ RawEvent rawev;
 /// the amount of time spent in each processor is output to the screen at the
 /// end of execution.
 UtkUnpacker::~UtkUnpacker() {
+    CloseSkim();
+    CloseAnalysisCache();
     delete DetectorDriver::get();
 }
 
+/// The times of the spill are given in clock ticks and are compared to the
+/// rejection regions in the same way as the events in ProcessRawEvent. The
+/// spill can only be placed in time once the first event has been built.
+bool UtkUnpacker::SkipSpill(const unsigned long long &start_,
+                            const unsigned long long &stop_) {
+    const Globals *globals = Globals::get();
+    if (!globals->hasReject() || GetNumRawEvents() == 0)
+        return false;
+
+    double clockInSeconds = globals->constants().clockInSeconds;
+    return globals->rejects().Contains(
+            (start_ - GetFirstTime()) * clockInSeconds,
+            (stop_ - GetFirstTime()) * clockInSeconds);
+}
+
 /// This method initializes the DetectorLibrary and DetectorDriver classes so
 /// that we can begin processing the events. We take special action on the
 /// first event so that we can handle somethings poperly. Then we processes
@@ -48,38 +68,52 @@ void UtkUnpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/) {
     DetectorDriver *driver = DetectorDriver::get();
     DetectorLibrary *modChan = DetectorLibrary::get();
     set<string> usedDetectors;
-    Messenger m;
-    stringstream ss;
 
     static clock_t systemStartTime;
     static struct tms systemTimes;
     static double lastTimeOfPreviousEvent;
     static unsigned int eventCounter = 0;
 
-    if (eventCounter == 0)
+    if (eventCounter == 0) {
+        run_ = Globals::get()->constants();
+        rejects_ = Globals::get()->rejects();
         InitializeDriver(driver, modChan, systemStartTime);
-    else if(eventCounter % 5000 == 0 || eventCounter == 1)
+        if (Globals::get()->hasAnalysisCache())
+            OpenAnalysisCache(driver, addr_);
+    } else if(eventCounter % 5000 == 0 || eventCounter == 1)
         PrintProcessingTimeInformation(systemStartTime, times(&systemTimes),
             GetEventStartTime(), eventCounter);
 
-    if (Globals::get()->hasReject()) {
-        double eventTime = (GetEventStartTime() - GetFirstTime()) *
-                                Globals::get()->clockInSeconds();
+    //The events are numbered before the rejection, so an event keeps its
+    //number, and its random numbers, whatever the rejection regions
+    rawev.SetSequence(sequence_++);
 
-        vector< pair<int, int> > rejectRegions = Globals::get()->rejectRegions();
+    if (!rejects_.empty() &&
+        rejects_.Contains((GetEventStartTime() - GetFirstTime()) *
+                          run_.clockInSeconds))
+        return;
 
-        for (vector<pair<int, int> >::iterator region = rejectRegions.begin();
-             region != rejectRegions.end(); ++region)
-            if (eventTime > region->first && eventTime < region->second)
-                return;
+    //The diagnostic spectra counted for every hit are plotted whenever the
+    //events of a new spill begin
+    if (!rawEvent.empty() && rawEvent.front() &&
+        rawEvent.front()->spillIndex != lastSpill_) {
+        driver->CommitSpillFills();
+        lastSpill_ = rawEvent.front()->spillIndex;
+
+        //The memory is measured with the spills, but at most once a second
+        time_t now = time(NULL);
+        if (now != lastMemory_) {
+            lastMemory_ = now;
+            CheckMemory();
+        }
     }
 
     driver->plot(D_EVENT_GAP, (GetRealStopTime() - lastTimeOfPreviousEvent) *
-            Globals::get()->clockInSeconds()*1e9);
+            run_.clockInSeconds*1e9);
     driver->plot(D_BUFFER_END_TIME, GetRealStopTime() *
-            Globals::get()->clockInSeconds()*1e9);
+            run_.clockInSeconds*1e9);
     driver->plot(D_EVENT_LENGTH, (GetRealStopTime() - GetRealStartTime()) *
-            Globals::get()->clockInSeconds()*1e9);
+            run_.clockInSeconds*1e9);
     driver->plot(D_EVENT_MULTIPLICITY, rawEvent.size());
 
     //loop over the list of channels that fired in this event
@@ -92,9 +126,8 @@ void UtkUnpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/) {
         RawStats((*it), driver);
 
         if ((*it)->getID() == pixie::U_DELIMITER) {
-            ss << "pattern 0 ignore";
-            m.warning(ss.str());
-            ss.str("");
+            static LogSite delimiterSite("UtkUnpacker: Pattern 0 ignored");
+            Messenger().warningf(delimiterSite, "pattern 0 ignore");
             continue;
         }
 
@@ -102,57 +135,182 @@ void UtkUnpacker::ProcessRawEvent(ScanInterface *addr_/*=NULL*/) {
         if ((*modChan)[(*it)->getID()].GetType() == "ignore")
             continue;
 
-        // Convert an XiaData to a ChanEvent
-        ChanEvent *event = new ChanEvent((*it));
-
-        //Add the ChanEvent pointer to the rawev and used detectors.
+        //Fill a (reused) ChanEvent from the XiaData and add it to the rawev
+        //and used detectors.
         usedDetectors.insert((*modChan)[(*it)->getID()].GetType());
-        rawev.AddChan(event);
+        rawev.AddChan(*it);
 
         ///@TODO Add back in the processing for the dtime.
     }//for(deque<PixieData*>::iterator
 
     driver->ProcessEvent(rawev);
+    if (rawev.IsKept())
+        WriteSkim(addr_);
     rawev.Zero(usedDetectors);
     usedDetectors.clear();
 
     // If a place has a resetable type then reset it.
-    for (map<string, Place *>::iterator it =
-            TreeCorrelator::get()->places_.begin();
-         it != TreeCorrelator::get()->places_.end(); ++it)
-        if ((*it).second->resetable())
-            (*it).second->reset();
+    TreeCorrelator::get()->resetPlaces();
 
     eventCounter++;
     lastTimeOfPreviousEvent = GetRealStopTime();
 }
 
+/// The histograms are counted for the processor or analyzer which registered
+/// their range of ids, the histograms outside of every range (the raw and
+/// diagnostic ones) and the slack of the shared blocks are counted together.
+void UtkUnpacker::AccountMemory(vector<PerfCounters::MemoryEntry> &entries_) {
+    Unpacker::AccountMemory(entries_);
+
+#ifndef USE_HRIBF
+    if (output_his) {
+        const map<int, pair<int, string> > &ranges =
+                PlotsRegister::get()->GetRanges();
+        size_t owned = 0;
+        for (map<int, pair<int, string> >::const_iterator it = ranges.begin();
+             it != ranges.end(); it++) {
+            size_t bytes = 0;
+            for (int id = it->first; id <= it->second.first; id++)
+                bytes += output_his->GetMemory(id);
+            if (bytes == 0)
+                continue;
+            entries_.push_back(PerfCounters::MemoryEntry(
+                    "histograms " + it->second.second, bytes));
+            owned += bytes;
+        }
+        size_t total = output_his->GetMemory();
+        if (total > owned)
+            entries_.push_back(PerfCounters::MemoryEntry("histograms, other",
+                                                         total - owned));
+    }
+#endif
+
+    entries_.push_back(PerfCounters::MemoryEntry("correlator places",
+            TreeCorrelator::get()->memory()));
+
+    const vector<EventProcessor *> &processors =
+            DetectorDriver::get()->GetProcessors();
+    for (vector<EventProcessor *>::const_iterator it = processors.begin();
+         it != processors.end(); it++) {
+        size_t bytes = (*it)->GetMemory();
+        if (bytes > 0)
+            entries_.push_back(PerfCounters::MemoryEntry((*it)->GetName(),
+                                                         bytes));
+    }
+}
+
+/// Sparse storage makes the fills of the 2-D histograms slower, so it is only
+/// switched on once the budget is exceeded, and the blocks filled so far are
+/// made sparse once. The blocks filled afterwards start sparse.
+void UtkUnpacker::CheckMemory() {
+    if (!UpdateMemory())
+        return;
+#ifndef USE_HRIBF
+    if (!Globals::get()->sparseHis() || !output_his || output_his->IsSparse() ||
+        output_his->IsMapped())
+        return;
+    output_his->SetSparse(true);
+    size_t freed = output_his->Sparsify();
+    stringstream ss;
+    ss << "Over the memory budget, the 2-D histograms are now kept sparse, "
+       << "which freed " << freed / 1048576 << " MB";
+    Messenger().detail(ss.str());
+    UpdateMemory();
+#endif
+}
+
 /// This method plots information about the running time of the program, the
 /// hit spectrum, and the scalars for each of the channels. The two runtime
 /// spectra are critical when we are trying to debug potential data losses in
 /// the system. These spectra print the total number of counts in a given
-/// (milli)second of time.
+/// (milli)second of time. The fills are counted by the DetectorDriver and
+/// plotted once per spill.
 void UtkUnpacker::RawStats(XiaData *event_, DetectorDriver *driver,
                            ScanInterface *addr_) {
-    int id = event_->getID();
-    static const int specNoBins = SE;
-    static double runTimeSecs = 0, remainNumSecs = 0;
-    static double runTimeMsecs = 0, remainNumMsecs = 0;
-    static int rowNumSecs = 0, rowNumMsecs = 0;
-
-    runTimeSecs = (event_->time - GetFirstTime()) *
-                  Globals::get()->clockInSeconds();
-    rowNumSecs = int(runTimeSecs / specNoBins);
-    remainNumSecs = runTimeSecs - rowNumSecs * specNoBins;
-
-    runTimeMsecs = runTimeSecs*1000;
-    rowNumMsecs = int(runTimeMsecs / specNoBins);
-    remainNumMsecs = runTimeMsecs - rowNumMsecs * specNoBins;
-
-    driver->plot(D_HIT_SPECTRUM, id);
-    driver->plot(DD_RUNTIME_SEC, remainNumSecs, rowNumSecs);
-    driver->plot(DD_RUNTIME_MSEC, remainNumMsecs, rowNumMsecs);
-    driver->plot(D_SCALAR + id, runTimeSecs);
+    driver->PlotRawStats(event_->getID(),
+                         (event_->time - GetFirstTime()) * run_.clockInSeconds);
+}
+
+/// The skim file is opened on the first raw event that is selected, and its
+/// header is copied from the header of the input file. If the file cannot be
+/// opened the skim is turned off for the rest of the scan.
+void UtkUnpacker::WriteSkim(ScanInterface *addr_) {
+    if (!skim_.IsOpen()) {
+        if (!Globals::get()->hasSkim() || skimFailed_)
+            return;
+        string fname = Globals::get()->skimFile();
+        if (fname.empty())
+            fname = addr_->GetOutputFilename() + "_skim.pld";
+        if (!skim_.Open(fname)) {
+            Messenger m;
+            m.warning("UtkUnpacker: Unable to open the skim file " + fname +
+                      ", no events will be skimmed.");
+            skimFailed_ = true;
+            return;
+        }
+        fileInformation *info = addr_->GetFileInfo();
+        string name, value;
+        for (size_t i = 0; i < info->size(); i++)
+            if (info->at(i, name, value))
+                skim_.SetHeader(name, value);
+    }
+    skim_.Write(rawEvent);
+}
+
+/// The file is closed at the end of the scan so that it may be read while
+/// the program is still running.
+void UtkUnpacker::CloseSkim() {
+    if (!skim_.IsOpen())
+        return;
+    skim_.Close();
+    cout << "UtkUnpacker: Wrote " << skim_.GetNumEvents() << " raw events ("
+         << skim_.GetNumHits() << " hits) to the skim file " << skim_.GetName()
+         << ".\n";
+}
+
+/// The hash of the cache combines the configuration of the analyzers with
+/// the header of the input file, so that the cache of one run is never read
+/// for another.
+void UtkUnpacker::OpenAnalysisCache(DetectorDriver *driver,
+                                    ScanInterface *addr_) {
+    string fname = Globals::get()->analysisCacheFile();
+    if (fname.empty())
+        fname = addr_->GetOutputFilename() + ".acache";
+
+    stringstream header;
+    header << Globals::get()->analyzerhash();
+    fileInformation *info = addr_->GetFileInfo();
+    string name, value;
+    for (size_t i = 0; i < info->size(); i++)
+        if (info->at(i, name, value))
+            header << '\n' << name << '=' << value;
+
+    Messenger m;
+    if (!analysisCache_.Open(fname, Globals::HashConfig(header.str()))) {
+        m.warning("UtkUnpacker: Unable to open the analysis cache " + fname +
+                  ", the traces are analyzed as usual.");
+        return;
+    }
+    if (analysisCache_.IsReading())
+        m.detail("Reading the results of the trace analyzers from " + fname);
+    else
+        m.detail("Writing the results of the trace analyzers to " + fname);
+    driver->SetAnalysisCache(&analysisCache_);
+}
+
+/// The file is closed at the end of the scan, so that a cache which was
+/// written may be read by the next scan.
+void UtkUnpacker::CloseAnalysisCache() {
+    if (analysisCache_.IsReading())
+        cout << "UtkUnpacker: Read the results of "
+             << analysisCache_.GetNumLoaded() << " traces from the analysis "
+             << "cache, " << analysisCache_.GetNumMissed()
+             << " traces were not found and analyzed.\n";
+    else if (analysisCache_.IsWriting())
+        cout << "UtkUnpacker: Wrote the results of "
+             << analysisCache_.GetNumStored()
+             << " traces to the analysis cache.\n";
+    analysisCache_.Close();
 }
 
 /// First we initialize the DetectorLibrary, which reads the Map
@@ -178,6 +336,7 @@ void UtkUnpacker::InitializeDriver(DetectorDriver *driver,
 
     detlib->PrintUsedDetectors(rawev);
     driver->Init(rawev);
+    driver->SetPerf(&perf);
 
     try {
         driver->SanityCheck();
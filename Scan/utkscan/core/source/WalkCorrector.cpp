@@ -4,6 +4,8 @@
  * \date January 22, 2013
  */
 #include <cmath>
+#include <limits>
+#include <sstream>
 
 #include "WalkCorrector.hpp"
 #include "Exceptions.hpp"
@@ -13,7 +15,8 @@ using namespace std;
 void WalkCorrector::AddChannel(const Identifier& chanID,
                                const std::string model,
                                double min, double max,
-                               const std::vector<double>& par) {
+                               const std::vector<double>& par,
+                               unsigned int points) {
     CorrectionParams cf;
 
     unsigned required_parameters = 0;
@@ -51,8 +54,18 @@ void WalkCorrector::AddChannel(const Identifier& chanID,
         throw GeneralException(ss.str());
     }
 
+    if (points != 0 &&
+        (points < 2 || max == numeric_limits<double>::max())) {
+        stringstream ss;
+        ss << "WalkCorrector: a tabulated correction needs at least 2 "
+           << "points and a maximum of its range, " << points
+           << " points from " << min << " to " << max << " were found";
+        throw GeneralException(ss.str());
+    }
+
     cf.min = min;
     cf.max = max;
+    cf.points = points;
 
     for (vector<double>::const_iterator it = par.begin(); it != par.end();
         ++it) {
@@ -107,7 +120,7 @@ void WalkCorrector::AddChannel(const Identifier& chanID,
     }
 }
 
-double WalkCorrector::GetCorrection(Identifier& chanID, double raw) const {
+double WalkCorrector::GetCorrection(const Identifier& chanID, double raw) const {
     map<Identifier, vector<CorrectionParams> >::const_iterator itch =
         channels_.find(chanID);
     if (itch != channels_.end()) {
@@ -119,38 +132,103 @@ double WalkCorrector::GetCorrection(Identifier& chanID, double raw) const {
         if (itf == itch->second.end()) {
             return 0;
         }
-        switch(itf->model) {
-            case none:
-                return Model_None();
-                break;
-            case A:
-                return Model_A(itf->parameters, raw);
-                break;
-            case B1:
-                return Model_B1(itf->parameters, raw);
-                break;
-            case B2:
-                return Model_B2(itf->parameters, raw);
-                break;
-            case VS:
-                return Model_VS(itf->parameters, raw);
-                break;
-	    case VM:
-                return Model_VM(itf->parameters, raw);
-                break;
-            case VL:
-                return Model_VL(itf->parameters, raw);
-                break;
-            case VD:
-                return Model_VD(itf->parameters, raw);
-                break;
-            case VB:
-                return Model_VB(itf->parameters, raw);
-                break;
-            default:
-                break;
+        return Evaluate(itf->model, itf->parameters.data(), raw);
+    }
+    return 0;
+}
+
+void WalkCorrector::BuildTable(const std::vector<Identifier>& chans) {
+    index_.assign(chans.size(), make_pair(0u, 0u));
+    entries_.clear();
+    pars_.clear();
+    tables_.clear();
+
+    vector<size_t> offsets, tableOffsets;
+    for (size_t i = 0; i < chans.size(); i++) {
+        map<Identifier, vector<CorrectionParams> >::const_iterator itch =
+            channels_.find(chans[i]);
+        if (itch == channels_.end())
+            continue;
+        index_[i] = make_pair((unsigned int)entries_.size(),
+                              (unsigned int)itch->second.size());
+        for (vector<CorrectionParams>::const_iterator itf =
+                 itch->second.begin(); itf != itch->second.end(); ++itf) {
+            TableEntry entry;
+            entry.model = itf->model;
+            entry.min = itf->min;
+            entry.max = itf->max;
+            entry.par = NULL;
+            entry.points = itf->points;
+            entry.invStep = 0;
+            entry.table = NULL;
+            entries_.push_back(entry);
+            offsets.push_back(pars_.size());
+            tableOffsets.push_back(tables_.size());
+            pars_.insert(pars_.end(), itf->parameters.begin(),
+                         itf->parameters.end());
+            if (itf->points == 0)
+                continue;
+
+            double step = (itf->max - itf->min) / (itf->points - 1);
+            entries_.back().invStep = step > 0 ? 1.0 / step : 0;
+            for (unsigned int p = 0; p < itf->points; p++) {
+                double raw = itf->min + p * step;
+                double value = Evaluate(itf->model,
+                                        itf->parameters.data(), raw);
+                if (!isfinite(value)) {
+                    stringstream ss;
+                    ss << "WalkCorrector: tabulated correction of channel " << i
+                       << " is not finite at " << raw
+                       << ", raise the minimum of its range";
+                    throw GeneralException(ss.str());
+                }
+                tables_.push_back(value);
+            }
         }
     }
+
+    //The coefficients and tables are pointed to only once pars_ and tables_
+    //have stopped growing
+    for (size_t i = 0; i < entries_.size(); i++) {
+        entries_[i].par = pars_.data() + offsets[i];
+        if (entries_[i].points != 0)
+            entries_[i].table = tables_.data() + tableOffsets[i];
+    }
+}
+
+double WalkCorrector::Evaluate(WalkModel model, const double *par,
+                               double raw) const {
+    switch(model) {
+        case none:
+            return Model_None();
+            break;
+        case A:
+            return Model_A(par, raw);
+            break;
+        case B1:
+            return Model_B1(par, raw);
+            break;
+        case B2:
+            return Model_B2(par, raw);
+            break;
+        case VS:
+            return Model_VS(par, raw);
+            break;
+        case VM:
+            return Model_VM(par, raw);
+            break;
+        case VL:
+            return Model_VL(par, raw);
+            break;
+        case VD:
+            return Model_VD(par, raw);
+            break;
+        case VB:
+            return Model_VB(par, raw);
+            break;
+        default:
+            break;
+    }
     return 0;
 }
 
@@ -158,27 +236,27 @@ double WalkCorrector::Model_None() const {
     return(0.0);
 }
 
-double WalkCorrector::Model_A(const std::vector<double>& par,
+double WalkCorrector::Model_A(const double *par,
                               double raw) const {
     return(par[0] + 
 	   par[1] / (par[2] + raw) + 
 	   par[3] * exp(-raw / par[4]));
 }
 
-double WalkCorrector::Model_B1(const std::vector<double>& par,
+double WalkCorrector::Model_B1(const double *par,
                                double raw) const {
     return(par[0] + 
 	   (par[1] + par[2] / (raw + 1.0)) *
            exp(-raw / par[3]));
 }
 
-double WalkCorrector::Model_B2(const std::vector<double>& par,
+double WalkCorrector::Model_B2(const double *par,
                                double raw) const {
     return(par[0] + 
 	   par[1] * exp(-raw / par[2]));
 }
 
-double WalkCorrector::Model_VS(const std::vector<double> &par, 
+double WalkCorrector::Model_VS(const double *par,
 			       double raw) const {
     if(raw < 175)
 	return(1.09099*log(raw)-7.76641);
@@ -188,24 +266,24 @@ double WalkCorrector::Model_VS(const std::vector<double> &par,
 	   -0.000163286*raw-2.13918);
 }
 
-double WalkCorrector::Model_VB(const std::vector<double> &par,
+double WalkCorrector::Model_VB(const double *par,
 			       double raw) const {
     return(-(1.07908*log10(raw)-8.27739));
 }
 
-double WalkCorrector::Model_VD(const std::vector<double> &par,
+double WalkCorrector::Model_VD(const double *par,
 			       double raw) const {
     return(92.7907602830327 * exp(-raw/186091.225414275) +
 	   0.59140785215161 * exp(raw/2068.14618331387) -
 	   95.5388835298589);
 }
 
-double WalkCorrector::Model_VM(const std::vector<double> &par,
+double WalkCorrector::Model_VM(const double *par,
 			       double raw) const {
     return(0.0);
 }
 
-double WalkCorrector::Model_VL(const std::vector<double> &par,
+double WalkCorrector::Model_VL(const double *par,
 			       double raw) const {
     return(0.0);
 }
@@ -0,0 +1,198 @@
+/** \file cubegate.cpp
+ * \brief Projects the gamma-gamma-gamma cube of a scan through energy gates
+ *
+ * The cube written by the GeProcessor is read back, and every gate is
+ * projected from it on several threads: a single gate gives the symmetric
+ * gamma-gamma matrix in coincidence with the gate, together with its
+ * projection, and a double gate gives the spectrum in coincidence with both
+ * gates. The spectra are written to a .his and .drr pair, so they are looked
+ * at with the same tools as the spectra of the scan. The total projection of
+ * the cube is histogram 1, the matrix of single gate n (counting from 0) is
+ * 100 + n and its projection 200 + n, and double gate n is 300 + n.
+ */
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cstdlib>
+
+#include "GammaCube.hpp"
+#include "HisFile.hpp"
+#include "HisProjections.hpp"
+
+// Define the name of the program.
+#ifndef PROGRAM_NAME
+#define PROGRAM_NAME "cubegate"
+#endif
+
+using std::cout;
+using std::endl;
+
+namespace {
+    /// An energy gate, in bins of the cube
+    typedef std::pair<unsigned int, unsigned int> Gate;
+
+    /** Parse a gate given as low:high in keV
+     * \return false if the gate is not valid */
+    bool ParseGate(const std::string &text, const GammaCube &cube, Gate &gate) {
+        size_t colon = text.find(':');
+        if (colon == std::string::npos)
+            return false;
+        double low = strtod(text.substr(0, colon).c_str(), NULL);
+        double high = strtod(text.substr(colon + 1).c_str(), NULL);
+        if (low < 0 || high < low)
+            return false;
+        gate.first = (unsigned int)(low / cube.GetBinWidth());
+        gate.second = (unsigned int)(high / cube.GetBinWidth());
+        return gate.first < cube.GetSize();
+    }
+
+    /** Fill a 1D spectrum of the size of the cube
+     * \return the sum of the spectrum */
+    unsigned long long Write1D(OutputHisFile &his, unsigned int id,
+                               const std::vector<unsigned long long> &spectrum) {
+        unsigned long long sum = 0;
+        for (size_t x = 0; x < spectrum.size(); x++) {
+            if (spectrum[x] == 0)
+                continue;
+            his.Fill(id, x, 0, spectrum[x]);
+            sum += spectrum[x];
+        }
+        return sum;
+    }
+
+    void Help(const char *name) {
+        cout << "  SYNTAX: " << name << " <cube file> [options]\n"
+             << "   Options:\n"
+             << "    --gate <low:high>    | A single gate (in keV), may be "
+             << "given several times\n"
+             << "    --double <low:high,low:high> | A double gate (in keV), may "
+             << "be given several times\n"
+             << "    --threads <num>      | Threads projecting the cube "
+             << "(default=number of cores)\n"
+             << "    --output <prefix>    | The spectra are written to "
+             << "<prefix>.his and .drr (default=<cube file>.gates)\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        Help(argv[0]);
+        return (argc < 2 ? 1 : 0);
+    }
+
+    std::string cubeName(argv[1]);
+    std::string outName = cubeName + ".gates";
+    std::vector<std::string> singles, doubles;
+    unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg(argv[i]);
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--gate" && hasValue)
+            singles.push_back(argv[++i]);
+        else if (arg == "--double" && hasValue)
+            doubles.push_back(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            numThreads = std::max(1ul, strtoul(argv[++i], NULL, 0));
+        else if (arg == "--output" && hasValue)
+            outName = argv[++i];
+        else {
+            cout << PROGRAM_NAME << ": Unknown option '" << arg << "'\n";
+            Help(argv[0]);
+            return 1;
+        }
+    }
+
+    GammaCube cube;
+    if (!cube.Read(cubeName)) {
+        cout << PROGRAM_NAME << ": Failed to read the cube '" << cubeName << "'\n";
+        return 1;
+    }
+    const unsigned int size = cube.GetSize();
+    if (size > 32768) {
+        cout << PROGRAM_NAME << ": The cube has " << size << " bins per axis, "
+             << "more than a histogram may have\n";
+        return 1;
+    }
+    cout << PROGRAM_NAME << ": " << cube.GetTotal() << " triples in "
+         << cube.GetNumEntries() << " bins of " << cube.GetBinWidth()
+         << " keV, " << size << " bins per axis\n";
+
+    std::vector<Gate> singleGates(singles.size());
+    for (size_t i = 0; i < singles.size(); i++) {
+        if (!ParseGate(singles[i], cube, singleGates[i])) {
+            cout << PROGRAM_NAME << ": Bad gate '" << singles[i] << "'\n";
+            return 1;
+        }
+    }
+    std::vector<std::pair<Gate, Gate> > doubleGates(doubles.size());
+    for (size_t i = 0; i < doubles.size(); i++) {
+        size_t comma = doubles[i].find(',');
+        if (comma == std::string::npos ||
+            !ParseGate(doubles[i].substr(0, comma), cube, doubleGates[i].first) ||
+            !ParseGate(doubles[i].substr(comma + 1), cube, doubleGates[i].second)) {
+            cout << PROGRAM_NAME << ": Bad double gate '" << doubles[i] << "'\n";
+            return 1;
+        }
+    }
+
+    OutputHisFile his(outName);
+    if (!his.IsWritable()) {
+        cout << PROGRAM_NAME << ": Failed to open '" << outName << ".his'\n";
+        return 1;
+    }
+    his.push_back(new drr_entry(1, 2, size, size, 0, size - 1,
+                                "Total projection of the cube"));
+    for (size_t i = 0; i < singles.size(); i++) {
+        std::string title = "Gate " + singles[i];
+        his.push_back(new drr_entry(100 + i, 2, size, size, 0, size - 1,
+                                    size, size, 0, size - 1, title.c_str()));
+        title = "Gate " + singles[i] + " projection";
+        his.push_back(new drr_entry(200 + i, 2, size, size, 0, size - 1,
+                                    title.c_str()));
+    }
+    for (size_t i = 0; i < doubles.size(); i++) {
+        std::string title = "Gates " + doubles[i];
+        his.push_back(new drr_entry(300 + i, 2, size, size, 0, size - 1,
+                                    title.c_str()));
+    }
+    his.Finalize();
+
+    std::vector<unsigned long long> spectrum, matrix;
+    ProjectCube(cube, spectrum, numThreads);
+    Write1D(his, 1, spectrum);
+
+    for (size_t i = 0; i < singleGates.size(); i++) {
+        ProjectCube(cube, singleGates[i].first, singleGates[i].second,
+                    matrix, numThreads);
+        spectrum.assign(size, 0);
+        for (size_t y = 0; y < size; y++) {
+            for (size_t x = 0; x < size; x++) {
+                unsigned long long counts = matrix[y * size + x];
+                if (counts == 0)
+                    continue;
+                his.Fill(100 + i, x, y, counts);
+                spectrum[x] += counts;
+            }
+        }
+        unsigned long long sum = Write1D(his, 200 + i, spectrum);
+        cout << "  Gate " << singles[i] << ": " << sum << " counts\n";
+    }
+
+    for (size_t i = 0; i < doubleGates.size(); i++) {
+        ProjectCube(cube, doubleGates[i].first.first,
+                    doubleGates[i].first.second, doubleGates[i].second.first,
+                    doubleGates[i].second.second, spectrum, numThreads);
+        unsigned long long sum = Write1D(his, 300 + i, spectrum);
+        cout << "  Gates " << doubles[i] << ": " << sum << " counts\n";
+    }
+
+    his.Close();
+    cout << PROGRAM_NAME << ": Wrote " << outName << ".his\n";
+    return 0;
+}
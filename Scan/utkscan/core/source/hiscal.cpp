@@ -0,0 +1,578 @@
+/** \file hiscal.cpp
+ * \brief Calibrates the channel energies from the raw spectra of a source run
+ *
+ * The raw energy spectra (D_RAW_ENERGY) of a .his file written by utkscan
+ * are read through a MappedHisFile, and every channel is calibrated on its
+ * own thread: the peaks of the smoothed spectrum are searched above the
+ * local background, the pairs of peaks are matched to the pairs of lines of
+ * the source to find the gain which puts the most peaks on lines, and the
+ * matched peaks are fitted with a gaussian over a linear background. The
+ * calibration is the weighted least squares fit of the line energies to the
+ * fitted centroids. The Calibration entries of every channel are written as
+ * the Module and Channel nodes of the Map of the configuration file.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdlib>
+
+#include "DammPlotIds.hpp"
+#include "Globals.hpp"
+#include "HisFile.hpp"
+
+// Define the name of the program.
+#ifndef PROGRAM_NAME
+#define PROGRAM_NAME "hiscal"
+#endif
+
+using std::cout;
+using std::endl;
+
+namespace {
+    /// The gamma lines (in keV) of the common calibration sources
+    const std::map<std::string, std::vector<double> > &Sources() {
+        static std::map<std::string, std::vector<double> > sources;
+        if (sources.empty()) {
+            sources["22Na"] = {511.0, 1274.537};
+            sources["60Co"] = {1173.228, 1332.492};
+            sources["133Ba"] = {81.00, 276.40, 302.85, 356.01, 383.85};
+            sources["137Cs"] = {661.657};
+            sources["152Eu"] = {121.78, 244.70, 344.28, 778.90, 964.08,
+                                1085.84, 1112.08, 1408.01};
+            sources["207Bi"] = {569.70, 1063.66, 1770.23};
+            sources["228Th"] = {238.63, 583.19, 727.33, 860.56, 2614.51};
+        }
+        return sources;
+    }
+
+    /// A peak found in a spectrum
+    struct Peak {
+        double channel; //!< the centroid (in bins)
+        double sigma; //!< the width (in bins)
+        double height; //!< the height above the background
+        double area; //!< the counts above the background
+    };
+
+    /// The calibration of one channel
+    struct Result {
+        unsigned int hisId; //!< the id of the raw energy spectrum
+        bool good; //!< true if enough lines were matched
+        std::string reason; //!< why the channel could not be calibrated
+        std::vector<double> pars; //!< the parameters of the calibration
+        std::vector<std::pair<double, Peak> > matched; //!< line energy and raw peak
+        double rms; //!< the rms residual of the lines (in keV)
+
+        Result() : hisId(0), good(false), rms(0) {}
+    };
+
+    /// The options of the calibration
+    struct Options {
+        std::vector<double> lines; //!< the line energies, in increasing order
+        unsigned int degree; //!< 1 for linear, 2 for quadratic
+        unsigned long long minCounts; //!< spectra with fewer counts are skipped
+        double tolerance; //!< the largest distance of a peak from its line (in keV)
+        double threshold; //!< the significance of a peak above the background
+        unsigned int smooth; //!< the half width of the smoothing (in bins)
+
+        Options() : degree(1), minCounts(1000), tolerance(3.0), threshold(5.0),
+            smooth(2) {}
+    };
+
+    /** Fit a gaussian over a linear background to the peak near a bin. The
+    * background is taken from the bins between 3 and 6 sigma on each side,
+    * and a parabola is fitted to the logarithm of the bins above half of the
+    * maximum, weighted by their squared counts.
+    * \return false if no peak could be fitted */
+    bool FitPeak(const std::vector<double> &spec, double guess, double sigma,
+                 Peak &peak) {
+        const int n = spec.size();
+        int center = (int)(guess + 0.5);
+        int inner = std::max(2, (int)(3 * sigma + 0.5));
+        int outer = std::max(inner + 2, (int)(6 * sigma + 0.5));
+        if (center - outer < 0 || center + outer >= n)
+            return false;
+
+        double left = 0, right = 0;
+        for (int i = inner; i < outer; i++) {
+            left += spec[center - i];
+            right += spec[center + i];
+        }
+        left /= outer - inner;
+        right /= outer - inner;
+        double slope = (right - left) / (inner + outer);
+
+        std::vector<double> net(2 * inner + 1);
+        int top = 0;
+        for (int i = -inner; i <= inner; i++) {
+            net[i + inner] = spec[center + i] - (0.5 * (left + right) + slope * i);
+            if (net[i + inner] > net[top])
+                top = i + inner;
+        }
+        double height = net[top];
+        if (height <= 0)
+            return false;
+
+        int low = top, high = top;
+        while (low > 0 && net[low - 1] > height / 2)
+            low--;
+        while (high + 1 < (int)net.size() && net[high + 1] > height / 2)
+            high++;
+
+        double s[5] = {0, 0, 0, 0, 0}, t[3] = {0, 0, 0};
+        double area = 0;
+        for (int i = low; i <= high; i++) {
+            double w = net[i] * net[i], ly = std::log(net[i]);
+            double x = i - top, xn = 1;
+            for (int k = 0; k < 5; k++) {
+                s[k] += w * xn;
+                if (k < 3)
+                    t[k] += w * xn * ly;
+                xn *= x;
+            }
+        }
+        for (size_t i = 0; i < net.size(); i++)
+            area += std::max(0.0, net[i]);
+
+        double det = s[0] * (s[2] * s[4] - s[3] * s[3]) -
+            s[1] * (s[1] * s[4] - s[3] * s[2]) + s[2] * (s[1] * s[3] - s[2] * s[2]);
+        if (high - low < 2 || det == 0)
+            return false;
+        double b = (s[0] * (t[1] * s[4] - s[3] * t[2]) -
+                    t[0] * (s[1] * s[4] - s[3] * s[2]) +
+                    s[2] * (s[1] * t[2] - t[1] * s[2])) / det;
+        double c = (s[0] * (s[2] * t[2] - t[1] * s[3]) -
+                    s[1] * (s[1] * t[2] - t[1] * s[2]) +
+                    t[0] * (s[1] * s[3] - s[2] * s[2])) / det;
+        if (c >= 0 || std::fabs(b / (2 * c)) > high - low)
+            return false;
+
+        peak.channel = center - inner + top - b / (2 * c);
+        peak.sigma = std::sqrt(-1 / (2 * c));
+        peak.height = height;
+        peak.area = area;
+        return true;
+    }
+
+    /** Find the peaks of a spectrum, the local maxima of the smoothed
+    * spectrum which stand more than threshold standard deviations above the
+    * background on both sides. The strongest maxPeaks of them are fitted and
+    * returned in increasing order of channel. */
+    void SearchPeaks(const std::vector<double> &spec, const Options &opts,
+                     unsigned int maxPeaks, std::vector<Peak> &peaks) {
+        const int n = spec.size();
+        const int h = opts.smooth;
+        std::vector<double> smooth(n, 0);
+        double sum = 0;
+        for (int i = 0; i < std::min(n, 2 * h + 1); i++)
+            sum += spec[i];
+        for (int i = h; i + h < n; i++) {
+            smooth[i] = sum / (2 * h + 1);
+            if (i + h + 1 < n)
+                sum += spec[i + h + 1] - spec[i - h];
+        }
+
+        const int gap = 3 * (h + 1), span = 2 * (h + 1);
+        std::vector<Peak> found;
+        for (int i = gap + span; i + gap + span < n; i++) {
+            if (smooth[i] <= 0 || smooth[i] < smooth[i - 1] ||
+                smooth[i] <= smooth[i + 1])
+                continue;
+            double left = 0, right = 0;
+            for (int j = gap; j < gap + span; j++) {
+                left += smooth[i - j];
+                right += smooth[i + j];
+            }
+            double bkg = std::max(left, right) / span;
+            double net = smooth[i] - bkg;
+            if (net <= opts.threshold * std::sqrt(std::max(bkg, 1.0) /
+                                                  (2 * h + 1)))
+                continue;
+            Peak p;
+            p.channel = i;
+            p.height = net;
+            p.sigma = 0;
+            p.area = 0;
+            found.push_back(p);
+        }
+
+        std::sort(found.begin(), found.end(), [](const Peak &a, const Peak &b) {
+            return a.height > b.height;
+        });
+        if (found.size() > maxPeaks)
+            found.resize(maxPeaks);
+
+        //! The width is estimated from the half maximum of the raw spectrum
+        for (std::vector<Peak>::iterator it = found.begin(); it != found.end();
+             ++it) {
+            int i = (int)it->channel;
+            double half = spec[i] - it->height / 2;
+            int low = i, high = i;
+            while (low > 0 && spec[low - 1] > half && i - low < 50)
+                low--;
+            while (high + 1 < n && spec[high + 1] > half && high - i < 50)
+                high++;
+            Peak fitted;
+            if (FitPeak(spec, i, std::max(1.0, (high - low + 1) / 2.355),
+                        fitted))
+                peaks.push_back(fitted);
+        }
+        std::sort(peaks.begin(), peaks.end(), [](const Peak &a, const Peak &b) {
+            return a.channel < b.channel;
+        });
+    }
+
+    /** Fit a polynomial of degree to the points (x, y) with weights w
+    * \return false if the fit is singular */
+    bool FitPolynomial(const std::vector<double> &x, const std::vector<double> &y,
+                       const std::vector<double> &w, unsigned int degree,
+                       std::vector<double> &pars) {
+        const unsigned int m = degree + 1;
+        std::vector<std::vector<double> > a(m, std::vector<double>(m + 1, 0));
+        for (size_t i = 0; i < x.size(); i++) {
+            std::vector<double> xn(2 * m, 1);
+            for (unsigned int k = 1; k < 2 * m; k++)
+                xn[k] = xn[k - 1] * x[i];
+            for (unsigned int r = 0; r < m; r++) {
+                for (unsigned int c = 0; c < m; c++)
+                    a[r][c] += w[i] * xn[r + c];
+                a[r][m] += w[i] * xn[r] * y[i];
+            }
+        }
+        //! Gaussian elimination with partial pivoting
+        for (unsigned int c = 0; c < m; c++) {
+            unsigned int pivot = c;
+            for (unsigned int r = c + 1; r < m; r++)
+                if (std::fabs(a[r][c]) > std::fabs(a[pivot][c]))
+                    pivot = r;
+            if (a[pivot][c] == 0)
+                return false;
+            std::swap(a[c], a[pivot]);
+            for (unsigned int r = 0; r < m; r++) {
+                if (r == c)
+                    continue;
+                double f = a[r][c] / a[c][c];
+                for (unsigned int k = c; k <= m; k++)
+                    a[r][k] -= f * a[c][k];
+            }
+        }
+        pars.resize(m);
+        for (unsigned int r = 0; r < m; r++)
+            pars[r] = a[r][m] / a[r][r];
+        return true;
+    }
+
+    /// Return the energy of a raw value
+    double Evaluate(const std::vector<double> &pars, double raw) {
+        double e = 0, xn = 1;
+        for (size_t i = 0; i < pars.size(); i++, xn *= raw)
+            e += pars[i] * xn;
+        return e;
+    }
+
+    /** Calibrate one channel from its raw energy spectrum */
+    void Calibrate(const HisView &view, const Options &opts, Result &result) {
+        const drr_entry *entry = view.GetEntry();
+        std::vector<double> spec(view.GetSize());
+        unsigned long long counts = 0;
+        for (size_t i = 0; i < spec.size(); i++) {
+            spec[i] = view[i];
+            counts += view[i];
+        }
+        if (counts < opts.minCounts) {
+            result.reason = "too few counts";
+            return;
+        }
+
+        //! The bins hold raw values from bin*comp to (bin+1)*comp-1
+        double comp = entry->scaled[0] > 0 ?
+                      (double)entry->raw[0] / entry->scaled[0] : 1;
+        if (comp < 1)
+            comp = 1;
+
+        std::vector<Peak> peaks;
+        SearchPeaks(spec, opts, std::max<unsigned int>(20, 3 * opts.lines.size()),
+                    peaks);
+        if (peaks.size() < std::min<size_t>(opts.lines.size(), opts.degree + 1)) {
+            result.reason = "too few peaks";
+            return;
+        }
+        std::vector<double> raw(peaks.size());
+        for (size_t i = 0; i < peaks.size(); i++)
+            raw[i] = peaks[i].channel * comp + (comp - 1) / 2;
+
+        //! Every pair of peaks is tried on every pair of lines, keeping the
+        //! gain which puts the most peaks on lines, then the strongest ones
+        const std::vector<double> &lines = opts.lines;
+        std::vector<int> best;
+        double bestScore = -1;
+        if (lines.size() == 1) {
+            best.assign(1, 0);
+            for (size_t i = 1; i < peaks.size(); i++)
+                if (peaks[i].area > peaks[best[0]].area)
+                    best[0] = i;
+        }
+        for (size_t i = 0; i < peaks.size(); i++) {
+            for (size_t j = i + 1; j < peaks.size(); j++) {
+                for (size_t k = 0; k < lines.size(); k++) {
+                    for (size_t l = k + 1; l < lines.size(); l++) {
+                        double gain = (lines[l] - lines[k]) / (raw[j] - raw[i]);
+                        double offset = lines[k] - gain * raw[i];
+                        std::vector<int> match(lines.size(), -1);
+                        double score = 0;
+                        for (size_t m = 0; m < lines.size(); m++) {
+                            double closest = opts.tolerance;
+                            for (size_t p = 0; p < peaks.size(); p++) {
+                                double d = std::fabs(offset + gain * raw[p] -
+                                                     lines[m]);
+                                if (d < closest) {
+                                    closest = d;
+                                    match[m] = p;
+                                }
+                            }
+                            if (match[m] >= 0)
+                                score += 1 + 0.5 * peaks[match[m]].area / counts;
+                        }
+                        if (score > bestScore) {
+                            bestScore = score;
+                            best = match;
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<double> x, y, w;
+        for (size_t m = 0; m < best.size(); m++) {
+            if (best[m] < 0)
+                continue;
+            const Peak &p = peaks[best[m]];
+            x.push_back(raw[best[m]]);
+            y.push_back(lines[m]);
+            w.push_back(p.area / std::max(p.sigma * p.sigma, 0.25));
+            result.matched.push_back(std::make_pair(lines[m], p));
+        }
+
+        //! A single line gives only the gain, through the origin
+        if (x.size() == 1 && opts.degree == 1) {
+            result.pars.assign(1, 0.0);
+            result.pars.push_back(y[0] / x[0]);
+        } else if (x.size() <= opts.degree ||
+                   !FitPolynomial(x, y, w, opts.degree, result.pars)) {
+            result.reason = "too few lines matched";
+            return;
+        }
+        if (result.pars[1] <= 0) {
+            result.reason = "negative gain";
+            return;
+        }
+
+        double sum = 0;
+        for (size_t i = 0; i < x.size(); i++)
+            sum += std::pow(Evaluate(result.pars, x[i]) - y[i], 2);
+        result.rms = std::sqrt(sum / x.size());
+        result.good = true;
+    }
+
+    /// Split a comma separated list
+    std::vector<std::string> Split(const std::string &list) {
+        std::vector<std::string> items;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+
+    void Help(const char *name) {
+        cout << "  SYNTAX: " << name << " <his prefix> [options]\n"
+             << "   Options:\n"
+             << "    --source <names>     | Calibration sources, comma separated ("
+             << "22Na, 60Co, 133Ba, 137Cs, 152Eu, 207Bi, 228Th)\n"
+             << "    --energies <keV,...> | Line energies, instead of or besides "
+             << "the sources\n"
+             << "    --ids <first>-<last> | Histogram ids of the raw energies "
+             << "(default=1-300)\n"
+             << "    --quadratic          | Fit a quadratic calibration instead "
+             << "of a linear one\n"
+             << "    --tolerance <keV>    | Largest distance of a peak from its "
+             << "line (default=3)\n"
+             << "    --threshold <sigma>  | Significance of a peak above the "
+             << "background (default=5)\n"
+             << "    --min-counts <num>   | Skip spectra with fewer counts "
+             << "(default=1000)\n"
+             << "    --threads <num>      | Channels calibrated at once "
+             << "(default=number of cores)\n"
+             << "    --output <file>      | The Map entries are written here "
+             << "(default=<his prefix>.cal.xml)\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        Help(argv[0]);
+        return (argc < 2 ? 1 : 0);
+    }
+
+    std::string prefix(argv[1]);
+    std::string outName = prefix + ".cal.xml";
+    std::string sourceNames;
+    Options opts;
+    unsigned int firstId = dammIds::raw::OFFSET + dammIds::raw::D_RAW_ENERGY;
+    unsigned int lastId = firstId + dammIds::raw::D_FILTER_ENERGY - 1;
+    unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg(argv[i]);
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--source" && hasValue) {
+            sourceNames = argv[++i];
+            std::vector<std::string> names = Split(sourceNames);
+            for (std::vector<std::string>::iterator it = names.begin();
+                 it != names.end(); ++it) {
+                std::map<std::string, std::vector<double> >::const_iterator src =
+                        Sources().find(*it);
+                if (src == Sources().end()) {
+                    cout << PROGRAM_NAME << ": Unknown source '" << *it << "'\n";
+                    return 1;
+                }
+                opts.lines.insert(opts.lines.end(), src->second.begin(),
+                                  src->second.end());
+            }
+        } else if (arg == "--energies" && hasValue) {
+            std::vector<std::string> energies = Split(argv[++i]);
+            for (std::vector<std::string>::iterator it = energies.begin();
+                 it != energies.end(); ++it)
+                opts.lines.push_back(strtod(it->c_str(), NULL));
+        } else if (arg == "--ids" && hasValue) {
+            std::string ids(argv[++i]);
+            firstId = strtoul(ids.c_str(), NULL, 0);
+            size_t dash = ids.find('-');
+            lastId = (dash == std::string::npos ? firstId :
+                      strtoul(ids.substr(dash + 1).c_str(), NULL, 0));
+        } else if (arg == "--quadratic")
+            opts.degree = 2;
+        else if (arg == "--tolerance" && hasValue)
+            opts.tolerance = strtod(argv[++i], NULL);
+        else if (arg == "--threshold" && hasValue)
+            opts.threshold = strtod(argv[++i], NULL);
+        else if (arg == "--min-counts" && hasValue)
+            opts.minCounts = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--threads" && hasValue)
+            numThreads = std::max(1ul, strtoul(argv[++i], NULL, 0));
+        else if (arg == "--output" && hasValue)
+            outName = argv[++i];
+        else {
+            cout << PROGRAM_NAME << ": Unknown option '" << arg << "'\n";
+            Help(argv[0]);
+            return 1;
+        }
+    }
+
+    std::sort(opts.lines.begin(), opts.lines.end());
+    opts.lines.erase(std::unique(opts.lines.begin(), opts.lines.end()),
+                     opts.lines.end());
+    if (opts.lines.empty()) {
+        cout << PROGRAM_NAME << ": No lines given, use --source or --energies\n";
+        return 1;
+    }
+
+    MappedHisFile his(prefix.c_str());
+    if (!his.IsOpen()) {
+        cout << PROGRAM_NAME << ": Failed to open '" << prefix << ".his'\n";
+        return 1;
+    }
+
+    //! The entries are read here, the views are then only read by the threads
+    std::vector<HisView> views;
+    std::vector<Result> results;
+    for (unsigned int id = firstId; id <= lastId; id++) {
+        HisView view = his.GetHistogram(id);
+        if (!view.IsValid() || view.GetEntry()->hisDim != 1)
+            continue;
+        views.push_back(view);
+        results.push_back(Result());
+        results.back().hisId = id;
+    }
+    if (views.empty()) {
+        cout << PROGRAM_NAME << ": No 1D spectra with ids " << firstId << " to "
+             << lastId << " in '" << prefix << "'\n";
+        return 1;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < std::min<size_t>(numThreads, views.size()); t++)
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < views.size(); i = next++)
+                Calibrate(views[i], opts, results[i]);
+        }));
+    for (std::vector<std::thread>::iterator it = workers.begin();
+         it != workers.end(); ++it)
+        it->join();
+
+    std::ofstream out(outName.c_str());
+    if (!out.good()) {
+        cout << PROGRAM_NAME << ": Failed to open '" << outName << "'\n";
+        return 1;
+    }
+    out << "<!-- Calibrated by " << PROGRAM_NAME << " from " << prefix
+        << ".his with the lines";
+    for (size_t i = 0; i < opts.lines.size(); i++)
+        out << " " << opts.lines[i];
+    out << " keV -->\n";
+
+    const unsigned int firstRaw = dammIds::raw::OFFSET +
+                                  dammIds::raw::D_RAW_ENERGY;
+    const char *model = (opts.degree == 1 ? "linear" : "quadratic");
+    int module = -1;
+    unsigned int numGood = 0;
+    cout << "   id  mod chan  lines   rms (keV)  parameters\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &res = results[i];
+        unsigned int index = res.hisId - firstRaw;
+        unsigned int mod = index / pixie::numberOfChannels;
+        unsigned int chan = index % pixie::numberOfChannels;
+        cout << std::right << std::setw(5) << res.hisId << std::setw(5) << mod
+             << std::setw(5) << chan;
+        if (!res.good) {
+            cout << "  " << res.reason << "\n";
+            continue;
+        }
+        cout << std::setw(7) << res.matched.size() << std::fixed
+             << std::setprecision(3) << std::setw(12) << res.rms << " ";
+        for (size_t p = 0; p < res.pars.size(); p++)
+            cout << " " << std::resetiosflags(std::ios::floatfield)
+                 << std::setprecision(6) << res.pars[p];
+        cout << "\n";
+
+        if ((int)mod != module) {
+            if (module >= 0)
+                out << "</Module>\n";
+            out << "<Module number=\"" << mod << "\">\n";
+            module = mod;
+        }
+        out << "    <Channel number=\"" << chan << "\">\n"
+            << "        <Calibration model=\"" << model << "\">\n"
+            << "            " << std::setprecision(6);
+        for (size_t p = 0; p < res.pars.size(); p++)
+            out << (p > 0 ? " " : "") << res.pars[p];
+        out << "\n        </Calibration>\n    </Channel>\n";
+        numGood++;
+    }
+    if (module >= 0)
+        out << "</Module>\n";
+
+    cout << PROGRAM_NAME << ": Calibrated " << numGood << " of "
+         << results.size() << " channels, written to '" << outName << "'\n";
+    return 0;
+}
@@ -0,0 +1,388 @@
+/** \file hisconv.cpp
+ * \brief Converts the histograms of a .his file to a ROOT or columnar file
+ *
+ * The .drr and .his files are read through a MappedHisFile, so the bins are
+ * read straight from the page cache instead of being copied spectrum by
+ * spectrum. The histograms are converted, and optionally rebinned, by a pool
+ * of threads, while the main thread writes the converted histograms in the
+ * order of their ids. Only a few histograms per thread are converted ahead
+ * of the one being written, so the memory used stays small for any size of
+ * .his file.
+ *
+ * The ROOT output holds a TH1 or TH2 named h<id> for each histogram, with
+ * 32 bit bins unless a rebinned bin exceeds them. The columnar output (see
+ * ColumnWriter.hpp) holds the bins which are not empty as rows of the id,
+ * x, y and counts columns, and <output>_his.col the id, dimension and number
+ * of bins along x and y of each histogram. The titles are in the .list file
+ * of the input.
+ */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "ColumnWriter.hpp"
+#include "HisFile.hpp"
+
+#ifdef USE_ROOT
+#include <TFile.h>
+#include <TH1D.h>
+#include <TH1I.h>
+#include <TH2D.h>
+#include <TH2I.h>
+#endif
+
+// Define the name of the program.
+#ifndef PROGRAM_NAME
+#define PROGRAM_NAME "hisconv"
+#endif
+
+using std::cout;
+using std::endl;
+
+namespace {
+    /// A histogram converted by a thread and waiting to be written
+    struct Converted {
+        unsigned int hisId; //!< the id of the histogram
+        unsigned int dim; //!< 1 or 2
+        unsigned int xBins; //!< the number of bins along x, once rebinned
+        unsigned int yBins; //!< the number of bins along y, once rebinned
+        unsigned int xWidth; //!< the number of input bins in a bin along x
+        unsigned int yWidth; //!< the number of input bins in a bin along y
+        std::string title; //!< the title of the histogram
+        std::vector<unsigned long long> bins; //!< the counts, x running fastest
+        unsigned long long maxCount; //!< the largest count
+        unsigned long long total; //!< the sum of the counts
+        bool ready; //!< true once converted
+
+        Converted() : hisId(0), dim(1), xBins(0), yBins(1), xWidth(1),
+                      yWidth(1), maxCount(0), total(0), ready(false) {}
+    };
+
+    /// Sum the bins of a histogram into bins of xWidth by yWidth input bins
+    void Convert(const HisView &view, unsigned int xWidth, unsigned int yWidth,
+                 Converted &out) {
+        const drr_entry *entry = view.GetEntry();
+        unsigned int nx = entry->scaled[0];
+        unsigned int ny = (entry->hisDim > 1 ? entry->scaled[1] : 1);
+        if (entry->hisDim < 2)
+            yWidth = 1;
+
+        out.hisId = entry->hisID;
+        out.dim = (entry->hisDim > 1 ? 2 : 1);
+        out.xWidth = xWidth;
+        out.yWidth = yWidth;
+        out.xBins = (nx + xWidth - 1) / xWidth;
+        out.yBins = (ny + yWidth - 1) / yWidth;
+        out.title.assign(entry->title, strnlen(entry->title, 40));
+        out.title.erase(out.title.find_last_not_of(' ') + 1);
+        out.bins.assign((size_t)out.xBins * out.yBins, 0);
+
+        //! The rows are read in order, so the file is read sequentially
+        for (unsigned int y = 0; y < ny; y++) {
+            unsigned long long *row = &out.bins[(size_t)(y / yWidth) * out.xBins];
+            size_t first = (size_t)y * nx;
+            if (entry->use_int) {
+                const unsigned int *bins = (const unsigned int *)view.GetBins() + first;
+                for (unsigned int x = 0; x < nx; x++)
+                    row[x / xWidth] += bins[x];
+            } else {
+                const unsigned short *bins = (const unsigned short *)view.GetBins() + first;
+                for (unsigned int x = 0; x < nx; x++)
+                    row[x / xWidth] += bins[x];
+            }
+        }
+
+        for (size_t i = 0; i < out.bins.size(); i++) {
+            out.total += out.bins[i];
+            out.maxCount = std::max(out.maxCount, out.bins[i]);
+        }
+    }
+
+#ifdef USE_ROOT
+    /// Copy the counts into the bins of a ROOT histogram, leaving its
+    /// underflow and overflow bins empty
+    template<typename T>
+    void SetContents(TH1 *hist, const Converted &his) {
+        T *array = dynamic_cast<T *>(hist);
+        unsigned int stride = his.xBins + 2;
+        for (unsigned int y = 0; y < his.yBins; y++) {
+            size_t out = (his.dim > 1 ? (size_t)(y + 1) * stride : 0) + 1;
+            for (unsigned int x = 0; x < his.xBins; x++)
+                array->fArray[out + x] = his.bins[(size_t)y * his.xBins + x];
+        }
+        hist->SetEntries(his.total);
+    }
+
+    /// Write a histogram to the ROOT file
+    void WriteRoot(TFile &file, const Converted &his) {
+        std::stringstream name;
+        name << "h" << his.hisId;
+        bool wide = his.maxCount > (unsigned long long)INT_MAX;
+        double xHigh = (double)his.xBins * his.xWidth;
+        double yHigh = (double)his.yBins * his.yWidth;
+        TH1 *hist;
+        if (his.dim == 1) {
+            if (wide) {
+                hist = new TH1D(name.str().c_str(), his.title.c_str(),
+                                his.xBins, 0, xHigh);
+                SetContents<TArrayD>(hist, his);
+            } else {
+                hist = new TH1I(name.str().c_str(), his.title.c_str(),
+                                his.xBins, 0, xHigh);
+                SetContents<TArrayI>(hist, his);
+            }
+        } else {
+            if (wide) {
+                hist = new TH2D(name.str().c_str(), his.title.c_str(),
+                                his.xBins, 0, xHigh, his.yBins, 0, yHigh);
+                SetContents<TArrayD>(hist, his);
+            } else {
+                hist = new TH2I(name.str().c_str(), his.title.c_str(),
+                                his.xBins, 0, xHigh, his.yBins, 0, yHigh);
+                SetContents<TArrayI>(hist, his);
+            }
+        }
+        file.cd();
+        hist->Write();
+        delete hist;
+    }
+#endif
+
+    /// The columnar output, the bins and the list of histograms
+    struct ColumnOutput {
+        ColumnWriter bins; //!< the bins which are not empty
+        ColumnWriter hists; //!< a row for each histogram
+        unsigned int id, x, y, dim, xBins, yBins; //!< the values of a row
+        unsigned long long counts; //!< the counts of a bin
+
+        ColumnOutput(const std::string &prefix) :
+            bins(prefix + ".col", 65536, 1, true),
+            hists(prefix + "_his.col", 4096, 1, false) {
+            bins.AddColumn("id", &id);
+            bins.AddColumn("x", &x);
+            bins.AddColumn("y", &y);
+            bins.AddColumn("counts", &counts);
+            hists.AddColumn("id", &id);
+            hists.AddColumn("dim", &dim);
+            hists.AddColumn("xbins", &xBins);
+            hists.AddColumn("ybins", &yBins);
+        }
+
+        /// Write the bins of a histogram which are not empty, and its row
+        void Write(const Converted &his) {
+            id = his.hisId;
+            for (y = 0; y < his.yBins; y++) {
+                const unsigned long long *row = &his.bins[(size_t)y * his.xBins];
+                for (x = 0; x < his.xBins; x++) {
+                    if (row[x] == 0)
+                        continue;
+                    counts = row[x];
+                    bins.Fill();
+                }
+            }
+            dim = his.dim;
+            xBins = his.xBins;
+            yBins = his.yBins;
+            hists.Fill();
+        }
+    };
+
+    void Help(const char *name) {
+        cout << "  SYNTAX: " << name << " <his prefix> [options]\n"
+             << "   Options:\n"
+             << "    --format <root|col>  | The output format (default="
+#ifdef USE_ROOT
+             << "root)\n"
+#else
+             << "col)\n"
+#endif
+             << "    --ids <first>-<last> | Only convert these histogram ids\n"
+             << "    --rebin <x>[,<y>]    | Sum x (and y) bins into one "
+             << "(default=1, y defaults to x)\n"
+             << "    --threads <num>      | Histograms converted at once "
+             << "(default=number of cores)\n"
+             << "    --output <prefix>    | The output is <prefix>.root or "
+             << "<prefix>.col (default=<his prefix>)\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        Help(argv[0]);
+        return (argc < 2 ? 1 : 0);
+    }
+
+    std::string prefix(argv[1]);
+    std::string outName = prefix;
+#ifdef USE_ROOT
+    std::string format = "root";
+#else
+    std::string format = "col";
+#endif
+    unsigned int firstId = 0;
+    unsigned int lastId = UINT_MAX;
+    unsigned int xWidth = 1;
+    unsigned int yWidth = 1;
+    unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg(argv[i]);
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--format" && hasValue)
+            format = argv[++i];
+        else if (arg == "--ids" && hasValue) {
+            std::string ids(argv[++i]);
+            firstId = strtoul(ids.c_str(), NULL, 0);
+            size_t dash = ids.find('-');
+            lastId = (dash == std::string::npos ? firstId :
+                      strtoul(ids.substr(dash + 1).c_str(), NULL, 0));
+        } else if (arg == "--rebin" && hasValue) {
+            std::string widths(argv[++i]);
+            xWidth = std::max(1ul, strtoul(widths.c_str(), NULL, 0));
+            size_t comma = widths.find(',');
+            yWidth = (comma == std::string::npos ? xWidth :
+                      std::max(1ul, strtoul(widths.substr(comma + 1).c_str(),
+                                            NULL, 0)));
+        } else if (arg == "--threads" && hasValue)
+            numThreads = std::max(1ul, strtoul(argv[++i], NULL, 0));
+        else if (arg == "--output" && hasValue)
+            outName = argv[++i];
+        else {
+            cout << PROGRAM_NAME << ": Unknown option '" << arg << "'\n";
+            Help(argv[0]);
+            return 1;
+        }
+    }
+
+#ifdef USE_ROOT
+    if (format != "root" && format != "col") {
+#else
+    if (format != "col") {
+#endif
+        cout << PROGRAM_NAME << ": Unsupported format '" << format << "'\n";
+        return 1;
+    }
+
+    MappedHisFile his(prefix.c_str());
+    if (!his.IsOpen()) {
+        cout << PROGRAM_NAME << ": Failed to open '" << prefix << ".his'\n";
+        return 1;
+    }
+
+    //! The entries are read here, the views are then only read by the threads
+    std::vector<HisView> views;
+    std::vector<unsigned int> ids = his.GetIdList();
+    for (std::vector<unsigned int>::iterator it = ids.begin(); it != ids.end();
+         ++it) {
+        if (*it < firstId || *it > lastId)
+            continue;
+        HisView view = his.GetHistogram(*it);
+        if (view.IsValid() && view.GetSize() > 0)
+            views.push_back(view);
+    }
+    if (views.empty()) {
+        cout << PROGRAM_NAME << ": No histograms to convert in '" << prefix
+             << "'\n";
+        return 1;
+    }
+
+#ifdef USE_ROOT
+    TFile *rootFile = NULL;
+    if (format == "root") {
+        rootFile = new TFile((outName + ".root").c_str(), "RECREATE");
+        if (rootFile->IsZombie()) {
+            cout << PROGRAM_NAME << ": Failed to open '" << outName
+                 << ".root'\n";
+            return 1;
+        }
+    }
+#endif
+    ColumnOutput *colFile = NULL;
+    if (format == "col") {
+        colFile = new ColumnOutput(outName);
+        if (!colFile->bins.IsOpen() || !colFile->hists.IsOpen()) {
+            cout << PROGRAM_NAME << ": Failed to open '" << outName
+                 << ".col'\n";
+            return 1;
+        }
+    }
+
+    //! A thread only takes a histogram this far ahead of the one written
+    const size_t window = 4 * numThreads;
+    std::vector<Converted> converted(views.size());
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t next = 0;
+    size_t written = 0;
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < std::min<size_t>(numThreads, views.size()); t++)
+        workers.push_back(std::thread([&]() {
+            while (true) {
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() {
+                        return next >= views.size() || next < written + window;
+                    });
+                    if (next >= views.size())
+                        return;
+                    i = next++;
+                }
+                Convert(views[i], xWidth, yWidth, converted[i]);
+                std::lock_guard<std::mutex> lock(mutex);
+                converted[i].ready = true;
+                changed.notify_all();
+            }
+        }));
+
+    unsigned long long numBins = 0;
+    for (size_t i = 0; i < converted.size(); i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return converted[i].ready; });
+        }
+#ifdef USE_ROOT
+        if (rootFile)
+            WriteRoot(*rootFile, converted[i]);
+#endif
+        if (colFile)
+            colFile->Write(converted[i]);
+        numBins += converted[i].bins.size();
+        std::vector<unsigned long long>().swap(converted[i].bins);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        written = i + 1;
+        changed.notify_all();
+    }
+    for (std::vector<std::thread>::iterator it = workers.begin();
+         it != workers.end(); ++it)
+        it->join();
+
+#ifdef USE_ROOT
+    if (rootFile) {
+        rootFile->Close();
+        delete rootFile;
+    }
+#endif
+    if (colFile) {
+        colFile->bins.Close();
+        colFile->hists.Close();
+        delete colFile;
+    }
+
+    cout << PROGRAM_NAME << ": Converted " << converted.size()
+         << " histograms (" << numBins << " bins) of '" << prefix << "' to '"
+         << outName << "." << format << "'\n";
+    return 0;
+}
@@ -0,0 +1,279 @@
+/** \file utkbench.cpp
+ * \brief Measures the throughput of utkscan on synthetic spills
+ *
+ * The scan is set up from a configuration file exactly as utkscan does, but
+ * instead of reading an input file the Unpacker is fed spills made by the
+ * SpillGenerator. The time spent building events and running them through
+ * the processors and analyzers is reported as hits/s and MB/s, followed by
+ * the fill rate of the declared histograms. The time spent in each processor
+ * and analyzer is printed by the Profiler when the scan is closed.
+ *
+ * With --replay, the raw events recorded by a scan (utkscan --record) are
+ * loaded into memory once and run through the processors and analyzers of
+ * the configuration again and again, without any unpacking or reading of
+ * files in between. Every pass is reported as raw events/s and allocations
+ * per raw event, so the cost of the processors is measured on their own. The
+ * allocations are counted by replacing the global operator new.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "HisFile.hpp"
+#include "RawEventFile.hpp"
+#include "SpillGenerator.hpp"
+#include "UtkScanInterface.hpp"
+#include "UtkUnpacker.hpp"
+
+// Define the name of the program.
+#ifndef PROGRAM_NAME
+#define PROGRAM_NAME "utkbench"
+#endif
+
+using std::cout;
+using std::endl;
+
+namespace {
+    std::atomic<unsigned long long> numAllocations(0); //!< calls to operator new
+}
+
+void* operator new(size_t size) {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+/// Return the seconds elapsed since a time point.
+static double Elapsed(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start).count();
+}
+
+/// Print the throughput of one stage of the benchmark.
+static void Report(const std::string &stage, double seconds,
+                   unsigned long long hits, unsigned long long words) {
+    cout << " " << std::left << std::setw(10) << stage << std::right
+         << std::fixed << std::setprecision(3) << std::setw(10) << seconds
+         << " s" << std::setprecision(2) << std::setw(12)
+         << hits / seconds / 1E6 << " Mhits/s" << std::setprecision(1)
+         << std::setw(10) << words * 4 / seconds / 1E6 << " MB/s" << endl;
+}
+
+/// Fill every declared histogram with random values and return the number
+/// of fills done.
+static unsigned long long FillHistograms(unsigned int fillsPerHis) {
+    std::mt19937 rng(1);
+    unsigned long long numFills = 0;
+    const std::map<unsigned int, drr_entry *> &drrMap = output_his->GetDrrMap();
+    for (unsigned int i = 0; i < fillsPerHis; i++) {
+        for (std::map<unsigned int, drr_entry *>::const_iterator it =
+                drrMap.begin(); it != drrMap.end(); ++it) {
+            unsigned int x = rng() % (it->second->scaled[0] + 1);
+            unsigned int y = (it->second->hisDim > 1 ?
+                              rng() % (it->second->scaled[1] + 1) : 0);
+            output_his->Fill(it->first, x, y);
+            numFills++;
+        }
+    }
+    return numFills;
+}
+
+static void Help(const char *name) {
+    cout << "  SYNTAX: " << name << " -c <config> [bench options] "
+         << "[scan options]\n"
+         << "   Benchmark options:\n"
+         << "    --modules <num>      | The number of modules (default=4)\n"
+         << "    --rate <Hz>          | The event rate (default=1E5)\n"
+         << "    --mult <num>         | The mean channels per event (default=2)\n"
+         << "    --trace <samples>    | The trace length of every hit (default=0)\n"
+         << "    --spill-time <s>     | The length of a spill (default=0.1)\n"
+         << "    --spills <num>       | The number of spills (default=50)\n"
+         << "    --seed <seed>        | The seed of the generator (default=1)\n"
+         << "    --fills <num>        | The fills of every histogram (default=1000)\n"
+         << "   Replay options:\n"
+         << "    --replay <file.rev>  | Run the raw events of a file recorded by "
+         << "utkscan --record instead of synthetic spills\n"
+         << "    --events <num>       | The raw events loaded into memory "
+         << "(default=all)\n"
+         << "    --passes <num>       | The passes over the loaded raw events "
+         << "(default=5)\n"
+         << "   All other options are passed on to the scan, which always runs "
+         << "in batch mode.\n";
+}
+
+/// Run the raw events loaded from a .rev file through the processors a
+/// number of times and report the rate and allocations of each pass. The
+/// first pass also initializes the DetectorDriver, so it is reported apart
+/// from the mean of the others.
+static int Replay(Unpacker *core, RawEventReader &reader,
+                  unsigned long long maxEvents, unsigned int numPasses) {
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+    unsigned long long numEvents = reader.Load(maxEvents);
+    if (numEvents == 0) {
+        cout << PROGRAM_NAME << ": No raw events could be loaded" << endl;
+        return 1;
+    }
+    cout << "\n Loaded " << numEvents << " raw events in "
+         << std::setprecision(3) << Elapsed(start) << " s.\n\n"
+         << " pass          time     event rate   allocations/event" << endl;
+
+    double warmTime = 0;
+    unsigned long long warmAllocations = 0;
+    for (unsigned int pass = 0; pass < numPasses; pass++) {
+        reader.Rewind();
+        unsigned long long allocations = numAllocations.load();
+        start = std::chrono::steady_clock::now();
+        while (core->ReplayRawEvent(reader)) {}
+        core->FlushEvents();
+        double seconds = Elapsed(start);
+        allocations = numAllocations.load() - allocations;
+
+        cout << " " << std::left << std::setw(8) << pass + 1 << std::right
+             << std::fixed << std::setprecision(3) << std::setw(10) << seconds
+             << " s" << std::setprecision(1) << std::setw(10)
+             << numEvents / seconds / 1E3 << " kHz" << std::setprecision(2)
+             << std::setw(16) << (double)allocations / numEvents << endl;
+        if (pass > 0) {
+            warmTime += seconds;
+            warmAllocations += allocations;
+        }
+    }
+
+    if (numPasses > 1) {
+        unsigned long long warmEvents = numEvents * (numPasses - 1);
+        cout << " " << std::left << std::setw(8) << "mean" << std::right
+             << std::setprecision(3) << std::setw(10)
+             << warmTime / (numPasses - 1) << " s" << std::setprecision(1)
+             << std::setw(10) << warmEvents / warmTime / 1E3 << " kHz"
+             << std::setprecision(2) << std::setw(16)
+             << (double)warmAllocations / warmEvents << "\n";
+    }
+    cout << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    SpillGenerator generator;
+    unsigned int numSpills = 50;
+    unsigned int fillsPerHis = 1000;
+    std::string replayName;
+    unsigned long long maxEvents = 0;
+    unsigned int numPasses = 5;
+
+    // Take the benchmark options out and pass the rest on to the scan.
+    std::vector<char *> args(1, argv[0]);
+    static char batchArg[] = "-b";
+    args.push_back(batchArg);
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-h" || arg == "--help") {
+            Help(argv[0]);
+            return 0;
+        }
+        bool hasValue = (i + 1 < argc);
+        if (arg == "--modules" && hasValue)
+            generator.SetModules(strtoul(argv[++i], NULL, 0));
+        else if (arg == "--rate" && hasValue)
+            generator.SetRate(strtod(argv[++i], NULL));
+        else if (arg == "--mult" && hasValue)
+            generator.SetMultiplicity(strtod(argv[++i], NULL));
+        else if (arg == "--trace" && hasValue)
+            generator.SetTraceLength(strtoul(argv[++i], NULL, 0));
+        else if (arg == "--spill-time" && hasValue)
+            generator.SetSpillTime(strtod(argv[++i], NULL));
+        else if (arg == "--spills" && hasValue)
+            numSpills = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--seed" && hasValue)
+            generator.SetSeed(strtoul(argv[++i], NULL, 0));
+        else if (arg == "--fills" && hasValue)
+            fillsPerHis = strtoul(argv[++i], NULL, 0);
+        else if (arg == "--replay" && hasValue)
+            replayName = argv[++i];
+        else if (arg == "--events" && hasValue)
+            maxEvents = strtoull(argv[++i], NULL, 0);
+        else if (arg == "--passes" && hasValue)
+            numPasses = std::max(1ul, strtoul(argv[++i], NULL, 0));
+        else
+            args.push_back(argv[i]);
+    }
+    args.push_back(NULL);
+
+    if (generator.GetModules() > 14) {
+        cout << "utkbench.cpp : No more than 14 modules per crate" << endl;
+        return 1;
+    }
+
+    UtkScanInterface scanner;
+    scanner.SetProgramName(std::string(PROGRAM_NAME));
+    if (!scanner.Setup(args.size() - 1, args.data()))
+        return 1;
+    Unpacker *core = scanner.GetCore();
+
+    if (!replayName.empty()) {
+        RawEventReader reader;
+        if (!reader.Open(replayName)) {
+            cout << PROGRAM_NAME << ": Failed to open the raw event file '"
+                 << replayName << "'" << endl;
+            return 1;
+        }
+        int retval = Replay(core, reader, maxEvents, numPasses);
+
+        // The Profiler prints the time of every processor and analyzer here.
+        scanner.Close();
+        return retval;
+    }
+
+    std::vector<std::vector<unsigned int> > spills(numSpills);
+    unsigned long long numHits = 0;
+    unsigned long long numWords = 0;
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+    for (std::vector<std::vector<unsigned int> >::iterator it = spills.begin();
+         it != spills.end(); ++it) {
+        numHits += generator.Next(*it);
+        numWords += it->size();
+    }
+    double genTime = Elapsed(start);
+
+    start = std::chrono::steady_clock::now();
+    for (std::vector<std::vector<unsigned int> >::iterator it = spills.begin();
+         it != spills.end(); ++it)
+        core->ReadSpill(it->data(), it->size(), false);
+    core->FlushEvents();
+    double scanTime = Elapsed(start);
+
+    start = std::chrono::steady_clock::now();
+    unsigned long long numFills = FillHistograms(fillsPerHis);
+    double fillTime = Elapsed(start);
+
+    cout << "\n Generated " << numSpills << " spills, " << numHits
+         << " hits, " << numWords * 4 / 1E6 << " MB.\n\n"
+         << " stage          time        hit rate      data rate" << endl;
+    Report("generate", genTime, numHits, numWords);
+    Report("scan", scanTime, numHits, numWords);
+    cout << " " << std::left << std::setw(10) << "histogram" << std::right
+         << std::setprecision(3) << std::setw(10)
+         << fillTime << " s" << std::setprecision(2) << std::setw(12)
+         << numFills / fillTime / 1E6 << " Mfills/s ("
+         << output_his->GetDrrMap().size() << " histograms)\n" << endl;
+
+    // The Profiler prints the time of every processor and analyzer here.
+    scanner.Close();
+    return 0;
+}
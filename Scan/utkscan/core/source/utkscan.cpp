@@ -1,6 +1,20 @@
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 // Local files
+#include "HisFile.hpp"
+#include "SkimWriter.hpp"
 #include "UtkScanInterface.hpp"
 #include "UtkUnpacker.hpp"
 
@@ -12,7 +26,8 @@
 using std::cout;
 using std::endl;
 
-int main(int argc, char *argv[]){
+/// Set up and run a single scan with the given command line arguments.
+static int RunScan(int argc, char *argv[]) {
     // Define a new unpacker object.
     cout << "utkscan.cpp : Instancing the UtkScanInterface" << endl;
     UtkScanInterface scanner;
@@ -36,3 +51,338 @@ int main(int argc, char *argv[]){
     //return how things went
     return(retval);
 }
+
+/// Return the value of an option with an argument, or an empty string if
+/// argv[index] is not that option. index is advanced past a separate argument.
+static std::string GetOptionValue(int argc, char *argv[], int &index,
+                                  const char shortName, const char *longName) {
+    std::string arg(argv[index]);
+    std::string longOpt = std::string("--") + longName;
+    if ((arg == longOpt || (arg.size() == 2 && arg[0] == '-' &&
+                            arg[1] == shortName)) && index + 1 < argc)
+        return argv[++index];
+    if (arg.compare(0, longOpt.size() + 1, longOpt + "=") == 0)
+        return arg.substr(longOpt.size() + 1);
+    if (arg.size() > 2 && arg[0] == '-' && arg[1] == shortName)
+        return arg.substr(2);
+    return "";
+}
+
+/// Quote an argument for the shell of a remote host.
+static std::string ShellQuote(const std::string &arg) {
+    std::string quoted = "'";
+    for (size_t i = 0; i < arg.size(); i++) {
+        if (arg[i] == '\'')
+            quoted += "'\\''";
+        else
+            quoted += arg[i];
+    }
+    return quoted + "'";
+}
+
+/// Split a list at every delim, dropping the empty entries.
+static std::vector<std::string> SplitList(const std::string &list,
+                                          const char delim) {
+    std::vector<std::string> entries;
+    std::stringstream ss(list);
+    std::string entry;
+    while (std::getline(ss, entry, delim))
+        if (!entry.empty())
+            entries.push_back(entry);
+    return entries;
+}
+
+/// The hosts the scans are run on, and how they are started there.
+struct HostList {
+    std::vector<std::string> names; ///< The hosts, empty to scan locally
+    std::vector<std::string> launcher; ///< The command which runs a shell command on a host
+    std::vector<unsigned int> running; ///< The number of scans running on each host
+};
+
+/// Start a scan in a new process, locally or on a host through the
+/// launcher. The output of the scan is kept in prefix.out.
+static pid_t StartScan(const std::vector<std::string> &workerArgs,
+                       const std::string &logName, bool append,
+                       const HostList &hosts, size_t host) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    if (!freopen(logName.c_str(), append ? "a" : "w", stdout) ||
+        !freopen(logName.c_str(), "a", stderr))
+        _exit(EXIT_FAILURE);
+
+    std::vector<std::string> command;
+    if (hosts.names.empty())
+        command = workerArgs;
+    else {
+        //The remote scan runs the same program in the same directory, so
+        // the hosts have to share the file system.
+        char path[4096], cwd[4096];
+        ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+        if (length <= 0 || !getcwd(cwd, sizeof(cwd)))
+            _exit(EXIT_FAILURE);
+        path[length] = '\0';
+
+        std::stringstream remote;
+        remote << "cd " << ShellQuote(cwd) << " && exec " << ShellQuote(path);
+        for (size_t i = 1; i < workerArgs.size(); i++)
+            remote << " " << ShellQuote(workerArgs[i]);
+
+        command = hosts.launcher;
+        command.push_back(hosts.names[host]);
+        command.push_back(remote.str());
+    }
+
+    std::vector<char *> commandArgv;
+    for (std::vector<std::string>::iterator it = command.begin();
+         it != command.end(); it++)
+        commandArgv.push_back(const_cast<char *>(it->c_str()));
+    commandArgv.push_back(NULL);
+    if (hosts.names.empty())
+        exit(RunScan(commandArgv.size() - 1, commandArgv.data()));
+    execvp(commandArgv[0], commandArgv.data());
+    _exit(EXIT_FAILURE);
+}
+
+/// Scan several input files at once, each in its own process so that every
+/// scan has its own DetectorDriver state, and sum their histograms into the
+/// requested output file once all of the scans are done. When shards is
+/// larger than one, the spills of every file are also divided between that
+/// many scans (see ScanInterface::SetSpillShard), so that a single file is
+/// processed in parallel with every scan filling its own histogram file.
+/// With a list of hosts the scans are spread over the hosts, jobs at a time
+/// on each, instead of being run locally. A scan which fails is started once
+/// more, on another host if there is one, resuming from its last checkpoint
+/// if checkpoints are written. The skim files of the scans are merged as
+/// well.
+static int RunMultiFileScan(const std::vector<std::string> &inputs,
+                            const std::string &output, unsigned int jobs,
+                            unsigned int shards,
+                            const std::vector<std::string> &args,
+                            HostList &hosts) {
+    static const unsigned int maxAttempts = 2;
+    std::vector<std::string> prefixes;
+    std::vector<std::string> names;
+    std::map<pid_t, std::pair<size_t, size_t> > running;
+    size_t numScans = inputs.size() * shards;
+    std::vector<bool> succeeded(numScans, false);
+    std::vector<unsigned int> attempts(numScans, 0);
+    std::vector<size_t> lastHost(numScans, (size_t)-1);
+    std::deque<size_t> pending;
+    size_t numDone = 0;
+
+    bool checkpoints = false;
+    for (std::vector<std::string>::const_iterator it = args.begin();
+         it != args.end(); it++)
+        checkpoints |= (it->compare(0, 12, "--checkpoint") == 0);
+
+    cout << "utkscan.cpp : Scanning " << inputs.size() << " files";
+    if (shards > 1)
+        cout << " in " << shards << " spill shards each";
+    if (hosts.names.empty())
+        cout << " using " << jobs << " processes" << endl;
+    else
+        cout << " on " << hosts.names.size() << " hosts using " << jobs
+             << " processes each" << endl;
+
+    for (size_t i = 0; i < numScans; i++) {
+        std::stringstream prefix, name;
+        prefix << output << "_part" << i;
+        prefixes.push_back(prefix.str());
+        name << inputs[i / shards];
+        if (shards > 1)
+            name << " (shard " << i % shards << "/" << shards << ")";
+        names.push_back(name.str());
+        pending.push_back(i);
+    }
+    if (hosts.names.empty())
+        hosts.running.assign(1, 0);
+    else
+        hosts.running.assign(hosts.names.size(), 0);
+
+    while (!pending.empty() || !running.empty()) {
+        //The free host with the fewest scans. A scan which is started again
+        // is not run on the host where it failed, if there is another one.
+        size_t host = hosts.running.size();
+        if (!pending.empty()) {
+            for (size_t h = 0; h < hosts.running.size(); h++) {
+                if (hosts.running[h] >= jobs ||
+                    (h == lastHost[pending.front()] &&
+                     hosts.running.size() > 1))
+                    continue;
+                if (host == hosts.running.size() ||
+                    hosts.running[h] < hosts.running[host])
+                    host = h;
+            }
+        }
+
+        if (host < hosts.running.size()) {
+            size_t next = pending.front();
+            pending.pop_front();
+
+            // Every worker runs in batch mode with its own output file.
+            std::vector<std::string> workerArgs(args);
+            workerArgs.push_back("-b");
+            workerArgs.push_back("-i");
+            workerArgs.push_back(inputs[next / shards]);
+            workerArgs.push_back("-o");
+            workerArgs.push_back(prefixes[next]);
+            if (shards > 1) {
+                std::stringstream shard;
+                shard << next % shards << "/" << shards;
+                workerArgs.push_back("--shard");
+                workerArgs.push_back(shard.str());
+            }
+            if (attempts[next] > 0 && checkpoints)
+                workerArgs.push_back("--resume");
+
+            pid_t pid = StartScan(workerArgs, prefixes[next] + ".out",
+                                  attempts[next] > 0, hosts, host);
+            attempts[next]++;
+            lastHost[next] = host;
+            if (pid < 0) {
+                cout << "utkscan.cpp : Failed to start a scan for "
+                     << names[next] << endl;
+                numDone++;
+                continue;
+            }
+            cout << "utkscan.cpp : Started scan of " << names[next];
+            if (!hosts.names.empty())
+                cout << " on " << hosts.names[host];
+            cout << " (pid " << pid << ")" << endl;
+            running[pid] = std::make_pair(next, host);
+            hosts.running[host]++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            break;
+        std::map<pid_t, std::pair<size_t, size_t> >::iterator it =
+                running.find(pid);
+        if (it == running.end())
+            continue;
+        size_t scan = it->second.first;
+        hosts.running[it->second.second]--;
+        running.erase(it);
+
+        succeeded[scan] = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!succeeded[scan] && attempts[scan] < maxAttempts) {
+            cout << "utkscan.cpp : Scan of " << names[scan]
+                 << " FAILED, starting it again" << endl;
+            pending.push_back(scan);
+            continue;
+        }
+        numDone++;
+        cout << "utkscan.cpp : Scan of " << names[scan]
+             << (succeeded[scan] ? " finished" : " FAILED") << " ("
+             << numDone << " of " << numScans << " done)" << endl;
+    }
+
+    std::vector<std::string> finished;
+    for (size_t i = 0; i < numScans; i++) {
+        if (succeeded[i])
+            finished.push_back(prefixes[i]);
+        else
+            cout << "utkscan.cpp : Leaving " << names[i]
+                 << " out of the summed histograms, see " << prefixes[i]
+                 << ".out" << endl;
+    }
+
+    cout << "utkscan.cpp : Summing the histograms of " << finished.size()
+         << " scans into " << output << ".his" << endl;
+    if (finished.empty() || !OutputHisFile::Sum(output, finished)) {
+        cout << "utkscan.cpp : Failed to sum the histograms!" << endl;
+        return 1;
+    }
+
+    // The summed file replaces the histograms of the individual scans.
+    std::vector<std::string> skims;
+    for (std::vector<std::string>::iterator it = finished.begin();
+         it != finished.end(); it++) {
+        remove((*it + ".his").c_str());
+        remove((*it + ".drr").c_str());
+        remove((*it + ".list").c_str());
+        if (access((*it + "_skim.pld").c_str(), R_OK) == 0)
+            skims.push_back(*it + "_skim.pld");
+    }
+
+    if (!skims.empty()) {
+        cout << "utkscan.cpp : Merging the skims of " << skims.size()
+             << " scans into " << output << "_skim.pld" << endl;
+        if (!SkimWriter::Merge(output + "_skim.pld", skims))
+            cout << "utkscan.cpp : Failed to merge the skims!" << endl;
+        else {
+            for (std::vector<std::string>::iterator it = skims.begin();
+                 it != skims.end(); it++)
+                remove(it->c_str());
+        }
+    }
+
+    // The checkpoints are only needed until every scan is summed.
+    if (finished.size() == numScans) {
+        for (std::vector<std::string>::iterator it = finished.begin();
+             it != finished.end(); it++)
+            remove((*it + ".ckpt").c_str());
+    }
+
+    return (finished.size() == numScans ? 0 : 1);
+}
+
+int main(int argc, char *argv[]){
+    // Collect the input files, the output name, the number of jobs and the
+    // number of spill shards per file. All of the other arguments are passed
+    // on to each scan unchanged.
+    std::vector<std::string> inputs;
+    std::vector<std::string> args;
+    std::string output = "out";
+    std::string value;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    long shards = 1;
+    bool hasCounts = false;
+    HostList hosts;
+    std::string launcher = "ssh";
+
+    args.push_back(argv[0]);
+    for (int i = 1; i < argc; i++) {
+        if (!(value = GetOptionValue(argc, argv, i, 'i', "input")).empty())
+            inputs.push_back(value);
+        else if (!(value = GetOptionValue(argc, argv, i, 'o', "output")).empty())
+            output = value;
+        else if (!(value = GetOptionValue(argc, argv, i, 'j', "jobs")).empty())
+            jobs = strtol(value.c_str(), NULL, 0);
+        else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+            shards = strtol(argv[++i], NULL, 0);
+        else if (strncmp(argv[i], "--shards=", 9) == 0)
+            shards = strtol(argv[i] + 9, NULL, 0);
+        else if (!(value = GetOptionValue(argc, argv, i, 0, "hosts")).empty())
+            hosts.names = SplitList(value, ',');
+        else if (!(value = GetOptionValue(argc, argv, i, 0, "launcher")).empty())
+            launcher = value;
+        else {
+            hasCounts |= (strcmp(argv[i], "--counts") == 0);
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (shards < 1)
+        shards = 1;
+    if (inputs.size() * shards <= 1 && hosts.names.empty())
+        return(RunScan(argc, argv));
+    hosts.launcher = SplitList(launcher, ' ');
+
+    // Each scan would write its counts to the same file.
+    if (hasCounts)
+        cout << "utkscan.cpp : WARNING! The channel counts written by --counts "
+             << "are only kept for the last scan to finish" << endl;
+
+    if (jobs < 1)
+        jobs = 1;
+    if ((size_t)jobs > inputs.size() * shards)
+        jobs = inputs.size() * shards;
+
+    return(RunMultiFileScan(inputs, output, jobs, shards, args, hosts));
+}
@@ -7,6 +7,7 @@
 #ifndef __ANL1471PROCESSOR_HPP_
 #define __ANL1471PROCESSOR_HPP_
 
+#include "ColumnWriter.hpp"
 #include "EventProcessor.hpp"
 #include "VandleProcessor.hpp"
 
@@ -29,12 +30,18 @@ public:
                     const double &res, const double &offset,
                     const double &numStarts);
 
+    /** Initialize the processor and open its output streams
+    * \param [in] event : the raw event to initialize with
+    * \return true if the initialization was successful */
+    virtual bool Init(RawEvent &event);
+
     /** Process the event
     * \param [in] event : the event to process
     * \return Returns true if the processing was successful */
     virtual bool Process(RawEvent &event);
 private:
-    std::string fileName_; //!< name of the his file
-    std::vector<std::string> fileNames_; //!< vector of output file names
+    ColumnWriter *streams_[2]; //!< output streams of the small and medium bars
+    double streamTof_; //!< corrected ToF written to the streams
+    double streamQdc_; //!< QDC written to the streams
 };
 #endif
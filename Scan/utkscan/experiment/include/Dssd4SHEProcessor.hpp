@@ -75,6 +75,10 @@ public:
     virtual bool PreProcess(RawEvent &event);
     /** Perform Process */
     virtual bool Process(RawEvent &event);
+    /** \return the bytes held by the chains of the correlator */
+    virtual size_t GetMemory(void) const {
+        return correlator_.memory();
+    }
 
 protected:
     /** Picks what event type we had 
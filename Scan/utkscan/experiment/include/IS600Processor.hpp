@@ -7,8 +7,7 @@
  */
 #ifndef __IS600PROCESSOR_HPP_
 #define __IS600PROCESSOR_HPP_
-#include <fstream>
-
+#include "ColumnWriter.hpp"
 #include "EventProcessor.hpp"
 
 #ifdef useroot
@@ -28,6 +27,11 @@ public:
     /** Declare the plots used in the analysis */
     virtual void DeclarePlots(void);
 
+    /** Initialize the processor and open its output stream
+    * \param [in] rawev : the raw event to initialize with
+    * \return true if the initialization was successful */
+    virtual bool Init(RawEvent &rawev);
+
     /** PreProcess does nothing since this is solely dependent on results
      from other Processors*/
     virtual bool PreProcess(RawEvent &event);
@@ -43,6 +47,8 @@ private:
     TH2D *qdctof_; //!< a 2D histogram in ROOT
     TH1D *vsize_; //!< a 1D histogram in root
 #endif
-    std::ofstream *outstream; //!< filestream to output to text file
+    ColumnWriter *stream_; //!< output stream of the ToF and QDC of the bars
+    double streamTof_; //!< ToF written to the stream
+    double streamQdc_; //!< QDC written to the stream
 };
 #endif
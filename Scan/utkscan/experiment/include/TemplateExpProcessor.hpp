@@ -5,8 +5,7 @@
  */
 #ifndef __TEMPLATEEXPPROCESSOR_HPP_
 #define __TEMPLATEEXPPROCESSOR_HPP_
-#include <fstream>
-
+#include "ColumnWriter.hpp"
 #include "EventProcessor.hpp"
 
 #ifdef useroot
@@ -28,6 +27,11 @@ public:
     /** Declare the plots used in the analysis */
     virtual void DeclarePlots(void);
 
+    /** Initialize the processor and open its output stream
+    * \param [in] rawev : the raw event to initialize with
+    * \return true if the initialization was successful */
+    virtual bool Init(RawEvent &rawev);
+
     /** PreProcess does nothing since this is solely dependent on results
      from other Processors*/
     virtual bool PreProcess(RawEvent &event);
@@ -41,11 +45,10 @@ private:
     void ObtainHisName(void);
     /** Sets the detectors that are associated with this processor */
     void SetAssociatedTypes(void);
-    /** Sets up the ASCII output file stream */
-    void SetupAsciiOutput(void);
-
     std::string fileName_; //!< String to hold the file name from command line
-    std::ofstream *poutstream_; //!< Pointer to ouptut ASCII file stream.
+    ColumnWriter *pstream_; //!< Output stream of the template and ge energies
+    double streamTemplateEnergy_; //!< Template energy written to the stream
+    double streamGammaEnergy_; //!< Ge energy written to the stream
     double gCutoff_; //!< Variable used to set gamma cutoff energy
 
 #ifdef useroot
@@ -6,14 +6,13 @@
  *\author S. V. Paulauskas
  *\date September 19, 2015
  */
-#include <fstream>
 #include <iostream>
 
 #include <cmath>
 
 #include "BarBuilder.hpp"
 #include "DammPlotIds.hpp"
-#include "GetArguments.hpp"
+#include "DetectorDriver.hpp"
 #include "Globals.hpp"
 #include "RawEvent.hpp"
 #include "TimingMapBuilder.hpp"
@@ -69,17 +68,19 @@ Anl1471Processor::Anl1471Processor(const std::vector<std::string> &typeList,
     const double &res, const double &offset, const double &numStarts) :
     VandleProcessor(typeList,res,offset,numStarts) {
     associatedTypes.insert("vandle");
+    streams_[0] = streams_[1] = NULL;
+}
 
-    char hisFileName[32];
-    GetArgument(1, hisFileName, 32);
-    string temp = hisFileName;
-    temp = temp.substr(0, temp.find_first_of(" "));
-    stringstream name;
-    name << temp;
-    fileName_ = name.str();
-    fileNames_.push_back(fileName_ + "-tof-sm.dat");
-    fileNames_.push_back(fileName_ + "-tof-md.dat");
-    fileNames_.push_back(fileName_ + "-tof-04Plus.dat");
+bool Anl1471Processor::Init(RawEvent &event) {
+    const char *names[2] = {"anl1471_tof_sm", "anl1471_tof_md"};
+    for (int i = 0; i < 2; i++) {
+        streams_[i] = DetectorDriver::get()->output.Open(names[i]);
+        if (streams_[i]) {
+            streams_[i]->AddColumn("tof", &streamTof_);
+            streams_[i]->AddColumn("qdc", &streamQdc_);
+        }
+    }
+    return(VandleProcessor::Init(event));
 }
 
 bool Anl1471Processor::Process(RawEvent &event) {
@@ -88,9 +89,10 @@ bool Anl1471Processor::Process(RawEvent &event) {
     if(!VandleProcessor::Process(event))
         return(false);
 
-    for (BarMap::iterator it = bars_.begin(); it !=  bars_.end(); it++) {
-        TimingDefs::TimingIdentifier barId = (*it).first;
-        BarDetector bar = (*it).second;
+    const BarArray &bars = barBuilder_.GetBarArray();
+    for (size_t it = bars.Next(0); it < bars.size(); it = bars.Next(it+1)) {
+        BarDetector bar = bars[it];
+        TimingDefs::TimingIdentifier barId = bar.GetKey();
         if(!bar.GetHasEvent())
             continue;
 
@@ -103,11 +105,12 @@ bool Anl1471Processor::Process(RawEvent &event) {
 	if(bar.GetType() == "medium")
 	    bananaNum = 1;
 
-        for(BarMap::iterator itStart = barStarts_.begin();
-        itStart != barStarts_.end(); itStart++) {
-            BarDetector start = (*itStart).second;
+        const BarArray &barStarts = startBuilder_.GetBarArray();
+        for(size_t itStart = barStarts.Next(0); itStart < barStarts.size();
+            itStart = barStarts.Next(itStart+1)) {
+            BarDetector start = barStarts[itStart];
             
-            unsigned int startLoc = (*itStart).first.first;
+            unsigned int startLoc = start.GetKey().first;
             unsigned int barPlusStartLoc = numStarts_*barLoc+startLoc;
 	    
             double tofOffset = cal.GetTofOffset(startLoc);
@@ -121,15 +124,13 @@ bool Anl1471Processor::Process(RawEvent &event) {
                                            bar.GetQdc());
 	    //All of them are gated using a banana gate
             if(inPeel) {
-		ofstream data;
-		if(bar.GetType() == "small") {
-                    data.open(fileNames_[0].c_str(), ios::app);
-                    data << corTof << " " << bar.GetQdc() << endl;
-                } else {
-		    data.open(fileNames_[1].c_str(), ios::app);
-                    data << corTof << " " << bar.GetQdc() << endl;
+		ColumnWriter *stream =
+		    streams_[bar.GetType() == "small" ? 0 : 1];
+		if(stream) {
+		    streamTof_ = corTof;
+		    streamQdc_ = bar.GetQdc();
+		    stream->Fill();
 		}
-		data.close();
             }
 
             double cycleTime = TreeCorrelator::get()->place("Cycle")->last().time;
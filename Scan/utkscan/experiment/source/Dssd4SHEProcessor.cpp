@@ -173,7 +173,7 @@ bool Dssd4SHEProcessor::PreProcess(RawEvent &event) {
         const Trace& trace = (*itx)->GetTrace();
 
         /** Handle additional pulses (no. 2, 3, ...) */
-        int pulses = trace.GetValue("numPulses");
+        int pulses = trace.GetValue(Trace::NUM_PULSES);
         for (int i = 1; i < pulses; ++i) {
             stringstream energyCalName;
             energyCalName << "filterEnergy" << i + 1 << "Cal";
@@ -185,7 +185,7 @@ bool Dssd4SHEProcessor::PreProcess(RawEvent &event) {
             StripEvent ev2;
             ev2.E = trace.GetValue(energyCalName.str());
             ev2.t = (trace.GetValue(timeName.str()) - 
-                     trace.GetValue("filterTime") + ev.t);
+                     trace.GetValue(Trace::FILTER_TIME) + ev.t);
             ev2.pos = ev.pos;
             ev2.sat = false;
             ev2.pileup = true;
@@ -225,7 +225,7 @@ bool Dssd4SHEProcessor::PreProcess(RawEvent &event) {
 
         const Trace& trace = (*ity)->GetTrace();
 
-        int pulses = trace.GetValue("numPulses");
+        int pulses = trace.GetValue(Trace::NUM_PULSES);
         for (int i = 1; i < pulses; ++i) {
             stringstream energyCalName;
             energyCalName << "filterEnergy" << i + 1 << "Cal";
@@ -237,7 +237,7 @@ bool Dssd4SHEProcessor::PreProcess(RawEvent &event) {
             StripEvent ev2;
             ev2.E = trace.GetValue(energyCalName.str());
             ev2.t = (trace.GetValue(timeName.str()) - 
-                     trace.GetValue("filterTime") + ev.t);
+                     trace.GetValue(Trace::FILTER_TIME) + ev.t);
             ev2.pos = ev.pos;
             ev2.sat = false;
             ev2.pileup = true;
@@ -265,45 +265,63 @@ bool Dssd4SHEProcessor::PreProcess(RawEvent &event) {
         }
     }
 
+    /** If energies are in lower range and/or not satured
+     *  check if delta energy condition is not met, 
+     *  if not, skip this event
+     *
+     *  For high energy events and satured set 20 MeV
+     *  energy for difference check. The calibration in this
+     *  range is most likely imprecise, so one cannot correlate
+     *  by energy difference.
+     *
+     *  The Y events are sorted once by this energy, so that for each
+     *  X event only the Y events within deltaEnergy_ are compared, instead
+     *  of all of them.
+     **/
+    double highEnergyCut = highEnergyCut_;
+    auto matchEnergy = [highEnergyCut](const StripEvent& ev) {
+        return (ev.sat || ev.E > highEnergyCut) ? 20000.0 : ev.E;
+    };
+
+    size_t numY = yEventsTMatch.size();
+    vector< pair<double, size_t> > ySorted(numY);
+    for (size_t i = 0; i < numY; ++i)
+        ySorted[i] = make_pair(matchEnergy(yEventsTMatch[i].first), i);
+    sort(ySorted.begin(), ySorted.end());
+
+    vector<double> yEnergies(numY), yTimes(numY);
+    for (size_t k = 0; k < numY; ++k) {
+        yEnergies[k] = ySorted[k].first;
+        yTimes[k] = yEventsTMatch[ySorted[k].second].first.t;
+    }
+
+    double clockInSeconds = Globals::get()->clockInSeconds();
     for (vector< pair<StripEvent, bool> >::iterator itx = xEventsTMatch.begin();
          itx != xEventsTMatch.end();
          ++itx) {
+        double energyX = matchEnergy((*itx).first);
+        size_t first = lower_bound(yEnergies.begin(), yEnergies.end(),
+                                   energyX - deltaEnergy_) - yEnergies.begin();
+        size_t last = upper_bound(yEnergies.begin(), yEnergies.end(),
+                                  energyX + deltaEnergy_) - yEnergies.begin();
+
         double bestDtime = numeric_limits<double>::max();
         vector< pair<StripEvent, bool> >::iterator bestMatch =
             yEventsTMatch.end();
-        for (vector< pair<StripEvent, bool> >::iterator ity = 
-                                                     yEventsTMatch.begin();
-            ity != yEventsTMatch.end();
-            ++ity) 
-        {
+        for (size_t k = first; k < last; ++k) {
+            size_t index = ySorted[k].second;
             // If already matched, skip
-            if ((*ity).second)
-                continue;
-
-            double energyX = (*itx).first.E;
-            double energyY = (*ity).first.E;
-
-            /** If energies are in lower range and/or not satured
-             *  check if delta energy condition is not met, 
-             *  if not, skip this event
-             *
-             *  For high energy events and satured set 20 MeV
-             *  energy for difference check. The calibration in this
-             *  range is most likely imprecise, so one cannot correlate
-             *  by energy difference.
-             **/
-            if ( (*itx).first.sat || energyX > highEnergyCut_ )
-                energyX = 20000.0;
-            if ( (*ity).first.sat || energyY > highEnergyCut_ )
-                energyY = 20000.0;
-            if ( abs(energyX - energyY) > deltaEnergy_)
+            if (yEventsTMatch[index].second)
                 continue;
 
-            double dTime = abs((*itx).first.t - (*ity).first.t) *
-                                Globals::get()->clockInSeconds();
-            if (dTime < bestDtime) {
+            // Ties go to the earliest Y event in the summary, as they did
+            // when the events were compared in order
+            double dTime = abs((*itx).first.t - yTimes[k]) * clockInSeconds;
+            if (dTime < bestDtime ||
+                (dTime == bestDtime && bestMatch != yEventsTMatch.end() &&
+                 index < (size_t)(bestMatch - yEventsTMatch.begin()))) {
                 bestDtime = dTime;
-                bestMatch = ity;
+                bestMatch = yEventsTMatch.begin() + index;
             }
         }
         if (bestDtime < timeWindow_) {
@@ -5,7 +5,6 @@
  *\author S. V. Paulauskas
  *\date July 14, 2015
  */
-#include <fstream>
 #include <iostream>
 
 #include <cmath>
@@ -65,20 +64,18 @@ void IS600Processor::DeclarePlots(void) {
 		       SD, SB, "GammaProton TDIFF vs. Gamma Energy");
 }
 
-IS600Processor::IS600Processor() : EventProcessor(OFFSET, RANGE, "IS600PRocessor") {
+IS600Processor::IS600Processor() : EventProcessor(OFFSET, RANGE, "IS600PRocessor"),
+    stream_(NULL) {
     associatedTypes.insert("vandle");
     associatedTypes.insert("labr3");
     associatedTypes.insert("beta");
     associatedTypes.insert("ge");
 
+#ifdef useroot
     char hisFileName[32];
     GetArgument(1, hisFileName, 32);
     string temp = hisFileName;
     temp = temp.substr(0, temp.find_first_of(" "));
-    stringstream name;
-    name << temp << ".dat";
-    outstream = new ofstream(name.str().c_str());
-#ifdef useroot
     stringstream rootname;
     rootname << temp << ".root";
     rootfile_ = new TFile(rootname.str().c_str(),"RECREATE");
@@ -91,8 +88,6 @@ IS600Processor::IS600Processor() : EventProcessor(OFFSET, RANGE, "IS600PRocessor
 }
 
 IS600Processor::~IS600Processor() {
-    outstream->close();
-    delete(outstream);
 #ifdef useroot
     rootfile_->Write();
     rootfile_->Close();
@@ -100,6 +95,16 @@ IS600Processor::~IS600Processor() {
 #endif
 }
 
+///Opens the output stream of the bars, which the DetectorDriver closes
+bool IS600Processor::Init(RawEvent &rawev) {
+    stream_ = DetectorDriver::get()->output.Open("is600");
+    if (stream_) {
+        stream_->AddColumn("tof", &streamTof_);
+        stream_->AddColumn("qdc", &streamQdc_);
+    }
+    return(EventProcessor::Init(rawev));
+}
+
 ///We do nothing here since we're completely dependent on the resutls of others
 bool IS600Processor::PreProcess(RawEvent &event){
     if (!EventProcessor::PreProcess(event))
@@ -184,7 +189,11 @@ bool IS600Processor::Process(RawEvent &event) {
             bar.GetQdc());
 	    bool isLowStart = start.GetQdc() < 300;
 
-	    *outstream << tof << " " << bar.GetQdc() << endl;
+	    if (stream_) {
+		streamTof_ = tof;
+		streamQdc_ = bar.GetQdc();
+		stream_->Fill();
+	    }
 #ifdef useroot
         qdctof_->Fill(tof,bar.GetQdc());
         qdc_ = bar.GetQdc();
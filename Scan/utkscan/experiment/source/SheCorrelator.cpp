@@ -12,6 +12,7 @@
 #include "SheCorrelator.hpp"
 #include "DetectorDriver.hpp"
 #include "Exceptions.hpp"
+#include "Globals.hpp"
 #include "Notebook.hpp"
 
 
@@ -40,21 +41,31 @@ SheEvent::SheEvent(double energy, double time, int mwpc,
 }
 
 
-SheCorrelator::SheCorrelator(int size_x, int size_y) {
+SheCorrelator::SheCorrelator(int size_x, int size_y,
+                             double window /* = 0*/,
+                             unsigned depth /* = 64*/,
+                             unsigned radius /* = 0*/) :
+    pixels_(size_x + 1, size_y + 1, RingBuffer<SheEvent>(depth)) {
     size_x_ = size_x + 1;
     size_y_ = size_y + 1;
-    pixels_ = new deque<SheEvent>*[size_x_];
-    for(int i = 0; i < size_x_; ++i)
-        pixels_[i] = new deque<SheEvent>[size_y_];
+    window_ = window / Globals::get()->clockInSeconds();
+    radius_ = radius;
+    depth_ = depth;
 }
 
 
-SheCorrelator::~SheCorrelator() {
-    for(int i = 0; i < size_y_; ++i) {
-        pixels_[i]->clear();
-        delete[] pixels_[i];
+void SheCorrelator::open_history(const std::string& fname) {
+    if (!history_.Open(fname, size_x_, size_y_, depth_)) {
+        stringstream ss;
+        ss << "SheCorrelator: could not map the history file " << fname;
+        throw IOException(ss.str());
     }
-    delete[] pixels_;
+}
+
+size_t SheCorrelator::memory() const {
+    return pixels_.GetMemory([](const RingBuffer<SheEvent>& chain) {
+        return chain.capacity() * sizeof(SheEvent);
+    });
 }
 
 
@@ -71,27 +82,82 @@ bool SheCorrelator::add_event(SheEvent& event, int x, int y) {
         throw GeneralWarning(ss.str());
     }
 
-    if (event.get_type() == heavyIon)
-        flush_chain(x, y);
+    if (history_.IsOpen())
+        return add_event(history_, event, x, y);
+    return add_event(pixels_, event, x, y);
+}
+
+template<class Store>
+bool SheCorrelator::add_event(Store& store, SheEvent& event, int x, int y) {
+    if (event.get_type() == heavyIon) {
+        flush_chain(store, x, y);
+        store.Get(x, y).push_back(event);
+        return true;
+    }
+
+    typename Store::value_type* chain = store.Find(x, y);
+    if (chain != NULL)
+        expire_chain(*chain, event.get_time());
+
+    if ((chain == NULL || chain->empty()) && radius_ > 0) {
+        typename Store::Pixel* neighbour =
+            find_neighbour(store, x, y, event.get_time());
+        if (neighbour != NULL) {
+            x = neighbour->x;
+            y = neighbour->y;
+        }
+    }
 
-    pixels_[x][y].push_back(event);
+    store.Get(x, y).push_back(event);
 
     if (event.get_type() == fission)
-        flush_chain(x, y);
+        flush_chain(store, x, y);
     
     return true;
 }
 
-bool SheCorrelator::flush_chain(int x, int y) {
-    unsigned chain_size = pixels_[x][y].size();
+template<class Chain>
+void SheCorrelator::expire_chain(Chain& chain, double time) {
+    if (window_ <= 0)
+        return;
+    while (!chain.empty() && time - chain.front().get_time() > window_)
+        chain.pop_front();
+}
+
+template<class Store>
+typename Store::Pixel* SheCorrelator::find_neighbour(Store& store, int x,
+                                                     int y, double time) {
+    vector<typename Store::Pixel*> found;
+    store.Neighbours(x, y, radius_, found);
+
+    typename Store::Pixel* latest = NULL;
+    for (typename vector<typename Store::Pixel*>::iterator it =
+             found.begin(); it != found.end(); ++it) {
+        typename Store::value_type& chain = (*it)->value;
+        expire_chain(chain, time);
+        if (chain.empty() || chain.front().get_type() != heavyIon)
+            continue;
+        if (latest == NULL ||
+            chain.front().get_time() > latest->value.front().get_time())
+            latest = *it;
+    }
+    return latest;
+}
+
+template<class Store>
+bool SheCorrelator::flush_chain(Store& store, int x, int y) {
+    typename Store::value_type* chain = store.Find(x, y);
+    if (chain == NULL)
+        return false;
+    unsigned chain_size = chain->size();
 
     /** If chain too short just clear it */
     if (chain_size < 2) {
-        pixels_[x][y].clear();
+        chain->clear();
         return false;
     }
 
-    SheEvent first = pixels_[x][y].front();
+    SheEvent first = chain->front();
 
     /** Conditions for interesing chain:
      *      * starts with heavy ion implantation
@@ -101,14 +167,14 @@ bool SheCorrelator::flush_chain(int x, int y) {
 
     /** If it doesn't start with hevayIon, clear and exit**/
     if (first.get_type() != heavyIon) {
-        pixels_[x][y].clear();
+        chain->clear();
         return false;
     }
 
     /** If it is 2 elements long, check if the second is fission,
      *  if not - clear and exit**/
-    if (chain_size == 2 && pixels_[x][y].back().get_type() != fission) {
-        pixels_[x][y].clear();
+    if (chain_size == 2 && chain->back().get_type() != fission) {
+        chain->clear();
         return false;
     }
 
@@ -120,8 +186,8 @@ bool SheCorrelator::flush_chain(int x, int y) {
     ss << humanTime << "\t X = " << x <<  " Y = " << y << endl;
 
     int alphas = 0;
-    for (deque<SheEvent>::iterator it = pixels_[x][y].begin();
-         it != pixels_[x][y].end();
+    for (typename Store::value_type::iterator it = chain->begin();
+         it != chain->end();
          ++it)
     {
         if ((*it).get_type() == alpha) {
@@ -131,7 +197,7 @@ bool SheCorrelator::flush_chain(int x, int y) {
         ss << endl;
     }
 
-    pixels_[x][y].clear();
+    chain->clear();
 
     if (alphas >= 2) {
         Notebook::get()->report(ss.str());
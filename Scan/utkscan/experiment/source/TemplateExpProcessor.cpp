@@ -3,7 +3,6 @@
  *\author S. V. Paulauskas
  *\date May 20, 2016
  */
-#include <fstream>
 #include <iostream>
 
 #include <cmath>
@@ -39,22 +38,22 @@ void TemplateExpProcessor::DeclarePlots(void) {
 }
 
 TemplateExpProcessor::TemplateExpProcessor() :
-    EventProcessor(OFFSET, RANGE, "TemplateExpProcessor") {
+    EventProcessor(OFFSET, RANGE, "TemplateExpProcessor"),
+    pstream_(NULL) {
     gCutoff_ = 0.; ///Set the gamma cuttoff energy to a default of 0.
     SetAssociatedTypes();
     ObtainHisName();
-    SetupAsciiOutput();
 #ifdef useroot
     SetupRootOutput();
 #endif
 }
 
 TemplateExpProcessor::TemplateExpProcessor(const double &gcut) :
-    EventProcessor(OFFSET, RANGE, "TemplateExpProcessor") {
+    EventProcessor(OFFSET, RANGE, "TemplateExpProcessor"),
+    pstream_(NULL) {
     gCutoff_ = gcut;
     SetAssociatedTypes();
     ObtainHisName();
-    SetupAsciiOutput();
 #ifdef useroot
     SetupRootOutput();
 #endif
@@ -62,8 +61,6 @@ TemplateExpProcessor::TemplateExpProcessor(const double &gcut) :
 
 ///Destructor to close output files and clean up pointers
 TemplateExpProcessor::~TemplateExpProcessor() {
-    poutstream_->close();
-    delete(poutstream_);
 #ifdef useroot
     prootfile_->Write();
     prootfile_->Close();
@@ -77,11 +74,14 @@ void TemplateExpProcessor::SetAssociatedTypes(void) {
     associatedTypes.insert("ge");
 }
 
-///Sets up the name of the output ascii data file
-void TemplateExpProcessor::SetupAsciiOutput(void) {
-    stringstream name;
-    name << fileName_ << ".dat";
-    poutstream_ = new ofstream(name.str().c_str());
+///Opens the output stream of the energies, which the DetectorDriver closes
+bool TemplateExpProcessor::Init(RawEvent &rawev) {
+    pstream_ = DetectorDriver::get()->output.Open("template_exp");
+    if (pstream_) {
+        pstream_->AddColumn("template_energy", &streamTemplateEnergy_);
+        pstream_->AddColumn("ge_energy", &streamGammaEnergy_);
+    }
+    return(EventProcessor::Init(rawev));
 }
 
 #ifdef useroot
@@ -162,8 +162,12 @@ bool TemplateExpProcessor::Process(RawEvent &event) {
             ///Plot the Template Energy vs. Ge Energy
             plot(DD_TENVSGEN, gEnergy, (*tit)->GetEnergy());
 
-            ///Output template and ge energy to text file
-            *poutstream_ << (*tit)->GetEnergy() << " " << gEnergy << endl;
+            ///Output template and ge energy to the stream
+            if (pstream_) {
+                streamTemplateEnergy_ = (*tit)->GetEnergy();
+                streamGammaEnergy_ = gEnergy;
+                pstream_->Fill();
+            }
             ///Fill ROOT histograms and tree with the information
             #ifdef useroot
                 ptvsge_->Fill((*tit)->GetEnergy(), gEnergy);
@@ -100,7 +100,7 @@ bool TwoChanTimingProcessor::Process(RawEvent &event) {
 
     static int trcCounter = 0;
     int bin;
-    for(vector<int>::const_iterator it = start.GetTrace()->begin(); it !=
+    for(Trace::const_iterator it = start.GetTrace()->begin(); it !=
             start.GetTrace()->end(); it++) {
         bin = (int)(it-start.GetTrace()->begin());
         traces->Fill(bin, trcCounter, *it);
@@ -62,9 +62,10 @@ bool WalkVandleBetaProcessor::Process(RawEvent &event) {
     if (!VandleProcessor::Process(event))
         return(false);
 
-    for (BarMap::iterator it = bars_.begin(); it !=  bars_.end(); it++) {
-        TimingDefs::TimingIdentifier barId = (*it).first;
-        BarDetector bar = (*it).second;
+    const BarArray &bars = barBuilder_.GetBarArray();
+    for (size_t it = bars.Next(0); it < bars.size(); it = bars.Next(it+1)) {
+        BarDetector bar = bars[it];
+        TimingDefs::TimingIdentifier barId = bar.GetKey();
         if(!bar.GetHasEvent())
             continue;
 
@@ -95,13 +96,13 @@ bool WalkVandleBetaProcessor::Process(RawEvent &event) {
         }
 
 
-        for(TimingMap::iterator itStart = starts_.begin();
-        itStart != starts_.end(); itStart++) {
-            HighResTimingData start = (*itStart).second;
+        for(size_t itStart = starts_.Next(0); itStart < starts_.size();
+            itStart = starts_.Next(itStart+1)) {
+            HighResTimingData start = starts_[itStart];
             if(!start.GetIsValidData())
                 continue;
 
-            unsigned int startLoc = (*itStart).first.first;
+            unsigned int startLoc = start.GetChan()->GetChanID().GetLocation();
 
             double tofOffset = cal.GetTofOffset(startLoc);
             double tofBarWalkCor = bar.GetWalkCorTimeAve() -
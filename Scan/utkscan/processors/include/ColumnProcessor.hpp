@@ -0,0 +1,43 @@
+/** \file ColumnProcessor.hpp
+ * \brief Processor to dump data from events into a columnar file
+ *
+ * This loops over the other event processors to fill their columns, the
+ * columnar alternative to the RootProcessor. See ColumnWriter.hpp for the
+ * layout of the file.
+ */
+#ifndef __COLUMNPROCESSOR_HPP_
+#define __COLUMNPROCESSOR_HPP_
+
+#include <string>
+#include <vector>
+
+#include "ColumnWriter.hpp"
+#include "EventProcessor.hpp"
+
+//! A Class to output the data of events into columns
+class ColumnProcessor : public EventProcessor {
+public:
+    /** Constructor taking arguments for the file creation
+    * \param [in] fileName : the name of the columnar file
+    * \param [in] chunkSize : the number of events written together
+    * \param [in] level : the compression level of the columns */
+    ColumnProcessor(const std::string &fileName,
+                    const unsigned int &chunkSize, const int &level);
+    /** Default Destructor */
+    virtual ~ColumnProcessor();
+    /** Initializes the processor, adding the columns of the processors
+    * in the DetectorDriver
+    * \param [in] rawev : the raw event to analyze
+    * \return true if the initialization was successful */
+    virtual bool Init(RawEvent& rawev);
+    /** Fills a row with the data of the event
+    * \param [in] event : the event to process
+    * \return true if processing was successful */
+    virtual bool Process(RawEvent &event);
+private:
+    ColumnWriter writer_; //!< Writes the columns to the file
+
+    /// All processors with AddColumns() information
+    std::vector<EventProcessor *> vecProcess_;
+};
+#endif // __COLUMNPROCESSOR_HPP_
@@ -7,13 +7,13 @@
 #include <map>
 #include <set>
 #include <string>
-
-#include <sys/times.h>
+#include <typeinfo>
 
 #include "Plots.hpp"
 #include "TreeCorrelator.hpp"
 
 // forward declarations
+class ColumnWriter;
 class DetectorSummary;
 class RawEvent;
 
@@ -45,6 +45,42 @@ public:
         return(associatedTypes);
     }
 
+    /** \return true if the processor declared the places and summaries
+    * that it reads and writes (see DeclareAccess). A declaration made by
+    * a base class does not hold for the classes derived from it. */
+    bool HasDeclaredAccess(void) const {
+        return(accessDeclared != NULL && *accessDeclared == typeid(*this));
+    }
+
+    /** \return The places and detector summaries read by the processor */
+    const std::set<std::string>& GetReadAccess(void) const {
+        return(readAccess);
+    }
+
+    /** \return The places and detector summaries written by the processor */
+    const std::set<std::string>& GetWriteAccess(void) const {
+        return(writeAccess);
+    }
+
+    /** \return true if the processor declared the trace fields that it
+    * reads (see DeclareTraceFields). As for DeclareAccess, a declaration
+    * made by a base class does not hold for the classes derived from it. */
+    bool HasDeclaredTraceFields(void) const {
+        return(traceFieldsDeclared != NULL &&
+               *traceFieldsDeclared == typeid(*this));
+    }
+
+    /** \return The trace fields read by the processor */
+    const std::set<std::string>& GetTraceFields(void) const {
+        return(traceFields);
+    }
+
+    /** \return The types, in addition to the associated ones, whose trace
+    * fields are read by the processor */
+    const std::set<std::string>& GetTraceTypes(void) const {
+        return(traceTypes);
+    }
+
     /** \return The status of the Processor */
     virtual bool DidProcess(void) const {
         return(didProcess);
@@ -60,6 +96,12 @@ public:
      * \return True on success */
     virtual bool Init(RawEvent& event);
 
+    /** Called between two events when the calibrations of the configuration
+     * were reloaded (see DetectorDriver::ReloadCalibrations). A processor
+     * which copied calibration constants into tables of its own in Init
+     * builds them again here. */
+    virtual void CalibrationsChanged(void) {};
+
     /** Process an event. In PreProcess correlator should filled (for all
     * derived classes) and basic analysis is done. More sophisticated analysis
     * (which might also depend on other processors) should be done in Process()
@@ -71,19 +113,38 @@ public:
 
     /** Process an event. PreProcess function should fill correlation tree and
     * all processors should have basic parameters calculated during
-    * PreProccessing. This also starts the processing timer.
+    * PreProccessing.
     * \param[in] event : The Event to be processed
     * \return True if success */
     virtual bool Process(RawEvent &event);
 
-    /** Wrap up the processing and update the time spent by this processor */
-    void EndProcess(void);
+    /** Wrap up the processing. The time spent in PreProcess and Process is
+    * recorded by the DetectorDriver, so this does nothing and is kept for
+    * the derived classes which call it. */
+    void EndProcess(void) {};
 
     /** Get the name of the processor
     * \return Name of the processor */
     std::string GetName(void) const {
         return(name);
     }
+    /** Get the memory held by the processor beyond its own object, e.g.
+    * the event history of a correlator it owns. Reported with the memory of
+    * the other subsystems by the perf command.
+    * \return The number of bytes held, zero by default */
+    virtual size_t GetMemory(void) const {return(0);};
+
+    /** This function adds the columns that will hold the data generated by
+    * this event processor to the columnar event output
+    * \param [in] writer : The writer to add the columns to
+    * \return true if any columns were added */
+    virtual bool AddColumns(ColumnWriter &writer) {return(false);};
+
+    /** This function is called before each row of the columnar event output
+    * is filled. As for FillBranch, the data needs to be zeroed for events
+    * where no detectors of interest to this processor triggered. */
+    virtual void FillColumns(void) {};
+
 #ifdef useroot
     /** This functions adds the branch to the tree that will be responsible
     * for holding the data generated by this event processor
@@ -106,6 +167,51 @@ protected:
     bool initDone;//!< True if the initialization has finished
     bool didProcess;//!< True if the process finished
     std::map<std::string, const DetectorSummary *> sumMap; //!< Map of associated detector summary
+    std::set<std::string> readAccess; //!< Places and summaries read by the Processor
+    std::set<std::string> writeAccess; //!< Places and summaries written by the Processor
+    const std::type_info *accessDeclared; //!< Class which declared what the Processor reads and writes
+    std::set<std::string> traceFields; //!< Trace fields read by the Processor
+    std::set<std::string> traceTypes; //!< Other types whose trace fields are read
+    const std::type_info *traceFieldsDeclared; //!< Class which declared the trace fields read
+
+    /** Declare the places of the TreeCorrelator and the detector summaries
+    * that the processor reads and writes in PreProcess and Process, in
+    * addition to the summaries of its associated types which it always
+    * reads. A place name ending in '*' stands for all of the places which
+    * start with the name. Processors which declared their access and which
+    * do not write anything the other reads or writes may be run
+    * concurrently on the same event. A processor which makes no declaration
+    * is never run together with any other processor. Call from the
+    * constructor of the class which implements PreProcess and Process.
+    * \param [in] reads : the places and summaries that are read
+    * \param [in] writes : the places and summaries that are written */
+    void DeclareAccess(const std::set<std::string> &reads,
+                       const std::set<std::string> &writes) {
+        readAccess = reads;
+        writeAccess = writes;
+        accessDeclared = &typeid(*this);
+    }
+
+    /** Declare the fields of the traces, such as "qdc" or "phase", that
+    * the processor reads from the channels of its associated types and of
+    * the other types that are given. A name ending in '*' stands for all of
+    * the fields which start with the name, and "waveform" stands for the
+    * waveform of the trace. The phase and the tqdc set the high resolution
+    * and walk corrected times of a channel, so they should be listed by
+    * processors which use those times. The trace analyzers whose results
+    * are read by no processor are skipped for that type. A processor which
+    * makes no declaration reads every field of its associated types. Call
+    * from the constructor of the class which implements PreProcess and
+    * Process.
+    * \param [in] fields : the trace fields that are read
+    * \param [in] types : the other types whose traces are read */
+    void DeclareTraceFields(const std::set<std::string> &fields,
+                            const std::set<std::string> &types =
+                                std::set<std::string>()) {
+        traceFields = fields;
+        traceTypes = types;
+        traceFieldsDeclared = &typeid(*this);
+    }
 
     /** Plots class for given Processor, takes care of declaration
     * and plotting within boundaries allowed by PlotsRegistry */
@@ -126,6 +232,18 @@ protected:
         histo.Plot(dammId, val1, val2, val3, name);
     }
 
+    /*! \brief Plots into a histogram through the handle from
+    * histo.GetHandle, without looking up its id
+    * \param [in] handle : The histogram to plot into
+    * \param [in] val1 : The x value to plot
+    * \param [in] val2 : The y value to plot (if 2D histogram)
+    * \param [in] val3 : The z value to plot (if 2D histogram)
+    */
+    void plot(const Plots::Handle &handle, double val1, double val2 = -1,
+              double val3 = -1) {
+        histo.Plot(handle, val1, val2, val3);
+    }
+
     /*! \brief Declares a 1D histogram calls the C++ wrapper for DAMM
     * \param [in] dammId : The histogram number to define
     * \param [in] xSize : The range of the x-axis
@@ -146,10 +264,13 @@ protected:
         histo.DeclareHistogram2D(dammId, xSize, ySize, title);
     }
 
-private:
-    tms tmsBegin; //!< The beginning processor time
-    double userTime;//!< The user time spent in the processor
-    double systemTime;//!< The system time spent in the processor
-    double clocksPerSecond;//!< The number of clock cycles per second
+    /*! \brief Declares all of the histograms of a table
+    * \param [in] defs : the table of histogram declarations, which is
+    * usually constexpr and checked with HistogramTableIsValid
+    */
+    template<size_t N>
+    void DeclareHistograms(const HistogramDef (&defs)[N]) {
+        histo.DeclareHistograms(defs, N);
+    }
 };
 #endif // __EVENTPROCESSOR_HPP_
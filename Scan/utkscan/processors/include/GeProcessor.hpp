@@ -5,11 +5,13 @@
 #define __GEPROCESSOR_HPP_
 
 #include <map>
+#include <string>
 #include <vector>
 #include <utility>
 #include <cmath>
 
 #include "EventProcessor.hpp"
+#include "GammaCube.hpp"
 #include "RawEvent.hpp"
 
 namespace dammIds {
@@ -185,12 +187,20 @@ public:
      * \param [in] cycle_gate1_min : the minimum range for the first cycle gate
      * \param [in] cycle_gate1_max : the maximum range for the first cycle gate
      * \param [in] cycle_gate2_min : the minimum range for the second cycle gate
-     * \param [in] cycle_gate2_max : the maximum range for the second cycle gate */
+     * \param [in] cycle_gate2_max : the maximum range for the second cycle gate
+     * \param [in] cubeFile : the file to write the gamma-gamma-gamma cube of
+     *  the addback energies to, empty to not fill the cube
+     * \param [in] cubeSize : the number of bins per axis of the cube
+     * \param [in] cubeBin : the energy (in keV) of a bin of the cube */
     GeProcessor(double gammaThreshold, double lowRatio,
                 double highRatio, double subEventWindow,
                 double gammaBetaLimit, double gammaGammaLimit,
                 double cycle_gate1_min, double cycle_gate1_max,
-                double cycle_gate2_min, double cycle_gate2_max);
+                double cycle_gate2_min, double cycle_gate2_max,
+                const std::string &cubeFile = "",
+                unsigned int cubeSize = 4096, double cubeBin = 1.0);
+    /** Destructor, writes the gamma-gamma-gamma cube */
+    virtual ~GeProcessor();
     /** Preprocess the event
      * \param [in] event : the event to preprocess
      * \return true if successful */
@@ -212,6 +222,7 @@ protected:
     static const unsigned int chansPerClover = 4; /*!< number of channels per clover */
 
     std::map<int, int> leafToClover;   /*!< Translate a leaf location to a clover number */
+    std::vector<int> cloverOfLeaf_;    /*!< leafToClover indexed by location */
     std::vector<float> timeResolution; /*!< Contatin time resolutions used */
     unsigned int numClovers;           /*!< number of clovers in map */
 
@@ -230,6 +241,43 @@ protected:
     /** Preprocessed good ge events, filled in PreProcess.*/
     std::vector<ChanEvent*> geEvents_;
 
+    /** \brief A good ge event above the gamma threshold, with the values
+     * used by the coincidence loops read once */
+    struct GammaHit {
+        double energy; //!< calibrated energy
+        double time; //!< corrected time
+        int clover; //!< the clover of the leaf
+    };
+
+    /** The geEvents_ above the gamma threshold in time order, filled in
+     * PreProcess */
+    std::vector<GammaHit> gammas_;
+
+    /** Low gain event of each leaf location for the current event */
+    std::vector<ChanEvent*> lowOfLeaf_;
+
+    /** \brief Handles of the gamma-gamma matrices, taken once the plots
+     * are declared so that the pair loops do not look up their ids */
+    struct GammaGammaPlots {
+        Plots::Handle energy; //!< DD_ENERGY
+        Plots::Handle cgate1; //!< DD_ENERGY_CGATE1
+        Plots::Handle cgate2; //!< DD_ENERGY_CGATE2
+        Plots::Handle prompt; //!< DD_ENERGY_PROMPT
+        Plots::Handle betaEnergy; //!< betaGated::DD_ENERGY
+        Plots::Handle betaCgate1; //!< betaGated::DD_ENERGY_CGATE1
+        Plots::Handle betaCgate2; //!< betaGated::DD_ENERGY_CGATE2
+        Plots::Handle betaPrompt; //!< betaGated::DD_ENERGY_PROMPT
+        Plots::Handle betaDelayed; //!< betaGated::DD_ENERGY_BDELAYED
+        Plots::Handle tdiff; //!< DD_TDIFF__GAMMA_GAMMA_ENERGY
+        Plots::Handle tdiffSum; //!< DD_TDIFF__GAMMA_GAMMA_ENERGY_SUM
+        Plots::Handle add; //!< DD_ADD_ENERGY
+        Plots::Handle addMulti; //!< multi::DD_ADD_ENERGY
+        Plots::Handle addBeta; //!< betaGated::DD_ADD_ENERGY
+        Plots::Handle addBetaMulti; //!< multi::betaGated::DD_ADD_ENERGY
+        Plots::Handle addPrompt; //!< betaGated::DD_ADD_ENERGY_PROMPT
+        Plots::Handle addPromptMulti; //!< multi::betaGated::DD_ADD_ENERGY_PROMPT
+    } ggPlots_; //!< the gamma-gamma matrices
+
     /** Declares a histogram with a range of granularities
      * \param [in] dammId : the dammID to plot
      * \param [in] xsize : the size in the x range
@@ -253,11 +301,25 @@ protected:
      * \param [in] bin1 : the first bin to plot into
      * \param [in] bin2 : the second bin to plot into */
     void symplot(int dammID, double bin1, double bin2);
+    /** Symmetric gamma-gamma plots through a handle.
+     * \param [in] handle : the handle of the plot
+     * \param [in] bin1 : the first bin to plot into
+     * \param [in] bin2 : the second bin to plot into */
+    void symplot(const Plots::Handle &handle, double bin1, double bin2);
 
     /** addbackEvents vector of vectors, where first vector
      * enumerates cloves, second events */
     std::vector< std::vector<AddBackEvent> > addbackEvents_;
     
+    /** Add the triples of prompt addback gammas of every addback event to
+     * the gamma-gamma-gamma cube */
+    void FillCube(void);
+
+    GammaCube *cube_; //!< the gamma-gamma-gamma cube, NULL if not filled
+    std::string cubeFile_; //!< the file the cube is written to
+    double cubeBin_; //!< the energy (in keV) of a bin of the cube
+    std::vector<const AddBackEvent*> cubeHits_; //!< the gammas of an addback event
+
     /** tas vector for total energy absorbed, similar structure as addback
      * but there is only one "super-clover" (sum of all detectors)*/
     std::vector<AddBackEvent> tas_;
@@ -6,12 +6,17 @@
 #define __HEN3PROCESSOR_HPP_
 
 #include "EventProcessor.hpp"
+#include "TimeWindowCounter.hpp"
 
 /// Processor to handle 3Hen detector
 class Hen3Processor : public EventProcessor {
 public:
     /** Default Constructor */
     Hen3Processor();
+    /** Constructor counting the neutrons in a window after every beta
+     * \param [in] neutronWindow : the length of the window in seconds, no
+     * window is counted if not positive */
+    Hen3Processor(double neutronWindow);
     /** Default Destructor */
     ~Hen3Processor(){};
     /** Preprocess the event
@@ -22,6 +27,9 @@ public:
      * \param [in] event : the event to process
      * \return true if the process was successful */
     virtual bool Process(RawEvent &event);
+    /** \return true if the event has 3Hen hits, or a beta when the neutrons
+     * are counted in a window after the betas */
+    virtual bool HasEvent(void) const;
     /** Declare the plots for the analysis */
     virtual void DeclarePlots(void);
 protected:
@@ -29,5 +37,13 @@ protected:
      * \param [in] nTime : the neutron time
      * \return the Event data for the bet matching neutron to beta */
     EventData BestBetaForNeutron(double nTime);
+
+    /** Give the neutrons and the beta of the event to the window counter,
+     * and plot the windows it finished
+     * \param [in] event : the event to count */
+    void CountWindows(RawEvent &event);
+
+    double neutronWindow_; //!< the length of the window after a beta in seconds
+    TimeWindowCounter windows_; //!< counts the neutrons around every beta
 };
 #endif // __HEN3PROCESSOR_H_
@@ -4,6 +4,8 @@
 #ifndef __IMPLANT_SSD_PROCESSOR_HPP_
 #define __IMPLANT_SSD_PROCESSOR_HPP_
 
+#include <vector>
+
 #include "EventProcessor.hpp"
 
 class RawEvent;
@@ -21,11 +23,35 @@ private:
     unsigned int fastTracesWritten;//!< Number of fast traces written
     unsigned int highTracesWritten;//!< Number of high traces written
 
+    /// The conditions of an event the type depends on, one bit each
+    enum ETypeConditions {HIGH_ENERGY = 1, BEAM_ON = 2, HAS_TOF = 4,
+                          ENOUGH_MCP = 8, LONG_TOF = 16, FISSION_ENERGY = 32,
+                          PILE_UP = 64, NUM_CONDITIONS = 128};
+
+    /** The event type of every combination of the conditions, so that
+     * SetType is a single look up */
+    EventInfo::EEventTypes typeTable_[NUM_CONDITIONS];
+
+    std::vector<double> stripImplantTime_;//!< Time of the last implant of each strip, NAN if none
+    std::vector<double> stripImplantEnergy_;//!< Energy of the last implant of each strip
+    std::vector<bool> stripVetoed_;//!< True if the last event of the strip had a veto
+
+    /** \return the event type of a combination of the conditions, the rules
+     * from which the table of types is filled
+     * \param [in] conditions : the ETypeConditions bits of the event */
+    static EventInfo::EEventTypes TypeOf(unsigned int conditions);
+
     /** Sets the event type
      * \param [in] info : the event information to set
      * \return The event types that were set */
     EventInfo::EEventTypes SetType(EventInfo &info) const;
 
+    /** Keeps the last implant and veto of the strip of an event, and plots
+     * the decays against the time since the last implant of their strip
+     * \param [in] info : the classified event
+     * \param [in] loc : the strip of the event */
+    void UpdateStrip(const EventInfo &info, unsigned int loc);
+
     /** Plots a specific type
      * \param [in] info : the information to plot
      * \param [in] loc : the location to plot
@@ -37,6 +37,12 @@ public:
     virtual bool Process(RawEvent &event);
     /** Declare plots for processor */
     virtual void DeclarePlots(void);
+    /** Add the columns to the columnar event output
+    * \param [in] writer : the writer to add the columns to
+    * \return true if you could do it */
+    bool AddColumns(ColumnWriter &writer);
+    /** Fill the columns */
+    void FillColumns(void);
 #ifdef useroot
     /** Add the branch to the tree
     * \param [in] tree : the tree to add the branch to
@@ -13,6 +13,10 @@ class LiquidScintProcessor : public EventProcessor {
 public:
     /** Default Constructor */
     LiquidScintProcessor();
+    /** Constructor
+    * \param [in] neutronBanana : the id of the banana of the neutrons in
+    * the trace QDC vs. discrimination plot, no gate if zero */
+    LiquidScintProcessor(const int &neutronBanana);
     /** Default Destructor */
     ~LiquidScintProcessor(){};
     /** Performs the preprocessing, which cannot depend on other processors
@@ -27,5 +31,6 @@ public:
     virtual void DeclarePlots(void);
 private:
    unsigned int counter;//!< A counter for counting...
+   int neutronBanana_;//!< The banana of the neutrons, no gate if zero
 };
 #endif // __LIQUIDSCINTPROCSSEOR_HPP_
@@ -5,9 +5,12 @@
 #ifndef __LOGICPROCESSOR_HPP_
 #define __LOGICPROCESSOR_HPP_
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "EventProcessor.hpp"
+#include "LogicTimeline.hpp"
 
 //! Class to handle logic signals
 class LogicProcessor : public EventProcessor {
@@ -53,6 +56,20 @@ public:
      * \param [in] loc : the location to get the status from */
     unsigned long StartCount(size_t loc) const { return startCount.at(loc); };
 
+    /** \return The logic status for a given location at any time of the
+     * run up to the current event
+     * \param [in] loc : the location to get the status from
+     * \param [in] t : the time to look at */
+    bool LogicStatus(size_t loc, double t) const {
+        return levels_.at(loc).State(t);
+    }
+
+    /** \return The history of the Beam, Cycle or TapeMove place, e.g. to
+     * ask if the beam was on at some time. The history of any other place
+     * is empty.
+     * \param [in] place : the name of the place */
+    const LogicTimeline &GetTimeline(const std::string &place) const;
+
     /** \return The time since the last off
      * \param [in] loc : the location to get the status from
      * \param [in] t : the current time to compare with the last one */
@@ -75,6 +92,9 @@ protected:
     std::vector<unsigned long> stopCount;  //!< number of stops received
     std::vector<unsigned long> startCount; //!< number of starts received
 
+    std::vector<LogicTimeline> levels_; //!< history of the logic signals
+    std::map<std::string, LogicTimeline> timelines_; //!< history of the places
+
 private:
     /** Basic Processing of the event
     * \param [in] event : the even to process */
@@ -84,6 +104,12 @@ private:
     * \param [in] event : the even to process */
     void TriggerProcessing(RawEvent &event);
 
+    /** Activate or deactivate a place and keep the change in its history
+    * \param [in] place : the name of the place
+    * \param [in] time : the time of the change
+    * \param [in] state : true to activate the place */
+    void SetPlace(const std::string &place, double time, bool state);
+
     int plotSize; //!< Size of the plots to make
 
     /** In some experiments the MTC stop signal was doubled
@@ -29,6 +29,7 @@ public:
 
 private:
     static const size_t nPos = 4; //!< number of positions
+    unsigned int cornerIds[nPos]; //!< the subtype ids of the corners, in the order of raw
 
     /** \brief Data structure to hold MCP data */
     struct McpData {
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "EventProcessor.hpp"
+#include "QdcPositions.hpp"
 #include "RawEvent.hpp"
 
 class ChanEvent;
@@ -20,14 +21,14 @@ private:
     static const int matchingTimeCut = 5; //!< maximum difference between edge and sum timestamps
 
     float qdcLen[numQdcs]; //!< the length of each qdc in pixie samples
-    float qdcPos[numQdcs]; //!< the ending sample number for each QDC position
-    float totLen;          //!< calculated length of all qdcs excluding baseline qdc
     int whichQdc;          //!< which qdc we are using for position determinatio
     static const int maxNumLocations = 12; //!< maximum number of locations
     int numLocations; //!< number of locations in the processor
     float posScale;        //!< an arbitrary scale for the position parameter to physical units
     std::vector<float> minNormQdc; //!< the minimum normalized qdc observed for a location
     std::vector<float> maxNormQdc; //!< the maximum normalized qdc observed for a location
+    QdcPositions positions; //!< the QDCs and positions of the strips of the event
+    std::vector<ChanEvent*> stripSums; //!< the sum channel of each strip in positions
 
     /** Find the matching edge of the SSD
     * \param [in] match : the matching edge
@@ -62,6 +63,9 @@ public:
     virtual bool Init(RawEvent& rawev);
     /** \brief Process the QDC data involved in top/bottom side for a strip
     *
+    *  The edges of all the strips of the event are gathered first, and
+    *  their QDCs and positions are computed together by QdcPositions.
+    *
     *  Note: QDC lengths are HARD-CODED at the moment for the plots and to
     *  determine the position
     * \param [in] event : the event to process
@@ -7,6 +7,8 @@
 #ifndef __PSPMTPROCESSOR_HPP__
 #define __PSPMTPROCESSOR_HPP__
 
+#include <vector>
+
 #include "RawEvent.hpp"
 #include "EventProcessor.hpp"
 
@@ -15,6 +17,10 @@ class PspmtProcessor : public EventProcessor {
 public:
     /** Default Constructor */
     PspmtProcessor(void);
+    /** Constructor choosing how the pixels are found
+     * \param [in] usePositionMap : true to look the pixels up in the
+     *  position map instead of calculating them for every event */
+    PspmtProcessor(const bool &usePositionMap);
     /** Default Destructor */
     ~PspmtProcessor() {};
     
@@ -29,6 +35,43 @@ public:
      * \return Returns true if the processing was successful */
     virtual bool Process(RawEvent &event);
 private:
+    /** Build the position map from the position calibration. The map has
+     * one element for every pair of raw x and y position bins, each one
+     * raw position unit wide, holding the pixel index x * posBins + y. */
+    void BuildPositionMap(void);
+
+    /** \return the pixel index of a pair of raw positions, looked up in the
+     * position map, or -1 if outside of it
+     * \param [in] x : the raw x position
+     * \param [in] y : the raw y position */
+    int GetPixel(const double &x, const double &y) const {
+        double xBin = x - rawOffset_;
+        double yBin = y - rawOffset_;
+        if(xBin < 0 || yBin < 0 || xBin >= rawScale_ || yBin >= rawScale_)
+            return(-1);
+        return(positionMap_[(int)xBin*rawScale_ + (int)yBin]);
+    }
+
+    /** Split a pixel index into its x and y pixels, -1 if it is outside
+     * of the position map
+     * \param [in] pixel : the pixel index
+     * \param [out] x : the x pixel
+     * \param [out] y : the y pixel */
+    void SplitPixel(const int &pixel, double &x, double &y) const {
+        x = pixel < 0 ? -1 : pixel / posBins_;
+        y = pixel < 0 ? -1 : pixel % posBins_;
+    }
+
+    static const int posBins_ = 32; //!< Number of pixels along each axis
+    static const int rawScale_ = 512; //!< Raw positions per anode fraction
+    static const int rawOffset_ = 100; //!< Offset of the raw positions
+
+    bool usePositionMap_; //!< True if the pixels come from the position map
+    double threshold_; //!< Energy threshold of the anodes for a position
+    double slope_; //!< Slope of the pixel calibration of the raw positions
+    double intercept_; //!< Intercept of the pixel calibration
+    std::vector<int> positionMap_; //!< Pixel index by raw x and y bin
+
     ///Structure defining what data we're storing
     struct PspmtData {
 	///Clears the data from the processor 
@@ -1,7 +1,15 @@
 /** \file RootProcessor.hpp
  * \brief Processor to dump data from events into a root tree
  *
- * This loops over other event processor to fill appropriate branches
+ * This loops over other event processor to fill appropriate branches.
+ *
+ * With a batch size, the tree is filled and saved on a writer thread, so
+ * that the compression of the baskets does not stall the processing. The
+ * branches are then bound to staging buffers owned by the writer: for every
+ * event the data of the processors is copied into a batch, and full batches
+ * are handed to the writer through a bounded queue. Only leaf list branches
+ * of fixed size can be copied like this, with any other branch the tree is
+ * filled on the processing thread as before.
  */
 
 #ifndef useroot
@@ -11,6 +19,10 @@
 #ifndef __ROOTPROCESSOR_HPP_
 #define __ROOTPROCESSOR_HPP_
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "EventProcessor.hpp"
@@ -29,11 +41,52 @@ class RootProcessor : public EventProcessor {
 
     /// All processors with AddBranch() information
     vector<EventProcessor *> vecProcess;
+
+    /// A branch copied from the processors into the batches
+    struct CopiedBranch {
+        const char *source; //!< The data of the processor
+        size_t size; //!< The number of bytes copied
+        size_t offset; //!< The offset in an event of a batch
+        vector<char> staging; //!< The data the branch is filled from
+    };
+
+    unsigned int batchSize_; //!< Events per batch, 0 to fill on this thread
+    unsigned int queueDepth_; //!< Maximum number of queued batches
+    size_t eventBytes_; //!< The number of bytes of an event in a batch
+    vector<CopiedBranch> branches_; //!< The branches copied into batches
+    vector<char> batch_; //!< The batch being filled
+    unsigned int batchEvents_; //!< The number of events in batch_
+
+    std::deque<vector<char> > queue_; //!< Batches waiting for the writer
+    std::deque<vector<char> > spare_; //!< Written batches for reuse
+    std::mutex queueMutex_; //!< Lock for the queue and spare batches
+    std::condition_variable queueReady_; //!< Signalled when a batch is queued or the writer is stopped
+    std::condition_variable queueSpace_; //!< Signalled when the writer takes a batch
+    std::thread writer_; //!< Thread filling and saving the tree
+    bool stop_; //!< Set to true to stop the writer once the queue is empty
+
+    /** Bind the branches of the tree to staging buffers and start the writer
+    * thread. Leaves the tree filled on the processing thread if a branch
+    * cannot be copied.
+    * \return true if the writer was started */
+    bool StartWriter(void);
+    /** Fill the tree from the queued batches until stopped */
+    void WriteBatches(void);
+    /** Hand the batch being filled to the writer */
+    void QueueBatch(void);
+    /** Fill the tree and save it occasionally */
+    void FillTree(void);
  public:
     /** Constructor taking arguments for file and tree creation
     * \param [in] fileName : the file name for the root file
-    * \param [in] treeName : the name of the tree to save to the root file*/
-    RootProcessor(const char *fileName, const char *treeName);
+    * \param [in] treeName : the name of the tree to save to the root file
+    * \param [in] batchSize : the number of events handed to the writer
+    *  thread at once, 0 to fill the tree on the processing thread
+    * \param [in] imtThreads : the number of threads ROOT may use to
+    *  compress the baskets, 0 to leave implicit multithreading off */
+    RootProcessor(const char *fileName, const char *treeName,
+                  const unsigned int &batchSize = 0,
+                  const unsigned int &imtThreads = 0);
     /** Initializes the processor
     * \param [in] rawev : the raw event to analyze
     * \return true if the initialization was successful */
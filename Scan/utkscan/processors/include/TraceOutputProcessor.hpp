@@ -0,0 +1,82 @@
+/** \file TraceOutputProcessor.hpp
+ * \brief Processor selecting the traces kept in the ROOT output
+ *
+ * Each rule names a detector type (and optionally a subtype) and the
+ * conditions for keeping the traces of its channels: the pileup flag, a
+ * calibrated energy window, every Nth trace, or a chi^2/dof of the
+ * FittingAnalyzer above a limit. A trace is kept if any of the conditions of
+ * the first rule matching its channel holds. The kept traces are compressed
+ * with the TraceCompressor and written by the RootProcessor to the branches
+ * "<name>.id" (the channel index), "<name>.length" (the number of samples),
+ * "<name>.size" (the number of bytes) and "<name>.data" (the coded traces,
+ * back to back).
+ */
+#ifndef __TRACEOUTPUTPROCESSOR_HPP_
+#define __TRACEOUTPUTPROCESSOR_HPP_
+
+#include <string>
+#include <vector>
+
+#include "EventProcessor.hpp"
+
+class ChanEvent;
+
+//! Class to select, compress and output traces
+class TraceOutputProcessor : public EventProcessor {
+public:
+    /** The conditions for keeping the traces of a detector type */
+    struct Rule {
+        std::string type; //!< the detector type
+        std::string subtype; //!< the subtype, or empty for all of them
+        bool pileup; //!< keep the traces flagged as pileup
+        double minEnergy; //!< lower end of the energy window
+        double maxEnergy; //!< upper end of the energy window
+        bool useEnergy; //!< keep the traces in the energy window
+        unsigned int every; //!< keep every Nth trace, 0 for none
+        double maxChiSq; //!< keep the fits with a larger chi^2/dof, 0 for none
+        unsigned int count; //!< the number of traces matched so far
+    };
+
+    /** Constructor taking the rules for keeping traces
+    * \param [in] rules : the rules, the first one matching a channel is used */
+    TraceOutputProcessor(const std::vector<Rule> &rules);
+    /** Default Destructor, prints the number of traces kept */
+    virtual ~TraceOutputProcessor();
+    /** Selects and compresses the traces of the event
+    * \param [in] event : the event to process
+    * \return true if processing was successful */
+    virtual bool Process(RawEvent &event);
+
+#ifdef useroot
+    /** Add the branches to the tree
+    * \param [in] tree : the tree to add the branches to
+    * \return true if you could do it */
+    virtual bool AddBranch(TTree *tree);
+    /** Fill the branches */
+    virtual void FillBranch(void);
+#endif
+
+private:
+    /** \return the rule applying to a channel, or NULL if there is none
+    * \param [in] chan : the channel */
+    Rule* FindRule(const ChanEvent &chan);
+    /** \return true if the trace of a channel is kept by a rule
+    * \param [in] rule : the rule for the channel
+    * \param [in] chan : the channel */
+    bool Keep(const Rule &rule, const ChanEvent &chan) const;
+    /** Clear the kept traces */
+    void Clear(void);
+
+    std::vector<Rule> rules_; //!< the rules for keeping traces
+
+    std::vector<int> id_; //!< the channel index of each kept trace
+    std::vector<unsigned int> length_; //!< the samples of each kept trace
+    std::vector<unsigned int> size_; //!< the coded bytes of each kept trace
+    std::vector<unsigned char> data_; //!< the coded traces
+
+    unsigned long long seen_; //!< the number of traces matching a rule
+    unsigned long long kept_; //!< the number of traces kept
+    unsigned long long samples_; //!< the number of samples kept
+    unsigned long long bytes_; //!< the number of coded bytes kept
+};
+#endif // __TRACEOUTPUTPROCESSOR_HPP_
@@ -18,6 +18,7 @@
 #ifndef __VANDLEPROCESSOR_HPP_
 #define __VANDLEPROCESSOR_HPP_
 
+#include "BarBuilder.hpp"
 #include "BarDetector.hpp"
 #include "EventProcessor.hpp"
 #include "HighResTimingData.hpp"
@@ -41,6 +42,18 @@ public:
                     const double &res, const double &offset,
                     const unsigned int &numStarts);
 
+    /** Initialize the processor, lay out the flat arrays of the bars and
+     * starts from the DetectorLibrary and the timing calibrations of the bars
+     * from the TimingCalibrator
+     * \param [in] event : the event to initialize with
+     * \return True on success */
+    virtual bool Init(RawEvent &event);
+
+    /** Lay out the reloaded timing calibrations of the bars again */
+    virtual void CalibrationsChanged(void) {
+        calTable_ = TimingCalibrationTable(barBuilder_.GetKeys());
+    }
+
     /** Preprocess the VANDLE data
      * \param [in] event : the event to preprocess
      * \return true if successful */
@@ -61,8 +74,8 @@ public:
         return((z0/corRadius)*TOF);
     }
     
-    /** \return the map of the build VANDLE bars */
-    BarMap GetBars(void) {return(bars_);}
+    /** \return the map of the build VANDLE bars, made from the flat array */
+    BarMap GetBars(void);
     /** \return true if we requested small bars in the xml */
     bool GetHasSmall(void) {return(hasSmall_);}
     /** \return true if we requested medium bars in the xml  */
@@ -71,9 +84,10 @@ public:
     bool GetHasBig(void) {return(hasBig_);}
 
 protected:
-    BarMap bars_;//!< A map to hold all the bars
-    TimingMap starts_;//!< A map to to hold all the starts
-    BarMap barStarts_;//!< A map that holds all of the bar starts
+    BarBuilder barBuilder_;//!< Builds the bars of the event into a flat array
+    BarBuilder startBuilder_;//!< Builds the bar starts into a flat array
+    TimingArray starts_;//!< The starts of the event indexed by channel id
+    TimingCalibrationTable calTable_;//!< Timing calibrations by bar slot
     DetectorSummary *geSummary_;//!< The Detector Summary for Ge Events
 
     bool hasDecay_; //!< True if there was a correlated beta decay
@@ -94,6 +108,13 @@ private:
     /** Analyze the data for scenarios with Single sided Starts; e.g. LeRIBSS
      * beta scintillators. */
     void AnalyzeStarts(void);
+    /** \return true if the bar in a slot had an event and its flight path,
+     * using the calibration table instead of the TimingCalibrator
+     * \param [in] slot : the slot of the bar
+     * \param [in] bar : the bar
+     * \param [out] flightPath : the flight path of the particle to the bar */
+    bool GetBarFlightPath(const size_t &slot, const BarDetector &bar,
+                          double &flightPath) const;
     /** Clear the maps in anticipation for the next event */
     void ClearMaps(void);
     /** Fill up the basic histograms */
@@ -25,6 +25,7 @@ BetaScintProcessor::BetaScintProcessor(double gammaBetaLimit,
                                        double energyContraction) :
     EventProcessor(OFFSET, RANGE, "BetaScintProcessor") {
     associatedTypes.insert("beta_scint");
+    DeclareAccess({"Beta", "Cycle", "Gamma"}, {});
     gammaBetaLimit_ = gammaBetaLimit;
     energyContraction_ = energyContraction;
 }
@@ -172,7 +173,7 @@ bool BetaScintProcessor::Process(RawEvent &event) {
         /* Beta events gated by "Beta" place are plotted here
          * Energy-time spectra are gated
          * */
-        for (deque<EventData>::iterator itb = betas->info_.begin();
+        for (RingBuffer<EventData>::iterator itb = betas->info_.begin();
              itb != betas->info_.end(); ++itb) {
             if (itb->energy == energy && itb->time == time &&
                 itb->location == location) {
@@ -0,0 +1,63 @@
+/** \file ColumnProcessor.cpp
+ * \brief Implementation of class to dump event info to a columnar file
+ */
+#include <algorithm>
+#include <iostream>
+
+#include "ColumnProcessor.hpp"
+#include "DetectorDriver.hpp"
+
+using namespace std;
+
+ColumnProcessor::ColumnProcessor(const std::string &fileName,
+                                 const unsigned int &chunkSize,
+                                 const int &level) :
+    EventProcessor(), writer_(fileName, chunkSize, level) {
+    name = "ColumnProcessor";
+}
+
+bool ColumnProcessor::Init(RawEvent& rawev) {
+    if (!writer_.IsOpen()) {
+        cout << "Could not open the output file for " << name
+             << " processor" << endl;
+        return(false);
+    }
+
+    const vector<EventProcessor *>& drvProcess =
+        DetectorDriver::get()->GetProcessors();
+
+    for (vector<EventProcessor *>::const_iterator it = drvProcess.begin();
+         it != drvProcess.end(); it++) {
+        if ((*it)->AddColumns(writer_)) {
+            vecProcess_.push_back(*it);
+            set_union((*it)->GetTypes().begin(), (*it)->GetTypes().end(),
+                      associatedTypes.begin(), associatedTypes.end(),
+                      inserter(associatedTypes, associatedTypes.begin()));
+        }
+    }
+
+    if (writer_.GetNumColumns() == 0) {
+        cout << "No processor added columns for " << name
+             << " processor" << endl;
+        return(false);
+    }
+    return(EventProcessor::Init(rawev));
+}
+
+bool ColumnProcessor::Process(RawEvent &event) {
+    if (!EventProcessor::Process(event))
+        return(false);
+
+    for (vector<EventProcessor *>::iterator it = vecProcess_.begin();
+         it != vecProcess_.end(); it++)
+        (*it)->FillColumns();
+    writer_.Fill();
+
+    EndProcess();
+    return(true);
+}
+
+ColumnProcessor::~ColumnProcessor() {
+    cout << "  saving " << writer_.GetEntries() << " column entries" << endl;
+    writer_.Close();
+}
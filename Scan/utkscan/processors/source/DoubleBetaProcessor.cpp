@@ -28,6 +28,7 @@ using namespace dammIds::doublebeta;
 DoubleBetaProcessor::DoubleBetaProcessor():
     EventProcessor(OFFSET, RANGE, "DoubleBetaProcessor") {
     associatedTypes.insert("beta");
+    DeclareAccess({}, {"DoubleBeta*"});
 }
 
 void DoubleBetaProcessor::DeclarePlots(void) {
@@ -29,6 +29,47 @@ namespace dammIds {
         const int DD_DECAY_FRONT_ENERGY__POSITION   = 43;//!< Decay Front vs. Position
         const int DD_DECAY_BACK_ENERGY__POSITION    = 44;//!< Decay Back vs. Position
         const int DD_ENERGY__DECAY_TIME_GRANX = 50;//!< Energy Vs. Decay Time
+
+        const int implantEnergyBins = SE;//!< Bins for the implant energy
+        const int decayEnergyBins = SD;//!< Bins for the decay energy
+        const int positionBins = S6;//!< Bins for the strip position
+        const int timeBins = S8;//!< Bins for the decay time
+
+        //! The histograms of the DssdProcessor
+        constexpr HistogramDef PLOTS[] = {
+            {DD_IMPLANT_FRONT_ENERGY__POSITION, implantEnergyBins,
+             positionBins, "DSSD Strip vs E - RF", 0},
+            {DD_IMPLANT_BACK_ENERGY__POSITION, implantEnergyBins,
+             positionBins, "DSSD Strip vs E - RB", 0},
+            {DD_DECAY_FRONT_ENERGY__POSITION, decayEnergyBins, positionBins,
+             "DSSD Strip vs E - DF", 0},
+            {DD_DECAY_BACK_ENERGY__POSITION, decayEnergyBins, positionBins,
+             "DSSD Strip vs E - DB", 0},
+            {DD_IMPLANT_POSITION, positionBins, positionBins,
+             "DSSD Hit Pattern - R", 0},
+            {DD_DECAY_POSITION, positionBins, positionBins,
+             "DSSD Hit Pattern - D", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 0, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (10ns/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 1, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (100ns/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 2, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (400ns/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 3, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (1us/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 4, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (10us/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 5, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (100us/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 6, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (1ms/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 7, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (10ms/ch)(xkeV)", 0},
+            {DD_ENERGY__DECAY_TIME_GRANX + 8, decayEnergyBins, timeBins,
+             "DSSD Ty,Ex (100ms/ch)(xkeV)", 0},
+        };
+        static_assert(HistogramTableIsValid(PLOTS, RANGE),
+                      "The DssdProcessor histograms overlap or are out of range");
     }
 }
 
@@ -43,45 +84,7 @@ DssdProcessor::DssdProcessor() :
 }
 
 void DssdProcessor::DeclarePlots(void) {
-    using namespace dammIds::dssd;
-
-    const int implantEnergyBins = SE;
-    const int decayEnergyBins   = SD;
-    const int positionBins = S6;
-    const int timeBins     = S8;
-
-    DeclareHistogram2D(DD_IMPLANT_FRONT_ENERGY__POSITION,
-		       implantEnergyBins, positionBins, "DSSD Strip vs E - RF");
-    DeclareHistogram2D(DD_IMPLANT_BACK_ENERGY__POSITION,
-		       implantEnergyBins, positionBins, "DSSD Strip vs E - RB");
-    DeclareHistogram2D(DD_DECAY_FRONT_ENERGY__POSITION,
-		       decayEnergyBins, positionBins, "DSSD Strip vs E - DF");
-    DeclareHistogram2D(DD_DECAY_BACK_ENERGY__POSITION,
-		       decayEnergyBins, positionBins, "DSSD Strip vs E - DB");
-    DeclareHistogram2D(DD_IMPLANT_POSITION,
-		       positionBins, positionBins, "DSSD Hit Pattern - R");
-    DeclareHistogram2D(DD_DECAY_POSITION,
-		       positionBins, positionBins, "DSSD Hit Pattern - D");
-
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 0, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (10ns/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 1, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (100ns/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 2, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (400ns/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 3, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (1us/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 4, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (10us/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 5, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (100us/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 6, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (1ms/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 7, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (10ms/ch)(xkeV)");
-    DeclareHistogram2D(DD_ENERGY__DECAY_TIME_GRANX + 8, decayEnergyBins, timeBins,
-		       "DSSD Ty,Ex (100ms/ch)(xkeV)");
-
+    DeclareHistograms(dammIds::dssd::PLOTS);
 }
 
 bool DssdProcessor::Process(RawEvent &event) {
@@ -12,9 +12,6 @@
 #include <sstream>
 #include <vector>
 
-#include <unistd.h>
-#include <sys/times.h>
-
 #include "DetectorLibrary.hpp"
 #include "EventProcessor.hpp"
 #include "RawEvent.hpp"
@@ -23,22 +20,18 @@
 using namespace std;
 
 EventProcessor::EventProcessor() :
-  name("generic"), initDone(false), didProcess(false), histo(0, 0, "generic"),
-  userTime(0.), systemTime(0.) {
-    clocksPerSecond = sysconf(_SC_CLK_TCK);
+  name("generic"), initDone(false), didProcess(false), accessDeclared(NULL),
+  traceFieldsDeclared(NULL),
+  histo(0, 0, "generic") {
 }
 
 EventProcessor::EventProcessor(int offset, int range, std::string proc_name) :
-  name(proc_name), initDone(false), didProcess(false),
-  histo(offset, range, proc_name), userTime(0.), systemTime(0.) {
-    clocksPerSecond = sysconf(_SC_CLK_TCK);
+  name(proc_name), initDone(false), didProcess(false), accessDeclared(NULL),
+  traceFieldsDeclared(NULL),
+  histo(offset, range, proc_name) {
 }
 
 EventProcessor::~EventProcessor() {
-    if (initDone)
-        cout << name << " : "
-	     << userTime << " user time, "
-	     << systemTime << " system time" << endl;
 }
 
 bool EventProcessor::HasEvent(void) const {
@@ -53,11 +46,12 @@ bool EventProcessor::HasEvent(void) const {
 
 bool EventProcessor::Init(RawEvent& rawev) {
     vector<string> intersect;
-    const set<string> &usedDets = DetectorLibrary::get()->GetUsedDetectors();
-
-    set_intersection(associatedTypes.begin(), associatedTypes.end(),
-                     usedDets.begin(), usedDets.end(),
-                     back_inserter(intersect) );
+    const DetectorLibrary *lib = DetectorLibrary::get();
+    for (set<string>::const_iterator it = associatedTypes.begin();
+         it != associatedTypes.end(); it++) {
+        if (lib->IsUsed(Identifier::NameId(*it)))
+            intersect.push_back(*it);
+    }
 
     if (intersect.empty())
         return(false);
@@ -86,24 +80,7 @@ bool EventProcessor::PreProcess(RawEvent &event) {
 bool EventProcessor::Process(RawEvent &event) {
     if (!initDone)
         return (didProcess = false);
-
-    times(&tmsBegin);
-
-    EndProcess();
     return (didProcess = true);
 }
 
-void EventProcessor::EndProcess(void) {
-    tms tmsEnd;
-
-    times(&tmsEnd);
-
-    userTime += (tmsEnd.tms_utime - tmsBegin.tms_utime) / clocksPerSecond;
-    systemTime += (tmsEnd.tms_stime - tmsBegin.tms_stime) / clocksPerSecond;
-
-    //! Reset the beginning time so multiple calls of EndProcess from
-    //! derived classes work properly
-    times(&tmsBegin);
-}
-
 
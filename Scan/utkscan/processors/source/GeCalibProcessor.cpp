@@ -59,6 +59,7 @@ GeCalibProcessor::GeCalibProcessor(double gammaThreshold, double lowRatio,
     GeProcessor(gammaThreshold, lowRatio, highRatio,
 		100e-9, 200e-9,
 		200e-9, 0, 0, 0, 0) {
+    DeclareAccess({"Beta"}, {});
 }
 
 /** Declare plots including many for decay/implant/neutron gated analysis  */
@@ -72,13 +73,14 @@ void GeCalibProcessor::DeclarePlots(void) {
     
     DetectorLibrary* modChan = DetectorLibrary::get();
     
-    const set<int> &cloverLocations = modChan->GetLocations("ge", "clover_high");
+    const LocationSet &cloverLocations =
+        modChan->GetLocationSet("ge", "clover_high");
     // could set it now but we'll iterate through the locations to set this
     unsigned int cloverChans = 0;
-    
-    for ( set<int>::const_iterator it = cloverLocations.begin();
-	  it != cloverLocations.end(); it++) {
-        leafToClover[*it] = int(cloverChans / 4);
+
+    for (int loc = cloverLocations.Next(0); loc >= 0;
+         loc = cloverLocations.Next(loc + 1)) {
+        leafToClover[loc] = int(cloverChans / 4);
         cloverChans++;
     }
     
@@ -60,14 +60,25 @@ void GeProcessor::symplot(int dammID, double bin1, double bin2) {
     plot(dammID, bin2, bin1);
 }
 
+void GeProcessor::symplot(const Plots::Handle &handle, double bin1,
+                          double bin2) {
+    plot(handle, bin1, bin2);
+    plot(handle, bin2, bin1);
+}
+
 GeProcessor::GeProcessor(double gammaThreshold, double lowRatio,
                          double highRatio, double subEventWindow,
                          double gammaBetaLimit, double gammaGammaLimit,
                          double cycle_gate1_min, double cycle_gate1_max,
-                         double cycle_gate2_min, double cycle_gate2_max) :
+                         double cycle_gate2_min, double cycle_gate2_max,
+                         const std::string &cubeFile, unsigned int cubeSize,
+                         double cubeBin) :
                          EventProcessor(OFFSET, RANGE, "GeProcessor"),
-                         leafToClover() {
+                         leafToClover(), cube_(NULL), cubeFile_(cubeFile),
+                         cubeBin_(cubeBin) {
     associatedTypes.insert("ge"); // associate with germanium detectors
+    DeclareAccess({"Beam", "Beta", "Cycle"}, {});
+    DeclareTraceFields({});
 
     gammaThreshold_ = gammaThreshold;
     lowRatio_ = lowRatio;
@@ -93,19 +104,18 @@ GeProcessor::GeProcessor(double gammaThreshold, double lowRatio,
         throw GeneralException(ss.str());
     }
 
+    if (!cubeFile_.empty()) {
+        if (cubeBin_ <= 0 || cubeSize == 0 || cubeSize > GammaCube::maxSize)
+            throw GeneralException("GeProcessor: wrong size or bin width of "
+                                   "the gamma-gamma-gamma cube");
+        cube_ = new GammaCube(cubeSize, cubeBin_);
+    }
+
 #ifdef GGATES
     Messenger m;
     m.detail("Loading Gamma-gamma gates", 1);
 
-    string cfg = Globals::get()->configfile();
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_file(cfg.c_str());
-    if (!result) {
-        stringstream ss;
-        ss << "DetectorDriver: error parsing file " << cfg;
-        ss << " : " << result.description();
-        throw IOException(ss.str());
-    }
+    const pugi::xml_document &doc = Globals::get()->configdoc();
 
     pugi::xml_node gamma_gates = doc.child("Configuration").child("GammaGates");
     for (pugi::xml_node gate = gamma_gates.child("Gate"); gate;
@@ -146,6 +156,19 @@ not implemented");
 #endif
 }
 
+GeProcessor::~GeProcessor() {
+    if (!cube_)
+        return;
+    Messenger m;
+    stringstream ss;
+    ss << "Writing " << cube_->GetTotal() << " gamma-gamma-gamma triples in "
+       << cube_->GetNumEntries() << " bins to " << cubeFile_;
+    m.detail(ss.str());
+    if (!cube_->Write(cubeFile_))
+        m.warning("GeProcessor: Failed to write the cube to " + cubeFile_);
+    delete cube_;
+}
+
 /** Declare plots including many for decay/implant/neutron gated analysis  */
 void GeProcessor::DeclarePlots(void) {
     const int energyBins1  = SD;
@@ -164,14 +187,14 @@ void GeProcessor::DeclarePlots(void) {
     */
     DetectorLibrary* modChan = DetectorLibrary::get();
 
-    const set<int> &cloverLocations = modChan->GetLocations("ge",
-                                                            "clover_high");
+    const LocationSet &cloverLocations =
+        modChan->GetLocationSet("ge", "clover_high");
     // could set it now but we'll iterate through the locations to set this
     unsigned int cloverChans = 0;
 
-    for ( set<int>::const_iterator it = cloverLocations.begin();
-	  it != cloverLocations.end(); it++) {
-        leafToClover[*it] = int(cloverChans / 4);
+    for (int loc = cloverLocations.Next(0); loc >= 0;
+         loc = cloverLocations.Next(loc + 1)) {
+        leafToClover[loc] = int(cloverChans / 4);
         cloverChans++;
     }
 
@@ -221,6 +244,14 @@ void GeProcessor::DeclarePlots(void) {
         addbackEvents_.push_back(empty);
     }
 
+    if (!leafToClover.empty()) {
+        cloverOfLeaf_.assign(leafToClover.rbegin()->first + 1, 0);
+        for (map<int, int>::const_iterator it = leafToClover.begin();
+             it != leafToClover.end(); ++it)
+            cloverOfLeaf_[it->first] = it->second;
+    }
+    lowOfLeaf_.assign(cloverOfLeaf_.size(), NULL);
+
     DeclareHistogram1D(D_ENERGY, energyBins1, "Gamma singles");
     DeclareHistogram1D(D_ENERGY_MOVE, energyBins1,
                        "Gamma singles tape move period");
@@ -379,6 +410,25 @@ void GeProcessor::DeclarePlots(void) {
                           energyBins2, granTimeBins,
                           "Beta-gated addback E - Time",
                           2, timeResolution, "s");
+
+    ggPlots_.energy = histo.GetHandle(DD_ENERGY);
+    ggPlots_.cgate1 = histo.GetHandle(DD_ENERGY_CGATE1);
+    ggPlots_.cgate2 = histo.GetHandle(DD_ENERGY_CGATE2);
+    ggPlots_.prompt = histo.GetHandle(DD_ENERGY_PROMPT);
+    ggPlots_.betaEnergy = histo.GetHandle(betaGated::DD_ENERGY);
+    ggPlots_.betaCgate1 = histo.GetHandle(betaGated::DD_ENERGY_CGATE1);
+    ggPlots_.betaCgate2 = histo.GetHandle(betaGated::DD_ENERGY_CGATE2);
+    ggPlots_.betaPrompt = histo.GetHandle(betaGated::DD_ENERGY_PROMPT);
+    ggPlots_.betaDelayed = histo.GetHandle(betaGated::DD_ENERGY_BDELAYED);
+    ggPlots_.tdiff = histo.GetHandle(DD_TDIFF__GAMMA_GAMMA_ENERGY);
+    ggPlots_.tdiffSum = histo.GetHandle(DD_TDIFF__GAMMA_GAMMA_ENERGY_SUM);
+    ggPlots_.add = histo.GetHandle(DD_ADD_ENERGY);
+    ggPlots_.addMulti = histo.GetHandle(multi::DD_ADD_ENERGY);
+    ggPlots_.addBeta = histo.GetHandle(betaGated::DD_ADD_ENERGY);
+    ggPlots_.addBetaMulti = histo.GetHandle(multi::betaGated::DD_ADD_ENERGY);
+    ggPlots_.addPrompt = histo.GetHandle(betaGated::DD_ADD_ENERGY_PROMPT);
+    ggPlots_.addPromptMulti =
+        histo.GetHandle(multi::betaGated::DD_ADD_ENERGY_PROMPT);
 }
 
 
@@ -387,6 +437,7 @@ bool GeProcessor::PreProcess(RawEvent &event) {
         return false;
 
     geEvents_.clear();
+    gammas_.clear();
     for (unsigned i = 0; i < numClovers; ++i)
         addbackEvents_[i].clear();
     tas_.clear();
@@ -396,6 +447,15 @@ bool GeProcessor::PreProcess(RawEvent &event) {
     static const vector<ChanEvent*> &lowEvents  =
         event.GetSummary("ge:clover_low", true)->GetList();
 
+    /** The first low gain event of each leaf, to match the high gain
+     * events without searching the low gain list for each of them */
+    for (vector<ChanEvent*>::const_reverse_iterator itLow = lowEvents.rbegin();
+         itLow != lowEvents.rend(); itLow++) {
+        int location = (*itLow)->GetChanID().GetLocation();
+        if (location >= 0 && location < (int)lowOfLeaf_.size())
+            lowOfLeaf_[location] = *itLow;
+    }
+
     /** Only the high gain events are going to be used. The events where
      * low/high gain mismatches, saturation or pileup is marked are rejected
      */
@@ -405,23 +465,45 @@ bool GeProcessor::PreProcess(RawEvent &event) {
         if ( (*itHigh)->IsSaturated() || (*itHigh)->IsPileup() )
             continue;
 
-        vector <ChanEvent*>::const_iterator itLow = lowEvents.begin();
-        for (; itLow != lowEvents.end(); itLow++) {
-            if ( (*itLow)->GetChanID().GetLocation() == location ) {
-                break;
-            }
-        }
-        if ( itLow != lowEvents.end() ) {
-            double ratio = (*itHigh)->GetEnergy() / (*itLow)->GetEnergy();
+        ChanEvent *low = NULL;
+        if (location >= 0 && location < (int)lowOfLeaf_.size())
+            low = lowOfLeaf_[location];
+        if ( low != NULL ) {
+            double ratio = (*itHigh)->GetEnergy() / low->GetEnergy();
             if (ratio < lowRatio_ || ratio > highRatio_)
                 continue;
         }
         geEvents_.push_back(*itHigh);
     }
 
+    for (vector<ChanEvent*>::const_iterator itLow = lowEvents.begin();
+         itLow != lowEvents.end(); itLow++) {
+        int location = (*itLow)->GetChanID().GetLocation();
+        if (location >= 0 && location < (int)lowOfLeaf_.size())
+            lowOfLeaf_[location] = NULL;
+    }
+
     // now we sort the germanium events according to their corrected time
     sort(geEvents_.begin(), geEvents_.end(), CompareCorrectedTime);
 
+    for (vector<ChanEvent*>::iterator it = geEvents_.begin();
+         it != geEvents_.end(); it++) {
+        /**
+        * Do not take into account events with too low energy
+        * (avoid summing of noise with real gammas)
+        */
+        double energy = (*it)->GetCalEnergy();
+        if (energy < gammaThreshold_)
+            continue;
+        GammaHit hit;
+        hit.energy = energy;
+        hit.time = (*it)->GetCorrectedTime();
+        int location = (*it)->GetChanID().GetLocation();
+        hit.clover = location < (int)cloverOfLeaf_.size() ?
+            cloverOfLeaf_[location] : 0;
+        gammas_.push_back(hit);
+    }
+
     /** Here the addback spectra is constructed.
      *  addbackEvents_ is a vector for each clover
      *  holding a vector of pairs <energy, time> (both double),
@@ -433,24 +515,19 @@ bool GeProcessor::PreProcess(RawEvent &event) {
      */
     double refTime = -2.0 * subEventWindow_;
 
-    for (vector<ChanEvent*>::iterator it = geEvents_.begin(); it != geEvents_.end(); it++) {
-        ChanEvent *chan = *it;
-        double energy = chan->GetCalEnergy();
-        double time = chan->GetCorrectedTime();
-        int clover = leafToClover[chan->GetChanID().GetLocation()];
-
-        /**
-        * Do not take into account events with too low energy
-        * (avoid summing of noise with real gammas)
-        */
-        if (energy < gammaThreshold_)
-            continue;
+    const double clockInSeconds = Globals::get()->constants().clockInSeconds;
+    for (vector<GammaHit>::iterator it = gammas_.begin();
+         it != gammas_.end(); it++) {
+        double energy = it->energy;
+        double time = it->time;
+        int clover = it->clover;
 
         // entries in map are sorted by time
         // if event time is outside of subEventWindow, we start new
-        //   events for all clovers and "tas"
-        double dtime = abs(time - refTime) * Globals::get()->clockInSeconds();
-        if (dtime > subEventWindow_) {
+        //   events for all clovers and "tas"; the first gamma always
+        //   starts one, whatever its time
+        double dtime = abs(time - refTime) * clockInSeconds;
+        if (dtime > subEventWindow_ || tas_.empty()) {
             for (unsigned i = 0; i < numClovers; ++i) {
                 addbackEvents_[i].push_back(AddBackEvent());
             }
@@ -508,17 +585,12 @@ bool GeProcessor::Process(RawEvent &event) {
     
     // Note that geEvents_ vector holds only good events (matched
     // low & high gain). See PreProcess
-    for (vector<ChanEvent*>::iterator it1 = geEvents_.begin();
-	 it1 != geEvents_.end(); ++it1) {
-        ChanEvent* chan = *it1;
-	
-        double gEnergy = chan->GetCalEnergy();
-        if (gEnergy < gammaThreshold_)
-            continue;
-	
-        double gTime = chan->GetCorrectedTime();
+    for (vector<GammaHit>::const_iterator it1 = gammas_.begin();
+	 it1 != gammas_.end(); ++it1) {
+        double gEnergy = it1->energy;
+        double gTime = it1->time;
         double decayTime = (gTime - cycleTime) * clockInSeconds;
-        int det = leafToClover[chan->GetChanID().GetLocation()];
+        int det = it1->clover;
 	
         plot(D_ENERGY, gEnergy);
         plot(D_ENERGY_CLOVERX + det, gEnergy);
@@ -569,16 +641,42 @@ bool GeProcessor::Process(RawEvent &event) {
             }
         }
 
-        for (vector<ChanEvent*>::const_iterator it2 = it1 + 1;
-                it2 != geEvents_.end(); it2++) {
-            ChanEvent* chan2 = *it2;
-
-            double gEnergy2 = chan2->GetCalEnergy();
-            int det2 = leafToClover[chan2->GetChanID().GetLocation()];
-            double gTime2 = chan2->GetCorrectedTime();
-
-            if (gEnergy2 < gammaThreshold_)
-                continue;
+        /** The matrices a pair is plotted into depend only on the gates
+         * passed by the first gamma of the pair, so they are chosen once
+         * here and the loop over the second gammas only fills them. */
+        bool cycleGate1 = decayTime > cycle_gate1_min_ &&
+                          decayTime < cycle_gate1_max_;
+        bool cycleGate2 = decayTime > cycle_gate2_min_ &&
+                          decayTime < cycle_gate2_max_;
+        bool promptBeta = hasBeta && GoodGammaBeta(gb_dtime);
+
+        const Plots::Handle *pairPlots[6];
+        unsigned numPairPlots = 0;
+        pairPlots[numPairPlots++] = &ggPlots_.energy;
+        if (cycleGate1)
+            pairPlots[numPairPlots++] = &ggPlots_.cgate1;
+        if (cycleGate2)
+            pairPlots[numPairPlots++] = &ggPlots_.cgate2;
+        if (promptBeta) {
+            pairPlots[numPairPlots++] = &ggPlots_.betaEnergy;
+            if (cycleGate1)
+                pairPlots[numPairPlots++] = &ggPlots_.betaCgate1;
+            if (cycleGate2)
+                pairPlots[numPairPlots++] = &ggPlots_.betaCgate2;
+        } else if (hasBeta && gb_dtime > gammaBetaLimit_)
+            pairPlots[numPairPlots++] = &ggPlots_.betaDelayed;
+
+        const Plots::Handle *promptPlots[2];
+        unsigned numPromptPlots = 0;
+        promptPlots[numPromptPlots++] = &ggPlots_.prompt;
+        if (promptBeta)
+            promptPlots[numPromptPlots++] = &ggPlots_.betaPrompt;
+
+        for (vector<GammaHit>::const_iterator it2 = it1 + 1;
+                it2 != gammas_.end(); it2++) {
+            double gEnergy2 = it2->energy;
+            int det2 = it2->clover;
+            double gTime2 = it2->time;
 
             double gg_dtime = (gTime2 - gTime) * clockInSeconds;
 
@@ -586,10 +684,10 @@ bool GeProcessor::Process(RawEvent &event) {
              * to monitor addback subevent gates. */
             if (det == det2) {
                 double plotResolution = clockInSeconds;
-                plot(DD_TDIFF__GAMMA_GAMMA_ENERGY,
+                plot(ggPlots_.tdiff,
                      (int)(gg_dtime / plotResolution + 100),
                      gEnergy);
-                plot(DD_TDIFF__GAMMA_GAMMA_ENERGY_SUM,
+                plot(ggPlots_.tdiffSum,
                       (int)(gg_dtime / plotResolution + 100),
                       gEnergy + gEnergy2);
             }
@@ -601,40 +699,12 @@ bool GeProcessor::Process(RawEvent &event) {
              * (by 20% approx)
              */
             if (det2 != det) {
-                symplot(DD_ENERGY, gEnergy, gEnergy2);
-
-                if (decayTime > cycle_gate1_min_ &&
-                    decayTime < cycle_gate1_max_)
-                    symplot(DD_ENERGY_CGATE1, gEnergy, gEnergy2);
-                if (decayTime > cycle_gate2_min_ &&
-                    decayTime < cycle_gate2_max_)
-                    symplot(DD_ENERGY_CGATE2, gEnergy, gEnergy2);
-
-                if (hasBeta) {
-                    if (GoodGammaBeta(gb_dtime)) {
-                        symplot(betaGated::DD_ENERGY, gEnergy,
-                                gEnergy2);
-                        if (decayTime > cycle_gate1_min_ &&
-                            decayTime < cycle_gate1_max_)
-                            symplot(betaGated::DD_ENERGY_CGATE1,
-                                    gEnergy, gEnergy2);
-                        if (decayTime > cycle_gate2_min_ &&
-                            decayTime < cycle_gate2_max_)
-                            symplot(betaGated::DD_ENERGY_CGATE2,
-                                    gEnergy, gEnergy2);
-
-                    } else if (gb_dtime > gammaBetaLimit_) {
-                            symplot(betaGated::DD_ENERGY_BDELAYED,
-                                    gEnergy, gEnergy2);
-                    }
-                }
+                for (unsigned i = 0; i < numPairPlots; ++i)
+                    symplot(*pairPlots[i], gEnergy, gEnergy2);
 
                 if (abs(gg_dtime) < gammaGammaLimit_) {
-                    symplot(DD_ENERGY_PROMPT, gEnergy, gEnergy2);
-                    if (hasBeta && GoodGammaBeta(gb_dtime)) {
-                        symplot(betaGated::DD_ENERGY_PROMPT,
-                                gEnergy, gEnergy2);
-                    }
+                    for (unsigned i = 0; i < numPromptPlots; ++i)
+                        symplot(*promptPlots[i], gEnergy, gEnergy2);
                 }
             }
 #ifdef GGATES
@@ -681,11 +751,9 @@ bool GeProcessor::Process(RawEvent &event) {
                             plot(betaGated::DD_ANGLE__GATEX, 2, ig);
                     }
 
-                    for (vector<ChanEvent*>::const_iterator it3 = it2 + 1;
-                            it3 != geEvents_.end(); it3++) {
-                        double gEnergy3 = (*it3)->GetCalEnergy();
-                        if (gEnergy3 < gammaThreshold_)
-                            continue;
+                    for (vector<GammaHit>::const_iterator it3 = it2 + 1;
+                            it3 != gammas_.end(); it3++) {
+                        double gEnergy3 = it3->energy;
                         plot(DD_ENERGY__GATEX, gEnergy3, ig);
                         if (hasBeta && GoodGammaBeta(gb_dtime))
                             plot(betaGated::DD_ENERGY__GATEX, gEnergy3, ig);
@@ -760,6 +828,25 @@ bool GeProcessor::Process(RawEvent &event) {
                 }
             }
 
+            /** As for the single gammas, the matrices are chosen once for
+             * the first clover, the multi-gated ones are only used for
+             * pairs where both clovers have a multiplicity of 1 */
+            const Plots::Handle *addPlots[3], *addMultiPlots[3];
+            unsigned numAddPlots = 0, numAddMultiPlots = 0;
+            addPlots[numAddPlots++] = &ggPlots_.add;
+            addMultiPlots[numAddMultiPlots++] = &ggPlots_.addMulti;
+            if (hasBeta) {
+                addPlots[numAddPlots++] = &ggPlots_.addBeta;
+                addMultiPlots[numAddMultiPlots++] = &ggPlots_.addBetaMulti;
+                if (GoodGammaBeta(gb_dtime)) {
+                    addPlots[numAddPlots++] = &ggPlots_.addPrompt;
+                    addMultiPlots[numAddMultiPlots++] =
+                        &ggPlots_.addPromptMulti;
+                }
+            }
+            if (gMulti != 1)
+                numAddMultiPlots = 0;
+
             for (unsigned int det2 = det + 1;
                     det2 < numClovers; ++det2) {
                 double gEnergy2 = addbackEvents_[det2][ev].energy;
@@ -772,30 +859,52 @@ bool GeProcessor::Process(RawEvent &event) {
                 if (abs(gg_dtime) > gammaGammaLimit_)
                     continue;
 
-                symplot(DD_ADD_ENERGY, gEnergy, gEnergy2);
-                if (gMulti == 1 && gMulti2 == 1)
-                    symplot(multi::DD_ADD_ENERGY, gEnergy, gEnergy2);
-                if (hasBeta) {
-                    symplot(betaGated::DD_ADD_ENERGY, gEnergy, gEnergy2);
-                    if (gMulti == 1 && gMulti2 == 1)
-                        symplot(multi::betaGated::DD_ADD_ENERGY,
-                                gEnergy, gEnergy2);
-                    if (GoodGammaBeta(gb_dtime)) {
-                        symplot(betaGated::DD_ADD_ENERGY_PROMPT,
-                                gEnergy, gEnergy2);
-                        if (gMulti == 1 && gMulti2 == 1)
-                            symplot(multi::betaGated::DD_ADD_ENERGY_PROMPT,
-                                    gEnergy, gEnergy2);
-                    }
+                for (unsigned i = 0; i < numAddPlots; ++i)
+                    symplot(*addPlots[i], gEnergy, gEnergy2);
+                if (gMulti2 == 1) {
+                    for (unsigned i = 0; i < numAddMultiPlots; ++i)
+                        symplot(*addMultiPlots[i], gEnergy, gEnergy2);
                 }
             } // iteration over other clovers
         } // itertaion over clovers
     } // iteration over events
 
+    if (cube_)
+        FillCube();
+
     EndProcess(); // update the processing time
     return true;
 }
 
+void GeProcessor::FillCube(void) {
+    const double clockInSeconds = Globals::get()->constants().clockInSeconds;
+    for (unsigned int ev = 0; ev < tas_.size(); ev++) {
+        cubeHits_.clear();
+        for (unsigned int det = 0; det < numClovers; ++det)
+            if (addbackEvents_[det][ev].energy >= max(gammaThreshold_, 0.0))
+                cubeHits_.push_back(&addbackEvents_[det][ev]);
+
+        //! Every triple of clovers whose gammas are pairwise prompt
+        for (unsigned int i = 0; i + 2 < cubeHits_.size(); i++) {
+            for (unsigned int j = i + 1; j + 1 < cubeHits_.size(); j++) {
+                if (abs(cubeHits_[j]->time - cubeHits_[i]->time) *
+                    clockInSeconds > gammaGammaLimit_)
+                    continue;
+                for (unsigned int k = j + 1; k < cubeHits_.size(); k++) {
+                    if (abs(cubeHits_[k]->time - cubeHits_[i]->time) *
+                        clockInSeconds > gammaGammaLimit_ ||
+                        abs(cubeHits_[k]->time - cubeHits_[j]->time) *
+                        clockInSeconds > gammaGammaLimit_)
+                        continue;
+                    cube_->Add(cubeHits_[i]->energy / cubeBin_,
+                               cubeHits_[j]->energy / cubeBin_,
+                               cubeHits_[k]->energy / cubeBin_);
+                }
+            }
+        }
+    }
+}
+
 /**
  * Declare a 2D plot with a range of granularites on the Y axis
  */
@@ -2,6 +2,7 @@
  *
  * implementation for scintillator processor
  */
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <limits>
@@ -30,7 +31,9 @@ namespace dammIds {
 
         namespace beta {
             const int D_MULT_NEUTRON = 11;//!< Beta Gated Neutron Multiplicity
+            const int D_MULT_NEUTRON_WINDOW = 12;//!< Neutrons in the window after a beta
             const int D_ENERGY_NEUTRON = 13;//!< Beta Gated Neutron Energy
+            const int D_MULT_NEUTRON_RANDOM = 14;//!< Neutrons in the window before a beta
             const int D_TDIFF_HEN3_BETA = 15;//!< Beta Gated Tdiff btwn Hen3 & Beta
             const int D_TDIFF_NEUTRON_BETA = 16;//!< Beta Gated Tdiff btwn Neutron & Beta
         }
@@ -40,8 +43,18 @@ namespace dammIds {
     }
 }
 
-Hen3Processor::Hen3Processor() : EventProcessor(OFFSET, RANGE, "Hen3Processor") {
+Hen3Processor::Hen3Processor() : EventProcessor(OFFSET, RANGE, "Hen3Processor"),
+    neutronWindow_(0) {
     associatedTypes.insert("3hen");
+    DeclareAccess({"Beta", "Cycle"}, {"Neutron_*"});
+}
+
+Hen3Processor::Hen3Processor(double neutronWindow) :
+    EventProcessor(OFFSET, RANGE, "Hen3Processor"),
+    neutronWindow_(neutronWindow),
+    windows_(neutronWindow / Globals::get()->clockInSeconds()) {
+    associatedTypes.insert("3hen");
+    DeclareAccess({"Beta", "Cycle"}, {"Neutron_*"});
 }
 
 EventData Hen3Processor::BestBetaForNeutron(double nTime) {
@@ -70,6 +83,13 @@ EventData Hen3Processor::BestBetaForNeutron(double nTime) {
         return EventData(-1);
 }
 
+bool Hen3Processor::HasEvent(void) const {
+    if (EventProcessor::HasEvent())
+        return true;
+    return neutronWindow_ > 0 &&
+        TreeCorrelator::get()->place("Beta")->status();
+}
+
 void Hen3Processor::DeclarePlots(void) {
     DeclareHistogram1D(D_MULT_HEN3, S4, "3Hen event multiplicity");
     DeclareHistogram1D(D_MULT_NEUTRON, S4, "3Hen real neutron multiplicity");
@@ -95,6 +115,13 @@ void Hen3Processor::DeclarePlots(void) {
     DeclareHistogram2D(DD_DISTR_HEN3, S5, S5, "3Hen event distribution");
     DeclareHistogram2D(DD_DISTR_NEUTRON, S5, S5,
             "3Hen neutron distribution");
+
+    if (neutronWindow_ > 0) {
+        DeclareHistogram1D(beta::D_MULT_NEUTRON_WINDOW, S5,
+                "Neutrons in the window after a beta");
+        DeclareHistogram1D(beta::D_MULT_NEUTRON_RANDOM, S5,
+                "Neutrons in the window before a beta (random)");
+    }
 }
 
 bool Hen3Processor::PreProcess(RawEvent &event) {
@@ -128,6 +155,15 @@ bool Hen3Processor::Process(RawEvent &event) {
 
     static const DetectorSummary *hen3Summary = event.GetSummary("3hen", true);
 
+    if (neutronWindow_ > 0) {
+        CountWindows(event);
+        /** A beta without 3Hen hits only opens a window */
+        if (hen3Summary->GetMult() == 0) {
+            EndProcess();
+            return true;
+        }
+    }
+
     int hen3_count = dynamic_cast<PlaceCounter*>(
             TreeCorrelator::get()->place("Hen3"))->getCounter();
     int neutron_count = dynamic_cast<PlaceCounter*>(
@@ -232,3 +268,42 @@ bool Hen3Processor::Process(RawEvent &event) {
     EndProcess();
     return true;
 }
+
+void Hen3Processor::CountWindows(RawEvent &event) {
+    static const DetectorSummary *hen3Summary = event.GetSummary("3hen", true);
+
+    /** The neutrons and the beta are given in time order, the beta marked
+     * by true, so that the windows may cross the raw events. A neutron at
+     * the time of the beta comes first, it is not after the beta. */
+    vector<pair<double, bool> > times;
+    for (vector<ChanEvent*>::const_iterator it =
+             hen3Summary->GetList().begin();
+         it != hen3Summary->GetList().end(); it++) {
+        stringstream neutron_name;
+        neutron_name << "Neutron_" << (*it)->GetChanID().GetLocation();
+        if (TreeCorrelator::get()->place(neutron_name.str())->status())
+            times.push_back(make_pair((*it)->GetTime(), false));
+    }
+
+    bool tapeMove = !(TreeCorrelator::get()->place("Cycle")->status());
+    Place *beta = TreeCorrelator::get()->place("Beta");
+    if (!tapeMove && beta->status())
+        times.push_back(make_pair(beta->last().time, true));
+    sort(times.begin(), times.end());
+
+    for (vector<pair<double, bool> >::const_iterator it = times.begin();
+         it != times.end(); ++it) {
+        if (it->second)
+            windows_.AddTrigger(it->first);
+        else
+            windows_.AddHit(it->first);
+    }
+
+    const vector<TimeWindowCounter::Result> &results = windows_.GetResults();
+    for (vector<TimeWindowCounter::Result>::const_iterator it =
+             results.begin(); it != results.end(); ++it) {
+        plot(beta::D_MULT_NEUTRON_WINDOW, it->after);
+        plot(beta::D_MULT_NEUTRON_RANDOM, it->before);
+    }
+    windows_.ClearResults();
+}
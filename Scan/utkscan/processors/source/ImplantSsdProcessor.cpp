@@ -62,6 +62,7 @@ namespace dammIds {
 
         const int D_TDIFF_FOIL_IMPLANT = 11;//!< Tdiff between Foil and Implant
         const int D_TDIFF_FOIL_IMPLANT_MULT1 = 12;//!< Tdiff between Foil and Implant - Multiplicity 1
+        const int DD_DECAY_ENERGY__STRIP_TIME = 13;//!< Decay E vs. time since the implant of the strip
 
         const int D_FAST_DECAY_TRACE  = 100;//!< Fast decay traces
         const int D_HIGH_ENERGY_TRACE = 200;//!< High energy traces
@@ -71,6 +72,10 @@ namespace dammIds {
 ImplantSsdProcessor::ImplantSsdProcessor() : 
     EventProcessor(OFFSET, RANGE, "ImplantSsdProcessor") {
     associatedTypes.insert("ssd");
+    for (unsigned int i = 0; i < NUM_CONDITIONS; i++)
+        typeTable_[i] = TypeOf(i);
+    DeclareTraceFields({"badqdc", "filterEnergy*", "filterTime*", "numPulses",
+                        "position"});
 }
 
 void ImplantSsdProcessor::DeclarePlots(void)
@@ -199,6 +204,8 @@ void ImplantSsdProcessor::DeclarePlots(void)
 
     DeclareHistogram1D(D_TDIFF_FOIL_IMPLANT, tdiffBins, "DT foil to implant");
     DeclareHistogram1D(D_TDIFF_FOIL_IMPLANT_MULT1, tdiffBins, "DT foil to implant, mult. gated");
+    DeclareHistogram2D(DD_DECAY_ENERGY__STRIP_TIME, decayEnergyBins, timeBins,
+		       "Decay E vs time since strip implant (1ms/ch)");
 
     for (unsigned int i=0; i < numTraces; i++) {
 	DeclareHistogram1D(D_FAST_DECAY_TRACE + i, traceBins, "fast decay trace");
@@ -250,15 +257,15 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
     } else {
 	info.energy  = ch->GetCalEnergy();
     }
-    if (ch->GetTrace().HasValue("position")) {
-	info.position = ch->GetTrace().GetValue("position");
+    if (ch->GetTrace().HasValue(Trace::POSITION)) {
+	info.position = ch->GetTrace().GetValue(Trace::POSITION);
     } // else it defaults to nan
 
     info.time    = ch->GetTime();
     info.beamOn  = true;
 
     // recect noise events
-    if (info.energy < 10 || ch->GetTrace().HasValue("badqdc")) {
+    if (info.energy < 10 || ch->GetTrace().HasValue(Trace::BAD_QDC)) {
 	EndProcess();
 	return true;
     }
@@ -284,11 +291,11 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
     double digitalTof = NAN;
     if (mcpSummary) {
 	info.mcpMult = mcpSummary->GetMult();
-	vector<ChanEvent*> mcpEvents = mcpSummary->GetList();
+	const vector<ChanEvent*> &mcpEvents = mcpSummary->GetList();
 
 	double dtMin = DBL_MAX;
 
-	for (vector<ChanEvent*>::iterator it = mcpEvents.begin();
+	for (vector<ChanEvent*>::const_iterator it = mcpEvents.begin();
 	     it != mcpEvents.end(); it++) {
 	    double dt = info.time - (*it)->GetTime();
 
@@ -327,7 +334,7 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
     }
     info.tof = NAN;
     if (tacSummary) {
-	const vector<ChanEvent*> events = tacSummary->GetList();
+	const vector<ChanEvent*> &events = tacSummary->GetList();
 	for (vector<ChanEvent*>::const_iterator it = events.begin(); it != events.end(); it++) {
 	    int loc = (*it)->GetChanID().GetLocation();
 	    if (loc == 2) {
@@ -347,10 +354,11 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
 
     SetType(info);
     Correlate(corr, info, location);
+    UpdateStrip(info, location);
 
     // TOF spectra update
     if (tacSummary) {
-	const vector<ChanEvent*> events = tacSummary->GetList();
+	const vector<ChanEvent*> &events = tacSummary->GetList();
 	for (vector<ChanEvent*>::const_iterator it = events.begin();
 	     it != events.end(); it++) {
 	    double tof  = (*it)->GetCalEnergy();
@@ -389,14 +397,14 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
     if (info.pileUp) {
         double trigTime = info.time;
 
-        info.energy = driver->cali.GetCalEnergy(ch->GetChanID(),
+        info.energy = driver->cali.GetCalEnergy(ch->GetID(),
                                               trace.GetValue("filterEnergy2"));
-        info.time = trigTime + trace.GetValue("filterTime2") - trace.GetValue("filterTime");
+        info.time = trigTime + trace.GetValue("filterTime2") - trace.GetValue(Trace::FILTER_TIME);
 
         SetType(info);
         Correlate(corr, info, location);
 
-        int numPulses = trace.GetValue("numPulses");
+        int numPulses = trace.GetValue(Trace::NUM_PULSES);
 
         if ( numPulses > 2 ) {
             corr.Flag(location, 1);
@@ -404,11 +412,11 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
             for (int i=3; i <= numPulses; i++) {
             stringstream str;
             str << "filterEnergy" << i;
-            info.energy = driver->cali.GetCalEnergy(ch->GetChanID(),
+            info.energy = driver->cali.GetCalEnergy(ch->GetID(),
                                               trace.GetValue(str.str()));
             str.str(""); // clear it
             str << "filterTime" << i;
-            info.time   = trigTime + trace.GetValue(str.str()) - trace.GetValue("filterTime");
+            info.time   = trigTime + trace.GetValue(str.str()) - trace.GetValue(Trace::FILTER_TIME);
 
             SetType(info);
             Correlate(corr, info, location);
@@ -419,7 +427,7 @@ bool ImplantSsdProcessor::Process(RawEvent &event)
         cout << "Flagging for pileup" << endl;
 
         cout << "fast trace " << fastTracesWritten << " in strip " << location
-            << " : " << trace.GetValue("filterEnergy") << " " << trace.GetValue("filterTime")
+            << " : " << trace.GetValue(Trace::FILTER_ENERGY) << " " << trace.GetValue(Trace::FILTER_TIME)
             << " , " << trace.GetValue("filterEnergy2") << " " << trace.GetValue("filterTime2") << endl;
         cout << "  mcp mult " << info.mcpMult << endl;
 #endif // VERBOSE
@@ -460,45 +468,90 @@ EventInfo::EEventTypes ImplantSsdProcessor::SetType(EventInfo &info) const
 	return (info.type = EventInfo::PROTON_EVENT);
     }
 
-    bool enoughMcp = (info.mcpMult >= info.impMult);
+    unsigned int conditions =
+        (info.energy > cutoffEnergy) * HIGH_ENERGY |
+        info.beamOn * BEAM_ON |
+        info.hasTof * HAS_TOF |
+        (info.mcpMult >= info.impMult) * ENOUGH_MCP |
+        (info.tof > implantTof) * LONG_TOF |
+        (info.energy > fissionThresh) * FISSION_ENERGY |
+        info.pileUp * PILE_UP;
+    return (info.type = typeTable_[conditions]);
+}
+
+EventInfo::EEventTypes ImplantSsdProcessor::TypeOf(unsigned int conditions)
+{
+    bool beamOn = conditions & BEAM_ON;
+    bool hasTof = conditions & HAS_TOF;
+    bool enoughMcp = conditions & ENOUGH_MCP;
+    bool pileUp = conditions & PILE_UP;
+
     // high energy events
-    if (info.energy > cutoffEnergy) {
-	if ( info.beamOn) {
-	    if (info.hasTof && enoughMcp) {
-		if (info.tof > implantTof) {
-		    return (info.type = EventInfo::IMPLANT_EVENT);
+    if (conditions & HIGH_ENERGY) {
+	if (beamOn) {
+	    if (hasTof && enoughMcp) {
+		if (conditions & LONG_TOF) {
+		    return EventInfo::IMPLANT_EVENT;
 		}
-		return (info.type = EventInfo::PROJECTILE_EVENT);
+		return EventInfo::PROJECTILE_EVENT;
 	    } else {
 		// NO TAC OR MCP
-		if (info.energy > fissionThresh && !info.hasTof && !enoughMcp)
-
-		    return (info.type = EventInfo::FISSION_EVENT);
+		if ((conditions & FISSION_ENERGY) && !hasTof && !enoughMcp)
+		    return EventInfo::FISSION_EVENT;
 		// Implant with lost TAC or MCP possibly?
-		return (info.type = EventInfo::UNKNOWN_EVENT);
+		return EventInfo::UNKNOWN_EVENT;
 	    }
 	}
 	// NO BEAM
-	if (info.hasTof || enoughMcp) {
-	    return (info.type = EventInfo::UNKNOWN_EVENT);
+	if (hasTof || enoughMcp) {
+	    return EventInfo::UNKNOWN_EVENT;
 	}
-	if (info.energy > fissionThresh) {
-	    return (info.type = EventInfo::FISSION_EVENT);
+	if (conditions & FISSION_ENERGY) {
+	    return EventInfo::FISSION_EVENT;
 	}
-	return (info.type = EventInfo::UNKNOWN_EVENT);
+	return EventInfo::UNKNOWN_EVENT;
     }
 
     // low energy events
-    if (info.pileUp && !enoughMcp) {
-	return (info.type = EventInfo::DECAY_EVENT);
+    if (pileUp && !enoughMcp) {
+	return EventInfo::DECAY_EVENT;
+    }
+    if (!pileUp && !enoughMcp && !hasTof) {
+	return EventInfo::DECAY_EVENT;
     }
-    if (!info.pileUp && !enoughMcp && !info.hasTof) {
-	return (info.type = EventInfo::DECAY_EVENT);
+    if (beamOn && (hasTof || enoughMcp) )
+	return EventInfo::PROJECTILE_EVENT;
+
+    return EventInfo::UNKNOWN_EVENT;
+}
+
+void ImplantSsdProcessor::UpdateStrip(const EventInfo &info, unsigned int loc)
+{
+    using namespace dammIds::implantSsd;
+
+    if (loc >= stripImplantTime_.size()) {
+        stripImplantTime_.resize(loc + 1, NAN);
+        stripImplantEnergy_.resize(loc + 1, 0);
+        stripVetoed_.resize(loc + 1, false);
     }
-    if (info.beamOn && (info.hasTof || enoughMcp) )
-	return (info.type = EventInfo::PROJECTILE_EVENT);
 
-    return (info.type = EventInfo::UNKNOWN_EVENT);
+    switch (info.type) {
+	case EventInfo::IMPLANT_EVENT:
+	    stripImplantTime_[loc] = info.time;
+	    stripImplantEnergy_[loc] = info.energy;
+	    break;
+	case EventInfo::ALPHA_EVENT:
+	case EventInfo::DECAY_EVENT:
+	    if (!stripVetoed_[loc] && !isnan(stripImplantTime_[loc])) {
+		double dt = (info.time - stripImplantTime_[loc]) *
+		    Globals::get()->clockInSeconds();
+		plot(DD_DECAY_ENERGY__STRIP_TIME, info.energy, dt / 1e-3);
+	    }
+	    break;
+	default:
+	    break;
+    }
+    stripVetoed_[loc] = (info.type == EventInfo::PROTON_EVENT);
 }
 
 void ImplantSsdProcessor::PlotType(EventInfo &info, int loc, Correlator::EConditions cond)
@@ -5,6 +5,7 @@
 
 #include <cmath>
 
+#include "ColumnWriter.hpp"
 #include "DammPlotIds.hpp"
 #include "Globals.hpp"
 #include "RawEvent.hpp"
@@ -33,6 +34,8 @@ namespace dammIds {
 IonChamberProcessor::IonChamberProcessor() :
     EventProcessor(OFFSET, RANGE, "IonChamberProcessor") {
     associatedTypes.insert("ion_chamber");
+    DeclareAccess({}, {});
+    DeclareTraceFields({});
 
     for (size_t i=0; i < noDets; i++) {
       lastTime[i] = -1;
@@ -171,6 +174,20 @@ void IonChamberProcessor::Data::Clear(void) {
   mult = 0;
 }
 
+bool IonChamberProcessor::AddColumns(ColumnWriter &writer)
+{
+  writer.AddColumn(name + ".raw", data.raw, noDets);
+  writer.AddColumn(name + ".cal", data.cal, noDets);
+  writer.AddColumn(name + ".mult", &data.mult);
+  return true;
+}
+
+void IonChamberProcessor::FillColumns(void)
+{
+  if (!HasEvent())
+    data.Clear();
+}
+
 #ifdef useroot
 bool IonChamberProcessor::AddBranch(TTree *tree)
 {
@@ -30,12 +30,23 @@ namespace dammIds {
         const int DD_NEVSDISCRIM      = 8;//!< Neutron Energy vs. Discrimination
         const int DD_TQDCVSLIQTOF     = 10;//!< QDC vs Liquid ToF
         const int DD_TQDCVSENERGY     = 12;//!< QDC vs. Energy
+        const int DD_TOFNEUTRON       = 14;//!< ToF of the neutron banana
+        const int DD_TOFGAMMA         = 15;//!< ToF outside the neutron banana
     }
 }
 
 LiquidScintProcessor::LiquidScintProcessor() :
-    EventProcessor(OFFSET, RANGE, "LiquidScintProcessor") {
+    EventProcessor(OFFSET, RANGE, "LiquidScintProcessor"), counter(0),
+    neutronBanana_(0) {
     associatedTypes.insert("liquid_scint");
+    DeclareAccess({}, {});
+}
+
+LiquidScintProcessor::LiquidScintProcessor(const int &neutronBanana) :
+    EventProcessor(OFFSET, RANGE, "LiquidScintProcessor"), counter(0),
+    neutronBanana_(neutronBanana) {
+    associatedTypes.insert("liquid_scint");
+    DeclareAccess({}, {});
 }
 
 void LiquidScintProcessor::DeclarePlots(void) {
@@ -57,6 +68,15 @@ void LiquidScintProcessor::DeclarePlots(void) {
     // 	DeclareHistogram2D(DD_TQDCVSLIQTOF+i, SC, SE, "Trace QDC vs. Liquid TOF");
     // 	DeclareHistogram2D(DD_TQDCVSENERGY+i, SD, SE, "Trace QDC vs. Energy");
     // }
+
+    //The discrimination is cheap now that the sums of the WaveformAnalyzer
+    // are vectorized, so it is always plotted
+    DeclareHistogram2D(DD_DISCRIM, SA, S3, "N-Gamma Discrimination");
+    DeclareHistogram2D(DD_TQDCVSDISCRIM, SA, SE, "Trace QDC vs. NG Discrim");
+    if (neutronBanana_ != 0) {
+        DeclareHistogram2D(DD_TOFNEUTRON, SE, S3, "Liquid vs. TOF, neutrons");
+        DeclareHistogram2D(DD_TOFGAMMA, SE, S3, "Liquid vs. TOF, gammas");
+    }
 }
 
 bool LiquidScintProcessor::PreProcess(RawEvent &event) {
@@ -122,6 +142,11 @@ bool LiquidScintProcessor::Process(RawEvent &event) {
             if((*itLiquid)->GetChanID().HasTag("start"))
                 continue;
 
+            bool isNeutron = neutronBanana_ != 0 &&
+                histo.BananaTest(neutronBanana_,
+                                 discrimNorm*discRes+discOffset,
+                                 liquid.GetTraceQdc());
+
             for(vector<ChanEvent*>::iterator itStart = startEvents.begin();
             itStart != startEvents.end(); itStart++) {
                 unsigned int startLoc = (*itStart)->GetChanID().GetLocation();
@@ -140,6 +165,9 @@ bool LiquidScintProcessor::Process(RawEvent &event) {
                         discrimNorm*discRes+discOffset, TOF*resMult+resOffset);
                     plot(DD_TQDCVSLIQTOF+histLoc, TOF*resMult+resOffset,
                         liquid.GetTraceQdc());
+                    if(neutronBanana_ != 0)
+                        plot(isNeutron ? DD_TOFNEUTRON : DD_TOFGAMMA,
+                             TOF*resMult+resOffset, histLoc);
                 }
             }
         }
@@ -337,7 +337,7 @@ bool LitePositionProcessor::Process(RawEvent &event)
 	    if (i == whichQdc) {
 		position = posScale * (frac - minNormQdc[location]) /
 		    (maxNormQdc[location] - minNormQdc[location]);
-		sumchan->GetTrace().InsertValue("position", position);
+		sumchan->GetTrace().InsertValue(Trace::POSITION, position);
 		// plot(DD_POSITION, location, position);
 		plot(DD_POSITION__ENERGY_LOCX + location, position, sumchan->GetCalEnergy());
 		plot(DD_POSITION__ENERGY_LOCX + LOC_SUM, position, sumchan->GetCalEnergy());
@@ -348,9 +348,9 @@ bool LitePositionProcessor::Process(RawEvent &event)
 
 		// MAGIC NUMBERS HERE, move to qdc.txt
 		if (qdcSum < 1000 && sumchan->GetCalEnergy() > 15000) {
-		    sumchan->GetTrace().InsertValue("badqdc", 1);
+		    sumchan->GetTrace().InsertValue(Trace::BAD_QDC, 1);
 		} else {
-		  plot(DD_POSITION, location, sumchan->GetTrace().GetValue("position"));
+		  plot(DD_POSITION, location, sumchan->GetTrace().GetValue(Trace::POSITION));
 		}
 		plot(DD_QDCSUM__ENERGY_LOCX + location, qdcSum, sumchan->GetCalEnergy() / 10);
 		plot(DD_QDCSUM__ENERGY_LOCX + LOC_SUM , qdcSum, sumchan->GetCalEnergy() / 10);
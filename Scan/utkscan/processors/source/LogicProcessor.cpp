@@ -61,20 +61,24 @@ namespace dammIds {
 LogicProcessor::LogicProcessor(void) :
     EventProcessor(dammIds::logic::OFFSET, dammIds::logic::RANGE, "LogicProcessor"),
     lastStartTime(MAX_LOGIC, NAN), lastStopTime(MAX_LOGIC, NAN),
-    logicStatus(MAX_LOGIC), stopCount(MAX_LOGIC), startCount(MAX_LOGIC) {
+    logicStatus(MAX_LOGIC), stopCount(MAX_LOGIC), startCount(MAX_LOGIC),
+    levels_(MAX_LOGIC) {
     associatedTypes.insert("logic");
     associatedTypes.insert("timeclass"); // old detector type
     associatedTypes.insert("mtc");
+    DeclareAccess({"logic_*"}, {"Beam", "Cycle", "Supercycle", "TapeMove"});
 }
 
 LogicProcessor::LogicProcessor(int offset, int range, bool doubleStop/*=false*/,
 			       bool doubleStart/*=false*/) :
     EventProcessor(offset, range, "LogicProcessor"),
     lastStartTime(MAX_LOGIC, NAN), lastStopTime(MAX_LOGIC, NAN),
-    logicStatus(MAX_LOGIC), stopCount(MAX_LOGIC), startCount(MAX_LOGIC) {
+    logicStatus(MAX_LOGIC), stopCount(MAX_LOGIC), startCount(MAX_LOGIC),
+    levels_(MAX_LOGIC) {
     associatedTypes.insert("logic");
     associatedTypes.insert("timeclass"); // old detector type
     associatedTypes.insert("mtc");
+    DeclareAccess({"logic_*"}, {"Beam", "Cycle", "Supercycle", "TapeMove"});
 
     doubleStop_ = doubleStop;
     doubleStart_ = doubleStart;
@@ -158,6 +162,7 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
 
 	    lastStartTime.at(loc) = time;
 	    logicStatus.at(loc) = true;
+	    levels_.at(loc).Set(time, true);
 
 	    startCount.at(loc)++;
 	    plot(D_COUNTER_START, loc);
@@ -174,14 +179,15 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
 
             lastStopTime.at(loc) = time;
             logicStatus.at(loc) = false;
+            levels_.at(loc).Set(time, false);
 
             stopCount.at(loc)++;
             plot(D_COUNTER_STOP, loc);
         } else if(place == "logic_mtc_start_0") {
 	    double dt_start = time -
 		TreeCorrelator::get()->place(place)->secondlast().time;
-	    TreeCorrelator::get()->place("TapeMove")->activate(time);
-	    TreeCorrelator::get()->place("Cycle")->deactivate(time);
+	    SetPlace("TapeMove", time, true);
+	    SetPlace("Cycle", time, false);
 
 	    plot(D_TDIFF_MOVE_START, dt_start / mtcPlotResolution);
 	    plot(D_COUNTER, MOVE_START_BIN);
@@ -191,7 +197,7 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
 		TreeCorrelator::get()->place(place)->secondlast().time;
 	    double dt_move = time -
 		TreeCorrelator::get()->place("logic_mtc_start_0")->last().time;
-	    TreeCorrelator::get()->place("TapeMove")->deactivate(time);
+	    SetPlace("TapeMove", time, false);
 
 	    plot(D_TDIFF_MOVE_STOP, dt_stop / mtcPlotResolution);
 	    plot(D_MOVETIME, dt_move / mtcPlotResolution);
@@ -209,8 +215,8 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
 		    abs(dt_stop * clockInSeconds) < doubleTimeLimit_)
 		    continue;
 	    }
-	    TreeCorrelator::get()->place("Beam")->activate(time);
-	    TreeCorrelator::get()->place("Cycle")->activate(time);
+	    SetPlace("Beam", time, true);
+	    SetPlace("Cycle", time, true);
 
 	    plot(D_TDIFF_BEAM_START, dt_start / mtcPlotResolution);
 	    plot(D_COUNTER, BEAM_START_BIN);
@@ -226,7 +232,7 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
 		    abs(dt_beam * clockInSeconds) < doubleTimeLimit_)
 		    continue;
 	    }
-	    TreeCorrelator::get()->place("Beam")->deactivate(time);
+	    SetPlace("Beam", time, false);
 
 	    plot(D_TDIFF_BEAM_STOP, dt_stop / mtcPlotResolution);
 	    plot(D_BEAMTIME, dt_beam / mtcPlotResolution);
@@ -251,8 +257,8 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
             stringstream ss;
             // Check for double recorded same event (1 us limit)
             if (dt_beam_stop < doubleTimeLimit_) {
-                ss << "Ignore fast beam stop" << endl;
-                m.warning(ss.str());
+                static LogSite fastStopSite("LogicProcessor: Fast beam stop");
+                m.warningf(fastStopSite, "Ignore fast beam stop");
                 continue;
             }
 
@@ -263,13 +269,13 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
 
                 plot(D_TIME_STOP_LENGTH, dt_beam_stop / resolution);
 
-                TreeCorrelator::get()->place("Beam")->activate(time);
+                SetPlace("Beam", time, true);
                 ss << "Beam started after: " << dt_beam_stop / resolution
                    << " s ";
                 m.run_message(ss.str());
             }
             else {
-                TreeCorrelator::get()->place("Beam")->deactivate(time);
+                SetPlace("Beam", time, false);
                 ss << "Beam stopped";
                 m.run_message(ss.str());
             }
@@ -286,6 +292,20 @@ bool LogicProcessor::PreProcess(RawEvent &event) {
     return(true);
 }
 
+void LogicProcessor::SetPlace(const string &place, double time, bool state) {
+    if (state)
+        TreeCorrelator::get()->place(place)->activate(time);
+    else
+        TreeCorrelator::get()->place(place)->deactivate(time);
+    timelines_[place].Set(time, state);
+}
+
+const LogicTimeline &LogicProcessor::GetTimeline(const string &place) const {
+    static const LogicTimeline empty;
+    map<string, LogicTimeline>::const_iterator it = timelines_.find(place);
+    return it == timelines_.end() ? empty : it->second;
+}
+
 bool LogicProcessor::Process(RawEvent &event) {
     if (!EventProcessor::Process(event))
         return(false);
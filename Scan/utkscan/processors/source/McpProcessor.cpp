@@ -39,6 +39,12 @@ void McpProcessor::McpData::Clear(void) {
 
 McpProcessor::McpProcessor(void) : EventProcessor(OFFSET, RANGE, "McpProcessor") {
   associatedTypes.insert("mcp");
+  DeclareAccess({}, {});
+
+  const char *corners[nPos] = {"1position1", "1position2", "1position3",
+                               "1position4"};
+  for (size_t i = 0; i < nPos; i++)
+    cornerIds[i] = Identifier::NameId(corners[i]);
 }
 
 void McpProcessor::DeclarePlots(void) {
@@ -65,23 +71,14 @@ bool McpProcessor::Process(RawEvent &event) {
        it != mcpEvents.end(); it++) {
       ChanEvent *chan = *it;
 
-      string subtype   = chan->GetChanID().GetSubtype();
+      // the hits of the other subtypes (e.g. 1time) are not corners
+      unsigned int subtype = chan->GetChanID().GetSubtypeId();
       double calEnergy = chan->GetCalEnergy();
-
-      if(subtype == "1time") {
-	  // do nothing
-      } else if (subtype == "1position1"){
-	  data.raw[0] = calEnergy;
-	  data.mult++;
-      } else if (subtype == "1position2"){
-	  data.raw[1] = calEnergy;
-	  data.mult++;
-      } else if (subtype == "1position3"){
-	  data.raw[2] = calEnergy;
-	  data.mult++;
-      } else if (subtype == "1position4"){
-	  data.raw[3] = calEnergy;
-	  data.mult++;
+      for (size_t i = 0; i < nPos; i++) {
+	  if (subtype == cornerIds[i]) {
+	      data.raw[i] = calEnergy;
+	      data.mult++;
+	  }
       }
   }
 
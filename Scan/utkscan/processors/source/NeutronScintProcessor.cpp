@@ -31,6 +31,7 @@ namespace dammIds {
 NeutronScintProcessor::NeutronScintProcessor() :
     EventProcessor(OFFSET, RANGE, "NeutronScintProcessor") {
     associatedTypes.insert("neutron_scint");
+    DeclareAccess({"Beta", "Gamma", "GammaBeta"}, {});
 }
 
 void NeutronScintProcessor::DeclarePlots(void) {
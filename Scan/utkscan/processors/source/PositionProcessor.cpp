@@ -5,7 +5,6 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <numeric>
 #include <sstream>
 #include <vector>
 
@@ -55,6 +54,7 @@ using namespace dammIds::position;
 PositionProcessor::PositionProcessor() :
     EventProcessor(OFFSET, RANGE, "PositionProcessor") {
     associatedTypes.insert("ssd");
+    DeclareAccess({}, {});
 }
 
 bool PositionProcessor::Init(RawEvent& rawev)
@@ -109,11 +109,10 @@ bool PositionProcessor::Init(RawEvent& rawev)
 
     for (int i=0; i < numQdcs; i++)
         in >> qdcLen[i];
-    partial_sum(qdcLen, qdcLen + numQdcs, qdcPos);
-    totLen = qdcPos[numQdcs - 1]  - qdcLen[0];
-    // totLen = accumulate(qdcLen + 1, qdcLen + 8, 0);
+    positions.SetWindows(qdcLen);
 
     in >> whichQdc >> posScale;
+    positions.SetPosition(whichQdc, posScale);
 
     int numLocationsRead = 0;
     while (true) {
@@ -242,6 +241,9 @@ bool PositionProcessor::Process(RawEvent &event) {
     static const vector<ChanEvent*> &bottomEvents =
 	event.GetSummary("ssd:bottom", true)->GetList();
 
+    positions.Clear();
+    stripSums.clear();
+
     vector<ChanEvent *> allEvents;
     // just add in the digisum events for now
     allEvents.insert(allEvents.begin(), digisumEvents.begin(), digisumEvents.end());
@@ -301,98 +303,63 @@ bool PositionProcessor::Process(RawEvent &event) {
 
         using namespace dammIds::position;
 
-        float topQdc[numQdcs];
-        float bottomQdc[numQdcs];
-        float topQdcTot = 0;
-        float bottomQdcTot = 0;
-        float position = NAN;
-
-        topQdc[0] = top->GetQdcValue(0);
-        bottomQdc[0] = bottom->GetQdcValue(0);
-        if (bottomQdc[0] == pixie::U_DELIMITER || topQdc[0] == pixie::U_DELIMITER) {
+        if (top->GetQdcValue(0) == pixie::U_DELIMITER) {
             // This happens naturally for traces which have double triggers
             //   Onboard DSP does not write QDCs in this case
-#ifdef VERBOSE
-            cout << "SSD strip edges are missing QDC information for location " << location << endl;
-#endif
-            if (topQdc[0] == pixie::U_DELIMITER) {
-                // [2] -> Missing top QDC
-                plot(D_INFO_LOCX + location, INFO_MISSING_TOP_QDC);
-                plot(D_INFO_LOCX + LOC_SUM, INFO_MISSING_TOP_QDC);
-                // Recreate qdc from trace
-                if ( !top->GetTrace().empty() ) {
-                    topQdc[0] = accumulate(top->GetTrace().begin(), top->GetTrace().begin() + qdcLen[0], 0);
-                } else {
-                    topQdc[0] = 0;
-                }
-            }
-            if (bottomQdc[0] == pixie::U_DELIMITER) {
-                // [1] -> Missing bottom QDC
-                plot(D_INFO_LOCX + location, INFO_MISSING_BOTTOM_QDC);
-                plot(D_INFO_LOCX + LOC_SUM, INFO_MISSING_BOTTOM_QDC);
-                // Recreate qdc from trace
-                if ( !bottom->GetTrace().empty() ) {
-                    bottomQdc[0] = accumulate(bottom->GetTrace().begin(), bottom->GetTrace().begin() + qdcLen[0], 0);
-                } else {
-                    bottomQdc[0] = 0;
-                }
-            }
-            if ( topQdc[0] == 0 || bottomQdc[0] == 0 ) {
-                continue;
-            }
+            // [2] -> Missing top QDC
+            plot(D_INFO_LOCX + location, INFO_MISSING_TOP_QDC);
+            plot(D_INFO_LOCX + LOC_SUM, INFO_MISSING_TOP_QDC);
+        }
+        if (bottom->GetQdcValue(0) == pixie::U_DELIMITER) {
+            // [1] -> Missing bottom QDC
+            plot(D_INFO_LOCX + location, INFO_MISSING_BOTTOM_QDC);
+            plot(D_INFO_LOCX + LOC_SUM, INFO_MISSING_BOTTOM_QDC);
         }
+        // The QDCs missing are recreated from the traces
+        if (!positions.Add(*top, *bottom, minNormQdc[location],
+                           maxNormQdc[location]))
+            continue;
+        stripSums.push_back(sumchan);
+
         // [0] -> good stuff
         plot(D_INFO_LOCX + location, INFO_OKAY);
         plot(D_INFO_LOCX + LOC_SUM, INFO_OKAY);
+    } // end iteration over sum events
 
+    positions.Compute();
 
-        for (int i = 1; i < numQdcs; ++i) {
-            if (top->GetQdcValue(i) == pixie::U_DELIMITER) {
-                // Recreate qdc from trace
-                topQdc[i] = accumulate(top->GetTrace().begin() + qdcPos[i-1],
-                top->GetTrace().begin() + qdcPos[i], 0);
-            } else {
-                topQdc[i] = top->GetQdcValue(i);
-            }
-
-            topQdc[i] -= topQdc[0] * qdcLen[i] / qdcLen[0];
-            topQdcTot += topQdc[i];
-            topQdc[i] /= qdcLen[i];
+    for (size_t strip = 0; strip < stripSums.size(); ++strip) {
+        using namespace dammIds::position;
 
-            if (bottom->GetQdcValue(i) == pixie::U_DELIMITER) {
-                // Recreate qdc from trace
-                bottomQdc[i] = accumulate(bottom->GetTrace().begin() + qdcPos[i-1],
-                                          bottom->GetTrace().begin() + qdcPos[i], 0);
-            } else {
-                bottomQdc[i] = bottom->GetQdcValue(i);
-            }
+        ChanEvent *sumchan = stripSums[strip];
+        int location = sumchan->GetChanID().GetLocation();
+        float position = positions.Position(strip);
 
-            bottomQdc[i] -= bottomQdc[0] * qdcLen[i] / qdcLen[0];
-            bottomQdcTot += bottomQdc[i];
-            bottomQdc[i] /= qdcLen[i];
+        for (int i = 1; i < numQdcs; ++i) {
+            float topQdc = positions.Top(i, strip);
+            float bottomQdc = positions.Bottom(i, strip);
 
-            plot(DD_QDCN__QDCN_LOCX + QDC_JUMP * i + location, topQdc[i] + 10, bottomQdc[i] + 10);
-            plot(DD_QDCN__QDCN_LOCX + QDC_JUMP * i + LOC_SUM, topQdc[i], bottomQdc[i]);
+            plot(DD_QDCN__QDCN_LOCX + QDC_JUMP * i + location, topQdc + 10, bottomQdc + 10);
+            plot(DD_QDCN__QDCN_LOCX + QDC_JUMP * i + LOC_SUM, topQdc, bottomQdc);
 
-            float frac = topQdc[i] / (topQdc[i] + bottomQdc[i]) * 1000.; // per mil
+            float frac = positions.Fraction(i, strip);
 
             plot(D_QDCNORMN_LOCX + QDC_JUMP * i + location, frac);
             plot(D_QDCNORMN_LOCX + QDC_JUMP * i + LOC_SUM, frac);
             if (i == whichQdc) {
-                position = posScale * (frac - minNormQdc[location]) /
-                    (maxNormQdc[location] - minNormQdc[location]);
-                sumchan->GetTrace().InsertValue("position", position);
+                sumchan->GetTrace().InsertValue(Trace::POSITION, position);
                 plot(DD_POSITION__ENERGY_LOCX + location, position, sumchan->GetCalEnergy());
                 plot(DD_POSITION__ENERGY_LOCX + LOC_SUM, position, sumchan->GetCalEnergy());
             }
             if (i == 6 && !sumchan->IsSaturated()) {
                 // compare the long qdc to the energy
-                int qdcSum = topQdc[i] + bottomQdc[i];
+                int qdcSum = topQdc + bottomQdc;
 
                 // MAGIC NUMBERS HERE, move to qdc.txt
                 if (qdcSum < 1000 && sumchan->GetCalEnergy() > 15000) {
-                    sumchan->GetTrace().InsertValue("badqdc", 1);
-                } else if ( !isnan(position) ) {
+                    sumchan->GetTrace().InsertValue(Trace::BAD_QDC, 1);
+                } else if ( i >= whichQdc && !isnan(position) ) {
+                    // as long as the position comes from one of the first QDCs
                     plot(DD_POSITION, location, position);
                 }
             }
@@ -400,7 +367,8 @@ bool PositionProcessor::Process(RawEvent &event) {
         // KM QDC - QDC correlations
         double ratio[4] = {0};
         for (int i = 1; i < 5; ++i) {
-                ratio[i - 1] = topQdc[i] / (bottomQdc[i] + topQdc[i]) * 1000.0;
+                ratio[i - 1] = positions.Top(i, strip) /
+                    (positions.Bottom(i, strip) + positions.Top(i, strip)) * 1000.0;
         }
 
         plot(DD_QDCR2__QDCR1_LOCX + location, ratio[1], ratio[0]);
@@ -412,12 +380,11 @@ bool PositionProcessor::Process(RawEvent &event) {
         plot(DD_QDC3R__POS_LOCX + location, ratio[2], position * 10.0 + 200.0);
         plot(DD_QDC4R__POS_LOCX + location, ratio[3], position * 10.0 + 200.0);
 
-        topQdcTot    /= totLen;
-        bottomQdcTot /= totLen;
-
-        plot(DD_QDCTOT__QDCTOT_LOCX + location, topQdcTot, bottomQdcTot);
-        plot(DD_QDCTOT__QDCTOT_LOCX + LOC_SUM, topQdcTot, bottomQdcTot);
-    } // end iteration over sum events
+        plot(DD_QDCTOT__QDCTOT_LOCX + location, positions.TopTotal(strip),
+             positions.BottomTotal(strip));
+        plot(DD_QDCTOT__QDCTOT_LOCX + LOC_SUM, positions.TopTotal(strip),
+             positions.BottomTotal(strip));
+    } // end iteration over strips
 
     EndProcess();
 
@@ -48,6 +48,8 @@ namespace dammIds{
         const int D_QDC_TRACED=24; //!<Trace  qdc dynode
         
         const int DD_ESLEW=30; //!<ESLEW
+        const int D_PIXEL1=31; //!< pixel index of position 1
+        const int DD_PIXEL1_DYNODE=32; //!< dynode energy vs pixel 1
         
         const int D_TEMP0=80; //!< temp 0
         const int D_TEMP1=81; //!<temp 1
@@ -66,10 +68,46 @@ void PspmtProcessor::PspmtData::Clear(void) {
 
 PspmtProcessor::PspmtProcessor(void) : EventProcessor(OFFSET, RANGE, "PspmtProcessor") {
     associatedTypes.insert("pspmt");
+    DeclareAccess({}, {});
+    DeclareTraceFields({"baseline", "filterEnergy", "qdc"});
+    usePositionMap_ = false;
+    // tentatively fixed params //
+    threshold_ = 260;
+    slope_ = 0.0606;
+    intercept_ = 10.13;
+}
+
+PspmtProcessor::PspmtProcessor(const bool &usePositionMap) :
+    EventProcessor(OFFSET, RANGE, "PspmtProcessor") {
+    associatedTypes.insert("pspmt");
+    DeclareAccess({}, {});
+    DeclareTraceFields({"baseline", "filterEnergy", "qdc"});
+    usePositionMap_ = usePositionMap;
+    threshold_ = 260;
+    slope_ = 0.0606;
+    intercept_ = 10.13;
+    if(usePositionMap_)
+        BuildPositionMap();
+}
+
+void PspmtProcessor::BuildPositionMap(void) {
+    //The pixel along one axis of each raw position bin, from its center
+    vector<int> pixels(rawScale_);
+    for(int bin = 0; bin < rawScale_; bin++) {
+        pixels[bin] = (int)trunc(slope_*(bin + 0.5 + rawOffset_) - intercept_);
+        if(pixels[bin] < 0 || pixels[bin] >= posBins_)
+            pixels[bin] = -1;
+    }
+
+    positionMap_.assign(rawScale_*rawScale_, -1);
+    for(int x = 0; x < rawScale_; x++)
+        for(int y = 0; y < rawScale_; y++)
+            if(pixels[x] >= 0 && pixels[y] >= 0)
+                positionMap_[x*rawScale_ + y] = pixels[x]*posBins_ + pixels[y];
 }
 
 void PspmtProcessor::DeclarePlots(void) {
-    const int posBins      = 32; 
+    const int posBins      = posBins_;
     const int energyBins   = 8192;
     const int traceBins    = 128;
     const int traceBins2   = 512;
@@ -86,6 +124,11 @@ void PspmtProcessor::DeclarePlots(void) {
     DeclareHistogram2D(DD_POS2_RAW, Bins, Bins, "Pspmt Pos2 Raw");
     DeclareHistogram2D(DD_POS1, posBins, posBins, "Pspmt Pos1");
     DeclareHistogram2D(DD_POS2, posBins, posBins, "Pspmt Pos2");
+    if(usePositionMap_) {
+        DeclareHistogram1D(D_PIXEL1, posBins*posBins, "Pspmt Pixel1");
+        DeclareHistogram2D(DD_PIXEL1_DYNODE, energyBins, posBins*posBins,
+                           "Dynode vs Pixel1");
+    }
     
     // From QDC and traces 
     // 710-
@@ -150,11 +193,9 @@ bool PspmtProcessor::PreProcess(RawEvent &event){
     double pxright=0,pxleft=0,pytop=0,pybottom=0;
     double pxtre_r=0,pxtre_l=0,pytre_t=0,pytre_b=0;
     
-    // tentatively local params //
-    double threshold=260;
-    double slope=0.0606;
-    double intercept=10.13;
-    //////////////////////////////
+    const double threshold=threshold_;
+    const double slope=slope_;
+    const double intercept=intercept_;
     static int traceNum;
     
     double f=0.1;
@@ -163,24 +204,23 @@ bool PspmtProcessor::PreProcess(RawEvent &event){
          it != pspmtEvents.end(); it++) {
         
         ChanEvent *chan   = *it;
-        string subtype    = chan->GetChanID().GetSubtype();
         int    ch         = chan->GetChanID().GetLocation();
         double calEnergy  = chan->GetCalEnergy();
         //double pspmtTime  = chan->GetTime();
-        Trace trace       = chan->GetTrace();
+        const Trace &trace = chan->GetTrace();
         
         double trace_energy;
         //double trace_time;
         double baseline;
         double qdc;
-        //int    num        = trace.GetValue("numPulses");
+        //int    num        = trace.GetValue(Trace::NUM_PULSES);
         
-        if(trace.HasValue("filterEnergy")){
+        if(trace.HasValue(Trace::FILTER_ENERGY)){
             traceNum++;   	  
-            //trace_time      = trace.GetValue("filterTime");
-            trace_energy  = trace.GetValue("filterEnergy");
-            baseline         = trace.GetValue("baseline");
-            qdc                 = trace.GetValue("qdc");
+            //trace_time      = trace.GetValue(Trace::FILTER_TIME);
+            trace_energy  = trace.GetValue(Trace::FILTER_ENERGY);
+            baseline         = trace.GetValue(Trace::BASELINE);
+            qdc                 = trace.GetValue(Trace::QDC);
             
             if(ch==0){
                 qdc1 = qdc;
@@ -234,10 +274,11 @@ bool PspmtProcessor::PreProcess(RawEvent &event){
             qright  = (q4+q1)/2;
             
             qsum    = (q1+q2+q3+q4)/2;
-            xright  = (qright/qsum)*512+100;
-            xleft   = (qleft/qsum)*512+100;
-            ytop    = (qtop/qsum)*512+100;
-            ybottom = (qbottom/qsum)*512+100;
+            double scale = rawScale_/qsum;
+            xright  = qright*scale+rawOffset_;
+            xleft   = qleft*scale+rawOffset_;
+            ytop    = qtop*scale+rawOffset_;
+            ybottom = qbottom*scale+rawOffset_;
             plot(D_SUM,qsum);
         }
         
@@ -248,15 +289,21 @@ bool PspmtProcessor::PreProcess(RawEvent &event){
             qtre_r=(tre4+tre1)/2;
             qtre_s=(tre1+tre2+tre3+tre4)/2;
             
-            xtre_r=(qtre_r/qtre_s)*512+100;
-            xtre_l=(qtre_l/qtre_s)*512+100;
-            ytre_t=(qtre_t/qtre_s)*512+100;
-            ytre_b=(qtre_b/qtre_s)*512+100;
+            double scale=rawScale_/qtre_s;
+            xtre_r=qtre_r*scale+rawOffset_;
+            xtre_l=qtre_l*scale+rawOffset_;
+            ytre_t=qtre_t*scale+rawOffset_;
+            ytre_b=qtre_b*scale+rawOffset_;
             
-            pxtre_r = trunc(slope*xtre_l-intercept);
-            pxtre_l = trunc(slope*xtre_r-intercept);
-            pytre_t = trunc(slope*ytre_t-intercept);
-            pytre_b = trunc(slope*ytre_b-intercept);
+            if(usePositionMap_) {
+                SplitPixel(GetPixel(xtre_l,ytre_t),pxtre_r,pytre_t);
+                SplitPixel(GetPixel(xtre_r,ytre_b),pxtre_l,pytre_b);
+            } else {
+                pxtre_r = trunc(slope*xtre_l-intercept);
+                pxtre_l = trunc(slope*xtre_r-intercept);
+                pytre_t = trunc(slope*ytre_t-intercept);
+                pytre_b = trunc(slope*ytre_b-intercept);
+            }
                         
             plot(D_ENERGY_TRACESUM,qtre_s);
             
@@ -284,10 +331,20 @@ bool PspmtProcessor::PreProcess(RawEvent &event){
         }
         
         if(q1>threshold && q2>threshold && q3>threshold && q4>threshold ){
-            pxleft   = trunc(slope*xleft-intercept);
-            pxright  = trunc(slope*xright-intercept);
-            pytop    = trunc(slope*ytop-intercept);
-            pybottom = trunc(slope*ybottom-intercept);
+            if(usePositionMap_) {
+                int pixel1 = GetPixel(xright,ytop);
+                SplitPixel(pixel1,pxright,pytop);
+                SplitPixel(GetPixel(xleft,ybottom),pxleft,pybottom);
+                if(pixel1 >= 0) {
+                    plot(D_PIXEL1,pixel1);
+                    plot(DD_PIXEL1_DYNODE,qd,pixel1);
+                }
+            } else {
+                pxleft   = trunc(slope*xleft-intercept);
+                pxright  = trunc(slope*xright-intercept);
+                pytop    = trunc(slope*ytop-intercept);
+                pybottom = trunc(slope*ybottom-intercept);
+            }
             
             plot(DD_POS1_RAW,xright,ytop);
             plot(DD_POS2_RAW,xleft,ybottom);
@@ -302,7 +359,7 @@ bool PspmtProcessor::PreProcess(RawEvent &event){
                 plot(D_TEMP4,f*qd);
             }
             
-            for(vector<int>::iterator ittr = trace.begin();ittr != trace.end();ittr++)
+            for(Trace::const_iterator ittr = trace.begin();ittr != trace.end();ittr++)
                 plot(DD_SINGLE_TRACE,ittr-trace.begin(),traceNum,*ittr);
         }
     } // end of channel event
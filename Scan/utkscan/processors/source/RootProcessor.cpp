@@ -7,8 +7,13 @@
 #ifdef useroot
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 
+#include <TBranch.h>
+#include <TLeaf.h>
+#include <TObjArray.h>
+#include <TROOT.h>
 #include <TTree.h>
 
 #include "DetectorDriver.hpp"
@@ -18,10 +23,21 @@ using std::cout;
 using std::endl;
 
 /** Open a file for tree output */
-RootProcessor::RootProcessor(const char *fileName, const char *treeName)
+RootProcessor::RootProcessor(const char *fileName, const char *treeName,
+                             const unsigned int &batchSize,
+                             const unsigned int &imtThreads)
     : EventProcessor()
 {
     name = "RootProcessor";
+    batchSize_ = batchSize;
+    queueDepth_ = 4;
+    eventBytes_ = 0;
+    batchEvents_ = 0;
+    stop_ = false;
+#ifdef R__USE_IMT
+    if (imtThreads > 0)
+        ROOT::EnableImplicitMT(imtThreads);
+#endif
     file = new TFile(fileName, "recreate"); //! overwrite tree for now
     tree = new TTree(treeName, treeName);
 }
@@ -47,9 +63,119 @@ bool RootProcessor::Init(RawEvent& rawev)
             inserter(associatedTypes, associatedTypes.begin()) );
         }
     }
+    if (batchSize_ > 0 && !StartWriter())
+        batchSize_ = 0;
     return EventProcessor::Init(rawev);
 }
 
+/** Bind the branches to staging buffers and start the writer thread */
+bool RootProcessor::StartWriter(void)
+{
+    TObjArray *list = tree->GetListOfBranches();
+    for (int i = 0; i < list->GetEntriesFast(); i++) {
+        TBranch *branch = (TBranch*)list->At(i);
+        if (branch->IsA() != TBranch::Class() || branch->GetAddress() == NULL
+            || branch->GetListOfBranches()->GetEntriesFast() != 0) {
+            cout << "RootProcessor: the branch " << branch->GetName()
+                 << " cannot be copied, filling the tree without a writer"
+                 << " thread" << endl;
+            branches_.clear();
+            return false;
+        }
+
+        CopiedBranch copied;
+        copied.source = branch->GetAddress();
+        copied.size = 0;
+        TObjArray *leaves = branch->GetListOfLeaves();
+        for (int j = 0; j < leaves->GetEntriesFast(); j++) {
+            TLeaf *leaf = (TLeaf*)leaves->At(j);
+            if (leaf->GetLeafCount() != NULL) {
+                cout << "RootProcessor: the branch " << branch->GetName()
+                     << " has a variable size, filling the tree without a"
+                     << " writer thread" << endl;
+                branches_.clear();
+                return false;
+            }
+            copied.size = std::max(copied.size, (size_t)(leaf->GetOffset() +
+                leaf->GetLenStatic() * leaf->GetLenType()));
+        }
+        copied.offset = eventBytes_;
+        eventBytes_ += copied.size;
+        branches_.push_back(copied);
+    }
+
+    //The staging buffers stop moving once all branches have been added
+    for (size_t i = 0; i < branches_.size(); i++) {
+        branches_[i].staging.assign(branches_[i].size, 0);
+        memcpy(branches_[i].staging.data(), branches_[i].source,
+               branches_[i].size);
+        ((TBranch*)list->At(i))->SetAddress(branches_[i].staging.data());
+    }
+
+    ROOT::EnableThreadSafety();
+    batch_.reserve(eventBytes_ * batchSize_);
+    writer_ = std::thread(&RootProcessor::WriteBatches, this);
+    return true;
+}
+
+/** Fill the tree from the queued batches until stopped */
+void RootProcessor::WriteBatches(void)
+{
+    vector<char> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueReady_.wait(lock, [this]{return !queue_.empty() || stop_;});
+            if (queue_.empty())
+                return;
+            batch.swap(queue_.front());
+            queue_.pop_front();
+        }
+        queueSpace_.notify_one();
+
+        for (size_t pos = 0; pos + eventBytes_ <= batch.size();
+             pos += eventBytes_) {
+            for (vector<CopiedBranch>::iterator it = branches_.begin();
+                 it != branches_.end(); it++)
+                memcpy(it->staging.data(), &batch[pos + it->offset], it->size);
+            FillTree();
+        }
+
+        batch.clear();
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        spare_.push_back(vector<char>());
+        spare_.back().swap(batch);
+    }
+}
+
+/** Hand the batch being filled to the writer */
+void RootProcessor::QueueBatch(void)
+{
+    if (batchEvents_ == 0)
+        return;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex_);
+        queueSpace_.wait(lock, [this]{return queue_.size() < queueDepth_;});
+        queue_.push_back(vector<char>());
+        queue_.back().swap(batch_);
+        if (!spare_.empty()) {
+            batch_.swap(spare_.front());
+            spare_.pop_front();
+        }
+    }
+    queueReady_.notify_one();
+    batchEvents_ = 0;
+}
+
+/** Fill the tree and save it occasionally */
+void RootProcessor::FillTree(void)
+{
+    tree->Fill();
+    if (tree->GetEntries() % 1000 == 0) {
+	tree->AutoSave();
+    }
+}
+
 /** Fill the tree for each event, saving to file occasionally */
 bool RootProcessor::Process(RawEvent &event)
 {
@@ -61,9 +187,16 @@ bool RootProcessor::Process(RawEvent &event)
 	(*it)->FillBranch();
     }
 
-    tree->Fill();
-    if (tree->GetEntries() % 1000 == 0) {
-	tree->AutoSave();
+    if (batchSize_ == 0) {
+        FillTree();
+    } else {
+        size_t pos = batch_.size();
+        batch_.resize(pos + eventBytes_);
+        for (vector<CopiedBranch>::const_iterator it = branches_.begin();
+             it != branches_.end(); it++)
+            memcpy(&batch_[pos + it->offset], it->source, it->size);
+        if (++batchEvents_ >= batchSize_)
+            QueueBatch();
     }
 
     EndProcess();
@@ -73,6 +206,15 @@ bool RootProcessor::Process(RawEvent &event)
 /** Finish flushing the file to disk, and clean up memory */
 RootProcessor::~RootProcessor()
 {
+  if (writer_.joinable()) {
+    QueueBatch();
+    {
+      std::lock_guard<std::mutex> lock(queueMutex_);
+      stop_ = true;
+    }
+    queueReady_.notify_one();
+    writer_.join();
+  }
   if (tree != NULL) {
     cout << "  saving " << tree->GetEntries() << " tree entries" << endl;
     tree->AutoSave();
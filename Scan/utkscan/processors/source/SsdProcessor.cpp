@@ -23,6 +23,7 @@ namespace dammIds {
 
 SsdProcessor::SsdProcessor() : EventProcessor(OFFSET, RANGE, "SsdProcessor") {
     associatedTypes.insert("ssd");
+    DeclareAccess({}, {});
 }
 
 void SsdProcessor::DeclarePlots(void) {
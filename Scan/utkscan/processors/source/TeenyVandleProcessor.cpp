@@ -31,6 +31,7 @@ TeenyVandleProcessor::TeenyVandleProcessor():
     EventProcessor(dammIds::teenyvandle::OFFSET, dammIds::teenyvandle::RANGE,
                    "TeenyVandleProcessor") {
     associatedTypes.insert("tvandle");
+    DeclareAccess({}, {});
 }
 
 void TeenyVandleProcessor::DeclarePlots(void) {
@@ -23,11 +23,13 @@ using namespace dammIds::dettemplate;
 TemplateProcessor::TemplateProcessor():
     EventProcessor(OFFSET, RANGE, "TemplateProcessor") {
     associatedTypes.insert("template");
+    DeclareAccess({}, {});
 }
 
 TemplateProcessor::TemplateProcessor(const double &a):
     EventProcessor(OFFSET, RANGE, "TemplateProcessor") {
     associatedTypes.insert("template");
+    DeclareAccess({}, {});
     a_ = a;
 }
 
@@ -0,0 +1,141 @@
+/** \file TraceOutputProcessor.cpp
+ * \brief Implementation of the processor selecting the traces for output
+ */
+#include <iostream>
+
+#include <cmath>
+
+#include "DetectorSummary.hpp"
+#include "RawEvent.hpp"
+#include "TraceCompressor.hpp"
+#include "TraceOutputProcessor.hpp"
+
+#ifdef useroot
+#include <TTree.h>
+#endif
+
+using namespace std;
+
+TraceOutputProcessor::TraceOutputProcessor(const std::vector<Rule> &rules) :
+    EventProcessor(), rules_(rules) {
+    name = "TraceOutputProcessor";
+
+    bool useChiSq = false;
+    for (vector<Rule>::iterator it = rules_.begin(); it != rules_.end();
+         it++) {
+        associatedTypes.insert(it->type);
+        it->count = 0;
+        if (it->maxChiSq > 0)
+            useChiSq = true;
+    }
+
+    DeclareAccess({}, {});
+    if (useChiSq)
+        DeclareTraceFields({"chisqPerDof"});
+    else
+        DeclareTraceFields({});
+
+    seen_ = kept_ = samples_ = bytes_ = 0;
+}
+
+TraceOutputProcessor::~TraceOutputProcessor() {
+    cout << "  kept " << kept_ << " of " << seen_ << " traces";
+    if (samples_ > 0)
+        cout << " in " << bytes_ << " bytes, "
+             << 8.0 * bytes_ / samples_ << " bits per sample";
+    cout << endl;
+}
+
+bool TraceOutputProcessor::Process(RawEvent &event) {
+    if (!EventProcessor::Process(event))
+        return(false);
+
+    Clear();
+
+    for (set<string>::const_iterator type = associatedTypes.begin();
+         type != associatedTypes.end(); type++) {
+        const vector<ChanEvent*> &chans = sumMap[*type]->GetList();
+        for (vector<ChanEvent*>::const_iterator it = chans.begin();
+             it != chans.end(); it++) {
+            const Trace &trace = (*it)->GetTrace();
+            if (trace.empty())
+                continue;
+
+            Rule *rule = FindRule(**it);
+            if (rule == NULL)
+                continue;
+            seen_++;
+            rule->count++;
+            if (!Keep(*rule, **it))
+                continue;
+
+            size_t pos = data_.size();
+            TraceCompressor::Encode(trace, data_);
+            id_.push_back((*it)->GetID());
+            length_.push_back(trace.size());
+            size_.push_back(data_.size() - pos);
+
+            kept_++;
+            samples_ += trace.size();
+            bytes_ += data_.size() - pos;
+        }
+    }
+
+    EndProcess();
+    return(true);
+}
+
+TraceOutputProcessor::Rule* TraceOutputProcessor::FindRule(
+        const ChanEvent &chan) {
+    const Identifier &id = chan.GetChanID();
+    for (vector<Rule>::iterator it = rules_.begin(); it != rules_.end();
+         it++) {
+        if (it->type == id.GetType() &&
+            (it->subtype.empty() || it->subtype == id.GetSubtype()))
+            return(&(*it));
+    }
+    return(NULL);
+}
+
+bool TraceOutputProcessor::Keep(const Rule &rule,
+                                const ChanEvent &chan) const {
+    if (rule.pileup && chan.IsPileup())
+        return(true);
+    if (rule.every > 0 && rule.count % rule.every == 0)
+        return(true);
+    if (rule.useEnergy) {
+        double energy = chan.GetCalEnergy();
+        if (energy >= rule.minEnergy && energy <= rule.maxEnergy)
+            return(true);
+    }
+    if (rule.maxChiSq > 0) {
+        double chiSq = chan.GetTrace().GetValue(Trace::CHISQ_PER_DOF);
+        if (!std::isnan(chiSq) && chiSq > rule.maxChiSq)
+            return(true);
+    }
+    return(false);
+}
+
+void TraceOutputProcessor::Clear(void) {
+    id_.clear();
+    length_.clear();
+    size_.clear();
+    data_.clear();
+}
+
+#ifdef useroot
+bool TraceOutputProcessor::AddBranch(TTree *tree) {
+    if (!tree)
+        return(false);
+
+    return(tree->Branch((name + ".id").c_str(), &id_) != NULL &&
+           tree->Branch((name + ".length").c_str(), &length_) != NULL &&
+           tree->Branch((name + ".size").c_str(), &size_) != NULL &&
+           tree->Branch((name + ".data").c_str(), &data_) != NULL);
+}
+
+void TraceOutputProcessor::FillBranch(void) {
+    if (!HasEvent())
+        Clear();
+}
+#endif //useroot
@@ -16,6 +16,7 @@
 #include "BarBuilder.hpp"
 #include "DammPlotIds.hpp"
 #include "DetectorDriver.hpp"
+#include "DetectorLibrary.hpp"
 #include "Globals.hpp"
 #include "RawEvent.hpp"
 #include "TimingMapBuilder.hpp"
@@ -52,6 +53,10 @@ using namespace dammIds::vandle;
 VandleProcessor::VandleProcessor():
     EventProcessor(OFFSET, RANGE, "VandleProcessor") {
     associatedTypes.insert("vandle");
+    DeclareAccess({}, {});
+    DeclareTraceFields({"baseline", "discrim", "maxpos", "maxval",
+                        "numAboveThresh", "phase", "qdc", "sigmaBaseline",
+                        "tqdc"}, {"beta", "beta_scint", "liquid"});
 }
 
 VandleProcessor::VandleProcessor(const std::vector<std::string> &typeList,
@@ -59,6 +64,10 @@ VandleProcessor::VandleProcessor(const std::vector<std::string> &typeList,
                                  const unsigned int &numStarts):
     EventProcessor(OFFSET, RANGE, "VandleProcessor") {
     associatedTypes.insert("vandle");
+    DeclareAccess({}, {});
+    DeclareTraceFields({"baseline", "discrim", "maxpos", "maxval",
+                        "numAboveThresh", "phase", "qdc", "sigmaBaseline",
+                        "tqdc"}, {"beta", "beta_scint", "liquid"});
     plotMult_ = res;
     plotOffset_ = offset;
     numStarts_ = numStarts;
@@ -167,6 +176,16 @@ void VandleProcessor::DeclarePlots(void) {
     DeclareHistogram2D(DD_DEBUGGING, S8, S8, "2D Debugging");
 }
 
+bool VandleProcessor::Init(RawEvent &event) {
+    if (!EventProcessor::Init(event))
+        return(false);
+    barBuilder_ = BarBuilder("vandle");
+    startBuilder_ = BarBuilder("beta");
+    calTable_ = TimingCalibrationTable(barBuilder_.GetKeys());
+    starts_.Resize(DetectorLibrary::get()->size());
+    return(true);
+}
+
 bool VandleProcessor::PreProcess(RawEvent &event) {
     if (!EventProcessor::PreProcess(event))
         return false;
@@ -183,11 +202,10 @@ bool VandleProcessor::PreProcess(RawEvent &event) {
         return(false);
     }
 
-    BarBuilder billy(events);
-    billy.BuildBars();
-    bars_ = billy.GetBarMap();
+    barBuilder_.SetChannelList(events);
+    barBuilder_.BuildBars();
 
-    if(bars_.empty()) {
+    if(barBuilder_.GetBarArray().empty()) {
         plot(D_DEBUGGING, 25);
         return(false);
     }
@@ -215,20 +233,13 @@ bool VandleProcessor::Process(RawEvent &event) {
     static const vector<ChanEvent*> &liquidStarts =
         event.GetSummary("liquid:scint:start")->GetList();
 
-    vector<ChanEvent*> startEvents;
-    startEvents.insert(startEvents.end(),
-		       betaStarts.begin(), betaStarts.end());
-    startEvents.insert(startEvents.end(),
-		       liquidStarts.begin(), liquidStarts.end());
-
-    TimingMapBuilder bldStarts(startEvents);
-    starts_ = bldStarts.GetMap();
+    TimingMapBuilder::FillArray(betaStarts, starts_);
+    TimingMapBuilder::FillArray(liquidStarts, starts_);
 
     static const vector<ChanEvent*> &doubleBetaStarts =
         event.GetSummary("beta:double:start")->GetList();
-    BarBuilder startBars(doubleBetaStarts);
-    startBars.BuildBars();
-    barStarts_ = startBars.GetBarMap();
+    startBuilder_.SetChannelList(doubleBetaStarts);
+    startBuilder_.BuildBars();
 
     if(!doubleBetaStarts.empty())
         AnalyzeBarStarts();
@@ -240,35 +251,35 @@ bool VandleProcessor::Process(RawEvent &event) {
 }
 
 void VandleProcessor::AnalyzeBarStarts(void) {
-    for (BarMap::iterator it = bars_.begin(); it !=  bars_.end(); it++) {
-        TimingDefs::TimingIdentifier barId = (*it).first;
-        BarDetector bar = (*it).second;
+    const BarArray &bars = barBuilder_.GetBarArray();
+    const BarArray &barStarts = startBuilder_.GetBarArray();
+    for (size_t it = bars.Next(0); it < bars.size(); it = bars.Next(it+1)) {
+        const BarDetector &bar = bars[it];
 
-        if(!bar.GetHasEvent())
+        double flightPath;
+        if(!GetBarFlightPath(it, bar, flightPath))
             continue;
 
         unsigned int histTypeOffset = ReturnOffset(bar.GetType());
-        unsigned int barLoc = barId.first;
-        const TimingCalibration cal = bar.GetCalibration();
+        unsigned int barLoc = bar.GetKey().first;
+        double z0 = calTable_.GetZ0(it);
 
-        for(BarMap::iterator itStart = barStarts_.begin();
-        itStart != barStarts_.end(); itStart++) {
-            unsigned int startLoc = (*itStart).first.first;
+        for(size_t itStart = barStarts.Next(0); itStart < barStarts.size();
+            itStart = barStarts.Next(itStart+1)) {
+            const BarDetector &start = barStarts[itStart];
+            unsigned int startLoc = start.GetKey().first;
             unsigned int barPlusStartLoc = barLoc*numStarts_ + startLoc;
 
-            BarDetector start = (*itStart).second;
-
             double tof = bar.GetCorTimeAve() -
-                start.GetCorTimeAve() + cal.GetTofOffset(startLoc);
+                start.GetCorTimeAve() + calTable_.GetTofOffset(it, startLoc);
 
-            double corTof =
-                CorrectTOF(tof, bar.GetFlightPath(), cal.GetZ0());
+            double corTof = CorrectTOF(tof, flightPath, z0);
 
             plot(DD_TOFBARS+histTypeOffset, tof*plotMult_+plotOffset_,
                  barPlusStartLoc);
             plot(DD_CORTOFBARS, corTof*plotMult_+plotOffset_, barPlusStartLoc);
 
-            if(cal.GetTofOffset(startLoc) != 0) {
+            if(calTable_.GetTofOffset(it, startLoc) != 0) {
                 plot(DD_TQDCAVEVSTOF+histTypeOffset, tof*plotMult_+plotOffset_,
                      bar.GetQdc());
                 plot(DD_TQDCAVEVSCORTOF+histTypeOffset,
@@ -293,31 +304,28 @@ void VandleProcessor::AnalyzeBarStarts(void) {
 } //void VandleProcessor::AnalyzeData
 
 void VandleProcessor::AnalyzeStarts(void) {
-    for (BarMap::iterator it = bars_.begin(); it !=  bars_.end(); it++) {
-        TimingDefs::TimingIdentifier barId = (*it).first;
-        BarDetector bar = (*it).second;
+    const BarArray &bars = barBuilder_.GetBarArray();
+    for (size_t it = bars.Next(0); it < bars.size(); it = bars.Next(it+1)) {
+        const BarDetector &bar = bars[it];
 
-        if(!bar.GetHasEvent())
+        double flightPath;
+        if(!GetBarFlightPath(it, bar, flightPath))
             continue;
 
         unsigned int histTypeOffset = ReturnOffset(bar.GetType());
-        unsigned int barLoc = barId.first;
-        const TimingCalibration cal = bar.GetCalibration();
-
-        for(TimingMap::iterator itStart = starts_.begin();
-        itStart != starts_.end(); itStart++) {
-            if(!(*itStart).second.GetIsValid())
-                continue;
+        unsigned int barLoc = bar.GetKey().first;
+        double z0 = calTable_.GetZ0(it);
 
-            unsigned int startLoc = (*itStart).first.first;
+        for(size_t itStart = starts_.Next(0); itStart < starts_.size();
+            itStart = starts_.Next(itStart+1)) {
+            const HighResTimingData &start = starts_[itStart];
+            unsigned int startLoc = start.GetChan()->GetChanID().GetLocation();
             unsigned int barPlusStartLoc = barLoc*numStarts_ + startLoc;
-            HighResTimingData start = (*itStart).second;
 
             double tof = bar.GetCorTimeAve() -
-                start.GetCorrectedTime() + cal.GetTofOffset(startLoc);
+                start.GetCorrectedTime() + calTable_.GetTofOffset(it, startLoc);
 
-            double corTof =
-                CorrectTOF(tof, bar.GetFlightPath(), cal.GetZ0());
+            double corTof = CorrectTOF(tof, flightPath, z0);
 
             plot(DD_TOFBARS+histTypeOffset, tof*plotMult_+plotOffset_, barPlusStartLoc);
             plot(DD_TQDCAVEVSTOF+histTypeOffset, tof*plotMult_+plotOffset_, bar.GetQdc());
@@ -343,15 +351,41 @@ void VandleProcessor::AnalyzeStarts(void) {
     } //(BarMap::iterator itBar
 } //void VandleProcessor::AnalyzeData
 
+bool VandleProcessor::GetBarFlightPath(const size_t &slot,
+                                       const BarDetector &bar,
+                                       double &flightPath) const {
+    const HighResTimingData &left = bar.GetLeftSide();
+    const HighResTimingData &right = bar.GetRightSide();
+    double timeDiff = left.GetHighResTime() - right.GetHighResTime() +
+        calTable_.GetLeftRightTimeOffset(slot);
+    if(!(fabs(timeDiff) < calTable_.GetMaxTimeDifference(slot)) ||
+       !right.GetIsValid() || !left.GetIsValid())
+        return(false);
+
+    double z0 = calTable_.GetZ0(slot);
+    double x = calTable_.GetSpeedOfLight(slot)*0.5*timeDiff +
+        calTable_.GetXOffset(slot);
+    flightPath = sqrt(z0*z0 + x*x);
+    return(true);
+}
+
 void VandleProcessor::ClearMaps(void) {
-    bars_.clear();
     starts_.clear();
 }
 
+BarMap VandleProcessor::GetBars(void) {
+    BarMap bars;
+    const BarArray &array = barBuilder_.GetBarArray();
+    for(size_t it = array.Next(0); it < array.size(); it = array.Next(it+1))
+        bars.insert(make_pair(array[it].GetKey(), array[it]));
+    return(bars);
+}
+
 void VandleProcessor::FillVandleOnlyHists(void) {
-    for(BarMap::const_iterator it = bars_.begin(); it != bars_.end(); it++) {
-        TimingDefs::TimingIdentifier barId = (*it).first;
-        BarDetector bar = (*it).second;
+    const BarArray &bars = barBuilder_.GetBarArray();
+    for(size_t it = bars.Next(0); it < bars.size(); it = bars.Next(it+1)) {
+        const BarDetector &bar = bars[it];
+        const TimingDefs::TimingIdentifier &barId = bar.GetKey();
         unsigned int OFFSET = ReturnOffset(barId.second);
 
         plot(DD_TQDCBARS + OFFSET,
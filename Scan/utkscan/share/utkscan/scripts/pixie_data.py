@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""
+Read the files written by utkscan into numpy arrays without copying them.
+Each file is mapped into memory and the arrays are views of the mapping, so
+only the pages which are touched are ever read from disk.
+
+  HisFile     the histograms of a .drr/.his pair (see MappedHisFile in
+              HisFile.hpp), each a 1D or 2D array of its bins
+  ColumnFile  the chunked columnar files of the ColumnProcessor and hitdump
+              (see ColumnWriter.hpp), one array per column and chunk
+  RevFile     the raw event files of utkscan (see RawEventFile.hpp), in
+              chunks of events with their hits as a structured array
+
+    python3 pixie_data.py file.his|file.col|file.rev
+"""
+import mmap
+import struct
+import sys
+import zlib
+
+import numpy
+
+# The 32 byte CompactHit of CompactHit.hpp
+HIT_DTYPE = numpy.dtype([('timeStamp', '<u8'), ('spillIndex', '<u4'),
+                         ('hitIndex', '<u4'), ('traceOffset', '<u4'),
+                         ('traceLength', '<u2'), ('energy', '<u2'),
+                         ('modNum', '<u2'), ('chanNum', 'u1'),
+                         ('crateNum', 'u1'), ('slotNum', 'u1'),
+                         ('headerLength', 'u1'), ('flags', 'u1'),
+                         ('reserved', 'u1')])
+
+# The 32 byte record which starts each event of a .rev file
+EVENT_DTYPE = numpy.dtype([('numHits', '<u4'), ('numBytes', '<u4'),
+                           ('startTime', '<f8'), ('realStartTime', '<f8'),
+                           ('realStopTime', '<f8')])
+
+COLUMN_TYPES = {0: numpy.float64, 1: numpy.int32, 2: numpy.uint32,
+                3: numpy.uint64}
+
+
+def map_file(path):
+    """Return a read-only mapping of a whole file"""
+    with open(path, 'rb') as f:
+        return mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+
+def view(data, dtype, count, offset):
+    """Return count values of a mapping from a byte offset, without a copy"""
+    return numpy.frombuffer(data, dtype=dtype, count=count, offset=offset)
+
+
+class HisFile(object):
+    """The histograms of a .drr/.his pair, by histogram id"""
+
+    def __init__(self, prefix):
+        if prefix.endswith('.his') or prefix.endswith('.drr'):
+            prefix = prefix[:-4]
+        self.drr = map_file(prefix + '.drr')
+        if self.drr[:12] != b'HHIRFDIR0001':
+            raise ValueError('not a .drr file')
+        count = struct.unpack_from('<i', self.drr, 12)[0]
+        ids = struct.unpack_from('<{}i'.format(count), self.drr,
+                                 128 + 128 * count)
+        # The entry of each histogram follows the 128 byte header
+        self.index = dict((ids[i], 128 + 128 * i) for i in range(count))
+        self.his = map_file(prefix + '.his')
+
+    def ids(self):
+        """Return the ids of the histograms, in increasing order"""
+        return sorted(self.index)
+
+    def entry(self, his_id):
+        """Return the .drr entry of a histogram as a dict"""
+        pos = self.index[his_id]
+        dim, half_words = struct.unpack_from('<HH', self.drr, pos)
+        raw, scaled, minc, maxc = [struct.unpack_from('<4H', self.drr, pos + i)
+                                   for i in (12, 20, 28, 36)]
+        offset = struct.unpack_from('<I', self.drr, pos + 44)[0]
+        title = self.drr[pos + 88:pos + 128].decode('ascii', 'replace')
+        return {'id': his_id, 'dim': dim, 'half_words': half_words,
+                'raw': raw[:dim], 'scaled': scaled[:dim], 'min': minc[:dim],
+                'max': maxc[:dim], 'offset': 2 * offset,
+                'title': title.rstrip(' \0')}
+
+    def histogram(self, his_id):
+        """Return the bins of a histogram, indexed [x] or [y, x]"""
+        entry = self.entry(his_id)
+        if entry['dim'] not in (1, 2) or entry['half_words'] not in (1, 2):
+            raise ValueError('unsupported histogram {}'.format(his_id))
+        dtype = '<u4' if entry['half_words'] == 2 else '<u2'
+        shape = tuple(reversed(entry['scaled']))
+        count = int(numpy.prod(shape))
+        return view(self.his, dtype, count, entry['offset']).reshape(shape)
+
+
+class ColumnFile(object):
+    """A chunked columnar file, read one chunk of rows at a time"""
+
+    def __init__(self, path):
+        self.data = map_file(path)
+        schema, magic = struct.unpack_from('<Q8s', self.data,
+                                           len(self.data) - 16)
+        if magic != b'PXCOLEND':
+            raise ValueError('not a columnar event file')
+        if self.data[schema:schema + 4] != b'SCHM':
+            raise ValueError('missing schema')
+        pos = schema + 8
+        self.columns = []
+        for i in range(struct.unpack_from('<I', self.data, schema + 4)[0]):
+            length = struct.unpack_from('<I', self.data, pos)[0]
+            name = self.data[pos + 4:pos + 4 + length].decode()
+            ctype, width = struct.unpack_from('<BI', self.data,
+                                              pos + 4 + length)
+            self.columns.append((name, COLUMN_TYPES[ctype], width))
+            pos += 9 + length
+        self.entries, chunks = struct.unpack_from('<QI', self.data, pos)
+        self.offsets = struct.unpack_from('<{}Q'.format(chunks), self.data,
+                                          pos + 12)
+
+    def names(self):
+        """Return the names of the columns"""
+        return [c[0] for c in self.columns]
+
+    def chunks(self, names=None):
+        """Yield a dict of the requested (default all) columns of each chunk.
+        Stored columns are views of the file, compressed ones are inflated."""
+        wanted = set(self.names() if names is None else names)
+        for offset in self.offsets:
+            if self.data[offset:offset + 4] != b'CHNK':
+                raise ValueError('bad chunk at {}'.format(offset))
+            rows = struct.unpack_from('<I', self.data, offset + 4)[0]
+            pos = offset + 8
+            chunk = {}
+            for name, dtype, width in self.columns:
+                codec, size, raw = struct.unpack_from('<BII', self.data, pos)
+                pos += 9
+                if name in wanted:
+                    if codec == 1:
+                        values = numpy.frombuffer(
+                            zlib.decompress(self.data[pos:pos + size]),
+                            dtype=dtype)
+                    else:
+                        values = view(self.data, dtype, rows * width, pos)
+                    chunk[name] = (values.reshape(rows, width)
+                                   if width > 1 else values)
+                pos += size
+            yield chunk
+
+    def read(self, names=None):
+        """Return a dict of the requested (default all) columns of the file"""
+        wanted = self.names() if names is None else names
+        parts = dict((name, []) for name in wanted)
+        for chunk in self.chunks(wanted):
+            for name in wanted:
+                parts[name].append(chunk[name])
+        return dict((name, numpy.concatenate(p) if p else numpy.array([]))
+                    for name, p in parts.items())
+
+
+class RevChunk(object):
+    """A run of events of a .rev file. The event records and hits are
+    gathered into arrays, the traces and onboard words are views of the
+    file."""
+
+    def __init__(self, data, event_offsets, hit_offsets, first_hit):
+        self.data = data
+        raw = numpy.frombuffer(data, dtype=numpy.uint8)
+        self.events = raw[numpy.add.outer(event_offsets, numpy.arange(
+            EVENT_DTYPE.itemsize))].view(EVENT_DTYPE).reshape(-1)
+        self.hits = raw[numpy.add.outer(hit_offsets, numpy.arange(
+            HIT_DTYPE.itemsize))].view(HIT_DTYPE).reshape(-1)
+        self.hit_offsets = hit_offsets
+        # The hits of event i are hits[first_hit[i]:first_hit[i + 1]]
+        self.first_hit = first_hit
+
+    def onboard(self, hit):
+        """Return the onboard energy sums and QDCs of a hit"""
+        length = self.hits['headerLength'][hit]
+        count = (4 if length in (8, 16) else 0) + (8 if length in (12, 16)
+                                                   else 0)
+        return view(self.data, '<u4', count,
+                    int(self.hit_offsets[hit]) + HIT_DTYPE.itemsize)
+
+    def trace(self, hit):
+        """Return the trace samples of a hit"""
+        return view(self.data, '<u2', int(self.hits['traceLength'][hit]),
+                    int(self.hit_offsets[hit]) + HIT_DTYPE.itemsize
+                    + 4 * len(self.onboard(hit)))
+
+
+class RevFile(object):
+    """A raw event file, read in chunks of events"""
+
+    def __init__(self, path):
+        self.data = map_file(path)
+        if self.data[:8] != b'PXREVT02':
+            raise ValueError('not a raw event file')
+        self.end = len(self.data)
+        self.header = {}
+        self.first_time = 0.0
+        self.num_events = self.num_hits = 0
+        self.index_times = self.index_offsets = ()
+        self.indexed = self._read_index()
+
+    def _read_index(self):
+        if self.end < 24 or self.data[-8:] != b'PXREVEND':
+            return False
+        pos = struct.unpack_from('<Q', self.data, self.end - 16)[0]
+        if pos < 8 or self.data[pos:pos + 4] != b'RIDX':
+            return False
+        self.first_time, self.num_events, self.num_hits, entries = \
+            struct.unpack_from('<dQQI', self.data, pos + 4)
+        index = pos + 32
+        for i in range(2 * entries):
+            length = struct.unpack_from('<I', self.data, index)[0]
+            value = self.data[index + 4:index + 4 + length].decode()
+            if i % 2 == 0:
+                name = value
+            else:
+                self.header[name] = value
+            index += 4 + length
+        count = struct.unpack_from('<Q', self.data, index)[0]
+        self.index_times = view(self.data, '<f8', count, index + 8)
+        self.index_offsets = view(self.data, '<u8', count, index + 8 + 8 * count)
+        self.end = pos
+        return True
+
+    def chunks(self, events=65536, start_time=None):
+        """Yield RevChunks of up to events events, from the first event at
+        or after start_time (in clock ticks) if the file has an index"""
+        pos = 8
+        if start_time is not None and self.indexed:
+            entry = numpy.searchsorted(self.index_times, start_time, 'right')
+            if entry > 0:
+                pos = int(self.index_offsets[entry - 1])
+        while pos + EVENT_DTYPE.itemsize <= self.end:
+            event_offsets, hit_offsets, first_hit = [], [], []
+            while len(event_offsets) < events and \
+                    pos + EVENT_DTYPE.itemsize <= self.end:
+                hits, length, event_start = \
+                    struct.unpack_from('<IId', self.data, pos)
+                if pos + EVENT_DTYPE.itemsize + length > self.end:
+                    raise ValueError('truncated event at {}'.format(pos))
+                pos += EVENT_DTYPE.itemsize
+                if start_time is not None and event_start < start_time:
+                    pos += length
+                    continue
+                event_offsets.append(pos - EVENT_DTYPE.itemsize)
+                first_hit.append(len(hit_offsets))
+                for i in range(hits):
+                    trace, header = struct.unpack_from('<H7xB', self.data,
+                                                       pos + 20)
+                    hit_offsets.append(pos)
+                    pos += (HIT_DTYPE.itemsize + 2 * trace
+                            + 4 * ((4 if header in (8, 16) else 0)
+                                   + (8 if header in (12, 16) else 0)))
+            if not event_offsets:
+                break
+            first_hit.append(len(hit_offsets))
+            yield RevChunk(self.data, numpy.array(event_offsets, numpy.int64),
+                           numpy.array(hit_offsets, numpy.int64),
+                           numpy.array(first_hit, numpy.int64))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    path = sys.argv[1]
+    if path.endswith('.his') or path.endswith('.drr'):
+        his = HisFile(path)
+        for his_id in his.ids():
+            bins = his.histogram(his_id)
+            print('{}: {} {} counts'.format(his_id, bins.shape, bins.sum()))
+    elif path.endswith('.rev'):
+        events = hits = 0
+        for chunk in RevFile(path).chunks():
+            events += len(chunk.events)
+            hits += len(chunk.hits)
+        print('{} events, {} hits'.format(events, hits))
+    else:
+        for name, values in ColumnFile(path).read().items():
+            print('{}: {} {}'.format(name, values.shape, values[:5]))
@@ -0,0 +1,25 @@
+#!/usr/bin/env python3
+"""
+Read the columnar event files written by the ColumnProcessor of utkscan or
+by hitdump into numpy arrays, one per column. Only the requested columns are
+decompressed. The file layout is described in ColumnWriter.hpp.
+
+    python3 read_columns.py events.col [column ...]
+"""
+import sys
+
+from pixie_data import ColumnFile
+
+
+def read_columns(path, names=None):
+    """Return a dict of the requested (default all) columns of a file"""
+    return ColumnFile(path).read(names)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    names = sys.argv[2:] if len(sys.argv) > 2 else None
+    for name, values in read_columns(sys.argv[1], names).items():
+        print('{}: {} {}'.format(name, values.shape, values[:5]))
@@ -23,6 +23,13 @@ int main(int argc, char *argv[])
 	pif.Init();
 	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
 
+	// Adjust all modules at once, each in its own thread.
+	if(mod < 0){
+		pif.SetParallelModules();
+		if(pif.AdjustOffsets()){ pif.SaveDSPParameters(); }
+		return 0;
+	}
+
 	OffsetAdjuster adjuster;
 	if(forModule(&pif, mod, adjuster, 0)){ pif.SaveDSPParameters(); }
 
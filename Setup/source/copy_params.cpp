@@ -12,6 +12,7 @@
 
 #include "Display.h"
 #include "PixieInterface.h"
+#include "PixieSupport.h"
 
 using namespace std;
 using namespace Display;
@@ -52,6 +53,10 @@ int main(int argc, char **argv)
     sourceChan = atoi(argv[2]);
     destMod = atoi(argv[3]);
   }
+
+  // keep the destination parameters to show what the copy changed
+  ParameterSnapshot before;
+  before.Read(&pif, destMod);
   if (argc == 3) {
     // copy channel by channel between two modules
     for (unsigned int i=0; i < pif.GetNumberChannels(); i++) {      
@@ -80,7 +85,13 @@ int main(int argc, char **argv)
 
   if (success) {
     cout << OkayStr() << endl;
-    pif.SaveDSPParameters();    
+
+    ParameterSnapshot after, changes;
+    after.Read(&pif, destMod);
+    if (before.Diff(after, changes) > 0) {
+      changes.Print(&before);
+      pif.SaveDSPParameters();
+    } else cout << "  Destination parameters were already identical" << endl;
   } else cout << ErrorStr() << endl;
 
 	delete[] destMask;
@@ -0,0 +1,123 @@
+/********************************************************************/
+/*	crate_setup.cpp                                                 */
+/*		last updated: Oct. 15th, 2026                               */
+/********************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PixieSupport.h"
+
+typedef std::chrono::steady_clock setup_clock;
+
+// Return the seconds elapsed since start.
+static double elapsed(const setup_clock::time_point &start){
+	return std::chrono::duration<double>(setup_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+	std::string reportName = "crate_setup.txt";
+	bool doOffsets = true;
+	bool doTau = true;
+	bool applyTau = false;
+
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "--no-offsets") == 0){ doOffsets = false; }
+		else if(strcmp(argv[i], "--no-tau") == 0){ doTau = false; }
+		else if(strcmp(argv[i], "--apply-tau") == 0){ applyTau = true; }
+		else if(argv[i][0] == '-'){
+			std::cout << " Invalid argument to " << argv[0] << std::endl;
+			std::cout << "  SYNTAX: " << argv[0] << " <report file> <--no-offsets> <--no-tau> <--apply-tau>\n\n";
+			std::cout << "  Adjusts the offsets and finds the decay constant of every channel, in one\n";
+			std::cout << "  thread per module, and writes a report (default " << reportName << ").\n";
+			std::cout << "  With --apply-tau the decay constants found are written to the modules.\n\n";
+			return 1;
+		}
+		else{ reportName = argv[i]; }
+	}
+
+	PixieInterface pif("pixie.cfg");
+
+	pif.GetSlots();
+	pif.Init();
+	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
+	pif.SetParallelModules();
+
+	unsigned short nMods = pif.GetNumberCards();
+	size_t nChan = PixieInterface::GetNumberChannels();
+	bool changed = false;
+
+	bool offsetsOk = true;
+	double offsetsTime = 0;
+	if(doOffsets){
+		setup_clock::time_point start = setup_clock::now();
+		offsetsOk = pif.AdjustOffsets();
+		offsetsTime = elapsed(start);
+		changed = offsetsOk;
+	}
+
+	// The current values are read before the decay constants are applied.
+	std::vector< std::vector<double> > voffset(nMods, std::vector<double>(nChan, 0));
+	std::vector< std::vector<double> > oldTau(nMods, std::vector<double>(nChan, 0));
+	for(unsigned short mod = 0; mod < nMods; mod++){
+		for(size_t ch = 0; ch < nChan; ch++){
+			pif.ReadSglChanPar("VOFFSET", voffset[mod][ch], mod, ch);
+			pif.ReadSglChanPar("TAU", oldTau[mod][ch], mod, ch);
+		}
+	}
+
+	bool tauOk = true;
+	double tauTime = 0;
+	std::vector< std::vector<double> > newTau;
+	if(doTau){
+		setup_clock::time_point start = setup_clock::now();
+		tauOk = pif.FindTau(newTau);
+		tauTime = elapsed(start);
+
+		// Only channels where a decay constant was found are written.
+		if(applyTau){
+			std::vector< std::vector<PixieInterface::ChanPar> > pars(nMods);
+			for(unsigned short mod = 0; mod < nMods; mod++){
+				for(size_t ch = 0; ch < nChan; ch++){
+					if(newTau[mod][ch] > 0){ pars[mod].push_back(PixieInterface::ChanPar("TAU", ch, newTau[mod][ch])); }
+				}
+			}
+			if(pif.WriteChanPars(pars)){ changed = true; }
+		}
+	}
+
+	if(changed){ pif.SaveDSPParameters(); }
+
+	std::ofstream report(reportName.c_str());
+	if(!report.good()){
+		std::cout << " Failed to open report file '" << reportName << "'\n";
+		return 1;
+	}
+
+	time_t now = time(NULL);
+	report << "# crate_setup report, " << ctime(&now);
+	if(doOffsets){ report << "# offsets: " << (offsetsOk ? "ok" : "FAILED") << " in " << offsetsTime << " s\n"; }
+	else{ report << "# offsets: skipped\n"; }
+	if(doTau){ report << "# tau: " << (tauOk ? "ok" : "FAILED") << " in " << tauTime << " s" << (applyTau ? ", applied\n" : ", not applied\n"); }
+	else{ report << "# tau: skipped\n"; }
+	report << "# mod\tchan\tVOFFSET\tTAU\tfound TAU\n";
+	report << std::fixed;
+	for(unsigned short mod = 0; mod < nMods; mod++){
+		for(size_t ch = 0; ch < nChan; ch++){
+			report << mod << "\t" << ch << "\t" << std::setprecision(4) << voffset[mod][ch] << "\t" << oldTau[mod][ch] << "\t";
+			if(doTau && newTau[mod][ch] > 0){ report << newTau[mod][ch] << "\n"; }
+			else{ report << "-\n"; }
+		}
+	}
+	report.close();
+
+	std::cout << " Wrote report for " << nMods << " modules to '" << reportName << "'\n";
+
+	return (offsetsOk && tauOk ? 0 : 1);
+}
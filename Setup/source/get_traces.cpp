@@ -28,15 +28,20 @@ class TraceGrabber : public PixieFunction<>
 {
 public:
     TraceGrabber(unsigned short* data_, int trigger_, int maxTries_, size_t loopLength_, bool doFit_ = false) :
-	data(data_), trigger(trigger_), maxTries(maxTries_), loopLength(loopLength_), ready() {
+	data(data_), trigger(trigger_), maxTries(maxTries_), loopLength(loopLength_), ready(),
+	raw(NUMBER_OF_CHANNELS * PixieInterface::GetTraceLength()) {
 	doFit = doFit_;
 	isBidirectional = false;
 	updateBaselines = false;
 	for (int i = 0; i < NUMBER_OF_CHANNELS; ++i) {
 	    attempts[i] = 0;
 	    baseline[i] = NAN;
+	    newBaseline[i] = NAN;
+	    maximum[i] = 0;
 	}
     }
+    /** Acquire and read the traces of all channels of a module at once */
+    bool Acquire(PixieInterface &pif, int mod);
     bool operator()(PixieFunctionParms<> &par);
     bool Ready(void) const {return ready.count() == loopLength;}
     void EnableBaselineUpdate(void) {updateBaselines = true;}
@@ -61,6 +66,12 @@ private:
     bitset<NUMBER_OF_CHANNELS> ready;
     /** Calculated baseline for each channel */
     float baseline[NUMBER_OF_CHANNELS];
+    /** Traces of all channels from the last acquisition */
+    vector<unsigned short> raw;
+    /** Baseline of each channel in the last acquisition */
+    float newBaseline[NUMBER_OF_CHANNELS];
+    /** Maximum above baseline of each channel in the last acquisition */
+    float maximum[NUMBER_OF_CHANNELS];
 
     /** Save data to array */
     void StoreData(short unsigned int* trace,
@@ -123,112 +134,99 @@ double TraceGrabber::FitTau(const unsigned short* trace, size_t b0, size_t b1, s
         return -6.66e6;
 }
 
+bool TraceGrabber::Acquire(PixieInterface &pif, int mod)
+{
+    const size_t size = PixieInterface::GetTraceLength();
+    if (!pif.AcquireAllTraces(raw.data(), size, mod))
+	return false;
+    PixieInterface::AnalyzeTraces(raw.data(), pif.GetNumberChannels(), size, newBaseline, maximum);
+    return true;
+}
+
 bool TraceGrabber::operator()(PixieFunctionParms<> &par)
 {
-    /* Grab traces the first time around */
-    static size_t loopCount = loopLength;
-    // Reads traces from whole module
-    // Should be run only once per 'loop' (when all individual channels
-    // are processed)
-    if (loopCount >= loopLength) {
-        par.pif.AcquireTraces(par.mod);
-        loopCount = 0;
-    }
     // If channel ready skip the rest
     if ( ready[par.ch] ) 
         return true;
-    loopCount++;
 
     const size_t size = PixieInterface::GetTraceLength();
-    unsigned short *trace = new unsigned short[size];
-    usleep(10);
-    if (par.pif.ReadSglChanTrace(trace, size, par.mod, par.ch)) {
-        if (trigger > 0.0 && attempts[par.ch] < maxTries) {
-	    if (attempts[par.ch] == 0 || updateBaselines) {
-		size_t baselineSamples = size / 10;
-		unsigned long sum = 0;
-
-		for (unsigned i = 0; i < baselineSamples; ++i)
-		    sum += trace[i];
-		
-		baseline[par.ch] = float(sum)/float(baselineSamples);
-		if ( attempts[par.ch] == 0 ) {
-		    cout << "CH: " << par.ch << " average " << baseline[par.ch];
-		    cout << ", trig level = " << baseline[par.ch] + trigger;
-		    if (isBidirectional) 
-			cout << " or " << baseline[par.ch] - trigger;	       	
-		    if (updateBaselines)
-			cout << ", updating continuously"; 
-		    cout << endl;		
-		}
+    unsigned short *trace = &raw[par.ch * size];
+    if (trigger > 0.0 && attempts[par.ch] < maxTries) {
+	if (attempts[par.ch] == 0 || updateBaselines) {
+	    baseline[par.ch] = newBaseline[par.ch];
+	    if ( attempts[par.ch] == 0 ) {
+		cout << "CH: " << par.ch << " average " << baseline[par.ch];
+		cout << ", trig level = " << baseline[par.ch] + trigger;
+		if (isBidirectional) 
+		    cout << " or " << baseline[par.ch] - trigger;	       	
+		if (updateBaselines)
+		    cout << ", updating continuously"; 
+		cout << endl;		
 	    }
+	}
 
-            attempts[par.ch]++;
-
-            bool trig = false;
-            int triggerHigh = baseline[par.ch] + trigger;
-	    int triggerLow  = baseline[par.ch] - trigger;
+	attempts[par.ch]++;
 
-	    size_t x0;
-            for (unsigned int i = 0; i < size; ++i) {
-                if (trace[i] > triggerHigh || 
-		    (isBidirectional && trace[i] < triggerLow) ) {
-                    trig = true;
-                    x0 = i;
-                    break;
-                } 
-            }
-            if (trig) {
-                StoreData(trace, size, par.ch);
-                cout << "Channel " << par.ch << " ready " << " trig " << trace[x0] << " at " << x0 << endl;
-                if (doFit) {
-                    size_t x1 = 0;
-                    for (size_t i = size - 1; i > x0; --i) {
-                        if (trace[i] > triggerHigh - trigger/2 ||
-			    (isBidirectional && trace[i] < triggerLow + trigger / 2) ) {
-                            x1 = i;
-                            break;
-                        }
-                    }
-                    // Arbitrary 10 samples between x0 and x1 
-                    if (x1 > x0 + 10) {
-                        size_t b0, b1;
+	bool trig = false;
+	int triggerHigh = baseline[par.ch] + trigger;
+	int triggerLow  = baseline[par.ch] - trigger;
 
-                        if (x0 > 30) {
-                            b0 = 0;
-                            b1 = 20;
-                        } else {
-                            b0 = 8171;
-                            b1 = 8191;
-                        }
-                        // x0 + 5 in order to get rid of growin part
-                        //   might be not enough
-                        double tau = FitTau(trace, b0, b1, x0+5, x1);
+	size_t x0;
+	// The maximum of the trace is already known, so only scan it if it can trigger
+	bool canTrigger = isBidirectional || newBaseline[par.ch] + maximum[par.ch] > triggerHigh;
+	for (unsigned int i = 0; canTrigger && i < size; ++i) {
+	    if (trace[i] > triggerHigh || 
+		(isBidirectional && trace[i] < triggerLow) ) {
+		trig = true;
+		x0 = i;
+		break;
+	    } 
+	}
+	if (trig) {
+	    StoreData(trace, size, par.ch);
+	    cout << "Channel " << par.ch << " ready " << " trig " << trace[x0] << " at " << x0 << endl;
+	    if (doFit) {
+		size_t x1 = 0;
+		for (size_t i = size - 1; i > x0; --i) {
+		    if (trace[i] > triggerHigh - trigger/2 ||
+			(isBidirectional && trace[i] < triggerLow + trigger / 2) ) {
+			x1 = i;
+			break;
+		    }
+		}
+		// Arbitrary 10 samples between x0 and x1 
+		if (x1 > x0 + 10) {
+		    size_t b0, b1;
 
-                        cout << "Tau = " << tau << endl;
-                        cout << " x0 = " << x0 << ", x1 = " << x1 << endl;
-                        cout << " b0 = " << x0 << ", b1 = " << x1 << endl;
-                    } else {
-			// not enough samples
-                        cout << "Could not find tau " << endl;
+		    if (x0 > 30) {
+			b0 = 0;
+			b1 = 20;
+		    } else {
+			b0 = 8171;
+			b1 = 8191;
 		    }
-                }
-            }
-        } else if (attempts[par.ch] >= maxTries) {
-            attempts[par.ch]++;
-            StoreData(trace, size, par.ch);
-            cout << "Channel " << par.ch << " exceeded max number of attempts " << endl;
-        } else if (trigger == 0.0 ) {      
-            StoreData(trace, size, par.ch);
-            cout << "Channel " << par.ch << " ready, triggerless" << endl;
-        }
-			delete[] trace;
-        return true;
-    } else {
-	// Did not successfully read trace
-			delete[] trace;
-        return false;
+		    // x0 + 5 in order to get rid of growin part
+		    //   might be not enough
+		    double tau = FitTau(trace, b0, b1, x0+5, x1);
+
+		    cout << "Tau = " << tau << endl;
+		    cout << " x0 = " << x0 << ", x1 = " << x1 << endl;
+		    cout << " b0 = " << x0 << ", b1 = " << x1 << endl;
+		} else {
+		    // not enough samples
+		    cout << "Could not find tau " << endl;
+		}
+	    }
+	}
+    } else if (attempts[par.ch] >= maxTries) {
+	attempts[par.ch]++;
+	StoreData(trace, size, par.ch);
+	cout << "Channel " << par.ch << " exceeded max number of attempts " << endl;
+    } else if (trigger == 0.0 ) {      
+	StoreData(trace, size, par.ch);
+	cout << "Channel " << par.ch << " ready, triggerless" << endl;
     }
+    return true;
 }
 
 int main(int argc, char *argv[])
@@ -358,7 +356,9 @@ int main(int argc, char *argv[])
 
     int counter = 0;
     while (!grabber.Ready()) {
-        forChannel(pif, mod, ch, grabber);
+        // One acquisition and readout of the whole module per pass
+        if (grabber.Acquire(pif, mod))
+            forChannel(pif, mod, ch, grabber);
         cout << "|" << ++counter << " |\r" << flush; 
     }
     cout << "Counter : " << counter << endl;
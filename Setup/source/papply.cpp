@@ -0,0 +1,58 @@
+/********************************************************************/
+/*	papply.cpp                                                      */
+/*		last updated: Oct. 14th, 2026                               */
+/********************************************************************/
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PixieSupport.h"
+
+int main(int argc, char *argv[])
+{
+	if(argc < 2){
+		std::cout << " Invalid number of arguments to " << argv[0] << std::endl;
+		std::cout << "  SYNTAX: " << argv[0] << " [parameter file] <module> <--diff>\n\n";
+		std::cout << "  Writes only the parameters in the file which differ from those in the\n";
+		std::cout << "  crate. The file uses the format of the poll2 dump command. With --diff\n";
+		std::cout << "  the differences are printed but not written.\n\n";
+		return 1;
+	}
+
+	int mod = -1;
+	bool diffOnly = false;
+	for(int i = 2; i < argc; i++){
+		if(strcmp(argv[i], "--diff") == 0){ diffOnly = true; }
+		else{ mod = atoi(argv[i]); }
+	}
+
+	ParameterSnapshot target;
+	if(!target.Load(argv[1])){
+		std::cout << " Failed to read parameter file '" << argv[1] << "'\n";
+		return 1;
+	}
+
+	PixieInterface pif("pixie.cfg");
+
+	pif.GetSlots();
+	pif.Init();
+	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
+	pif.SetParallelModules();
+
+	// Read every parameter once, then compare in memory.
+	ParameterSnapshot current, changes;
+	current.Read(&pif, mod);
+	if(current.Diff(target, changes) == 0){
+		std::cout << " All " << current.Size() << " parameters already match '" << argv[1] << "'\n";
+		return 0;
+	}
+
+	std::cout << " " << changes.Size() << " of " << current.Size() << " parameters differ from '" << argv[1] << "'\n";
+	changes.Print(&current);
+	if(diffOnly){ return 0; }
+
+	if(changes.Apply(&pif)){ pif.SaveDSPParameters(); }
+
+	return 0;
+}
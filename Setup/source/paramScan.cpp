@@ -15,7 +15,7 @@
 #include "TGraphErrors.h"
 #include "TGraph2DErrors.h"
 
-#include "PixieInterface.h"
+#include "PixieSupport.h"
 
 #include "MCA_ROOT.h"
 
@@ -218,13 +218,17 @@ int main(int argc, char *argv[]) {
 
 	pif.RemovePresetRunLength(0);
 
-	if (!pif.ReadSglChanPar(par1.parName, par1.initialVal, mod, ch)) {
+	//Keep all parameters of the module so they can be restored after the scan.
+	ParameterSnapshot initialPars;
+	initialPars.Read(&pif, mod);
+
+	if (!initialPars.GetChannel(mod, ch, par1.parName, par1.initialVal) && !pif.ReadSglChanPar(par1.parName, par1.initialVal, mod, ch)) {
 		std::cout << "Check parameter name!\n";
 		return EXIT_FAILURE;
 	}
 	std::cout << par1.parName << " initial value: " << par1.initialVal << "\n";
 	if (isTwoDim) {
-		if (!pif.ReadSglChanPar(par2.parName, par2.initialVal, mod, ch)) {
+		if (!initialPars.GetChannel(mod, ch, par2.parName, par2.initialVal) && !pif.ReadSglChanPar(par2.parName, par2.initialVal, mod, ch)) {
 			std::cout << "Check parameter name!\n";
 			return EXIT_FAILURE;
 		}
@@ -237,16 +241,18 @@ int main(int argc, char *argv[]) {
 
 	MCA_ROOT *mca = new MCA_ROOT(&pif,"MCA");
 
+	//The set file is only written once the initial values are restored, each step
+	//just writes the scanned values which changed.
 	double readback;
+	std::vector<PixieInterface::ChanPar> batch;
 	for (int step = 0; step <= par1.numSteps; ++step) {
 		//Write parameter value
-		pif.WriteSglChanPar(par1.parName, par1.value, mod, ch);
+		batch.assign(1, PixieInterface::ChanPar(par1.parName, ch, par1.value));
+		pif.WriteChanPars(mod, batch);
 		
 		//Read back the value to see what it actually was set to.
-		pif.PrintSglChanPar(par1.parName, mod, ch);
 		pif.ReadSglChanPar(par1.parName, readback, mod, ch);
-		pif.SaveDSPParameters();
-		printf("Readback : %f\n", readback);
+		printf("  MOD %2d  CHAN %2d  %15s  %f -> %f\n", mod, ch, par1.parName, batch[0].prev, readback);
 		
 		//Reset par2 value
 		par2.reset();
@@ -254,12 +260,12 @@ int main(int argc, char *argv[]) {
 		for (int step2 = 0; step2 <= par2.numSteps; ++step2) {
 			if (isTwoDim) {
 				//Write parameter value
-				pif.WriteSglChanPar(par2.parName,par2.value,mod,ch);
+				batch.assign(1, PixieInterface::ChanPar(par2.parName, ch, par2.value));
+				pif.WriteChanPars(mod, batch);
 			
 				//Read back the value to see what it actually was set to.
-				pif.PrintSglChanPar(par2.parName, mod, ch);
 				pif.ReadSglChanPar(par2.parName, readback, mod, ch);
-				pif.SaveDSPParameters();
+				printf("  MOD %2d  CHAN %2d  %15s  %f -> %f\n", mod, ch, par2.parName, batch[0].prev, readback);
 			}
 
 			if (mca->IsOpen()) 
@@ -349,12 +355,13 @@ int main(int argc, char *argv[]) {
 
 	delete mca;
 
+	//Only the parameters which differ from the initial snapshot are written back.
 	std::cout << "Restoring initial parameter values.\n";
-	pif.WriteSglChanPar(par1.parName, par1.initialVal, mod, ch);
-	pif.PrintSglChanPar(par1.parName, mod, ch);
-	if (isTwoDim) {
-		pif.WriteSglChanPar(par2.parName, par2.initialVal, mod, ch);
-		pif.PrintSglChanPar(par2.parName, mod, ch);
+	ParameterSnapshot finalPars, changedPars;
+	finalPars.Read(&pif, mod);
+	if (finalPars.Diff(initialPars, changedPars) > 0) {
+		changedPars.Print(&finalPars);
+		changedPars.Apply(&pif);
 	}
 	pif.SaveDSPParameters();
 
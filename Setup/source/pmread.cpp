@@ -23,9 +23,12 @@ int main(int argc, char *argv[])
 	pif.Init();
 	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
 
+	// Read the modules at once, each in its own thread.
+	pif.SetParallelModules();
+
 	std::string temp_str(argv[2]);
 	ParameterModuleReader reader;
-	forModule(&pif, mod, reader, temp_str);
+	forModuleParallel(&pif, mod, reader, temp_str);
 
 	return 0;
 }
@@ -25,9 +25,12 @@ int main(int argc, char *argv[])
 	pif.Init();
 	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
 
+	// Write the modules at once, each in its own thread.
+	pif.SetParallelModules();
+
 	std::string temp_str(argv[2]);
 	ParameterModuleWriter writer;
-	if(forModule(&pif, mod, writer, make_pair(temp_str, value))){ pif.SaveDSPParameters(); }
+	if(forModuleParallel(&pif, mod, writer, make_pair(temp_str, value))){ pif.SaveDSPParameters(); }
 
 	return 0;
 }
@@ -24,9 +24,12 @@ int main(int argc, char *argv[])
 	pif.Init();
 	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
 
+	// Read the modules at once, each in its own thread.
+	pif.SetParallelModules();
+
 	std::string temp_str(argv[3]);
 	ParameterChannelReader reader;
-	forChannel(&pif, mod, ch, reader, temp_str);
+	forChannelParallel(&pif, mod, ch, reader, temp_str);
 
 	return 0;
 }
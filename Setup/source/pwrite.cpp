@@ -26,9 +26,12 @@ int main(int argc, char *argv[])
 	pif.Init();
 	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
 
+	// Write the modules at once, each in its own thread.
+	pif.SetParallelModules();
+
 	std::string temp_str(argv[3]);
 	ParameterChannelWriter writer;
-	if(forChannel(&pif, mod, ch, writer, make_pair(temp_str, value))){ pif.SaveDSPParameters(); }
+	if(forChannelParallel(&pif, mod, ch, writer, make_pair(temp_str, value))){ pif.SaveDSPParameters(); }
 
 	return 0;
 }
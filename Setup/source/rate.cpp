@@ -1,13 +1,19 @@
 /********************************************************************/
 /*	rate.cpp   						    */
-/*		last updated: 10/02/09 DTM	     	       	    */
+/*		last updated: 10/15/26	     	       	    */
 /*			       					    */
 /********************************************************************/
 
 #include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "utilities.h"
 #include "PixieInterface.h"
@@ -17,24 +23,75 @@ class StatsReader : public PixieFunction<>
   bool operator()(PixieFunctionParms<> &par);
 };
 
+/// Fixed size ring of statistics snapshots of the whole crate. The sampling
+///   thread adds snapshots and the writer removes them; when the writer falls
+///   behind, new snapshots are dropped and counted instead of blocking the sampling.
+class StatsRing
+{
+ public:
+  StatsRing(size_t capacity, size_t snapSize) :
+    data(capacity * snapSize), times(capacity), snapSize(snapSize),
+    head(0), count(0), dropped(0), done(false) {};
+
+  void Push(const PixieInterface::word_t *snap, double t);
+  bool Pop(PixieInterface::word_t *snap, double &t); // false once finished and empty
+  void Finish(void);
+  size_t GetDropped(void) {std::lock_guard<std::mutex> lock(mtx); return dropped;};
+
+ private:
+  std::vector<PixieInterface::word_t> data;
+  std::vector<double> times;
+  size_t snapSize;
+  size_t head, count, dropped;
+  bool done;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+};
+
+static int RateSeries(PixieInterface &pif, double interval, double duration,
+		      const char *fname, bool binary);
+
 int main(int argc, char *argv[])
 {
-  if (argc != 3) {
+  bool series = (argc >= 4 && strcmp(argv[1], "--series") == 0);
+
+  if (argc != 3 && !series) {
     printf("usage: %s <module> <channel>\n", argv[0]);
+    printf("       %s --series <interval ms> <duration s> [output] [--binary]\n", argv[0]);
+    printf("  --series samples the statistics of all modules every interval and writes the\n");
+    printf("  input and output rates and live fraction of every channel over each interval\n");
+    printf("  as CSV (default rates.csv), or as float records with --binary.\n");
     exit(EXIT_FAILURE);
   }
 
-  int mod = atoi(argv[1]);
-  int ch  = atoi(argv[2]);
-
   PixieInterface pif("pixie.cfg");
   pif.GetSlots();
   pif.Init();
   pif.Boot(0, true);
 
+  if (series) {
+    const char *fname = NULL;
+    bool binary = false;
+    for (int i=4; i < argc; i++) {
+      if (strcmp(argv[i], "--binary") == 0)
+	binary = true;
+      else
+	fname = argv[i];
+    }
+    if (!fname)
+      fname = (binary ? "rates.bin" : "rates.csv");
+
+    pif.SetParallelModules();
+    return RateSeries(pif, atof(argv[2]) / 1000.0, atof(argv[3]), fname, binary);
+  }
+
+  int mod = atoi(argv[1]);
+  int ch  = atoi(argv[2]);
+
   printf(" %2s %2s  %10s  %10s  %10s  %10s  %10s\n",
 	 "M", "C", "Input",  "Output", "Live_t", "Proc_ev", "RealTime");
-  
+
   StatsReader reader;
   forChannel(pif, mod, ch, reader);
 
@@ -49,7 +106,7 @@ bool StatsReader::operator()(PixieFunctionParms<> &par)
     par.pif.GetStatistics(par.mod);
 
   printf(" %2u %2u  %10.1f  %10.1f  %10.0f  %10.0f  %10.1f \n",
-	 par.mod, par.ch, 
+	 par.mod, par.ch,
 	 par.pif.GetInputCountRate(par.mod, par.ch),
 	 par.pif.GetOutputCountRate(par.mod, par.ch),
 	 par.pif.GetLiveTime(par.mod, par.ch),
@@ -60,3 +117,148 @@ bool StatsReader::operator()(PixieFunctionParms<> &par)
 
   return true;
 }
+
+void StatsRing::Push(const PixieInterface::word_t *snap, double t)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (count == times.size()) {
+      dropped++;
+      return;
+    }
+    size_t slot = (head + count) % times.size();
+    memcpy(&data[slot * snapSize], snap, snapSize * sizeof(PixieInterface::word_t));
+    times[slot] = t;
+    count++;
+  }
+  cv.notify_one();
+}
+
+bool StatsRing::Pop(PixieInterface::word_t *snap, double &t)
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock, [this]() { return count > 0 || done; });
+  if (count == 0)
+    return false;
+
+  memcpy(snap, &data[head * snapSize], snapSize * sizeof(PixieInterface::word_t));
+  t = times[head];
+  head = (head + 1) % times.size();
+  count--;
+  return true;
+}
+
+void StatsRing::Finish(void)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    done = true;
+  }
+  cv.notify_one();
+}
+
+/// The live time and real time counters are cumulative, so the rates over an
+///   interval are computed from the difference of the counts (rate * time) of
+///   two consecutive snapshots.
+int RateSeries(PixieInterface &pif, double interval, double duration,
+	       const char *fname, bool binary)
+{
+  if (interval <= 0 || duration <= 0) {
+    printf("Interval and duration must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  FILE *out = fopen(fname, binary ? "wb" : "w");
+  if (!out) {
+    printf("Failed to open output file %s\n", fname);
+    return EXIT_FAILURE;
+  }
+
+  const unsigned int nMods = pif.GetNumberCards();
+  const unsigned int nChan = PixieInterface::GetNumberChannels();
+  const size_t snapSize = nMods * PixieInterface::STAT_SIZE;
+
+  // binary header: "RATE", number of modules and channels, then per sample the
+  //   time (double) and icr, ocr, live fraction (float) of every channel
+  if (binary) {
+    fwrite("RATE", 1, 4, out);
+    fwrite(&nMods, sizeof(nMods), 1, out);
+    fwrite(&nChan, sizeof(nChan), 1, out);
+  } else {
+    fprintf(out, "time,mod,chan,icr,ocr,live\n");
+  }
+
+  // enough room for a couple of seconds of samples
+  size_t capacity = (size_t)(2.0 / interval) + 16;
+  StatsRing ring(capacity, snapSize);
+  size_t readErrors = 0;
+
+  std::thread sampler([&]() {
+    std::vector<PixieInterface::word_t> snap(snapSize);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point next = start;
+    std::chrono::duration<double> step(interval);
+
+    while (std::chrono::duration<double>(next - start).count() < duration) {
+      double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (pif.ReadStatistics(snap.data()))
+	ring.Push(snap.data(), t);
+      else
+	readErrors++;
+
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(step);
+      std::this_thread::sleep_until(next);
+    }
+    ring.Finish();
+  });
+
+  std::vector<PixieInterface::word_t> prev(snapSize), cur(snapSize);
+  std::vector<float> record(nMods * nChan * 3);
+  size_t nSamples = 0;
+  double t;
+
+  while (ring.Pop(cur.data(), t)) {
+    if (nSamples++ > 0) {
+      for (unsigned int mod=0; mod < nMods; mod++) {
+	PixieInterface::word_t *c = &cur[mod * PixieInterface::STAT_SIZE];
+	PixieInterface::word_t *p = &prev[mod * PixieInterface::STAT_SIZE];
+	double dReal = pif.GetRealTime(c, mod) - pif.GetRealTime(p, mod);
+
+	for (unsigned int ch=0; ch < nChan; ch++) {
+	  double liveC = pif.GetLiveTime(c, mod, ch), liveP = pif.GetLiveTime(p, mod, ch);
+	  double realC = pif.GetRealTime(c, mod), realP = pif.GetRealTime(p, mod);
+	  double dLive = liveC - liveP;
+	  double icr = 0, ocr = 0, live = 0;
+
+	  if (dLive > 0)
+	    icr = (pif.GetInputCountRate(c, mod, ch) * liveC - pif.GetInputCountRate(p, mod, ch) * liveP) / dLive;
+	  if (dReal > 0) {
+	    ocr = (pif.GetOutputCountRate(c, mod, ch) * realC - pif.GetOutputCountRate(p, mod, ch) * realP) / dReal;
+	    live = dLive / dReal;
+	  }
+
+	  if (binary) {
+	    float *r = &record[(mod * nChan + ch) * 3];
+	    r[0] = icr; r[1] = ocr; r[2] = live;
+	  } else {
+	    fprintf(out, "%.4f,%u,%u,%.1f,%.1f,%.4f\n", t, mod, ch, icr, ocr, live);
+	  }
+	}
+      }
+      if (binary) {
+	fwrite(&t, sizeof(t), 1, out);
+	fwrite(record.data(), sizeof(float), record.size(), out);
+      }
+    }
+    prev.swap(cur);
+  }
+
+  sampler.join();
+  fclose(out);
+
+  printf("Wrote %lu samples to %s (%lu dropped, %lu read errors)\n",
+	 (unsigned long)(nSamples > 0 ? nSamples - 1 : 0), fname,
+	 (unsigned long)ring.GetDropped(), (unsigned long)readErrors);
+
+  return EXIT_SUCCESS;
+}
@@ -26,11 +26,14 @@ int main(int argc, char **argv){
 	pif.GetSlots();
 	pif.Init();
 	pif.Boot(PixieInterface::DownloadParameters | PixieInterface::ProgramFPGA | PixieInterface::SetDAC, true);
+
+	// Write the modules at once, each in its own thread.
+	pif.SetParallelModules();
     
     flipper.SetBit(argv[3]);
     
 	std::string dum_str = "CHANNEL_CSRA";
-	if(forChannel(&pif, mod, ch, flipper, dum_str)){
+	if(forChannelParallel(&pif, mod, ch, flipper, dum_str)){
 		pif.SaveDSPParameters();
 	}
 